@@ -58,6 +58,13 @@ Java_com_google_android_filament_IndexBuffer_nBuilderBufferType(JNIEnv *env, jcl
     builder->bufferType(types[indexType & 1]);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_IndexBuffer_nBuilderStreaming(JNIEnv *env, jclass type,
+        jlong nativeBuilder, jboolean enabled) {
+    IndexBuffer::Builder* builder = (IndexBuffer::Builder *) nativeBuilder;
+    builder->streaming(enabled);
+}
+
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_google_android_filament_IndexBuffer_nBuilderBuild(JNIEnv *env, jclass type,
         jlong nativeBuilder, jlong nativeEngine) {
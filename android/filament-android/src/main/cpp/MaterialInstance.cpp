@@ -26,6 +26,10 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
+#include <vector>
+
+#include "common/NioUtils.h"
+
 using namespace filament;
 using namespace filament::math;
 
@@ -60,6 +64,18 @@ static void setParameter(JNIEnv* env, jlong nativeMaterialInstance, jstring name
     env->ReleaseStringUTFChars(name_, name);
 }
 
+// jlong handles are wider than pointers on 32-bit ABIs, they can't be reinterpreted in place
+static std::vector<MaterialInstance*> getInstances(JNIEnv* env,
+        jlongArray nativeMaterialInstances, jint count) {
+    std::vector<MaterialInstance*> instances(count);
+    jlong* handles = env->GetLongArrayElements(nativeMaterialInstances, NULL);
+    for (jint i = 0; i < count; i++) {
+        instances[i] = (MaterialInstance*) handles[i];
+    }
+    env->ReleaseLongArrayElements(nativeMaterialInstances, handles, JNI_ABORT);
+    return instances;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_google_android_filament_MaterialInstance_nSetParameterBool(JNIEnv *env, jclass,
@@ -246,6 +262,86 @@ Java_com_google_android_filament_MaterialInstance_nSetFloatParameterArray(JNIEnv
     env->ReleaseStringUTFChars(name_, name);
 }
 
+// Sets the parameter 'name' of 'count' instances, one value per instance, from a buffer of
+// 'count' consecutive elements.
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_google_android_filament_MaterialInstance_nSetIntParameters(JNIEnv *env, jclass,
+        jlongArray nativeMaterialInstances, jint count, jstring name_, jint element,
+        jobject values_, jint remaining) {
+    static constexpr jint sizes[] = { 1, 2, 3, 4 };
+    AutoBuffer nioBuffer(env, values_, count * sizes[element]);
+    void* v = nioBuffer.getData();
+    size_t sizeInBytes = nioBuffer.getSize();
+    if (sizeInBytes > (remaining << nioBuffer.getShift())) {
+        // BufferOverflowException
+        return -1;
+    }
+
+    std::vector<MaterialInstance*> instances = getInstances(env, nativeMaterialInstances, count);
+    const char* name = env->GetStringUTFChars(name_, 0);
+
+    switch ((IntElement) element) {
+        case INT:
+            MaterialInstance::setParameter(instances.data(), count, name, (const int32_t*) v);
+            break;
+        case INT2:
+            MaterialInstance::setParameter(instances.data(), count, name, (const int2*) v);
+            break;
+        case INT3:
+            MaterialInstance::setParameter(instances.data(), count, name, (const int3*) v);
+            break;
+        case INT4:
+            MaterialInstance::setParameter(instances.data(), count, name, (const int4*) v);
+            break;
+    }
+
+    env->ReleaseStringUTFChars(name_, name);
+    return 0;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_google_android_filament_MaterialInstance_nSetFloatParameters(JNIEnv *env, jclass,
+        jlongArray nativeMaterialInstances, jint count, jstring name_, jint element,
+        jobject values_, jint remaining) {
+    static constexpr jint sizes[] = { 1, 2, 3, 4, 9, 16 };
+    AutoBuffer nioBuffer(env, values_, count * sizes[element]);
+    void* v = nioBuffer.getData();
+    size_t sizeInBytes = nioBuffer.getSize();
+    if (sizeInBytes > (remaining << nioBuffer.getShift())) {
+        // BufferOverflowException
+        return -1;
+    }
+
+    std::vector<MaterialInstance*> instances = getInstances(env, nativeMaterialInstances, count);
+    const char* name = env->GetStringUTFChars(name_, 0);
+
+    switch ((FloatElement) element) {
+        case FLOAT:
+            MaterialInstance::setParameter(instances.data(), count, name, (const float*) v);
+            break;
+        case FLOAT2:
+            MaterialInstance::setParameter(instances.data(), count, name, (const float2*) v);
+            break;
+        case FLOAT3:
+            MaterialInstance::setParameter(instances.data(), count, name, (const float3*) v);
+            break;
+        case FLOAT4:
+            MaterialInstance::setParameter(instances.data(), count, name, (const float4*) v);
+            break;
+        case MAT3:
+            MaterialInstance::setParameter(instances.data(), count, name, (const mat3f*) v);
+            break;
+        case MAT4:
+            MaterialInstance::setParameter(instances.data(), count, name, (const mat4f*) v);
+            break;
+    }
+
+    env->ReleaseStringUTFChars(name_, name);
+    return 0;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_google_android_filament_MaterialInstance_nSetParameterTexture(
@@ -199,6 +199,40 @@ Java_com_google_android_filament_RenderableManager_nBuilderMorphing(JNIEnv*, jcl
     builder->morphing(enabled);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_RenderableManager_nBuilderComputeSkinning(JNIEnv*, jclass,
+        jlong nativeBuilder, jboolean enabled) {
+    RenderableManager::Builder *builder = (RenderableManager::Builder *) nativeBuilder;
+    builder->computeSkinning(enabled);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_RenderableManager_nBuilderComputeMorphing(JNIEnv*, jclass,
+        jlong nativeBuilder, jint targetCount) {
+    RenderableManager::Builder *builder = (RenderableManager::Builder *) nativeBuilder;
+    builder->computeMorphing((size_t) targetCount);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_RenderableManager_nBuilderDynamicBounds(JNIEnv* env, jclass,
+        jlong nativeBuilder, jboolean enable, jint boneCount, jobject boneBoxes, jint remaining) {
+    RenderableManager::Builder *builder = (RenderableManager::Builder *) nativeBuilder;
+    if (!boneBoxes) {
+        builder->dynamicBounds(enable);
+        return 0;
+    }
+    // each box is a center and a half extent
+    AutoBuffer nioBuffer(env, boneBoxes, boneCount * 6);
+    void* data = nioBuffer.getData();
+    size_t sizeInBytes = nioBuffer.getSize();
+    if (sizeInBytes > (remaining << nioBuffer.getShift())) {
+        // BufferOverflowException
+        return -1;
+    }
+    builder->dynamicBounds(enable, static_cast<Box const*>(data));
+    return 0;
+}
+
 
 extern "C" JNIEXPORT jint JNICALL
 Java_com_google_android_filament_RenderableManager_nSetBonesAsMatrices(JNIEnv* env, jclass,
@@ -244,6 +278,16 @@ Java_com_google_android_filament_RenderableManager_nSetMorphWeights(JNIEnv* env,
     rm->setMorphWeights((RenderableManager::Instance)instance, floatvec);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_RenderableManager_nSetMorphWeightsArray(JNIEnv* env, jclass,
+        jlong nativeRenderableManager, jint instance, jfloatArray weights, jint offset) {
+    RenderableManager *rm = (RenderableManager *) nativeRenderableManager;
+    jsize count = env->GetArrayLength(weights);
+    jfloat* vec = env->GetFloatArrayElements(weights, NULL);
+    rm->setMorphWeights((RenderableManager::Instance)instance, vec, (size_t)count, (size_t)offset);
+    env->ReleaseFloatArrayElements(weights, vec, JNI_ABORT);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_RenderableManager_nSetAxisAlignedBoundingBox(JNIEnv*,
         jclass, jlong nativeRenderableManager, jint i, jfloat cx, jfloat cy, jfloat cz,
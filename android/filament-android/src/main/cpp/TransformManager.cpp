@@ -23,6 +23,8 @@
 
 #include <math/mat4.h>
 
+#include "common/NioUtils.h"
+
 using namespace utils;
 using namespace filament;
 
@@ -97,6 +99,32 @@ Java_com_google_android_filament_TransformManager_nSetTransform(JNIEnv* env,
     env->ReleaseFloatArrayElements(localTransform_, localTransform, JNI_ABORT);
 }
 
+// Sets the local transforms of 'count' instances from a buffer of 'count' column-major 4x4
+// matrices, in a single local transform transaction. A transaction that is already open is
+// committed as well.
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_TransformManager_nSetTransforms(JNIEnv* env,
+        jclass, jlong nativeTransformManager, jintArray instances_, jint count,
+        jobject localTransforms_, jint remaining) {
+    TransformManager* tm = (TransformManager*) nativeTransformManager;
+    AutoBuffer nioBuffer(env, localTransforms_, count * 16);
+    void* data = nioBuffer.getData();
+    size_t sizeInBytes = nioBuffer.getSize();
+    if (sizeInBytes > (remaining << nioBuffer.getShift())) {
+        // BufferOverflowException
+        return -1;
+    }
+    auto const* localTransforms = static_cast<const filament::math::mat4f*>(data);
+    jint* instances = env->GetIntArrayElements(instances_, NULL);
+    tm->openLocalTransformTransaction();
+    for (jint i = 0; i < count; i++) {
+        tm->setTransform((TransformManager::Instance) instances[i], localTransforms[i]);
+    }
+    tm->commitLocalTransformTransaction();
+    env->ReleaseIntArrayElements(instances_, instances, JNI_ABORT);
+    return 0;
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_TransformManager_nGetTransform(JNIEnv* env,
         jclass, jlong nativeTransformManager, jint i,
@@ -74,6 +74,13 @@ Java_com_google_android_filament_VertexBuffer_nBuilderNormalized(JNIEnv *env, jc
     builder->normalized((VertexAttribute) attribute, normalized);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_VertexBuffer_nBuilderStreaming(JNIEnv *env, jclass type,
+        jlong nativeBuilder, jboolean enabled) {
+    VertexBuffer::Builder* builder = (VertexBuffer::Builder *) nativeBuilder;
+    builder->streaming(enabled);
+}
+
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_google_android_filament_VertexBuffer_nBuilderBuild(JNIEnv *env, jclass type,
         jlong nativeBuilder, jlong nativeEngine) {
@@ -45,6 +45,14 @@ Java_com_google_android_filament_View_nSetCamera(JNIEnv*, jclass,
     view->setCamera(camera);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetRightEyeCamera(JNIEnv*, jclass,
+        jlong nativeView, jlong nativeCamera) {
+    View* view = (View*) nativeView;
+    Camera* camera = (Camera*) nativeCamera;
+    view->setRightEyeCamera(camera);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_View_nSetColorGrading(JNIEnv*, jclass,
         jlong nativeView, jlong nativeColorGrading) {
@@ -315,6 +323,15 @@ Java_com_google_android_filament_View_nSetVignetteOptions(JNIEnv*, jclass, jlong
             .color = LinearColorA{r, g, b, a}, .enabled = (bool)enabled});
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetFoveationOptions(JNIEnv*, jclass, jlong nativeView,
+        jfloat centerX, jfloat centerY, jfloat gainX, jfloat gainY, jfloat area, jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setFoveationOptions({.center = {centerX, centerY}, .gain = {gainX, gainY},
+            .area = area, .enabled = (bool)enabled});
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_google_android_filament_View_nSetTemporalAntiAliasingOptions(JNIEnv *, jclass,
@@ -346,3 +363,19 @@ Java_com_google_android_filament_View_nIsScreenSpaceRefractionEnabled(JNIEnv *,
     View* view = (View*) nativeView;
     return (jboolean)view->isScreenSpaceRefractionEnabled();
 }
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetDepthPrepassEnabled(JNIEnv *, jclass,
+        jlong nativeView, jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setDepthPrepassEnabled((bool)enabled);
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_View_nIsDepthPrepassEnabled(JNIEnv *, jclass,
+        jlong nativeView) {
+    View* view = (View*) nativeView;
+    return (jboolean)view->isDepthPrepassEnabled();
+}
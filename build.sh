@@ -46,6 +46,9 @@ function print_help {
     echo "        For macOS, this builds universal binaries for both Apple silicon and Intel-based Macs."
     echo "    -w"
     echo "        Build Web documents (compiles .md.html files to .html)."
+    echo "    -e"
+    echo "        Build the WebGL target with wasm threads, the job system runs on web workers."
+    echo "        The page must be cross-origin isolated, see web/filament-js/README.md."
     echo ""
     echo "Build types:"
     echo "    release"
@@ -122,6 +125,9 @@ VULKAN_ANDROID_GRADLE_OPTION=""
 
 SWIFTSHADER_OPTION="-DFILAMENT_USE_SWIFTSHADER=OFF"
 
+WEBGL_THREADS_OPTION="-DFILAMENT_WEB_THREADS=OFF"
+WEBGL_VARIANT=
+
 IOS_BUILD_SIMULATOR=false
 BUILD_UNIVERSAL_LIBRARIES=false
 
@@ -206,12 +212,46 @@ function build_desktop {
     fi
 }
 
+# Builds the filament.wasm loaded by browsers that support WebAssembly SIMD, the main build
+# ships it as filament-simd.wasm.
+function build_webgl_simd_with_target {
+    local lc_target=$(echo "$1" | tr '[:upper:]' '[:lower:]')
+
+    echo "Building WebGL${WEBGL_VARIANT} ${lc_target} with WebAssembly SIMD..."
+    mkdir -p "out/cmake-webgl${WEBGL_VARIANT}-simd-${lc_target}"
+    cd "out/cmake-webgl${WEBGL_VARIANT}-simd-${lc_target}"
+
+    # Apply the emscripten environment within a subshell.
+    (
+    # shellcheck disable=SC1090
+    source "${EMSDK}/emsdk_env.sh"
+    if [[ ! -d "CMakeFiles" ]] || [[ "${ISSUE_CMAKE_ALWAYS}" == "true" ]]; then
+        cmake \
+            -G "${BUILD_GENERATOR}" \
+            -DIMPORT_EXECUTABLES_DIR=out \
+            -DCMAKE_TOOLCHAIN_FILE="${EMSDK}/upstream/emscripten/cmake/Modules/Platform/Emscripten.cmake" \
+            -DCMAKE_BUILD_TYPE="$1" \
+            -DWEBGL=1 \
+            -DFILAMENT_WEB_SIMD=ON \
+            -DFILAMENT_SKIP_SAMPLES=ON \
+            ${WEBGL_THREADS_OPTION} \
+            ../..
+    fi
+    ${BUILD_COMMAND} filament-js
+    )
+
+    cd ../..
+}
+
 function build_webgl_with_target {
     local lc_target=$(echo "$1" | tr '[:upper:]' '[:lower:]')
 
-    echo "Building WebGL ${lc_target}..."
-    mkdir -p "out/cmake-webgl-${lc_target}"
-    cd "out/cmake-webgl-${lc_target}"
+    build_webgl_simd_with_target "$1"
+    local simd_wasm="${PWD}/out/cmake-webgl${WEBGL_VARIANT}-simd-${lc_target}/web/filament-js/filament.wasm"
+
+    echo "Building WebGL${WEBGL_VARIANT} ${lc_target}..."
+    mkdir -p "out/cmake-webgl${WEBGL_VARIANT}-${lc_target}"
+    cd "out/cmake-webgl${WEBGL_VARIANT}-${lc_target}"
 
     if [[ ! "${BUILD_TARGETS}" ]]; then
         BUILD_TARGETS=${BUILD_CUSTOM_TARGETS}
@@ -228,8 +268,10 @@ function build_webgl_with_target {
             -DIMPORT_EXECUTABLES_DIR=out \
             -DCMAKE_TOOLCHAIN_FILE="${EMSDK}/upstream/emscripten/cmake/Modules/Platform/Emscripten.cmake" \
             -DCMAKE_BUILD_TYPE="$1" \
-            -DCMAKE_INSTALL_PREFIX="../webgl-${lc_target}/filament" \
+            -DCMAKE_INSTALL_PREFIX="../webgl${WEBGL_VARIANT}-${lc_target}/filament" \
             -DWEBGL=1 \
+            -DFILAMENT_WEB_SIMD_WASM="${simd_wasm}" \
+            ${WEBGL_THREADS_OPTION} \
             ../..
         ${BUILD_COMMAND} ${BUILD_TARGETS}
         )
@@ -247,14 +289,20 @@ function build_webgl_with_target {
         fi
 
         if [[ "${ISSUE_ARCHIVES}" == "true" ]]; then
-            echo "Generating out/filament-${lc_target}-web.tgz..."
+            local archive="filament${WEBGL_VARIANT}-${lc_target}-web"
+            echo "Generating out/${archive}.tgz..."
             cd web/filament-js
-            tar -cvf "../../../filament-${lc_target}-web.tar" filament.js
-            tar -rvf "../../../filament-${lc_target}-web.tar" filament.wasm
-            tar -rvf "../../../filament-${lc_target}-web.tar" filament.d.ts
+            tar -cvf "../../../${archive}.tar" filament.js
+            tar -rvf "../../../${archive}.tar" filament.wasm
+            tar -rvf "../../../${archive}.tar" filament-simd.wasm
+            tar -rvf "../../../${archive}.tar" filament.d.ts
+            # the script that starts the web workers of the wasm threads build
+            if [[ -f "filament.worker.js" ]]; then
+                tar -rvf "../../../${archive}.tar" filament.worker.js
+            fi
             cd -
-            gzip -c "../filament-${lc_target}-web.tar" > "../filament-${lc_target}-web.tgz"
-            rm "../filament-${lc_target}-web.tar"
+            gzip -c "../${archive}.tar" > "../${archive}.tgz"
+            rm "../${archive}.tar"
         fi
     fi
 
@@ -655,7 +703,7 @@ function run_tests {
 
 pushd "$(dirname "$0")" > /dev/null
 
-while getopts ":hacfijmp:q:uvslwt" opt; do
+while getopts ":hacfijmp:q:uvslwte" opt; do
     case ${opt} in
         h)
             print_help
@@ -765,6 +813,11 @@ while getopts ":hacfijmp:q:uvslwt" opt; do
         w)
             ISSUE_WEB_DOCS=true
             ;;
+        e)
+            WEBGL_THREADS_OPTION="-DFILAMENT_WEB_THREADS=ON"
+            WEBGL_VARIANT="-threads"
+            echo "WebAssembly threads enabled."
+            ;;
         \?)
             echo "Invalid option: -${OPTARG}" >&2
             echo ""
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <backend/Platform.h>
+
+#include "private/backend/CommandBufferQueue.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/DriverApi.h"
+
+#include "../test/ShaderGenerator.h"
+#include "../test/TrianglePrimitive.h"
+
+#include <chrono>
+#include <string>
+
+// ------------------------------------------------------------------------------------------------
+//
+// Measures the CPU cost of a draw call on each backend, in isolation from the engine: the commands
+// are encoded into a CommandStream on the benchmark's thread ("encode"), then executed by the
+// driver on the same thread ("execute"), as the engine's driver thread would. Each iteration is
+// a frame of DRAW_COUNT tiny triangles rendered into a headless swap chain, so the GPU is not the
+// bottleneck; only one of the two phases of the frame is timed.
+//
+// The benchmarks are named draws/<backend>/<pattern>/<phase>, e.g.
+//
+//     benchmark_backend --benchmark_filter=draws/vulkan/ --benchmark_counters_tabular=true
+//
+// items_per_second is the number of draws per second, and ns/draw their average cost. Backends
+// that can't be created on this machine are reported as errors.
+// ------------------------------------------------------------------------------------------------
+
+using namespace filament;
+using namespace filament::backend;
+
+namespace {
+
+constexpr size_t DRAW_COUNT = 1000;
+constexpr uint32_t SWAP_CHAIN_SIZE = 64;
+
+constexpr size_t CONFIG_MIN_COMMAND_BUFFERS_SIZE = 1 * 1024 * 1024;
+constexpr size_t CONFIG_COMMAND_BUFFERS_SIZE     = 3 * CONFIG_MIN_COMMAND_BUFFERS_SIZE;
+
+// The state that changes between consecutive draws.
+enum class Pattern {
+    SAME_PIPELINE,      // nothing changes
+    MATERIAL_SWITCH,    // alternates between two programs
+    UBO_REBIND,         // alternates between two uniform buffers
+    TEXTURE_SWITCH,     // alternates between two sampler groups, i.e. textures
+};
+
+enum class Phase {
+    ENCODE,     // recording the commands into the CommandStream
+    EXECUTE,    // executing them with the driver
+};
+
+std::string vertex(R"(#version 450 core
+layout(location = 0) in vec4 mesh_position;
+void main() {
+    gl_Position = vec4(mesh_position.xy * 0.01, 0.0, 1.0);
+})");
+
+// The two materials only differ by the constant added to their color.
+std::string fragment(float bias) {
+    return R"(#version 450 core
+precision mediump int; precision highp float;
+layout(location = 0) out vec4 fragColor;
+layout(location = 0) uniform sampler2D tex;
+uniform Params {
+    highp vec4 color;
+} params;
+void main() {
+    fragColor = texture(tex, vec2(0.5)) * params.color + )" + std::to_string(bias) + R"(;
+})";
+}
+
+// The resources of the benchmark, created and destroyed along with the driver.
+class DrawBenchmark {
+public:
+    explicit DrawBenchmark(Backend backend)
+            : mCommandBufferQueue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, CONFIG_COMMAND_BUFFERS_SIZE) {
+        Backend actual = backend;
+        mPlatform = DefaultPlatform::create(&actual);
+        if (!mPlatform || actual != backend) {
+            return;
+        }
+        mDriver = mPlatform->createDriver(nullptr);
+        if (!mDriver) {
+            return;
+        }
+        mCommandStream = CommandStream(*mDriver, mCommandBufferQueue.getCircularBuffer());
+        createResources(backend);
+        execute();
+    }
+
+    ~DrawBenchmark() {
+        if (mDriver) {
+            destroyResources();
+            execute();
+            mDriver->terminate();
+            delete mDriver;
+        }
+        DefaultPlatform::destroy(&mPlatform);
+    }
+
+    bool isValid() const noexcept { return mDriver != nullptr; }
+
+    // Records a frame of DRAW_COUNT draws.
+    void encode(Pattern pattern, uint32_t frameId) {
+        DriverApi& api = mCommandStream;
+        api.makeCurrent(mSwapChain, mSwapChain);
+        api.beginFrame(0, frameId);
+        api.beginRenderPass(mRenderTarget, mPassParams);
+        api.bindUniformBuffer(0, mUniformBuffers[0]);
+        api.bindSamplers(0, mSamplerGroups[0]);
+
+        auto primitive = mTriangle->getRenderPrimitive();
+        for (size_t i = 0; i < DRAW_COUNT; i++) {
+            const size_t alternate = i & 1u;
+            switch (pattern) {
+                case Pattern::SAME_PIPELINE:
+                    break;
+                case Pattern::MATERIAL_SWITCH:
+                    mPipeline.program = mPrograms[alternate];
+                    break;
+                case Pattern::UBO_REBIND:
+                    api.bindUniformBuffer(0, mUniformBuffers[alternate]);
+                    break;
+                case Pattern::TEXTURE_SWITCH:
+                    api.bindSamplers(0, mSamplerGroups[alternate]);
+                    break;
+            }
+            api.draw(mPipeline, primitive, 1);
+        }
+        mPipeline.program = mPrograms[0];
+
+        api.endRenderPass();
+        api.commit(mSwapChain);
+        api.endFrame(frameId);
+        mCommandBufferQueue.flush();
+    }
+
+    // Executes the commands encoded so far, like the engine's driver thread.
+    void execute() {
+        mCommandBufferQueue.flush();
+        auto buffers = mCommandBufferQueue.waitForCommands();
+        for (auto& item : buffers) {
+            if (UTILS_LIKELY(item.begin)) {
+                mCommandStream.execute(item.begin);
+                mCommandBufferQueue.releaseBuffer(item);
+            }
+        }
+    }
+
+private:
+    void createResources(Backend backend) {
+        DriverApi& api = mCommandStream;
+        mSwapChain = api.createSwapChainHeadless(SWAP_CHAIN_SIZE, SWAP_CHAIN_SIZE, 0);
+        api.makeCurrent(mSwapChain, mSwapChain);
+        mRenderTarget = api.createDefaultRenderTarget(0);
+
+        for (size_t i = 0; i < 2; i++) {
+            // The noop driver doesn't look at the shaders.
+            Program program;
+            if (backend != Backend::NOOP) {
+                test::ShaderGenerator generator(vertex, fragment(float(i)),
+                        test::Backend(backend), false);
+                program = generator.getProgram();
+            }
+            Program::Sampler samplers[] = { utils::CString("tex"), 0, false };
+            program.setSamplerGroup(0, samplers, 1);
+            program.setUniformBlock(0, utils::CString("params"));
+            mPrograms[i] = api.createProgram(std::move(program));
+
+            static const math::float4 color = { 1.0f, 0.5f, 0.25f, 1.0f };
+            mUniformBuffers[i] = api.createUniformBuffer(sizeof(color), BufferUsage::STATIC);
+            api.loadUniformBuffer(mUniformBuffers[i], { &color, sizeof(color) });
+
+            static const uint32_t texels[4] = { 0xffffffff, 0xff0000ff, 0xff00ff00, 0xffff0000 };
+            mTextures[i] = api.createTexture(SamplerType::SAMPLER_2D, 1, TextureFormat::RGBA8, 1,
+                    2, 2, 1, TextureUsage::DEFAULT);
+            api.update2DImage(mTextures[i], 0, 0, 0, 2, 2, { texels, sizeof(texels),
+                    PixelDataFormat::RGBA, PixelDataType::UBYTE });
+
+            SamplerGroup group(1);
+            group.setSampler(0, mTextures[i], {});
+            mSamplerGroups[i] = api.createSamplerGroup(group.getSize());
+            api.updateSamplerGroup(mSamplerGroups[i], std::move(group.toCommandStream()));
+        }
+        mTriangle = new test::TrianglePrimitive(api);
+
+        mPipeline.program = mPrograms[0];
+        mPipeline.rasterState.colorWrite = true;
+        mPipeline.rasterState.depthWrite = false;
+        mPipeline.rasterState.depthFunc = RasterState::DepthFunc::A;
+        mPipeline.rasterState.culling = CullingMode::NONE;
+
+        mPassParams.viewport = { 0, 0, SWAP_CHAIN_SIZE, SWAP_CHAIN_SIZE };
+        mPassParams.flags.clear = TargetBufferFlags::COLOR;
+        mPassParams.flags.discardStart = TargetBufferFlags::ALL;
+        mPassParams.flags.discardEnd = TargetBufferFlags::NONE;
+    }
+
+    void destroyResources() {
+        DriverApi& api = mCommandStream;
+        delete mTriangle;
+        for (size_t i = 0; i < 2; i++) {
+            api.destroySamplerGroup(mSamplerGroups[i]);
+            api.destroyTexture(mTextures[i]);
+            api.destroyUniformBuffer(mUniformBuffers[i]);
+            api.destroyProgram(mPrograms[i]);
+        }
+        api.destroyRenderTarget(mRenderTarget);
+        api.destroySwapChain(mSwapChain);
+    }
+
+    DefaultPlatform* mPlatform = nullptr;
+    Driver* mDriver = nullptr;
+    CommandBufferQueue mCommandBufferQueue;
+    CommandStream mCommandStream;
+
+    Handle<HwSwapChain> mSwapChain;
+    Handle<HwRenderTarget> mRenderTarget;
+    Handle<HwProgram> mPrograms[2];
+    Handle<HwUniformBuffer> mUniformBuffers[2];
+    Handle<HwTexture> mTextures[2];
+    Handle<HwSamplerGroup> mSamplerGroups[2];
+    test::TrianglePrimitive* mTriangle = nullptr;
+    PipelineState mPipeline;
+    RenderPassParams mPassParams;
+};
+
+void draws(benchmark::State& state, Backend backend, Pattern pattern, Phase phase) {
+    DrawBenchmark bench(backend);
+    if (!bench.isValid()) {
+        state.SkipWithError("this backend is not available");
+        return;
+    }
+
+    // Only the phase being measured is timed.
+    using clock = std::chrono::steady_clock;
+    clock::duration elapsed{};
+    uint32_t frameId = 0;
+    for (auto _ : state) {
+        if (phase == Phase::ENCODE) {
+            const clock::time_point start = clock::now();
+            bench.encode(pattern, frameId++);
+            elapsed += clock::now() - start;
+            state.PauseTiming();
+            bench.execute();
+            state.ResumeTiming();
+        } else {
+            state.PauseTiming();
+            bench.encode(pattern, frameId++);
+            state.ResumeTiming();
+            const clock::time_point start = clock::now();
+            bench.execute();
+            elapsed += clock::now() - start;
+        }
+    }
+
+    const size_t count = state.iterations() * DRAW_COUNT;
+    state.SetItemsProcessed(count);
+    state.counters["ns/draw"] = double(std::chrono::nanoseconds(elapsed).count()) / count;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    const std::pair<Backend, const char*> backends[] = {
+            { Backend::NOOP, "noop" },
+            { Backend::OPENGL, "opengl" },
+            { Backend::VULKAN, "vulkan" },
+            { Backend::METAL, "metal" },
+    };
+    const std::pair<Pattern, const char*> patterns[] = {
+            { Pattern::SAME_PIPELINE, "same_pipeline" },
+            { Pattern::MATERIAL_SWITCH, "material_switch" },
+            { Pattern::UBO_REBIND, "ubo_rebind" },
+            { Pattern::TEXTURE_SWITCH, "texture_switch" },
+    };
+    const std::pair<Phase, const char*> phases[] = {
+            { Phase::ENCODE, "encode" },
+            { Phase::EXECUTE, "execute" },
+    };
+    for (auto const& backend : backends) {
+        for (auto const& pattern : patterns) {
+            for (auto const& phase : phases) {
+                const std::string name = std::string("draws/") + backend.second + "/" +
+                        pattern.second + "/" + phase.second;
+                benchmark::RegisterBenchmark(name.c_str(), draws,
+                        backend.first, pattern.first, phase.first)->Unit(benchmark::kMicrosecond);
+            }
+        }
+    }
+
+    test::ShaderGenerator::init();
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    test::ShaderGenerator::shutdown();
+    return 0;
+}
@@ -19,6 +19,8 @@
 #ifndef TNT_FILAMENT_DRIVER_BUFFERDESCRIPTOR_H
 #define TNT_FILAMENT_DRIVER_BUFFERDESCRIPTOR_H
 
+#include <backend/CallbackHandler.h>
+
 #include <utils/compiler.h>
 
 #include <stddef.h>
@@ -40,7 +42,7 @@ public:
     /**
      * Callback used to destroy the buffer data.
      * Guarantees:
-     *      Called on the main filament thread.
+     *      Called on the main filament thread, or by the CallbackHandler if one is set.
      *
      * Limitations:
      *      Must be lightweight.
@@ -54,7 +56,11 @@ public:
     //! calls the callback to advertise BufferDescriptor no-longer owns the buffer
     ~BufferDescriptor() noexcept {
         if (callback) {
-            callback(buffer, size, user);
+            if (handler) {
+                postCallback();
+            } else {
+                callback(buffer, size, user);
+            }
         }
     }
 
@@ -62,7 +68,8 @@ public:
     BufferDescriptor& operator=(const BufferDescriptor& rhs) = delete;
 
     BufferDescriptor(BufferDescriptor&& rhs) noexcept
-        : buffer(rhs.buffer), size(rhs.size), callback(rhs.callback), user(rhs.user) {
+        : buffer(rhs.buffer), size(rhs.size),
+          callback(rhs.callback), user(rhs.user), handler(rhs.handler) {
             rhs.buffer = nullptr;
             rhs.callback = nullptr;
     }
@@ -73,6 +80,7 @@ public:
             size = rhs.size;
             callback = rhs.callback;
             user = rhs.user;
+            handler = rhs.handler;
             rhs.buffer = nullptr;
             rhs.callback = nullptr;
         }
@@ -92,13 +100,42 @@ public:
     }
 
     /**
-     * Set or replace the release callback function
+     * Creates a BufferDescriptor that references a CPU memory-buffer, released by a
+     * CallbackHandler
+     * @param buffer    Memory address of the CPU buffer to reference
+     * @param size      Size of the CPU buffer in bytes
+     * @param handler   The CallbackHandler the callback is posted to, see CallbackHandler
+     * @param callback  A callback used to release the CPU buffer from this BufferDescriptor
+     * @param user      An opaque user pointer passed to the callback function when it's called
+     */
+    BufferDescriptor(void const* buffer, size_t size, CallbackHandler* handler,
+            Callback callback, void* user = nullptr) noexcept
+                : buffer(const_cast<void*>(buffer)), size(size), callback(callback), user(user),
+                  handler(handler) {
+    }
+
+    /**
+     * Set or replace the release callback function, the callback is called on the main filament
+     * thread
      * @param callback  The new callback function
      * @param user      An opaque user pointer passed to the callbeck function when it's called
      */
     void setCallback(Callback callback, void* user = nullptr) noexcept {
         this->callback = callback;
         this->user = user;
+        this->handler = nullptr;
+    }
+
+    /**
+     * Set or replace the release callback function, the callback is posted to the given handler
+     * @param handler   The CallbackHandler the callback is posted to
+     * @param callback  The new callback function
+     * @param user      An opaque user pointer passed to the callbeck function when it's called
+     */
+    void setCallback(CallbackHandler* handler, Callback callback, void* user = nullptr) noexcept {
+        this->callback = callback;
+        this->user = user;
+        this->handler = handler;
     }
 
     //! Returns whether a release callback is set
@@ -114,6 +151,11 @@ public:
         return user;
     }
 
+    //! Returns the CallbackHandler the callback is posted to, or nullptr
+    CallbackHandler* getHandler() const noexcept {
+        return handler;
+    }
+
     //! CPU mempry-buffer virtual address
     void* buffer = nullptr;
 
@@ -121,9 +163,13 @@ public:
     size_t size = 0;
 
 private:
+    // hands the callback to the handler
+    void postCallback() noexcept;
+
     // callback when the buffer is consumed.
     Callback callback = nullptr;
     void* user = nullptr;
+    CallbackHandler* handler = nullptr;
 };
 
 } // namespace backend
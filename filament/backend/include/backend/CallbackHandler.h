@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_BACKEND_CALLBACKHANDLER_H
+#define TNT_FILAMENT_BACKEND_CALLBACKHANDLER_H
+
+#include <utils/compiler.h>
+
+namespace filament {
+namespace backend {
+
+/**
+ * A generic interface to dispatch callbacks on a thread chosen by the application.
+ *
+ * By default, the release callbacks of BufferDescriptors are called on the Engine's main thread
+ * when a frame begins or the Engine is flushed. Giving a CallbackHandler to a BufferDescriptor
+ * instead hands its callback to the handler, which typically queues it to a thread of its own
+ * or to the application's main loop. This keeps large frees, or callbacks that take locks of the
+ * application, out of the frame.
+ *
+ * The callbacks released together are posted in a single batch.
+ */
+class UTILS_PUBLIC CallbackHandler {
+public:
+    using Callback = void(*)(void* user);
+
+    /**
+     * Schedules callback(user) to be called on the thread of the handler's choice. post() is
+     * called on the Engine's main thread, or on the thread destroying the BufferDescriptor, and
+     * must not wait for the callback to run.
+     *
+     * @param user      An opaque pointer, the callback must be called with it exactly once
+     * @param callback  The function to call
+     */
+    virtual void post(void* user, Callback callback) = 0;
+
+protected:
+    virtual ~CallbackHandler() = default;
+};
+
+} // namespace backend
+} // namespace filament
+
+#endif // TNT_FILAMENT_BACKEND_CALLBACKHANDLER_H
@@ -110,6 +110,14 @@ enum class BufferUsage : uint8_t {
     STREAM,      //!< content invalidated and modified frequently, used many times
 };
 
+/**
+ * How a buffer object is bound to programs.
+ */
+enum class BufferObjectBinding : uint8_t {
+    UNIFORM,            //!< read-only uniform block
+    SHADER_STORAGE      //!< storage block, can be written by compute programs
+};
+
 /**
  * Defines a viewport, which is the origin and extent of the clip-space.
  * All drawing is clipped to the viewport.
@@ -345,6 +353,10 @@ enum class CompressedPixelDataType : uint16_t {
     SRGB8_ALPHA8_ASTC_10x10,
     SRGB8_ALPHA8_ASTC_12x10,
     SRGB8_ALPHA8_ASTC_12x12,
+
+    // BPTC float formats are available with GL 4.2 or an extension, Vulkan and Metal on macOS
+    RGB_BPTC_SIGNED_FLOAT,
+    RGB_BPTC_UNSIGNED_FLOAT,
 };
 
 /** Supported texel formats
@@ -415,6 +427,8 @@ enum class CompressedPixelDataType : uint16_t {
  * ETC2_EAC_SRGBA8  | Compresses SRGB8_A8
  * ETC2_RGB8_A1     | Compresses RGB8 with 1-bit alpha
  * ETC2_SRGB8_A1    | Compresses sRGB8 with 1-bit alpha
+ * RGB_BPTC_SIGNED_FLOAT   | BC6H, compresses RGB16F
+ * RGB_BPTC_UNSIGNED_FLOAT | BC6H, compresses positive RGB16F
  *
  *
  * @see Texture
@@ -499,17 +513,22 @@ enum class TextureFormat : uint16_t {
     SRGB8_ALPHA8_ASTC_10x10,
     SRGB8_ALPHA8_ASTC_12x10,
     SRGB8_ALPHA8_ASTC_12x12,
+
+    // BPTC float formats are available with GL 4.2 or an extension, Vulkan and Metal on macOS
+    RGB_BPTC_SIGNED_FLOAT,
+    RGB_BPTC_UNSIGNED_FLOAT,
 };
 
 //! Bitmask describing the intended Texture Usage
 enum class TextureUsage : uint8_t {
-    COLOR_ATTACHMENT    = 0x1,                      //!< Texture can be used as a color attachment
-    DEPTH_ATTACHMENT    = 0x2,                      //!< Texture can be used as a depth attachment
-    STENCIL_ATTACHMENT  = 0x4,                      //!< Texture can be used as a stencil attachment
-    UPLOADABLE          = 0x8,                      //!< Data can be uploaded into this texture (default)
-    SAMPLEABLE          = 0x10,                     //!< Texture can be sampled (default)
-    SUBPASS_INPUT       = 0x20,                     //!< Texture can be used as a subpass input
-    DEFAULT             = UPLOADABLE | SAMPLEABLE   //!< Default texture usage
+    COLOR_ATTACHMENT     = 0x1,                     //!< Texture can be used as a color attachment
+    DEPTH_ATTACHMENT     = 0x2,                     //!< Texture can be used as a depth attachment
+    STENCIL_ATTACHMENT   = 0x4,                     //!< Texture can be used as a stencil attachment
+    UPLOADABLE           = 0x8,                     //!< Data can be uploaded into this texture (default)
+    SAMPLEABLE           = 0x10,                    //!< Texture can be sampled (default)
+    SUBPASS_INPUT        = 0x20,                    //!< Texture can be used as a subpass input
+    TRANSIENT_ATTACHMENT = 0x40,                    //!< Attachment contents never need to be stored
+    DEFAULT              = UPLOADABLE | SAMPLEABLE  //!< Default texture usage
 };
 
 //! Texture swizzle
@@ -536,6 +555,48 @@ static constexpr bool isDepthFormat(TextureFormat format) noexcept {
     }
 }
 
+//! returns whether this format is an unsigned integer format
+static constexpr bool isUnsignedIntFormat(TextureFormat format) noexcept {
+    switch (format) {
+        case TextureFormat::R8UI:
+        case TextureFormat::R16UI:
+        case TextureFormat::R32UI:
+        case TextureFormat::RG8UI:
+        case TextureFormat::RG16UI:
+        case TextureFormat::RG32UI:
+        case TextureFormat::RGB8UI:
+        case TextureFormat::RGB16UI:
+        case TextureFormat::RGB32UI:
+        case TextureFormat::RGBA8UI:
+        case TextureFormat::RGBA16UI:
+        case TextureFormat::RGBA32UI:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//! returns whether this format is a signed integer format
+static constexpr bool isSignedIntFormat(TextureFormat format) noexcept {
+    switch (format) {
+        case TextureFormat::R8I:
+        case TextureFormat::R16I:
+        case TextureFormat::R32I:
+        case TextureFormat::RG8I:
+        case TextureFormat::RG16I:
+        case TextureFormat::RG32I:
+        case TextureFormat::RGB8I:
+        case TextureFormat::RGB16I:
+        case TextureFormat::RGB32I:
+        case TextureFormat::RGBA8I:
+        case TextureFormat::RGBA16I:
+        case TextureFormat::RGBA32I:
+            return true;
+        default:
+            return false;
+    }
+}
+
 //! returns whether this format a compressed format
 static constexpr bool isCompressedFormat(TextureFormat format) noexcept {
     return format >= TextureFormat::EAC_R11;
@@ -555,6 +616,12 @@ static constexpr bool isS3TCSRGBCompression(TextureFormat format) noexcept {
     return format >= TextureFormat::DXT1_SRGB && format <= TextureFormat::DXT5_SRGBA;
 }
 
+//! returns whether this format is a BPTC compressed format
+static constexpr bool isBPTCCompression(TextureFormat format) noexcept {
+    return format >= TextureFormat::RGB_BPTC_SIGNED_FLOAT &&
+            format <= TextureFormat::RGB_BPTC_UNSIGNED_FLOAT;
+}
+
 //! Texture Cubemap Face
 enum class TextureCubemapFace : uint8_t {
     // don't change the enums values
@@ -855,6 +922,26 @@ struct RenderPassFlags {
 /**
  * Parameters of a render pass.
  */
+/**
+ * Foveated rendering of a render pass: the shading rate decreases away from a focal point.
+ * Backends that don't support it ignore it.
+ */
+struct Foveation {
+    filament::math::float2 center = {};     //!< focal point in the viewport, in NDC
+    filament::math::float2 gain = {};       //!< resolution falloff away from the focal point, zero to disable
+    float area = 0.0f;                      //!< size of the full resolution area, in NDC
+};
+
+/**
+ * Statistics of the memory pools from which a backend sub-allocates its buffers and textures.
+ * Backends that don't pool their allocations report zeros.
+ */
+struct GpuMemoryPoolStats {
+    uint64_t pooled = 0;        //!< device memory allocated for the blocks of the pools
+    uint64_t unused = 0;        //!< bytes of those blocks that no resource occupies
+    uint64_t relocated = 0;     //!< bytes moved by the defragmentation of the pools so far
+};
+
 struct RenderPassParams {
     RenderPassFlags flags{};    //!< operations performed on the buffers for this pass
 
@@ -879,6 +966,9 @@ struct RenderPassParams {
      * attachment (see MRT::TARGET_COUNT).
      */
     uint32_t subpassMask = 0;
+
+    //! Foveation of this pass, disabled by default
+    Foveation foveation{};
 };
 
 struct PolygonOffset {
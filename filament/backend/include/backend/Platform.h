@@ -23,6 +23,9 @@
 
 #include <utils/compiler.h>
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace filament {
 namespace backend {
 
@@ -66,6 +69,71 @@ public:
      * thread, or if the platform does not need to perform any special processing.
      */
     virtual bool pumpEvents() noexcept { return false; }
+
+    /**
+     * Callback used to store a blob of data identified by a key, e.g. a serialized pipeline cache
+     * or a program binary. The storage is entirely managed by the client, which is free to ignore
+     * the request.
+     *
+     * This is modeled after EGL_ANDROID_blob_cache.
+     */
+    using InsertBlobFunc = void(*)(const void* key, size_t keySize,
+            const void* value, size_t valueSize, void* user);
+
+    /**
+     * Callback used to retrieve a blob of data previously stored with InsertBlobFunc.
+     * If the blob exists and \p valueSize is large enough, the blob must be copied into \p value.
+     * In all cases the size of the stored blob must be returned, or 0 if no blob exists for the
+     * given key. This allows the caller to query the size first by passing a valueSize of 0.
+     */
+    using RetrieveBlobFunc = size_t(*)(const void* key, size_t keySize,
+            void* value, size_t valueSize, void* user);
+
+    /**
+     * Sets the callbacks used by the backend to persist data across runs of the application
+     * (e.g. Vulkan pipeline caches). This must be called before the Engine is created.
+     *
+     * @param insertBlob    Callback used to store a blob, can be nullptr.
+     * @param retrieveBlob  Callback used to retrieve a blob, can be nullptr.
+     * @param user          User pointer passed to both callbacks.
+     */
+    void setBlobFunc(InsertBlobFunc insertBlob, RetrieveBlobFunc retrieveBlob,
+            void* user = nullptr) noexcept;
+
+    /**
+     * @return true if both the insert and retrieve callbacks are set.
+     */
+    bool hasBlobFunc() const noexcept;
+
+    /**
+     * Stores a blob using the InsertBlobFunc callback if it is set, does nothing otherwise.
+     */
+    void insertBlob(const void* key, size_t keySize, const void* value, size_t valueSize) noexcept;
+
+    /**
+     * Retrieves a blob using the RetrieveBlobFunc callback if it is set.
+     * @return the size of the stored blob, or 0 if there is no such blob.
+     */
+    size_t retrieveBlob(const void* key, size_t keySize, void* value, size_t valueSize) noexcept;
+
+    /**
+     * Sets the number of frames the backend can record while the GPU still executes the
+     * previous ones, at least 2. The Engine sets it from Engine::Config::frameLatency before it
+     * creates the driver. Only the Vulkan backend uses it, to size its ring of command buffers.
+     */
+    void setFramesInFlight(uint32_t count) noexcept;
+
+    /**
+     * @return the number of frames the backend can record while the GPU executes the previous
+     *         ones.
+     */
+    uint32_t getFramesInFlight() const noexcept { return mFramesInFlight; }
+
+private:
+    InsertBlobFunc mInsertBlob = nullptr;
+    RetrieveBlobFunc mRetrieveBlob = nullptr;
+    void* mBlobUser = nullptr;
+    uint32_t mFramesInFlight = 2;
 };
 
 
@@ -38,6 +38,10 @@ public:
     //      to set it to 3*requiredSize to avoid blocking the render thread (usually the UI thread).
     explicit CircularBuffer(size_t bufferSize);
 
+    // Wraps 'size' bytes of memory owned by someone else, typically a region reserved in
+    // another CircularBuffer. Such a buffer is only written linearly and can't be circularized.
+    CircularBuffer(void* data, size_t size) noexcept;
+
     // can't be moved or copy-constructed
     CircularBuffer(CircularBuffer const& rhs) = delete;
     CircularBuffer(CircularBuffer&& rhs) noexcept = delete;
@@ -46,6 +50,10 @@ public:
 
     ~CircularBuffer() noexcept;
 
+    // Replaces the storage with a new one of 'bufferSize' bytes, the buffer must not be in use
+    // (i.e. no data recorded, and none being read by a consumer).
+    void resize(size_t bufferSize);
+
     // allocates 'size' bytes in the circular buffer and returns a pointer to the memory
     // return the current head and moves it forward by size bytes
     inline void* allocate(size_t size) noexcept {
@@ -35,9 +35,10 @@ class CommandBufferQueue {
     struct Slice {
         void* begin;
         void* end;
+        CommandBufferQueue* owner;  // the queue whose circular buffer holds the commands
     };
 
-    const size_t mRequiredSize;
+    size_t mRequiredSize;
 
     CircularBuffer mCircularBuffer;
 
@@ -59,8 +60,20 @@ public:
 
     CircularBuffer& getCircularBuffer() { return mCircularBuffer; }
 
+    // largest amount of memory in use in the circular buffer after a flush()
     size_t getHighWatermark() const noexcept { return mHighWatermark; }
 
+    // total size of the circular buffer
+    size_t getCapacity() const noexcept { return mCircularBuffer.size(); }
+
+    // space guaranteed available in the circular buffer after flush()
+    size_t getRequiredSize() const noexcept { return mRequiredSize; }
+
+    // Waits for all the commands flushed so far to be executed and replaces the circular buffer
+    // with a new one of bufferSize bytes. Must be called right after flush(), from the thread
+    // that produces the commands. The CircularBuffer object itself stays the same.
+    void resize(size_t requiredSize, size_t bufferSize);
+
     // wait for commands to be available and returns an array containing these commands
     std::vector<Slice> waitForCommands() const;
 
@@ -73,6 +86,13 @@ public:
     // call blocks until the CircularBuffer has at least mRequiredSize bytes available.
     void flush() noexcept;
 
+    // Same as flush(), but for the commands written to the circular buffer of producer, a queue
+    // used by another thread: they're returned by waitForCommands() of this queue, after the
+    // commands flushed so far and before the ones flushed afterwards, and their memory is
+    // returned to producer by releaseBuffer(). Can be called concurrently with flush(), but
+    // only from the thread that writes to producer.
+    void flush(CommandBufferQueue& producer) noexcept;
+
     // returns from waitForCommands() immediately.
     void requestExit();
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_COMMANDCAPTURE_H
+#define TNT_FILAMENT_BACKEND_COMMANDCAPTURE_H
+
+#include <backend/BufferDescriptor.h>
+#include <backend/Handle.h>
+#include <backend/PipelineState.h>
+#include <backend/PixelBufferDescriptor.h>
+#include <backend/TargetBufferInfo.h>
+
+#include "private/backend/Program.h"
+#include "private/backend/SamplerGroup.h"
+
+#include <utils/compiler.h>
+
+#include <memory>
+#include <type_traits>
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament {
+namespace backend {
+
+/*
+ * The asynchronous commands of the driver API, in the order of DriverAPI.inc. A capture can
+ * only be replayed by a build whose DriverAPI.inc declares the same commands.
+ */
+enum class CapturedCommand : uint16_t {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                     methodName,
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     methodName,
+#include "private/backend/DriverAPI.inc"
+};
+
+/*
+ * CommandCapture writes the commands executed by a Driver to a file, along with the contents
+ * of the buffers and images they upload, so they can be replayed offline (see
+ * tools/framereplay).
+ *
+ * The commands are recorded by the thread executing them, in the order they're executed, which
+ * includes the commands of the reserved regions and the CommandBundles, and the compact commands
+ * are recorded with all their arguments.
+ *
+ * The file starts with a Header, followed by the commands, each one made of its CapturedCommand
+ * and its arguments:
+ * - integers, enums and the trivially copyable structures are written as they are in memory,
+ * - handles are written as their id, and the handle created by a createXXX() command is its
+ *   first argument,
+ * - buffers are written as their uint64_t size followed by their contents, pixel buffers add
+ *   their layout,
+ * - strings are written as their uint32_t length followed by their characters,
+ * - the arrays of handles are written as their uint32_t count followed by the ids,
+ * - the callbacks and the native pointers aren't written.
+ * The layout of the structures depends on the platform, so a capture must be replayed on a
+ * platform with the same pointer size and endianness.
+ */
+class CommandCapture {
+public:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t sizeOfSizeT;
+    };
+
+    static constexpr char MAGIC[8] = { 'F', 'I', 'L', 'C', 'A', 'P', 'T', 'R' };
+    static constexpr uint32_t VERSION = 1;
+
+    // Returns nullptr if the file can't be created.
+    static std::unique_ptr<CommandCapture> create(const char* path) noexcept;
+
+    CommandCapture(CommandCapture const& rhs) = delete;
+    CommandCapture& operator=(CommandCapture const& rhs) = delete;
+
+    ~CommandCapture() noexcept;
+
+    template<typename... ARGS>
+    void record(CapturedCommand command, ARGS const& ... args) noexcept {
+        write(command);
+        (write(args), ...);
+    }
+
+    // createRenderPrimitives(), destroyRenderPrimitives() and destroyTextures()
+    template<typename T>
+    void record(CapturedCommand command, Handle<T> const* const& handles,
+            uint32_t const& count) noexcept {
+        write(command);
+        write(count);
+        for (uint32_t i = 0; i < count; i++) {
+            write(handles[i]);
+        }
+    }
+
+private:
+    explicit CommandCapture(FILE* file) noexcept : mFile(file) { }
+
+    void write(void const* data, size_t size) noexcept;
+
+    template<typename T>
+    void write(T const& value) noexcept {
+        static_assert(std::is_trivially_copyable<T>::value,
+                "this type needs its own CommandCapture::write()");
+        write(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void write(Handle<T> const& handle) noexcept {
+        write(handle.getId());
+    }
+
+    // callbacks and native objects can't be replayed
+    template<typename T>
+    void write(T* const&) noexcept {
+    }
+
+    void write(const char* string) noexcept;
+    void write(utils::CString const& string) noexcept;
+    void write(BufferDescriptor const& data) noexcept;
+    void write(PixelBufferDescriptor const& data) noexcept;
+    void write(FaceOffsets const& offsets) noexcept;
+    void write(Program const& program) noexcept;
+    void write(SamplerGroup const& samplerGroup) noexcept;
+    void write(PipelineState const& state) noexcept;
+    void write(TargetBufferInfo const& info) noexcept;
+    void write(MRT const& mrt) noexcept;
+
+    FILE* mFile;
+};
+
+} // namespace backend
+} // namespace filament
+
+#endif // TNT_FILAMENT_BACKEND_COMMANDCAPTURE_H
@@ -28,6 +28,7 @@
 #include <backend/PresentCallable.h>
 #include <backend/TargetBufferInfo.h>
 
+#include "private/backend/CommandCapture.h"
 #include "private/backend/DriverApi.h"
 #include "private/backend/Program.h"
 #include "private/backend/SamplerGroup.h"
@@ -41,6 +42,7 @@
 #include <utils/compiler.h>
 
 #include <functional>
+#include <limits>
 #include <tuple>
 #include <thread>
 #include <utility>
@@ -75,6 +77,9 @@ public:
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
 #define DECL_DRIVER_API(methodName, paramsDecl, params)                     Execute methodName##_;
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     Execute methodName##_;
+#define DECL_DRIVER_API_COMPACT(methodName, paramsDecl, params)                                 \
+    Execute methodName##_;                                                                      \
+    Execute methodName##Compact_;
 #include "DriverAPI.inc"
 };
 
@@ -169,6 +174,15 @@ struct CommandType<void (Driver::*)(ARGS...)> {
             self->~Command();
         }
 
+        // records the command to 'capture', must be called before executing it
+        static inline void capture(CommandCapture& capture, CapturedCommand command,
+                CommandBase* base) noexcept {
+            Command const* self = static_cast<Command const*>(base);
+            std::apply([&capture, command](auto const& ... args) {
+                capture.record(command, args...);
+            }, self->mArgs);
+        }
+
         // A command can be moved
         inline Command(Command&& rhs) noexcept = default;
 
@@ -190,6 +204,188 @@ struct CommandType<void (Driver::*)(ARGS...)> {
 
 // ------------------------------------------------------------------------------------------------
 
+/*
+ * draw() and bindUniformBufferRange() make up most of the stream, and mostly repeat the
+ * arguments of the previous call. CompactCommandType<> gives them two encodings:
+ * - Full, which stores all the arguments, and records them in the Driver's CompactCommandState
+ *   when it's executed,
+ * - Delta, which fits in the smallest command slot and only stores what changed, the other
+ *   arguments are read from the Driver's CompactCommandState.
+ * CommandStream records a Delta only when it recorded the Full command it refers to, and no
+ * command it didn't record (i.e. a reserved region or a replay) can be executed in between.
+ */
+template<>
+struct CompactCommandType<&Driver::draw> {
+    class Full : public CommandBase {
+        PipelineState mState;
+        Handle<HwRenderPrimitive> mRph;
+        uint32_t mInstanceCount;
+
+    public:
+        template<typename M, typename D>
+        static inline void execute(M&& method, D&& driver, CommandBase* base, intptr_t* next) noexcept {
+            Full* self = static_cast<Full*>(base);
+            *next = align(sizeof(Full));
+            CompactCommandState& state = getState(driver);
+            state.pipelineStateChanged = !isSame(state.pipelineState, self->mState);
+            state.pipelineState = self->mState;
+            DrawStatistics& statistics = getStatistics(driver);
+            statistics.drawCount++;
+            statistics.pipelineChangeCount += state.pipelineStateChanged;
+            if (UTILS_UNLIKELY(driver.getCommandCapture())) {
+                driver.getCommandCapture()->record(CapturedCommand::draw,
+                        self->mState, self->mRph, self->mInstanceCount);
+            }
+            (driver.*method)(self->mState, self->mRph, self->mInstanceCount);
+        }
+
+        inline Full(Execute execute, PipelineState const& state, Handle<HwRenderPrimitive> rph,
+                uint32_t instanceCount) noexcept
+                : CommandBase(execute), mState(state), mRph(rph), mInstanceCount(instanceCount) {
+        }
+
+        // placement new declared as "throw" to avoid the compiler's null-check
+        inline void* operator new(std::size_t size, void* ptr) {
+            assert(ptr);
+            return ptr;
+        }
+    };
+
+    // draws with the pipeline state of the previous draw
+    class Delta : public CommandBase {
+        Handle<HwRenderPrimitive> mRph;
+        uint32_t mInstanceCount;
+
+    public:
+        template<typename M, typename D>
+        static inline void execute(M&& method, D&& driver, CommandBase* base, intptr_t* next) noexcept {
+            Delta* self = static_cast<Delta*>(base);
+            *next = align(sizeof(Delta));
+            CompactCommandState& state = getState(driver);
+            state.pipelineStateChanged = false;
+            getStatistics(driver).drawCount++;
+            if (UTILS_UNLIKELY(driver.getCommandCapture())) {
+                driver.getCommandCapture()->record(CapturedCommand::draw,
+                        state.pipelineState, self->mRph, self->mInstanceCount);
+            }
+            (driver.*method)(state.pipelineState, self->mRph, self->mInstanceCount);
+        }
+
+        inline Delta(Execute execute, Handle<HwRenderPrimitive> rph,
+                uint32_t instanceCount) noexcept
+                : CommandBase(execute), mRph(rph), mInstanceCount(instanceCount) {
+        }
+
+        // placement new declared as "throw" to avoid the compiler's null-check
+        inline void* operator new(std::size_t size, void* ptr) {
+            assert(ptr);
+            return ptr;
+        }
+    };
+
+    static inline bool isSame(PipelineState const& lhs, PipelineState const& rhs) noexcept {
+        return lhs.program == rhs.program &&
+               lhs.rasterState.u == rhs.rasterState.u &&
+               lhs.polygonOffset.slope == rhs.polygonOffset.slope &&
+               lhs.polygonOffset.constant == rhs.polygonOffset.constant &&
+               lhs.scissor.left == rhs.scissor.left &&
+               lhs.scissor.bottom == rhs.scissor.bottom &&
+               lhs.scissor.width == rhs.scissor.width &&
+               lhs.scissor.height == rhs.scissor.height;
+    }
+
+private:
+    static inline CompactCommandState& getState(Driver& driver) noexcept {
+        return driver.mCompactCommandState;
+    }
+    static inline DrawStatistics& getStatistics(Driver& driver) noexcept {
+        return driver.mDrawStatistics;
+    }
+};
+
+template<>
+struct CompactCommandType<&Driver::bindUniformBufferRange> {
+    class Full : public CommandBase {
+        size_t mIndex;
+        Handle<HwUniformBuffer> mUbh;
+        size_t mOffset;
+        size_t mSize;
+
+    public:
+        template<typename M, typename D>
+        static inline void execute(M&& method, D&& driver, CommandBase* base, intptr_t* next) noexcept {
+            Full* self = static_cast<Full*>(base);
+            *next = align(sizeof(Full));
+            getStatistics(driver).uniformBufferBindCount++;
+            if (self->mIndex < CONFIG_UNIFORM_BINDING_COUNT) {
+                // the size is only used by a Delta when it fits in 32 bits
+                getState(driver).uniformBufferRanges[self->mIndex] =
+                        { self->mUbh, uint32_t(self->mSize) };
+            }
+            if (UTILS_UNLIKELY(driver.getCommandCapture())) {
+                driver.getCommandCapture()->record(CapturedCommand::bindUniformBufferRange,
+                        self->mIndex, self->mUbh, self->mOffset, self->mSize);
+            }
+            (driver.*method)(self->mIndex, self->mUbh, self->mOffset, self->mSize);
+        }
+
+        inline Full(Execute execute, size_t index, Handle<HwUniformBuffer> ubh,
+                size_t offset, size_t size) noexcept
+                : CommandBase(execute), mIndex(index), mUbh(ubh), mOffset(offset), mSize(size) {
+        }
+
+        // placement new declared as "throw" to avoid the compiler's null-check
+        inline void* operator new(std::size_t size, void* ptr) {
+            assert(ptr);
+            return ptr;
+        }
+    };
+
+    // binds another range of the buffer previously bound at the same index, with the same size
+    class Delta : public CommandBase {
+        uint32_t mOffset;
+        uint8_t mIndex;
+
+    public:
+        template<typename M, typename D>
+        static inline void execute(M&& method, D&& driver, CommandBase* base, intptr_t* next) noexcept {
+            Delta* self = static_cast<Delta*>(base);
+            *next = align(sizeof(Delta));
+            CompactCommandState::UniformBufferRange const& range =
+                    getState(driver).uniformBufferRanges[self->mIndex];
+            getStatistics(driver).uniformBufferBindCount++;
+            if (UTILS_UNLIKELY(driver.getCommandCapture())) {
+                driver.getCommandCapture()->record(CapturedCommand::bindUniformBufferRange,
+                        size_t(self->mIndex), range.ubh, size_t(self->mOffset), size_t(range.size));
+            }
+            (driver.*method)(self->mIndex, range.ubh, self->mOffset, range.size);
+        }
+
+        inline Delta(Execute execute, uint8_t index, uint32_t offset) noexcept
+                : CommandBase(execute), mOffset(offset), mIndex(index) {
+        }
+
+        // placement new declared as "throw" to avoid the compiler's null-check
+        inline void* operator new(std::size_t size, void* ptr) {
+            assert(ptr);
+            return ptr;
+        }
+    };
+
+private:
+    static inline CompactCommandState& getState(Driver& driver) noexcept {
+        return driver.mCompactCommandState;
+    }
+    static inline DrawStatistics& getStatistics(Driver& driver) noexcept {
+        return driver.mDrawStatistics;
+    }
+};
+
+// the compact encodings of a method of "class Driver"
+#define COMPACT_COMMAND_TYPE(method) CompactCommandType<&Driver::method>
+
+// ------------------------------------------------------------------------------------------------
+
 class CustomCommand : public CommandBase {
     std::function<void()> mCommand;
     static void execute(Driver&, CommandBase* base, intptr_t* next) noexcept;
@@ -213,6 +409,44 @@ public:
 
 // ------------------------------------------------------------------------------------------------
 
+/*
+ * A CommandBundle owns driver commands recorded once, which can then be replayed any number of
+ * times with CommandStream::replay().
+ *
+ * The commands are executed again from the same memory each time, so only the commands whose
+ * parameters are trivially copyable can be recorded, e.g. the commands used to draw
+ * (bindUniformBuffer, bindUniformBufferRange, bindSamplers, draw). The handles used by the
+ * commands must stay valid as long as the bundle is replayed.
+ *
+ * Recording works like CommandStream::reserve(): a secondary CommandStream records into a
+ * CircularBuffer wrapping the memory returned by allocate(), and is terminated with
+ * endReservedRegion().
+ */
+class CommandBundle {
+public:
+    CommandBundle() noexcept = default;
+    ~CommandBundle() noexcept;
+
+    CommandBundle(CommandBundle const& rhs) = delete;
+    CommandBundle& operator=(CommandBundle const& rhs) = delete;
+
+    // Allocates room for 'size' bytes of commands, the bundle must not be valid.
+    void* allocate(size_t size);
+
+    // true if the bundle holds commands that can be replayed
+    bool isValid() const noexcept { return mCommands != nullptr; }
+
+    // Frees the commands once the replays already queued in 'stream' are executed. This must
+    // be called before the bundle is destroyed, it can then be recorded again.
+    void invalidate(CommandStream& stream);
+
+private:
+    friend class CommandStream;
+    void* mCommands = nullptr;
+};
+
+// ------------------------------------------------------------------------------------------------
+
 #if defined(NDEBUG)
     #define DEBUG_COMMAND(methodName, ...)
 #else
@@ -247,12 +481,21 @@ public:
         return result;                                                                          \
     }
 
+#define DECL_DRIVER_API_COMPACT(methodName, paramsDecl, params)                                 \
+    inline void methodName(paramsDecl);
+
 #include "DriverAPI.inc"
 
 public:
     CommandStream() noexcept = default;
     CommandStream(Driver& driver, CircularBuffer& buffer) noexcept;
 
+    // Creates a stream using the same Driver as 'primary', but recording into 'buffer'.
+    // This is used with reserve() to record commands concurrently from several threads, in
+    // which case 'buffer' wraps a reserved region and only the Driver API commands used to
+    // draw (e.g. bindUniformBuffer, bindSamplers, draw) can be recorded.
+    CommandStream(CommandStream const& primary, CircularBuffer& buffer) noexcept;
+
     // This is for debugging only. Currently CircularBuffer can only be written from a
     // single thread. In debug builds we assert this condition.
     // Call this first in the render loop.
@@ -277,6 +520,30 @@ public:
      */
     inline void* allocate(size_t size, size_t alignment = 8) noexcept;
 
+    /*
+     * Reserves 'size' bytes in the stream, at the current position. The region can then be
+     * recorded into later, possibly from another thread, using a secondary CommandStream on a
+     * CircularBuffer wrapping the region. The recording of the region must be finished with
+     * endReservedRegion() before the stream is flushed.
+     */
+    inline void* reserve(size_t size) noexcept {
+        // the commands recorded in the region are executed before the ones that follow
+        invalidateCompactState();
+        return allocateCommand(CommandBase::align(size));
+    }
+
+    /*
+     * Terminates the recording of a secondary stream created on a region returned by reserve(),
+     * the unused space at the end of the region is skipped.
+     */
+    void endReservedRegion() noexcept;
+
+    /*
+     * Executes the commands of 'bundle' at this point of the stream. The bundle must not be
+     * invalidated before this command is executed, see CommandBundle::invalidate().
+     */
+    void replay(CommandBundle const& bundle) noexcept;
+
     /*
      * Helper to allocate an array of trivially destructible objects
      */
@@ -299,12 +566,66 @@ private:
 
     bool mUsePerformanceCounter = false;
 
+    // The arguments of the last draw() and bindUniformBufferRange() recorded, which the compact
+    // commands are encoded against. Only valid while this stream recorded all the commands that
+    // are executed since.
+    CompactCommandState mCompactState;
+    bool mPipelineStateValid = false;
+    uint8_t mUniformBufferRangesValid = 0;     // one bit per binding
+    static_assert(CONFIG_UNIFORM_BINDING_COUNT <= 8, "mUniformBufferRangesValid is too small");
+
     inline void* allocateCommand(size_t size) {
         assert(mThreadId == std::this_thread::get_id());
         return mCurrentBuffer->allocate(size);
     }
+
+    inline void invalidateCompactState() noexcept {
+        mPipelineStateValid = false;
+        mUniformBufferRangesValid = 0;
+    }
 };
 
+void CommandStream::draw(PipelineState state, RenderPrimitiveHandle rph, uint32_t instanceCount) {
+    DEBUG_COMMAND(draw, state, rph, instanceCount);
+    using Cmd = COMPACT_COMMAND_TYPE(draw);
+    if (mPipelineStateValid && Cmd::isSame(mCompactState.pipelineState, state)) {
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd::Delta)));
+        new(p) Cmd::Delta(mDispatcher->drawCompact_, rph, instanceCount);
+    } else {
+        mCompactState.pipelineState = state;
+        mPipelineStateValid = true;
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd::Full)));
+        new(p) Cmd::Full(mDispatcher->draw_, state, rph, instanceCount);
+    }
+}
+
+void CommandStream::bindUniformBufferRange(size_t index, UniformBufferHandle ubh,
+        size_t offset, size_t size) {
+    DEBUG_COMMAND(bindUniformBufferRange, index, ubh, offset, size);
+    using Cmd = COMPACT_COMMAND_TYPE(bindUniformBufferRange);
+    constexpr size_t MAX_32_BITS = std::numeric_limits<uint32_t>::max();
+    if (UTILS_UNLIKELY(index >= CONFIG_UNIFORM_BINDING_COUNT || size > MAX_32_BITS)) {
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd::Full)));
+        new(p) Cmd::Full(mDispatcher->bindUniformBufferRange_, index, ubh, offset, size);
+        if (index < CONFIG_UNIFORM_BINDING_COUNT) {
+            mUniformBufferRangesValid &= ~(1u << index);
+        }
+        return;
+    }
+    CompactCommandState::UniformBufferRange& range = mCompactState.uniformBufferRanges[index];
+    if ((mUniformBufferRangesValid & (1u << index)) &&
+            range.ubh == ubh && range.size == size && offset <= MAX_32_BITS) {
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd::Delta)));
+        new(p) Cmd::Delta(mDispatcher->bindUniformBufferRangeCompact_,
+                uint8_t(index), uint32_t(offset));
+    } else {
+        range = { ubh, uint32_t(size) };
+        mUniformBufferRangesValid |= 1u << index;
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd::Full)));
+        new(p) Cmd::Full(mDispatcher->bindUniformBufferRange_, index, ubh, offset, size);
+    }
+}
+
 void* CommandStream::allocate(size_t size, size_t alignment) noexcept {
     // make sure alignment is a power of two
     assert(alignment && !(alignment & alignment-1));
@@ -34,6 +34,8 @@
 #include <utils/Log.h>
 
 #include <functional>
+#include <memory>
+#include <mutex>
 
 #include <stdint.h>
 
@@ -43,6 +45,38 @@ namespace backend {
 template<typename T>
 class ConcreteDispatcher;
 class Dispatcher;
+class CommandCapture;
+template<auto METHOD>
+struct CompactCommandType;
+class Driver;
+template<auto METHOD>
+void trackCommand(Driver& driver) noexcept;
+
+/*
+ * The arguments of the last draw() and bindUniformBufferRange() commands, which the compact
+ * commands of the CommandStream only record the changes to.
+ */
+struct CompactCommandState {
+    struct UniformBufferRange {
+        Handle<HwUniformBuffer> ubh;
+        uint32_t size = 0;
+    };
+    PipelineState pipelineState;
+    UniformBufferRange uniformBufferRanges[CONFIG_UNIFORM_BINDING_COUNT];
+    // whether the pipeline state of the draw being executed differs from the previous draw's
+    bool pipelineStateChanged = true;
+};
+
+/*
+ * The number of state changes of the commands executed in a frame, to measure how well the
+ * draws are batched.
+ */
+struct DrawStatistics {
+    uint32_t drawCount = 0;
+    uint32_t pipelineChangeCount = 0;       // draws with another pipeline state than the previous
+    uint32_t uniformBufferBindCount = 0;    // bindUniformBuffer() and bindUniformBufferRange()
+    uint32_t samplerBindCount = 0;          // bindSamplers()
+};
 
 class Driver {
 public:
@@ -68,6 +102,17 @@ public:
     virtual void debugCommand(const char* methodName) {}
 #endif
 
+    // Returns the statistics of the last frame executed, this can be called from any thread.
+    DrawStatistics getDrawStatistics() const noexcept;
+
+    // Records the commands executed from now on to 'capture', or stops recording them if it's
+    // null. This must be called before the driver starts executing commands.
+    void setCommandCapture(std::unique_ptr<CommandCapture> capture) noexcept;
+
+    // The capture the executed commands are recorded to, if any. Only used by the thread
+    // executing the commands.
+    CommandCapture* getCommandCapture() const noexcept { return mCommandCapture.get(); }
+
     /*
      * Asynchronous calls here only to provide a type to CommandStream. They must be non-virtual
      * so that calling the concrete implementation won't go through a vtable.
@@ -86,6 +131,35 @@ public:
     void methodName##R(RetType, paramsDecl) {}
 
 #include "private/backend/DriverAPI.inc"
+
+protected:
+    // Whether the pipeline state given to the draw() being executed differs from the one given
+    // to the previous draw(), which lets the backends skip translating it again.
+    bool isPipelineStateChanged() const noexcept {
+        return mCompactCommandState.pipelineStateChanged;
+    }
+
+private:
+    template<auto METHOD>
+    friend struct CompactCommandType;
+
+    template<auto METHOD>
+    friend void trackCommand(Driver& driver) noexcept;
+
+    // called by the thread executing the commands at the end of each frame
+    void publishDrawStatistics() noexcept;
+
+    // the state the compact commands are decoded against, only accessed by the thread
+    // executing the commands
+    CompactCommandState mCompactCommandState;
+
+    // the statistics of the frame being executed, only accessed by the thread executing
+    // the commands, and of the last frame executed
+    DrawStatistics mDrawStatistics;
+    DrawStatistics mLastFrameDrawStatistics;
+    mutable std::mutex mDrawStatisticsLock;
+
+    std::unique_ptr<CommandCapture> mCommandCapture;
 };
 
 } // namespace backend
@@ -101,6 +175,7 @@ utils::io::ostream& operator<<(utils::io::ostream& out, const filament::backend:
 utils::io::ostream& operator<<(utils::io::ostream& out, const filament::backend::TargetBufferInfo& tbi);
 
 utils::io::ostream& operator<<(utils::io::ostream& out, filament::backend::BufferDescriptor const& b);
+utils::io::ostream& operator<<(utils::io::ostream& out, filament::backend::BufferObjectBinding binding);
 utils::io::ostream& operator<<(utils::io::ostream& out, filament::backend::BufferUsage usage);
 utils::io::ostream& operator<<(utils::io::ostream& out, filament::backend::CullingMode mode);
 utils::io::ostream& operator<<(utils::io::ostream& out, filament::backend::ElementType type);
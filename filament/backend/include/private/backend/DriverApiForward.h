@@ -21,6 +21,7 @@
 namespace filament {
 namespace backend {
 
+class CommandBundle;
 class CommandStream;
 
 using DriverApi = CommandStream;
@@ -24,6 +24,7 @@
 #include <backend/DriverEnums.h>
 
 #include <array>
+#include <variant>
 #include <vector>
 
 namespace filament {
@@ -32,13 +33,14 @@ namespace backend {
 class Program {
 public:
 
-    static constexpr size_t SHADER_TYPE_COUNT = 2;
+    static constexpr size_t SHADER_TYPE_COUNT = 3;
     static constexpr size_t UNIFORM_BINDING_COUNT = CONFIG_UNIFORM_BINDING_COUNT;
     static constexpr size_t SAMPLER_BINDING_COUNT = CONFIG_SAMPLER_BINDING_COUNT;
 
     enum class Shader : uint8_t {
         VERTEX = 0,
-        FRAGMENT = 1
+        FRAGMENT = 1,
+        COMPUTE = 2     // a compute program has only this shader
     };
 
     struct Sampler {
@@ -47,8 +49,14 @@ public:
         bool strict = false;        // if true, this sampler must always have a bound texture
     };
 
+    struct SpecializationConstant {
+        uint32_t id;                                // id of the constant in the shaders
+        std::variant<int32_t, float, bool> value;   // value of the constant
+    };
+
     using SamplerGroupInfo = std::array<std::vector<Sampler>, SAMPLER_BINDING_COUNT>;
     using UniformBlockInfo = std::array<utils::CString, UNIFORM_BINDING_COUNT>;
+    using SpecializationConstantsInfo = std::vector<SpecializationConstant>;
 
     Program() noexcept;
     Program(const Program& rhs) = delete;
@@ -78,6 +86,16 @@ public:
     // Or more precisely, what layout(binding=) is set to in GLSL.
     Program& setSamplerGroup(size_t bindingPoint, Sampler const* samplers, size_t count) noexcept;
 
+    // Allows the backend to skip draw calls using this program while it's still being compiled,
+    // instead of waiting for the compilation to complete. This is only honored by backends that
+    // support parallel shader compilation (see Driver::isParallelShaderCompileSupported()).
+    Program& nonBlocking(bool enable) noexcept;
+
+    // Sets the values of the specialization constants of the shaders (Vulkan), which are function
+    // constants in Metal. The OpenGL backend defines the SPIRV_CROSS_CONSTANT_ID_<id> macros that
+    // SPIRV-Cross emits for them instead. Constants that the shaders don't declare are ignored.
+    Program& specializationConstants(SpecializationConstantsInfo specConstants) noexcept;
+
     Program& withVertexShader(void const* data, size_t size) {
         return shader(Shader::VERTEX, data, size);
     }
@@ -86,6 +104,10 @@ public:
         return shader(Shader::FRAGMENT, data, size);
     }
 
+    Program& withComputeShader(void const* data, size_t size) {
+        return shader(Shader::COMPUTE, data, size);
+    }
+
     std::array<std::vector<uint8_t>, SHADER_TYPE_COUNT> const& getShadersSource() const noexcept {
         return mShadersSource;
     }
@@ -100,6 +122,12 @@ public:
 
     bool hasSamplers() const noexcept { return mHasSamplers; }
 
+    bool isNonBlocking() const noexcept { return mNonBlocking; }
+
+    SpecializationConstantsInfo const& getSpecializationConstants() const noexcept {
+        return mSpecializationConstants;
+    }
+
 private:
 #if !defined(NDEBUG)
     friend utils::io::ostream& operator<< (utils::io::ostream& out, const Program& builder);
@@ -109,8 +137,10 @@ private:
     UniformBlockInfo mUniformBlocks = {};
     SamplerGroupInfo mSamplerGroups = {};
     std::array<std::vector<uint8_t>, SHADER_TYPE_COUNT> mShadersSource;
+    SpecializationConstantsInfo mSpecializationConstants;
     utils::CString mName;
     bool mHasSamplers = false;
+    bool mNonBlocking = false;
     uint8_t mVariant;
 };
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_UNIFORMBUFFERUPDATE_H
+#define TNT_FILAMENT_BACKEND_UNIFORMBUFFERUPDATE_H
+
+#include <backend/Handle.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace backend {
+
+// The data of Driver::updateUniformBuffers() is a sequence of these headers, each one followed by
+// the new content of the range it updates, padded to a multiple of 4 bytes.
+struct UniformBufferUpdate {
+    Handle<HwUniformBuffer> ubh;
+    uint32_t byteOffset = 0;    // offset of the range in the uniform buffer
+    uint32_t byteSize = 0;      // size of the range
+
+    // size of an update of 'byteSize' bytes in the data of updateUniformBuffers()
+    static constexpr size_t getStorageSize(size_t byteSize) noexcept {
+        return sizeof(UniformBufferUpdate) + ((byteSize + 3u) & ~size_t(3u));
+    }
+
+    void* getData() noexcept { return this + 1; }
+    void const* getData() const noexcept { return this + 1; }
+
+    UniformBufferUpdate const* next() const noexcept {
+        return reinterpret_cast<UniformBufferUpdate const*>(
+                reinterpret_cast<char const*>(this) + getStorageSize(byteSize));
+    }
+};
+
+static_assert(sizeof(UniformBufferUpdate) % 4 == 0,
+        "the data of the updates must stay aligned to 4 bytes");
+
+} // namespace backend
+} // namespace filament
+
+#endif // TNT_FILAMENT_BACKEND_UNIFORMBUFFERUPDATE_H
@@ -202,6 +202,10 @@ size_t getFormatSize(TextureFormat format) noexcept {
         case TextureFormat::SRGB8_ALPHA8_ASTC_12x12:
             return 16;
 
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT:
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT:
+            return 16;
+
         default:
             return 0;
     }
@@ -231,6 +235,10 @@ size_t getBlockWidth(TextureFormat format) noexcept {
         case TextureFormat::DXT5_SRGBA:
             return 4;
 
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT:
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT:
+            return 4;
+
         case TextureFormat::RGBA_ASTC_4x4:
         case TextureFormat::SRGB8_ALPHA8_ASTC_4x4:
             return 4;
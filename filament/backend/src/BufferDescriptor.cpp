@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <backend/BufferDescriptor.h>
+
+namespace filament {
+namespace backend {
+
+void BufferDescriptor::postCallback() noexcept {
+    // the handler gets a BufferDescriptor without handler, whose destruction calls the callback
+    CallbackHandler* const handler = this->handler;
+    BufferDescriptor* const descriptor = new BufferDescriptor(buffer, size, callback, user);
+    callback = nullptr;
+    handler->post(descriptor, [](void* user) {
+        delete static_cast<BufferDescriptor*>(user);
+    });
+}
+
+} // namespace backend
+} // namespace filament
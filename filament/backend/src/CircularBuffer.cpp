@@ -42,10 +42,27 @@ CircularBuffer::CircularBuffer(size_t size) {
     mHead = mData;
 }
 
+CircularBuffer::CircularBuffer(void* data, size_t size) noexcept {
+    // mData stays null, we don't own the memory
+    mSize = size;
+    mTail = data;
+    mHead = data;
+}
+
 CircularBuffer::~CircularBuffer() noexcept {
     dealloc();
 }
 
+void CircularBuffer::resize(size_t size) {
+    assert(mData);
+    assert(empty());
+    dealloc();
+    mData = alloc(size);
+    mSize = size;
+    mTail = mData;
+    mHead = mData;
+}
+
 // If the system support mmap(), use it for creating a "hard circular buffer" where two virtual
 // address ranges are mapped to the same physical pages.
 //
@@ -143,6 +160,7 @@ void CircularBuffer::dealloc() noexcept {
 
 
 void CircularBuffer::circularize() noexcept {
+    assert(mData);
     if (mUsesAshmem > 0) {
         intptr_t overflow = intptr_t(mHead) - (intptr_t(mData) + ssize_t(mSize));
         if (overflow >= 0) {
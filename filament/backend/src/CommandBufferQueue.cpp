@@ -78,7 +78,7 @@ void CommandBufferQueue::flush() noexcept {
     circularBuffer.circularize();
 
     std::unique_lock<utils::Mutex> lock(mLock);
-    mCommandBuffersToExecute.push_back({ tail, head });
+    mCommandBuffersToExecute.push_back({ tail, head, this });
 
     // circular buffer is too small, we corrupted the stream
     assert(used <= mFreeSpace);
@@ -87,9 +87,11 @@ void CommandBufferQueue::flush() noexcept {
     mFreeSpace -= used;
     const size_t requiredSize = mRequiredSize;
 
-#ifndef NDEBUG
     size_t totalUsed = circularBuffer.size() - mFreeSpace;
     mHighWatermark = std::max(mHighWatermark, totalUsed);
+    SYSTRACE_VALUE32("commandBufferUsage", totalUsed);
+
+#ifndef NDEBUG
     if (UTILS_UNLIKELY(totalUsed > requiredSize)) {
         slog.d << "CommandStream used too much space: " << totalUsed
             << ", out of " << requiredSize << " (will block)" << io::endl;
@@ -111,6 +113,62 @@ void CommandBufferQueue::flush() noexcept {
     }
 }
 
+void CommandBufferQueue::flush(CommandBufferQueue& producer) noexcept {
+    SYSTRACE_CALL();
+
+    CircularBuffer& circularBuffer = producer.mCircularBuffer;
+    if (circularBuffer.empty()) {
+        return;
+    }
+
+    new(circularBuffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+    void* const head = circularBuffer.getHead();
+    void* const tail = circularBuffer.getTail();
+    uint32_t used = uint32_t(intptr_t(head) - intptr_t(tail));
+    circularBuffer.circularize();
+
+    // the commands must be visible to the consumer before we wait for the producer's memory,
+    // which they may be holding
+    std::unique_lock<utils::Mutex> lock(mLock);
+    mCommandBuffersToExecute.push_back({ tail, head, &producer });
+    lock.unlock();
+    mCondition.notify_one();
+
+    std::unique_lock<utils::Mutex> producerLock(producer.mLock);
+    assert(used <= producer.mFreeSpace);
+    producer.mFreeSpace -= used;
+    const size_t requiredSize = producer.mRequiredSize;
+    producer.mHighWatermark = std::max(producer.mHighWatermark,
+            circularBuffer.size() - producer.mFreeSpace);
+    if (UTILS_UNLIKELY(producer.mFreeSpace < requiredSize)) {
+        SYSTRACE_NAME("waiting: CircularBuffer::flush()");
+        producer.mCondition.wait(producerLock, [&producer, requiredSize]() -> bool {
+            return producer.mFreeSpace >= requiredSize;
+        });
+    }
+}
+
+void CommandBufferQueue::resize(size_t requiredSize, size_t bufferSize) {
+    SYSTRACE_CALL();
+
+    CircularBuffer& circularBuffer = mCircularBuffer;
+    assert(circularBuffer.empty());
+    assert(bufferSize > requiredSize);
+
+    // all the memory must be back before we can release it
+    std::unique_lock<utils::Mutex> lock(mLock);
+    mCondition.wait(lock, [this, &circularBuffer]() -> bool {
+        return mFreeSpace == circularBuffer.size() || mExitRequested;
+    });
+    if (UTILS_UNLIKELY(mExitRequested)) {
+        return;
+    }
+
+    circularBuffer.resize(bufferSize);
+    mRequiredSize = (requiredSize + CircularBuffer::BLOCK_MASK) & ~CircularBuffer::BLOCK_MASK;
+    mFreeSpace = circularBuffer.size();
+}
+
 std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() const {
     if (!UTILS_HAS_THREADING) {
         return std::move(mCommandBuffersToExecute);
@@ -127,6 +185,10 @@ std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() con
 }
 
 void CommandBufferQueue::releaseBuffer(CommandBufferQueue::Slice const& buffer) {
+    if (UTILS_UNLIKELY(buffer.owner != this)) {
+        buffer.owner->releaseBuffer(buffer);
+        return;
+    }
     std::unique_lock<utils::Mutex> lock(mLock);
     mFreeSpace += uintptr_t(buffer.end) - uintptr_t(buffer.begin);
     lock.unlock();
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CommandCapture.h"
+
+#include <utils/Log.h>
+
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+namespace backend {
+
+std::unique_ptr<CommandCapture> CommandCapture::create(const char* path) noexcept {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        slog.e << "CommandCapture: couldn't create " << path << io::endl;
+        return nullptr;
+    }
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sizeOfSizeT = sizeof(size_t);
+    fwrite(&header, sizeof(header), 1, file);
+    slog.i << "CommandCapture: recording the driver commands to " << path << io::endl;
+    return std::unique_ptr<CommandCapture>(new CommandCapture(file));
+}
+
+CommandCapture::~CommandCapture() noexcept {
+    fclose(mFile);
+}
+
+void CommandCapture::write(void const* data, size_t size) noexcept {
+    if (size) {
+        fwrite(data, size, 1, mFile);
+    }
+}
+
+void CommandCapture::write(const char* string) noexcept {
+    const uint32_t length = string ? uint32_t(strlen(string)) : 0;
+    write(length);
+    write(string, length);
+}
+
+void CommandCapture::write(CString const& string) noexcept {
+    const uint32_t length = uint32_t(string.size());
+    write(length);
+    write(string.c_str(), length);
+}
+
+void CommandCapture::write(BufferDescriptor const& data) noexcept {
+    const uint64_t size = data.buffer ? data.size : 0;
+    write(size);
+    write(data.buffer, size);
+}
+
+void CommandCapture::write(PixelBufferDescriptor const& data) noexcept {
+    write(static_cast<BufferDescriptor const&>(data));
+    write(data.left);
+    write(data.top);
+    write(PixelDataType(data.type));
+    write(uint8_t(data.alignment));
+    if (data.type == PixelDataType::COMPRESSED) {
+        write(data.imageSize);
+        write(data.compressedFormat);
+    } else {
+        write(data.stride);
+        write(data.format);
+    }
+}
+
+void CommandCapture::write(FaceOffsets const& offsets) noexcept {
+    write(offsets.offsets, sizeof(offsets.offsets));
+}
+
+void CommandCapture::write(Program const& program) noexcept {
+    write(program.getName());
+    write(program.getVariant());
+    for (auto const& source : program.getShadersSource()) {
+        write(uint64_t(source.size()));
+        write(source.data(), source.size());
+    }
+    for (auto const& name : program.getUniformBlockInfo()) {
+        write(name);
+    }
+    for (auto const& samplers : program.getSamplerGroupInfo()) {
+        write(uint32_t(samplers.size()));
+        for (auto const& sampler : samplers) {
+            write(sampler.name);
+            write(sampler.binding);
+            write(sampler.strict);
+        }
+    }
+    auto const& constants = program.getSpecializationConstants();
+    write(uint32_t(constants.size()));
+    for (auto const& constant : constants) {
+        write(constant.id);
+        write(uint8_t(constant.value.index()));
+        if (auto const* i = std::get_if<int32_t>(&constant.value)) {
+            write(*i);
+        } else if (auto const* f = std::get_if<float>(&constant.value)) {
+            write(*f);
+        } else {
+            write(std::get<bool>(constant.value));
+        }
+    }
+    write(program.isNonBlocking());
+}
+
+void CommandCapture::write(SamplerGroup const& samplerGroup) noexcept {
+    const uint32_t size = uint32_t(samplerGroup.getSize());
+    SamplerGroup::Sampler const* const samplers = samplerGroup.getSamplers();
+    write(size);
+    for (uint32_t i = 0; i < size; i++) {
+        write(samplers[i].t);
+        write(samplers[i].s);
+    }
+}
+
+void CommandCapture::write(PipelineState const& state) noexcept {
+    write(state.program);
+    write(state.rasterState);
+    write(state.polygonOffset);
+    write(state.scissor);
+}
+
+void CommandCapture::write(TargetBufferInfo const& info) noexcept {
+    write(info.handle);
+    write(info.level);
+    write(info.layer);
+}
+
+void CommandCapture::write(MRT const& mrt) noexcept {
+    for (size_t i = 0; i < MRT::TARGET_COUNT; i++) {
+        write(mrt[i]);
+    }
+}
+
+} // namespace backend
+} // namespace filament
@@ -18,11 +18,14 @@
 
 #include <utils/CallStack.h>
 #include <utils/Log.h>
+#include <utils/Panic.h>
 #include <utils/Profiler.h>
 #include <utils/Systrace.h>
 
 #include <functional>
 
+#include <stdlib.h>
+
 #ifdef ANDROID
 #include <sys/system_properties.h>
 #endif
@@ -69,6 +72,67 @@ CommandStream::CommandStream(Driver& driver, CircularBuffer& buffer) noexcept
     __system_property_get("filament.perfcounters", property);
     mUsePerformanceCounter = bool(atoi(property));
 #endif
+
+    // the commands are recorded from the start, so that the capture creates all the objects
+    // the frames use
+    const char* capturePath = getenv("FILAMENT_COMMAND_CAPTURE");
+#ifdef ANDROID
+    char captureProperty[PROP_VALUE_MAX];
+    if (__system_property_get("filament.capture", captureProperty) > 0) {
+        capturePath = captureProperty;
+    }
+#endif
+    if (UTILS_UNLIKELY(capturePath && *capturePath)) {
+        driver.setCommandCapture(CommandCapture::create(capturePath));
+    }
+}
+
+CommandStream::CommandStream(CommandStream const& primary, CircularBuffer& buffer) noexcept
+        : mDispatcher(primary.mDispatcher),
+          mDriver(primary.mDriver),
+          mCurrentBuffer(&buffer)
+#ifndef NDEBUG
+          , mThreadId(std::this_thread::get_id())
+#endif
+          , mUsePerformanceCounter(primary.mUsePerformanceCounter) {
+}
+
+void CommandStream::endReservedRegion() noexcept {
+    char* const head = static_cast<char*>(mCurrentBuffer->getHead());
+    char* const end = static_cast<char*>(mCurrentBuffer->getTail()) + mCurrentBuffer->size();
+    // the region is too small, we corrupted the stream
+    assert(head <= end);
+    // all commands are aligned, so there is always room for a NoopCommand if there is any
+    if (head < end) {
+        new(mCurrentBuffer->allocate(sizeof(NoopCommand))) NoopCommand(end);
+    }
+}
+
+namespace {
+
+// executes the commands of a CommandBundle, which end with a NoopCommand(nullptr)
+class ReplayCommand : public CommandBase {
+    CommandBase* mCommands;
+    static void execute(Driver& driver, CommandBase* base, intptr_t* next) noexcept {
+        *next = align(sizeof(ReplayCommand));
+        CommandBase* UTILS_RESTRICT command = static_cast<ReplayCommand*>(base)->mCommands;
+        while (UTILS_LIKELY(command)) {
+            command = command->execute(driver);
+        }
+    }
+public:
+    inline explicit ReplayCommand(void* commands) noexcept
+            : CommandBase(execute), mCommands(static_cast<CommandBase*>(commands)) { }
+};
+
+} // anonymous namespace
+
+void CommandStream::replay(CommandBundle const& bundle) noexcept {
+    assert(bundle.isValid());
+    // the bundle changes the state the compact commands are decoded against
+    invalidateCompactState();
+    new(allocateCommand(CommandBase::align(sizeof(ReplayCommand)))) ReplayCommand(
+            bundle.mCommands);
 }
 
 void CommandStream::execute(void* buffer) {
@@ -146,6 +210,31 @@ void CommandType<void (Driver::*)(ARGS...)>::Command<METHOD>::log() noexcept  {
 
 // ------------------------------------------------------------------------------------------------
 
+CommandBundle::~CommandBundle() noexcept {
+    // invalidate() must have been called
+    assert(!mCommands);
+}
+
+void* CommandBundle::allocate(size_t size) {
+    assert(!mCommands);
+    // the commands are followed by the NoopCommand that terminates the replays
+    size = CommandBase::align(size);
+    mCommands = ::malloc(size + CommandBase::align(sizeof(NoopCommand)));
+    ASSERT_POSTCONDITION(mCommands, "couldn't allocate %u bytes for a CommandBundle",
+            unsigned(size));
+    new(static_cast<char*>(mCommands) + size) NoopCommand(nullptr);
+    return mCommands;
+}
+
+void CommandBundle::invalidate(CommandStream& stream) {
+    void* const commands = mCommands;
+    mCommands = nullptr;
+    if (commands) {
+        // the driver might not have executed all the replays yet
+        stream.queueCommand([commands]() { ::free(commands); });
+    }
+}
+
 void CustomCommand::execute(Driver&, CommandBase* base, intptr_t* next) noexcept {
     *next = CustomCommand::align(sizeof(CustomCommand));
     static_cast<CustomCommand*>(base)->mCommand();
@@ -232,6 +321,14 @@ io::ostream& operator<<(io::ostream& out, BufferUsage usage) {
     return out;
 }
 
+io::ostream& operator<<(io::ostream& out, BufferObjectBinding binding) {
+    switch (binding) {
+        CASE(BufferObjectBinding, UNIFORM)
+        CASE(BufferObjectBinding, SHADER_STORAGE)
+    }
+    return out;
+}
+
 io::ostream& operator<<(io::ostream& out, CullingMode mode) {
     switch (mode) {
         CASE(CullingMode, NONE)
@@ -412,6 +509,8 @@ io::ostream& operator<<(io::ostream& out, TextureFormat format) {
         CASE(TextureFormat, SRGB8_ALPHA8_ASTC_10x10)
         CASE(TextureFormat, SRGB8_ALPHA8_ASTC_12x10)
         CASE(TextureFormat, SRGB8_ALPHA8_ASTC_12x12)
+        CASE(TextureFormat, RGB_BPTC_SIGNED_FLOAT)
+        CASE(TextureFormat, RGB_BPTC_UNSIGNED_FLOAT)
     }
     return out;
 }
@@ -46,6 +46,27 @@
 namespace filament {
 namespace backend {
 
+// Called before a command is executed, updates the DrawStatistics of the commands it tracks
+// (the compact commands track themselves).
+template<auto METHOD>
+inline void trackCommand(Driver&) noexcept {
+}
+
+template<>
+inline void trackCommand<&Driver::bindUniformBuffer>(Driver& driver) noexcept {
+    driver.mDrawStatistics.uniformBufferBindCount++;
+}
+
+template<>
+inline void trackCommand<&Driver::bindSamplers>(Driver& driver) noexcept {
+    driver.mDrawStatistics.samplerBindCount++;
+}
+
+template<>
+inline void trackCommand<&Driver::endFrame>(Driver& driver) noexcept {
+    driver.publishDrawStatistics();
+}
+
 template<typename ConcreteDriver>
 class ConcreteDispatcher final : public Dispatcher {
 public:
@@ -54,6 +75,9 @@ public:
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
 #define DECL_DRIVER_API(methodName, paramsDecl, params)                 methodName##_ = &ConcreteDispatcher::methodName;
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) methodName##_ = &ConcreteDispatcher::methodName;
+#define DECL_DRIVER_API_COMPACT(methodName, paramsDecl, params)                                 \
+        methodName##_ = &ConcreteDispatcher::methodName;                                        \
+        methodName##Compact_ = &ConcreteDispatcher::methodName##Compact;
 #include "private/backend/DriverAPI.inc"
     }
 private:
@@ -63,6 +87,10 @@ private:
         SYSTRACE()                                                                              \
         using Cmd = COMMAND_TYPE(methodName);                                                   \
         ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);                  \
+        trackCommand<&Driver::methodName>(driver);                                              \
+        if (UTILS_UNLIKELY(driver.getCommandCapture())) {                                       \
+            Cmd::capture(*driver.getCommandCapture(), CapturedCommand::methodName, base);       \
+        }                                                                                       \
         Cmd::execute(&ConcreteDriver::methodName, concreteDriver, base, next);                  \
      }
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
@@ -70,8 +98,24 @@ private:
         SYSTRACE()                                                                              \
         using Cmd = COMMAND_TYPE(methodName##R);                                                \
         ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);                  \
+        if (UTILS_UNLIKELY(driver.getCommandCapture())) {                                       \
+            Cmd::capture(*driver.getCommandCapture(), CapturedCommand::methodName, base);       \
+        }                                                                                       \
         Cmd::execute(&ConcreteDriver::methodName##R, concreteDriver, base, next);               \
      }
+#define DECL_DRIVER_API_COMPACT(methodName, paramsDecl, params)                                 \
+    static void methodName(Driver& driver, CommandBase* base, intptr_t* next) {                 \
+        SYSTRACE()                                                                              \
+        using Cmd = COMPACT_COMMAND_TYPE(methodName);                                           \
+        ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);                  \
+        Cmd::Full::execute(&ConcreteDriver::methodName, concreteDriver, base, next);            \
+     }                                                                                          \
+    static void methodName##Compact(Driver& driver, CommandBase* base, intptr_t* next) {        \
+        SYSTRACE()                                                                              \
+        using Cmd = COMPACT_COMMAND_TYPE(methodName);                                           \
+        ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);                  \
+        Cmd::Delta::execute(&ConcreteDriver::methodName, concreteDriver, base, next);           \
+     }
 #include "private/backend/DriverAPI.inc"
 };
 
@@ -15,6 +15,7 @@
  */
 
 #include "private/backend/Driver.h"
+#include "private/backend/CommandCapture.h"
 #include "private/backend/CommandStream.h"
 
 #include "DriverBase.h"
@@ -26,8 +27,13 @@
 #include <math/vec4.h>
 
 #include <backend/BufferDescriptor.h>
+#include <backend/CallbackHandler.h>
 #include <backend/PixelBufferDescriptor.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 using namespace utils;
 
 namespace filament {
@@ -51,7 +57,29 @@ void DriverBase::purge() noexcept {
     for (auto& image : imagesToPurge) {
         image.callback(image.image, image.userData);
     }
-    // When the BufferDescriptors go out of scope, their destructors invoke their callbacks.
+
+    // The buffers released by a CallbackHandler are handed to it in one batch per handler,
+    // the others are released when they go out of scope.
+    using Batch = std::vector<BufferDescriptor>;
+    std::vector<std::pair<CallbackHandler*, Batch*>> batches;
+    for (auto& buffer : buffersToPurge) {
+        CallbackHandler* const handler = buffer.getHandler();
+        if (handler) {
+            auto pos = std::find_if(batches.begin(), batches.end(),
+                    [handler](auto const& batch) { return batch.first == handler; });
+            if (pos == batches.end()) {
+                pos = batches.emplace(batches.end(), handler, new Batch());
+            }
+            // without its handler, the destructor invokes the callback on the handler's thread
+            buffer.setCallback(buffer.getCallback(), buffer.getUser());
+            pos->second->push_back(std::move(buffer));
+        }
+    }
+    for (auto const& batch : batches) {
+        batch.first->post(batch.second, [](void* user) {
+            delete static_cast<Batch*>(user);
+        });
+    }
 }
 
 void DriverBase::scheduleDestroySlow(BufferDescriptor&& buffer) noexcept {
@@ -74,6 +102,21 @@ void Driver::execute(std::function<void(void)> fn) noexcept {
     fn();
 }
 
+DrawStatistics Driver::getDrawStatistics() const noexcept {
+    std::lock_guard<std::mutex> lock(mDrawStatisticsLock);
+    return mLastFrameDrawStatistics;
+}
+
+void Driver::setCommandCapture(std::unique_ptr<CommandCapture> capture) noexcept {
+    mCommandCapture = std::move(capture);
+}
+
+void Driver::publishDrawStatistics() noexcept {
+    std::lock_guard<std::mutex> lock(mDrawStatisticsLock);
+    mLastFrameDrawStatistics = mDrawStatistics;
+    mDrawStatistics = {};
+}
+
 size_t Driver::getElementTypeSize(ElementType type) noexcept {
     switch (type) {
         case ElementType::BYTE:     return sizeof(int8_t);
@@ -106,6 +106,16 @@ struct HwSamplerGroup : public HwBase {
 struct HwUniformBuffer : public HwBase {
 };
 
+struct HwBufferObject : public HwBase {
+    uint32_t byteCount{};
+    BufferObjectBinding bindingType{};
+
+    HwBufferObject() noexcept = default;
+    HwBufferObject(uint32_t byteCount, BufferObjectBinding bindingType) noexcept :
+            byteCount(byteCount), bindingType(bindingType) {
+    }
+};
+
 struct HwTexture : public HwBase {
     uint32_t width{};
     uint32_t height{};
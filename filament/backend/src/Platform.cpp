@@ -18,6 +18,8 @@
 
 #include <utils/Systrace.h>
 
+#include <algorithm>
+
 #if defined(ANDROID)
     #ifndef FILAMENT_USE_EXTERNAL_GLES3
         #include "opengl/PlatformEGLAndroid.h"
@@ -73,6 +75,36 @@ namespace backend {
 // this generates the vtable in this translation unit
 Platform::~Platform() noexcept = default;
 
+void Platform::setBlobFunc(InsertBlobFunc insertBlob, RetrieveBlobFunc retrieveBlob,
+        void* user) noexcept {
+    mInsertBlob = insertBlob;
+    mRetrieveBlob = retrieveBlob;
+    mBlobUser = user;
+}
+
+void Platform::setFramesInFlight(uint32_t count) noexcept {
+    mFramesInFlight = std::max(count, 2u);
+}
+
+bool Platform::hasBlobFunc() const noexcept {
+    return mInsertBlob && mRetrieveBlob;
+}
+
+void Platform::insertBlob(const void* key, size_t keySize,
+        const void* value, size_t valueSize) noexcept {
+    if (mInsertBlob) {
+        mInsertBlob(key, keySize, value, valueSize, mBlobUser);
+    }
+}
+
+size_t Platform::retrieveBlob(const void* key, size_t keySize,
+        void* value, size_t valueSize) noexcept {
+    if (mRetrieveBlob) {
+        return mRetrieveBlob(key, keySize, value, valueSize, mBlobUser);
+    }
+    return 0;
+}
+
 // Creates the platform-specific Platform object. The caller takes ownership and is
 // responsible for destroying it. Initialization of the backend API is deferred until
 // createDriver(). The passed-in backend hint is replaced with the resolved backend.
@@ -60,6 +60,15 @@ Program& Program::setSamplerGroup(size_t bindingPoint,
     return *this;
 }
 
+Program& Program::nonBlocking(bool enable) noexcept {
+    mNonBlocking = enable;
+    return *this;
+}
+
+Program& Program::specializationConstants(SpecializationConstantsInfo specConstants) noexcept {
+    mSpecializationConstants = std::move(specConstants);
+    return *this;
+}
 
 #if !defined(NDEBUG)
 io::ostream& operator<<(io::ostream& out, const Program& builder) {
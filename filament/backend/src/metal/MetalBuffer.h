@@ -43,6 +43,12 @@ public:
      */
     void copyIntoBuffer(void* src, size_t size);
 
+    /**
+     * Update 'size' bytes of the buffer at 'byteOffset' with data inside src, the rest of the
+     * content is kept.
+     */
+    void copyIntoBuffer(void const* src, size_t size, size_t byteOffset);
+
     /**
      * Denotes that this buffer is used for a draw call ensuring that its allocation remains valid
      * until the end of the current frame.
@@ -18,6 +18,8 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+
 namespace filament {
 namespace backend {
 namespace metal {
@@ -67,6 +69,31 @@ void MetalBuffer::copyIntoBuffer(void* src, size_t size) {
     memcpy(static_cast<uint8_t*>(mBufferPoolEntry->buffer.contents), src, size);
 }
 
+void MetalBuffer::copyIntoBuffer(void const* src, size_t size, size_t byteOffset) {
+    if (size <= 0) {
+        return;
+    }
+    ASSERT_PRECONDITION(byteOffset + size <= mBufferSize,
+            "Attempting to copy %d bytes at offset %d into a buffer of size %d",
+            size, byteOffset, mBufferSize);
+
+    if (mCpuBuffer) {
+        memcpy(static_cast<uint8_t*>(mCpuBuffer) + byteOffset, src, size);
+        return;
+    }
+
+    // The current buffer may still be used by the GPU, so the new contents go to a new buffer,
+    // which starts as a copy of the current one.
+    const MetalBufferPoolEntry* previous = mBufferPoolEntry;
+    mBufferPoolEntry = mContext.bufferPool->acquireBuffer(mBufferSize);
+    uint8_t* contents = static_cast<uint8_t*>(mBufferPoolEntry->buffer.contents);
+    if (previous) {
+        memcpy(contents, previous->buffer.contents, mBufferSize);
+        mContext.bufferPool->releaseBuffer(previous);
+    }
+    memcpy(contents + byteOffset, src, size);
+}
+
 id<MTLBuffer> MetalBuffer::getGpuBufferForDraw(id<MTLCommandBuffer> cmdBuffer) noexcept {
     if (!mBufferPoolEntry) {
         // If there's a CPU buffer, then we return nil here, as the CPU-side buffer will be bound
@@ -100,8 +127,12 @@ void MetalBuffer::bindBuffers(id<MTLCommandBuffer> cmdBuffer, id<MTLRenderComman
         size_t count) {
     const NSRange bufferRange = NSMakeRange(bufferStart, count);
 
-    std::vector<id<MTLBuffer>> metalBuffers(count, nil);
-    std::vector<size_t> metalOffsets(count, 0);
+    // this is called several times per draw, so avoid heap allocations
+    constexpr size_t MAX_BUFFER_COUNT =
+            std::max(size_t(Program::UNIFORM_BINDING_COUNT), size_t(MAX_VERTEX_ATTRIBUTE_COUNT));
+    assert(count <= MAX_BUFFER_COUNT);
+    id<MTLBuffer> metalBuffers[MAX_BUFFER_COUNT] = {};
+    size_t metalOffsets[MAX_BUFFER_COUNT] = {};
 
     for (size_t b = 0; b < count; b++) {
         MetalBuffer* const buffer = buffers[b];
@@ -119,13 +150,13 @@ void MetalBuffer::bindBuffers(id<MTLCommandBuffer> cmdBuffer, id<MTLRenderComman
     }
 
     if (stages & Stage::VERTEX) {
-        [encoder setVertexBuffers:metalBuffers.data()
-                          offsets:metalOffsets.data()
+        [encoder setVertexBuffers:metalBuffers
+                          offsets:metalOffsets
                         withRange:bufferRange];
     }
     if (stages & Stage::FRAGMENT) {
-        [encoder setFragmentBuffers:metalBuffers.data()
-                            offsets:metalOffsets.data()
+        [encoder setFragmentBuffers:metalBuffers
+                            offsets:metalOffsets
                           withRange:bufferRange];
     }
 
@@ -59,8 +59,17 @@ public:
     void reset() noexcept;
 
 private:
+    // Creates a shared buffer, from the heap when it's small enough.
+    id<MTLBuffer> newBuffer(size_t numBytes) noexcept;
+
     MetalContext& mContext;
 
+    // Heap small buffers are sub-allocated from, which is much cheaper than a device allocation.
+    // Only used on iOS, where heaps support the shared storage mode. Created on first use.
+    id<MTLHeap> mHeap = nil;
+    static constexpr size_t HEAP_SIZE = 4 * 1024 * 1024;
+    static constexpr size_t MAX_HEAP_ALLOCATION_SIZE = 64 * 1024;
+
     // Synchronizes access to mFreeStages, mUsedStages, and mutable data inside MetalBufferPoolEntrys.
     // acquireBuffer and releaseBuffer may be called on separate threads (the engine thread and a
     // Metal callback thread, for example).
@@ -42,8 +42,7 @@ MetalBufferPoolEntry const* MetalBufferPool::acquireBuffer(size_t numBytes) {
     }
 
     // We were not able to find a sufficiently large stage, so create a new one.
-    id<MTLBuffer> buffer = [mContext.device newBufferWithLength:numBytes
-                                                        options:MTLResourceStorageModeShared];
+    id<MTLBuffer> buffer = newBuffer(numBytes);
     MetalBufferPoolEntry* stage = new MetalBufferPoolEntry({
         .buffer = buffer,
         .capacity = numBytes,
@@ -55,6 +54,29 @@ MetalBufferPoolEntry const* MetalBufferPool::acquireBuffer(size_t numBytes) {
     return stage;
 }
 
+id<MTLBuffer> MetalBufferPool::newBuffer(size_t numBytes) noexcept {
+#if defined(IOS)
+    if (numBytes <= MAX_HEAP_ALLOCATION_SIZE) {
+        if (@available(iOS 10, *)) {
+            if (!mHeap) {
+                MTLHeapDescriptor* descriptor = [MTLHeapDescriptor new];
+                descriptor.size = HEAP_SIZE;
+                descriptor.storageMode = MTLStorageModeShared;
+                mHeap = [mContext.device newHeapWithDescriptor:descriptor];
+            }
+            // This returns nil when the heap is full. The space of a buffer goes back to the heap
+            // when the buffer is released, e.g. when gc() evicts it.
+            id<MTLBuffer> buffer = [mHeap newBufferWithLength:numBytes
+                                                      options:MTLResourceStorageModeShared];
+            if (buffer) {
+                return buffer;
+            }
+        }
+    }
+#endif
+    return [mContext.device newBufferWithLength:numBytes options:MTLResourceStorageModeShared];
+}
+
 void MetalBufferPool::retainBuffer(MetalBufferPoolEntry const *stage) noexcept {
     std::lock_guard<std::mutex> lock(mMutex);
 
@@ -108,6 +130,7 @@ void MetalBufferPool::reset() noexcept {
         delete pair.second;
     }
     mFreeStages.clear();
+    mHeap = nil;
 }
 
 } // namespace metal
@@ -61,6 +61,7 @@ struct MetalContext {
     UniformBufferState uniformState[VERTEX_BUFFER_START];
     CullModeStateTracker cullModeState;
     WindingStateTracker windingState;
+    SamplerBindingsStateTracker samplerBindingsState;
 
     // State caches.
     DepthStencilStateCache depthStencilStateCache;
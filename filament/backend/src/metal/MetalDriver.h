@@ -26,6 +26,7 @@
 #include <tsl/robin_map.h>
 
 #include <mutex>
+#include <vector>
 
 namespace filament {
 namespace backend {
@@ -37,6 +38,7 @@ namespace metal {
 struct MetalUniformBuffer;
 struct MetalContext;
 struct MetalProgram;
+struct MetalTexture;
 struct UniformBufferState;
 
 class MetalDriver final : public DriverBase {
@@ -165,6 +167,15 @@ private:
     void enumerateBoundUniformBuffers(const std::function<void(const UniformBufferState&,
             MetalUniformBuffer*, uint32_t)>& f);
 
+    // Makes the acquired image of a stream the image sampled through 'texture'.
+    void updateAcquiredImage(MetalTexture* texture, AcquiredImage const& image);
+    // Releases an acquired image to the client once the GPU is done with the frames sampling it.
+    void releaseAcquiredImage(AcquiredImage const& image);
+    void detachStream(MetalTexture* texture);
+
+    // the textures attached to an acquired stream, accessed from the user thread in updateStreams()
+    std::vector<MetalTexture*> mExternalStreams;
+
 };
 
 } // namespace metal
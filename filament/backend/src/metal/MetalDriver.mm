@@ -16,6 +16,7 @@
 
 #include "backend/PresentCallable.h"
 #include "private/backend/CommandStream.h"
+#include "private/backend/UniformBufferUpdate.h"
 #include "CommandStreamDispatcher.h"
 #include "metal/MetalDriver.h"
 
@@ -26,6 +27,7 @@
 #include "MetalHandles.h"
 #include "MetalState.h"
 #include "MetalTimerQuery.h"
+#include "PlatformMetal.h"
 
 #include <CoreVideo/CVMetalTexture.h>
 #include <CoreVideo/CVPixelBuffer.h>
@@ -34,6 +36,9 @@
 
 #include <utils/Log.h>
 #include <utils/Panic.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
 
 namespace filament {
 namespace backend {
@@ -50,6 +55,76 @@ Driver* MetalDriver::create(MetalPlatform* const platform) {
     return new MetalDriver(platform);
 }
 
+// The key used to store the serialized MTLBinaryArchive identifies the GPU, so that an archive
+// produced by a different one is never loaded.
+struct UTILS_PACKED BinaryArchiveBlobKey {
+    char tag[8];
+    char deviceName[64];
+};
+
+static BinaryArchiveBlobKey getBinaryArchiveBlobKey(id<MTLDevice> device) {
+    BinaryArchiveBlobKey key = { { 'F', 'M', 'T', 'L', 'A', 'R', 'C', '1' } };
+    strncpy(key.deviceName, device.name.UTF8String, sizeof(key.deviceName) - 1);
+    return key;
+}
+
+// MTLBinaryArchive can only be (de)serialized through a file, the blob goes through this one.
+static NSURL* getBinaryArchiveURL() {
+    NSString* name = [NSString stringWithFormat:@"filament-%d.metalarchive",
+            NSProcessInfo.processInfo.processIdentifier];
+    return [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+}
+
+static void createBinaryArchive(MetalPlatform& platform, MetalContext& context) {
+    if (!platform.hasBlobFunc()) {
+        return;
+    }
+    if (@available(macOS 11.0, iOS 14.0, *)) {
+        MTLBinaryArchiveDescriptor* descriptor = [MTLBinaryArchiveDescriptor new];
+        const BinaryArchiveBlobKey key = getBinaryArchiveBlobKey(context.device);
+        const size_t size = platform.retrieveBlob(&key, sizeof(key), nullptr, 0);
+        if (size) {
+            NSMutableData* data = [NSMutableData dataWithLength:size];
+            NSURL* url = getBinaryArchiveURL();
+            if (platform.retrieveBlob(&key, sizeof(key), data.mutableBytes, size) == size &&
+                    [data writeToURL:url atomically:NO]) {
+                descriptor.url = url;
+            }
+        }
+
+        NSError* error = nil;
+        id<MTLBinaryArchive> archive = [context.device newBinaryArchiveWithDescriptor:descriptor
+                                                                                error:&error];
+        if (archive == nil && descriptor.url) {
+            // e.g. the archive was made by an older version of the OS, start over
+            utils::slog.w << "Ignoring incompatible Metal binary archive." << utils::io::endl;
+            descriptor.url = nil;
+            archive = [context.device newBinaryArchiveWithDescriptor:descriptor error:&error];
+        }
+        context.pipelineStateCache.getCreator().binaryArchive = archive;
+    }
+}
+
+static void saveBinaryArchive(MetalPlatform& platform, MetalContext& context) {
+    if (@available(macOS 11.0, iOS 14.0, *)) {
+        PipelineStateCreator& creator = context.pipelineStateCache.getCreator();
+        if (creator.binaryArchive == nil) {
+            return;
+        }
+        NSURL* url = getBinaryArchiveURL();
+        if (creator.binaryArchiveModified && [creator.binaryArchive serializeToURL:url error:nil]) {
+            NSData* data = [NSData dataWithContentsOfURL:url];
+            if (data.length) {
+                const BinaryArchiveBlobKey key = getBinaryArchiveBlobKey(context.device);
+                platform.insertBlob(&key, sizeof(key), data.bytes, data.length);
+            }
+        }
+        [NSFileManager.defaultManager removeItemAtURL:url error:nil];
+        creator.binaryArchive = nil;
+        creator.binaryArchiveModified = false;
+    }
+}
+
 MetalDriver::MetalDriver(backend::MetalPlatform* platform) noexcept
         : DriverBase(new ConcreteDispatcher<MetalDriver>()),
         mPlatform(*platform),
@@ -59,6 +134,7 @@ MetalDriver::MetalDriver(backend::MetalPlatform* platform) noexcept
     mContext->commandQueue = [mContext->device newCommandQueue];
     mContext->commandQueue.label = @"Filament";
     mContext->pipelineStateCache.setDevice(mContext->device);
+    createBinaryArchive(mPlatform, *mContext);
     mContext->depthStencilStateCache.setDevice(mContext->device);
     mContext->samplerStateCache.setDevice(mContext->device);
     mContext->bufferPool = new MetalBufferPool(*mContext);
@@ -138,6 +214,9 @@ void MetalDriver::endFrame(uint32_t frameId) {
     mContext->currentDrawSwapChain->releaseDrawable();
 
     CVMetalTextureCacheFlush(mContext->textureCache, 0);
+
+    SYSTRACE_CONTEXT();
+    SYSTRACE_VALUE64("gpuMemory", getAllocatedGpuMemory());
 }
 
 void MetalDriver::flush(int) {
@@ -170,6 +249,11 @@ void MetalDriver::createIndexBufferR(Handle<HwIndexBuffer> ibh, ElementType elem
     construct_handle<MetalIndexBuffer>(mHandleMap, ibh, *mContext, elementSize, indexCount);
 }
 
+void MetalDriver::createBufferObjectR(Handle<HwBufferObject> boh, uint32_t byteCount,
+        BufferObjectBinding bindingType, BufferUsage usage) {
+    construct_handle<MetalBufferObject>(mHandleMap, boh, *mContext, byteCount, bindingType);
+}
+
 void MetalDriver::createTextureR(Handle<HwTexture> th, SamplerType target, uint8_t levels,
         TextureFormat format, uint8_t samples, uint32_t width, uint32_t height,
         uint32_t depth, TextureUsage usage) {
@@ -225,6 +309,13 @@ void MetalDriver::createRenderPrimitiveR(Handle<HwRenderPrimitive> rph, int dumm
     construct_handle<MetalRenderPrimitive>(mHandleMap, rph);
 }
 
+void MetalDriver::createRenderPrimitives(Handle<HwRenderPrimitive> const* rphs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        Handle<HwRenderPrimitive> rph = rphs[i];
+        construct_handle<MetalRenderPrimitive>(mHandleMap, rph);
+    }
+}
+
 void MetalDriver::createProgramR(Handle<HwProgram> rph, Program&& program) {
     construct_handle<MetalProgram>(mHandleMap, rph, mContext->device, program);
 }
@@ -319,6 +410,10 @@ Handle<HwIndexBuffer> MetalDriver::createIndexBufferS() noexcept {
     return alloc_handle<MetalIndexBuffer, HwIndexBuffer>();
 }
 
+Handle<HwBufferObject> MetalDriver::createBufferObjectS() noexcept {
+    return alloc_handle<MetalBufferObject, HwBufferObject>();
+}
+
 Handle<HwTexture> MetalDriver::createTextureS() noexcept {
     return alloc_handle<MetalTexture, HwTexture>();
 }
@@ -343,6 +438,15 @@ Handle<HwRenderPrimitive> MetalDriver::createRenderPrimitiveS() noexcept {
     return alloc_handle<MetalRenderPrimitive, HwRenderPrimitive>();
 }
 
+void MetalDriver::allocateRenderPrimitives(Handle<HwRenderPrimitive>* rphs, uint32_t count) {
+    // same as alloc_handle(), but takes the lock only once
+    std::lock_guard<std::mutex> lock(mHandleMapMutex);
+    for (uint32_t i = 0; i < count; i++) {
+        mHandleMap[mNextId] = malloc(sizeof(MetalRenderPrimitive));
+        rphs[i] = Handle<HwRenderPrimitive>(mNextId++);
+    }
+}
+
 Handle<HwProgram> MetalDriver::createProgramS() noexcept {
     return alloc_handle<MetalProgram, HwProgram>();
 }
@@ -397,12 +501,30 @@ void MetalDriver::destroyIndexBuffer(Handle<HwIndexBuffer> ibh) {
     }
 }
 
+void MetalDriver::destroyBufferObject(Handle<HwBufferObject> boh) {
+    if (boh) {
+        destruct_handle<MetalBufferObject>(mHandleMap, boh);
+    }
+}
+
 void MetalDriver::destroyRenderPrimitive(Handle<HwRenderPrimitive> rph) {
     if (rph) {
         destruct_handle<MetalRenderPrimitive>(mHandleMap, rph);
     }
 }
 
+void MetalDriver::destroyRenderPrimitives(Handle<HwRenderPrimitive> const* rphs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        destroyRenderPrimitive(rphs[i]);
+    }
+}
+
+void MetalDriver::destroyTextures(Handle<HwTexture> const* ths, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        destroyTexture(ths[i]);
+    }
+}
+
 void MetalDriver::destroyProgram(Handle<HwProgram> ph) {
     if (ph) {
         destruct_handle<MetalProgram>(mHandleMap, ph);
@@ -452,6 +574,11 @@ void MetalDriver::destroyTexture(Handle<HwTexture> th) {
         }
     }
 
+    auto* texture = handle_cast<MetalTexture>(mHandleMap, th);
+    if (texture->stream) {
+        detachStream(texture);
+    }
+
     destruct_handle<MetalTexture>(mHandleMap, th);
 }
 
@@ -468,7 +595,19 @@ void MetalDriver::destroySwapChain(Handle<HwSwapChain> sch) {
 }
 
 void MetalDriver::destroyStream(Handle<HwStream> sh) {
-    // no-op
+    if (!sh) {
+        return;
+    }
+    auto* stream = handle_cast<MetalStream>(mHandleMap, sh);
+    auto pos = std::find_if(mExternalStreams.begin(), mExternalStreams.end(),
+            [stream](MetalTexture const* t) { return t->stream == stream; });
+    if (pos != mExternalStreams.end()) {
+        detachStream(*pos);
+    }
+    if (stream->pending.image) {
+        scheduleRelease(std::move(stream->pending));
+    }
+    destruct_handle<MetalStream>(mHandleMap, sh);
 }
 
 void MetalDriver::destroyTimerQuery(Handle<HwTimerQuery> tqh) {
@@ -492,6 +631,8 @@ void MetalDriver::terminate() {
     mContext->bufferPool->reset();
     mContext->commandQueue = nil;
 
+    saveBinaryArchive(mPlatform, *mContext);
+
     MetalExternalImage::shutdown(*mContext);
     mContext->blitter->shutdown();
 }
@@ -509,11 +650,18 @@ Handle<HwStream> MetalDriver::createStreamNative(void* stream) {
 }
 
 Handle<HwStream> MetalDriver::createStreamAcquired() {
-    return {};
+    return alloc_and_construct_handle<MetalStream, HwStream>();
 }
 
+// Stashes the image until the next updateStreams(), which is called at the start of each frame.
 void MetalDriver::setAcquiredImage(Handle<HwStream> sh, void* image, backend::StreamCallback cb,
         void* userData) {
+    auto* stream = handle_cast<MetalStream>(mHandleMap, sh);
+    if (stream->pending.image) {
+        scheduleRelease(std::move(stream->pending));
+        utils::slog.w << "Acquired image is set more than once per frame." << utils::io::endl;
+    }
+    stream->pending = { image, cb, userData };
 }
 
 void MetalDriver::setStreamDimensions(Handle<HwStream> stream, uint32_t width,
@@ -526,7 +674,55 @@ int64_t MetalDriver::getStreamTimestamp(Handle<HwStream> stream) {
 }
 
 void MetalDriver::updateStreams(backend::DriverApi* driver) {
+    for (MetalTexture* texture : mExternalStreams) {
+        MetalStream* stream = texture->stream;
+        if (!stream || !stream->pending.image) {
+            continue;
+        }
+        AcquiredImage image = stream->pending;
+        stream->pending = {};
+        driver->queueCommand([this, texture, image]() {
+            updateAcquiredImage(texture, image);
+        });
+    }
+}
+
+void MetalDriver::updateAcquiredImage(MetalTexture* texture, AcquiredImage const& image) {
+    // The external image takes a reference of its own, which it releases when it's replaced. The
+    // client's reference is released with the callback of the acquired image.
+    CVPixelBufferRef pixelBuffer = (CVPixelBufferRef) image.image;
+    CVPixelBufferRetain(pixelBuffer);
+    texture->externalImage.set(pixelBuffer);
+
+    MetalStream* stream = texture->stream;
+    if (stream->acquired.image) {
+        releaseAcquiredImage(stream->acquired);
+    }
+    stream->acquired = image;
+}
+
+void MetalDriver::releaseAcquiredImage(AcquiredImage const& image) {
+    // Command buffers complete in order, so when the pending one completes, so have all the
+    // frames that sampled the image.
+    AcquiredImage released = image;
+    id<MTLCommandBuffer> commandBuffer = getPendingCommandBuffer(mContext);
+    [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+        scheduleRelease(AcquiredImage(released));
+    }];
+}
 
+void MetalDriver::detachStream(MetalTexture* texture) {
+    auto pos = std::find(mExternalStreams.begin(), mExternalStreams.end(), texture);
+    if (pos != mExternalStreams.end()) {
+        mExternalStreams.erase(pos);
+    }
+    MetalStream* stream = texture->stream;
+    texture->externalImage.set(nullptr);
+    if (stream->acquired.image) {
+        releaseAcquiredImage(stream->acquired);
+        stream->acquired = {};
+    }
+    texture->stream = nullptr;
 }
 
 void MetalDriver::destroyFence(Handle<HwFence> fh) {
@@ -607,6 +803,15 @@ bool MetalDriver::isFrameBufferFetchSupported() {
 #endif
 }
 
+bool MetalDriver::isParallelShaderCompileSupported() {
+    return false;
+}
+
+bool MetalDriver::isComputeSupported() {
+    // TODO: implement compute pipelines
+    return false;
+}
+
 bool MetalDriver::isFrameTimeSupported() {
     // Frame time is calculated via hard fences, which are only available on iOS 12 and above.
     if (@available(macOS 10.14, iOS 12, *)) {
@@ -619,6 +824,15 @@ bool MetalDriver::areFeedbackLoopsSupported() {
     return true;
 }
 
+uint64_t MetalDriver::getAllocatedGpuMemory() {
+    return mContext->device.currentAllocatedSize;
+}
+
+GpuMemoryPoolStats MetalDriver::getGpuMemoryPoolStats() {
+    // buffers and textures are allocated by the device rather than from heaps
+    return {};
+}
+
 math::float2 MetalDriver::getClipSpaceParams() {
     // z-coordinate of clip-space is in [0,w]
     return math::float2{ -0.5f, 0.5f };
@@ -640,6 +854,14 @@ void MetalDriver::updateIndexBuffer(Handle<HwIndexBuffer> ibh, BufferDescriptor&
     scheduleDestroy(std::move(data));
 }
 
+void MetalDriver::updateBufferObject(Handle<HwBufferObject> boh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    assert(byteOffset == 0);    // TODO: handle byteOffset for buffer objects
+    auto* bo = handle_cast<MetalBufferObject>(mHandleMap, boh);
+    bo->buffer.copyIntoBuffer(data.buffer, data.size);
+    scheduleDestroy(std::move(data));
+}
+
 void MetalDriver::update2DImage(Handle<HwTexture> th, uint32_t level, uint32_t xoffset,
         uint32_t yoffset, uint32_t width, uint32_t height, PixelBufferDescriptor&& data) {
     ASSERT_PRECONDITION(!isInRenderPass(mContext),
@@ -650,6 +872,10 @@ void MetalDriver::update2DImage(Handle<HwTexture> th, uint32_t level, uint32_t x
 }
 
 void MetalDriver::setMinMaxLevels(Handle<HwTexture> th, uint32_t minLevel, uint32_t maxLevel) {
+    // the range is applied through the LOD clamps of the sampler, see bindSamplers()
+    auto tex = handle_cast<MetalTexture>(mHandleMap, th);
+    tex->minLod = minLevel;
+    tex->maxLod = maxLevel;
 }
 
 void MetalDriver::update3DImage(Handle<HwTexture> th, uint32_t level,
@@ -697,6 +923,19 @@ void MetalDriver::setExternalImagePlane(Handle<HwTexture> th, void* image, size_
 }
 
 void MetalDriver::setExternalStream(Handle<HwTexture> th, Handle<HwStream> sh) {
+    auto* texture = handle_cast<MetalTexture>(mHandleMap, th);
+    if (texture->stream) {
+        detachStream(texture);
+    }
+    if (sh) {
+        auto* stream = handle_cast<MetalStream>(mHandleMap, sh);
+        if (stream->streamType != StreamType::ACQUIRED) {
+            utils::slog.w << "Only acquired streams are supported." << utils::io::endl;
+            return;
+        }
+        texture->stream = stream;
+        mExternalStreams.push_back(texture);
+    }
 }
 
 bool MetalDriver::getTimerQueryValue(Handle<HwTimerQuery> tqh, uint64_t* elapsedTime) {
@@ -742,6 +981,16 @@ void MetalDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh,
     scheduleDestroy(std::move(data));
 }
 
+void MetalDriver::updateUniformBuffers(BufferDescriptor&& updates) {
+    char const* const end = static_cast<char const*>(updates.buffer) + updates.size;
+    for (auto u = static_cast<UniformBufferUpdate const*>(updates.buffer);
+            reinterpret_cast<char const*>(u) < end; u = u->next()) {
+        auto uniform = handle_cast<MetalUniformBuffer>(mHandleMap, u->ubh);
+        uniform->buffer.copyIntoBuffer(u->getData(), u->byteSize, u->byteOffset);
+    }
+    scheduleDestroy(std::move(updates));
+}
+
 void MetalDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
         SamplerGroup&& samplerGroup) {
     auto sb = handle_cast<MetalSamplerGroup>(mHandleMap, sbh);
@@ -775,6 +1024,13 @@ void MetalDriver::beginRenderPass(Handle<HwRenderTarget> rth,
     };
     [mContext->currentRenderPassEncoder setViewport:metalViewport];
 
+    // Bind the zero buffer, used for missing vertex attributes. Nothing else uses this index, so
+    // once per encoder is enough.
+    static const char bytes[16] = { 0 };
+    [mContext->currentRenderPassEncoder setVertexBytes:bytes
+                                                length:16
+                                               atIndex:(VERTEX_BUFFER_START + ZERO_VERTEX_BUFFER)];
+
     // Metal requires a new command encoder for each render pass, and they cannot be reused.
     // We must bind certain states for each command encoder, so we dirty the states here to force a
     // rebinding at the first the draw call of this pass.
@@ -782,6 +1038,7 @@ void MetalDriver::beginRenderPass(Handle<HwRenderTarget> rth,
     mContext->depthStencilState.invalidate();
     mContext->cullModeState.invalidate();
     mContext->windingState.invalidate();
+    mContext->samplerBindingsState.invalidate();
 }
 
 void MetalDriver::nextSubpass(int dummy) {}
@@ -848,6 +1105,15 @@ void MetalDriver::bindUniformBufferRange(size_t index, Handle<HwUniformBuffer> u
     };
 }
 
+void MetalDriver::bindBufferObject(uint8_t index, Handle<HwBufferObject> boh) {
+    // TODO: buffer objects are only used by compute, which is not supported yet
+}
+
+void MetalDriver::bindVertexBufferStorage(uint8_t index, Handle<HwVertexBuffer> vbh,
+        uint8_t bufferIndex) {
+    // TODO: only used by compute, which is not supported yet
+}
+
 void MetalDriver::bindSamplers(size_t index, Handle<HwSamplerGroup> sbh) {
     auto sb = handle_cast<MetalSamplerGroup>(mHandleMap, sbh);
     mContext->samplerBindings[index] = sb;
@@ -1078,7 +1344,8 @@ void MetalDriver::blit(TargetBufferFlags buffers,
     mContext->blitter->blit(getPendingCommandBuffer(mContext), args);
 }
 
-void MetalDriver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph) {
+void MetalDriver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
     ASSERT_PRECONDITION(mContext->currentRenderPassEncoder != nullptr,
             "Attempted to draw without a valid command encoder.");
     auto primitive = handle_cast<MetalRenderPrimitive>(mHandleMap, rph);
@@ -1191,8 +1458,9 @@ void MetalDriver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph)
     // Enumerate all the sampler buffers for the program and check which textures and samplers need
     // to be bound.
 
-    id<MTLTexture> texturesToBind[SAMPLER_BINDING_COUNT] = {};
-    id<MTLSamplerState> samplersToBind[SAMPLER_BINDING_COUNT] = {};
+    SamplerBindingsState samplerBindings;
+    auto& texturesToBind = samplerBindings.textures;
+    auto& samplersToBind = samplerBindings.samplers;
 
     enumerateSamplerGroups(program, [this, &texturesToBind, &samplersToBind](
             const SamplerGroup::Sampler* sampler,
@@ -1233,29 +1501,27 @@ void MetalDriver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph)
     }
 
     // Similar to uniforms, we can't tell which stage will use the textures / samplers, so bind
-    // to both the vertex and fragment stages.
-
-    NSRange samplerRange = NSMakeRange(0, SAMPLER_BINDING_COUNT);
-    [mContext->currentRenderPassEncoder setFragmentTextures:texturesToBind
-                                                  withRange:samplerRange];
-    [mContext->currentRenderPassEncoder setVertexTextures:texturesToBind
-                                                withRange:samplerRange];
-    [mContext->currentRenderPassEncoder setFragmentSamplerStates:samplersToBind
-                                                       withRange:samplerRange];
-    [mContext->currentRenderPassEncoder setVertexSamplerStates:samplersToBind
-                                                     withRange:samplerRange];
+    // to both the vertex and fragment stages. Consecutive draws often use the same ones, in which
+    // case there's nothing to do.
+
+    mContext->samplerBindingsState.updateState(samplerBindings);
+    if (mContext->samplerBindingsState.stateChanged()) {
+        NSRange samplerRange = NSMakeRange(0, SAMPLER_BINDING_COUNT);
+        [mContext->currentRenderPassEncoder setFragmentTextures:texturesToBind
+                                                      withRange:samplerRange];
+        [mContext->currentRenderPassEncoder setVertexTextures:texturesToBind
+                                                    withRange:samplerRange];
+        [mContext->currentRenderPassEncoder setFragmentSamplerStates:samplersToBind
+                                                           withRange:samplerRange];
+        [mContext->currentRenderPassEncoder setVertexSamplerStates:samplersToBind
+                                                         withRange:samplerRange];
+    }
 
     // Bind the vertex buffers.
     MetalBuffer::bindBuffers(getPendingCommandBuffer(mContext), mContext->currentRenderPassEncoder,
             VERTEX_BUFFER_START, MetalBuffer::Stage::VERTEX, primitive->buffers.data(),
             primitive->offsets.data(), primitive->buffers.size());
 
-    // Bind the zero buffer, used for missing vertex attributes.
-    static const char bytes[16] = { 0 };
-    [mContext->currentRenderPassEncoder setVertexBytes:bytes
-                                                length:16
-                                               atIndex:(VERTEX_BUFFER_START + ZERO_VERTEX_BUFFER)];
-
     MetalIndexBuffer* indexBuffer = primitive->indexBuffer;
 
     id<MTLCommandBuffer> cmdBuffer = getPendingCommandBuffer(mContext);
@@ -1264,7 +1530,16 @@ void MetalDriver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph)
                                                    indexCount:primitive->count
                                                     indexType:getIndexType(indexBuffer->elementSize)
                                                   indexBuffer:metalIndexBuffer
-                                            indexBufferOffset:primitive->offset];
+                                            indexBufferOffset:primitive->offset
+                                                instanceCount:instanceCount];
+}
+
+void MetalDriver::bindImage(uint8_t unit, Handle<HwTexture> th, uint8_t level) {
+    // compute is not supported (see isComputeSupported())
+}
+
+void MetalDriver::dispatchCompute(Handle<HwProgram> ph, math::uint3 workGroupCount) {
+    // compute is not supported (see isComputeSupported())
 }
 
 void MetalDriver::beginTimerQuery(Handle<HwTimerQuery> tqh) {
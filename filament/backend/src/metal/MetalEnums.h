@@ -283,6 +283,9 @@ inline MTLPixelFormat getMetalFormat(TextureFormat format) noexcept {
 
         case TextureFormat::DXT1_RGB: return MTLPixelFormatInvalid;
         case TextureFormat::DXT1_SRGB: return MTLPixelFormatInvalid;
+
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT: return MTLPixelFormatBC6H_RGBFloat;
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT: return MTLPixelFormatBC6H_RGBUfloat;
 #endif
 
         default:
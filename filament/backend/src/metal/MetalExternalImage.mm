@@ -76,6 +76,10 @@ bool MetalExternalImage::isValid() const noexcept {
 }
 
 void MetalExternalImage::set(CVPixelBufferRef image) noexcept {
+    // The RGB texture is kept across frames of the same size. Command buffers execute in order,
+    // and Metal tracks the hazard between the previous frames reading it and the next
+    // conversion pass writing to it.
+    id<MTLTexture> previousRgbTexture = mRgbTexture;
     unset();
 
     if (!image) {
@@ -108,7 +112,12 @@ void MetalExternalImage::set(CVPixelBufferRef image) noexcept {
         mWidth = CVPixelBufferGetWidthOfPlane(image, Y_PLANE);
         mHeight = CVPixelBufferGetHeightOfPlane(image, Y_PLANE);
 
-        mRgbTexture = createRgbTexture(mWidth, mHeight);
+        if (previousRgbTexture && previousRgbTexture.width == mWidth &&
+                previousRgbTexture.height == mHeight) {
+            mRgbTexture = previousRgbTexture;
+        } else {
+            mRgbTexture = createRgbTexture(mWidth, mHeight);
+        }
 
         id <MTLCommandBuffer> commandBuffer = encodeColorConversionPass(
                 CVMetalTextureGetTexture(yPlane),
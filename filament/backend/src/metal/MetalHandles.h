@@ -126,6 +126,12 @@ struct MetalIndexBuffer : public HwIndexBuffer {
     MetalBuffer buffer;
 };
 
+struct MetalBufferObject : public HwBufferObject {
+    MetalBufferObject(MetalContext& context, uint32_t byteCount, BufferObjectBinding bindingType);
+
+    MetalBuffer buffer;
+};
+
 struct MetalUniformBuffer : public HwUniformBuffer {
     MetalUniformBuffer(MetalContext& context, size_t size);
 
@@ -157,6 +163,11 @@ struct MetalProgram : public HwProgram {
     bool isValid = false;
 };
 
+struct MetalStream : public HwStream {
+    AcquiredImage pending = {};     // set by setAcquiredImage(), picked up by updateStreams()
+    AcquiredImage acquired = {};    // the image sampled by the texture attached to the stream
+};
+
 struct MetalTexture : public HwTexture {
     MetalTexture(MetalContext& context, SamplerType target, uint8_t levels, TextureFormat format,
             uint8_t samples, uint32_t width, uint32_t height, uint32_t depth, TextureUsage usage)
@@ -182,6 +193,7 @@ struct MetalTexture : public HwTexture {
 
     MetalContext& context;
     MetalExternalImage externalImage;
+    MetalStream* stream = nullptr;  // the acquired stream this texture is attached to, if any
     id<MTLTexture> texture = nil;
     uint8_t bytesPerElement; // The number of bytes per pixel, or block (for compressed texture formats).
     uint8_t blockWidth; // The number of horizontal pixels per block (only for compressed texture formats).
@@ -298,6 +298,10 @@ MetalVertexBuffer::~MetalVertexBuffer() {
 MetalIndexBuffer::MetalIndexBuffer(MetalContext& context, uint8_t elementSize, uint32_t indexCount)
     : HwIndexBuffer(elementSize, indexCount), buffer(context, elementSize * indexCount, true) { }
 
+MetalBufferObject::MetalBufferObject(MetalContext& context, uint32_t byteCount,
+        BufferObjectBinding bindingType) : HwBufferObject(byteCount, bindingType),
+        buffer(context, byteCount, true) { }
+
 MetalUniformBuffer::MetalUniformBuffer(MetalContext& context, size_t size) : HwUniformBuffer(),
         buffer(context, size) { }
 
@@ -355,32 +359,64 @@ void MetalRenderPrimitive::setBuffers(MetalVertexBuffer* vertexBuffer, MetalInde
     };
 }
 
+// Metal libraries start with the "MTLB" magic number, MSL is text.
+static bool isMetalLibrary(const std::vector<uint8_t>& source) noexcept {
+    return source.size() >= 4 && !memcmp(source.data(), "MTLB", 4);
+}
+
 MetalProgram::MetalProgram(id<MTLDevice> device, const Program& program) noexcept
     : HwProgram(program.getName()), vertexFunction(nil), fragmentFunction(nil), samplerGroupInfo(),
         isValid(false) {
 
     using MetalFunctionPtr = __strong id<MTLFunction>*;
 
-    static_assert(Program::SHADER_TYPE_COUNT == 2, "Only vertex and fragment shaders expected.");
+    // compute programs are not supported, only look at the vertex and fragment shaders
+    static_assert(size_t(Program::Shader::VERTEX) == 0 && size_t(Program::Shader::FRAGMENT) == 1,
+            "Vertex and fragment shaders expected first.");
     MetalFunctionPtr shaderFunctions[2] = { &vertexFunction, &fragmentFunction };
 
+    // The specialization constants of the SPIR-V are function constants in the MSL.
+    MTLFunctionConstantValues* constants = nil;
+    if (!program.getSpecializationConstants().empty()) {
+        constants = [MTLFunctionConstantValues new];
+        for (auto const& constant : program.getSpecializationConstants()) {
+            const NSUInteger index = constant.id;
+            if (auto const* i = std::get_if<int32_t>(&constant.value)) {
+                [constants setConstantValue:i type:MTLDataTypeInt atIndex:index];
+            } else if (auto const* f = std::get_if<float>(&constant.value)) {
+                [constants setConstantValue:f type:MTLDataTypeFloat atIndex:index];
+            } else {
+                const bool b = std::get<bool>(constant.value);
+                [constants setConstantValue:&b type:MTLDataTypeBool atIndex:index];
+            }
+        }
+    }
+
     const auto& sources = program.getShadersSource();
-    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+    for (size_t i = 0; i < 2; i++) {
         const auto& source = sources[i];
         // It's okay for some shaders to be empty, they shouldn't be used in any draw calls.
         if (source.empty()) {
             continue;
         }
 
-        NSString* objcSource = [[NSString alloc] initWithBytes:source.data()
-                                                        length:source.size()
-                                                      encoding:NSUTF8StringEncoding];
         NSError* error = nil;
-        MTLCompileOptions* options = [MTLCompileOptions new];
-        options.languageVersion = MTLLanguageVersion1_1;
-        id<MTLLibrary> library = [device newLibraryWithSource:objcSource
-                                                      options:nil
-                                                        error:&error];
+        id<MTLLibrary> library = nil;
+        if (isMetalLibrary(source)) {
+            // precompiled by matc, dispatch_data_create() copies the data
+            dispatch_data_t data = dispatch_data_create(source.data(), source.size(),
+                    dispatch_get_main_queue(), DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+            library = [device newLibraryWithData:data error:&error];
+        } else {
+            NSString* objcSource = [[NSString alloc] initWithBytes:source.data()
+                                                            length:source.size()
+                                                          encoding:NSUTF8StringEncoding];
+            MTLCompileOptions* options = [MTLCompileOptions new];
+            options.languageVersion = MTLLanguageVersion1_1;
+            library = [device newLibraryWithSource:objcSource
+                                           options:nil
+                                             error:&error];
+        }
         if (library == nil) {
             if (error) {
                 auto description =
@@ -391,7 +427,22 @@ MetalProgram::MetalProgram(id<MTLDevice> device, const Program& program) noexcep
             return;
         }
 
-        *shaderFunctions[i] = [library newFunctionWithName:@"main0"];
+        if (constants) {
+            *shaderFunctions[i] = [library newFunctionWithName:@"main0"
+                                                constantValues:constants
+                                                         error:&error];
+            if (*shaderFunctions[i] == nil) {
+                if (error) {
+                    auto description =
+                            [error.localizedDescription cStringUsingEncoding:NSUTF8StringEncoding];
+                    utils::slog.w << description << utils::io::endl;
+                }
+                PANIC_LOG("Failed to specialize Metal program.");
+                return;
+            }
+        } else {
+            *shaderFunctions[i] = [library newFunctionWithName:@"main0"];
+        }
     }
 
     // All stages of the program have compiled successfuly, this is a valid program.
@@ -479,6 +530,14 @@ MetalTexture::MetalTexture(MetalContext& context, SamplerType target, uint8_t le
             descriptor.sampleCount = multisampled ? samples : 1;
             descriptor.usage = getMetalTextureUsage(usage);
             descriptor.storageMode = MTLStorageModePrivate;
+#if defined(IOS)
+            // Transient attachments are never loaded or stored, they can live in tile memory.
+            if (any(usage & TextureUsage::TRANSIENT_ATTACHMENT) &&
+                    none(usage & (TextureUsage::SAMPLEABLE | TextureUsage::UPLOADABLE))) {
+                descriptor.usage = MTLTextureUsageRenderTarget;
+                descriptor.storageMode = MTLStorageModeMemoryless;
+            }
+#endif
             texture = [context.device newTextureWithDescriptor:descriptor];
             ASSERT_POSTCONDITION(texture != nil, "Could not create Metal texture. Out of memory?");
             break;
@@ -713,7 +772,7 @@ MetalRenderTarget::MetalRenderTarget(MetalContext* context, uint32_t width, uint
 
         if (msaaResolve && textureSampleCount == 1) {
             multisampledColor[i] =
-                    createMultisampledTexture(context->device, color[0].texture.pixelFormat,
+                    createMultisampledTexture(context->device, color[i].texture.pixelFormat,
                             width, height, samples);
         }
     }
@@ -24,6 +24,8 @@
 
 #include <backend/DriverEnums.h>
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 #include <tsl/robin_map.h>
 #include <utils/Hash.h>
@@ -143,6 +145,8 @@ public:
 
     void setDevice(id<MTLDevice> device) noexcept { mDevice = device; }
 
+    StateCreator& getCreator() noexcept { return creator; }
+
     MetalType getOrCreateState(const StateType& state) noexcept {
         // Check if a valid state already exists in the cache.
         auto iter = mStateCache.find(state);
@@ -249,6 +253,11 @@ static_assert(sizeof(PipelineState) == 656, "PipelineState unexpected size.");
 struct PipelineStateCreator {
     id<MTLRenderPipelineState> operator()(id<MTLDevice> device, const PipelineState& state)
             noexcept;
+
+    // When set, pipelines are looked up in this archive first, and added to it otherwise.
+    API_AVAILABLE(macos(11.0), ios(14.0))
+    id<MTLBinaryArchive> binaryArchive = nil;
+    bool binaryArchiveModified = false;
 };
 
 using PipelineStateTracker = StateTracker<PipelineState>;
@@ -336,6 +345,24 @@ struct SamplerStateCreator {
 
 using SamplerStateCache = StateCache<SamplerState, id<MTLSamplerState>, SamplerStateCreator>;
 
+// Textures and samplers, bound to both the vertex and fragment stages
+
+struct SamplerBindingsState {
+    id<MTLTexture> textures[SAMPLER_BINDING_COUNT] = {};
+    id<MTLSamplerState> samplers[SAMPLER_BINDING_COUNT] = {};
+
+    bool operator==(const SamplerBindingsState& rhs) const noexcept {
+        return std::equal(std::begin(textures), std::end(textures), std::begin(rhs.textures)) &&
+               std::equal(std::begin(samplers), std::end(samplers), std::begin(rhs.samplers));
+    }
+
+    bool operator!=(const SamplerBindingsState& rhs) const noexcept {
+        return !operator==(rhs);
+    }
+};
+
+using SamplerBindingsStateTracker = StateTracker<SamplerBindingsState>;
+
 // Raster-related state
 
 using CullModeStateTracker = StateTracker<MTLCullMode>;
@@ -83,9 +83,24 @@ id<MTLRenderPipelineState> PipelineStateCreator::operator()(id<MTLDevice> device
     // MSAA
     descriptor.rasterSampleCount = state.sampleCount;
 
+    id<MTLRenderPipelineState> pipeline = nil;
+    if (@available(macOS 11.0, iOS 14.0, *)) {
+        if (binaryArchive) {
+            descriptor.binaryArchives = @[binaryArchive];
+            // a miss isn't an error, the pipeline is then added to the archive and compiled
+            pipeline = [device newRenderPipelineStateWithDescriptor:descriptor
+                    options:MTLPipelineOptionFailOnBinaryArchiveMiss reflection:nil error:nil];
+            if (pipeline == nil &&
+                    [binaryArchive addRenderPipelineFunctionsWithDescriptor:descriptor error:nil]) {
+                binaryArchiveModified = true;
+            }
+        }
+    }
+
     NSError* error = nullptr;
-    id<MTLRenderPipelineState> pipeline = [device newRenderPipelineStateWithDescriptor:descriptor
-                                                                                 error:&error];
+    if (pipeline == nil) {
+        pipeline = [device newRenderPipelineStateWithDescriptor:descriptor error:&error];
+    }
     if (error) {
         auto description = [error.localizedDescription cStringUsingEncoding:NSUTF8StringEncoding];
         utils::slog.e << description << utils::io::endl;
@@ -85,9 +85,21 @@ void NoopDriver::destroyVertexBuffer(Handle<HwVertexBuffer> vbh) {
 void NoopDriver::destroyIndexBuffer(Handle<HwIndexBuffer> ibh) {
 }
 
+void NoopDriver::destroyBufferObject(Handle<HwBufferObject> boh) {
+}
+
 void NoopDriver::destroyTexture(Handle<HwTexture> th) {
 }
 
+void NoopDriver::destroyRenderPrimitives(Handle<HwRenderPrimitive> const* rphs, uint32_t count) {
+}
+
+void NoopDriver::destroyTextures(Handle<HwTexture> const* ths, uint32_t count) {
+}
+
+void NoopDriver::createRenderPrimitives(Handle<HwRenderPrimitive> const* rphs, uint32_t count) {
+}
+
 void NoopDriver::destroyProgram(Handle<HwProgram> ph) {
 }
 
@@ -156,10 +168,32 @@ bool NoopDriver::isFrameBufferFetchSupported() {
     return false;
 }
 
+bool NoopDriver::isParallelShaderCompileSupported() {
+    return false;
+}
+
 bool NoopDriver::isFrameTimeSupported() {
     return true;
 }
 
+uint64_t NoopDriver::getAllocatedGpuMemory() {
+    return 0;
+}
+
+GpuMemoryPoolStats NoopDriver::getGpuMemoryPoolStats() {
+    return {};
+}
+
+void NoopDriver::allocateRenderPrimitives(Handle<HwRenderPrimitive>* rphs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        rphs[i] = Handle<HwRenderPrimitive>((HandleBase::HandleId)0xDEAD0000);
+    }
+}
+
+bool NoopDriver::isComputeSupported() {
+    return false;
+}
+
 bool NoopDriver::areFeedbackLoopsSupported() {
     return true;
 }
@@ -232,6 +266,15 @@ void NoopDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor
     scheduleDestroy(std::move(data));
 }
 
+void NoopDriver::updateUniformBuffers(BufferDescriptor&& updates) {
+    scheduleDestroy(std::move(updates));
+}
+
+void NoopDriver::updateBufferObject(Handle<HwBufferObject> boh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    scheduleDestroy(std::move(data));
+}
+
 void NoopDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
         SamplerGroup&& samplerGroup) {
 }
@@ -268,6 +311,13 @@ void NoopDriver::bindUniformBufferRange(size_t index, Handle<HwUniformBuffer> ub
         size_t offset, size_t size) {
 }
 
+void NoopDriver::bindBufferObject(uint8_t index, Handle<HwBufferObject> boh) {
+}
+
+void NoopDriver::bindVertexBufferStorage(uint8_t index, Handle<HwVertexBuffer> vbh,
+        uint8_t bufferIndex) {
+}
+
 void NoopDriver::bindSamplers(size_t index, Handle<HwSamplerGroup> sbh) {
 }
 
@@ -303,7 +353,14 @@ void NoopDriver::blit(TargetBufferFlags buffers,
         SamplerMagFilter filter) {
 }
 
-void NoopDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> rph) {
+void NoopDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
+}
+
+void NoopDriver::bindImage(uint8_t unit, Handle<HwTexture> th, uint8_t level) {
+}
+
+void NoopDriver::dispatchCompute(Handle<HwProgram> ph, math::uint3 workGroupCount) {
 }
 
 void NoopDriver::beginTimerQuery(Handle<HwTimerQuery> tqh) {
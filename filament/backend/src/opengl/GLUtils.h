@@ -108,6 +108,15 @@ constexpr inline GLenum getBufferUsage(backend::BufferUsage usage) noexcept {
     }
 }
 
+constexpr inline GLenum getBufferObjectBinding(backend::BufferObjectBinding bindingType) noexcept {
+    switch (bindingType) {
+        case backend::BufferObjectBinding::UNIFORM:
+            return GL_UNIFORM_BUFFER;
+        case backend::BufferObjectBinding::SHADER_STORAGE:
+            return GL_SHADER_STORAGE_BUFFER;
+    }
+}
+
 constexpr inline GLboolean getNormalization(bool normalized) noexcept {
     return GLboolean(normalized ? GL_TRUE : GL_FALSE);
 }
@@ -485,6 +494,16 @@ constexpr /* inline */ GLenum getInternalFormat(backend::TextureFormat format) n
             // this should not happen
             return 0;
 #endif
+
+#if defined(GL_EXT_texture_compression_bptc) || defined(GL_ARB_texture_compression_bptc)
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT:   return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+#else
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT:
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT:
+            // this should not happen
+            return 0;
+#endif
         case TextureFormat::UNUSED:
             return 0;
     }
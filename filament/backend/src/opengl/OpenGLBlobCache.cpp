@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OpenGLBlobCache.h"
+
+#include <backend/Platform.h>
+
+#include <utils/compiler.h>
+
+#include <vector>
+
+#include <string.h>
+
+namespace filament {
+
+using namespace backend;
+using namespace utils;
+
+// FNV-1a, we need a 64-bits hash of arbitrarily sized data
+static uint64_t hash64(void const* data, size_t size, uint64_t h = 0xcbf29ce484222325u) noexcept {
+    uint8_t const* p = (uint8_t const*)data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3u;
+    }
+    return h;
+}
+
+static uint64_t hash64(char const* s, uint64_t h) noexcept {
+    return s ? hash64(s, strlen(s), h) : h;
+}
+
+OpenGLBlobCache::OpenGLBlobCache() noexcept {
+#if !defined(__EMSCRIPTEN__)
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    mSupported = formatCount > 0;
+
+    uint64_t h = hash64((char const*)glGetString(GL_VENDOR), 0xcbf29ce484222325u);
+    h = hash64((char const*)glGetString(GL_RENDERER), h);
+    h = hash64((char const*)glGetString(GL_VERSION), h);
+    mDriverHash = h;
+#endif
+}
+
+bool OpenGLBlobCache::isEnabled(Platform& platform) const noexcept {
+    return mSupported && platform.hasBlobFunc();
+}
+
+OpenGLBlobCache::Key OpenGLBlobCache::getKey(Program const& program) const noexcept {
+    Key key = { { 'F', 'G', 'L', 'P', 'R', 'G', '0', '2' } };
+    key.driverHash = mDriverHash;
+    auto const& sources = program.getShadersSource();
+    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+        key.sourceHash[i] = hash64(sources[i].data(), sources[i].size());
+        key.sourceSize[i] = uint32_t(sources[i].size());
+    }
+    // the specialization constants are defined in the sources
+    for (auto const& constant : program.getSpecializationConstants()) {
+        uint32_t value[3] = { constant.id, uint32_t(constant.value.index()), 0 };
+        std::visit([&value](auto v) { memcpy(&value[2], &v, sizeof(v)); }, constant.value);
+        for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+            key.sourceHash[i] = hash64(value, sizeof(value), key.sourceHash[i]);
+        }
+    }
+    return key;
+}
+
+GLuint OpenGLBlobCache::retrieve(UTILS_UNUSED Platform& platform,
+        UTILS_UNUSED Key const& key) noexcept {
+#if !defined(__EMSCRIPTEN__)
+    size_t const size = platform.retrieveBlob(&key, sizeof(key), nullptr, 0);
+    if (size <= sizeof(GLenum)) {
+        mMissCount++;
+        return 0;
+    }
+
+    std::vector<uint8_t> blob(size);
+    if (platform.retrieveBlob(&key, sizeof(key), blob.data(), size) != size) {
+        mMissCount++;
+        return 0;
+    }
+
+    GLenum format;
+    memcpy(&format, blob.data(), sizeof(format));
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, blob.data() + sizeof(format), GLsizei(size - sizeof(format)));
+
+    // The driver is allowed to reject a binary at any time (e.g. after a driver update), in
+    // which case we simply fallback to compiling the program.
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (UTILS_UNLIKELY(status != GL_TRUE)) {
+        glDeleteProgram(program);
+        mRejectedCount++;
+        mMissCount++;
+        return 0;
+    }
+
+    mHitCount++;
+    return program;
+#else
+    return 0;
+#endif
+}
+
+void OpenGLBlobCache::prepareForBinary(UTILS_UNUSED GLuint program) const noexcept {
+#if !defined(__EMSCRIPTEN__)
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+}
+
+void OpenGLBlobCache::insert(UTILS_UNUSED Platform& platform, UTILS_UNUSED Key const& key,
+        UTILS_UNUSED GLuint program) noexcept {
+#if !defined(__EMSCRIPTEN__)
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<uint8_t> blob(sizeof(GLenum) + length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, blob.data() + sizeof(GLenum));
+    if (UTILS_UNLIKELY(glGetError() != GL_NO_ERROR)) {
+        return;
+    }
+    memcpy(blob.data(), &format, sizeof(format));
+    platform.insertBlob(&key, sizeof(key), blob.data(), sizeof(GLenum) + length);
+#endif
+}
+
+} // namespace filament
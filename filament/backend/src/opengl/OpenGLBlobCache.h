@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_OPENGLBLOBCACHE_H
+#define TNT_FILAMENT_DRIVER_OPENGLBLOBCACHE_H
+
+#include "private/backend/Program.h"
+
+#include "gl_headers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+namespace backend {
+class Platform;
+} // namespace backend
+
+/*
+ * OpenGLBlobCache stores linked program binaries (glGetProgramBinary) using the Platform's
+ * blob callbacks and restores them (glProgramBinary) the next time the same program is created,
+ * skipping GLSL compilation and linking entirely.
+ *
+ * The cache key is made of a hash of the shader sources and a hash of the GL driver identity
+ * (vendor, renderer and version strings), so that a binary is never fed to a different driver.
+ * A binary rejected by the driver is simply ignored, the caller then compiles the program normally.
+ */
+class OpenGLBlobCache {
+public:
+    struct Key {
+        char tag[8];
+        uint64_t driverHash;
+        uint64_t sourceHash[backend::Program::SHADER_TYPE_COUNT];
+        uint32_t sourceSize[backend::Program::SHADER_TYPE_COUNT];
+    };
+
+    // must be constructed with a current GL context
+    OpenGLBlobCache() noexcept;
+
+    // whether program binaries are supported by this driver and the platform has a storage
+    bool isEnabled(backend::Platform& platform) const noexcept;
+
+    // computes the key for the given program
+    Key getKey(backend::Program const& program) const noexcept;
+
+    // Returns a linked program retrieved from the cache, or 0 on a miss or if the driver rejected
+    // the binary. The program must be created with prepareForBinary() before linking.
+    GLuint retrieve(backend::Platform& platform, Key const& key) noexcept;
+
+    // must be called before linking a program that will be inserted in the cache
+    void prepareForBinary(GLuint program) const noexcept;
+
+    // stores the binary of the given linked program into the cache
+    void insert(backend::Platform& platform, Key const& key, GLuint program) noexcept;
+
+    uint32_t getHitCount() const noexcept { return mHitCount; }
+    uint32_t getMissCount() const noexcept { return mMissCount; }
+    uint32_t getRejectedCount() const noexcept { return mRejectedCount; }
+
+private:
+    // a blob is the binary format (a GLenum) immediately followed by the binary itself
+    uint64_t mDriverHash = 0;
+    uint32_t mHitCount = 0;
+    uint32_t mMissCount = 0;
+    uint32_t mRejectedCount = 0;
+    bool mSupported = false;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_OPENGLBLOBCACHE_H
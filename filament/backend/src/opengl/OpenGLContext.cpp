@@ -111,6 +111,11 @@ OpenGLContext::OpenGLContext() noexcept {
         }
         if (major == 3 && minor >= 1) {
             features.multisample_texture = true;
+#ifdef GL_COMPUTE_ENTRY_POINTS_IMPORTED
+            features.compute_shader = glDispatchCompute && glBindImageTexture && glMemoryBarrier;
+#else
+            features.compute_shader = HAS_COMPUTE_ENTRY_POINTS;
+#endif
         }
         initExtensionsGLES(major, minor, exts);
     } else if (GL41_HEADERS) {
@@ -119,6 +124,7 @@ OpenGLContext::OpenGLContext() noexcept {
         }
         initExtensionsGL(major, minor, exts);
         features.multisample_texture = true;
+        features.compute_shader = GL43_HEADERS && (major > 4 || (major == 4 && minor >= 3));
     };
     assert(shaderModel != ShaderModel::UNKNOWN);
     mShaderModel = shaderModel;
@@ -231,12 +237,14 @@ void OpenGLContext::initExtensionsGLES(GLint major, GLint minor, ExtentionSet co
     ext.texture_filter_anisotropic = hasExtension(exts, "GL_EXT_texture_filter_anisotropic");
     ext.texture_compression_etc2 = true;
     ext.QCOM_tiled_rendering = hasExtension(exts, "GL_QCOM_tiled_rendering");
+    ext.QCOM_framebuffer_foveated = hasExtension(exts, "GL_QCOM_framebuffer_foveated");
     ext.OES_EGL_image_external_essl3 = hasExtension(exts, "GL_OES_EGL_image_external_essl3");
     ext.EXT_debug_marker = hasExtension(exts, "GL_EXT_debug_marker");
     ext.EXT_color_buffer_half_float = hasExtension(exts, "GL_EXT_color_buffer_half_float");
     ext.EXT_color_buffer_float = hasExtension(exts, "GL_EXT_color_buffer_float");
     ext.APPLE_color_buffer_packed_float = hasExtension(exts, "GL_APPLE_color_buffer_packed_float");
     ext.texture_compression_s3tc = hasExtension(exts, "WEBGL_compressed_texture_s3tc");
+    ext.texture_compression_bptc = hasExtension(exts, "GL_EXT_texture_compression_bptc");
     ext.EXT_multisampled_render_to_texture = hasExtension(exts, "GL_EXT_multisampled_render_to_texture");
     ext.EXT_multisampled_render_to_texture2 = hasExtension(exts, "GL_EXT_multisampled_render_to_texture2");
     ext.EXT_disjoint_timer_query = hasExtension(exts, "GL_EXT_disjoint_timer_query");
@@ -244,6 +252,8 @@ void OpenGLContext::initExtensionsGLES(GLint major, GLint minor, ExtentionSet co
     ext.EXT_texture_compression_s3tc_srgb = hasExtension(exts, "GL_EXT_texture_compression_s3tc_srgb");
     ext.EXT_shader_framebuffer_fetch = hasExtension(exts, "GL_EXT_shader_framebuffer_fetch");
     ext.EXT_clip_control = hasExtension(exts, "GL_EXT_clip_control");
+    ext.EXT_buffer_storage = hasExtension(exts, "GL_EXT_buffer_storage");
+    ext.KHR_parallel_shader_compile = hasExtension(exts, "GL_KHR_parallel_shader_compile");
     // ES 3.2 implies EXT_color_buffer_float
     if (major >= 3 && minor >= 2) {
         ext.EXT_color_buffer_float = true;
@@ -254,6 +264,8 @@ void OpenGLContext::initExtensionsGL(GLint major, GLint minor, ExtentionSet cons
     ext.texture_filter_anisotropic = hasExtension(exts, "GL_EXT_texture_filter_anisotropic");
     ext.texture_compression_etc2 = hasExtension(exts, "GL_ARB_ES3_compatibility");
     ext.texture_compression_s3tc = hasExtension(exts, "GL_EXT_texture_compression_s3tc");
+    ext.texture_compression_bptc = hasExtension(exts, "GL_ARB_texture_compression_bptc") ||
+            major > 4 || (major == 4 && minor >= 2);
     ext.OES_EGL_image_external_essl3 = hasExtension(exts, "GL_OES_EGL_image_external_essl3");
     ext.EXT_debug_marker = hasExtension(exts, "GL_EXT_debug_marker");
     ext.EXT_color_buffer_half_float = true;  // Assumes core profile.
@@ -263,6 +275,10 @@ void OpenGLContext::initExtensionsGL(GLint major, GLint minor, ExtentionSet cons
     ext.EXT_texture_sRGB = hasExtension(exts, "GL_EXT_texture_sRGB");
     ext.EXT_shader_framebuffer_fetch = hasExtension(exts, "GL_EXT_shader_framebuffer_fetch");
     ext.EXT_clip_control = hasExtension(exts, "GL_ARB_clip_control") || (major == 4 && minor >= 5);
+    ext.EXT_buffer_storage =
+            hasExtension(exts, "GL_ARB_buffer_storage") || (major == 4 && minor >= 4);
+    ext.KHR_parallel_shader_compile = hasExtension(exts, "GL_KHR_parallel_shader_compile") ||
+            hasExtension(exts, "GL_ARB_parallel_shader_compile");
 }
 
 void OpenGLContext::bindBuffer(GLenum target, GLuint buffer) noexcept {
@@ -358,7 +374,17 @@ void OpenGLContext::deleteBuffers(GLsizei n, const GLuint* buffers, GLenum targe
             genericBuffer = 0;
         }
     }
-    if (target == GL_UNIFORM_BUFFER || target == GL_TRANSFORM_FEEDBACK_BUFFER) {
+    // any buffer can be the destination of a copy from the staging buffer
+    auto& copyWriteBuffer =
+            state.buffers.genericBinding[getIndexForBufferTarget(GL_COPY_WRITE_BUFFER)];
+    #pragma nounroll
+    for (GLsizei i = 0; i < n; ++i) {
+        if (copyWriteBuffer == buffers[i]) {
+            copyWriteBuffer = 0;
+        }
+    }
+    if (target == GL_UNIFORM_BUFFER || target == GL_TRANSFORM_FEEDBACK_BUFFER ||
+            target == GL_SHADER_STORAGE_BUFFER) {
         auto& indexedBuffer = state.buffers.targets[targetIndex];
         #pragma nounroll // clang generates >1 KiB of code!!
         for (GLsizei i = 0; i < n; ++i) {
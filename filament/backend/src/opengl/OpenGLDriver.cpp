@@ -18,11 +18,13 @@
 
 #include "private/backend/DriverApi.h"
 #include "private/backend/OpenGLPlatform.h"
+#include "private/backend/UniformBufferUpdate.h"
 
 #include "CommandStreamDispatcher.h"
 #include "OpenGLBlitter.h"
 #include "OpenGLDriverFactory.h"
 #include "OpenGLProgram.h"
+#include "OpenGLStagingBuffer.h"
 #include "TimerQuery.h"
 #include "OpenGLContext.h"
 
@@ -45,6 +47,9 @@
 #define HAS_MAPBUFFERS 1
 #endif
 
+// texture uploads of at least this size go through a pixel unpack buffer
+static constexpr size_t UNPACK_BUFFER_MIN_SIZE = 256u * 1024u;
+
 #define DEBUG_MARKER_NONE       0
 #define DEBUG_MARKER_OPENGL     1
 
@@ -133,8 +138,9 @@ OpenGLDriver::OpenGLDriver(OpenGLPlatform* platform) noexcept
         : DriverBase(new ConcreteDispatcher<OpenGLDriver>()),
           mHandleArena("Handles", FILAMENT_OPENGL_HANDLE_ARENA_SIZE_IN_MB * 1024U * 1024U), // TODO: set the amount in configuration
           mSamplerMap(32),
-          mPlatform(*platform) {
-  
+          mPlatform(*platform),
+          mUniformBufferAllocator(mContext) {
+
     std::fill(mSamplerBindings.begin(), mSamplerBindings.end(), nullptr);
 
     // set a reasonable default value for our stream array
@@ -151,6 +157,15 @@ OpenGLDriver::OpenGLDriver(OpenGLPlatform* platform) noexcept
         mContext.resetProgram();
     }
 
+    // Initialize the staging buffer only if we can map it persistently
+    if (mContext.ext.EXT_buffer_storage) {
+        mStagingBuffer = new OpenGLStagingBuffer(mContext);
+        if (!mStagingBuffer->init()) {
+            delete mStagingBuffer;
+            mStagingBuffer = nullptr;
+        }
+    }
+
     if (mContext.ext.EXT_disjoint_timer_query || GL41_HEADERS) {
         // timer queries are available
         if (mContext.bugs.dont_use_timer_query && mPlatform.canCreateFence()) {
@@ -173,6 +188,7 @@ OpenGLDriver::OpenGLDriver(OpenGLPlatform* platform) noexcept
 
 OpenGLDriver::~OpenGLDriver() noexcept {
     delete mOpenGLBlitter;
+    delete mStagingBuffer;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -197,9 +213,28 @@ void OpenGLDriver::terminate() {
     if (mOpenGLBlitter) {
         mOpenGLBlitter->terminate();
     }
+    if (mStagingBuffer) {
+        mStagingBuffer->terminate();
+    }
+    mUniformBufferAllocator.terminate();
+    if (mUnpackBuffer) {
+        mContext.deleteBuffers(1, &mUnpackBuffer, GL_PIXEL_UNPACK_BUFFER);
+    }
+    for (PixelPackBuffer const& buffer : mPixelPackBuffers) {
+        mContext.deleteBuffers(1, &buffer.pbo, GL_PIXEL_PACK_BUFFER);
+    }
+    mPixelPackBuffers.clear();
 
     delete mTimerQueryImpl;
 
+#ifndef NDEBUG
+    if (mBlobCache.getHitCount() || mBlobCache.getMissCount()) {
+        slog.d << "Program binary cache: " << mBlobCache.getHitCount() << " hits, "
+                << mBlobCache.getMissCount() << " misses ("
+                << mBlobCache.getRejectedCount() << " rejected)" << io::endl;
+    }
+#endif
+
     mPlatform.terminate();
 }
 
@@ -217,6 +252,9 @@ void OpenGLDriver::bindTexture(GLuint unit, GLTexture const* t) noexcept {
 }
 
 void OpenGLDriver::useProgram(OpenGLProgram* p) noexcept {
+    if (UTILS_UNLIKELY(p->isPending())) {
+        p->initialize(this);
+    }
     mContext.useProgram(p->gl.program);
     // set-up textures and samplers in the proper TMUs (as specified in setSamplers)
     p->use(this);
@@ -292,6 +330,7 @@ void OpenGLDriver::setRasterStateSlow(RasterState rs) noexcept {
 // For reference on a 64-bits machine:
 //    GLFence                   :  8
 //    GLIndexBuffer             : 12        moderate
+//    GLBufferObject            : 36        few
 //    GLSamplerGroup            : 16        moderate
 // -- less than 16 bytes
 
@@ -347,7 +386,7 @@ void OpenGLDriver::HandleAllocator::free(void* p, size_t size) noexcept {
 
 
 // This is "NOINLINE" because it ends-up generating more code than we'd like because of
-// the locking (unfortunately, mHandleArena is accessed from 2 threads)
+// the atomic free lists (unfortunately, mHandleArena is accessed from 2 threads)
 UTILS_NOINLINE
 HandleBase::HandleId OpenGLDriver::allocateHandle(size_t size) noexcept {
     void* addr = mHandleArena.alloc(size);
@@ -416,6 +455,12 @@ Handle<HwRenderPrimitive> OpenGLDriver::createRenderPrimitiveS() noexcept {
     return initHandle<GLRenderPrimitive>();
 }
 
+void OpenGLDriver::allocateRenderPrimitives(Handle<HwRenderPrimitive>* rphs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        rphs[i] = initHandle<GLRenderPrimitive>();
+    }
+}
+
 Handle<HwProgram> OpenGLDriver::createProgramS() noexcept {
     return initHandle<OpenGLProgram>();
 }
@@ -428,6 +473,10 @@ Handle<HwUniformBuffer> OpenGLDriver::createUniformBufferS() noexcept {
     return initHandle<GLUniformBuffer>();
 }
 
+Handle<HwBufferObject> OpenGLDriver::createBufferObjectS() noexcept {
+    return initHandle<GLBufferObject>();
+}
+
 Handle<HwTexture> OpenGLDriver::createTextureS() noexcept {
     return initHandle<GLTexture>();
 }
@@ -484,6 +533,7 @@ void OpenGLDriver::createVertexBufferR(
     auto& gl = mContext;
     GLVertexBuffer* vb = construct<GLVertexBuffer>(vbh,
             bufferCount, attributeCount, elementCount, attributes);
+    vb->gl.usage = usage;
 
     GLsizei n = GLsizei(vb->bufferCount);
 
@@ -516,6 +566,7 @@ void OpenGLDriver::createIndexBufferR(
     auto& gl = mContext;
     uint8_t elementSize = static_cast<uint8_t>(getElementTypeSize(elementType));
     GLIndexBuffer* ib = construct<GLIndexBuffer>(ibh, elementSize, indexCount);
+    ib->gl.usage = usage;
     glGenBuffers(1, &ib->gl.buffer);
     GLsizeiptr size = elementSize * indexCount;
     gl.bindVertexArray(nullptr);
@@ -532,6 +583,22 @@ void OpenGLDriver::createRenderPrimitiveR(Handle<HwRenderPrimitive> rph, int) {
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::createRenderPrimitives(Handle<HwRenderPrimitive> const* rphs, uint32_t count) {
+    DEBUG_MARKER()
+
+    // generate the vertex array objects by batches
+    GLuint vaos[64];
+    for (uint32_t first = 0; first < count; first += 64) {
+        const uint32_t n = std::min(count - first, 64u);
+        glGenVertexArrays(GLsizei(n), vaos);
+        for (uint32_t i = 0; i < n; i++) {
+            Handle<HwRenderPrimitive> rph = rphs[first + i];
+            handle_cast<GLRenderPrimitive*>(rph)->gl.vao = vaos[i];
+        }
+    }
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 void OpenGLDriver::createProgramR(Handle<HwProgram> ph, Program&& program) {
     DEBUG_MARKER()
 
@@ -553,12 +620,38 @@ void OpenGLDriver::createUniformBufferR(
 
     auto& gl = mContext;
     GLUniformBuffer* ub = construct<GLUniformBuffer>(ubh, size, usage);
+
+    // STREAM buffers cycle through their own storage (see updateBuffer), they can't be packed
+    if (usage != BufferUsage::STREAM) {
+        auto allocation = mUniformBufferAllocator.allocate((uint32_t)size);
+        if (allocation.id) {
+            ub->gl.ubo.id = allocation.id;
+            ub->gl.ubo.offset = allocation.offset;
+            ub->gl.ubo.suballocated = true;
+            return;
+        }
+    }
+
     glGenBuffers(1, &ub->gl.ubo.id);
     gl.bindBuffer(GL_UNIFORM_BUFFER, ub->gl.ubo.id);
     glBufferData(GL_UNIFORM_BUFFER, size, nullptr, getBufferUsage(usage));
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::createBufferObjectR(Handle<HwBufferObject> boh,
+        uint32_t byteCount, BufferObjectBinding bindingType, BufferUsage usage) {
+    DEBUG_MARKER()
+    assert(bindingType != BufferObjectBinding::SHADER_STORAGE || mContext.features.compute_shader);
+
+    auto& gl = mContext;
+    GLBufferObject* bo = construct<GLBufferObject>(boh, byteCount, bindingType, usage);
+    bo->gl.binding = getBufferObjectBinding(bindingType);
+    glGenBuffers(1, &bo->gl.buffer.id);
+    gl.bindBuffer(bo->gl.binding, bo->gl.buffer.id);
+    glBufferData(bo->gl.binding, byteCount, nullptr, getBufferUsage(usage));
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 
 UTILS_NOINLINE
 void OpenGLDriver::textureStorage(OpenGLDriver::GLTexture* t,
@@ -1243,11 +1336,39 @@ void OpenGLDriver::destroyUniformBuffer(Handle<HwUniformBuffer> ubh) {
     if (ubh) {
         auto& gl = mContext;
         GLUniformBuffer* ub = handle_cast<GLUniformBuffer*>(ubh);
-        gl.deleteBuffers(1, &ub->gl.ubo.id, GL_UNIFORM_BUFFER);
+        if (ub->gl.ubo.suballocated) {
+            mUniformBufferAllocator.free({ ub->gl.ubo.id, ub->gl.ubo.offset },
+                    ub->gl.ubo.capacity);
+        } else {
+            gl.deleteBuffers(1, &ub->gl.ubo.id, GL_UNIFORM_BUFFER);
+        }
         destruct(ubh, ub);
     }
 }
 
+void OpenGLDriver::destroyBufferObject(Handle<HwBufferObject> boh) {
+    DEBUG_MARKER()
+    if (boh) {
+        auto& gl = mContext;
+        GLBufferObject* bo = handle_cast<GLBufferObject*>(boh);
+        gl.deleteBuffers(1, &bo->gl.buffer.id, bo->gl.binding);
+        destruct(boh, bo);
+    }
+}
+
+void OpenGLDriver::destroyRenderPrimitives(Handle<HwRenderPrimitive> const* rphs,
+        uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        destroyRenderPrimitive(rphs[i]);
+    }
+}
+
+void OpenGLDriver::destroyTextures(Handle<HwTexture> const* ths, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        destroyTexture(ths[i]);
+    }
+}
+
 void OpenGLDriver::destroyTexture(Handle<HwTexture> th) {
     DEBUG_MARKER()
 
@@ -1476,6 +1597,9 @@ bool OpenGLDriver::isTextureFormatSupported(TextureFormat format) {
             return gl.ext.texture_compression_s3tc;
         }
     }
+    if (isBPTCCompression(format)) {
+        return gl.ext.texture_compression_bptc && getInternalFormat(format) != 0;
+    }
     return getInternalFormat(format) != 0;
 }
 
@@ -1574,10 +1698,30 @@ bool OpenGLDriver::isFrameBufferFetchSupported() {
     return gl.ext.EXT_shader_framebuffer_fetch;
 }
 
+bool OpenGLDriver::isParallelShaderCompileSupported() {
+    auto& gl = mContext;
+    return gl.ext.KHR_parallel_shader_compile;
+}
+
 bool OpenGLDriver::isFrameTimeSupported() {
     return mFrameTimeSupported;
 }
 
+uint64_t OpenGLDriver::getAllocatedGpuMemory() {
+    // OpenGL has no portable query, the engine computes the sizes of its resources instead
+    return 0;
+}
+
+GpuMemoryPoolStats OpenGLDriver::getGpuMemoryPoolStats() {
+    // the allocations are made by the GL driver
+    return {};
+}
+
+bool OpenGLDriver::isComputeSupported() {
+    auto& gl = mContext;
+    return gl.features.compute_shader;
+}
+
 bool OpenGLDriver::areFeedbackLoopsSupported() {
     return !mContext.bugs.disable_feedback_loops;
 }
@@ -1618,8 +1762,10 @@ void OpenGLDriver::updateVertexBuffer(Handle<HwVertexBuffer> vbh,
     auto& gl = mContext;
     GLVertexBuffer* eb = handle_cast<GLVertexBuffer *>(vbh);
 
-    gl.bindBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[index]);
-    glBufferSubData(GL_ARRAY_BUFFER, byteOffset, p.size, p.buffer);
+    if (!stageBufferUpdate(eb->gl.usage, eb->gl.buffers[index], byteOffset, p)) {
+        gl.bindBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[index]);
+        glBufferSubData(GL_ARRAY_BUFFER, byteOffset, p.size, p.buffer);
+    }
 
     scheduleDestroy(std::move(p));
 
@@ -1634,9 +1780,11 @@ void OpenGLDriver::updateIndexBuffer(
     GLIndexBuffer* ib = handle_cast<GLIndexBuffer *>(ibh);
     assert(ib->elementSize == 2 || ib->elementSize == 4);
 
-    gl.bindVertexArray(nullptr);
-    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib->gl.buffer);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, byteOffset, p.size, p.buffer);
+    if (!stageBufferUpdate(ib->gl.usage, ib->gl.buffer, byteOffset, p)) {
+        gl.bindVertexArray(nullptr);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib->gl.buffer);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, byteOffset, p.size, p.buffer);
+    }
 
     scheduleDestroy(std::move(p));
 
@@ -1656,11 +1804,54 @@ void OpenGLDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescript
     scheduleDestroy(std::move(p));
 }
 
+void OpenGLDriver::updateUniformBuffers(BufferDescriptor&& updates) {
+    DEBUG_MARKER()
+
+    auto& gl = mContext;
+    char const* const end = static_cast<char const*>(updates.buffer) + updates.size;
+    for (auto u = static_cast<UniformBufferUpdate const*>(updates.buffer);
+            reinterpret_cast<char const*>(u) < end; u = u->next()) {
+        GLUniformBuffer* ub = handle_cast<GLUniformBuffer *>(u->ubh);
+        if (u->byteOffset == 0 && u->byteSize == ub->gl.ubo.capacity) {
+            updateBuffer(GL_UNIFORM_BUFFER, &ub->gl.ubo,
+                    BufferDescriptor(u->getData(), u->byteSize),
+                    (uint32_t)gl.gets.uniform_buffer_offset_alignment);
+        } else if (u->byteSize > 0) {
+            updateBufferRange(GL_UNIFORM_BUFFER, &ub->gl.ubo,
+                    u->getData(), u->byteSize, u->byteOffset);
+        }
+    }
+    scheduleDestroy(std::move(updates));
+}
+
+void OpenGLDriver::updateBufferObject(
+        Handle<HwBufferObject> boh, BufferDescriptor&& bd, uint32_t byteOffset) {
+    DEBUG_MARKER()
+    auto& gl = mContext;
+    GLBufferObject* bo = handle_cast<GLBufferObject*>(boh);
+    assert(byteOffset + bd.size <= bo->byteCount);
+
+    if (!stageBufferUpdate(bo->gl.buffer.usage, bo->gl.buffer.id, byteOffset, bd)) {
+        gl.bindBuffer(bo->gl.binding, bo->gl.buffer.id);
+        glBufferSubData(bo->gl.binding, byteOffset, bd.size, bd.buffer);
+    }
+    scheduleDestroy(std::move(bd));
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 void OpenGLDriver::updateBuffer(GLenum target,
         GLBuffer* buffer, BufferDescriptor const& p, uint32_t alignment) noexcept {
     assert(buffer->capacity >= p.size);
     assert(buffer->id);
 
+    if (stageBufferUpdate(buffer->usage, buffer->id, buffer->offset, p)) {
+        // the copy is ordered with the draws using the previous content, so we don't need to
+        // move to another part of the buffer
+        buffer->base = 0;
+        buffer->size = (uint32_t)p.size;
+        return;
+    }
+
     auto& gl = mContext;
     gl.bindBuffer(target, buffer->id);
     if (buffer->usage == BufferUsage::STREAM) {
@@ -1705,7 +1896,10 @@ void OpenGLDriver::updateBuffer(GLenum target,
         }
     }
 
-    if (p.size == buffer->capacity) {
+    if (buffer->suballocated) {
+        // the rest of the GL buffer belongs to other uniform buffers
+        glBufferSubData(target, buffer->offset, p.size, p.buffer);
+    } else if (p.size == buffer->capacity) {
         // it looks like it's generally faster (or not worse) to use glBufferData()
         glBufferData(target, buffer->capacity, p.buffer, getBufferUsage(buffer->usage));
     } else {
@@ -1719,6 +1913,29 @@ void OpenGLDriver::updateBuffer(GLenum target,
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::updateBufferRange(GLenum target, GLBuffer* buffer, void const* data,
+        uint32_t size, uint32_t byteOffset) noexcept {
+    assert(byteOffset + size <= buffer->capacity);
+    assert(buffer->id);
+
+    // the rest of the content is kept, so the range is updated where the current content is,
+    // glBufferSubData() is ordered with the draws using the previous content
+    const uint32_t offset = buffer->offset + buffer->base + byteOffset;
+    if (!stageBufferUpdate(buffer->usage, buffer->id, offset, BufferDescriptor(data, size))) {
+        mContext.bindBuffer(target, buffer->id);
+        glBufferSubData(target, offset, size, data);
+    }
+    buffer->size = std::max(buffer->size, byteOffset + size);
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+bool OpenGLDriver::stageBufferUpdate(BufferUsage usage, GLuint buffer, uint32_t byteOffset,
+        BufferDescriptor const& p) noexcept {
+    // STATIC buffers are rarely updated, glBufferSubData() is good enough for them
+    return mStagingBuffer && usage != BufferUsage::STATIC &&
+            mStagingBuffer->copy(buffer, byteOffset, p.buffer, (uint32_t)p.size);
+}
 
 void OpenGLDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
         SamplerGroup&& samplerGroup) {
@@ -1840,6 +2057,10 @@ void OpenGLDriver::setTextureData(GLTexture* t,
     gl.pixelStore(GL_UNPACK_SKIP_PIXELS, p.left);
     gl.pixelStore(GL_UNPACK_SKIP_ROWS, p.top);
 
+    // with an unpack buffer bound, the pixels are addressed by their offset in it
+    const bool unpackBuffer = bindUnpackBuffer(p);
+    uint8_t const* const pixels = unpackBuffer ? nullptr : static_cast<uint8_t const*>(p.buffer);
+
     switch (t->target) {
         case SamplerType::SAMPLER_EXTERNAL:
             // if we get there, it's because the user is trying to use an external texture
@@ -1852,7 +2073,7 @@ void OpenGLDriver::setTextureData(GLTexture* t,
             assert(t->gl.target == GL_TEXTURE_2D);
             glTexSubImage2D(t->gl.target, GLint(level),
                     GLint(xoffset), GLint(yoffset),
-                    width, height, glFormat, glType, p.buffer);
+                    width, height, glFormat, glType, pixels);
             break;
         case SamplerType::SAMPLER_3D:
             assert(zoffset + depth <= std::max(1u, t->depth >> level));
@@ -1861,7 +2082,7 @@ void OpenGLDriver::setTextureData(GLTexture* t,
             assert(t->gl.target == GL_TEXTURE_3D);
             glTexSubImage3D(t->gl.target, GLint(level),
                     GLint(xoffset), GLint(yoffset), GLint(zoffset),
-                    width, height, depth, glFormat, glType, p.buffer);
+                    width, height, depth, glFormat, glType, pixels);
             break;
         case SamplerType::SAMPLER_2D_ARRAY:
             assert(zoffset + depth <= t->depth);
@@ -1871,7 +2092,7 @@ void OpenGLDriver::setTextureData(GLTexture* t,
             assert(t->gl.target == GL_TEXTURE_2D_ARRAY);
             glTexSubImage3D(t->gl.target, GLint(level),
                     GLint(xoffset), GLint(yoffset), GLint(zoffset),
-                    width, height, depth, glFormat, glType, p.buffer);
+                    width, height, depth, glFormat, glType, pixels);
             break;
         case SamplerType::SAMPLER_CUBEMAP: {
             assert(t->gl.target == GL_TEXTURE_CUBE_MAP);
@@ -1883,12 +2104,16 @@ void OpenGLDriver::setTextureData(GLTexture* t,
                 GLenum target = getCubemapTarget(TextureCubemapFace(face));
                 glTexSubImage2D(target, GLint(level), 0, 0,
                         t->width >> level, t->height >> level, glFormat, glType,
-                        static_cast<uint8_t const*>(p.buffer) + offsets[face]);
+                        pixels + offsets[face]);
             }
             break;
         }
     }
 
+    if (unpackBuffer) {
+        gl.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
     // update the base/max LOD so we don't access undefined LOD. this allows the app to
     // specify levels as they become available.
 
@@ -1927,6 +2152,10 @@ void OpenGLDriver::setCompressedTextureData(GLTexture* t,  uint32_t level,
 
     GLsizei imageSize = GLsizei(p.imageSize);
 
+    // with an unpack buffer bound, the pixels are addressed by their offset in it
+    const bool unpackBuffer = bindUnpackBuffer(p);
+    uint8_t const* const pixels = unpackBuffer ? nullptr : static_cast<uint8_t const*>(p.buffer);
+
     //  TODO: maybe assert the size is right (b/c we can compute it ourselves)
 
     switch (t->target) {
@@ -1941,7 +2170,7 @@ void OpenGLDriver::setCompressedTextureData(GLTexture* t,  uint32_t level,
             assert(t->gl.target == GL_TEXTURE_2D);
             glCompressedTexSubImage2D(t->gl.target, GLint(level),
                     GLint(xoffset), GLint(yoffset),
-                    width, height, t->gl.internalFormat, imageSize, p.buffer);
+                    width, height, t->gl.internalFormat, imageSize, pixels);
             break;
         case SamplerType::SAMPLER_3D:
             bindTexture(OpenGLContext::MAX_TEXTURE_UNIT_COUNT - 1, t);
@@ -1949,13 +2178,13 @@ void OpenGLDriver::setCompressedTextureData(GLTexture* t,  uint32_t level,
             assert(t->gl.target == GL_TEXTURE_3D);
             glCompressedTexSubImage3D(t->gl.target, GLint(level),
                     GLint(xoffset), GLint(yoffset), GLint(zoffset),
-                    width, height, depth, t->gl.internalFormat, imageSize, p.buffer);
+                    width, height, depth, t->gl.internalFormat, imageSize, pixels);
             break;
         case SamplerType::SAMPLER_2D_ARRAY:
             assert(t->gl.target == GL_TEXTURE_2D_ARRAY);
             glCompressedTexSubImage3D(t->gl.target, GLint(level),
                     GLint(xoffset), GLint(yoffset), GLint(zoffset),
-                    width, height, depth, t->gl.internalFormat, imageSize, p.buffer);
+                    width, height, depth, t->gl.internalFormat, imageSize, pixels);
             break;
         case SamplerType::SAMPLER_CUBEMAP: {
             assert(faceOffsets);
@@ -1968,12 +2197,16 @@ void OpenGLDriver::setCompressedTextureData(GLTexture* t,  uint32_t level,
                 GLenum target = getCubemapTarget(TextureCubemapFace(face));
                 glCompressedTexSubImage2D(target, GLint(level), 0, 0,
                         t->width >> level, t->height >> level, t->gl.internalFormat,
-                        imageSize, static_cast<uint8_t const*>(p.buffer) + offsets[face]);
+                        imageSize, pixels + offsets[face]);
             }
             break;
         }
     }
 
+    if (unpackBuffer) {
+        gl.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
     // update the base/max LOD so we don't access undefined LOD. this allows the app to
     // specify levels as they become available.
 
@@ -1991,6 +2224,39 @@ void OpenGLDriver::setCompressedTextureData(GLTexture* t,  uint32_t level,
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+bool OpenGLDriver::bindUnpackBuffer(BufferDescriptor const& p) noexcept {
+#if HAS_MAPBUFFERS
+    // Large uploads are copied into a pixel unpack buffer: the copy is cheap, and the transfer
+    // to the texture then happens asynchronously, instead of blocking this thread while the
+    // driver consumes the client memory.
+    if (p.size < UNPACK_BUFFER_MIN_SIZE) {
+        return false;
+    }
+
+    auto& gl = mContext;
+    if (UTILS_UNLIKELY(!mUnpackBuffer)) {
+        glGenBuffers(1, &mUnpackBuffer);
+    }
+    gl.bindBuffer(GL_PIXEL_UNPACK_BUFFER, mUnpackBuffer);
+
+    // orphan the previous content, which a pending transfer might still be reading
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, p.size, nullptr, GL_STREAM_DRAW);
+    void* vaddr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, p.size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (vaddr) {
+        memcpy(vaddr, p.buffer, p.size);
+        if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE) {
+            return true;
+        }
+    }
+
+    // the content is undefined if unmapping failed, use the client memory instead
+    gl.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    CHECK_GL_ERROR(utils::slog.e)
+#endif
+    return false;
+}
+
 void OpenGLDriver::setupExternalImage(void* image) {
     mPlatform.retainExternalImage(image);
 }
@@ -2203,6 +2469,10 @@ void OpenGLDriver::beginRenderPass(Handle<HwRenderTarget> rth,
     gl.bindFramebuffer(GL_FRAMEBUFFER, rt->gl.fbo);
     CHECK_GL_FRAMEBUFFER_STATUS(utils::slog.e, GL_FRAMEBUFFER)
 
+    if (gl.ext.QCOM_framebuffer_foveated) {
+        setFoveation(rt, params.foveation, params.viewport);
+    }
+
     // glInvalidateFramebuffer appeared on GLES 3.0 and GL4.3, for simplicity we just
     // ignore it on GL (rather than having to do a runtime check).
     if (GLES30_HEADERS) {
@@ -2229,7 +2499,7 @@ void OpenGLDriver::beginRenderPass(Handle<HwRenderTarget> rth,
 
     if (any(clearFlags)) {
         gl.disable(GL_SCISSOR_TEST);
-        clearWithRasterPipe(clearFlags,
+        clearWithRasterPipe(rt, clearFlags,
                 params.clearColor, params.clearDepth, params.clearStencil);
     }
 
@@ -2246,11 +2516,38 @@ void OpenGLDriver::beginRenderPass(Handle<HwRenderTarget> rth,
     // clear the discarded (but not the cleared ones) buffers in debug builds
     mContext.bindFramebuffer(GL_FRAMEBUFFER, rt->gl.fbo);
     mContext.disable(GL_SCISSOR_TEST);
-    clearWithRasterPipe(discardFlags & ~clearFlags,
+    clearWithRasterPipe(rt, discardFlags & ~clearFlags,
             { 1, 0, 0, 1 }, 1.0, 0);
 #endif
 }
 
+void OpenGLDriver::setFoveation(GLRenderTarget* rt, Foveation const& foveation,
+        Viewport const& viewport) noexcept {
+#ifdef GL_QCOM_framebuffer_foveated
+    const bool enabled = foveation.gain.x > 0.0f || foveation.gain.y > 0.0f;
+    if (!rt->gl.fbo || (!enabled && !rt->foveationConfigured)) {
+        return;
+    }
+
+    if (!rt->foveationConfigured) {
+        // the configuration of a framebuffer can't change, only its parameters
+        GLuint providedFeatures = 0;
+        glFramebufferFoveationConfigQCOM(rt->gl.fbo, 1, 1,
+                GL_FOVEATION_ENABLE_BIT_QCOM, &providedFeatures);
+        rt->foveationConfigured = true;
+    }
+
+    // the focal point is relative to the viewport, the extension wants it in the framebuffer
+    const float sx = float(viewport.width) / float(rt->width);
+    const float sy = float(viewport.height) / float(rt->height);
+    const float cx = (float(viewport.left) / float(rt->width)) * 2.0f - 1.0f + (foveation.center.x + 1.0f) * sx;
+    const float cy = (float(viewport.bottom) / float(rt->height)) * 2.0f - 1.0f + (foveation.center.y + 1.0f) * sy;
+    glFramebufferFoveationParametersQCOM(rt->gl.fbo, 0, 0, cx, cy,
+            foveation.gain.x / sx, foveation.gain.y / sy, foveation.area * std::min(sx, sy));
+    CHECK_GL_ERROR(utils::slog.e)
+#endif
+}
+
 void OpenGLDriver::endRenderPass(int) {
     DEBUG_MARKER()
     auto& gl = mContext;
@@ -2290,7 +2587,7 @@ void OpenGLDriver::endRenderPass(int) {
     // clear the discarded buffers in debug builds
     mContext.bindFramebuffer(GL_FRAMEBUFFER, rt->gl.fbo);
     mContext.disable(GL_SCISSOR_TEST);
-    clearWithRasterPipe(discardFlags,
+    clearWithRasterPipe(rt, discardFlags,
             { 0, 1, 0, 1 }, 1.0, 0);
 #endif
 
@@ -2680,7 +2977,8 @@ void OpenGLDriver::bindUniformBuffer(size_t index, Handle<HwUniformBuffer> ubh)
     auto& gl = mContext;
     GLUniformBuffer* ub = handle_cast<GLUniformBuffer *>(ubh);
     assert(ub->gl.ubo.base == 0);
-    gl.bindBufferRange(GL_UNIFORM_BUFFER, GLuint(index), ub->gl.ubo.id, 0, ub->gl.ubo.capacity);
+    gl.bindBufferRange(GL_UNIFORM_BUFFER, GLuint(index), ub->gl.ubo.id,
+            ub->gl.ubo.offset, ub->gl.ubo.capacity);
     CHECK_GL_ERROR(utils::slog.e)
 }
 
@@ -2693,7 +2991,35 @@ void OpenGLDriver::bindUniformBufferRange(size_t index, Handle<HwUniformBuffer>
     // TODO: Is this assert really needed? Note that size is only populated for STREAM buffers.
     assert(size <= ub->gl.ubo.size);
     assert(ub->gl.ubo.base + offset + size <= ub->gl.ubo.capacity);
-    gl.bindBufferRange(GL_UNIFORM_BUFFER, GLuint(index), ub->gl.ubo.id, ub->gl.ubo.base + offset, size);
+    gl.bindBufferRange(GL_UNIFORM_BUFFER, GLuint(index), ub->gl.ubo.id,
+            ub->gl.ubo.offset + ub->gl.ubo.base + offset, size);
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::bindBufferObject(uint8_t index, Handle<HwBufferObject> boh) {
+    DEBUG_MARKER()
+    auto& gl = mContext;
+    GLBufferObject* bo = handle_cast<GLBufferObject*>(boh);
+    gl.bindBufferRange(bo->gl.binding, GLuint(index), bo->gl.buffer.id, 0, bo->byteCount);
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::bindVertexBufferStorage(uint8_t index, Handle<HwVertexBuffer> vbh,
+        uint8_t bufferIndex) {
+    DEBUG_MARKER()
+    auto& gl = mContext;
+    GLVertexBuffer const* vb = handle_cast<const GLVertexBuffer*>(vbh);
+    assert(bufferIndex < vb->bufferCount);
+
+    // same size as computed in createVertexBufferR()
+    size_t size = 0;
+    for (auto const& item : vb->attributes) {
+        if (item.buffer == bufferIndex) {
+            size = std::max(size, size_t(item.offset + vb->vertexCount * item.stride));
+        }
+    }
+    gl.bindBufferRange(GL_SHADER_STORAGE_BUFFER, GLuint(index), vb->gl.buffers[bufferIndex],
+            0, GLsizeiptr(size));
     CHECK_GL_ERROR(utils::slog.e)
 }
 
@@ -2820,20 +3146,20 @@ void OpenGLDriver::readPixels(Handle<HwRenderTarget> src,
     GLRenderTarget const* s = handle_cast<GLRenderTarget const*>(src);
     gl.bindFramebuffer(GL_READ_FRAMEBUFFER, s->gl.fbo);
 
-    GLuint pbo;
-    glGenBuffers(1, &pbo);
-    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
-    glBufferData(GL_PIXEL_PACK_BUFFER, p.size, nullptr, GL_STATIC_DRAW);
+    // the pixels are copied into a buffer object, which is mapped once the fence signals so that
+    // neither glReadPixels() nor the mapping stall
+    const PixelPackBuffer buffer = acquirePixelPackBuffer(GLsizeiptr(p.size));
+    gl.bindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
     glReadPixels(GLint(x), GLint(y), GLint(width), GLint(height), glFormat, glType, nullptr);
     gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
     // we're forced to make a copy on the heap because otherwise it deletes std::function<> copy
     // constructor.
     auto* pUserBuffer = new PixelBufferDescriptor(std::move(p));
-    whenGpuCommandsComplete([this, width, height, pbo, pUserBuffer]() mutable {
+    whenGpuCommandsComplete([this, width, height, buffer, pUserBuffer]() mutable {
         PixelBufferDescriptor& p = *pUserBuffer;
         auto& gl = mContext;
-        gl.bindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        gl.bindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
         void* vaddr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,  p.size, GL_MAP_READ_BIT);
         if (vaddr) {
             // now we need to flip the buffer vertically to match our API
@@ -2852,7 +3178,7 @@ void OpenGLDriver::readPixels(Handle<HwRenderTarget> src,
             glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
         }
         gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-        glDeleteBuffers(1, &pbo);
+        releasePixelPackBuffer(buffer);
         scheduleDestroy(std::move(p));
         delete pUserBuffer;
         CHECK_GL_ERROR(utils::slog.e)
@@ -2861,6 +3187,40 @@ void OpenGLDriver::readPixels(Handle<HwRenderTarget> src,
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+OpenGLDriver::PixelPackBuffer OpenGLDriver::acquirePixelPackBuffer(GLsizeiptr size) noexcept {
+    // the smallest buffer large enough
+    auto& buffers = mPixelPackBuffers;
+    auto best = buffers.end();
+    for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+        if (it->size >= size && (best == buffers.end() || it->size < best->size)) {
+            best = it;
+        }
+    }
+    if (best != buffers.end()) {
+        const PixelPackBuffer buffer = *best;
+        buffers.erase(best);
+        return buffer;
+    }
+
+    PixelPackBuffer buffer{ 0, size };
+    glGenBuffers(1, &buffer.pbo);
+    mContext.bindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    mContext.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    CHECK_GL_ERROR(utils::slog.e)
+    return buffer;
+}
+
+void OpenGLDriver::releasePixelPackBuffer(PixelPackBuffer buffer) noexcept {
+    auto& buffers = mPixelPackBuffers;
+    buffers.push_back(buffer);
+    if (buffers.size() > MAX_PIXEL_PACK_BUFFERS) {
+        // the oldest buffer is the least likely to fit the next read-backs
+        mContext.deleteBuffers(1, &buffers.front().pbo, GL_PIXEL_PACK_BUFFER);
+        buffers.erase(buffers.begin());
+    }
+}
+
 void OpenGLDriver::whenGpuCommandsComplete(std::function<void()> fn) noexcept {
     GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
     mGpuCommandCompleteOps.emplace_back(sync, std::move(fn));
@@ -2948,6 +3308,9 @@ void OpenGLDriver::endFrame(uint32_t frameId) {
     //SYSTRACE_NAME("glFinish");
     //glFinish();
     insertEventMarker("endFrame");
+    if (mStagingBuffer) {
+        mStagingBuffer->endFrame();
+    }
 }
 
 void OpenGLDriver::flush(int) {
@@ -2975,7 +3338,7 @@ void OpenGLDriver::finish(int) {
 }
 
 UTILS_NOINLINE
-void OpenGLDriver::clearWithRasterPipe(TargetBufferFlags clearFlags,
+void OpenGLDriver::clearWithRasterPipe(GLRenderTarget const* rt, TargetBufferFlags clearFlags,
         math::float4 const& linearColor, GLfloat depth, GLint stencil) noexcept {
     DEBUG_MARKER()
     RasterState rs(mRasterState);
@@ -2991,17 +3354,20 @@ void OpenGLDriver::clearWithRasterPipe(TargetBufferFlags clearFlags,
         setRasterState(rs);
     }
 
-    if (any(clearFlags & TargetBufferFlags::COLOR0)) {
-        glClearBufferfv(GL_COLOR, 0, linearColor.v);
-    }
-    if (any(clearFlags & TargetBufferFlags::COLOR1)) {
-        glClearBufferfv(GL_COLOR, 1, linearColor.v);
-    }
-    if (any(clearFlags & TargetBufferFlags::COLOR2)) {
-        glClearBufferfv(GL_COLOR, 2, linearColor.v);
-    }
-    if (any(clearFlags & TargetBufferFlags::COLOR3)) {
-        glClearBufferfv(GL_COLOR, 3, linearColor.v);
+    for (GLint i = 0; i < 4; i++) {
+        if (any(clearFlags & getMRTColorFlag(i))) {
+            // clearing an integer buffer with floats is undefined
+            GLTexture const* const t = rt->gl.color[i].texture;
+            if (t && isUnsignedIntFormat(t->format)) {
+                const math::uint4 color(linearColor);
+                glClearBufferuiv(GL_COLOR, i, color.v);
+            } else if (t && isSignedIntFormat(t->format)) {
+                const math::int4 color(linearColor);
+                glClearBufferiv(GL_COLOR, i, color.v);
+            } else {
+                glClearBufferfv(GL_COLOR, i, linearColor.v);
+            }
+        }
     }
 
     if ((clearFlags & TargetBufferFlags::DEPTH_AND_STENCIL) == TargetBufferFlags::DEPTH_AND_STENCIL) {
@@ -3097,12 +3463,22 @@ void OpenGLDriver::updateTextureLodRange(GLTexture* texture, int8_t targetLevel)
     }
 }
 
-void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph) {
+void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
     DEBUG_MARKER()
     auto& gl = mContext;
 
     OpenGLProgram* p = handle_cast<OpenGLProgram*>(state.program);
 
+    if (UTILS_UNLIKELY(p->isPending())) {
+        // Skip the draw call rather than stalling if the program is still compiling and
+        // it allows it.
+        if (p->isNonBlocking() && !p->isReady()) {
+            return;
+        }
+        p->initialize(this);
+    }
+
     // If the material debugger is enabled, avoid fatal (or cascading) errors and that can occur
     // during the draw call when the program is invalid. The shader compile error has already been
     // dumped to the console at this point, so it's fine to simply return early.
@@ -3121,12 +3497,53 @@ void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph) {
 
     setViewportScissor(state.scissor);
 
-    glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
-            rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset));
+    if (UTILS_LIKELY(instanceCount <= 1)) {
+        glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset));
+    } else {
+        glDrawElementsInstanced(GLenum(rp->type), rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset),
+                GLsizei(instanceCount));
+    }
 
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::bindImage(uint8_t unit, Handle<HwTexture> th, uint8_t level) {
+    DEBUG_MARKER()
+    assert(mContext.features.compute_shader);
+
+#if HAS_COMPUTE_ENTRY_POINTS
+    GLTexture const* t = handle_cast<const GLTexture*>(th);
+    glBindImageTexture(unit, t->gl.id, level, GL_FALSE, 0, GL_READ_WRITE, t->gl.internalFormat);
+    CHECK_GL_ERROR(utils::slog.e)
+#endif
+}
+
+void OpenGLDriver::dispatchCompute(Handle<HwProgram> ph, math::uint3 workGroupCount) {
+    DEBUG_MARKER()
+    assert(mContext.features.compute_shader);
+
+#if HAS_COMPUTE_ENTRY_POINTS
+    OpenGLProgram* p = handle_cast<OpenGLProgram*>(ph);
+    useProgram(p);
+    if (UTILS_UNLIKELY(!p->isValid())) {
+        return;
+    }
+
+    glDispatchCompute(workGroupCount.x, workGroupCount.y, workGroupCount.z);
+
+    // make the image and storage buffer writes visible to all the commands that follow, they
+    // can be used as textures, images, vertices, indices, uniforms or storage.
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT |
+            GL_UNIFORM_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+            GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+            GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    CHECK_GL_ERROR(utils::slog.e)
+#endif
+}
+
 // explicit instantiation of the Dispatcher
 template class backend::ConcreteDispatcher<OpenGLDriver>;
 
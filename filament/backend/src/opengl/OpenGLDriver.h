@@ -19,7 +19,9 @@
 
 #include "private/backend/Driver.h"
 #include "DriverBase.h"
+#include "OpenGLBlobCache.h"
 #include "OpenGLContext.h"
+#include "OpenGLUniformBufferAllocator.h"
 
 #include <utils/compiler.h>
 #include <utils/Allocator.h>
@@ -46,6 +48,7 @@ class TargetBufferInfo;
 
 class OpenGLProgram;
 class OpenGLBlitter;
+class OpenGLStagingBuffer;
 class TimerQueryInterface;
 
 class OpenGLDriver final : public backend::DriverBase {
@@ -68,7 +71,9 @@ public:
         uint32_t capacity = 0;
         uint32_t base = 0;
         uint32_t size = 0;
+        uint32_t offset = 0;        // offset of our storage in 'id', when suballocated
         backend::BufferUsage usage = {};
+        bool suballocated = false;
     };
 
     struct GLVertexBuffer : public backend::HwVertexBuffer {
@@ -76,6 +81,7 @@ public:
         struct {
             // 4 * MAX_VERTEX_ATTRIBUTE_COUNT bytes
             std::array<GLuint, backend::MAX_VERTEX_ATTRIBUTE_COUNT> buffers{};
+            backend::BufferUsage usage = {};
         } gl;
     };
 
@@ -83,6 +89,7 @@ public:
         using HwIndexBuffer::HwIndexBuffer;
         struct {
             GLuint buffer{};
+            backend::BufferUsage usage = {};
         } gl;
     };
 
@@ -97,6 +104,20 @@ public:
         } gl;
     };
 
+    struct GLBufferObject : public backend::HwBufferObject {
+        using HwBufferObject::HwBufferObject;
+        GLBufferObject(uint32_t size, backend::BufferObjectBinding bindingType,
+                backend::BufferUsage usage) noexcept
+                : HwBufferObject(size, bindingType) {
+            gl.buffer.capacity = size;
+            gl.buffer.usage = usage;
+        }
+        struct {
+            GLBuffer buffer;
+            GLenum binding = 0;
+        } gl;
+    };
+
     struct GLSamplerGroup : public backend::HwSamplerGroup {
         using HwSamplerGroup::HwSamplerGroup;
     };
@@ -195,6 +216,7 @@ public:
             uint8_t samples : 4;
         } gl;
         backend::TargetBufferFlags targets = {};
+        bool foveationConfigured = false;   // see GL_QCOM_framebuffer_foveated
     };
 
     struct GLSync : public backend::HwSync {
@@ -240,10 +262,12 @@ private:
 
     // Memory management...
 
+    // Handles are allocated from the main thread and freed from the driver thread, the pools
+    // use lock-free free lists so that neither waits for the other.
     class HandleAllocator {
-        utils::PoolAllocator< 16, 16>   mPool0;
-        utils::PoolAllocator< 64, 32>   mPool1;
-        utils::PoolAllocator<208, 32>   mPool2;
+        utils::PoolAllocator< 16, 16, 0, utils::AtomicFreeList>   mPool0;
+        utils::PoolAllocator< 64, 32, 0, utils::AtomicFreeList>   mPool1;
+        utils::PoolAllocator<208, 32, 0, utils::AtomicFreeList>   mPool2;
     public:
         static constexpr size_t MIN_ALIGNMENT_SHIFT = 4;
         explicit HandleAllocator(const utils::HeapArea& area);
@@ -251,14 +275,14 @@ private:
         void free(void* p, size_t size) noexcept;
     };
 
-    // the arenas for handle allocation needs to be thread-safe
+    // the arenas for handle allocation needs to be thread-safe, HandleAllocator already is
 #ifndef NDEBUG
     using HandleArena = utils::Arena<HandleAllocator,
-            utils::LockingPolicy::SpinLock,
+            utils::LockingPolicy::NoLock,
             utils::TrackingPolicy::Debug>;
 #else
     using HandleArena = utils::Arena<HandleAllocator,
-            utils::LockingPolicy::SpinLock>;
+            utils::LockingPolicy::NoLock>;
 #endif
 
     HandleArena mHandleArena;
@@ -356,6 +380,10 @@ private:
     void resolvePass(ResolveAction action, GLRenderTarget const* rt,
             backend::TargetBufferFlags discardFlags) noexcept;
 
+    // sets the foveation of the bound render target, relative to the viewport of the pass
+    void setFoveation(GLRenderTarget* rt, backend::Foveation const& foveation,
+            backend::Viewport const& viewport) noexcept;
+
     GLuint getSamplerSlow(backend::SamplerParams sp) const noexcept;
 
     inline GLuint getSampler(backend::SamplerParams sp) const noexcept {
@@ -385,7 +413,7 @@ private:
     GLboolean mRenderPassColorWrite{};
     GLboolean mRenderPassDepthWrite{};
 
-    void clearWithRasterPipe(backend::TargetBufferFlags clearFlags,
+    void clearWithRasterPipe(GLRenderTarget const* rt, backend::TargetBufferFlags clearFlags,
             math::float4 const& linearColor, GLfloat depth, GLint stencil) noexcept;
 
     void setViewportScissor(backend::Viewport const& viewportScissor) noexcept;
@@ -402,10 +430,37 @@ private:
 
     backend::OpenGLPlatform& mPlatform;
 
+    OpenGLBlobCache mBlobCache;
+
     OpenGLBlitter* mOpenGLBlitter = nullptr;
+
+    // ring used to update DYNAMIC and STREAM buffers, null if buffer storage isn't supported
+    OpenGLStagingBuffer* mStagingBuffer = nullptr;
+    bool stageBufferUpdate(backend::BufferUsage usage, GLuint buffer, uint32_t byteOffset,
+            backend::BufferDescriptor const& p) noexcept;
+
+    // pixel unpack buffer used for large texture uploads
+    GLuint mUnpackBuffer = 0;
+    bool bindUnpackBuffer(backend::BufferDescriptor const& p) noexcept;
+
+    // pixel pack buffers of the completed readPixels(), reused by the following ones
+    static constexpr size_t MAX_PIXEL_PACK_BUFFERS = 4;
+    struct PixelPackBuffer {
+        GLuint pbo;
+        GLsizeiptr size;
+    };
+    std::vector<PixelPackBuffer> mPixelPackBuffers;
+    PixelPackBuffer acquirePixelPackBuffer(GLsizeiptr size) noexcept;
+    void releasePixelPackBuffer(PixelPackBuffer buffer) noexcept;
+
+    // small STATIC and DYNAMIC uniform buffers are packed into larger GL buffers
+    OpenGLUniformBufferAllocator mUniformBufferAllocator;
+
     void updateStreamTexId(GLTexture* t, backend::DriverApi* driver) noexcept;
     void updateStreamAcquired(GLTexture* t, backend::DriverApi* driver) noexcept;
     void updateBuffer(GLenum target, GLBuffer* buffer, backend::BufferDescriptor const& p, uint32_t alignment = 16) noexcept;
+    void updateBufferRange(GLenum target, GLBuffer* buffer, void const* data,
+            uint32_t size, uint32_t byteOffset) noexcept;
     void updateTextureLodRange(GLTexture* texture, int8_t targetLevel) noexcept;
 
     void setExternalTexture(GLTexture* t, void* image);
@@ -23,8 +23,13 @@
 #include <utils/Panic.h>
 
 #include <private/backend/BackendUtils.h>
+#include <private/backend/OpenGLPlatform.h>
 
 #include <cctype>
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
 
 namespace filament {
 
@@ -32,13 +37,122 @@ using namespace filament::math;
 using namespace utils;
 using namespace backend;
 
+// KHR_parallel_shader_compile and ARB_parallel_shader_compile share the same value
+static constexpr GLenum COMPLETION_STATUS = 0x91B1;
+
 OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) noexcept
         :  HwProgram(programBuilder.getName()), mIsValid(false) {
 
+    // First try to retrieve the linked program from the blob cache, this skips compilation
+    // and linking entirely.
+    OpenGLBlobCache& blobCache = gl->mBlobCache;
+    Platform& platform = gl->mPlatform;
+    const bool useBlobCache = blobCache.isEnabled(platform);
+    OpenGLBlobCache::Key key{};
+    if (useBlobCache) {
+        key = blobCache.getKey(programBuilder);
+        GLuint program = blobCache.retrieve(platform, key);
+        if (program) {
+            this->gl.program = program;
+            initializeProgramState(gl,
+                    programBuilder.getUniformBlockInfo(), programBuilder.getSamplerGroupInfo());
+            mIsValid = true;
+            return;
+        }
+    }
+
+    compileAndLink(programBuilder, useBlobCache ? &blobCache : nullptr);
+
+    mLazyInitializationData = std::make_unique<LazyInitializationData>(LazyInitializationData{
+            .uniformBlockInfo = programBuilder.getUniformBlockInfo(),
+            .samplerGroupInfo = programBuilder.getSamplerGroupInfo(),
+            .blobCacheKey = key,
+            .useBlobCache = useBlobCache,
+            .nonBlocking = programBuilder.isNonBlocking()
+    });
+
+    // When the driver compiles programs in parallel, we defer checking the program's status
+    // to when it's first needed, so we don't stall waiting for the compilation to finish.
+    if (!gl->getContext().ext.KHR_parallel_shader_compile) {
+        initialize(gl);
+    }
+}
+
+OpenGLProgram::~OpenGLProgram() noexcept {
+    const uint8_t validShaderSet = mValidShaderSet;
+    const GLuint program = gl.program;
+    if (validShaderSet) {
+        #pragma nounroll
+        for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+            if (validShaderSet & (1U << i)) {
+                const GLuint shader = gl.shaders[i];
+                if (program) {
+                    glDetachShader(program, shader);
+                }
+                glDeleteShader(shader);
+            }
+        }
+    }
+    if (program) {
+        glDeleteProgram(program);
+    }
+}
+
+bool OpenGLProgram::isReady() const noexcept {
+    if (!isPending()) {
+        return true;
+    }
+    if (!gl.program) {
+        // the program is invalid, initialize() will report the error.
+        return true;
+    }
+    GLint status = GL_FALSE;
+    glGetProgramiv(gl.program, COMPLETION_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+void OpenGLProgram::initialize(OpenGLDriver* gl) noexcept {
+    assert(isPending());
+    std::unique_ptr<LazyInitializationData> data = std::move(mLazyInitializationData);
+
+    if (UTILS_LIKELY(checkCompileAndLinkStatus())) {
+        if (data->useBlobCache) {
+            gl->mBlobCache.insert(gl->mPlatform, data->blobCacheKey, this->gl.program);
+        }
+        initializeProgramState(gl, data->uniformBlockInfo, data->samplerGroupInfo);
+        mIsValid = true;
+    }
+
+    // Failing to compile a program can't be fatal, because this will happen a lot in
+    // the material tools. We need to have a better way to handle these errors and
+    // return to the editor.
+    if (UTILS_UNLIKELY(!isValid())) {
+        PANIC_LOG("Failed to compile GLSL program.");
+    }
+}
+
+void OpenGLProgram::compileAndLink(const Program& programBuilder,
+        OpenGLBlobCache const* blobCache) noexcept {
+
     using Shader = Program::Shader;
 
     const auto& shadersSource = programBuilder.getShadersSource();
 
+    // GLSL has no specialization constants, SPIRV-Cross turns them into macros we define instead
+    std::string specConstantDefines;
+    for (auto const& constant : programBuilder.getSpecializationConstants()) {
+        specConstantDefines += "#define SPIRV_CROSS_CONSTANT_ID_" + std::to_string(constant.id);
+        if (auto const* i = std::get_if<int32_t>(&constant.value)) {
+            specConstantDefines += " " + std::to_string(*i) + "\n";
+        } else if (auto const* f = std::get_if<float>(&constant.value)) {
+            char value[32];
+            snprintf(value, sizeof(value), " %.9g\n", *f);
+            specConstantDefines += value;
+        } else {
+            specConstantDefines += std::get<bool>(constant.value) ? " true\n" : " false\n";
+        }
+    }
+
     // build all shaders
     #pragma nounroll
     for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
@@ -51,10 +165,12 @@ OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) no
             case Shader::FRAGMENT:
                 glShaderType = GL_FRAGMENT_SHADER;
                 break;
+            case Shader::COMPUTE:
+                glShaderType = GL_COMPUTE_SHADER;
+                break;
         }
 
         if (!shadersSource[i].empty()) {
-            GLint status;
             auto shader = shadersSource[i];
             GLint const length = (GLint)shader.size();
 
@@ -71,126 +187,141 @@ OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) no
             const char * const source = (const char*)shader.data();
 
             GLuint shaderId = glCreateShader(glShaderType);
-            glShaderSource(shaderId, 1, &source, &length);
+            if (specConstantDefines.empty()) {
+                glShaderSource(shaderId, 1, &source, &length);
+            } else {
+                // the defines must come after the #version directive, on the first line
+                const char* eol = (const char*)memchr(source, '\n', size_t(length));
+                const GLint versionLength = eol ? GLint(eol - source + 1) : 0;
+                const char* const sources[3] = {
+                        source, specConstantDefines.c_str(), source + versionLength };
+                const GLint lengths[3] = {
+                        versionLength, GLint(specConstantDefines.size()), length - versionLength };
+                glShaderSource(shaderId, 3, sources, lengths);
+            }
             glCompileShader(shaderId);
 
-            glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
-            if (UTILS_UNLIKELY(status != GL_TRUE)) {
-                logCompilationError(slog.e, shaderId, source);
-                glDeleteShader(shaderId);
-                return;
-            }
             this->gl.shaders[i] = shaderId;
             mValidShaderSet |= 1U << i;
         }
     }
 
-    // we need at least a vertex and fragment program
+    // we need at least a vertex and fragment program, or a compute program alone
     const uint8_t validShaderSet = mValidShaderSet;
     const uint8_t mask = VERTEX_SHADER_BIT | FRAGMENT_SHADER_BIT;
-    if (UTILS_LIKELY((mValidShaderSet & mask) == mask)) {
-        GLint status;
-        GLuint program = glCreateProgram();
-        for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
-            if (validShaderSet & (1U << i)) {
-                glAttachShader(program, this->gl.shaders[i]);
-            }
+    if (UTILS_UNLIKELY((validShaderSet & mask) != mask && validShaderSet != COMPUTE_SHADER_BIT)) {
+        return;
+    }
+
+    // Note that we don't check the compilation status before linking, because this would
+    // force a synchronization with the compiler. Linking fails if a shader didn't compile.
+    GLuint program = glCreateProgram();
+    if (blobCache) {
+        blobCache->prepareForBinary(program);
+    }
+    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+        if (validShaderSet & (1U << i)) {
+            glAttachShader(program, this->gl.shaders[i]);
         }
-        glLinkProgram(program);
+    }
+    glLinkProgram(program);
+    this->gl.program = program;
+}
 
-        glGetProgramiv(program, GL_LINK_STATUS, &status);
-        if (UTILS_UNLIKELY(status != GL_TRUE)) {
-            char error[512];
-            glGetProgramInfoLog(program, sizeof(error), nullptr, error);
+bool OpenGLProgram::checkCompileAndLinkStatus() noexcept {
+    const GLuint program = gl.program;
+    if (UTILS_UNLIKELY(!program)) {
+        return false;
+    }
 
-            slog.e << "LINKING: " << error << io::endl;
-            glDeleteProgram(program);
-            return;
-        }
-        this->gl.program = program;
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (UTILS_LIKELY(status == GL_TRUE)) {
+        return true;
+    }
 
-        // Associate each UniformBlock in the program to a known binding.
-        auto const& uniformBlockInfo = programBuilder.getUniformBlockInfo();
-        #pragma nounroll
-        for (GLuint binding = 0, n = uniformBlockInfo.size(); binding < n; binding++) {
-            auto const& name = uniformBlockInfo[binding];
-            if (!name.empty()) {
-                GLint index = glGetUniformBlockIndex(program, name.c_str());
-                if (index >= 0) {
-                    glUniformBlockBinding(program, GLuint(index), binding);
-                }
-                CHECK_GL_ERROR(utils::slog.e)
+    // Linking failed, figure out first if a shader failed to compile.
+    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+        if (mValidShaderSet & (1U << i)) {
+            const GLuint shaderId = gl.shaders[i];
+            glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
+            if (UTILS_UNLIKELY(status != GL_TRUE)) {
+                GLint length = 0;
+                glGetShaderiv(shaderId, GL_SHADER_SOURCE_LENGTH, &length);
+                std::vector<char> source(size_t(length) + 1, '\0');
+                glGetShaderSource(shaderId, length, nullptr, source.data());
+                logCompilationError(slog.e, shaderId, source.data());
+                return false;
             }
         }
+    }
 
-        if (programBuilder.hasSamplers()) {
-            // if we have samplers, we need to do a bit of extra work
-            // activate this program so we can set all its samplers once and for all (glUniform1i)
-            gl->getContext().useProgram(program);
-
-            auto const& samplerGroupInfo = programBuilder.getSamplerGroupInfo();
-            auto& indicesRun = mIndicesRuns;
-            uint8_t numUsedBindings = 0;
-            uint8_t tmu = 0;
-
-            #pragma nounroll
-            for (size_t i = 0, c = samplerGroupInfo.size(); i < c; i++) {
-                auto const& groupInfo = samplerGroupInfo[i];
-                if (!groupInfo.empty()) {
-                    // Cache the sampler uniform locations for each interface block
-                    BlockInfo& info = mBlockInfos[numUsedBindings];
-                    info.binding = uint8_t(i);
-                    uint8_t count = 0;
-                    for (uint8_t j = 0, m = uint8_t(groupInfo.size()); j < m; ++j) {
-                        // find its location and associate a TMU to it
-                        GLint loc = glGetUniformLocation(program, groupInfo[j].name.c_str());
-                        if (loc >= 0) {
-                            glUniform1i(loc, tmu);
-                            indicesRun[tmu] = j;
-                            count++;
-                            tmu++;
-                        } else {
-                            // glGetUniformLocation could fail if the uniform is not used
-                            // in the program. We should just ignore the error in that case.
-                        }
-                    }
-                    if (count > 0) {
-                        numUsedBindings++;
-                        info.count = uint8_t(count - 1);
-                    }
-                }
+    char error[512];
+    glGetProgramInfoLog(program, sizeof(error), nullptr, error);
+    slog.e << "LINKING: " << error << io::endl;
+    return false;
+}
+
+void OpenGLProgram::initializeProgramState(OpenGLDriver* gl,
+        Program::UniformBlockInfo const& uniformBlockInfo,
+        Program::SamplerGroupInfo const& samplerGroupInfo) noexcept {
+    const GLuint program = this->gl.program;
+
+    // Associate each UniformBlock in the program to a known binding.
+    #pragma nounroll
+    for (GLuint binding = 0, n = uniformBlockInfo.size(); binding < n; binding++) {
+        auto const& name = uniformBlockInfo[binding];
+        if (!name.empty()) {
+            GLint index = glGetUniformBlockIndex(program, name.c_str());
+            if (index >= 0) {
+                glUniformBlockBinding(program, GLuint(index), binding);
             }
-            mUsedBindingsCount = numUsedBindings;
+            CHECK_GL_ERROR(utils::slog.e)
         }
-        mIsValid = true;
     }
 
-    // Failing to compile a program can't be fatal, because this will happen a lot in
-    // the material tools. We need to have a better way to handle these errors and
-    // return to the editor. Also note the early "return" statements in this function.
-    if (UTILS_UNLIKELY(!isValid())) {
-        PANIC_LOG("Failed to compile GLSL program.");
+    bool hasSamplers = false;
+    for (auto const& groupInfo : samplerGroupInfo) {
+        hasSamplers = hasSamplers || !groupInfo.empty();
     }
-}
 
-OpenGLProgram::~OpenGLProgram() noexcept {
-    const size_t validShaderSet = mValidShaderSet;
-    const bool isValid = mIsValid;
-    GLuint program = gl.program;
-    if (validShaderSet) {
+    if (hasSamplers) {
+        // if we have samplers, we need to do a bit of extra work
+        // activate this program so we can set all its samplers once and for all (glUniform1i)
+        gl->getContext().useProgram(program);
+
+        auto& indicesRun = mIndicesRuns;
+        uint8_t numUsedBindings = 0;
+        uint8_t tmu = 0;
+
         #pragma nounroll
-        for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
-            if (validShaderSet & (1U << i)) {
-                const GLuint shader = gl.shaders[i];
-                if (isValid) {
-                    glDetachShader(program, shader);
+        for (size_t i = 0, c = samplerGroupInfo.size(); i < c; i++) {
+            auto const& groupInfo = samplerGroupInfo[i];
+            if (!groupInfo.empty()) {
+                // Cache the sampler uniform locations for each interface block
+                BlockInfo& info = mBlockInfos[numUsedBindings];
+                info.binding = uint8_t(i);
+                uint8_t count = 0;
+                for (uint8_t j = 0, m = uint8_t(groupInfo.size()); j < m; ++j) {
+                    // find its location and associate a TMU to it
+                    GLint loc = glGetUniformLocation(program, groupInfo[j].name.c_str());
+                    if (loc >= 0) {
+                        glUniform1i(loc, tmu);
+                        indicesRun[tmu] = j;
+                        count++;
+                        tmu++;
+                    } else {
+                        // glGetUniformLocation could fail if the uniform is not used
+                        // in the program. We should just ignore the error in that case.
+                    }
+                }
+                if (count > 0) {
+                    numUsedBindings++;
+                    info.count = uint8_t(count - 1);
                 }
-                glDeleteShader(shader);
             }
         }
-    }
-    if (isValid) {
-        glDeleteProgram(program);
+        mUsedBindingsCount = numUsedBindings;
     }
 }
 
@@ -18,6 +18,7 @@
 #define TNT_FILAMENT_DRIVER_OPENGLPROGRAM_H
 
 #include "DriverBase.h"
+#include "OpenGLBlobCache.h"
 #include "OpenGLDriver.h"
 
 #include "private/backend/Driver.h"
@@ -26,6 +27,7 @@
 #include <utils/compiler.h>
 #include <utils/Log.h>
 
+#include <memory>
 #include <vector>
 
 #include <stddef.h>
@@ -43,6 +45,21 @@ public:
 
     bool isValid() const noexcept { return mIsValid; }
 
+    // With KHR_parallel_shader_compile, a program is "pending" until its compilation and link
+    // status has been checked and its uniforms have been initialized (see initialize()).
+    bool isPending() const noexcept { return bool(mLazyInitializationData); }
+
+    // Whether draw calls using this program can be skipped while it's pending.
+    bool isNonBlocking() const noexcept {
+        return mLazyInitializationData && mLazyInitializationData->nonBlocking;
+    }
+
+    // Returns true if a pending program has finished compiling and linking, without blocking.
+    bool isReady() const noexcept;
+
+    // Completes the initialization of a pending program. This blocks until the program is linked.
+    void initialize(OpenGLDriver* gl) noexcept;
+
     void use(OpenGLDriver* const gl) noexcept {
         if (UTILS_UNLIKELY(mUsedBindingsCount)) {
             // We rely on GL state tracking to avoid unnecessary glBindTexture / glBindSampler
@@ -62,8 +79,8 @@ public:
     }
 
     struct {
-        GLuint shaders[backend::Program::SHADER_TYPE_COUNT];
-        GLuint program;
+        GLuint shaders[backend::Program::SHADER_TYPE_COUNT] = {};
+        GLuint program = 0;
     } gl; // 12 bytes
 
     static void logCompilationError(utils::io::ostream& out, GLuint shaderId, char const* source) noexcept;
@@ -72,6 +89,7 @@ private:
     static constexpr uint8_t TEXTURE_UNIT_COUNT = OpenGLContext::MAX_TEXTURE_UNIT_COUNT;
     static constexpr uint8_t VERTEX_SHADER_BIT   = uint8_t(1) << size_t(backend::Program::Shader::VERTEX);
     static constexpr uint8_t FRAGMENT_SHADER_BIT = uint8_t(1) << size_t(backend::Program::Shader::FRAGMENT);
+    static constexpr uint8_t COMPUTE_SHADER_BIT  = uint8_t(1) << size_t(backend::Program::Shader::COMPUTE);
 
     struct BlockInfo {
         uint8_t binding : 3;    // binding (i.e.: index in mSamplerBindings)
@@ -95,7 +113,31 @@ private:
     // runs of indices into SamplerGroup -- run start index and size given by BlockInfo
     std::array<uint8_t, TEXTURE_UNIT_COUNT> mIndicesRuns;    // 16 bytes
 
+    // state needed to complete the initialization of a pending program
+    struct LazyInitializationData {
+        backend::Program::UniformBlockInfo uniformBlockInfo;
+        backend::Program::SamplerGroupInfo samplerGroupInfo;
+        OpenGLBlobCache::Key blobCacheKey;
+        bool useBlobCache;
+        bool nonBlocking;
+    };
+
+    std::unique_ptr<LazyInitializationData> mLazyInitializationData;
+
     void updateSamplers(OpenGLDriver* gl) noexcept;
+
+    // Issues the compilation and link of the program, without checking their status. If
+    // blobCache is not null, the program is prepared so its binary can be retrieved after linking.
+    void compileAndLink(const backend::Program& programBuilder,
+            OpenGLBlobCache const* blobCache) noexcept;
+
+    // Checks the compilation and link status, this blocks until the program is linked.
+    bool checkCompileAndLinkStatus() noexcept;
+
+    // Associates uniform blocks and samplers to their binding points.
+    void initializeProgramState(OpenGLDriver* gl,
+            backend::Program::UniformBlockInfo const& uniformBlockInfo,
+            backend::Program::SamplerGroupInfo const& samplerGroupInfo) noexcept;
 };
 
 
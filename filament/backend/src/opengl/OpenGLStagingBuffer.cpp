@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OpenGLStagingBuffer.h"
+
+#include "GLUtils.h"
+#include "OpenGLContext.h"
+
+#include <utils/Log.h>
+
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+
+// alignment of the updates in the ring, so they're copied efficiently
+static constexpr uint32_t ALIGNMENT = 16u;
+
+bool OpenGLStagingBuffer::init() noexcept {
+#if HAS_BUFFER_STORAGE
+    auto& gl = mContext;
+    if (!glBufferStorage) {
+        return false;
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &mBuffer);
+    gl.bindBuffer(GL_COPY_READ_BUFFER, mBuffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, CAPACITY, nullptr, flags);
+    mData = (uint8_t*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, CAPACITY, flags);
+    CHECK_GL_ERROR(utils::slog.e)
+
+    if (UTILS_UNLIKELY(!mData)) {
+        terminate();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OpenGLStagingBuffer::terminate() noexcept {
+    for (Region const& region : mRegions) {
+        glDeleteSync(region.fence);
+    }
+    mRegions.clear();
+    if (mBuffer) {
+        auto& gl = mContext;
+        if (mData) {
+            gl.bindBuffer(GL_COPY_READ_BUFFER, mBuffer);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            mData = nullptr;
+        }
+        gl.deleteBuffers(1, &mBuffer, GL_COPY_READ_BUFFER);
+        mBuffer = 0;
+    }
+    mHead = mTail = mFrameStart = 0;
+}
+
+bool OpenGLStagingBuffer::copy(GLuint buffer, uint32_t offset,
+        void const* data, uint32_t size) noexcept {
+    if (UTILS_UNLIKELY(size > MAX_UPDATE_SIZE)) {
+        return false;
+    }
+
+    // Find room for the update after mHead. We never let mHead catch up with mTail, so that
+    // they're only equal when the ring is empty.
+    auto allocate = [this](uint32_t n) -> int64_t {
+        if (mHead == mTail) {
+            mHead = mTail = mFrameStart = 0;
+        }
+        const uint32_t pos = (mHead + (ALIGNMENT - 1u)) & ~(ALIGNMENT - 1u);
+        if (mHead >= mTail) {
+            if (pos + n <= CAPACITY) {
+                return pos;
+            }
+            // wrap around
+            return n < mTail ? 0 : -1;
+        }
+        return pos + n < mTail ? pos : -1;
+    };
+
+    int64_t pos = allocate(size);
+    if (UTILS_UNLIKELY(pos < 0)) {
+        // the ring is full, see if the GPU released anything in the meantime
+        recycle();
+        pos = allocate(size);
+        if (pos < 0) {
+            return false;
+        }
+    }
+
+    // the mapping is coherent, so the data is visible to the commands issued after this
+    memcpy(mData + pos, data, size);
+    mHead = uint32_t(pos) + size;
+
+    auto& gl = mContext;
+    gl.bindBuffer(GL_COPY_READ_BUFFER, mBuffer);
+    gl.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, pos, offset, size);
+    CHECK_GL_ERROR(utils::slog.e)
+    return true;
+}
+
+void OpenGLStagingBuffer::endFrame() noexcept {
+    if (mHead != mFrameStart) {
+        mRegions.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), mHead });
+        mFrameStart = mHead;
+    }
+    recycle();
+}
+
+void OpenGLStagingBuffer::recycle() noexcept {
+    // regions are in submission order, we stop at the first one still in use
+    while (!mRegions.empty()) {
+        Region const& region = mRegions.front();
+        const GLenum status = glClientWaitSync(region.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(region.fence);
+        mTail = region.end;
+        mRegions.pop_front();
+    }
+}
+
+} // namespace filament
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_OPENGLSTAGINGBUFFER_H
+#define TNT_FILAMENT_DRIVER_OPENGLSTAGINGBUFFER_H
+
+#include <utils/compiler.h>
+#include "gl_headers.h"
+
+#include <deque>
+
+#include <stdint.h>
+
+namespace filament {
+
+class OpenGLContext;
+
+/*
+ * OpenGLStagingBuffer is a ring buffer persistently and coherently mapped with glBufferStorage().
+ *
+ * Buffer updates are copied into the ring, and transferred to their destination with
+ * glCopyBufferSubData(), which doesn't stall or make the driver copy the data. The part of the
+ * ring written during a frame is protected by a fence, and reused once the fence signals.
+ */
+class OpenGLStagingBuffer {
+public:
+    // size of the ring
+    static constexpr uint32_t CAPACITY = 4u * 1024u * 1024u;
+
+    // larger updates don't go through the ring
+    static constexpr uint32_t MAX_UPDATE_SIZE = CAPACITY / 4u;
+
+    explicit OpenGLStagingBuffer(OpenGLContext& context) noexcept : mContext(context) {}
+
+    // returns false if the ring can't be created, in which case it must not be used
+    bool init() noexcept;
+    void terminate() noexcept;
+
+    // Copies 'size' bytes from 'data' into 'buffer' at 'offset'. Returns false if there isn't
+    // enough room left in the ring, the caller must then update the buffer itself.
+    bool copy(GLuint buffer, uint32_t offset, void const* data, uint32_t size) noexcept;
+
+    // fences the data written this frame and reclaims the regions the GPU is done with
+    void endFrame() noexcept;
+
+private:
+    struct Region {
+        GLsync fence;
+        uint32_t end;
+    };
+
+    void recycle() noexcept;
+
+    OpenGLContext& mContext;
+    GLuint mBuffer{};
+    uint8_t* mData = nullptr;
+    uint32_t mHead = 0;         // where the next update is written
+    uint32_t mTail = 0;         // start of the oldest region in use by the GPU
+    uint32_t mFrameStart = 0;   // start of the region written this frame
+    std::deque<Region> mRegions;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_OPENGLSTAGINGBUFFER_H
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OpenGLUniformBufferAllocator.h"
+
+#include "GLUtils.h"
+#include "OpenGLContext.h"
+
+#include <utils/algorithm.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include <assert.h>
+
+using namespace utils;
+
+namespace filament {
+
+OpenGLUniformBufferAllocator::OpenGLUniformBufferAllocator(OpenGLContext& context) noexcept
+        : mContext(context) {
+    // blocks must be aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, which is a power of two
+    const uint32_t alignment =
+            std::max(16u, (uint32_t)context.gets.uniform_buffer_offset_alignment);
+    assert(!(alignment & (alignment - 1u)));
+    mMinBlockSize = std::min(alignment, MAX_ALLOCATION_SIZE);
+}
+
+void OpenGLUniformBufferAllocator::terminate() noexcept {
+    auto& gl = mContext;
+    if (!mSlabs.empty()) {
+        gl.deleteBuffers(GLsizei(mSlabs.size()), mSlabs.data(), GL_UNIFORM_BUFFER);
+        mSlabs.clear();
+    }
+    for (auto& blocks : mFreeBlocks) {
+        blocks.clear();
+    }
+}
+
+size_t OpenGLUniformBufferAllocator::getSizeClass(uint32_t size) const noexcept {
+    // smallest power of two that fits 'size' and satisfies the alignment
+    size = std::max(size, mMinBlockSize);
+    return 32u - details::clz(size - 1u);
+}
+
+OpenGLUniformBufferAllocator::Allocation OpenGLUniformBufferAllocator::allocate(
+        uint32_t size) noexcept {
+    if (UTILS_UNLIKELY(!size || size > MAX_ALLOCATION_SIZE)) {
+        return {};
+    }
+
+    const size_t sizeClass = getSizeClass(size);
+    auto& blocks = mFreeBlocks[sizeClass];
+    if (UTILS_UNLIKELY(blocks.empty())) {
+        // carve a new slab into blocks of this size class
+        auto& gl = mContext;
+        GLuint id;
+        glGenBuffers(1, &id);
+        gl.bindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, SLAB_SIZE, nullptr, GL_DYNAMIC_DRAW);
+        CHECK_GL_ERROR(utils::slog.e)
+        mSlabs.push_back(id);
+
+        // in reverse order, so blocks are handed out by increasing offsets
+        const uint32_t blockSize = 1u << sizeClass;
+        blocks.reserve(blocks.size() + SLAB_SIZE / blockSize);
+        for (uint32_t offset = SLAB_SIZE; offset > 0;) {
+            offset -= blockSize;
+            blocks.push_back({ id, offset });
+        }
+    }
+
+    const Allocation allocation = blocks.back();
+    blocks.pop_back();
+    return allocation;
+}
+
+void OpenGLUniformBufferAllocator::free(Allocation allocation, uint32_t size) noexcept {
+    assert(allocation.id);
+    mFreeBlocks[getSizeClass(size)].push_back(allocation);
+}
+
+} // namespace filament
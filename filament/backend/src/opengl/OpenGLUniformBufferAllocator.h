@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_OPENGLUNIFORMBUFFERALLOCATOR_H
+#define TNT_FILAMENT_DRIVER_OPENGLUNIFORMBUFFERALLOCATOR_H
+
+#include "gl_headers.h"
+
+#include <utils/compiler.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace filament {
+
+class OpenGLContext;
+
+/*
+ * OpenGLUniformBufferAllocator packs small uniform buffers into large GL buffers (slabs).
+ *
+ * Each slab is split into blocks of a single power-of-two size, at least
+ * GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, so blocks can be bound with glBindBufferRange() directly.
+ * Freed blocks are reused by later allocations of the same size class; slabs are only released
+ * by terminate().
+ */
+class OpenGLUniformBufferAllocator {
+public:
+    // size of the GL buffers blocks are allocated from
+    static constexpr uint32_t SLAB_SIZE = 64u * 1024u;
+
+    // larger uniform buffers get their own GL buffer
+    static constexpr uint32_t MAX_ALLOCATION_SIZE = 4u * 1024u;
+
+    struct Allocation {
+        GLuint id = 0;          // 0 if the allocation failed
+        uint32_t offset = 0;
+    };
+
+    explicit OpenGLUniformBufferAllocator(OpenGLContext& context) noexcept;
+
+    void terminate() noexcept;
+
+    // returns an invalid allocation if 'size' is larger than MAX_ALLOCATION_SIZE
+    Allocation allocate(uint32_t size) noexcept;
+
+    // 'size' must be the size the allocation was made with
+    void free(Allocation allocation, uint32_t size) noexcept;
+
+private:
+    static constexpr size_t SIZE_CLASS_COUNT = 13;  // up to 2^12 = MAX_ALLOCATION_SIZE
+    static_assert((1u << (SIZE_CLASS_COUNT - 1)) == MAX_ALLOCATION_SIZE,
+            "SIZE_CLASS_COUNT is inconsistent with MAX_ALLOCATION_SIZE");
+
+    size_t getSizeClass(uint32_t size) const noexcept;
+
+    OpenGLContext& mContext;
+    uint32_t mMinBlockSize;
+    std::vector<GLuint> mSlabs;
+    std::vector<Allocation> mFreeBlocks[SIZE_CLASS_COUNT];
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_OPENGLUNIFORMBUFFERALLOCATOR_H
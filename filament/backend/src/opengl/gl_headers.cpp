@@ -16,9 +16,9 @@
 
 #if defined(ANDROID) || defined(FILAMENT_USE_EXTERNAL_GLES3) || defined(__EMSCRIPTEN__)
 
+#include "gl_headers.h"
+
 #include <EGL/egl.h>
-#include <GLES3/gl3.h>
-#include <GLES2/gl2ext.h>
 #include <mutex>
 
 namespace glext {
@@ -26,6 +26,10 @@ namespace glext {
 PFNGLSTARTTILINGQCOMPROC glStartTilingQCOM;
 PFNGLENDTILINGQCOMPROC glEndTilingQCOM;
 #endif
+#ifdef GL_QCOM_framebuffer_foveated
+PFNGLFRAMEBUFFERFOVEATIONCONFIGQCOMPROC glFramebufferFoveationConfigQCOM;
+PFNGLFRAMEBUFFERFOVEATIONPARAMETERSQCOMPROC glFramebufferFoveationParametersQCOM;
+#endif
 #ifdef GL_OES_EGL_image
 PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 #endif
@@ -48,6 +52,14 @@ PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64v;
 #ifdef GL_EXT_clip_control
 PFNGLCLIPCONTROLEXTPROC glClipControl;
 #endif
+#ifdef GL_EXT_buffer_storage
+PFNGLBUFFERSTORAGEEXTPROC glBufferStorage;
+#endif
+#ifdef GL_COMPUTE_ENTRY_POINTS_IMPORTED
+PFNGLDISPATCHCOMPUTEPROC glDispatchCompute;
+PFNGLBINDIMAGETEXTUREPROC glBindImageTexture;
+PFNGLMEMORYBARRIERPROC glMemoryBarrier;
+#endif
 
 static std::once_flag sGlExtInitialized;
 
@@ -63,6 +75,16 @@ void importGLESExtensionsEntryPoints() {
                         "glEndTilingQCOM");
 #endif
 
+#ifdef GL_QCOM_framebuffer_foveated
+        glFramebufferFoveationConfigQCOM =
+                (PFNGLFRAMEBUFFERFOVEATIONCONFIGQCOMPROC)eglGetProcAddress(
+                        "glFramebufferFoveationConfigQCOM");
+
+        glFramebufferFoveationParametersQCOM =
+                (PFNGLFRAMEBUFFERFOVEATIONPARAMETERSQCOMPROC)eglGetProcAddress(
+                        "glFramebufferFoveationParametersQCOM");
+#endif
+
 #ifdef GL_OES_EGL_image
         glEGLImageTargetTexture2DOES =
                 (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress(
@@ -102,6 +124,22 @@ void importGLESExtensionsEntryPoints() {
         glGetQueryObjectui64v =
                 (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress(
                         "glGetQueryObjectui64vEXT");
+#endif
+#ifdef GL_COMPUTE_ENTRY_POINTS_IMPORTED
+        glDispatchCompute =
+                (PFNGLDISPATCHCOMPUTEPROC)eglGetProcAddress(
+                        "glDispatchCompute");
+        glBindImageTexture =
+                (PFNGLBINDIMAGETEXTUREPROC)eglGetProcAddress(
+                        "glBindImageTexture");
+        glMemoryBarrier =
+                (PFNGLMEMORYBARRIERPROC)eglGetProcAddress(
+                        "glMemoryBarrier");
+#endif
+#ifdef GL_EXT_buffer_storage
+        glBufferStorage =
+                (PFNGLBUFFERSTORAGEEXTPROC)eglGetProcAddress(
+                        "glBufferStorageEXT");
 #endif
     });
 #ifdef GL_EXT_clip_control
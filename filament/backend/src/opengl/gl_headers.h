@@ -32,6 +32,10 @@
         extern PFNGLSTARTTILINGQCOMPROC glStartTilingQCOM;
         extern PFNGLENDTILINGQCOMPROC glEndTilingQCOM;
 #endif
+#ifdef GL_QCOM_framebuffer_foveated
+        extern PFNGLFRAMEBUFFERFOVEATIONCONFIGQCOMPROC glFramebufferFoveationConfigQCOM;
+        extern PFNGLFRAMEBUFFERFOVEATIONPARAMETERSQCOMPROC glFramebufferFoveationParametersQCOM;
+#endif
 #ifdef GL_OES_EGL_image
         extern PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 #endif
@@ -60,9 +64,58 @@
         #ifndef GL_ZERO_TO_ONE
         #define GL_ZERO_TO_ONE GL_ZERO_TO_ONE_EXT
         #endif
+#endif
+#ifdef GL_EXT_buffer_storage
+        extern PFNGLBUFFERSTORAGEEXTPROC glBufferStorage;
+        #ifndef GL_MAP_PERSISTENT_BIT
+        #define GL_MAP_PERSISTENT_BIT GL_MAP_PERSISTENT_BIT_EXT
+        #endif
+        #ifndef GL_MAP_COHERENT_BIT
+        #define GL_MAP_COHERENT_BIT GL_MAP_COHERENT_BIT_EXT
+        #endif
+        #define GL_BUFFER_STORAGE_ENTRY_POINTS_IMPORTED true
+#endif
+#ifdef GL_EXT_texture_compression_bptc
+        #ifndef GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT
+        #define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_EXT
+        #endif
+        #ifndef GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+        #define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_EXT
+        #endif
+#endif
+#ifndef GL_ES_VERSION_3_1
+        // The GLES3.1 compute entry points are imported at runtime, they're null with GLES3.0
+        typedef void (GL_APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(
+                GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+        typedef void (GL_APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture,
+                GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+        typedef void (GL_APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+        extern PFNGLDISPATCHCOMPUTEPROC glDispatchCompute;
+        extern PFNGLBINDIMAGETEXTUREPROC glBindImageTexture;
+        extern PFNGLMEMORYBARRIERPROC glMemoryBarrier;
+        #define GL_COMPUTE_ENTRY_POINTS_IMPORTED true
 #endif
     }
 
+#ifndef GL_ES_VERSION_3_1
+    #define GL_SHADER_STORAGE_BUFFER            0x90D2
+    #define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT  0x00000001
+    #define GL_ELEMENT_ARRAY_BARRIER_BIT        0x00000002
+    #define GL_UNIFORM_BARRIER_BIT              0x00000004
+    #define GL_TEXTURE_FETCH_BARRIER_BIT        0x00000008
+    #define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT  0x00000020
+    #define GL_COMMAND_BARRIER_BIT              0x00000040
+    #define GL_TEXTURE_UPDATE_BARRIER_BIT       0x00000100
+    #define GL_BUFFER_UPDATE_BARRIER_BIT        0x00000200
+    #define GL_SHADER_STORAGE_BARRIER_BIT       0x00002000
+    #ifndef GL_WRITE_ONLY
+    #define GL_WRITE_ONLY                       0x88B9
+    #endif
+    #ifndef GL_READ_WRITE
+    #define GL_READ_WRITE                       0x88BA
+    #endif
+#endif
+
     // Prevent lots of #ifdef's between desktop and mobile by providing some suffix-free constants:
     #define GL_DEBUG_OUTPUT                   0x92E0
     #define GL_DEBUG_OUTPUT_SYNCHRONOUS       0x8242
@@ -111,6 +164,10 @@
 #define GL_TEXTURE_EXTERNAL_OES           0x8D65
 #endif
 
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER                 0x91B9
+#endif
+
 #include "NullGLES.h"
 
 #if (!defined(GL_ES_VERSION_3_0) && !defined(GL_VERSION_4_1))
@@ -135,4 +192,24 @@
 #define GL41_HEADERS false
 #endif
 
+#if defined(GL_VERSION_4_3)
+#define GL43_HEADERS true
+#else
+#define GL43_HEADERS false
+#endif
+
+// glDispatchCompute() and friends are available (they can still be null when imported)
+#if GLES31_HEADERS || GL43_HEADERS || defined(GL_COMPUTE_ENTRY_POINTS_IMPORTED)
+#define HAS_COMPUTE_ENTRY_POINTS true
+#else
+#define HAS_COMPUTE_ENTRY_POINTS false
+#endif
+
+// glBufferStorage() is available (it can still be null when imported)
+#if defined(GL_VERSION_4_4) || defined(GL_BUFFER_STORAGE_ENTRY_POINTS_IMPORTED)
+#define HAS_BUFFER_STORAGE true
+#else
+#define HAS_BUFFER_STORAGE false
+#endif
+
 #endif // TNT_FILAMENT_DRIVER_GL_HEADERS_H
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan/VulkanBarriers.h"
+
+using namespace bluevk;
+
+namespace filament {
+namespace backend {
+
+static bool overlaps(uint32_t base0, uint32_t count0, uint32_t base1, uint32_t count1) {
+    // VK_REMAINING_* counts are all ones, which saturates the end of the range
+    const uint64_t end0 = uint64_t(base0) + count0;
+    const uint64_t end1 = uint64_t(base1) + count1;
+    return base0 < end1 && base1 < end0;
+}
+
+static bool overlaps(VkImageMemoryBarrier const& lhs, VkImageMemoryBarrier const& rhs) {
+    VkImageSubresourceRange const& a = lhs.subresourceRange;
+    VkImageSubresourceRange const& b = rhs.subresourceRange;
+    return lhs.image == rhs.image && (a.aspectMask & b.aspectMask) &&
+            overlaps(a.baseMipLevel, a.levelCount, b.baseMipLevel, b.levelCount) &&
+            overlaps(a.baseArrayLayer, a.layerCount, b.baseArrayLayer, b.layerCount);
+}
+
+void VulkanBarrierBatch::add(VkCommandBuffer cmdbuffer, VkPipelineStageFlags srcStages,
+        VkPipelineStageFlags dstStages, VkImageMemoryBarrier const& barrier) {
+    for (VkImageMemoryBarrier const& pending : mImageBarriers) {
+        if (overlaps(pending, barrier)) {
+            record(cmdbuffer);
+            break;
+        }
+    }
+    mSrcStages |= srcStages;
+    mDstStages |= dstStages;
+    mImageBarriers.push_back(barrier);
+}
+
+void VulkanBarrierBatch::add(VkCommandBuffer cmdbuffer, VkPipelineStageFlags srcStages,
+        VkPipelineStageFlags dstStages, VkBufferMemoryBarrier const& barrier) {
+    for (VkBufferMemoryBarrier const& pending : mBufferBarriers) {
+        if (pending.buffer == barrier.buffer) {
+            record(cmdbuffer);
+            break;
+        }
+    }
+    mSrcStages |= srcStages;
+    mDstStages |= dstStages;
+    mBufferBarriers.push_back(barrier);
+}
+
+void VulkanBarrierBatch::clear() noexcept {
+    mSrcStages = 0;
+    mDstStages = 0;
+    mImageBarriers.clear();
+    mBufferBarriers.clear();
+}
+
+void VulkanBarrierBatch::record(VkCommandBuffer cmdbuffer) noexcept {
+    vkCmdPipelineBarrier(cmdbuffer, mSrcStages, mDstStages, 0, 0, nullptr,
+            uint32_t(mBufferBarriers.size()), mBufferBarriers.data(),
+            uint32_t(mImageBarriers.size()), mImageBarriers.data());
+    clear();
+}
+
+} // namespace filament
+} // namespace backend
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_VULKANBARRIERS_H
+#define TNT_FILAMENT_DRIVER_VULKANBARRIERS_H
+
+#include <bluevk/BlueVK.h>
+
+#include <utils/compiler.h>
+
+#include <vector>
+
+namespace filament {
+namespace backend {
+
+// Accumulates the pipeline barriers of a command buffer, so that consecutive layout transitions
+// and buffer barriers are recorded by a single vkCmdPipelineBarrier. The pending barriers must be
+// flushed before recording a command that depends on them: copies, blits, render passes and
+// draws, and before ending the command buffer.
+//
+// Barriers are unordered within a vkCmdPipelineBarrier, so adding a barrier that overlaps a
+// pending one (e.g. two successive transitions of the same miplevel) flushes the pending ones
+// first. The stage masks of the batch are the union of the masks of its barriers.
+class VulkanBarrierBatch {
+public:
+    void add(VkCommandBuffer cmdbuffer, VkPipelineStageFlags srcStages,
+            VkPipelineStageFlags dstStages, VkImageMemoryBarrier const& barrier);
+
+    void add(VkCommandBuffer cmdbuffer, VkPipelineStageFlags srcStages,
+            VkPipelineStageFlags dstStages, VkBufferMemoryBarrier const& barrier);
+
+    // Records the pending barriers into the given command buffer, if there are any.
+    void flush(VkCommandBuffer cmdbuffer) noexcept {
+        if (UTILS_UNLIKELY(!empty())) {
+            record(cmdbuffer);
+        }
+    }
+
+    bool empty() const noexcept {
+        return mImageBarriers.empty() && mBufferBarriers.empty();
+    }
+
+    // Drops the pending barriers, e.g. when the command buffer is reset.
+    void clear() noexcept;
+
+private:
+    void record(VkCommandBuffer cmdbuffer) noexcept;
+
+    VkPipelineStageFlags mSrcStages = 0;
+    VkPipelineStageFlags mDstStages = 0;
+    std::vector<VkImageMemoryBarrier> mImageBarriers;
+    std::vector<VkBufferMemoryBarrier> mBufferBarriers;
+};
+
+} // namespace filament
+} // namespace backend
+
+#endif // TNT_FILAMENT_DRIVER_VULKANBARRIERS_H
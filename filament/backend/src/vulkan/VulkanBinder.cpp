@@ -20,6 +20,8 @@
 #include <utils/Panic.h>
 #include <utils/trap.h>
 
+#include <algorithm>
+
 #define FILAMENT_VULKAN_VERBOSE 0
 
 // Vulkan functions often immediately dereference pointers, so it's fine to pass in a pointer
@@ -36,11 +38,8 @@ namespace backend {
 // allocator by passing in a null pointer, and we pinpoint the argument by using the VKALLOC macro.
 static constexpr VkAllocationCallbacks* VKALLOC = nullptr;
 
-// Maximum number of descriptor sets that can be allocated by the pool.
-// TODO: Make VulkanBinder robust against a large number of descriptors.
-// There are several approaches we could take to deal with too many descriptors:
-// - Create another pool after hitting the limit of the first pool.
-// - Allow several uniform buffer descriptors to bind simultaneously instead of just one.
+// Maximum number of descriptor sets that can be allocated by each pool. Another pool is created
+// when all the existing ones are full.
 static constexpr uint32_t MAX_DESCRIPTOR_SET_COUNT = 1500;
 
 static VulkanBinder::RasterState createDefaultRasterState();
@@ -68,22 +67,32 @@ VulkanBinder::~VulkanBinder() {
 }
 
 bool VulkanBinder::getOrCreateDescriptors(VkDescriptorSet descriptorSets[3],
-        VkPipelineLayout* pipelineLayout) noexcept {
+        VkPipelineLayout* pipelineLayout, uint32_t dynamicOffsets[UBUFFER_BINDING_COUNT]) noexcept {
     // If this method has never been called before, we need to create a new layout object.
     if (!mPipelineLayout) {
         createLayoutsAndDescriptors();
     }
 
+    for (uint32_t binding = 0; binding < UBUFFER_BINDING_COUNT; binding++) {
+        dynamicOffsets[binding] = mDynamicOffsets[binding];
+    }
+
     // If no bindings have been dirtied, update the timestamp (most recent access) and return false
-    // to indicate there's no need to re-bind.
+    // to indicate there's no need to re-bind, unless only the dynamic offsets have changed.
     if (!mDirtyDescriptor) {
         assert(mCurrentDescriptorBundle && mCurrentDescriptorBundle->bound);
         descriptorSets[0] = mCurrentDescriptorBundle->handles[0];
         descriptorSets[1] = mCurrentDescriptorBundle->handles[1];
         descriptorSets[2] = mCurrentDescriptorBundle->handles[2];
         mCurrentDescriptorBundle->timestamp = mCurrentTime;
+        if (mDirtyDynamicOffsets) {
+            mDirtyDynamicOffsets = false;
+            *pipelineLayout = mPipelineLayout;
+            return true;
+        }
         return false;
     }
+    mDirtyDynamicOffsets = false;
 
     // Release the previously bound descriptor and update its time stamp.
     if (mCurrentDescriptorBundle) {
@@ -96,6 +105,7 @@ bool VulkanBinder::getOrCreateDescriptors(VkDescriptorSet descriptorSets[3],
     // value method for obtaining a stable reference.
     auto iter = mDescriptorBundles.find(mDescriptorKey);
     if (UTILS_LIKELY(iter != mDescriptorBundles.end())) {
+        mStats.descriptorHits++;
         mCurrentDescriptorBundle = &iter.value();
         descriptorSets[0] = mCurrentDescriptorBundle->handles[0];
         descriptorSets[1] = mCurrentDescriptorBundle->handles[1];
@@ -107,13 +117,21 @@ bool VulkanBinder::getOrCreateDescriptors(VkDescriptorSet descriptorSets[3],
         return true;
     }
 
+    mStats.descriptorMisses++;
+
     // Allocate one descriptor set for each type: uniforms, samplers, and input attachments.
     VkDescriptorSetAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = mDescriptorPool;
+    allocInfo.descriptorPool = mDescriptorPools.back();
     allocInfo.descriptorSetCount = 3;
     allocInfo.pSetLayouts = mDescriptorSetLayouts;
     VkResult err = vkAllocateDescriptorSets(mDevice, &allocInfo, descriptorSets);
+    if (UTILS_UNLIKELY(err)) {
+        // The pool is exhausted (or fragmented), grow instead of flushing the cache.
+        createDescriptorPool();
+        allocInfo.descriptorPool = mDescriptorPools.back();
+        err = vkAllocateDescriptorSets(mDevice, &allocInfo, descriptorSets);
+    }
     ASSERT_POSTCONDITION(!err, "Unable to allocate descriptor set.");
     *pipelineLayout = mPipelineLayout;
 
@@ -123,7 +141,8 @@ bool VulkanBinder::getOrCreateDescriptors(VkDescriptorSet descriptorSets[3],
     auto& bundle = mDescriptorBundles.emplace(std::make_pair(mDescriptorKey, DescriptorBundle {
         .handles = { descriptorSets[0], descriptorSets[1], descriptorSets[2] },
         .timestamp = mCurrentTime,
-        .bound = true
+        .bound = true,
+        .pool = allocInfo.descriptorPool
     })).first.value();
 
     mCurrentDescriptorBundle = &bundle;
@@ -137,7 +156,7 @@ bool VulkanBinder::getOrCreateDescriptors(VkDescriptorSet descriptorSets[3],
         if (mDescriptorKey.uniformBuffers[binding]) {
             VkDescriptorBufferInfo& bufferInfo = mDescriptorBuffers[binding];
             bufferInfo.buffer = mDescriptorKey.uniformBuffers[binding];
-            bufferInfo.offset = mDescriptorKey.uniformBufferOffsets[binding];
+            bufferInfo.offset = 0;
             bufferInfo.range = mDescriptorKey.uniformBufferSizes[binding];
             VkWriteDescriptorSet& writeInfo = writes[nwrites++];
             writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -146,7 +165,7 @@ bool VulkanBinder::getOrCreateDescriptors(VkDescriptorSet descriptorSets[3],
             writeInfo.dstBinding = binding;
             writeInfo.dstArrayElement = 0;
             writeInfo.descriptorCount = 1;
-            writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             writeInfo.pImageInfo = nullptr;
             writeInfo.pBufferInfo = &bufferInfo;
             writeInfo.pTexelBufferView = nullptr;
@@ -214,6 +233,7 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
     // method for obtaining a stable reference.
     auto iter = mPipelines.find(mPipelineKey);
     if (UTILS_LIKELY(iter != mPipelines.end())) {
+        mStats.pipelineHits++;
         mCurrentPipeline = &iter.value();
         *pipeline = mCurrentPipeline->handle;
         mCurrentPipeline->timestamp = mCurrentTime;
@@ -223,6 +243,7 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
     }
 
     // If we reach this point, we need to create and stash a brand new pipeline object.
+    mStats.pipelineMisses++;
     mShaderStages[0].module = mPipelineKey.shaders[0];
     mShaderStages[1].module = mPipelineKey.shaders[1];
 
@@ -299,7 +320,7 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
             << mShaderStages[0].module << ", " << mShaderStages[1].module << ")" << utils::io::endl;
     #endif
 
-    VkResult err = vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo,
+    VkResult err = vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &pipelineCreateInfo,
             VKALLOC, pipeline);
     if (err) {
         utils::slog.e << "vkCreateGraphicsPipelines error " << err << utils::io::endl;
@@ -322,6 +343,7 @@ void VulkanBinder::bindProgramBundle(const ProgramBundle& bundle) noexcept {
             mDirtyPipeline = true;
             mPipelineKey.shaders[ssi] = shaders[ssi];
         }
+        mShaderStages[ssi].pSpecializationInfo = bundle.specializationInfo;
     }
 }
 
@@ -401,7 +423,7 @@ void VulkanBinder::unbindUniformBuffer(VkBuffer uniformBuffer) noexcept {
         if (key.uniformBuffers[bindingIndex] == uniformBuffer) {
             key.uniformBuffers[bindingIndex] = {};
             key.uniformBufferSizes[bindingIndex] = {};
-            key.uniformBufferOffsets[bindingIndex] = {};
+            mDynamicOffsets[bindingIndex] = 0;
             mDirtyDescriptor = true;
         }
     }
@@ -455,7 +477,8 @@ void VulkanBinder::evictDescriptors(std::function<bool(const DescriptorKey&)> fi
             mDescriptorGraveyard.push_back({
                 .handles = { cacheEntry.handles[0], cacheEntry.handles[1], cacheEntry.handles[2] },
                 .timestamp = cacheEntry.timestamp,
-                .bound = false
+                .bound = false,
+                .pool = cacheEntry.pool
             });
             iter = mDescriptorBundles.erase(iter);
         } else {
@@ -471,13 +494,16 @@ void VulkanBinder::bindUniformBuffer(uint32_t bindingIndex, VkBuffer uniformBuff
             bindingIndex, UBUFFER_BINDING_COUNT);
     auto& key = mDescriptorKey;
     if (key.uniformBuffers[bindingIndex] != uniformBuffer ||
-        key.uniformBufferOffsets[bindingIndex] != offset ||
         key.uniformBufferSizes[bindingIndex] != size) {
         key.uniformBuffers[bindingIndex] = uniformBuffer;
-        key.uniformBufferOffsets[bindingIndex] = offset;
         key.uniformBufferSizes[bindingIndex] = size;
         mDirtyDescriptor = true;
     }
+    // A new offset into the same buffer doesn't need a new descriptor set.
+    if (mDynamicOffsets[bindingIndex] != offset) {
+        mDynamicOffsets[bindingIndex] = uint32_t(offset);
+        mDirtyDynamicOffsets = true;
+    }
 }
 
 void VulkanBinder::bindSampler(uint32_t bindingIndex, VkDescriptorImageInfo samplerInfo) noexcept {
@@ -515,6 +541,10 @@ void VulkanBinder::destroyCache() noexcept {
         vkDestroyPipeline(mDevice, iter.second.handle, VKALLOC);
     }
     mPipelines.clear();
+    for (auto const& val : mPipelineGraveyard) {
+        vkDestroyPipeline(mDevice, val.handle, VKALLOC);
+    }
+    mPipelineGraveyard.clear();
     mCurrentPipeline = nullptr;
     mDirtyPipeline = true;
 }
@@ -530,6 +560,18 @@ void VulkanBinder::resetBindings() noexcept {
 // frame counter. Frames are a better metric than wall clock because we know with certainty that
 // objects last bound more than n frames ago are no longer in use (due to existing fences).
 void VulkanBinder::gc() noexcept {
+    mStats.descriptorPoolCount = uint32_t(mDescriptorPools.size());
+    mLastStats = mStats;
+    mStats = {};
+
+    #if FILAMENT_VULKAN_VERBOSE
+    utils::slog.d << "VulkanBinder: descriptors " << mLastStats.descriptorHits << " hits, "
+            << mLastStats.descriptorMisses << " misses, "
+            << mLastStats.descriptorEvictions << " evictions; pipelines "
+            << mLastStats.pipelineHits << " hits, " << mLastStats.pipelineMisses << " misses, "
+            << mLastStats.pipelineEvictions << " evictions" << utils::io::endl;
+    #endif
+
     // If this is one of the first few frames, return early to avoid wrapping unsigned integers.
     if (++mCurrentTime <= TIME_BEFORE_EVICTION) {
         return;
@@ -541,8 +583,9 @@ void VulkanBinder::gc() noexcept {
             iter != mDescriptorBundles.end();) {
         auto& cacheEntry = iter->second;
         if (cacheEntry.timestamp < evictTime && !cacheEntry.bound) {
-            vkFreeDescriptorSets(mDevice, mDescriptorPool, 3, cacheEntry.handles);
+            vkFreeDescriptorSets(mDevice, cacheEntry.pool, 3, cacheEntry.handles);
             iter = mDescriptorBundles.erase(iter);
+            mStats.descriptorEvictions++;
         } else {
             ++iter;
         }
@@ -553,10 +596,15 @@ void VulkanBinder::gc() noexcept {
         if (cacheEntry.timestamp < evictTime && !cacheEntry.bound) {
             vkDestroyPipeline(mDevice, cacheEntry.handle, VKALLOC);
             iter = mPipelines.erase(iter);
+            mStats.pipelineEvictions++;
         } else {
             ++iter;
         }
     }
+
+    // Objects used in the last few frames are kept above, but the caches are still bounded.
+    evictLeastRecentlyUsed();
+
     // The graveyard is composed of descriptors that contain references to extinct objects. We
     // take care only to free the ones that are old enough to be evicted, since they might be
     // referenced in a command buffer that hasn't finished executing.
@@ -564,14 +612,73 @@ void VulkanBinder::gc() noexcept {
     graveyard.swap(mDescriptorGraveyard);
     for (auto& val : graveyard) {
         if (val.timestamp < evictTime) {
-           vkFreeDescriptorSets(mDevice, mDescriptorPool, 3, val.handles);
+           vkFreeDescriptorSets(mDevice, val.pool, 3, val.handles);
         } else {
             mDescriptorGraveyard.emplace_back(DescriptorBundle {
                 .handles = { val.handles[0], val.handles[1], val.handles[2] },
-                .timestamp = val.timestamp
+                .timestamp = val.timestamp,
+                .bound = false,
+                .pool = val.pool
             });
         }
     }
+    decltype(mPipelineGraveyard) pipelineGraveyard;
+    pipelineGraveyard.swap(mPipelineGraveyard);
+    for (auto& val : pipelineGraveyard) {
+        if (val.timestamp < evictTime) {
+            vkDestroyPipeline(mDevice, val.handle, VKALLOC);
+        } else {
+            mPipelineGraveyard.push_back(val);
+        }
+    }
+}
+
+// Moves the least recently used objects that are not bound out of the caches when they are too
+// big. They might still be referenced by a command buffer, so they go to the graveyards.
+void VulkanBinder::evictLeastRecentlyUsed() noexcept {
+    if (mDescriptorBundles.size() > MAX_CACHED_DESCRIPTOR_BUNDLES) {
+        std::vector<uint32_t> timestamps;
+        timestamps.reserve(mDescriptorBundles.size());
+        for (auto const& pair : mDescriptorBundles) {
+            timestamps.push_back(pair.second.timestamp);
+        }
+        // evict everything at least as old as the n-th most recent entry
+        const size_t excess = mDescriptorBundles.size() - MAX_CACHED_DESCRIPTOR_BUNDLES;
+        std::nth_element(timestamps.begin(), timestamps.begin() + excess - 1, timestamps.end());
+        const uint32_t oldest = timestamps[excess - 1];
+        for (decltype(mDescriptorBundles)::const_iterator iter = mDescriptorBundles.begin();
+                iter != mDescriptorBundles.end();) {
+            auto& cacheEntry = iter->second;
+            if (cacheEntry.timestamp <= oldest && !cacheEntry.bound) {
+                mDescriptorGraveyard.push_back(cacheEntry);
+                iter = mDescriptorBundles.erase(iter);
+                mStats.descriptorEvictions++;
+            } else {
+                ++iter;
+            }
+        }
+    }
+    if (mPipelines.size() > MAX_CACHED_PIPELINES) {
+        std::vector<uint32_t> timestamps;
+        timestamps.reserve(mPipelines.size());
+        for (auto const& pair : mPipelines) {
+            timestamps.push_back(pair.second.timestamp);
+        }
+        const size_t excess = mPipelines.size() - MAX_CACHED_PIPELINES;
+        std::nth_element(timestamps.begin(), timestamps.begin() + excess - 1, timestamps.end());
+        const uint32_t oldest = timestamps[excess - 1];
+        for (decltype(mPipelines)::const_iterator iter = mPipelines.begin();
+                iter != mPipelines.end();) {
+            auto& cacheEntry = iter->second;
+            if (cacheEntry.timestamp <= oldest && !cacheEntry.bound) {
+                mPipelineGraveyard.push_back({ cacheEntry.handle, cacheEntry.timestamp });
+                iter = mPipelines.erase(iter);
+                mStats.pipelineEvictions++;
+            } else {
+                ++iter;
+            }
+        }
+    }
 }
 
 void VulkanBinder::createLayoutsAndDescriptors() noexcept {
@@ -581,7 +688,7 @@ void VulkanBinder::createLayoutsAndDescriptors() noexcept {
 
     // First create the descriptor set layout for UBO's.
     VkDescriptorSetLayoutBinding ubindings[UBUFFER_BINDING_COUNT];
-    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     for (uint32_t i = 0; i < UBUFFER_BINDING_COUNT; i++) {
         binding.binding = i;
         ubindings[i] = binding;
@@ -624,7 +731,10 @@ void VulkanBinder::createLayoutsAndDescriptors() noexcept {
             &mPipelineLayout);
     ASSERT_POSTCONDITION(!err, "Unable to create pipeline layout.");
 
-    // Create the VkDescriptorPool.
+    createDescriptorPool();
+}
+
+void VulkanBinder::createDescriptorPool() noexcept {
     VkDescriptorPoolSize poolSizes[3] = {};
     VkDescriptorPoolCreateInfo poolInfo {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -634,15 +744,17 @@ void VulkanBinder::createLayoutsAndDescriptors() noexcept {
         .poolSizeCount = 3,
         .pPoolSizes = poolSizes
     };
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     poolSizes[0].descriptorCount = poolInfo.maxSets * UBUFFER_BINDING_COUNT;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = poolInfo.maxSets * SAMPLER_BINDING_COUNT;
     poolSizes[2].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
     poolSizes[2].descriptorCount = poolInfo.maxSets * TARGET_BINDING_COUNT;
 
-    err = vkCreateDescriptorPool(mDevice, &poolInfo, VKALLOC, &mDescriptorPool);
+    VkDescriptorPool pool;
+    VkResult err = vkCreateDescriptorPool(mDevice, &poolInfo, VKALLOC, &pool);
     ASSERT_POSTCONDITION(!err, "Unable to create descriptor pool.");
+    mDescriptorPools.push_back(pool);
 }
 
 void VulkanBinder::destroyLayoutsAndDescriptors() noexcept {
@@ -664,8 +776,12 @@ void VulkanBinder::destroyLayoutsAndDescriptors() noexcept {
         vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayouts[i], VKALLOC);
         mDescriptorSetLayouts[i] = {};
     }
-    vkDestroyDescriptorPool(mDevice, mDescriptorPool, VKALLOC);
-    mDescriptorPool = VK_NULL_HANDLE;
+    // destroying the pools frees all their descriptor sets, including the ones in the graveyard
+    mDescriptorGraveyard.clear();
+    for (VkDescriptorPool pool : mDescriptorPools) {
+        vkDestroyDescriptorPool(mDevice, pool, VKALLOC);
+    }
+    mDescriptorPools.clear();
     mCurrentDescriptorBundle = nullptr;
     mDirtyDescriptor = true;
 }
@@ -679,7 +795,6 @@ bool VulkanBinder::DescEqual::operator()(const VulkanBinder::DescriptorKey& k1,
         const VulkanBinder::DescriptorKey& k2) const {
     for (uint32_t i = 0; i < UBUFFER_BINDING_COUNT; i++) {
         if (k1.uniformBuffers[i] != k2.uniformBuffers[i] ||
-            k1.uniformBufferOffsets[i] != k2.uniformBufferOffsets[i] ||
             k1.uniformBufferSizes[i] != k2.uniformBufferSizes[i]) {
             return false;
         }
@@ -50,8 +50,9 @@ namespace backend {
 //        mBinder.bindPrimitiveTopology(geo.topology);
 //        mBinder.bindVertexArray(geo.varray);
 //        VkDescriptorSet descriptors[3];
-//        if (mBinder.getOrCreateDescriptors(descriptors, ...)) {
-//            vkCmdBindDescriptorSets(... descriptors ...);
+//        uint32_t offsets[UBUFFER_BINDING_COUNT];
+//        if (mBinder.getOrCreateDescriptors(descriptors, &layout, offsets)) {
+//            vkCmdBindDescriptorSets(... descriptors ... offsets ...);
 //        }
 //        VkPipeline pipeline;
 //        if (mBinder.getOrCreatePipeline(&pipeline)) {
@@ -69,6 +70,8 @@ namespace backend {
 // - Push constants are not supported. (if adding support, see VkPipelineLayoutCreateInfo)
 // - Only three descriptor sets are bound at a time (one for each type of descriptor).
 // - Descriptor sets are never mutated using vkUpdateDescriptorSets, except upon creation.
+// - Uniform buffers are dynamic descriptors, so binding a different range of the same buffer
+//   (e.g. per-renderable data) only changes the dynamic offsets, not the descriptor set.
 // - Assumes that viewport and scissor should be dynamic. (not baked into VkPipeline)
 // - Assumes that uniform buffers should be visible across all shader stages.
 //
@@ -89,10 +92,13 @@ public:
         VkVertexInputBindingDescription buffers[VERTEX_ATTRIBUTE_COUNT];
     };
 
-    // The ProgramBundle contains weak references to the compiled vertex and fragment shaders.
+    // The ProgramBundle contains weak references to the compiled vertex and fragment shaders, and
+    // to the values of their specialization constants (null if there are none). The constants
+    // aren't part of the pipeline key since shader modules are not shared among programs.
     struct ProgramBundle {
         VkShaderModule vertex;
         VkShaderModule fragment;
+        const VkSpecializationInfo* specializationInfo;
     };
 
     // The RasterState POD contains standard graphics-related state like blending, culling, etc.
@@ -107,6 +113,17 @@ public:
     };
     static_assert(std::is_pod<RasterState>::value, "RasterState must be a POD for fast hashing.");
 
+    // Cache counters, reset by each call to gc().
+    struct Stats {
+        uint32_t descriptorHits;
+        uint32_t descriptorMisses;
+        uint32_t descriptorEvictions;
+        uint32_t pipelineHits;
+        uint32_t pipelineMisses;
+        uint32_t pipelineEvictions;
+        uint32_t descriptorPoolCount;
+    };
+
     // Upon construction, the binder initializes some internal state but does not make any Vulkan
     // calls. On destruction it will free any cached Vulkan objects that haven't already been freed
     // via resetBindings(). We don't pass the VkDevice to the constructor to allow the client to own
@@ -115,13 +132,18 @@ public:
     ~VulkanBinder();
     void setDevice(VkDevice device) { mDevice = device; }
 
+    // Sets the VkPipelineCache used when creating new pipelines. The cache is owned by the client,
+    // which is responsible for its serialization and destruction. VK_NULL_HANDLE is allowed.
+    void setPipelineCache(VkPipelineCache cache) { mPipelineCache = cache; }
+
     // Clients should initialize their copy of the raster state using this method. They can then
     // mutate their copy and pass it back through bindRasterState().
     const RasterState& getDefaultRasterState() const { return mDefaultRasterState; }
 
-    // Returns true if vkCmdBindDescriptorSets is required.
-    bool getOrCreateDescriptors(VkDescriptorSet descriptors[3], VkPipelineLayout* pipelineLayout)
-            noexcept;
+    // Returns true if vkCmdBindDescriptorSets is required, with the given dynamic offsets (one for
+    // each uniform buffer binding).
+    bool getOrCreateDescriptors(VkDescriptorSet descriptors[3], VkPipelineLayout* pipelineLayout,
+            uint32_t dynamicOffsets[UBUFFER_BINDING_COUNT]) noexcept;
 
     // Returns true if any pipeline bindings have changed. (i.e., vkCmdBindPipeline is required)
     bool getOrCreatePipeline(VkPipeline* pipeline) noexcept;
@@ -161,6 +183,9 @@ public:
     // Evicts old unused Vulkan objects. Call this once per frame.
     void gc() noexcept;
 
+    // Returns the counters of the frame that ended with the last call to gc().
+    Stats const& getStats() const noexcept { return mLastStats; }
+
 private:
     // The pipeline key is a POD that represents all currently bound states that form the immutable
     // VkPipeline object. We apply a hash function to its contents only if has been mutated since
@@ -193,13 +218,13 @@ private:
 
     // The descriptor key is a POD that represents all currently bound states that go into the
     // descriptor set. We apply a hash function to its contents only if has been mutated since
-    // the previous call to getOrCreateDescriptors.
+    // the previous call to getOrCreateDescriptors. Uniform buffer offsets are not part of it
+    // since they are dynamic.
     #pragma pack(push, 1)
     struct UTILS_PACKED DescriptorKey {
         VkBuffer uniformBuffers[UBUFFER_BINDING_COUNT];
         VkDescriptorImageInfo samplers[SAMPLER_BINDING_COUNT];
         VkDescriptorImageInfo inputAttachments[TARGET_BINDING_COUNT];
-        VkDeviceSize uniformBufferOffsets[UBUFFER_BINDING_COUNT];
         VkDeviceSize uniformBufferSizes[UBUFFER_BINDING_COUNT];
     };
     #pragma pack(pop)
@@ -217,13 +242,23 @@ private:
         VkDescriptorSet handles[3];
         uint32_t timestamp;
         bool bound;
+        VkDescriptorPool pool;
+    };
+
+    // A pipeline that is no longer cached, but might still be used by a command buffer.
+    struct PipelineTombstone {
+        VkPipeline handle;
+        uint32_t timestamp;
     };
 
     void createLayoutsAndDescriptors() noexcept;
     void destroyLayoutsAndDescriptors() noexcept;
+    void createDescriptorPool() noexcept;
     void evictDescriptors(std::function<bool(const DescriptorKey&)> filter) noexcept;
+    void evictLeastRecentlyUsed() noexcept;
 
     VkDevice mDevice = nullptr;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
     const RasterState mDefaultRasterState;
 
     // These structs are used only in a transient way but are stored for convenience.
@@ -241,6 +276,7 @@ private:
     // uniform buffers).
     PipelineKey mPipelineKey;
     DescriptorKey mDescriptorKey;
+    uint32_t mDynamicOffsets[UBUFFER_BINDING_COUNT] = {};
 
     // Weak references to the currently bound pipeline and descriptor sets.
     PipelineVal* mCurrentPipeline = nullptr;
@@ -250,18 +286,28 @@ private:
     // a new pipeline or descriptor set needs to be retrieved from the cache or created.
     bool mDirtyPipeline = true;
     bool mDirtyDescriptor = true;
+    bool mDirtyDynamicOffsets = true;
 
     // Cached Vulkan objects. These objects are owned by the Binder.
     VkDescriptorSetLayout mDescriptorSetLayouts[3] = {};
     VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
     tsl::robin_map<PipelineKey, PipelineVal, PipelineHashFn, PipelineEqual> mPipelines;
     tsl::robin_map<DescriptorKey, DescriptorBundle, DescHashFn, DescEqual> mDescriptorBundles;
-    VkDescriptorPool mDescriptorPool;
+    // Descriptor sets are allocated from the last pool, a new pool is added when it is full.
+    std::vector<VkDescriptorPool> mDescriptorPools;
     std::vector<DescriptorBundle> mDescriptorGraveyard;
+    std::vector<PipelineTombstone> mPipelineGraveyard;
+
+    Stats mStats = {};
+    Stats mLastStats = {};
 
     // Store the current "time" (really just a frame count) and LRU eviction parameters.
     uint32_t mCurrentTime = 0;
     static constexpr uint32_t TIME_BEFORE_EVICTION = 3;
+
+    // Beyond these sizes, the least recently used objects are evicted even if they are recent.
+    static constexpr uint32_t MAX_CACHED_DESCRIPTOR_BUNDLES = 1024;
+    static constexpr uint32_t MAX_CACHED_PIPELINES = 512;
 };
 
 } // namespace filament
@@ -29,7 +29,7 @@ using namespace bluevk;
 namespace filament {
 namespace backend {
 
-void VulkanBlitter::blitColor(VkCommandBuffer cmdBuffer, BlitArgs args) {
+void VulkanBlitter::blitColor(VulkanCommandBuffer& commands, BlitArgs args) {
     lazyInit();
     const VulkanAttachment src = args.srcTarget->getColor(args.targetIndex);
     const VulkanAttachment dst = args.dstTarget->getColor(0);
@@ -51,10 +51,10 @@ void VulkanBlitter::blitColor(VkCommandBuffer cmdBuffer, BlitArgs args) {
 #endif
 
     blitFast(aspect, args.filter, args.srcTarget, src, dst, args.srcRectPair, args.dstRectPair,
-            cmdBuffer);
+            commands);
 }
 
-void VulkanBlitter::blitDepth(VkCommandBuffer cmdBuffer, BlitArgs args) {
+void VulkanBlitter::blitDepth(VulkanCommandBuffer& commands, BlitArgs args) {
     lazyInit();
     const VulkanAttachment src = args.srcTarget->getDepth();
     const VulkanAttachment dst = args.dstTarget->getDepth();
@@ -76,12 +76,12 @@ void VulkanBlitter::blitDepth(VkCommandBuffer cmdBuffer, BlitArgs args) {
 #endif
 
     blitFast(aspect, args.filter, args.srcTarget, src, dst, args.srcRectPair, args.dstRectPair,
-            cmdBuffer);
+            commands);
 }
 
 void VulkanBlitter::blitFast(VkImageAspectFlags aspect, VkFilter filter,
     const VulkanRenderTarget* srcTarget, VulkanAttachment src, VulkanAttachment dst,
-    const VkOffset3D srcRect[2], const VkOffset3D dstRect[2], VkCommandBuffer cmdbuffer) {
+    const VkOffset3D srcRect[2], const VkOffset3D dstRect[2], VulkanCommandBuffer& commands) {
     const VkImageBlit blitRegions[1] = {{
         .srcSubresource = { aspect, src.level, src.layer, 1 },
         .srcOffsets = { srcRect[0], srcRect[1] },
@@ -99,12 +99,16 @@ void VulkanBlitter::blitFast(VkImageAspectFlags aspect, VkFilter filter,
         .extent = { srcExtent.width, srcExtent.height, 1 }
     }};
 
-    VulkanTexture::transitionImageLayout(cmdbuffer, src.image, VK_IMAGE_LAYOUT_UNDEFINED,
+    const VkCommandBuffer cmdbuffer = commands.cmdbuffer;
+
+    VulkanTexture::transitionImageLayout(commands, src.image, VK_IMAGE_LAYOUT_UNDEFINED,
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, src.level, 1, 1, aspect);
 
-    VulkanTexture::transitionImageLayout(cmdbuffer, dst.image, VK_IMAGE_LAYOUT_UNDEFINED,
+    VulkanTexture::transitionImageLayout(commands, dst.image, VK_IMAGE_LAYOUT_UNDEFINED,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, dst.level, 1, 1, aspect);
 
+    commands.barriers.flush(cmdbuffer);
+
     if (src.texture && src.texture->samples > 1 && dst.texture && dst.texture->samples == 1) {
         assert(aspect != VK_IMAGE_ASPECT_DEPTH_BIT && "Resolve with depth is not yet supported.");
         vkCmdResolveImage(cmdbuffer, src.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.image,
@@ -115,10 +119,10 @@ void VulkanBlitter::blitFast(VkImageAspectFlags aspect, VkFilter filter,
     }
 
     if (src.texture) {
-        VulkanTexture::transitionImageLayout(cmdbuffer, src.image, VK_IMAGE_LAYOUT_UNDEFINED,
+        VulkanTexture::transitionImageLayout(commands, src.image, VK_IMAGE_LAYOUT_UNDEFINED,
                 getTextureLayout(src.texture->usage), src.level, 1, 1, aspect);
     } else if  (!mContext.currentSurface->headlessQueue) {
-        VulkanTexture::transitionImageLayout(cmdbuffer, src.image, VK_IMAGE_LAYOUT_UNDEFINED,
+        VulkanTexture::transitionImageLayout(commands, src.image, VK_IMAGE_LAYOUT_UNDEFINED,
                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, src.level, 1, 1, aspect);
     }
 
@@ -127,7 +131,7 @@ void VulkanBlitter::blitFast(VkImageAspectFlags aspect, VkFilter filter,
     const VkImageLayout desiredLayout = dst.texture ? getTextureLayout(dst.texture->usage) :
             getSwapContext(mContext).attachment.layout;
 
-    VulkanTexture::transitionImageLayout(cmdbuffer, dst.image, VK_IMAGE_LAYOUT_UNDEFINED,
+    VulkanTexture::transitionImageLayout(commands, dst.image, VK_IMAGE_LAYOUT_UNDEFINED,
             desiredLayout, dst.level, 1, 1, aspect);
 }
 
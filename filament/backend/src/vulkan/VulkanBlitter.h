@@ -35,8 +35,8 @@ public:
         int targetIndex = 0;
     };
 
-    void blitColor(VkCommandBuffer cmdBuffer, BlitArgs args);
-    void blitDepth(VkCommandBuffer cmdBuffer, BlitArgs args);
+    void blitColor(VulkanCommandBuffer& commands, BlitArgs args);
+    void blitDepth(VulkanCommandBuffer& commands, BlitArgs args);
 
     void shutdown() noexcept;
 
@@ -45,7 +45,7 @@ private:
 
     void blitFast(VkImageAspectFlags aspect, VkFilter filter, const VulkanRenderTarget* srcTarget,
         VulkanAttachment src, VulkanAttachment dst, const VkOffset3D srcRect[2],
-        const VkOffset3D dstRect[2], VkCommandBuffer cmdBuffer);
+        const VkOffset3D dstRect[2], VulkanCommandBuffer& commands);
 
     VkShaderModule mVertex = VK_NULL_HANDLE;
     VkShaderModule mFragment = VK_NULL_HANDLE;
@@ -15,6 +15,7 @@
  */
 
 #include "vulkan/VulkanBuffer.h"
+#include "vulkan/VulkanMemoryPools.h"
 
 #include <utils/Panic.h>
 
@@ -24,38 +25,38 @@ namespace filament {
 namespace backend {
 
 VulkanBuffer::VulkanBuffer(VulkanContext& context, VulkanStagePool& stagePool,
-        VulkanDisposer& disposer, VulkanDisposer::Key key, VkBufferUsageFlags usage,
+        VulkanDisposer& disposer, VulkanDisposable* disposable, VkBufferUsageFlags usage,
         uint32_t numBytes) : mContext(context), mStagePool(stagePool), mDisposer(disposer),
-        mDisposerKey(key) {
+        mDisposable(disposable) {
     // Create the VkBuffer.
     VkBufferCreateInfo bufferInfo {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = numBytes,
         .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT
     };
-    VmaAllocationCreateInfo allocInfo {
-        .usage = VMA_MEMORY_USAGE_GPU_ONLY
-    };
-    vmaCreateBuffer(context.allocator, &bufferInfo, &allocInfo, &mGpuBuffer, &mGpuMemory, nullptr);
+    // Vertex and index buffers can be relocated, see getGpuBuffer().
+    const bool geometry = usage &
+            (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    const auto kind = geometry ? VulkanMemoryPools::Kind::GEOMETRY :
+            VulkanMemoryPools::Kind::BUFFER;
+    VkResult result = context.memoryPools->createBuffer(kind, bufferInfo, &mGpuBuffer,
+            &mGpuMemory);
+    ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to allocate a buffer.");
 }
 
 VulkanBuffer::~VulkanBuffer() {
-    vmaDestroyBuffer(mContext.allocator, mGpuBuffer, mGpuMemory);
+    mContext.memoryPools->destroyBuffer(mGpuBuffer, mGpuMemory);
 }
 
 void VulkanBuffer::loadFromCpu(const void* cpuData, uint32_t byteOffset, uint32_t numBytes) {
     assert(byteOffset == 0);
-    VulkanStage const* stage = mStagePool.acquireStage(numBytes);
-    void* mapped;
-    vmaMapMemory(mContext.allocator, stage->memory, &mapped);
-    memcpy(mapped, cpuData, numBytes);
-    vmaUnmapMemory(mContext.allocator, stage->memory);
-    vmaFlushAllocation(mContext.allocator, stage->memory, byteOffset, numBytes);
 
-    auto copyToDevice = [this, numBytes, stage] (VulkanCommandBuffer& commands) {
-        VkBufferCopy region { .size = numBytes };
-        vkCmdCopyBuffer(commands.cmdbuffer, stage->buffer, mGpuBuffer, 1, &region);
-        mDisposer.acquire(mDisposerKey, commands.resources);
+    auto copyToDevice = [this, cpuData, numBytes] (VulkanCommandBuffer& commands) {
+        VulkanStagingRegion const src = mStagePool.upload(cpuData, numBytes, commands);
+        VkBufferCopy region { .srcOffset = src.offset, .size = numBytes };
+        commands.barriers.flush(commands.cmdbuffer);
+        vkCmdCopyBuffer(commands.cmdbuffer, src.buffer, mGpuBuffer, 1, &region);
+        mDisposer.acquire(mDisposable, commands.resources);
 
         // Ensure that the copy finishes before the next draw call.
         VkBufferMemoryBarrier barrier {
@@ -67,10 +68,8 @@ void VulkanBuffer::loadFromCpu(const void* cpuData, uint32_t byteOffset, uint32_
             .buffer = mGpuBuffer,
             .size = VK_WHOLE_SIZE
         };
-        vkCmdPipelineBarrier(commands.cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
-
-        mStagePool.releaseStage(stage, commands);
+        commands.barriers.add(commands.cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, barrier);
     };
 
     // If inside beginFrame / endFrame, use the swap context, otherwise use the work cmdbuffer.
@@ -27,15 +27,19 @@ namespace backend {
 class VulkanBuffer {
 public:
     VulkanBuffer(VulkanContext& context, VulkanStagePool& stagePool, VulkanDisposer& disposer,
-            VulkanDisposer::Key mDisposerKey, VkBufferUsageFlags usage, uint32_t numBytes);
+            VulkanDisposable* disposable, VkBufferUsageFlags usage, uint32_t numBytes);
     ~VulkanBuffer();
     void loadFromCpu(const void* cpuData, uint32_t byteOffset, uint32_t numBytes);
+
+    // The VkBuffer of a vertex or index buffer changes when VulkanMemoryPools relocates it, so
+    // it must be read again by each frame rather than cached.
     VkBuffer getGpuBuffer() const { return mGpuBuffer; }
+
 private:
     VulkanContext& mContext;
     VulkanStagePool& mStagePool;
     VulkanDisposer& mDisposer;
-    VulkanDisposer::Key mDisposerKey;
+    VulkanDisposable* mDisposable;
     VmaAllocation mGpuMemory = VK_NULL_HANDLE;
     VkBuffer mGpuBuffer = VK_NULL_HANDLE;
 };
@@ -41,11 +41,29 @@ static const PFN_vkGetDeviceProcAddr& vkGetDeviceProcAddr = bluevk::vkGetDeviceP
 
 #include <utils/Panic.h>
 
+#include <array>
+
 using namespace bluevk;
 
 namespace filament {
 namespace backend {
 
+// The device extensions needed to import AHardwareBuffers, along with the extensions they depend on.
+#if defined(__ANDROID__)
+static constexpr std::array<const char*, 8> HARDWARE_BUFFER_EXTENSIONS = {
+    VK_ANDROID_EXTERNAL_MEMORY_ANDROID_HARDWARE_BUFFER_EXTENSION_NAME,
+    VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+    VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+    VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+    VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+    VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+    VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+};
+#else
+static constexpr std::array<const char*, 0> HARDWARE_BUFFER_EXTENSIONS = {};
+#endif
+
 VulkanCmdFence::VulkanCmdFence(VkDevice device, bool signaled) : device(device) {
     VkFenceCreateInfo fenceCreateInfo { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
     if (signaled) {
@@ -95,6 +113,7 @@ void selectPhysicalDevice(VulkanContext& context) {
         vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamiliesCount,
                 queueFamiliesProperties.data());
         context.graphicsQueueFamilyIndex = 0xffff;
+        context.transferQueueFamilyIndex = 0xffff;
         for (uint32_t j = 0; j < queueFamiliesCount; ++j) {
             VkQueueFamilyProperties props = queueFamiliesProperties[j];
             if (props.queueCount == 0) {
@@ -103,6 +122,11 @@ void selectPhysicalDevice(VulkanContext& context) {
             if (props.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 context.graphicsQueueFamilyIndex = j;
             }
+            // A family with only transfer capabilities is typically backed by a DMA engine.
+            const VkQueueFlags ignored = VK_QUEUE_SPARSE_BINDING_BIT;
+            if ((props.queueFlags & ~ignored) == VK_QUEUE_TRANSFER_BIT) {
+                context.transferQueueFamilyIndex = j;
+            }
         }
         if (context.graphicsQueueFamilyIndex == 0xffff) continue;
 
@@ -118,6 +142,8 @@ void selectPhysicalDevice(VulkanContext& context) {
         ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkEnumerateDeviceExtensionProperties error.");
         bool supportsSwapchain = false;
         context.debugMarkersSupported = false;
+        context.timelineSemaphoreSupported = false;
+        size_t hardwareBufferExtensions = 0;
         for (uint32_t k = 0; k < extensionCount; ++k) {
             if (!strcmp(extensions[k].extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
                 supportsSwapchain = true;
@@ -125,7 +151,17 @@ void selectPhysicalDevice(VulkanContext& context) {
             if (!strcmp(extensions[k].extensionName, VK_EXT_DEBUG_MARKER_EXTENSION_NAME)) {
                 context.debugMarkersSupported = true;
             }
+            if (!strcmp(extensions[k].extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+                context.timelineSemaphoreSupported = true;
+            }
+            for (const char* name : HARDWARE_BUFFER_EXTENSIONS) {
+                if (!strcmp(extensions[k].extensionName, name)) {
+                    hardwareBufferExtensions++;
+                }
+            }
         }
+        context.hardwareBufferSupported = !HARDWARE_BUFFER_EXTENSIONS.empty() &&
+                hardwareBufferExtensions == HARDWARE_BUFFER_EXTENSIONS.size();
         if (!supportsSwapchain) continue;
 
         // Bingo, we finally found a physical device that supports everything we need.
@@ -180,8 +216,8 @@ void selectPhysicalDevice(VulkanContext& context) {
     PANIC_POSTCONDITION("Unable to find suitable device.");
 }
 
-void createLogicalDevice(VulkanContext& context) {
-    VkDeviceQueueCreateInfo deviceQueueCreateInfo[1] = {};
+void createLogicalDevice(VulkanContext& context, uint32_t frameCount) {
+    VkDeviceQueueCreateInfo deviceQueueCreateInfo[2] = {};
     const float queuePriority[] = {1.0f};
     VkDeviceCreateInfo deviceCreateInfo = {};
     std::vector<const char*> deviceExtensionNames = {
@@ -190,6 +226,26 @@ void createLogicalDevice(VulkanContext& context) {
     if (context.debugMarkersSupported && !context.debugUtilsSupported) {
         deviceExtensionNames.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
     }
+    if (context.hardwareBufferSupported) {
+        deviceExtensionNames.insert(deviceExtensionNames.end(),
+                HARDWARE_BUFFER_EXTENSIONS.begin(), HARDWARE_BUFFER_EXTENSIONS.end());
+    }
+
+    // The extension is only useful if the feature is supported, which needs to be queried.
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+    };
+    if (context.timelineSemaphoreSupported && vkGetPhysicalDeviceFeatures2KHR) {
+        VkPhysicalDeviceFeatures2 features2 {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &timelineFeatures,
+        };
+        vkGetPhysicalDeviceFeatures2KHR(context.physicalDevice, &features2);
+    }
+    context.timelineSemaphoreSupported = timelineFeatures.timelineSemaphore == VK_TRUE;
+    if (context.timelineSemaphoreSupported) {
+        deviceExtensionNames.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
     deviceQueueCreateInfo->sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     deviceQueueCreateInfo->queueFamilyIndex = context.graphicsQueueFamilyIndex;
     deviceQueueCreateInfo->queueCount = 1;
@@ -197,6 +253,11 @@ void createLogicalDevice(VulkanContext& context) {
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.queueCreateInfoCount = 1;
     deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfo;
+    if (context.transferQueueFamilyIndex != 0xffff) {
+        deviceQueueCreateInfo[1] = deviceQueueCreateInfo[0];
+        deviceQueueCreateInfo[1].queueFamilyIndex = context.transferQueueFamilyIndex;
+        deviceCreateInfo.queueCreateInfoCount = 2;
+    }
 
     // We could simply enable all supported features, but since that may have performance
     // consequences let's just enable the features we need.
@@ -207,6 +268,9 @@ void createLogicalDevice(VulkanContext& context) {
     };
 
     deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
+    if (context.timelineSemaphoreSupported) {
+        deviceCreateInfo.pNext = &timelineFeatures;
+    }
     deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensionNames.size();
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensionNames.data();
     VkResult result = vkCreateDevice(context.physicalDevice, &deviceCreateInfo, VKALLOC,
@@ -220,8 +284,41 @@ void createLogicalDevice(VulkanContext& context) {
     createInfo.flags =
             VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     createInfo.queueFamilyIndex = context.graphicsQueueFamilyIndex;
-    result = vkCreateCommandPool(context.device, &createInfo, VKALLOC, &context.commandPool);
-    ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateCommandPool error.");
+
+    // Create the ring of frames, each with its own pool and the command buffer of its draws.
+    context.frames.resize(frameCount);
+    context.currentFrame = 0;
+    for (VulkanFrame& frame : context.frames) {
+        result = vkCreateCommandPool(context.device, &createInfo, VKALLOC, &frame.pool);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateCommandPool error.");
+        const VkCommandBufferAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame.pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        result = vkAllocateCommandBuffers(context.device, &allocateInfo,
+                &frame.commands.cmdbuffer);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkAllocateCommandBuffers error.");
+        createSemaphore(context.device, &frame.imageAvailable);
+        createSemaphore(context.device, &frame.renderingFinished);
+    }
+
+    if (context.timelineSemaphoreSupported) {
+        const VkSemaphoreTypeCreateInfoKHR typeCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+            .initialValue = 0,
+        };
+        const VkSemaphoreCreateInfo semaphoreCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &typeCreateInfo,
+        };
+        result = vkCreateSemaphore(context.device, &semaphoreCreateInfo, VKALLOC,
+                &context.timeline);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateSemaphore error.");
+        context.timelineValue = 0;
+    }
 
     // Create a timestamp pool large enough to hold a pair of queries for each timer.
     VkQueryPoolCreateInfo tqpCreateInfo = {};
@@ -265,16 +362,30 @@ void createLogicalDevice(VulkanContext& context) {
     };
     vmaCreateAllocator(&allocatorInfo, &context.allocator);
 
-    // Create the work command buffer and fence for work unrelated to the swap chain.
-    const VkCommandBufferAllocateInfo allocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = context.commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1
-    };
-    const VkCommandBufferBeginInfo binfo { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    vkAllocateCommandBuffers(context.device, &allocateInfo, &context.work.cmdbuffer);
-    vkBeginCommandBuffer(context.work.cmdbuffer, &binfo);
+    // Create the objects used by the transfer queue, if any.
+    if (context.transferQueueFamilyIndex != 0xffff) {
+        vkGetDeviceQueue(context.device, context.transferQueueFamilyIndex, 0,
+                &context.transferQueue);
+        createInfo.queueFamilyIndex = context.transferQueueFamilyIndex;
+        result = vkCreateCommandPool(context.device, &createInfo, VKALLOC,
+                &context.transferCommandPool);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateCommandPool error.");
+        const VkCommandBufferAllocateInfo transferAllocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = context.transferCommandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        vkAllocateCommandBuffers(context.device, &transferAllocateInfo,
+                &context.transferCommands);
+        const VkFenceCreateInfo fenceCreateInfo { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        vkCreateFence(context.device, &fenceCreateInfo, VKALLOC, &context.transferFence);
+        const VkSemaphoreCreateInfo semaphoreCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+        };
+        vkCreateSemaphore(context.device, &semaphoreCreateInfo, VKALLOC,
+                &context.transferFinished);
+    }
 }
 
 void getPresentationQueue(VulkanContext& context, VulkanSurfaceContext& sc) {
@@ -460,42 +571,13 @@ void createSwapChain(VulkanContext& context, VulkanSurfaceContext& surfaceContex
         ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateImageView error.");
     }
 
-    createSemaphore(context.device, &surfaceContext.imageAvailable);
-    createSemaphore(context.device, &surfaceContext.renderingFinished);
-
-    // Allocate command buffers.
-    VkCommandBufferAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocateInfo.commandPool = context.commandPool;
-    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocateInfo.commandBufferCount = (uint32_t) surfaceContext.swapContexts.size();
-    std::vector<VkCommandBuffer> cmdbufs(allocateInfo.commandBufferCount);
-    result = vkAllocateCommandBuffers(context.device, &allocateInfo, cmdbufs.data());
-    ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkAllocateCommandBuffers error.");
-    for (uint32_t i = 0; i < allocateInfo.commandBufferCount; ++i) {
-        surfaceContext.swapContexts[i].commands.cmdbuffer = cmdbufs[i];
-    }
-
     createFinalDepthBuffer(context, surfaceContext, context.finalDepthFormat);
 }
 
-void destroySwapChain(VulkanContext& context, VulkanSurfaceContext& surfaceContext,
-        VulkanDisposer& disposer) {
+void destroySwapChain(VulkanContext& context, VulkanSurfaceContext& surfaceContext) {
     waitForIdle(context);
     const VkDevice device = context.device;
     for (SwapContext& swapContext : surfaceContext.swapContexts) {
-        disposer.release(swapContext.commands.resources);
-        vkFreeCommandBuffers(device, context.commandPool, 1,
-                &swapContext.commands.cmdbuffer);
-
-        // The wrapper object for the submission fence has shared ownership semantics, so here
-        // we notify other owners that the swap chain (and its associated command buffers) have
-        // been destroyed.
-        if (swapContext.commands.fence) {
-            swapContext.commands.fence->swapChainDestroyed = true;
-            swapContext.commands.fence.reset();
-        }
-
         // If this is headless, then we own the image and need to explicitly destroy it.
         if (!surfaceContext.swapchain) {
             vkDestroyImage(device, swapContext.attachment.image, VKALLOC);
@@ -503,12 +585,9 @@ void destroySwapChain(VulkanContext& context, VulkanSurfaceContext& surfaceConte
         }
 
         vkDestroyImageView(device, swapContext.attachment.view, VKALLOC);
-        swapContext.commands.fence = VK_NULL_HANDLE;
         swapContext.attachment.view = VK_NULL_HANDLE;
     }
     vkDestroySwapchainKHR(device, surfaceContext.swapchain, VKALLOC);
-    vkDestroySemaphore(device, surfaceContext.imageAvailable, VKALLOC);
-    vkDestroySemaphore(device, surfaceContext.renderingFinished, VKALLOC);
 
     vkDestroyImageView(device, surfaceContext.depth.view, VKALLOC);
     vkDestroyImage(device, surfaceContext.depth.image, VKALLOC);
@@ -545,9 +624,9 @@ void makeSwapChainPresentable(VulkanContext& context) {
             .layerCount = 1,
         },
     };
-    vkCmdPipelineBarrier(context.currentCommands->cmdbuffer,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    context.currentCommands->barriers.add(context.currentCommands->cmdbuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            barrier);
 }
 
 uint32_t selectMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs) {
@@ -563,44 +642,139 @@ uint32_t selectMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs)
     return (uint32_t) ~0ul;
 }
 
+bool hasMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs) {
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        if (flags & 1) {
+            if ((context.memoryProperties.memoryTypes[i].propertyFlags & reqs) == reqs) {
+                return true;
+            }
+        }
+        flags >>= 1;
+    }
+    return false;
+}
+
 SwapContext& getSwapContext(VulkanContext& context) {
     VulkanSurfaceContext& surface = *context.currentSurface;
     return surface.swapContexts[surface.currentSwapIndex];
 }
 
+// Waits for the last submission of the given frame, if it is still in flight.
+static void waitForFrame(VulkanContext& context, VulkanFrame& frame) {
+    if (frame.timelineValue) {
+        const VkSemaphoreWaitInfoKHR waitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+            .semaphoreCount = 1,
+            .pSemaphores = &context.timeline,
+            .pValues = &frame.timelineValue,
+        };
+        VkResult result = vkWaitSemaphoresKHR(context.device, &waitInfo, UINT64_MAX);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkWaitSemaphores error.");
+    } else if (frame.lastFence) {
+        VkResult result = vkWaitForFences(context.device, 1, &frame.lastFence->fence, VK_TRUE,
+                UINT64_MAX);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkWaitForFences error.");
+    }
+    frame.timelineValue = 0;
+    frame.lastFence.reset();
+}
+
 void waitForIdle(VulkanContext& context) {
     // If there's no valid GPU then we have nothing to do.
     if (!context.device) {
         return;
     }
 
-    // Flush the work command buffer and wait for it to finish.
-    if (!context.work.fence->submitted) {
+    // Flush the pending work.
+    if (context.work.cmdbuffer) {
         flushWorkCommandBuffer(context);
-        acquireWorkCommandBuffer(context);
-    }
-
-    // Wait for submitted command buffer(s) to finish.
-    if (context.currentSurface) {
-        VkFence fences[4];
-        uint32_t nfences = 0;
-        auto& surfaceContext = *context.currentSurface;
-        for (auto& swapContext : surfaceContext.swapContexts) {
-            assert(nfences < 4);
-            if (swapContext.commands.fence && swapContext.commands.fence->submitted) {
-                fences[nfences++] = swapContext.commands.fence->fence;
-                swapContext.commands.fence->submitted = false;
-            }
-        }
-        if (nfences > 0) {
-            vkWaitForFences(context.device, nfences, fences, VK_TRUE, UINT64_MAX);
-        }
+    }
+
+    // Flush the active command buffer and wait for it to finish.
+    if (context.currentSurface && context.currentCommands) {
+        flushCommandBuffer(context);
+    }
+
+    // Wait for the frames that are still in flight.
+    for (VulkanFrame& frame : context.frames) {
+        waitForFrame(context, frame);
+    }
+}
+
+VulkanFrame& acquireNextFrame(VulkanContext& context) {
+    if (context.work.cmdbuffer) {
+        flushWorkCommandBuffer(context);
+    }
+
+    context.currentFrame = (context.currentFrame + 1) % context.frames.size();
+    VulkanFrame& frame = context.frames[context.currentFrame];
+
+    // This only blocks when the CPU is a whole ring of frames ahead of the GPU.
+    waitForFrame(context, frame);
+
+    // Recycle all the command buffers of the frame at once. The work command buffers beyond what a
+    // frame usually needs are freed, so that a burst of uploads doesn't keep them forever.
+    VkResult result = vkResetCommandPool(context.device, frame.pool, 0);
+    ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkResetCommandPool error.");
+    constexpr size_t MAX_IDLE_WORK_BUFFERS = 8;
+    if (frame.workBuffers.size() > MAX_IDLE_WORK_BUFFERS) {
+        vkFreeCommandBuffers(context.device, frame.pool,
+                uint32_t(frame.workBuffers.size() - MAX_IDLE_WORK_BUFFERS),
+                frame.workBuffers.data() + MAX_IDLE_WORK_BUFFERS);
+        frame.workBuffers.resize(MAX_IDLE_WORK_BUFFERS);
+    }
+    frame.workBufferCount = 0;
+    return frame;
+}
+
+void destroyFrames(VulkanContext& context) {
+    for (VulkanFrame& frame : context.frames) {
+        // Destroying the pool frees its command buffers.
+        vkDestroyCommandPool(context.device, frame.pool, VKALLOC);
+        vkDestroySemaphore(context.device, frame.imageAvailable, VKALLOC);
+        vkDestroySemaphore(context.device, frame.renderingFinished, VKALLOC);
+    }
+    context.frames.clear();
+    if (context.timeline) {
+        vkDestroySemaphore(context.device, context.timeline, VKALLOC);
+        context.timeline = VK_NULL_HANDLE;
+    }
+}
+
+VkResult submitToGraphicsQueue(VulkanContext& context, VkSubmitInfo submitInfo,
+        std::shared_ptr<VulkanCmdFence> const& fence) {
+    VulkanFrame& frame = context.frames[context.currentFrame];
 
-        // Next flush the active command buffer and wait for it to finish.
-        if (context.currentCommands) {
-            flushCommandBuffer(context);
+    // Signal the timeline semaphore in addition to the semaphores of the submission.
+    VkSemaphore signalSemaphores[2];
+    uint64_t signalValues[2] = {};
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+    };
+    if (context.timeline) {
+        assert(submitInfo.signalSemaphoreCount <= 1);
+        if (submitInfo.signalSemaphoreCount) {
+            signalSemaphores[0] = submitInfo.pSignalSemaphores[0];
         }
+        signalSemaphores[submitInfo.signalSemaphoreCount] = context.timeline;
+        signalValues[submitInfo.signalSemaphoreCount] = ++context.timelineValue;
+        submitInfo.signalSemaphoreCount++;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+
+        // The values of the binary semaphores that we wait on and signal are ignored.
+        timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+        frame.timelineValue = context.timelineValue;
     }
+    frame.lastFence = fence;
+
+    std::unique_lock<utils::Mutex> lock(fence->mutex);
+    VkResult result = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, fence->fence);
+    fence->submitted = true;
+    lock.unlock();
+    fence->condition.notify_all();
+    return result;
 }
 
 bool acquireSwapCommandBuffer(VulkanContext& context) {
@@ -613,8 +787,9 @@ bool acquireSwapCommandBuffer(VulkanContext& context) {
 
     } else {
 
+        VkSemaphore imageAvailable = context.frames[context.currentFrame].imageAvailable;
         VkResult result = vkAcquireNextImageKHR(context.device, surface.swapchain,
-                UINT64_MAX, surface.imageAvailable, VK_NULL_HANDLE, &surface.currentSwapIndex);
+                UINT64_MAX, imageAvailable, VK_NULL_HANDLE, &surface.currentSwapIndex);
 
         // We should be notified of a suboptimal surface, but it should not cause a cascade of
         // log messages or a loop of re-creations.
@@ -631,28 +806,21 @@ bool acquireSwapCommandBuffer(VulkanContext& context) {
         assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR);
     }
 
-    SwapContext& swap = getSwapContext(context);
-
-    // Ensure that the previous submission of this command buffer has finished.
-    auto& cmdfence = swap.commands.fence;
-    if (cmdfence) {
-        VkResult result = vkWaitForFences(context.device, 1, &cmdfence->fence, VK_TRUE, UINT64_MAX);
-        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkWaitForFences error.");
+    // The command buffer of the current frame has been recycled by acquireNextFrame(), along with
+    // its pool, once its previous submission finished. It is already recording if the swap chain
+    // was refreshed during the frame.
+    VulkanCommandBuffer& commands = context.frames[context.currentFrame].commands;
+    if (context.currentCommands == &commands) {
+        return true;
     }
-
-     cmdfence.reset(new VulkanCmdFence(context.device));
-
-    // Restart the command buffer.
-    VkCommandBuffer cmdbuffer = swap.commands.cmdbuffer;
-    VkResult error = vkResetCommandBuffer(cmdbuffer, 0);
-    ASSERT_POSTCONDITION(!error, "vkResetCommandBuffer error.");
-    VkCommandBufferBeginInfo beginInfo {
+    commands.fence.reset(new VulkanCmdFence(context.device));
+    const VkCommandBufferBeginInfo beginInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    error = vkBeginCommandBuffer(cmdbuffer, &beginInfo);
+    VkResult error = vkBeginCommandBuffer(commands.cmdbuffer, &beginInfo);
     ASSERT_POSTCONDITION(!error, "vkBeginCommandBuffer error.");
-    context.currentCommands = &swap.commands;
+    context.currentCommands = &commands;
     return true;
 }
 
@@ -664,34 +832,40 @@ void flushCommandBuffer(VulkanContext& context) {
     makeSwapChainPresentable(context);
 
     // Submit the command buffer.
+    context.currentCommands->barriers.flush(context.currentCommands->cmdbuffer);
     VkResult error = vkEndCommandBuffer(context.currentCommands->cmdbuffer);
     ASSERT_POSTCONDITION(!error, "vkEndCommandBuffer error.");
-    VkPipelineStageFlags waitDestStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags waitDestStageMask = TRANSFER_WAIT_STAGES;
     VkSubmitInfo submitInfo {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .pWaitDstStageMask = &waitDestStageMask,
         .commandBufferCount = 1,
         .pCommandBuffers = &context.currentCommands->cmdbuffer,
     };
+    if (flushTransferCommandBuffer(context, *context.currentCommands)) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &context.transferFinished;
+    }
 
-    auto& cmdfence = swapContext.commands.fence;
-    std::unique_lock<utils::Mutex> lock(cmdfence->mutex);
-    error = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, cmdfence->fence);
-    lock.unlock();
+    auto& cmdfence = context.currentCommands->fence;
+    error = submitToGraphicsQueue(context, submitInfo, cmdfence);
     ASSERT_POSTCONDITION(!error, "vkQueueSubmit error.");
     swapContext.invalid = true;
-    cmdfence->condition.notify_all();
 
-    // Restart the command buffer.
+    // Restart the command buffer, the frame has nothing left in flight.
     error = vkWaitForFences(context.device, 1, &cmdfence->fence, VK_TRUE, UINT64_MAX);
     ASSERT_POSTCONDITION(!error, "vkWaitForFences error.");
     error = vkResetFences(context.device, 1, &cmdfence->fence);
     ASSERT_POSTCONDITION(!error, "vkResetFences error.");
+    cmdfence->submitted = false;
+    VulkanFrame& frame = context.frames[context.currentFrame];
+    frame.timelineValue = 0;
+    frame.lastFence.reset();
     error = vkResetCommandBuffer(context.currentCommands->cmdbuffer, 0);
     ASSERT_POSTCONDITION(!error, "vkResetCommandBuffer error.");
     VkCommandBufferBeginInfo beginInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
     error = vkBeginCommandBuffer(context.currentCommands->cmdbuffer, &beginInfo);
     ASSERT_POSTCONDITION(!error, "vkBeginCommandBuffer error.");
@@ -715,30 +889,104 @@ VkFormat findSupportedFormat(VulkanContext& context, const std::vector<VkFormat>
 
 VkCommandBuffer acquireWorkCommandBuffer(VulkanContext& context) {
     VulkanCommandBuffer& work = context.work;
-    const VkCommandBufferBeginInfo binfo { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    if (work.fence && work.fence->submitted) {
-        work.fence->submitted = false;
-        vkWaitForFences(context.device, 1, &work.fence->fence, VK_TRUE, UINT64_MAX);
-        vkResetCommandBuffer(work.cmdbuffer, 0);
-        vkBeginCommandBuffer(work.cmdbuffer, &binfo);
+    if (work.cmdbuffer) {
+        return work.cmdbuffer;
+    }
+
+    // Take the next command buffer of the current frame, there is no need to wait for the
+    // previous work since each flushed work buffer is only recycled with its frame.
+    VulkanFrame& frame = context.frames[context.currentFrame];
+    if (frame.workBufferCount == frame.workBuffers.size()) {
+        const VkCommandBufferAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame.pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VkCommandBuffer cmdbuffer;
+        VkResult result = vkAllocateCommandBuffers(context.device, &allocateInfo, &cmdbuffer);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkAllocateCommandBuffers error.");
+        frame.workBuffers.push_back(cmdbuffer);
     }
+    work.cmdbuffer = frame.workBuffers[frame.workBufferCount++];
+    const VkCommandBufferBeginInfo binfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(work.cmdbuffer, &binfo);
     work.fence.reset(new VulkanCmdFence(context.device));
     return work.cmdbuffer;
 }
 
 void flushWorkCommandBuffer(VulkanContext& context) {
     VulkanCommandBuffer& work = context.work;
-    ASSERT_PRECONDITION(!work.fence->submitted, "Flushed the work buffer more than once.");
-    const VkPipelineStageFlags waitDestStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    ASSERT_PRECONDITION(work.cmdbuffer, "Flushed the work buffer more than once.");
+    const VkPipelineStageFlags waitDestStageMask = TRANSFER_WAIT_STAGES;
     VkSubmitInfo submitInfo {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .pWaitDstStageMask = &waitDestStageMask,
         .commandBufferCount = 1,
         .pCommandBuffers = &work.cmdbuffer,
     };
+    if (flushTransferCommandBuffer(context, work)) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &context.transferFinished;
+    }
+    work.barriers.flush(work.cmdbuffer);
     vkEndCommandBuffer(work.cmdbuffer);
-    vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, work.fence->fence);
-    work.fence->submitted = true;
+    VkResult error = submitToGraphicsQueue(context, submitInfo, work.fence);
+    ASSERT_POSTCONDITION(!error, "vkQueueSubmit error.");
+    work.cmdbuffer = VK_NULL_HANDLE;
+
+    // The resources used by the work are released along with the frame.
+    VulkanDisposer::Set& resources = context.frames[context.currentFrame].resources;
+    resources.resources.insert(resources.resources.end(), work.resources.resources.begin(),
+            work.resources.resources.end());
+    work.resources.resources.clear();
+    work.resources.serial = 0;
+}
+
+VkCommandBuffer acquireTransferCommandBuffer(VulkanContext& context,
+        VulkanCommandBuffer& consumer) {
+    if (!context.transferQueue) {
+        return VK_NULL_HANDLE;
+    }
+    if (context.transferConsumer) {
+        // Uploads can only be waited on by a single graphics command buffer.
+        return context.transferConsumer == &consumer ? context.transferCommands : VK_NULL_HANDLE;
+    }
+    if (context.transferSubmitted) {
+        vkWaitForFences(context.device, 1, &context.transferFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(context.device, 1, &context.transferFence);
+        context.transferSubmitted = false;
+    }
+    vkResetCommandBuffer(context.transferCommands, 0);
+    const VkCommandBufferBeginInfo binfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(context.transferCommands, &binfo);
+    context.transferConsumer = &consumer;
+    return context.transferCommands;
+}
+
+bool flushTransferCommandBuffer(VulkanContext& context, VulkanCommandBuffer& consumer) {
+    if (context.transferConsumer != &consumer) {
+        return false;
+    }
+    vkEndCommandBuffer(context.transferCommands);
+    const VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &context.transferCommands,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &context.transferFinished,
+    };
+    VkResult error = vkQueueSubmit(context.transferQueue, 1, &submitInfo, context.transferFence);
+    ASSERT_POSTCONDITION(!error, "vkQueueSubmit error.");
+    context.transferSubmitted = true;
+    context.transferConsumer = nullptr;
+    return true;
 }
 
 void createFinalDepthBuffer(VulkanContext& context, VulkanSurfaceContext& surfaceContext,
@@ -814,8 +1062,8 @@ void createFinalDepthBuffer(VulkanContext& context, VulkanSurfaceContext& surfac
             .layerCount = 1,
         },
     };
-    vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    context.work.barriers.add(cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, barrier);
 
     flushWorkCommandBuffer(context);
 }
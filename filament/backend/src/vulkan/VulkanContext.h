@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_DRIVER_VULKANCONTEXT_H
 #define TNT_FILAMENT_DRIVER_VULKANCONTEXT_H
 
+#include "VulkanBarriers.h"
 #include "VulkanBinder.h"
 #include "VulkanDisposer.h"
 
@@ -51,6 +52,7 @@ struct VulkanRenderTarget;
 struct VulkanSurfaceContext;
 struct VulkanTexture;
 class VulkanStagePool;
+class VulkanMemoryPools;
 
 // This wrapper exists so that we can use shared_ptr to implement shared ownership for low-level
 // Vulkan fences.
@@ -62,7 +64,6 @@ struct VulkanCmdFence {
     utils::Condition condition;
     utils::Mutex mutex;
     std::atomic<VkResult> status;
-    bool swapChainDestroyed = false;
 
     // TODO: for non-work buffers the following field indicates if the fence has EVER been
     // submitted, which is a bit misleading or un-useful. This needs to be refactored.
@@ -73,9 +74,38 @@ struct VulkanCmdFence {
 // DriverApi fence object and should not be destroyed until both the DriverAPI object is freed and
 // we're done waiting on the most recent submission of the given command buffer.
 struct VulkanCommandBuffer {
-    VkCommandBuffer cmdbuffer;
+    VkCommandBuffer cmdbuffer = VK_NULL_HANDLE;
     std::shared_ptr<VulkanCmdFence> fence;
     VulkanDisposer::Set resources;
+    VulkanBarrierBatch barriers;
+};
+
+// The command buffers are recorded into a ring of frames, so that the CPU records a frame while
+// the GPU still executes the previous ones. Each frame owns a command pool, from which its draw
+// commands and the work command buffers flushed during the frame are allocated. A frame is
+// reused once the GPU is done with its last submission: its pool is then reset in bulk, and the
+// resources acquired by its command buffers are released.
+struct VulkanFrame {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VulkanCommandBuffer commands;
+
+    // The work command buffers are allocated on demand, and recycled by the reset of the pool.
+    std::vector<VkCommandBuffer> workBuffers;
+    uint32_t workBufferCount = 0;
+
+    // The resources acquired by the work command buffers flushed during the frame.
+    VulkanDisposer::Set resources;
+
+    // The acquisition and presentation of the swap chain image, they can only be reused once the
+    // frame is done.
+    VkSemaphore imageAvailable = VK_NULL_HANDLE;
+    VkSemaphore renderingFinished = VK_NULL_HANDLE;
+
+    // The last submission of the frame: the value it signals on the timeline semaphore when it's
+    // supported, its fence otherwise. Submissions complete in order, so waiting for the last one
+    // waits for the whole frame.
+    uint64_t timelineValue = 0;
+    std::shared_ptr<VulkanCmdFence> lastFence;
 };
 
 struct VulkanTimestamps {
@@ -99,12 +129,12 @@ struct VulkanContext {
     VkPhysicalDeviceFeatures physicalDeviceFeatures;
     VkPhysicalDeviceMemoryProperties memoryProperties;
     VkDevice device;
-    VkCommandPool commandPool;
     VulkanTimestamps timestamps;
     uint32_t graphicsQueueFamilyIndex;
     VkQueue graphicsQueue;
     bool debugMarkersSupported;
     bool debugUtilsSupported;
+    bool hardwareBufferSupported = false;
     VulkanBinder::RasterState rasterState;
     VulkanCommandBuffer* currentCommands;
     VulkanSurfaceContext* currentSurface;
@@ -112,11 +142,34 @@ struct VulkanContext {
     VkViewport viewport;
     VkFormat finalDepthFormat;
     VmaAllocator allocator;
+    VulkanMemoryPools* memoryPools = nullptr;
     VulkanTexture* emptyTexture = nullptr;
 
     // The work context is used for activities unrelated to the swap chain or draw calls, such as
-    // uploads, blits, and transitions.
+    // uploads, blits, and transitions. Its command buffer is allocated from the current frame by
+    // acquireWorkCommandBuffer(), and is VK_NULL_HANDLE once flushed.
     VulkanCommandBuffer work;
+
+    // The ring of frames in flight, see VulkanFrame.
+    std::vector<VulkanFrame> frames;
+    uint32_t currentFrame = 0;
+
+    // With VK_KHR_timeline_semaphore, every graphics submission signals the next value of this
+    // semaphore, which tells when the frames are done without a fence per frame.
+    bool timelineSemaphoreSupported = false;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint64_t timelineValue = 0;
+
+    // When the device has a dedicated transfer queue, texture uploads are recorded on it. The
+    // graphics command buffer that uses them (the "consumer") waits on transferFinished.
+    uint32_t transferQueueFamilyIndex = 0xffff;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+    VkFence transferFence = VK_NULL_HANDLE;
+    VkSemaphore transferFinished = VK_NULL_HANDLE;
+    VulkanCommandBuffer* transferConsumer = nullptr;
+    bool transferSubmitted = false;
 };
 
 struct VulkanAttachment {
@@ -134,7 +187,6 @@ struct VulkanAttachment {
 // Typically there are only 2 or 3 instances of the SwapContext per SwapChain.
 struct SwapContext {
     VulkanAttachment attachment;
-    VulkanCommandBuffer commands;
     bool invalid;
 };
 
@@ -151,31 +203,56 @@ struct VulkanSurfaceContext {
     VkQueue headlessQueue;
     std::vector<SwapContext> swapContexts;
     uint32_t currentSwapIndex;
-    VkSemaphore imageAvailable;
-    VkSemaphore renderingFinished;
     VulkanAttachment depth;
     bool suboptimal;
 };
 
 void selectPhysicalDevice(VulkanContext& context);
-void createLogicalDevice(VulkanContext& context);
+// Also creates the ring of 'frameCount' frames in flight.
+void createLogicalDevice(VulkanContext& context, uint32_t frameCount);
+void destroyFrames(VulkanContext& context);
 void getPresentationQueue(VulkanContext& context, VulkanSurfaceContext& sc);
 void getHeadlessQueue(VulkanContext& context, VulkanSurfaceContext& sc);
 
 void createSwapChain(VulkanContext& context, VulkanSurfaceContext& sc);
-void destroySwapChain(VulkanContext& context, VulkanSurfaceContext& sc, VulkanDisposer& disposer);
+void destroySwapChain(VulkanContext& context, VulkanSurfaceContext& sc);
 void makeSwapChainPresentable(VulkanContext& context);
 
 uint32_t selectMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs);
+bool hasMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs);
 SwapContext& getSwapContext(VulkanContext& context);
 void waitForIdle(VulkanContext& context);
 bool acquireSwapCommandBuffer(VulkanContext& context);
 void releaseCommandBuffer(VulkanContext& context);
 void flushCommandBuffer(VulkanContext& context);
+
+// Submits to the graphics queue as the last submission of the current frame, signaling the given
+// fence and the next value of the timeline semaphore if it's supported.
+VkResult submitToGraphicsQueue(VulkanContext& context, VkSubmitInfo submitInfo,
+        std::shared_ptr<VulkanCmdFence> const& fence);
+
+// Flushes the work command buffer, then moves to the next frame of the ring. This waits for the
+// GPU only if the frame is still in flight, i.e. if the GPU is a whole ring behind. The pool of
+// the frame is reset, and the caller must release its resources.
+VulkanFrame& acquireNextFrame(VulkanContext& context);
+
 VkFormat findSupportedFormat(VulkanContext& context, const std::vector<VkFormat>& candidates,
         VkImageTiling tiling, VkFormatFeatureFlags features);
 VkCommandBuffer acquireWorkCommandBuffer(VulkanContext& context);
 void flushWorkCommandBuffer(VulkanContext& context);
+
+// Returns the command buffer of the transfer queue to record uploads used by the given graphics
+// command buffer, or VK_NULL_HANDLE if they must be recorded on the graphics queue.
+VkCommandBuffer acquireTransferCommandBuffer(VulkanContext& context,
+        VulkanCommandBuffer& consumer);
+
+// Submits the uploads used by the given graphics command buffer, if any. Returns true if its
+// submission must wait on context.transferFinished.
+bool flushTransferCommandBuffer(VulkanContext& context, VulkanCommandBuffer& consumer);
+
+// Stages at which graphics submissions wait for the transfer queue.
+constexpr VkPipelineStageFlags TRANSFER_WAIT_STAGES = VK_PIPELINE_STAGE_TRANSFER_BIT |
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 void createFinalDepthBuffer(VulkanContext& context, VulkanSurfaceContext& sc, VkFormat depthFormat);
 VkImageLayout getTextureLayout(TextureUsage usage);
 void createEmptyTexture(VulkanContext& context, VulkanStagePool& stagePool);
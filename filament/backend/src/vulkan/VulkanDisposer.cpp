@@ -16,53 +16,52 @@
 
 #include "vulkan/VulkanDisposer.h"
 
+#include <assert.h>
+
 namespace filament {
 namespace backend {
 
-void VulkanDisposer::createDisposable(Key resource, std::function<void()> destructor) noexcept {
-    mDisposables[resource].destructor = destructor;
+void VulkanDisposer::createDisposable(Key resource, VulkanDisposable::Destructor destructor,
+        void* user, uint32_t id) noexcept {
+    resource->mDestructor = destructor;
+    resource->mUser = user;
+    resource->mId = id;
+    resource->mRefCount = 1;
+    resource->mLastSerial = 0;
+    mDisposableCount++;
 }
 
 void VulkanDisposer::addReference(Key resource) noexcept {
-    assert(mDisposables[resource].refcount > 0);
-    ++mDisposables[resource].refcount;
+    assert(resource->mRefCount > 0);
+    ++resource->mRefCount;
 }
 
 void VulkanDisposer::removeReference(Key resource) noexcept {
-    assert(mDisposables[resource].refcount > 0);
-    if (--mDisposables[resource].refcount == 0) {
-        mGraveyard.emplace_back(std::move(mDisposables[resource]));
-        mDisposables.erase(resource);
-    }
-}
-void VulkanDisposer::acquire(Key resource, Set& resources) noexcept {
-    if (resource == nullptr) {
-        return;
-    }
-    auto iter = resources.find(resource);
-    if (iter == resources.end()) {
-        resources.insert(resource);
-        addReference(resource);
+    assert(resource->mRefCount > 0);
+    if (--resource->mRefCount == 0) {
+        mGraveyard.push_back(resource);
     }
 }
 
-void VulkanDisposer::release(Set& resources) {
-    for (auto resource : resources) {
+void VulkanDisposer::release(Set& resources) noexcept {
+    for (Key resource : resources.resources) {
         removeReference(resource);
     }
-    resources.clear();
+    resources.resources.clear();
+    resources.serial = 0;
 }
 
 void VulkanDisposer::gc() noexcept {
-    for (auto& ptr : mGraveyard) {
-        ptr.destructor();
+    for (Key resource : mGraveyard) {
+        mDisposableCount--;
+        resource->mDestructor(resource, resource->mUser, resource->mId);
     }
     mGraveyard.clear();
 }
 
 void VulkanDisposer::reset() noexcept {
     gc();
-    assert(mDisposables.empty());
+    assert(mDisposableCount == 0);
 }
 
 } // namespace filament
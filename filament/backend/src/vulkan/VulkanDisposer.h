@@ -17,28 +17,52 @@
 #ifndef TNT_FILAMENT_DRIVER_VULKANDISPOSER_H
 #define TNT_FILAMENT_DRIVER_VULKANDISPOSER_H
 
-#include <tsl/robin_map.h>
-#include <tsl/robin_set.h>
+#include <utils/compiler.h>
+
+#include <stdint.h>
 
-#include <functional>
-#include <memory>
 #include <vector>
 
 namespace filament {
 namespace backend {
 
+// Base of the objects whose destruction is deferred by VulkanDisposer. The reference count and
+// the bookkeeping of the command buffers are stored in the object itself, so that acquiring it
+// for a command buffer needs neither a lookup nor an allocation.
+class VulkanDisposable {
+public:
+    // Destroys the object, 'user' and 'id' are the values given to createDisposable().
+    using Destructor = void (*)(VulkanDisposable* disposable, void* user, uint32_t id);
+
+private:
+    friend class VulkanDisposer;
+    Destructor mDestructor = nullptr;
+    void* mUser = nullptr;
+    uint32_t mId = 0;
+    uint32_t mRefCount = 0;
+    uint64_t mLastSerial = 0;   // serial of the last set that acquired the object
+};
+
 // VulkanDisposer tracks resources (such as textures or vertex buffers) that need deferred
 // destruction due to potential use by one or more reference holders. An example of a reference
-// holder is an active Vulkan command buffer. Resources are represented with void* to allow callers
-// to use any type of handle. Reference holders (e.g. VulkanCommandBuffer) have an associated
-// robin_set of resource handles.
+// holder is an active Vulkan command buffer. Each reference holder (e.g. VulkanCommandBuffer) has
+// a Set that lists the resources it acquired since its previous submission completed, this Set is
+// released when the holder is reused, i.e. once its fence has signaled.
 class VulkanDisposer {
 public:
-    using Key = const void*;
-    using Set = tsl::robin_set<Key>;
+    using Key = VulkanDisposable*;
+
+    struct Set {
+        // Unique among all the sets and their releases, 0 until the first acquisition. This lets
+        // acquire() skip the resources that are already in the set without searching it.
+        uint64_t serial = 0;
+        std::vector<VulkanDisposable*> resources;
+    };
 
-    // Adds the given resource to the disposer and sets its reference count to 1.
-    void createDisposable(Key resource, std::function<void()> destructor) noexcept;
+    // Adds the given resource to the disposer and sets its reference count to 1. The destructor
+    // is called with 'user' and 'id' once the count drops to zero and gc() is called.
+    void createDisposable(Key resource, VulkanDisposable::Destructor destructor, void* user,
+            uint32_t id = 0) noexcept;
 
     // Increments the reference count.
     void addReference(Key resource) noexcept;
@@ -47,25 +71,39 @@ public:
     void removeReference(Key resource) noexcept;
 
     // If the given resource is not in the given set, then it gets added to the set and its
-    // reference count is incremented.
-    void acquire(Key resource, Set& resources) noexcept;
+    // reference count is incremented. A resource acquired by several sets in an interleaved
+    // fashion may be listed more than once by a set, each entry holding its own reference.
+    void acquire(Key resource, Set& resources) noexcept {
+        if (UTILS_UNLIKELY(resources.serial == 0)) {
+            resources.serial = ++mLastSerial;
+        }
+        if (resource && resource->mLastSerial != resources.serial) {
+            resource->mLastSerial = resources.serial;
+            resource->mRefCount++;
+            resources.resources.push_back(resource);
+        }
+    }
+
+    // Returns true if the given set acquired the given resource since its last release, and no
+    // other set acquired it since then.
+    bool isAcquired(Key resource, Set const& resources) const noexcept {
+        return resources.serial && resource->mLastSerial == resources.serial;
+    }
 
     // Decrements the reference count for all resources in the set, then clears it.
-    void release(Set& resources);
+    void release(Set& resources) noexcept;
 
     // Invokes the destructor function for each disposable in the graveyard.
     void gc() noexcept;
 
-    // Invokes the destructor function for all disposables, regardless of reference count.
+    // Invokes the destructor function for all disposables in the graveyard, and asserts that no
+    // other disposable is alive.
     void reset() noexcept;
 
 private:
-    struct Disposable {
-        int refcount = 1;
-        std::function<void()> destructor;
-    };
-    tsl::robin_map<Key, Disposable> mDisposables;
-    std::vector<Disposable> mGraveyard;
+    std::vector<VulkanDisposable*> mGraveyard;
+    uint64_t mLastSerial = 0;
+    size_t mDisposableCount = 0;
 };
 
 } // namespace filament
@@ -23,10 +23,15 @@
 #include "VulkanHandles.h"
 #include "VulkanPlatform.h"
 
+#include "private/backend/UniformBufferUpdate.h"
+
 #include <utils/Panic.h>
 #include <utils/CString.h>
+#include <utils/Systrace.h>
 #include <utils/trap.h>
 
+#include <algorithm>
+
 #ifndef NDEBUG
 #include <set>
 #endif
@@ -92,9 +97,12 @@ VulkanDriver::VulkanDriver(VulkanPlatform* platform,
         mContextManager(*platform),
         mBlitter(mContext),
         mStagePool(mContext, mDisposer),
+        mMemoryPools(mContext),
         mFramebufferCache(mContext),
-        mSamplerCache(mContext) {
+        mSamplerCache(mContext),
+        mShaderCache(mContext) {
     mContext.rasterState = mBinder.getDefaultRasterState();
+    mContext.memoryPools = &mMemoryPools;
 
     // Load Vulkan entry points.
     ASSERT_POSTCONDITION(bluevk::initialize(), "BlueVK is unable to load entry points.");
@@ -196,8 +204,9 @@ VulkanDriver::VulkanDriver(VulkanPlatform* platform,
     selectPhysicalDevice(mContext);
 
     // Initialize device and graphicsQueue.
-    createLogicalDevice(mContext);
+    createLogicalDevice(mContext, platform->getFramesInFlight());
     mBinder.setDevice(mContext.device);
+    createPipelineCache();
     createEmptyTexture(mContext, mStagePool);
 
     // Choose a depth format that meets our requirements. Take care not to include stencil formats
@@ -236,6 +245,97 @@ Driver* VulkanDriver::create(VulkanPlatform* const platform,
     return new VulkanDriver(platform, ppEnabledExtensions, enabledExtensionCount);
 }
 
+// The key used to store the serialized VkPipelineCache identifies the physical device and its
+// driver, so that a cache produced by a different GPU or driver is never handed to Vulkan.
+struct UTILS_PACKED PipelineCacheBlobKey {
+    char tag[8];
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static PipelineCacheBlobKey getPipelineCacheBlobKey(const VkPhysicalDeviceProperties& props) {
+    PipelineCacheBlobKey key = { { 'F', 'V', 'K', 'P', 'S', 'O', '0', '1' } };
+    key.vendorID = props.vendorID;
+    key.deviceID = props.deviceID;
+    key.driverVersion = props.driverVersion;
+    memcpy(key.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    return key;
+}
+
+// Some drivers do not handle invalid cache data gracefully, so we validate the header ourselves.
+static bool isPipelineCacheDataValid(const VkPhysicalDeviceProperties& props,
+        const std::vector<uint8_t>& data) {
+    constexpr size_t HEADER_SIZE = 16 + VK_UUID_SIZE;
+    if (data.size() < HEADER_SIZE) {
+        return false;
+    }
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+    return header[0] >= HEADER_SIZE &&
+            header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header[2] == props.vendorID &&
+            header[3] == props.deviceID &&
+            !memcmp(data.data() + 16, props.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+void VulkanDriver::createPipelineCache() {
+    std::vector<uint8_t> data;
+    if (mContextManager.hasBlobFunc()) {
+        const PipelineCacheBlobKey key = getPipelineCacheBlobKey(mContext.physicalDeviceProperties);
+        size_t size = mContextManager.retrieveBlob(&key, sizeof(key), nullptr, 0);
+        if (size) {
+            data.resize(size);
+            size = mContextManager.retrieveBlob(&key, sizeof(key), data.data(), data.size());
+            data.resize(size);
+        }
+        if (!data.empty() && !isPipelineCacheDataValid(mContext.physicalDeviceProperties, data)) {
+            utils::slog.w << "Ignoring incompatible Vulkan pipeline cache." << utils::io::endl;
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+    VkResult result = vkCreatePipelineCache(mContext.device, &createInfo, VKALLOC, &mPipelineCache);
+    if (result != VK_SUCCESS && !data.empty()) {
+        // The driver rejected our data, try again with an empty cache.
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        result = vkCreatePipelineCache(mContext.device, &createInfo, VKALLOC, &mPipelineCache);
+    }
+    if (result != VK_SUCCESS) {
+        utils::slog.w << "Unable to create Vulkan pipeline cache." << utils::io::endl;
+        mPipelineCache = VK_NULL_HANDLE;
+    }
+    mBinder.setPipelineCache(mPipelineCache);
+}
+
+void VulkanDriver::savePipelineCache() {
+    if (mPipelineCache == VK_NULL_HANDLE) {
+        return;
+    }
+    if (mContextManager.hasBlobFunc()) {
+        size_t size = 0;
+        vkGetPipelineCacheData(mContext.device, mPipelineCache, &size, nullptr);
+        if (size) {
+            std::vector<uint8_t> data(size);
+            if (vkGetPipelineCacheData(mContext.device, mPipelineCache, &size, data.data())
+                    == VK_SUCCESS) {
+                const PipelineCacheBlobKey key =
+                        getPipelineCacheBlobKey(mContext.physicalDeviceProperties);
+                mContextManager.insertBlob(&key, sizeof(key), data.data(), size);
+            }
+        }
+    }
+    mBinder.setPipelineCache(VK_NULL_HANDLE);
+    vkDestroyPipelineCache(mContext.device, mPipelineCache, VKALLOC);
+    mPipelineCache = VK_NULL_HANDLE;
+}
+
 ShaderModel VulkanDriver::getShaderModel() const noexcept {
 #if defined(ANDROID) || defined(IOS)
     return ShaderModel::GL_ES_30;
@@ -249,33 +349,42 @@ void VulkanDriver::terminate() {
         return;
     }
 
-    // Flush the work command buffer.
-    acquireWorkCommandBuffer(mContext);
+    // Flush the pending work and wait for all the frames in flight.
+    waitForIdle(mContext);
 
     delete mContext.emptyTexture;
 
     mBlitter.shutdown();
 
+    for (VulkanFrame& frame : mContext.frames) {
+        mDisposer.release(frame.commands.resources);
+        mDisposer.release(frame.resources);
+        frame.commands.fence.reset();
+    }
     mDisposer.release(mContext.work.resources);
+    mContext.work.fence.reset();
 
     // Allow the stage pool and disposer to clean up.
     mStagePool.gc();
     mDisposer.reset();
 
-    // Destroy the work command buffer and fence.
-    VulkanCommandBuffer& work = mContext.work;
-    VkDevice device = mContext.device;
-    vkFreeCommandBuffers(device, mContext.commandPool, 1, &work.cmdbuffer);
-    work.fence.reset();
-
     mStagePool.reset();
+    mMemoryPools.reset();
     mBinder.destroyCache();
+    savePipelineCache();
     mFramebufferCache.reset();
     mSamplerCache.reset();
+    mShaderCache.reset();
 
     vmaDestroyAllocator(mContext.allocator);
     vkDestroyQueryPool(mContext.device, mContext.timestamps.pool, VKALLOC);
-    vkDestroyCommandPool(mContext.device, mContext.commandPool, VKALLOC);
+    destroyFrames(mContext);
+    if (mContext.transferQueue) {
+        vkQueueWaitIdle(mContext.transferQueue);
+        vkDestroySemaphore(mContext.device, mContext.transferFinished, VKALLOC);
+        vkDestroyFence(mContext.device, mContext.transferFence, VKALLOC);
+        vkDestroyCommandPool(mContext.device, mContext.transferCommandPool, VKALLOC);
+    }
     vkDestroyDevice(mContext.device, VKALLOC);
     if (mDebugCallback) {
         vkDestroyDebugReportCallbackEXT(mContext.instance, mDebugCallback, VKALLOC);
@@ -289,11 +398,8 @@ void VulkanDriver::terminate() {
 }
 
 void VulkanDriver::tick(int) {
-    if (!mContext.currentSurface) {
-        return;
-    }
-    for (SwapContext& sc : mContext.currentSurface->swapContexts) {
-        VulkanCmdFence* fence = sc.commands.fence.get();
+    for (VulkanFrame& frame : mContext.frames) {
+        VulkanCmdFence* fence = frame.commands.fence.get();
         if (fence) {
             VkResult status = vkGetFenceStatus(mContext.device, fence->fence);
             fence->status.store(status, std::memory_order_relaxed);
@@ -308,12 +414,11 @@ void VulkanDriver::beginFrame(int64_t monotonic_clock_ns, uint32_t frameId) {
         return;
     }
 
-    // After each command buffer acquisition, we know that the previous submission of the acquired
-    // command buffer has finished, so we can decrement the refcount for each of its referenced
-    // resources.
-
-    acquireWorkCommandBuffer(mContext);
-    mDisposer.release(mContext.work.resources);
+    // The resources of the previous use of the frame were released by advanceFrame(), once its
+    // command buffers finished executing. The pending work is submitted ahead of the frame.
+    if (mContext.work.cmdbuffer) {
+        flushWorkCommandBuffer(mContext);
+    }
 
     // With MoltenVK, it might take several attempts to acquire a swap chain that is not marked as
     // "out of date" after a resize event.
@@ -346,8 +451,6 @@ void VulkanDriver::beginFrame(int64_t monotonic_clock_ns, uint32_t frameId) {
     }
     #endif
 
-    mDisposer.release(mContext.currentCommands->resources);
-
     // vkCmdBindPipeline and vkCmdBindDescriptorSets establish bindings to a specific command
     // buffer; they are not global to the device. Since VulkanBinder doesn't have context about the
     // current command buffer, we need to reset its bindings after swapping over to a new command
@@ -381,7 +484,14 @@ void VulkanDriver::setPresentationTime(int64_t monotonic_clock_ns) {
 }
 
 void VulkanDriver::endFrame(uint32_t frameId) {
-    // Do nothing here; see commit().
+    // Nothing is presented here, see commit(). The frame's commands have been submitted, which
+    // makes this the time to relocate buffers, while no command buffer refers to them.
+    if (!mContext.currentCommands) {
+        mMemoryPools.endFrame();
+    }
+
+    SYSTRACE_CONTEXT();
+    SYSTRACE_VALUE64("gpuMemory", getAllocatedGpuMemory());
 }
 
 void VulkanDriver::flush(int) {
@@ -400,9 +510,7 @@ void VulkanDriver::createUniformBufferR(Handle<HwUniformBuffer> ubh, size_t size
         BufferUsage usage) {
     auto uniformBuffer = construct_handle<VulkanUniformBuffer>(mHandleMap, ubh, mContext,
             mStagePool, mDisposer, size, usage);
-    mDisposer.createDisposable(uniformBuffer, [this, ubh] () {
-        destruct_handle<VulkanUniformBuffer>(mHandleMap, ubh);
-    });
+    createDisposableHandle(uniformBuffer, ubh);
 }
 
 void VulkanDriver::destroyUniformBuffer(Handle<HwUniformBuffer> ubh) {
@@ -411,11 +519,9 @@ void VulkanDriver::destroyUniformBuffer(Handle<HwUniformBuffer> ubh) {
         mBinder.unbindUniformBuffer(buffer->getGpuBuffer());
 
         // We do not know if any pending draw calls are making use of this uniform buffer,
-        // so assume the worst: that all command buffers are all using it.
-        if (mContext.currentSurface) {
-            for (auto& swapContext : mContext.currentSurface->swapContexts) {
-                mDisposer.acquire(buffer, swapContext.commands.resources);
-            }
+        // so assume the worst: that all the frames in flight are using it.
+        for (VulkanFrame& frame : mContext.frames) {
+            mDisposer.acquire(buffer, frame.commands.resources);
         }
 
         mDisposer.removeReference(buffer);
@@ -426,20 +532,33 @@ void VulkanDriver::createRenderPrimitiveR(Handle<HwRenderPrimitive> rph, int) {
     construct_handle<VulkanRenderPrimitive>(mHandleMap, rph, mContext);
 }
 
+void VulkanDriver::createRenderPrimitives(Handle<HwRenderPrimitive> const* rphs,
+        uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        Handle<HwRenderPrimitive> rph = rphs[i];
+        construct_handle<VulkanRenderPrimitive>(mHandleMap, rph, mContext);
+    }
+}
+
 void VulkanDriver::destroyRenderPrimitive(Handle<HwRenderPrimitive> rph) {
     if (rph) {
         destruct_handle<VulkanRenderPrimitive>(mHandleMap, rph);
     }
 }
 
+void VulkanDriver::destroyRenderPrimitives(Handle<HwRenderPrimitive> const* rphs,
+        uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        destroyRenderPrimitive(rphs[i]);
+    }
+}
+
 void VulkanDriver::createVertexBufferR(Handle<HwVertexBuffer> vbh, uint8_t bufferCount,
         uint8_t attributeCount, uint32_t elementCount, AttributeArray attributes,
         BufferUsage usage) {
     auto vertexBuffer = construct_handle<VulkanVertexBuffer>(mHandleMap, vbh, mContext, mStagePool,
             mDisposer, bufferCount, attributeCount, elementCount, attributes);
-    mDisposer.createDisposable(vertexBuffer, [this, vbh] () {
-        destruct_handle<VulkanVertexBuffer>(mHandleMap, vbh);
-    });
+    createDisposableHandle(vertexBuffer, vbh);
 }
 
 void VulkanDriver::destroyVertexBuffer(Handle<HwVertexBuffer> vbh) {
@@ -454,9 +573,7 @@ void VulkanDriver::createIndexBufferR(Handle<HwIndexBuffer> ibh,
     auto elementSize = (uint8_t) getElementTypeSize(elementType);
     auto indexBuffer = construct_handle<VulkanIndexBuffer>(mHandleMap, ibh, mContext, mStagePool,
             mDisposer, elementSize, indexCount);
-    mDisposer.createDisposable(indexBuffer, [this, ibh] () {
-        destruct_handle<VulkanIndexBuffer>(mHandleMap, ibh);
-    });
+    createDisposableHandle(indexBuffer, ibh);
 }
 
 void VulkanDriver::destroyIndexBuffer(Handle<HwIndexBuffer> ibh) {
@@ -466,14 +583,29 @@ void VulkanDriver::destroyIndexBuffer(Handle<HwIndexBuffer> ibh) {
     }
 }
 
+void VulkanDriver::createBufferObjectR(Handle<HwBufferObject> boh,
+        uint32_t byteCount, BufferObjectBinding bindingType, BufferUsage usage) {
+    auto bufferObject = construct_handle<VulkanBufferObject>(mHandleMap, boh, mContext,
+            mStagePool, mDisposer, byteCount, bindingType);
+    createDisposableHandle(bufferObject, boh);
+}
+
+void VulkanDriver::destroyBufferObject(Handle<HwBufferObject> boh) {
+    if (boh) {
+        auto bufferObject = handle_cast<VulkanBufferObject>(mHandleMap, boh);
+        if (bufferObject->bindingType == BufferObjectBinding::UNIFORM) {
+            mBinder.unbindUniformBuffer(bufferObject->buffer->getGpuBuffer());
+        }
+        mDisposer.removeReference(bufferObject);
+    }
+}
+
 void VulkanDriver::createTextureR(Handle<HwTexture> th, SamplerType target, uint8_t levels,
         TextureFormat format, uint8_t samples, uint32_t w, uint32_t h, uint32_t depth,
         TextureUsage usage) {
     auto vktexture = construct_handle<VulkanTexture>(mHandleMap, th, mContext, target, levels,
             format, samples, w, h, depth, usage, mStagePool);
-    mDisposer.createDisposable(vktexture, [this, th] () {
-        destruct_handle<VulkanTexture>(mHandleMap, th);
-    });
+    createDisposableHandle(vktexture, th);
 }
 
 void VulkanDriver::createTextureSwizzledR(Handle<HwTexture> th, SamplerType target, uint8_t levels,
@@ -482,9 +614,7 @@ void VulkanDriver::createTextureSwizzledR(Handle<HwTexture> th, SamplerType targ
         TextureSwizzle r, TextureSwizzle g, TextureSwizzle b, TextureSwizzle a) {
     auto vktexture = construct_handle<VulkanTexture>(mHandleMap, th, mContext, target, levels,
             format, samples, w, h, depth, usage, mStagePool);
-    mDisposer.createDisposable(vktexture, [this, th] () {
-        destruct_handle<VulkanTexture>(mHandleMap, th);
-    });
+    createDisposableHandle(vktexture, th);
     // TODO: implement texture swizzling
 }
 
@@ -498,16 +628,26 @@ void VulkanDriver::importTextureR(Handle<HwTexture> th, intptr_t id,
 void VulkanDriver::destroyTexture(Handle<HwTexture> th) {
     if (th) {
         auto texture = handle_cast<VulkanTexture>(mHandleMap, th);
-        mBinder.unbindImageView(texture->imageView);
+        texture->forEachPrimaryView([this](VkImageView view) {
+            mBinder.unbindImageView(view);
+        });
+        if (texture->stream) {
+            detachStream(texture);
+        }
         mDisposer.removeReference(texture);
     }
 }
 
+void VulkanDriver::destroyTextures(Handle<HwTexture> const* ths, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        destroyTexture(ths[i]);
+    }
+}
+
 void VulkanDriver::createProgramR(Handle<HwProgram> ph, Program&& program) {
-    auto vkprogram = construct_handle<VulkanProgram>(mHandleMap, ph, mContext, program);
-    mDisposer.createDisposable(vkprogram, [this, ph] () {
-        destruct_handle<VulkanProgram>(mHandleMap, ph);
-    });
+    auto vkprogram = construct_handle<VulkanProgram>(mHandleMap, ph, mContext, mShaderCache,
+            program);
+    createDisposableHandle(vkprogram, ph);
 }
 
 void VulkanDriver::destroyProgram(Handle<HwProgram> ph) {
@@ -518,9 +658,7 @@ void VulkanDriver::destroyProgram(Handle<HwProgram> ph) {
 
 void VulkanDriver::createDefaultRenderTargetR(Handle<HwRenderTarget> rth, int) {
     auto renderTarget = construct_handle<VulkanRenderTarget>(mHandleMap, rth, mContext);
-    mDisposer.createDisposable(renderTarget, [this, rth] () {
-        destruct_handle<VulkanRenderTarget>(mHandleMap, rth);
-    });
+    createDisposableHandle(renderTarget, rth);
 }
 
 void VulkanDriver::createRenderTargetR(Handle<HwRenderTarget> rth,
@@ -548,9 +686,23 @@ void VulkanDriver::createRenderTargetR(Handle<HwRenderTarget> rth,
 
     auto renderTarget = construct_handle<VulkanRenderTarget>(mHandleMap, rth, mContext,
             width, height, samples, colorTargets, depthStencil, mStagePool);
-    mDisposer.createDisposable(renderTarget, [this, rth] () {
-        destruct_handle<VulkanRenderTarget>(mHandleMap, rth);
-    });
+    mDisposer.createDisposable(renderTarget, [](VulkanDisposable* disposable, void* user,
+            uint32_t id) {
+        // Drop the framebuffers made from our attachments before their views can be recycled.
+        VulkanDriver* const driver = static_cast<VulkanDriver*>(user);
+        VulkanRenderTarget* rt = static_cast<VulkanRenderTarget*>(disposable);
+        VkImageView views[MRT::TARGET_COUNT * 2 + 2];
+        size_t count = 0;
+        for (int i = 0; i < MRT::TARGET_COUNT; i++) {
+            views[count++] = rt->getColor(i).view;
+            views[count++] = rt->getMsaaColor(i).view;
+        }
+        views[count++] = rt->getDepth().view;
+        views[count++] = rt->getMsaaDepth().view;
+        driver->mFramebufferCache.purge(views, count);
+        driver->destruct_handle<VulkanRenderTarget>(driver->mHandleMap,
+                Handle<HwRenderTarget>(id));
+    }, this, rth.getId());
 }
 
 void VulkanDriver::destroyRenderTarget(Handle<HwRenderTarget> rth) {
@@ -565,6 +717,7 @@ void VulkanDriver::createFenceR(Handle<HwFence> fh, int) {
 
      // As a fallback in release builds, trigger the fence based on the work command buffer.
     if (mContext.currentCommands == nullptr) {
+        acquireWorkCommandBuffer(mContext);
         construct_handle<VulkanFence>(mHandleMap, fh, mContext.work);
         return;
     }
@@ -630,10 +783,23 @@ Handle<HwUniformBuffer> VulkanDriver::createUniformBufferS() noexcept {
     return alloc_handle<VulkanUniformBuffer, HwUniformBuffer>();
 }
 
+Handle<HwBufferObject> VulkanDriver::createBufferObjectS() noexcept {
+    return alloc_handle<VulkanBufferObject, HwBufferObject>();
+}
+
 Handle<HwRenderPrimitive> VulkanDriver::createRenderPrimitiveS() noexcept {
     return alloc_handle<VulkanRenderPrimitive, HwRenderPrimitive>();
 }
 
+void VulkanDriver::allocateRenderPrimitives(Handle<HwRenderPrimitive>* rphs, uint32_t count) {
+    // same as alloc_handle(), but takes the lock only once
+    std::lock_guard<std::mutex> lock(mHandleMapMutex);
+    for (uint32_t i = 0; i < count; i++) {
+        mHandleMap[mNextId] = Blob(sizeof(VulkanRenderPrimitive));
+        rphs[i] = Handle<HwRenderPrimitive>(mNextId++);
+    }
+}
+
 Handle<HwProgram> VulkanDriver::createProgramS() noexcept {
     return alloc_handle<VulkanProgram, HwProgram>();
 }
@@ -671,9 +837,7 @@ Handle<HwTimerQuery> VulkanDriver::createTimerQueryS() noexcept {
     // before createTimerQueryR is executed.
     Handle<HwTimerQuery> tqh = alloc_handle<VulkanTimerQuery, HwTimerQuery>();
     auto query = construct_handle<VulkanTimerQuery>(mHandleMap, tqh, mContext);
-    mDisposer.createDisposable(query, [this, tqh] () {
-        destruct_handle<VulkanTimerQuery>(mHandleMap, tqh);
-    });
+    createDisposableHandle(query, tqh);
     return tqh;
 }
 
@@ -696,7 +860,7 @@ void VulkanDriver::destroySamplerGroup(Handle<HwSamplerGroup> sbh) {
 void VulkanDriver::destroySwapChain(Handle<HwSwapChain> sch) {
     if (sch) {
         VulkanSurfaceContext& surfaceContext = handle_cast<VulkanSwapChain>(mHandleMap, sch)->surfaceContext;
-        backend::destroySwapChain(mContext, surfaceContext, mDisposer);
+        backend::destroySwapChain(mContext, surfaceContext);
 
         vkDestroySurfaceKHR(mContext.instance, surfaceContext.surface, VKALLOC);
         if (mContext.currentSurface == &surfaceContext) {
@@ -708,6 +872,18 @@ void VulkanDriver::destroySwapChain(Handle<HwSwapChain> sch) {
 }
 
 void VulkanDriver::destroyStream(Handle<HwStream> sh) {
+    if (sh) {
+        VulkanStream* stream = handle_cast<VulkanStream>(mHandleMap, sh);
+        auto pos = std::find_if(mExternalStreams.begin(), mExternalStreams.end(),
+                [stream](VulkanTexture const* t) { return t->stream == stream; });
+        if (pos != mExternalStreams.end()) {
+            detachStream(*pos);
+        }
+        if (stream->pending.image) {
+            scheduleRelease(std::move(stream->pending));
+        }
+        destruct_handle<VulkanStream>(mHandleMap, sh);
+    }
 }
 
 void VulkanDriver::destroyTimerQuery(Handle<HwTimerQuery> tqh) {
@@ -726,11 +902,20 @@ Handle<HwStream> VulkanDriver::createStreamNative(void* nativeStream) {
 }
 
 Handle<HwStream> VulkanDriver::createStreamAcquired() {
-    return {};
+    Handle<HwStream> sh = alloc_handle<VulkanStream, HwStream>();
+    construct_handle<VulkanStream>(mHandleMap, sh);
+    return sh;
 }
 
+// Stashes the image until the next updateStreams(), which is called at the start of each frame.
 void VulkanDriver::setAcquiredImage(Handle<HwStream> sh, void* image, backend::StreamCallback cb,
         void* userData) {
+    VulkanStream* stream = handle_cast<VulkanStream>(mHandleMap, sh);
+    if (stream->pending.image) {
+        scheduleRelease(std::move(stream->pending));
+        utils::slog.w << "Acquired image is set more than once per frame." << utils::io::endl;
+    }
+    stream->pending = { image, cb, userData };
 }
 
 void VulkanDriver::setStreamDimensions(Handle<HwStream> sh, uint32_t width, uint32_t height) {
@@ -741,6 +926,52 @@ int64_t VulkanDriver::getStreamTimestamp(Handle<HwStream> sh) {
 }
 
 void VulkanDriver::updateStreams(CommandStream* driver) {
+    for (VulkanTexture* texture : mExternalStreams) {
+        VulkanStream* stream = texture->stream;
+        if (!stream || !stream->pending.image) {
+            continue;
+        }
+        AcquiredImage image = stream->pending;
+        stream->pending = {};
+        driver->queueCommand([this, texture, image]() {
+            updateExternalImage(texture, image);
+        });
+    }
+}
+
+void VulkanDriver::updateExternalImage(VulkanTexture* texture, AcquiredImage const& image) {
+    VulkanExternalImage* external = new VulkanExternalImage(mContext, image);
+    if (external->view == VK_NULL_HANDLE) {
+        delete external;
+        scheduleRelease(AcquiredImage(image));
+        return;
+    }
+
+    // The image is released to the client only when the command buffers sampling it are done.
+    mDisposer.createDisposable(external, [](VulkanDisposable* disposable, void* user, uint32_t) {
+        VulkanExternalImage* external = static_cast<VulkanExternalImage*>(disposable);
+        AcquiredImage acquired = external->acquired;
+        delete external;
+        static_cast<VulkanDriver*>(user)->scheduleRelease(std::move(acquired));
+    }, this);
+    if (texture->externalImage) {
+        mBinder.unbindImageView(texture->externalImage->view);
+        mDisposer.removeReference(texture->externalImage);
+    }
+    texture->externalImage = external;
+}
+
+void VulkanDriver::detachStream(VulkanTexture* texture) {
+    auto pos = std::find(mExternalStreams.begin(), mExternalStreams.end(), texture);
+    if (pos != mExternalStreams.end()) {
+        mExternalStreams.erase(pos);
+    }
+    if (texture->externalImage) {
+        mBinder.unbindImageView(texture->externalImage->view);
+        mDisposer.removeReference(texture->externalImage);
+        texture->externalImage = nullptr;
+    }
+    texture->stream = nullptr;
 }
 
 void VulkanDriver::destroyFence(Handle<HwFence> fh) {
@@ -759,9 +990,6 @@ FenceStatus VulkanDriver::wait(Handle<HwFence> fh, uint64_t timeout) {
     } else {
         lock.unlock();
     }
-    if (cmdfence->swapChainDestroyed) {
-        return FenceStatus::ERROR;
-    }
     VkResult result = vkWaitForFences(mContext.device, 1, &cmdfence->fence, VK_TRUE, timeout);
     return result == VK_SUCCESS ? FenceStatus::CONDITION_SATISFIED : FenceStatus::TIMEOUT_EXPIRED;
 }
@@ -815,10 +1043,35 @@ bool VulkanDriver::isFrameBufferFetchSupported() {
     return true;
 }
 
+bool VulkanDriver::isParallelShaderCompileSupported() {
+    // TODO: create pipelines with worker threads
+    return false;
+}
+
 bool VulkanDriver::isFrameTimeSupported() {
     return true;
 }
 
+uint64_t VulkanDriver::getAllocatedGpuMemory() {
+    // VMA keeps track of its allocations in each heap, it's thread-safe
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+    vmaGetBudget(mContext.allocator, budgets);
+    uint64_t allocated = 0;
+    for (VmaBudget const& budget : budgets) {
+        allocated += budget.allocationBytes;
+    }
+    return allocated;
+}
+
+GpuMemoryPoolStats VulkanDriver::getGpuMemoryPoolStats() {
+    return mMemoryPools.getStats();
+}
+
+bool VulkanDriver::isComputeSupported() {
+    // TODO: implement compute pipelines
+    return false;
+}
+
 bool VulkanDriver::areFeedbackLoopsSupported() {
     return true;
 }
@@ -842,6 +1095,13 @@ void VulkanDriver::updateIndexBuffer(Handle<HwIndexBuffer> ibh, BufferDescriptor
     scheduleDestroy(std::move(p));
 }
 
+void VulkanDriver::updateBufferObject(Handle<HwBufferObject> boh, BufferDescriptor&& bd,
+        uint32_t byteOffset) {
+    auto& bo = *handle_cast<VulkanBufferObject>(mHandleMap, boh);
+    bo.buffer->loadFromCpu(bd.buffer, byteOffset, bd.size);
+    scheduleDestroy(std::move(bd));
+}
+
 void VulkanDriver::update2DImage(Handle<HwTexture> th,
         uint32_t level, uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         PixelBufferDescriptor&& data) {
@@ -851,6 +1111,7 @@ void VulkanDriver::update2DImage(Handle<HwTexture> th,
 }
 
 void VulkanDriver::setMinMaxLevels(Handle<HwTexture> th, uint32_t minLevel, uint32_t maxLevel) {
+    handle_cast<VulkanTexture>(mHandleMap, th)->setPrimaryRange(minLevel, maxLevel);
 }
 
 void VulkanDriver::update3DImage(
@@ -925,9 +1186,6 @@ SyncStatus VulkanDriver::getSyncStatus(Handle<HwSync> sh) {
     if (sync->fence == nullptr) {
         return SyncStatus::NOT_SIGNALED;
     }
-    if (sync->fence->swapChainDestroyed) {
-        return SyncStatus::ERROR;
-    }
     VkResult status = sync->fence->status.load(std::memory_order_relaxed);
     switch (status) {
         case VK_SUCCESS: return SyncStatus::SIGNALED;
@@ -943,22 +1201,58 @@ void VulkanDriver::setExternalImagePlane(Handle<HwTexture> th, void* image, size
 }
 
 void VulkanDriver::setExternalStream(Handle<HwTexture> th, Handle<HwStream> sh) {
+    VulkanTexture* texture = handle_cast<VulkanTexture>(mHandleMap, th);
+    if (texture->stream) {
+        detachStream(texture);
+    }
+    if (sh) {
+        VulkanStream* stream = handle_cast<VulkanStream>(mHandleMap, sh);
+        if (stream->streamType != StreamType::ACQUIRED) {
+            utils::slog.w << "Only acquired streams are supported." << utils::io::endl;
+            return;
+        }
+        texture->stream = stream;
+        mExternalStreams.push_back(texture);
+    }
 }
 
-void VulkanDriver::generateMipmaps(Handle<HwTexture> th) { }
+void VulkanDriver::generateMipmaps(Handle<HwTexture> th) {
+    auto* texture = handle_cast<VulkanTexture>(mHandleMap, th);
+    if (mContext.currentCommands) {
+        mDisposer.acquire(texture, mContext.currentCommands->resources);
+        texture->generateMipmaps(*mContext.currentCommands);
+    } else {
+        acquireWorkCommandBuffer(mContext);
+        mDisposer.acquire(texture, mContext.work.resources);
+        texture->generateMipmaps(mContext.work);
+        flushWorkCommandBuffer(mContext);
+    }
+}
 
 bool VulkanDriver::canGenerateMipmaps() {
-    return false;
+    return true;
 }
 
 void VulkanDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& data) {
     if (data.size > 0) {
         auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, ubh);
-        buffer->loadFromCpu(data.buffer, (uint32_t) data.size);
+        buffer->loadFromCpu(data.buffer, 0, (uint32_t) data.size);
         scheduleDestroy(std::move(data));
     }
 }
 
+void VulkanDriver::updateUniformBuffers(BufferDescriptor&& updates) {
+    char const* const end = static_cast<char const*>(updates.buffer) + updates.size;
+    for (auto u = static_cast<UniformBufferUpdate const*>(updates.buffer);
+            reinterpret_cast<char const*>(u) < end; u = u->next()) {
+        if (u->byteSize > 0) {
+            auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, u->ubh);
+            buffer->loadFromCpu(u->getData(), u->byteOffset, u->byteSize);
+        }
+    }
+    scheduleDestroy(std::move(updates));
+}
+
 void VulkanDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
         SamplerGroup&& samplerGroup) {
     auto* sb = handle_cast<VulkanSamplerGroup>(mHandleMap, sbh);
@@ -968,7 +1262,6 @@ void VulkanDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
 void VulkanDriver::beginRenderPass(Handle<HwRenderTarget> rth, const RenderPassParams& params) {
     assert(mContext.currentCommands);
     assert(mContext.currentSurface);
-    VulkanSurfaceContext& surface = *mContext.currentSurface;
     mCurrentRenderTarget = handle_cast<VulkanRenderTarget>(mHandleMap, rth);
     VulkanRenderTarget* rt = mCurrentRenderTarget;
 
@@ -1007,6 +1300,9 @@ void VulkanDriver::beginRenderPass(Handle<HwRenderTarget> rth, const RenderPassP
     VkRenderPass renderPass = mFramebufferCache.getRenderPass(rpkey);
     mBinder.bindRenderPass(renderPass, 0);
 
+    // the raster state depends on the samples and color targets of the render target
+    mRasterStateDirty = true;
+
     // Create the VkFramebuffer or fetch it from cache.
     VulkanFboCache::FboKey fbkey {
         .renderPass = renderPass,
@@ -1085,10 +1381,11 @@ void VulkanDriver::beginRenderPass(Handle<HwRenderTarget> rth, const RenderPassP
     }
     renderPassInfo.pClearValues = &clearValues[0];
 
-    const SwapContext& swapContext = surface.swapContexts[surface.currentSwapIndex];
+    VulkanCommandBuffer& commands = *mContext.currentCommands;
 
-    vkCmdBeginRenderPass(swapContext.commands.cmdbuffer, &renderPassInfo,
-            VK_SUBPASS_CONTENTS_INLINE);
+    // The layout transitions of the attachments, and the uploads since the previous pass.
+    commands.barriers.flush(commands.cmdbuffer);
+    vkCmdBeginRenderPass(commands.cmdbuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     VkViewport viewport = mContext.viewport = {
         .x = (float) params.viewport.left,
@@ -1100,7 +1397,7 @@ void VulkanDriver::beginRenderPass(Handle<HwRenderTarget> rth, const RenderPassP
     };
 
     mCurrentRenderTarget->transformClientRectToPlatform(&viewport);
-    vkCmdSetViewport(swapContext.commands.cmdbuffer, 0, 1, &viewport);
+    vkCmdSetViewport(commands.cmdbuffer, 0, 1, &viewport);
 
     mContext.currentRenderPass = {
         .renderPass = renderPassInfo.renderPass,
@@ -1138,6 +1435,9 @@ void VulkanDriver::nextSubpass(int) {
     mBinder.bindRenderPass(mContext.currentRenderPass.renderPass,
             ++mContext.currentRenderPass.currentSubpass);
 
+    // the subpass can have another number of color targets
+    mRasterStateDirty = true;
+
     for (uint32_t i = 0; i < VulkanBinder::TARGET_BINDING_COUNT; i++) {
         if ((1 << i) & mContext.currentRenderPass.subpassMask) {
             VulkanAttachment subpassInput = mCurrentRenderTarget->getColor(i);
@@ -1186,41 +1486,48 @@ void VulkanDriver::commit(Handle<HwSwapChain> sch) {
     makeSwapChainPresentable(mContext);
 
     // Finalize the command buffer and set the cmdbuffer pointer to null.
-    VkResult result = vkEndCommandBuffer(mContext.currentCommands->cmdbuffer);
+    VulkanCommandBuffer& commands = *mContext.currentCommands;
+    commands.barriers.flush(commands.cmdbuffer);
+    VkResult result = vkEndCommandBuffer(commands.cmdbuffer);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkEndCommandBuffer error.");
     mContext.currentCommands = nullptr;
 
     // Submit the command buffer.
-    VkPipelineStageFlags waitDestStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
     VulkanSurfaceContext& surfaceContext = *mContext.currentSurface;
     SwapContext& swapContext = getSwapContext(mContext);
+    VulkanFrame& frame = mContext.frames[mContext.currentFrame];
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitDestStageMasks[2];
+    uint32_t waitSemaphoreCount = 0;
+    if (!surfaceContext.headlessQueue) {
+        waitSemaphores[waitSemaphoreCount] = frame.imageAvailable;
+        waitDestStageMasks[waitSemaphoreCount++] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    if (flushTransferCommandBuffer(mContext, commands)) {
+        waitSemaphores[waitSemaphoreCount] = mContext.transferFinished;
+        waitDestStageMasks[waitSemaphoreCount++] = TRANSFER_WAIT_STAGES;
+    }
     VkSubmitInfo submitInfo {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1u,
-            .pWaitSemaphores = &surfaceContext.imageAvailable,
-            .pWaitDstStageMask = &waitDestStageMask,
+            .waitSemaphoreCount = waitSemaphoreCount,
+            .pWaitSemaphores = waitSemaphores,
+            .pWaitDstStageMask = waitDestStageMasks,
             .commandBufferCount = 1,
-            .pCommandBuffers = &swapContext.commands.cmdbuffer,
+            .pCommandBuffers = &commands.cmdbuffer,
             .signalSemaphoreCount = 1u,
-            .pSignalSemaphores = &surfaceContext.renderingFinished,
+            .pSignalSemaphores = &frame.renderingFinished,
     };
     if (surfaceContext.headlessQueue) {
-        submitInfo.waitSemaphoreCount = 0;
-        submitInfo.pWaitSemaphores = nullptr;
         submitInfo.signalSemaphoreCount = 0;
         submitInfo.pSignalSemaphores = nullptr;
     }
 
-    auto& cmdfence = swapContext.commands.fence;
-    std::unique_lock<utils::Mutex> lock(cmdfence->mutex);
-    result = vkQueueSubmit(mContext.graphicsQueue, 1, &submitInfo, cmdfence->fence);
-    cmdfence->submitted = true;
-    lock.unlock();
+    result = submitToGraphicsQueue(mContext, submitInfo, commands.fence);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkQueueSubmit error.");
     swapContext.invalid = true;
-    cmdfence->condition.notify_all();
 
     if (surfaceContext.headlessQueue) {
+        advanceFrame();
         return;
     }
 
@@ -1229,7 +1536,7 @@ void VulkanDriver::commit(Handle<HwSwapChain> sch) {
     VkPresentInfoKHR presentInfo {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &surface.renderingFinished,
+        .pWaitSemaphores = &frame.renderingFinished,
         .swapchainCount = 1,
         .pSwapchains = &surface.swapchain,
         .pImageIndices = &surface.currentSwapIndex,
@@ -1246,6 +1553,15 @@ void VulkanDriver::commit(Handle<HwSwapChain> sch) {
     // The surface can be "out of date" when it has been resized, which is not an error.
     assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR ||
             result == VK_ERROR_OUT_OF_DATE_KHR);
+
+    advanceFrame();
+}
+
+void VulkanDriver::advanceFrame() {
+    // This waits for the GPU only if it is a whole ring of frames behind.
+    VulkanFrame& frame = acquireNextFrame(mContext);
+    mDisposer.release(frame.commands.resources);
+    mDisposer.release(frame.resources);
 }
 
 void VulkanDriver::bindUniformBuffer(size_t index, Handle<HwUniformBuffer> ubh) {
@@ -1262,6 +1578,20 @@ void VulkanDriver::bindUniformBufferRange(size_t index, Handle<HwUniformBuffer>
     mBinder.bindUniformBuffer((uint32_t)index, buffer->getGpuBuffer(), offset, size);
 }
 
+void VulkanDriver::bindBufferObject(uint8_t index, Handle<HwBufferObject> boh) {
+    auto* bo = handle_cast<VulkanBufferObject>(mHandleMap, boh);
+    // TODO: storage buffers need a descriptor set layout with storage bindings, which the
+    //       binder doesn't have yet; only the uniform binding is supported for now.
+    if (bo->bindingType == BufferObjectBinding::UNIFORM) {
+        mBinder.bindUniformBuffer((uint32_t)index, bo->buffer->getGpuBuffer(), 0, bo->byteCount);
+    }
+}
+
+void VulkanDriver::bindVertexBufferStorage(uint8_t index, Handle<HwVertexBuffer> vbh,
+        uint8_t bufferIndex) {
+    // TODO: see bindBufferObject(), storage bindings are not supported yet
+}
+
 void VulkanDriver::bindSamplers(size_t index, Handle<HwSamplerGroup> sbh) {
     auto* hwsb = handle_cast<VulkanSamplerGroup>(mHandleMap, sbh);
     mSamplerBindings[index] = hwsb;
@@ -1368,10 +1698,11 @@ void VulkanDriver::readPixels(Handle<HwRenderTarget> src, uint32_t x, uint32_t y
 
     // TODO: replace waitForIdle with an image barrier coupled with acquireWorkCommandBuffer.
     waitForIdle(mContext);
+    acquireWorkCommandBuffer(mContext);
 
     // Transition the staging image layout.
 
-    VulkanTexture::transitionImageLayout(mContext.work.cmdbuffer, stagingImage,
+    VulkanTexture::transitionImageLayout(mContext.work, stagingImage,
             VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, 1, 1,
             VK_IMAGE_ASPECT_COLOR_BIT);
 
@@ -1401,12 +1732,13 @@ void VulkanDriver::readPixels(Handle<HwRenderTarget> src, uint32_t x, uint32_t y
     // Transition the source image layout (which might be the swap chain)
 
     VkImage srcImage = srcTarget->getColor(0).image;
-    VulkanTexture::transitionImageLayout(mContext.work.cmdbuffer, srcImage,
+    VulkanTexture::transitionImageLayout(mContext.work, srcImage,
             VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcMipLevel, 1, 1,
             VK_IMAGE_ASPECT_COLOR_BIT);
 
     // Perform the blit.
 
+    mContext.work.barriers.flush(mContext.work.cmdbuffer);
     vkCmdCopyImage(mContext.work.cmdbuffer, srcTarget->getColor(0).image,
             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             1, &imageCopyRegion);
@@ -1415,11 +1747,11 @@ void VulkanDriver::readPixels(Handle<HwRenderTarget> src, uint32_t x, uint32_t y
 
     if (srcTexture || mContext.currentSurface->presentQueue) {
         const VkImageLayout present = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        VulkanTexture::transitionImageLayout(mContext.work.cmdbuffer, srcImage,
+        VulkanTexture::transitionImageLayout(mContext.work, srcImage,
                 VK_IMAGE_LAYOUT_UNDEFINED, srcTexture ? getTextureLayout(srcTexture->usage) : present,
                 srcMipLevel, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT);
     } else {
-        VulkanTexture::transitionImageLayout(mContext.work.cmdbuffer, srcImage,
+        VulkanTexture::transitionImageLayout(mContext.work, srcImage,
                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
                 srcMipLevel, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT);
     }
@@ -1444,13 +1776,14 @@ void VulkanDriver::readPixels(Handle<HwRenderTarget> src, uint32_t x, uint32_t y
         }
     };
 
-    vkCmdPipelineBarrier(mContext.work.cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    mContext.work.barriers.add(mContext.work.cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, barrier);
 
     // Flush and wait.
 
+    std::shared_ptr<VulkanCmdFence> fence = mContext.work.fence;
     flushWorkCommandBuffer(mContext);
-    acquireWorkCommandBuffer(mContext);
+    vkWaitForFences(device, 1, &fence->fence, VK_TRUE, UINT64_MAX);
 
     VkImageSubresource subResource { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT };
     VkSubresourceLayout subResourceLayout;
@@ -1505,12 +1838,11 @@ void VulkanDriver::blit(TargetBufferFlags buffers, Handle<HwRenderTarget> dst, V
     const int32_t dstTop = std::min(dstRect.bottom + dstRect.height, dstExtent.height);
     const VkOffset3D dstOffsets[2] = { { dstLeft, dstBottom, 0 }, { dstRight, dstTop, 1 }};
 
-    VkCommandBuffer cmdbuf;
-    if (mContext.currentCommands) {
-        cmdbuf = mContext.currentCommands->cmdbuffer;
-    } else {
-        cmdbuf = acquireWorkCommandBuffer(mContext);;
+    if (!mContext.currentCommands) {
+        acquireWorkCommandBuffer(mContext);
     }
+    VulkanCommandBuffer& cmdbuf = mContext.currentCommands ? *mContext.currentCommands :
+            mContext.work;
 
     if (any(buffers & TargetBufferFlags::DEPTH) && srcTarget->hasDepth() && dstTarget->hasDepth()) {
         mBlitter.blitDepth(cmdbuf, {dstTarget, dstOffsets, srcTarget, srcOffsets});
@@ -1537,10 +1869,14 @@ void VulkanDriver::blit(TargetBufferFlags buffers, Handle<HwRenderTarget> dst, V
     }
 }
 
-void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> rph) {
+void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
     VulkanCommandBuffer* commands = mContext.currentCommands;
     ASSERT_POSTCONDITION(commands, "Draw calls can occur only within a beginFrame / endFrame.");
     VkCommandBuffer cmdbuffer = commands->cmdbuffer;
+
+    // Normally empty, the barriers are flushed when the render pass begins.
+    commands->barriers.flush(cmdbuffer);
     const VulkanRenderPrimitive& prim = *handle_cast<VulkanRenderPrimitive>(mHandleMap, rph);
 
     Handle<HwProgram> programHandle = pipelineState.program;
@@ -1560,50 +1896,55 @@ void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> r
     }
 #endif
 
-    // Update the VK raster state.
-
     const VulkanRenderTarget* rt = mCurrentRenderTarget;
 
-    mContext.rasterState.depthStencil = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = (VkBool32) rasterState.depthWrite,
-        .depthCompareOp = getCompareOp(rasterState.depthFunc),
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_FALSE,
-    };
+    // Update the VK raster state, only when it changed since the previous draw.
+    if (isPipelineStateChanged() || mRasterStateDirty) {
+        mRasterStateDirty = false;
+
+        mContext.rasterState.depthStencil = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+            .depthTestEnable = VK_TRUE,
+            .depthWriteEnable = (VkBool32) rasterState.depthWrite,
+            .depthCompareOp = getCompareOp(rasterState.depthFunc),
+            .depthBoundsTestEnable = VK_FALSE,
+            .stencilTestEnable = VK_FALSE,
+        };
 
-    mContext.rasterState.multisampling = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .rasterizationSamples = (VkSampleCountFlagBits) rt->getSamples(),
-        .alphaToCoverageEnable = rasterState.alphaToCoverage,
-    };
+        mContext.rasterState.multisampling = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .rasterizationSamples = (VkSampleCountFlagBits) rt->getSamples(),
+            .alphaToCoverageEnable = rasterState.alphaToCoverage,
+        };
 
-    mContext.rasterState.blending = {
-        .blendEnable = (VkBool32) rasterState.hasBlending(),
-        .srcColorBlendFactor = getBlendFactor(rasterState.blendFunctionSrcRGB),
-        .dstColorBlendFactor = getBlendFactor(rasterState.blendFunctionDstRGB),
-        .colorBlendOp = (VkBlendOp) rasterState.blendEquationRGB,
-        .srcAlphaBlendFactor = getBlendFactor(rasterState.blendFunctionSrcAlpha),
-        .dstAlphaBlendFactor = getBlendFactor(rasterState.blendFunctionDstAlpha),
-        .alphaBlendOp =  (VkBlendOp) rasterState.blendEquationAlpha,
-        .colorWriteMask = (VkColorComponentFlags) (rasterState.colorWrite ? 0xf : 0x0),
-    };
+        mContext.rasterState.blending = {
+            .blendEnable = (VkBool32) rasterState.hasBlending(),
+            .srcColorBlendFactor = getBlendFactor(rasterState.blendFunctionSrcRGB),
+            .dstColorBlendFactor = getBlendFactor(rasterState.blendFunctionDstRGB),
+            .colorBlendOp = (VkBlendOp) rasterState.blendEquationRGB,
+            .srcAlphaBlendFactor = getBlendFactor(rasterState.blendFunctionSrcAlpha),
+            .dstAlphaBlendFactor = getBlendFactor(rasterState.blendFunctionDstAlpha),
+            .alphaBlendOp =  (VkBlendOp) rasterState.blendEquationAlpha,
+            .colorWriteMask = (VkColorComponentFlags) (rasterState.colorWrite ? 0xf : 0x0),
+        };
 
-    VkPipelineRasterizationStateCreateInfo& vkraster = mContext.rasterState.rasterization;
-    vkraster.cullMode = getCullMode(rasterState.culling);
-    vkraster.frontFace = getFrontFace(rasterState.inverseFrontFaces);
-    vkraster.depthBiasEnable = (depthOffset.constant || depthOffset.slope) ? VK_TRUE : VK_FALSE;
-    vkraster.depthBiasConstantFactor = depthOffset.constant;
-    vkraster.depthBiasSlopeFactor = depthOffset.slope;
+        VkPipelineRasterizationStateCreateInfo& vkraster = mContext.rasterState.rasterization;
+        vkraster.cullMode = getCullMode(rasterState.culling);
+        vkraster.frontFace = getFrontFace(rasterState.inverseFrontFaces);
+        vkraster.depthBiasEnable =
+                (depthOffset.constant || depthOffset.slope) ? VK_TRUE : VK_FALSE;
+        vkraster.depthBiasConstantFactor = depthOffset.constant;
+        vkraster.depthBiasSlopeFactor = depthOffset.slope;
 
-    mContext.rasterState.colorTargetCount = rt->getColorTargetCount(mContext.currentRenderPass);
+        mContext.rasterState.colorTargetCount =
+                rt->getColorTargetCount(mContext.currentRenderPass);
+        mBinder.bindRasterState(mContext.rasterState);
+    }
 
     VulkanBinder::ProgramBundle shaderHandles = program->bundle;
 
     // Push state changes to the VulkanBinder instance. This is fast and does not make VK calls.
     mBinder.bindProgramBundle(shaderHandles);
-    mBinder.bindRasterState(mContext.rasterState);
     mBinder.bindPrimitiveTopology(prim.primitiveTopology);
     mBinder.bindVertexArray(prim.varray);
 
@@ -1632,7 +1973,7 @@ void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> r
             // appropriate. The fallback improves robustness but does not guarantee 100% success.
             // It can be argued that clients are being malfeasant here anyway, since Vulkan does
             // not allow sampling from a non-bound texture.
-            const VulkanTexture* texture;
+            VulkanTexture* texture;
             if (UTILS_UNLIKELY(!boundSampler->t)) {
                 if (!sampler.strict) {
                     continue;
@@ -1644,16 +1985,22 @@ void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> r
                 utils::slog.w << " at binding point " << +bindingPoint << utils::io::endl;
                 texture = mContext.emptyTexture;
             } else {
-                texture = handle_const_cast<VulkanTexture>(mHandleMap, boundSampler->t);
+                texture = handle_cast<VulkanTexture>(mHandleMap, boundSampler->t);
                 mDisposer.acquire(texture, commands->resources);
             }
 
             const SamplerParams& samplerParams = boundSampler->s;
             VkSampler vksampler = mSamplerCache.getSampler(samplerParams);
 
+            VkImageView imageView = texture->imageView;
+            if (UTILS_UNLIKELY(texture->externalImage)) {
+                mDisposer.acquire(texture->externalImage, commands->resources);
+                imageView = texture->externalImage->view;
+            }
+
             mBinder.bindSampler(bindingPoint, {
                 .sampler = vksampler,
-                .imageView = texture->imageView,
+                .imageView = imageView,
                 .imageLayout = getTextureLayout(texture->usage)
             });
         }
@@ -1677,9 +2024,10 @@ void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> r
     // Bind new descriptor sets if they need to change.
     VkDescriptorSet descriptors[3];
     VkPipelineLayout pipelineLayout;
-    if (mBinder.getOrCreateDescriptors(descriptors, &pipelineLayout)) {
+    uint32_t dynamicOffsets[VulkanBinder::UBUFFER_BINDING_COUNT];
+    if (mBinder.getOrCreateDescriptors(descriptors, &pipelineLayout, dynamicOffsets)) {
         vkCmdBindDescriptorSets(cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 3,
-                descriptors, 0, nullptr);
+                descriptors, VulkanBinder::UBUFFER_BINDING_COUNT, dynamicOffsets);
     }
 
     // Bind the pipeline if it changed. This can happen, for example, if the raster state changed.
@@ -1692,20 +2040,32 @@ void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> r
     // Next bind the vertex buffers and index buffer. One potential performance improvement is to
     // avoid rebinding these if they are already bound, but since we do not (yet) support subranges
     // it would be rare for a client to make consecutive draw calls with the same render primitive.
-    vkCmdBindVertexBuffers(cmdbuffer, 0, (uint32_t) prim.buffers.size(),
-            prim.buffers.data(), prim.offsets.data());
+    VkBuffer buffers[MAX_VERTEX_ATTRIBUTE_COUNT];
+    const uint32_t bufferCount = (uint32_t) prim.buffers.size();
+    for (uint32_t i = 0; i < bufferCount; i++) {
+        buffers[i] = prim.buffers[i]->getGpuBuffer();
+    }
+    vkCmdBindVertexBuffers(cmdbuffer, 0, bufferCount, buffers, prim.offsets.data());
     vkCmdBindIndexBuffer(cmdbuffer, prim.indexBuffer->buffer->getGpuBuffer(), 0,
             prim.indexBuffer->indexType);
 
     // Finally, make the actual draw call. TODO: support subranges
     const uint32_t indexCount = prim.count;
-    const uint32_t instanceCount = 1;
     const uint32_t firstIndex = prim.offset / prim.indexBuffer->elementSize;
     const int32_t vertexOffset = 0;
-    const uint32_t firstInstId = 1;
+    // gl_InstanceIndex includes firstInstance, shaders expect instances to start at zero
+    const uint32_t firstInstId = 0;
     vkCmdDrawIndexed(cmdbuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstId);
 }
 
+void VulkanDriver::bindImage(uint8_t unit, Handle<HwTexture> th, uint8_t level) {
+    // compute is not supported (see isComputeSupported())
+}
+
+void VulkanDriver::dispatchCompute(Handle<HwProgram> ph, math::uint3 workGroupCount) {
+    // compute is not supported (see isComputeSupported())
+}
+
 void VulkanDriver::beginTimerQuery(Handle<HwTimerQuery> tqh) {
     VulkanCommandBuffer* commands = mContext.currentCommands;
     ASSERT_POSTCONDITION(commands, "Timer queries can occur only within a beginFrame / endFrame.");
@@ -1733,7 +2093,7 @@ void VulkanDriver::refreshSwapChain() {
     VulkanSurfaceContext& surface = *mContext.currentSurface;
 
     assert(!surface.headlessQueue && "Resizing headless swap chains is not supported.");
-    backend::destroySwapChain(mContext, surface, mDisposer);
+    backend::destroySwapChain(mContext, surface);
     createSwapChain(mContext, surface);
 
     mFramebufferCache.reset();
@@ -1743,8 +2103,10 @@ void VulkanDriver::refreshSwapChain() {
 void VulkanDriver::debugCommand(const char* methodName) {
     static const std::set<utils::StaticString> OUTSIDE_COMMANDS = {
         "loadUniformBuffer",
+        "updateUniformBuffers",
         "updateVertexBuffer",
         "updateIndexBuffer",
+        "updateBufferObject",
         "update2DImage",
         "updateCubeImage",
     };
@@ -22,7 +22,9 @@
 #include "VulkanDisposer.h"
 #include "VulkanContext.h"
 #include "VulkanFboCache.h"
+#include "VulkanMemoryPools.h"
 #include "VulkanSamplerCache.h"
+#include "VulkanShaderCache.h"
 #include "VulkanStagePool.h"
 #include "VulkanUtility.h"
 
@@ -41,6 +43,7 @@ namespace backend {
 class VulkanPlatform;
 struct VulkanRenderTarget;
 struct VulkanSamplerGroup;
+struct VulkanTexture;
 
 class VulkanDriver final : public DriverBase {
 public:
@@ -146,19 +149,48 @@ private:
         handleMap.erase(handle.getId());
     }
 
+    // Makes the given handle's object a disposable, destroyed with destruct_handle<Dp>() once
+    // it is no longer referenced.
+    template<typename Dp, typename B>
+    void createDisposableHandle(Dp* object, Handle<B> handle) noexcept {
+        mDisposer.createDisposable(object, [](VulkanDisposable*, void* user, uint32_t id) {
+            VulkanDriver* const driver = static_cast<VulkanDriver*>(user);
+            driver->destruct_handle<Dp>(driver->mHandleMap, Handle<B>(id));
+        }, this, handle.getId());
+    }
+
     void refreshSwapChain();
 
+    // Moves on to the next frame of the ring, and releases the resources of its previous use.
+    void advanceFrame();
+
+    // Imports the acquired image of a stream, and makes it the image sampled through 'texture'.
+    void updateExternalImage(VulkanTexture* texture, AcquiredImage const& image);
+    void detachStream(VulkanTexture* texture);
+
+    // The pipeline cache is seeded from the platform's blob storage at startup and serialized
+    // back into it upon termination, so that pipelines don't need to be re-compiled on every run.
+    void createPipelineCache();
+    void savePipelineCache();
+
     VulkanContext mContext = {};
     VulkanBinder mBinder;
     VulkanBlitter mBlitter;
     VulkanDisposer mDisposer;
     VulkanStagePool mStagePool;
+    VulkanMemoryPools mMemoryPools;
     VulkanFboCache mFramebufferCache;
     VulkanSamplerCache mSamplerCache;
+    VulkanShaderCache mShaderCache;
     VulkanRenderTarget* mCurrentRenderTarget = nullptr;
+    bool mRasterStateDirty = true;  // the raster state must be updated by the next draw
     VulkanSamplerGroup* mSamplerBindings[VulkanBinder::SAMPLER_BINDING_COUNT] = {};
     VkDebugReportCallbackEXT mDebugCallback = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT mDebugMessenger = VK_NULL_HANDLE;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+
+    // the textures attached to an acquired stream, accessed from the user thread in updateStreams()
+    std::vector<VulkanTexture*> mExternalStreams;
 };
 
 } // namespace backend
@@ -65,10 +65,11 @@ VulkanFboCache::~VulkanFboCache() {
 
 VkFramebuffer VulkanFboCache::getFramebuffer(FboKey config) noexcept {
     auto iter = mFramebufferCache.find(config);
-    if (UTILS_LIKELY(iter != mFramebufferCache.end() && iter->second.handle != VK_NULL_HANDLE)) {
+    if (UTILS_LIKELY(iter != mFramebufferCache.end())) {
         iter.value().timestamp = mCurrentTime;
         return iter->second.handle;
     }
+    mStats.framebufferMisses++;
 
     // The attachment list contains: Color Attachments, Resolve Attachments, and Depth Attachment.
     // For simplicity, create an array that can hold the maximum possible number of attachments.
@@ -117,10 +118,11 @@ VkFramebuffer VulkanFboCache::getFramebuffer(FboKey config) noexcept {
 
 VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
     auto iter = mRenderPassCache.find(config);
-    if (UTILS_LIKELY(iter != mRenderPassCache.end() && iter->second.handle != VK_NULL_HANDLE)) {
+    if (UTILS_LIKELY(iter != mRenderPassCache.end())) {
         iter.value().timestamp = mCurrentTime;
         return iter->second.handle;
     }
+    mStats.renderPassMisses++;
     const bool isSwapChain = config.colorLayout[0] == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     const bool hasSubpasses = config.subpassMask != 0;
 
@@ -249,11 +251,17 @@ VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
         const bool clear = any(config.clear & flag);
         const bool discard = any(config.discardStart & flag);
 
+        // A MSAA sidecar is resolved on-tile into its resolve attachment and never stored, the
+        // same as GL's EXT_multisampled_render_to_texture. A MSAA texture is stored for later
+        // passes, unless the client discards it.
+        const bool resolved = config.needsResolveMask & (1 << i);
+        const bool store = !resolved && none(config.discardEnd & flag);
+
         attachments[attachmentIndex++] = {
             .format = config.colorFormat[i],
             .samples = (VkSampleCountFlagBits) config.samples,
             .loadOp = clear ? kClear : (discard ? kDontCare : kKeep),
-            .storeOp = config.samples == 1 ? kEnableStore : kDisableStore,
+            .storeOp = store ? kEnableStore : kDisableStore,
             .stencilLoadOp = kDontCare,
             .stencilStoreOp = kDisableStore,
             .initialLayout = colorLayouts[i].initial,
@@ -302,13 +310,14 @@ VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
     if (hasDepth) {
         bool clear = any(config.clear & TargetBufferFlags::DEPTH);
         bool discard = any(config.discardStart & TargetBufferFlags::DEPTH);
+        bool discardEnd = any(config.discardEnd & TargetBufferFlags::DEPTH);
         depthAttachmentRef.layout = config.depthLayout;
         depthAttachmentRef.attachment = attachmentIndex;
         attachments[attachmentIndex++] = {
             .format = config.depthFormat,
             .samples = (VkSampleCountFlagBits) config.samples,
             .loadOp = clear ? kClear : (discard ? kDontCare : kKeep),
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .storeOp = discardEnd ? kDisableStore : kEnableStore,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
             .initialLayout = config.depthLayout,
@@ -340,34 +349,108 @@ void VulkanFboCache::reset() noexcept {
         vkDestroyFramebuffer(mContext.device, pair.second.handle, VKALLOC);
     }
     mFramebufferCache.clear();
+    for (auto const& val : mFramebufferGraveyard) {
+        vkDestroyFramebuffer(mContext.device, val.handle, VKALLOC);
+    }
+    mFramebufferGraveyard.clear();
     for (auto pair : mRenderPassCache) {
         vkDestroyRenderPass(mContext.device, pair.second.handle, VKALLOC);
     }
     mRenderPassCache.clear();
+    mRenderPassRefCount.clear();
+}
+
+void VulkanFboCache::destroyFramebuffer(VkRenderPass renderPass,
+        VkFramebuffer handle) noexcept {
+    mRenderPassRefCount[renderPass]--;
+    vkDestroyFramebuffer(mContext.device, handle, VKALLOC);
+    mStats.evictions++;
 }
 
-// Frees up old framebuffers and render passes, then nulls out their key.  Doesn't bother removing
-// the actual map entry since it is fairly small.
+// Frees up old framebuffers and render passes, along with their map entries. Entries are keyed
+// on image views, which are recycled by the driver, so leaving them around would let the cache
+// grow without bounds.
 void VulkanFboCache::gc() noexcept {
+    mStats.framebufferCount = uint32_t(mFramebufferCache.size());
+    mStats.renderPassCount = uint32_t(mRenderPassCache.size());
+    mLastStats = mStats;
+    mStats = {};
+
+    #if FILAMENT_VULKAN_VERBOSE
+    if (mLastStats.framebufferMisses || mLastStats.renderPassMisses || mLastStats.evictions) {
+        utils::slog.d << "FBO cache: "
+            << mLastStats.framebufferCount << " framebuffers, "
+            << mLastStats.renderPassCount << " render passes, "
+            << mLastStats.framebufferMisses << " framebuffer misses, "
+            << mLastStats.renderPassMisses << " render pass misses, "
+            << mLastStats.evictions << " evictions"
+            << utils::io::endl;
+    }
+    #endif
+
     // If this is one of the first few frames, return early to avoid wrapping unsigned integers.
     if (++mCurrentTime <= TIME_BEFORE_EVICTION) {
         return;
     }
     const uint32_t evictTime = mCurrentTime - TIME_BEFORE_EVICTION;
 
-    for (auto iter = mFramebufferCache.begin(); iter != mFramebufferCache.end(); ++iter) {
+    for (auto iter = mFramebufferCache.begin(); iter != mFramebufferCache.end();) {
         const FboVal fbo = iter->second;
-        if (fbo.timestamp < evictTime && fbo.handle) {
-            mRenderPassRefCount[iter->first.renderPass]--;
-            vkDestroyFramebuffer(mContext.device, fbo.handle, VKALLOC);
-            iter.value().handle = VK_NULL_HANDLE;
+        if (fbo.timestamp < evictTime) {
+            destroyFramebuffer(iter->first.renderPass, fbo.handle);
+            iter = mFramebufferCache.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    decltype(mFramebufferGraveyard) graveyard;
+    graveyard.swap(mFramebufferGraveyard);
+    for (auto const& val : graveyard) {
+        if (val.timestamp < evictTime) {
+            destroyFramebuffer(val.renderPass, val.handle);
+        } else {
+            mFramebufferGraveyard.push_back(val);
         }
     }
-    for (auto iter = mRenderPassCache.begin(); iter != mRenderPassCache.end(); ++iter) {
+    for (auto iter = mRenderPassCache.begin(); iter != mRenderPassCache.end();) {
         const VkRenderPass handle = iter->second.handle;
-        if (iter->second.timestamp < evictTime && handle && mRenderPassRefCount[handle] == 0) {
+        if (iter->second.timestamp < evictTime && mRenderPassRefCount[handle] == 0) {
             vkDestroyRenderPass(mContext.device, handle, VKALLOC);
-            iter.value().handle = VK_NULL_HANDLE;
+            mRenderPassRefCount.erase(handle);
+            iter = mRenderPassCache.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void VulkanFboCache::purge(VkImageView const* views, size_t count) noexcept {
+    auto refersTo = [views, count](FboKey const& key) {
+        for (size_t i = 0; i < count; i++) {
+            const VkImageView view = views[i];
+            if (view == VK_NULL_HANDLE) {
+                continue;
+            }
+            if (key.depth == view) {
+                return true;
+            }
+            for (int j = 0; j < MRT::TARGET_COUNT; j++) {
+                if (key.color[j] == view || key.resolve[j] == view) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    // Views are shared by the render targets of a texture, so the framebuffers might still be
+    // referenced by a command buffer. They go to the graveyard, which gc() empties.
+    for (auto iter = mFramebufferCache.begin(); iter != mFramebufferCache.end();) {
+        if (refersTo(iter->first)) {
+            mFramebufferGraveyard.push_back({
+                    iter->second.handle, iter->first.renderPass, mCurrentTime });
+            iter = mFramebufferCache.erase(iter);
+        } else {
+            ++iter;
         }
     }
 }
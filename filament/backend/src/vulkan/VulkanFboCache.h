@@ -25,6 +25,8 @@
 
 #include <tsl/robin_map.h>
 
+#include <vector>
+
 namespace filament {
 namespace backend {
 
@@ -88,6 +90,15 @@ public:
         bool operator()(const FboKey& k1, const FboKey& k2) const;
     };
 
+    // Counters gathered since the previous call to gc().
+    struct Stats {
+        uint32_t framebufferCount;
+        uint32_t renderPassCount;
+        uint32_t framebufferMisses;
+        uint32_t renderPassMisses;
+        uint32_t evictions;
+    };
+
     explicit VulkanFboCache(VulkanContext&);
     ~VulkanFboCache();
 
@@ -100,6 +111,13 @@ public:
     // Evicts old unused Vulkan objects. Call this once per frame.
     void gc() noexcept;
 
+    // Removes the framebuffers that refer to any of the given image views from the cache. Call
+    // this when the attachments of a render target go away, before their views can be recycled.
+    void purge(VkImageView const* views, size_t count) noexcept;
+
+    // Returns the counters of the frame that preceded the latest call to gc().
+    Stats getStats() const noexcept { return mLastStats; }
+
     // Frees all Vulkan objects. Call this during shutdown before the device is destroyed.
     void reset() noexcept;
 
@@ -109,6 +127,18 @@ private:
     tsl::robin_map<RenderPassKey, RenderPassVal, RenderPassHash, RenderPassEq> mRenderPassCache;
     tsl::robin_map<VkRenderPass, uint32_t> mRenderPassRefCount;
     uint32_t mCurrentTime = 0;
+    Stats mStats = {};
+    Stats mLastStats = {};
+
+    // A framebuffer that is no longer cached, but might still be used by a command buffer.
+    struct FboTombstone {
+        VkFramebuffer handle;
+        VkRenderPass renderPass;
+        uint32_t timestamp;
+    };
+    std::vector<FboTombstone> mFramebufferGraveyard;
+
+    void destroyFramebuffer(VkRenderPass renderPass, VkFramebuffer handle) noexcept;
 
     // If any VkRenderPass or VkFramebuffer is unused for more than TIME_BEFORE_EVICTION frames, it
     // is evicted from the cache. Ideally this constant is greater than or equal to the number of
@@ -17,10 +17,17 @@
 #include "vulkan/VulkanHandles.h"
 
 #include "DataReshaper.h"
+#include "VulkanMemoryPools.h"
 #include "VulkanPlatform.h"
 
 #include <utils/Panic.h>
 
+#if defined(__ANDROID__)
+#include <android/hardware_buffer.h>
+#endif
+
+#include <string.h>
+
 #define FILAMENT_VULKAN_VERBOSE 0
 
 using namespace bluevk;
@@ -47,24 +54,25 @@ static void clampToFramebuffer(VkRect2D* rect, uint32_t fbWidth, uint32_t fbHeig
     rect->extent.height = std::max(top - y, 0);
 }
 
-VulkanProgram::VulkanProgram(VulkanContext& context, const Program& builder) noexcept :
-        HwProgram(builder.getName()), context(context) {
+VulkanProgram::VulkanProgram(VulkanContext& context, VulkanShaderCache& shaderCache,
+        const Program& builder) noexcept :
+        HwProgram(builder.getName()), context(context), shaderCache(shaderCache) {
     auto const& blobs = builder.getShadersSource();
     VkShaderModule* modules[2] = { &bundle.vertex, &bundle.fragment };
+    bundle.vertex = VK_NULL_HANDLE;
+    bundle.fragment = VK_NULL_HANDLE;
+    bundle.specializationInfo = nullptr;
     bool missing = false;
-    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+    // compute programs are not supported, only look at the vertex and fragment shaders
+    for (size_t i = 0; i < 2; i++) {
         const auto& blob = blobs[i];
         VkShaderModule* module = modules[i];
         if (blob.empty()) {
             missing = true;
             continue;
         }
-        VkShaderModuleCreateInfo moduleInfo = {};
-        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        moduleInfo.codeSize = blob.size();
-        moduleInfo.pCode = (uint32_t*) blob.data();
-        VkResult result = vkCreateShaderModule(context.device, &moduleInfo, VKALLOC, module);
-        ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to create shader module.");
+        // variants of different materials often have identical shaders, which share a module
+        *module = shaderCache.acquire((const uint32_t*) blob.data(), blob.size());
     }
 
     // Output a warning because it's okay to encounter empty blobs, but it's not okay to use
@@ -76,6 +84,31 @@ VulkanProgram::VulkanProgram(VulkanContext& context, const Program& builder) noe
 
     // Make a copy of the binding map
     samplerGroupInfo = builder.getSamplerGroupInfo();
+
+    // The constants are given to the pipelines created for this program.
+    auto const& specConstants = builder.getSpecializationConstants();
+    if (!specConstants.empty()) {
+        specializationEntries.reserve(specConstants.size());
+        specializationData.reserve(specConstants.size());
+        for (auto const& constant : specConstants) {
+            const uint32_t offset = uint32_t(specializationData.size() * sizeof(uint32_t));
+            specializationEntries.push_back({ constant.id, offset, sizeof(uint32_t) });
+            uint32_t value = 0;
+            if (auto const* i = std::get_if<int32_t>(&constant.value)) {
+                memcpy(&value, i, sizeof(value));
+            } else if (auto const* f = std::get_if<float>(&constant.value)) {
+                memcpy(&value, f, sizeof(value));
+            } else {
+                value = std::get<bool>(constant.value) ? VK_TRUE : VK_FALSE;
+            }
+            specializationData.push_back(value);
+        }
+        specializationInfo.mapEntryCount = uint32_t(specializationEntries.size());
+        specializationInfo.pMapEntries = specializationEntries.data();
+        specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+        specializationInfo.pData = specializationData.data();
+        bundle.specializationInfo = &specializationInfo;
+    }
 #if FILAMENT_VULKAN_VERBOSE
     utils::slog.d << "Created VulkanProgram " << builder.getName().c_str()
                 << ", variant = (" << utils::io::hex
@@ -86,8 +119,8 @@ VulkanProgram::VulkanProgram(VulkanContext& context, const Program& builder) noe
 }
 
 VulkanProgram::~VulkanProgram() {
-    vkDestroyShaderModule(context.device, bundle.vertex, VKALLOC);
-    vkDestroyShaderModule(context.device, bundle.fragment, VKALLOC);
+    shaderCache.release(bundle.vertex);
+    shaderCache.release(bundle.fragment);
 }
 
 static VulkanAttachment createAttachment(VulkanAttachment spec) {
@@ -150,8 +183,12 @@ VulkanRenderTarget::VulkanRenderTarget(VulkanContext& context, uint32_t width, u
         const VulkanAttachment& spec = color[index];
         VulkanTexture* texture = spec.texture;
         if (texture && texture->samples == 1) {
+            // The sidecar is resolved at the end of each render pass, it is never stored.
+            const TextureUsage usage = TextureUsage::COLOR_ATTACHMENT |
+                    TextureUsage::TRANSIENT_ATTACHMENT |
+                    (texture->usage & TextureUsage::SUBPASS_INPUT);
             VulkanTexture* msTexture = new VulkanTexture(context, texture->target, level,
-                    texture->format, samples, width, height, depth, texture->usage, stagePool);
+                    texture->format, samples, width, height, depth, usage, stagePool);
             mMsaaAttachments[index] = createAttachment({ .texture = msTexture });
             mMsaaAttachments[index].view = msTexture->getImageView(0, 0, VK_IMAGE_ASPECT_COLOR_BIT);
         }
@@ -170,9 +207,12 @@ VulkanRenderTarget::VulkanRenderTarget(VulkanContext& context, uint32_t width, u
         return;
     }
 
-    // Create sidecar MSAA texture for the depth attachment.
+    // Create sidecar MSAA texture for the depth attachment. Vulkan 1.0 can't resolve depth, the
+    // sidecar is only ever used as an attachment and can live in tile memory.
+    const TextureUsage usage = TextureUsage::DEPTH_ATTACHMENT |
+            TextureUsage::TRANSIENT_ATTACHMENT;
     VulkanTexture* msTexture = new VulkanTexture(context, depthTexture->target, level,
-            depthTexture->format, samples, width, height, depth, depthTexture->usage, stagePool);
+            depthTexture->format, samples, width, height, depth, usage, stagePool);
     mMsaaDepthAttachment = createAttachment({
         .texture = msTexture,
         .level = depthSpec.level,
@@ -212,19 +252,6 @@ VulkanSwapChain::VulkanSwapChain(VulkanContext& context, uint32_t width, uint32_
     // Somewhat arbitrarily, headless rendering is double-buffered.
     surfaceContext.swapContexts.resize(2);
 
-    // Allocate a command buffer for each swap context, just like a real swap chain.
-    VkCommandBufferAllocateInfo allocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = context.commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = (uint32_t) surfaceContext.swapContexts.size()
-    };
-    std::vector<VkCommandBuffer> cmdbufs(allocateInfo.commandBufferCount);
-    vkAllocateCommandBuffers(context.device, &allocateInfo, cmdbufs.data());
-    for (uint32_t i = 0; i < allocateInfo.commandBufferCount; ++i) {
-        surfaceContext.swapContexts[i].commands.cmdbuffer = cmdbufs[i];
-    }
-
     // Begin a new command buffer in order to transition image layouts via vkCmdPipelineBarrier.
     VkCommandBuffer cmdbuffer = acquireWorkCommandBuffer(context);
 
@@ -292,8 +319,8 @@ VulkanSwapChain::VulkanSwapChain(VulkanContext& context, uint32_t width, uint32_
                 .layerCount = 1,
             },
         };
-        vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        context.work.barriers.add(cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, barrier);
     }
 
     flushWorkCommandBuffer(context);
@@ -304,9 +331,6 @@ VulkanSwapChain::VulkanSwapChain(VulkanContext& context, uint32_t width, uint32_
     surfaceContext.clientSize.width = width;
     surfaceContext.clientSize.height = height;
 
-    surfaceContext.imageAvailable = VK_NULL_HANDLE;
-    surfaceContext.renderingFinished = VK_NULL_HANDLE;
-
     createFinalDepthBuffer(context, surfaceContext, context.finalDepthFormat);
 }
 
@@ -428,23 +452,22 @@ VulkanUniformBuffer::VulkanUniformBuffer(VulkanContext& context, VulkanStagePool
         .size = numBytes,
         .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
     };
-    VmaAllocationCreateInfo allocInfo {
-        .usage = VMA_MEMORY_USAGE_GPU_ONLY
-    };
-    vmaCreateBuffer(mContext.allocator, &bufferInfo, &allocInfo, &mGpuBuffer, &mGpuMemory, nullptr);
+    VkResult result = mContext.memoryPools->createBuffer(VulkanMemoryPools::Kind::BUFFER,
+            bufferInfo, &mGpuBuffer, &mGpuMemory);
+    ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to allocate a uniform buffer.");
 }
 
-void VulkanUniformBuffer::loadFromCpu(const void* cpuData, uint32_t numBytes) {
-    VulkanStage const* stage = mStagePool.acquireStage(numBytes);
-    void* mapped;
-    vmaMapMemory(mContext.allocator, stage->memory, &mapped);
-    memcpy(mapped, cpuData, numBytes);
-    vmaUnmapMemory(mContext.allocator, stage->memory);
-    vmaFlushAllocation(mContext.allocator, stage->memory, 0, numBytes);
-
-    auto copyToDevice = [this, numBytes, stage] (VulkanCommandBuffer& commands) {
-        VkBufferCopy region { .size = numBytes };
-        vkCmdCopyBuffer(commands.cmdbuffer, stage->buffer, mGpuBuffer, 1, &region);
+void VulkanUniformBuffer::loadFromCpu(const void* cpuData, uint32_t byteOffset,
+        uint32_t numBytes) {
+    auto copyToDevice = [this, cpuData, byteOffset, numBytes] (VulkanCommandBuffer& commands) {
+        VulkanStagingRegion const src = mStagePool.upload(cpuData, numBytes, commands);
+        VkBufferCopy region {
+            .srcOffset = src.offset,
+            .dstOffset = byteOffset,
+            .size = numBytes
+        };
+        commands.barriers.flush(commands.cmdbuffer);
+        vkCmdCopyBuffer(commands.cmdbuffer, src.buffer, mGpuBuffer, 1, &region);
         mDisposer.acquire(this, commands.resources);
 
         // Ensure that the copy finishes before the next draw call.
@@ -457,10 +480,8 @@ void VulkanUniformBuffer::loadFromCpu(const void* cpuData, uint32_t numBytes) {
             .buffer = mGpuBuffer,
             .size = VK_WHOLE_SIZE
         };
-        vkCmdPipelineBarrier(commands.cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
-
-        mStagePool.releaseStage(stage, commands);
+        commands.barriers.add(commands.cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, barrier);
     };
 
     // If inside beginFrame / endFrame, use the swap context, otherwise use the work cmdbuffer.
@@ -474,7 +495,7 @@ void VulkanUniformBuffer::loadFromCpu(const void* cpuData, uint32_t numBytes) {
 }
 
 VulkanUniformBuffer::~VulkanUniformBuffer() {
-    vmaDestroyBuffer(mContext.allocator, mGpuBuffer, mGpuMemory);
+    mContext.memoryPools->destroyBuffer(mGpuBuffer, mGpuMemory);
 }
 
 VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t levels,
@@ -518,8 +539,12 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
 
     // Filament expects blit() to work with any texture, so we almost always set these usage flags.
     // TODO: investigate performance implications of setting these flags.
-    const VkImageUsageFlags blittable = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    // Transient attachments are the exception, since they are never stored to memory. On tilers
+    // they can live entirely in tile memory.
+    const bool transient = any(usage & TextureUsage::TRANSIENT_ATTACHMENT) &&
+            none(usage & (TextureUsage::SAMPLEABLE | TextureUsage::UPLOADABLE));
+    const VkImageUsageFlags blittable = transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT :
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
     if (any(usage & TextureUsage::SAMPLEABLE)) {
 
@@ -552,7 +577,9 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
         imageInfo.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
     }
 
-    VkResult error = vkCreateImage(context.device, &imageInfo, VKALLOC, &textureImage);
+    // Transient attachments are backed by lazily allocated memory where available.
+    VkResult error = context.memoryPools->createImage(imageInfo, transient, &textureImage,
+            &textureImageMemory);
     if (error || FILAMENT_VULKAN_VERBOSE) {
         utils::slog.d << "vkCreateImage: "
             << "result = " << error << ", "
@@ -565,55 +592,20 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
     }
     ASSERT_POSTCONDITION(!error, "Unable to create image.");
 
-    // Allocate memory for the VkImage and bind it.
-    VkMemoryRequirements memReqs = {};
-    vkGetImageMemoryRequirements(context.device, textureImage, &memReqs);
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = selectMemoryType(context, memReqs.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    error = vkAllocateMemory(context.device, &allocInfo, nullptr, &textureImageMemory);
-    ASSERT_POSTCONDITION(!error, "Unable to allocate image memory.");
-    error = vkBindImageMemory(context.device, textureImage, textureImageMemory, 0);
-    ASSERT_POSTCONDITION(!error, "Unable to bind image.");
-
     mAspect = any(usage & TextureUsage::DEPTH_ATTACHMENT) ? VK_IMAGE_ASPECT_DEPTH_BIT :
             VK_IMAGE_ASPECT_COLOR_BIT;
 
     // Create a VkImageView so that shaders can sample from the image.
     // RenderTarget does not use this view because it selects a single miplevel.
-    VkImageViewCreateInfo viewInfo = {};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = textureImage;
-    viewInfo.format = vkformat;
-    viewInfo.subresourceRange.aspectMask = mAspect;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = levels;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    if (target == SamplerType::SAMPLER_CUBEMAP) {
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-        viewInfo.subresourceRange.layerCount = 6;
-    } else if (target == SamplerType::SAMPLER_2D_ARRAY) {
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-        viewInfo.subresourceRange.layerCount = depth;
-    } else if (target == SamplerType::SAMPLER_3D) {
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
-        viewInfo.subresourceRange.layerCount = 1;
-    } else {
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.subresourceRange.layerCount = 1;
-    }
-    error = vkCreateImageView(context.device, &viewInfo, VKALLOC, &imageView);
-    ASSERT_POSTCONDITION(!error, "Unable to create image view.");
+    imageView = createPrimaryView(0, levels - 1);
+    mPrimaryViews.push_back({ 0, uint32_t(levels - 1), imageView });
 
     if (any(usage & (TextureUsage::COLOR_ATTACHMENT | TextureUsage::DEPTH_ATTACHMENT))) {
-        auto transition = [=](VulkanCommandBuffer commands) {
+        auto transition = [=](VulkanCommandBuffer& commands) {
             // If this is a SAMPLER_2D_ARRAY texture, then the depth argument stores the number of
             // texture layers.
             const uint32_t layers = target == SamplerType::SAMPLER_2D_ARRAY ? depth : 1;
-            VulkanTexture::transitionImageLayout(commands.cmdbuffer, textureImage,
+            VulkanTexture::transitionImageLayout(commands, textureImage,
                     VK_IMAGE_LAYOUT_UNDEFINED, getTextureLayout(usage), 0, layers, levels, mAspect);
         };
         if (mContext.currentCommands) {
@@ -626,10 +618,129 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
     }
 }
 
+VulkanExternalImage::VulkanExternalImage(VulkanContext& context, AcquiredImage const& acquired)
+        : context(context), acquired(acquired) {
+#if defined(__ANDROID__)
+    if (!context.hardwareBufferSupported) {
+        utils::slog.w << "Hardware buffers can't be imported by this device." << utils::io::endl;
+        return;
+    }
+
+    AHardwareBuffer* buffer = (AHardwareBuffer*) acquired.image;
+    AHardwareBuffer_Desc desc = {};
+    AHardwareBuffer_describe(buffer, &desc);
+
+    VkAndroidHardwareBufferFormatPropertiesANDROID formatProperties = {
+        .sType = VK_STRUCTURE_TYPE_ANDROID_HARDWARE_BUFFER_FORMAT_PROPERTIES_ANDROID
+    };
+    VkAndroidHardwareBufferPropertiesANDROID properties = {
+        .sType = VK_STRUCTURE_TYPE_ANDROID_HARDWARE_BUFFER_PROPERTIES_ANDROID,
+        .pNext = &formatProperties
+    };
+    VkResult result = vkGetAndroidHardwareBufferPropertiesANDROID(context.device, buffer,
+            &properties);
+    if (result != VK_SUCCESS) {
+        utils::slog.w << "Unable to query the properties of a hardware buffer." << utils::io::endl;
+        return;
+    }
+
+    // YUV buffers usually have an external format, which can only be sampled through an
+    // immutable VkSamplerYcbcrConversion. The binder doesn't support immutable samplers.
+    if (formatProperties.format == VK_FORMAT_UNDEFINED) {
+        utils::slog.w << "Hardware buffers with an external format aren't supported."
+                << utils::io::endl;
+        return;
+    }
+
+    VkExternalMemoryImageCreateInfo externalInfo = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_ANDROID_HARDWARE_BUFFER_BIT_ANDROID
+    };
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = &externalInfo,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = formatProperties.format,
+        .extent = { desc.width, desc.height, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+    result = vkCreateImage(context.device, &imageInfo, VKALLOC, &image);
+    if (result != VK_SUCCESS) {
+        utils::slog.w << "Unable to create an image for a hardware buffer." << utils::io::endl;
+        return;
+    }
+
+    // The memory of the buffer is imported rather than allocated, which is what makes this
+    // zero-copy. Imported buffers require a dedicated allocation.
+    VkImportAndroidHardwareBufferInfoANDROID importInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_ANDROID_HARDWARE_BUFFER_INFO_ANDROID,
+        .buffer = buffer
+    };
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext = &importInfo,
+        .image = image
+    };
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &dedicatedInfo,
+        .allocationSize = properties.allocationSize,
+        .memoryTypeIndex = selectMemoryType(context, properties.memoryTypeBits, 0)
+    };
+    result = vkAllocateMemory(context.device, &allocInfo, VKALLOC, &memory);
+    if (result != VK_SUCCESS) {
+        utils::slog.w << "Unable to import the memory of a hardware buffer." << utils::io::endl;
+        return;
+    }
+    vkBindImageMemory(context.device, image, memory, 0);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = formatProperties.format,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+    vkCreateImageView(context.device, &viewInfo, VKALLOC, &view);
+
+    // The buffer was written by the producer of the stream (e.g. the camera), so its ownership
+    // is transferred from the foreign queue family. This also makes the contents visible.
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_FOREIGN_EXT,
+        .dstQueueFamilyIndex = context.graphicsQueueFamilyIndex,
+        .image = image,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+    VkCommandBuffer cmdbuffer = acquireWorkCommandBuffer(context);
+    context.work.barriers.add(cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, barrier);
+#else
+    utils::slog.w << "Acquired stream images are only supported on Android." << utils::io::endl;
+#endif
+}
+
+VulkanExternalImage::~VulkanExternalImage() {
+    vkDestroyImageView(context.device, view, VKALLOC);
+    vkDestroyImage(context.device, image, VKALLOC);
+    vkFreeMemory(context.device, memory, VKALLOC);
+}
+
 VulkanTexture::~VulkanTexture() {
-    vkDestroyImage(mContext.device, textureImage, VKALLOC);
-    vkDestroyImageView(mContext.device, imageView, VKALLOC);
-    vkFreeMemory(mContext.device, textureImageMemory, VKALLOC);
+    for (auto entry : mPrimaryViews) {
+        vkDestroyImageView(mContext.device, entry.view, VKALLOC);
+    }
+    mContext.memoryPools->destroyImage(textureImage, textureImageMemory);
     for (auto entry : mImageViews) {
         vkDestroyImageView(mContext.device, entry.view, VKALLOC);
     }
@@ -672,14 +783,7 @@ void VulkanTexture::update3DImage(const PixelBufferDescriptor& data, uint32_t wi
 
     // Create a copy-to-device functor.
     auto copyToDevice = [this, stage, width, height, depth, miplevel] (VulkanCommandBuffer& commands) {
-        transitionImageLayout(commands.cmdbuffer, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel, 1, 1, mAspect);
-        copyBufferToImage(commands.cmdbuffer, stage->buffer, textureImage, width, height, depth,
-                nullptr, miplevel);
-        transitionImageLayout(commands.cmdbuffer, textureImage,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                getTextureLayout(usage), miplevel, 1, 1, mAspect);
-
-        mStagePool.releaseStage(stage, commands);
+        copyStageToImage(commands, stage, width, height, depth, nullptr, miplevel, 1);
     };
 
     // If inside beginFrame / endFrame, use the swap context, otherwise use the work cmdbuffer.
@@ -716,15 +820,7 @@ void VulkanTexture::updateCubeImage(const PixelBufferDescriptor& data,
     auto copyToDevice = [this, faceOffsets, stage, miplevel] (VulkanCommandBuffer& commands) {
         uint32_t width = std::max(1u, this->width >> miplevel);
         uint32_t height = std::max(1u, this->height >> miplevel);
-        transitionImageLayout(commands.cmdbuffer, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel, 6, 1, mAspect);
-        copyBufferToImage(commands.cmdbuffer, stage->buffer, textureImage, width, height, 1,
-                &faceOffsets, miplevel);
-        transitionImageLayout(commands.cmdbuffer, textureImage,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, getTextureLayout(usage), miplevel, 6,
-                1, mAspect);
-
-        mStagePool.releaseStage(stage, commands);
+        copyStageToImage(commands, stage, width, height, 1, &faceOffsets, miplevel, 6);
     };
 
     // If inside beginFrame / endFrame, use the swap context, otherwise use the work cmdbuffer.
@@ -737,6 +833,100 @@ void VulkanTexture::updateCubeImage(const PixelBufferDescriptor& data,
     }
 }
 
+void VulkanTexture::copyStageToImage(VulkanCommandBuffer& commands, VulkanStage const* stage,
+        uint32_t width, uint32_t height, uint32_t depth, FaceOffsets const* faceOffsets,
+        uint32_t miplevel, uint32_t layers) {
+    const VkImageLayout layout = getTextureLayout(usage);
+    VkCommandBuffer transfer = acquireTransferCommandBuffer(mContext, commands);
+    if (!transfer) {
+        transitionImageLayout(commands, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel, layers, 1, mAspect);
+        commands.barriers.flush(commands.cmdbuffer);
+        copyBufferToImage(commands.cmdbuffer, stage->buffer, textureImage, width, height, depth,
+                faceOffsets, miplevel);
+        // Left pending, so that it's batched with the transitions of the next uploads.
+        transitionImageLayout(commands, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                layout, miplevel, layers, 1, mAspect);
+    } else {
+        transitionImageLayout(transfer, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel, layers, 1, mAspect);
+        copyBufferToImage(transfer, stage->buffer, textureImage, width, height, depth,
+                faceOffsets, miplevel);
+
+        // Hand the miplevel over to the graphics queue. The same barrier is recorded on both
+        // queues: it releases ownership on the transfer queue and acquires it on the graphics
+        // queue, which waits for the transfer semaphore at TRANSFER_WAIT_STAGES.
+        VkImageMemoryBarrier barrier {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = 0,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = layout,
+            .srcQueueFamilyIndex = mContext.transferQueueFamilyIndex,
+            .dstQueueFamilyIndex = mContext.graphicsQueueFamilyIndex,
+            .image = textureImage,
+            .subresourceRange = {
+                .aspectMask = mAspect,
+                .baseMipLevel = miplevel,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = layers,
+            }
+        };
+        vkCmdPipelineBarrier(transfer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        commands.barriers.add(commands.cmdbuffer, TRANSFER_WAIT_STAGES, TRANSFER_WAIT_STAGES,
+                barrier);
+    }
+
+    // The graphics command buffer finishes after the upload, so it can own the stage in both cases.
+    mStagePool.releaseStage(stage, commands);
+}
+
+VkImageView VulkanTexture::createPrimaryView(uint32_t minLevel, uint32_t maxLevel) {
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = textureImage;
+    viewInfo.format = vkformat;
+    viewInfo.subresourceRange.aspectMask = mAspect;
+    viewInfo.subresourceRange.baseMipLevel = minLevel;
+    viewInfo.subresourceRange.levelCount = maxLevel - minLevel + 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    if (target == SamplerType::SAMPLER_CUBEMAP) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+        viewInfo.subresourceRange.layerCount = 6;
+    } else if (target == SamplerType::SAMPLER_2D_ARRAY) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewInfo.subresourceRange.layerCount = depth;
+    } else if (target == SamplerType::SAMPLER_3D) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+        viewInfo.subresourceRange.layerCount = 1;
+    } else {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.subresourceRange.layerCount = 1;
+    }
+    VkImageView view;
+    VkResult error = vkCreateImageView(mContext.device, &viewInfo, VKALLOC, &view);
+    ASSERT_POSTCONDITION(!error, "Unable to create image view.");
+    return view;
+}
+
+void VulkanTexture::setPrimaryRange(uint32_t minLevel, uint32_t maxLevel) {
+    maxLevel = std::min(maxLevel, uint32_t(levels - 1));
+    minLevel = std::min(minLevel, maxLevel);
+    for (auto const& entry : mPrimaryViews) {
+        if (entry.minLevel == minLevel && entry.maxLevel == maxLevel) {
+            imageView = entry.view;
+            return;
+        }
+    }
+    // there are at most levels * (levels + 1) / 2 ranges
+    imageView = createPrimaryView(minLevel, maxLevel);
+    mPrimaryViews.push_back({ minLevel, maxLevel, imageView });
+}
+
 VkImageView VulkanTexture::getImageView(int level, int layer, VkImageAspectFlags aspect) {
     for (auto entry : mImageViews) {
         if (entry.level == level && entry.layer == layer) {
@@ -776,64 +966,173 @@ VkImageView VulkanTexture::getImageView(int level, int layer, VkImageAspectFlags
     return imageView;
 }
 
+void VulkanTexture::generateMipmaps(VulkanCommandBuffer& commands) {
+    if (levels < 2 || target == SamplerType::SAMPLER_3D ||
+            target == SamplerType::SAMPLER_EXTERNAL) {
+        return;
+    }
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(mContext.physicalDevice, vkformat, &properties);
+    const VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+    const VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if ((features & blit) != blit) {
+        utils::slog.e << "Texture format " << vkformat << " is not blittable." << utils::io::endl;
+        return;
+    }
+    const VkFilter filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ?
+            VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    const VkImageLayout layout = getTextureLayout(usage);
+    const uint32_t layers = target == SamplerType::SAMPLER_CUBEMAP ? 6 :
+            target == SamplerType::SAMPLER_2D_ARRAY ? depth : 1;
+
+    VkImageMemoryBarrier barrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = textureImage,
+        .subresourceRange = { mAspect, 0, 1, 0, layers }
+    };
+    auto transition = [&](uint32_t level, uint32_t levelCount,
+            VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+            VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        commands.barriers.add(commands.cmdbuffer, srcStages, dstStages, barrier);
+    };
+
+    // All the levels are transitioned at once: the base level becomes the source of the first
+    // blit, and the others, whose contents are replaced, become destinations.
+    transition(0, 1, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT);
+    transition(1, levels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    commands.barriers.flush(commands.cmdbuffer);
+
+    for (uint32_t level = 1; level < levels; level++) {
+        const int32_t srcWidth = std::max(1u, width >> (level - 1));
+        const int32_t srcHeight = std::max(1u, height >> (level - 1));
+        const int32_t dstWidth = std::max(1u, width >> level);
+        const int32_t dstHeight = std::max(1u, height >> level);
+        const VkImageBlit region {
+            .srcSubresource = { mAspect, level - 1, 0, layers },
+            .srcOffsets = { { 0, 0, 0 }, { srcWidth, srcHeight, 1 } },
+            .dstSubresource = { mAspect, level, 0, layers },
+            .dstOffsets = { { 0, 0, 0 }, { dstWidth, dstHeight, 1 } }
+        };
+        vkCmdBlitImage(commands.cmdbuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter);
+
+        // the level just written is the source of the next blit
+        if (level + 1 < levels) {
+            transition(level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            commands.barriers.flush(commands.cmdbuffer);
+        }
+    }
+
+    // All the levels go back to the layout of the texture together, this is left pending until
+    // the next command that needs it.
+    transition(0, levels - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    transition(levels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
 // TODO: replace the last 4 args with VkImageSubresourceRange
-// TODO: replace this function with a flexible thin wrapper over image barrier creation
-void VulkanTexture::transitionImageLayout(VkCommandBuffer cmd, VkImage image,
-        VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel,
-        uint32_t layerCount, uint32_t levelCount, VkImageAspectFlags aspect) {
+// Fills the barrier of a layout transition and its stages, returns false if there's nothing to do.
+static bool getLayoutTransition(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+        uint32_t miplevel, uint32_t layerCount, uint32_t levelCount, VkImageAspectFlags aspect,
+        VkImageMemoryBarrier* barrier, VkPipelineStageFlags* sourceStage,
+        VkPipelineStageFlags* destinationStage) {
     if (oldLayout == newLayout) {
-        return;
+        return false;
     }
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = aspect;
-    barrier.subresourceRange.baseMipLevel = miplevel;
-    barrier.subresourceRange.levelCount = levelCount;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = layerCount;
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
+    *barrier = {};
+    barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier->oldLayout = oldLayout;
+    barrier->newLayout = newLayout;
+    barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->image = image;
+    barrier->subresourceRange.aspectMask = aspect;
+    barrier->subresourceRange.baseMipLevel = miplevel;
+    barrier->subresourceRange.levelCount = levelCount;
+    barrier->subresourceRange.baseArrayLayer = 0;
+    barrier->subresourceRange.layerCount = layerCount;
     switch (newLayout) {
         case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            barrier->srcAccessMask = 0;
+            barrier->dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            *sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            *destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
             break;
         case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            barrier->srcAccessMask = 0;
+            barrier->dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            *sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            *destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
             break;
         case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
         case VK_IMAGE_LAYOUT_GENERAL:
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier->dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            *sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            *destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
             break;
 
         // We support PRESENT as a target layout to allow blitting from the swap chain.
         // See also makeSwapChainPresentable().
         case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
         case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = 0;
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            barrier->srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier->dstAccessMask = 0;
+            *sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            *destinationStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
             break;
 
         default:
            PANIC_POSTCONDITION("Unsupported layout transition.");
     }
-    vkCmdPipelineBarrier(cmd, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1,
-            &barrier);
+    return true;
+}
+
+void VulkanTexture::transitionImageLayout(VulkanCommandBuffer& commands, VkImage image,
+        VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel,
+        uint32_t layerCount, uint32_t levelCount, VkImageAspectFlags aspect) {
+    VkImageMemoryBarrier barrier;
+    VkPipelineStageFlags sourceStage;
+    VkPipelineStageFlags destinationStage;
+    if (getLayoutTransition(image, oldLayout, newLayout, miplevel, layerCount, levelCount, aspect,
+            &barrier, &sourceStage, &destinationStage)) {
+        commands.barriers.add(commands.cmdbuffer, sourceStage, destinationStage, barrier);
+    }
+}
+
+void VulkanTexture::transitionImageLayout(VkCommandBuffer cmd, VkImage image,
+        VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel,
+        uint32_t layerCount, uint32_t levelCount, VkImageAspectFlags aspect) {
+    VkImageMemoryBarrier barrier;
+    VkPipelineStageFlags sourceStage;
+    VkPipelineStageFlags destinationStage;
+    if (getLayoutTransition(image, oldLayout, newLayout, miplevel, layerCount, levelCount, aspect,
+            &barrier, &sourceStage, &destinationStage)) {
+        vkCmdPipelineBarrier(cmd, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1,
+                &barrier);
+    }
 }
 
 void VulkanTexture::copyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image,
@@ -886,7 +1185,7 @@ void VulkanRenderPrimitive::setBuffers(VulkanVertexBuffer* vertexBuffer,
     const size_t nattrs = vertexBuffer->attributes.size();
 
     // These vectors are passed to vkCmdBindVertexBuffers at every draw call. This binds the
-    // VkBuffer objects, but does not describe the structure of a vertex.
+    // VulkanBuffer objects, but does not describe the structure of a vertex.
     buffers.clear();
     buffers.reserve(nattrs);
     offsets.clear();
@@ -900,8 +1199,8 @@ void VulkanRenderPrimitive::setBuffers(VulkanVertexBuffer* vertexBuffer,
     // Position should always be present.
     assert(enabledAttributes & 1);
 
-    // For each enabled attribute, append to each of the above lists. Note that a single VkBuffer
-    // handle might be appended more than once, which is perfectly fine.
+    // For each enabled attribute, append to each of the above lists. Note that a single
+    // VulkanBuffer might be appended more than once, which is perfectly fine.
     uint32_t bufferIndex = 0;
     for (uint32_t attribIndex = 0; attribIndex < nattrs; attribIndex++) {
         Attribute attrib = vertexBuffer->attributes[attribIndex];
@@ -925,7 +1224,7 @@ void VulkanRenderPrimitive::setBuffers(VulkanVertexBuffer* vertexBuffer,
             }
         }
 
-        buffers.push_back(vertexBuffer->buffers[attrib.buffer]->getGpuBuffer());
+        buffers.push_back(vertexBuffer->buffers[attrib.buffer].get());
         offsets.push_back(attrib.offset);
         varray.attributes[bufferIndex] = {
             .location = attribIndex, // matches the GLSL layout specifier
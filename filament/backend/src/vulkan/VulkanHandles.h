@@ -20,16 +20,23 @@
 #include "VulkanDriver.h"
 #include "VulkanBinder.h"
 #include "VulkanBuffer.h"
+#include "VulkanShaderCache.h"
 
 namespace filament {
 namespace backend {
 
-struct VulkanProgram : public HwProgram {
-    VulkanProgram(VulkanContext& context, const Program& builder) noexcept;
+struct VulkanProgram : public HwProgram, public VulkanDisposable {
+    VulkanProgram(VulkanContext& context, VulkanShaderCache& shaderCache,
+            const Program& builder) noexcept;
     ~VulkanProgram();
     VulkanContext& context;
+    VulkanShaderCache& shaderCache;
     VulkanBinder::ProgramBundle bundle;
     Program::SamplerGroupInfo samplerGroupInfo;
+    // all the constants are 32 bits wide
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    std::vector<uint32_t> specializationData;
+    VkSpecializationInfo specializationInfo = {};
 };
 
 // The render target bundles together a set of attachments, each of which can have one of the
@@ -40,7 +47,7 @@ struct VulkanProgram : public HwProgram {
 //
 // We use private inheritance to shield clients from the width / height fields in HwRenderTarget,
 // which are not representative when this is the default render target.
-struct VulkanRenderTarget : private HwRenderTarget {
+struct VulkanRenderTarget : private HwRenderTarget, public VulkanDisposable {
     // Creates an offscreen render target.
     VulkanRenderTarget(VulkanContext& context, uint32_t width, uint32_t height, uint8_t samples,
             VulkanAttachment color[MRT::TARGET_COUNT], VulkanAttachment depthStencil[2],
@@ -78,14 +85,14 @@ struct VulkanSwapChain : public HwSwapChain {
     VulkanSurfaceContext surfaceContext;
 };
 
-struct VulkanVertexBuffer : public HwVertexBuffer {
+struct VulkanVertexBuffer : public HwVertexBuffer, public VulkanDisposable {
     VulkanVertexBuffer(VulkanContext& context, VulkanStagePool& stagePool, VulkanDisposer& disposer,
             uint8_t bufferCount, uint8_t attributeCount, uint32_t elementCount,
             AttributeArray const& attributes);
     std::vector<std::unique_ptr<VulkanBuffer>> buffers;
 };
 
-struct VulkanIndexBuffer : public HwIndexBuffer {
+struct VulkanIndexBuffer : public HwIndexBuffer, public VulkanDisposable {
     VulkanIndexBuffer(VulkanContext& context, VulkanStagePool& stagePool, VulkanDisposer& disposer,
             uint8_t elementSize, uint32_t indexCount) : HwIndexBuffer(elementSize, indexCount),
             indexType(elementSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32),
@@ -95,11 +102,20 @@ struct VulkanIndexBuffer : public HwIndexBuffer {
     const std::unique_ptr<VulkanBuffer> buffer;
 };
 
-struct VulkanUniformBuffer : public HwUniformBuffer {
+struct VulkanBufferObject : public HwBufferObject, public VulkanDisposable {
+    VulkanBufferObject(VulkanContext& context, VulkanStagePool& stagePool, VulkanDisposer& disposer,
+            uint32_t byteCount, BufferObjectBinding bindingType)
+            : HwBufferObject(byteCount, bindingType),
+            buffer(new VulkanBuffer(context, stagePool, disposer, this,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, byteCount)) {}
+    const std::unique_ptr<VulkanBuffer> buffer;
+};
+
+struct VulkanUniformBuffer : public HwUniformBuffer, public VulkanDisposable {
     VulkanUniformBuffer(VulkanContext& context, VulkanStagePool& stagePool,
             VulkanDisposer& disposer, uint32_t numBytes, backend::BufferUsage usage);
     ~VulkanUniformBuffer();
-    void loadFromCpu(const void* cpuData, uint32_t numBytes);
+    void loadFromCpu(const void* cpuData, uint32_t byteOffset, uint32_t numBytes);
     VkBuffer getGpuBuffer() const { return mGpuBuffer; }
 private:
     VulkanContext& mContext;
@@ -113,7 +129,25 @@ struct VulkanSamplerGroup : public HwSamplerGroup {
     VulkanSamplerGroup(VulkanContext& context, uint32_t count) : HwSamplerGroup(count) {}
 };
 
-struct VulkanTexture : public HwTexture {
+struct VulkanStream : public HwStream {
+    // the image set by setAcquiredImage(), picked up by the next updateStreams()
+    AcquiredImage pending = {};
+};
+
+// A hardware buffer acquired from an external stream, imported as a sampled image without any
+// copy. It is a disposable: it's destroyed, and its buffer released to the client, once the last
+// command buffer that samples it has completed.
+struct VulkanExternalImage : public VulkanDisposable {
+    VulkanExternalImage(VulkanContext& context, AcquiredImage const& acquired);
+    ~VulkanExternalImage();
+    VulkanContext& context;
+    AcquiredImage acquired;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;   // null if the buffer couldn't be imported
+};
+
+struct VulkanTexture : public HwTexture, public VulkanDisposable {
     VulkanTexture(VulkanContext& context, SamplerType target, uint8_t levels,
             TextureFormat format, uint8_t samples, uint32_t w, uint32_t h, uint32_t depth,
             TextureUsage usage, VulkanStagePool& stagePool);
@@ -128,8 +162,29 @@ struct VulkanTexture : public HwTexture {
     // Gets or creates a cached image view for a single miplevel and array layer.
     VkImageView getImageView(int level, int layer, VkImageAspectFlags aspect);
 
-    // Issues a barrier that transforms the layout of the image, e.g. from a CPU-writeable
-    // layout to a GPU-readable layout.
+    // Selects the miplevels sampled by shaders, i.e. the range of imageView. The views of the
+    // previous ranges may still be used by command buffers in flight, so they're cached until
+    // the texture is destroyed.
+    void setPrimaryRange(uint32_t minLevel, uint32_t maxLevel);
+
+    template<typename F>
+    void forEachPrimaryView(F&& f) const {
+        for (auto const& entry : mPrimaryViews) {
+            f(entry.view);
+        }
+    }
+
+    // Generates the miplevels 1 and up from the miplevel 0, with a chain of blits.
+    void generateMipmaps(VulkanCommandBuffer& commands);
+
+    // Adds a barrier that transforms the layout of the image, e.g. from a CPU-writeable layout to
+    // a GPU-readable layout, to the barriers batched by the command buffer.
+    static void transitionImageLayout(VulkanCommandBuffer& commands, VkImage image,
+            VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel,
+            uint32_t layers, uint32_t levels, VkImageAspectFlags aspect);
+
+    // Same as above, but the barrier is recorded immediately, for the command buffers that don't
+    // batch their barriers (i.e. the transfer queue's).
     static void transitionImageLayout(VkCommandBuffer cmdbuffer, VkImage image,
             VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel,
             uint32_t layers, uint32_t levels, VkImageAspectFlags aspect);
@@ -137,9 +192,19 @@ struct VulkanTexture : public HwTexture {
     VkFormat vkformat;
     VkImageView imageView = VK_NULL_HANDLE;
     VkImage textureImage = VK_NULL_HANDLE;
-    VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+    VmaAllocation textureImageMemory = VK_NULL_HANDLE;
+
+    // for SAMPLER_EXTERNAL textures, the stream they're attached to and its current image
+    VulkanStream* stream = nullptr;
+    VulkanExternalImage* externalImage = nullptr;
 private:
 
+    // Records the upload of a stage to a miplevel, on the transfer queue if there is one. The
+    // given graphics command buffer is the one using the texture next.
+    void copyStageToImage(VulkanCommandBuffer& commands, VulkanStage const* stage,
+            uint32_t width, uint32_t height, uint32_t depth, FaceOffsets const* faceOffsets,
+            uint32_t miplevel, uint32_t layers);
+
     // Issues a copy from a VkBuffer to a specified miplevel in a VkImage. The given width and
     // height define a subregion within the miplevel.
     void copyBufferToImage(VkCommandBuffer cmdbuffer, VkBuffer buffer, VkImage image,
@@ -152,7 +217,16 @@ private:
         VkImageView view;
     };
 
+    struct PrimaryViewCacheEntry {
+        uint32_t minLevel;
+        uint32_t maxLevel;
+        VkImageView view;
+    };
+
+    VkImageView createPrimaryView(uint32_t minLevel, uint32_t maxLevel);
+
     std::vector<ImageViewCacheEntry> mImageViews;
+    std::vector<PrimaryViewCacheEntry> mPrimaryViews;
     VkImageAspectFlags mAspect;
     VulkanContext& mContext;
     VulkanStagePool& mStagePool;
@@ -168,9 +242,10 @@ struct VulkanRenderPrimitive : public HwRenderPrimitive {
     VkPrimitiveTopology primitiveTopology;
     // The "varray" field describes the structure of the vertex and gets passed to VulkanBinder,
     // which in turn passes it to vkCreateGraphicsPipelines. The "buffers" and "offsets" vectors are
-    // passed to vkCmdBindVertexBuffers at draw call time.
+    // passed to vkCmdBindVertexBuffers at draw call time, where the VkBuffer handles are read from
+    // the buffers since they change when the buffers are relocated.
     VulkanBinder::VertexArray varray;
-    std::vector<VkBuffer> buffers;
+    std::vector<VulkanBuffer const*> buffers;
     std::vector<VkDeviceSize> offsets;
 };
 
@@ -184,7 +259,7 @@ struct VulkanSync : public HwSync {
     std::shared_ptr<VulkanCmdFence> fence;
 };
 
-struct VulkanTimerQuery : public HwTimerQuery {
+struct VulkanTimerQuery : public HwTimerQuery, public VulkanDisposable {
     VulkanTimerQuery(VulkanContext& context);
     ~VulkanTimerQuery();
     uint32_t startingQueryIndex;
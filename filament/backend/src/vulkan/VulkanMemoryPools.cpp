@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan/VulkanMemoryPools.h"
+
+#include <utils/Panic.h>
+
+#include <mutex>
+
+using namespace bluevk;
+
+namespace filament {
+namespace backend {
+
+VkResult VulkanMemoryPools::createBuffer(Kind kind, VkBufferCreateInfo const& info,
+        VkBuffer* buffer, VmaAllocation* allocation) noexcept {
+    assert(kind != Kind::IMAGE);
+
+    // Relocating a buffer copies it to a new one.
+    VkBufferCreateInfo bufferInfo = info;
+    if (kind == Kind::GEOMETRY) {
+        bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+    VkResult result = vkCreateBuffer(mContext.device, &bufferInfo, VKALLOC, buffer);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(mContext.device, *buffer, &requirements);
+    const VmaAllocationCreateInfo allocInfo = getAllocationInfo(kind, requirements);
+    result = vmaAllocateMemoryForBuffer(mContext.allocator, *buffer, &allocInfo, allocation,
+            nullptr);
+    if (result == VK_SUCCESS) {
+        result = vmaBindBufferMemory(mContext.allocator, *allocation, *buffer);
+        if (result != VK_SUCCESS) {
+            vmaFreeMemory(mContext.allocator, *allocation);
+        }
+    }
+    if (result != VK_SUCCESS) {
+        vkDestroyBuffer(mContext.device, *buffer, VKALLOC);
+        *buffer = VK_NULL_HANDLE;
+        *allocation = VK_NULL_HANDLE;
+        return result;
+    }
+
+    // Only the pools are defragmented.
+    if (kind == Kind::GEOMETRY && allocInfo.pool) {
+        mRelocatables[*allocation] = { buffer, bufferInfo.size, bufferInfo.usage };
+    }
+    mAllocationCount++;
+    return VK_SUCCESS;
+}
+
+void VulkanMemoryPools::destroyBuffer(VkBuffer buffer, VmaAllocation allocation) noexcept {
+    if (!allocation) {
+        return;
+    }
+    mAllocationCount++;
+
+    const bool relocatable = mRelocatables.erase(allocation) != 0;
+    if (relocatable && mDefragmentation) {
+        // The buffer may be the destination of the copies in flight.
+        if (mPassFence) {
+            mRetiredBuffers.push_back(buffer);
+        } else {
+            vkDestroyBuffer(mContext.device, buffer, VKALLOC);
+        }
+        mDeferredFrees.push_back(allocation);
+        return;
+    }
+    vkDestroyBuffer(mContext.device, buffer, VKALLOC);
+    vmaFreeMemory(mContext.allocator, allocation);
+}
+
+VkResult VulkanMemoryPools::createImage(VkImageCreateInfo const& info, bool transient,
+        VkImage* image, VmaAllocation* allocation) noexcept {
+    VkResult result = vkCreateImage(mContext.device, &info, VKALLOC, image);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    // Lazily allocated memory is only backed by physical memory if the attachment is stored, it
+    // can't be shared with other images.
+    result = VK_ERROR_FEATURE_NOT_PRESENT;
+    if (transient) {
+        const VmaAllocationCreateInfo allocInfo {
+            .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+            .usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED
+        };
+        result = vmaAllocateMemoryForImage(mContext.allocator, *image, &allocInfo, allocation,
+                nullptr);
+    }
+    if (result != VK_SUCCESS) {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(mContext.device, *image, &requirements);
+        const VmaAllocationCreateInfo allocInfo = getAllocationInfo(Kind::IMAGE, requirements);
+        result = vmaAllocateMemoryForImage(mContext.allocator, *image, &allocInfo, allocation,
+                nullptr);
+    }
+    if (result == VK_SUCCESS) {
+        result = vmaBindImageMemory(mContext.allocator, *allocation, *image);
+        if (result != VK_SUCCESS) {
+            vmaFreeMemory(mContext.allocator, *allocation);
+        }
+    }
+    if (result != VK_SUCCESS) {
+        vkDestroyImage(mContext.device, *image, VKALLOC);
+        *image = VK_NULL_HANDLE;
+        *allocation = VK_NULL_HANDLE;
+        return result;
+    }
+    mAllocationCount++;
+    return VK_SUCCESS;
+}
+
+void VulkanMemoryPools::destroyImage(VkImage image, VmaAllocation allocation) noexcept {
+    if (!allocation) {
+        return;
+    }
+    mAllocationCount++;
+    vkDestroyImage(mContext.device, image, VKALLOC);
+    vmaFreeMemory(mContext.allocator, allocation);
+}
+
+VmaAllocationCreateInfo VulkanMemoryPools::getAllocationInfo(Kind kind,
+        VkMemoryRequirements const& requirements) noexcept {
+    VmaAllocationCreateInfo allocInfo { .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+    if (requirements.size > MEDIUM_SIZE) {
+        allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        return allocInfo;
+    }
+    uint32_t memoryType;
+    if (vmaFindMemoryTypeIndex(mContext.allocator, requirements.memoryTypeBits, &allocInfo,
+            &memoryType) == VK_SUCCESS) {
+        const SizeClass sizeClass = requirements.size > SMALL_SIZE ? MEDIUM : SMALL;
+        allocInfo.pool = getPool(kind, sizeClass, memoryType);
+    }
+    return allocInfo;
+}
+
+VmaPool VulkanMemoryPools::getPool(Kind kind, SizeClass sizeClass, uint32_t memoryType) noexcept {
+    VmaPool& pool = mPools[size_t(kind)][sizeClass][memoryType];
+    if (UTILS_UNLIKELY(!pool)) {
+        // Each pool holds either buffers or optimally tiled images, so the buffer-image
+        // granularity doesn't need to be respected between its allocations.
+        const VmaPoolCreateInfo poolInfo {
+            .memoryTypeIndex = memoryType,
+            .flags = VMA_POOL_CREATE_IGNORE_BUFFER_IMAGE_GRANULARITY_BIT,
+            .blockSize = sizeClass == SMALL ? SMALL_BLOCK_SIZE : MEDIUM_BLOCK_SIZE,
+        };
+        std::lock_guard<utils::Mutex> lock(mPoolLock);
+        if (vmaCreatePool(mContext.allocator, &poolInfo, &pool) != VK_SUCCESS) {
+            // Fall back to VMA's default pools.
+            pool = VK_NULL_HANDLE;
+        }
+    }
+    return pool;
+}
+
+bool VulkanMemoryPools::isFragmented() const noexcept {
+    // Defragmenting is worthwhile when it can release a block, i.e. when the unused ranges of a
+    // pool add up to more than a block.
+    for (size_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+        const VkDeviceSize blockSize = sizeClass == SMALL ? SMALL_BLOCK_SIZE : MEDIUM_BLOCK_SIZE;
+        for (VmaPool pool : mPools[size_t(Kind::GEOMETRY)][sizeClass]) {
+            if (pool) {
+                VmaPoolStats stats;
+                vmaGetPoolStats(mContext.allocator, pool, &stats);
+                if (stats.blockCount > 1 && stats.unusedSize >= blockSize) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void VulkanMemoryPools::endFrame() noexcept {
+    assert(!mContext.currentCommands);
+
+    // Continue the defragmentation once the copies of the previous pass are done.
+    if (mDefragmentation) {
+        if (mPassFence) {
+            if (vkGetFenceStatus(mContext.device, mPassFence->fence) != VK_SUCCESS) {
+                return;
+            }
+            endPass();
+        }
+        if (mDefragmentation) {
+            beginPass();
+        }
+        return;
+    }
+
+    mIdleFrameCount = mAllocationCount == mLastAllocationCount ? mIdleFrameCount + 1 : 0;
+    mLastAllocationCount = mAllocationCount;
+    if (mIdleFrameCount >= IDLE_FRAME_COUNT) {
+        mIdleFrameCount = 0;
+        if (isFragmented()) {
+            beginDefragmentation();
+            beginPass();
+        }
+    }
+}
+
+void VulkanMemoryPools::beginDefragmentation() noexcept {
+    VmaPool pools[SIZE_CLASS_COUNT * VK_MAX_MEMORY_TYPES];
+    uint32_t poolCount = 0;
+    for (auto const& sizeClass : mPools[size_t(Kind::GEOMETRY)]) {
+        for (VmaPool pool : sizeClass) {
+            if (pool) {
+                pools[poolCount++] = pool;
+            }
+        }
+    }
+
+    // The moves are copied by our own command buffers, one pass per frame. VMA computes the plan
+    // of the moves upon the first pass, and frees their sources as each pass ends.
+    const VmaDefragmentationInfo2 info {
+        .flags = VMA_DEFRAGMENTATION_FLAG_INCREMENTAL,
+        .poolCount = poolCount,
+        .pPools = pools,
+        .maxCpuBytesToMove = 0,
+        .maxCpuAllocationsToMove = 0,
+        .maxGpuBytesToMove = MAX_BYTES_TO_MOVE,
+        .maxGpuAllocationsToMove = UINT32_MAX,
+    };
+    VkResult result = vmaDefragmentationBegin(mContext.allocator, &info, nullptr,
+            &mDefragmentation);
+    if (result != VK_NOT_READY) {
+        // There was nothing to do, or it failed.
+        vmaDefragmentationEnd(mContext.allocator, mDefragmentation);
+        mDefragmentation = VK_NULL_HANDLE;
+    }
+}
+
+void VulkanMemoryPools::beginPass() noexcept {
+    VmaDefragmentationPassMoveInfo moves[MAX_MOVES_PER_PASS];
+    VmaDefragmentationPassInfo pass { .moveCount = MAX_MOVES_PER_PASS, .pMoves = moves };
+    vmaBeginDefragmentationPass(mContext.allocator, mDefragmentation, &pass);
+    if (pass.moveCount == 0) {
+        vmaEndDefragmentationPass(mContext.allocator, mDefragmentation);
+        endDefragmentation();
+        return;
+    }
+
+    VkCommandBuffer cmdbuffer = acquireWorkCommandBuffer(mContext);
+    mContext.work.barriers.flush(cmdbuffer);
+
+    // The destinations may have been read by the draws of previous frames, and the sources
+    // written by their uploads.
+    const VkMemoryBarrier before {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(cmdbuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, nullptr, 0, nullptr);
+
+    // Each buffer is copied to a new VkBuffer bound to its destination, which takes its place
+    // right away: the next frames are submitted after the copies, so they can use it.
+    for (uint32_t i = 0; i < pass.moveCount; i++) {
+        VmaDefragmentationPassMoveInfo const& move = moves[i];
+        auto iter = mRelocatables.find(move.allocation);
+        if (iter == mRelocatables.end()) {
+            // The buffer has been destroyed, its allocation is moved without content.
+            continue;
+        }
+        Relocatable const& relocatable = iter->second;
+        const VkBufferCreateInfo bufferInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = relocatable.size,
+            .usage = relocatable.usage,
+        };
+        VkBuffer buffer;
+        VkResult result = vkCreateBuffer(mContext.device, &bufferInfo, VKALLOC, &buffer);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to create a relocated buffer.");
+        vkBindBufferMemory(mContext.device, buffer, move.memory, move.offset);
+
+        const VkBufferCopy region { .size = relocatable.size };
+        vkCmdCopyBuffer(cmdbuffer, *relocatable.buffer, buffer, 1, &region);
+        mRetiredBuffers.push_back(*relocatable.buffer);
+        *relocatable.buffer = buffer;
+        mRelocatedBytes.fetch_add(relocatable.size, std::memory_order_relaxed);
+    }
+
+    const VkMemoryBarrier after {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &after,
+            0, nullptr, 0, nullptr);
+
+    mPassFence = mContext.work.fence;
+    flushWorkCommandBuffer(mContext);
+}
+
+void VulkanMemoryPools::endPass() noexcept {
+    for (VkBuffer buffer : mRetiredBuffers) {
+        vkDestroyBuffer(mContext.device, buffer, VKALLOC);
+    }
+    mRetiredBuffers.clear();
+    mPassFence.reset();
+
+    // This frees the sources of the moves, and the blocks that are now empty.
+    if (vmaEndDefragmentationPass(mContext.allocator, mDefragmentation) != VK_NOT_READY) {
+        endDefragmentation();
+    }
+}
+
+void VulkanMemoryPools::endDefragmentation() noexcept {
+    vmaDefragmentationEnd(mContext.allocator, mDefragmentation);
+    mDefragmentation = VK_NULL_HANDLE;
+    for (VmaAllocation allocation : mDeferredFrees) {
+        vmaFreeMemory(mContext.allocator, allocation);
+    }
+    mDeferredFrees.clear();
+    mLastAllocationCount = mAllocationCount;
+    mIdleFrameCount = 0;
+}
+
+GpuMemoryPoolStats VulkanMemoryPools::getStats() const noexcept {
+    GpuMemoryPoolStats result;
+    std::lock_guard<utils::Mutex> lock(mPoolLock);
+    for (auto const& kind : mPools) {
+        for (auto const& sizeClass : kind) {
+            for (VmaPool pool : sizeClass) {
+                if (pool) {
+                    VmaPoolStats stats;
+                    vmaGetPoolStats(mContext.allocator, pool, &stats);
+                    result.pooled += stats.size;
+                    result.unused += stats.unusedSize;
+                }
+            }
+        }
+    }
+    result.relocated = mRelocatedBytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+void VulkanMemoryPools::reset() noexcept {
+    if (mDefragmentation) {
+        if (mPassFence) {
+            endPass();
+        }
+        if (mDefragmentation) {
+            endDefragmentation();
+        }
+    }
+    mRelocatables.clear();
+
+    std::lock_guard<utils::Mutex> lock(mPoolLock);
+    for (auto& kind : mPools) {
+        for (auto& sizeClass : kind) {
+            for (VmaPool& pool : sizeClass) {
+                if (pool) {
+                    vmaDestroyPool(mContext.allocator, pool);
+                    pool = VK_NULL_HANDLE;
+                }
+            }
+        }
+    }
+}
+
+} // namespace filament
+} // namespace backend
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_VULKANMEMORYPOOLS_H
+#define TNT_FILAMENT_DRIVER_VULKANMEMORYPOOLS_H
+
+#include "VulkanContext.h"
+
+#include <backend/DriverEnums.h>
+
+#include <tsl/robin_map.h>
+
+#include <utils/Mutex.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace filament {
+namespace backend {
+
+// Allocates the device memory of buffers and images from VMA pools, with separate pools for each
+// kind of resource and size class. Resources that are streamed in and out therefore leave holes
+// only among resources of a similar size, which they can reuse, and the allocations larger than
+// the size classes get their own VkDeviceMemory.
+//
+// The geometry buffers (i.e. vertex and index buffers) are relocatable: when nothing has been
+// allocated or freed for a while, the fragmented geometry pools are compacted by moving a few
+// buffers per frame, until whole blocks can be released.
+class VulkanMemoryPools {
+public:
+    enum class Kind : uint8_t {
+        GEOMETRY,   // vertex and index buffers, can be relocated
+        BUFFER,     // uniform and storage buffers
+        IMAGE,      // textures and attachments
+    };
+
+    // Allocations up to SMALL_SIZE are sub-allocated from blocks of SMALL_BLOCK_SIZE, and up to
+    // MEDIUM_SIZE from blocks of MEDIUM_BLOCK_SIZE. Larger ones have dedicated allocations.
+    static constexpr VkDeviceSize SMALL_SIZE = 256 * 1024;
+    static constexpr VkDeviceSize SMALL_BLOCK_SIZE = 4 * 1024 * 1024;
+    static constexpr VkDeviceSize MEDIUM_SIZE = 4 * 1024 * 1024;
+    static constexpr VkDeviceSize MEDIUM_BLOCK_SIZE = 32 * 1024 * 1024;
+
+    // Number of consecutive frames without allocations after which the pools are defragmented.
+    static constexpr uint32_t IDLE_FRAME_COUNT = 30;
+
+    // Bounds of a defragmentation, and of the copies it records per frame.
+    static constexpr VkDeviceSize MAX_BYTES_TO_MOVE = 16 * 1024 * 1024;
+    static constexpr uint32_t MAX_MOVES_PER_PASS = 16;
+
+    explicit VulkanMemoryPools(VulkanContext& context) noexcept : mContext(context) {}
+
+    VulkanMemoryPools(VulkanMemoryPools const&) = delete;
+    VulkanMemoryPools& operator=(VulkanMemoryPools const&) = delete;
+
+    // Creates a device-local buffer and binds it to pooled memory. When a GEOMETRY buffer is
+    // relocated, *buffer is replaced with a new VkBuffer at the new location, so it must stay at
+    // the same address until destroyBuffer() and be read again by every frame that uses it.
+    VkResult createBuffer(Kind kind, VkBufferCreateInfo const& info, VkBuffer* buffer,
+            VmaAllocation* allocation) noexcept;
+    void destroyBuffer(VkBuffer buffer, VmaAllocation allocation) noexcept;
+
+    // Creates a device-local image and binds it to pooled memory. Transient attachments use
+    // lazily allocated memory when the device has it, which is never pooled.
+    VkResult createImage(VkImageCreateInfo const& info, bool transient, VkImage* image,
+            VmaAllocation* allocation) noexcept;
+    void destroyImage(VkImage image, VmaAllocation allocation) noexcept;
+
+    // Called once the commands of a frame have been submitted, i.e. when no command buffer is
+    // being recorded. This is where the defragmentation starts and progresses.
+    void endFrame() noexcept;
+
+    // Thread-safe.
+    GpuMemoryPoolStats getStats() const noexcept;
+
+    // Ends the defragmentation and destroys the pools. The GPU must be idle and all the resources
+    // destroyed.
+    void reset() noexcept;
+
+private:
+    enum SizeClass : uint8_t {
+        SMALL,
+        MEDIUM,
+        SIZE_CLASS_COUNT
+    };
+    static constexpr size_t KIND_COUNT = 3;
+
+    // A relocatable buffer, i.e. where its handle lives and how to create it again.
+    struct Relocatable {
+        VkBuffer* buffer;
+        VkDeviceSize size;
+        VkBufferUsageFlags usage;
+    };
+
+    VmaAllocationCreateInfo getAllocationInfo(Kind kind,
+            VkMemoryRequirements const& requirements) noexcept;
+    VmaPool getPool(Kind kind, SizeClass sizeClass, uint32_t memoryType) noexcept;
+
+    bool isFragmented() const noexcept;
+    void beginDefragmentation() noexcept;
+    void beginPass() noexcept;
+    void endPass() noexcept;
+    void endDefragmentation() noexcept;
+
+    VulkanContext& mContext;
+
+    // The pools are created lazily for each memory type, and read by getStats() from any thread.
+    mutable utils::Mutex mPoolLock;
+    VmaPool mPools[KIND_COUNT][SIZE_CLASS_COUNT][VK_MAX_MEMORY_TYPES] = {};
+
+    tsl::robin_map<VmaAllocation, Relocatable> mRelocatables;
+
+    // Counts the allocations and frees, to find out whether a frame made any.
+    uint64_t mAllocationCount = 0;
+    uint64_t mLastAllocationCount = 0;
+    uint32_t mIdleFrameCount = 0;
+
+    // The defragmentation in progress, and the fence of the copies of its current pass. The
+    // buffers that were moved by the pass are destroyed once the fence is signaled, and the
+    // allocations freed during the defragmentation are only freed after it ends, since they may
+    // still be part of its plan.
+    VmaDefragmentationContext mDefragmentation = VK_NULL_HANDLE;
+    std::shared_ptr<VulkanCmdFence> mPassFence;
+    std::vector<VkBuffer> mRetiredBuffers;
+    std::vector<VmaAllocation> mDeferredFrees;
+
+    std::atomic<uint64_t> mRelocatedBytes = { 0 };
+};
+
+} // namespace filament
+} // namespace backend
+
+#endif // TNT_FILAMENT_DRIVER_VULKANMEMORYPOOLS_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan/VulkanShaderCache.h"
+
+#include <utils/Hash.h>
+#include <utils/Panic.h>
+
+using namespace bluevk;
+
+namespace filament {
+namespace backend {
+
+VulkanShaderCache::VulkanShaderCache(VulkanContext& context) : mContext(context) {}
+
+VkShaderModule VulkanShaderCache::acquire(const uint32_t* code, size_t size) {
+    // SPIR-V is made of 32-bit words, two seeds give a 64-bit hash which also covers the size.
+    const size_t wordCount = size / 4;
+    const uint64_t key = (uint64_t(utils::hash::murmur3(code, wordCount, 0)) << 32u) |
+            utils::hash::murmur3(code, wordCount, uint32_t(wordCount));
+
+    auto iter = mModules.find(key);
+    if (iter != mModules.end()) {
+        mEntries[iter->second].refCount++;
+        return iter->second;
+    }
+
+    const VkShaderModuleCreateInfo moduleInfo {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = size,
+        .pCode = code,
+    };
+    VkShaderModule module;
+    VkResult result = vkCreateShaderModule(mContext.device, &moduleInfo, VKALLOC, &module);
+    ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to create shader module.");
+    mModules[key] = module;
+    mEntries[module] = { key, 1 };
+    return module;
+}
+
+void VulkanShaderCache::release(VkShaderModule module) noexcept {
+    auto iter = mEntries.find(module);
+    if (iter == mEntries.end()) {
+        return;
+    }
+    if (--iter.value().refCount == 0) {
+        mModules.erase(iter->second.key);
+        mEntries.erase(iter);
+        vkDestroyShaderModule(mContext.device, module, VKALLOC);
+    }
+}
+
+void VulkanShaderCache::reset() noexcept {
+    for (auto pair : mEntries) {
+        vkDestroyShaderModule(mContext.device, pair.first, VKALLOC);
+    }
+    mEntries.clear();
+    mModules.clear();
+}
+
+} // namespace filament
+} // namespace backend
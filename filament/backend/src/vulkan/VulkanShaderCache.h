@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_VULKANSHADERCACHE_H
+#define TNT_FILAMENT_DRIVER_VULKANSHADERCACHE_H
+
+#include "VulkanContext.h"
+
+#include <tsl/robin_map.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace backend {
+
+// Shares the VkShaderModule objects between the programs whose shaders have the same SPIR-V, e.g.
+// the depth variants of materials that only differ by their fragment shader. The modules are
+// reference counted and looked up by a 64-bit hash of their code. Since the pipelines are keyed
+// by their shader modules, the programs that share their modules also share their pipelines.
+class VulkanShaderCache {
+public:
+    explicit VulkanShaderCache(VulkanContext&);
+
+    // Returns the module with the given SPIR-V, creating it if it doesn't exist yet.
+    VkShaderModule acquire(const uint32_t* code, size_t size);
+
+    // Drops a reference to the given module, which is destroyed once it is no longer used.
+    void release(VkShaderModule module) noexcept;
+
+    // Destroys all the modules, which must no longer be used.
+    void reset() noexcept;
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t refCount;
+    };
+    VulkanContext& mContext;
+    tsl::robin_map<uint64_t, VkShaderModule> mModules;
+    tsl::robin_map<VkShaderModule, Entry> mEntries;
+};
+
+} // namespace filament
+} // namespace backend
+
+#endif // TNT_FILAMENT_DRIVER_VULKANSHADERCACHE_H
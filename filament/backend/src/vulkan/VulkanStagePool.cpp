@@ -16,8 +16,11 @@
 
 #include "vulkan/VulkanStagePool.h"
 
+#include <utils/compiler.h>
 #include <utils/Panic.h>
 
+#include <string.h>
+
 namespace filament {
 namespace backend {
 
@@ -31,12 +34,9 @@ VulkanStage const* VulkanStagePool::acquireStage(uint32_t numBytes) {
         return stage;
     }
     // We were not able to find a sufficiently large stage, so create a new one.
-    VulkanStage* stage = new VulkanStage({
-        .memory = VK_NULL_HANDLE,
-        .buffer = VK_NULL_HANDLE,
-        .capacity = numBytes,
-        .lastAccessed = mCurrentFrame,
-    });
+    VulkanStage* stage = new VulkanStage();
+    stage->capacity = numBytes;
+    stage->lastAccessed = mCurrentFrame;
 
     // Create the VkBuffer.
     mUsedStages.insert(stage);
@@ -45,6 +45,15 @@ VulkanStage const* VulkanStagePool::acquireStage(uint32_t numBytes) {
         .size = numBytes,
         .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
     };
+    // Stages can be used by both the graphics and the transfer queues.
+    const uint32_t queueFamilies[] = {
+        mContext.graphicsQueueFamilyIndex, mContext.transferQueueFamilyIndex
+    };
+    if (mContext.transferQueue) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilies;
+    }
     VmaAllocationCreateInfo allocInfo {
         .usage = VMA_MEMORY_USAGE_CPU_ONLY
     };
@@ -68,9 +77,103 @@ void VulkanStagePool::releaseStage(VulkanStage const* stage) noexcept {
 void VulkanStagePool::releaseStage(VulkanStage const* stage, VulkanCommandBuffer& cmd) noexcept {
     // Replace the previous owner of the stage with the given command buffer.  When the command
     // buffer finishes execution, the stage will finally be released back into the pool.
-    mDisposer.createDisposable(stage, [stage, this]() { this->releaseStage(stage); });
-    mDisposer.acquire(stage, cmd.resources);
-    mDisposer.removeReference(stage);
+    // Stages are immutable for their users, only their disposer bookkeeping changes here.
+    VulkanStage* mutableStage = const_cast<VulkanStage*>(stage);
+    mDisposer.createDisposable(mutableStage, [](VulkanDisposable* disposable, void* user, uint32_t) {
+        static_cast<VulkanStagePool*>(user)->releaseStage(static_cast<VulkanStage*>(disposable));
+    }, this);
+    mDisposer.acquire(mutableStage, cmd.resources);
+    mDisposer.removeReference(mutableStage);
+}
+
+VulkanStagingRegion VulkanStagePool::upload(const void* data, uint32_t numBytes,
+        VulkanCommandBuffer& cmd) {
+    uint32_t offset;
+    if (allocateFromRing(numBytes, cmd, &offset)) {
+        memcpy(mRingData + offset, data, numBytes);
+        vmaFlushAllocation(mContext.allocator, mRingMemory, offset, numBytes);
+        return { mRingBuffer, offset };
+    }
+
+    VulkanStage const* stage = acquireStage(numBytes);
+    void* mapped;
+    vmaMapMemory(mContext.allocator, stage->memory, &mapped);
+    memcpy(mapped, data, numBytes);
+    vmaUnmapMemory(mContext.allocator, stage->memory);
+    vmaFlushAllocation(mContext.allocator, stage->memory, 0, numBytes);
+    releaseStage(stage, cmd);
+    return { stage->buffer, 0 };
+}
+
+bool VulkanStagePool::allocateFromRing(uint32_t numBytes, VulkanCommandBuffer& cmd,
+        uint32_t* offset) {
+    if (numBytes > RING_MAX_UPLOAD_SIZE) {
+        return false;
+    }
+
+    if (UTILS_UNLIKELY(!mRingBuffer)) {
+        VkBufferCreateInfo bufferInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = RING_SIZE,
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        };
+        VmaAllocationCreateInfo allocInfo {
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_CPU_ONLY
+        };
+        VmaAllocationInfo info;
+        vmaCreateBuffer(mContext.allocator, &bufferInfo, &allocInfo, &mRingBuffer, &mRingMemory,
+                &info);
+        mRingData = static_cast<uint8_t*>(info.pMappedData);
+    }
+
+    retireRingBlocks();
+
+    // allocations never straddle the end of the ring, the space we skip belongs to this block
+    const uint32_t size = (numBytes + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+    uint32_t start = mRingHead;
+    uint32_t skipped = 0;
+    if (start + size > RING_SIZE) {
+        skipped = RING_SIZE - start;
+        start = 0;
+    }
+    if (mRingUsed + skipped + size > RING_SIZE) {
+        // the ring is full, the GPU is still using all of it
+        return false;
+    }
+    mRingUsed += skipped + size;
+    mRingHead = (start + size) % RING_SIZE;
+    *offset = start;
+
+    // The last block can grow as long as it's still referenced by this command buffer, i.e.
+    // until the command buffer has been released.
+    RingBlock* block = mRingBlocks.empty() ? nullptr : mRingBlocks.back();
+    if (block && mDisposer.isAcquired(block, cmd.resources)) {
+        block->size += skipped + size;
+    } else {
+        block = new RingBlock();
+        block->size = skipped + size;
+        mRingBlocks.push_back(block);
+        mDisposer.createDisposable(block, [](VulkanDisposable* disposable, void*, uint32_t) {
+            static_cast<RingBlock*>(disposable)->retired = true;
+        }, nullptr);
+        mDisposer.acquire(block, cmd.resources);
+        mDisposer.removeReference(block);
+    }
+    return true;
+}
+
+void VulkanStagePool::retireRingBlocks() noexcept {
+    while (!mRingBlocks.empty() && mRingBlocks.front()->retired) {
+        RingBlock* block = mRingBlocks.front();
+        mRingBlocks.pop_front();
+        mRingUsed -= block->size;
+        delete block;
+    }
+    if (mRingBlocks.empty()) {
+        // nothing is in flight, restart from the beginning to avoid skipping space
+        mRingHead = 0;
+    }
 }
 
 void VulkanStagePool::gc() noexcept {
@@ -99,6 +202,19 @@ void VulkanStagePool::reset() noexcept {
         delete pair.second;
     }
     mFreeStages.clear();
+
+    retireRingBlocks();
+    assert(mRingBlocks.empty());
+    for (RingBlock* block : mRingBlocks) {
+        delete block;
+    }
+    mRingBlocks.clear();
+    if (mRingBuffer) {
+        vmaDestroyBuffer(mContext.allocator, mRingBuffer, mRingMemory);
+        mRingBuffer = VK_NULL_HANDLE;
+        mRingMemory = VK_NULL_HANDLE;
+        mRingData = nullptr;
+    }
 }
 
 } // namespace filament
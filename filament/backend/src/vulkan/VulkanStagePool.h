@@ -21,6 +21,7 @@
 
 #include "VulkanDisposer.h"
 
+#include <deque>
 #include <map>
 #include <unordered_set>
 
@@ -28,14 +29,24 @@ namespace filament {
 namespace backend {
 
 // Immutable POD representing a shared CPU-GPU staging area.
-struct VulkanStage {
-    VmaAllocation memory;
+struct VulkanStage : public VulkanDisposable {
+    VmaAllocation memory = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    uint32_t capacity = 0;
+    mutable uint64_t lastAccessed = 0;
+};
+
+// Source of an upload, i.e. a range of a CPU-writable VkBuffer holding a copy of the data.
+struct VulkanStagingRegion {
     VkBuffer buffer;
-    uint32_t capacity;
-    mutable uint64_t lastAccessed;
+    VkDeviceSize offset;
 };
 
 // Manages a pool of stages, periodically releasing stages that have been unused for a while.
+//
+// Small uploads are sub-allocated from a persistently mapped ring buffer instead. Space in the
+// ring is retired by the VulkanDisposer, i.e when the command buffers that reference it have
+// finished executing.
 class VulkanStagePool {
 public:
     explicit VulkanStagePool(VulkanContext& context, VulkanDisposer& disposer) noexcept :
@@ -48,6 +59,10 @@ public:
     void releaseStage(VulkanStage const* stage) noexcept;
     void releaseStage(VulkanStage const* stage, VulkanCommandBuffer& cmd) noexcept;
 
+    // Copies the given data into a staging area that stays alive until the given command buffer
+    // has finished executing. This uses the ring buffer if possible, or a stage otherwise.
+    VulkanStagingRegion upload(const void* data, uint32_t numBytes, VulkanCommandBuffer& cmd);
+
     // Evicts old unused stages and bumps the current frame number.
     void gc() noexcept;
 
@@ -66,6 +81,30 @@ private:
     // In theory this need not exist, but is useful for validation and ensuring no leaks.
     std::unordered_set<VulkanStage const*> mUsedStages;
 
+    // A range of the ring buffer in use by one command buffer.
+    struct RingBlock : public VulkanDisposable {
+        uint32_t size = 0;
+        bool retired = false;
+    };
+
+    bool allocateFromRing(uint32_t numBytes, VulkanCommandBuffer& cmd, uint32_t* offset);
+    void retireRingBlocks() noexcept;
+
+    VmaAllocation mRingMemory = VK_NULL_HANDLE;
+    VkBuffer mRingBuffer = VK_NULL_HANDLE;
+    uint8_t* mRingData = nullptr;
+    uint32_t mRingHead = 0;
+    uint32_t mRingUsed = 0;
+
+    // Blocks in allocation order, only the oldest ones can be reclaimed. The last one keeps
+    // growing while it is owned by the same command buffer.
+    std::deque<RingBlock*> mRingBlocks;
+
+    static constexpr uint32_t RING_SIZE = 4u * 1024u * 1024u;
+    static constexpr uint32_t RING_ALIGNMENT = 256;
+    // larger uploads use a stage
+    static constexpr uint32_t RING_MAX_UPLOAD_SIZE = RING_SIZE / 4;
+
     // Store the current "time" (really just a frame count) and LRU eviction parameters.
     uint64_t mCurrentFrame = 0;
     static constexpr uint32_t TIME_BEFORE_EVICTION = 3;
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filament/Engine.h>
+
+#include "details/Engine.h"
+#include "MaterialParser.h"
+
+#include "generated/resources/materials.h"
+
+#include <private/backend/CircularBuffer.h>
+#include <private/backend/CommandStream.h>
+#include <private/filament/EngineEnums.h>
+#include <private/filament/SamplerInterfaceBlock.h>
+#include <private/filament/UibGenerator.h>
+#include <private/filament/UniformInterfaceBlock.h>
+
+#include <filaflat/ShaderBuilder.h>
+
+#include <utils/algorithm.h>
+#include <utils/CString.h>
+#include <utils/memalign.h>
+
+using namespace filament;
+using namespace filament::backend;
+using namespace utils;
+
+// ------------------------------------------------------------------------------------------------
+// CommandStream
+// ------------------------------------------------------------------------------------------------
+
+/*
+ * Encodes and decodes the commands of state.range(0) draws, as RenderPass::executeCommands()
+ * does, into a buffer of their own. The commands are executed by the noop driver.
+ */
+class CommandStreamFixture : public benchmark::Fixture {
+public:
+    // a new material instance every few draws
+    static constexpr size_t DRAWS_PER_MATERIAL_INSTANCE = 16;
+
+    static constexpr size_t DRAW_SIZE =
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBufferRange))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(draw)));
+
+    static constexpr size_t MATERIAL_INSTANCE_SIZE =
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(bindSamplers)));
+
+    Engine* engine = nullptr;
+    void* storage = nullptr;
+    size_t size = 0;
+
+    void SetUp(const benchmark::State& state) override {
+        const size_t count = size_t(state.range(0));
+        engine = Engine::create(Engine::Backend::NOOP);
+        size = count * DRAW_SIZE +
+                (count / DRAWS_PER_MATERIAL_INSTANCE + 1) * MATERIAL_INSTANCE_SIZE +
+                CommandBase::align(sizeof(NoopCommand));
+        storage = utils::aligned_alloc(size, CACHELINE_SIZE);
+    }
+
+    void TearDown(const benchmark::State&) override {
+        utils::aligned_free(storage);
+        Engine::destroy(&engine);
+    }
+
+    // records the commands in 'buffer', which are terminated like the engine's command buffers
+    static void encode(CommandStream& stream, CircularBuffer& buffer, size_t count) noexcept {
+        const PipelineState pipeline;
+        const Handle<HwUniformBuffer> ubh;
+        const Handle<HwSamplerGroup> sgh;
+        const Handle<HwRenderPrimitive> rph;
+        for (size_t i = 0; i < count; i++) {
+            if (i % DRAWS_PER_MATERIAL_INSTANCE == 0) {
+                stream.bindUniformBuffer(BindingPoints::PER_MATERIAL_INSTANCE, ubh);
+                stream.bindSamplers(BindingPoints::PER_MATERIAL_INSTANCE, sgh);
+            }
+            stream.bindUniformBufferRange(BindingPoints::PER_RENDERABLE, ubh,
+                    i * sizeof(PerRenderableUib), sizeof(PerRenderableUib));
+            stream.draw(pipeline, rph, 1);
+        }
+        new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+    }
+};
+
+BENCHMARK_DEFINE_F(CommandStreamFixture, encode)(benchmark::State& state) {
+    FEngine& e = *upcast(engine);
+    const size_t count = size_t(state.range(0));
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            CircularBuffer buffer(storage, size);
+            CommandStream stream(e.getDriverApi(), buffer);
+            encode(stream, buffer, count);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetBytesProcessed(state.iterations() * size);
+    }
+}
+
+BENCHMARK_DEFINE_F(CommandStreamFixture, decode)(benchmark::State& state) {
+    FEngine& e = *upcast(engine);
+    const size_t count = size_t(state.range(0));
+    CircularBuffer buffer(storage, size);
+    CommandStream stream(e.getDriverApi(), buffer);
+    encode(stream, buffer, count);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            // the commands only hold trivially destructible parameters, so they can be
+            // executed again from the same memory
+            stream.execute(buffer.getTail());
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+        state.SetBytesProcessed(state.iterations() * size);
+    }
+}
+
+BENCHMARK_REGISTER_F(CommandStreamFixture, encode)->Range(256, 16384);
+BENCHMARK_REGISTER_F(CommandStreamFixture, decode)->Range(256, 16384);
+
+// ------------------------------------------------------------------------------------------------
+// MaterialParser
+// ------------------------------------------------------------------------------------------------
+
+// what FMaterial reads from the package when the material is built
+static void materialParse(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            MaterialParser parser(Backend::OPENGL,
+                    MATERIALS_DEFAULTMATERIAL_DATA, MATERIALS_DEFAULTMATERIAL_SIZE);
+            if (parser.parse() != MaterialParser::ParseResult::SUCCESS) {
+                state.SkipWithError("could not parse the material package");
+                break;
+            }
+            CString name;
+            UniformInterfaceBlock uib;
+            SamplerInterfaceBlock sib;
+            parser.getName(&name);
+            parser.getUIB(&uib);
+            parser.getSIB(&sib);
+            benchmark::DoNotOptimize(name);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * MATERIALS_DEFAULTMATERIAL_SIZE);
+    }
+}
+
+// what FMaterial does to create a program
+static void materialGetShader(benchmark::State& state) {
+    MaterialParser parser(Backend::OPENGL,
+            MATERIALS_DEFAULTMATERIAL_DATA, MATERIALS_DEFAULTMATERIAL_SIZE);
+    uint32_t shaderModels = 0;
+    if (parser.parse() != MaterialParser::ParseResult::SUCCESS ||
+            !parser.getShaderModels(&shaderModels) || !shaderModels) {
+        state.SkipWithError("could not parse the material package");
+        return;
+    }
+    // use any of the shader models the material was built for
+    const ShaderModel shaderModel = ShaderModel(utils::ctz(shaderModels));
+
+    filaflat::ShaderBuilder vs;
+    filaflat::ShaderBuilder fs;
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            parser.getShader(vs, shaderModel, 0, ShaderType::VERTEX);
+            parser.getShader(fs, shaderModel, 0, ShaderType::FRAGMENT);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * 2);
+    }
+}
+
+BENCHMARK(materialParse);
+BENCHMARK(materialGetShader);
@@ -34,7 +34,7 @@ using namespace utils;
 
 
 class FilamentFixture : public benchmark::Fixture {
-protected:
+public:
     static constexpr size_t BATCH_SIZE = 512;
 
     Frustum frustum{};
@@ -43,8 +43,6 @@ protected:
     std::vector<float4> spheres;
     Culler::result_type* UTILS_RESTRICT visibles = nullptr;
 
-
-public:
     FilamentFixture() {
 
         std::default_random_engine gen; // NOLINT
@@ -103,3 +101,74 @@ BENCHMARK_F(FilamentFixture, sphereCulling)(benchmark::State& state) {
         state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
     }
 }
+
+// compare the culling kernels, the benchmarks above use the one selected at runtime
+
+static void boxCullingKernel(FilamentFixture& fixture, benchmark::State& state,
+        Culler::Kernel kernel) {
+    if (!Culler::Test::isSupported(kernel)) {
+        state.SkipWithError("kernel not supported on this CPU");
+        return;
+    }
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            Culler::Test::intersects(kernel, fixture.visibles, fixture.frustum,
+                    fixture.boxesCenter.data(), fixture.boxesExtent.data(),
+                    FilamentFixture::BATCH_SIZE);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * FilamentFixture::BATCH_SIZE);
+    }
+}
+
+static void sphereCullingKernel(FilamentFixture& fixture, benchmark::State& state,
+        Culler::Kernel kernel) {
+    if (!Culler::Test::isSupported(kernel)) {
+        state.SkipWithError("kernel not supported on this CPU");
+        return;
+    }
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            Culler::Test::intersects(kernel, fixture.visibles, fixture.frustum,
+                    fixture.spheres.data(), FilamentFixture::BATCH_SIZE);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * FilamentFixture::BATCH_SIZE);
+    }
+}
+
+BENCHMARK_F(FilamentFixture, boxCullingScalar)(benchmark::State& state) {
+    boxCullingKernel(*this, state, Culler::Kernel::SCALAR);
+}
+
+BENCHMARK_F(FilamentFixture, boxCullingSSE)(benchmark::State& state) {
+    boxCullingKernel(*this, state, Culler::Kernel::SSE);
+}
+
+BENCHMARK_F(FilamentFixture, boxCullingAVX2)(benchmark::State& state) {
+    boxCullingKernel(*this, state, Culler::Kernel::AVX2);
+}
+
+BENCHMARK_F(FilamentFixture, boxCullingNEON)(benchmark::State& state) {
+    boxCullingKernel(*this, state, Culler::Kernel::NEON);
+}
+
+BENCHMARK_F(FilamentFixture, sphereCullingScalar)(benchmark::State& state) {
+    sphereCullingKernel(*this, state, Culler::Kernel::SCALAR);
+}
+
+BENCHMARK_F(FilamentFixture, sphereCullingSSE)(benchmark::State& state) {
+    sphereCullingKernel(*this, state, Culler::Kernel::SSE);
+}
+
+BENCHMARK_F(FilamentFixture, sphereCullingAVX2)(benchmark::State& state) {
+    sphereCullingKernel(*this, state, Culler::Kernel::AVX2);
+}
+
+BENCHMARK_F(FilamentFixture, sphereCullingNEON)(benchmark::State& state) {
+    sphereCullingKernel(*this, state, Culler::Kernel::NEON);
+}
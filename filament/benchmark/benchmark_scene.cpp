@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filament/Camera.h>
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/LightManager.h>
+#include <filament/Material.h>
+#include <filament/RenderableManager.h>
+#include <filament/Renderer.h>
+#include <filament/Scene.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+
+#include "details/Allocators.h"
+#include "details/Camera.h"
+#include "details/Engine.h"
+#include "details/Froxelizer.h"
+#include "details/Scene.h"
+#include "details/ShadowMap.h"
+#include "details/View.h"
+#include "RenderPass.h"
+
+#include <utils/EntityManager.h>
+#include <utils/memalign.h>
+
+#include <random>
+#include <vector>
+
+using namespace filament;
+using namespace filament::math;
+using namespace utils;
+
+/*
+ * These benchmarks run the per-frame CPU work of the engine on a synthetic scene, made of
+ * state.range(0) renderables and state.range(1) point lights, plus a directional light casting
+ * shadows. The scene is rendered once with the noop backend, the benchmarks then run a single
+ * step of the frame on the state it left.
+ */
+class SceneFixture : public benchmark::Fixture {
+public:
+    static constexpr uint32_t WIDTH = 1280;
+    static constexpr uint32_t HEIGHT = 720;
+
+    Engine* engine = nullptr;
+    SwapChain* swapChain = nullptr;
+    Renderer* renderer = nullptr;
+    View* view = nullptr;
+    Scene* scene = nullptr;
+    Camera* camera = nullptr;
+    VertexBuffer* vertexBuffer = nullptr;
+    IndexBuffer* indexBuffer = nullptr;
+    Entity cameraEntity;
+    Entity root;
+    Entity sun;
+    std::vector<Entity> renderables;
+    std::vector<Entity> lights;
+
+    void SetUp(const benchmark::State& state) override {
+        static const float3 vertices[3] = {{ -0.5f, -0.5f, 0.0f }, { 0.5f, -0.5f, 0.0f },
+                                           {  0.0f,  0.5f, 0.0f }};
+        static const uint16_t indices[3] = { 0, 1, 2 };
+
+        engine = Engine::create(Engine::Backend::NOOP);
+        swapChain = engine->createSwapChain(WIDTH, HEIGHT);
+        renderer = engine->createRenderer();
+        scene = engine->createScene();
+        view = engine->createView();
+        cameraEntity = EntityManager::get().create();
+        camera = engine->createCamera(cameraEntity);
+        camera->setProjection(45.0, double(WIDTH) / HEIGHT, 0.1, 100.0);
+        view->setViewport({ 0, 0, WIDTH, HEIGHT });
+        view->setScene(scene);
+        view->setCamera(camera);
+        view->setPostProcessingEnabled(false);
+
+        vertexBuffer = VertexBuffer::Builder()
+                .vertexCount(3)
+                .bufferCount(1)
+                .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+                .build(*engine);
+        vertexBuffer->setBufferAt(*engine, 0, { vertices, sizeof(vertices) });
+        indexBuffer = IndexBuffer::Builder()
+                .indexCount(3)
+                .bufferType(IndexBuffer::IndexType::USHORT)
+                .build(*engine);
+        indexBuffer->setBuffer(*engine, { indices, sizeof(indices) });
+
+        // the renderables are children of 'root', so moving it updates the whole scene
+        auto& tcm = engine->getTransformManager();
+        root = EntityManager::get().create();
+        tcm.create(root);
+        auto const rootInstance = tcm.getInstance(root);
+
+        // the renderables and lights are randomly spread in the camera's frustum, the
+        // sequence is the same for every run
+        std::default_random_engine gen; // NOLINT
+        std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+        auto randomPosition = [&]() {
+            const float z = 2.0f + 48.0f * (rand(gen) * 0.5f + 0.5f);
+            return float3{ rand(gen) * z * 0.7f, rand(gen) * z * 0.4f, -z };
+        };
+
+        MaterialInstance const* const mi = engine->getDefaultMaterial()->getDefaultInstance();
+        renderables.resize(size_t(state.range(0)));
+        EntityManager::get().create(renderables.size(), renderables.data());
+        for (Entity e : renderables) {
+            RenderableManager::Builder(1)
+                    .boundingBox({{ -0.5f, -0.5f, -0.1f }, { 0.5f, 0.5f, 0.1f }})
+                    .geometry(0, RenderableManager::PrimitiveType::TRIANGLES,
+                            vertexBuffer, indexBuffer)
+                    .material(0, mi)
+                    .castShadows(true)
+                    .receiveShadows(true)
+                    .build(*engine, e);
+            tcm.create(e, rootInstance, mat4f::translation(randomPosition()));
+            scene->addEntity(e);
+        }
+
+        lights.resize(size_t(state.range(1)));
+        EntityManager::get().create(lights.size(), lights.data());
+        for (Entity e : lights) {
+            LightManager::Builder(LightManager::Type::POINT)
+                    .position(randomPosition())
+                    .falloff(2.0f + 8.0f * (rand(gen) * 0.5f + 0.5f))
+                    .intensity(10000.0f)
+                    .build(*engine, e);
+            scene->addEntity(e);
+        }
+
+        sun = EntityManager::get().create();
+        LightManager::Builder(LightManager::Type::DIRECTIONAL)
+                .direction({ 0.2f, -1.0f, -0.4f })
+                .castShadows(true)
+                .build(*engine, sun);
+        scene->addEntity(sun);
+
+        if (renderer->beginFrame(swapChain)) {
+            renderer->render(view);
+            renderer->endFrame();
+        }
+        engine->flushAndWait();
+    }
+
+    void TearDown(const benchmark::State&) override {
+        for (Entity e : renderables) {
+            engine->destroy(e);
+        }
+        for (Entity e : lights) {
+            engine->destroy(e);
+        }
+        engine->destroy(sun);
+        engine->destroy(root);
+        engine->destroy(vertexBuffer);
+        engine->destroy(indexBuffer);
+        engine->destroyCameraComponent(cameraEntity);
+        engine->destroy(view);
+        engine->destroy(scene);
+        engine->destroy(renderer);
+        engine->destroy(swapChain);
+        EntityManager::get().destroy(renderables.size(), renderables.data());
+        EntityManager::get().destroy(lights.size(), lights.data());
+        EntityManager::get().destroy(sun);
+        EntityManager::get().destroy(root);
+        EntityManager::get().destroy(cameraEntity);
+        Engine::destroy(&engine);
+        renderables.clear();
+        lights.clear();
+    }
+
+    bool checkScene(benchmark::State& state) const {
+        if (upcast(view)->getVisibleRenderables().empty()) {
+            state.SkipWithError("the scene wasn't rendered");
+            return false;
+        }
+        return true;
+    }
+};
+
+static void sceneArguments(benchmark::internal::Benchmark* b) {
+    b->Ranges({{ 256, 4096 }, { 16, int64_t(CONFIG_MAX_LIGHT_COUNT) }})
+            ->ArgNames({ "renderables", "lights" })
+            ->Unit(benchmark::kMicrosecond);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+BENCHMARK_DEFINE_F(SceneFixture, scenePrepare)(benchmark::State& state) {
+    if (!checkScene(state)) {
+        return;
+    }
+    FScene& s = *upcast(scene);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            s.prepare(mat4f{});
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * renderables.size());
+    }
+}
+
+// the world origin changes every frame, so none of the renderables' data can be reused
+BENCHMARK_DEFINE_F(SceneFixture, scenePrepareWorldOriginChanged)(benchmark::State& state) {
+    if (!checkScene(state)) {
+        return;
+    }
+    FScene& s = *upcast(scene);
+    const mat4f origins[2] = { mat4f{}, mat4f::translation(float3{ 0.0f, 0.0f, 0.01f }) };
+    size_t frame = 0;
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            s.prepare(origins[frame++ & 1u]);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * renderables.size());
+    }
+}
+
+BENCHMARK_DEFINE_F(SceneFixture, sceneCulling)(benchmark::State& state) {
+    if (!checkScene(state)) {
+        return;
+    }
+    FEngine& e = *upcast(engine);
+    FScene& s = *upcast(scene);
+    const Frustum frustum = upcast(camera)->getFrustum();
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            FView::cullRenderables(e.getJobSystem(), s, s.getRenderableData(), frustum,
+                    VISIBLE_RENDERABLE_BIT);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * renderables.size());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+BENCHMARK_DEFINE_F(SceneFixture, transformTransaction)(benchmark::State& state) {
+    auto& tcm = engine->getTransformManager();
+    std::vector<TransformManager::Instance> instances(renderables.size());
+    std::vector<mat4f> transforms(renderables.size());
+    for (size_t i = 0, c = renderables.size(); i < c; i++) {
+        instances[i] = tcm.getInstance(renderables[i]);
+        transforms[i] = tcm.getTransform(instances[i]);
+    }
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            tcm.openLocalTransformTransaction();
+            for (size_t i = 0, c = instances.size(); i < c; i++) {
+                tcm.setTransform(instances[i], transforms[i]);
+            }
+            tcm.commitLocalTransformTransaction();
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * renderables.size());
+    }
+}
+
+// moving the root updates the world transform of all the renderables
+BENCHMARK_DEFINE_F(SceneFixture, transformHierarchy)(benchmark::State& state) {
+    auto& tcm = engine->getTransformManager();
+    auto const rootInstance = tcm.getInstance(root);
+    const mat4f transforms[2] = { mat4f{}, mat4f::translation(float3{ 0.0f, 0.01f, 0.0f }) };
+    size_t frame = 0;
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            tcm.setTransform(rootInstance, transforms[frame++ & 1u]);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * renderables.size());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+BENCHMARK_DEFINE_F(SceneFixture, renderPassColor)(benchmark::State& state) {
+    if (!checkScene(state)) {
+        return;
+    }
+    FEngine& e = *upcast(engine);
+    FView& v = *upcast(view);
+    FScene& s = *upcast(scene);
+
+    using Command = RenderPass::Command;
+    const size_t commandsCount = FEngine::CONFIG_PER_FRAME_COMMANDS_SIZE / sizeof(Command);
+    Command* const commands = static_cast<Command*>(
+            utils::aligned_alloc(commandsCount * sizeof(Command), CACHELINE_SIZE));
+
+    RenderPass pass(e, GrowingSlice<Command>(commands, commandsCount));
+    RenderPass::RenderFlags renderFlags = 0;
+    if (v.hasShadowing())          renderFlags |= RenderPass::HAS_SHADOWING;
+    if (v.hasDirectionalLight())   renderFlags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
+    if (v.hasDynamicLighting())    renderFlags |= RenderPass::HAS_DYNAMIC_LIGHTING;
+    pass.setRenderFlags(renderFlags);
+    pass.setCamera(v.getCameraInfo());
+    pass.setGeometry(s.getRenderableData(), v.getVisibleRenderables(), s.getRenderableUBO());
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            pass.getCommands() = GrowingSlice<Command>(commands, commandsCount);
+            pass.appendCommands(RenderPass::COLOR);
+            pass.sortCommands();
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * v.getVisibleRenderables().size());
+    }
+
+    utils::aligned_free(commands);
+}
+
+BENCHMARK_DEFINE_F(SceneFixture, renderPassDepth)(benchmark::State& state) {
+    if (!checkScene(state)) {
+        return;
+    }
+    FEngine& e = *upcast(engine);
+    FView& v = *upcast(view);
+    FScene& s = *upcast(scene);
+
+    using Command = RenderPass::Command;
+    const size_t commandsCount = FEngine::CONFIG_PER_FRAME_COMMANDS_SIZE / sizeof(Command);
+    Command* const commands = static_cast<Command*>(
+            utils::aligned_alloc(commandsCount * sizeof(Command), CACHELINE_SIZE));
+
+    RenderPass pass(e, GrowingSlice<Command>(commands, commandsCount));
+    pass.setCamera(v.getCameraInfo());
+    pass.setGeometry(s.getRenderableData(), v.getVisibleRenderables(), s.getRenderableUBO());
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            pass.getCommands() = GrowingSlice<Command>(commands, commandsCount);
+            pass.appendCommands(RenderPass::DEPTH);
+            pass.sortCommands();
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * v.getVisibleRenderables().size());
+    }
+
+    utils::aligned_free(commands);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static void froxelizeLights(SceneFixture& fixture, benchmark::State& state, bool moving) {
+    if (!fixture.checkScene(state)) {
+        return;
+    }
+    FEngine& e = *upcast(fixture.engine);
+    FView& v = *upcast(fixture.view);
+    FScene::LightSoa const& lightData = upcast(fixture.scene)->getLightData();
+    auto& driver = e.getDriverApi();
+
+    // the camera moves a little every frame so that all the lights need froxelizing again
+    CameraInfo cameras[2] = { v.getCameraInfo(), v.getCameraInfo() };
+    cameras[1].view = cameras[1].view * mat4f::translation(float3{ 0.0f, 0.0f, 0.01f });
+
+    LinearAllocatorArena arena("benchmark: froxelizer", FEngine::CONFIG_PER_RENDER_PASS_ARENA_SIZE);
+    Froxelizer froxelizer(e);
+    size_t frame = 0;
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            filament::ArenaScope scope(arena);
+            CameraInfo const& camera = cameras[moving ? (frame++ & 1u) : 0u];
+            froxelizer.prepare(driver, scope, v.getViewport(), camera.projection,
+                    camera.zn, camera.zf, lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT);
+            froxelizer.froxelizeLights(e, camera, lightData);
+            froxelizer.commit(driver);
+
+            // the froxel buffers are allocated in the command stream
+            state.PauseTiming();
+            e.flush();
+            state.ResumeTiming();
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * fixture.lights.size());
+    }
+
+    froxelizer.terminate(driver);
+    e.flushAndWait();
+}
+
+BENCHMARK_DEFINE_F(SceneFixture, froxelizeLights)(benchmark::State& state) {
+    froxelizeLights(*this, state, true);
+}
+
+BENCHMARK_DEFINE_F(SceneFixture, froxelizeLightsStatic)(benchmark::State& state) {
+    froxelizeLights(*this, state, false);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+BENCHMARK_DEFINE_F(SceneFixture, shadowMapFrustum)(benchmark::State& state) {
+    if (!checkScene(state)) {
+        return;
+    }
+    FEngine& e = *upcast(engine);
+    FView& v = *upcast(view);
+    FScene& s = *upcast(scene);
+    FScene::LightSoa const& lightData = s.getLightData();
+    CameraInfo const& camera = v.getCameraInfo();
+    const uint8_t visibleLayers = v.getVisibleLayers();
+
+    const ShadowMap::ShadowMapLayout layout{
+            .zResolution = 1.0f / (1u << 16u),
+            .atlasDimension = 1024,
+            .textureDimension = 1024,
+            .shadowDimension = 1024 - 2,
+            .offset = {}
+    };
+
+    ShadowMap shadowMap(e);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            ShadowMap::CascadeParameters cascadeParams;
+            ShadowMap::computeSceneCascadeParams(lightData, 0, v, camera, visibleLayers,
+                    cascadeParams);
+            shadowMap.update(lightData, 0, &s, camera, visibleLayers, layout, cascadeParams);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * renderables.size());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+BENCHMARK_REGISTER_F(SceneFixture, scenePrepare)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, scenePrepareWorldOriginChanged)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, sceneCulling)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, transformTransaction)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, transformHierarchy)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, renderPassColor)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, renderPassDepth)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, froxelizeLights)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, froxelizeLightsStatic)->Apply(sceneArguments);
+BENCHMARK_REGISTER_F(SceneFixture, shadowMapFrustum)->Apply(sceneArguments);
@@ -93,6 +93,7 @@ class FColorGrading;
  */
 class UTILS_PUBLIC ColorGrading : public FilamentAPI {
     struct BuilderDetails;
+    friend class FColorGrading;
 public:
     enum class QualityLevel : uint8_t {
         LOW,
@@ -21,8 +21,11 @@
 
 #include <utils/compiler.h>
 
+#include <cstddef>
+
 namespace utils {
 class Entity;
+class JobExecutor;
 class JobSystem;
 } // namespace utils
 
@@ -32,10 +35,12 @@ class Camera;
 class ColorGrading;
 class DebugRegistry;
 class Fence;
+class Impostor;
 class IndexBuffer;
 class IndirectLight;
 class Material;
 class MaterialInstance;
+class ReflectionProbe;
 class Renderer;
 class RenderTarget;
 class Scene;
@@ -119,6 +124,16 @@ class TransformManager;
  * calls to an Engine instance methods.
  * If multi-threading is needed, synchronization must be external.
  *
+ * The exception is loading: VertexBuffer, IndexBuffer and Texture can be built from any thread,
+ * and VertexBuffer::setBufferAt(), IndexBuffer::setBuffer() and Texture::setImage() called from
+ * any thread, concurrently with the Engine's thread. The commands of such a call execute in
+ * order with the calls made by the same thread before it, and before the commands of the
+ * Engine's thread that are flushed after the call returned: a resource built on a loading thread
+ * can be used by the Engine's thread as soon as the build() returned. A resource built on the
+ * Engine's thread must be flushed (e.g. with Engine::flush()) before it's updated from another
+ * thread. Destroying resources, streamed textures and the other calls are still restricted to
+ * the Engine's thread.
+ *
  * Multi-threading
  * ===============
  *
@@ -148,6 +163,173 @@ public:
     using Platform = backend::Platform;
     using Backend = backend::Backend;
 
+    /**
+     * Configuration of the Engine's memory budgets, given to Engine::create() and
+     * Engine::createAsync(). Values left to 0 use the defaults of the build.
+     */
+    struct Config {
+        /**
+         * Size in MiB of the command buffer, which holds the driver commands of the frames
+         * in flight. This is at least 3 times minCommandBufferSizeMB, which is also the default.
+         */
+        uint32_t commandBufferSizeMB = 0;
+
+        /**
+         * Size in MiB guaranteed available in the command buffer after each flush, this is the
+         * largest amount of driver commands a frame can generate. Defaults to 1 MiB.
+         */
+        uint32_t minCommandBufferSizeMB = 0;
+
+        /**
+         * Size in MiB up to which the command buffer can grow. When the command buffer comes
+         * close to being full, it is doubled between two frames, along with
+         * minCommandBufferSizeMB. The default, 0, disables growing the command buffer.
+         */
+        uint32_t maxCommandBufferSizeMB = 0;
+
+        /**
+         * Size in MiB of the cache of render target textures unused by the last frames, which
+         * are recycled by the following frames. When the cache is full, the least recently used
+         * textures are destroyed first. Defaults to 64 MiB.
+         */
+        uint32_t textureCacheSizeMB = 0;
+
+        /**
+         * Number of frames after which an unused texture is evicted from the cache, even if the
+         * cache isn't full. Defaults to 30.
+         */
+        uint32_t textureCacheMaxAge = 0;
+
+        /**
+         * Size in MiB of the levels the streamed textures keep resident on the GPU (see
+         * Texture::Builder::streaming()). When the levels needed on screen don't fit, the
+         * textures not visible anymore are evicted first, then all the others lose the same
+         * number of levels. Defaults to 256 MiB.
+         */
+        uint32_t textureStreamingBudgetMB = 0;
+
+        /**
+         * Number of JobSystem jobs that can exist at the same time. When they are all in use,
+         * work that would be split in jobs runs on the calling thread instead. Defaults to 4096,
+         * at most 32766. JobSystem::getPeakJobCount() can be used to tune it.
+         */
+        uint32_t jobSystemMaxJobCount = 0;
+
+        /**
+         * Number of JobSystem worker threads. The default, 0, picks a value based on the number
+         * of CPUs, or of CPUs in jobSystemAffinityMask.
+         */
+        uint32_t jobSystemThreadCount = 0;
+
+        /**
+         * CPUs the JobSystem worker threads run on, bit N being CPU N. Each worker is pinned to
+         * one of them. For instance JobSystem::getBigCoresMask() keeps the engine's jobs (culling,
+         * froxelization, commands generation...) on the big cores of a big.LITTLE SoC.
+         * The default, 0, pins worker N to CPU N.
+         */
+        uint64_t jobSystemAffinityMask = 0;
+
+        /**
+         * Task scheduler of the application, which lends its threads to the JobSystem. When
+         * set, the JobSystem doesn't start worker threads of its own, which would compete for the
+         * CPUs with the application's pool. The engine's jobs (culling, froxelization, commands
+         * generation, gltfio decoding...) still go through the JobSystem, which dispatches
+         * helper tasks to the executor when it has queued jobs. jobSystemThreadCount and
+         * jobSystemAffinityMask are then ignored. The executor must outlive the Engine.
+         *
+         * @see utils::JobExecutor
+         */
+        utils::JobExecutor* jobSystemExecutor = nullptr;
+
+        /**
+         * Size in MiB of the arena backing Engine::ScratchScope. Allocations that don't fit
+         * fall back to the heap. Defaults to 1 MiB.
+         */
+        uint32_t scratchArenaSizeMB = 0;
+
+        /**
+         * Number of frames the GPU can fall behind before Renderer::beginFrame() asks to skip a
+         * frame. Offline rendering, e.g. of thumbnails with a headless SwapChain, favors
+         * throughput over latency and can keep more frames in flight, so that the GPU works on
+         * a frame while the read-backs of the previous ones complete. Defaults to 1, at most 3.
+         *
+         * The Vulkan backend records frameLatency + 1 frames in a ring of command buffers, so that
+         * it doesn't wait for the GPU as long as the frames aren't skipped.
+         *
+         * @see Renderer::renderStandaloneView(), which never skips frames
+         */
+        uint32_t frameLatency = 0;
+
+        /**
+         * Number of objects released per frame, to spread the cost of unloading large scenes.
+         * When it isn't 0, destroying a VertexBuffer, IndexBuffer, Texture or MaterialInstance
+         * only queues it, and each Renderer::endFrame() releases at most that many of the queued
+         * objects, oldest first. The components of the entities destroyed with the EntityManager
+         * are also garbage collected at most that many per frame by each component manager.
+         * Either way, an object can't be used once it has been destroyed.
+         * Defaults to 0, no limit.
+         */
+        uint32_t destructionBudget = 0;
+
+        /**
+         * Backs the Engine's per-frame arenas with transparent huge pages where the platform
+         * supports them (Linux and Android), to reduce the TLB misses of command generation.
+         * This rounds each arena up to a multiple of 2 MiB.
+         */
+        bool arenaHugePages = false;
+
+        /**
+         * Commits the memory of the Engine's per-frame arenas when the Engine and its Views are
+         * created, so that the first frames don't take page faults. The arenas then count
+         * towards the resident memory of the process upfront.
+         */
+        bool arenaPrefault = false;
+    };
+
+    /**
+     * A ScratchScope hands out short-lived memory from an arena owned by the Engine, which is
+     * much cheaper than the heap for per-frame temporaries. All the memory allocated through a
+     * ScratchScope is released at once when it is destroyed.
+     *
+     * When the arena is full, allocations fall back to the heap, so they never fail for lack
+     * of arena space. Engine::getScratchArenaHighWatermark() can be used to size the arena
+     * with Config::scratchArenaSizeMB.
+     *
+     * ScratchScopes must only be used on the Engine's main thread and, when nested, destroyed
+     * in the reverse order of their creation. Destructors of objects placed in the memory are
+     * not called.
+     *
+     * \code{.cpp}
+     * {
+     *     Engine::ScratchScope scratch(*engine);
+     *     float* weights = static_cast<float*>(scratch.allocate(count * sizeof(float)));
+     *     ...
+     * } // weights is released here
+     * \endcode
+     */
+    class UTILS_PUBLIC ScratchScope {
+    public:
+        explicit ScratchScope(Engine& engine) noexcept;
+        ~ScratchScope() noexcept;
+
+        ScratchScope(ScratchScope const&) = delete;
+        ScratchScope& operator=(ScratchScope const&) = delete;
+
+        /**
+         * Allocates \p size bytes aligned to \p alignment, which must be a power of two.
+         * The memory stays valid until this ScratchScope is destroyed.
+         *
+         * @return a pointer to the memory, nullptr only if the heap itself is exhausted.
+         */
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) noexcept;
+
+    private:
+        Engine& mEngine;
+        void* mRewind;
+        // singly linked list of the allocations that didn't fit in the arena
+        void* mHeapBlocks = nullptr;
+    };
+
     /**
      * Creates an instance of Engine
      *
@@ -166,11 +348,15 @@ public:
      *                          The lifetime of \p platform must exceed the lifetime of
      *                          the Engine object.
      *
+     *                          Platform::setBlobFunc() can be used to let the backend persist
+     *                          data across runs, such as GPU pipeline caches.
+     *
      *  @param sharedGLContext  A platform-dependant OpenGL context used as a shared context
      *                          when creating filament's internal context.
      *                          Setting this parameter will force filament to use the OpenGL
      *                          implementation (instead of Vulkan for instance).
      *
+     *  @param config           Memory budgets of the Engine, or nullptr to use the defaults.
      *
      * @return A pointer to the newly created Engine, or nullptr if the Engine couldn't be created.
      *
@@ -185,7 +371,8 @@ public:
      * This method is thread-safe.
      */
     static Engine* create(Backend backend = Backend::DEFAULT,
-            Platform* platform = nullptr, void* sharedGLContext = nullptr);
+            Platform* platform = nullptr, void* sharedGLContext = nullptr,
+            const Config* config = nullptr);
 
 #if UTILS_HAS_THREADING
     /**
@@ -227,10 +414,13 @@ public:
      *                          when creating filament's internal context.
      *                          Setting this parameter will force filament to use the OpenGL
      *                          implementation (instead of Vulkan for instance).
+     *
+     *  @param config           Memory budgets of the Engine, or nullptr to use the defaults.
      */
     static void createAsync(CreateCallback callback, void* user,
             Backend backend = Backend::DEFAULT,
-            Platform* platform = nullptr, void* sharedGLContext = nullptr);
+            Platform* platform = nullptr, void* sharedGLContext = nullptr,
+            const Config* config = nullptr);
 
     /**
      * Retrieve an Engine* from createAsync(). This must be called from the same thread than
@@ -409,6 +599,8 @@ public:
     bool destroy(const Scene* p);               //!< Destroys a Scene object.
     bool destroy(const Skybox* p);              //!< Destroys a SkyBox object.
     bool destroy(const ColorGrading* p);        //!< Destroys a ColorGrading object.
+    bool destroy(const ReflectionProbe* p);     //!< Destroys a ReflectionProbe object.
+    bool destroy(const Impostor* p);            //!< Destroys an Impostor object.
     bool destroy(const SwapChain* p);           //!< Destroys a SwapChain object.
     bool destroy(const Stream* p);              //!< Destroys a Stream object.
     bool destroy(const Texture* p);             //!< Destroys a Texture object.
@@ -442,6 +634,50 @@ public:
      */
     Backend getBackend() const noexcept;
 
+    /**
+     * Returns whether the backend can compile shaders without blocking the rendering thread.
+     * Currently this is only the case with the OpenGL backend when the driver supports
+     * GL_KHR_parallel_shader_compile.
+     *
+     * @return true if asynchronous shader compilation is supported.
+     * @see setAsyncShaderCompilationEnabled()
+     */
+    bool isAsyncShaderCompilationSupported() noexcept;
+
+    /**
+     * Enables or disables asynchronous shader compilation (disabled by default).
+     *
+     * When enabled and supported, programs created for surface materials are compiled in
+     * the background and renderables using them are simply not drawn until the compilation
+     * completes, instead of stalling the frame. Post-process materials are never affected.
+     *
+     * This only affects programs created after this call.
+     *
+     * @param enabled true to enable asynchronous shader compilation.
+     * @see isAsyncShaderCompilationSupported()
+     */
+    void setAsyncShaderCompilationEnabled(bool enabled) noexcept;
+
+    /**
+     * @return whether asynchronous shader compilation is enabled.
+     */
+    bool isAsyncShaderCompilationEnabled() const noexcept;
+
+    /**
+     * Loads a shared shader dictionary, built with matc's --shared-dictionary option (or
+     * filamat::MaterialBuilder::buildSharedDictionary()).
+     *
+     * The materials built with a shared dictionary only store the lines of their GLSL and MSL
+     * shaders that the dictionary doesn't have, the others are read from the dictionary, which
+     * is parsed only once. The dictionary must be loaded before these materials are created and
+     * stays loaded until the engine is destroyed. Loading the same dictionary again is a no-op.
+     *
+     * @param data Pointer to the dictionary package, which is only used during this call.
+     * @param size Size of the dictionary package in bytes.
+     * @return false if the data isn't a valid shared dictionary.
+     */
+    bool loadShaderDictionary(const void* data, size_t size) noexcept;
+
     /**
      * Allocate a small amount of memory directly in the command stream. The allocated memory is
      * guaranteed to be preserved until the current command buffer is executed
@@ -489,6 +725,79 @@ public:
 
     DebugRegistry& getDebugRegistry() noexcept;
 
+    /**
+     * Returns the largest amount of memory, in bytes, used by the command buffer so far. This
+     * can be used to tune Config::commandBufferSizeMB.
+     *
+     * @see Config
+     */
+    size_t getCommandBufferHighWatermark() const noexcept;
+
+    /**
+     * Returns the current size of the command buffer in bytes.
+     *
+     * @see Config
+     */
+    size_t getCommandBufferSize() const noexcept;
+
+    /**
+     * Returns the largest amount of memory, in bytes, used so far by the arena holding the
+     * temporary data of a frame (render passes, culling, froxelization...). When this comes
+     * close to the FILAMENT_PER_RENDER_PASS_ARENA_SIZE_IN_MB build option, the arena should be
+     * made larger.
+     */
+    size_t getPerRenderPassArenaHighWatermark() const noexcept;
+
+    /**
+     * Returns the largest amount of memory, in bytes, used so far in the ScratchScope arena.
+     * Allocations that fell back to the heap are not accounted for.
+     *
+     * @see ScratchScope, Config::scratchArenaSizeMB
+     */
+    size_t getScratchArenaHighWatermark() const noexcept;
+
+    /**
+     * Estimated GPU memory used by the Engine, in bytes.
+     *
+     * The categories are computed from the sizes and formats of the resources, the same way on
+     * all backends, so they don't account for the padding and alignment of the GPU's
+     * allocations. backendTotal is what the backend itself reports having allocated, where it
+     * can tell.
+     */
+    struct MemoryStats {
+        //! Textures created with Texture::Builder, only the resident levels of streamed ones.
+        size_t textures = 0;
+        //! Vertex buffers.
+        size_t vertexBuffers = 0;
+        //! Index buffers.
+        size_t indexBuffers = 0;
+        //! The attachments of the render passes of the last frame, but the shadow maps.
+        size_t renderTargets = 0;
+        //! The shadow maps of the views rendered during the last frame.
+        size_t shadowMaps = 0;
+        //! Attachments of previous frames kept for reuse, see Config::textureCacheSizeMB.
+        size_t resourceCache = 0;
+        //! Allocated by the backend: VMA's statistics on Vulkan, the device's allocated size on
+        //! Metal. 0 on OpenGL, which can't tell.
+        uint64_t backendTotal = 0;
+        //! Part of backendTotal made of the memory blocks from which the backend sub-allocates
+        //! its buffers and textures. 0 on backends that don't pool their allocations.
+        uint64_t backendPooled = 0;
+        //! Free space within backendPooled, which grows as the pools fragment.
+        uint64_t backendPoolUnused = 0;
+        //! Bytes moved by the defragmentation of the pools since the Engine was created.
+        uint64_t backendRelocated = 0;
+    };
+
+    /**
+     * Returns the estimated GPU memory used by the Engine, so that the application can enforce
+     * a budget, e.g. together with Config::textureStreamingBudgetMB. This walks all the
+     * textures and buffers, it's meant to be called once in a while rather than every frame.
+     *
+     * @see MemoryStats
+     */
+    MemoryStats getMemoryStats() const noexcept;
+
 protected:
     //! \privatesection
     Engine() noexcept = default;
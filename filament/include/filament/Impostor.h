@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//! \file
+
+#ifndef TNT_FILAMENT_IMPOSTOR_H
+#define TNT_FILAMENT_IMPOSTOR_H
+
+#include <filament/FilamentAPI.h>
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+
+#include <stdint.h>
+
+namespace filament {
+
+class FImpostor;
+
+class Engine;
+class IndirectLight;
+class Renderer;
+class Texture;
+class View;
+
+/**
+ * An Impostor replaces a renderable with a single textured quad when it covers a small part of
+ * the screen, e.g. distant trees or buildings in a large scene, to save most of its vertex and
+ * draw cost.
+ *
+ * The renderable is rendered once, by bake(), from a grid of directions covering the sphere,
+ * into the layers of an atlas (an octahedral impostor). Past the impostor's screen size, the
+ * level of detail selection draws a quad facing the camera instead of the renderable's
+ * primitives, showing the atlas frame closest to the direction it's seen from. Instances of the
+ * renderable each get their own quad.
+ *
+ * The frames are rendered with a View of their own, without post-processing or shadows, and
+ * are lit by the IndirectLight given to the Builder and by the lights added to the View's Scene.
+ * The lighting is baked in the object's space, so it turns with the object. The values captured
+ * are in physical units (exposure of 1), and are exposed like the rest of the scene when drawn.
+ *
+ * Skinned or morphed renderables are not supported, their impostor would show the bind pose.
+ *
+ * ~~~~~~~~~~~{.cpp}
+ *  filament::Impostor* impostor = filament::Impostor::Builder()
+ *              .renderable(tree)
+ *              .screenSize(0.05f)
+ *              .indirectLight(ibl)
+ *              .build(*engine);
+ *
+ *  // typically once, after loading
+ *  if (renderer->beginFrame(swapChain)) {
+ *      impostor->bake(*renderer);
+ *      renderer->render(view);
+ *      renderer->endFrame();
+ *  }
+ * ~~~~~~~~~~~
+ *
+ * @see RenderableManager::Builder::levelOfDetail()
+ */
+class UTILS_PUBLIC Impostor : public FilamentAPI {
+    struct BuilderDetails;
+
+public:
+    //! Use Builder to construct an Impostor object instance
+    class Builder : public BuilderBase<BuilderDetails> {
+        friend struct BuilderDetails;
+    public:
+        Builder() noexcept;
+        Builder(Builder const& rhs) noexcept;
+        Builder(Builder&& rhs) noexcept;
+        ~Builder() noexcept;
+        Builder& operator=(Builder const& rhs) noexcept;
+        Builder& operator=(Builder&& rhs) noexcept;
+
+        /**
+         * The renderable replaced by the impostor. This is required.
+         *
+         * @param renderable An entity with a renderable component, it must outlive the Impostor.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& renderable(utils::Entity renderable) noexcept;
+
+        /**
+         * The renderable rendered into the atlas, the one replaced by default. An instanced
+         * renderable would render all its instances into each frame, a single renderable with
+         * the same geometry and materials can be baked instead.
+         *
+         * Its world transform must be a rotation, a uniform scale and a translation, its bounding
+         * box must be the one of the replaced renderable.
+         *
+         * @param source An entity with a renderable component, it must outlive the Impostor.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& source(utils::Entity source) noexcept;
+
+        /**
+         * Dimension in texels of each frame of the atlas.
+         * Must be a power-of-two, 64 by default.
+         *
+         * @param size Dimension of the frames.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& size(uint32_t size) noexcept;
+
+        /**
+         * Number of frames along each side of the octahedral grid, between 2 and 16 (8 by
+         * default). The atlas has frames * frames layers, more frames reduce the popping when
+         * the impostor turns, at the cost of memory and of a longer bake().
+         *
+         * @param frames Number of frames per side.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& frames(uint8_t frames) noexcept;
+
+        /**
+         * Screen size below which the impostor is drawn instead of the renderable, as a fraction
+         * of the viewport height, like the screen sizes of the levels of detail. It must be
+         * between 0 and 1, 0.05 by default.
+         *
+         * @param screenSize The threshold of the impostor.
+         *
+         * @return This Builder, for chaining calls.
+         *
+         * @see setScreenSize()
+         */
+        Builder& screenSize(float screenSize) noexcept;
+
+        /**
+         * The IndirectLight the frames are lit with, none by default.
+         *
+         * @param indirectLight An IndirectLight that must outlive the Impostor, or nullptr.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& indirectLight(IndirectLight* indirectLight) noexcept;
+
+        /**
+         * Creates the Impostor object and returns a pointer to it.
+         *
+         * @param engine Reference to the filament::Engine to associate this Impostor with.
+         *
+         * @return pointer to the newly created object, or nullptr if the parameters are invalid.
+         *
+         * @exception utils::PostConditionPanic if a runtime error occurred, such as running out of
+         *            memory or other resources.
+         * @exception utils::PreConditionPanic if a parameter to a builder function was invalid.
+         */
+        Impostor* build(Engine& engine);
+
+    private:
+        friend class FImpostor;
+    };
+
+    /**
+     * Renders the frames of the atlas, then the impostor replaces the renderable past its screen
+     * size. It can be called again to update the atlas, e.g. after the renderable's materials
+     * changed.
+     *
+     * @param renderer The Renderer to render the frames with.
+     *
+     * @attention
+     * bake() must be called *after* Renderer::beginFrame() and *before* Renderer::endFrame().
+     * It renders all the frames at once, which is typically done once after loading.
+     */
+    void bake(Renderer& renderer);
+
+    //! Returns whether bake() was called, i.e. whether the impostor is in use.
+    bool isBaked() const noexcept;
+
+    /**
+     * Changes the screen size below which the impostor is drawn instead of the renderable.
+     *
+     * @param screenSize A fraction of the viewport height, between 0 and 1.
+     *
+     * @see Builder::screenSize()
+     */
+    void setScreenSize(float screenSize) noexcept;
+
+    //! Returns the screen size below which the impostor is drawn.
+    float getScreenSize() const noexcept;
+
+    /**
+     * Returns the atlas, a 2D array texture with a layer per frame. It's owned by the Impostor.
+     */
+    Texture* getAtlas() const noexcept;
+
+    /**
+     * Returns the View used to render the frames. Lights can be added to its Scene, but its
+     * Camera, Viewport and RenderTarget are managed by the Impostor.
+     */
+    View* getView() noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_IMPOSTOR_H
@@ -82,6 +82,15 @@ public:
          */
         Builder& bufferType(IndexType indexType) noexcept;
 
+        /**
+         * Declares that the indices are replaced every frame. The backend then optimizes for
+         * frequent updates, which are best written with IndexBuffer::mapBuffer().
+         *
+         * @param enabled true to make the buffer streaming, the default is false.
+         * @return A reference to this Builder for chaining calls.
+         */
+        Builder& streaming(bool enabled = true) noexcept;
+
         /**
          * Creates the IndexBuffer object and returns a pointer to it. After creation, the index
          * buffer is uninitialized. Use IndexBuffer::setBuffer() to initialized the IndexBuffer.
@@ -113,6 +122,18 @@ public:
      */
     void setBuffer(Engine& engine, BufferDescriptor&& buffer, uint32_t byteOffset = 0);
 
+    /**
+     * Updates a region of this IndexBuffer with indices the client writes directly to the
+     * returned memory. See VertexBuffer::mapBufferAt() for when the memory must be written.
+     *
+     * @param engine Reference to the filament::Engine to associate this IndexBuffer with.
+     * @param byteCount Size in *bytes* of the update.
+     * @param byteOffset Offset in *bytes* into the IndexBuffer
+     * @return A pointer to \p byteCount bytes to write the indices to, or nullptr if
+     *         \p byteCount is 0.
+     */
+    void* mapBuffer(Engine& engine, uint32_t byteCount, uint32_t byteOffset = 0);
+
     /**
      * Returns the size of this IndexBuffer in elements.
      * @return The number of indices the IndexBuffer holds.
@@ -77,7 +77,7 @@ class FLightManager;
  * parallel and come from infinitely far away and from everywhere. Typically a directional light
  * is used to simulate the sun.
  *
- * Directional lights and spot lights are able to cast shadows.
+ * Directional lights, spot lights and point lights are able to cast shadows.
  *
  * To create a directional light use Type.DIRECTIONAL or Type.SUN, both are similar, but the later
  * also draws a sun's disk in the sky and its reflection on glossy objects.
@@ -189,7 +189,10 @@ public:
      * Control the quality / performance of the shadow map associated to this light
      */
     struct ShadowOptions {
-        /** Size of the shadow map in texels. Must be a power-of-two. */
+        /**
+         * Size of the shadow map in texels. Must be a power-of-two.
+         * The six faces of a point light's shadow map share a square of this size.
+         */
         uint32_t mapSize = 1024;
 
         /**
@@ -309,6 +312,28 @@ public:
          */
         float maxShadowDistance = 0.3;
 
+        /**
+         * Shadow casters of the directional light smaller than this number of texels in their
+         * cascade aren't rendered into the shadow map (0 by default, i.e. disabled). Each caster
+         * is measured in the cascade of its point closest to the camera.
+         *
+         * CAUTION: this parameter is ignored for all lights except the directional/sun light.
+         */
+        float minCasterTexels = 0.0f;
+
+        /**
+         * Hint that this light and its shadow casters don't change often (false by default).
+         *
+         * When true, the shadow maps of this light are kept from one frame to the next and are
+         * only rendered again when they're invalidated, i.e. when the light, its shadow map
+         * projection (which depends on the camera and the cascade splits for directional
+         * lights), or the set and transforms of its visible shadow casters change.
+         *
+         * Shadow casters using skinning always invalidate the shadow maps. Other changes, such as
+         * material parameters affecting the casters' coverage, are not detected.
+         */
+        bool isStatic = false;
+
         /**
          * Options available when the View's ShadowType is set to VSM.
          *
@@ -323,6 +348,12 @@ public:
              * Higher values may not be available depending on the underlying hardware.
              */
             uint8_t msaaSamples = 1;
+
+            /**
+             * Width in texels of the Gaussian blur applied to the VSM shadow map after it's
+             * rendered, which softens the shadows. 0 disables the blur, the maximum is 125.
+             */
+            float blurWidth = 0.0f;
         } vsm;
     };
 
@@ -395,7 +426,8 @@ public:
          * @return This Builder, for chaining calls.
          *
          * @warning
-         * - Only a Type.DIRECTIONAL, Type.SUN, Type.SPOT, or Type.FOCUSED_SPOT light can cast shadows
+         * - Up to 4 Type.SPOT, Type.FOCUSED_SPOT or Type.POINT lights cast shadows, and at most 2
+         *   of them can be point lights
          */
         Builder& castShadows(bool enable) noexcept;
 
@@ -860,7 +892,8 @@ public:
      * @param shadowCaster Enables or disables casting shadows from this Light.
      *
      * @warning
-     * - Only a Type.DIRECTIONAL, Type.SUN, Type.SPOT, or Type.FOCUSED_SPOT light can cast shadows
+     * - Up to 4 Type.SPOT, Type.FOCUSED_SPOT or Type.POINT lights cast shadows, and at most 2
+     *   of them can be point lights
      */
     void setShadowCaster(Instance i, bool shadowCaster) noexcept;
 
@@ -86,6 +86,26 @@ public:
         Precision precision;
     };
 
+    /**
+     * Features that select the variants of a material's programs, see compile().
+     */
+    enum VariantFeature : uint8_t {
+        DIRECTIONAL_LIGHTING    = 0x01, //!< The scene has a directional light
+        DYNAMIC_LIGHTING        = 0x02, //!< The scene has point or spot lights
+        SHADOW_RECEIVER         = 0x04, //!< Shadows are enabled and the renderable receives them
+        SKINNING                = 0x08, //!< The renderable uses skinning or morphing
+        FOG                     = 0x20, //!< The View has fog enabled
+        VSM                     = 0x40, //!< The View uses ShadowType::VSM
+        ALL_VARIANTS            = 0x6F  //!< All of the above
+    };
+
+    /**
+     * Called once the programs requested by compile() have been created.
+     *
+     * @see compile()
+     */
+    using CompilationCallback = void(*)(Material* material, void* user);
+
     class Builder : public BuilderBase<BuilderDetails> {
         friend struct BuilderDetails;
     public:
@@ -105,6 +125,16 @@ public:
          */
         Builder& package(const void* payload, size_t size);
 
+        /**
+         * Specifies the material data without copying it, e.g. to use a package mapped from a
+         * file. The shaders are then read directly from the package when a program is created.
+         *
+         * @param payload Pointer to the material data, must stay valid and unchanged until the
+         *                Material is destroyed.
+         * @param size Size of the material data pointed to by "payload" in bytes.
+         */
+        Builder& packageNoCopy(const void* payload, size_t size);
+
         /**
          * Creates the Material object and returns a pointer to it.
          *
@@ -196,6 +226,9 @@ public:
     // Return the refraction type used by this material.
     RefractionType getRefractionType() const noexcept;
 
+    //! Indicates whether this material can be rendered with foveation (see View::setFoveationOptions()).
+    bool isFoveationEnabled() const noexcept;
+
     /**
      * Returns the number of parameters declared by this material.
      * The returned value can be 0.
@@ -277,6 +310,35 @@ public:
 
     //! Returns this material's default instance.
     MaterialInstance const* getDefaultInstance() const noexcept;
+
+    /**
+     * Creates ahead of time the programs of the variants made of the given features, e.g. to
+     * compile the material behind a loading screen rather than during the first frames that use
+     * it. Without this, a program is created the first time a renderable needs it, which
+     * stalls that frame.
+     *
+     * A variant is included when all of its features are in \p variants, the depth variants
+     * (shadow maps, picking) are always included. The variants that don't apply to this material
+     * (e.g. lighting variants of an unlit material) or that were left out of the package by matc
+     * are skipped, as are the programs already created. Post-process materials create all their
+     * programs.
+     *
+     * The programs are created by the driver asynchronously. With
+     * Engine::setAsyncShaderCompilationEnabled(true) and a driver that supports it, the GPU
+     * driver may still be compiling them when the callback is called; renderables using them are
+     * then skipped until they're ready, rather than stalling the frame.
+     *
+     * e.g.: for a View with shadows and fog enabled, in a scene with a directional light:
+     *      material->compile(Material::DIRECTIONAL_LIGHTING | Material::SHADOW_RECEIVER |
+     *              Material::FOG | Material::SKINNING, onCompiled, this);
+     *
+     * @param variants  The features of the variants to create, a combination of VariantFeature.
+     * @param callback  Optional, called on the driver thread once the driver has created the
+     *                  programs. The material must not be destroyed before then.
+     * @param user      User data passed to \p callback.
+     */
+    void compile(uint8_t variants = ALL_VARIANTS,
+            CompilationCallback callback = nullptr, void* user = nullptr) noexcept;
 };
 
 } // namespace filament
@@ -91,6 +91,35 @@ public:
     template<typename T, typename = is_supported_parameter_t<T>>
     void setParameter(const char* name, const T* values, size_t count) noexcept;
 
+    /**
+     * Set a uniform by name on many instances at once. The parameter is looked up only once,
+     * which makes this much cheaper than calling setParameter() on each instance.
+     *
+     * @param instances Instances to set the parameter of, they should all be instances of the
+     *                  same Material. Cannot be nullptr.
+     * @param count     Number of instances.
+     * @param name      Name of the parameter as defined by Material. Cannot be nullptr.
+     * @param value     Value of the parameter to set on all the instances.
+     */
+    template<typename T, typename = is_supported_parameter_t<T>>
+    static void setParameter(MaterialInstance* const* instances, size_t count,
+            const char* name, T value) noexcept;
+
+    /**
+     * Set a uniform by name to a different value on each of many instances. The parameter is
+     * looked up only once, which makes this much cheaper than calling setParameter() on each
+     * instance.
+     *
+     * @param instances Instances to set the parameter of, they should all be instances of the
+     *                  same Material. Cannot be nullptr.
+     * @param count     Number of instances.
+     * @param name      Name of the parameter as defined by Material. Cannot be nullptr.
+     * @param values    Array of count values, values[i] is set on instances[i].
+     */
+    template<typename T, typename = is_supported_parameter_t<T>>
+    static void setParameter(MaterialInstance* const* instances, size_t count,
+            const char* name, const T* values) noexcept;
+
     /**
      * Set a texture as the named parameter
      *
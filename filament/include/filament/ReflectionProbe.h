@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//! \file
+
+#ifndef TNT_FILAMENT_REFLECTIONPROBE_H
+#define TNT_FILAMENT_REFLECTIONPROBE_H
+
+#include <filament/FilamentAPI.h>
+
+#include <utils/compiler.h>
+
+#include <math/mathfwd.h>
+
+#include <stdint.h>
+
+namespace filament {
+
+class FReflectionProbe;
+
+class Engine;
+class IndirectLight;
+class Renderer;
+class Scene;
+class View;
+
+/**
+ * A ReflectionProbe keeps the IndirectLight of a Scene up-to-date with the Scene's content, as
+ * seen from a position, e.g. in a dynamic environment.
+ *
+ * Capturing the environment and filtering it is spread over several frames to avoid spikes: each
+ * call to render() renders a few faces of a low resolution cubemap, then its reflections are
+ * filtered on the GPU a mipmap level per frame, and its irradiance is computed. Once all of it
+ * is complete, a new IndirectLight replaces the previous one in the Scene, and the next capture
+ * starts.
+ *
+ * The Scene is rendered with a View of its own, without post-processing or shadows. The values
+ * captured are in physical units (exposure of 1), so the IndirectLight has an intensity of 1.
+ *
+ * ~~~~~~~~~~~{.cpp}
+ *  filament::ReflectionProbe* probe = filament::ReflectionProbe::Builder()
+ *              .scene(scene)
+ *              .position({ 0, 1, 0 })
+ *              .build(*engine);
+ *
+ *  if (renderer->beginFrame(swapChain)) {
+ *      probe->render(*renderer);
+ *      renderer->render(view);
+ *      renderer->endFrame();
+ *  }
+ * ~~~~~~~~~~~
+ *
+ * @see IndirectLight, Texture::generatePrefilterMipmap(), Texture::computeIrradianceSH()
+ */
+class UTILS_PUBLIC ReflectionProbe : public FilamentAPI {
+    struct BuilderDetails;
+
+public:
+    //! Use Builder to construct a ReflectionProbe object instance
+    class Builder : public BuilderBase<BuilderDetails> {
+        friend struct BuilderDetails;
+    public:
+        Builder() noexcept;
+        Builder(Builder const& rhs) noexcept;
+        Builder(Builder&& rhs) noexcept;
+        ~Builder() noexcept;
+        Builder& operator=(Builder const& rhs) noexcept;
+        Builder& operator=(Builder&& rhs) noexcept;
+
+        /**
+         * The Scene captured, its IndirectLight is replaced each time a capture is complete.
+         * This is required.
+         *
+         * @param scene The Scene to capture, it must outlive the ReflectionProbe.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& scene(Scene* scene) noexcept;
+
+        /**
+         * Dimension in texels of the faces of the captured cubemap and of the reflections.
+         * Must be a power-of-two, 128 by default.
+         *
+         * @param size Dimension of the cubemap faces.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& size(uint32_t size) noexcept;
+
+        /**
+         * Number of cubemap faces rendered by each call to render(), between 1 and 6
+         * (1 by default).
+         *
+         * @param count Number of faces rendered per frame.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& facesPerFrame(uint8_t count) noexcept;
+
+        /**
+         * World-space position the Scene is captured from, the origin by default.
+         *
+         * @param position The position of the probe.
+         *
+         * @return This Builder, for chaining calls.
+         *
+         * @see setPosition()
+         */
+        Builder& position(math::float3 const& position) noexcept;
+
+        /**
+         * Distances of the near and far clipping planes of the capture, in world units.
+         * 0.1 and 100 by default.
+         *
+         * @param near Distance to the near plane, must be positive.
+         * @param far  Distance to the far plane, must be greater than \p near.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& clipping(float near, float far) noexcept;
+
+        /**
+         * Number of samples used to filter the reflections (8 by default).
+         *
+         * @param sampleCount Number of samples per texel.
+         *
+         * @return This Builder, for chaining calls.
+         *
+         * @see Texture::PrefilterOptions::sampleCount
+         */
+        Builder& sampleCount(uint16_t sampleCount) noexcept;
+
+        /**
+         * Creates the ReflectionProbe object and returns a pointer to it.
+         *
+         * @param engine Reference to the filament::Engine to associate this ReflectionProbe
+         *               with.
+         *
+         * @return pointer to the newly created object, or nullptr if the parameters are invalid.
+         *
+         * @exception utils::PostConditionPanic if a runtime error occurred, such as running out of
+         *            memory or other resources.
+         * @exception utils::PreConditionPanic if a parameter to a builder function was invalid.
+         */
+        ReflectionProbe* build(Engine& engine);
+
+    private:
+        friend class FReflectionProbe;
+    };
+
+    /**
+     * Moves the probe. This takes effect with the next capture, the one in progress is
+     * completed from its current position.
+     *
+     * @param position The new world-space position of the probe.
+     */
+    void setPosition(math::float3 const& position) noexcept;
+
+    //! Returns the world-space position of the probe.
+    math::float3 getPosition() const noexcept;
+
+    /**
+     * Advances the capture: renders the next faces of the cubemap, or once the filtering of the
+     * previous capture is complete, replaces the Scene's IndirectLight.
+     *
+     * @param renderer The Renderer to render the faces with.
+     *
+     * @attention
+     * render() must be called *after* Renderer::beginFrame() and *before* Renderer::endFrame(),
+     * typically once per frame.
+     */
+    void render(Renderer& renderer);
+
+    /**
+     * Returns the IndirectLight of the last complete capture, which is also set on the Scene,
+     * or nullptr before the first one. It's owned by the ReflectionProbe and is destroyed when
+     * it's replaced, or with the ReflectionProbe.
+     */
+    IndirectLight* getIndirectLight() const noexcept;
+
+    /**
+     * Returns the View used to render the faces of the cubemap. It can be used to further
+     * configure the capture, e.g. its visible layers, but its Scene, Camera, Viewport and
+     * RenderTarget are managed by the ReflectionProbe.
+     */
+    View* getView() noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_REFLECTIONPROBE_H
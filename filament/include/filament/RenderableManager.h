@@ -154,6 +154,26 @@ public:
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t count) noexcept; //!< \overload
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices) noexcept; //!< \overload
 
+        /**
+         * Specifies a compact vertex buffer drawn instead of the primitive's vertex buffer by
+         * the depth-only passes (shadow maps, depth prepass, SSAO structure pass), so they
+         * fetch less vertex data.
+         *
+         * It's drawn with the primitive's indices, so it must have the same vertex count as the
+         * vertex buffer given to geometry(). It typically only declares POSITION, plus the
+         * attributes the depth passes can read: BONE_INDICES and BONE_WEIGHTS for skinning, the
+         * morph target positions for morphing, and the attributes of the material for MASKED
+         * materials. The primitive's vertex buffer is drawn when one of the attributes it has
+         * and the depth passes read is missing, or when the renderable is skinned by the
+         * compute pass.
+         *
+         * Changing the vertices with setGeometryAt() removes the depth vertices.
+         *
+         * @param index zero-based index of the primitive, must be less than the count passed to Builder constructor
+         * @param vertices the compact vertex buffer, or nullptr to draw the primitive's vertex buffer
+         */
+        Builder& depthGeometry(size_t index, VertexBuffer* vertices) noexcept;
+
         /**
          * Binds a material instance to the specified primitive.
          *
@@ -240,7 +260,8 @@ public:
         Builder& screenSpaceContactShadows(bool enable) noexcept;
 
         /**
-         * Enables GPU vertex skinning for up to 255 bones, 0 by default.
+         * Enables GPU vertex skinning for up to 255 bones (more with computeSkinning()),
+         * 0 by default.
          *
          * Each vertex can be affected by up to 4 bones simultaneously. The attached
          * VertexBuffer must provide data in the \c BONE_INDICES slot (uvec4) and the
@@ -256,6 +277,65 @@ public:
         Builder& skinning(size_t boneCount, Bone const* bones) noexcept; //!< \overload
         Builder& skinning(size_t boneCount) noexcept; //!< \overload
 
+        /**
+         * Skins the vertices in a compute pass, only when the bones change, instead of in the
+         * vertex shader of every pass that draws them (shadow maps, depth, color...).
+         * false by default.
+         *
+         * The bones of all the renderables skinned this way are stored in a single buffer, which
+         * lifts the limit of 255 bones. Each primitive keeps a skinned copy of its vertices.
+         *
+         * This is ignored, and the vertices are skinned in the vertex shader, when the backend
+         * doesn't support compute, or when the vertex buffer of any primitive has:
+         * - POSITION in another format than FLOAT3 or FLOAT4,
+         * - TANGENTS in another format than FLOAT4 or normalized SHORT4,
+         * - BONE_INDICES in another format than UBYTE4 or USHORT4,
+         * - BONE_WEIGHTS in another format than FLOAT4, normalized UBYTE4 or normalized USHORT4,
+         * - or any attribute whose offset or stride isn't a multiple of 4.
+         *
+         * Compute skinning can't be combined with morphing, see computeMorphing() instead.
+         */
+        Builder& computeSkinning(bool enable) noexcept;
+
+        /**
+         * Gives the renderable any number of morph targets, which are applied in a compute pass,
+         * before the skinning if any, only when their weights change. 0 by default.
+         *
+         * Unlike morphing(), the targets aren't vertex attributes: each one is a sparse list of
+         * position and normal deltas, set with RenderableManager::setMorphTargetAt(), and only
+         * the targets with a non-zero weight cost anything. The weights are set with
+         * RenderableManager::setMorphWeights(Instance, float const*, size_t, size_t).
+         *
+         * This enables computeSkinning(), and has the same requirements on the vertex buffers,
+         * except for the bone attributes when the renderable isn't skinned. build() fails if
+         * they aren't met, or if the backend doesn't support compute.
+         *
+         * This can't be combined with morphing().
+         *
+         * @param targetCount the number of morph targets of each primitive
+         */
+        Builder& computeMorphing(size_t targetCount) noexcept;
+
+        /**
+         * Recomputes the bounding box of the renderable each frame its bones or the weights of
+         * its computeMorphing() targets change, instead of relying on the box given to
+         * boundingBox() to enclose every pose. false by default.
+         *
+         * When skinned, the bounding box is the union of the boxes of the bones, each transformed
+         * by its bone. When only morphed, it's the box given to boundingBox() grown by the
+         * weighted morph targets. In both cases the boxes are grown by the morph targets before
+         * being transformed.
+         *
+         * The bounding boxes of all the renderables whose bones changed are updated at once, in
+         * parallel, when the scene is prepared for rendering.
+         *
+         * @param enable    whether the bounding box follows the bones and morph targets
+         * @param boneBoxes one box per bone, required when skinned. The box of a bone must
+         *                  enclose, in the bind pose, all the vertices that the bone influences.
+         *                  The boxes are copied by build().
+         */
+        Builder& dynamicBounds(bool enable, Box const* boneBoxes = nullptr) noexcept;
+
         /**
          * Controls if the renderable has vertex morphing targets, false by default.
          *
@@ -267,6 +347,31 @@ public:
          */
         Builder& morphing(bool enable) noexcept;
 
+        /**
+         * Draws this renderable instanceCount times with a single draw call per primitive, 1 by
+         * default.
+         *
+         * All instances share the renderable's world transform, material instances and
+         * per-renderable uniforms. The vertex shader can use getInstanceIndex() to tell the
+         * instances apart.
+         *
+         * When per-instance transforms are provided, they're expressed relative to the
+         * renderable's transform and are available to the vertex shader through
+         * getInstanceTransform(), typically applied in materialVertex(). In that case the
+         * bounding box given to boundingBox() is the bounding box of a single instance, and
+         * culling uses the union of all the transformed instance bounding boxes.
+         * Per-instance transforms can't be combined with skinning or morphing.
+         *
+         * See also RenderableManager::setInstanceTransforms(), which can be called on a
+         * per-frame basis.
+         *
+         * @param instanceCount number of instances to draw, between 1 and 65535. When transforms
+         *                      are provided, this is limited to 256.
+         * @param transforms    the initial set of per-instance transforms (one for each instance)
+         */
+        Builder& instances(size_t instanceCount, math::mat4f const* transforms) noexcept;
+        Builder& instances(size_t instanceCount) noexcept; //!< \overload
+
         /**
          * Sets an ordering index for blended primitives that all live at the same Z value.
          *
@@ -275,6 +380,24 @@ public:
          */
         Builder& blendOrder(size_t primitiveIndex, uint16_t order) noexcept;
 
+        /**
+         * Groups the primitives into levels of detail, only one of which is drawn. Each View
+         * picks the level of a renderable from the size of its bounding sphere on screen.
+         *
+         * The primitives of a level follow those of the previous level, so that the primitives
+         * of level 0 start at index 0. The levels must cover all the primitives and their
+         * screen sizes must decrease from one level to the next. By default all the primitives
+         * are in a single level.
+         *
+         * @param level          index of the level, 0 being the most detailed, up to 7.
+         * @param primitiveCount number of primitives in this level.
+         * @param screenSize     the level is drawn when the bounding sphere of the renderable is
+         *                       at least this fraction of the viewport height, and no previous
+         *                       level is. The last level is drawn when the renderable is smaller
+         *                       than all the screen sizes.
+         */
+        Builder& levelOfDetail(uint8_t level, size_t primitiveCount, float screenSize) noexcept;
+
         /**
          * Adds the Renderable component to an entity.
          *
@@ -297,11 +420,13 @@ public:
 
     private:
         friend class FEngine;
+        friend class FImpostor;
         friend class FRenderPrimitive;
         friend class FRenderableManager;
         struct Entry {
             VertexBuffer* vertices = nullptr;
             IndexBuffer* indices = nullptr;
+            VertexBuffer* depthVertices = nullptr;
             size_t offset = 0;
             size_t minIndex = 0;
             size_t maxIndex = 0;
@@ -400,6 +525,48 @@ public:
      */
     void setMorphWeights(Instance instance, math::float4 const& weights) noexcept;
 
+    /**
+     * Updates the weights of the morph targets in the range [offset, offset + count), all zeroes
+     * by default.
+     *
+     * The renderable must be built with Builder::computeMorphing().
+     */
+    void setMorphWeights(Instance instance, float const* weights, size_t count,
+            size_t offset = 0) noexcept;
+
+    /**
+     * Sets the deltas of a morph target of the given primitive. Only the vertices that the
+     * target moves need to be listed, each one at most once.
+     *
+     * The renderable must be built with Builder::computeMorphing(). The targets are kept when
+     * the geometry of the primitive changes, they must be set again if the vertices differ.
+     *
+     * @param instance       the renderable of interest
+     * @param primitiveIndex the primitive of interest, as indexed in the Builder
+     * @param targetIndex    the morph target, less than the count given to computeMorphing()
+     * @param vertices       the indices of the moved vertices in the vertex buffer
+     * @param positions      the position delta of each moved vertex
+     * @param normals        the normal delta of each moved vertex, or nullptr
+     * @param count          the number of moved vertices
+     */
+    void setMorphTargetAt(Instance instance, size_t primitiveIndex, size_t targetIndex,
+            uint32_t const* vertices, math::float3 const* positions, math::float3 const* normals,
+            size_t count) noexcept;
+
+    /**
+     * Updates the per-instance transforms in the range [offset, offset + count).
+     * The transforms must be pre-allocated using Builder::instances().
+     */
+    void setInstanceTransforms(Instance instance, math::mat4f const* transforms,
+            size_t count = 1, size_t offset = 0) noexcept;
+
+    /**
+     * Gets the number of instances drawn for this renderable.
+     *
+     * \see Builder::instances()
+     */
+    size_t getInstanceCount(Instance instance) const noexcept;
+
     /**
      * Gets the bounding box used for frustum culling.
      *
@@ -418,10 +585,18 @@ public:
     uint8_t getLayerMask(Instance instance) const noexcept;
 
     /**
-     * Gets the immutable number of primitives in the given renderable.
+     * Gets the immutable number of primitives in the given renderable, across all its levels of
+     * detail. Primitives are indexed as in the Builder.
      */
     size_t getPrimitiveCount(Instance instance) const noexcept;
 
+    /**
+     * Gets the number of levels of detail of the given renderable, 1 if it has none.
+     *
+     * \see Builder::levelOfDetail()
+     */
+    size_t getLevelOfDetailCount(Instance instance) const noexcept;
+
     /**
      * Changes the material instance binding for the given primitive.
      *
@@ -436,9 +611,10 @@ public:
     MaterialInstance* getMaterialInstanceAt(Instance instance, size_t primitiveIndex) const noexcept;
 
     /**
-     * Changes the geometry for the given primitive.
+     * Changes the geometry for the given primitive. The depth vertices of the primitive, if
+     * any, are removed.
      *
-     * \see Builder::geometry()
+     * \see Builder::geometry(), Builder::depthGeometry()
      */
     void setGeometryAt(Instance instance, size_t primitiveIndex,
             PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
@@ -24,6 +24,7 @@
 #include <utils/compiler.h>
 
 #include <backend/PresentCallable.h>
+#include <backend/PixelBufferDescriptor.h>
 #include <backend/DriverEnums.h>
 
 #include <math/vec4.h>
@@ -87,6 +88,26 @@ public:
         uint64_t vsyncOffsetNanos = 0;
     };
 
+    /**
+     * Controllers computing the dynamic resolution scale from the frame timings.
+     * @see FrameRateOptions
+     */
+    enum class ResolutionController : uint8_t {
+        /**
+         * Scales the resolution with a PID controller on the GPU time of whole frames.
+         */
+        PID,
+        /**
+         * Predicts the GPU time of the next frames from the time of the last frame measured, at
+         * the resolution it was rendered at, so the latency of the measurements doesn't cause
+         * oscillations. The passes whose cost doesn't depend on the resolution (e.g. shadow maps)
+         * are accounted for when they're timed (see setFrameTimingsCallback()). The resolution is
+         * only lowered when the GPU is the bottleneck, as predicted from the CPU time of the
+         * frames.
+         */
+        PREDICTIVE
+    };
+
     /**
      * Use FrameRateOptions to set the desired frame rate and control how quickly the system
      * reacts to GPU load changes.
@@ -104,6 +125,7 @@ public:
      *            This value can be computed as 1 / N, where N is the number of frames
      *            needed to reach 64% of the target scale factor.
      *            Higher values make the dynamic resolution react faster.
+     * controller: how the scale is computed from the frame timings
      *
      * @see View::DynamicResolutionOptions
      * @see Renderer::DisplayInfo
@@ -114,6 +136,16 @@ public:
         float scaleRate = 0.125f;      //!< rate at which the system reacts to load changes
         uint8_t history = 3;           //!< history size
         uint8_t interval = 1;          //!< desired frame interval in unit of 1.0 / DisplayInfo::refreshRate
+        ResolutionController controller = ResolutionController::PID; //!< dynamic resolution controller
+
+        /**
+         * When the GPU is behind, lets up to 3 frames be in flight instead of skipping frames,
+         * and goes back to Engine::Config::frameLatency once the GPU has caught up.
+         * If beginFrame() is given the vsync time and the DisplayInfo has a refresh rate, the
+         * frames are also scheduled for presentation that many refresh periods later, on
+         * platforms that support it (Android).
+         */
+        bool adaptiveLatency = false;
     };
 
     /**
@@ -135,6 +167,35 @@ public:
         bool discard = true;
     };
 
+    /**
+     * Timings of a frame, reported to a FrameTimingsCallback once the GPU is done with it,
+     * i.e. usually a few frames after it was rendered.
+     *
+     * CPU times are the time the thread spent running, not waiting. GPU times are precise only
+     * when the backend supports timer queries, e.g. with EXT_disjoint_timer_query on OpenGL ES.
+     *
+     * @see setFrameTimingsCallback()
+     */
+    struct FrameTimings {
+        /** GPU time of a pass of the frame, e.g. "Shadow Pass", "SSAO Pass" or "TAA". */
+        struct Pass {
+            const char* name;           //!< name of the pass, a string literal
+            uint64_t gpuTimeNs;         //!< time taken by the GPU to execute the pass
+        };
+        uint32_t frameId;               //!< frame number, as counted by beginFrame()
+        uint64_t mainThreadTimeNs;      //!< CPU time of the main thread, beginFrame() to endFrame()
+        uint64_t driverThreadTimeNs;    //!< CPU time of the driver thread running the frame
+        uint64_t gpuTimeNs;             //!< sum of the GPU time of the passes
+        Pass const* passes;             //!< passes of all the Views, in execution order
+        size_t passCount;               //!< number of passes
+    };
+
+    /**
+     * Receives the timings of a frame on the main thread, from beginFrame(). \p timings is only
+     * valid during the call.
+     */
+    using FrameTimingsCallback = void(*)(FrameTimings const& timings, void* user);
+
     /**
      * Information about the display this Renderer is associated to. This information is needed
      * to accurately compute dynamic-resolution scaling and for frame-pacing.
@@ -152,6 +213,20 @@ public:
      */
     void setClearOptions(const ClearOptions& options);
 
+    /**
+     * Sets a callback receiving the CPU and per-pass GPU timings of the frames, or nullptr to
+     * stop timing them.
+     *
+     * Timing the passes has a small cost on the GPU. While they are timed, the GPU frame time
+     * used by dynamic resolution is the sum of the time of the passes.
+     *
+     * @param callback  Called with the timings of each frame, or nullptr.
+     * @param user      User data passed to \p callback.
+     *
+     * @see FrameTimings
+     */
+    void setFrameTimingsCallback(FrameTimingsCallback callback, void* user = nullptr) noexcept;
+
     /**
      * Get the Engine that created this Renderer.
      *
@@ -224,6 +299,29 @@ public:
      */
     void render(View const* view);
 
+    /**
+     * Renders a View into its RenderTarget, outside of beginFrame() / endFrame(). This is meant
+     * for offline rendering, e.g. of many thumbnails per second: there is no SwapChain to
+     * present and frames are never skipped, the CPU only waits for the GPU when the command
+     * buffer is full. Typically, each call is followed by readPixels() on the View's
+     * RenderTarget, whose callbacks are invoked as the read-backs complete.
+     *
+     * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+     * for (size_t i = 0; i < count; i++) {
+     *     renderer->renderStandaloneView(views[i]);
+     *     renderer->readPixels(views[i]->getRenderTarget(), 0, 0, width, height, std::move(buffers[i]));
+     * }
+     * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+     *
+     * @param view A pointer to the view to render, it must have a RenderTarget.
+     *
+     * @attention
+     * renderStandaloneView() must be called *outside* of beginFrame() / endFrame().
+     *
+     * @see View::setRenderTarget(), Engine::Config::frameLatency
+     */
+    void renderStandaloneView(View const* view);
+
     /**
      * Flags used to configure the behavior of copyFrame().
      *
@@ -326,7 +424,9 @@ public:
      * It is also possible to use a Fence to wait for the read-back.
      *
      * @remark
-     * readPixels() is intended for debugging and testing. It will impact performance significantly.
+     * readPixels() doesn't wait for the GPU: on OpenGL the pixels are copied into a GPU buffer,
+     * taken from a pool, which is mapped once a fence signals. Still, each read-back is a copy of
+     * the render target and can impact performance.
      *
      */
     void readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
@@ -386,13 +486,40 @@ public:
      * It is also possible to use a Fence to wait for the read-back.
      *
      * @remark
-     * readPixels() is intended for debugging and testing. It will impact performance significantly.
+     * readPixels() doesn't wait for the GPU: on OpenGL the pixels are copied into a GPU buffer,
+     * taken from a pool, which is mapped once a fence signals. Still, each read-back is a copy of
+     * the render target and can impact performance.
      *
      */
     void readPixels(RenderTarget* renderTarget,
             uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
             backend::PixelBufferDescriptor&& buffer);
 
+    /**
+     * A read-back of a sub-region of a RenderTarget.
+     * @see readPixels(ReadPixelsRequest*, size_t)
+     */
+    struct ReadPixelsRequest {
+        RenderTarget* renderTarget = nullptr;   //!< RenderTarget to read back from, nullptr for the SwapChain
+        uint32_t xoffset = 0;                   //!< Left offset of the sub-region to read back
+        uint32_t yoffset = 0;                   //!< Bottom offset of the sub-region to read back
+        uint32_t width = 0;                     //!< Width of the sub-region to read back
+        uint32_t height = 0;                    //!< Height of the sub-region to read back
+        backend::PixelBufferDescriptor buffer;  //!< Client-side buffer where the read-back will be written
+    };
+
+    /**
+     * Reads back several RenderTargets, or the SwapChain, at once. This is equivalent to calling
+     * readPixels() for each request, e.g. to read back all the thumbnails rendered in a frame.
+     *
+     * @param requests  The read-backs to perform. Their buffers are moved from, and the callback
+     *                  of each buffer is invoked on the main thread when its read-back completes.
+     * @param count     Number of requests.
+     *
+     * @see readPixels(RenderTarget*, uint32_t, uint32_t, uint32_t, uint32_t, backend::PixelBufferDescriptor&&)
+     */
+    void readPixels(ReadPixelsRequest* requests, size_t count);
+
     /**
      * Set-up a frame for this Renderer.
      *
@@ -19,10 +19,15 @@
 #ifndef TNT_FILAMENT_SCENE_H
 #define TNT_FILAMENT_SCENE_H
 
+#include <filament/Box.h>
 #include <filament/FilamentAPI.h>
 
 #include <utils/compiler.h>
 
+#include <math/vec3.h>
+
+#include <stdint.h>
+
 namespace utils {
     class Entity;
 } // namespace utils
@@ -156,6 +161,86 @@ public:
      * @return Whether the given entity is in the Scene.
      */
     bool hasEntity(utils::Entity entity) const noexcept;
+
+    /**
+     * Enables or disables hierarchical culling.
+     *
+     * When enabled, the Scene maintains a bounding volume hierarchy of its Renderable objects,
+     * which allows culling to reject whole groups of objects at once. The hierarchy is
+     * refit when objects move, and rebuilt when objects are added or removed.
+     *
+     * This is beneficial for scenes with a large number of mostly static objects, but has an
+     * overhead for scenes which change often. Disabled by default.
+     *
+     * @param enabled true to enable hierarchical culling, false otherwise.
+     */
+    void setHierarchicalCullingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether hierarchical culling is enabled.
+     *
+     * @return true if hierarchical culling is enabled, false otherwise.
+     */
+    bool isHierarchicalCullingEnabled() const noexcept;
+
+    /**
+     * Cell value meaning "no cell", see setCell().
+     */
+    static constexpr uint32_t NO_CELL = 0xFFFFFFFFu;
+
+    /**
+     * Adds a cell to the Scene's cell-and-portal visibility structure.
+     *
+     * Cells partition an indoor scene, typically one cell per room, and are connected by
+     * portals (see addPortal()). When the camera is inside a cell, only the cells that can be
+     * seen from it through a chain of portals are visible, and the Renderable objects assigned
+     * to the other cells are culled (see setCell()). When the camera is outside all cells,
+     * e.g. outdoors, cells don't affect culling.
+     *
+     * Only the camera culling is affected, objects in hidden cells still cast shadows.
+     *
+     * @param bounds World-space bounds of the cell. Cells can overlap, e.g. around a door.
+     * @return The index of the new cell, used by addPortal() and setCell().
+     */
+    uint32_t addCell(Box const& bounds) noexcept;
+
+    /**
+     * Adds a portal between two cells, through which each cell can see into the other.
+     *
+     * @param cellA     Index of one of the cells the portal connects, as returned by addCell().
+     * @param cellB     Index of the other cell.
+     * @param vertices  World-space vertices of the portal, a convex planar polygon e.g. the
+     *                  opening of a door or of a window, in clockwise or counter-clockwise order.
+     * @param count     Number of vertices, between 3 and 8.
+     */
+    void addPortal(uint32_t cellA, uint32_t cellB, math::float3 const* vertices, size_t count);
+
+    /**
+     * Assigns the Renderable of an Entity to a cell.
+     *
+     * The Renderable is culled when its cell isn't visible from the camera, whether or not it
+     * is in the view frustum. A Renderable which is not assigned to a cell, e.g. a large object
+     * spanning several cells, is culled by the frustum only.
+     *
+     * The assignment is dropped when the Entity is removed from the Scene.
+     *
+     * @param entity    An Entity of the Scene.
+     * @param cell      Index of the cell as returned by addCell(), or NO_CELL to remove the
+     *                  Entity from its cell.
+     */
+    void setCell(utils::Entity entity, uint32_t cell);
+
+    /**
+     * Removes all cells and portals, and all the cell assignments.
+     */
+    void clearCells() noexcept;
+
+    /**
+     * Returns the number of cells added with addCell().
+     *
+     * @return The number of cells of the Scene.
+     */
+    size_t getCellCount() const noexcept;
 };
 
 } // namespace filament
@@ -125,6 +125,11 @@ public:
      *
      * This method should be called on the same thread that calls Renderer::beginFrame, which is
      * also where the callback is invoked.
+     *
+     * The image is an EGLImageKHR with OpenGL, an AHardwareBuffer with Vulkan (only RGB formats
+     * are supported) and a CVPixelBufferRef with Metal. With Vulkan and Metal the image is
+     * sampled without being copied, and the callback is invoked once the GPU has finished with
+     * the frames that use it.
      */
     void setAcquiredImage(void* image, Callback callback, void* userdata) noexcept;
 
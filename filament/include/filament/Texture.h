@@ -25,6 +25,8 @@
 
 #include <utils/compiler.h>
 
+#include <math/vec3.h>
+
 #include <stddef.h>
 
 namespace filament {
@@ -81,10 +83,22 @@ public:
 
     static bool isTextureFormatSupported(Engine& engine, InternalFormat format) noexcept;
 
+    //! Whether generateMipmaps() can be used with textures of the given format.
+    static bool isTextureFormatMipmappable(Engine& engine, InternalFormat format) noexcept;
+
     static size_t computeTextureDataSize(Texture::Format format, Texture::Type type,
             size_t stride, size_t height, size_t alignment) noexcept;
 
 
+    /**
+     * Callback reporting the progress of generatePrefilterMipmap(), it's called on the
+     * application thread each time mipmap levels are uploaded. \p progress is the fraction of the
+     * levels uploaded, 1 means the reflection map is complete.
+     *
+     * @see PrefilterOptions
+     */
+    using PrefilterCallback = void(*)(Texture* texture, float progress, void* user);
+
     /**
      * Options for environment prefiltering into reflection map
      *
@@ -93,11 +107,25 @@ public:
     struct UTILS_PUBLIC PrefilterOptions {
         uint16_t sampleCount = 8;   //!< sample count used for filtering
         bool mirror = true;         //!< whether the environment must be mirrored
+        bool async = false;         //!< whether the CPU prefiltering runs in background jobs
+        PrefilterCallback callback = nullptr;   //!< reports the progress, can be null
+        void* user = nullptr;                   //!< user data passed to callback
     private:
-        UTILS_UNUSED uintptr_t reserved[3] = {};
+        UTILS_UNUSED uintptr_t reserved[1] = {};
     };
 
 
+    /**
+     * Callback requesting a level of a streamed texture, it's called on the application thread
+     * during Renderer::beginFrame(). The application must eventually provide the level with
+     * setImage(), either right away or later, e.g. once it's read from storage. The level is
+     * requested again each time the texture is reallocated. The callback must not destroy
+     * textures.
+     *
+     * @see Builder::streaming()
+     */
+    using StreamingCallback = void(*)(Texture* texture, size_t level, void* user);
+
     //! Use Builder to construct a Texture object instance
     class Builder : public BuilderBase<BuilderDetails> {
         friend struct BuilderDetails;
@@ -185,6 +213,25 @@ public:
          */
         Builder& swizzle(Swizzle r, Swizzle g, Swizzle b, Swizzle a) noexcept;
 
+        /**
+         * Makes the texture streamed: only the levels needed to render the visible objects at
+         * their size on screen are resident on the GPU, within the budget set by
+         * Engine::Config::textureStreamingBudgetMB.
+         *
+         * The levels are requested from \p callback as needed, coarsest first, and the shaders
+         * sample the finest level uploaded so far. The levels up to 128 texels are always
+         * resident. The size on screen assumes the texture covers its renderable once.
+         *
+         * A streamed texture must be a Sampler::SAMPLER_2D with the Usage::DEFAULT usage, and
+         * its levels must be set whole with setImage(). It can't be swizzled or imported.
+         *
+         * @param callback  requests levels of the texture
+         * @param user      user data passed to \p callback
+         * @return This Builder, for chaining calls.
+         * @see StreamingCallback
+         */
+        Builder& streaming(StreamingCallback callback, void* user = nullptr) noexcept;
+
         /**
          * Creates the Texture object and returns a pointer to it.
          *
@@ -486,8 +533,12 @@ public:
      *
      * The reflections cubemap's dimension must be a power-of-two.
      *
-     * @warning This operation is computationally intensive, especially with large environments and
-     *          is currently synchronous. Expect about 1ms for a 16x16 cubemap.
+     * @warning This operation is computationally intensive, especially with large environments.
+     *          Expect about 1ms for a 16x16 cubemap. It's synchronous unless
+     *          PrefilterOptions::async is set, in which case the prefiltering runs in low priority
+     *          jobs of the engine and each mipmap level is uploaded as soon as it's ready, during
+     *          the following frames. PrefilterOptions::callback reports when it's complete, until
+     *          then the previous reflection map can be kept in use.
      *
      * @param engine        Reference to the filament::Engine to associate this IndirectLight with.
      * @param buffer        Client-side buffer containing the images to set.
@@ -501,6 +552,61 @@ public:
     void generatePrefilterMipmap(Engine& engine,
             PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
             PrefilterOptions const* options = nullptr);
+
+    /**
+     * Populates all the mipmap levels of this texture with the prefiltered reflections of an
+     * environment cubemap that's already on the GPU, e.g. rendered at runtime.
+     *
+     * This is the GPU version of the method above: the filtering is done with render passes,
+     * which are executed during the next frame (i.e. by the next successful
+     * Renderer::beginFrame()). The texture's content is undefined until then. If either texture
+     * is destroyed before then, nothing is done. PrefilterOptions::async is ignored, the
+     * callback is called once the render passes are issued.
+     *
+     * The environment must obey to some constraints:
+     *   - it must be a cubemap, different from this texture
+     *   - all of its mipmap levels must be populated (e.g. with generateMipmaps()), they are
+     *     used to filter with few samples
+     *
+     * The current texture must be a cubemap with a power-of-two dimension, an uncompressed
+     * color-renderable internal format and the Usage::COLOR_ATTACHMENT usage.
+     *
+     * @param engine        Reference to the filament::Engine this texture is associated with.
+     * @param environment   Environment cubemap to filter.
+     * @param options       Optional parameter to controlling user-specified quality and options.
+     *
+     * @exception utils::PreConditionPanic if the constraints are not respected.
+     */
+    void generatePrefilterMipmap(Engine& engine, Texture const* environment,
+            PrefilterOptions const* options = nullptr);
+
+    /**
+     * Callback receiving the 9 spherical harmonics coefficients computed by computeIrradianceSH().
+     * They're ready to be used with IndirectLight::Builder::irradiance(3, sh).
+     */
+    using SphericalHarmonicsCallback = void(*)(math::float3 const* sh, void* user);
+
+    /**
+     * Computes the irradiance of this environment cubemap as 3 bands of spherical harmonics,
+     * on the GPU. This avoids reading the environment back, e.g. when it's rendered at runtime.
+     *
+     * The projection is done during the next frame (i.e. by the next successful
+     * Renderer::beginFrame()), the result is read back and delivered asynchronously to
+     * \p callback on the application thread. If this texture is destroyed before the projection
+     * is done, the callback is not called.
+     *
+     * This texture must be a cubemap with all its mipmap levels populated, they're used to
+     * reduce the cost of the integration. Only PrefilterOptions::mirror is used.
+     *
+     * @param engine    Reference to the filament::Engine this texture is associated with.
+     * @param callback  Called with the 9 coefficients, which are only valid during the call.
+     * @param user      User data passed to \p callback.
+     * @param options   Optional parameter to controlling user-specified quality and options.
+     *
+     * @exception utils::PreConditionPanic if the constraints are not respected.
+     */
+    void computeIrradianceSH(Engine& engine, SphericalHarmonicsCallback callback, void* user,
+            PrefilterOptions const* options = nullptr) const;
 };
 
 } // namespace filament
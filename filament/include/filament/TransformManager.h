@@ -247,6 +247,53 @@ public:
      * @see openLocalTransformTransaction(), setTransform()
      */
     void commitLocalTransformTransaction() noexcept;
+
+    /**
+     * Enables or disables the snapshot mode, which is disabled by default.
+     *
+     * In snapshot mode, rendering uses the world transforms as they were when commitSnapshot()
+     * was last called, instead of the current ones. So the application can simulate the next
+     * frame on another thread while Renderer::render() culls and records the current one:
+     *
+     * \code
+     * tcm.setSnapshotEnabled(true);
+     * ...
+     * tcm.commitSnapshot();
+     * std::thread simulation([&]() { simulate(tcm); });
+     * renderer->render(view);
+     * simulation.join();
+     * \endcode
+     *
+     * While rendering, the other thread may only call setTransform(), getTransform() and
+     * getWorldTransform() of components that already exist, or use a local transform
+     * transaction that doesn't change the hierarchy (large ones run on the Engine's JobSystem,
+     * see JobSystem::adopt()). Creating, destroying and re-parenting components, and using the
+     * other managers, must still be done on the Engine's thread while it isn't rendering.
+     *
+     * The getters of Camera return the transform rendering uses.
+     *
+     * Enabling the snapshot mode commits a snapshot.
+     *
+     * @param enabled true to render the world transforms of the last commitSnapshot()
+     * @see commitSnapshot()
+     */
+    void setSnapshotEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether the snapshot mode is enabled.
+     * @see setSnapshotEnabled()
+     */
+    bool isSnapshotEnabled() const noexcept;
+
+    /**
+     * Makes the current world transforms the ones rendering uses in snapshot mode. This must be
+     * called on the Engine's thread between frames, while no other thread sets transforms.
+     * Components created afterwards are rendered with the world transform they're created with,
+     * until the next commit.
+     *
+     * @see setSnapshotEnabled()
+     */
+    void commitSnapshot() noexcept;
 };
 
 } // namespace filament
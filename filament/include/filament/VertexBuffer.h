@@ -127,6 +127,16 @@ public:
          */
         Builder& normalized(VertexAttribute attribute, bool normalize = true) noexcept;
 
+        /**
+         * Declares that the content of the buffers is replaced every frame, e.g. for particles
+         * or lines. The backend then optimizes for frequent updates, which are best written with
+         * mapBufferAt().
+         *
+         * @param enabled true to make the buffers streaming, the default is false.
+         * @return A reference to this Builder for chaining calls.
+         */
+        Builder& streaming(bool enabled = true) noexcept;
+
         /**
          * Creates the VertexBuffer object and returns a pointer to it.
          *
@@ -166,6 +176,29 @@ public:
     void setBufferAt(Engine& engine, uint8_t bufferIndex, BufferDescriptor&& buffer,
             uint32_t byteOffset = 0);
 
+    /**
+     * Updates part of a buffer with data the client writes directly to the returned memory,
+     * instead of passing a BufferDescriptor. The memory is owned by the Engine and recycled
+     * once the update is done, so there is no allocation per update.
+     *
+     * The memory must be fully written before the commands of the Engine are flushed, i.e.
+     * before the next call to Renderer::render(), Renderer::endFrame(), Engine::flush() or
+     * Engine::flushAndWait(). It must not be accessed afterwards.
+     *
+     * @param engine Reference to the filament::Engine to associate this VertexBuffer with.
+     * @param bufferIndex Index of the buffer to update. Must be between 0
+     *                    and Builder::bufferCount() - 1.
+     * @param byteCount Size in *bytes* of the update.
+     * @param byteOffset Offset in *bytes* into the buffer at index \p bufferIndex of this vertex
+     *                   buffer set.
+     * @return A pointer to \p byteCount bytes to write the data to, or nullptr if \p bufferIndex
+     *         is out of range or \p byteCount is 0.
+     *
+     * @see Builder::streaming()
+     */
+    void* mapBufferAt(Engine& engine, uint8_t bufferIndex, uint32_t byteCount,
+            uint32_t byteOffset = 0);
+
     /**
      * Specifies the quaternion type for the "populateTangentQuaternions" utility.
      */
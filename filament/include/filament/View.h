@@ -25,8 +25,10 @@
 #include <backend/DriverEnums.h>
 
 #include <utils/compiler.h>
+#include <utils/Entity.h>
 
 #include <math/mathfwd.h>
+#include <math/vec3.h>
 
 namespace filament {
 
@@ -91,6 +93,10 @@ public:
      * maxScale:  the maximum scale in X and Y this View should use
      * quality:   upscaling quality.
      *            LOW: 1 bilinear tap, Medium: 4 bilinear taps, High: 9 bilinear taps (tent)
+     * scaleStep: when not 0, the scale factors are multiples of this step (e.g. 1/16), and only
+     *            change once the scale needed is well past the current step. The buffers of
+     *            the View then take a few sizes only and can be reused from frame to frame.
+     *            By default the sizes are multiples of 8 pixels.
      *
      * \note
      * Dynamic resolution is only supported on platforms where the time to render
@@ -106,6 +112,7 @@ public:
         bool enabled = false;                           //!< enable or disable dynamic resolution
         bool homogeneousScaling = false;                //!< set to true to force homogeneous scaling
         QualityLevel quality = QualityLevel::LOW;       //!< Upscaling quality
+        float scaleStep = 0.0f;                         //!< step between the scale factors, or 0
     };
 
     /**
@@ -192,6 +199,22 @@ public:
         bool enabled = false;                       //!< enables or disables the vignette effect
     };
 
+    /**
+     * Options to control foveated rendering, where the shading rate of the color pass decreases
+     * away from a focal point, e.g. in the periphery of a VR headset's lenses.
+     *
+     * Foveation is applied by the backend when it supports it (currently OpenGL ES with
+     * GL_QCOM_framebuffer_foveated), and ignored otherwise.
+     *
+     * @see setFoveationOptions(), Material::isFoveationEnabled()
+     */
+    struct FoveationOptions {
+        math::float2 center = { 0.0f, 0.0f };   //!< focal point in the viewport, in NDC (-1 to 1)
+        math::float2 gain = { 2.0f, 2.0f };     //!< how fast the resolution decreases away from the focal point, horizontally and vertically
+        float area = 0.1f;                      //!< size of the full resolution area around the focal point, in NDC
+        bool enabled = false;                   //!< enables or disables foveated rendering
+    };
+
     /**
      * Structure used to set the precision of the color buffer and related quality settings.
      *
@@ -218,9 +241,13 @@ public:
         float radius = 0.3f;    //!< Ambient Occlusion radius in meters, between 0 and ~10.
         float power = 1.0f;     //!< Controls ambient occlusion's contrast. Must be positive.
         float bias = 0.0005f;   //!< Self-occlusion bias in meters. Use to avoid self-occlusion. Between 0 and a few mm.
-        float resolution = 0.5f;//!< How each dimension of the AO buffer is scaled. Must be either 0.5 or 1.0.
+        float resolution = 0.5f;//!< How each dimension of the AO buffer is scaled. Must be either 0.25, 0.5 or 1.0.
         float intensity = 1.0f; //!< Strength of the Ambient Occlusion effect.
-        QualityLevel quality = QualityLevel::LOW; //!< affects # of samples used for AO.
+        /**
+         * affects # of samples used for AO. With TAA enabled, the samples change every frame and
+         * are accumulated by TAA, so a lower quality is usually enough.
+         */
+        QualityLevel quality = QualityLevel::LOW;
         QualityLevel lowPassFilter = QualityLevel::MEDIUM; //!< affects AO smoothness
         QualityLevel upsampling = QualityLevel::LOW; //!< affects AO buffer upsampling quality
         bool enabled = false;    //!< enables or disables screen-space ambient occlusion
@@ -245,12 +272,62 @@ public:
 
     /**
      * Options for Temporal Anti-aliasing (TAA)
-     * @see setTemporalAntiAliasingOptions()
+     *
+     * With upscaling, when dynamic resolution lowers the resolution of the view, TAA reconstructs
+     * the image at the output resolution instead of it being upscaled with a blit: the jitter
+     * sequence is longer so that it covers the output pixels, and the history is kept at the
+     * output resolution. The post-processing effects following TAA (depth of field, bloom, color
+     * grading) then run at the output resolution.
+     *
+     * @see setTemporalAntiAliasingOptions(), setDynamicResolutionOptions()
      */
     struct TemporalAntiAliasingOptions {
         float filterWidth = 1.0f;   //!< reconstruction filter width typically between 0 (sharper, aliased) and 1 (smoother)
         float feedback = 0.04f;     //!< history feedback, between 0 (maximum temporal AA) and 1 (no temporal AA).
         bool enabled = false;       //!< enables or disables temporal anti-aliasing
+        bool upscaling = false;     //!< with dynamic resolution, reconstructs the image at the output resolution
+    };
+
+    /**
+     * Options for Screen-space Reflections (SSR)
+     *
+     * Reflection rays are traced at half the resolution of the structure pass (see
+     * AmbientOcclusionOptions::resolution) through a hierarchical depth buffer, which skips the
+     * empty space in large steps. The rays that hit sample the previous frame's color, reprojected
+     * into the current frame, so the reflections appear one frame after the View starts rendering
+     * them. The reflections are exposed to the materials, which blend them over the reflections of
+     * the IndirectLight.
+     *
+     * @see setScreenSpaceReflectionsOptions()
+     */
+    struct ScreenSpaceReflectionsOptions {
+        float thickness = 0.1f;     //!< ray thickness, in world units
+        float bias = 0.01f;         //!< bias, in world units, to prevent self-intersections
+        float maxDistance = 3.0f;   //!< maximum distance, in world units, to trace
+        bool enabled = false;       //!< enables or disables screen-space reflections
+    };
+
+    /**
+     * Options for automatic exposure
+     *
+     * The exposure of the Camera is adjusted so that the average luminance of the scene matches
+     * the key value. The average is measured on the GPU from a histogram of the luminance of the
+     * color buffer, which ignores the darkest and the brightest pixels, and the exposure adapts
+     * to it over time. The compensation is never read back by the CPU: it's applied to the
+     * color buffer before bloom and color grading, so the Camera exposure remains the reference
+     * point and the limits of the compensation are relative to it.
+     *
+     * @see setAutoExposureOptions()
+     */
+    struct AutoExposureOptions {
+        float minCompensation = -4.0f;  //!< lowest exposure compensation, in EV
+        float maxCompensation = 4.0f;   //!< highest exposure compensation, in EV
+        float lowPercentile = 0.1f;     //!< fraction of the darkest pixels ignored, in [0, 1]
+        float highPercentile = 0.9f;    //!< fraction of the pixels brighter than this ignored
+        float key = 0.18f;              //!< target average luminance, middle gray by default
+        float speedUp = 3.0f;           //!< adaptation speed when the scene gets brighter, in 1/s
+        float speedDown = 1.0f;         //!< adaptation speed when the scene gets darker, in 1/s
+        bool enabled = false;           //!< enables or disables automatic exposure
     };
 
     /**
@@ -293,6 +370,16 @@ public:
          * @warning This API is still experimental and subject to change.
          */
         uint8_t anisotropy = 0;
+
+        /**
+         * Whether to store the moments in a 32-bit (RG32F) or a 16-bit (RG16F) texture. The 16-bit
+         * texture halves the memory and bandwidth of the shadow maps, but its lower precision can
+         * cause light leaks. The blur (see LightManager::ShadowOptions::vsm::blurWidth) biases the
+         * second moment to hide the rounding of the 16-bit texture.
+         *
+         * @warning This API is still experimental and subject to change.
+         */
+        bool highPrecision = true;
     };
 
     /**
@@ -409,6 +496,31 @@ public:
         return const_cast<View*>(this)->getCamera();
     }
 
+    /**
+     * Enables stereoscopic rendering by setting the Camera of the right eye. The Camera set with
+     * setCamera() is then the left eye's. Pass nullptr to disable stereoscopic rendering, which
+     * is the default.
+     *
+     * In stereo, each eye is rendered into one half of the viewport: the left eye in the left half
+     * and the right eye in the right half. The projections of both cameras must account for
+     * that aspect ratio. The renderables are culled once for both eyes, against a frustum that
+     * contains both frusta, and the rendering commands are generated once and issued for each
+     * eye. This halves the CPU cost compared to rendering each eye with its own View.
+     *
+     * @param camera The Camera of the right eye, or nullptr. The Camera must outlive the View
+     *               or be dissociated from it first.
+     *
+     * @note Shadows and the froxelization of the lights are computed for the left eye.
+     *       Ambient occlusion, temporal anti-aliasing, depth of field, screen space refraction and
+     *       the depth prepass are not supported in stereo and are turned off.
+     */
+    void setRightEyeCamera(Camera* camera) noexcept;
+
+    /**
+     * @return The Camera of the right eye, or nullptr if stereoscopic rendering is disabled.
+     */
+    Camera const* getRightEyeCamera() const noexcept;
+
     /**
      * Sets the blending mode used to draw the view into the SwapChain.
      *
@@ -487,6 +599,30 @@ public:
      */
     bool isScreenSpaceRefractionEnabled() const noexcept;
 
+    /**
+     * Enables or disables the depth prepass. Disabled by default.
+     *
+     * When enabled, the opaque and alpha-masked objects are first rendered in the depth buffer
+     * only, then the color pass shades them with an "equal" depth test and depth writes turned
+     * off, so that each pixel is shaded at most once. This trades a second geometry pass for
+     * less overdraw and pays off with expensive materials and scenes with a lot of depth
+     * complexity.
+     *
+     * When ambient occlusion is enabled at full resolution, without MSAA and contact shadows,
+     * the depth prepass is also used as the structure pass, which it then replaces.
+     *
+     * @param enabled true enables the depth prepass, false disables it.
+     *
+     * @note Materials that change the depth of their fragments, or whose depth test isn't the
+     *       default one, are rendered as usual in the color pass.
+     */
+    void setDepthPrepassEnabled(bool enabled) noexcept;
+
+    /**
+     * @return whether the depth prepass is enabled
+     */
+    bool isDepthPrepassEnabled() const noexcept;
+
     /**
      * Sets how many samples are to be used for MSAA in the post-process stage.
      * Default is 1 and disables MSAA.
@@ -583,6 +719,40 @@ public:
      */
     AmbientOcclusionOptions const& getAmbientOcclusionOptions() const noexcept;
 
+    /**
+     * Enables or disables screen-space reflections. Disabled by default.
+     *
+     * Screen-space reflections require the structure pass, the materials of this View lose one
+     * of their samplers to the reflections.
+     *
+     * @param options Options for screen-space reflections.
+     */
+    void setScreenSpaceReflectionsOptions(ScreenSpaceReflectionsOptions options) noexcept;
+
+    /**
+     * Returns screen-space reflections options.
+     *
+     * @return screen-space reflections options currently set.
+     */
+    ScreenSpaceReflectionsOptions const& getScreenSpaceReflectionsOptions() const noexcept;
+
+    /**
+     * Enables or disables automatic exposure in the post-processing stage. Disabled by default.
+     *
+     * Automatic exposure isn't applied when color grading is merged into the color pass, so it
+     * prevents that optimization.
+     *
+     * @param options Options for automatic exposure.
+     */
+    void setAutoExposureOptions(AutoExposureOptions options) noexcept;
+
+    /**
+     * Returns automatic exposure options.
+     *
+     * @return automatic exposure options currently set.
+     */
+    AutoExposureOptions const& getAutoExposureOptions() const noexcept;
+
     /**
      * Enables or disables bloom in the post-processing stage. Disabled by default.
      *
@@ -639,6 +809,25 @@ public:
      */
     VignetteOptions getVignetteOptions() const noexcept;
 
+    /**
+     * Enables or disables foveated rendering of the color pass. Disabled by default.
+     *
+     * The color pass isn't foveated when it draws a material that opts out of foveation,
+     * because the shading rate can't change within a pass with the supported backends.
+     * In stereo, the focal point is relative to each eye's half of the viewport.
+     *
+     * @param options options
+     * @see Material::isFoveationEnabled()
+     */
+    void setFoveationOptions(FoveationOptions options) noexcept;
+
+    /**
+     * Queries the foveation options.
+     *
+     * @return the current foveation options for this view.
+     */
+    FoveationOptions getFoveationOptions() const noexcept;
+
     /**
      * Enables or disables dithering in the post-processing stage. Enabled by default.
      *
@@ -784,6 +973,102 @@ public:
      */
     bool isFrontFaceWindingInverted() const noexcept;
 
+    /**
+     * Enables or disables occlusion culling. Disabled by default.
+     *
+     * When enabled, renderables hidden behind the opaque geometry rendered in a previous frame
+     * are not drawn. The depth of previous frames is read back asynchronously, so this only
+     * takes effect after a few frames, and is conservative: renderables can be drawn even
+     * though they're hidden, especially while the camera moves.
+     *
+     * Shadow casters are not affected. This is useful for dense scenes, e.g. interiors, where
+     * most renderables inside the frustum are occluded.
+     *
+     * @param enabled True to enable occlusion culling, false otherwise.
+     */
+    void setOcclusionCullingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether occlusion culling is enabled.
+     */
+    bool isOcclusionCullingEnabled() const noexcept;
+
+    /**
+     * Enables or disables temporal sorting. Disabled by default.
+     *
+     * When enabled, the draw commands of a frame are sorted starting from their order in the
+     * previous frame, which takes linear time when few of them change their place. This helps
+     * with mostly static cameras; after a cut or while the camera turns quickly, the commands
+     * are sorted from scratch as when this is disabled. This uses some memory per draw command.
+     *
+     * @param enabled True to enable temporal sorting, false otherwise.
+     */
+    void setTemporalSortingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether temporal sorting is enabled.
+     */
+    bool isTemporalSortingEnabled() const noexcept;
+
+    /**
+     * Enables or disables order-independent transparency. Disabled by default.
+     *
+     * When enabled, the objects using the TRANSPARENT or FADE blending modes are rendered
+     * unsorted, and only once regardless of their TransparencyMode, into intermediate buffers
+     * which are then composited over the color buffer (weighted blended order-independent
+     * transparency). This removes the cost of sorting them and of drawing them twice, which
+     * helps with many overlapping transparent objects such as foliage. The result is an
+     * approximation that is the most accurate when the overlapping layers have similar colors
+     * or low opacities.
+     *
+     * Refractive materials and the other blending modes are sorted as usual and rendered
+     * before the order-independent transparency is composited. This is ignored in stereo.
+     *
+     * @param enabled True to enable order-independent transparency, false otherwise.
+     */
+    void setOrderIndependentTransparencyEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether order-independent transparency is enabled.
+     */
+    bool isOrderIndependentTransparencyEnabled() const noexcept;
+
+    /**
+     * Result of a picking query, see pick().
+     */
+    struct PickingQueryResult {
+        //! Renderable visible at the picked pixel, or a null entity if there is none.
+        utils::Entity renderable{};
+        //! Value of the depth buffer at the picked pixel (reversed-z, 0 is the far plane).
+        float depth{};
+        //! Coordinates of the picked pixel in the viewport, and its depth.
+        math::float3 fragCoords{};
+    };
+
+    /**
+     * Callback of a picking query, called on the thread that drives the Engine (i.e. the one
+     * calling Renderer::beginFrame()).
+     */
+    using PickingQueryResultCallback = void(*)(PickingQueryResult const& result, void* user);
+
+    /**
+     * Queries which renderable is visible at a pixel of this View.
+     *
+     * The next frame rendering this View also renders the object ids of the visible renderables
+     * into a single texel covering the pixel, which is read back asynchronously: the callback is
+     * called a few frames later, and the GPU is never waited on. All the renderables can be
+     * picked, including the translucent ones, but the ones whose material has its own depth
+     * variants (e.g. alpha masked or with custom vertex code) are only found if it was built by
+     * this version of matc, without filtering out the fog variants.
+     *
+     * @param x         Horizontal coordinate of the pixel in the viewport, from the left.
+     * @param y         Vertical coordinate of the pixel in the viewport, from the bottom.
+     * @param callback  Called once with the result of the query.
+     * @param user      User data passed to \p callback.
+     */
+    void pick(uint32_t x, uint32_t y, PickingQueryResultCallback callback,
+            void* user = nullptr) noexcept;
+
     // for debugging...
 
     //! debugging: allows to entirely disable frustum culling. (culling enabled by default).
@@ -16,13 +16,16 @@
 
 #include <filament/Box.h>
 
+#include <math/simd.h>
+
 using namespace filament::math;
 
 namespace filament {
 
 Box rigidTransform(Box const& UTILS_RESTRICT box, const mat4f& UTILS_RESTRICT m) noexcept {
-    const mat3f u(m.upperLeft());
-    return { u * box.center + m[3].xyz, abs(u) * box.halfExtent };
+    Box result;
+    simd::rigidTransform(result.center, result.halfExtent, m, box.center, box.halfExtent);
+    return result;
 }
 
 Box rigidTransform(Box const& UTILS_RESTRICT box, const mat3f& UTILS_RESTRICT u) noexcept {
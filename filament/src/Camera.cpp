@@ -24,6 +24,7 @@
 #include <utils/Panic.h>
 
 #include <math/scalar.h>
+#include <math/simd.h>
 #include <filament/Exposure.h>
 
 using namespace filament::math;
@@ -165,13 +166,18 @@ void UTILS_NOINLINE FCamera::setModelMatrix(const mat4f& modelMatrix) noexcept {
     transformManager.setTransform(transformManager.getInstance(mEntity), modelMatrix);
 }
 
+void FCamera::setRootModelMatrix(const mat4f& modelMatrix) noexcept {
+    FTransformManager& transformManager = mEngine.getTransformManager();
+    transformManager.setRootTransform(transformManager.getInstance(mEntity), modelMatrix);
+}
+
 void FCamera::lookAt(const float3& eye, const float3& center, const float3& up) noexcept {
     setModelMatrix(mat4f::lookAt(eye, center, up));
 }
 
 mat4f const& FCamera::getModelMatrix() const noexcept {
     FTransformManager const& transformManager = mEngine.getTransformManager();
-    return transformManager.getWorldTransform(transformManager.getInstance(mEntity));
+    return transformManager.getRenderWorldTransform(transformManager.getInstance(mEntity));
 }
 
 mat4f UTILS_NOINLINE FCamera::getViewMatrix() const noexcept {
@@ -230,8 +236,8 @@ math::details::TMat44<T> inverseProjection(const math::details::TMat44<T>& p) no
 UTILS_NOINLINE
 mat4f FCamera::getViewMatrix(mat4f const& model) noexcept {
     // We can't use rigidTransformInverse here. The camera's model matrix might have scaling, which
-    // would make it non-rigid.
-    return inverse(model);
+    // would make it non-rigid, but it's always affine.
+    return simd::affineInverse(model);
 }
 
 Frustum FCamera::getFrustum(mat4 const& projection, mat4f const& viewMatrix) noexcept {
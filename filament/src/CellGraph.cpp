@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "details/CellGraph.h"
+
+#include <filament/Frustum.h>
+
+#include <utils/Systrace.h>
+
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <assert.h>
+
+using namespace filament::math;
+
+namespace filament {
+
+namespace {
+
+// below this distance from the plane of a portal, the frustum isn't narrowed to the portal
+constexpr float PORTAL_EPSILON = 1e-2f;
+
+// Clips a convex polygon by a plane, keeping what's behind it. The result has at most one
+// more vertex than the polygon, unless the polygon is (almost) in the plane.
+size_t clip(float3 const* UTILS_RESTRICT in, size_t count, float4 const& plane,
+        float3* UTILS_RESTRICT out) noexcept {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        float3 const& a = in[i];
+        float3 const& b = in[(i + 1) % count];
+        const float da = dot(plane.xyz, a) + plane.w;
+        const float db = dot(plane.xyz, b) + plane.w;
+        if (da <= 0) {
+            out[n++] = a;
+        }
+        if ((da > 0) != (db > 0)) {
+            out[n++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    return n;
+}
+
+} // anonymous namespace
+
+uint32_t CellGraph::addCell(Box const& bounds) noexcept {
+    mCells.push_back(bounds);
+    mCellPortals.emplace_back();
+    return uint32_t(mCells.size() - 1);
+}
+
+void CellGraph::addPortal(uint32_t cellA, uint32_t cellB,
+        float3 const* vertices, size_t count) noexcept {
+    assert(cellA < mCells.size() && cellB < mCells.size());
+    assert(count >= 3 && count <= MAX_PORTAL_VERTEX_COUNT);
+
+    Portal portal{};
+    float3 normal{};
+    float3 centroid{};
+    for (size_t i = 0; i < count; i++) {
+        normal += cross(vertices[i], vertices[(i + 1) % count]);
+        centroid += vertices[i];
+        portal.vertices[i] = vertices[i];
+    }
+    normal = normalize(normal);
+    centroid /= float(count);
+    portal.plane = float4{ normal, -dot(normal, centroid) };
+    portal.cells[0] = cellA;
+    portal.cells[1] = cellB;
+    portal.count = uint32_t(count);
+
+    const uint32_t index = uint32_t(mPortals.size());
+    mPortals.push_back(portal);
+    mCellPortals[cellA].push_back(index);
+    mCellPortals[cellB].push_back(index);
+}
+
+void CellGraph::clear() noexcept {
+    mCells.clear();
+    mCellPortals.clear();
+    mPortals.clear();
+    mVisible.clear();
+    mOnPath.clear();
+}
+
+bool CellGraph::update(float4 const planes[6], float3 const& eye, bool narrow) noexcept {
+    SYSTRACE_CALL();
+
+    const size_t count = mCells.size();
+    mVisible.assign(count, false);
+    mOnPath.assign(count, false);
+    mEye = eye;
+    mNarrow = narrow;
+    mFarPlane = planes[size_t(Frustum::Plane::FAR)];
+
+    Volume volume;
+    std::copy_n(planes, 6, volume.planes);
+    volume.count = 6;
+
+    // cells may overlap, e.g. around a door, the traversal starts from all those containing
+    // the eye
+    bool inside = false;
+    for (uint32_t i = 0; i < count; i++) {
+        const float3 d = abs(eye - mCells[i].center);
+        const float3 e = mCells[i].halfExtent;
+        if (d.x <= e.x && d.y <= e.y && d.z <= e.z) {
+            inside = true;
+            traverse(i, volume, 0);
+        }
+    }
+
+    if (!inside) {
+        mVisible.assign(count, true);
+    }
+    return inside;
+}
+
+void CellGraph::traverse(uint32_t cell, Volume const& volume, size_t depth) noexcept {
+    mVisible[cell] = true;
+    if (depth == MAX_DEPTH) {
+        return;
+    }
+
+    // a cell can be seen through several paths, but a path never loops
+    mOnPath[cell] = true;
+    Volume narrowed;
+    for (uint32_t p : mCellPortals[cell]) {
+        Portal const& portal = mPortals[p];
+        const uint32_t next = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+        if (!mOnPath[next] && narrow(portal, volume, narrowed)) {
+            traverse(next, narrowed, depth + 1);
+        }
+    }
+    mOnPath[cell] = false;
+}
+
+bool CellGraph::narrow(Portal const& portal, Volume const& volume,
+        Volume& result) const noexcept {
+    constexpr size_t CAPACITY = MAX_PORTAL_VERTEX_COUNT + MAX_PLANE_COUNT;
+    float3 buffers[2][CAPACITY];
+    float3* in = buffers[0];
+    float3* out = buffers[1];
+
+    // clip the portal by the frustum, if nothing is left the portal isn't visible
+    size_t n = portal.count;
+    std::copy_n(portal.vertices, n, in);
+    for (size_t j = 0; j < volume.count && n >= 3; j++) {
+        if (2 * n > CAPACITY) {
+            // degenerate clipping, what's left of the portal is large enough
+            break;
+        }
+        n = clip(in, n, volume.planes[j], out);
+        std::swap(in, out);
+    }
+    if (n < 3) {
+        return false;
+    }
+
+    // The frustum is kept as is when the eye is too close to the portal, e.g. walking through
+    // a door, or when the clipped portal has too many edges.
+    const float distance = dot(portal.plane.xyz, mEye) + portal.plane.w;
+    if (!mNarrow || std::abs(distance) < PORTAL_EPSILON || n + 2 > MAX_PLANE_COUNT) {
+        result = volume;
+        return true;
+    }
+
+    float3 centroid{};
+    for (size_t i = 0; i < n; i++) {
+        centroid += in[i];
+    }
+    centroid /= float(n);
+
+    // one plane through the eye and each edge of the clipped portal, facing outside
+    result.count = 0;
+    for (size_t i = 0; i < n; i++) {
+        const float3 a = in[i] - mEye;
+        const float3 b = in[(i + 1) % n] - mEye;
+        float3 normal = cross(a, b);
+        const float l = length(normal);
+        if (!(l > 1e-6f * length(a) * length(b))) {
+            // degenerate edge, skipping its plane only makes the frustum larger
+            continue;
+        }
+        normal /= l;
+        float4 plane{ normal, -dot(normal, mEye) };
+        if (dot(plane.xyz, centroid) + plane.w > 0) {
+            plane = -plane;
+        }
+        result.planes[result.count++] = plane;
+    }
+
+    // what's between the eye and the portal isn't seen through it
+    result.planes[result.count++] = distance < 0 ? -portal.plane : portal.plane;
+    result.planes[result.count++] = mFarPlane;
+    return true;
+}
+
+void CellGraph::cull(Culler::result_type* results, uint32_t const* cells,
+        uint32_t const* indices, size_t count, size_t bit) const noexcept {
+    const Culler::result_type mask = Culler::result_type(~(1u << bit));
+    for (size_t i = 0; i < count; i++) {
+        if (!isVisible(cells[indices[i]])) {
+            results[i] &= mask;
+        }
+    }
+}
+
+} // namespace filament
@@ -32,6 +32,7 @@
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
 #include <functional>
 
 #include <math.h>
@@ -46,64 +47,6 @@ using namespace backend;
 // Builder
 //------------------------------------------------------------------------------
 
-struct ColorGrading::BuilderDetails {
-    ColorGrading::QualityLevel quality = QualityLevel::MEDIUM;
-
-    ToneMapping toneMapping = ToneMapping::ACES_LEGACY;
-    // White balance
-    float2 whiteBalance     = {0.0f, 0.0f};
-    // Channel mixer
-    float3 outRed           = {1.0f, 0.0f, 0.0f};
-    float3 outGreen         = {0.0f, 1.0f, 0.0f};
-    float3 outBlue          = {0.0f, 0.0f, 1.0f};
-    // Tonal ranges
-    float3 shadows          = {1.0f, 1.0f, 1.0f};
-    float3 midtones         = {1.0f, 1.0f, 1.0f};
-    float3 highlights       = {1.0f, 1.0f, 1.0f};
-    float4 tonalRanges      = {0.0f, 0.333f, 0.550f, 1.0f}; // defaults in DaVinci Resolve
-    // ASC CDL
-    float3 slope            = {1.0f};
-    float3 offset           = {0.0f};
-    float3 power            = {1.0f};
-    // Color adjustments
-    float  contrast         = 1.0f;
-    float  vibrance         = 1.0f;
-    float  saturation       = 1.0f;
-    // Curves
-    float3 shadowGamma      = {1.0f};
-    float3 midPoint         = {1.0f};
-    float3 highlightScale   = {1.0f};
-    // Keep last
-    bool hasAdjustments     = false;
-
-    bool operator!=(const BuilderDetails &rhs) const {
-        return !(rhs == *this);
-    }
-
-    bool operator==(const BuilderDetails &rhs) const {
-        // Note: Do NOT compare hasAdjustments
-        return quality == rhs.quality &&
-               toneMapping == rhs.toneMapping &&
-               whiteBalance == rhs.whiteBalance &&
-               outRed == rhs.outRed &&
-               outGreen == rhs.outGreen &&
-               outBlue == rhs.outBlue &&
-               shadows == rhs.shadows &&
-               midtones == rhs.midtones &&
-               highlights == rhs.highlights &&
-               tonalRanges == rhs.tonalRanges &&
-               slope == rhs.slope &&
-               offset == rhs.offset &&
-               power == rhs.power &&
-               contrast == rhs.contrast &&
-               vibrance == rhs.vibrance &&
-               saturation == rhs.saturation &&
-               shadowGamma == rhs.shadowGamma &&
-               midPoint == rhs.midPoint &&
-               highlightScale == rhs.highlightScale;
-    }
-};
-
 using BuilderType = ColorGrading;
 BuilderType::Builder::Builder() noexcept = default;
 BuilderType::Builder::~Builder() noexcept = default;
@@ -217,12 +160,14 @@ inline float3 adaptationTransform(float2 whiteBalance) {
     return ILLUMINANT_D65_LMS / lms;
 }
 
-UTILS_ALWAYS_INLINE
-inline float3 chromaticAdaptation(float3 v, float2 whiteBalance) {
-    v = sRGB_to_LMS * v;
-    v = adaptationTransform(whiteBalance) * v;
-    v = LMS_to_sRGB * v;
-    return v;
+inline mat3f chromaticAdaptation(float2 whiteBalance) {
+    // same as LMS_to_sRGB * diag(adaptationTransform(whiteBalance)) * sRGB_to_LMS
+    const float3 adaptation = adaptationTransform(whiteBalance);
+    mat3f m = sRGB_to_LMS;
+    for (size_t i = 0; i < 3; i++) {
+        m[i] *= adaptation;
+    }
+    return LMS_to_sRGB * m;
 }
 
 //------------------------------------------------------------------------------
@@ -346,10 +291,10 @@ inline float3 vibrance(float3 v, float vibrance) {
 }
 
 UTILS_ALWAYS_INLINE
-inline float3 curves(float3 v, float3 shadowGamma, float3 midPoint, float3 highlightScale) {
+inline float3 curves(float3 v, float3 shadowGamma, float3 shadowScale,
+        float3 midPoint, float3 highlightScale) {
     // "Practical HDR and Wide Color Techniques in Gran Turismo SPORT", Uchimura 2018
-    float3 d = 1.0f / (pow(midPoint, shadowGamma - 1.0f));
-    float3 dark = pow(v, shadowGamma) * d;
+    float3 dark = pow(v, shadowGamma) * shadowScale;
     float3 light = highlightScale * (v - midPoint) + midPoint;
     return float3{
         v.r <= midPoint.r ? dark.r : light.r,
@@ -427,35 +372,56 @@ ColorTransform selectToneMapping(ColorGrading::ToneMapping toneMapping) {
 // Color grading implementation
 //------------------------------------------------------------------------------
 
+// LUTs are at most 64x64x64 (see selectLutDimension())
+static constexpr size_t MAX_LUT_DIMENSION = 64;
+
 struct Config {
+    // includes the white balance when there are adjustments
     mat3f colorGradingTransformIn;
     mat3f colorGradingTransformOut;
     float3 lumaTransform;
+    float3 shadowScale;
     ColorTransform linearToLogTransform;
     ColorTransform logToLinearTransform;
     ColorTransform toneMapper;
     size_t lutDimension;
+    // LogC decoding is done per channel, so it's evaluated once per coordinate of the LUT
+    float linear[MAX_LUT_DIMENSION];
 };
 
-// Inside the FColorGrading constructor, TSAN sporadically detects a data race on the config struct;
-// the Filament thread writes and the Job thread reads. In practice there should be no data race, so
-// we force TSAN off to silence the warning.
+// Inside generateLut(), TSAN sporadically detects a data race on the config struct; the Filament
+// thread writes and the Job thread reads. In practice there should be no data race, so we force
+// TSAN off to silence the warning.
 UTILS_NO_SANITIZE_THREAD
-FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
+TextureHandle FColorGrading::generateLut(FEngine& engine, BuilderDetails const& builder) {
     SYSTRACE_CALL();
 
     DriverApi& driver = engine.getDriverApi();
 
     Config config{
-        .colorGradingTransformIn  = selectColorGradingTransformIn(builder->toneMapping),
-        .colorGradingTransformOut = selectColorGradingTransformOut(builder->toneMapping),
-        .lumaTransform            = selectLumaTransform(builder->toneMapping),
-        .linearToLogTransform     = selectLinearToLogTransform(builder->toneMapping),
-        .logToLinearTransform     = selectLogToLinearTransform(builder->toneMapping),
-        .toneMapper               = selectToneMapping(builder->toneMapping),
-        .lutDimension             = selectLutDimension(builder->quality)
+        .colorGradingTransformIn  = selectColorGradingTransformIn(builder.toneMapping),
+        .colorGradingTransformOut = selectColorGradingTransformOut(builder.toneMapping),
+        .lumaTransform            = selectLumaTransform(builder.toneMapping),
+        .shadowScale              = 1.0f / pow(builder.midPoint, builder.shadowGamma - 1.0f),
+        .linearToLogTransform     = selectLinearToLogTransform(builder.toneMapping),
+        .logToLinearTransform     = selectLogToLinearTransform(builder.toneMapping),
+        .toneMapper               = selectToneMapping(builder.toneMapping),
+        .lutDimension             = selectLutDimension(builder.quality)
     };
 
+    // TODO: Performed in sRGB, should be in Rec.2020 or AP1
+    if (builder.hasAdjustments) {
+        // White balance
+        config.colorGradingTransformIn =
+                config.colorGradingTransformIn * chromaticAdaptation(builder.whiteBalance);
+    }
+
+    assert(config.lutDimension <= MAX_LUT_DIMENSION);
+    for (size_t i = 0; i < config.lutDimension; i++) {
+        // LogC encoding
+        config.linear[i] = LogC_to_linear(float3{ float(i) / float(config.lutDimension - 1u) }).x;
+    }
+
     size_t lutElementCount = config.lutDimension * config.lutDimension * config.lutDimension;
     size_t elementSize = sizeof(half4);
     void* data = malloc(lutElementCount * elementSize);
@@ -463,10 +429,10 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
     TextureFormat textureFormat;
     PixelDataFormat format;
     PixelDataType type;
-    selectLutTextureParams(builder->quality, textureFormat, format, type);
-     assert(FTexture::validatePixelFormatAndType(textureFormat, format, type));
+    selectLutTextureParams(builder.quality, textureFormat, format, type);
+    assert(FTexture::validatePixelFormatAndType(textureFormat, format, type));
 
-     void* converted = nullptr;
+    void* converted = nullptr;
     if (type == PixelDataType::UINT_2_10_10_10_REV) {
         // convert input to UINT_2_10_10_10_REV if needed
         converted = malloc(lutElementCount * sizeof(uint32_t));
@@ -480,61 +446,54 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
     JobSystem& js = engine.getJobSystem();
     auto *slices = js.createJob();
     for (size_t b = 0; b < config.lutDimension; b++) {
-        auto *job = js.createJob(slices, [data, converted, b, &config, builder](JobSystem&, JobSystem::Job*) {
+        auto *job = js.createJob(slices, [data, converted, b, &config, &builder](JobSystem&, JobSystem::Job*) {
             half4* UTILS_RESTRICT p = (half4*) data + b * config.lutDimension * config.lutDimension;
+            mat3f const& transformIn = config.colorGradingTransformIn;
+            const float3 blue = transformIn[2] * config.linear[b];
             for (size_t g = 0; g < config.lutDimension; g++) {
+                // Convert to color grading color space. The transform is linear, so its green
+                // and blue terms are the same for the whole row.
+                const float3 greenBlue = transformIn[1] * config.linear[g] + blue;
                 for (size_t r = 0; r < config.lutDimension; r++) {
-                    float3 v = float3{ r, g, b } * (1.0f / float(config.lutDimension - 1u));
-
-                    // LogC encoding
-                    v = LogC_to_linear(v);
-
-                    // TODO: Performed in sRGB, should be in Rec.2020 or AP1
-                    if (builder->hasAdjustments) {
-                        // White balance
-                        v = chromaticAdaptation(v, builder->whiteBalance);
-                    }
+                    float3 v = transformIn[0] * config.linear[r] + greenBlue;
 
-                    // Convert to color grading color space
-                    v = config.colorGradingTransformIn * v;
-
-                    if (builder->hasAdjustments) {
+                    if (builder.hasAdjustments) {
                         // Kill negative values before the next transforms
                         v = max(v, 0.0f);
 
                         // Channel mixer
-                        v = channelMixer(v, builder->outRed, builder->outGreen, builder->outBlue);
+                        v = channelMixer(v, builder.outRed, builder.outGreen, builder.outBlue);
 
                         // Shadows/mid-tones/highlights
                         v = tonalRanges(v, config.lumaTransform,
-                                builder->shadows, builder->midtones, builder->highlights,
-                                builder->tonalRanges);
+                                builder.shadows, builder.midtones, builder.highlights,
+                                builder.tonalRanges);
 
                         // The adjustments below behave better in log space using the ACEScct
                         // color space.
                         v = config.linearToLogTransform(v);
 
                         // ASC CDL
-                        v = colorDecisionList(v, builder->slope, builder->offset, builder->power);
+                        v = colorDecisionList(v, builder.slope, builder.offset, builder.power);
 
                         // Contrast in log space
-                        v = contrast(v, builder->contrast);
+                        v = contrast(v, builder.contrast);
 
                         // Back to linear space
                         v = config.logToLinearTransform(v);
 
                         // Vibrance in linear space
-                        v = vibrance(v, builder->vibrance);
+                        v = vibrance(v, builder.vibrance);
 
                         // Saturation in linear space
-                        v = saturation(v, builder->saturation);
+                        v = saturation(v, builder.saturation);
 
                         // Kill negative values before tone mapping
                         v = max(v, 0.0f);
 
                         // RGB curves
-                        v = curves(v,
-                                builder->shadowGamma, builder->midPoint, builder->highlightScale);
+                        v = curves(v, builder.shadowGamma, config.shadowScale,
+                                builder.midPoint, builder.highlightScale);
                     }
 
                     // Tone mapping
@@ -580,7 +539,7 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
     //std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - now;
     //slog.d << "LUT generation time: " << duration.count() << " ms" << io::endl;
 
-    mLutHandle = driver.createTexture(SamplerType::SAMPLER_3D, 1, textureFormat, 1,
+    TextureHandle handle = driver.createTexture(SamplerType::SAMPLER_3D, 1, textureFormat, 1,
             config.lutDimension, config.lutDimension, config.lutDimension, TextureUsage::DEFAULT);
 
     if (converted) {
@@ -589,7 +548,7 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
         elementSize = sizeof(uint32_t);
     }
 
-    driver.update3DImage(mLutHandle, 0,
+    driver.update3DImage(handle, 0,
             0, 0, 0,
             config.lutDimension, config.lutDimension, config.lutDimension,
             PixelBufferDescriptor{
@@ -597,13 +556,81 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
                     [](void* buffer, size_t, void*) { free(buffer); }
             }
     );
+
+    return handle;
+}
+
+FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
+    LutCache& cache = engine.getColorGradingLutCache();
+    BuilderDetails const& details = *builder.operator->();
+    mLutHandle = cache.acquire(details);
+    if (!mLutHandle) {
+        mLutHandle = generateLut(engine, details);
+        cache.add(details, mLutHandle);
+    }
 }
 
 FColorGrading::~FColorGrading() noexcept = default;
 
 void FColorGrading::terminate(FEngine& engine) {
-    DriverApi& driver = engine.getDriverApi();
-    driver.destroyTexture(mLutHandle);
+    engine.getColorGradingLutCache().release(engine.getDriverApi(), mLutHandle);
+}
+
+//------------------------------------------------------------------------------
+// LUT cache
+//------------------------------------------------------------------------------
+
+FColorGrading::LutCache::LutCache() noexcept = default;
+
+FColorGrading::LutCache::~LutCache() noexcept {
+    assert(mEntries.empty());
+}
+
+TextureHandle FColorGrading::LutCache::acquire(BuilderDetails const& details) noexcept {
+    auto pos = std::find_if(mEntries.begin(), mEntries.end(),
+            [&details](Entry const& entry) { return entry.details == details; });
+    if (pos == mEntries.end()) {
+        return {};
+    }
+    pos->references++;
+    return pos->handle;
+}
+
+void FColorGrading::LutCache::add(BuilderDetails const& details, TextureHandle handle) {
+    mEntries.push_back({ details, handle, 1, 0 });
+}
+
+void FColorGrading::LutCache::release(DriverApi& driver, TextureHandle handle) noexcept {
+    auto pos = std::find_if(mEntries.begin(), mEntries.end(),
+            [handle](Entry const& entry) { return entry.handle == handle; });
+    assert(pos != mEntries.end() && pos->references > 0);
+    if (--pos->references > 0) {
+        return;
+    }
+    pos->lastUsed = ++mAge;
+
+    size_t unused = std::count_if(mEntries.begin(), mEntries.end(),
+            [](Entry const& entry) { return entry.references == 0; });
+    while (unused > UNUSED_CAPACITY) {
+        // destroy the LUT released the longest time ago
+        auto oldest = mEntries.end();
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+            if (!it->references && (oldest == mEntries.end() || it->lastUsed < oldest->lastUsed)) {
+                oldest = it;
+            }
+        }
+        driver.destroyTexture(oldest->handle);
+        mEntries.erase(oldest);
+        unused--;
+    }
+}
+
+void FColorGrading::LutCache::terminate(DriverApi& driver) noexcept {
+    for (Entry const& entry : mEntries) {
+        assert(entry.references == 0);
+        driver.destroyTexture(entry.handle);
+    }
+    mEntries.clear();
 }
 
 } //namespace filament
@@ -0,0 +1,570 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ComputeSkinning.h"
+
+#include "details/VertexBuffer.h"
+
+#include <private/filament/EngineEnums.h>
+#include <private/filament/UibGenerator.h>
+
+#include "private/backend/DriverApi.h"
+
+#include <private/backend/Program.h>
+
+#include <utils/CString.h>
+
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <string>
+
+using namespace utils;
+
+namespace filament {
+
+using namespace backend;
+using namespace math;
+
+static constexpr uint8_t PARAMS_BINDING = BindingPoints::PER_RENDERABLE;
+
+// storage block binding points, see getShaderSource()
+static constexpr uint8_t PALETTE_BINDING = 0;
+static constexpr uint8_t INDICES_BINDING = 1;
+static constexpr uint8_t WEIGHTS_BINDING = 2;
+static constexpr uint8_t POSITIONS_BINDING = 3;
+static constexpr uint8_t SKINNED_POSITIONS_BINDING = 4;
+static constexpr uint8_t TANGENTS_BINDING = 5;
+static constexpr uint8_t SKINNED_TANGENTS_BINDING = 6;
+static constexpr uint8_t DELTAS_BINDING = 7;
+
+static constexpr uint32_t GROUP_SIZE = 64;
+static constexpr uint32_t MAX_GROUP_COUNT = 65535;
+
+// initial size of the palette, it grows as needed
+static constexpr uint32_t MIN_PALETTE_CAPACITY = CONFIG_MAX_BONE_COUNT;
+
+// the attribute formats the compute shader can decode
+enum Format : uint32_t {
+    FLOAT3,
+    FLOAT4,
+    SHORT4_NORMALIZED,
+    UBYTE4,
+    USHORT4,
+    UBYTE4_NORMALIZED,
+    USHORT4_NORMALIZED,
+    UNSUPPORTED
+};
+
+enum Mode : uint32_t {
+    COPY,   // copies a whole buffer
+    MORPH,  // adds the deltas of a morph target to the vertices, in place
+    SKIN
+};
+
+struct SkinningParams {
+    uint4 vertices;     // count of vertices (words when copying, deltas when morphing),
+                        // first bone (first delta when morphing), mode, unused
+    uint4 positions;    // offset and stride in words, format, declared
+    uint4 tangents;     // offset and stride in words, format, declared
+    uint4 indices;      // offset and stride in words, format, declared
+    uint4 weights;      // offset and stride in words, format, declared
+    float4 morph;       // weight of the morph target, unused
+};
+
+static_assert(sizeof(ComputeSkinning::MorphDelta) == 32, "MorphDelta must match the shader");
+
+static Format getFormat(Attribute const& attribute) noexcept {
+    const bool normalized = attribute.flags & Attribute::FLAG_NORMALIZED;
+    switch (attribute.type) {
+        case ElementType::FLOAT3:   return normalized ? UNSUPPORTED : FLOAT3;
+        case ElementType::FLOAT4:   return normalized ? UNSUPPORTED : FLOAT4;
+        case ElementType::SHORT4:   return normalized ? SHORT4_NORMALIZED : UNSUPPORTED;
+        case ElementType::UBYTE4:   return normalized ? UBYTE4_NORMALIZED : UBYTE4;
+        case ElementType::USHORT4:  return normalized ? USHORT4_NORMALIZED : USHORT4;
+        default:                    return UNSUPPORTED;
+    }
+}
+
+static bool isSkinningAttribute(size_t attribute) noexcept {
+    return attribute == VertexAttribute::POSITION || attribute == VertexAttribute::TANGENTS ||
+           attribute == VertexAttribute::BONE_INDICES || attribute == VertexAttribute::BONE_WEIGHTS;
+}
+
+static std::string getShaderSource() {
+    return std::string("#version 430 core\n") +
+            "#define GROUP_SIZE " + std::to_string(GROUP_SIZE) + "u\n" +
+            "#define FORMAT_FLOAT4 " + std::to_string(FLOAT4) + "u\n" +
+            "#define FORMAT_SHORT4_NORMALIZED " + std::to_string(SHORT4_NORMALIZED) + "u\n" +
+            "#define FORMAT_UBYTE4 " + std::to_string(UBYTE4) + "u\n" +
+            "#define FORMAT_UBYTE4_NORMALIZED " + std::to_string(UBYTE4_NORMALIZED) + "u\n" +
+            "#define FORMAT_USHORT4_NORMALIZED " + std::to_string(USHORT4_NORMALIZED) + "u\n" +
+            "#define MODE_COPY " + std::to_string(COPY) + "u\n" +
+            "#define MODE_MORPH " + std::to_string(MORPH) + "u\n" +
+            R"GLSL(
+layout(local_size_x = GROUP_SIZE) in;
+
+layout(std140) uniform SkinningParams {
+    uvec4 vertices;
+    uvec4 positions;
+    uvec4 tangents;
+    uvec4 indices;
+    uvec4 weights;
+    vec4 morph;
+} params;
+
+// same layout as PerRenderableUibBone
+struct Bone {
+    vec4 q;
+    vec4 t;
+    vec4 s;
+    vec4 ns;
+};
+
+layout(std430, binding = 0) readonly buffer BonePalette {
+    Bone bones[];
+} palette;
+
+// the vertex buffers are read and written as words, whatever their layout
+layout(std430, binding = 1) readonly buffer BoneIndices { uint data[]; } boneIndices;
+layout(std430, binding = 2) readonly buffer BoneWeights { uint data[]; } boneWeights;
+layout(std430, binding = 3) readonly buffer Positions { uint data[]; } positions;
+layout(std430, binding = 4) writeonly buffer SkinnedPositions { uint data[]; } skinnedPositions;
+layout(std430, binding = 5) readonly buffer Tangents { uint data[]; } tangents;
+layout(std430, binding = 6) writeonly buffer SkinnedTangents { uint data[]; } skinnedTangents;
+
+// when morphing, 'positions' and 'skinnedPositions' (same for the tangents) are the same buffer
+struct MorphDelta {
+    vec3 position;
+    uint vertex;
+    vec3 normal;
+    uint reserved;
+};
+
+layout(std430, binding = 7) readonly buffer MorphDeltas {
+    MorphDelta deltas[];
+} morph;
+
+uint getWordIndex(uvec4 layout, uint vertex) {
+    return layout.x + vertex * layout.y;
+}
+
+uvec4 getBoneIndices(uint vertex) {
+    uint i = getWordIndex(params.indices, vertex);
+    uint w = boneIndices.data[i];
+    if (params.indices.z == FORMAT_UBYTE4) {
+        return uvec4(w & 0xFFu, (w >> 8u) & 0xFFu, (w >> 16u) & 0xFFu, w >> 24u);
+    }
+    uint w1 = boneIndices.data[i + 1u];
+    return uvec4(w & 0xFFFFu, w >> 16u, w1 & 0xFFFFu, w1 >> 16u);
+}
+
+vec4 getBoneWeights(uint vertex) {
+    uint i = getWordIndex(params.weights, vertex);
+    if (params.weights.z == FORMAT_UBYTE4_NORMALIZED) {
+        return unpackUnorm4x8(boneWeights.data[i]);
+    }
+    if (params.weights.z == FORMAT_USHORT4_NORMALIZED) {
+        return vec4(unpackUnorm2x16(boneWeights.data[i]), unpackUnorm2x16(boneWeights.data[i + 1u]));
+    }
+    return uintBitsToFloat(uvec4(boneWeights.data[i], boneWeights.data[i + 1u],
+            boneWeights.data[i + 2u], boneWeights.data[i + 3u]));
+}
+
+vec3 mulBoneVertex(vec3 v, uint i) {
+    Bone bone = palette.bones[params.vertices.y + i];
+    v *= bone.s.xyz;
+    v += 2.0 * cross(bone.q.xyz, cross(bone.q.xyz, v) + bone.q.w * v);
+    return v + bone.t.xyz;
+}
+
+vec3 mulBoneNormal(vec3 n, uint i) {
+    Bone bone = palette.bones[params.vertices.y + i];
+    n *= bone.ns.xyz;
+    return n + 2.0 * cross(bone.q.xyz, cross(bone.q.xyz, n) + bone.q.w * n);
+}
+
+vec3 skinPosition(vec3 p, uvec4 ids, vec4 weights) {
+    return mulBoneVertex(p, ids.x) * weights.x + mulBoneVertex(p, ids.y) * weights.y +
+           mulBoneVertex(p, ids.z) * weights.z + mulBoneVertex(p, ids.w) * weights.w;
+}
+
+vec3 skinNormal(vec3 n, uvec4 ids, vec4 weights) {
+    return mulBoneNormal(n, ids.x) * weights.x + mulBoneNormal(n, ids.y) * weights.y +
+           mulBoneNormal(n, ids.z) * weights.z + mulBoneNormal(n, ids.w) * weights.w;
+}
+
+void toTangentFrame(vec4 q, out vec3 n, out vec3 t) {
+    n = vec3( 0.0,  0.0,  1.0) +
+        vec3( 2.0, -2.0, -2.0) * q.x * q.zwx +
+        vec3( 2.0,  2.0, -2.0) * q.y * q.wzy;
+    t = vec3( 1.0,  0.0,  0.0) +
+        vec3(-2.0,  2.0, -2.0) * q.y * q.yxw +
+        vec3(-2.0,  2.0,  2.0) * q.z * q.zwx;
+}
+
+// the inverse of toTangentFrame(), the sign of w tells whether the bitangent is reflected
+vec4 fromTangentFrame(vec3 n, vec3 t, bool reflected) {
+    t = normalize(t - n * dot(n, t));
+    mat3 m = mat3(t, cross(n, t), n);
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    vec4 q;
+    if (trace > 0.0) {
+        float s = sqrt(trace + 1.0) * 2.0;
+        q = vec4(m[1][2] - m[2][1], m[2][0] - m[0][2], m[0][1] - m[1][0], 0.25 * s * s) / s;
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        float s = sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]) * 2.0;
+        q = vec4(0.25 * s * s, m[1][0] + m[0][1], m[2][0] + m[0][2], m[1][2] - m[2][1]) / s;
+    } else if (m[1][1] > m[2][2]) {
+        float s = sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]) * 2.0;
+        q = vec4(m[1][0] + m[0][1], 0.25 * s * s, m[2][1] + m[1][2], m[2][0] - m[0][2]) / s;
+    } else {
+        float s = sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]) * 2.0;
+        q = vec4(m[2][0] + m[0][2], m[2][1] + m[1][2], 0.25 * s * s, m[0][1] - m[1][0]) / s;
+    }
+    q = normalize(q);
+    if (q.w < 0.0) {
+        q = -q;
+    }
+    // w can't be 0, it would lose its sign once packed
+    const float bias = 1.0 / 32767.0;
+    if (q.w < bias) {
+        q.xyz *= sqrt(1.0 - bias * bias);
+        q.w = bias;
+    }
+    return reflected ? -q : q;
+}
+
+vec4 getTangents(uint t) {
+    if (params.tangents.z == FORMAT_SHORT4_NORMALIZED) {
+        return vec4(unpackSnorm2x16(tangents.data[t]), unpackSnorm2x16(tangents.data[t + 1u]));
+    }
+    return uintBitsToFloat(uvec4(tangents.data[t], tangents.data[t + 1u],
+            tangents.data[t + 2u], tangents.data[t + 3u]));
+}
+
+void setTangents(uint t, vec4 q) {
+    if (params.tangents.z == FORMAT_SHORT4_NORMALIZED) {
+        skinnedTangents.data[t     ] = packSnorm2x16(q.xy);
+        skinnedTangents.data[t + 1u] = packSnorm2x16(q.zw);
+    } else {
+        skinnedTangents.data[t     ] = floatBitsToUint(q.x);
+        skinnedTangents.data[t + 1u] = floatBitsToUint(q.y);
+        skinnedTangents.data[t + 2u] = floatBitsToUint(q.z);
+        skinnedTangents.data[t + 3u] = floatBitsToUint(q.w);
+    }
+}
+
+vec3 getPosition(uint p) {
+    return uintBitsToFloat(uvec3(positions.data[p], positions.data[p + 1u], positions.data[p + 2u]));
+}
+
+void setPosition(uint p, vec3 position) {
+    skinnedPositions.data[p     ] = floatBitsToUint(position.x);
+    skinnedPositions.data[p + 1u] = floatBitsToUint(position.y);
+    skinnedPositions.data[p + 2u] = floatBitsToUint(position.z);
+}
+
+void main() {
+    uint count = params.vertices.x;
+    uint step = gl_NumWorkGroups.x * GROUP_SIZE;
+
+    if (params.vertices.z == MODE_COPY) {
+        for (uint i = gl_GlobalInvocationID.x; i < count; i += step) {
+            skinnedPositions.data[i] = positions.data[i];
+        }
+        return;
+    }
+
+    if (params.vertices.z == MODE_MORPH) {
+        // a vertex appears at most once in a morph target, so there are no conflicting writes
+        float weight = params.morph.x;
+        for (uint i = gl_GlobalInvocationID.x; i < count; i += step) {
+            MorphDelta delta = morph.deltas[params.vertices.y + i];
+            uint p = getWordIndex(params.positions, delta.vertex);
+            setPosition(p, getPosition(p) + weight * delta.position);
+            if (params.tangents.w != 0u && any(notEqual(delta.normal, vec3(0.0)))) {
+                uint t = getWordIndex(params.tangents, delta.vertex);
+                vec4 q = getTangents(t);
+                vec3 normal;
+                vec3 tangent;
+                toTangentFrame(normalize(q), normal, tangent);
+                normal = normalize(normal + weight * delta.normal);
+                setTangents(t, fromTangentFrame(normal, tangent, q.w < 0.0));
+            }
+        }
+        return;
+    }
+
+    for (uint v = gl_GlobalInvocationID.x; v < count; v += step) {
+        uvec4 ids = getBoneIndices(v);
+        vec4 weights = getBoneWeights(v);
+
+        uint p = getWordIndex(params.positions, v);
+        setPosition(p, skinPosition(getPosition(p), ids, weights));
+        if (params.positions.z == FORMAT_FLOAT4) {
+            skinnedPositions.data[p + 3u] = positions.data[p + 3u];
+        }
+
+        if (params.tangents.w != 0u) {
+            uint t = getWordIndex(params.tangents, v);
+            vec4 q = getTangents(t);
+            vec3 normal;
+            vec3 tangent;
+            toTangentFrame(normalize(q), normal, tangent);
+            normal = normalize(skinNormal(normal, ids, weights));
+            tangent = normalize(skinNormal(tangent, ids, weights));
+            setTangents(t, fromTangentFrame(normal, tangent, q.w < 0.0));
+        }
+    }
+}
+)GLSL";
+}
+
+void ComputeSkinning::init(DriverApi& driver) noexcept {
+    mComputeSupported = driver.isComputeSupported();
+}
+
+void ComputeSkinning::terminate(DriverApi& driver) noexcept {
+    if (mProgram) {
+        driver.destroyProgram(mProgram);
+        driver.destroyUniformBuffer(mParamsUbh);
+    }
+    if (mPalette) {
+        driver.destroyBufferObject(mPalette);
+    }
+}
+
+bool ComputeSkinning::isSupported(FVertexBuffer const& vertices, bool skinning) noexcept {
+    AttributeBitset const declared = vertices.getDeclaredAttributes();
+    if (!declared[VertexAttribute::POSITION] || (skinning &&
+            (!declared[VertexAttribute::BONE_INDICES] || !declared[VertexAttribute::BONE_WEIGHTS]))) {
+        return false;
+    }
+
+    // the buffers are accessed as arrays of words
+    AttributeArray const& attributes = vertices.getAttributes();
+    for (size_t i = 0, c = attributes.size(); i < c; i++) {
+        if (declared[i] && ((attributes[i].offset & 0x3u) || (attributes[i].stride & 0x3u))) {
+            return false;
+        }
+    }
+
+    const Format positions = getFormat(attributes[VertexAttribute::POSITION]);
+    const Format tangents = declared[VertexAttribute::TANGENTS] ?
+            getFormat(attributes[VertexAttribute::TANGENTS]) : FLOAT4;
+    const Format indices = skinning ?
+            getFormat(attributes[VertexAttribute::BONE_INDICES]) : UBYTE4;
+    const Format weights = skinning ?
+            getFormat(attributes[VertexAttribute::BONE_WEIGHTS]) : FLOAT4;
+    return (positions == FLOAT3 || positions == FLOAT4) &&
+           (tangents == FLOAT4 || tangents == SHORT4_NORMALIZED) &&
+           (indices == UBYTE4 || indices == USHORT4) &&
+           (weights == FLOAT4 || weights == UBYTE4_NORMALIZED || weights == USHORT4_NORMALIZED);
+}
+
+ComputeSkinning::Range ComputeSkinning::allocateBones(DriverApi& driver, uint32_t count) noexcept {
+    assert(count > 0);
+
+    // first fit in the ranges freed so far
+    auto pos = std::find_if(mFreeRanges.begin(), mFreeRanges.end(),
+            [count](Range const& range) { return range.count >= count; });
+    if (pos != mFreeRanges.end()) {
+        Range const range{ pos->offset, count };
+        pos->offset += count;
+        pos->count -= count;
+        if (!pos->count) {
+            mFreeRanges.erase(pos);
+        }
+        return range;
+    }
+
+    Range const range{ mPaletteSize, count };
+    mPaletteSize += count;
+    if (UTILS_UNLIKELY(mPaletteSize > mPaletteCapacity)) {
+        // The bones are lost with the old palette, the renderables upload theirs again when they
+        // notice the new generation.
+        if (mPalette) {
+            driver.destroyBufferObject(mPalette);
+        }
+        mPaletteCapacity = std::max({ mPaletteSize, mPaletteCapacity * 2, MIN_PALETTE_CAPACITY });
+        mPalette = driver.createBufferObject(mPaletteCapacity * sizeof(PerRenderableUibBone),
+                BufferObjectBinding::SHADER_STORAGE, BufferUsage::DYNAMIC);
+        mPaletteGeneration++;
+    }
+    return range;
+}
+
+void ComputeSkinning::freeBones(Range range) noexcept {
+    auto pos = std::lower_bound(mFreeRanges.begin(), mFreeRanges.end(), range,
+            [](Range const& lhs, Range const& rhs) { return lhs.offset < rhs.offset; });
+    pos = mFreeRanges.insert(pos, range);
+
+    // merge with the following and the preceding free ranges
+    auto next = std::next(pos);
+    if (next != mFreeRanges.end() && pos->offset + pos->count == next->offset) {
+        pos->count += next->count;
+        mFreeRanges.erase(next);
+    }
+    if (pos != mFreeRanges.begin()) {
+        auto prev = std::prev(pos);
+        if (prev->offset + prev->count == pos->offset) {
+            prev->count += pos->count;
+            pos = mFreeRanges.erase(pos);
+            pos = std::prev(pos);
+        }
+    }
+
+    // the free range at the end isn't needed
+    if (pos->offset + pos->count == mPaletteSize) {
+        mPaletteSize = pos->offset;
+        mFreeRanges.erase(pos);
+    }
+}
+
+void ComputeSkinning::updateBones(DriverApi& driver, Range range,
+        BufferDescriptor&& bones) noexcept {
+    assert(bones.size == range.count * sizeof(PerRenderableUibBone));
+    driver.updateBufferObject(mPalette, std::move(bones),
+            range.offset * sizeof(PerRenderableUibBone));
+}
+
+Handle<HwVertexBuffer> ComputeSkinning::createSkinnedVertexBuffer(DriverApi& driver,
+        FVertexBuffer const& vertices) noexcept {
+    return driver.createVertexBuffer(vertices.getBufferCount(),
+            uint8_t(vertices.getDeclaredAttributes().count()), uint32_t(vertices.getVertexCount()),
+            vertices.getAttributes(), BufferUsage::DYNAMIC);
+}
+
+void ComputeSkinning::deform(DriverApi& driver, FVertexBuffer const& vertices,
+        Handle<HwVertexBuffer> skinned, Range bones, Handle<HwBufferObject> deltas,
+        MorphTarget const* targets, size_t targetCount) noexcept {
+    assert(mComputeSupported);
+
+    if (UTILS_UNLIKELY(!mProgram)) {
+        const std::string shader = getShaderSource();
+        Program program;
+        program.diagnostics(CString("ComputeSkinning"))
+                .withComputeShader(shader.data(), shader.size())
+                .setUniformBlock(PARAMS_BINDING, CString("SkinningParams"));
+        mProgram = driver.createProgram(std::move(program));
+        mParamsUbh = driver.createUniformBuffer(sizeof(SkinningParams), BufferUsage::DYNAMIC);
+    }
+
+    Handle<HwVertexBuffer> const source = vertices.getHwHandle();
+    AttributeArray const& attributes = vertices.getAttributes();
+    AttributeBitset const declared = vertices.getDeclaredAttributes();
+    const uint32_t vertexCount = uint32_t(vertices.getVertexCount());
+
+    // the morph targets are applied in place, so the positions and tangents must be copied first
+    const bool morphing = bool(deltas);
+
+    driver.bindUniformBuffer(PARAMS_BINDING, mParamsUbh);
+
+    // the buffers holding attributes that skinning doesn't write are copied as they are
+    for (uint8_t buffer = 0, c = vertices.getBufferCount(); buffer < c; buffer++) {
+        bool needsCopy = false;
+        uint32_t size = 0;
+        for (size_t i = 0; i < attributes.size(); i++) {
+            if (declared[i] && attributes[i].buffer == buffer) {
+                needsCopy = needsCopy || !isSkinningAttribute(i) || (morphing &&
+                        (i == VertexAttribute::POSITION || i == VertexAttribute::TANGENTS));
+                size = std::max(size, attributes[i].offset + vertexCount * attributes[i].stride);
+            }
+        }
+        if (needsCopy) {
+            SkinningParams* const params = driver.allocatePod<SkinningParams>();
+            *params = {};
+            params->vertices = { size / 4, 0, uint32_t(COPY), 0 };
+            driver.loadUniformBuffer(mParamsUbh, { params, sizeof(SkinningParams) });
+            driver.bindVertexBufferStorage(POSITIONS_BINDING, source, buffer);
+            driver.bindVertexBufferStorage(SKINNED_POSITIONS_BINDING, skinned, buffer);
+            dispatch(driver, size / 4);
+        }
+    }
+
+    auto getLayout = [&](VertexAttribute attribute) -> uint4 {
+        Attribute const& item = attributes[attribute];
+        return { item.offset / 4, uint32_t(item.stride) / 4,
+                uint32_t(getFormat(item)), uint32_t(declared[attribute]) };
+    };
+
+    auto bindPositionsAndTangents = [&](Handle<HwVertexBuffer> from) {
+        driver.bindVertexBufferStorage(POSITIONS_BINDING, from,
+                attributes[VertexAttribute::POSITION].buffer);
+        driver.bindVertexBufferStorage(SKINNED_POSITIONS_BINDING, skinned,
+                attributes[VertexAttribute::POSITION].buffer);
+        if (declared[VertexAttribute::TANGENTS]) {
+            driver.bindVertexBufferStorage(TANGENTS_BINDING, from,
+                    attributes[VertexAttribute::TANGENTS].buffer);
+            driver.bindVertexBufferStorage(SKINNED_TANGENTS_BINDING, skinned,
+                    attributes[VertexAttribute::TANGENTS].buffer);
+        }
+    };
+
+    // one dispatch per morph target, the cost only depends on the targets that are active
+    if (morphing) {
+        driver.bindBufferObject(DELTAS_BINDING, deltas);
+        bindPositionsAndTangents(skinned);
+        for (size_t i = 0; i < targetCount; i++) {
+            MorphTarget const& target = targets[i];
+            if (target.weight == 0.0f || !target.count) {
+                continue;
+            }
+            SkinningParams* const params = driver.allocatePod<SkinningParams>();
+            *params = {};
+            params->vertices = { target.count, target.offset, uint32_t(MORPH), 0 };
+            params->positions = getLayout(VertexAttribute::POSITION);
+            params->tangents = getLayout(VertexAttribute::TANGENTS);
+            params->morph = { target.weight, 0, 0, 0 };
+            driver.loadUniformBuffer(mParamsUbh, { params, sizeof(SkinningParams) });
+            dispatch(driver, target.count);
+        }
+    }
+
+    if (!bones.count) {
+        return;
+    }
+
+    SkinningParams* const params = driver.allocatePod<SkinningParams>();
+    *params = {};
+    params->vertices = { vertexCount, bones.offset, uint32_t(SKIN), 0 };
+    params->positions = getLayout(VertexAttribute::POSITION);
+    params->tangents = getLayout(VertexAttribute::TANGENTS);
+    params->indices = getLayout(VertexAttribute::BONE_INDICES);
+    params->weights = getLayout(VertexAttribute::BONE_WEIGHTS);
+    driver.loadUniformBuffer(mParamsUbh, { params, sizeof(SkinningParams) });
+
+    driver.bindBufferObject(PALETTE_BINDING, mPalette);
+    driver.bindVertexBufferStorage(INDICES_BINDING, source,
+            attributes[VertexAttribute::BONE_INDICES].buffer);
+    driver.bindVertexBufferStorage(WEIGHTS_BINDING, source,
+            attributes[VertexAttribute::BONE_WEIGHTS].buffer);
+    // the morphed vertices are skinned in place
+    bindPositionsAndTangents(morphing ? skinned : source);
+    dispatch(driver, vertexCount);
+}
+
+void ComputeSkinning::dispatch(DriverApi& driver, uint32_t invocationCount) noexcept {
+    // the shader loops over what doesn't fit in the maximum work group count
+    const uint32_t groupCount = std::min((invocationCount + GROUP_SIZE - 1) / GROUP_SIZE,
+            MAX_GROUP_COUNT);
+    if (groupCount) {
+        driver.dispatchCompute(mProgram, { groupCount, 1, 1 });
+    }
+}
+
+} // namespace filament
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_COMPUTESKINNING_H
+#define TNT_FILAMENT_COMPUTESKINNING_H
+
+#include <backend/BufferDescriptor.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include "private/backend/DriverApiForward.h"
+
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+class FVertexBuffer;
+
+// Skins and morphs vertices in a compute pass, into a vertex buffer that all the passes of the
+// frame draw without skinning, instead of skinning them in the vertex shader of every pass.
+// The bones of all the renderables skinned this way live in a single palette buffer, so their
+// count isn't limited by the size of a uniform buffer.
+// The morph targets are stored as sparse lists of deltas, only the targets with a non-zero
+// weight are applied.
+class ComputeSkinning {
+public:
+    // a range of bones in the palette
+    struct Range {
+        uint32_t offset = 0;
+        uint32_t count = 0;
+    };
+
+    // how a morph target moves one vertex, in the layout used by the compute shader
+    struct MorphDelta {
+        math::float3 position;
+        uint32_t vertex;
+        math::float3 normal;
+        uint32_t reserved;
+    };
+
+    // a morph target, as a range of MorphDelta in a buffer
+    struct MorphTarget {
+        uint32_t offset;
+        uint32_t count;
+        float weight;
+    };
+
+    ComputeSkinning() noexcept = default;
+    ComputeSkinning(ComputeSkinning const& rhs) = delete;
+    ComputeSkinning& operator=(ComputeSkinning const& rhs) = delete;
+
+    void init(backend::DriverApi& driver) noexcept;
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    bool isSupported() const noexcept { return mComputeSupported; }
+
+    // Whether deform() can read the vertices of 'vertices': they need positions, and bone
+    // indices and weights when skinned, in one of the formats the compute shader decodes, and all
+    // the attributes must be aligned to 4 bytes.
+    static bool isSupported(FVertexBuffer const& vertices, bool skinning) noexcept;
+
+    Range allocateBones(backend::DriverApi& driver, uint32_t count) noexcept;
+    void freeBones(Range range) noexcept;
+
+    // Incremented each time the palette is reallocated, which loses the bones it holds.
+    uint32_t getPaletteGeneration() const noexcept { return mPaletteGeneration; }
+
+    // 'bones' holds 'range.count' PerRenderableUibBone
+    void updateBones(backend::DriverApi& driver, Range range,
+            backend::BufferDescriptor&& bones) noexcept;
+
+    // Creates a vertex buffer with the same layout as 'vertices', for deform() to write to.
+    backend::Handle<backend::HwVertexBuffer> createSkinnedVertexBuffer(
+            backend::DriverApi& driver, FVertexBuffer const& vertices) noexcept;
+
+    // Writes 'vertices' to 'skinned', morphed by the 'targets' whose deltas are in 'deltas',
+    // then skinned with the bones in 'bones', if any. The attributes that aren't affected are
+    // copied as they are.
+    void deform(backend::DriverApi& driver, FVertexBuffer const& vertices,
+            backend::Handle<backend::HwVertexBuffer> skinned, Range bones,
+            backend::Handle<backend::HwBufferObject> deltas,
+            MorphTarget const* targets, size_t targetCount) noexcept;
+
+private:
+    void dispatch(backend::DriverApi& driver, uint32_t invocationCount) noexcept;
+
+    backend::Handle<backend::HwProgram> mProgram;
+    backend::Handle<backend::HwUniformBuffer> mParamsUbh;
+    backend::Handle<backend::HwBufferObject> mPalette;
+    uint32_t mPaletteCapacity = 0;      // in bones
+    uint32_t mPaletteSize = 0;          // in bones, the end of the last allocated range
+    uint32_t mPaletteGeneration = 0;
+    std::vector<Range> mFreeRanges;     // sorted by offset
+    bool mComputeSupported = false;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_COMPUTESKINNING_H
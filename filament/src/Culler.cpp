@@ -20,22 +20,66 @@
 
 #include <math/fast.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <immintrin.h>
+#   define CULLER_HAS_SSE 1
+    // the AVX2 kernel is compiled with a target attribute and only used if the CPU supports it
+#   if defined(__GNUC__) || defined(__clang__)
+#       define CULLER_HAS_AVX2 1
+#       define CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#   endif
+#endif
+
+#if defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define CULLER_HAS_NEON 1
+#endif
+
+// WebAssembly SIMD can't be detected at runtime, a module using it fails to load on browsers
+// that don't support it, so filament-js ships a second module built with -msimd128.
+#if defined(__wasm_simd128__)
+#   include <wasm_simd128.h>
+#   define CULLER_HAS_WASM_SIMD 1
+#endif
+
+#ifndef CULLER_HAS_SSE
+#   define CULLER_HAS_SSE 0
+#endif
+#ifndef CULLER_HAS_AVX2
+#   define CULLER_HAS_AVX2 0
+#endif
+#ifndef CULLER_HAS_NEON
+#   define CULLER_HAS_NEON 0
+#endif
+#ifndef CULLER_HAS_WASM_SIMD
+#   define CULLER_HAS_WASM_SIMD 0
+#endif
+
 using namespace filament::math;
 
 namespace filament {
 
-void Culler::intersects(
+namespace {
+
+using result_type = Culler::result_type;
+
+using BoxKernel = void (*)(result_type*, float4 const*, float3 const*, float3 const*,
+        size_t, size_t);
+using SphereKernel = void (*)(result_type*, float4 const*, float4 const*, size_t);
+
+// ------------------------------------------------------------------------------------------------
+// Scalar
+// ------------------------------------------------------------------------------------------------
+
+void intersectsSpheresScalar(
         result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT planes,
         float4 const* UTILS_RESTRICT b,
         size_t count) noexcept {
 
-    float4 const * const UTILS_RESTRICT planes = frustum.mPlanes;
-
     // we use a vectorize width of 8 because, on ARMv8 it allow the compiler to write 8
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
@@ -55,19 +99,16 @@ void Culler::intersects(
     }
 }
 
-void Culler::intersects(
+void intersectsBoxesScalar(
         result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT planes,
         float3 const* UTILS_RESTRICT center,
         float3 const* UTILS_RESTRICT extent,
         size_t count, size_t bit) noexcept {
 
-    float4 const * UTILS_RESTRICT const planes = frustum.mPlanes;
-
     // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
@@ -89,6 +130,551 @@ void Culler::intersects(
     }
 }
 
+// ------------------------------------------------------------------------------------------------
+// SSE
+//
+// The SIMD kernels evaluate the plane equations in the same order as the scalar code, so all
+// kernels return the same results. An item is visible when the sign bit of all 6 dot products
+// is set, which is computed by and-ing them together.
+// ------------------------------------------------------------------------------------------------
+
+#if CULLER_HAS_SSE
+
+// loads 4 float3 and transposes them to x, y, z vectors
+inline void loadSSE(float3 const* p, __m128& x, __m128& y, __m128& z) noexcept {
+    float const* const f = &p->x;
+    const __m128 a = _mm_loadu_ps(f + 0);   // x0 y0 z0 x1
+    const __m128 b = _mm_loadu_ps(f + 4);   // y1 z1 x2 y2
+    const __m128 c = _mm_loadu_ps(f + 8);   // z2 x3 y3 z3
+    const __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));    // x2 y2 x3 y3
+    const __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));    // y0 z0 y1 z1
+    x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// loads 4 float4 and transposes them to x, y, z, w vectors
+inline void loadSSE(float4 const* p, __m128& x, __m128& y, __m128& z, __m128& w) noexcept {
+    float const* const f = &p->x;
+    x = _mm_loadu_ps(f + 0);
+    y = _mm_loadu_ps(f + 4);
+    z = _mm_loadu_ps(f + 8);
+    w = _mm_loadu_ps(f + 12);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+}
+
+void intersectsBoxesSSE(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+
+    __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (size_t j = 0; j < 6; j++) {
+        px[j] = _mm_set1_ps(planes[j].x);
+        py[j] = _mm_set1_ps(planes[j].y);
+        pz[j] = _mm_set1_ps(planes[j].z);
+        pw[j] = _mm_set1_ps(planes[j].w);
+        ax[j] = _mm_set1_ps(std::abs(planes[j].x));
+        ay[j] = _mm_set1_ps(std::abs(planes[j].y));
+        az[j] = _mm_set1_ps(std::abs(planes[j].z));
+    }
+
+    for (size_t i = 0; i < count; i += 8) {
+        int mask = 0;
+        for (size_t k = 0; k < 8; k += 4) {
+            __m128 cx, cy, cz, ex, ey, ez;
+            loadSSE(center + i + k, cx, cy, cz);
+            loadSSE(extent + i + k, ex, ey, ez);
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (size_t j = 0; j < 6; j++) {
+                __m128 dot = _mm_sub_ps(_mm_mul_ps(px[j], cx), _mm_mul_ps(ax[j], ex));
+                dot = _mm_add_ps(dot, _mm_mul_ps(py[j], cy));
+                dot = _mm_sub_ps(dot, _mm_mul_ps(ay[j], ey));
+                dot = _mm_add_ps(dot, _mm_mul_ps(pz[j], cz));
+                dot = _mm_sub_ps(dot, _mm_mul_ps(az[j], ez));
+                dot = _mm_add_ps(dot, pw[j]);
+                visible = _mm_and_ps(visible, dot);
+            }
+            mask |= _mm_movemask_ps(visible) << k;
+        }
+        for (size_t k = 0; k < 8; k++) {
+            results[i + k] |= result_type(((mask >> k) & 1) << bit);
+        }
+    }
+}
+
+void intersectsSpheresSSE(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (size_t j = 0; j < 6; j++) {
+        px[j] = _mm_set1_ps(planes[j].x);
+        py[j] = _mm_set1_ps(planes[j].y);
+        pz[j] = _mm_set1_ps(planes[j].z);
+        pw[j] = _mm_set1_ps(planes[j].w);
+    }
+
+    for (size_t i = 0; i < count; i += 8) {
+        int mask = 0;
+        for (size_t k = 0; k < 8; k += 4) {
+            __m128 x, y, z, r;
+            loadSSE(b + i + k, x, y, z, r);
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (size_t j = 0; j < 6; j++) {
+                __m128 dot = _mm_mul_ps(px[j], x);
+                dot = _mm_add_ps(dot, _mm_mul_ps(py[j], y));
+                dot = _mm_add_ps(dot, _mm_mul_ps(pz[j], z));
+                dot = _mm_add_ps(dot, pw[j]);
+                dot = _mm_sub_ps(dot, r);
+                visible = _mm_and_ps(visible, dot);
+            }
+            mask |= _mm_movemask_ps(visible) << k;
+        }
+        for (size_t k = 0; k < 8; k++) {
+            results[i + k] = result_type((mask >> k) & 1);
+        }
+    }
+}
+
+#endif // CULLER_HAS_SSE
+
+// ------------------------------------------------------------------------------------------------
+// AVX2
+// ------------------------------------------------------------------------------------------------
+
+#if CULLER_HAS_AVX2
+
+CULLER_TARGET_AVX2
+inline void loadAVX2(float3 const* p, __m256& x, __m256& y, __m256& z) noexcept {
+    __m128 x0, y0, z0, x1, y1, z1;
+    loadSSE(p, x0, y0, z0);
+    loadSSE(p + 4, x1, y1, z1);
+    x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+    y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+    z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+}
+
+CULLER_TARGET_AVX2
+inline void loadAVX2(float4 const* p, __m256& x, __m256& y, __m256& z, __m256& w) noexcept {
+    __m128 x0, y0, z0, w0, x1, y1, z1, w1;
+    loadSSE(p, x0, y0, z0, w0);
+    loadSSE(p + 4, x1, y1, z1, w1);
+    x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+    y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+    z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+    w = _mm256_insertf128_ps(_mm256_castps128_ps256(w0), w1, 1);
+}
+
+CULLER_TARGET_AVX2
+void intersectsBoxesAVX2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+
+    __m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (size_t j = 0; j < 6; j++) {
+        px[j] = _mm256_set1_ps(planes[j].x);
+        py[j] = _mm256_set1_ps(planes[j].y);
+        pz[j] = _mm256_set1_ps(planes[j].z);
+        pw[j] = _mm256_set1_ps(planes[j].w);
+        ax[j] = _mm256_set1_ps(std::abs(planes[j].x));
+        ay[j] = _mm256_set1_ps(std::abs(planes[j].y));
+        az[j] = _mm256_set1_ps(std::abs(planes[j].z));
+    }
+
+    // results are expanded from the 8 bits mask with a byte shuffle
+    const __m128i selectors = _mm_set1_epi64x(0x8040201008040201ll);
+    const __m128i shift = _mm_cvtsi32_si128(int(bit));
+
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 cx, cy, cz, ex, ey, ez;
+        loadAVX2(center + i, cx, cy, cz);
+        loadAVX2(extent + i, ex, ey, ez);
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++) {
+            __m256 dot = _mm256_sub_ps(_mm256_mul_ps(px[j], cx), _mm256_mul_ps(ax[j], ex));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(py[j], cy));
+            dot = _mm256_sub_ps(dot, _mm256_mul_ps(ay[j], ey));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(pz[j], cz));
+            dot = _mm256_sub_ps(dot, _mm256_mul_ps(az[j], ez));
+            dot = _mm256_add_ps(dot, pw[j]);
+            visible = _mm256_and_ps(visible, dot);
+        }
+        // one byte per item, 0 or 1, shifted to 'bit'
+        const __m128i mask = _mm_set1_epi8(char(_mm256_movemask_ps(visible)));
+        __m128i r = _mm_min_epu8(_mm_and_si128(mask, selectors), _mm_set1_epi8(1));
+        r = _mm_sll_epi16(r, shift);
+        __m128i dst = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(results + i));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(results + i), _mm_or_si128(dst, r));
+    }
+}
+
+CULLER_TARGET_AVX2
+void intersectsSpheresAVX2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (size_t j = 0; j < 6; j++) {
+        px[j] = _mm256_set1_ps(planes[j].x);
+        py[j] = _mm256_set1_ps(planes[j].y);
+        pz[j] = _mm256_set1_ps(planes[j].z);
+        pw[j] = _mm256_set1_ps(planes[j].w);
+    }
+
+    const __m128i selectors = _mm_set1_epi64x(0x8040201008040201ll);
+
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 x, y, z, r;
+        loadAVX2(b + i, x, y, z, r);
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++) {
+            __m256 dot = _mm256_mul_ps(px[j], x);
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(py[j], y));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(pz[j], z));
+            dot = _mm256_add_ps(dot, pw[j]);
+            dot = _mm256_sub_ps(dot, r);
+            visible = _mm256_and_ps(visible, dot);
+        }
+        const __m128i mask = _mm_set1_epi8(char(_mm256_movemask_ps(visible)));
+        const __m128i v = _mm_min_epu8(_mm_and_si128(mask, selectors), _mm_set1_epi8(1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(results + i), v);
+    }
+}
+
+bool cpuSupportsAVX2() noexcept {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // CULLER_HAS_AVX2
+
+// ------------------------------------------------------------------------------------------------
+// NEON
+// ------------------------------------------------------------------------------------------------
+
+#if CULLER_HAS_NEON
+
+void intersectsBoxesNEON(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+
+    float32x4_t ax[6], ay[6], az[6];
+    for (size_t j = 0; j < 6; j++) {
+        ax[j] = vdupq_n_f32(std::abs(planes[j].x));
+        ay[j] = vdupq_n_f32(std::abs(planes[j].y));
+        az[j] = vdupq_n_f32(std::abs(planes[j].z));
+    }
+
+    const int8x8_t shift = vdup_n_s8(int8_t(bit));
+
+    for (size_t i = 0; i < count; i += 8) {
+        uint32x4_t visible[2];
+        for (size_t k = 0; k < 2; k++) {
+            // vld3q deinterleaves the float3 for us
+            const float32x4x3_t c = vld3q_f32(&center[i + k * 4].x);
+            const float32x4x3_t e = vld3q_f32(&extent[i + k * 4].x);
+            uint32x4_t v = vdupq_n_u32(~0u);
+            for (size_t j = 0; j < 6; j++) {
+                float32x4_t dot = vsubq_f32(vmulq_n_f32(c.val[0], planes[j].x),
+                        vmulq_f32(ax[j], e.val[0]));
+                dot = vaddq_f32(dot, vmulq_n_f32(c.val[1], planes[j].y));
+                dot = vsubq_f32(dot, vmulq_f32(ay[j], e.val[1]));
+                dot = vaddq_f32(dot, vmulq_n_f32(c.val[2], planes[j].z));
+                dot = vsubq_f32(dot, vmulq_f32(az[j], e.val[2]));
+                dot = vaddq_f32(dot, vdupq_n_f32(planes[j].w));
+                v = vandq_u32(v, vreinterpretq_u32_f32(dot));
+            }
+            visible[k] = vshrq_n_u32(v, 31);
+        }
+        // narrow the eight 0/1 results to bytes and write them in one go
+        const uint16x8_t v16 = vcombine_u16(vmovn_u32(visible[0]), vmovn_u32(visible[1]));
+        const uint8x8_t v8 = vshl_u8(vmovn_u16(v16), shift);
+        vst1_u8(results + i, vorr_u8(vld1_u8(results + i), v8));
+    }
+}
+
+void intersectsSpheresNEON(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+
+    for (size_t i = 0; i < count; i += 8) {
+        uint32x4_t visible[2];
+        for (size_t k = 0; k < 2; k++) {
+            const float32x4x4_t s = vld4q_f32(&b[i + k * 4].x);
+            uint32x4_t v = vdupq_n_u32(~0u);
+            for (size_t j = 0; j < 6; j++) {
+                float32x4_t dot = vmulq_n_f32(s.val[0], planes[j].x);
+                dot = vaddq_f32(dot, vmulq_n_f32(s.val[1], planes[j].y));
+                dot = vaddq_f32(dot, vmulq_n_f32(s.val[2], planes[j].z));
+                dot = vaddq_f32(dot, vdupq_n_f32(planes[j].w));
+                dot = vsubq_f32(dot, s.val[3]);
+                v = vandq_u32(v, vreinterpretq_u32_f32(dot));
+            }
+            visible[k] = vshrq_n_u32(v, 31);
+        }
+        const uint16x8_t v16 = vcombine_u16(vmovn_u32(visible[0]), vmovn_u32(visible[1]));
+        vst1_u8(results + i, vmovn_u16(v16));
+    }
+}
+
+#endif // CULLER_HAS_NEON
+
+// ------------------------------------------------------------------------------------------------
+// WebAssembly SIMD
+// ------------------------------------------------------------------------------------------------
+
+#if CULLER_HAS_WASM_SIMD
+
+// loads 4 float3 and transposes them to x, y, z vectors
+inline void loadWasm(float3 const* p, v128_t& x, v128_t& y, v128_t& z) noexcept {
+    float const* const f = &p->x;
+    const v128_t a = wasm_v128_load(f + 0);     // x0 y0 z0 x1
+    const v128_t b = wasm_v128_load(f + 4);     // y1 z1 x2 y2
+    const v128_t c = wasm_v128_load(f + 8);     // z2 x3 y3 z3
+    x = wasm_i32x4_shuffle(wasm_i32x4_shuffle(a, b, 0, 3, 6, 7), c, 0, 1, 2, 5);
+    y = wasm_i32x4_shuffle(wasm_i32x4_shuffle(a, b, 1, 4, 7, 7), c, 0, 1, 2, 6);
+    z = wasm_i32x4_shuffle(wasm_i32x4_shuffle(a, b, 2, 5, 5, 5), c, 0, 1, 4, 7);
+}
+
+// loads 4 float4 and transposes them to x, y, z, w vectors
+inline void loadWasm(float4 const* p, v128_t& x, v128_t& y, v128_t& z, v128_t& w) noexcept {
+    float const* const f = &p->x;
+    const v128_t r0 = wasm_v128_load(f + 0);
+    const v128_t r1 = wasm_v128_load(f + 4);
+    const v128_t r2 = wasm_v128_load(f + 8);
+    const v128_t r3 = wasm_v128_load(f + 12);
+    const v128_t t0 = wasm_i32x4_shuffle(r0, r1, 0, 4, 1, 5);   // x0 x1 y0 y1
+    const v128_t t1 = wasm_i32x4_shuffle(r2, r3, 0, 4, 1, 5);   // x2 x3 y2 y3
+    const v128_t t2 = wasm_i32x4_shuffle(r0, r1, 2, 6, 3, 7);   // z0 z1 w0 w1
+    const v128_t t3 = wasm_i32x4_shuffle(r2, r3, 2, 6, 3, 7);   // z2 z3 w2 w3
+    x = wasm_i32x4_shuffle(t0, t1, 0, 1, 4, 5);
+    y = wasm_i32x4_shuffle(t0, t1, 2, 3, 6, 7);
+    z = wasm_i32x4_shuffle(t2, t3, 0, 1, 4, 5);
+    w = wasm_i32x4_shuffle(t2, t3, 2, 3, 6, 7);
+}
+
+void intersectsBoxesWasm(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+
+    v128_t px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (size_t j = 0; j < 6; j++) {
+        px[j] = wasm_f32x4_splat(planes[j].x);
+        py[j] = wasm_f32x4_splat(planes[j].y);
+        pz[j] = wasm_f32x4_splat(planes[j].z);
+        pw[j] = wasm_f32x4_splat(planes[j].w);
+        ax[j] = wasm_f32x4_splat(std::abs(planes[j].x));
+        ay[j] = wasm_f32x4_splat(std::abs(planes[j].y));
+        az[j] = wasm_f32x4_splat(std::abs(planes[j].z));
+    }
+
+    for (size_t i = 0; i < count; i += 8) {
+        int mask = 0;
+        for (size_t k = 0; k < 8; k += 4) {
+            v128_t cx, cy, cz, ex, ey, ez;
+            loadWasm(center + i + k, cx, cy, cz);
+            loadWasm(extent + i + k, ex, ey, ez);
+            v128_t visible = wasm_i32x4_splat(-1);
+            for (size_t j = 0; j < 6; j++) {
+                v128_t dot = wasm_f32x4_sub(wasm_f32x4_mul(px[j], cx), wasm_f32x4_mul(ax[j], ex));
+                dot = wasm_f32x4_add(dot, wasm_f32x4_mul(py[j], cy));
+                dot = wasm_f32x4_sub(dot, wasm_f32x4_mul(ay[j], ey));
+                dot = wasm_f32x4_add(dot, wasm_f32x4_mul(pz[j], cz));
+                dot = wasm_f32x4_sub(dot, wasm_f32x4_mul(az[j], ez));
+                dot = wasm_f32x4_add(dot, pw[j]);
+                visible = wasm_v128_and(visible, dot);
+            }
+            mask |= int(wasm_i32x4_bitmask(visible)) << k;
+        }
+        for (size_t k = 0; k < 8; k++) {
+            results[i + k] |= result_type(((mask >> k) & 1) << bit);
+        }
+    }
+}
+
+void intersectsSpheresWasm(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+
+    v128_t px[6], py[6], pz[6], pw[6];
+    for (size_t j = 0; j < 6; j++) {
+        px[j] = wasm_f32x4_splat(planes[j].x);
+        py[j] = wasm_f32x4_splat(planes[j].y);
+        pz[j] = wasm_f32x4_splat(planes[j].z);
+        pw[j] = wasm_f32x4_splat(planes[j].w);
+    }
+
+    for (size_t i = 0; i < count; i += 8) {
+        int mask = 0;
+        for (size_t k = 0; k < 8; k += 4) {
+            v128_t x, y, z, r;
+            loadWasm(b + i + k, x, y, z, r);
+            v128_t visible = wasm_i32x4_splat(-1);
+            for (size_t j = 0; j < 6; j++) {
+                v128_t dot = wasm_f32x4_mul(px[j], x);
+                dot = wasm_f32x4_add(dot, wasm_f32x4_mul(py[j], y));
+                dot = wasm_f32x4_add(dot, wasm_f32x4_mul(pz[j], z));
+                dot = wasm_f32x4_add(dot, pw[j]);
+                dot = wasm_f32x4_sub(dot, r);
+                visible = wasm_v128_and(visible, dot);
+            }
+            mask |= int(wasm_i32x4_bitmask(visible)) << k;
+        }
+        for (size_t k = 0; k < 8; k++) {
+            results[i + k] = result_type((mask >> k) & 1);
+        }
+    }
+}
+
+#endif // CULLER_HAS_WASM_SIMD
+
+// ------------------------------------------------------------------------------------------------
+// Dispatch
+// ------------------------------------------------------------------------------------------------
+
+struct Kernels {
+    BoxKernel boxes;
+    SphereKernel spheres;
+};
+
+bool isKernelSupported(Culler::Kernel kernel) noexcept {
+    switch (kernel) {
+        case Culler::Kernel::SCALAR:
+            return true;
+        case Culler::Kernel::SSE:
+            return CULLER_HAS_SSE;
+        case Culler::Kernel::AVX2:
+#if CULLER_HAS_AVX2
+            return cpuSupportsAVX2();
+#else
+            return false;
+#endif
+        case Culler::Kernel::NEON:
+            return CULLER_HAS_NEON;
+        case Culler::Kernel::WASM_SIMD:
+            return CULLER_HAS_WASM_SIMD;
+    }
+    return false;
+}
+
+Kernels getKernels(Culler::Kernel kernel) noexcept {
+    switch (kernel) {
+#if CULLER_HAS_SSE
+        case Culler::Kernel::SSE:
+            return { intersectsBoxesSSE, intersectsSpheresSSE };
+#endif
+#if CULLER_HAS_AVX2
+        case Culler::Kernel::AVX2:
+            return { intersectsBoxesAVX2, intersectsSpheresAVX2 };
+#endif
+#if CULLER_HAS_NEON
+        case Culler::Kernel::NEON:
+            return { intersectsBoxesNEON, intersectsSpheresNEON };
+#endif
+#if CULLER_HAS_WASM_SIMD
+        case Culler::Kernel::WASM_SIMD:
+            return { intersectsBoxesWasm, intersectsSpheresWasm };
+#endif
+        default:
+            return { intersectsBoxesScalar, intersectsSpheresScalar };
+    }
+}
+
+Culler::Kernel getBestKernel() noexcept {
+    for (Culler::Kernel kernel : { Culler::Kernel::AVX2, Culler::Kernel::NEON,
+            Culler::Kernel::SSE, Culler::Kernel::WASM_SIMD }) {
+        if (isKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return Culler::Kernel::SCALAR;
+}
+
+// CPU features don't change, so the selection is done only once
+Culler::Kernel getKernel() noexcept {
+    static const Culler::Kernel kernel = getBestKernel();
+    return kernel;
+}
+
+Kernels const& getKernels() noexcept {
+    static const Kernels kernels = getKernels(getKernel());
+    return kernels;
+}
+
+} // anonymous namespace
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+    getKernels().spheres(results, frustum.mPlanes, b, count);
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+    getKernels().boxes(results, frustum.mPlanes, center, extent, count, bit);
+}
+
+void Culler::intersectsCones(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT spheres,
+        float3 const* UTILS_RESTRICT axes,
+        float const* UTILS_RESTRICT cosSqr,
+        size_t count) noexcept {
+    float4 const* const UTILS_RESTRICT planes = frustum.getNormalizedPlanes();
+
+    // A cone is outside of the frustum when its apex is outside of a plane and the cone points
+    // away from it at an angle the cone can't cover. This is branch-less so it gets vectorized
+    // like the other scalar kernels.
+    #pragma clang loop vectorize_width(8)
+    for (size_t i = 0; i < count; i++) {
+        int invisible = 0;
+
+        #pragma clang loop unroll(full)
+        for (size_t j = 0; j < 6; j++) {
+            const float p = planes[j].x * spheres[i].x +
+                            planes[j].y * spheres[i].y +
+                            planes[j].z * spheres[i].z +
+                            planes[j].w;
+            const float c = planes[j].x * axes[i].x +
+                            planes[j].y * axes[i].y +
+                            planes[j].z * axes[i].z;
+            invisible |= int((1.0f - c * c) < cosSqr[i]) & int(c > 0.0f) & int(p > 0.0f);
+        }
+
+        // 0 clears the result, ~0 keeps it
+        results[i] &= result_type(invisible - 1);
+    }
+}
+
 /*
  * returns whether a box intersects with the frustum
  */
@@ -136,4 +722,30 @@ void Culler::Test::intersects(
     Culler::intersects(results, frustum, b, count);
 }
 
+Culler::Kernel Culler::Test::getKernel() noexcept {
+    return filament::getKernel();
+}
+
+bool Culler::Test::isSupported(Kernel kernel) noexcept {
+    return isKernelSupported(kernel);
+}
+
+void Culler::Test::intersects(Kernel kernel,
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float3 const* UTILS_RESTRICT c,
+        float3 const* UTILS_RESTRICT e,
+        size_t count) noexcept {
+    assert(isKernelSupported(kernel));
+    getKernels(kernel).boxes(results, frustum.mPlanes, c, e, round(count), 0);
+}
+
+void Culler::Test::intersects(Kernel kernel,
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT b, size_t count) noexcept {
+    assert(isKernelSupported(kernel));
+    getKernels(kernel).spheres(results, frustum.mPlanes, b, round(count));
+}
+
 } // namespace filament
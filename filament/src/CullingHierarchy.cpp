@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/CullingHierarchy.h"
+
+#include <filament/Frustum.h>
+
+#include <utils/Systrace.h>
+
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <limits>
+
+using namespace filament::math;
+
+namespace filament {
+
+namespace {
+
+enum class Classification {
+    OUTSIDE, INTERSECTS, INSIDE
+};
+
+inline Classification classify(float4 const* UTILS_RESTRICT planes, Box const& box) noexcept {
+    Classification result = Classification::INSIDE;
+    for (size_t j = 0; j < 6; j++) {
+        const float d = dot(planes[j].xyz, box.center) + planes[j].w;
+        const float r = dot(abs(planes[j].xyz), box.halfExtent);
+        if (d - r >= 0) {
+            // entirely in front of a plane, i.e. outside of the frustum
+            return Classification::OUTSIDE;
+        }
+        if (d + r >= 0) {
+            result = Classification::INTERSECTS;
+        }
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+void CullingHierarchy::clear() noexcept {
+    mNodes.clear();
+    mIndices.clear();
+    mLeaves.clear();
+    mInstances.clear();
+    mBoxes.clear();
+    mDirty.clear();
+}
+
+void CullingHierarchy::update(Instance const* instances, float3 const* centers,
+        float3 const* extents, size_t count) noexcept {
+    SYSTRACE_CALL();
+
+    const bool changed = mInstances.size() != count ||
+            !std::equal(mInstances.begin(), mInstances.end(), instances);
+
+    if (UTILS_UNLIKELY(changed)) {
+        mInstances.assign(instances, instances + count);
+        mBoxes.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            mBoxes[i] = { centers[i], extents[i] };
+        }
+        rebuild(count);
+        return;
+    }
+
+    // only refit the nodes containing renderables that moved
+    bool dirty = false;
+    for (size_t i = 0; i < count; i++) {
+        Box& box = mBoxes[i];
+        if (UTILS_UNLIKELY(box.center != centers[i] || box.halfExtent != extents[i])) {
+            box = { centers[i], extents[i] };
+            for (uint32_t n = mLeaves[i]; !mDirty[n]; n = mNodes[n].parent) {
+                mDirty[n] = true;
+            }
+            dirty = true;
+        }
+    }
+    if (dirty) {
+        refit();
+    }
+}
+
+void CullingHierarchy::rebuild(size_t count) noexcept {
+    SYSTRACE_CALL();
+
+    mNodes.clear();
+    mIndices.resize(count);
+    mLeaves.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        mIndices[i] = uint32_t(i);
+    }
+    if (count) {
+        // a balanced tree has at most 2 * count / (LEAF_SIZE / 2) nodes
+        mNodes.reserve(4 * count / LEAF_SIZE + 1);
+        build(0, 0, uint32_t(count));
+    }
+    mDirty.assign(mNodes.size(), false);
+}
+
+uint32_t CullingHierarchy::build(uint32_t parent, uint32_t first, uint32_t count) noexcept {
+    const uint32_t index = uint32_t(mNodes.size());
+    mNodes.push_back({ {}, first, count, 0, parent });
+
+    uint32_t* const indices = mIndices.data() + first;
+    Box const* const boxes = mBoxes.data();
+
+    // bounds of the renderables, and of their centers which we use to pick the split axis
+    float3 bmin(std::numeric_limits<float>::max());
+    float3 bmax(std::numeric_limits<float>::lowest());
+    float3 cmin(bmin);
+    float3 cmax(bmax);
+    for (uint32_t i = 0; i < count; i++) {
+        Box const& box = boxes[indices[i]];
+        bmin = min(bmin, box.getMin());
+        bmax = max(bmax, box.getMax());
+        cmin = min(cmin, box.center);
+        cmax = max(cmax, box.center);
+    }
+    mNodes[index].box.set(bmin, bmax);
+
+    if (count <= LEAF_SIZE) {
+        for (uint32_t i = 0; i < count; i++) {
+            mLeaves[indices[i]] = index;
+        }
+        return index;
+    }
+
+    // split at the median of the longest axis
+    const float3 size = cmax - cmin;
+    const size_t axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    const uint32_t half = count / 2;
+    std::nth_element(indices, indices + half, indices + count,
+            [boxes, axis](uint32_t lhs, uint32_t rhs) {
+                return boxes[lhs].center[axis] < boxes[rhs].center[axis];
+            });
+
+    build(index, first, half);
+    const uint32_t right = build(index, first + half, count - half);
+    mNodes[index].right = right;
+    return index;
+}
+
+void CullingHierarchy::refit() noexcept {
+    SYSTRACE_CALL();
+
+    // children always come after their parent, so going backward refits them first
+    for (size_t n = mNodes.size(); n-- > 0;) {
+        if (!mDirty[n]) {
+            continue;
+        }
+        mDirty[n] = false;
+        Node& node = mNodes[n];
+        if (node.right) {
+            node.box = mNodes[n + 1].box;
+            node.box.unionSelf(mNodes[node.right].box);
+        } else {
+            float3 bmin(std::numeric_limits<float>::max());
+            float3 bmax(std::numeric_limits<float>::lowest());
+            for (uint32_t i = node.first, e = node.first + node.count; i < e; i++) {
+                Box const& box = mBoxes[mIndices[i]];
+                bmin = min(bmin, box.getMin());
+                bmax = max(bmax, box.getMax());
+            }
+            node.box.set(bmin, bmax);
+        }
+    }
+}
+
+void CullingHierarchy::cull(Culler::result_type* UTILS_RESTRICT results,
+        Frustum const& frustum, size_t bit) const noexcept {
+    SYSTRACE_CALL();
+
+    if (mNodes.empty()) {
+        return;
+    }
+
+    float4 const* const planes = frustum.getNormalizedPlanes();
+    const Culler::result_type visible = Culler::result_type(1u << bit);
+    Node const* const nodes = mNodes.data();
+    uint32_t const* const indices = mIndices.data();
+    Box const* const boxes = mBoxes.data();
+
+    // the tree is balanced, so its depth is bounded by log2 of the number of renderables
+    uint32_t stack[64];
+    size_t top = 0;
+    stack[top++] = 0;
+    while (top) {
+        Node const& node = nodes[stack[--top]];
+        const Classification c = classify(planes, node.box);
+        if (c == Classification::OUTSIDE) {
+            continue;
+        }
+        if (c == Classification::INSIDE) {
+            for (uint32_t i = node.first, e = node.first + node.count; i < e; i++) {
+                results[indices[i]] |= visible;
+            }
+            continue;
+        }
+        if (node.right) {
+            stack[top++] = node.right;
+            stack[top++] = uint32_t(&node - nodes) + 1;
+        } else {
+            for (uint32_t i = node.first, e = node.first + node.count; i < e; i++) {
+                const uint32_t index = indices[i];
+                if (classify(planes, boxes[index]) != Classification::OUTSIDE) {
+                    results[index] |= visible;
+                }
+            }
+        }
+    }
+}
+
+} // namespace filament
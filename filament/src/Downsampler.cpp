@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Downsampler.h"
+
+#include <private/filament/EngineEnums.h>
+
+#include "private/backend/DriverApi.h"
+#include "private/backend/SamplerGroup.h"
+
+#include <private/backend/Program.h>
+
+#include <utils/CString.h>
+
+#include <math/vec4.h>
+
+#include <string>
+
+using namespace utils;
+
+namespace filament {
+
+using namespace backend;
+using namespace math;
+
+static constexpr uint8_t PARAMS_BINDING = BindingPoints::PER_RENDERABLE;
+static constexpr uint8_t SAMPLER_BINDING = BindingPoints::PER_MATERIAL_INSTANCE;
+static constexpr uint8_t COUNTER_BINDING = 0;
+
+struct DownsampleParams {
+    uint4 size;         // width, height, level count, work group count
+    float4 params;      // threshold, 1 / highlight, 1 / width, 1 / height
+};
+
+static std::string getShaderSource() {
+    return std::string("#version 430 core\n") +
+            "#define TILE_SIZE " + std::to_string(Downsampler::TILE_SIZE) + "u\n" +
+            "#define MAX_LEVELS " + std::to_string(Downsampler::MAX_LEVELS) + "\n" +
+            R"GLSL(
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(std140) uniform DownsampleParams {
+    uvec4 size;
+    vec4 params;
+} params;
+
+layout(std430, binding = 0) coherent buffer DownsampleCounter {
+    uint count;
+} counter;
+
+uniform sampler2D source;
+
+layout(binding = 0, r11f_g11f_b10f) uniform coherent highp image2D levels[MAX_LEVELS];
+
+shared vec3 tile[TILE_SIZE * TILE_SIZE];
+shared bool last;
+
+uint index(uvec2 p) {
+    return p.y * TILE_SIZE + p.x;
+}
+
+vec3 prefilter(vec3 c) {
+    float luma = max(c.r, max(c.g, c.b));
+    if (params.params.x > 0.0) {
+        // keep what's above 1.0, with the hue of the original color
+        c *= max(luma - 1.0, 0.0) / max(luma, 1e-5);
+        luma = max(luma - 1.0, 0.0);
+    }
+    // compress the highlights so that isolated bright pixels don't flicker
+    return c / (1.0 + luma * params.params.y);
+}
+
+void main() {
+    uvec2 size = params.size.xy;
+    uint levelCount = params.size.z;
+    uvec2 origin = gl_WorkGroupID.xy * TILE_SIZE;
+    uvec2 local = gl_LocalInvocationID.xy;
+
+    // level 0, each invocation filters 2x2 texels of the tile, with 4 bilinear taps each
+    vec2 d = 0.25 * params.params.zw;
+    for (uint i = 0u; i < 4u; i++) {
+        uvec2 t = local * 2u + uvec2(i & 1u, i >> 1u);
+        uvec2 p = origin + t;
+        vec2 uv = (vec2(p) + 0.5) * params.params.zw;
+        vec3 c = texture(source, uv + vec2(-d.x, -d.y)).rgb +
+                 texture(source, uv + vec2( d.x, -d.y)).rgb +
+                 texture(source, uv + vec2(-d.x,  d.y)).rgb +
+                 texture(source, uv + vec2( d.x,  d.y)).rgb;
+        c = prefilter(c * 0.25);
+        tile[index(t)] = c;
+        if (all(lessThan(p, size))) {
+            imageStore(levels[0], ivec2(p), vec4(c, 1.0));
+        }
+    }
+    memoryBarrierShared();
+    barrier();
+
+    // the following levels of the tile, in place: level l is stored every 2^l texels
+    uint tileLevels = min(levelCount, 6u);
+    for (uint l = 1u; l < tileLevels; l++) {
+        uint n = TILE_SIZE >> l;
+        if (local.x < n && local.y < n) {
+            uint s = 1u << (l - 1u);
+            uvec2 q = local << l;
+            vec3 c = tile[index(q)] + tile[index(q + uvec2(s, 0u))] +
+                     tile[index(q + uvec2(0u, s))] + tile[index(q + uvec2(s, s))];
+            c *= 0.25;
+            tile[index(q)] = c;
+            uvec2 p = (origin >> l) + local;
+            if (all(lessThan(p, max(size >> l, uvec2(1u))))) {
+                imageStore(levels[l], ivec2(p), vec4(c, 1.0));
+            }
+        }
+        memoryBarrierShared();
+        barrier();
+    }
+
+    if (levelCount <= 6u) {
+        return;
+    }
+
+    // The last work group to get here generates the remaining levels, from the level 5 texels
+    // written by all the work groups.
+    memoryBarrierImage();
+    if (local == uvec2(0u)) {
+        last = atomicAdd(counter.count, 1u) == params.size.w - 1u;
+    }
+    barrier();
+    if (!last) {
+        return;
+    }
+
+    for (uint l = 6u; l < levelCount; l++) {
+        ivec2 src = ivec2(max(size >> (l - 1u), uvec2(1u))) - 1;
+        uvec2 dst = max(size >> l, uvec2(1u));
+        for (uint y = local.y; y < dst.y; y += 16u) {
+            for (uint x = local.x; x < dst.x; x += 16u) {
+                ivec2 q = ivec2(x, y) * 2;
+                vec3 c = imageLoad(levels[l - 1u], min(q, src)).rgb +
+                         imageLoad(levels[l - 1u], min(q + ivec2(1, 0), src)).rgb +
+                         imageLoad(levels[l - 1u], min(q + ivec2(0, 1), src)).rgb +
+                         imageLoad(levels[l - 1u], min(q + ivec2(1, 1), src)).rgb;
+                imageStore(levels[l], ivec2(x, y), vec4(c * 0.25, 1.0));
+            }
+        }
+        memoryBarrierImage();
+        barrier();
+    }
+
+    // ready for the next dispatch
+    if (local == uvec2(0u)) {
+        counter.count = 0u;
+    }
+}
+)GLSL";
+}
+
+void Downsampler::init(DriverApi& driver) noexcept {
+    mComputeSupported = driver.isComputeSupported();
+}
+
+void Downsampler::terminate(DriverApi& driver) noexcept {
+    if (mProgram) {
+        driver.destroyProgram(mProgram);
+        driver.destroyUniformBuffer(mParamsUbh);
+        driver.destroySamplerGroup(mSamplerGroup);
+        driver.destroyBufferObject(mCounter);
+    }
+}
+
+void Downsampler::downsample(DriverApi& driver,
+        Handle<HwTexture> source, Handle<HwTexture> destination,
+        uint32_t width, uint32_t height, uint8_t levels, Prefilter prefilter) noexcept {
+    assert(isSupported(FORMAT, levels));
+
+    if (UTILS_UNLIKELY(!mProgram)) {
+        const std::string shader = getShaderSource();
+        const Program::Sampler sampler{ CString("source"), 0 };
+        Program program;
+        program.diagnostics(CString("Downsampler"))
+                .withComputeShader(shader.data(), shader.size())
+                .setUniformBlock(PARAMS_BINDING, CString("DownsampleParams"))
+                .setSamplerGroup(SAMPLER_BINDING, &sampler, 1);
+        mProgram = driver.createProgram(std::move(program));
+        mParamsUbh = driver.createUniformBuffer(sizeof(DownsampleParams), BufferUsage::DYNAMIC);
+        mSamplerGroup = driver.createSamplerGroup(1);
+        mCounter = driver.createBufferObject(sizeof(uint32_t),
+                BufferObjectBinding::SHADER_STORAGE, BufferUsage::DYNAMIC);
+        // the counter is reset by the last work group of each dispatch after that
+        uint32_t* const zero = static_cast<uint32_t*>(driver.allocate(sizeof(uint32_t)));
+        *zero = 0;
+        driver.updateBufferObject(mCounter, { zero, sizeof(uint32_t) }, 0);
+    }
+
+    const uint32_t groupCountX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const uint32_t groupCountY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    DownsampleParams* const params = driver.allocatePod<DownsampleParams>();
+    params->size = { width, height, levels, groupCountX * groupCountY };
+    params->params = {
+            prefilter.threshold ? 1.0f : 0.0f, prefilter.invHighlight,
+            1.0f / float(width), 1.0f / float(height) };
+    driver.loadUniformBuffer(mParamsUbh, { params, sizeof(DownsampleParams) });
+
+    SamplerGroup samplers(1);
+    samplers.setSampler(0, source, {
+            .filterMag = SamplerMagFilter::LINEAR,
+            .filterMin = SamplerMinFilter::LINEAR });
+    driver.updateSamplerGroup(mSamplerGroup, std::move(samplers.toCommandStream()));
+
+    driver.bindUniformBuffer(PARAMS_BINDING, mParamsUbh);
+    driver.bindSamplers(SAMPLER_BINDING, mSamplerGroup);
+    driver.bindBufferObject(COUNTER_BINDING, mCounter);
+    for (uint8_t level = 0; level < levels; level++) {
+        driver.bindImage(level, destination, level);
+    }
+    driver.dispatchCompute(mProgram, { groupCountX, groupCountY, 1 });
+}
+
+} // namespace filament
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DOWNSAMPLER_H
+#define TNT_FILAMENT_DOWNSAMPLER_H
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include "private/backend/DriverApiForward.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+// Generates a whole mip chain in a single compute dispatch, instead of one render pass per level.
+// Each work group downsamples a tile of the first level down to a single texel in shared memory,
+// then the last work group to finish generates the remaining levels from those texels.
+class Downsampler {
+public:
+    // the levels are bound to as many image units, the minimum guaranteed by GL 4.3
+    static constexpr size_t MAX_LEVELS = 8;
+
+    // size of the tile of the first level handled by each work group (16x16 invocations)
+    static constexpr uint32_t TILE_SIZE = 32;
+
+    // filter applied when sampling the source, e.g. to extract the highlights for bloom
+    struct Prefilter {
+        bool threshold = false;     // keep only what's above 1.0
+        float invHighlight = 0.0f;  // compress the highlights above 1/invHighlight, 0 to disable
+    };
+
+    Downsampler() noexcept = default;
+    Downsampler(Downsampler const& rhs) = delete;
+    Downsampler& operator=(Downsampler const& rhs) = delete;
+
+    void init(backend::DriverApi& driver) noexcept;
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // Whether a mip chain can be generated by downsample(), otherwise one render pass per level
+    // is needed.
+    bool isSupported(backend::TextureFormat format, size_t levels) const noexcept {
+        return mComputeSupported && format == FORMAT && levels <= MAX_LEVELS;
+    }
+
+    // Samples the level 0 of 'source' (bilinear) into the level 0 of 'destination', then
+    // generates its following levels. 'width' and 'height' are the size of the destination.
+    void downsample(backend::DriverApi& driver,
+            backend::Handle<backend::HwTexture> source,
+            backend::Handle<backend::HwTexture> destination,
+            uint32_t width, uint32_t height, uint8_t levels, Prefilter prefilter) noexcept;
+
+private:
+    // the only format with an image format qualifier that's used for mip chains
+    static constexpr backend::TextureFormat FORMAT = backend::TextureFormat::R11F_G11F_B10F;
+
+    backend::Handle<backend::HwProgram> mProgram;
+    backend::Handle<backend::HwUniformBuffer> mParamsUbh;
+    backend::Handle<backend::HwSamplerGroup> mSamplerGroup;
+    backend::Handle<backend::HwBufferObject> mCounter;
+    bool mComputeSupported = false;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DOWNSAMPLER_H
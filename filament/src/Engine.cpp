@@ -24,6 +24,7 @@
 #include "details/VertexBuffer.h"
 #include "details/Fence.h"
 #include "details/Camera.h"
+#include "details/Impostor.h"
 #include "details/IndexBuffer.h"
 #include "details/IndirectLight.h"
 #include "details/Material.h"
@@ -38,13 +39,21 @@
 
 #include <private/filament/SibGenerator.h>
 
+#include <filament/MaterialChunkType.h>
 #include <filament/MaterialEnums.h>
 
+#include <filaflat/ChunkContainer.h>
+#include <filaflat/DictionaryReader.h>
+#include <filaflat/Unflattener.h>
+
 #include <utils/compiler.h>
 #include <utils/Log.h>
+#include <utils/memalign.h>
 #include <utils/Panic.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 
 #include "generated/resources/materials.h"
@@ -57,11 +66,50 @@ namespace filament {
 using namespace backend;
 using namespace filaflat;
 
-FEngine* FEngine::create(Backend backend, Platform* platform, void* sharedGLContext) {
+// fills-in the defaults of a Config and makes its sizes consistent with each other
+static Engine::Config validateConfig(const Engine::Config* config) noexcept {
+    Engine::Config result = config ? *config : Engine::Config{};
+    if (!result.minCommandBufferSizeMB) {
+        result.minCommandBufferSizeMB = FILAMENT_MIN_COMMAND_BUFFERS_SIZE_IN_MB;
+    }
+    // the command buffer must hold at least 3 frames to not stall the render thread
+    result.commandBufferSizeMB =
+            std::max(result.commandBufferSizeMB, 3u * result.minCommandBufferSizeMB);
+    if (result.maxCommandBufferSizeMB) {
+        result.maxCommandBufferSizeMB =
+                std::max(result.maxCommandBufferSizeMB, result.commandBufferSizeMB);
+    }
+    if (!result.textureCacheSizeMB) {
+        result.textureCacheSizeMB = uint32_t(ResourceAllocator::DEFAULT_CACHE_CAPACITY >> 20u);
+    }
+    if (!result.textureCacheMaxAge) {
+        result.textureCacheMaxAge = uint32_t(ResourceAllocator::DEFAULT_CACHE_MAX_AGE);
+    }
+    if (!result.textureStreamingBudgetMB) {
+        result.textureStreamingBudgetMB = uint32_t(TextureStreamer::DEFAULT_BUDGET >> 20u);
+    }
+    if (!result.jobSystemMaxJobCount) {
+        result.jobSystemMaxJobCount = uint32_t(JobSystem::DEFAULT_MAX_JOB_COUNT);
+    }
+    result.jobSystemMaxJobCount =
+            std::min(result.jobSystemMaxJobCount, uint32_t(JobSystem::MAX_JOB_COUNT));
+    if (!result.scratchArenaSizeMB) {
+        result.scratchArenaSizeMB = 1;
+    }
+    if (!result.frameLatency) {
+        result.frameLatency = 1;
+    }
+    result.frameLatency =
+            std::min(result.frameLatency, uint32_t(FrameSkipper::MAX_FRAME_LATENCY - 1));
+    return result;
+}
+
+FEngine* FEngine::create(Backend backend, Platform* platform, void* sharedGLContext,
+        const Config* config) {
     SYSTRACE_ENABLE();
     SYSTRACE_CALL();
 
-    FEngine* instance = new FEngine(backend, platform, sharedGLContext);
+    FEngine* instance = new FEngine(backend, platform, sharedGLContext, validateConfig(config));
 
     // initialize all fields that need an instance of FEngine
     // (this cannot be done safely in the ctor)
@@ -78,6 +126,7 @@ FEngine* FEngine::create(Backend backend, Platform* platform, void* sharedGLCont
             slog.e << "Selected backend not supported in this build." << io::endl;
             return nullptr;
         }
+        platform->setFramesInFlight(instance->mConfig.frameLatency + 1);
         instance->mDriver = platform->createDriver(sharedGLContext);
     } else {
         // start the driver thread
@@ -106,10 +155,10 @@ FEngine* FEngine::create(Backend backend, Platform* platform, void* sharedGLCont
 #if UTILS_HAS_THREADING
 
 void FEngine::createAsync(CreateCallback callback, void* user,
-        Backend backend, Platform* platform, void* sharedGLContext) {
+        Backend backend, Platform* platform, void* sharedGLContext, const Config* config) {
     SYSTRACE_ENABLE();
     SYSTRACE_CALL();
-    FEngine* instance = new FEngine(backend, platform, sharedGLContext);
+    FEngine* instance = new FEngine(backend, platform, sharedGLContext, validateConfig(config));
 
     // start the driver thread
     instance->mDriverThread = std::thread(&FEngine::loop, instance);
@@ -160,18 +209,28 @@ static constexpr float4 sFullScreenTriangleVertices[3] = {
 // these must be static because only a pointer is copied to the render stream
 static const uint16_t sFullScreenTriangleIndices[3] = { 0, 1, 2 };
 
-FEngine::FEngine(Backend backend, Platform* platform, void* sharedGLContext) :
+FEngine::FEngine(Backend backend, Platform* platform, void* sharedGLContext,
+        Config const& config) :
         mBackend(backend),
         mPlatform(platform),
         mSharedGLContext(sharedGLContext),
+        mConfig(config),
         mPostProcessManager(*this),
         mEntityManager(EntityManager::get()),
         mRenderableManager(*this),
-        mTransformManager(),
+        mTransformManager(&mJobSystem),
         mLightManager(*this),
         mCameraManager(*this),
-        mCommandBufferQueue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, CONFIG_COMMAND_BUFFERS_SIZE),
-        mPerRenderPassAllocator("per-renderpass allocator", CONFIG_PER_RENDER_PASS_ARENA_SIZE),
+        mTextureStreamer(size_t(config.textureStreamingBudgetMB) * 1024 * 1024),
+        mCommandBufferQueue(size_t(config.minCommandBufferSizeMB) * 1024 * 1024,
+                size_t(config.commandBufferSizeMB) * 1024 * 1024),
+        mPerRenderPassAllocator("per-renderpass allocator", CONFIG_PER_RENDER_PASS_ARENA_SIZE,
+                getArenaOptions()),
+        mScratchArena("scratch allocator", size_t(config.scratchArenaSizeMB) * 1024 * 1024,
+                getArenaOptions()),
+        mJobSystem(JobSystem::Config{ config.jobSystemThreadCount, 1,
+                config.jobSystemMaxJobCount, config.jobSystemAffinityMask,
+                JobSystem::Priority::DISPLAY, config.jobSystemExecutor }),
         mEngineEpoch(std::chrono::steady_clock::now()),
         mDriverBarrier(1),
         mMainThreadId(std::this_thread::get_id())
@@ -192,11 +251,26 @@ FEngine::FEngine(Backend backend, Platform* platform, void* sharedGLContext) :
 void FEngine::init() {
     SYSTRACE_CALL();
 
+#ifndef NDEBUG
+    // breakdown of the time spent initializing the engine, printed at the end
+    auto t = clock::now();
+    std::pair<const char*, float> timings[4];
+    size_t timingCount = 0;
+    auto checkpoint = [&](const char* name) {
+        auto now = clock::now();
+        timings[timingCount++] = { name, std::chrono::duration<float, std::milli>(now - t).count() };
+        t = now;
+    };
+#else
+    auto checkpoint = [](const char*) {};
+#endif
+
     // this must be first.
     mCommandStream = CommandStream(*mDriver, mCommandBufferQueue.getCircularBuffer());
     DriverApi& driverApi = getDriverApi();
 
-    mResourceAllocator = new ResourceAllocator(driverApi);
+    mResourceAllocator = new ResourceAllocator(driverApi,
+            size_t(mConfig.textureCacheSizeMB) * 1024 * 1024, mConfig.textureCacheMaxAge);
 
     mFullScreenTriangleVb = upcast(VertexBuffer::Builder()
             .vertexCount(3)
@@ -240,17 +314,27 @@ void FEngine::init() {
             .irradiance(3, reinterpret_cast<const float3*>(sh))
             .build(*this));
 
-    mDefaultColorGrading = upcast(ColorGrading::Builder().build(*this));
+    checkpoint("default resources");
 
     // Always initialize the default material, most materials' depth shaders fallback on it.
-    mDefaultMaterial = upcast(
-            FMaterial::DefaultMaterialBuilder()
-                    .package(MATERIALS_DEFAULTMATERIAL_DATA, MATERIALS_DEFAULTMATERIAL_SIZE)
-                    .build(*const_cast<FEngine*>(this)));
+    mDefaultMaterial = createEmbeddedMaterial(
+            MATERIALS_DEFAULTMATERIAL_DATA, MATERIALS_DEFAULTMATERIAL_SIZE, true);
+    checkpoint("default material");
 
     mPostProcessManager.init();
+    mComputeSkinning.init(driverApi);
     mLightManager.init(*this);
+    checkpoint("post-process and lights");
+
     mDFG = std::make_unique<DFG>(*this);
+    checkpoint("DFG");
+
+#ifndef NDEBUG
+    for (size_t i = 0; i < timingCount; i++) {
+        slog.d << "Engine init: " << timings[i].first << " " << timings[i].second << " ms"
+               << io::endl;
+    }
+#endif
 }
 
 FEngine::~FEngine() noexcept {
@@ -273,9 +357,11 @@ void FEngine::shutdown() {
 #ifndef NDEBUG
     // print out some statistics about this run
     size_t wm = mCommandBufferQueue.getHighWatermark();
-    size_t wmpct = wm / (CONFIG_COMMAND_BUFFERS_SIZE / 100);
+    size_t wmpct = wm / (mCommandBufferQueue.getCapacity() / 100);
     slog.d << "CircularBuffer: High watermark "
            << wm / 1024 << " KiB (" << wmpct << "%)" << io::endl;
+    slog.d << "JobSystem: Peak job count " << mJobSystem.getPeakJobCount()
+           << " / " << mJobSystem.getMaxJobCount() << io::endl;
 #endif
 
     DriverApi& driver = getDriverApi();
@@ -284,10 +370,12 @@ void FEngine::shutdown() {
      * Destroy our own state first
      */
 
+    mFrameJobs.clear();                     // drop the pending work, it may use our state
     mPostProcessManager.terminate(driver);  // free-up post-process manager resources
     mResourceAllocator->terminate();
     mDFG->terminate();                      // free-up the DFG
     mRenderableManager.terminate();         // free-up all renderables
+    mComputeSkinning.terminate(driver);     // after the renderables, which use its palette
     mLightManager.terminate();              // free-up all lights
     mCameraManager.terminate();             // free-up all cameras
 
@@ -298,10 +386,15 @@ void FEngine::shutdown() {
     destroy(mDefaultIblTexture);
     destroy(mDefaultIbl);
 
-    destroy(mDefaultColorGrading);
+    if (mDefaultColorGrading) {
+        destroy(mDefaultColorGrading);
+    }
 
     destroy(mDefaultMaterial);
 
+    // the objects whose destruction was deferred, including some of ours above
+    processDeferredDestructions(true);
+
     /*
      * clean-up after the user -- we call terminate on each "leaked" object and clear each list.
      *
@@ -309,14 +402,19 @@ void FEngine::shutdown() {
      */
 
     // try to destroy objects in the inverse dependency
+    cleanupResourceList(mImpostors);
+    cleanupResourceList(mReflectionProbes);
     cleanupResourceList(mRenderers);
     cleanupResourceList(mViews);
     cleanupResourceList(mScenes);
     cleanupResourceList(mSkyboxes);
     cleanupResourceList(mColorGradings);
+    mColorGradingLutCache.terminate(driver);
 
     // this must be done after Skyboxes and before materials
     destroy(mSkyboxMaterial);
+    destroy(mImpostorMaterials[0]);
+    destroy(mImpostorMaterials[1]);
 
     cleanupResourceList(mIndexBuffers);
     cleanupResourceList(mVertexBuffers);
@@ -347,6 +445,9 @@ void FEngine::shutdown() {
 
     }
 
+    // all the commands of the other threads were executed with the engine's
+    mProducerStreams.clear();
+
     // Finally, call user callbacks that might have been scheduled.
     // These callbacks CANNOT call driver APIs.
     getDriver().purge();
@@ -361,22 +462,71 @@ void FEngine::shutdown() {
     mTerminated = true;
 }
 
+template<typename F>
+void FEngine::forEachMaterialInstance(F f) {
+    for (auto& materialInstanceList : mMaterialInstances) {
+        for (const auto& item : materialInstanceList.second) {
+            f(item);
+        }
+    }
+    // and the default material instances
+    for (const auto& material : mMaterials) {
+        f(material->getDefaultInstance());
+    }
+}
+
 void FEngine::prepare() {
     SYSTRACE_CALL();
     // prepare() is called once per Renderer frame. Ideally we would upload the content of
     // UBOs that are visible only. It's not such a big issue because the actual upload() is
     // skipped is the UBO hasn't changed. Still we could have a lot of these.
     FEngine::DriverApi& driver = getDriverApi();
-    for (auto& materialInstanceList : mMaterialInstances) {
-        for (const auto& item : materialInstanceList.second) {
-            item->commit(driver);
+
+    // streaming can change the HwTexture of textures, the samplers using them are updated
+    // before they're committed below
+    if (UTILS_UNLIKELY(!mTextureStreamer.empty())) {
+        if (mTextureStreamer.update(driver)) {
+            forEachMaterialInstance([](FMaterialInstance* mi) {
+                mi->updateStreamedTextures();
+            });
         }
     }
 
-    // Commit default material instances.
-    for (const auto& material : mMaterials) {
-        material->getDefaultInstance()->commit(driver);
+    // The uniforms of all the material instances are updated with a single command, which only
+    // carries the range of uniforms that changed in each of them.
+    size_t size = 0;
+    forEachMaterialInstance([&size](FMaterialInstance const* mi) {
+        size += mi->getUniformsUpdateSize();
+    });
+    if (size) {
+        BufferDescriptor updates(driver.allocate(size), size);
+        void* p = updates.buffer;
+        forEachMaterialInstance([&p](FMaterialInstance const* mi) {
+            if (mi->getUniformsUpdateSize()) {
+                p = mi->writeUniformsUpdate(p);
+            }
+        });
+        driver.updateUniformBuffers(std::move(updates));
     }
+
+    // the uniforms are clean at this point, this commits the samplers
+    forEachMaterialInstance([&driver](FMaterialInstance const* mi) {
+        mi->commit(driver);
+    });
+
+    if (UTILS_UNLIKELY(!mFrameJobs.empty())) {
+        std::vector<PendingFrameJob> jobs;
+        std::swap(jobs, mFrameJobs);
+        for (PendingFrameJob& pending : jobs) {
+            if (!pending.job(driver)) {
+                mFrameJobs.push_back(std::move(pending));
+            }
+        }
+    }
+}
+
+void FEngine::addFrameJob(FTexture const* texture0, FTexture const* texture1, FrameJob job) {
+    mFrameJobs.push_back({{ texture0, texture1 }, std::move(job) });
 }
 
 void FEngine::gc() {
@@ -386,23 +536,66 @@ void FEngine::gc() {
     auto *parent = js.createJob();
     auto em = std::ref(mEntityManager);
 
-    js.run(jobs::createJob(js, parent, &FRenderableManager::gc, &mRenderableManager, em),
+    // with a destruction budget, each manager removes at most that many components per frame
+    const size_t maxCount = mConfig.destructionBudget ?
+            size_t(mConfig.destructionBudget) : std::numeric_limits<size_t>::max();
+
+    js.run(jobs::createJob(js, parent, &FRenderableManager::gc, &mRenderableManager, em, maxCount),
             JobSystem::DONT_SIGNAL);
-    js.run(jobs::createJob(js, parent, &FLightManager::gc, &mLightManager, em),
+    js.run(jobs::createJob(js, parent, &FLightManager::gc, &mLightManager, em, maxCount),
             JobSystem::DONT_SIGNAL);
-    js.run(jobs::createJob(js, parent, &FTransformManager::gc, &mTransformManager, em),
+    js.run(jobs::createJob(js, parent, &FTransformManager::gc, &mTransformManager, em, maxCount),
             JobSystem::DONT_SIGNAL);
-    js.run(jobs::createJob(js, parent, &FCameraManager::gc, &mCameraManager, em),
+    js.run(jobs::createJob(js, parent, &FCameraManager::gc, &mCameraManager, em, maxCount),
             JobSystem::DONT_SIGNAL);
 
     js.runAndWait(parent);
 }
 
+void FEngine::processDeferredDestructions(bool all) {
+    auto& pending = mDeferredDestructions;
+    size_t count = all ? pending.size() : std::min(pending.size(), size_t(mConfig.destructionBudget));
+    while (count--) {
+        DeferredDestruction const item = pending.front();
+        pending.pop_front();
+        item.destroy(*this, item.object);
+    }
+}
+
 void FEngine::flush() {
     // flush the command buffer
     flushCommandBuffer(mCommandBufferQueue);
 }
 
+void FEngine::growCommandBufferIfNeeded() {
+#if UTILS_HAS_THREADING
+    CommandBufferQueue& queue = mCommandBufferQueue;
+    const size_t capacity = queue.getCapacity();
+    const size_t requiredSize = queue.getRequiredSize();
+    const size_t maxCapacity = size_t(mConfig.maxCommandBufferSizeMB) * 1024 * 1024;
+
+    // flush() blocks when less than requiredSize is free, grow before that happens
+    if (UTILS_LIKELY(capacity >= maxCapacity ||
+            queue.getHighWatermark() <= capacity - requiredSize - requiredSize / 4)) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    // this keeps the ratio between the two sizes
+    const size_t newCapacity = std::min(maxCapacity, capacity * 2);
+    const size_t newRequiredSize = requiredSize * newCapacity / capacity;
+
+    slog.i << "CircularBuffer: growing from " << capacity / 1024 << " KiB to "
+           << newCapacity / 1024 << " KiB (high watermark "
+           << queue.getHighWatermark() / 1024 << " KiB)" << io::endl;
+
+    // the gc() of the component managers might have added some commands
+    flush();
+    queue.resize(newRequiredSize, newCapacity);
+#endif
+}
+
 void FEngine::flushAndWait() {
 
 #if defined(ANDROID)
@@ -490,6 +683,8 @@ int FEngine::loop() {
     JobSystem::setThreadName("FEngine::loop");
     JobSystem::setThreadPriority(JobSystem::Priority::DISPLAY);
 
+    // the frames the CPU can be ahead of the GPU, plus the one being recorded
+    mPlatform->setFramesInFlight(mConfig.frameLatency + 1);
     mDriver = mPlatform->createDriver(mSharedGLContext);
     mDriverBarrier.latch();
     if (UTILS_UNLIKELY(!mDriver)) {
@@ -522,6 +717,53 @@ void FEngine::flushCommandBuffer(CommandBufferQueue& commandQueue) {
     commandQueue.flush();
 }
 
+struct FEngine::ProducerStream {
+    explicit ProducerStream(DriverApi const& primary)
+            : queue(CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE, CONFIG_PRODUCER_COMMAND_BUFFERS_SIZE),
+              stream(primary, queue.getCircularBuffer()) {
+    }
+    // only the circular buffer and the accounting of its memory are used, the commands are
+    // executed from the engine's queue
+    CommandBufferQueue queue;
+    DriverApi stream;
+};
+
+FEngine::ProducerStream& FEngine::getProducerStream() {
+    std::lock_guard<utils::Mutex> lock(mProducerStreamsLock);
+    std::unique_ptr<ProducerStream>& producer = mProducerStreams[std::this_thread::get_id()];
+    if (UTILS_UNLIKELY(!producer)) {
+        producer = std::make_unique<ProducerStream>(mCommandStream);
+    }
+    return *producer;
+}
+
+FEngine::ResourceCommands::ResourceCommands(FEngine& engine) noexcept
+        : mEngine(engine),
+          mProducer(UTILS_LIKELY(engine.isEngineThread()) ? nullptr : &engine.getProducerStream()),
+          mDriverApi(mProducer ? mProducer->stream : engine.getDriverApi()) {
+}
+
+FEngine::ResourceCommands::~ResourceCommands() noexcept {
+    if (UTILS_UNLIKELY(mProducer)) {
+        mEngine.mCommandBufferQueue.flush(mProducer->queue);
+    }
+}
+
+FMaterial* FEngine::createEmbeddedMaterial(uint8_t const* data, size_t size,
+        bool defaultMaterial) noexcept {
+    const size_t packageSize = resgen::getUncompressedSize(data);
+    std::unique_ptr<uint8_t[]> package(new uint8_t[packageSize]);
+    UTILS_UNUSED_IN_RELEASE bool success = resgen::decompress(data, size, package.get());
+    assert(success);
+
+    // the builder copies the package
+    if (defaultMaterial) {
+        return upcast(FMaterial::DefaultMaterialBuilder()
+                .package(package.get(), packageSize).build(*this));
+    }
+    return upcast(Material::Builder().package(package.get(), packageSize).build(*this));
+}
+
 const FMaterial* FEngine::getSkyboxMaterial() const noexcept {
     FMaterial const* material = mSkyboxMaterial;
     if (UTILS_UNLIKELY(material == nullptr)) {
@@ -531,6 +773,30 @@ const FMaterial* FEngine::getSkyboxMaterial() const noexcept {
     return material;
 }
 
+const FMaterial* FEngine::getImpostorMaterial(bool instanced) const noexcept {
+    FMaterial const* material = mImpostorMaterials[instanced];
+    if (UTILS_UNLIKELY(material == nullptr)) {
+        FEngine* const engine = const_cast<FEngine*>(this);
+        material = instanced ?
+                engine->createEmbeddedMaterial(MATERIALS_IMPOSTORINSTANCED_DATA,
+                        MATERIALS_IMPOSTORINSTANCED_SIZE) :
+                engine->createEmbeddedMaterial(MATERIALS_IMPOSTOR_DATA, MATERIALS_IMPOSTOR_SIZE);
+        mImpostorMaterials[instanced] = material;
+    }
+    return material;
+}
+
+const FColorGrading* FEngine::getDefaultColorGrading() const noexcept {
+    // building the default LUT is one of the most expensive steps of the engine's startup,
+    // so it's deferred until the first View needs it
+    FColorGrading* colorGrading = mDefaultColorGrading;
+    if (UTILS_UNLIKELY(colorGrading == nullptr)) {
+        colorGrading = upcast(ColorGrading::Builder().build(*const_cast<FEngine*>(this)));
+        mDefaultColorGrading = colorGrading;
+    }
+    return colorGrading;
+}
+
 // -----------------------------------------------------------------------------------------------
 // Resource management
 // -----------------------------------------------------------------------------------------------
@@ -539,8 +805,8 @@ const FMaterial* FEngine::getSkyboxMaterial() const noexcept {
  * Object created from a Builder
  */
 
-template <typename T>
-inline T* FEngine::create(ResourceList<T>& list, typename T::Builder const& builder) noexcept {
+template <typename T, typename L>
+inline T* FEngine::create(ResourceList<T, L>& list, typename T::Builder const& builder) noexcept {
     T* p = mHeapAllocator.make<T>(*this, builder);
     list.insert(p);
     return p;
@@ -566,6 +832,28 @@ FMaterial* FEngine::createMaterial(const Material::Builder& builder) noexcept {
     return create(mMaterials, builder);
 }
 
+bool FEngine::loadShaderDictionary(const void* data, size_t size) noexcept {
+    ChunkContainer container(data, size);
+    uint64_t id = 0;
+    if (!container.parse() || !container.hasChunk(filamat::ChunkType::DictionaryShared) ||
+            !Unflattener(container.getChunkStart(filamat::ChunkType::DictionaryShared),
+                    container.getChunkEnd(filamat::ChunkType::DictionaryShared)).read(&id) ||
+            !container.hasChunk(filamat::ChunkType::DictionaryText)) {
+        slog.e << "not a shared shader dictionary" << io::endl;
+        return false;
+    }
+    if (mShaderDictionaries.find(id) != mShaderDictionaries.end()) {
+        return true;
+    }
+    std::unique_ptr<BlobDictionary> dictionary(new BlobDictionary());
+    if (!DictionaryReader::unflatten(container, filamat::ChunkType::DictionaryText, *dictionary)) {
+        slog.e << "could not parse the shared shader dictionary" << io::endl;
+        return false;
+    }
+    mShaderDictionaries.emplace(id, std::move(dictionary));
+    return true;
+}
+
 FSkybox* FEngine::createSkybox(const Skybox::Builder& builder) noexcept {
     return create(mSkyboxes, builder);
 }
@@ -574,6 +862,15 @@ FColorGrading* FEngine::createColorGrading(const ColorGrading::Builder& builder)
     return create(mColorGradings, builder);
 }
 
+FReflectionProbe* FEngine::createReflectionProbe(
+        const ReflectionProbe::Builder& builder) noexcept {
+    return create(mReflectionProbes, builder);
+}
+
+FImpostor* FEngine::createImpostor(const Impostor::Builder& builder) noexcept {
+    return create(mImpostors, builder);
+}
+
 FStream* FEngine::createStream(const Stream::Builder& builder) noexcept {
     return create(mStreams, builder);
 }
@@ -722,14 +1019,33 @@ bool FEngine::terminateAndDestroy(const T* ptr, ResourceList<T, L>& list) {
     return success;
 }
 
+template<typename T, typename L>
+bool FEngine::terminateAndDestroyDeferred(const T* ptr, ResourceList<T, L>& list) {
+    if (!mConfig.destructionBudget) {
+        return terminateAndDestroy(ptr, list);
+    }
+    if (ptr == nullptr) return true;
+    bool success = list.remove(ptr);
+    if (ASSERT_PRECONDITION_NON_FATAL(success,
+            "Object %s at %p doesn't exist (double free?)",
+            CallStack::typeName<T>().c_str(), ptr)) {
+        mDeferredDestructions.push_back({ const_cast<T*>(ptr), [](FEngine& engine, void* p) {
+            T* const object = static_cast<T*>(p);
+            object->terminate(engine);
+            engine.mHeapAllocator.destroy(object);
+        }});
+    }
+    return success;
+}
+
 // -----------------------------------------------------------------------------------------------
 
 bool FEngine::destroy(const FVertexBuffer* p) {
-    return terminateAndDestroy(p, mVertexBuffers);
+    return terminateAndDestroyDeferred(p, mVertexBuffers);
 }
 
 bool FEngine::destroy(const FIndexBuffer* p) {
-    return terminateAndDestroy(p, mIndexBuffers);
+    return terminateAndDestroyDeferred(p, mIndexBuffers);
 }
 
 inline bool FEngine::destroy(const FRenderer* p) {
@@ -748,9 +1064,28 @@ inline bool FEngine::destroy(const FColorGrading* p) {
     return terminateAndDestroy(p, mColorGradings);
 }
 
+inline bool FEngine::destroy(const FReflectionProbe* p) {
+    return terminateAndDestroy(p, mReflectionProbes);
+}
+
+inline bool FEngine::destroy(const FImpostor* p) {
+    return terminateAndDestroy(p, mImpostors);
+}
+
 UTILS_NOINLINE
 bool FEngine::destroy(const FTexture* p) {
-    return terminateAndDestroy(p, mTextures);
+    if (UTILS_UNLIKELY(!mFrameJobs.empty())) {
+        mFrameJobs.erase(std::remove_if(mFrameJobs.begin(), mFrameJobs.end(),
+                [p](PendingFrameJob const& pending) {
+                    return pending.textures[0] == p || pending.textures[1] == p;
+                }), mFrameJobs.end());
+    }
+    if (UTILS_UNLIKELY(p && p->isStreamed())) {
+        forEachMaterialInstance([p](FMaterialInstance* mi) {
+            mi->forgetStreamedTexture(p);
+        });
+    }
+    return terminateAndDestroyDeferred(p, mTextures);
 }
 
 bool FEngine::destroy(const FRenderTarget* p) {
@@ -798,7 +1133,7 @@ bool FEngine::destroy(const FMaterialInstance* ptr) {
     auto pos = mMaterialInstances.find(ptr->getMaterial());
     assert(pos != mMaterialInstances.cend());
     if (pos != mMaterialInstances.cend()) {
-        return terminateAndDestroy(ptr, pos->second);
+        return terminateAndDestroyDeferred(ptr, pos->second);
     }
     // if we don't find this instance's material it might be because it's the default instance
     // in which case it fine to ignore.
@@ -820,6 +1155,34 @@ void* FEngine::streamAlloc(size_t size, size_t alignment) noexcept {
     return getDriverApi().allocate(size, alignment);
 }
 
+Engine::MemoryStats FEngine::getMemoryStats() const noexcept {
+    MemoryStats stats;
+    mTextures.forEach([&stats](FTexture const* texture) {
+        stats.textures += texture->getMemorySize();
+    });
+    mVertexBuffers.forEach([&stats](FVertexBuffer const* vertexBuffer) {
+        stats.vertexBuffers += vertexBuffer->getMemorySize();
+    });
+    mIndexBuffers.forEach([&stats](FIndexBuffer const* indexBuffer) {
+        stats.indexBuffers += indexBuffer->getMemorySize();
+    });
+    for (FView const* view : mViews) {
+        stats.shadowMaps += view->getShadowMapMemorySize();
+    }
+
+    // the shadow maps are allocated by the ResourceAllocator too
+    ResourceAllocator::Stats const resources = mResourceAllocator->getStats();
+    stats.renderTargets = resources.inUsePeak - std::min(resources.inUsePeak, stats.shadowMaps);
+    stats.resourceCache = resources.cacheSize;
+
+    stats.backendTotal = getDriver().getAllocatedGpuMemory();
+    backend::GpuMemoryPoolStats const pools = getDriver().getGpuMemoryPoolStats();
+    stats.backendPooled = pools.pooled;
+    stats.backendPoolUnused = pools.unused;
+    stats.backendRelocated = pools.relocated;
+    return stats;
+}
+
 bool FEngine::execute() {
 
     // wait until we get command buffers to be executed (or thread exit requested)
@@ -850,8 +1213,9 @@ void FEngine::destroy(FEngine* engine) {
 // Trampoline calling into private implementation
 // ------------------------------------------------------------------------------------------------
 
-Engine* Engine::create(Backend backend, Platform* platform, void* sharedGLContext) {
-    return FEngine::create(backend, platform, sharedGLContext);
+Engine* Engine::create(Backend backend, Platform* platform, void* sharedGLContext,
+        const Config* config) {
+    return FEngine::create(backend, platform, sharedGLContext, config);
 }
 
 void Engine::destroy(Engine* engine) {
@@ -860,8 +1224,8 @@ void Engine::destroy(Engine* engine) {
 
 #if UTILS_HAS_THREADING
 void Engine::createAsync(Engine::CreateCallback callback, void* user, Backend backend,
-        Platform* platform, void* sharedGLContext) {
-    FEngine::createAsync(callback, user, backend, platform, sharedGLContext);
+        Platform* platform, void* sharedGLContext, const Config* config) {
+    FEngine::createAsync(callback, user, backend, platform, sharedGLContext, config);
 }
 
 Engine* Engine::getEngine(void* token) {
@@ -889,6 +1253,22 @@ Backend Engine::getBackend() const noexcept {
     return upcast(this)->getBackend();
 }
 
+bool Engine::isAsyncShaderCompilationSupported() noexcept {
+    return upcast(this)->isAsyncShaderCompilationSupported();
+}
+
+void Engine::setAsyncShaderCompilationEnabled(bool enabled) noexcept {
+    upcast(this)->setAsyncShaderCompilationEnabled(enabled);
+}
+
+bool Engine::isAsyncShaderCompilationEnabled() const noexcept {
+    return upcast(this)->isAsyncShaderCompilationEnabled();
+}
+
+bool Engine::loadShaderDictionary(const void* data, size_t size) noexcept {
+    return upcast(this)->loadShaderDictionary(data, size);
+}
+
 Renderer* Engine::createRenderer() noexcept {
     return upcast(this)->createRenderer();
 }
@@ -965,6 +1345,14 @@ bool Engine::destroy(const ColorGrading* p) {
     return upcast(this)->destroy(upcast(p));
 }
 
+bool Engine::destroy(const ReflectionProbe* p) {
+    return upcast(this)->destroy(upcast(p));
+}
+
+bool Engine::destroy(const Impostor* p) {
+    return upcast(this)->destroy(upcast(p));
+}
+
 bool Engine::destroy(const Stream* p) {
     return upcast(this)->destroy(upcast(p));
 }
@@ -1025,6 +1413,58 @@ DebugRegistry& Engine::getDebugRegistry() noexcept {
     return upcast(this)->getDebugRegistry();
 }
 
+size_t Engine::getCommandBufferHighWatermark() const noexcept {
+    return upcast(this)->getCommandBufferHighWatermark();
+}
+
+size_t Engine::getCommandBufferSize() const noexcept {
+    return upcast(this)->getCommandBufferSize();
+}
+
+size_t Engine::getPerRenderPassArenaHighWatermark() const noexcept {
+    return upcast(this)->getPerRenderPassArenaHighWatermark();
+}
+
+size_t Engine::getScratchArenaHighWatermark() const noexcept {
+    return upcast(this)->getScratchArenaHighWatermark();
+}
+
+Engine::MemoryStats Engine::getMemoryStats() const noexcept {
+    return upcast(this)->getMemoryStats();
+}
+
+Engine::ScratchScope::ScratchScope(Engine& engine) noexcept
+        : mEngine(engine), mRewind(upcast(engine).getScratchArena().getCurrent()) {
+}
+
+Engine::ScratchScope::~ScratchScope() noexcept {
+    void* block = mHeapBlocks;
+    while (block) {
+        void* const next = *static_cast<void**>(block);
+        utils::aligned_free(block);
+        block = next;
+    }
+    upcast(mEngine).getScratchArena().rewind(mRewind);
+}
+
+void* Engine::ScratchScope::allocate(size_t size, size_t alignment) noexcept {
+    alignment = std::max(alignment, alignof(void*));
+    void* p = upcast(mEngine).getScratchArena().alloc(size, alignment);
+    if (UTILS_UNLIKELY(!p)) {
+        // The arena is full, use the heap. The block starts with the link to the previous heap
+        // block, padded so that the returned memory keeps the requested alignment.
+        const size_t header = std::max(alignment, sizeof(void*));
+        void* const block = utils::aligned_alloc(header + size, alignment);
+        if (UTILS_UNLIKELY(!block)) {
+            return nullptr;
+        }
+        *static_cast<void**>(block) = mHeapBlocks;
+        mHeapBlocks = block;
+        p = static_cast<char*>(block) + header;
+    }
+    return p;
+}
+
 Camera* Engine::createCamera() noexcept {
     return createCamera(upcast(this)->getEntityManager().create());
 }
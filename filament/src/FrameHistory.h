@@ -31,6 +31,17 @@ struct FrameHistoryEntry {
     math::float2 jitter{};
     uint32_t frameId = 0;
 
+    // the color the screen-space reflections of the next frame are traced into, at half
+    // resolution, and the world-space to clip-space matrix it was rendered with
+    FrameGraphTexture ssr;
+    FrameGraphTexture::Descriptor ssrDesc;
+    math::mat4f ssrProjection;
+
+    // the adapted log2 luminance (r) and exposure compensation (g) of the automatic exposure,
+    // and the engine time it was computed at, in seconds
+    FrameGraphTexture exposure;
+    FrameGraphTexture::Descriptor exposureDesc;
+    double exposureTime = 0.0;
 };
 
 /*
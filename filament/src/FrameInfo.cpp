@@ -21,8 +21,12 @@
 
 #include <math/scalar.h>
 
+#include <algorithm>
 #include <cmath>
 
+#include <string.h>
+#include <time.h>
+
 namespace filament {
 using namespace utils;
 
@@ -35,6 +39,24 @@ void move_backward(InputIterator first, InputIterator last, OutputIterator resul
     }
 }
 
+// CPU time of the calling thread
+static uint64_t getThreadTime() noexcept {
+#if defined(WIN32) || defined(__EMSCRIPTEN__)
+    // no per-thread clock here, this includes the time the thread was waiting
+    using namespace std::chrono;
+    return uint64_t(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+#else
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+#endif
+}
+
+// whether the GPU time of a pass doesn't depend on the resolution of the view
+static bool isResolutionIndependent(const char* name) noexcept {
+    return !strncmp(name, "Shadow", 6) || !strncmp(name, "VSM", 3);
+}
+
 FrameInfoManager::FrameInfoManager(FEngine& engine) : mEngine(engine) {
     backend::DriverApi& driver = mEngine.getDriverApi();
     for (auto& query : mQueries) {
@@ -51,22 +73,48 @@ void FrameInfoManager::terminate() {
     }
 }
 
-void FrameInfoManager::beginFrame(Config const& config, uint32_t frameId) {
+void FrameInfoManager::beginFrame(Config const& config, uint32_t frameId, bool timerQuery) {
     backend::DriverApi& driver = mEngine.getDriverApi();
-    driver.beginTimerQuery(mQueries[mIndex]);
+    if (timerQuery) {
+        driver.beginTimerQuery(mQueries[mIndex]);
+        mQueryFrameIds[mIndex] = frameId;
+        mQueryActive = true;
+    }
     uint64_t elapsed = 0;
     if (driver.getTimerQueryValue(mQueries[mLast], &elapsed)) {
-        mLast = (mLast + 1) % POOL_COUNT;
         // conversion to our duration happens here
         mFrameTime = std::chrono::duration<uint64_t, std::nano>(elapsed);
+        mMeasuredFrameId = mQueryFrameIds[mLast];
+        mFixedGpuTime = {};
+        mDriverThreadTime = {};
+        mMeasured = true;
+        mLast = (mLast + 1) % POOL_COUNT;
     }
-    update(config,mFrameTime);
+    mMainThreadBegin = getThreadTime();
+    update(config, mFrameTime);
+    mFrameTimeHistory[0].frameId = frameId;
+    mMeasured = false;
+}
+
+void FrameInfoManager::setFrameTimings(uint32_t frameId, duration gpuTime, duration fixedGpuTime,
+        duration driverThreadTime) noexcept {
+    mFrameTime = gpuTime;
+    mMeasuredFrameId = frameId;
+    mFixedGpuTime = fixedGpuTime;
+    mDriverThreadTime = driverThreadTime;
+    mMeasured = true;
 }
 
 void FrameInfoManager::endFrame() {
+    mFrameTimeHistory[0].mainThreadTime =
+            std::chrono::duration<uint64_t, std::nano>(getThreadTime() - mMainThreadBegin);
+    if (!mQueryActive) {
+        return;
+    }
     backend::DriverApi& driver = mEngine.getDriverApi();
     driver.endTimerQuery(mQueries[mIndex]);
     mIndex = (mIndex + 1) % POOL_COUNT;
+    mQueryActive = false;
 }
 
 void FrameInfoManager::update(Config const& config, FrameInfoManager::duration lastFrameTime) {
@@ -76,6 +124,8 @@ void FrameInfoManager::update(Config const& config, FrameInfoManager::duration l
     // this is like doing { pop_back(); push_front(); }
     filament::move_backward(history.begin(), history.end() - 1, history.end());
     history[0].frameTime = lastFrameTime;
+    history[0].mainThreadTime = {};
+    history[0].renderScale = 1.0f;
 
     mFrameTimeHistorySize = std::min(++mFrameTimeHistorySize, uint32_t(MAX_FRAMETIME_HISTORY));
     if (UTILS_UNLIKELY(mFrameTimeHistorySize < 3)) {
@@ -96,6 +146,17 @@ void FrameInfoManager::update(Config const& config, FrameInfoManager::duration l
 
     history[0].denoisedFrameTime = denoisedFrameTime;
 
+    if (config.controller == Renderer::ResolutionController::PREDICTIVE) {
+        updatePrediction(config);
+    } else {
+        updatePid(config);
+    }
+}
+
+void FrameInfoManager::updatePid(Config const& config) {
+    auto& history = mFrameTimeHistory;
+    const duration denoisedFrameTime = history[0].denoisedFrameTime;
+
     // how much we need to scale the current workload to fit in our target, at this instant
     const duration targetWithHeadroom = config.targetFrameTime * (1.0f - config.headRoomRatio);
     const duration measured = denoisedFrameTime;
@@ -125,5 +186,220 @@ void FrameInfoManager::update(Config const& config, FrameInfoManager::duration l
 //    slog.d << history[0].pid.error * 100 << "%, " << scale << io::endl;
 }
 
+void FrameInfoManager::updatePrediction(Config const& config) {
+    auto& history = mFrameTimeHistory;
+    FrameInfo& info = history[0];
+
+    // until a new measurement arrives, the decisions of the previous frame stand
+    info.scale = history[1].scale;
+    info.prediction = history[1].prediction;
+    info.valid = history[1].valid;
+    if (!mMeasured) {
+        return;
+    }
+
+    // find the frame the GPU time was measured for, to know the scale it was rendered at
+    auto const last = history.begin() + mFrameTimeHistorySize;
+    auto const pos = std::find_if(history.begin() + 1, last,
+            [id = mMeasuredFrameId](FrameInfo const& frame) { return frame.frameId == id; });
+    if (pos == last) {
+        return;
+    }
+
+    // The GPU time of the passes depending on the resolution, brought back to scale 1. It
+    // doesn't depend on the scale the frame was rendered at, so unlike the frame time it isn't
+    // affected by the couple of frames it takes to measure it.
+    const duration gpuTime = mFrameTime;
+    const duration fixedTime = std::min(mFixedGpuTime, gpuTime);
+    const duration workload = (gpuTime - fixedTime) / std::max(pos->renderScale, 1.0f / 64.0f);
+
+    // median filter, like the frame time
+    info.prediction.workload = workload;
+    info.prediction.fixedTime = fixedTime;
+    std::array<duration, MAX_FRAMETIME_HISTORY> median; // NOLINT -- it's initialized below
+    size_t size = std::min(mFrameTimeHistorySize, std::min(config.historySize, (uint32_t)median.size()));
+    for (size_t i = 0; i < size; ++i) {
+        median[i] = history[i].prediction.workload;
+    }
+    std::sort(median.begin(), median.begin() + size);
+    const duration denoisedWorkload = median[size / 2];
+
+    // the scale at which the frames would take the target time
+    const duration targetWithHeadroom = config.targetFrameTime * (1.0f - config.headRoomRatio);
+    const duration available = std::max(targetWithHeadroom - fixedTime, targetWithHeadroom / 8.0f);
+    float targetScale = denoisedWorkload.count() > 0.0f ?
+            available / denoisedWorkload : history[1].scale;
+
+    // Frames take as long as the slowest of the CPU and GPU. When the CPU is the bottleneck, a
+    // lower resolution wouldn't make the frames shorter, so the scale can only go up.
+    const duration cpuTime = std::max(pos->mainThreadTime, mDriverThreadTime);
+    const bool gpuBound = gpuTime >= cpuTime;
+    const float previousScale = history[1].valid ? history[1].scale : 1.0f;
+    if (!gpuBound) {
+        targetScale = std::max(targetScale, previousScale);
+    }
+
+    // converge towards the target, this only filters the noise left by the median
+    const float Kp = (1.0f - std::exp(-config.oneOverTau));
+    float scale = previousScale * std::pow(targetScale / previousScale, Kp);
+    scale = math::clamp(scale, 1.0f / 64.0f, 4.0f);
+
+    info.prediction.targetScale = targetScale;
+    info.prediction.gpuBound = gpuBound;
+    info.scale = scale;
+    info.valid = true;
+
+    SYSTRACE_CONTEXT();
+    SYSTRACE_VALUE32("info_gpu_bound", gpuBound);
+    SYSTRACE_VALUE32("info_s", scale * 100);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+PassTimer::PassTimer(FEngine& engine) noexcept : mEngine(engine) {
+}
+
+PassTimer::~PassTimer() noexcept = default;
+
+void PassTimer::terminate() {
+    backend::DriverApi& driver = mEngine.getDriverApi();
+    for (Frame& frame : mFrames) {
+        for (Pass const& pass : frame.passes) {
+            driver.destroyTimerQuery(pass.query);
+        }
+        frame.passes.clear();
+        frame.pending = false;
+    }
+    for (auto query : mFreeQueries) {
+        driver.destroyTimerQuery(query);
+    }
+    mFreeQueries.clear();
+    mCurrent = nullptr;
+}
+
+backend::Handle<backend::HwTimerQuery> PassTimer::acquireQuery() {
+    if (mFreeQueries.empty()) {
+        return mEngine.getDriverApi().createTimerQuery();
+    }
+    auto query = mFreeQueries.back();
+    mFreeQueries.pop_back();
+    return query;
+}
+
+bool PassTimer::report(Frame& frame) {
+    // The driver thread is done with the frame, so all its queries have begun and can be
+    // polled without seeing the result of their previous use.
+    if (!frame.driverTime->done.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    backend::DriverApi& driver = mEngine.getDriverApi();
+    mReport.resize(frame.passes.size());
+    uint64_t gpuTime = 0;
+    uint64_t fixedGpuTime = 0;
+    for (size_t i = 0, c = frame.passes.size(); i < c; i++) {
+        uint64_t elapsed = 0;
+        if (!driver.getTimerQueryValue(frame.passes[i].query, &elapsed)) {
+            return false;
+        }
+        mReport[i] = { frame.passes[i].name, elapsed };
+        gpuTime += elapsed;
+        if (isResolutionIndependent(frame.passes[i].name)) {
+            fixedGpuTime += elapsed;
+        }
+    }
+
+    if (mCallback) {
+        Renderer::FrameTimings const timings{
+                .frameId = frame.frameId,
+                .mainThreadTimeNs = frame.mainThreadTime,
+                .driverThreadTimeNs = frame.driverTime->elapsed.load(std::memory_order_relaxed),
+                .gpuTimeNs = gpuTime,
+                .passes = mReport.data(),
+                .passCount = mReport.size()
+        };
+        mCallback(timings, mUser);
+    }
+    mLastTimings = {
+            .frameId = frame.frameId,
+            .gpuTime = std::chrono::duration<uint64_t, std::nano>(gpuTime),
+            .fixedGpuTime = std::chrono::duration<uint64_t, std::nano>(fixedGpuTime),
+            .driverThreadTime = std::chrono::duration<uint64_t, std::nano>(
+                    frame.driverTime->elapsed.load(std::memory_order_relaxed))
+    };
+
+    for (Pass const& pass : frame.passes) {
+        mFreeQueries.push_back(pass.query);
+    }
+    frame.passes.clear();
+    frame.driverTime.reset();
+    frame.pending = false;
+    return true;
+}
+
+bool PassTimer::beginFrame(uint32_t frameId) {
+    // report the available frames, in order
+    bool reported = false;
+    while (true) {
+        auto pos = std::min_element(mFrames.begin(), mFrames.end(),
+                [](Frame const& lhs, Frame const& rhs) {
+                    return lhs.pending && (!rhs.pending || lhs.frameId < rhs.frameId);
+                });
+        if (!pos->pending || !report(*pos)) {
+            break;
+        }
+        reported = true;
+    }
+
+    if (!isEnabled()) {
+        return reported;
+    }
+
+    auto pos = std::find_if(mFrames.begin(), mFrames.end(),
+            [](Frame const& frame) { return !frame.pending; });
+    if (pos == mFrames.end()) {
+        // the GPU is too far behind, this frame won't be reported
+        return reported;
+    }
+
+    Frame& frame = *pos;
+    frame.frameId = frameId;
+    frame.mainThreadBegin = getThreadTime();
+    frame.driverTime = std::make_shared<DriverTime>();
+    mEngine.getDriverApi().queueCommand([driverTime = frame.driverTime]() {
+        driverTime->begin.store(getThreadTime(), std::memory_order_relaxed);
+    });
+    mCurrent = &frame;
+    return reported;
+}
+
+void PassTimer::endFrame() {
+    Frame* const frame = mCurrent;
+    if (!frame) {
+        return;
+    }
+    mEngine.getDriverApi().queueCommand([driverTime = frame->driverTime]() {
+        const uint64_t end = getThreadTime();
+        driverTime->elapsed.store(end - driverTime->begin.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        driverTime->done.store(true, std::memory_order_release);
+    });
+    frame->mainThreadTime = getThreadTime() - frame->mainThreadBegin;
+    frame->pending = true;
+    mCurrent = nullptr;
+}
+
+void PassTimer::beginPass(const char* name) {
+    assert(mCurrent);
+    auto query = acquireQuery();
+    mCurrent->passes.push_back({ name, query });
+    mEngine.getDriverApi().beginTimerQuery(query);
+}
+
+void PassTimer::endPass() {
+    assert(mCurrent && !mCurrent->passes.empty());
+    mEngine.getDriverApi().endTimerQuery(mCurrent->passes.back().query);
+}
+
 
 } // namespace filament
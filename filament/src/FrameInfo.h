@@ -21,8 +21,13 @@
 
 #include "backend/Handle.h"
 
+#include <filament/Renderer.h>
+
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -32,14 +37,24 @@ class FEngine;
 
 struct FrameInfo {
     using duration = std::chrono::duration<float>;
+    uint32_t frameId = 0;
     duration frameTime{};            // frame period
     duration denoisedFrameTime{};    // frame period (median filter)
+    duration mainThreadTime{};       // CPU time of the main thread, beginFrame() to endFrame()
+    float renderScale = 1.0f;        // scale the views were rendered at (ratio of areas)
     bool valid = false;
     float scale = 1.0f;
     struct {
         float integral{};
         float error{};
     } pid;
+    // decisions of the predictive controller
+    struct {
+        duration workload{};         // GPU time of the frame at scale 1, without the fixed costs
+        duration fixedTime{};        // GPU time of the passes independent of the resolution
+        float targetScale = 1.0f;    // scale at which the frame fits in the target time
+        bool gpuBound = false;       // whether lowering the resolution would shorten the frames
+    } prediction;
 };
 
 class FrameInfoManager {
@@ -54,14 +69,26 @@ public:
         float headRoomRatio;
         float oneOverTau;
         uint32_t historySize;
+        Renderer::ResolutionController controller;
     };
 
     explicit FrameInfoManager(FEngine& engine);
     ~FrameInfoManager() noexcept;
     void terminate();
-    void beginFrame(Config const& config, uint32_t frameId);  // call this immediately after "make current"
+    // Call this immediately after "make current". Timer queries can't be nested, so when the
+    // passes are timed individually (see PassTimer), the frame isn't timed with a query and its
+    // GPU time is given with setFrameTimings() instead.
+    void beginFrame(Config const& config, uint32_t frameId, bool timerQuery = true);
     void endFrame(); // call this immediately before "swap buffers"
 
+    // GPU time of the frame frameId measured by PassTimer, along with the GPU time of its passes
+    // that don't depend on the resolution and the CPU time of the driver thread.
+    void setFrameTimings(uint32_t frameId, duration gpuTime, duration fixedGpuTime,
+            duration driverThreadTime) noexcept;
+
+    // Records the scale at which the views using dynamic resolution rendered this frame.
+    void setRenderScale(float scale) noexcept { mFrameTimeHistory[0].renderScale = scale; }
+
     FrameInfo const& getLastFrameInfo() const {
         return mFrameTimeHistory[0];
     }
@@ -73,16 +100,106 @@ public:
 
 private:
     void update(Config const& config, duration lastFrameTime);
+    void updatePid(Config const& config);
+    void updatePrediction(Config const& config);
     FEngine& mEngine;
     backend::Handle<backend::HwTimerQuery> mQueries[POOL_COUNT];
+    uint32_t mQueryFrameIds[POOL_COUNT] = {};
     duration mFrameTime{};
     uint32_t mIndex = 0;
     uint32_t mLast = 0;
+    bool mQueryActive = false;
+
+    // the last GPU time measured, and the frame it was measured for
+    uint32_t mMeasuredFrameId = 0;
+    duration mFixedGpuTime{};
+    duration mDriverThreadTime{};
+    bool mMeasured = false;
+    uint64_t mMainThreadBegin = 0;
 
     std::array<FrameInfo, MAX_FRAMETIME_HISTORY> mFrameTimeHistory;
     uint32_t mFrameTimeHistorySize = 0;
 };
 
+/*
+ * PassTimer times each FrameGraph pass of a frame with a timer query, along with the CPU time
+ * the main and driver threads spent on the frame. The timings are handed to a
+ * Renderer::FrameTimingsCallback by a later beginFrame(), once they are all available.
+ */
+class PassTimer {
+    // frames whose timings aren't available yet, frames beyond this aren't timed
+    static constexpr size_t MAX_FRAMES_IN_FLIGHT = 4;
+
+public:
+    using duration = FrameInfo::duration;
+
+    explicit PassTimer(FEngine& engine) noexcept;
+    ~PassTimer() noexcept;
+    void terminate();
+
+    void setCallback(Renderer::FrameTimingsCallback callback, void* user) noexcept {
+        mCallback = callback;
+        mUser = user;
+    }
+
+    bool isEnabled() const noexcept { return mCallback != nullptr; }
+
+    // whether the passes of the current frame are being timed
+    bool isTiming() const noexcept { return mCurrent != nullptr; }
+
+    // Reports the frames whose timings became available, and starts timing this one if
+    // enabled. Returns true if a report was made, its timings are then getLastTimings().
+    bool beginFrame(uint32_t frameId);
+    void endFrame();
+
+    // FrameGraph passes are timed between these, they can't be nested
+    void beginPass(const char* name);
+    void endPass();
+
+    // timings of the last frame reported
+    struct Timings {
+        uint32_t frameId = 0;
+        duration gpuTime{};
+        duration fixedGpuTime{};     // the passes whose cost doesn't depend on the resolution
+        duration driverThreadTime{};
+    };
+    Timings const& getLastTimings() const noexcept { return mLastTimings; }
+
+private:
+    // written by the driver thread
+    struct DriverTime {
+        std::atomic<uint64_t> begin = { 0 };
+        std::atomic<uint64_t> elapsed = { 0 };
+        std::atomic<bool> done = { false };
+    };
+
+    struct Pass {
+        const char* name;
+        backend::Handle<backend::HwTimerQuery> query;
+    };
+
+    struct Frame {
+        uint32_t frameId = 0;
+        uint64_t mainThreadBegin = 0;
+        uint64_t mainThreadTime = 0;
+        std::shared_ptr<DriverTime> driverTime;
+        std::vector<Pass> passes;
+        bool pending = false;
+    };
+
+    bool report(Frame& frame);
+    backend::Handle<backend::HwTimerQuery> acquireQuery();
+
+    FEngine& mEngine;
+    Renderer::FrameTimingsCallback mCallback = nullptr;
+    void* mUser = nullptr;
+    std::array<Frame, MAX_FRAMES_IN_FLIGHT> mFrames;
+    Frame* mCurrent = nullptr;
+    std::vector<backend::Handle<backend::HwTimerQuery>> mFreeQueries;
+    std::vector<Renderer::FrameTimings::Pass> mReport;
+    Timings mLastTimings;
+};
+
 
 } // namespace filament
 
@@ -24,8 +24,8 @@ using namespace utils;
 using namespace backend;
 
 FrameSkipper::FrameSkipper(FEngine& engine, size_t latency) noexcept
-        : mEngine(engine), mLast(latency) {
-    assert(latency <= MAX_FRAME_LATENCY);
+        : mEngine(engine), mMinLatency(latency), mLatency(latency) {
+    assert(latency >= 1 && latency < MAX_FRAME_LATENCY);
 }
 
 FrameSkipper::~FrameSkipper() noexcept {
@@ -37,19 +37,47 @@ FrameSkipper::~FrameSkipper() noexcept {
     }
 }
 
+void FrameSkipper::setAdaptive(bool adaptive) noexcept {
+    mAdaptive = adaptive;
+    if (!adaptive) {
+        mLatency = mMinLatency;
+    }
+    mAheadFrameCount = 0;
+}
+
+bool FrameSkipper::isSignaled(size_t latency) const noexcept {
+    auto sync = mDelayedSyncs[LAST - latency];
+    return !sync || mEngine.getDriverApi().getSyncStatus(sync) != SyncStatus::NOT_SIGNALED;
+}
+
 bool FrameSkipper::beginFrame() noexcept {
     auto& driver = mEngine.getDriverApi();
     auto& syncs = mDelayedSyncs;
-    auto sync = syncs.front();
-    if (sync) {
-        auto status = driver.getSyncStatus(sync);
-        if (status == SyncStatus::NOT_SIGNALED) {
+
+    while (!isSignaled(mLatency)) {
+        if (!mAdaptive || mLatency == LAST) {
             // Sync not ready, skip frame
             return false;
         }
-        driver.destroySync(sync);
+        // let one more frame in flight rather than skipping this one
+        mLatency++;
+        mAheadFrameCount = 0;
+    }
+
+    // the gpu is ahead if it would have kept up with one frame less in flight
+    if (mAdaptive && mLatency > mMinLatency && isSignaled(mLatency - 1)) {
+        if (++mAheadFrameCount == LATENCY_DECREASE_FRAME_COUNT) {
+            mLatency--;
+            mAheadFrameCount = 0;
+        }
+    } else {
+        mAheadFrameCount = 0;
+    }
+
+    // shift all fences down by 1, the oldest one is signaled since a more recent one is
+    if (syncs.front()) {
+        driver.destroySync(syncs.front());
     }
-    // shift all fences down by 1
     std::move(syncs.begin() + 1, syncs.end(), syncs.begin());
     syncs.back() = {};
     return true;
@@ -60,7 +88,7 @@ void FrameSkipper::endFrame() noexcept {
     // (i.e. FrameSkipper::beginFrame() returned false), we need to make sure to replace
     // a fence that might be here already)
     auto& driver = mEngine.getDriverApi();
-    auto& sync = mDelayedSyncs[mLast];
+    auto& sync = mDelayedSyncs[LAST];
     if (sync) {
         driver.destroySync(sync);
     }
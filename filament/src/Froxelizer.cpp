@@ -23,6 +23,7 @@
 
 #include <filament/Viewport.h>
 
+#include <utils/algorithm.h>
 #include <utils/BinaryTreeArray.h>
 #include <utils/Systrace.h>
 
@@ -30,7 +31,10 @@
 #include <math/fast.h>
 #include <math/scalar.h>
 
+#include <private/backend/Program.h>
+
 #include <algorithm>
+#include <string>
 
 #include <stddef.h>
 
@@ -74,10 +78,132 @@ constexpr size_t PER_FROXELDATA_ARENA_SIZE = sizeof(float4) *
 // number of lights processed by one group (e.g. 32)
 static constexpr size_t LIGHT_PER_GROUP = sizeof(Froxelizer::LightGroupType) * 8;
 
-// number of groups (i.e. jobs) to use for froxelization (e.g. 8)
+// number of groups packed in one light record word (e.g. 2)
+static constexpr size_t GROUP_PER_RECORD_WORD = sizeof(uint64_t) / sizeof(Froxelizer::LightGroupType);
+
+// maximum number of groups (i.e. jobs) to use for froxelization (e.g. 8), the actual count
+// depends on the number of visible lights
 static constexpr size_t GROUP_COUNT =
         (CONFIG_MAX_LIGHT_COUNT + LIGHT_PER_GROUP - 1) / LIGHT_PER_GROUP;
 
+// lights are froxelized incrementally when at most 1 / INCREMENTAL_FROXELIZATION_RATIO of them
+// changed, otherwise all the froxels are rebuilt.
+static constexpr size_t INCREMENTAL_FROXELIZATION_RATIO = 4;
+
+static_assert(GROUP_COUNT % GROUP_PER_RECORD_WORD == 0,
+        "CONFIG_MAX_LIGHT_COUNT must be a multiple of 64");
+
+// maximum number of chunks of slices (i.e. jobs) the froxels are compressed in
+static constexpr size_t COMPRESSION_CHUNK_COUNT = 8;
+
+
+// GPU light binning
+// -----------------
+// Each froxel is handled by one invocation of the binning compute shader, which tests all the
+// lights against the froxel's planes like the CPU does, but treats spot lights as spheres. There
+// is no compaction, each froxel owns a fixed range of the record buffer.
+
+// number of froxels handled by one work group, i.e. one row of the froxel buffer
+static constexpr size_t BINNING_WORK_GROUP_SIZE = FROXEL_BUFFER_WIDTH;
+
+// maximum number of x and y planes, there are at least CONFIG_FROXEL_SLICE_COUNT slices, so
+// countX * countY <= 512, which bounds countX + countY + 2
+static constexpr size_t BINNING_PLANE_COUNT =
+        FROXEL_BUFFER_ENTRY_COUNT_MAX / FEngine::CONFIG_FROXEL_SLICE_COUNT + 3;
+
+// the z distances are packed in float4
+static constexpr size_t BINNING_DISTANCE_COUNT = (FEngine::CONFIG_FROXEL_SLICE_COUNT + 1 + 3) / 4;
+
+// the existing per-view bindings must stay untouched, but these two are bound again by
+// every pass before drawing
+static constexpr uint8_t BINNING_PARAMS_BINDING = BindingPoints::PER_RENDERABLE;
+static constexpr uint8_t BINNING_LIGHTS_BINDING = BindingPoints::PER_MATERIAL_INSTANCE;
+
+// must match FroxelBinningParams in the binning shader (std140)
+struct BinningParams {
+    uint4 froxelCount;      // x, y, z, total
+    uint4 lights;           // light count, records per froxel
+    float4 distancesZ[BINNING_DISTANCE_COUNT];
+    float4 planes[BINNING_PLANE_COUNT];     // x planes followed by y planes
+};
+
+static_assert(sizeof(BinningParams) <= 16384, "BinningParams must fit in a 16 KiB UBO");
+
+static std::string getBinningShaderSource() noexcept {
+    const char* recordFormat = std::is_same<Froxelizer::RecordBufferType, uint8_t>::value
+            ? "r8ui" : "r16ui";
+    return std::string("#version 430 core\n") +
+            "#define WORK_GROUP_SIZE " + std::to_string(BINNING_WORK_GROUP_SIZE) + "\n" +
+            "#define PLANE_COUNT " + std::to_string(BINNING_PLANE_COUNT) + "\n" +
+            "#define DISTANCE_COUNT " + std::to_string(BINNING_DISTANCE_COUNT) + "\n" +
+            "#define LIGHT_COUNT " + std::to_string(CONFIG_MAX_LIGHT_COUNT) + "\n" +
+            "#define FROXEL_SHIFT " + std::to_string(FROXEL_BUFFER_WIDTH_SHIFT) + "u\n" +
+            "#define RECORD_SHIFT " + std::to_string(RECORD_BUFFER_WIDTH_SHIFT) + "u\n" +
+            "layout(binding = 1, " + recordFormat +
+            ") uniform writeonly highp uimage2D records;\n" +
+            R"GLSL(
+layout(local_size_x = WORK_GROUP_SIZE) in;
+
+layout(std140) uniform FroxelBinningParams {
+    uvec4 froxelCount;
+    uvec4 lights;
+    vec4 distancesZ[DISTANCE_COUNT];
+    vec4 planes[PLANE_COUNT];
+} params;
+
+layout(std140) uniform FroxelBinningLights {
+    vec4 lights[LIGHT_COUNT];
+} lights;
+
+layout(binding = 0, rg16ui) uniform writeonly highp uimage2D froxels;
+
+ivec2 texel(uint index, uint shift) {
+    return ivec2(uvec2(index & ((1u << shift) - 1u), index >> shift));
+}
+
+float distanceZ(uint i) {
+    return params.distancesZ[i >> 2u][i & 3u];
+}
+
+void main() {
+    uint froxel = gl_GlobalInvocationID.x;
+    if (froxel >= params.froxelCount.w) {
+        imageStore(froxels, texel(froxel, FROXEL_SHIFT), uvec4(0u));
+        return;
+    }
+
+    uint ix = froxel % params.froxelCount.x;
+    uint iy = (froxel / params.froxelCount.x) % params.froxelCount.y;
+    uint iz = froxel / (params.froxelCount.x * params.froxelCount.y);
+
+    // the froxel's planes, a point is inside when dot(plane.xyz, p) + plane.w <= 0
+    uint y = params.froxelCount.x + 1u;
+    vec4 planes[6];
+    planes[0] =  params.planes[ix];
+    planes[1] = -params.planes[ix + 1u];
+    planes[2] =  params.planes[y + iy];
+    planes[3] = -params.planes[y + iy + 1u];
+    planes[4] =  vec4(0.0, 0.0, 1.0, distanceZ(iz));
+    planes[5] = -vec4(0.0, 0.0, 1.0, distanceZ(iz + 1u));
+
+    uint offset = froxel * params.lights.y;
+    uint count = 0u;
+    for (uint i = 0u; i < params.lights.x && count < params.lights.y; i++) {
+        vec4 sphere = lights.lights[i];
+        bool inside = true;
+        for (int j = 0; j < 6; j++) {
+            inside = inside && dot(planes[j].xyz, sphere.xyz) + planes[j].w <= sphere.w;
+        }
+        if (inside) {
+            imageStore(records, texel(offset + count, RECORD_SHIFT), uvec4(i));
+            count++;
+        }
+    }
+
+    imageStore(froxels, texel(froxel, FROXEL_SHIFT), uvec4(offset, count, 0u, 0u));
+}
+)GLSL";
+}
 
 // record buffer cannot be larger than 65K entries because we're using uint16_t to store indices
 // so its maximum size is 128 KiB
@@ -85,7 +211,7 @@ static_assert(RECORD_BUFFER_ENTRY_COUNT <= 65536,
         "RecordBuffer cannot be larger than 65536 entries");
 
 Froxelizer::Froxelizer(FEngine& engine)
-        : mArena("froxel", PER_FROXELDATA_ARENA_SIZE) {
+        : mArena("froxel", PER_FROXELDATA_ARENA_SIZE, engine.getArenaOptions()) {
 
     DriverApi& driverApi = engine.getDriverApi();
 
@@ -95,6 +221,8 @@ Froxelizer::Froxelizer(FEngine& engine)
     mRecordsBuffer = GPUBuffer(driverApi, { type, 1 }, RECORD_BUFFER_WIDTH, RECORD_BUFFER_HEIGHT);
     mFroxelBuffer  = GPUBuffer(driverApi, { GPUBuffer::ElementType::UINT16, 2 },
             FROXEL_BUFFER_WIDTH, FROXEL_BUFFER_HEIGHT);
+
+    mGpuBinningSupported = driverApi.isComputeSupported();
 }
 
 Froxelizer::~Froxelizer() {
@@ -112,6 +240,12 @@ void Froxelizer::terminate(DriverApi& driverApi) noexcept {
 
     mRecordsBuffer.terminate(driverApi);
     mFroxelBuffer.terminate(driverApi);
+
+    if (mBinningProgram) {
+        driverApi.destroyProgram(mBinningProgram);
+        driverApi.destroyUniformBuffer(mBinningParamsUbh);
+        driverApi.destroyUniformBuffer(mBinningLightsUbh);
+    }
 }
 
 void Froxelizer::setOptions(float zLightNear, float zLightFar) noexcept {
@@ -140,7 +274,8 @@ void Froxelizer::setProjection(const mat4f& projection, float near, float far) n
 
 bool Froxelizer::prepare(
         FEngine::DriverApi& driverApi, ArenaScope& arena, filament::Viewport const& viewport,
-        const mat4f& projection, float projectionNear, float projectionFar) noexcept {
+        const mat4f& projection, float projectionNear, float projectionFar,
+        size_t lightCount) noexcept {
     setViewport(viewport);
     setProjection(projection, projectionNear, projectionFar);
 
@@ -149,15 +284,33 @@ bool Froxelizer::prepare(
         uniformsNeedUpdating = update();
     }
 
+    // Froxelization only processes as many groups of lights as needed, so its cost follows the
+    // number of visible lights rather than CONFIG_MAX_LIGHT_COUNT. We keep an even number of
+    // groups, so that they pack exactly in light record words.
+    assert(lightCount <= CONFIG_MAX_LIGHT_COUNT);
+    const size_t groupCount = (lightCount + LIGHT_PER_GROUP - 1) / LIGHT_PER_GROUP;
+    mGroupCount = std::max(size_t(1), (groupCount + GROUP_PER_RECORD_WORD - 1) &
+            ~(GROUP_PER_RECORD_WORD - 1));
+    mLightRecordWordCount = mGroupCount / GROUP_PER_RECORD_WORD;
+    assert(mGroupCount <= GROUP_COUNT);
+
+    if (mGpuBinning) {
+        // the froxels are computed by commitGpuBinning(), we only need the lights (~4 KiB)
+        mGpuLights = { driverApi.allocatePod<float4>(lightCount), uint32_t(lightCount) };
+        return uniformsNeedUpdating;
+    }
+
     /*
      * Allocations that need to persists until the driver consumes them are done from
      * the command stream.
      */
 
-    // froxel buffer (~32 KiB)
+    // froxel buffer (~32 KiB), only the rows covering the viewport's froxels are used
+    const size_t froxelBufferEntryCount =
+            (mFroxelCount + FROXEL_BUFFER_WIDTH_MASK) & ~FROXEL_BUFFER_WIDTH_MASK;
     mFroxelBufferUser = {
-            driverApi.allocatePod<FroxelEntry>(FROXEL_BUFFER_ENTRY_COUNT_MAX),
-            FROXEL_BUFFER_ENTRY_COUNT_MAX };
+            driverApi.allocatePod<FroxelEntry>(froxelBufferEntryCount),
+            uint32_t(froxelBufferEntryCount) };
 
     // record buffer (~64 KiB)
     mRecordBufferUser = {
@@ -168,24 +321,21 @@ bool Froxelizer::prepare(
      * Temporary allocations for processing all froxel data
      */
 
-    // light records per froxel (~256 KiB)
+    // light records per froxel (~256 KiB), entirely written by froxelizeAssignRecordsCompress()
+    const size_t lightRecordWordCount = mFroxelCount * mLightRecordWordCount;
     mLightRecords = {
-            arena.allocate<LightRecord>(FROXEL_BUFFER_ENTRY_COUNT_MAX, CACHELINE_SIZE),
-            FROXEL_BUFFER_ENTRY_COUNT_MAX };
+            arena.allocate<LightRecordWord>(lightRecordWordCount, CACHELINE_SIZE),
+            uint32_t(lightRecordWordCount) };
 
-    // froxel thread data (~256 KiB)
-    mFroxelShardedData = {
-            arena.allocate<FroxelThreadData>(GROUP_COUNT, CACHELINE_SIZE),
-            uint32_t(GROUP_COUNT)
-    };
+    // froxel thread data (~256 KiB), kept across frames so lights can be froxelized incrementally
+    if (UTILS_UNLIKELY(mFroxelShardedData.size() != mGroupCount)) {
+        mFroxelShardedData.resize(mGroupCount);
+        mFroxelsValid = false;
+    }
 
     assert(mFroxelBufferUser.begin());
     assert(mRecordBufferUser.begin());
     assert(mLightRecords.begin());
-    assert(mFroxelShardedData.begin());
-
-    // initialize buffers that need to be
-    memset(mLightRecords.data(), 0, mLightRecords.sizeInBytes());
 
     return uniformsNeedUpdating;
 }
@@ -241,6 +391,8 @@ void Froxelizer::computeFroxelLayout(
 
 UTILS_NOINLINE
 bool Froxelizer::update() noexcept {
+    // the froxels changed, all lights need to be froxelized again
+    mFroxelsValid = false;
     bool uniformsNeedUpdating = false;
     if (UTILS_UNLIKELY(mDirtyFlags & VIEWPORT_CHANGED)) {
         filament::Viewport const& viewport = mViewport;
@@ -511,22 +663,130 @@ std::pair<size_t, size_t> Froxelizer::clipToIndices(float2 const& clip) const no
 
 
 void Froxelizer::commit(backend::DriverApi& driverApi) {
-    // send data to GPU
-    mFroxelBuffer.commit(driverApi, mFroxelBufferUser);
-    mRecordsBuffer.commit(driverApi, mRecordBufferUser);
+    if (mGpuBinning) {
+        commitGpuBinning(driverApi);
+        return;
+    }
+
+    if (!mFroxelsChanged) {
+        // the GPU buffers are still valid
+        return;
+    }
+
+    // send data to GPU, only the rows of the froxel buffer that changed since the last upload
+    // and the rows of the record buffer that are used are uploaded
+    commitFroxelBufferChanges(driverApi);
+    const size_t recordCount =
+            (mRecordCount + RECORD_BUFFER_WIDTH - 1) & ~(RECORD_BUFFER_WIDTH - 1);
+    if (recordCount) {
+        mRecordsBuffer.commit(driverApi,
+                mRecordBufferUser.cbegin(), mRecordBufferUser.cbegin() + recordCount);
+    }
 #ifndef NDEBUG
     mFroxelBufferUser.clear();
     mRecordBufferUser.clear();
-    mFroxelShardedData.clear();
 #endif
 }
 
+void Froxelizer::commitFroxelBufferChanges(backend::DriverApi& driverApi) noexcept {
+    FroxelEntry const* const froxels = mFroxelBufferUser.data();
+    const size_t rowCount = mFroxelBufferUser.size() / FROXEL_BUFFER_WIDTH;
+
+    // a copy of the froxel buffer of a different size doesn't match anything
+    size_t firstRow = 0;
+    size_t endRow = rowCount;
+    if (mFroxelBufferUploaded.size() == mFroxelBufferUser.size()) {
+        auto isRowEqual = [froxels, uploaded = mFroxelBufferUploaded.data()](size_t row) {
+            const size_t first = row * FROXEL_BUFFER_WIDTH;
+            return !memcmp(froxels + first, uploaded + first,
+                    FROXEL_BUFFER_WIDTH * sizeof(FroxelEntry));
+        };
+        while (firstRow < endRow && isRowEqual(firstRow)) {
+            firstRow++;
+        }
+        while (endRow > firstRow && isRowEqual(endRow - 1)) {
+            endRow--;
+        }
+    } else {
+        mFroxelBufferUploaded.resize(mFroxelBufferUser.size());
+    }
+
+    if (firstRow < endRow) {
+        FroxelEntry const* const begin = froxels + firstRow * FROXEL_BUFFER_WIDTH;
+        FroxelEntry const* const end = froxels + endRow * FROXEL_BUFFER_WIDTH;
+        mFroxelBuffer.commit(driverApi, begin, end, firstRow);
+        std::copy(begin, end, mFroxelBufferUploaded.begin() + firstRow * FROXEL_BUFFER_WIDTH);
+    }
+}
+
+void Froxelizer::commitGpuBinning(backend::DriverApi& driverApi) noexcept {
+    // the froxel buffer is written by the GPU, the last upload doesn't match it anymore
+    mFroxelBufferUploaded.clear();
+
+    if (UTILS_UNLIKELY(!mBinningProgram)) {
+        const std::string source = getBinningShaderSource();
+        Program program;
+        program.diagnostics(CString("FroxelBinning"))
+                .withComputeShader(source.data(), source.size())
+                .setUniformBlock(BINNING_PARAMS_BINDING, CString("FroxelBinningParams"))
+                .setUniformBlock(BINNING_LIGHTS_BINDING, CString("FroxelBinningLights"));
+        mBinningProgram = driverApi.createProgram(std::move(program));
+        mBinningParamsUbh = driverApi.createUniformBuffer(
+                sizeof(BinningParams), BufferUsage::DYNAMIC);
+        mBinningLightsUbh = driverApi.createUniformBuffer(
+                CONFIG_MAX_LIGHT_COUNT * sizeof(float4), BufferUsage::DYNAMIC);
+    }
+
+    // each froxel gets the same number of records, and the count is stored on 8 bits
+    const uint32_t recordsPerFroxel =
+            uint32_t(std::min(RECORD_BUFFER_ENTRY_COUNT / mFroxelCount, size_t(255)));
+
+    BinningParams* const params = driverApi.allocatePod<BinningParams>();
+    params->froxelCount = { mFroxelCountX, mFroxelCountY, mFroxelCountZ, mFroxelCount };
+    params->lights = { uint32_t(mGpuLights.size()), recordsPerFroxel, 0, 0 };
+    std::copy_n(mDistancesZ, mFroxelCountZ + 1, &params->distancesZ[0].x);
+    std::copy_n(mPlanesX, mFroxelCountX + 1, params->planes);
+    std::copy_n(mPlanesY, mFroxelCountY + 1, params->planes + mFroxelCountX + 1);
+    driverApi.loadUniformBuffer(mBinningParamsUbh, { params, sizeof(BinningParams) });
+    if (!mGpuLights.empty()) {
+        driverApi.loadUniformBuffer(mBinningLightsUbh,
+                { mGpuLights.data(), mGpuLights.size() * sizeof(float4) });
+    }
+
+    driverApi.bindUniformBuffer(BINNING_PARAMS_BINDING, mBinningParamsUbh);
+    driverApi.bindUniformBuffer(BINNING_LIGHTS_BINDING, mBinningLightsUbh);
+    mFroxelBuffer.bindImage(driverApi, 0);
+    mRecordsBuffer.bindImage(driverApi, 1);
+    driverApi.dispatchCompute(mBinningProgram,
+            { (mFroxelCount + BINNING_WORK_GROUP_SIZE - 1) / BINNING_WORK_GROUP_SIZE, 1, 1 });
+}
+
 void Froxelizer::froxelizeLights(FEngine& engine,
         CameraInfo const& UTILS_RESTRICT camera,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     // note: this is called asynchronously
-    froxelizeLoop(engine, camera, lightData);
-    froxelizeAssignRecordsCompress();
+    assert(lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT <= mGroupCount * LIGHT_PER_GROUP);
+
+    if (mGpuBinning) {
+        // only gather the lights in view-space, they're binned on the GPU by commit()
+        auto const* UTILS_RESTRICT spheres = lightData.data<FScene::POSITION_RADIUS>();
+        float4* const UTILS_RESTRICT lights = mGpuLights.data();
+        for (size_t i = 0, c = mGpuLights.size(); i < c; i++) {
+            const float4 s = spheres[i + FScene::DIRECTIONAL_LIGHTS_COUNT];
+            lights[i] = { (camera.view * float4{ s.xyz, 1 }).xyz, s.w };
+        }
+        // the CPU froxels are now stale
+        mFroxelsValid = false;
+        return;
+    }
+
+    mFroxelsChanged = froxelizeLoop(engine, camera, lightData);
+    if (!mFroxelsChanged) {
+        // nothing moved since the last froxelization
+        return;
+    }
+
+    froxelizeAssignRecordsCompress(engine.getJobSystem());
 
 #ifndef NDEBUG
     if (lightData.size()) {
@@ -552,43 +812,78 @@ void Froxelizer::froxelizeLights(FEngine& engine,
 #endif
 }
 
-void Froxelizer::froxelizeLoop(FEngine& engine,
+bool Froxelizer::froxelizeLoop(FEngine& engine,
         const CameraInfo& UTILS_RESTRICT camera,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     SYSTRACE_CALL();
 
-    Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
-    memset(froxelThreadData.data(), 0, froxelThreadData.sizeInBytes());
-
     auto& lcm = engine.getLightManager();
     auto const* UTILS_RESTRICT spheres      = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
 
-    auto process = [ this, &froxelThreadData,
-                     spheres, directions, instances, &camera, &lcm ]
-            (size_t count, size_t offset, size_t stride) {
+    // Gather the lights' parameters in view-space and find the ones that changed since the last
+    // froxelization. Lights are in view-space, so this also catches camera movements.
+    const size_t lightCount = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+    const bool rebuild = !mFroxelsValid || mLightParams.size() != lightCount;
+    mLightParams.resize(lightCount);
+    mChangedLights.clear();
+
+    const mat3f& vn = camera.view.upperLeft();
+    for (size_t i = 0; i < lightCount; i++) {
+        const size_t j = i + FScene::DIRECTIONAL_LIGHTS_COUNT;
+        FLightManager::Instance li = instances[j];
+        const LightParams light = {
+                .position = (camera.view * float4{ spheres[j].xyz, 1 }).xyz, // to view-space
+                .cosSqr = lcm.getCosOuterSquared(li),   // spot only
+                .axis = vn * directions[j],             // spot only
+                .invSin = lcm.getSinInverse(li),        // spot only
+                .radius = spheres[j].w,
+        };
+        if (rebuild || memcmp(&light, &mLightParams[i], sizeof(LightParams)) != 0) {
+            mLightParams[i] = light;
+            if (!rebuild) {
+                mChangedLights.push_back(uint32_t(i));
+            }
+        }
+    }
+
+    if (!rebuild && mChangedLights.empty()) {
+        return false;
+    }
+
+    mFroxelsValid = true;
+    FroxelThreadData* const froxelThreadData = mFroxelShardedData.data();
+    const size_t groupCount = mGroupCount;
+    const mat4f& projection = mProjection;
+
+    if (!rebuild && mChangedLights.size() * INCREMENTAL_FROXELIZATION_RATIO <= lightCount) {
+        // only a few lights changed, remove them from all froxels and froxelize them again
+        for (uint32_t i : mChangedLights) {
+            const size_t group = i % groupCount;
+            const size_t bit   = i / groupCount;
+            FroxelThreadData& threadData = froxelThreadData[group];
+            const LightGroupType mask = ~(LightGroupType(1) << bit);
+            for (size_t f = 0, c = getFroxelCount(); f < c; f++) {
+                threadData[f] &= mask;
+            }
+            froxelizePointAndSpotLight(threadData, bit, projection, mLightParams[i]);
+        }
+        return true;
+    }
 
-        const mat4f& projection = mProjection;
-        const mat3f& vn = camera.view.upperLeft();
+    memset(froxelThreadData, 0, mFroxelShardedData.size() * sizeof(FroxelThreadData));
 
+    auto process = [ this, froxelThreadData, groupCount, &projection ]
+            (size_t count, size_t offset, size_t stride) {
+        LightParams const* const UTILS_RESTRICT lights = mLightParams.data();
         for (size_t i = offset; i < count; i += stride) {
-            const size_t j = i + FScene::DIRECTIONAL_LIGHTS_COUNT;
-            FLightManager::Instance li = instances[j];
-            LightParams light = {
-                    .position = (camera.view * float4{ spheres[j].xyz, 1 }).xyz, // to view-space
-                    .cosSqr = lcm.getCosOuterSquared(li),   // spot only
-                    .axis = vn * directions[j],             // spot only
-                    .invSin = lcm.getSinInverse(li),        // spot only
-                    .radius = spheres[j].w,
-            };
-
-            const size_t group = i % GROUP_COUNT;
-            const size_t bit   = i / GROUP_COUNT;
+            const size_t group = i % groupCount;
+            const size_t bit   = i / groupCount;
             assert(bit < LIGHT_PER_GROUP);
 
             FroxelThreadData& threadData = froxelThreadData[group];
-            froxelizePointAndSpotLight(threadData, bit, projection, light);
+            froxelizePointAndSpotLight(threadData, bit, projection, lights[i]);
         }
     };
 
@@ -598,9 +893,9 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
     constexpr bool SINGLE_THREADED = false;
     if (!SINGLE_THREADED) {
         auto *parent = js.createJob();
-        for (size_t i = 0; i < GROUP_COUNT; i++) {
+        for (size_t i = 0; i < groupCount; i++) {
             js.run(jobs::createJob(js, parent, std::cref(process),
-                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, i, GROUP_COUNT));
+                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, i, groupCount));
         }
         js.runAndWait(parent);
     } else {
@@ -608,104 +903,175 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
                 lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, 0, 1)
         );
     }
+    return true;
 }
 
-void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
+void Froxelizer::froxelizeAssignRecordsCompress(JobSystem& js) noexcept {
 
     SYSTRACE_CALL();
 
-    Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
-
-    // convert froxel data from N groups of M bits to LightRecord::bitset, so we can
-    // easily compare adjacent froxels, for compaction. The conversion loops below get
-    // inlined and vectorized in release builds.
-
-    // this gets very well vectorized...
-    utils::Slice<LightRecord> records(mLightRecords);
-    for (size_t j = 0, jc = FROXEL_BUFFER_ENTRY_COUNT_MAX; j < jc; j++) {
-        for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
-            using container_type = LightRecord::bitset::container_type;
-            constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
-            container_type b = froxelThreadData[i * r][j];
-            for (size_t k = 0; k < r; k++) {
-                b |= (container_type(froxelThreadData[i * r + k][j]) << (LIGHT_PER_GROUP * k));
-            }
-            records[j].lights.getBitsAt(i) = b;
-        }
-    }
+    FroxelThreadData const* const froxelThreadData = mFroxelShardedData.data();
+    const size_t groupCount = mGroupCount;
+    const size_t wordCount = mLightRecordWordCount;
+    const size_t froxelCountX = mFroxelCountX;
+    const size_t sliceSize = size_t(mFroxelCountX) * mFroxelCountY;
+    const size_t sliceCount = mFroxelCountZ;
+    const size_t chunkCount = std::min(sliceCount, COMPRESSION_CHUNK_COUNT);
 
-    uint16_t offset = 0;
+    LightRecordWord* const UTILS_RESTRICT records = mLightRecords.data();
     FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
-
-    const size_t froxelCountX = mFroxelCountX;
     RecordBufferType* const UTILS_RESTRICT froxelRecords = mRecordBufferUser.data();
 
-    // how many froxel record entries were reused (for debugging)
-    UTILS_UNUSED size_t reused = 0;
+    // chunks of slices are compressed independently, each one writes its records after the
+    // ones of the previous chunks
+    std::array<size_t, COMPRESSION_CHUNK_COUNT> chunkRecordCounts{};
+    std::array<size_t, COMPRESSION_CHUNK_COUNT> chunkRecordEnds{};
+    auto getChunkBegin = [sliceSize, sliceCount, chunkCount](size_t chunk) {
+        return (chunk * sliceCount / chunkCount) * sliceSize;
+    };
 
-    for (size_t i = 0, c = getFroxelCount(); i < c;) {
-        LightRecord b = records[i];
-        if (b.lights.none()) {
-            froxels[i++].u32 = 0;
-            continue;
-        }
+    auto isEmpty = [wordCount](LightRecordWord const* UTILS_RESTRICT record) {
+        return std::all_of(record, record + wordCount, [](LightRecordWord w) { return !w; });
+    };
 
-        // We have a limitation of 255 spot + 255 point lights per froxel.
-        // note: initializer list for union cannot have more than one element
-        FroxelEntry entry; 
-        entry.offset = offset;
-        entry.count = (uint8_t)std::min(size_t(255), b.lights.count());
+    auto isEqual = [wordCount](LightRecordWord const* UTILS_RESTRICT lhs,
+            LightRecordWord const* UTILS_RESTRICT rhs) {
+        return std::equal(lhs, lhs + wordCount, rhs);
+    };
 
-        const size_t lightCount = entry.count;
+    // First pass: finds the records of each froxel, and assigns them offsets relative to the
+    // beginning of the chunk's records.
+    auto compress = [&](size_t chunk) {
+        const size_t first = getChunkBegin(chunk);
+        const size_t last = getChunkBegin(chunk + 1);
+
+        // convert froxel data from N groups of M bits to light record words, so we can
+        // easily compare adjacent froxels, for compaction. The conversion loops below get
+        // inlined and vectorized in release builds.
+        for (size_t j = first; j < last; j++) {
+            for (size_t i = 0; i < wordCount; i++) {
+                constexpr size_t r = GROUP_PER_RECORD_WORD;
+                LightRecordWord b = froxelThreadData[i * r][j];
+                for (size_t k = 1; k < r; k++) {
+                    b |= LightRecordWord(froxelThreadData[i * r + k][j]) << (LIGHT_PER_GROUP * k);
+                }
+                records[j * wordCount + i] = b;
+            }
+        }
 
-        if (UTILS_UNLIKELY(offset + lightCount >= RECORD_BUFFER_ENTRY_COUNT)) {
-#ifndef NDEBUG
-            slog.d << "out of space: " << i << ", at " << offset << io::endl;
-#endif
-            // note: instead of dropping froxels we could look for similar records we've already
-            // filed up.
-            do { // this compiles to memset()
+        size_t offset = 0;
+        for (size_t i = first; i < last;) {
+            LightRecordWord const* b = records + i * wordCount;
+            if (isEmpty(b)) {
                 froxels[i++].u32 = 0;
-            } while(i < c);
-            goto out_of_memory;
-        }
+                continue;
+            }
 
-        // iterate the bitfield
-        auto * const beginPoint = froxelRecords + offset;
-        b.lights.forEachSetBit([point = beginPoint, beginPoint](size_t l) mutable {
-            // make sure to keep this code branch-less
-            const size_t word = l / LIGHT_PER_GROUP;
-            const size_t bit  = l % LIGHT_PER_GROUP;
-            l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-            *point = (RecordBufferType)l;
-            // we need to "cancel" the write if we have more than 255 spot or point lights
-            // (this is a limitation of the data type used to store the light counts per froxel)
-            point += (point - beginPoint < 255) ? 1 : 0;
-        });
-
-        offset += lightCount;
+            size_t bitCount = 0;
+            for (size_t w = 0; w < wordCount; w++) {
+                bitCount += utils::popcount(b[w]);
+            }
 
-#ifndef NDEBUG
-        if (lightCount) { reused--; }
-#endif
-        do {
-#ifndef NDEBUG
-            if (lightCount) { reused++; }
-#endif
-            froxels[i++].u32 = entry.u32;
-            if (i >= c) break;
-
-            if (records[i].lights != b.lights && i >= froxelCountX) {
-                // if this froxel record doesn't match the previous one on its left,
-                // we re-try with the record above it, which saves many froxel records
-                // (north of 10% in practice).
-                b = records[i - froxelCountX];
-                entry.u32 = froxels[i - froxelCountX].u32;
+            // We have a limitation of 255 spot + 255 point lights per froxel.
+            // note: initializer list for union cannot have more than one element
+            FroxelEntry entry;
+            entry.count = (uint8_t)std::min(size_t(255), bitCount);
+
+            const size_t lightCount = entry.count;
+
+            if (UTILS_UNLIKELY(offset + lightCount >= RECORD_BUFFER_ENTRY_COUNT)) {
+                // these froxels wouldn't fit after the previous chunks' records either
+                do { // this compiles to memset()
+                    froxels[i++].u32 = 0;
+                } while(i < last);
+                break;
             }
-        } while(records[i].lights == b.lights);
+
+            entry.offset = uint16_t(offset);
+            offset += lightCount;
+
+            do {
+                froxels[i++].u32 = entry.u32;
+                if (i >= last) break;
+
+                if (!isEqual(records + i * wordCount, b) && i >= first + froxelCountX) {
+                    // if this froxel record doesn't match the previous one on its left,
+                    // we re-try with the record above it, which saves many froxel records
+                    // (north of 10% in practice).
+                    b = records + (i - froxelCountX) * wordCount;
+                    entry.u32 = froxels[i - froxelCountX].u32;
+                }
+            } while(isEqual(records + i * wordCount, b));
+        }
+        chunkRecordCounts[chunk] = offset;
+    };
+
+    // Second pass: writes the records of each chunk at its final offset. The froxels that
+    // start new records are the ones whose offset is the end of the records written so far,
+    // the others reuse records of froxels on their left or above them.
+    auto emit = [&](size_t chunk, size_t base) {
+        const size_t first = getChunkBegin(chunk);
+        const size_t last = getChunkBegin(chunk + 1);
+        size_t offset = 0;
+        for (size_t i = first; i < last; i++) {
+            FroxelEntry& entry = froxels[i];
+            if (!entry.count) {
+                continue;
+            }
+            const bool isNewRecord = entry.offset == offset;
+            if (UTILS_UNLIKELY(base + entry.offset + entry.count >= RECORD_BUFFER_ENTRY_COUNT)) {
+                // out of space, note: instead of dropping froxels we could look for similar
+                // records we've already filed up.
+                entry.u32 = 0;
+                continue;
+            }
+            if (isNewRecord) {
+                // iterate the bitfield
+                LightRecordWord const* b = records + i * wordCount;
+                auto * const beginPoint = froxelRecords + base + offset;
+                auto * point = beginPoint;
+                for (size_t w = 0; w < wordCount; w++) {
+                    for (LightRecordWord v = b[w]; v; v &= v - 1) {
+                        // make sure to keep this code branch-less
+                        const size_t l = w * 64 + utils::ctz(v);
+                        const size_t word = l / LIGHT_PER_GROUP;
+                        const size_t bit  = l % LIGHT_PER_GROUP;
+                        *point = (RecordBufferType)(bit * groupCount + word);
+                        // we need to "cancel" the write if we have more than 255 spot or point
+                        // lights (this is a limitation of the data type used to store the light
+                        // counts per froxel)
+                        point += (point - beginPoint < 255) ? 1 : 0;
+                    }
+                }
+                offset += entry.count;
+            }
+            entry.offset = uint16_t(base + entry.offset);
+        }
+        chunkRecordEnds[chunk] = base + offset;
+    };
+
+    JobSystem::Job* parent = js.createJob();
+    for (size_t i = 0; i < chunkCount; i++) {
+        js.run(jobs::createJob(js, parent, std::cref(compress), i));
+    }
+    js.runAndWait(parent);
+
+    // prefix sum of the chunks' record counts
+    size_t base = 0;
+    parent = js.createJob();
+    for (size_t i = 0; i < chunkCount; i++) {
+        js.run(jobs::createJob(js, parent, std::cref(emit), i, base));
+        base += chunkRecordCounts[i];
+    }
+    js.runAndWait(parent);
+
+    mRecordCount = *std::max_element(
+            chunkRecordEnds.cbegin(), chunkRecordEnds.cbegin() + chunkCount);
+
+    // the end of the last row of the froxel buffer doesn't correspond to any froxel
+    for (size_t i = getFroxelCount(), c = mFroxelBufferUser.size(); i < c; i++) {
+        froxels[i].u32 = 0;
     }
-out_of_memory:
-    ;
 }
 
 static inline float2 project(mat4f const& p, float3 const& v) noexcept {
@@ -62,8 +62,15 @@ public:
     size_t getSize() const noexcept { return mSize; }
 
     // source data isn't copied and must stay valid until the command-buffer is executed
+    // the data must cover whole rows, starting from the first one
     void commit(backend::DriverApi& driverApi, void const* begin, void const* end) noexcept {
-        commitSlow(driverApi, begin, end);
+        commitSlow(driverApi, begin, end, 0);
+    }
+
+    // same as above, but the data covers whole rows starting from 'firstRow'
+    void commit(backend::DriverApi& driverApi, void const* begin, void const* end,
+            size_t firstRow) noexcept {
+        commitSlow(driverApi, begin, end, firstRow);
     }
 
     template<typename T>
@@ -78,6 +85,9 @@ public:
         group.setSampler(index, { getHandle(), getSamplerParams() });
     }
 
+    // binds the buffer to image 'unit' so it can be written by a compute program
+    void bindImage(backend::DriverApi& driverApi, uint8_t unit) const noexcept;
+
 private:
     // this is really hidden implementation details (the fact we're using a texture should be
     // exposed as little as possible)
@@ -85,7 +95,8 @@ private:
     backend::SamplerParams getSamplerParams() const noexcept { return backend::SamplerParams{}; }
 
 private:
-    void commitSlow(backend::DriverApi& driverApi, void const* begin, void const* end) noexcept;
+    void commitSlow(backend::DriverApi& driverApi, void const* begin, void const* end,
+            size_t firstRow) noexcept;
 
     backend::Handle<backend::HwTexture> mTexture;
     uint32_t mSize = 0;
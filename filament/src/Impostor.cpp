@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/Impostor.h"
+
+#include "components/RenderableManager.h"
+#include "components/TransformManager.h"
+
+#include "details/Camera.h"
+#include "details/Engine.h"
+#include "details/IndexBuffer.h"
+#include "details/IndirectLight.h"
+#include "details/Material.h"
+#include "details/MaterialInstance.h"
+#include "details/Renderer.h"
+#include "details/RenderTarget.h"
+#include "details/Scene.h"
+#include "details/Texture.h"
+#include "details/VertexBuffer.h"
+#include "details/View.h"
+
+#include "FilamentAPI-impl.h"
+
+#include <filament/Camera.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderTarget.h>
+#include <filament/Texture.h>
+#include <filament/TextureSampler.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+
+#include <utils/EntityManager.h>
+#include <utils/Panic.h>
+
+#include <math/mat4.h>
+#include <math/vec2.h>
+#include <math/vec3.h>
+
+#include <cmath>
+
+using namespace filament::math;
+
+namespace filament {
+
+struct Impostor::BuilderDetails {
+    utils::Entity mRenderable;
+    utils::Entity mSource;
+    FIndirectLight* mIndirectLight = nullptr;
+    uint32_t mSize = 64;
+    float mScreenSize = 0.05f;
+    uint8_t mFrames = 8;
+};
+
+using BuilderType = Impostor;
+BuilderType::Builder::Builder() noexcept = default;
+BuilderType::Builder::~Builder() noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder&& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs) noexcept = default;
+
+Impostor::Builder& Impostor::Builder::renderable(utils::Entity renderable) noexcept {
+    mImpl->mRenderable = renderable;
+    return *this;
+}
+
+Impostor::Builder& Impostor::Builder::source(utils::Entity source) noexcept {
+    mImpl->mSource = source;
+    return *this;
+}
+
+Impostor::Builder& Impostor::Builder::size(uint32_t size) noexcept {
+    mImpl->mSize = size;
+    return *this;
+}
+
+Impostor::Builder& Impostor::Builder::frames(uint8_t frames) noexcept {
+    mImpl->mFrames = frames;
+    return *this;
+}
+
+Impostor::Builder& Impostor::Builder::screenSize(float screenSize) noexcept {
+    mImpl->mScreenSize = screenSize;
+    return *this;
+}
+
+Impostor::Builder& Impostor::Builder::indirectLight(IndirectLight* indirectLight) noexcept {
+    mImpl->mIndirectLight = upcast(indirectLight);
+    return *this;
+}
+
+Impostor* Impostor::Builder::build(Engine& engine) {
+    FRenderableManager const& rcm = upcast(engine).getRenderableManager();
+    if (!ASSERT_PRECONDITION_NON_FATAL(rcm.hasComponent(mImpl->mRenderable),
+            "a renderable is required")) {
+        return nullptr;
+    }
+    if (!mImpl->mSource) {
+        mImpl->mSource = mImpl->mRenderable;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(rcm.hasComponent(mImpl->mSource),
+            "the source must be a renderable")) {
+        return nullptr;
+    }
+    const uint32_t size = mImpl->mSize;
+    if (!ASSERT_PRECONDITION_NON_FATAL(size && !(size & (size - 1)),
+            "size must be a power-of-two")) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mFrames >= 2 && mImpl->mFrames <= 16,
+            "frames must be between 2 and 16")) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mScreenSize > 0.0f && mImpl->mScreenSize < 1.0f,
+            "screenSize must be between 0 and 1")) {
+        return nullptr;
+    }
+    return upcast(engine).createImpostor(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Octahedral mapping of [-1, 1]^2 to the unit sphere, +y at the center, -y at the corners. It
+// must match the one of the impostor materials (materials/impostor/impostor.vs).
+static float3 octahedralDecode(float2 p) noexcept {
+    float3 d{ p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y };
+    if (d.y < 0.0f) {
+        const float2 xz{ (1.0f - std::abs(d.z)) * (d.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::abs(d.x)) * (d.z >= 0.0f ? 1.0f : -1.0f) };
+        d.x = xz.x;
+        d.z = xz.y;
+    }
+    return normalize(d);
+}
+
+// the quad's corners, the material places them in front of the camera
+static constexpr float2 sQuadVertices[4] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+static constexpr uint16_t sQuadIndices[6] = { 0, 1, 2, 0, 2, 3 };
+
+FImpostor::FImpostor(FEngine& engine, const Builder& builder)
+        : mEngine(engine),
+          mRenderable(builder->mRenderable),
+          mSource(builder->mSource),
+          mScreenSize(builder->mScreenSize),
+          mFrames(builder->mFrames) {
+    Engine& e = engine;
+    const uint32_t size = builder->mSize;
+    const uint32_t frameCount = uint32_t(mFrames) * mFrames;
+
+    // The atlas has its mipmap levels, a distant impostor covers a few texels of its frame. The
+    // captured values are in physical units, they need a floating point format.
+    mAtlas = upcast(Texture::Builder()
+            .width(size)
+            .height(size)
+            .depth(frameCount)
+            .levels(uint8_t(FTexture::maxLevelCount(size)))
+            .sampler(Texture::Sampler::SAMPLER_2D_ARRAY)
+            .format(Texture::InternalFormat::RGBA16F)
+            .usage(Texture::Usage::COLOR_ATTACHMENT | Texture::Usage::SAMPLEABLE)
+            .build(e));
+
+    // all the frames share the depth buffer, it's cleared for each of them
+    mDepth = upcast(Texture::Builder()
+            .width(size)
+            .height(size)
+            .format(Texture::InternalFormat::DEPTH24)
+            .usage(Texture::Usage::DEPTH_ATTACHMENT)
+            .build(e));
+
+    mTargets.resize(frameCount);
+    for (uint32_t layer = 0; layer < frameCount; layer++) {
+        mTargets[layer] = upcast(RenderTarget::Builder()
+                .texture(RenderTarget::AttachmentPoint::COLOR, mAtlas)
+                .layer(RenderTarget::AttachmentPoint::COLOR, layer)
+                .texture(RenderTarget::AttachmentPoint::DEPTH, mDepth)
+                .build(e));
+    }
+
+    // the frames only show the source, lit by the given IndirectLight and the lights added
+    mScene = upcast(e.createScene());
+    mScene->addEntity(mSource);
+    mScene->setIndirectLight(builder->mIndirectLight);
+
+    mCameraEntity = utils::EntityManager::get().create();
+    mCamera = upcast(e.createCamera(mCameraEntity));
+    // f/1, 1.2s, ISO 100 gives an exposure of exactly 1
+    mCamera->setExposure(1.0f, 1.2f, 100.0f);
+
+    mView = upcast(e.createView());
+    mView->setName("Impostor");
+    mView->setScene(mScene);
+    mView->setCamera(mCamera);
+    mView->setViewport({ 0, 0, size, size });
+    mView->setPostProcessingEnabled(false);
+    mView->setShadowingEnabled(false);
+    mView->setScreenSpaceRefractionEnabled(false);
+
+    // The quad is drawn with the renderable's instance count, the material applies their
+    // transforms if they have any.
+    FRenderableManager const& rcm = engine.getRenderableManager();
+    const auto ri = rcm.getInstance(mRenderable);
+    const bool instanced = bool(rcm.getInstancesUbh(ri));
+    const Box aabb = rcm.getAxisAlignedBoundingBox(ri);
+
+    mMaterialInstance = engine.getImpostorMaterial(instanced)->createInstance("Impostor");
+    mMaterialInstance->setParameter("atlas", mAtlas, {
+            TextureSampler::MinFilter::LINEAR_MIPMAP_LINEAR, TextureSampler::MagFilter::LINEAR });
+    mMaterialInstance->setParameter("frames", int32_t(mFrames));
+    mMaterialInstance->setParameter("center", aabb.center);
+    mMaterialInstance->setParameter("radius", length(aabb.halfExtent));
+
+    mVertices = upcast(VertexBuffer::Builder()
+            .vertexCount(4)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT2, 0)
+            .build(e));
+    mVertices->setBufferAt(engine, 0, { sQuadVertices, sizeof(sQuadVertices) });
+
+    mIndices = upcast(IndexBuffer::Builder()
+            .indexCount(6)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(e));
+    mIndices->setBuffer(engine, { sQuadIndices, sizeof(sQuadIndices) });
+
+    RenderableManager::Builder::Entry entry;
+    entry.vertices = mVertices;
+    entry.indices = mIndices;
+    entry.maxIndex = 3;
+    entry.count = 6;
+    entry.materialInstance = mMaterialInstance;
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    mPrimitiveHandle = driver.createRenderPrimitive();
+    mPrimitive.init(driver, mPrimitiveHandle, entry);
+}
+
+void FImpostor::terminate(FEngine& engine) noexcept {
+    FRenderableManager& rcm = engine.getRenderableManager();
+    if (mBaked && rcm.hasComponent(mRenderable)) {
+        rcm.setImpostor(rcm.getInstance(mRenderable), {}, 0.0f);
+    }
+
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    mPrimitive.terminate(driver);
+    driver.destroyRenderPrimitive(mPrimitiveHandle);
+
+    // use Engine::destroy because FEngine::destroy is inlined
+    Engine& e = engine;
+    e.destroy(mMaterialInstance);
+    e.destroy(mVertices);
+    e.destroy(mIndices);
+    e.destroy(mView);
+    e.destroy(mScene);
+    e.destroyCameraComponent(mCameraEntity);
+    utils::EntityManager::get().destroy(mCameraEntity);
+    for (FRenderTarget* target : mTargets) {
+        e.destroy(target);
+    }
+    e.destroy(mAtlas);
+    e.destroy(mDepth);
+}
+
+void FImpostor::bake(FRenderer& renderer) {
+    FRenderableManager& rcm = mEngine.getRenderableManager();
+    FTransformManager const& tcm = mEngine.getTransformManager();
+    if (!ASSERT_PRECONDITION_NON_FATAL(
+            rcm.hasComponent(mRenderable) && rcm.hasComponent(mSource),
+            "the renderables of the Impostor were destroyed")) {
+        return;
+    }
+
+    // The frames are captured in the object's space, from the source's current transform. The
+    // bounding sphere is the replaced renderable's, for a single instance.
+    const Box aabb = rcm.getAxisAlignedBoundingBox(rcm.getInstance(mRenderable));
+    const auto ti = tcm.getInstance(mSource);
+    const mat4f worldFromObject = ti ? tcm.getWorldTransform(ti) : mat4f{};
+    const float3 center = (worldFromObject * float4{ aabb.center, 1.0f }).xyz;
+    const float radius = length(aabb.halfExtent) * length(worldFromObject[0].xyz);
+    mCamera->setProjection(Camera::Projection::ORTHO,
+            -radius, radius, -radius, radius, 0.5f * radius, 3.5f * radius);
+
+    // Each frame is an orthographic capture from a direction of the octahedral grid, its up
+    // vector must be the one the material computes to place the quad.
+    const float last = float(mFrames - 1);
+    for (uint8_t y = 0; y < mFrames; y++) {
+        for (uint8_t x = 0; x < mFrames; x++) {
+            const float3 d = octahedralDecode(float2{ float(x), float(y) } / last * 2.0f - 1.0f);
+            const float3 up = std::abs(d.y) > 0.999f ? float3{ 0, 0, 1 } : float3{ 0, 1, 0 };
+            const float3 direction = normalize(worldFromObject.upperLeft() * d);
+            mCamera->lookAt(center + direction * (2.0f * radius), center,
+                    normalize(worldFromObject.upperLeft() * up));
+            mView->setRenderTarget(mTargets[y * mFrames + x]);
+            renderer.renderCleared(mView, {});
+        }
+    }
+
+    // the mipmaps are generated right after the frames are rendered, within this frame
+    mAtlas->generateMipmaps(mEngine);
+
+    if (!mBaked) {
+        mBaked = true;
+        rcm.setImpostor(rcm.getInstance(mRenderable), { &mPrimitive, 1u }, mScreenSize);
+    }
+}
+
+void FImpostor::setScreenSize(float screenSize) noexcept {
+    mScreenSize = screenSize;
+    FRenderableManager& rcm = mEngine.getRenderableManager();
+    if (mBaked && rcm.hasComponent(mRenderable)) {
+        rcm.setImpostor(rcm.getInstance(mRenderable), { &mPrimitive, 1u }, mScreenSize);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+void Impostor::bake(Renderer& renderer) {
+    upcast(this)->bake(upcast(renderer));
+}
+
+bool Impostor::isBaked() const noexcept {
+    return upcast(this)->isBaked();
+}
+
+void Impostor::setScreenSize(float screenSize) noexcept {
+    upcast(this)->setScreenSize(screenSize);
+}
+
+float Impostor::getScreenSize() const noexcept {
+    return upcast(this)->getScreenSize();
+}
+
+Texture* Impostor::getAtlas() const noexcept {
+    return upcast(this)->getAtlas();
+}
+
+View* Impostor::getView() noexcept {
+    return upcast(this)->getView();
+}
+
+} // namespace filament
@@ -25,6 +25,7 @@ namespace filament {
 struct IndexBuffer::BuilderDetails {
     uint32_t mIndexCount = 0;
     IndexType mIndexType = IndexType::UINT;
+    bool mStreaming = false;
 };
 
 using BuilderType = IndexBuffer;
@@ -45,6 +46,11 @@ IndexBuffer::Builder& IndexBuffer::Builder::bufferType(IndexType indexType) noex
     return *this;
 }
 
+IndexBuffer::Builder& IndexBuffer::Builder::streaming(bool enabled) noexcept {
+    mImpl->mStreaming = enabled;
+    return *this;
+}
+
 IndexBuffer* IndexBuffer::Builder::build(Engine& engine) {
     return upcast(engine).createIndexBuffer(*this);
 }
@@ -52,12 +58,14 @@ IndexBuffer* IndexBuffer::Builder::build(Engine& engine) {
 // ------------------------------------------------------------------------------------------------
 
 FIndexBuffer::FIndexBuffer(FEngine& engine, const IndexBuffer::Builder& builder)
-        : mIndexCount(builder->mIndexCount) {
-    FEngine::DriverApi& driver = engine.getDriverApi();
+        : mIndexCount(builder->mIndexCount),
+          mIndexSize(builder->mIndexType == IndexType::UINT ? 4 : 2) {
+    FEngine::ResourceCommands commands(engine);
+    FEngine::DriverApi& driver = commands.getDriverApi();
     mHandle = driver.createIndexBuffer(
             (backend::ElementType)builder->mIndexType,
             uint32_t(builder->mIndexCount),
-            backend::BufferUsage::STATIC);
+            builder->mStreaming ? backend::BufferUsage::STREAM : backend::BufferUsage::STATIC);
 }
 
 void FIndexBuffer::terminate(FEngine& engine) {
@@ -66,7 +74,19 @@ void FIndexBuffer::terminate(FEngine& engine) {
 }
 
 void FIndexBuffer::setBuffer(FEngine& engine, BufferDescriptor&& buffer, uint32_t byteOffset) {
+    FEngine::ResourceCommands commands(engine);
+    commands.getDriverApi().updateIndexBuffer(mHandle, std::move(buffer), byteOffset);
+}
+
+void* FIndexBuffer::mapBuffer(FEngine& engine, uint32_t byteCount, uint32_t byteOffset) {
+    if (byteCount == 0) {
+        return nullptr;
+    }
+    // see FVertexBuffer::mapBufferAt()
+    BufferDescriptor buffer = engine.getStreamingBufferAllocator().allocate(byteCount);
+    void* const data = const_cast<void*>(buffer.buffer);
     engine.getDriverApi().updateIndexBuffer(mHandle, std::move(buffer), byteOffset);
+    return data;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -78,6 +98,10 @@ void IndexBuffer::setBuffer(Engine& engine,
     upcast(this)->setBuffer(upcast(engine), std::move(buffer), byteOffset);
 }
 
+void* IndexBuffer::mapBuffer(Engine& engine, uint32_t byteCount, uint32_t byteOffset) {
+    return upcast(this)->mapBuffer(upcast(engine), byteCount, byteOffset);
+}
+
 size_t IndexBuffer::getIndexCount() const noexcept {
     return upcast(this)->getIndexCount();
 }
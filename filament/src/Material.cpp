@@ -36,6 +36,9 @@
 
 #include <utils/CString.h>
 #include <utils/Panic.h>
+#include <utils/Systrace.h>
+
+#include <inttypes.h>
 
 using namespace utils;
 using namespace filaflat;
@@ -44,11 +47,35 @@ namespace filament {
 
 using namespace backend;
 
-static MaterialParser* createParser(Backend backend, const void* data, size_t size) {
-    MaterialParser* materialParser = new MaterialParser(backend, data, size);
+static_assert(Material::DIRECTIONAL_LIGHTING == Variant::DIRECTIONAL_LIGHTING &&
+        Material::DYNAMIC_LIGHTING == Variant::DYNAMIC_LIGHTING &&
+        Material::SHADOW_RECEIVER == Variant::SHADOW_RECEIVER &&
+        Material::SKINNING == Variant::SKINNING_OR_MORPHING &&
+        Material::FOG == Variant::FOG &&
+        Material::VSM == Variant::VSM,
+        "Material::VariantFeature must match the variant bits");
+
+static MaterialParser* createParser(FEngine& engine, const void* data, size_t size,
+        bool copy) {
+    const Backend backend = engine.getBackend();
+    MaterialParser* materialParser = new MaterialParser(backend, data, size, copy);
 
     MaterialParser::ParseResult materialResult = materialParser->parse();
 
+    // the shaders of the materials built with a shared dictionary need it
+    uint64_t dictionaryId;
+    if (materialResult == MaterialParser::ParseResult::SUCCESS &&
+            materialParser->getSharedDictionary(&dictionaryId)) {
+        BlobDictionary const* dictionary = engine.getShaderDictionary(dictionaryId);
+        if (!ASSERT_POSTCONDITION_NON_FATAL(dictionary,
+                "the material needs the shared shader dictionary %016" PRIx64
+                ", see Engine::loadShaderDictionary()\n", dictionaryId)) {
+            delete materialParser;
+            return nullptr;
+        }
+        materialParser->setSharedDictionary(dictionary);
+    }
+
     if (backend == Backend::NOOP) {
         return materialParser;
     }
@@ -76,6 +103,7 @@ static MaterialParser* createParser(Backend backend, const void* data, size_t si
 struct Material::BuilderDetails {
     const void* mPayload = nullptr;
     size_t mSize = 0;
+    bool mCopyPackage = true;
     MaterialParser* mMaterialParser = nullptr;
     bool mDefaultMaterial = false;
 };
@@ -95,12 +123,23 @@ BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs
 Material::Builder& Material::Builder::package(const void* payload, size_t size) {
     mImpl->mPayload = payload;
     mImpl->mSize = size;
+    mImpl->mCopyPackage = true;
+    return *this;
+}
+
+Material::Builder& Material::Builder::packageNoCopy(const void* payload, size_t size) {
+    mImpl->mPayload = payload;
+    mImpl->mSize = size;
+    mImpl->mCopyPackage = false;
     return *this;
 }
 
 Material* Material::Builder::build(Engine& engine) {
-    MaterialParser* materialParser = createParser(
-            upcast(engine).getBackend(), mImpl->mPayload, mImpl->mSize);
+    MaterialParser* materialParser = createParser(upcast(engine), mImpl->mPayload, mImpl->mSize,
+            mImpl->mCopyPackage);
+    if (!materialParser) {
+        return nullptr;
+    }
 
     uint32_t v = 0;
     materialParser->getShaderModels(&v);
@@ -191,11 +230,29 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
     parser->getRequiredAttributes(&mRequiredAttributes);
     parser->getRefractionMode(&mRefractionMode);
     parser->getRefractionType(&mRefractionType);
+    parser->isFoveationEnabled(&mFoveationEnabled);
 
     if (mBlendingMode == BlendingMode::MASKED) {
         parser->getMaskThreshold(&mMaskThreshold);
     }
 
+    // The depth variant transforms the positions, skins and morphs them, and runs the material's
+    // vertex code, which can read the custom attributes. MASKED materials also run the
+    // fragment code to compute the alpha.
+    for (size_t i = VertexAttribute::CUSTOM0; i <= VertexAttribute::CUSTOM7; i++) {
+        mDepthAttributes.set(i, mRequiredAttributes[i]);
+    }
+    mDepthAttributes.set(VertexAttribute::POSITION);
+    mDepthAttributes.set(VertexAttribute::BONE_INDICES);
+    mDepthAttributes.set(VertexAttribute::BONE_WEIGHTS);
+    mDepthAttributes.set(VertexAttribute::MORPH_POSITION_0);
+    mDepthAttributes.set(VertexAttribute::MORPH_POSITION_1);
+    mDepthAttributes.set(VertexAttribute::MORPH_POSITION_2);
+    mDepthAttributes.set(VertexAttribute::MORPH_POSITION_3);
+    if (mBlendingMode == BlendingMode::MASKED) {
+        mDepthAttributes |= mRequiredAttributes;
+    }
+
     // The fade blending mode only affects shading. For proper sorting we need to
     // treat this blending mode as a regular transparent blending operation.
     if (UTILS_UNLIKELY(mBlendingMode == BlendingMode::FADE)) {
@@ -287,10 +344,11 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
     mIsDefaultMaterial = builder->mDefaultMaterial;
 
     // pre-cache the shared variants -- these variants are shared with the default material.
+    // The picking variants are shared too, but only created when a picking query needs them.
     if (UTILS_UNLIKELY(!mIsDefaultMaterial && !mHasCustomDepthShader)) {
         auto& cachedPrograms = mCachedPrograms;
         for (uint8_t i = 0, n = cachedPrograms.size(); i < n; ++i) {
-            if (Variant(i).isDepthPass()) {
+            if (Variant(i).isDepthPass() && !Variant(i).hasPicking()) {
                 cachedPrograms[i] = engine.getDefaultMaterial()->getProgram(i);
             }
         }
@@ -344,6 +402,67 @@ UniformInterfaceBlock::UniformInfo const* FMaterial::reflect(
     return p == list.end() ? nullptr : &static_cast<UniformInterfaceBlock::UniformInfo const&>(*p);
 }
 
+void FMaterial::compile(uint8_t variants,
+        Material::CompilationCallback callback, void* user) noexcept {
+    SYSTRACE_CALL();
+
+    const ShaderModel sm = mEngine.getDriver().getShaderModel();
+    const bool isNoop = mEngine.getBackend() == Backend::NOOP;
+    const bool isSurface = getMaterialDomain() == MaterialDomain::SURFACE;
+
+    for (size_t i = 0; i < VARIANT_COUNT; i++) {
+        const uint8_t variantKey = uint8_t(i);
+        if (mCachedPrograms[variantKey]) {
+            continue;
+        }
+
+        uint8_t vertexVariantKey = variantKey;
+        uint8_t fragmentVariantKey = variantKey;
+        if (isSurface) {
+            // the depth variants don't depend on the lighting features
+            if (Variant::isReserved(variantKey) ||
+                    (variantKey & ~(variants | Variant::DEPTH)) ||
+                    Variant::filterVariant(variantKey, isVariantLit()) != variantKey) {
+                continue;
+            }
+            vertexVariantKey = Variant::filterVariantVertex(variantKey);
+            fragmentVariantKey = Variant::filterVariantFragment(variantKey);
+        }
+
+        // skip the variants matc didn't generate, getProgram() would fail on them
+        if (!isNoop && !(mMaterialParser->hasShader(sm, vertexVariantKey, ShaderType::VERTEX) &&
+                mMaterialParser->hasShader(sm, fragmentVariantKey, ShaderType::FRAGMENT))) {
+            continue;
+        }
+        getProgram(variantKey);
+    }
+
+    if (callback) {
+        // the driver executes the commands in order, so the programs have been created by then
+        mEngine.getDriverApi().queueCommand([this, callback, user]() {
+            callback(this, user);
+        });
+    }
+}
+
+bool FMaterial::hasVariant(uint8_t variantKey) const noexcept {
+    if (mCachedPrograms[variantKey]) {
+        return true;
+    }
+    if (Variant(variantKey).isDepthPass() && !mIsDefaultMaterial && !mHasCustomDepthShader) {
+        return mEngine.getDefaultMaterial()->hasVariant(variantKey);
+    }
+    if (mEngine.getBackend() == Backend::NOOP) {
+        return true;
+    }
+    // e.g. the picking variants of materials built before they existed
+    const ShaderModel sm = mEngine.getDriver().getShaderModel();
+    return mMaterialParser->hasShader(sm, Variant::filterVariantVertex(variantKey),
+                    ShaderType::VERTEX) &&
+            mMaterialParser->hasShader(sm, Variant::filterVariantFragment(variantKey),
+                    ShaderType::FRAGMENT);
+}
+
 Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
     switch (getMaterialDomain()) {
         case MaterialDomain::SURFACE:
@@ -362,6 +481,12 @@ Handle<HwProgram> FMaterial::getSurfaceProgramSlow(uint8_t variantKey)
 
     assert(!Variant::isReserved(variantKey));
 
+    if (Variant(variantKey).hasPicking() && !mIsDefaultMaterial && !mHasCustomDepthShader) {
+        Handle<HwProgram> const program = mEngine.getDefaultMaterial()->getProgram(variantKey);
+        mCachedPrograms[variantKey] = program;
+        return program;
+    }
+
     uint8_t vertexVariantKey = Variant::filterVariantVertex(variantKey);
     uint8_t fragmentVariantKey = Variant::filterVariantFragment(variantKey);
 
@@ -376,11 +501,17 @@ Handle<HwProgram> FMaterial::getSurfaceProgramSlow(uint8_t variantKey)
     if (Variant(variantKey).hasSkinningOrMorphing()) {
         pb.setUniformBlock(BindingPoints::PER_RENDERABLE_BONES,
                 UibGenerator::getPerRenderableBonesUib().getName());
+    } else {
+        pb.setUniformBlock(BindingPoints::PER_RENDERABLE_BONES,
+                UibGenerator::getPerRenderableInstancesUib().getName());
     }
 
     addSamplerGroup(pb, BindingPoints::PER_VIEW, SibGenerator::getPerViewSib(variantKey), mSamplerBindings);
     addSamplerGroup(pb, BindingPoints::PER_MATERIAL_INSTANCE, mSamplerInterfaceBlock, mSamplerBindings);
 
+    // surface programs can be skipped while they compile, it only delays the renderable
+    pb.nonBlocking(mEngine.isAsyncShaderCompilationEnabled());
+
     return createAndCacheProgram(std::move(pb), variantKey);
 }
 
@@ -441,7 +572,8 @@ Program FMaterial::getProgramBuilderWithVariants(
 
 Handle<HwProgram> FMaterial::createAndCacheProgram(Program&& p,
         uint8_t variantKey) const noexcept {
-    auto program = mEngine.getDriverApi().createProgram(std::move(p));
+    // identical programs are shared with the other materials
+    auto program = mEngine.getProgramCache().acquire(mEngine.getDriverApi(), std::move(p));
     assert(program);
 
     mCachedPrograms[variantKey] = program;
@@ -522,7 +654,7 @@ void FMaterial::onEditCallback(void* userdata, const utils::CString& name, const
 
     // This is called on a web server thread so we defer clearing the program cache
     // and swapping out the MaterialParser until the next getProgram call.
-    material->mPendingEdits = createParser(engine.getBackend(), packageData, packageSize);
+    material->mPendingEdits = createParser(engine, packageData, packageSize, true);
 }
 
 void FMaterial::onQueryCallback(void* userdata, uint64_t* pVariants) {
@@ -552,7 +684,7 @@ void FMaterial::destroyPrograms(FEngine& engine) {
                 continue;
             }
         }
-        driverApi.destroyProgram(cachedPrograms[i]);
+        engine.getProgramCache().release(driverApi, cachedPrograms[i]);
     }
 }
 
@@ -652,6 +784,10 @@ RefractionType Material::getRefractionType() const noexcept {
     return upcast(this)->getRefractionType();
 }
 
+bool Material::isFoveationEnabled() const noexcept {
+    return upcast(this)->isFoveationEnabled();
+}
+
 bool Material::hasParameter(const char* name) const noexcept {
     return upcast(this)->hasParameter(name);
 }
@@ -668,4 +804,8 @@ MaterialInstance const* Material::getDefaultInstance() const noexcept {
     return upcast(this)->getDefaultInstance();
 }
 
+void Material::compile(uint8_t variants, CompilationCallback callback, void* user) noexcept {
+    upcast(this)->compile(variants, callback, user);
+}
+
 } // namespace filament
@@ -28,6 +28,8 @@
 
 #include <utils/Log.h>
 
+#include <algorithm>
+
 #include <string.h>
 
 using namespace filament::math;
@@ -50,6 +52,7 @@ FMaterialInstance::FMaterialInstance(FEngine& engine, FMaterial const* material,
 
     if (!material->getSamplerInterfaceBlock().isEmpty()) {
         mSamplers.setSamplers(material->getDefaultInstance()->getSamplerGroup());
+        mStreamedTextures = material->getDefaultInstance()->getStreamedTextures();
         mSbHandle = driver.createSamplerGroup(mSamplers.getSize());
     }
 
@@ -116,15 +119,29 @@ void FMaterialInstance::initialize(FMaterial const* material) {
 }
 
 void FMaterialInstance::commitSlow(DriverApi& driver) const {
-    // update uniforms if needed
+    // update uniforms if needed, only the range that changed is uploaded
     if (mUniforms.isDirty()) {
-        driver.loadUniformBuffer(mUbHandle, mUniforms.toBufferDescriptor(driver));
+        const size_t size = getUniformsUpdateSize();
+        BufferDescriptor updates(driver.allocate(size), size);
+        writeUniformsUpdate(updates.buffer);
+        driver.updateUniformBuffers(std::move(updates));
     }
     if (mSamplers.isDirty()) {
         driver.updateSamplerGroup(mSbHandle, std::move(mSamplers.toCommandStream()));
     }
 }
 
+void* FMaterialInstance::writeUniformsUpdate(void* out) const noexcept {
+    assert(mUniforms.isDirty());
+    const size_t offset = mUniforms.getDirtyOffset();
+    const size_t size = mUniforms.getDirtySize();
+    UniformBufferUpdate* const update = new(out) UniformBufferUpdate{
+            mUbHandle, uint32_t(offset), uint32_t(size) };
+    memcpy(update->getData(), static_cast<char const*>(mUniforms.getBuffer()) + offset, size);
+    mUniforms.clean();
+    return static_cast<char*>(out) + UniformBufferUpdate::getStorageSize(size);
+}
+
 template<typename T, typename>
 inline void FMaterialInstance::setParameter(const char* name, T value) noexcept {
     ssize_t offset = mMaterial->getUniformInterfaceBlock().getUniformOffset(name, 0);
@@ -141,15 +158,63 @@ inline void FMaterialInstance::setParameter(const char* name, const T* value, si
     }
 }
 
+template <typename T, typename>
+void FMaterialInstance::setParameter(MaterialInstance* const* instances, size_t count,
+        const char* name, const T* values, size_t valueStride) noexcept {
+    if (UTILS_UNLIKELY(!count)) {
+        return;
+    }
+    FMaterial const* const material = upcast(instances[0])->mMaterial;
+    ssize_t offset = material->getUniformInterfaceBlock().getUniformOffset(name, 0);
+    for (size_t i = 0; i < count; i++) {
+        FMaterialInstance* const mi = upcast(instances[i]);
+        const T& value = values[i * valueStride];
+        if (UTILS_LIKELY(mi->mMaterial == material)) {
+            if (offset >= 0) {
+                mi->mUniforms.setUniform<T>(size_t(offset), value);
+            }
+        } else {
+            // the parameter may be elsewhere in the uniforms of another material
+            mi->setParameter<T>(name, value);
+        }
+    }
+}
+
 void FMaterialInstance::setParameter(const char* name,
         Texture const* texture, TextureSampler const& sampler) noexcept {
-    setParameter(name, upcast(texture)->getHwHandle(), sampler.getSamplerParams());
+    FTexture const* const t = upcast(texture);
+    setParameter(name, t->getHwHandle(), sampler.getSamplerParams());
+    if (UTILS_UNLIKELY(t->isStreamed())) {
+        size_t index = mMaterial->getSamplerInterfaceBlock().getSamplerInfo(name)->offset;
+        mStreamedTextures.push_back({ t, uint32_t(index) });
+    }
 }
 
 void FMaterialInstance::setParameter(const char* name,
         backend::Handle<backend::HwTexture> texture, backend::SamplerParams params) noexcept {
     size_t index = mMaterial->getSamplerInterfaceBlock().getSamplerInfo(name)->offset;
     mSamplers.setSampler(index, { texture, params });
+    if (UTILS_UNLIKELY(!mStreamedTextures.empty())) {
+        mStreamedTextures.erase(std::remove_if(mStreamedTextures.begin(), mStreamedTextures.end(),
+                [index](StreamedTexture const& entry) { return entry.index == index; }),
+                mStreamedTextures.end());
+    }
+}
+
+void FMaterialInstance::updateStreamedTextures() noexcept {
+    for (StreamedTexture const& entry : mStreamedTextures) {
+        const backend::SamplerGroup::Sampler sampler = mSamplers.getSamplers()[entry.index];
+        const backend::Handle<backend::HwTexture> handle = entry.texture->getHwHandle();
+        if (sampler.t != handle) {
+            mSamplers.setSampler(entry.index, { handle, sampler.s });
+        }
+    }
+}
+
+void FMaterialInstance::forgetStreamedTexture(FTexture const* texture) noexcept {
+    mStreamedTextures.erase(std::remove_if(mStreamedTextures.begin(), mStreamedTextures.end(),
+            [texture](StreamedTexture const& entry) { return entry.texture == texture; }),
+            mStreamedTextures.end());
 }
 
 void FMaterialInstance::setDoubleSided(bool doubleSided) noexcept {
@@ -283,6 +348,56 @@ template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (const char*
 template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (const char* name, const mat3f    *v, size_t c) noexcept;
 template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (const char* name, const mat4f    *v, size_t c) noexcept;
 
+template <typename T, typename>
+void MaterialInstance::setParameter(MaterialInstance* const* instances, size_t count,
+        const char* name, T value) noexcept {
+    FMaterialInstance::setParameter<T>(instances, count, name, &value, 0);
+}
+
+template <typename T, typename>
+void MaterialInstance::setParameter(MaterialInstance* const* instances, size_t count,
+        const char* name, const T* values) noexcept {
+    FMaterialInstance::setParameter<T>(instances, count, name, values, 1);
+}
+
+// explicit template instantiation of our supported types
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool>    (MaterialInstance* const*, size_t, const char*, bool) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float>   (MaterialInstance* const*, size_t, const char*, float) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int32_t> (MaterialInstance* const*, size_t, const char*, int32_t) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint32_t>(MaterialInstance* const*, size_t, const char*, uint32_t) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool2>   (MaterialInstance* const*, size_t, const char*, bool2) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool3>   (MaterialInstance* const*, size_t, const char*, bool3) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool4>   (MaterialInstance* const*, size_t, const char*, bool4) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int2>    (MaterialInstance* const*, size_t, const char*, int2) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int3>    (MaterialInstance* const*, size_t, const char*, int3) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int4>    (MaterialInstance* const*, size_t, const char*, int4) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint2>   (MaterialInstance* const*, size_t, const char*, uint2) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint3>   (MaterialInstance* const*, size_t, const char*, uint3) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint4>   (MaterialInstance* const*, size_t, const char*, uint4) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float2>  (MaterialInstance* const*, size_t, const char*, float2) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float3>  (MaterialInstance* const*, size_t, const char*, float3) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (MaterialInstance* const*, size_t, const char*, float4) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (MaterialInstance* const*, size_t, const char*, mat3f) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (MaterialInstance* const*, size_t, const char*, mat4f) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool>    (MaterialInstance* const*, size_t, const char*, const bool*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float>   (MaterialInstance* const*, size_t, const char*, const float*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int32_t> (MaterialInstance* const*, size_t, const char*, const int32_t*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint32_t>(MaterialInstance* const*, size_t, const char*, const uint32_t*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool2>   (MaterialInstance* const*, size_t, const char*, const bool2*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool3>   (MaterialInstance* const*, size_t, const char*, const bool3*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool4>   (MaterialInstance* const*, size_t, const char*, const bool4*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int2>    (MaterialInstance* const*, size_t, const char*, const int2*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int3>    (MaterialInstance* const*, size_t, const char*, const int3*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<int4>    (MaterialInstance* const*, size_t, const char*, const int4*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint2>   (MaterialInstance* const*, size_t, const char*, const uint2*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint3>   (MaterialInstance* const*, size_t, const char*, const uint3*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint4>   (MaterialInstance* const*, size_t, const char*, const uint4*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float2>  (MaterialInstance* const*, size_t, const char*, const float2*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float3>  (MaterialInstance* const*, size_t, const char*, const float3*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (MaterialInstance* const*, size_t, const char*, const float4*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (MaterialInstance* const*, size_t, const char*, const mat3f*) noexcept;
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (MaterialInstance* const*, size_t, const char*, const mat4f*) noexcept;
+
 void MaterialInstance::setParameter(const char* name, Texture const* texture,
         TextureSampler const& sampler) noexcept {
     return upcast(this)->setParameter(name, texture, sampler);
@@ -43,8 +43,9 @@ namespace filament {
 
 // ------------------------------------------------------------------------------------------------
 
-MaterialParser::MaterialParserDetails::MaterialParserDetails(Backend backend, const void* data, size_t size)
-        : mManagedBuffer(data, size),
+MaterialParser::MaterialParserDetails::MaterialParserDetails(Backend backend, const void* data,
+        size_t size, bool copy)
+        : mManagedBuffer(data, size, copy),
           mChunkContainer(mManagedBuffer.data(), mManagedBuffer.size()),
           mMaterialChunk(mChunkContainer) {
     switch (backend) {
@@ -79,10 +80,21 @@ bool MaterialParser::MaterialParserDetails::getFromSimpleChunk(filamat::ChunkTyp
     return false;
 }
 
+static ChunkType getCompressedMaterialTag(ChunkType materialTag) noexcept {
+    switch (materialTag) {
+        case ChunkType::MaterialGlsl:
+            return ChunkType::MaterialGlslCompressed;
+        case ChunkType::MaterialMetal:
+            return ChunkType::MaterialMetalCompressed;
+        default:
+            return ChunkType::Unknown;
+    }
+}
+
 // ------------------------------------------------------------------------------------------------
 
-MaterialParser::MaterialParser(Backend backend, const void* data, size_t size)
-        : mImpl(backend, data, size) {
+MaterialParser::MaterialParser(Backend backend, const void* data, size_t size, bool copy)
+        : mImpl(backend, data, size, copy) {
 }
 
 ChunkContainer& MaterialParser::getChunkContainer() noexcept {
@@ -96,12 +108,22 @@ ChunkContainer const& MaterialParser::getChunkContainer() const noexcept {
 MaterialParser::ParseResult MaterialParser::parse() noexcept {
     ChunkContainer& cc = getChunkContainer();
     if (cc.parse()) {
-        if (!cc.hasChunk(mImpl.mMaterialTag) || !cc.hasChunk(mImpl.mDictionaryTag)) {
+        // precompiled Metal libraries are preferred over the MSL, and like compressed text
+        // shaders they don't use the dictionary
+        const ChunkType compressedTag = getCompressedMaterialTag(mImpl.mMaterialTag);
+        const bool compressed = !cc.hasChunk(mImpl.mMaterialTag) &&
+                compressedTag != ChunkType::Unknown && cc.hasChunk(compressedTag);
+        if (mImpl.mMaterialTag == ChunkType::MaterialMetal &&
+                cc.hasChunk(ChunkType::MaterialMetalLibrary)) {
+            mImpl.mMaterialTag = ChunkType::MaterialMetalLibrary;
+            mImpl.mBlobDictionaryLoaded = true;
+        } else if (compressed) {
+            mImpl.mMaterialTag = compressedTag;
+            mImpl.mBlobDictionaryLoaded = true;
+        } else if (!cc.hasChunk(mImpl.mMaterialTag) || !cc.hasChunk(mImpl.mDictionaryTag)) {
             return ParseResult::ERROR_MISSING_BACKEND;
         }
-        if (!DictionaryReader::unflatten(cc, mImpl.mDictionaryTag, mImpl.mBlobDictionary)) {
-            return ParseResult::ERROR_OTHER;
-        }
+        // otherwise the dictionary is read by the first call to getShader()
         if (!mImpl.mMaterialChunk.readIndex(mImpl.mMaterialTag)) {
             return ParseResult::ERROR_OTHER;
         }
@@ -233,6 +255,10 @@ bool MaterialParser::hasCustomDepthShader(bool* value) const noexcept {
     return mImpl.getFromSimpleChunk(ChunkType::MaterialHasCustomDepthShader, value);
 }
 
+bool MaterialParser::isFoveationEnabled(bool* value) const noexcept {
+    return mImpl.getFromSimpleChunk(ChunkType::MaterialFoveation, value);
+}
+
 bool MaterialParser::hasSpecularAntiAliasing(bool* value) const noexcept {
     return mImpl.getFromSimpleChunk(ChunkType::MaterialSpecularAntiAliasing, value);
 }
@@ -269,10 +295,33 @@ bool MaterialParser::getRefractionType(RefractionType* value) const noexcept {
 
 bool MaterialParser::getShader(ShaderBuilder& shader,
         ShaderModel shaderModel, uint8_t variant, ShaderType stage) noexcept {
+    if (UTILS_UNLIKELY(!mImpl.mBlobDictionaryLoaded)) {
+        // materials are often created long before most of their shaders are needed, if ever
+        if (!DictionaryReader::unflatten(mImpl.mChunkContainer, mImpl.mDictionaryTag,
+                mImpl.mBlobDictionary)) {
+            return false;
+        }
+        mImpl.mBlobDictionaryLoaded = true;
+    }
     return mImpl.mMaterialChunk.getShader(shader,
             mImpl.mBlobDictionary, (uint8_t)shaderModel, variant, stage);
 }
 
+bool MaterialParser::hasShader(ShaderModel shaderModel,
+        uint8_t variant, ShaderType stage) const noexcept {
+    return mImpl.mMaterialChunk.hasShader((uint8_t)shaderModel, variant, (uint8_t)stage);
+}
+
+bool MaterialParser::getSharedDictionary(uint64_t* id) const noexcept {
+    // only the text dictionaries can be shared
+    return mImpl.mDictionaryTag == ChunkType::DictionaryText &&
+            mImpl.getFromSimpleChunk(ChunkType::DictionaryShared, id);
+}
+
+void MaterialParser::setSharedDictionary(BlobDictionary const* dictionary) noexcept {
+    mImpl.mBlobDictionary.setBase(dictionary);
+}
+
 // ------------------------------------------------------------------------------------------------
 
 
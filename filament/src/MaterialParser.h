@@ -44,7 +44,8 @@ struct SubpassInfo;
 
 class MaterialParser {
 public:
-    MaterialParser(backend::Backend backend, const void* data, size_t size);
+    // Unless 'copy' is false, the package is copied. Otherwise it must outlive the parser.
+    MaterialParser(backend::Backend backend, const void* data, size_t size, bool copy = true);
 
     MaterialParser(MaterialParser const& rhs) noexcept = delete;
     MaterialParser& operator=(MaterialParser const& rhs) noexcept = delete;
@@ -86,6 +87,7 @@ public:
     bool getRefractionMode(RefractionMode* value) const noexcept;
     bool getRefractionType(RefractionType* value) const noexcept;
     bool hasCustomDepthShader(bool* value) const noexcept;
+    bool isFoveationEnabled(bool* value) const noexcept;
     bool hasSpecularAntiAliasing(bool* value) const noexcept;
     bool getSpecularAntiAliasingVariance(float* value) const noexcept;
     bool getSpecularAntiAliasingThreshold(float* value) const noexcept;
@@ -93,9 +95,18 @@ public:
     bool getShader(filaflat::ShaderBuilder& shader, backend::ShaderModel shaderModel,
             uint8_t variant, backend::ShaderType stage) noexcept;
 
+    bool hasShader(backend::ShaderModel shaderModel,
+            uint8_t variant, backend::ShaderType stage) const noexcept;
+
+    // Returns the id of the shared dictionary the shaders of this backend need, if any.
+    bool getSharedDictionary(uint64_t* id) const noexcept;
+
+    // The shared dictionary must outlive this parser.
+    void setSharedDictionary(filaflat::BlobDictionary const* dictionary) noexcept;
+
 private:
     struct MaterialParserDetails {
-        MaterialParserDetails(backend::Backend backend, const void* data, size_t size);
+        MaterialParserDetails(backend::Backend backend, const void* data, size_t size, bool copy);
 
         template<typename T>
         bool getFromSimpleChunk(filamat::ChunkType type, T* value) const noexcept;
@@ -106,12 +117,20 @@ private:
         class ManagedBuffer {
             void* mStart = nullptr;
             size_t mSize = 0;
+            bool mOwned = false;
         public:
-            explicit ManagedBuffer(const void* start, size_t size)
-                    : mStart(malloc(size)), mSize(size) {
-                memcpy(mStart, start, size);
+            ManagedBuffer(const void* start, size_t size, bool copy)
+                    : mStart(copy ? malloc(size) : const_cast<void*>(start)), mSize(size),
+                      mOwned(copy) {
+                if (copy) {
+                    memcpy(mStart, start, size);
+                }
+            }
+            ~ManagedBuffer() noexcept {
+                if (mOwned) {
+                    free(mStart);
+                }
             }
-            ~ManagedBuffer() noexcept { free(mStart); }
             ManagedBuffer(ManagedBuffer const& rhs) = delete;
             ManagedBuffer& operator=(ManagedBuffer const& rhs) = delete;
             void* data() const noexcept { return mStart; }
@@ -125,7 +144,10 @@ private:
 
         // Keep MaterialChunk alive between calls to getShader to avoid reload the shader index.
         filaflat::MaterialChunk mMaterialChunk;
+
+        // The dictionary is only read by the first call to getShader().
         filaflat::BlobDictionary mBlobDictionary;
+        bool mBlobDictionaryLoaded = false;
         filamat::ChunkType mMaterialTag = filamat::ChunkType::Unknown;
         filamat::ChunkType mDictionaryTag = filamat::ChunkType::Unknown;
     };
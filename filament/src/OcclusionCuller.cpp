@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OcclusionCuller.h"
+
+#include "details/Engine.h"
+
+#include <utils/Systrace.h>
+
+#include <math/vec2.h>
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace filament::math;
+using namespace utils;
+
+namespace filament {
+
+using namespace backend;
+
+// A box must be this much (relatively) in front of the hi-z depth to be visible, this
+// absorbs the precision differences between the GPU depth and our projection.
+static constexpr float DEPTH_BIAS = 1.0f / 1024.0f;
+
+OcclusionCuller::OcclusionCuller() noexcept = default;
+
+OcclusionCuller::~OcclusionCuller() noexcept {
+    // terminate() must have been called
+    for (auto const& readback : mReadbacks) {
+        assert(readback.state.load(std::memory_order_relaxed) != PENDING);
+    }
+}
+
+void OcclusionCuller::terminate(FEngine& engine) noexcept {
+    // the driver might still be writing into our buffers
+    for (auto const& readback : mReadbacks) {
+        if (readback.state.load(std::memory_order_acquire) == PENDING) {
+            engine.flushAndWait();
+            break;
+        }
+    }
+    reset();
+}
+
+void OcclusionCuller::reset() noexcept {
+    for (auto& readback : mReadbacks) {
+        uint32_t expected = READY;
+        readback.state.compare_exchange_strong(expected, FREE, std::memory_order_relaxed);
+    }
+    mLevels.clear();
+}
+
+PixelBufferDescriptor OcclusionCuller::acquire(uint32_t width, uint32_t height,
+        mat4f const& clipFromWorld, float3 const& cameraPosition) noexcept {
+    auto pos = std::find_if(std::begin(mReadbacks), std::end(mReadbacks),
+            [](Readback const& readback) {
+                return readback.state.load(std::memory_order_acquire) == FREE;
+            });
+    if (pos == std::end(mReadbacks)) {
+        return {};
+    }
+
+    Readback& readback = *pos;
+    readback.data.resize(width * height);
+    readback.width = width;
+    readback.height = height;
+    readback.frame = mFrame;
+    readback.clipFromWorld = clipFromWorld;
+    readback.cameraPosition = cameraPosition;
+    readback.state.store(PENDING, std::memory_order_relaxed);
+
+    return PixelBufferDescriptor(readback.data.data(), readback.data.size() * sizeof(float),
+            PixelDataFormat::R, PixelDataType::FLOAT, &onReadbackComplete, &readback);
+}
+
+void OcclusionCuller::onReadbackComplete(void*, size_t, void* user) {
+    // this can be called from the driver thread
+    Readback* const readback = static_cast<Readback*>(user);
+    readback->state.store(READY, std::memory_order_release);
+}
+
+void OcclusionCuller::buildPyramid(Readback const& readback) noexcept {
+    SYSTRACE_CALL();
+
+    // compute the size of all levels first, so the storage doesn't move while we fill it
+    mLevels.clear();
+    size_t size = 0;
+    uint32_t w = readback.width;
+    uint32_t h = readback.height;
+    while (true) {
+        mLevels.push_back({ nullptr, w, h });
+        size += w * h;
+        if (w == 1 && h == 1) {
+            break;
+        }
+        w = std::max(1u, (w + 1) / 2);
+        h = std::max(1u, (h + 1) / 2);
+    }
+    mPyramid.resize(size);
+
+    float* p = mPyramid.data();
+    std::copy(readback.data.begin(), readback.data.end(), p);
+    mLevels[0].data = p;
+    for (size_t l = 1; l < mLevels.size(); l++) {
+        Level const& src = mLevels[l - 1];
+        Level& dst = mLevels[l];
+        p += src.width * src.height;
+        dst.data = p;
+        // each texel keeps the farthest depth (smallest with reversed-z) of its 2x2 footprint,
+        // odd sizes are handled by clamping
+        for (uint32_t y = 0; y < dst.height; y++) {
+            const uint32_t y0 = std::min(y * 2, src.height - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+            for (uint32_t x = 0; x < dst.width; x++) {
+                const uint32_t x0 = std::min(x * 2, src.width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+                p[y * dst.width + x] = std::min(
+                        std::min(src.data[y0 * src.width + x0], src.data[y0 * src.width + x1]),
+                        std::min(src.data[y1 * src.width + x0], src.data[y1 * src.width + x1]));
+            }
+        }
+    }
+
+    mPyramidFrame = readback.frame;
+    mClipFromWorld = readback.clipFromWorld;
+    mCameraPosition = readback.cameraPosition;
+}
+
+void OcclusionCuller::cull(FScene::RenderableSoa& renderableData, mat4f const& worldOrigin,
+        float3 const& cameraPosition, size_t bit) noexcept {
+    SYSTRACE_CALL();
+
+    const uint32_t frame = mFrame++;
+
+    // pick the most recent readback, and release the older ones
+    Readback* latest = nullptr;
+    for (auto& readback : mReadbacks) {
+        if (readback.state.load(std::memory_order_acquire) == READY) {
+            if (!latest || readback.frame > latest->frame) {
+                latest = &readback;
+            }
+        }
+    }
+    if (latest) {
+        buildPyramid(*latest);
+        for (auto& readback : mReadbacks) {
+            if (readback.state.load(std::memory_order_relaxed) == READY &&
+                    readback.frame <= latest->frame) {
+                readback.state.store(FREE, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    if (mLevels.empty() || frame - mPyramidFrame > MAX_LATENCY) {
+        return;
+    }
+
+    // renderables are in this frame's world origin space, bring them to the hi-z clip space
+    const mat4f clipFromScene = mClipFromWorld * inverse(worldOrigin);
+
+    // The camera moving reveals parts of the scene that were occluded, expanding the bounds by
+    // the distance it moved keeps this conservative.
+    const float expansion = length(cameraPosition - mCameraPosition);
+
+    const FScene::VisibleMaskType visibleBit = FScene::VisibleMaskType(1u << bit);
+    FScene::VisibleMaskType* const UTILS_RESTRICT visibleMask =
+            renderableData.data<FScene::VISIBLE_MASK>();
+    float3 const* const UTILS_RESTRICT centers = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* const UTILS_RESTRICT extents = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+
+    for (size_t i = 0, c = renderableData.size(); i < c; i++) {
+        if (!(visibleMask[i] & visibleBit)) {
+            continue;
+        }
+        const float4 center = clipFromScene * float4{ centers[i], 1.0f };
+        const float3 extent = extents[i] + expansion;
+        const float4 axes[3] = {
+                clipFromScene[0] * extent.x,
+                clipFromScene[1] * extent.y,
+                clipFromScene[2] * extent.z };
+        if (isOccluded(center, axes)) {
+            visibleMask[i] &= ~visibleBit;
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(float4 const& center, float4 const axes[3]) const noexcept {
+    // screen-space bounds and nearest depth (largest with reversed-z) of the box
+    float2 lo(std::numeric_limits<float>::max());
+    float2 hi(std::numeric_limits<float>::lowest());
+    float nearest = 0.0f;
+    for (size_t k = 0; k < 8; k++) {
+        const float4 p = center +
+                ((k & 1u) ? axes[0] : -axes[0]) +
+                ((k & 2u) ? axes[1] : -axes[1]) +
+                ((k & 4u) ? axes[2] : -axes[2]);
+        if (p.w <= 0.0f) {
+            // behind the camera
+            return false;
+        }
+        const float3 ndc = p.xyz / p.w;
+        lo = min(lo, ndc.xy);
+        hi = max(hi, ndc.xy);
+        nearest = std::max(nearest, 0.5f - 0.5f * ndc.z);
+    }
+
+    if (nearest >= 1.0f) {
+        // crosses the near plane
+        return false;
+    }
+
+    if (lo.x < -1.0f || lo.y < -1.0f || hi.x > 1.0f || hi.y > 1.0f) {
+        // not entirely in the previous viewport, we don't know what's there
+        return false;
+    }
+
+    Level const& base = mLevels[0];
+    const float2 size{ base.width, base.height };
+    const float2 tlo = (lo * 0.5f + 0.5f) * size;
+    const float2 thi = (hi * 0.5f + 0.5f) * size;
+
+    // pick the level where the box covers at most 2x2 texels
+    const float span = std::max({ thi.x - tlo.x, thi.y - tlo.y, 1.0f });
+    const size_t level = std::min(mLevels.size() - 1, size_t(std::ceil(std::log2(span))));
+    Level const& l = mLevels[level];
+
+    const uint32_t x0 = std::min(uint32_t(tlo.x) >> level, l.width - 1);
+    const uint32_t y0 = std::min(uint32_t(tlo.y) >> level, l.height - 1);
+    const uint32_t x1 = std::min(uint32_t(thi.x) >> level, l.width - 1);
+    const uint32_t y1 = std::min(uint32_t(thi.y) >> level, l.height - 1);
+
+    float farthest = std::numeric_limits<float>::max();
+    for (uint32_t y = y0; y <= y1; y++) {
+        for (uint32_t x = x0; x <= x1; x++) {
+            farthest = std::min(farthest, l.data[y * l.width + x]);
+        }
+    }
+
+    return nearest * (1.0f + DEPTH_BIAS) < farthest;
+}
+
+} // namespace filament
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_OCCLUSIONCULLER_H
+#define TNT_FILAMENT_OCCLUSIONCULLER_H
+
+#include "details/Scene.h"
+
+#include <backend/PixelBufferDescriptor.h>
+
+#include <utils/compiler.h>
+
+#include <math/mat4.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <atomic>
+#include <vector>
+
+namespace filament {
+
+class FEngine;
+
+/*
+ * OcclusionCuller rejects renderables hidden behind the opaque geometry of a previous frame.
+ *
+ * Each frame, the level of the hi-z pyramid PostProcessManager builds from the structure pass
+ * that holds the farthest depth of each tile is read back asynchronously into one of our buffers.
+ * When a readback is available, the coarser levels of the pyramid are rebuilt from it on the CPU,
+ * and the renderables' bounds are tested against it using the camera of that frame.
+ *
+ * Results have at least one frame of latency. Culling is conservative: renderables crossing the
+ * near plane or leaving the previous viewport are visible, bounds are expanded by the distance
+ * the camera moved since, and too old readbacks are ignored.
+ */
+class OcclusionCuller {
+public:
+    // size in pixels of the structure buffer tile reduced to a single hi-z texel
+    static constexpr uint32_t TILE_SIZE = 8;
+
+    // number of readbacks that can be in flight
+    static constexpr size_t BUFFER_COUNT = 3;
+
+    // readbacks older than this many frames are ignored
+    static constexpr uint32_t MAX_LATENCY = 4;
+
+    OcclusionCuller() noexcept;
+    ~OcclusionCuller() noexcept;
+
+    OcclusionCuller(OcclusionCuller const&) = delete;
+    OcclusionCuller& operator=(OcclusionCuller const&) = delete;
+
+    // waits for the readbacks in flight, must be called before destruction
+    void terminate(FEngine& engine) noexcept;
+
+    // Returns a descriptor to read back this frame's reduced depth of 'width' x 'height' R32F
+    // texels, or an empty descriptor if all buffers are in flight. 'clipFromWorld' is the
+    // transform the depth was rendered with and 'cameraPosition' the position of the camera,
+    // both in API world space (i.e. without the world origin).
+    backend::PixelBufferDescriptor acquire(uint32_t width, uint32_t height,
+            math::mat4f const& clipFromWorld, math::float3 const& cameraPosition) noexcept;
+
+    // Clears 'bit' in the VISIBLE_MASK of renderables occluded in the latest readback.
+    // Must be called once per frame. 'worldOrigin' is this frame's world origin transform and
+    // 'cameraPosition' is in API world space.
+    void cull(FScene::RenderableSoa& renderableData, math::mat4f const& worldOrigin,
+            math::float3 const& cameraPosition, size_t bit) noexcept;
+
+    // drops all readbacks, e.g. when occlusion culling is disabled
+    void reset() noexcept;
+
+private:
+    enum State : uint32_t {
+        FREE, PENDING, READY
+    };
+
+    struct Readback {
+        std::vector<float> data;
+        std::atomic<uint32_t> state = { FREE };
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t frame = 0;
+        math::mat4f clipFromWorld;
+        math::float3 cameraPosition;
+    };
+
+    struct Level {
+        float const* data;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    static void onReadbackComplete(void* buffer, size_t size, void* user);
+
+    void buildPyramid(Readback const& readback) noexcept;
+    // center and axes (scaled by the half-extent) of a box in clip space
+    bool isOccluded(math::float4 const& center, math::float4 const axes[3]) const noexcept;
+
+    Readback mReadbacks[BUFFER_COUNT];
+    uint32_t mFrame = 0;
+
+    // hi-z pyramid of the latest readback, level 0 is the readback itself
+    std::vector<float> mPyramid;
+    std::vector<Level> mLevels;
+    uint32_t mPyramidFrame = 0;
+    math::mat4f mClipFromWorld;
+    math::float3 mCameraPosition;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_OCCLUSIONCULLER_H
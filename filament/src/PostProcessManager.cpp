@@ -15,6 +15,7 @@
  */
 
 #include "PostProcessManager.h"
+#include "OcclusionCuller.h"
 
 #include "details/Engine.h"
 
@@ -121,7 +122,7 @@ FMaterial* PostProcessManager::PostProcessMaterial::loadMaterial() const noexcep
     // TODO: After all materials using this class have been converted to the post-process material
     //       domain, load both OPAQUE and TRANSPARENT variants here.
     mHasMaterial = true;
-    mMaterial = upcast(Material::Builder().package(mData, mSize).build(*mEngine));
+    mMaterial = mEngine->createEmbeddedMaterial(mData, mSize);
     return mMaterial;
 }
 
@@ -154,25 +155,10 @@ FMaterialInstance* PostProcessManager::PostProcessMaterial::getMaterialInstance(
 // ------------------------------------------------------------------------------------------------
 
 PostProcessManager::PostProcessManager(FEngine& engine) noexcept
-        : mEngine(engine),
-          mHaltonSamples{
-                  { filament::halton( 0, 2), filament::halton( 0, 3) },
-                  { filament::halton( 1, 2), filament::halton( 1, 3) },
-                  { filament::halton( 2, 2), filament::halton( 2, 3) },
-                  { filament::halton( 3, 2), filament::halton( 3, 3) },
-                  { filament::halton( 4, 2), filament::halton( 4, 3) },
-                  { filament::halton( 5, 2), filament::halton( 5, 3) },
-                  { filament::halton( 6, 2), filament::halton( 6, 3) },
-                  { filament::halton( 7, 2), filament::halton( 7, 3) },
-                  { filament::halton( 8, 2), filament::halton( 8, 3) },
-                  { filament::halton( 9, 2), filament::halton( 9, 3) },
-                  { filament::halton(10, 2), filament::halton(10, 3) },
-                  { filament::halton(11, 2), filament::halton(11, 3) },
-                  { filament::halton(12, 2), filament::halton(12, 3) },
-                  { filament::halton(13, 2), filament::halton(13, 3) },
-                  { filament::halton(14, 2), filament::halton(14, 3) },
-                  { filament::halton(15, 2), filament::halton(15, 3) }}
-{
+        : mEngine(engine) {
+    for (size_t i = 0; i < MAX_HALTON_SAMPLES; i++) {
+        mHaltonSamples[i] = { filament::halton(i, 2), filament::halton(i, 3) };
+    }
 }
 
 UTILS_NOINLINE
@@ -194,7 +180,17 @@ void PostProcessManager::init() noexcept {
 
     registerPostProcessMaterial("sao", MATERIAL(SAO));
     registerPostProcessMaterial("mipmapDepth", MATERIAL(MIPMAPDEPTH));
+    registerPostProcessMaterial("hiz", MATERIAL(HIZ));
+    registerPostProcessMaterial("ssr", MATERIAL(SSR));
+    registerPostProcessMaterial("autoExposureLuminance", MATERIAL(AUTOEXPOSURELUMINANCE));
+    registerPostProcessMaterial("autoExposureHistogram", MATERIAL(AUTOEXPOSUREHISTOGRAM));
+    registerPostProcessMaterial("autoExposure", MATERIAL(AUTOEXPOSURE));
+    registerPostProcessMaterial("autoExposureApply", MATERIAL(AUTOEXPOSUREAPPLY));
+    registerPostProcessMaterial("iblPrefilter", MATERIAL(IBLPREFILTER));
+    registerPostProcessMaterial("iblSH", MATERIAL(IBLSH));
+    registerPostProcessMaterial("oitComposite", MATERIAL(OITCOMPOSITE));
     registerPostProcessMaterial("vsmMipmap", MATERIAL(VSMMIPMAP));
+    registerPostProcessMaterial("vsmBlur", MATERIAL(VSMBLUR));
     registerPostProcessMaterial("bilateralBlur", MATERIAL(BILATERALBLUR));
     registerPostProcessMaterial("separableGaussianBlur", MATERIAL(SEPARABLEGAUSSIANBLUR));
     registerPostProcessMaterial("bloomDownsample", MATERIAL(BLOOMDOWNSAMPLE));
@@ -204,6 +200,7 @@ void PostProcessManager::init() noexcept {
     registerPostProcessMaterial("blitHigh", MATERIAL(BLITHIGH));
     registerPostProcessMaterial("colorGrading", MATERIAL(COLORGRADING));
     registerPostProcessMaterial("colorGradingAsSubpass", MATERIAL(COLORGRADINGASSUBPASS));
+    registerPostProcessMaterial("colorGradingFxaa", MATERIAL(COLORGRADINGFXAA));
     registerPostProcessMaterial("fxaa", MATERIAL(FXAA));
     registerPostProcessMaterial("taa", MATERIAL(TAA));
     registerPostProcessMaterial("dofDownsample", MATERIAL(DOFDOWNSAMPLE));
@@ -214,15 +211,6 @@ void PostProcessManager::init() noexcept {
     registerPostProcessMaterial("dofMedian", MATERIAL(DOFMEDIAN));
     registerPostProcessMaterial("dofCombine", MATERIAL(DOFCOMBINE));
 
-    // UBO storage size.
-    // The effective kernel size is (kMaxPositiveKernelSize - 1) * 4 + 1.
-    // e.g.: 5 positive-side samples, give 4+1+4=9 samples both sides
-    // taking advantage of linear filtering produces an effective kernel of 8+1+8=17 samples
-    // and because it's a separable filter, the effective 2D filter kernel size is 17*17
-    // The total number of samples needed over the two passes is 18.
-    auto& separableGaussianBlur = getPostProcessMaterial("separableGaussianBlur");
-    mSeparableGaussianBlurKernelStorageSize = separableGaussianBlur.getMaterial()->reflect("kernel")->size;
-
     mDummyOneTexture = driver.createTexture(SamplerType::SAMPLER_2D, 1,
             TextureFormat::RGBA8, 1, 1, 1, 1, TextureUsage::DEFAULT);
 
@@ -241,6 +229,8 @@ void PostProcessManager::init() noexcept {
     driver.update2DImage(mDummyOneTexture, 0, 0, 0, 1, 1, std::move(dataOne));
     driver.update3DImage(mDummyOneTextureArray, 0, 0, 0, 0, 1, 1, 1, std::move(dataOneArray));
     driver.update2DImage(mDummyZeroTexture, 0, 0, 0, 1, 1, std::move(dataZero));
+
+    mDownsampler.init(driver);
 }
 
 void PostProcessManager::terminate(DriverApi& driver) noexcept {
@@ -248,6 +238,7 @@ void PostProcessManager::terminate(DriverApi& driver) noexcept {
     driver.destroyTexture(mDummyOneTexture);
     driver.destroyTexture(mDummyOneTextureArray);
     driver.destroyTexture(mDummyZeroTexture);
+    mDownsampler.terminate(driver);
     auto first = mMaterialRegistry.begin();
     auto last = mMaterialRegistry.end();
     while (first != last) {
@@ -263,7 +254,7 @@ void PostProcessManager::commitAndRender(FrameGraphRenderTarget const& out,
     mi->commit(driver);
     mi->use(driver);
     driver.beginRenderPass(out.target, out.params);
-    driver.draw(material.getPipelineState(variant), mEngine.getFullScreenRenderPrimitive());
+    driver.draw(material.getPipelineState(variant), mEngine.getFullScreenRenderPrimitive(), 1);
     driver.endRenderPass();
 }
 
@@ -331,6 +322,105 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::structure(FrameGraph& fg,
     return depth;
 }
 
+PostProcessManager::HiZLayout PostProcessManager::getHiZLayout(
+        uint32_t width, uint32_t height) noexcept {
+    // the coarsest level covers 64 x 64 structure texels, which bounds the padding
+    constexpr uint8_t MAX_LEVEL_COUNT = 6;
+    const uint32_t w = (width  + 1u) / 2u;
+    const uint32_t h = (height + 1u) / 2u;
+    const uint8_t levels = std::min(MAX_LEVEL_COUNT, FTexture::maxLevelCount(w, h));
+    const uint32_t alignment = 1u << (levels - 1u);
+    return {
+            .width  = (w + alignment - 1u) & ~(alignment - 1u),
+            .height = (h + alignment - 1u) & ~(alignment - 1u),
+            .levels = levels };
+}
+
+FrameGraphId<FrameGraphTexture> PostProcessManager::hizPyramid(FrameGraph& fg,
+        OcclusionCuller* culler, CameraInfo const& cameraInfo) noexcept {
+
+    // the texels of this level cover the tiles of the OcclusionCuller
+    constexpr uint8_t OCCLUSION_LEVEL = 2;
+    static_assert(OcclusionCuller::TILE_SIZE == 2u << OCCLUSION_LEVEL,
+            "OcclusionCuller::TILE_SIZE must match a level of the hi-z pyramid");
+
+    struct HiZData {
+        FrameGraphId<FrameGraphTexture> in;
+        FrameGraphId<FrameGraphTexture> out;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    Blackboard& blackboard = fg.getBlackboard();
+    FrameGraphId<FrameGraphTexture> depth = blackboard.get<FrameGraphTexture>("structure");
+    assert(depth.isValid());
+
+    auto const& desc = fg.getDescriptor(depth);
+    const HiZLayout layout = getHiZLayout(desc.width, desc.height);
+    assert(layout.levels > OCCLUSION_LEVEL);
+
+    // the readback leaves out the padding of the pyramid, and uses the camera the structure pass
+    // was rendered with (jittered only when the structure pass is the depth prepass)
+    const uint32_t readbackWidth =
+            (desc.width  + OcclusionCuller::TILE_SIZE - 1) / OcclusionCuller::TILE_SIZE;
+    const uint32_t readbackHeight =
+            (desc.height + OcclusionCuller::TILE_SIZE - 1) / OcclusionCuller::TILE_SIZE;
+    const mat4f clipFromWorld = cameraInfo.projection * cameraInfo.view * cameraInfo.worldOrigin;
+    const float3 cameraPosition = cameraInfo.worldOffset;
+
+    // level 0 reduces the structure buffer, the following levels reduce the previous one
+    FrameGraphId<FrameGraphTexture> hiz;
+    for (uint8_t level = 0; level < layout.levels; level++) {
+        const bool readback = culler && level == OCCLUSION_LEVEL;
+        auto& hizPass = fg.addPass<HiZData>("Hi-Z Pass",
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    if (level == 0) {
+                        data.in = builder.sample(depth);
+                        data.out = builder.createTexture("Hi-Z Buffer", {
+                                .width = layout.width, .height = layout.height,
+                                .levels = layout.levels,
+                                .format = TextureFormat::RG32F });
+                    } else {
+                        data.in = builder.sample(hiz);
+                        data.out = data.in;
+                    }
+                    data.out = builder.write(data.out);
+                    data.rt = builder.createRenderTarget("Hi-Z Target", {
+                            .attachments = {{ data.out, level }} });
+                    if (readback) {
+                        // the readback is an output outside of the graph
+                        builder.sideEffect();
+                    }
+                },
+                [=](FrameGraphPassResources const& resources,
+                        auto const& data, DriverApi& driver) {
+                    auto in = resources.getTexture(data.in);
+                    auto out = resources.get(data.rt);
+
+                    auto& material = getPostProcessMaterial("hiz");
+                    FMaterialInstance* const mi = material.getMaterialInstance();
+                    mi->setParameter("depth", in, {
+                            .filterMin = SamplerMinFilter::NEAREST_MIPMAP_NEAREST });
+                    mi->setParameter("level", int32_t(level ? level - 1 : 0));
+                    mi->setParameter("structure", level == 0);
+
+                    commitAndRender(out, material, driver);
+
+                    if (readback) {
+                        PixelBufferDescriptor buffer = culler->acquire(
+                                readbackWidth, readbackHeight, clipFromWorld, cameraPosition);
+                        if (buffer.buffer) {
+                            driver.readPixels(out.target, 0, 0, readbackWidth, readbackHeight,
+                                    std::move(buffer));
+                        }
+                    }
+                });
+        hiz = hizPass.getData().out;
+    }
+
+    blackboard["hiz"] = hiz;
+    return hiz;
+}
+
 FrameGraphId<FrameGraphTexture> PostProcessManager::mipmapPass(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> input, size_t level) noexcept {
 
@@ -368,7 +458,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::mipmapPass(FrameGraph& fg,
 FrameGraphId<FrameGraphTexture> PostProcessManager::screenSpaceAmbientOcclusion(
         FrameGraph& fg, RenderPass& pass,
         filament::Viewport const& svp, const CameraInfo& cameraInfo,
-        View::AmbientOcclusionOptions options) noexcept {
+        View::AmbientOcclusionOptions options, uint32_t temporalIndex) noexcept {
 
     FEngine& engine = mEngine;
     Handle<HwRenderPrimitive> fullScreenRenderPrimitive = engine.getFullScreenRenderPrimitive();
@@ -410,6 +500,13 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::screenSpaceAmbientOcclusion(
             break;
     }
 
+    // With TAA, the spiral is twisted differently each frame (the fractional part of the turns
+    // follows the golden ratio sequence), so that TAA accumulates different samples over time.
+    if (temporalIndex) {
+        const float twist = float(temporalIndex) * 0.618034f;
+        spiralTurns += twist - std::floor(twist);
+    }
+
     switch (options.lowPassFilter) {
         default:
         case View::QualityLevel::LOW:
@@ -547,7 +644,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::screenSpaceAmbientOcclusion(
                 pipeline.rasterState.depthFunc = RasterState::DepthFunc::L;
 
                 driver.beginRenderPass(ssao.target, ssao.params);
-                driver.draw(pipeline, fullScreenRenderPrimitive);
+                driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                 driver.endRenderPass();
             });
 
@@ -647,13 +744,311 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::bilateralBlurPass(
                 pipeline.rasterState.depthFunc = RasterState::DepthFunc::L;
 
                 driver.beginRenderPass(blurred.target, blurred.params);
-                driver.draw(pipeline, fullScreenRenderPrimitive);
+                driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                 driver.endRenderPass();
             });
 
     return blurPass.getData().blurred;
 }
 
+FrameGraphId<FrameGraphTexture> PostProcessManager::screenSpaceReflections(FrameGraph& fg,
+        FrameHistory const& frameHistory, CameraInfo const& cameraInfo,
+        View::ScreenSpaceReflectionsOptions const& options) noexcept {
+
+    // the rays are traced into the previous frame, there is nothing to reflect without it
+    FrameHistoryEntry const& entry = frameHistory[0];
+    if (UTILS_UNLIKELY(!entry.ssr.texture)) {
+        return {};
+    }
+
+    Blackboard& blackboard = fg.getBlackboard();
+    FrameGraphId<FrameGraphTexture> depth = blackboard.get<FrameGraphTexture>("structure");
+    FrameGraphId<FrameGraphTexture> hiz = blackboard.get<FrameGraphTexture>("hiz");
+    assert(depth.isValid() && hiz.isValid());
+
+    FrameGraphId<FrameGraphTexture> history = fg.import("SSR history", entry.ssrDesc, entry.ssr);
+
+    struct SSRData {
+        FrameGraphId<FrameGraphTexture> hiz;
+        FrameGraphId<FrameGraphTexture> history;
+        FrameGraphId<FrameGraphTexture> reflections;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // maps the texture coordinates and the depth buffer values to clip-space, see taa()
+    constexpr mat4f clipFromScreen = {
+            float4{  2,  0,  0, 0 },
+            float4{  0,  2,  0, 0 },
+            float4{  0,  0, -2, 0 },
+            float4{ -1, -1,  1, 1 },
+    };
+    const mat4f screenFromClip = inverse(clipFromScreen);
+    const mat4f screenFromView = screenFromClip * cameraInfo.projection;
+    const mat4f clipFromWorld = cameraInfo.projection * cameraInfo.view * cameraInfo.worldOrigin;
+    const mat4f reprojection =
+            screenFromClip * entry.ssrProjection * inverse(clipFromWorld) * clipFromScreen;
+
+    auto const& structureDesc = fg.getDescriptor(depth);
+    const uint8_t levelCount = fg.getDescriptor(hiz).levels;
+
+    auto& ssrPass = fg.addPass<SSRData>("SSR Pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.hiz = builder.sample(hiz);
+                data.history = builder.sample(history);
+                // at the resolution of the level 0 of the hi-z pyramid, without its padding
+                data.reflections = builder.createTexture("Reflections Buffer", {
+                        .width  = (structureDesc.width  + 1u) / 2u,
+                        .height = (structureDesc.height + 1u) / 2u,
+                        .format = TextureFormat::RGBA16F });
+                data.reflections = builder.write(data.reflections);
+                data.rt = builder.createRenderTarget("Reflections Target", {
+                        .attachments = { data.reflections } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                auto hiz = resources.getTexture(data.hiz);
+                auto history = resources.getTexture(data.history);
+                auto out = resources.get(data.rt);
+
+                auto& material = getPostProcessMaterial("ssr");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+                mi->setParameter("hiz", hiz, {
+                        .filterMin = SamplerMinFilter::NEAREST_MIPMAP_NEAREST });
+                mi->setParameter("history", history, {
+                        .filterMag = SamplerMagFilter::LINEAR,
+                        .filterMin = SamplerMinFilter::LINEAR });
+                mi->setParameter("screenFromView", screenFromView);
+                mi->setParameter("viewFromScreen", inverse(screenFromView));
+                mi->setParameter("reprojection", reprojection);
+                mi->setParameter("size",
+                        float2{ structureDesc.width, structureDesc.height } * 0.5f);
+                mi->setParameter("maxLevel", int32_t(levelCount - 1));
+                mi->setParameter("near", cameraInfo.zn);
+                mi->setParameter("thickness", options.thickness);
+                mi->setParameter("bias", options.bias);
+                mi->setParameter("maxDistance", options.maxDistance);
+
+                commitAndRender(out, material, driver);
+            });
+
+    auto reflections = ssrPass.getData().reflections;
+    blackboard["reflections"] = reflections;
+    return reflections;
+}
+
+void PostProcessManager::screenSpaceReflectionsHistory(FrameGraph& fg,
+        FrameGraphId<FrameGraphTexture> input, FrameHistory& frameHistory,
+        mat4f const& clipFromWorld) noexcept {
+
+    struct SSRHistoryData {
+        FrameGraphId<FrameGraphTexture> history;
+    };
+
+    // the reflections are at half resolution, the color they sample doesn't need more
+    auto const& desc = fg.getDescriptor(input);
+    FrameGraphId<FrameGraphTexture> history = opaqueBlit(fg, input, {
+            .width  = std::max(1u, desc.width  / 2u),
+            .height = std::max(1u, desc.height / 2u),
+            .format = TextureFormat::R11F_G11F_B10F });
+
+    fg.addPass<SSRHistoryData>("SSR History",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.history = builder.sample(history);
+                // the history is an output outside of the graph
+                builder.sideEffect();
+            },
+            [&frameHistory](FrameGraphPassResources const& resources,
+                    auto const& data, DriverApi&) {
+                FrameHistoryEntry& current = frameHistory.getCurrent();
+                resources.detach(data.history, &current.ssr, &current.ssrDesc);
+            });
+
+    frameHistory.getCurrent().ssrProjection = clipFromWorld;
+}
+
+FrameGraphId<FrameGraphTexture> PostProcessManager::autoExposure(FrameGraph& fg,
+        FrameGraphId<FrameGraphTexture> input, FrameHistory& frameHistory,
+        View::AutoExposureOptions const& options, double time) noexcept {
+
+    // The luminance is measured at a fixed resolution. The histogram is built in slices of rows,
+    // which the exposure pass sums, so that no pass loops over the whole metering image.
+    constexpr uint32_t kMeteringSize = 64;
+    constexpr uint32_t kBinCount = 64;
+    constexpr uint32_t kSliceCount = 8;
+    constexpr uint32_t kRowsPerSlice = kMeteringSize / kSliceCount;
+    constexpr float kPixelCount = float(kMeteringSize * kMeteringSize);
+
+    // The histogram covers the luminances whose compensation isn't clamped, the others are
+    // counted in its first and last bins.
+    const float logKey = std::log2(options.key);
+    const float logRange = std::max(options.maxCompensation - options.minCompensation, 0.01f);
+    const float minLog = logKey - options.maxCompensation;
+
+    // at least one pixel is between the percentiles
+    const float lowCount = std::min(options.lowPercentile * kPixelCount, kPixelCount - 1.0f);
+    const float highCount = std::max(options.highPercentile * kPixelCount, lowCount + 1.0f);
+
+    // the first frame starts at the measured luminance
+    FrameHistoryEntry const& previous = frameHistory[0];
+    FrameGraphId<FrameGraphTexture> history;
+    float2 adaptation{ 1.0f };
+    if (previous.exposure.texture) {
+        history = fg.import("Exposure history", previous.exposureDesc, previous.exposure);
+        const float dt = float(std::max(0.0, time - previous.exposureTime));
+        adaptation = {
+                1.0f - std::exp(-dt * options.speedUp),
+                1.0f - std::exp(-dt * options.speedDown) };
+    }
+    frameHistory.getCurrent().exposureTime = time;
+
+    struct LuminanceData {
+        FrameGraphId<FrameGraphTexture> input;
+        FrameGraphId<FrameGraphTexture> luminance;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& luminancePass = fg.addPass<LuminanceData>("Auto Exposure Luminance",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.input = builder.sample(input);
+                data.luminance = builder.createTexture("Luminance Buffer", {
+                        .width = kMeteringSize,
+                        .height = kMeteringSize,
+                        .format = TextureFormat::R16F });
+                data.luminance = builder.write(data.luminance);
+                data.rt = builder.createRenderTarget("Luminance Target", {
+                        .attachments = { data.luminance } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                auto const& material = getPostProcessMaterial("autoExposureLuminance");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+                mi->setParameter("color", resources.getTexture(data.input), {
+                        .filterMag = SamplerMagFilter::LINEAR,
+                        .filterMin = SamplerMinFilter::LINEAR });
+                mi->setParameter("texelSize", float2{ 1.0f / float(kMeteringSize) });
+                commitAndRender(resources.get(data.rt), material, driver);
+            });
+
+    struct HistogramData {
+        FrameGraphId<FrameGraphTexture> luminance;
+        FrameGraphId<FrameGraphTexture> histogram;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& histogramPass = fg.addPass<HistogramData>("Auto Exposure Histogram",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.luminance = builder.sample(luminancePass.getData().luminance);
+                // the counts are integers of at most kRowsPerSlice * kMeteringSize, exact in fp16
+                data.histogram = builder.createTexture("Histogram Buffer", {
+                        .width = kBinCount,
+                        .height = kSliceCount,
+                        .format = TextureFormat::R16F });
+                data.histogram = builder.write(data.histogram);
+                data.rt = builder.createRenderTarget("Histogram Target", {
+                        .attachments = { data.histogram } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                auto const& material = getPostProcessMaterial("autoExposureHistogram");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+                mi->setParameter("luminance", resources.getTexture(data.luminance), {});
+                mi->setParameter("range", float2{ minLog, float(kBinCount) / logRange });
+                mi->setParameter("bins", int32_t(kBinCount));
+                mi->setParameter("rows", int32_t(kRowsPerSlice));
+                commitAndRender(resources.get(data.rt), material, driver);
+            });
+
+    struct ExposureData {
+        FrameGraphId<FrameGraphTexture> histogram;
+        FrameGraphId<FrameGraphTexture> history;
+        FrameGraphId<FrameGraphTexture> exposure;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& exposurePass = fg.addPass<ExposureData>("Auto Exposure",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.histogram = builder.sample(histogramPass.getData().histogram);
+                if (history.isValid()) {
+                    data.history = builder.sample(history);
+                }
+                data.exposure = builder.createTexture("Exposure Buffer", {
+                        .width = 1,
+                        .height = 1,
+                        .format = TextureFormat::RG16F });
+                data.exposure = builder.write(data.exposure);
+                data.rt = builder.createRenderTarget("Exposure Target", {
+                        .attachments = { data.exposure } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                // without history, the adaptation ignores the previous value
+                Handle<HwTexture> history = data.history.isValid() ?
+                        resources.getTexture(data.history) : getZeroTexture();
+
+                auto const& material = getPostProcessMaterial("autoExposure");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+                mi->setParameter("histogram", resources.getTexture(data.histogram), {});
+                mi->setParameter("history", history, {});
+                mi->setParameter("range", float4{
+                        minLog, logRange / float(kBinCount), lowCount, highCount });
+                mi->setParameter("compensation", float3{
+                        logKey, options.minCompensation, options.maxCompensation });
+                mi->setParameter("adaptation", adaptation);
+                commitAndRender(resources.get(data.rt), material, driver);
+            });
+
+    FrameGraphId<FrameGraphTexture> exposure = exposurePass.getData().exposure;
+
+    struct ExposureHistoryData {
+        FrameGraphId<FrameGraphTexture> exposure;
+    };
+
+    fg.addPass<ExposureHistoryData>("Auto Exposure History",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.exposure = builder.sample(exposure);
+                // the history is an output outside of the graph
+                builder.sideEffect();
+            },
+            [&frameHistory](FrameGraphPassResources const& resources,
+                    auto const& data, DriverApi&) {
+                FrameHistoryEntry& current = frameHistory.getCurrent();
+                resources.detach(data.exposure, &current.exposure, &current.exposureDesc);
+            });
+
+    struct ApplyData {
+        FrameGraphId<FrameGraphTexture> exposure;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& applyPass = fg.addPass<ApplyData>("Auto Exposure Apply",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.exposure = builder.sample(exposure);
+                data.output = builder.write(builder.read(input));
+                data.rt = builder.createRenderTarget("Auto Exposure Target", {
+                        .attachments = { data.output } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                auto out = resources.get(data.rt);
+                out.params.flags.discardStart = TargetBufferFlags::NONE; // because we'll blend
+
+                auto const& material = getPostProcessMaterial("autoExposureApply");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+                mi->setParameter("exposure", resources.getTexture(data.exposure), {});
+                mi->commit(driver);
+                mi->use(driver);
+
+                // the color buffer is multiplied by the compensation, its alpha is preserved
+                PipelineState pipeline(material.getPipelineState());
+                pipeline.rasterState.blendFunctionSrcRGB   = BlendFunction::ZERO;
+                pipeline.rasterState.blendFunctionSrcAlpha = BlendFunction::ZERO;
+                pipeline.rasterState.blendFunctionDstRGB   = BlendFunction::SRC_COLOR;
+                pipeline.rasterState.blendFunctionDstAlpha = BlendFunction::ONE;
+
+                driver.beginRenderPass(out.target, out.params);
+                driver.draw(pipeline, mEngine.getFullScreenRenderPrimitive(), 1);
+                driver.endRenderPass();
+            });
+
+    return applyPass.getData().output;
+}
+
 FrameGraphId<FrameGraphTexture> PostProcessManager::generateGaussianMipmap(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> input, size_t roughnessLodCount,
         bool reinhard, size_t kernelWidth, float sigmaRatio) noexcept {
@@ -664,6 +1059,44 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::generateGaussianMipmap(Frame
     return input;
 }
 
+// Computes the positive side of a normalized Gaussian kernel, with two texels per sample to take
+// advantage of linear filtering. Returns the number of samples stored in 'kernel'.
+static size_t computeGaussianCoefficients(float2* kernel, size_t size,
+        size_t kernelWidth, float sigma) noexcept {
+    const float alpha = 1.0f / (2.0f * sigma * sigma);
+
+    // number of positive-side samples needed, using linear sampling
+    size_t m = (kernelWidth - 1) / 4 + 1;
+    // clamp to what we have
+    m = std::min(size, m);
+
+    // How the kernel samples are stored:
+    //  *===*---+---+---+---+---+---+
+    //  | 0 | 1 | 2 | 3 | 4 | 5 | 6 |       Gaussian coefficients (right size)
+    //  *===*-------+-------+-------+
+    //  | 0 |   1   |   2   |   3   |       stored coefficients (right side)
+
+    kernel[0].x = 1.0;
+    kernel[0].y = 0.0;
+    float totalWeight = kernel[0].x;
+
+    for (size_t i = 1; i < m; i++) {
+        float x0 = i * 2 - 1;
+        float x1 = i * 2;
+        float k0 = std::exp(-alpha * x0 * x0);
+        float k1 = std::exp(-alpha * x1 * x1);
+        float k = k0 + k1;
+        float o = k0 / k;
+        kernel[i].x = k;
+        kernel[i].y = o;
+        totalWeight += (k0 + k1) * 2.0f;
+    }
+    for (size_t i = 0; i < m; i++) {
+        kernel[i].x *= 1.0f / totalWeight;
+    }
+    return m;
+}
+
 FrameGraphId<FrameGraphTexture> PostProcessManager::gaussianBlurPass(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> input, uint8_t srcLevel,
         FrameGraphId<FrameGraphTexture> output, uint8_t dstLevel,
@@ -673,41 +1106,6 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::gaussianBlurPass(FrameGraph&
 
     Handle<HwRenderPrimitive> fullScreenRenderPrimitive = mEngine.getFullScreenRenderPrimitive();
 
-    auto computeGaussianCoefficients = [kernelWidth, sigma](float2* kernel, size_t size) -> size_t {
-        const float alpha = 1.0f / (2.0f * sigma * sigma);
-
-        // number of positive-side samples needed, using linear sampling
-        size_t m = (kernelWidth - 1) / 4 + 1;
-        // clamp to what we have
-        m = std::min(size, m);
-
-        // How the kernel samples are stored:
-        //  *===*---+---+---+---+---+---+
-        //  | 0 | 1 | 2 | 3 | 4 | 5 | 6 |       Gaussian coefficients (right size)
-        //  *===*-------+-------+-------+
-        //  | 0 |   1   |   2   |   3   |       stored coefficients (right side)
-
-        kernel[0].x = 1.0;
-        kernel[0].y = 0.0;
-        float totalWeight = kernel[0].x;
-
-        for (size_t i = 1; i < m; i++) {
-            float x0 = i * 2 - 1;
-            float x1 = i * 2;
-            float k0 = std::exp(-alpha * x0 * x0);
-            float k1 = std::exp(-alpha * x1 * x1);
-            float k = k0 + k1;
-            float o = k0 / k;
-            kernel[i].x = k;
-            kernel[i].y = o;
-            totalWeight += (k0 + k1) * 2.0f;
-        }
-        for (size_t i = 0; i < m; i++) {
-            kernel[i].x *= 1.0f / totalWeight;
-        }
-        return m;
-    };
-
     struct BlurPassData {
         FrameGraphId<FrameGraphTexture> in;
         FrameGraphId<FrameGraphTexture> out;
@@ -716,6 +1114,18 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::gaussianBlurPass(FrameGraph&
         FrameGraphRenderTargetHandle tempRT;
     };
 
+    // UBO storage size.
+    // The effective kernel size is (kMaxPositiveKernelSize - 1) * 4 + 1.
+    // e.g.: 5 positive-side samples, give 4+1+4=9 samples both sides
+    // taking advantage of linear filtering produces an effective kernel of 8+1+8=17 samples
+    // and because it's a separable filter, the effective 2D filter kernel size is 17*17
+    // The total number of samples needed over the two passes is 18.
+    // This is only known once the material is loaded, which we defer to its first use.
+    if (UTILS_UNLIKELY(!mSeparableGaussianBlurKernelStorageSize)) {
+        auto& separableGaussianBlur = getPostProcessMaterial("separableGaussianBlur");
+        mSeparableGaussianBlurKernelStorageSize =
+                separableGaussianBlur.getMaterial()->reflect("kernel")->size;
+    }
     const size_t kernelStorageSize = mSeparableGaussianBlurKernelStorageSize;
     auto& gaussianBlurPasses = fg.addPass<BlurPassData>("Gaussian Blur Passes",
             [&](FrameGraph::Builder& builder, auto& data) {
@@ -753,7 +1163,8 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::gaussianBlurPass(FrameGraph&
 
                 float2 kernel[64];
                 size_t m = computeGaussianCoefficients(kernel,
-                        std::min(sizeof(kernel) / sizeof(*kernel), kernelStorageSize));
+                        std::min(sizeof(kernel) / sizeof(*kernel), kernelStorageSize),
+                        kernelWidth, sigma);
 
                 // horizontal pass
                 auto hwTempRT = resources.get(data.tempRT);
@@ -801,7 +1212,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::gaussianBlurPass(FrameGraph&
                 // we don't need to call use() here, since it's the same material
 
                 driver.beginRenderPass(hwOutRT.target, hwOutRT.params);
-                driver.draw(separableGaussianBlur.getPipelineState(), fullScreenRenderPrimitive);
+                driver.draw(separableGaussianBlur.getPipelineState(), fullScreenRenderPrimitive, 1);
                 driver.endRenderPass();
             });
 
@@ -981,7 +1392,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::dof(FrameGraph& fg,
                     mi->setParameter("weightScale", 0.5f / float(1u<<level));
                     mi->commit(driver);
                     driver.beginRenderPass(out.target, out.params);
-                    driver.draw(pipeline, fullScreenRenderPrimitive);
+                    driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                     driver.endRenderPass();
                 }
             });
@@ -1335,15 +1746,26 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::bloomPass(FrameGraph& fg,
             [=](FrameGraphPassResources const& resources,
                     auto const& data, DriverApi& driver) {
 
+                auto hwIn = resources.getTexture(data.in);
+                auto hwOut = resources.getTexture(data.out);
+                auto const& outDesc = resources.getDescriptor(data.out);
+
+                if (mDownsampler.isSupported(outFormat, bloomOptions.levels)) {
+                    // all the levels in one dispatch, the render targets are left unused
+                    driver.setMinMaxLevels(hwIn, 0, 0);
+                    mDownsampler.downsample(driver, hwIn, hwOut,
+                            outDesc.width, outDesc.height, bloomOptions.levels, {
+                                    .threshold = bloomOptions.threshold,
+                                    .invHighlight = std::isinf(bloomOptions.highlight) ?
+                                            0.0f : 1.0f / bloomOptions.highlight });
+                    return;
+                }
+
                 auto const& material = getPostProcessMaterial("bloomDownsample");
                 FMaterialInstance* mi = material.getMaterialInstance();
 
                 const PipelineState pipeline(material.getPipelineState());
 
-                auto hwIn = resources.getTexture(data.in);
-                auto hwOut = resources.getTexture(data.out);
-                auto const& outDesc = resources.getDescriptor(data.out);
-
                 mi->use(driver);
                 mi->setParameter("source", hwIn,  {
                         .filterMag = SamplerMagFilter::LINEAR,
@@ -1365,7 +1787,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::bloomPass(FrameGraph& fg,
                     hwOutRT.params.flags.discardStart = TargetBufferFlags::COLOR;
                     hwOutRT.params.flags.discardEnd = TargetBufferFlags::NONE;
                     driver.beginRenderPass(hwOutRT.target, hwOutRT.params);
-                    driver.draw(pipeline, fullScreenRenderPrimitive);
+                    driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                     driver.endRenderPass();
 
                     // prepare the next level
@@ -1422,7 +1844,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::bloomPass(FrameGraph& fg,
                     mi->commit(driver);
 
                     driver.beginRenderPass(hwDstRT.target, hwDstRT.params);
-                    driver.draw(pipeline, fullScreenRenderPrimitive);
+                    driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                     driver.endRenderPass();
                 }
 
@@ -1539,7 +1961,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::bloomPassPingPong(FrameGraph
                     hwDstRT.params.flags.discardStart = TargetBufferFlags::COLOR;
                     hwDstRT.params.flags.discardEnd = TargetBufferFlags::NONE;
                     driver.beginRenderPass(hwDstRT.target, hwDstRT.params);
-                    driver.draw(pipeline, fullScreenRenderPrimitive);
+                    driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                     driver.endRenderPass();
 
                     // prepare the next level
@@ -1599,7 +2021,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::bloomPassPingPong(FrameGraph
                     mi->commit(driver);
 
                     driver.beginRenderPass(hwDstRT.target, hwDstRT.params);
-                    driver.draw(pipeline, fullScreenRenderPrimitive);
+                    driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                     driver.endRenderPass();
                 }
 
@@ -1680,13 +2102,13 @@ void PostProcessManager::colorGradingSubpass(DriverApi& driver,  bool translucen
             PostProcessVariant::TRANSLUCENT : PostProcessVariant::OPAQUE);
 
     driver.nextSubpass();
-    driver.draw(material.getPipelineState(variant), fullScreenRenderPrimitive);
+    driver.draw(material.getPipelineState(variant), fullScreenRenderPrimitive, 1);
 }
 
 FrameGraphId<FrameGraphTexture> PostProcessManager::colorGrading(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> input, const FColorGrading* colorGrading,
-        TextureFormat outFormat, bool translucent, bool fxaa, float2 scale,
-        View::BloomOptions bloomOptions, View::VignetteOptions vignetteOptions, bool dithering) noexcept {
+        ColorGradingConfig const& colorGradingConfig, float2 scale,
+        View::BloomOptions bloomOptions, View::VignetteOptions vignetteOptions) noexcept {
 
     struct PostProcessColorGrading {
         FrameGraphId<FrameGraphTexture> input;
@@ -1719,11 +2141,13 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::colorGrading(FrameGraph& fg,
     auto& ppColorGrading = fg.addPass<PostProcessColorGrading>("colorGrading",
             [&](FrameGraph::Builder& builder, auto& data) {
                 auto const& inputDesc = fg.getDescriptor(input);
-                data.input = builder.sample(input);
+                // color grading as a subpass doesn't support bloom
+                data.input = (colorGradingConfig.asSubpass && !bloomBlur.isValid()) ?
+                        builder.sampleAtPixel(input) : builder.sample(input);
                 data.output = builder.createTexture("colorGrading output", {
                         .width = inputDesc.width,
                         .height = inputDesc.height,
-                        .format = outFormat
+                        .format = colorGradingConfig.ldrFormat
                 });
                 data.output = builder.write(data.output);
                 data.rt = builder.createRenderTarget("colorGrading Target", {
@@ -1737,6 +2161,14 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::colorGrading(FrameGraph& fg,
                 }
             },
             [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                if (resources.isSubpass()) {
+                    // we're running in the render pass writing our input, with the material
+                    // set up by colorGradingPrepareSubpass()
+                    colorGradingSubpass(driver, colorGradingConfig.translucent);
+                    driver.endRenderPass();
+                    return;
+                }
+
                 Handle<HwTexture> colorTexture = resources.getTexture(data.input);
 
                 Handle<HwTexture> bloomTexture =
@@ -1747,13 +2179,25 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::colorGrading(FrameGraph& fg,
 
                 auto const& out = resources.get(data.rt);
 
-                auto const& material = getPostProcessMaterial("colorGrading");
+                // FXAA is applied in the same pass, on the graded colors of the neighbors
+                const bool fusedFxaa = colorGradingConfig.fxaa && !colorGradingConfig.asSubpass;
+
+                auto const& material = fusedFxaa ?
+                        getPostProcessMaterial("colorGradingFxaa") :
+                        getPostProcessMaterial("colorGrading");
                 FMaterialInstance* mi = material.getMaterialInstance();
                 mi->setParameter("lut", colorGrading->getHwHandle(), {
                         .filterMag = SamplerMagFilter::LINEAR,
                         .filterMin = SamplerMinFilter::LINEAR
                 });
-                mi->setParameter("colorBuffer", colorTexture, { /* shader uses texelFetch */ });
+                if (fusedFxaa) {
+                    mi->setParameter("colorBuffer", colorTexture, {
+                            .filterMag = SamplerMagFilter::LINEAR,
+                            .filterMin = SamplerMinFilter::LINEAR
+                    });
+                } else {
+                    mi->setParameter("colorBuffer", colorTexture, { /* uses texelFetch */ });
+                }
                 mi->setParameter("bloomBuffer", bloomTexture, {
                         .filterMag = SamplerMagFilter::LINEAR,
                         .filterMin = SamplerMinFilter::LINEAR /* always read base level in shader */
@@ -1780,14 +2224,16 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::colorGrading(FrameGraph& fg,
 
                 const float temporalNoise = mUniformDistribution(mEngine.getRandomEngine());
 
-                mi->setParameter("dithering", dithering);
+                mi->setParameter("dithering", colorGradingConfig.dithering);
                 mi->setParameter("bloom", bloomParameters);
                 mi->setParameter("vignette", vignetteParameters);
                 mi->setParameter("vignetteColor", vignetteOptions.color);
-                mi->setParameter("fxaa", fxaa);
+                if (!fusedFxaa) {
+                    mi->setParameter("fxaa", colorGradingConfig.fxaa);
+                }
                 mi->setParameter("temporalNoise", temporalNoise);
 
-                const uint8_t variant = uint8_t(translucent ?
+                const uint8_t variant = uint8_t(colorGradingConfig.translucent ?
                             PostProcessVariant::TRANSLUCENT : PostProcessVariant::OPAQUE);
 
                 commitAndRender(out, material, variant, driver);
@@ -1843,11 +2289,21 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::fxaa(FrameGraph& fg,
 
 void PostProcessManager::prepareTaa(FrameHistory& frameHistory,
         CameraInfo const& cameraInfo,
-        View::TemporalAntiAliasingOptions const& taaOptions) const noexcept {
+        View::TemporalAntiAliasingOptions const& taaOptions,
+        float2 scale) const noexcept {
     auto const& previous = frameHistory[0];
     auto& current = frameHistory.getCurrent();
+    // When upscaling, a pixel covers 1 / (scale.x * scale.y) output pixels, each of which
+    // needs about as many samples as without upscaling.
+    size_t sampleCount = 16;
+    if (taaOptions.upscaling) {
+        const float pixels = 1.0f / (scale.x * scale.y);
+        while (sampleCount < MAX_HALTON_SAMPLES && float(sampleCount) < 16.0f * pixels) {
+            sampleCount *= 2;
+        }
+    }
     // get sample position within a pixel [-0.5, 0.5]
-    const float2 jitter = halton(previous.frameId) - 0.5f;
+    const float2 jitter = halton(previous.frameId, sampleCount) - 0.5f;
     // compute the world-space to clip-space matrix for this frame
     current.projection = cameraInfo.projection * (cameraInfo.view * cameraInfo.worldOrigin);
     // save this frame's sample position
@@ -1859,7 +2315,8 @@ void PostProcessManager::prepareTaa(FrameHistory& frameHistory,
 FrameGraphId<FrameGraphTexture> PostProcessManager::taa(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> input, FrameHistory& frameHistory,
         View::TemporalAntiAliasingOptions taaOptions,
-        ColorGradingConfig colorGradingConfig) noexcept {
+        ColorGradingConfig colorGradingConfig,
+        uint32_t width, uint32_t height) noexcept {
 
     FrameHistoryEntry const& entry = frameHistory[0];
     FrameGraphId<FrameGraphTexture> colorHistory;
@@ -1885,9 +2342,20 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::taa(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> tonemappedOutput;
         FrameGraphRenderTargetHandle rt;
     };
+    const auto inputDesc = fg.getDescriptor(input);
+    const bool upscaling = taaOptions.upscaling &&
+            (width != inputDesc.width || height != inputDesc.height);
+    if (upscaling) {
+        // Each output pixel receives a new sample only every 1 / (scale.x * scale.y) frames on
+        // average, so the history is given proportionally more weight.
+        taaOptions.feedback *= float(inputDesc.width * inputDesc.height) / float(width * height);
+    }
+
     auto& taa = fg.addPass<TAAData>("TAA",
             [&](FrameGraph::Builder& builder, auto& data) {
-                auto desc = fg.getDescriptor(input);
+                auto desc = inputDesc;
+                desc.width = width;
+                desc.height = height;
                 data.color = builder.sample(input);
                 data.depth = builder.sample(depth);
                 data.history = builder.sample(colorHistory);
@@ -1948,7 +2416,10 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::taa(FrameGraph& fg,
 
                 auto const& material = getPostProcessMaterial("taa");
                 FMaterialInstance* mi = material.getMaterialInstance();
-                mi->setParameter("color",  color, {});  // nearest
+                // the color buffer is filtered when it's smaller than the output
+                mi->setParameter("color",  color, {
+                        .filterMag = upscaling ? SamplerMagFilter::LINEAR : SamplerMagFilter::NEAREST
+                });
                 mi->setParameter("depth",  depth, {});  // nearest
                 mi->setParameter("alpha", taaOptions.feedback);
                 mi->setParameter("history", history, {
@@ -1971,7 +2442,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::taa(FrameGraph& fg,
                     out.params.subpassMask = 1;
                 }
                 driver.beginRenderPass(out.target, out.params);
-                driver.draw(material.getPipelineState(variant), mEngine.getFullScreenRenderPrimitive());
+                driver.draw(material.getPipelineState(variant), mEngine.getFullScreenRenderPrimitive(), 1);
                 if (colorGradingConfig.asSubpass) {
                     colorGradingSubpass(driver, colorGradingConfig.translucent);
                 }
@@ -2084,7 +2555,7 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::blendBlit(
                     pipeline.rasterState.blendFunctionDstAlpha = BlendFunction::ONE_MINUS_SRC_ALPHA;
                 }
                 driver.beginRenderPass(out.target, out.params);
-                driver.draw(pipeline, fullScreenRenderPrimitive);
+                driver.draw(pipeline, fullScreenRenderPrimitive, 1);
                 driver.endRenderPass();
             });
 
@@ -2140,6 +2611,53 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::resolve(FrameGraph& fg,
     return ppResolve.getData().output;
 }
 
+FrameGraphId<FrameGraphTexture> PostProcessManager::orderIndependentTransparencyComposite(
+        FrameGraph& fg, FrameGraphId<FrameGraphTexture> input,
+        FrameGraphId<FrameGraphTexture> accumulation,
+        FrameGraphId<FrameGraphTexture> weight) noexcept {
+
+    struct CompositeData {
+        FrameGraphId<FrameGraphTexture> accumulation;
+        FrameGraphId<FrameGraphTexture> weight;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& ppComposite = fg.addPass<CompositeData>("OIT Composite",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.accumulation = builder.sample(accumulation);
+                data.weight = builder.sample(weight);
+                data.output = builder.write(builder.read(input));
+                data.rt = builder.createRenderTarget("OIT Composite Target", {
+                        .attachments = { data.output } });
+            },
+            [=](FrameGraphPassResources const& resources,
+                    auto const& data, DriverApi& driver) {
+                auto out = resources.get(data.rt);
+                out.params.flags.discardStart = TargetBufferFlags::NONE; // because we'll blend
+
+                auto const& material = getPostProcessMaterial("oitComposite");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+                mi->setParameter("accumulation", resources.getTexture(data.accumulation), {});
+                mi->setParameter("weight", resources.getTexture(data.weight), {});
+                mi->commit(driver);
+                mi->use(driver);
+
+                // the composite is premultiplied
+                PipelineState pipeline(material.getPipelineState());
+                pipeline.rasterState.blendFunctionSrcRGB   = BlendFunction::ONE;
+                pipeline.rasterState.blendFunctionSrcAlpha = BlendFunction::ONE;
+                pipeline.rasterState.blendFunctionDstRGB   = BlendFunction::ONE_MINUS_SRC_ALPHA;
+                pipeline.rasterState.blendFunctionDstAlpha = BlendFunction::ONE_MINUS_SRC_ALPHA;
+
+                driver.beginRenderPass(out.target, out.params);
+                driver.draw(pipeline, mEngine.getFullScreenRenderPrimitive(), 1);
+                driver.endRenderPass();
+            });
+
+    return ppComposite.getData().output;
+}
+
 FrameGraphId<FrameGraphTexture> PostProcessManager::vsmMipmapPass(FrameGraph& fg,
         FrameGraphId<FrameGraphTexture> input, uint8_t layer, size_t level) noexcept {
 
@@ -2192,4 +2710,204 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::vsmMipmapPass(FrameGraph& fg
     return depthMipmapPass.getData().out;
 }
 
+FrameGraphId<FrameGraphTexture> PostProcessManager::vsmBlurPass(FrameGraph& fg,
+        FrameGraphId<FrameGraphTexture> input, uint8_t layer, uint2 offset, uint32_t dim,
+        float blurWidth, float momentBias) noexcept {
+
+    struct VsmBlurData {
+        FrameGraphId<FrameGraphTexture> in;
+        FrameGraphId<FrameGraphTexture> out;
+        FrameGraphId<FrameGraphTexture> temp;
+        FrameGraphRenderTargetHandle tempRT;
+        FrameGraphRenderTargetHandle outRT;
+    };
+
+    // must match the size of the kernel array of vsmBlur.mat
+    constexpr size_t KERNEL_SIZE = 32;
+    const size_t kernelWidth = std::min(size_t(std::ceil(blurWidth)) | 1u, KERNEL_SIZE * 4 - 3);
+    const float sigma = (kernelWidth + 1.0f) / 6.0f;
+
+    auto& blurPass = fg.addPass<VsmBlurData>("VSM Blur Pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                const char* name = builder.getName(input);
+                auto const& desc = builder.getDescriptor(input);
+                data.in = builder.sample(input);
+                data.out = builder.write(data.in);
+
+                // the horizontal pass only covers the shadow map
+                data.temp = builder.createTexture("VSM Blur Temporary", {
+                        .width = dim,
+                        .height = dim,
+                        .depth = 1,
+                        .type = SamplerType::SAMPLER_2D_ARRAY,
+                        .format = desc.format
+                });
+                data.temp = builder.write(builder.sample(data.temp));
+
+                data.tempRT = builder.createRenderTarget("VSM Blur Horizontal Target", {
+                        .attachments = {{ data.temp, 0u, 0u }} });
+                data.outRT = builder.createRenderTarget(name, {
+                        .attachments = {{ data.out, 0u, layer }} });
+            },
+            [=](FrameGraphPassResources const& resources,
+                    auto const& data, DriverApi& driver) {
+                Handle<HwRenderPrimitive> fullScreenRenderPrimitive =
+                        mEngine.getFullScreenRenderPrimitive();
+
+                auto const& material = getPostProcessMaterial("vsmBlur");
+                FMaterialInstance* const mi = material.getMaterialInstance();
+
+                float2 kernel[KERNEL_SIZE];
+                const size_t m = computeGaussianCoefficients(kernel, KERNEL_SIZE,
+                        kernelWidth, sigma);
+
+                // the 1-texel border of the shadow map is neither read nor written
+                const float size = float(resources.getDescriptor(data.in).width);
+                const float2 lo = float2(offset) + 1.5f;
+                const float2 hi = float2(offset) + float(dim) - 1.5f;
+
+                // horizontal pass, from the layer to the temporary texture
+                auto tempRT = resources.get(data.tempRT);
+                tempRT.params.viewport = { 1, 1, dim - 2, dim - 2 };
+                // The framegraph only computes discard flags at FrameGraphPass boundaries
+                tempRT.params.flags.discardEnd = TargetBufferFlags::NONE;
+
+                mi->setParameter("moments", resources.getTexture(data.in), {
+                        .filterMag = SamplerMagFilter::LINEAR,
+                        .filterMin = SamplerMinFilter::LINEAR
+                });
+                mi->setParameter("layer", float(layer));
+                mi->setParameter("origin", float2(offset));
+                mi->setParameter("invSize", float2(1.0f / size));
+                mi->setParameter("bounds", float4{ lo / size, hi / size });
+                mi->setParameter("axis", float2{ 1.0f / size, 0.0f });
+                mi->setParameter("count", int32_t(m));
+                mi->setParameter("kernel", kernel, m);
+                mi->setParameter("momentBias", 0.0f);
+                commitAndRender(tempRT, material, driver);
+
+                // vertical pass, from the temporary texture back to the shadow map
+                auto outRT = resources.get(data.outRT);
+                outRT.params.viewport = {
+                        int32_t(offset.x + 1), int32_t(offset.y + 1), dim - 2, dim - 2 };
+
+                mi->setParameter("moments", resources.getTexture(data.temp), {
+                        .filterMag = SamplerMagFilter::LINEAR,
+                        .filterMin = SamplerMinFilter::LINEAR
+                });
+                mi->setParameter("layer", 0.0f);
+                mi->setParameter("origin", -float2(offset));
+                mi->setParameter("invSize", float2(1.0f / float(dim)));
+                mi->setParameter("bounds", float4{
+                        float2(1.5f / float(dim)), float2(1.0f - 1.5f / float(dim)) });
+                mi->setParameter("axis", float2{ 0.0f, 1.0f / float(dim) });
+                mi->setParameter("momentBias", momentBias);
+                mi->commit(driver);
+                // we don't need to call use() here, since it's the same material
+
+                driver.beginRenderPass(outRT.target, outRT.params);
+                driver.draw(material.getPipelineState(), fullScreenRenderPrimitive, 1);
+                driver.endRenderPass();
+            });
+
+    return blurPass.getData().out;
+}
+
+void PostProcessManager::prefilterEnvironment(DriverApi& driver, FTexture const* environment,
+        FTexture const* reflections, Texture::PrefilterOptions const& options,
+        size_t firstLevel, size_t levelCount) noexcept {
+    // see CubemapIBL::roughnessFilter()
+    const size_t dim0 = environment->getWidth();
+    const float omegaP = (4.0f * f::PI) / float(6 * dim0 * dim0);
+    // K is a LOD bias that allows a bit of overlapping between samples
+    constexpr float K = 4;
+    const float lodOffset = 0.5f * (std::log2(K) - std::log2(omegaP));
+
+    // the roughness of a level only depends on the size of the texture, as with the CPU version
+    assert(firstLevel + levelCount <= reflections->getLevelCount());
+    const float maxLevel = float(std::max(1, int(reflections->getMaxLevelCount()) - 1));
+
+    auto& material = getPostProcessMaterial("iblPrefilter");
+    FMaterialInstance* const mi = material.getMaterialInstance();
+    mi->setParameter("environment", environment->getHwHandle(), {
+            .filterMag = SamplerMagFilter::LINEAR,
+            .filterMin = SamplerMinFilter::LINEAR_MIPMAP_LINEAR });
+    mi->setParameter("sampleCount", int32_t(std::max(uint16_t(1), options.sampleCount)));
+    mi->setParameter("lodOffset", lodOffset);
+    mi->setParameter("maxLod", float(environment->getLevelCount() - 1));
+    mi->setParameter("mirror", options.mirror ? -1.0f : 1.0f);
+
+    for (size_t level = firstLevel; level < firstLevel + levelCount; level++) {
+        const uint32_t dim = uint32_t(reflections->getWidth(level));
+        const float lod = saturate(float(level) / maxLevel);
+        mi->setParameter("linearRoughness", lod * lod);
+        for (size_t face = 0; face < 6; face++) {
+            mi->setParameter("face", int32_t(face));
+            FrameGraphRenderTarget out;
+            out.target = driver.createRenderTarget(TargetBufferFlags::COLOR0, dim, dim, 1,
+                    MRT{{ reflections->getHwHandle(), uint8_t(level), TextureCubemapFace(face) }},
+                    {}, {});
+            out.params.viewport = { 0, 0, dim, dim };
+            out.params.flags.discardStart = TargetBufferFlags::COLOR0;
+            commitAndRender(out, material, driver);
+            driver.destroyRenderTarget(out.target);
+        }
+    }
+}
+
+void PostProcessManager::computeIrradianceSH(DriverApi& driver, FTexture const* environment,
+        bool mirror, Texture::SphericalHarmonicsCallback callback, void* user) noexcept {
+    // The coefficients are rendered in a 9x6 target, one row per face, which are summed when
+    // read back. The environment is integrated at a level of 32x32 texels at most, which is
+    // plenty for the low frequencies of the irradiance.
+    constexpr size_t MAX_DIM = 32;
+    size_t level = 0;
+    while (level + 1 < environment->getLevelCount() && environment->getWidth(level) > MAX_DIM) {
+        level++;
+    }
+
+    auto& material = getPostProcessMaterial("iblSH");
+    FMaterialInstance* const mi = material.getMaterialInstance();
+    mi->setParameter("environment", environment->getHwHandle(), {
+            .filterMag = SamplerMagFilter::NEAREST,
+            .filterMin = SamplerMinFilter::NEAREST_MIPMAP_NEAREST });
+    mi->setParameter("dim", int32_t(environment->getWidth(level)));
+    mi->setParameter("lod", float(level));
+    mi->setParameter("mirror", mirror ? -1.0f : 1.0f);
+
+    Handle<HwTexture> sh = driver.createTexture(SamplerType::SAMPLER_2D, 1,
+            TextureFormat::RGBA16F, 1, 9, 6, 1,
+            TextureUsage::COLOR_ATTACHMENT | TextureUsage::SAMPLEABLE);
+
+    FrameGraphRenderTarget out;
+    out.target = driver.createRenderTarget(TargetBufferFlags::COLOR0, 9, 6, 1, MRT{ sh }, {}, {});
+    out.params.viewport = { 0, 0, 9, 6 };
+    out.params.flags.discardStart = TargetBufferFlags::COLOR0;
+    commitAndRender(out, material, driver);
+
+    struct Readback {
+        float4 texels[6 * 9];
+        Texture::SphericalHarmonicsCallback callback;
+        void* user;
+    };
+    Readback* readback = new Readback{ {}, callback, user };
+    driver.readPixels(out.target, 0, 0, 9, 6, {
+            readback->texels, sizeof(readback->texels),
+            PixelDataFormat::RGBA, PixelDataType::FLOAT,
+            [](void*, size_t, void* user) {
+                Readback* readback = static_cast<Readback*>(user);
+                float3 sh[9] = {};
+                for (size_t face = 0; face < 6; face++) {
+                    for (size_t i = 0; i < 9; i++) {
+                        sh[i] += readback->texels[face * 9 + i].rgb;
+                    }
+                }
+                readback->callback(sh, readback->user);
+                delete readback;
+            }, readback });
+
+    driver.destroyRenderTarget(out.target);
+    driver.destroyTexture(sh);
+}
+
 } // namespace filament
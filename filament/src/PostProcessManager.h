@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_POSTPROCESS_MANAGER_H
 #define TNT_FILAMENT_POSTPROCESS_MANAGER_H
 
+#include "Downsampler.h"
 #include "UniformBuffer.h"
 
 #include "private/backend/DriverApiForward.h"
@@ -26,6 +27,7 @@
 #include <fg/FrameGraphHandle.h>
 
 #include <backend/DriverEnums.h>
+#include <filament/Texture.h>
 #include <filament/View.h>
 
 #include <utils/CString.h>
@@ -41,7 +43,9 @@ class FColorGrading;
 class FEngine;
 class FMaterial;
 class FMaterialInstance;
+class FTexture;
 class FView;
+class OcclusionCuller;
 class RenderPass;
 struct CameraInfo;
 
@@ -66,11 +70,48 @@ public:
     FrameGraphId<FrameGraphTexture> structure(FrameGraph& fg, RenderPass const& pass,
             uint32_t width, uint32_t height, float scale) noexcept;
 
+    // Layout of the hi-z pyramid of a width x height structure buffer. Level 0 is half the size
+    // of the structure buffer, padded so that each level is exactly half the size of the
+    // previous one: a texel of level k then covers 2^(k+1) x 2^(k+1) structure texels.
+    struct HiZLayout {
+        uint32_t width;
+        uint32_t height;
+        uint8_t levels;
+    };
+    static HiZLayout getHiZLayout(uint32_t width, uint32_t height) noexcept;
+
+    // Reduces the structure buffer to a hi-z pyramid, where each texel keeps the farthest (r) and
+    // the closest (g) depth of its footprint. It's shared by screen-space reflections and
+    // occlusion culling: with a culler, the level whose texels cover OcclusionCuller::TILE_SIZE
+    // structure texels is read back for it. The pyramid is put on the blackboard as "hiz".
+    FrameGraphId<FrameGraphTexture> hizPyramid(FrameGraph& fg, OcclusionCuller* culler,
+            CameraInfo const& cameraInfo) noexcept;
+
+    // Screen-space reflections, traced through the hi-z pyramid into the color of the previous
+    // frame. The output is half the size of the structure buffer, with premultiplied colors and
+    // the confidence of the reflections in alpha. The output is invalid without a history.
+    FrameGraphId<FrameGraphTexture> screenSpaceReflections(FrameGraph& fg,
+            FrameHistory const& frameHistory, CameraInfo const& cameraInfo,
+            View::ScreenSpaceReflectionsOptions const& options) noexcept;
+
+    // keeps the color passes output at half resolution in the current history entry, for the
+    // reflections of the next frame. 'clipFromWorld' is the transform it was rendered with.
+    void screenSpaceReflectionsHistory(FrameGraph& fg, FrameGraphId<FrameGraphTexture> input,
+            FrameHistory& frameHistory, math::mat4f const& clipFromWorld) noexcept;
+
+    // Automatic exposure: measures the luminance of 'input' with a histogram, adapts the
+    // exposure of the previous frame toward it and multiplies the compensation into 'input'.
+    // Everything stays on the GPU, the adapted exposure is kept in the current history entry.
+    // 'time' is the engine time, in seconds.
+    FrameGraphId<FrameGraphTexture> autoExposure(FrameGraph& fg,
+            FrameGraphId<FrameGraphTexture> input, FrameHistory& frameHistory,
+            View::AutoExposureOptions const& options, double time) noexcept;
+
     // SSAO
     FrameGraphId<FrameGraphTexture> screenSpaceAmbientOcclusion(FrameGraph& fg,
             RenderPass& pass, filament::Viewport const& svp,
             CameraInfo const& cameraInfo,
-            View::AmbientOcclusionOptions options) noexcept;
+            View::AmbientOcclusionOptions options, uint32_t temporalIndex) noexcept;
 
     // Used in refraction pass
     FrameGraphId<FrameGraphTexture> generateGaussianMipmap(FrameGraph& fg,
@@ -91,10 +132,14 @@ public:
 
     void colorGradingSubpass(backend::DriverApi& driver, bool translucent) noexcept;
 
+    // When colorGradingConfig.asSubpass is set, this pass can be merged into the pass writing
+    // 'input', in which case colorGradingPrepareSubpass() must have been called before.
+    // Otherwise, when colorGradingConfig.fxaa is set, FXAA is applied by this pass as well and
+    // fxaa() must not be called.
     FrameGraphId<FrameGraphTexture> colorGrading(FrameGraph& fg,
             FrameGraphId<FrameGraphTexture> input, const FColorGrading* colorGrading,
-            backend::TextureFormat outFormat, bool translucent, bool fxaa, math::float2 scale,
-            View::BloomOptions bloomOptions, View::VignetteOptions vignetteOptions, bool dithering) noexcept;
+            ColorGradingConfig const& colorGradingConfig, math::float2 scale,
+            View::BloomOptions bloomOptions, View::VignetteOptions vignetteOptions) noexcept;
 
     // Anti-aliasing
     FrameGraphId<FrameGraphTexture> fxaa(FrameGraph& fg,
@@ -102,14 +147,18 @@ public:
             bool translucent) noexcept;
 
     // Temporal Anti-aliasing
+    // scale is the dynamic resolution scale, with upscaling the jitter sequence is longer
     void prepareTaa(FrameHistory& frameHistory,
             CameraInfo const& cameraInfo,
-            View::TemporalAntiAliasingOptions const& taaOptions) const noexcept;
+            View::TemporalAntiAliasingOptions const& taaOptions,
+            math::float2 scale) const noexcept;
 
+    // With taaOptions.upscaling, the output has the given size instead of the input's
     FrameGraphId<FrameGraphTexture> taa(FrameGraph& fg,
             FrameGraphId<FrameGraphTexture> input, FrameHistory& frameHistory,
             View::TemporalAntiAliasingOptions taaOptions,
-            ColorGradingConfig colorGradingConfig) noexcept;
+            ColorGradingConfig colorGradingConfig,
+            uint32_t width, uint32_t height) noexcept;
 
     // Blit/rescaling/resolves
     FrameGraphId<FrameGraphTexture> opaqueBlit(FrameGraph& fg,
@@ -123,16 +172,39 @@ public:
     FrameGraphId<FrameGraphTexture> resolve(FrameGraph& fg,
             const char* outputBufferName, FrameGraphId<FrameGraphTexture> input) noexcept;
 
+    // blends the buffers of the order-independent transparency pass over the color buffer
+    FrameGraphId<FrameGraphTexture> orderIndependentTransparencyComposite(FrameGraph& fg,
+            FrameGraphId<FrameGraphTexture> input,
+            FrameGraphId<FrameGraphTexture> accumulation,
+            FrameGraphId<FrameGraphTexture> weight) noexcept;
+
+    // VSM shadow blur pass, a separable Gaussian blur of the shadow map of size 'dim' at 'offset'
+    // in 'layer', which adds 'momentBias' to its second moment.
+    FrameGraphId<FrameGraphTexture> vsmBlurPass(FrameGraph& fg,
+            FrameGraphId<FrameGraphTexture> input, uint8_t layer, math::uint2 offset,
+            uint32_t dim, float blurWidth, float momentBias) noexcept;
+
     // VSM shadow mipmap pass
     FrameGraphId<FrameGraphTexture> vsmMipmapPass(FrameGraph& fg,
             FrameGraphId<FrameGraphTexture> input, uint8_t layer, size_t level) noexcept;
 
+    // IBL, see FTexture::generatePrefilterMipmap() and FTexture::computeIrradianceSH()
+    // these are not frame graph passes, but they must be called within a frame
+    // prefilterEnvironment() filters 'levelCount' levels of the reflections from 'firstLevel'
+    void prefilterEnvironment(backend::DriverApi& driver, FTexture const* environment,
+            FTexture const* reflections, Texture::PrefilterOptions const& options,
+            size_t firstLevel, size_t levelCount) noexcept;
+
+    void computeIrradianceSH(backend::DriverApi& driver, FTexture const* environment, bool mirror,
+            Texture::SphericalHarmonicsCallback callback, void* user) noexcept;
+
     backend::Handle<backend::HwTexture> getOneTexture() const { return mDummyOneTexture; }
     backend::Handle<backend::HwTexture> getZeroTexture() const { return mDummyZeroTexture; }
     backend::Handle<backend::HwTexture> getOneTextureArray() const { return mDummyOneTextureArray; }
 
-    math::float2 halton(size_t index) const noexcept {
-        return mHaltonSamples[index & 0xFu];
+    // sampleCount must be a power of two, at most MAX_HALTON_SAMPLES
+    math::float2 halton(size_t index, size_t sampleCount = 16) const noexcept {
+        return mHaltonSamples[index & (sampleCount - 1u)];
     }
 
 private:
@@ -220,11 +292,16 @@ private:
     backend::Handle<backend::HwTexture> mDummyOneTextureArray;
     backend::Handle<backend::HwTexture> mDummyZeroTexture;
 
+    // generates the bloom levels in a single compute dispatch, when supported
+    Downsampler mDownsampler;
+
     size_t mSeparableGaussianBlurKernelStorageSize = 0;
 
     std::uniform_real_distribution<float> mUniformDistribution{0.0f, 1.0f};
 
-    const math::float2 mHaltonSamples[16];
+    // TAA upscaling needs more samples so that they cover each output pixel
+    static constexpr size_t MAX_HALTON_SAMPLES = 64;
+    math::float2 mHaltonSamples[MAX_HALTON_SAMPLES];
     bool mDisableFeedbackLoops;
 };
 
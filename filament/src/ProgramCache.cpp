@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProgramCache.h"
+
+#include "private/backend/DriverApi.h"
+
+#include <private/backend/Program.h>
+
+#include <utils/CString.h>
+
+#include <variant>
+
+#include <assert.h>
+#include <string.h>
+
+namespace filament {
+
+using namespace backend;
+
+namespace {
+
+// FNV-1a, programs are only hashed when they're created
+struct Hasher {
+    uint64_t value = 0xcbf29ce484222325u;
+
+    void bytes(void const* data, size_t size) noexcept {
+        auto const* p = static_cast<uint8_t const*>(data);
+        for (size_t i = 0; i < size; i++) {
+            value = (value ^ p[i]) * 0x100000001b3u;
+        }
+    }
+
+    template<typename T>
+    void pod(T const& v) noexcept {
+        bytes(&v, sizeof(v));
+    }
+
+    void string(utils::CString const& s) noexcept {
+        // the size delimits consecutive strings
+        pod(uint32_t(s.size()));
+        bytes(s.c_str_safe(), s.size());
+    }
+};
+
+} // anonymous namespace
+
+ProgramCache::ProgramCache() noexcept = default;
+
+ProgramCache::~ProgramCache() noexcept {
+    assert(mPrograms.empty());
+}
+
+uint64_t ProgramCache::hash(Program const& program) noexcept {
+    Hasher h;
+    for (auto const& source : program.getShadersSource()) {
+        h.pod(uint64_t(source.size()));
+        h.bytes(source.data(), source.size());
+    }
+    for (auto const& name : program.getUniformBlockInfo()) {
+        h.string(name);
+    }
+    for (auto const& group : program.getSamplerGroupInfo()) {
+        h.pod(uint32_t(group.size()));
+        for (auto const& sampler : group) {
+            h.string(sampler.name);
+            h.pod(sampler.binding);
+            h.pod(sampler.strict);
+        }
+    }
+    for (auto const& constant : program.getSpecializationConstants()) {
+        h.pod(constant.id);
+        h.pod(uint32_t(constant.value.index()));
+        std::visit([&h](auto value) { h.pod(value); }, constant.value);
+    }
+    h.pod(program.isNonBlocking());
+    return h.value;
+}
+
+Handle<HwProgram> ProgramCache::acquire(DriverApi& driver, Program&& program) {
+    const uint64_t key = hash(program);
+    auto pos = mPrograms.find(key);
+    if (pos != mPrograms.end()) {
+        pos->second.references++;
+        return pos->second.handle;
+    }
+    Handle<HwProgram> handle = driver.createProgram(std::move(program));
+    mPrograms[key] = { handle, 1 };
+    mKeys[handle.getId()] = key;
+    return handle;
+}
+
+void ProgramCache::release(DriverApi& driver, Handle<HwProgram> handle) noexcept {
+    if (!handle) {
+        return;
+    }
+    auto key = mKeys.find(handle.getId());
+    assert(key != mKeys.end());
+    auto pos = mPrograms.find(key->second);
+    assert(pos != mPrograms.end() && pos->second.references > 0);
+    if (--pos->second.references > 0) {
+        return;
+    }
+    driver.destroyProgram(handle);
+    mPrograms.erase(pos);
+    mKeys.erase(key);
+}
+
+} // namespace filament
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_PROGRAMCACHE_H
+#define TNT_FILAMENT_PROGRAMCACHE_H
+
+#include <backend/Handle.h>
+
+#include "private/backend/DriverApiForward.h"
+
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+namespace backend {
+class Program;
+} // namespace backend
+
+// Shares the identical programs of the materials, e.g. the variants of materials that only differ
+// by their raster state, or of a material package loaded more than once. The programs are looked
+// up by a 64-bit hash of what defines them: their shaders, uniform blocks, sampler groups and
+// specialization constants, but not their diagnostics. A program is destroyed with its last
+// reference.
+class ProgramCache {
+public:
+    ProgramCache() noexcept;
+    ~ProgramCache() noexcept;
+
+    ProgramCache(ProgramCache const& rhs) = delete;
+    ProgramCache& operator=(ProgramCache const& rhs) = delete;
+
+    // Returns the program identical to 'program' and adds a reference to it, or creates it with
+    // one reference.
+    backend::Handle<backend::HwProgram> acquire(backend::DriverApi& driver,
+            backend::Program&& program);
+
+    // Removes a reference to a program, and destroys it if it was the last one. Null handles are
+    // ignored.
+    void release(backend::DriverApi& driver, backend::Handle<backend::HwProgram> handle) noexcept;
+
+    // Number of distinct programs.
+    size_t getProgramCount() const noexcept { return mPrograms.size(); }
+
+    static uint64_t hash(backend::Program const& program) noexcept;
+
+private:
+    struct Entry {
+        backend::Handle<backend::HwProgram> handle;
+        uint32_t references;
+    };
+    std::unordered_map<uint64_t, Entry> mPrograms;
+    std::unordered_map<backend::HandleBase::HandleId, uint64_t> mKeys;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_PROGRAMCACHE_H
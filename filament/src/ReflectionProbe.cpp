@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "details/ReflectionProbe.h"
+
+#include "details/Camera.h"
+#include "details/Engine.h"
+#include "details/IndirectLight.h"
+#include "details/Renderer.h"
+#include "details/RenderTarget.h"
+#include "details/Scene.h"
+#include "details/Texture.h"
+#include "details/View.h"
+
+#include "PostProcessManager.h"
+
+#include "FilamentAPI-impl.h"
+
+#include <filament/Camera.h>
+#include <filament/IndirectLight.h>
+#include <filament/RenderTarget.h>
+#include <filament/Texture.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+
+#include <utils/EntityManager.h>
+#include <utils/Panic.h>
+
+using namespace filament::math;
+
+namespace filament {
+
+struct ReflectionProbe::BuilderDetails {
+    FScene* mScene = nullptr;
+    float3 mPosition{};
+    float mNear = 0.1f;
+    float mFar = 100.0f;
+    uint32_t mSize = 128;
+    uint16_t mSampleCount = 8;
+    uint8_t mFacesPerFrame = 1;
+};
+
+using BuilderType = ReflectionProbe;
+BuilderType::Builder::Builder() noexcept = default;
+BuilderType::Builder::~Builder() noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder&& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs) noexcept = default;
+
+ReflectionProbe::Builder& ReflectionProbe::Builder::scene(Scene* scene) noexcept {
+    mImpl->mScene = upcast(scene);
+    return *this;
+}
+
+ReflectionProbe::Builder& ReflectionProbe::Builder::size(uint32_t size) noexcept {
+    mImpl->mSize = size;
+    return *this;
+}
+
+ReflectionProbe::Builder& ReflectionProbe::Builder::facesPerFrame(uint8_t count) noexcept {
+    mImpl->mFacesPerFrame = count;
+    return *this;
+}
+
+ReflectionProbe::Builder& ReflectionProbe::Builder::position(float3 const& position) noexcept {
+    mImpl->mPosition = position;
+    return *this;
+}
+
+ReflectionProbe::Builder& ReflectionProbe::Builder::clipping(float near, float far) noexcept {
+    mImpl->mNear = near;
+    mImpl->mFar = far;
+    return *this;
+}
+
+ReflectionProbe::Builder& ReflectionProbe::Builder::sampleCount(uint16_t sampleCount) noexcept {
+    mImpl->mSampleCount = sampleCount;
+    return *this;
+}
+
+ReflectionProbe* ReflectionProbe::Builder::build(Engine& engine) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mScene, "a scene is required")) {
+        return nullptr;
+    }
+    const uint32_t size = mImpl->mSize;
+    if (!ASSERT_PRECONDITION_NON_FATAL(size && !(size & (size - 1)),
+            "size must be a power-of-two")) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(
+            mImpl->mFacesPerFrame >= 1 && mImpl->mFacesPerFrame <= 6,
+            "facesPerFrame must be between 1 and 6")) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mNear > 0.0f && mImpl->mFar > mImpl->mNear,
+            "invalid clipping planes")) {
+        return nullptr;
+    }
+    return upcast(engine).createReflectionProbe(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// The camera of each face, following the OpenGL cubemap conventions: the cube is seen from the
+// inside, and the t axis of the faces points down, except for the y faces.
+static const struct {
+    float3 direction;
+    float3 up;
+} sFaces[6] = {
+        { {  1,  0,  0 }, { 0, -1,  0 } },
+        { { -1,  0,  0 }, { 0, -1,  0 } },
+        { {  0,  1,  0 }, { 0,  0,  1 } },
+        { {  0, -1,  0 }, { 0,  0, -1 } },
+        { {  0,  0,  1 }, { 0, -1,  0 } },
+        { {  0,  0, -1 }, { 0, -1,  0 } },
+};
+
+FReflectionProbe::FReflectionProbe(FEngine& engine, const Builder& builder)
+        : mEngine(engine),
+          mScene(builder->mScene),
+          mPosition(builder->mPosition),
+          mNear(builder->mNear),
+          mFar(builder->mFar),
+          mSampleCount(builder->mSampleCount),
+          mFacesPerFrame(builder->mFacesPerFrame) {
+    Engine& e = engine;
+    const uint32_t size = builder->mSize;
+
+    // The capture and the reflections have all their mipmap levels, the filtering samples the
+    // capture's levels to need few samples.
+    const uint8_t levels = uint8_t(FTexture::maxLevelCount(size));
+    auto createCubemap = [&]() {
+        return upcast(Texture::Builder()
+                .width(size)
+                .height(size)
+                .levels(levels)
+                .sampler(Texture::Sampler::SAMPLER_CUBEMAP)
+                .format(Texture::InternalFormat::RGBA16F)
+                .usage(Texture::Usage::COLOR_ATTACHMENT | Texture::Usage::SAMPLEABLE)
+                .build(e));
+    };
+    mCapture = createCubemap();
+    mReflections[0] = createCubemap();
+    mReflections[1] = createCubemap();
+
+    // all the faces share the depth buffer, it's cleared for each of them
+    mDepth = upcast(Texture::Builder()
+            .width(size)
+            .height(size)
+            .format(Texture::InternalFormat::DEPTH24)
+            .usage(Texture::Usage::DEPTH_ATTACHMENT)
+            .build(e));
+
+    for (size_t face = 0; face < 6; face++) {
+        mTargets[face] = upcast(RenderTarget::Builder()
+                .texture(RenderTarget::AttachmentPoint::COLOR, mCapture)
+                .face(RenderTarget::AttachmentPoint::COLOR, RenderTarget::CubemapFace(face))
+                .texture(RenderTarget::AttachmentPoint::DEPTH, mDepth)
+                .build(e));
+    }
+
+    // The captured values are not exposed, they're in the physical units the IndirectLight
+    // expects with an intensity of 1.
+    mCameraEntity = utils::EntityManager::get().create();
+    mCamera = upcast(e.createCamera(mCameraEntity));
+    mCamera->setProjection(90.0, 1.0, mNear, mFar, Camera::Fov::VERTICAL);
+    // f/1, 1.2s, ISO 100 gives an exposure of exactly 1
+    mCamera->setExposure(1.0f, 1.2f, 100.0f);
+
+    // The capture is low resolution and only used for lighting: the faces are rendered straight
+    // into the cubemap, without post-processing, and without shadows.
+    mView = upcast(e.createView());
+    mView->setName("ReflectionProbe");
+    mView->setScene(mScene);
+    mView->setCamera(mCamera);
+    mView->setViewport({ 0, 0, size, size });
+    mView->setPostProcessingEnabled(false);
+    mView->setShadowingEnabled(false);
+    mView->setScreenSpaceRefractionEnabled(false);
+}
+
+void FReflectionProbe::terminate(FEngine& engine) noexcept {
+    // the irradiance of a pending capture is dropped when it arrives
+    if (mPendingIrradiance) {
+        mPendingIrradiance->probe = nullptr;
+        mPendingIrradiance = nullptr;
+    }
+
+    // use Engine::destroy because FEngine::destroy is inlined
+    Engine& e = engine;
+    e.destroy(mView);
+    e.destroyCameraComponent(mCameraEntity);
+    utils::EntityManager::get().destroy(mCameraEntity);
+    if (mIndirectLight) {
+        if (mScene->getIndirectLight() == mIndirectLight) {
+            mScene->setIndirectLight(nullptr);
+        }
+        e.destroy(mIndirectLight);
+    }
+    for (FRenderTarget* target : mTargets) {
+        e.destroy(target);
+    }
+    // this also drops the frame job filtering the capture, if any
+    e.destroy(mCapture);
+    e.destroy(mDepth);
+    e.destroy(mReflections[0]);
+    e.destroy(mReflections[1]);
+}
+
+void FReflectionProbe::render(FRenderer& renderer) {
+    if (mState == State::SWAP && mHasIrradiance) {
+        swap();
+    }
+    if (mState != State::CAPTURE) {
+        return;
+    }
+
+    // a capture is rendered from a single position
+    if (mNextFace == 0) {
+        mCapturePosition = mPosition;
+    }
+    for (size_t i = 0; i < mFacesPerFrame && mNextFace < 6; i++, mNextFace++) {
+        const auto& face = sFaces[mNextFace];
+        mCamera->lookAt(mCapturePosition, mCapturePosition + face.direction, face.up);
+        mView->setRenderTarget(mTargets[mNextFace]);
+        renderer.render(mView);
+    }
+    if (mNextFace == 6) {
+        mNextFace = 0;
+        filter();
+    }
+}
+
+void FReflectionProbe::filter() noexcept {
+    mState = State::FILTER;
+    mHasIrradiance = false;
+
+    // the mipmaps are generated right after the faces are rendered, within this frame
+    mCapture->generateMipmaps(mEngine);
+
+    // The filtering starts with the next frame, each one filters a level of the reflections.
+    // The capture was rendered with the OpenGL conventions, it doesn't need to be mirrored.
+    FTexture* const reflections = mReflections[mBack];
+    Texture::PrefilterOptions options;
+    options.sampleCount = mSampleCount;
+    options.mirror = false;
+    mEngine.addFrameJob(mCapture, reflections,
+            [this, reflections, options, level = size_t(0)](FEngine::DriverApi& driver) mutable {
+                PostProcessManager& ppm = mEngine.getPostProcessManager();
+                if (level == 0) {
+                    mPendingIrradiance = new PendingIrradiance{ this };
+                    ppm.computeIrradianceSH(driver, mCapture, false,
+                            [](float3 const* sh, void* user) {
+                                PendingIrradiance* pending = static_cast<PendingIrradiance*>(user);
+                                if (FReflectionProbe* probe = pending->probe) {
+                                    std::copy_n(sh, 9, probe->mIrradiance);
+                                    probe->mHasIrradiance = true;
+                                    probe->mPendingIrradiance = nullptr;
+                                }
+                                delete pending;
+                            }, mPendingIrradiance);
+                }
+                ppm.prefilterEnvironment(driver, mCapture, reflections, options, level, 1);
+                if (++level < reflections->getLevelCount()) {
+                    return false;
+                }
+                mState = State::SWAP;
+                return true;
+            });
+}
+
+void FReflectionProbe::swap() noexcept {
+    // The new IndirectLight is complete, it replaces the previous one all at once. The previous
+    // reflections are filtered again by the next capture.
+    Engine& e = mEngine;
+    FIndirectLight* const light = upcast(IndirectLight::Builder()
+            .reflections(mReflections[mBack])
+            .irradiance(3, mIrradiance)
+            .intensity(1.0f)
+            .build(e));
+    mScene->setIndirectLight(light);
+    if (mIndirectLight) {
+        e.destroy(mIndirectLight);
+    }
+    mIndirectLight = light;
+    mBack ^= 1u;
+    mState = State::CAPTURE;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+void ReflectionProbe::setPosition(float3 const& position) noexcept {
+    upcast(this)->setPosition(position);
+}
+
+float3 ReflectionProbe::getPosition() const noexcept {
+    return upcast(this)->getPosition();
+}
+
+void ReflectionProbe::render(Renderer& renderer) {
+    upcast(this)->render(upcast(renderer));
+}
+
+IndirectLight* ReflectionProbe::getIndirectLight() const noexcept {
+    return upcast(this)->getIndirectLight();
+}
+
+View* ReflectionProbe::getView() noexcept {
+    return upcast(this)->getView();
+}
+
+} // namespace filament
@@ -27,9 +27,12 @@
 
 #include <private/filament/UibGenerator.h>
 
+#include <private/backend/CircularBuffer.h>
+
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <limits>
 #include <utility>
 
 using namespace utils;
@@ -78,6 +81,71 @@ RenderPass::Command* RenderPass::newCommandBuffer() noexcept {
 }
 
 RenderPass::Command* RenderPass::appendCommands(CommandTypeFlags const commandTypeFlags) noexcept {
+    if (UTILS_LIKELY(!mVisibleRenderables.empty())) {
+        // up-to-date summed primitive counts needed for generateCommands()
+        assert(mRenderableSoa);
+        updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(*mRenderableSoa),
+                mVisibleRenderables);
+    }
+    return appendCommandsImpl(commandTypeFlags);
+}
+
+void RenderPass::appendCommands(RenderPass* const* passes, size_t count,
+        CommandTypeFlags const commandTypeFlags) noexcept {
+    SYSTRACE_CALL();
+
+    if (UTILS_UNLIKELY(!count)) {
+        return;
+    }
+
+    FScene::RenderableSoa const* const soa = passes[0]->mRenderableSoa;
+    const utils::Range<uint32_t> vr = passes[0]->mVisibleRenderables;
+    for (size_t i = 0; i < count; i++) {
+        assert(passes[i]->mRenderableSoa == soa);
+        assert(passes[i]->mVisibleRenderables.first == vr.first);
+        assert(passes[i]->mVisibleRenderables.last == vr.last);
+    }
+
+    // the passes share their summed primitive counts, so they're computed once, after which
+    // generating the commands only reads the geometry.
+    uint32_t commandCount = 0;
+    if (!vr.empty()) {
+        assert(soa);
+        updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(*soa), vr);
+        // + 1 for the sentinel
+        commandCount = getCommandCount(*soa, vr, commandTypeFlags) + 1;
+    }
+
+    // each pass gets its own part of our command buffer
+    GrowingSlice<Command>& commands = mCommands;
+    newCommandBuffer();
+    for (size_t i = 0; i < count; i++) {
+        passes[i]->mCommands = GrowingSlice<Command>(commands.grow(commandCount), commandCount);
+    }
+
+    JobSystem& js = mEngine.getJobSystem();
+    JobSystem::Job* parent = js.createJob();
+    for (size_t i = 0; i < count; i++) {
+        RenderPass* const pass = passes[i];
+        js.run(js.createJob(parent, [pass, commandTypeFlags](JobSystem&, JobSystem::Job*) {
+            pass->appendCommandsImpl(commandTypeFlags);
+        }));
+    }
+    js.runAndWait(parent);
+}
+
+uint32_t RenderPass::getCommandCount(FScene::RenderableSoa const& soa, Range<uint32_t> vr,
+        CommandTypeFlags const commandTypeFlags) noexcept {
+    // compute how much maximum storage we need for this pass
+    uint32_t count = FScene::getPrimitiveCount(soa, vr.last);
+    // double the color pass for transparent objects that need to render twice
+    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
+    const bool depthPass  = bool(commandTypeFlags & CommandTypeFlags::DEPTH);
+    return count * uint32_t(colorPass * 2 + depthPass);
+}
+
+RenderPass::Command* RenderPass::appendCommandsImpl(
+        CommandTypeFlags const commandTypeFlags) noexcept {
     SYSTRACE_CONTEXT();
 
     FEngine& engine = mEngine;
@@ -95,17 +163,9 @@ RenderPass::Command* RenderPass::appendCommands(CommandTypeFlags const commandTy
     // trace the number of visible renderables
     SYSTRACE_VALUE32("visibleRenderables", vr.size());
 
-    // up-to-date summed primitive counts needed for generateCommands()
+    // the summed primitive counts must be up-to-date
     FScene::RenderableSoa const& soa = *mRenderableSoa;
-    updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(soa), vr);
-
-    // compute how much maximum storage we need for this pass
-    uint32_t growBy = FScene::getPrimitiveCount(soa, vr.last);
-    // double the color pass for transparent objects that need to render twice
-    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
-    const bool depthPass  = bool(commandTypeFlags & CommandTypeFlags::DEPTH);
-    growBy *= uint32_t(colorPass * 2 + depthPass);
-    Command* const curr = commands.grow(growBy);
+    Command* const curr = commands.grow(getCommandCount(soa, vr, commandTypeFlags));
 
     // we extract camera position/forward outside of the loop, because these are not cheap.
     const float3 cameraPosition(camera.getPosition());
@@ -154,12 +214,17 @@ RenderPass::Command* RenderPass::appendCustomCommand(Pass pass, CustomCommand cu
     return curr + 1;
 }
 
-RenderPass::Command* RenderPass::sortCommands() noexcept {
+RenderPass::Command* RenderPass::sortCommands(CommandOrder* order) noexcept {
     SYSTRACE_NAME("sort and trim commands");
 
     GrowingSlice<Command>& commands = mCommands;
 
-    std::sort(commands.begin(), commands.end());
+    const uint32_t count = commands.size();
+    const bool sorted = order && coherentSortCommands(commands.begin(), count, *order);
+    if (!sorted &&
+            (count < RADIX_SORT_MIN_COMMAND_COUNT || !radixSortCommands(commands.begin(), count))) {
+        std::sort(commands.begin(), commands.end());
+    }
 
     // find the last command
     Command const* const last = std::partition_point(commands.begin(), commands.end(),
@@ -169,9 +234,246 @@ RenderPass::Command* RenderPass::sortCommands() noexcept {
 
     commands.resize(uint32_t(last - commands.begin()));
 
+    if (order) {
+        order->record(commands.begin(), commands.end());
+    }
+
     return commands.end();
 }
 
+bool RenderPass::coherentSortCommands(Command* const UTILS_RESTRICT commands,
+        uint32_t const count, CommandOrder& order) const noexcept {
+    SYSTRACE_CALL();
+
+    // the previous order is a poor guess when the camera turned
+    const float3 cameraForward(mCamera.getForwardVector());
+    const bool turned = dot(cameraForward, order.mCameraForward) < COHERENT_SORT_MIN_CAMERA_COS;
+    order.mCameraForward = cameraForward;
+    const uint32_t rankCount = uint32_t(order.mRanks.size());
+    if (turned || !rankCount) {
+        return false;
+    }
+
+    ArenaScope arena(mEngine.getPerRenderPassAllocator());
+    Command* const seeded = arena.allocate<Command>(count, CACHELINE_SIZE);
+    uint32_t* const byRank = arena.allocate<uint32_t>(rankCount, CACHELINE_SIZE);
+    uint32_t* const unranked = arena.allocate<uint32_t>(count, CACHELINE_SIZE);
+    if (UTILS_UNLIKELY(!seeded || !byRank || !unranked)) {
+        return false;
+    }
+
+    // put the commands in their previous order, followed by the new ones
+    std::fill_n(byRank, rankCount, UINT32_MAX);
+    uint32_t unrankedCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        auto const pos = order.mRanks.find(CommandOrder::getIdentity(commands[i]));
+        if (pos != order.mRanks.end() && byRank[pos->second] == UINT32_MAX) {
+            byRank[pos->second] = i;
+        } else {
+            unranked[unrankedCount++] = i;
+        }
+    }
+    uint32_t n = 0;
+    for (uint32_t r = 0; r < rankCount; r++) {
+        if (byRank[r] != UINT32_MAX) {
+            seeded[n++] = commands[byRank[r]];
+        }
+    }
+    for (uint32_t i = 0; i < unrankedCount; i++) {
+        seeded[n++] = commands[unranked[i]];
+    }
+    assert(n == count);
+
+    // an insertion sort is linear on nearly sorted commands, it gives up when they're not
+    const size_t maxMoves = count * COHERENT_SORT_MAX_MOVES_PER_COMMAND;
+    size_t moves = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        if (!(seeded[i] < seeded[i - 1])) {
+            continue;
+        }
+        const Command command = seeded[i];
+        uint32_t j = i;
+        do {
+            seeded[j] = seeded[j - 1];
+            j--;
+        } while (j > 0 && command < seeded[j - 1]);
+        seeded[j] = command;
+        moves += i - j;
+        if (UTILS_UNLIKELY(moves > maxMoves)) {
+            return false;
+        }
+    }
+
+    std::copy_n(seeded, count, commands);
+    return true;
+}
+
+uint64_t RenderPass::CommandOrder::getIdentity(Command const& command) noexcept {
+    // transparent primitives can be drawn twice in the BLENDED pass, the two-pass bit tells them
+    // apart
+    const uint64_t pass = command.key & PASS_MASK;
+    const uint64_t twoPass = pass == uint64_t(Pass::BLENDED) ?
+            command.key & BLEND_TWO_PASS_MASK : 0;
+    return (uint64_t(command.primitive.primitiveHandle.getId()) << 32u) |
+            ((pass >> PASS_SHIFT) << 1u) | twoPass;
+}
+
+void RenderPass::CommandOrder::record(Command const* first, Command const* last) {
+    // custom commands aren't recorded, they're few and sorted with the new commands
+    mRanks.clear();
+    uint32_t rank = 0;
+    for (Command const* command = first; command != last; ++command) {
+        if ((command->key & CUSTOM_MASK) == uint64_t(CustomCommand::PASS)) {
+            mRanks[getIdentity(*command)] = rank++;
+        }
+    }
+}
+
+bool RenderPass::radixSortCommands(Command* const UTILS_RESTRICT commands,
+        uint32_t const count) const noexcept {
+    SYSTRACE_CALL();
+
+    // This is a stable LSD radix sort on (key, index) pairs, 8 bits at a time. Commands are
+    // only moved once at the end, rather than being swapped during the sort.
+    // Each pass is split in chunks processed by the JobSystem: first each chunk computes its
+    // histogram, then the chunks scatter their pairs in parallel, each chunk writes at
+    // offsets that preserve the stability of the sort.
+
+    constexpr size_t RADIX_BITS = 8;
+    constexpr size_t RADIX = 1u << RADIX_BITS;
+    constexpr size_t PASS_COUNT = sizeof(CommandKey) * 8 / RADIX_BITS;
+
+    using Histogram = uint32_t[RADIX];
+
+    JobSystem& js = mEngine.getJobSystem();
+    ArenaScope arena(mEngine.getPerRenderPassAllocator());
+
+    const uint32_t chunkCount = uint32_t(std::min(RADIX_SORT_MAX_CHUNK_COUNT,
+            (count + RADIX_SORT_CHUNK_SIZE - 1) / RADIX_SORT_CHUNK_SIZE));
+    const uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    CommandKey* keys[2] = {
+            arena.allocate<CommandKey>(count, CACHELINE_SIZE),
+            arena.allocate<CommandKey>(count, CACHELINE_SIZE) };
+    uint32_t* indices[2] = {
+            arena.allocate<uint32_t>(count, CACHELINE_SIZE),
+            arena.allocate<uint32_t>(count, CACHELINE_SIZE) };
+    // histograms for all passes and all chunks (the pass histograms are only valid for the
+    // first scatter, after that they're recomputed)
+    Histogram* const histograms = arena.allocate<Histogram>(chunkCount * PASS_COUNT,
+            CACHELINE_SIZE);
+    if (UTILS_UNLIKELY(!keys[0] || !keys[1] || !indices[0] || !indices[1] || !histograms)) {
+        return false;
+    }
+
+    auto runChunks = [&js, chunkCount](auto const& work) {
+        auto* job = jobs::parallel_for(js, nullptr, 0, chunkCount, std::cref(work),
+                jobs::CountSplitter<1>());
+        js.runAndWait(job);
+    };
+
+    // extract the keys and compute the histograms of all passes in one go
+    runChunks([=](uint32_t first, uint32_t n) {
+        for (uint32_t c = first; c < first + n; c++) {
+            Histogram* const UTILS_RESTRICT h = histograms + c * PASS_COUNT;
+            std::fill_n(&h[0][0], PASS_COUNT * RADIX, 0u);
+            for (uint32_t i = c * chunkSize, e = std::min(count, i + chunkSize); i < e; i++) {
+                const CommandKey key = commands[i].key;
+                keys[0][i] = key;
+                indices[0][i] = i;
+                for (size_t p = 0; p < PASS_COUNT; p++) {
+                    h[p][(key >> (p * RADIX_BITS)) & (RADIX - 1)]++;
+                }
+            }
+        }
+    });
+
+    // a byte which has the same value for all keys doesn't need a pass
+    bool needsPass[PASS_COUNT];
+    for (size_t p = 0; p < PASS_COUNT; p++) {
+        uint32_t firstBucketCount = 0;
+        size_t firstBucket = (commands[0].key >> (p * RADIX_BITS)) & (RADIX - 1);
+        for (uint32_t c = 0; c < chunkCount; c++) {
+            firstBucketCount += histograms[c * PASS_COUNT + p][firstBucket];
+        }
+        needsPass[p] = firstBucketCount != count;
+    }
+
+    size_t current = 0;
+    bool histogramsValid = true;
+    for (size_t p = 0; p < PASS_COUNT; p++) {
+        if (!needsPass[p]) {
+            continue;
+        }
+
+        const unsigned shift = unsigned(p * RADIX_BITS);
+        CommandKey const* const keysIn = keys[current];
+        uint32_t const* const indicesIn = indices[current];
+
+        if (!histogramsValid) {
+            runChunks([=](uint32_t first, uint32_t n) {
+                for (uint32_t c = first; c < first + n; c++) {
+                    uint32_t* const UTILS_RESTRICT h = histograms[c * PASS_COUNT + p];
+                    std::fill_n(h, RADIX, 0u);
+                    for (uint32_t i = c * chunkSize, e = std::min(count, i + chunkSize); i < e; i++) {
+                        h[(keysIn[i] >> shift) & (RADIX - 1)]++;
+                    }
+                }
+            });
+        }
+
+        // turn the histograms into per-chunk output offsets, in place
+        uint32_t offset = 0;
+        for (size_t v = 0; v < RADIX; v++) {
+            for (uint32_t c = 0; c < chunkCount; c++) {
+                uint32_t& h = histograms[c * PASS_COUNT + p][v];
+                const uint32_t n = h;
+                h = offset;
+                offset += n;
+            }
+        }
+
+        CommandKey* const keysOut = keys[current ^ 1];
+        uint32_t* const indicesOut = indices[current ^ 1];
+        runChunks([=](uint32_t first, uint32_t n) {
+            for (uint32_t c = first; c < first + n; c++) {
+                uint32_t* const UTILS_RESTRICT offsets = histograms[c * PASS_COUNT + p];
+                for (uint32_t i = c * chunkSize, e = std::min(count, i + chunkSize); i < e; i++) {
+                    const CommandKey key = keysIn[i];
+                    const uint32_t pos = offsets[(key >> shift) & (RADIX - 1)]++;
+                    keysOut[pos] = key;
+                    indicesOut[pos] = indicesIn[i];
+                }
+            }
+        });
+
+        current ^= 1;
+        histogramsValid = false;
+    }
+
+    // finally, apply the permutation in place by following its cycles, this moves each
+    // command only once.
+    uint32_t* const UTILS_RESTRICT permutation = indices[current];
+    for (uint32_t i = 0; i < count; i++) {
+        if (permutation[i] == i) {
+            continue;
+        }
+        const Command temp = commands[i];
+        uint32_t j = i;
+        while (true) {
+            const uint32_t k = permutation[j];
+            permutation[j] = j;
+            if (k == i) {
+                commands[j] = temp;
+                break;
+            }
+            commands[j] = commands[k];
+            j = k;
+        }
+    }
+    return true;
+}
+
 void RenderPass::execute(const char* name,
         backend::Handle<backend::HwRenderTarget> renderTarget,
         backend::RenderPassParams params) const noexcept {
@@ -182,6 +484,17 @@ void RenderPass::execute(const char* name,
     driver.endRenderPass();
 }
 
+backend::Foveation RenderPass::getFoveation(backend::Foveation const& foveation) const noexcept {
+    auto optsOut = [](Command const& command) {
+        return (command.key & CUSTOM_MASK) == uint64_t(CustomCommand::PASS) &&
+                !command.primitive.mi->getMaterial()->isFoveationEnabled();
+    };
+    if (std::any_of(mCommands.begin(), mCommands.end(), optsOut)) {
+        return {};
+    }
+    return foveation;
+}
+
 void RenderPass::executeCommands(const char* name) const noexcept {
     DriverApi& driver = mEngine.getDriverApi();
     RenderPass::recordDriverCommands(driver, mCommands.begin(), mCommands.end());
@@ -195,41 +508,73 @@ void RenderPass::recordDriverCommands(FEngine::DriverApi& driver, const Command*
     if (first != last) {
         SYSTRACE_VALUE32("commandCount", last - first);
 
-        PolygonOffset dummyPolyOffset;
-        PipelineState pipeline{ .polygonOffset = mPolygonOffset };
-        PolygonOffset* const pPipelinePolygonOffset =
-                mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
-
-        Handle<HwUniformBuffer> uboHandle = mUboHandle;
-        FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
-        FMaterial const* UTILS_RESTRICT ma = nullptr;
         auto const& customCommands = mCustomCommands;
+        auto isCustom = [](Command const& command) {
+            return (command.key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS);
+        };
 
-        first--;
-        while (++first != last) {
-            /*
-             * Be careful when changing code below, this is the hot inner-loop
-             */
-
-            if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
+        while (first != last) {
+            if (UTILS_UNLIKELY(isCustom(*first))) {
                 uint32_t index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
                 customCommands[index]();
+                ++first;
                 continue;
             }
 
-            // per-renderable uniform
-            const PrimitiveInfo info = first->primitive;
-            pipeline.rasterState = info.rasterState;
-            if (UTILS_UNLIKELY(mi != info.mi)) {
-                // this is always taken the first time
-                mi = info.mi;
-                ma = mi->getMaterial();
-                pipeline.scissor = mi->getScissor();
-                *pPipelinePolygonOffset = mi->getPolygonOffset();
-                mi->use(driver);
+            // custom commands are executed in order on this thread, the draw commands between
+            // them are recorded in parallel when there are enough of them.
+            const Command* const next = std::find_if(first, last, isCustom);
+            if (size_t(next - first) >= PARALLEL_RECORDING_MIN_COMMAND_COUNT &&
+                    mEngine.getJobSystem().getThreadCount() > 1) {
+                recordDrawCommandsParallel(driver, first, next);
+            } else {
+                recordDrawCommands(driver, first, next);
             }
+            first = next;
+        }
+        mCustomCommands.clear();
+    }
+}
 
-            pipeline.program = ma->getProgram(info.materialVariant.key);
+void RenderPass::recordDrawCommands(FEngine::DriverApi& driver, const Command* first,
+        const Command* last) const noexcept {
+    PolygonOffset dummyPolyOffset;
+    PipelineState pipeline{ .polygonOffset = mPolygonOffset };
+    PolygonOffset* const pPipelinePolygonOffset =
+            mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
+
+    Handle<HwUniformBuffer> uboHandle = mUboHandle;
+    uint16_t const* const UTILS_RESTRICT soaInstanceCount =
+            mRenderableSoa ? mRenderableSoa->data<FScene::INSTANCE_COUNT>() : nullptr;
+    FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
+    FMaterial const* UTILS_RESTRICT ma = nullptr;
+
+    // consecutive primitives of the same renderable share their per-renderable uniforms
+    uint32_t renderableIndex = std::numeric_limits<uint32_t>::max();
+
+    first--;
+    while (++first != last) {
+        /*
+         * Be careful when changing code below, this is the hot inner-loop
+         */
+
+        assert((first->key & CUSTOM_MASK) == uint64_t(CustomCommand::PASS));
+
+        // per-renderable uniform
+        const PrimitiveInfo info = first->primitive;
+        pipeline.rasterState = info.rasterState;
+        if (UTILS_UNLIKELY(mi != info.mi)) {
+            // this is always taken the first time
+            mi = info.mi;
+            ma = mi->getMaterial();
+            pipeline.scissor = mi->getScissor();
+            *pPipelinePolygonOffset = mi->getPolygonOffset();
+            mi->use(driver);
+        }
+
+        pipeline.program = ma->getProgram(info.materialVariant.key);
+        if (renderableIndex != info.index) {
+            renderableIndex = info.index;
             size_t offset = info.index * sizeof(PerRenderableUib);
             driver.bindUniformBufferRange(BindingPoints::PER_RENDERABLE,
                     uboHandle, offset, sizeof(PerRenderableUib));
@@ -237,12 +582,101 @@ void RenderPass::recordDriverCommands(FEngine::DriverApi& driver, const Command*
                 driver.bindUniformBuffer(BindingPoints::PER_RENDERABLE_BONES,
                         info.perRenderableBones);
             }
-            driver.draw(pipeline, info.primitiveHandle);
         }
-        mCustomCommands.clear();
+        driver.draw(pipeline, info.primitiveHandle, soaInstanceCount[info.index]);
     }
 }
 
+size_t RenderPass::getRecordingSize(const Command* first, const Command* last) noexcept {
+    // The size is an upper bound: material instance changes assume the worst case, and so do the
+    // per-renderable bindings, which are skipped between primitives of the same renderable.
+    // This is cheap for the programs that already exist.
+    constexpr size_t USE_MATERIAL_INSTANCE_SIZE =
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(bindSamplers)));
+    constexpr size_t DRAW_SIZE =
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBufferRange))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(draw)));
+    constexpr size_t BONES_SIZE = CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer)));
+
+    FMaterialInstance const* mi = nullptr;
+    uint8_t variant = 0;
+    size_t size = 0;
+    for (Command const* c = first; c != last; ++c) {
+        PrimitiveInfo const& info = c->primitive;
+        if (UTILS_UNLIKELY(info.mi != mi || info.materialVariant.key != variant)) {
+            size += info.mi != mi ? USE_MATERIAL_INSTANCE_SIZE : 0;
+            mi = info.mi;
+            variant = info.materialVariant.key;
+            mi->getMaterial()->getProgram(variant);
+        }
+        size += DRAW_SIZE + (info.perRenderableBones ? BONES_SIZE : 0);
+    }
+    return size;
+}
+
+void RenderPass::recordCommands(CommandBundle& bundle) const noexcept {
+    SYSTRACE_CALL();
+
+    Command const* const first = mCommands.begin();
+    Command const* const last = mCommands.end();
+    assert(std::none_of(first, last, [](Command const& command) {
+        return (command.key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS);
+    }));
+
+    const size_t size = getRecordingSize(first, last);
+    CircularBuffer buffer(bundle.allocate(size), size);
+    CommandStream stream(mEngine.getDriverApi(), buffer);
+    recordDrawCommands(stream, first, last);
+    stream.endReservedRegion();
+}
+
+void RenderPass::recordDrawCommandsParallel(FEngine::DriverApi& driver, const Command* first,
+        const Command* last) const noexcept {
+    SYSTRACE_CALL();
+
+    // Each chunk of commands is recorded by a job into a region of the command stream reserved
+    // ahead of time, so that the chunks end-up in order in the stream without copies.
+    // The size of a region is an upper bound (see getRecordingSize()), the unused space is
+    // skipped with a NoopCommand.
+
+    JobSystem& js = mEngine.getJobSystem();
+
+    const size_t count = last - first;
+    const size_t chunkCount = std::min({ js.getThreadCount(), PARALLEL_RECORDING_MAX_CHUNK_COUNT,
+            count / PARALLEL_RECORDING_CHUNK_SIZE });
+    const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    // Programs can't be created from the jobs, because that records commands in the main stream,
+    // getRecordingSize() makes sure all the programs we need exist before reserving the regions.
+    size_t sizes[PARALLEL_RECORDING_MAX_CHUNK_COUNT];
+    for (size_t i = 0; i < chunkCount; i++) {
+        Command const* const begin = first + i * chunkSize;
+        Command const* const end = std::min(begin + chunkSize, last);
+        sizes[i] = getRecordingSize(begin, end);
+    }
+
+    void* regions[PARALLEL_RECORDING_MAX_CHUNK_COUNT];
+    for (size_t i = 0; i < chunkCount; i++) {
+        regions[i] = driver.reserve(sizes[i]);
+    }
+
+    auto work = [=, &driver, &sizes, &regions](uint32_t start, uint32_t n) {
+        for (size_t i = start; i < start + n; i++) {
+            Command const* const begin = first + i * chunkSize;
+            Command const* const end = std::min(begin + chunkSize, last);
+            CircularBuffer region(regions[i], sizes[i]);
+            CommandStream stream(driver, region);
+            recordDrawCommands(stream, begin, end);
+            stream.endReservedRegion();
+        }
+    };
+
+    auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(chunkCount), std::cref(work),
+            jobs::CountSplitter<1>());
+    js.runAndWait(job);
+}
+
 /* static */
 UTILS_ALWAYS_INLINE // this function exists only to make the code more readable. we want it inlined.
 inline              // and we don't need it in the compilation unit
@@ -350,6 +784,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
     const bool depthContainsShadowCasters = bool(extraFlags & CommandTypeFlags::DEPTH_CONTAINS_SHADOW_CASTERS);
     const bool depthFilterTranslucentObjects = bool(extraFlags & CommandTypeFlags::DEPTH_FILTER_TRANSLUCENT_OBJECTS);
     const bool depthFilterAlphaMaskedObjects = bool(extraFlags & CommandTypeFlags::DEPTH_FILTER_ALPHA_MASKED_OBJECTS);
+    const bool depthPicking = bool(extraFlags & CommandTypeFlags::DEPTH_PICKING);
 
     auto const* const UTILS_RESTRICT soaWorldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
     auto const* const UTILS_RESTRICT soaReversedWinding = soa.data<FScene::REVERSED_WINDING_ORDER>();
@@ -360,6 +795,8 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
     const bool viewInverseFrontFaces = renderFlags & HAS_INVERSE_FRONT_FACES;
+    const bool hasDepthPrepass = renderFlags & HAS_DEPTH_PREPASS;
+    const bool hasOrderIndependentTransparency = renderFlags & HAS_ORDER_INDEPENDENT_TRANSPARENCY;
 
     Variant materialVariant;
     materialVariant.setDirectionalLighting(renderFlags & HAS_DIRECTIONAL_LIGHT);
@@ -372,9 +809,10 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
 
     Command cmdDepth;
     cmdDepth.primitive.materialVariant = Variant{ Variant::DEPTH_VARIANT };
-    cmdDepth.primitive.materialVariant.setVsm(renderFlags & HAS_VSM);
+    cmdDepth.primitive.materialVariant.setVsm((renderFlags & HAS_VSM) && !depthPicking);
+    cmdDepth.primitive.materialVariant.setPicking(depthPicking);
     cmdDepth.primitive.rasterState = {};
-    cmdDepth.primitive.rasterState.colorWrite = renderFlags & HAS_VSM;
+    cmdDepth.primitive.rasterState.colorWrite = (renderFlags & HAS_VSM) || depthPicking;
     cmdDepth.primitive.rasterState.depthWrite = true;
     cmdDepth.primitive.rasterState.depthFunc = RasterState::DepthFunc::GE;
     cmdDepth.primitive.rasterState.alphaToCoverage = false;
@@ -461,7 +899,38 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
                 RenderPass::setupColorCommand(cmdColor, mi, inverseFrontFaces);
 
                 const bool blendPass = Pass(cmdColor.key & PASS_MASK) == Pass::BLENDED;
-                if (blendPass) {
+                const BlendingMode blendingMode = mi->getMaterial()->getBlendingMode();
+                const bool weightedBlendPass = blendPass & hasOrderIndependentTransparency &
+                        (blendingMode == BlendingMode::TRANSPARENT ||
+                         blendingMode == BlendingMode::FADE);
+                if (UTILS_UNLIKELY(weightedBlendPass)) {
+                    // order-independent transparency pass:
+                    // the weighted blended commands don't depend on their order, so they're
+                    // sorted by material and drawn only once.
+                    cmdColor.key &= PRIORITY_MASK;
+                    cmdColor.key |= uint64_t(Pass::OIT);
+                    cmdColor.key |= uint64_t(CustomCommand::PASS);
+                    cmdColor.key |= mi->getSortingKey();
+                    cmdColor.key |= makeField(cmdColor.primitive.materialVariant.key,
+                            MATERIAL_VARIANT_KEY_MASK, MATERIAL_VARIANT_KEY_SHIFT);
+
+                    // the premultiplied colors are summed and their alphas are multiplied into
+                    // the revealage, i.e. the product of (1 - alpha).
+                    RasterState& rs = cmdColor.primitive.rasterState;
+                    rs.blendFunctionSrcRGB = BlendFunction::ONE;
+                    rs.blendFunctionDstRGB = BlendFunction::ONE;
+                    rs.blendFunctionSrcAlpha = BlendFunction::ZERO;
+                    rs.blendFunctionDstAlpha = BlendFunction::ONE_MINUS_SRC_ALPHA;
+                    rs.depthWrite = false;
+
+                    // TWO_PASSES_TWO_SIDES: both sides are drawn at once
+                    const TransparencyMode mode = mi->getMaterial()->getTransparencyMode();
+                    rs.culling = (mode == TransparencyMode::TWO_PASSES_TWO_SIDES) ?
+                            CullingMode::NONE : rs.culling;
+
+                    curr->key = uint64_t(Pass::SENTINEL);
+                    ++curr;
+                } else if (blendPass) {
                     // TODO: at least for transparent objects, AABB should be per primitive
                     // blend pass:
                     // this will sort back-to-front for blended, and honor explicit ordering
@@ -525,6 +994,18 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
                     cmdColor.key |= makeField(distanceBits >> 22u, Z_BUCKET_MASK,
                             Z_BUCKET_SHIFT);
 
+                    // with a depth prepass, the objects it rendered are already in the depth
+                    // buffer, so only their visible fragments pass the depth test. Materials that
+                    // don't write depth or use their own depth test were not (or might not be)
+                    // rendered the same way by the prepass and are left untouched.
+                    const bool prepassed = hasDepthPrepass
+                            & mi->getMaterial()->getRasterState().depthWrite
+                            & cmdColor.primitive.rasterState.depthWrite
+                            & (cmdColor.primitive.rasterState.depthFunc == SamplerCompareFunc::GE);
+                    cmdColor.primitive.rasterState.depthWrite &= !prepassed;
+                    cmdColor.primitive.rasterState.depthFunc = prepassed ?
+                            SamplerCompareFunc::E : cmdColor.primitive.rasterState.depthFunc;
+
                     curr->key = uint64_t(Pass::SENTINEL);
                     ++curr;
                 }
@@ -540,7 +1021,8 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
                 RasterState rs = ma->getRasterState();
 
                 // unconditionally write the command
-                cmdDepth.primitive.primitiveHandle = primitive.getHwHandle();
+                cmdDepth.primitive.primitiveHandle =
+                        primitive.getDepthHwHandle(ma->getDepthAttributes());
                 cmdDepth.primitive.mi = mi;
                 cmdDepth.primitive.rasterState.culling = mi->getCullingMode();
                 *curr = cmdDepth;
@@ -554,6 +1036,12 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
                         & !(depthFilterAlphaMaskedObjects & rs.alphaToCoverage))
                                 | writeDepthForShadowCasters;
 
+                if (UTILS_UNLIKELY(depthPicking)) {
+                    // all renderables can be picked, including the translucent ones, unless their
+                    // material doesn't have the picking variant (e.g. built before it existed)
+                    issueDepth = ma->hasVariant(cmdDepth.primitive.materialVariant.key);
+                }
+
                 curr->key |= select(!issueDepth);
 
                 // handle the case where this primitive is empty / no-op
@@ -30,6 +30,10 @@
 #include <utils/compiler.h>
 #include <utils/Slice.h>
 
+#include <math/vec3.h>
+
+#include <tsl/robin_map.h>
+
 #include <limits>
 
 namespace utils {
@@ -91,6 +95,7 @@ public:
         COLOR    = uint64_t(0x01) << PASS_SHIFT,
         REFRACT  = uint64_t(0x02) << PASS_SHIFT,
         BLENDED  = uint64_t(0x03) << PASS_SHIFT,
+        OIT      = uint64_t(0x04) << PASS_SHIFT,    // weighted blended transparency
         SENTINEL = 0xffffffffffffffffllu
     };
 
@@ -110,11 +115,18 @@ public:
         DEPTH_FILTER_TRANSLUCENT_OBJECTS = 0x8,
         // alpha-tested objects are not rendered in the depth buffer
         DEPTH_FILTER_ALPHA_MASKED_OBJECTS = 0x10,
+        // the object id of the renderables is written along with the depth (picking variant)
+        DEPTH_PICKING = 0x20,
 
         // generate commands for shadow map
         SHADOW = DEPTH | DEPTH_CONTAINS_SHADOW_CASTERS,
         // generate commands for SSAO
         SSAO = DEPTH | DEPTH_FILTER_TRANSLUCENT_OBJECTS,
+        // generate commands for the depth prepass, i.e. the objects of the color pass that
+        // write depth
+        DEPTH_PREPASS = DEPTH | DEPTH_FILTER_TRANSLUCENT_OBJECTS,
+        // generate commands for the picking queries
+        PICKING = DEPTH | DEPTH_PICKING,
     };
 
 
@@ -152,6 +164,14 @@ public:
     // | correctness                                                            |
     //
     //
+    // OIT command (weighted blended order-independent transparency)
+    // |   6  | 2| 2|1| 3 | 2|  6   |   10     |               32               |
+    // +------+--+--+-+---+--+------+----------+--------------------------------+
+    // |000100|01|00|0|ppp|00|000000|0000000000|          material-id           |
+    // +------+--+--+-+---+--+------+----------+--------------------------------+
+    // | correctness      |      optimizations (truncation allowed)             |
+    //
+    //
     // pre-CUSTOM command
     // |   6  | 2| 2|         22           |               32               |
     // +------+--+--+----------------------+--------------------------------+
@@ -239,7 +259,27 @@ public:
     static constexpr RenderFlags HAS_INVERSE_FRONT_FACES = 0x08;
     static constexpr RenderFlags HAS_FOG                 = 0x10;
     static constexpr RenderFlags HAS_VSM                 = 0x20;
-
+    static constexpr RenderFlags HAS_DEPTH_PREPASS       = 0x40;
+    static constexpr RenderFlags HAS_ORDER_INDEPENDENT_TRANSPARENCY = 0x80;
+
+
+    // Keeps the order of the sorted commands of a pass from a frame to the next, so that
+    // sortCommands() can start from it. Draw commands are identified by their primitive and
+    // their pass.
+    class CommandOrder {
+    public:
+        // forgets the previous order, e.g. after a cut
+        void reset() noexcept { mRanks.clear(); }
+
+    private:
+        friend class RenderPass;
+        void record(Command const* first, Command const* last);
+        static uint64_t getIdentity(Command const& command) noexcept;
+
+        // position of each draw command in the last sorted pass
+        tsl::robin_map<uint64_t, uint32_t> mRanks;
+        math::float3 mCameraForward{};
+    };
 
     RenderPass(FEngine& engine, utils::GrowingSlice<Command> commands) noexcept;
     RenderPass(RenderPass const& rhs);
@@ -272,13 +312,22 @@ public:
     // returns mCommands.end()
     Command* appendCommands(CommandTypeFlags commandTypeFlags) noexcept;
 
+    // Appends commands to 'count' passes concurrently. The passes must have the same geometry
+    // (see setGeometry()), but can differ otherwise, e.g. by their camera or visibility mask.
+    // Each pass gets a new command buffer taken from this pass' command buffer. The passes'
+    // commands still need to be sorted.
+    void appendCommands(RenderPass* const* passes, size_t count,
+            CommandTypeFlags commandTypeFlags) noexcept;
+
     // returns mCommands.end()
     Command* appendCustomCommand(Pass pass, CustomCommand custom, uint32_t order,
             std::function<void()> command);
 
     // sorts commands, then trims sentinels and returns
     // the new mCommands.end()
-    Command* sortCommands() noexcept;
+    // With 'order', the commands are first put in the order of the previous frame, and sorted
+    // in linear time if they're nearly sorted. The new order is then recorded in 'order'.
+    Command* sortCommands(CommandOrder* order = nullptr) noexcept;
 
     void execute(const char* name,
             backend::Handle<backend::HwRenderTarget> renderTarget,
@@ -286,6 +335,16 @@ public:
 
     void executeCommands(const char* name) const noexcept;
 
+    // Records the draw commands of this pass into 'bundle', which must not be valid. The pass
+    // can't have custom commands. The bundle can be replayed with DriverApi::replay() instead
+    // of executeCommands() for as long as this pass would record the same commands, i.e. with
+    // the same primitives, material instances and per-renderable UBO.
+    void recordCommands(backend::CommandBundle& bundle) const noexcept;
+
+    // Returns 'foveation', or no foveation if a material drawn by this pass opts out of it,
+    // because the shading rate can't change within a pass.
+    backend::Foveation getFoveation(backend::Foveation const& foveation) const noexcept;
+
     utils::GrowingSlice<Command>& getCommands() { return mCommands; }
     utils::Slice<Command> const& getCommands() const { return mCommands; }
 
@@ -302,6 +361,27 @@ private:
     static constexpr size_t JOBS_PARALLEL_FOR_COMMANDS_SIZE  =
             sizeof(Command) * JOBS_PARALLEL_FOR_COMMANDS_COUNT;
 
+    // below this many commands, std::sort() beats the radix sort's fixed cost
+    static constexpr size_t RADIX_SORT_MIN_COMMAND_COUNT = 1024;
+
+    // number of commands processed by each radix sort job
+    static constexpr size_t RADIX_SORT_CHUNK_SIZE = 4096;
+
+    // the previous order is ignored when the camera turns more than ~8 degrees
+    static constexpr float COHERENT_SORT_MIN_CAMERA_COS = 0.99f;
+
+    // the insertion sort of the commands in their previous order gives up above this many moves
+    // per command, which happens when too many commands change their place
+    static constexpr size_t COHERENT_SORT_MAX_MOVES_PER_COMMAND = 4;
+    static constexpr size_t RADIX_SORT_MAX_CHUNK_COUNT = 16;
+
+    // runs of draw commands at least this long are recorded in parallel
+    static constexpr size_t PARALLEL_RECORDING_MIN_COMMAND_COUNT = 1024;
+
+    // minimum number of draw commands recorded by each job
+    static constexpr size_t PARALLEL_RECORDING_CHUNK_SIZE = 256;
+    static constexpr size_t PARALLEL_RECORDING_MAX_CHUNK_COUNT = 16;
+
     static_assert(JOBS_PARALLEL_FOR_COMMANDS_SIZE % utils::CACHELINE_SIZE == 0,
             "Size of Commands jobs must be multiple of a cache-line size");
 
@@ -321,6 +401,31 @@ private:
     void recordDriverCommands(FEngine::DriverApi& driver, const Command* first,
             const Command* last) const noexcept;
 
+    // [first, last) must only contain draw commands (i.e. no custom commands)
+    void recordDrawCommands(FEngine::DriverApi& driver, const Command* first,
+            const Command* last) const noexcept;
+
+    void recordDrawCommandsParallel(FEngine::DriverApi& driver, const Command* first,
+            const Command* last) const noexcept;
+
+    // size of the driver commands recorded by recordDrawCommands() for [first, last), this
+    // also creates the programs these commands need
+    static size_t getRecordingSize(const Command* first, const Command* last) noexcept;
+
+    // returns false if there wasn't enough scratch memory, commands are left untouched then
+    bool radixSortCommands(Command* commands, uint32_t count) const noexcept;
+
+    // returns false if the order of the previous frame isn't close enough to the sorted order,
+    // commands are left untouched then
+    bool coherentSortCommands(Command* commands, uint32_t count,
+            CommandOrder& order) const noexcept;
+
+    // maximum number of commands (excluding the sentinel) generated for the renderables in 'vr'
+    static uint32_t getCommandCount(FScene::RenderableSoa const& soa, utils::Range<uint32_t> vr,
+            CommandTypeFlags commandTypeFlags) noexcept;
+
+    Command* appendCommandsImpl(CommandTypeFlags commandTypeFlags) noexcept;
+
     static void updateSummedPrimitiveCounts(
             FScene::RenderableSoa& renderableData, utils::Range<uint32_t> vr) noexcept;
 
@@ -24,11 +24,12 @@
 namespace filament {
 
 void FRenderPrimitive::init(backend::DriverApi& driver,
+        backend::Handle<backend::HwRenderPrimitive> handle,
         const RenderableManager::Builder::Entry& entry) noexcept {
 
     assert(entry.materialInstance);
 
-    mHandle = driver.createRenderPrimitive();
+    mHandle = handle;
     mMaterialInstance = upcast(entry.materialInstance);
     mBlendOrder = entry.blendOrder;
 
@@ -48,12 +49,26 @@ void FRenderPrimitive::init(backend::DriverApi& driver,
 
         mPrimitiveType = entry.type;
         mEnabledAttributes = enabledAttributes;
+
+        if (entry.depthVertices) {
+            FVertexBuffer* depthVertexBuffer = upcast(entry.depthVertices);
+            mDepthAttributes = depthVertexBuffer->getDeclaredAttributes();
+            mDepthHandle = driver.createRenderPrimitive();
+            driver.setRenderPrimitiveBuffer(mDepthHandle, depthVertexBuffer->getHwHandle(), ibh,
+                    (uint32_t)mDepthAttributes.getValue());
+            driver.setRenderPrimitiveRange(mDepthHandle, entry.type,
+                    (uint32_t)entry.offset, (uint32_t)entry.minIndex, (uint32_t)entry.maxIndex,
+                    (uint32_t)entry.count);
+        }
     }
 }
 
-void FRenderPrimitive::terminate(FEngine& engine) {
-    FEngine::DriverApi& driver = engine.getDriverApi();
-    driver.destroyRenderPrimitive(mHandle);
+void FRenderPrimitive::terminate(backend::DriverApi& driver) noexcept {
+    if (mDepthHandle) {
+        driver.destroyRenderPrimitive(mDepthHandle);
+        mDepthHandle.clear();
+        mDepthAttributes = {};
+    }
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type,
@@ -71,6 +86,9 @@ void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType typ
 
     mPrimitiveType = type;
     mEnabledAttributes = enabledAttributes;
+
+    // the depth vertices don't match the new vertices anymore
+    terminate(driver);
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type, size_t offset,
@@ -78,6 +96,10 @@ void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType typ
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.setRenderPrimitiveRange(mHandle, type,
             (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex, (uint32_t)count);
+    if (mDepthHandle) {
+        driver.setRenderPrimitiveRange(mDepthHandle, type,
+                (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex, (uint32_t)count);
+    }
     mPrimitiveType = type;
 }
 
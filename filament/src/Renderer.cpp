@@ -54,8 +54,9 @@ using namespace backend;
 
 FRenderer::FRenderer(FEngine& engine) :
         mEngine(engine),
-        mFrameSkipper(engine, 1u),
+        mFrameSkipper(engine, engine.getConfig().frameLatency),
         mFrameInfoManager(engine),
+        mPassTimer(engine),
         mIsRGB8Supported(false),
         mPerRenderPassArena(engine.getPerRenderPassAllocator())
 {
@@ -64,6 +65,24 @@ FRenderer::FRenderer(FEngine& engine) :
 
     debugRegistry.registerProperty("d.renderer.doFrameCapture",
             &engine.debug.renderer.doFrameCapture);
+
+    // these are statistics, written after each view is rendered
+    debugRegistry.registerProperty("d.framegraph.pass_count",
+            &engine.debug.framegraph.pass_count);
+    debugRegistry.registerProperty("d.framegraph.culled_pass_count",
+            &engine.debug.framegraph.culled_pass_count);
+    debugRegistry.registerProperty("d.framegraph.execute_ms",
+            &engine.debug.framegraph.execute_ms);
+    debugRegistry.registerProperty("d.framegraph.slowest_pass_ms",
+            &engine.debug.framegraph.slowest_pass_ms);
+    debugRegistry.registerProperty("d.draws.draw_count",
+            &engine.debug.draws.draw_count);
+    debugRegistry.registerProperty("d.draws.pipeline_change_count",
+            &engine.debug.draws.pipeline_change_count);
+    debugRegistry.registerProperty("d.draws.uniform_bind_count",
+            &engine.debug.draws.uniform_bind_count);
+    debugRegistry.registerProperty("d.draws.sampler_bind_count",
+            &engine.debug.draws.sampler_bind_count);
 }
 
 void FRenderer::init() noexcept {
@@ -131,6 +150,7 @@ void FRenderer::terminate(FEngine& engine) {
         engine.execute();
     }
     mFrameInfoManager.terminate();
+    mPassTimer.terminate();
 }
 
 void FRenderer::resetUserTime() {
@@ -167,26 +187,79 @@ void FRenderer::render(FView const* view) {
     }
 
     if (UTILS_LIKELY(view && view->getScene())) {
-        // per-renderpass data
-        ArenaScope rootArena(mPerRenderPassArena);
+        renderInternal(view);
+    }
+}
+
+void FRenderer::renderCleared(FView const* view, float4 const& clearColor) {
+    // the clear flags are initialized from the options for each new render target, and set
+    // explicitly for the ones already rendered into this frame
+    const ClearOptions options = mClearOptions;
+    const TargetBufferFlags clearFlags = mClearFlags;
+    const TargetBufferFlags discardedFlags = mDiscardedFlags;
+    mClearOptions.clearColor = clearColor;
+    mClearOptions.clear = true;
+    mClearFlags |= TargetBufferFlags::COLOR;
+    mDiscardedFlags |= TargetBufferFlags::COLOR;
+    render(view);
+    mClearOptions = options;
+    mClearFlags = clearFlags;
+    mDiscardedFlags = discardedFlags;
+}
+
+void FRenderer::renderStandaloneView(FView const* view) {
+    SYSTRACE_CALL();
+
+    if (!ASSERT_PRECONDITION_NON_FATAL(!mSwapChain,
+            "renderStandaloneView() must be called outside of beginFrame() / endFrame()")) {
+        return;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(view->getRenderTarget(),
+            "View \"%s\" must have a RenderTarget", view->getName())) {
+        return;
+    }
 
-        FEngine& engine = mEngine;
-        JobSystem& js = engine.getJobSystem();
+    if (UTILS_LIKELY(view->getScene())) {
+        FEngine& engine = getEngine();
+        FEngine::DriverApi& driver = engine.getDriverApi();
 
-        // create a root job so no other job can escape
-        auto *rootJob = js.setRootJob(js.createJob());
+        // A frame of its own, without a SwapChain to present or FrameSkipper to wait for: the
+        // command buffer is what throttles the CPU when it's too far ahead of the GPU.
+        mFrameId++;
+        initializeClearFlags();
+        mPreviousRenderTargets.clear();
+        driver.beginFrame(std::chrono::steady_clock::now().time_since_epoch().count(), mFrameId);
+        engine.prepare();
 
-        // execute the render pass
-        renderJob(rootArena, const_cast<FView&>(*view));
+        renderInternal(view);
 
-        // make sure to flush the command buffer
-        engine.flush();
+        driver.endFrame(mFrameId);
 
-        // and wait for all jobs to finish as a safety (this should be a no-op)
-        js.runAndWait(rootJob);
+        // gives the backend a chance to execute periodic tasks, e.g. complete the read-backs
+        driver.tick();
     }
 }
 
+void FRenderer::renderInternal(FView const* view) {
+    // per-renderpass data
+    ArenaScope rootArena(mPerRenderPassArena);
+
+    FEngine& engine = mEngine;
+    JobSystem& js = engine.getJobSystem();
+
+    // create a root job so no other job can escape
+    auto *rootJob = js.setRootJob(js.createJob());
+
+    // execute the render pass
+    renderJob(rootArena, const_cast<FView&>(*view));
+
+    // make sure to flush the command buffer
+    engine.flush();
+
+    // and wait for all jobs to finish as a safety (this should be a no-op)
+    js.runAndWait(rootJob);
+}
+
 void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     FEngine& engine = getEngine();
     JobSystem& js = engine.getJobSystem();
@@ -222,7 +295,23 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
         scale = 1.0f;
     }
 
+    // In stereo, the commands are issued once per eye in each half of the color buffer, which
+    // the screen-space effects (and the depth prepass) don't know about.
+    const bool stereo = view.isStereoEnabled();
+    if (stereo) {
+        aoOptions.enabled = false;
+        dofOptions.enabled = false;
+        taaOptions.enabled = false;
+    }
+    const bool depthPrepass = view.isDepthPrepassEnabled() && !stereo;
+    const bool autoExposure = hasPostProcess && view.getAutoExposureOptions().enabled;
+
     const bool scaled = any(notEqual(scale, float2(1.0f)));
+    if (view.getDynamicResolutionOptions().enabled) {
+        mFrameInfoManager.setRenderScale(scale.x * scale.y);
+    }
+    // with TAA upscaling, TAA outputs the full resolution image
+    const bool taaUpscaling = scaled && taaOptions.enabled && taaOptions.upscaling;
     filament::Viewport svp = vp.scale(scale);
     if (svp.empty()) {
         return;
@@ -234,7 +323,7 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
         initializeClearFlags();
     }
 
-    view.prepare(engine, driver, arena, svp, getShaderUserTime());
+    view.prepare(engine, driver, arena, svp, getShaderUserTime(), mFrameId);
 
     // start froxelization immediately, it has no dependencies
     JobSystem::Job* jobFroxelize = js.runAndRetain(js.createJob(nullptr,
@@ -259,6 +348,10 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     if (view.hasFog())                     renderFlags |= RenderPass::HAS_FOG;
     if (view.isFrontFaceWindingInverted()) renderFlags |= RenderPass::HAS_INVERSE_FRONT_FACES;
     if (view.hasVsm())                     renderFlags |= RenderPass::HAS_VSM;
+    if (depthPrepass)                      renderFlags |= RenderPass::HAS_DEPTH_PREPASS;
+    if (view.hasOrderIndependentTransparency()) {
+        renderFlags |= RenderPass::HAS_ORDER_INDEPENDENT_TRANSPARENCY;
+    }
     pass.setRenderFlags(renderFlags);
 
     /*
@@ -307,7 +400,8 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     const bool blending = !hasCustomRenderTarget && blendModeTranslucent;
     // If the swapchain is transparent or if we blend into it, we need to allocate our intermediate
     // buffers with an alpha channel.
-    const bool needsAlphaChannel = mSwapChain->isTransparent() || blendModeTranslucent;
+    const bool needsAlphaChannel =
+            (mSwapChain && mSwapChain->isTransparent()) || blendModeTranslucent;
     const TextureFormat hdrFormat = getHdrFormat(view, needsAlphaChannel);
 
     const ColorPassConfig config{
@@ -321,17 +415,21 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
             .hasContactShadows = scene.hasContactShadows()
     };
 
-    // asSubpass is disabled with TAA (although it's supported) because performance was degraded
+    // asSubpass only allows the FrameGraph to merge color grading into the color pass, which it
+    // does when nothing else needs the color buffer (e.g. no bloom, DoF or MSAA resolve).
+    // It's disabled with TAA (although it's supported) because performance was degraded
     // on qualcomm hardware -- we might need a backend dependent toggle at some point
+    // With FXAA, color grading runs as a full pass instead, which applies FXAA as well: that's one
+    // pass over the color buffer instead of a subpass followed by a separate FXAA pass.
     const PostProcessManager::ColorGradingConfig colorGradingConfig{
-            .asSubpass =
-                    colorGrading &&
-                    msaa <= 1 && !bloomOptions.enabled && !dofOptions.enabled && !taaOptions.enabled &&
+            .asSubpass = colorGrading && !fxaa && !taaOptions.enabled && !stereo &&
+                    !view.hasOrderIndependentTransparency() &&
+                    !view.hasScreenSpaceReflections() && !autoExposure &&
                     driver.isFrameBufferFetchSupported(),
             .translucent = needsAlphaChannel,
             .fxaa = fxaa,
             .dithering = dithering,
-            .ldrFormat = (colorGrading && fxaa) ? TextureFormat::RGBA8 : getLdrFormat(needsAlphaChannel)
+            .ldrFormat = getLdrFormat(needsAlphaChannel)
     };
 
     /*
@@ -343,6 +441,7 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     pass.setCamera(cameraInfo);
     pass.setGeometry(scene.getRenderableData(), view.getVisibleRenderables(), scene.getRenderableUBO());
     view.updatePrimitivesLod(engine, cameraInfo, scene.getRenderableData(), view.getVisibleRenderables());
+    view.updateTextureStreaming(engine, cameraInfo, scene.getRenderableData(), view.getVisibleRenderables());
 
     fg.addTrivialSideEffectPass("Prepare View Uniforms", [svp, &view] (DriverApi& driver) {
         CameraInfo cameraInfo = view.getCameraInfo();
@@ -356,18 +455,49 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     // Currently it consists of a simple depth pass.
     // This is normally used by SSAO and contact-shadows
 
-    // TODO: this should be a FrameGraph pass to participate to automatic culling
-    pass.newCommandBuffer();
-    pass.appendCommands(RenderPass::CommandTypeFlags::SSAO);
-    pass.sortCommands();
+    // With a depth prepass, the structure pass is skipped when it would render the same depth
+    // buffer, i.e. at full resolution and without MSAA. The color pass can't sample the buffer it
+    // renders into though, which rules out contact shadows.
+    const bool structureIsDepthPrepass = depthPrepass && msaa <= 1 &&
+            aoOptions.resolution == 1.0f && !scene.hasContactShadows() &&
+            svp.width >= 32 && svp.height >= 32;
+
+    // the hi-z pyramid of the structure pass is shared by occlusion culling and the screen-space
+    // reflections
+    OcclusionCuller* const occlusionCuller =
+            view.isOcclusionCullingEnabled() ? &view.getOcclusionCuller() : nullptr;
+    const bool hasHiZ = occlusionCuller || view.hasScreenSpaceReflections();
+
+    if (!structureIsDepthPrepass) {
+        // TODO: this should be a FrameGraph pass to participate to automatic culling
+        pass.newCommandBuffer();
+        pass.appendCommands(RenderPass::CommandTypeFlags::SSAO);
+        pass.sortCommands(view.getCommandOrder(FView::SortedPass::STRUCTURE));
+
+        // TODO: the scaling should depends on all passes that need the structure pass
+        ppm.structure(fg, pass, svp.width, svp.height, aoOptions.resolution);
+
+        if (hasHiZ) {
+            // the hi-z buffer read back here is used to cull the following frames
+            ppm.hizPyramid(fg, occlusionCuller, cameraInfo);
+        }
+    }
 
-    // TODO: the scaling should depends on all passes that need the structure pass
-    ppm.structure(fg, pass, svp.width, svp.height, aoOptions.resolution);
+    // --------------------------------------------------------------------------------------------
+    // picking pass -- renders the object ids of the renderables at the picked pixels, with the
+    // camera that isn't jittered
+
+    if (view.hasPickingQueries()) {
+        pass.newCommandBuffer();
+        pass.appendCommands(RenderPass::CommandTypeFlags::PICKING);
+        pass.sortCommands();
+        pickingPass(fg, config, pass, view);
+    }
 
     // Apply the TAA jitter to everything after the structure pass, starting with the color pass.
     if (taaOptions.enabled) {
         auto& history = view.getFrameHistory();
-        ppm.prepareTaa(history, cameraInfo, taaOptions);
+        ppm.prepareTaa(history, cameraInfo, taaOptions, scale);
         // convert the sample position to jitter in clip-space
         float2 jitterInClipSpace =
                 history.getCurrent().jitter * (2.0f / float2{ svp.width, svp.height });
@@ -380,12 +510,43 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
         });
     }
 
+    // --------------------------------------------------------------------------------------------
+    // depth prepass -- renders the depth buffer of the color pass, with the same (jittered) camera
+
+    if (depthPrepass) {
+        pass.newCommandBuffer();
+        pass.appendCommands(RenderPass::CommandTypeFlags::DEPTH_PREPASS);
+        pass.sortCommands(view.getCommandOrder(FView::SortedPass::DEPTH_PREPASS));
+
+        if (structureIsDepthPrepass) {
+            FrameGraphId<FrameGraphTexture> structure =
+                    ppm.structure(fg, pass, svp.width, svp.height, 1.0f);
+            fg.getBlackboard()["depth"] = structure;
+
+            if (hasHiZ) {
+                ppm.hizPyramid(fg, occlusionCuller, cameraInfo);
+            }
+        } else {
+            depthPrepassPass(fg, config, pass);
+        }
+    }
+
     // --------------------------------------------------------------------------------------------
     // SSAO pass
 
     if (aoOptions.enabled) {
         // we could rely on FrameGraph culling, but this creates unnecessary CPU work
-        ppm.screenSpaceAmbientOcclusion(fg, pass, svp, cameraInfo, aoOptions);
+        // with TAA, the AO samples vary each frame
+        ppm.screenSpaceAmbientOcclusion(fg, pass, svp, cameraInfo, aoOptions,
+                taaOptions.enabled ? view.getFrameHistory().getCurrent().frameId : 0);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    // SSR pass -- traced into the previous frame, before the color passes which sample it
+
+    if (view.hasScreenSpaceReflections()) {
+        ppm.screenSpaceReflections(fg, view.getFrameHistory(), cameraInfo,
+                view.getScreenSpaceReflectionsOptions());
     }
 
     // --------------------------------------------------------------------------------------------
@@ -394,16 +555,15 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     // TODO: ideally this should be a FrameGraph pass to participate to automatic culling
     pass.newCommandBuffer();
     pass.appendCommands(RenderPass::COLOR);
-    pass.sortCommands();
+    pass.sortCommands(view.getCommandOrder(FView::SortedPass::COLOR));
 
     FrameGraphTexture::Descriptor desc = {
             .width = config.svp.width,
             .height = config.svp.height,
-            .format = config.hdrFormat
+            .format = config.hdrFormat,
+            // the hint is dropped unless the color buffer is only read by a subpass
+            .usage = TextureUsage::TRANSIENT_ATTACHMENT
     };
-    if (colorGradingConfig.asSubpass) {
-        desc.usage |= backend::TextureUsage::SUBPASS_INPUT;
-    }
 
     // a non-drawing pass to prepare everything that need to be before the color passes execute
     fg.addTrivialSideEffectPass("Prepare Color Passes",
@@ -428,18 +588,49 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
             }
     );
 
-    // color-grading as subpass is done either by the color pass or the TAA pass if any
-    auto colorGradingConfigForColor = colorGradingConfig;
-    colorGradingConfigForColor.asSubpass = colorGradingConfigForColor.asSubpass && !taaOptions.enabled;
+    // the weighted blended commands are sorted last and rendered after the color passes
+    Command const* const oit = std::partition_point(pass.begin(), pass.end(),
+            [](auto const& command) {
+                return (command.key & RenderPass::PASS_MASK) < uint64_t(RenderPass::Pass::OIT);
+            });
+
+    RenderPass colorPasses(pass);
+    colorPasses.getCommands().set(
+            const_cast<Command*>(pass.begin()),
+            const_cast<Command*>(oit));
+
+    // the color pass + refraction, color grading might be merged into the latter
+    FrameGraphId<FrameGraphTexture> colorPassOutput;
+    if (view.isScreenSpaceRefractionEnabled() && !stereo) {
+        colorPassOutput = refractionPass(fg, config, colorGradingConfig, colorPasses, view);
+    }
 
-    // the color pass itself + color-grading as subpass if needed
-    FrameGraphId<FrameGraphTexture> colorPassOutput = colorPass(fg, "Color Pass",
-            desc, config, colorGradingConfigForColor, pass, view);
+    // the color pass itself, color grading might be merged into it as a subpass
+    if (!colorPassOutput.isValid()) {
+        colorPassOutput = colorPass(fg, "Color Pass",
+                desc, config, colorGradingConfig, colorPasses, view);
+    }
 
-    // the color pass + refraction + color-grading as subpass if needed
-    // this cancels the colorPass() call above if refraction is active.
-    if (view.isScreenSpaceRefractionEnabled()) {
-        colorPassOutput = refractionPass(fg, config, colorGradingConfigForColor, pass, view);
+    if (UTILS_UNLIKELY(oit != pass.end())) {
+        RenderPass transparentPass(pass);
+        transparentPass.getCommands().set(
+                const_cast<Command*>(oit),
+                const_cast<Command*>(pass.end()));
+        colorPassOutput = orderIndependentTransparencyPass(fg, config, transparentPass, view,
+                colorPassOutput);
+    }
+
+    if (view.hasScreenSpaceReflections()) {
+        // the color is saved with the camera of the color passes, i.e. jittered with TAA
+        ppm.screenSpaceReflectionsHistory(fg, colorPassOutput, view.getFrameHistory(),
+                cameraInfo.projection * cameraInfo.view * cameraInfo.worldOrigin);
+    }
+
+    if (autoExposure) {
+        // applied before TAA, bloom and DoF, which all work with the compensated colors
+        colorPassOutput = ppm.autoExposure(fg, colorPassOutput, view.getFrameHistory(),
+                view.getAutoExposureOptions(),
+                std::chrono::duration<double>(engine.getEngineTime()).count());
     }
 
     FrameGraphId<FrameGraphTexture> input = colorPassOutput;
@@ -463,9 +654,13 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     // TAA for color pass
     if (taaOptions.enabled) {
-        input = ppm.taa(fg, input, view.getFrameHistory(), taaOptions, colorGradingConfig);
+        input = ppm.taa(fg, input, view.getFrameHistory(), taaOptions, colorGradingConfig,
+                taaUpscaling ? vp.width : svp.width, taaUpscaling ? vp.height : svp.height);
     }
 
+    // the passes following TAA upscaling are at the full resolution
+    const float2 postProcessScale = taaUpscaling ? float2(1.0f) : scale;
+
     // --------------------------------------------------------------------------------------------
     // Post Processing...
 
@@ -474,20 +669,16 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
             input = ppm.dof(fg, input, dofOptions, needsAlphaChannel, cameraInfo);
         }
         if (colorGrading) {
-            if (!colorGradingConfig.asSubpass) {
-                input = ppm.colorGrading(fg, input,
-                        view.getColorGrading(),
-                        colorGradingConfig.ldrFormat,
-                        colorGradingConfig.translucent,
-                        colorGradingConfig.fxaa,
-                        scale, bloomOptions, vignetteOptions,
-                        colorGradingConfig.dithering);
-            }
+            input = ppm.colorGrading(fg, input,
+                    view.getColorGrading(),
+                    colorGradingConfig,
+                    postProcessScale, bloomOptions, vignetteOptions);
         }
-        if (fxaa) {
-            input = ppm.fxaa(fg, input, colorGradingConfig.ldrFormat, !colorGrading || needsAlphaChannel);
+        if (fxaa && !colorGrading) {
+            // otherwise FXAA was applied by the color grading pass
+            input = ppm.fxaa(fg, input, colorGradingConfig.ldrFormat, true);
         }
-        if (scaled) {
+        if (scaled && !taaUpscaling) {
             if (UTILS_LIKELY(!blending && upscalingQuality == View::QualityLevel::LOW)) {
                 input = ppm.opaqueBlit(fg, input, { .format = colorGradingConfig.ldrFormat });
             } else {
@@ -504,13 +695,10 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     //   intermediate buffer when MSAA is enabled.
     // * We also need an extra buffer for blending the result to the framebuffer if the view
     //   is translucent.
-    // * And we can't use the default rendertarget if MRT is required (e.g. with color grading
-    //   as a subpass)
     // The intermediate buffer is accomplished with a "fake" opaqueBlit (i.e. blit) operation.
 
     const bool outputIsInput = fg.equal(input, colorPassOutput);
-    if ((outputIsInput && viewRenderTarget == mRenderTarget &&
-                    (msaa > 1 || colorGradingConfig.asSubpass)) ||
+    if ((outputIsInput && viewRenderTarget == mRenderTarget && msaa > 1) ||
         (!outputIsInput && blending)) {
         if (UTILS_LIKELY(!blending && upscalingQuality == View::QualityLevel::LOW)) {
             input = ppm.opaqueBlit(fg, input, { .format = colorGradingConfig.ldrFormat });
@@ -525,7 +713,14 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     fg.moveResource(fgViewRenderTarget, output);
     fg.compile();
     //fg.export_graphviz(slog.d, view.getName());
-    fg.execute(engine, driver);
+    fg.execute(engine, driver, mPassTimer.isTiming() ? &mPassTimer : nullptr);
+
+    // expose the frame graph statistics of the last view rendered
+    auto const& fgStats = fg.getStats();
+    engine.debug.framegraph.pass_count = int(fgStats.passCount);
+    engine.debug.framegraph.culled_pass_count = int(fgStats.culledPassCount);
+    engine.debug.framegraph.execute_ms = fgStats.executeTime;
+    engine.debug.framegraph.slowest_pass_ms = fgStats.slowestPassTime;
 
     // save the current history entry and destroy the oldest entry
     view.commitFrameHistory(engine);
@@ -540,7 +735,7 @@ FrameGraphId<FrameGraphTexture> FRenderer::refractionPass(FrameGraph& fg,
         FView const& view) const noexcept {
 
     auto& blackboard = fg.getBlackboard();
-    auto input = blackboard.get<FrameGraphTexture>("color");
+    FrameGraphId<FrameGraphTexture> input;
     FrameGraphId<FrameGraphTexture> output;
 
     // find the first refractive object
@@ -554,10 +749,6 @@ FrameGraphId<FrameGraphTexture> FRenderer::refractionPass(FrameGraph& fg,
 
     if (UTILS_UNLIKELY(hasScreenSpaceRefraction)) {
         PostProcessManager& ppm = mEngine.getPostProcessManager();
-        // clear the color/depth buffers, which will orphan (and cull) the color pass
-        input.clear();
-        blackboard.remove("color");
-        blackboard.remove("depth");
 
         RenderPass opaquePass(pass);
         opaquePass.getCommands().set(
@@ -571,12 +762,6 @@ FrameGraphId<FrameGraphTexture> FRenderer::refractionPass(FrameGraph& fg,
                 .format = config.hdrFormat
         };
 
-        // The opaque pass never uses subpasses, but the transparent pass might.
-        // Therefore we need to set up the usage flag here, before the color texture is created.
-        if (colorGradingConfig.asSubpass) {
-            desc.usage |= backend::TextureUsage::SUBPASS_INPUT;
-        }
-
         input = colorPass(fg, "Color Pass (opaque)", desc, config,
                 { .asSubpass = false }, opaquePass, view);
 
@@ -650,16 +835,15 @@ FrameGraphId<FrameGraphTexture> FRenderer::refractionPass(FrameGraph& fg,
         output = colorPass(fg, "Color Pass (transparent)",
                 desc, config, colorGradingConfig, translucentPass, view);
 
-        if (config.msaa > 1 && !colorGradingConfig.asSubpass) {
+        if (config.msaa > 1) {
             // We need to do a resolve here because later passes (such as color grading or DoF) will need
             // to sample from 'output'. However, because we have MSAA, we know we're not sampleable.
             // And this is because in the SSR case, we had to use a renderbuffer to conserve the
             // multi-sample buffer.
             output = ppm.resolve(fg, "Resolved Color Buffer", output);
         }
-    } else {
-        output = input;
     }
+    // without refractive objects, output is invalid and the regular color pass is used instead
     return output;
 }
 
@@ -671,10 +855,10 @@ FrameGraphId<FrameGraphTexture> FRenderer::colorPass(FrameGraph& fg, const char*
     struct ColorPassData {
         FrameGraphId<FrameGraphTexture> shadows;
         FrameGraphId<FrameGraphTexture> color;
-        FrameGraphId<FrameGraphTexture> output;
         FrameGraphId<FrameGraphTexture> depth;
         FrameGraphId<FrameGraphTexture> ssao;
         FrameGraphId<FrameGraphTexture> ssr;
+        FrameGraphId<FrameGraphTexture> reflections;
         FrameGraphId<FrameGraphTexture> structure;
         FrameGraphRenderTargetHandle rt{};
         float4 clearColor{};
@@ -691,6 +875,7 @@ FrameGraphId<FrameGraphTexture> FRenderer::colorPass(FrameGraph& fg, const char*
                 data.shadows = blackboard.get<FrameGraphTexture>("shadows");
                 data.ssr  = blackboard.get<FrameGraphTexture>("ssr");
                 data.ssao = blackboard.get<FrameGraphTexture>("ssao");
+                data.reflections = blackboard.get<FrameGraphTexture>("reflections");
                 data.color = blackboard.get<FrameGraphTexture>("color");
                 data.depth = blackboard.get<FrameGraphTexture>("depth");
                 data.structure = blackboard.get<FrameGraphTexture>("structure");
@@ -712,6 +897,10 @@ FrameGraphId<FrameGraphTexture> FRenderer::colorPass(FrameGraph& fg, const char*
                     data.ssao = builder.sample(data.ssao);
                 }
 
+                if (data.reflections.isValid()) {
+                    data.reflections = builder.sample(data.reflections);
+                }
+
                 if (!data.color.isValid()) {
                     // we're allocating a new buffer, so its content is undefined and we might need
                     // to clear it.
@@ -744,17 +933,14 @@ FrameGraphId<FrameGraphTexture> FRenderer::colorPass(FrameGraph& fg, const char*
                             // sample automatically -- which is what we want.
                             .samples = colorBufferDesc.samples,
                             .format = TextureFormat::DEPTH32F,
+                            // the hint is dropped if a later pass needs the depth buffer
+                            .usage = TextureUsage::TRANSIENT_ATTACHMENT
                     });
                 }
 
                 if (colorGradingConfig.asSubpass) {
-                    data.output = builder.createTexture("Tonemapped Buffer", {
-                            .width = colorBufferDesc.width,
-                            .height = colorBufferDesc.height,
-                            .format = colorGradingConfig.ldrFormat
-                    });
-                    data.output = builder.write(data.output);
-                    data.color = builder.read(data.color);
+                    // color grading can then be merged into this pass
+                    builder.allowSubpass();
                 }
 
                 data.color = builder.write(builder.read(data.color));
@@ -763,7 +949,7 @@ FrameGraphId<FrameGraphTexture> FRenderer::colorPass(FrameGraph& fg, const char*
                 blackboard["depth"] = data.depth;
 
                 data.rt = builder.createRenderTarget("Color Pass Target", {
-                        .attachments = {{ data.color, data.output, {}, {}}, data.depth, {}},
+                        .attachments = { data.color, data.depth },
                         .samples = config.msaa,
                         .clearFlags = clearColorFlags | clearDepthFlags });
             },
@@ -786,43 +972,257 @@ FrameGraphId<FrameGraphTexture> FRenderer::colorPass(FrameGraph& fg, const char*
                     view.prepareStructure(structure ? structure : ppm.getOneTexture());
                 }
 
+                // without reflections (e.g. in the first frame), their confidence is zero
+                view.prepareScreenSpaceReflections(data.reflections.isValid() ?
+                        resources.getTexture(data.reflections) : ppm.getZeroTexture());
+
                 // TODO: check what getTexture() returns
                 if (data.ssr.isValid()) {
                     view.prepareSSR(resources.getTexture(data.ssr), config.refractionLodOffset);
                 }
 
-                view.prepareViewport(static_cast<filament::Viewport&>(out.params.viewport));
-                view.commitUniforms(driver);
-
                 out.params.clearColor = data.clearColor;
 
-                if (colorGradingConfig.asSubpass) {
-                    out.params.subpassMask = 1;
-                    driver.beginRenderPass(out.target, out.params);
-                    pass.executeCommands(resources.getPassName());
-                    ppm.colorGradingSubpass(driver, colorGradingConfig.translucent);
-                } else {
-                    driver.beginRenderPass(out.target, out.params);
-                    pass.executeCommands(resources.getPassName());
+                View::FoveationOptions const foveationOptions = view.getFoveationOptions();
+                if (foveationOptions.enabled) {
+                    out.params.foveation = pass.getFoveation({
+                            .center = foveationOptions.center,
+                            .gain = foveationOptions.gain,
+                            .area = foveationOptions.area });
                 }
 
-                driver.endRenderPass();
+                if (UTILS_UNLIKELY(view.isStereoEnabled())) {
+                    renderStereo(driver, out, pass, resources.getPassName(), view);
+                    driver.flush();
+                    return;
+                }
 
-                // color pass is typically heavy and we don't have much CPU work left after
-                // this point, so flushing now allows us to start the GPU earlier and reduce
-                // latency, without creating bubbles.
-                driver.flush();
+                view.prepareViewport(static_cast<filament::Viewport&>(out.params.viewport));
+                view.commitUniforms(driver);
+
+                driver.beginRenderPass(out.target, out.params);
+                pass.executeCommands(resources.getPassName());
+
+                // otherwise the subpass merged into this pass ends the render pass
+                if (!resources.hasSubpass()) {
+                    driver.endRenderPass();
+
+                    // color pass is typically heavy and we don't have much CPU work left after
+                    // this point, so flushing now allows us to start the GPU earlier and reduce
+                    // latency, without creating bubbles.
+                    driver.flush();
+                }
             }
     );
 
-    // when color grading is done as a subpass, the output of the color-pass is the ldr buffer
-    auto output = colorGradingConfig.asSubpass ?
-            colorPass.getData().output : colorPass.getData().color;
+    auto output = colorPass.getData().color;
 
     fg.getBlackboard()["color"] = output;
     return output;
 }
 
+FrameGraphId<FrameGraphTexture> FRenderer::orderIndependentTransparencyPass(FrameGraph& fg,
+        ColorPassConfig const& config, RenderPass const& pass, FView const& view,
+        FrameGraphId<FrameGraphTexture> input) const noexcept {
+
+    struct OrderIndependentTransparencyData {
+        FrameGraphId<FrameGraphTexture> shadows;
+        FrameGraphId<FrameGraphTexture> ssao;
+        FrameGraphId<FrameGraphTexture> reflections;
+        FrameGraphId<FrameGraphTexture> structure;
+        FrameGraphId<FrameGraphTexture> accumulation;
+        FrameGraphId<FrameGraphTexture> weight;
+        FrameGraphId<FrameGraphTexture> depth;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // The transparent objects are accumulated in two buffers, with the blending set up by
+    // RenderPass and the weights computed by their materials:
+    // - accumulation, rgb: sum of the weighted premultiplied colors, a: product of (1 - alpha)
+    // - weight, r: sum of the weighted alphas
+    auto& oitPass = fg.addPass<OrderIndependentTransparencyData>(
+            "Order-Independent Transparency Pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                Blackboard& blackboard = fg.getBlackboard();
+                data.shadows = blackboard.get<FrameGraphTexture>("shadows");
+                data.ssao = blackboard.get<FrameGraphTexture>("ssao");
+                data.reflections = blackboard.get<FrameGraphTexture>("reflections");
+                data.structure = blackboard.get<FrameGraphTexture>("structure");
+                data.depth = blackboard.get<FrameGraphTexture>("depth");
+                assert(data.depth.isValid());
+
+                if (config.hasContactShadows) {
+                    assert(data.structure.isValid());
+                    data.structure = builder.sample(data.structure);
+                }
+                if (data.shadows.isValid()) {
+                    data.shadows = builder.sample(data.shadows);
+                }
+                if (data.ssao.isValid()) {
+                    data.ssao = builder.sample(data.ssao);
+                }
+                if (data.reflections.isValid()) {
+                    data.reflections = builder.sample(data.reflections);
+                }
+
+                data.accumulation = builder.createTexture("OIT Accumulation Buffer", {
+                        .width = config.svp.width,
+                        .height = config.svp.height,
+                        .format = TextureFormat::RGBA16F });
+                data.weight = builder.createTexture("OIT Weight Buffer", {
+                        .width = config.svp.width,
+                        .height = config.svp.height,
+                        .format = TextureFormat::R16F });
+
+                data.accumulation = builder.write(data.accumulation);
+                data.weight = builder.write(data.weight);
+                // the depth buffer is only tested, the transparent objects don't write it
+                data.depth = builder.write(builder.read(data.depth));
+
+                data.rt = builder.createRenderTarget("OIT Target", {
+                        .attachments = {{ data.accumulation, data.weight, {}, {} }, data.depth, {}},
+                        .samples = config.msaa,
+                        .clearFlags = TargetBufferFlags::COLOR0 | TargetBufferFlags::COLOR1 });
+            },
+            [=, &view](FrameGraphPassResources const& resources, auto const& data,
+                    DriverApi& driver) {
+                auto out = resources.get(data.rt);
+
+                PostProcessManager& ppm = getEngine().getPostProcessManager();
+                view.prepareSSAO(data.ssao.isValid() ?
+                        resources.getTexture(data.ssao) : ppm.getOneTexture());
+                view.prepareShadow(data.shadows.isValid() ?
+                        resources.getTexture(data.shadows) : ppm.getOneTextureArray());
+                view.prepareScreenSpaceReflections(data.reflections.isValid() ?
+                        resources.getTexture(data.reflections) : ppm.getZeroTexture());
+                if (data.structure.isValid()) {
+                    const auto& structure = resources.getTexture(data.structure);
+                    view.prepareStructure(structure ? structure : ppm.getOneTexture());
+                }
+                view.prepareViewport(static_cast<filament::Viewport&>(out.params.viewport));
+                view.commitUniforms(driver);
+
+                // the revealage starts at 1, the sums at 0
+                out.params.clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+                pass.execute(resources.getPassName(), out.target, out.params);
+            });
+
+    auto const& data = oitPass.getData();
+    fg.getBlackboard()["depth"] = data.depth;
+
+    PostProcessManager& ppm = getEngine().getPostProcessManager();
+    auto output = ppm.orderIndependentTransparencyComposite(fg, input,
+            data.accumulation, data.weight);
+    fg.getBlackboard()["color"] = output;
+    return output;
+}
+
+void FRenderer::renderStereo(DriverApi& driver, FrameGraphRenderTarget out,
+        RenderPass const& pass, const char* name, FView const& view) noexcept {
+    // Each eye is a render pass in its half of the target, the right eye's loads what the left
+    // eye rendered and is the only one to honor the discard flags at the end.
+    filament::Viewport const viewport = static_cast<filament::Viewport&>(out.params.viewport);
+    const TargetBufferFlags discardEnd = out.params.flags.discardEnd;
+    out.params.flags.discardEnd = TargetBufferFlags::NONE;
+
+    CameraInfo const* const cameras[2] = { &view.getCameraInfo(), &view.getRightEyeCameraInfo() };
+    for (size_t eye = 0; eye < 2; eye++) {
+        if (eye == 1) {
+            out.params.flags.clear = TargetBufferFlags::NONE;
+            out.params.flags.discardStart = TargetBufferFlags::NONE;
+            out.params.flags.discardEnd = discardEnd;
+        }
+        out.params.viewport = FView::getEyeViewport(viewport, eye);
+        view.prepareCamera(*cameras[eye]);
+        view.prepareViewport(static_cast<filament::Viewport&>(out.params.viewport));
+        view.commitUniforms(driver);
+
+        driver.beginRenderPass(out.target, out.params);
+        pass.executeCommands(name);
+        driver.endRenderPass();
+    }
+
+    // the following passes see the left eye's camera and the whole viewport
+    view.prepareCamera(view.getCameraInfo());
+    view.prepareViewport(viewport);
+    view.commitUniforms(driver);
+}
+
+void FRenderer::depthPrepassPass(FrameGraph& fg, ColorPassConfig const& config,
+        RenderPass const& pass) const noexcept {
+
+    struct DepthPrepassData {
+        FrameGraphId<FrameGraphTexture> depth;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& depthPrepass = fg.addPass<DepthPrepassData>("Depth Prepass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                // The color pass tests against the depth of each sample, so with MSAA the depth
+                // buffer must keep its samples instead of being resolved.
+                data.depth = builder.createTexture("Depth Buffer", {
+                        .width = config.svp.width,
+                        .height = config.svp.height,
+                        .samples = config.msaa,
+                        .format = TextureFormat::DEPTH32F });
+
+                data.depth = builder.write(builder.read(data.depth));
+
+                data.rt = builder.createRenderTarget("Depth Prepass Target", {
+                        .attachments = {{}, data.depth },
+                        .samples = config.msaa,
+                        .clearFlags = TargetBufferFlags::DEPTH
+                });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                auto out = resources.get(data.rt);
+                pass.execute(resources.getPassName(), out.target, out.params);
+            });
+
+    // the color passes render into this depth buffer without clearing it
+    fg.getBlackboard()["depth"] = depthPrepass.getData().depth;
+}
+
+void FRenderer::pickingPass(FrameGraph& fg, ColorPassConfig const& config,
+        RenderPass const& pass, FView& view) const noexcept {
+
+    struct PickingPassData {
+        FrameGraphId<FrameGraphTexture> picking;
+        FrameGraphId<FrameGraphTexture> depth;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // Each query renders into a single texel, with the viewport offset so that the texel covers
+    // the picked pixel: the bounds of the target act as a scissor and the fragments elsewhere
+    // are never shaded. The texel is read back by the driver without stalling.
+    for (FView::PickingQuery* query : view.takePickingQueries()) {
+        const int32_t x = int32_t(float(query->x) * config.scale.x);
+        const int32_t y = int32_t(float(query->y) * config.scale.y);
+        fg.addPass<PickingPassData>("Picking Pass",
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    data.picking = builder.createTexture("Picking Buffer", {
+                            .width = 1, .height = 1, .format = TextureFormat::RGBA32UI });
+                    data.depth = builder.createTexture("Picking Depth Buffer", {
+                            .width = 1, .height = 1, .format = TextureFormat::DEPTH32F });
+                    data.picking = builder.write(data.picking);
+                    data.depth = builder.write(data.depth);
+                    data.rt = builder.createRenderTarget("Picking Target", {
+                            .attachments = { data.picking, data.depth },
+                            .viewport = { -x, -y, config.svp.width, config.svp.height },
+                            .clearFlags = TargetBufferFlags::COLOR | TargetBufferFlags::DEPTH
+                    });
+                    // nothing reads the picking buffer in the graph, the readback is our output
+                    builder.sideEffect();
+                },
+                [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                    auto out = resources.get(data.rt);
+                    pass.execute(resources.getPassName(), out.target, out.params);
+                    driver.readPixels(out.target, 0, 0, 1, 1,
+                            FView::getPickingQueryBuffer(query));
+                });
+    }
+}
+
 void FRenderer::copyFrame(FSwapChain* dstSwapChain, filament::Viewport const& dstViewport,
         filament::Viewport const& srcViewport, CopyFrameFlag flags) {
     SYSTRACE_CALL();
@@ -933,6 +1333,13 @@ bool FRenderer::beginFrame(FSwapChain* swapChain, uint64_t vsyncSteadyClockTimeN
         }
         driver.beginFrame(appVsync.time_since_epoch().count(), mFrameId);
 
+        // the passes of the frame can't be timed if the whole frame is
+        if (mPassTimer.beginFrame(mFrameId)) {
+            PassTimer::Timings const& timings = mPassTimer.getLastTimings();
+            mFrameInfoManager.setFrameTimings(timings.frameId, timings.gpuTime,
+                    timings.fixedGpuTime, timings.driverThreadTime);
+        }
+
         // This need to occur after the backend beginFrame() because some backends need to start
         // a command buffer before creating a fence.
         mFrameInfoManager.beginFrame({
@@ -941,36 +1348,26 @@ bool FRenderer::beginFrame(FSwapChain* swapChain, uint64_t vsyncSteadyClockTimeN
                 },
                 .headRoomRatio = mFrameRateOptions.headRoomRatio,
                 .oneOverTau = mFrameRateOptions.scaleRate,
-                .historySize = mFrameRateOptions.history
-        }, mFrameId);
+                .historySize = mFrameRateOptions.history,
+                .controller = mFrameRateOptions.controller
+        }, mFrameId, !mPassTimer.isTiming());
 
-        if (false && vsyncSteadyClockTimeNano) { // work in progress
+        if (mFrameRateOptions.adaptiveLatency && vsyncSteadyClockTimeNano &&
+                mDisplayInfo.refreshRate > 0.0f) {
             const size_t interval = mFrameRateOptions.interval; // user requested swap-interval;
             const steady_clock::duration refreshPeriod(uint64_t(1e9 / mDisplayInfo.refreshRate));
-            const steady_clock::duration presentationDeadline(mDisplayInfo.presentationDeadlineNanos);
             const steady_clock::duration vsyncOffset(mDisplayInfo.vsyncOffsetNanos);
 
             // hardware vsync timestamp
             steady_clock::time_point hwVsync = appVsync - vsyncOffset;
 
-            // compute our desired presentation time. We can't pick a desired presentation time
-            // that's too far, or we won't be able to dequeue buffers.
-            steady_clock::time_point desiredPresentationTime = hwVsync + 2 * interval * refreshPeriod;
-
-            // Compute the deadline. This deadline is when the GPU must be finished.
-            // The deadline has 1ms backed in it on Android.
-            UTILS_UNUSED_IN_RELEASE
-            steady_clock::time_point deadline = desiredPresentationTime - presentationDeadline;
-
-            // one important thing is to make sure that the deadline is comfortably later than
-            // when the gpu will finish, otherwise we'll have inconsistent latency/frames.
-
-            // TODO: evaluate if we can make it in time, and if not why.
-            // If the problem is cpu+gpu latency we can try to push the desired presentation time
-            // further away, but this has limits, as only 2 buffers are dequeuable.
-            // If the problem is the gpu is overwhelmed, then we need to
-            //  - see if there is more headroom in dynamic resolution
-            //  - or start skipping frames. Ideally lower the framerate too.
+            // The frame can be presented once the frames in flight before it have been, so we
+            // ask for it one interval after them. Asking for it sooner would only make it wait
+            // in the queue, asking later would add latency. The latency can't be more than 3
+            // frames, so the desired presentation time is never too far to dequeue buffers.
+            const size_t latency = mFrameSkipper.getLatency();
+            steady_clock::time_point desiredPresentationTime =
+                    hwVsync + (latency + 1) * interval * refreshPeriod;
 
             // presentation time is set to the middle of the period we're interested in
             steady_clock::time_point presentationTime = desiredPresentationTime - refreshPeriod / 2;
@@ -1016,6 +1413,7 @@ void FRenderer::endFrame() {
     }
 
     mFrameInfoManager.endFrame();
+    mPassTimer.endFrame();
     mFrameSkipper.endFrame();
 
     if (mSwapChain) {
@@ -1025,6 +1423,13 @@ void FRenderer::endFrame() {
 
     driver.endFrame(mFrameId);
 
+    // expose the draw statistics of the last frame the backend finished executing
+    backend::DrawStatistics const drawStats = engine.getDriver().getDrawStatistics();
+    engine.debug.draws.draw_count = int(drawStats.drawCount);
+    engine.debug.draws.pipeline_change_count = int(drawStats.pipelineChangeCount);
+    engine.debug.draws.uniform_bind_count = int(drawStats.uniformBufferBindCount);
+    engine.debug.draws.sampler_bind_count = int(drawStats.samplerBindCount);
+
     // gives the backend a chance to execute periodic tasks
     driver.tick();
 
@@ -1036,6 +1441,7 @@ void FRenderer::endFrame() {
 
     // do this before engine.flush()
     engine.getResourceAllocator().gc();
+    engine.processDeferredDestructions();
 
     // Run the component managers' GC in parallel
     // WARNING: while doing this we can't access any component manager
@@ -1047,6 +1453,13 @@ void FRenderer::endFrame() {
 
     // make sure we're done with the gcs
     js.waitAndRelease(job);
+
+    // between frames is the only time the command buffer can be replaced
+    engine.growCommandBufferIfNeeded();
+
+#if defined(UTILS_PERF_CAPTURE)
+    PerfCapture::endFrame();
+#endif
 }
 
 void FRenderer::readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
@@ -1060,6 +1473,16 @@ void FRenderer::readPixels(FRenderTarget* renderTarget,
     readPixels(renderTarget->getHwHandle(), xoffset, yoffset, width, height, std::move(buffer));
 }
 
+void FRenderer::readPixels(ReadPixelsRequest* requests, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        ReadPixelsRequest& request = requests[i];
+        readPixels(request.renderTarget ?
+                        upcast(request.renderTarget)->getHwHandle() : mRenderTarget,
+                request.xoffset, request.yoffset, request.width, request.height,
+                std::move(request.buffer));
+    }
+}
+
 void FRenderer::readPixels(Handle<HwRenderTarget> renderTargetHandle,
         uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         backend::PixelBufferDescriptor&& buffer) {
@@ -1125,6 +1548,10 @@ void Renderer::render(View const* view) {
     upcast(this)->render(upcast(view));
 }
 
+void Renderer::renderStandaloneView(View const* view) {
+    upcast(this)->renderStandaloneView(upcast(view));
+}
+
 bool Renderer::beginFrame(SwapChain* swapChain, uint64_t vsyncSteadyClockTimeNano) {
     return upcast(this)->beginFrame(upcast(swapChain), vsyncSteadyClockTimeNano, nullptr, nullptr);
 }
@@ -1151,6 +1578,10 @@ void Renderer::readPixels(RenderTarget* renderTarget,
             xoffset, yoffset, width, height, std::move(buffer));
 }
 
+void Renderer::readPixels(ReadPixelsRequest* requests, size_t count) {
+    upcast(this)->readPixels(requests, count);
+}
+
 void Renderer::endFrame() {
     upcast(this)->endFrame();
 }
@@ -1175,4 +1606,8 @@ void Renderer::setClearOptions(const ClearOptions& options) {
     upcast(this)->setClearOptions(options);
 }
 
+void Renderer::setFrameTimingsCallback(FrameTimingsCallback callback, void* user) noexcept {
+    upcast(this)->setFrameTimingsCallback(callback, user);
+}
+
 } // namespace filament
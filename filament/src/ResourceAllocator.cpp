@@ -21,6 +21,10 @@
 #include "details/Texture.h"
 
 #include <utils/Log.h>
+#include <utils/Systrace.h>
+
+#include <map>
+#include <tuple>
 
 using namespace utils;
 
@@ -28,37 +32,6 @@ namespace filament {
 
 using namespace backend;
 
-// ------------------------------------------------------------------------------------------------
-
-template<typename K, typename V, typename H>
-UTILS_NOINLINE
-typename ResourceAllocator::AssociativeContainer<K, V, H>::iterator
-ResourceAllocator::AssociativeContainer<K, V, H>::erase(iterator it) {
-    return mContainer.erase(it);
-}
-
-template<typename K, typename V, typename H>
-typename ResourceAllocator::AssociativeContainer<K, V, H>::const_iterator
-ResourceAllocator::AssociativeContainer<K, V, H>::find(key_type const& key) const {
-    return const_cast<AssociativeContainer*>(this)->find(key);
-}
-
-template<typename K, typename V, typename H>
-UTILS_NOINLINE
-typename ResourceAllocator::AssociativeContainer<K, V, H>::iterator
-ResourceAllocator::AssociativeContainer<K, V, H>::find(key_type const& key) {
-    return std::find_if(mContainer.begin(), mContainer.end(), [&key](auto const& v) {
-        return v.first == key;
-    });
-}
-
-template<typename K, typename V, typename H>
-template<typename... ARGS>
-UTILS_NOINLINE
-void ResourceAllocator::AssociativeContainer<K, V, H>::emplace(ARGS&& ... args) {
-    mContainer.emplace_back(std::forward<ARGS>(args)...);
-}
-
 // ------------------------------------------------------------------------------------------------
 ResourceAllocatorInterface::~ResourceAllocatorInterface() = default;
 
@@ -77,8 +50,9 @@ size_t ResourceAllocator::TextureKey::getSize() const noexcept {
     return size;
 }
 
-ResourceAllocator::ResourceAllocator(DriverApi& driverApi) noexcept
-        : mBackend(driverApi) {
+ResourceAllocator::ResourceAllocator(DriverApi& driverApi, size_t cacheCapacity,
+        size_t cacheMaxAge) noexcept
+        : mBackend(driverApi), mCacheCapacity(cacheCapacity), mCacheMaxAge(cacheMaxAge) {
 }
 
 ResourceAllocator::~ResourceAllocator() noexcept {
@@ -89,9 +63,18 @@ ResourceAllocator::~ResourceAllocator() noexcept {
 void ResourceAllocator::terminate() noexcept {
     assert(!mInUseTextures.size());
     auto& textureCache = mTextureCache;
-    for (auto it = textureCache.begin(); it != textureCache.end();) {
-        mBackend.destroyTexture(it->second.handle);
-        it = textureCache.erase(it);
+    const size_t count = textureCache.size();
+    if (count) {
+        // destroy the whole cache with a single command
+        auto* handles = mBackend.allocatePod<TextureHandle>(count);
+        size_t i = 0;
+        for (auto const& item : textureCache) {
+            handles[i++] = item.second.handle;
+        }
+        mBackend.destroyTextures(handles, uint32_t(count));
+        textureCache.clear();
+        mTextureCacheIndex.clear();
+        mCacheSize = 0;
     }
 }
 
@@ -131,19 +114,24 @@ backend::TextureHandle ResourceAllocator::createTexture(const char* name,
     // do we have a suitable texture in the cache?
     TextureHandle handle;
     if (mEnabled) {
-        auto& textureCache = mTextureCache;
         const TextureKey key{ name, target, levels, format, samples, width, height, depth, usage };
-        auto it = textureCache.find(key);
-        if (UTILS_LIKELY(it != textureCache.end())) {
+        auto it = mTextureCacheIndex.find(key);
+        if (UTILS_LIKELY(it != mTextureCacheIndex.end())) {
             // we do, move the entry to the in-use list, and remove from the cache
-            handle = it->second.handle;
-            mCacheSize -= it->second.size;
-            textureCache.erase(it);
+            CacheList::iterator pos = it->second;
+            handle = pos->second.handle;
+            mCacheSize -= pos->second.size;
+            mTextureCacheIndex.erase(it);
+            mTextureCache.erase(pos);
+            mHits++;
         } else {
             // we don't, allocate a new texture and populate the in-use list
             handle = mBackend.createTexture(
                     target, levels, format, samples, width, height, depth, usage);
+            mMisses++;
         }
+        mInUseSize += key.getSize();
+        mInUsePeak = std::max(mInUsePeak, mInUseSize);
         mInUseTextures.emplace(handle, key);
     } else {
         handle = mBackend.createTexture(
@@ -158,12 +146,15 @@ void ResourceAllocator::destroyTexture(TextureHandle h) noexcept {
         auto it = mInUseTextures.find(h);
         assert(it != mInUseTextures.end());
 
-        // move it to the cache
+        // move it to the cache, as the most recently used entry
         const TextureKey key = it->second;
         uint32_t size = key.getSize();
 
-        mTextureCache.emplace(key, TextureCachePayload{ h, mAge, size });
+        auto pos = mTextureCache.emplace(mTextureCache.end(),
+                key, TextureCachePayload{ h, mAge, size });
+        mTextureCacheIndex.emplace(key, pos);
         mCacheSize += size;
+        mInUseSize -= size;
 
         // remove it from the in-use list
         mInUseTextures.erase(it);
@@ -178,79 +169,87 @@ void ResourceAllocator::gc() noexcept {
     // increase our age
     const size_t age = mAge++;
 
+    mLastInUsePeak = mInUsePeak;
+    mInUsePeak = mInUseSize;
+
     // Purging strategy:
     //  - remove entries that are older than a certain age
     //      - remove only one entry per gc(),
     //      - unless we're at capacity
     // - remove LRU entries until we're below capacity
+    //
+    // The cache is sorted from the least recently used entry, so we only ever look at its front.
 
     auto& textureCache = mTextureCache;
-    for (auto it = textureCache.begin(); it != textureCache.end();) {
-        const size_t ageDiff = age - it->second.age;
-        if (ageDiff >= CACHE_MAX_AGE) {
-            it = purge(it);
-            if (mCacheSize < CACHE_CAPACITY) {
-                // if we're not at capacity, only purge a single entry per gc, trying to
-                // avoid a burst of work.
-                break;
-            }
-        } else {
-            ++it;
-        }
+    if (!textureCache.empty() && age - textureCache.front().second.age >= mCacheMaxAge) {
+        purge(textureCache.begin());
     }
-
-    if (UTILS_UNLIKELY(mCacheSize >= CACHE_CAPACITY)) {
-        // make a copy of our cache to a vector
-        std::vector<std::pair<TextureKey, TextureCachePayload>> cache;
-        cache.reserve(textureCache.size());
-        for (auto const& item : textureCache) {
-            cache.push_back(item);
-        }
-
-        // sort by least recently used
-        std::sort(cache.begin(), cache.end(), [](auto const& lhs, auto const& rhs) {
-            return lhs.second.age < rhs.second.age;
-        });
-
-        // now remove entries until we're at capacity
-        auto curr = cache.begin();
-        while (mCacheSize >= CACHE_CAPACITY) {
-            // by construction this entry must exist
-            purge(textureCache.find(curr->first));
-            ++curr;
-        }
-
-        // Since we're sorted already, reset the oldestAge of the whole system
-        size_t oldestAge = cache.front().second.age;
-        for (auto& it : textureCache) {
-            it.second.age -= oldestAge;
-        }
-        mAge -= oldestAge;
+    while (UTILS_UNLIKELY(mCacheSize >= mCacheCapacity) && !textureCache.empty()) {
+        purge(textureCache.begin());
     }
+
+    SYSTRACE_CONTEXT();
+    SYSTRACE_VALUE64("resourceCacheSize", mCacheSize);
+    SYSTRACE_VALUE64("resourceInUseSize", mInUseSize);
     //if (mAge % 60 == 0) dump();
 }
 
+ResourceAllocator::Stats ResourceAllocator::getStats() const noexcept {
+    return {
+            .cacheSize = mCacheSize,
+            .cacheCount = mTextureCache.size(),
+            .inUseSize = mInUseSize,
+            .inUsePeak = mLastInUsePeak,
+            .hits = mHits,
+            .misses = mMisses,
+            .evictions = mEvictions
+    };
+}
+
 UTILS_NOINLINE
 void ResourceAllocator::dump(bool brief) const noexcept {
-    slog.d << "# entries=" << mTextureCache.size() << ", sz=" << mCacheSize / float(1u << 20u)
-           << " MiB" << io::endl;
+    constexpr float MiB = 1u << 20u;
+    slog.d << "# entries=" << mTextureCache.size() << ", sz=" << mCacheSize / MiB << " MiB"
+           << ", in use=" << mInUseTextures.size() << " (" << mInUseSize / MiB << " MiB)"
+           << ", hits=" << mHits << ", misses=" << mMisses << ", evictions=" << mEvictions
+           << io::endl;
     if (!brief) {
+        // group the cached textures by format and size, this is what decides whether they're
+        // reused
+        struct Group {
+            size_t count = 0;
+            size_t size = 0;
+        };
+        std::map<std::tuple<TextureFormat, uint32_t, uint32_t, uint8_t>, Group> groups;
         for (auto const& it : mTextureCache) {
-            auto w = it.first.width;
-            auto h = it.first.height;
-            auto f = FTexture::getFormatSize(it.first.format);
-            slog.d << it.first.name << ": w=" << w << ", h=" << h << ", f=" << f << ", sz="
-                   << it.second.size / float(1u << 20u) << io::endl;
+            TextureKey const& key = it.first;
+            Group& group = groups[{ key.format, key.width, key.height, key.samples }];
+            group.count++;
+            group.size += it.second.size;
+        }
+        for (auto const& it : groups) {
+            slog.d << "format=" << uint32_t(std::get<0>(it.first))
+                   << ": w=" << std::get<1>(it.first) << ", h=" << std::get<2>(it.first)
+                   << ", samples=" << +std::get<3>(it.first)
+                   << ", count=" << it.second.count
+                   << ", sz=" << it.second.size / MiB << io::endl;
         }
     }
 }
 
-ResourceAllocator::CacheContainer::iterator ResourceAllocator::purge(
-        ResourceAllocator::CacheContainer::iterator const& pos) {
+void ResourceAllocator::purge(CacheList::iterator pos) noexcept {
     //slog.d << "purging " << pos->second.handle.getId() << ", age=" << pos->second.age << io::endl;
+    auto range = mTextureCacheIndex.equal_range(pos->first);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == pos) {
+            mTextureCacheIndex.erase(it);
+            break;
+        }
+    }
     mBackend.destroyTexture(pos->second.handle);
     mCacheSize -= pos->second.size;
-    return mTextureCache.erase(pos);
+    mEvictions++;
+    mTextureCache.erase(pos);
 }
 
 } // namespace filament
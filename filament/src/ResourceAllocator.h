@@ -25,7 +25,8 @@
 
 #include <utils/Hash.h>
 
-#include <vector>
+#include <list>
+#include <unordered_map>
 
 #include <stdint.h>
 
@@ -60,7 +61,13 @@ protected:
 
 class ResourceAllocator final : public ResourceAllocatorInterface {
 public:
-    explicit ResourceAllocator(backend::DriverApi& driverApi) noexcept;
+    // by default, the cache holds up to 64 MiB of textures unused for at most 30 gc() calls
+    static constexpr size_t DEFAULT_CACHE_CAPACITY = 64u << 20u;
+    static constexpr size_t DEFAULT_CACHE_MAX_AGE  = 30u;
+
+    explicit ResourceAllocator(backend::DriverApi& driverApi,
+            size_t cacheCapacity = DEFAULT_CACHE_CAPACITY,
+            size_t cacheMaxAge = DEFAULT_CACHE_MAX_AGE) noexcept;
     ~ResourceAllocator() noexcept override;
 
     void terminate() noexcept;
@@ -85,11 +92,22 @@ public:
 
     void gc() noexcept;
 
-private:
-    // TODO: these should be settings of the engine
-    static constexpr size_t CACHE_CAPACITY = 64u << 20u;   // 64 MiB
-    static constexpr size_t CACHE_MAX_AGE  = 30u;
+    struct Stats {
+        size_t cacheSize;       // bytes of the unused textures kept in the cache
+        size_t cacheCount;      // number of unused textures kept in the cache
+        size_t inUseSize;       // bytes of the textures currently handed out
+        size_t inUsePeak;       // largest inUseSize between the last two gc(), i.e. in a frame
+        size_t hits;            // textures created from the cache
+        size_t misses;          // textures created by the backend
+        size_t evictions;       // textures destroyed because of the cache age or capacity
+    };
+
+    Stats getStats() const noexcept;
 
+    // logs the statistics and the content of the cache, grouped by format and size
+    void dump(bool brief = false) const noexcept;
+
+private:
     struct TextureKey {
         const char* name; // doesn't participate in the hash
         backend::SamplerType target;
@@ -149,42 +167,30 @@ private:
         }
     };
 
-    inline void dump(bool brief = false) const noexcept;
-
-    template<typename Key, typename Value, typename Hasher = Hasher<Key>>
-    class AssociativeContainer {
-        // We use a std::vector instead of a std::multimap because we don't expect many items
-        // in the cache and std::multimap generates tons of code. Even with more items, we
-        // could improve this trivially by using a sorted std::vector.
-        using Container = std::vector<std::pair<Key, Value>>;
-        Container mContainer;
-    public:
-        using iterator = typename Container::iterator;
-        using const_iterator = typename Container::const_iterator;
-        using key_type = typename Container::value_type::first_type;
-        using value_type = typename Container::value_type::second_type;
-
-        size_t size() const { return mContainer.size(); }
-        iterator begin() { return mContainer.begin(); }
-        const_iterator begin() const { return mContainer.begin(); }
-        iterator end() { return mContainer.end(); }
-        const_iterator end() const  { return mContainer.end(); }
-        iterator erase(iterator it);
-        const_iterator find(key_type const& key) const;
-        iterator find(key_type const& key);
-        template<typename ... ARGS>
-        void emplace(ARGS&&... args);
-    };
-
-    using CacheContainer = AssociativeContainer<TextureKey, TextureCachePayload>;
+    // The cache entries are kept from the least to the most recently used, since they're always
+    // added with the current age. The index lets us find an entry from its key in O(1).
+    using CacheList = std::list<std::pair<TextureKey, TextureCachePayload>>;
+    using CacheIndex = std::unordered_multimap<TextureKey, CacheList::iterator,
+            Hasher<TextureKey>>;
+    using InUseContainer = std::unordered_map<backend::TextureHandle, TextureKey,
+            Hasher<backend::TextureHandle>>;
 
-    CacheContainer::iterator purge(CacheContainer::iterator const& pos);
+    void purge(CacheList::iterator pos) noexcept;
 
     backend::DriverApi& mBackend;
-    CacheContainer mTextureCache;
-    AssociativeContainer<backend::TextureHandle, TextureKey> mInUseTextures;
+    CacheList mTextureCache;
+    CacheIndex mTextureCacheIndex;
+    InUseContainer mInUseTextures;
+    const size_t mCacheCapacity;
+    const size_t mCacheMaxAge;
     size_t mAge = 0;
-    uint32_t mCacheSize = 0;
+    size_t mCacheSize = 0;
+    size_t mInUseSize = 0;
+    size_t mInUsePeak = 0;
+    size_t mLastInUsePeak = 0;
+    size_t mHits = 0;
+    size_t mMisses = 0;
+    size_t mEvictions = 0;
     const bool mEnabled = true;
 };
 
@@ -25,12 +25,19 @@
 #include "details/IndirectLight.h"
 #include "details/Skybox.h"
 
+#include <math/simd.h>
+
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
+#include <utils/Panic.h>
 #include <utils/Range.h>
+#include <utils/Systrace.h>
 #include <utils/Zip2Iterator.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 
 using namespace filament::math;
 using namespace utils;
@@ -46,16 +53,30 @@ FScene::FScene(FEngine& engine) :
 FScene::~FScene() noexcept = default;
 
 
-void FScene::prepare(const mat4f& worldOriginTransform) {
+void FScene::prepare(const mat4f& worldOriginTransform, uint32_t frameId) {
+    SYSTRACE_NAME("FScene::prepare");
+
     // TODO: can we skip this in most cases? Since we rely on indices staying the same,
     //       we could only skip, if nothing changed in the RCM.
 
     FEngine& engine = mEngine;
-    EntityManager& em = engine.getEntityManager();
     FRenderableManager& rcm = engine.getRenderableManager();
     FTransformManager& tcm = engine.getTransformManager();
     FLightManager& lcm = engine.getLightManager();
-    // go through the list of entities, and gather the data of those that are renderables
+
+    // the bounding boxes that follow the bones must be up-to-date before they're gathered below
+    rcm.updateDynamicBounds(engine.getJobSystem());
+
+    // When another View of this frame already prepared the scene with the same world origin,
+    // and nothing changed since, the renderables and lights it found are reused. Only the
+    // data the Views reorder is restored.
+    const bool reused = mPreparedFrameValid && mPreparedFrameId == frameId &&
+            mPreparedSceneVersion == mVersion &&
+            mPreparedLightVersion == lcm.getVersion() &&
+            tcm.getRenderVersion() == mPreparedTransformVersion &&
+            rcm.getVersion() == mPreparedRenderableVersion &&
+            worldOriginTransform == mPreparedWorldOrigin;
+
     auto& sceneData = mRenderableData;
     auto& lightData = mLightData;
     auto const& entities = mEntities;
@@ -64,34 +85,202 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
     // NOTE: we can't know in advance how many entities are renderable or lights because the corresponding
     // component can be added after the entity is added to the scene.
 
-    size_t renderableDataCapacity = entities.size();
-    // we need the capacity to be multiple of 16 for SIMD loops
-    renderableDataCapacity = (renderableDataCapacity + 0xFu) & ~0xFu;
+    // SoA arrays are padded to a multiple of 16 elements, which the SIMD loops rely on.
+    // The capacities grow geometrically, so that a growing scene isn't reallocated every frame.
+
     // we need 1 extra entry at the end for the summed primitive count
-    renderableDataCapacity = renderableDataCapacity + 1;
+    const size_t renderableDataCapacity = entities.size() + 1;
 
     sceneData.clear();
-    if (sceneData.capacity() < renderableDataCapacity) {
-        sceneData.setCapacity(renderableDataCapacity);
-    }
+    sceneData.ensureCapacity(renderableDataCapacity);
 
     // The light data list will always contain at least one entry for the
     // dominating directional light, even if there are no entities.
-    size_t lightDataCapacity = std::max<size_t>(1, entities.size());
-    // we need the capacity to be multiple of 16 for SIMD loops
-    lightDataCapacity = (lightDataCapacity + 0xFu) & ~0xFu;
+    const size_t lightDataCapacity = std::max<size_t>(1, entities.size());
 
     lightData.clear();
-    if (lightData.capacity() < lightDataCapacity) {
-        lightData.setCapacity(lightDataCapacity);
+    lightData.ensureCapacity(lightDataCapacity);
+
+    if (reused) {
+        auto const& preparedLightData = mPreparedLightData;
+        const size_t lightCount = preparedLightData.size();
+        lightData.resize(lightCount);
+        std::copy_n(preparedLightData.data<POSITION_RADIUS>(), lightCount,
+                lightData.data<POSITION_RADIUS>());
+        std::copy_n(preparedLightData.data<DIRECTION>(), lightCount,
+                lightData.data<DIRECTION>());
+        std::copy_n(preparedLightData.data<LIGHT_INSTANCE>(), lightCount,
+                lightData.data<LIGHT_INSTANCE>());
+    } else {
+        gatherEntities(worldOriginTransform);
+    }
+
+    // Nothing needs to be computed again if neither the list of renderables, nor their
+    // components, nor the world origin changed since the last prepare().
+    auto const& renderables = mPreparedRenderables;
+    const size_t count = renderables.size();
+    auto const& lastRenderables = mLastPreparedRenderables;
+    const bool unchanged = reused || (mPreparedData.size() == count &&
+            tcm.getRenderVersion() == mPreparedTransformVersion &&
+            rcm.getVersion() == mPreparedRenderableVersion &&
+            worldOriginTransform == mPreparedWorldOrigin &&
+            std::equal(renderables.begin(), renderables.end(),
+                    lastRenderables.begin(), lastRenderables.end(),
+                    [](PreparedRenderable const& lhs, PreparedRenderable const& rhs) {
+                        return lhs.renderable == rhs.renderable && lhs.transform == rhs.transform;
+                    }));
+    mPreparedTransformVersion = tcm.getRenderVersion();
+    mPreparedRenderableVersion = rcm.getVersion();
+    mPreparedLightVersion = lcm.getVersion();
+    mPreparedSceneVersion = mVersion;
+    mPreparedWorldOrigin = worldOriginTransform;
+    mPreparedFrameId = frameId;
+    mPreparedFrameValid = true;
+
+    if (!unchanged) {
+        // renderables we didn't have before must have their UBO computed
+        const size_t previousCount = std::min(mPreparedData.size(), count);
+        mPreparedData.resize(count);
+        mUboCache.resize(count);
+        mUboDirty.resize(count);
+        std::fill(mUboDirty.begin() + previousCount, mUboDirty.end(), 1);
+    }
+
+    // we know there is enough space in the array
+    sceneData.resize(count);
+
+    // this job runs on multiple threads, each chunk covers at least a cache line of every array
+    auto& preparedData = mPreparedData;
+    uint8_t* const UTILS_RESTRICT uboDirty = mUboDirty.data();
+    auto functor = [&sceneData, &preparedData, &rcm, &tcm, &worldOriginTransform, unchanged,
+            uboDirty, prepared = renderables.data(), count](uint32_t chunk, uint32_t c) {
+        const size_t first = chunk * PREPARE_CHUNK_SIZE;
+        const size_t last = std::min(count, size_t(chunk + c) * PREPARE_CHUNK_SIZE);
+        if (!unchanged) {
+            for (size_t i = first; i < last; i++) {
+                auto const ri = prepared[i].renderable;
+                auto const ti = prepared[i].transform;
+
+                // get the world transform
+                const mat4f worldTransform =
+                        simd::multiply(worldOriginTransform, tcm.getRenderWorldTransform(ti));
+                const bool reversedWindingOrder = det(worldTransform.upperLeft()) < 0;
+
+                // skinning and per-instance transforms are mutually exclusive and share a binding
+                auto bonesUbh = rcm.getBonesUbh(ri);
+                if (UTILS_UNLIKELY(!bonesUbh)) {
+                    bonesUbh = rcm.getInstancesUbh(ri);
+                }
+
+                const FRenderableManager::Visibility visibility = rcm.getVisibility(ri);
+                const float4 morphWeights = rcm.getMorphWeights(ri);
+
+                // the UBO of this renderable only needs updating if what goes in it changed
+                FRenderableManager::Visibility const& previous =
+                        preparedData.elementAt<VISIBILITY_STATE>(i);
+                if (preparedData.elementAt<RENDERABLE_INSTANCE>(i) != ri ||
+                        preparedData.elementAt<WORLD_TRANSFORM>(i) != worldTransform ||
+                        preparedData.elementAt<MORPH_WEIGHTS>(i) != morphWeights ||
+                        previous.skinning != visibility.skinning ||
+                        previous.morphing != visibility.morphing ||
+                        previous.screenSpaceContactShadows !=
+                                visibility.screenSpaceContactShadows) {
+                    uboDirty[i] = 1;
+                }
+
+                preparedData.elementAt<RENDERABLE_INSTANCE>(i)     = ri;
+                preparedData.elementAt<WORLD_TRANSFORM>(i)         = worldTransform;
+                preparedData.elementAt<REVERSED_WINDING_ORDER>(i)  = reversedWindingOrder;
+                preparedData.elementAt<VISIBILITY_STATE>(i)        = visibility;
+                preparedData.elementAt<BONES_UBH>(i)               = bonesUbh;
+                preparedData.elementAt<INSTANCE_COUNT>(i)          =
+                        uint16_t(rcm.getInstanceCount(ri));
+                preparedData.elementAt<MORPH_WEIGHTS>(i)           = morphWeights;
+                preparedData.elementAt<LAYERS>(i)                  = rcm.getLayerMask(ri);
+
+                // the local AABB, transformed below
+                Box const& aabb = rcm.getAABB(ri);
+                preparedData.elementAt<WORLD_AABB_CENTER>(i)       = aabb.center;
+                preparedData.elementAt<WORLD_AABB_EXTENT>(i)       = aabb.halfExtent;
+            }
+
+            // compute the world AABBs so we can perform culling, in a single pass over the
+            // streams the culler reads
+            simd::rigidTransform(
+                    preparedData.data<WORLD_AABB_CENTER>() + first,
+                    preparedData.data<WORLD_AABB_EXTENT>() + first,
+                    preparedData.data<WORLD_TRANSFORM>() + first, last - first);
+        }
+
+        // the scene data is reordered by the views, so it always starts from the prepared data
+        auto copy = [&](auto const* src, auto* dst) {
+            std::copy(src + first, src + last, dst + first);
+        };
+        copy(preparedData.data<RENDERABLE_INSTANCE>(),  sceneData.data<RENDERABLE_INSTANCE>());
+        copy(preparedData.data<WORLD_TRANSFORM>(),      sceneData.data<WORLD_TRANSFORM>());
+        copy(preparedData.data<REVERSED_WINDING_ORDER>(),
+                sceneData.data<REVERSED_WINDING_ORDER>());
+        copy(preparedData.data<VISIBILITY_STATE>(),     sceneData.data<VISIBILITY_STATE>());
+        copy(preparedData.data<BONES_UBH>(),            sceneData.data<BONES_UBH>());
+        copy(preparedData.data<INSTANCE_COUNT>(),       sceneData.data<INSTANCE_COUNT>());
+        copy(preparedData.data<WORLD_AABB_CENTER>(),    sceneData.data<WORLD_AABB_CENTER>());
+        copy(preparedData.data<MORPH_WEIGHTS>(),        sceneData.data<MORPH_WEIGHTS>());
+        copy(preparedData.data<LAYERS>(),               sceneData.data<LAYERS>());
+        copy(preparedData.data<WORLD_AABB_EXTENT>(),    sceneData.data<WORLD_AABB_EXTENT>());
+        uint32_t* const UTILS_RESTRICT indices = sceneData.data<PREPARED_INDEX>();
+        for (size_t i = first; i < last; i++) {
+            indices[i] = uint32_t(i);
+        }
+    };
+
+    const uint32_t chunkCount = uint32_t((count + PREPARE_CHUNK_SIZE - 1) / PREPARE_CHUNK_SIZE);
+    JobSystem& js = engine.getJobSystem();
+    auto* job = jobs::parallel_for(js, nullptr, 0, chunkCount,
+            std::ref(functor), jobs::CountSplitter<PREPARE_MIN_CHUNK_COUNT, 8>());
+    js.runAndWait(job);
+
+    // some elements past the end of the array will be accessed by SIMD code, we need to make
+    // sure the data is valid enough as not to produce errors such as divide-by-zero
+    // (e.g. in computeLightRanges())
+    for (size_t i = lightData.size(), e = (lightData.size() + 3u) & ~3u; i < e; i++) {
+        new(lightData.data<POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
+    }
+
+    // when reused, the hierarchy was already updated with the same boxes
+    if (mHierarchicalCulling && !reused) {
+        mCullingHierarchy.update(sceneData.data<RENDERABLE_INSTANCE>(),
+                sceneData.data<WORLD_AABB_CENTER>(), sceneData.data<WORLD_AABB_EXTENT>(),
+                sceneData.size());
     }
+}
+
+void FScene::gatherEntities(const mat4f& worldOriginTransform) {
+    FEngine& engine = mEngine;
+    EntityManager& em = engine.getEntityManager();
+    FRenderableManager& rcm = engine.getRenderableManager();
+    FTransformManager& tcm = engine.getTransformManager();
+    FLightManager& lcm = engine.getLightManager();
+
+    auto& lightData = mLightData;
+    auto const& entities = mEntities;
+
     // the first entries are reserved for the directional lights (currently only one)
     lightData.resize(DIRECTIONAL_LIGHTS_COUNT);
 
-
     // find the max intensity directional light index in our local array
     float maxIntensity = 0.0f;
 
+    // Looking up the components of each entity is done serially, the renderables' data is then
+    // computed in parallel by prepare(). Lights are few, so they're handled right away.
+    auto& renderables = mPreparedRenderables;
+    std::swap(renderables, mLastPreparedRenderables);
+    renderables.clear();
+    renderables.reserve(entities.size());
+
+    auto const& entityCells = mEntityCells;
+    auto& cells = mPreparedCells;
+    cells.clear();
+
     for (Entity e : entities) {
         if (!em.isAlive(e)) {
             continue;
@@ -105,35 +294,23 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
             continue;
         }
 
-        // get the world transform
         auto ti = tcm.getInstance(e);
-        const mat4f worldTransform = worldOriginTransform * tcm.getWorldTransform(ti);
-        const bool reversedWindingOrder = det(worldTransform.upperLeft()) < 0;
 
         // don't even draw this object if it doesn't have a transform (which shouldn't happen
         // because one is always created when creating a Renderable component).
         if (ri && ti) {
-            // compute the world AABB so we can perform culling
-            const Box worldAABB = rigidTransform(rcm.getAABB(ri), worldTransform);
-
-            // we know there is enough space in the array
-            sceneData.push_back_unsafe(
-                    ri,                       // RENDERABLE_INSTANCE
-                    worldTransform,           // WORLD_TRANSFORM
-                    reversedWindingOrder,     // REVERSED_WINDING_ORDER
-                    rcm.getVisibility(ri),    // VISIBILITY_STATE
-                    rcm.getBonesUbh(ri),      // BONES_UBH
-                    worldAABB.center,         // WORLD_AABB_CENTER
-                    0,                        // VISIBLE_MASK
-                    rcm.getMorphWeights(ri),  // MORPH_WEIGHTS
-                    rcm.getLayerMask(ri),     // LAYERS
-                    worldAABB.halfExtent,     // WORLD_AABB_EXTENT
-                    {},                       // PRIMITIVES
-                    0                         // SUMMED_PRIMITIVE_COUNT
-            );
+            renderables.push_back({ ri, ti });
+            if (UTILS_UNLIKELY(!entityCells.empty())) {
+                auto const pos = entityCells.find(e);
+                cells.push_back(pos != entityCells.end() ? pos->second : CellGraph::NO_CELL);
+            }
         }
 
         if (li) {
+            // get the world transform
+            const mat4f worldTransform =
+                    simd::multiply(worldOriginTransform, tcm.getRenderWorldTransform(ti));
+
             // find the dominant directional light
             if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
                 // we don't store the directional lights, because we only have a single one
@@ -161,78 +338,138 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
         }
     }
 
-    // some elements past the end of the array will be accessed by SIMD code, we need to make
-    // sure the data is valid enough as not to produce errors such as divide-by-zero
-    // (e.g. in computeLightRanges())
-    for (size_t i = lightData.size(), e = (lightData.size() + 3u) & ~3u; i < e; i++) {
-        new(lightData.data<POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
+    // keep the lights as gathered, since the Views reorder mLightData
+    const size_t lightCount = lightData.size();
+    auto& preparedLightData = mPreparedLightData;
+    if (preparedLightData.capacity() < lightData.capacity()) {
+        preparedLightData.setCapacity(lightData.capacity());
     }
+    preparedLightData.resize(lightCount);
+    std::copy_n(lightData.data<POSITION_RADIUS>(), lightCount,
+            preparedLightData.data<POSITION_RADIUS>());
+    std::copy_n(lightData.data<DIRECTION>(), lightCount, preparedLightData.data<DIRECTION>());
+    std::copy_n(lightData.data<LIGHT_INSTANCE>(), lightCount,
+            preparedLightData.data<LIGHT_INSTANCE>());
 }
 
-void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept {
+void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables,
+        backend::Handle<backend::HwUniformBuffer> renderableUbh, bool forceUpload) noexcept {
     FEngine::DriverApi& driver = mEngine.getDriverApi();
     const size_t size = visibleRenderables.size() * sizeof(PerRenderableUib);
 
+    auto& sceneData = mRenderableData;
+    uint32_t const* const UTILS_RESTRICT indices = sceneData.data<PREPARED_INDEX>();
+    uint8_t* const UTILS_RESTRICT uboDirty = mUboDirty.data();
+
+    // If neither the renderables in the UBO nor their content changed since the last upload,
+    // the UBO doesn't need to be touched at all.
+    bool upToDate = !forceUpload && renderableUbh == mRenderableViewUbh &&
+            mUploadedIndices.size() == visibleRenderables.size();
+    for (uint32_t i = visibleRenderables.first; upToDate && i < visibleRenderables.last; i++) {
+        const uint32_t p = indices[i];
+        upToDate = mUploadedIndices[i - visibleRenderables.first] == p && !uboDirty[p];
+    }
+    if (upToDate) {
+        if (mSkybox) {
+            mSkybox->commit(driver);
+        }
+        return;
+    }
+
     // allocate space into the command stream directly
     void* const buffer = driver.allocate(size);
 
-    bool hasContactShadows = false;
-    auto& sceneData = mRenderableData;
-    for (uint32_t i : visibleRenderables) {
-        mat4f const& model = sceneData.elementAt<WORLD_TRANSFORM>(i);
-        const size_t offset = i * sizeof(PerRenderableUib);
-
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, worldFromModelMatrix), model);
-
-        // Using mat3f::getTransformForNormals handles non-uniform scaling, but DOESN'T guarantee that
-        // the transformed normals will have unit-length, therefore they need to be normalized
-        // in the shader (that's already the case anyways, since normalization is needed after
-        // interpolation).
-        //
-        // We pre-scale normals by the inverse of the largest scale factor to avoid
-        // large post-transform magnitudes in the shader, especially in the fragment shader, where
-        // we use medium precision.
-        //
-        // Note: if the model matrix is known to be a rigid-transform, we could just use it directly.
-
-        mat3f m = mat3f::getTransformForNormals(model.upperLeft());
-        m *= mat3f(1.0f / std::sqrt(max(float3{length2(m[0]), length2(m[1]), length2(m[2])})));
-
-        // The shading normal must be flipped for mirror transformations.
-        // Basically we're shading the other side of the polygon and therefore need to negate the
-        // normal, similar to what we already do to support double-sided lighting.
-        if (sceneData.elementAt<REVERSED_WINDING_ORDER>(i)) {
-            m = -m;
-        }
+    // Each worker updates the cached UBO content of its dirty renderables and copies it directly
+    // into the command stream buffer. PerRenderableUib is 256-bytes aligned so workers never
+    // share a cache line.
+    // Note: the cache holds the UBO layout (not the C++ layout) of PerRenderableUib.
+    std::atomic<bool> hasContactShadows = { false };
+    PerRenderableUib* const UTILS_RESTRICT uboCache = mUboCache.data();
+    FRenderableManager const& rcm = mEngine.getRenderableManager();
+    auto functor = [buffer, &sceneData, &hasContactShadows, &rcm, indices, uboDirty, uboCache](
+            uint32_t first, uint32_t c) {
+        bool contactShadows = false;
+        for (uint32_t i = first, e = first + c; i < e; i++) {
+            const uint32_t p = indices[i];
+            FRenderableManager::Visibility visibility = sceneData.elementAt<VISIBILITY_STATE>(i);
+            contactShadows = contactShadows || visibility.screenSpaceContactShadows;
+
+            void* const cache = uboCache + p;
+            if (uboDirty[p]) {
+                uboDirty[p] = 0;
+                mat4f const& model = sceneData.elementAt<WORLD_TRANSFORM>(i);
+
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, worldFromModelMatrix), model);
+
+                // Using mat3f::getTransformForNormals handles non-uniform scaling, but DOESN'T
+                // guarantee that the transformed normals will have unit-length, therefore they
+                // need to be normalized in the shader (that's already the case anyways, since
+                // normalization is needed after interpolation).
+                //
+                // We pre-scale normals by the inverse of the largest scale factor to avoid
+                // large post-transform magnitudes in the shader, especially in the fragment
+                // shader, where we use medium precision.
+                //
+                // Note: if the model matrix is known to be a rigid-transform, we could just use it
+                // directly.
+
+                mat3f m = mat3f::getTransformForNormals(model.upperLeft());
+                m *= mat3f(1.0f / std::sqrt(
+                        max(float3{ length2(m[0]), length2(m[1]), length2(m[2]) })));
+
+                // The shading normal must be flipped for mirror transformations.
+                // Basically we're shading the other side of the polygon and therefore need to
+                // negate the normal, similar to what we already do to support double-sided
+                // lighting.
+                if (sceneData.elementAt<REVERSED_WINDING_ORDER>(i)) {
+                    m = -m;
+                }
 
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, worldFromModelNormalMatrix), m);
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, worldFromModelNormalMatrix), m);
 
-        // Note that we cast bool to uint32_t. Booleans are byte-sized in C++, but we need to
-        // initialize all 32 bits in the UBO field.
+                // Note that we cast bool to uint32_t. Booleans are byte-sized in C++, but we need
+                // to initialize all 32 bits in the UBO field.
 
-        FRenderableManager::Visibility visibility = sceneData.elementAt<VISIBILITY_STATE>(i);
-        hasContactShadows = hasContactShadows || visibility.screenSpaceContactShadows;
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, skinningEnabled),
-                uint32_t(visibility.skinning));
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, skinningEnabled),
+                        uint32_t(visibility.skinning));
 
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, morphingEnabled),
-                uint32_t(visibility.morphing));
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, morphingEnabled),
+                        uint32_t(visibility.morphing));
 
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, screenSpaceContactShadows),
-                uint32_t(visibility.screenSpaceContactShadows));
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, screenSpaceContactShadows),
+                        uint32_t(visibility.screenSpaceContactShadows));
 
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, morphWeights),
-                sceneData.elementAt<MORPH_WEIGHTS>(i));
-    }
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, morphWeights),
+                        sceneData.elementAt<MORPH_WEIGHTS>(i));
+
+                // read back by the picking queries
+                UniformBuffer::setUniform(cache,
+                        offsetof(PerRenderableUib, objectId),
+                        rcm.getEntity(sceneData.elementAt<RENDERABLE_INSTANCE>(i)).getId());
+            }
+
+            memcpy(static_cast<char*>(buffer) + i * sizeof(PerRenderableUib), cache,
+                    sizeof(PerRenderableUib));
+        }
+        if (contactShadows) {
+            hasContactShadows.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    JobSystem& js = mEngine.getJobSystem();
+    auto* job = jobs::parallel_for(js, nullptr, visibleRenderables.first,
+            uint32_t(visibleRenderables.size()),
+            std::ref(functor), jobs::CountSplitter<UBO_MIN_RENDERABLE_COUNT, 8>());
+    js.runAndWait(job);
 
-    // TODO: handle static objects separately
-    mHasContactShadows = hasContactShadows;
+    mUploadedIndices.assign(indices + visibleRenderables.first, indices + visibleRenderables.last);
+    mHasContactShadows = hasContactShadows.load(std::memory_order_relaxed);
     mRenderableViewUbh = renderableUbh;
     driver.loadUniformBuffer(renderableUbh, { buffer, size });
 
@@ -259,13 +496,16 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
      * - we can build light trees
      * - lights farther from the camera are dropped when in excess
      *   (note this doesn't work well, e.g. for search-lights)
+     * When there are too many lights, the nearest ones are selected first, so that only the
+     * lights that are kept are sorted.
      */
 
     ArenaScope arena(rootArena.getAllocator());
     size_t const size = lightData.size();
 
     // always allocate at least 4 entries, because the vectorized loops below rely on that
-    float* const UTILS_RESTRICT distances = arena.allocate<float>((size + 3u) & 3u, CACHELINE_SIZE);
+    float* const UTILS_RESTRICT distances =
+            arena.allocate<float>((size + 3u) & ~3u, CACHELINE_SIZE);
 
     // pre-compute the lights' distance to the camera plane, for sorting below
     // - we don't skip the directional light, because we don't care, it's ignored during sorting
@@ -274,14 +514,17 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
 
     // skip directional light
     Zip2Iterator<FScene::LightSoa::iterator, float*> b = { lightData.begin(), distances };
-    std::sort(b + DIRECTIONAL_LIGHTS_COUNT, b + size,
-            [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; });
-
-    // drop excess lights
-    lightData.resize(std::min(size, CONFIG_MAX_LIGHT_COUNT + DIRECTIONAL_LIGHTS_COUNT));
+    auto nearest = [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; };
+    const size_t count = std::min(size, CONFIG_MAX_LIGHT_COUNT + DIRECTIONAL_LIGHTS_COUNT);
+    if (UTILS_UNLIKELY(count < size)) {
+        // drop excess lights
+        std::nth_element(b + DIRECTIONAL_LIGHTS_COUNT, b + count, b + size, nearest);
+        lightData.resize(count);
+    }
+    std::sort(b + DIRECTIONAL_LIGHTS_COUNT, b + count, nearest);
 
     // number of point/spot lights
-    size_t positionalLightCount = size - DIRECTIONAL_LIGHTS_COUNT;
+    size_t positionalLightCount = count - DIRECTIONAL_LIGHTS_COUNT;
 
     // compute the light ranges (needed when building light trees)
     float2* const zrange = lightData.data<FScene::SCREEN_SPACE_Z_RANGE>();
@@ -292,7 +535,7 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
     auto const* UTILS_RESTRICT directions       = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances        = lightData.data<FScene::LIGHT_INSTANCE>();
     auto const* UTILS_RESTRICT shadowInfo       = lightData.data<FScene::SHADOW_INFO>();
-    for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = size; i < c; ++i) {
+    for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = count; i < c; ++i) {
         const size_t gpuIndex = i - DIRECTIONAL_LIGHTS_COUNT;
         auto li = instances[i];
         lp[gpuIndex].positionFalloff      = { spheres[i].xyz, lcm.getSquaredFalloffInv(li) };
@@ -358,16 +601,87 @@ inline void FScene::computeLightRanges(
     }
 }
 
+void FScene::setHierarchicalCullingEnabled(bool enabled) noexcept {
+    mHierarchicalCulling = enabled;
+    mVersion++;
+    if (!enabled) {
+        mCullingHierarchy.clear();
+    }
+}
+
+static_assert(Scene::NO_CELL == CellGraph::NO_CELL);
+
+uint32_t FScene::addCell(Box const& bounds) noexcept {
+    return mCellGraph.addCell(bounds);
+}
+
+void FScene::addPortal(uint32_t cellA, uint32_t cellB, float3 const* vertices, size_t count) {
+    ASSERT_PRECONDITION(cellA < mCellGraph.getCellCount() && cellB < mCellGraph.getCellCount(),
+            "portal between cells %u and %u, but the scene has %u cells",
+            cellA, cellB, unsigned(mCellGraph.getCellCount()));
+    ASSERT_PRECONDITION(cellA != cellB, "portal from cell %u to itself", cellA);
+    ASSERT_PRECONDITION(count >= 3 && count <= CellGraph::MAX_PORTAL_VERTEX_COUNT,
+            "a portal must have between 3 and %u vertices (%u)",
+            unsigned(CellGraph::MAX_PORTAL_VERTEX_COUNT), unsigned(count));
+    mCellGraph.addPortal(cellA, cellB, vertices, count);
+}
+
+void FScene::setCell(Entity entity, uint32_t cell) {
+    ASSERT_PRECONDITION(cell == CellGraph::NO_CELL || cell < mCellGraph.getCellCount(),
+            "cell %u doesn't exist, the scene has %u cells",
+            cell, unsigned(mCellGraph.getCellCount()));
+    if (cell == CellGraph::NO_CELL) {
+        mEntityCells.erase(entity);
+    } else {
+        mEntityCells[entity] = cell;
+    }
+    mVersion++;
+}
+
+void FScene::clearCells() noexcept {
+    mCellGraph.clear();
+    mEntityCells.clear();
+    mVersion++;
+}
+
+void FScene::cullCells(Frustum const& frustum, mat4f const& worldOrigin,
+        float3 const& eye, bool narrow, size_t bit) noexcept {
+    if (mCellGraph.empty() || mPreparedCells.empty()) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    // the cells are in API world space, for a rigid transform the planes transform by the
+    // transpose of the world origin
+    float4 planes[6];
+    frustum.getNormalizedPlanes(planes);
+    const mat4f m = transpose(worldOrigin);
+    for (float4& plane : planes) {
+        plane = m * plane;
+    }
+
+    if (mCellGraph.update(planes, eye, narrow)) {
+        auto& sceneData = mRenderableData;
+        mCellGraph.cull(sceneData.data<VISIBLE_MASK>(), mPreparedCells.data(),
+                sceneData.data<PREPARED_INDEX>(), sceneData.size(), bit);
+    }
+}
+
 void FScene::addEntity(Entity entity) {
     mEntities.insert(entity);
+    mVersion++;
 }
 
 void FScene::addEntities(const Entity* entities, size_t count) {
     mEntities.insert(entities, entities + count);
+    mVersion++;
 }
 
 void FScene::remove(Entity entity) {
     mEntities.erase(entity);
+    mEntityCells.erase(entity);
+    mVersion++;
 }
 
 void FScene::removeEntities(const Entity* entities, size_t count) {
@@ -482,4 +796,33 @@ bool Scene::hasEntity(Entity entity) const noexcept {
     return upcast(this)->hasEntity(entity);
 }
 
+void Scene::setHierarchicalCullingEnabled(bool enabled) noexcept {
+    upcast(this)->setHierarchicalCullingEnabled(enabled);
+}
+
+bool Scene::isHierarchicalCullingEnabled() const noexcept {
+    return upcast(this)->isHierarchicalCullingEnabled();
+}
+
+uint32_t Scene::addCell(Box const& bounds) noexcept {
+    return upcast(this)->addCell(bounds);
+}
+
+void Scene::addPortal(uint32_t cellA, uint32_t cellB, math::float3 const* vertices,
+        size_t count) {
+    upcast(this)->addPortal(cellA, cellB, vertices, count);
+}
+
+void Scene::setCell(Entity entity, uint32_t cell) {
+    upcast(this)->setCell(entity, cell);
+}
+
+void Scene::clearCells() noexcept {
+    upcast(this)->clearCells();
+}
+
+size_t Scene::getCellCount() const noexcept {
+    return upcast(this)->getCellCount();
+}
+
 } // namespace filament
@@ -67,24 +67,11 @@ ShadowMap::~ShadowMap() {
     engine.getEntityManager().destroy(sizeof(entities) / sizeof(Entity), entities);
 }
 
-void ShadowMap::render(DriverApi& driver, FView::Range const& range, RenderPass& pass,
-        FView& view) noexcept {
-    FEngine& engine = mEngine;
-
-    FScene& scene = *view.getScene();
-
-    FCamera const& camera = getCamera();
-    filament::CameraInfo cameraInfo(camera);
-
-    pass.setCamera(cameraInfo);
+void ShadowMap::prepareRenderPass(RenderPass& pass, FView::Range const& range,
+        FView const& view) const noexcept {
+    FScene const& scene = *view.getScene();
+    pass.setCamera(filament::CameraInfo(getCamera()));
     pass.setGeometry(scene.getRenderableData(), range, scene.getRenderableUBO());
-
-    // updatePrimitivesLod must be run before appendCommands.
-    view.updatePrimitivesLod(engine, cameraInfo, scene.getRenderableData(), range);
-
-    pass.newCommandBuffer();
-    pass.appendCommands(RenderPass::SHADOW);
-    pass.sortCommands();
 }
 
 void ShadowMap::computeSceneCascadeParams(const FScene::LightSoa& lightData, size_t index,
@@ -193,6 +180,10 @@ void ShadowMap::update(const FScene::LightSoa& lightData, size_t index, FScene c
                     lightData.elementAt<FScene::POSITION_RADIUS>(index).w, cameraInfo, params);
             break;
         case Type::POINT:
+            // each face of the cube is rendered like a spot light with a 90 degrees cone
+            computeShadowCameraSpot(lightData.elementAt<FScene::POSITION_RADIUS>(index).xyz,
+                    getCubeFaceDirection(layout.face), f::PI_4,
+                    lightData.elementAt<FScene::POSITION_RADIUS>(index).w, cameraInfo, params);
             break;
     }
 }
@@ -441,7 +432,7 @@ void ShadowMap::computeShadowCameraDirectional(
         // mLightSpace is used in the shader to access the shadow map texture, and has the model
         // matrix baked in.
 
-        mCamera->setModelMatrix(FCamera::rigidTransformInverse(b) * M);
+        mCamera->setRootModelMatrix(FCamera::rigidTransformInverse(b) * M);
         mCamera->setCustomProjection(mat4(F * W * L * Mp), znear, zfar);
 
         // for the debug camera, we need to undo the world origin
@@ -491,7 +482,7 @@ void ShadowMap::computeShadowCameraSpot(math::float3 const& position, math::floa
     // mLightSpace is used in the shader to access the shadow map texture, and has the model matrix
     // baked in.
 
-    mCamera->setModelMatrix(FCamera::rigidTransformInverse(b) * M);
+    mCamera->setRootModelMatrix(FCamera::rigidTransformInverse(b) * M);
     mCamera->setCustomProjection(mat4(Mp), nearPlane, farPlane);
 
     // for the debug camera, we need to undo the world origin
@@ -575,6 +566,28 @@ mat4f ShadowMap::applyLISPSM(math::mat4f& Wp,
 }
 
 
+float ShadowMap::computeCascadeDimension(filament::CameraInfo const& camera,
+        float viewportHeight, float near, float far) noexcept {
+    // The cascade is about as wide as the diagonal of the view frustum at its far end, while a
+    // pixel is the size of the view frustum's height at its near end divided by the viewport
+    // height.
+    mat4f const& p = camera.projection;
+    const float aspect = p[1][1] / p[0][0];
+    const float texels = viewportHeight * std::sqrt(aspect * aspect + 1.0f);
+    if (p[3][3] != 0.0f) {
+        // orthographic projection, the pixel size doesn't depend on the distance
+        return texels;
+    }
+    return texels * far / std::max(near, std::numeric_limits<float>::min());
+}
+
+float3 ShadowMap::getCubeFaceDirection(size_t face) noexcept {
+    assert(face < 6);
+    float3 dir{};
+    dir[face / 2] = (face & 1u) ? -1.0f : 1.0f;
+    return dir;
+}
+
 mat4f ShadowMap::getTextureCoordsMapping() const noexcept {
     // remapping from NDC to texture coordinates (i.e. [-1,1] -> [0, 1])
     // ([1, 0] for depth mapping)
@@ -600,12 +613,13 @@ mat4f ShadowMap::getTextureCoordsMapping() const noexcept {
             0.0f, 0.0f, 0.0f, 1.0f
     });
 
-    // apply the 1-texel border viewport transform
-    const float o = 1.0f / mShadowMapLayout.atlasDimension;
+    // apply the 1-texel border viewport transform, and move to the shadow map within the atlas
+    const float2 o = (float2(mShadowMapLayout.offset) + 1.0f) /
+            float(mShadowMapLayout.atlasDimension);
     const float s = 1.0f - 2.0f * (1.0f / mShadowMapLayout.textureDimension);
     const mat4f Mb(mat4f::row_major_init{
-             s,    0.0f, 0.0f, o,
-             0.0f, s,    0.0f, o,
+             s,    0.0f, 0.0f, o.x,
+             0.0f, s,    0.0f, o.y,
              0.0f, 0.0f, 1.0f, 0.0f,
              0.0f, 0.0f, 0.0f, 1.0f
     });
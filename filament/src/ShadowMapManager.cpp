@@ -20,14 +20,33 @@
 #include "details/View.h"
 
 #include "RenderPass.h"
+#include "ResourceAllocator.h"
+#include "TextureStreamer.h"
 
 #include <private/filament/SibGenerator.h>
 
+#include <utils/algorithm.h>
+#include <utils/Hash.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <cmath>
+
 namespace filament {
 
 using namespace backend;
 using namespace math;
 
+// Extracts the even bits of 'v'.
+static constexpr uint32_t compactBits(uint32_t v) noexcept {
+    v &= 0x55555555u;
+    v = (v | (v >> 1u)) & 0x33333333u;
+    v = (v | (v >> 2u)) & 0x0F0F0F0Fu;
+    v = (v | (v >> 4u)) & 0x00FF00FFu;
+    v = (v | (v >> 8u)) & 0x0000FFFFu;
+    return v;
+}
+
 ShadowMapManager::ShadowMapManager(FEngine& engine) {
     for (auto& entry : mCascadeShadowMapCache) {
         entry = std::make_unique<ShadowMap>(engine);
@@ -44,6 +63,11 @@ ShadowMapManager::ShadowMapManager(FEngine& engine) {
 
 ShadowMapManager::~ShadowMapManager() = default;
 
+void ShadowMapManager::terminate(FEngine& engine) noexcept {
+    mShadowTexture.destroy(engine.getResourceAllocator());
+    mShadowTexture = {};
+}
+
 ShadowMapManager::ShadowTechnique ShadowMapManager::update(
         FEngine& engine, FView& view, UniformBuffer& perViewUb,
         UniformBuffer& shadowUb, FScene::RenderableSoa& renderableData,
@@ -69,14 +93,25 @@ void ShadowMapManager::setShadowCascades(size_t lightIndex, size_t cascades) noe
 
 void ShadowMapManager::addSpotShadowMap(size_t lightIndex) noexcept {
     const size_t maps = mSpotShadowMaps.size();
-    assert(maps < CONFIG_MAX_SHADOW_CASTING_SPOTS);
-    mSpotShadowMaps.emplace_back(mSpotShadowMapCache[maps].get(), lightIndex);
+    const uint8_t slot = maps ? mSpotShadowMaps.back().getLightSlot() + 1 : 0;
+    assert(maps < CONFIG_MAX_SHADOW_MAPS_PUNCTUAL);
+    assert(slot < CONFIG_MAX_SHADOW_CASTING_SPOTS);
+    mSpotShadowMaps.emplace_back(mSpotShadowMapCache[maps].get(), lightIndex, slot, false, 0);
+}
+
+void ShadowMapManager::addPointShadowMap(size_t lightIndex) noexcept {
+    const size_t maps = mSpotShadowMaps.size();
+    const uint8_t slot = maps ? mSpotShadowMaps.back().getLightSlot() + 1 : 0;
+    assert(maps + CUBE_FACE_COUNT <= CONFIG_MAX_SHADOW_MAPS_PUNCTUAL);
+    assert(slot < CONFIG_MAX_SHADOW_CASTING_SPOTS);
+    for (uint8_t face = 0; face < CUBE_FACE_COUNT; face++) {
+        mSpotShadowMaps.emplace_back(mSpotShadowMapCache[maps + face].get(), lightIndex, slot,
+                true, face);
+    }
 }
 
 void ShadowMapManager::render(FrameGraph& fg, FEngine& engine, FView& view,
         backend::DriverApi& driver, RenderPass& pass) noexcept {
-    constexpr size_t MAX_SHADOW_LAYERS =
-        CONFIG_MAX_SHADOW_CASCADES + CONFIG_MAX_SHADOW_CASTING_SPOTS;
     struct ShadowPassData {
         FrameGraphId<FrameGraphTexture> shadows;
         FrameGraphId<FrameGraphTexture> tempDepth;
@@ -85,142 +120,277 @@ void ShadowMapManager::render(FrameGraph& fg, FEngine& engine, FView& view,
 
     using ShadowPass = std::pair<const ShadowMapEntry*, RenderPass>;
     std::vector<ShadowPass> passes;
-    passes.reserve(MAX_SHADOW_LAYERS);
+    passes.reserve(MAX_SHADOW_MAPS);
     uint8_t layerSampleCount[MAX_SHADOW_LAYERS] = {};
+    uint8_t layerPassCount[MAX_SHADOW_LAYERS] = {};
 
     assert(mTextureRequirements.layers <= MAX_SHADOW_LAYERS);
 
-    // These loops fill render passes with appropriate rendering commands for each shadow map.
-    // The actual render pass execution is deferred to the frame graph.
-    for (const auto& map : mCascadeShadowMaps) {
+    const bool fillWithCheckerboard = engine.debug.shadowmap.checkerboard && !view.hasVsm();
+
+    FrameGraphTexture::Descriptor shadowTextureDesc {
+        .width = mTextureRequirements.size, .height = mTextureRequirements.size,
+        .depth = mTextureRequirements.layers,
+        .levels = mTextureRequirements.levels,
+        .type = SamplerType::SAMPLER_2D_ARRAY,
+        .format = mTextureFormat,
+        .usage = TextureUsage::DEPTH_ATTACHMENT | TextureUsage::SAMPLEABLE
+            | (fillWithCheckerboard ? TextureUsage::UPLOADABLE : (TextureUsage) 0)
+    };
+    if (view.hasVsm()) {
+        shadowTextureDesc.format = view.getVsmShadowOptions().highPrecision ?
+                TextureFormat::RG32F : TextureFormat::RG16F;
+        shadowTextureDesc.usage = TextureUsage::COLOR_ATTACHMENT | TextureUsage::SAMPLEABLE;
+    }
+    mMemorySize = shadowTextureDesc.depth * TextureStreamer::getLevelsSize(
+            shadowTextureDesc.width, shadowTextureDesc.height, shadowTextureDesc.format,
+            0, shadowTextureDesc.levels);
+
+    // When a light with the static hint casts shadows, the shadow texture is kept across frames
+    // and only the layers that changed are rendered.
+    auto isStatic = [](ShadowMapEntry const& map) {
+        return map.isStatic() && map.hasVisibleShadows();
+    };
+    const bool useCache = !fillWithCheckerboard &&
+            (std::any_of(mCascadeShadowMaps.begin(), mCascadeShadowMaps.end(), isStatic) ||
+             std::any_of(mSpotShadowMaps.begin(), mSpotShadowMaps.end(), isStatic));
+
+    FrameGraphTexture::Descriptor const& cachedDesc = mShadowTextureDesc;
+    if (mShadowTexture.texture && (!useCache ||
+            cachedDesc.width != shadowTextureDesc.width ||
+            cachedDesc.height != shadowTextureDesc.height ||
+            cachedDesc.depth != shadowTextureDesc.depth ||
+            cachedDesc.levels != shadowTextureDesc.levels ||
+            cachedDesc.format != shadowTextureDesc.format ||
+            cachedDesc.usage != shadowTextureDesc.usage)) {
+        mShadowTexture.destroy(engine.getResourceAllocator());
+        mShadowTexture = {};
+    }
+    if (!mShadowTexture.texture) {
+        // nothing is cached in a new texture
+        mCachedShadowMaps = {};
+    }
+
+    FScene::RenderableSoa& renderableData = view.getScene()->getRenderableData();
+    FView::Range const& directionalCasters = view.getVisibleDirectionalShadowCasters();
+    FView::Range const& spotCasters = view.getVisibleSpotShadowCasters();
+
+    // Shadow maps sharing a layer are rendered together, because the whole layer is cleared
+    // before rendering the first one. Find the layers holding a shadow map that changed.
+    uint32_t renderedLayers = 0;
+    size_t directionalHash = 0;
+    const bool directionalCacheable = useCache &&
+            hashShadowCasters(renderableData, directionalCasters,
+                    VISIBLE_DIR_SHADOW_RENDERABLE, &directionalHash);
+    for (size_t i = 0; i < mCascadeShadowMaps.size(); i++) {
+        const auto& map = mCascadeShadowMaps[i];
+        if (!map.hasVisibleShadows()) {
+            mCachedShadowMaps[i].valid = false;
+            continue;
+        }
+        if (updateCachedShadowMap(i, map, view.hasVsm(), directionalCacheable,
+                directionalHash)) {
+            renderedLayers |= 1u << map.getLayout().layer;
+        }
+    }
+    size_t spotHash = 0;
+    bool spotCacheable = false;
+    size_t hashedSlot = CONFIG_MAX_SHADOW_CASTING_SPOTS;
+    for (size_t i = 0; i < mSpotShadowMaps.size(); i++) {
+        const auto& map = mSpotShadowMaps[i];
+        const size_t index = CONFIG_MAX_SHADOW_CASCADES + i;
         if (!map.hasVisibleShadows()) {
+            mCachedShadowMaps[index].valid = false;
             continue;
         }
+        // the faces of a point light share their casters, they're hashed only once
+        if (map.getLightSlot() != hashedSlot) {
+            hashedSlot = map.getLightSlot();
+            spotCacheable = useCache && map.isStatic() &&
+                    hashShadowCasters(renderableData, spotCasters,
+                            VISIBLE_SPOT_SHADOW_RENDERABLE_N(map.getLightSlot()), &spotHash);
+        }
+        if (updateCachedShadowMap(index, map, view.hasVsm(), spotCacheable, spotHash)) {
+            renderedLayers |= 1u << map.getLayout().layer;
+        }
+    }
 
-        map.getShadowMap()->render(driver, view.getVisibleDirectionalShadowCasters(), pass, view);
+    // These loops set up a render pass for each shadow map in a layer that needs rendering,
+    // their commands are generated below. The actual render pass execution is deferred to the
+    // frame graph.
+    for (const auto& map : mCascadeShadowMaps) {
+        const uint8_t layer = map.getLayout().layer;
+        assert(layer < mTextureRequirements.layers);
+        if (!map.hasVisibleShadows() || !(renderedLayers & (1u << layer))) {
+            continue;
+        }
 
-        assert(map.getLayout().layer < mTextureRequirements.layers);
         passes.emplace_back(&map, pass);
+        map.getShadowMap()->prepareRenderPass(passes.back().second, directionalCasters, view);
 
-        const uint8_t layer = map.getLayout().layer;
-        assert(layer < MAX_SHADOW_LAYERS);
         layerSampleCount[layer] = map.getLayout().vsmSamples;
+        layerPassCount[layer]++;
     }
+    const size_t cascadePassCount = passes.size();
+
     for (size_t i = 0; i < mSpotShadowMaps.size(); i++) {
         const auto& map = mSpotShadowMaps[i];
-        if (!map.hasVisibleShadows()) {
+        const uint8_t layer = map.getLayout().layer;
+        assert(layer < mTextureRequirements.layers);
+        if (!map.hasVisibleShadows() || !(renderedLayers & (1u << layer))) {
             continue;
         }
 
-        pass.setVisibilityMask(VISIBLE_SPOT_SHADOW_RENDERABLE_N(i));
-        map.getShadowMap()->render(driver, view.getVisibleSpotShadowCasters(), pass, view);
-        pass.clearVisibilityMask();
-
-        assert(map.getLayout().layer < mTextureRequirements.layers);
         passes.emplace_back(&map, pass);
+        RenderPass& spotPass = passes.back().second;
+        spotPass.setVisibilityMask(VISIBLE_SPOT_SHADOW_RENDERABLE_N(map.getLightSlot()));
+        map.getShadowMap()->prepareRenderPass(spotPass, spotCasters, view);
 
-        const uint8_t layer = map.getLayout().layer;
-        assert(layer < MAX_SHADOW_LAYERS);
         layerSampleCount[layer] = map.getLayout().vsmSamples;
+        layerPassCount[layer]++;
     }
-    assert(passes.size() <= mTextureRequirements.layers);
+    const size_t spotPassCount = passes.size() - cascadePassCount;
 
-    const bool fillWithCheckerboard = engine.debug.shadowmap.checkerboard && !view.hasVsm();
+    // The commands of all the shadow maps using the same casters are generated concurrently.
+    // The casters' level of detail must be updated first, this is done only once for all of them.
+    RenderPass* shadowPasses[MAX_SHADOW_MAPS];
+    for (size_t i = 0; i < passes.size(); i++) {
+        shadowPasses[i] = &passes[i].second;
+    }
+    if (cascadePassCount) {
+        view.updatePrimitivesLod(engine, view.getCameraInfo(), renderableData,
+                directionalCasters);
+        pass.appendCommands(shadowPasses, cascadePassCount, RenderPass::SHADOW);
+    }
+    if (spotPassCount) {
+        view.updatePrimitivesLod(engine, view.getCameraInfo(), renderableData, spotCasters);
+        pass.appendCommands(shadowPasses + cascadePassCount, spotPassCount, RenderPass::SHADOW);
+    }
+    // sorting uses the per-render-pass arena, so it can't run concurrently
+    for (auto& entry : passes) {
+        entry.second.sortCommands();
+    }
 
-    auto& shadowPass = fg.addPass<ShadowPassData>("Shadow Pass",
-            [&](FrameGraph::Builder& builder, auto& data) {
-                FrameGraphTexture::Descriptor shadowTextureDesc {
-                    .width = mTextureRequirements.size, .height = mTextureRequirements.size,
-                    .depth = mTextureRequirements.layers,
-                    .levels = mTextureRequirements.levels,
-                    .type = SamplerType::SAMPLER_2D_ARRAY,
-                    .format = mTextureFormat,
-                    .usage = TextureUsage::DEPTH_ATTACHMENT | TextureUsage::SAMPLEABLE
-                        | (fillWithCheckerboard ? TextureUsage::UPLOADABLE : (TextureUsage) 0)
-                };
-
-                if (view.hasVsm()) {
-                    // TODO: support 16-bit VSM depth textures.
-                    shadowTextureDesc.format = TextureFormat::RG32F;
-                    shadowTextureDesc.usage = TextureUsage::COLOR_ATTACHMENT |
-                            TextureUsage::SAMPLEABLE;
-                }
+    FrameGraphId<FrameGraphTexture> cachedShadows;
+    if (mShadowTexture.texture) {
+        cachedShadows = fg.import("Cached Shadow Texture", mShadowTextureDesc, mShadowTexture);
+    }
 
-                data.shadows = builder.createTexture("Shadow Texture", shadowTextureDesc);
-                data.shadows = builder.write(data.shadows);
-
-                if (view.hasVsm()) {
-                    // When rendering VSM shadow maps, we still need a depth texture for correct
-                    // sorting. The texture is cleared before each pass and discarded afterwards.
-                    data.tempDepth = builder.createTexture("Temporary VSM Depth Texture", {
-                        .width = mTextureRequirements.size, .height = mTextureRequirements.size,
-                        .depth = 1,
-                        .levels = 1,
-                        // Each shadow pass has its own sample count. We specify samples = 1 here to
-                        // force the frame graph to create the "magic resolve" textures with correct
-                        // sample counts automatically.
-                        .samples = 1,
-                        .type = SamplerType::SAMPLER_2D,
-                        .format = TextureFormat::DEPTH16,
-                        .usage = TextureUsage::DEPTH_ATTACHMENT
-                    });
-                    // We specify "read" for the temporary shadow texture, so it isn't culled.
-                    data.tempDepth = builder.write(builder.read(data.tempDepth));
-                }
+    // the shadow texture must be detached from the frame graph the first time it's cached
+    const bool detach = useCache && !mShadowTexture.texture;
+
+    FrameGraphId<FrameGraphTexture> shadows = cachedShadows;
+    if (!passes.empty() || !shadows.isValid()) {
+        auto& shadowPass = fg.addPass<ShadowPassData>("Shadow Pass",
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    data.shadows = cachedShadows.isValid() ? cachedShadows :
+                            builder.createTexture("Shadow Texture", shadowTextureDesc);
+                    data.shadows = builder.write(data.shadows);
 
-                // Create a render target for each layer of the texture array.
-                for (uint8_t i = 0u; i < mTextureRequirements.layers; i++) {
-                    FrameGraphRenderTarget::Descriptor renderTargetDesc {};
                     if (view.hasVsm()) {
-                        renderTargetDesc.attachments = { { data.shadows, 0u, i }, { data.tempDepth } };
-                        renderTargetDesc.clearFlags = TargetBufferFlags::COLOR |
-                            TargetBufferFlags::DEPTH;
-                        renderTargetDesc.clearColor = { 1.0f, 1.0f, 0.0f, 0.0f };
-                        renderTargetDesc.samples = layerSampleCount[i];
-                    } else {
-                        renderTargetDesc.attachments = { {}, { data.shadows, 0u, i } };
-                        renderTargetDesc.clearFlags = TargetBufferFlags::DEPTH;
+                        // When rendering VSM shadow maps, we still need a depth texture for
+                        // correct sorting. It's shared by all the shadow maps, cleared before
+                        // each pass and discarded afterwards, so it can live in tile memory.
+                        data.tempDepth = builder.createTexture("Temporary VSM Depth Texture", {
+                            .width = mTextureRequirements.size,
+                            .height = mTextureRequirements.size,
+                            .depth = 1,
+                            .levels = 1,
+                            // Each shadow pass has its own sample count. We specify samples = 1
+                            // here to force the frame graph to create the "magic resolve"
+                            // textures with correct sample counts automatically.
+                            .samples = 1,
+                            .type = SamplerType::SAMPLER_2D,
+                            .format = TextureFormat::DEPTH16,
+                            .usage = TextureUsage::DEPTH_ATTACHMENT |
+                                    TextureUsage::TRANSIENT_ATTACHMENT
+                        });
+                        // We specify "read" for the temporary shadow texture, so it isn't culled.
+                        data.tempDepth = builder.write(builder.read(data.tempDepth));
                     }
 
-                    data.rt[i] = builder.createRenderTarget("Shadow RT", renderTargetDesc);
-                }
-            },
-            [=, passes = std::move(passes), &view, &engine](FrameGraphPassResources const& resources,
-                    auto const& data, DriverApi& driver) mutable {
-                for (auto& [map, pass] : passes) {
-                    FCamera const& camera = map->getShadowMap()->getCamera();
-                    filament::CameraInfo cameraInfo(camera);
-                    view.prepareCamera(cameraInfo);
-
-                    // we set a viewport with a 1-texel border for when we index outside of the
-                    // texture
-                    // DON'T CHANGE this unless ShadowMap::getTextureCoordsMapping() is updated too.
-                    // see: ShadowMap::getTextureCoordsMapping()
-                    // For floating-point depth textures, the 1-texel border could be set to
-                    // FLOAT_MAX to avoid clamping in the shadow shader (see sampleDepth inside
-                    // shadowing.fs). Unfortunately, the APIs don't seem let us clear depth
-                    // attachments to anything greater than 1.0, so we'd need a way to do this other
-                    // than clearing.
-                    const uint32_t dim = map->getLayout().size;
-                    filament::Viewport viewport { 1, 1, dim - 2, dim - 2 };
-                    view.prepareViewport(viewport);
-
-                    view.commitUniforms(driver);
-
-                    const auto layer = map->getLayout().layer;
-                    auto rt = resources.get(data.rt[layer]);
-                    rt.params.viewport = viewport;
-
-                    auto polygonOffset = map->getShadowMap()->getPolygonOffset();
-                    pass.overridePolygonOffset(&polygonOffset);
-
-                    pass.execute("Shadow Pass", rt.target, rt.params);
-                }
+                    // Create a render target for each layer of the texture array.
+                    for (uint8_t i = 0u; i < mTextureRequirements.layers; i++) {
+                        FrameGraphRenderTarget::Descriptor renderTargetDesc {};
+                        if (view.hasVsm()) {
+                            renderTargetDesc.attachments = {
+                                    { data.shadows, 0u, i }, { data.tempDepth } };
+                            renderTargetDesc.clearFlags = TargetBufferFlags::COLOR |
+                                TargetBufferFlags::DEPTH;
+                            renderTargetDesc.clearColor = { 1.0f, 1.0f, 0.0f, 0.0f };
+                            renderTargetDesc.samples = layerSampleCount[i];
+                        } else {
+                            renderTargetDesc.attachments = { {}, { data.shadows, 0u, i } };
+                            renderTargetDesc.clearFlags = TargetBufferFlags::DEPTH;
+                        }
+
+                        data.rt[i] = builder.createRenderTarget("Shadow RT", renderTargetDesc);
+                    }
+                },
+                [=, passes = std::move(passes), &view, &engine](
+                        FrameGraphPassResources const& resources,
+                        auto const& data, DriverApi& driver) mutable {
+                    uint32_t startedLayers = 0;
+                    for (auto& [map, pass] : passes) {
+                        FCamera const& camera = map->getShadowMap()->getCamera();
+                        filament::CameraInfo cameraInfo(camera);
+                        view.prepareCamera(cameraInfo);
+
+                        // we set a viewport with a 1-texel border for when we index outside of
+                        // the texture
+                        // DON'T CHANGE this unless ShadowMap::getTextureCoordsMapping() is
+                        // updated too.
+                        // see: ShadowMap::getTextureCoordsMapping()
+                        // For floating-point depth textures, the 1-texel border could be set to
+                        // FLOAT_MAX to avoid clamping in the shadow shader (see sampleDepth
+                        // inside shadowing.fs). Unfortunately, the APIs don't seem let us clear
+                        // depth attachments to anything greater than 1.0, so we'd need a way to
+                        // do this other than clearing.
+                        // The shadow map might only be a part of the layer, the viewport also
+                        // keeps the rendering within it.
+                        const uint32_t dim = map->getLayout().size;
+                        const uint2 offset = map->getLayout().offset;
+                        filament::Viewport viewport {
+                                int32_t(offset.x + 1), int32_t(offset.y + 1), dim - 2, dim - 2 };
+                        view.prepareViewport(viewport);
+
+                        view.commitUniforms(driver);
+
+                        const auto layer = map->getLayout().layer;
+                        auto rt = resources.get(data.rt[layer]);
+                        rt.params.viewport = viewport;
+
+                        // Only the first shadow map rendered in a layer clears it, and
+                        // the attachments are kept until the last one is rendered. The VSM
+                        // depth is never kept, each shadow map clears it again.
+                        const TargetBufferFlags scratch = view.hasVsm() ?
+                                TargetBufferFlags::DEPTH : TargetBufferFlags::NONE;
+                        if (startedLayers & (1u << layer)) {
+                            rt.params.flags.clear = scratch;
+                            rt.params.flags.discardStart = scratch;
+                        }
+                        startedLayers |= 1u << layer;
+                        if (--layerPassCount[layer]) {
+                            rt.params.flags.discardEnd = scratch;
+                        }
+
+                        auto polygonOffset = map->getShadowMap()->getPolygonOffset();
+                        pass.overridePolygonOffset(&polygonOffset);
+
+                        pass.execute("Shadow Pass", rt.target, rt.params);
+                    }
 
-                engine.flush(); // Wake-up the driver thread
-            });
+                    if (detach) {
+                        // keep the shadow texture for the next frames, we own it from now on
+                        resources.detach(data.shadows, &mShadowTexture, &mShadowTextureDesc);
+                    }
+
+                    engine.flush(); // Wake-up the driver thread
+                });
+
+        shadows = shadowPass.getData().shadows;
+    }
 
-    auto shadows = shadowPass.getData().shadows;
 
     if (UTILS_UNLIKELY(fillWithCheckerboard)) {
         struct DebugPatternData {
@@ -241,11 +411,31 @@ void ShadowMapManager::render(FrameGraph& fg, FEngine& engine, FView& view,
         shadows = debugPatternPass.getData().shadows;
     }
 
+    // Blur the VSM shadow maps that were rendered, before their mipmaps are generated.
+    if (view.hasVsm()) {
+        auto& ppm = engine.getPostProcessManager();
+        const float momentBias =
+                view.getVsmShadowOptions().highPrecision ? 0.0f : VSM_MOMENT_BIAS_16;
+        auto blur = [&](ShadowMapEntry const& map) {
+            ShadowLayout const& layout = map.getLayout();
+            if (map.hasVisibleShadows() && layout.vsmBlurWidth > 0.0f &&
+                    (renderedLayers & (1u << layout.layer))) {
+                shadows = ppm.vsmBlurPass(fg, shadows, layout.layer, layout.offset, layout.size,
+                        layout.vsmBlurWidth, momentBias);
+            }
+        };
+        std::for_each(mCascadeShadowMaps.begin(), mCascadeShadowMaps.end(), blur);
+        std::for_each(mSpotShadowMaps.begin(), mSpotShadowMaps.end(), blur);
+    }
+
     // If the shadow texture has more than one level, then anisotropy was specified and we should
-    // generate VSM mipmaps.
+    // generate VSM mipmaps. The mipmaps of the cached layers are still valid.
     if (mTextureRequirements.levels > 1) {
         auto& ppm = engine.getPostProcessManager();
         for (uint8_t layer = 0; layer < mTextureRequirements.layers; layer++) {
+            if (useCache && !(renderedLayers & (1u << layer))) {
+                continue;
+            }
             for (size_t level = 0; level < mTextureRequirements.levels - 1; level++) {
                 shadows = ppm.vsmMipmapPass(fg, shadows, layer, level);
             }
@@ -255,6 +445,179 @@ void ShadowMapManager::render(FrameGraph& fg, FEngine& engine, FView& view,
     fg.getBlackboard().put("shadows", shadows);
 }
 
+bool ShadowMapManager::hashShadowCasters(FScene::RenderableSoa const& renderableData,
+        utils::Range<uint32_t> range, FScene::VisibleMaskType mask, size_t* hash) noexcept {
+    auto const* UTILS_RESTRICT instances = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* UTILS_RESTRICT transforms = renderableData.data<FScene::WORLD_TRANSFORM>();
+    auto const* UTILS_RESTRICT visibility = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto const* UTILS_RESTRICT visibleMask = renderableData.data<FScene::VISIBLE_MASK>();
+    auto const* UTILS_RESTRICT morphWeights = renderableData.data<FScene::MORPH_WEIGHTS>();
+
+    uint32_t h = 0;
+    for (uint32_t i : range) {
+        if (!(visibleMask[i] & mask)) {
+            continue;
+        }
+        if (UTILS_UNLIKELY(visibility[i].skinning)) {
+            // the bones can change without us knowing
+            return false;
+        }
+        const uint32_t instance = instances[i].asValue();
+        h = utils::hash::murmur3(&instance, 1, h);
+        h = utils::hash::murmur3(reinterpret_cast<uint32_t const*>(&transforms[i]),
+                sizeof(mat4f) / 4, h);
+        if (visibility[i].morphing) {
+            h = utils::hash::murmur3(reinterpret_cast<uint32_t const*>(&morphWeights[i]),
+                    sizeof(float4) / 4, h);
+        }
+    }
+    *hash = h;
+    return true;
+}
+
+void ShadowMapManager::cullDirectionalShadowCasters(FView const& view,
+        FScene::RenderableSoa& renderableData, float3 direction, float minTexels) noexcept {
+    SYSTRACE_CALL();
+
+    // The visible receivers are rasterized in a coarse grid perpendicular to the light, which
+    // keeps the farthest receiver depth along the light in each cell. A caster can only shadow
+    // a cell farther than its nearest depth.
+    constexpr size_t GRID_SIZE = 32;
+
+    auto const* UTILS_RESTRICT centers = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    auto const* UTILS_RESTRICT extents = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    auto const* UTILS_RESTRICT visibility = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto const* UTILS_RESTRICT layers = renderableData.data<FScene::LAYERS>();
+    auto* UTILS_RESTRICT visibleMask = renderableData.data<FScene::VISIBLE_MASK>();
+    const size_t count = renderableData.size();
+    const uint8_t visibleLayers = view.getVisibleLayers();
+
+    // light space: xy perpendicular to the light, z is the depth along the light
+    const float3 z = normalize(direction);
+    const float3 up = std::abs(z.y) < 0.999f ? float3{ 0, 1, 0 } : float3{ 1, 0, 0 };
+    const float3 x = normalize(cross(up, z));
+    const float3 y = cross(z, x);
+
+    struct Bounds {
+        float3 min;
+        float3 max;
+    };
+    auto getLightSpaceBounds = [&](size_t i) -> Bounds {
+        const float3 c = { dot(centers[i], x), dot(centers[i], y), dot(centers[i], z) };
+        const float3 e = {
+                dot(abs(x), extents[i]), dot(abs(y), extents[i]), dot(abs(z), extents[i]) };
+        return { c - e, c + e };
+    };
+    auto isVisibleReceiver = [&](size_t i) {
+        return visibility[i].receiveShadows && (layers[i] & visibleLayers) &&
+                (!visibility[i].culling || (visibleMask[i] & VISIBLE_RENDERABLE));
+    };
+
+    float2 gridMin{ std::numeric_limits<float>::max() };
+    float2 gridMax{ std::numeric_limits<float>::lowest() };
+    for (size_t i = 0; i < count; i++) {
+        if (isVisibleReceiver(i)) {
+            const Bounds b = getLightSpaceBounds(i);
+            gridMin = min(gridMin, b.min.xy);
+            gridMax = max(gridMax, b.max.xy);
+        }
+    }
+
+    float depths[GRID_SIZE * GRID_SIZE];
+    std::fill_n(depths, GRID_SIZE * GRID_SIZE, std::numeric_limits<float>::lowest());
+    const float2 cellScale = float(GRID_SIZE) / max(gridMax - gridMin, float2{ 1e-6f });
+
+    // range of the cells overlapped by a light-space rectangle, false if it's outside the grid
+    auto getCells = [&](Bounds const& b, uint2& lo, uint2& hi) {
+        if (any(greaterThan(b.min.xy, gridMax)) || any(lessThan(b.max.xy, gridMin))) {
+            return false;
+        }
+        const float2 l = clamp((b.min.xy - gridMin) * cellScale, 0.0f, float(GRID_SIZE - 1));
+        const float2 h = clamp((b.max.xy - gridMin) * cellScale, 0.0f, float(GRID_SIZE - 1));
+        lo = uint2(l);
+        hi = uint2(h);
+        return true;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        uint2 lo, hi;
+        const Bounds b = getLightSpaceBounds(i);
+        if (isVisibleReceiver(i) && getCells(b, lo, hi)) {
+            for (uint32_t cy = lo.y; cy <= hi.y; cy++) {
+                for (uint32_t cx = lo.x; cx <= hi.x; cx++) {
+                    float& d = depths[cy * GRID_SIZE + cx];
+                    d = std::max(d, b.max.z);
+                }
+            }
+        }
+    }
+
+    // the casters are measured in the cascade of their point closest to the camera
+    CameraInfo const& camera = view.getCameraInfo();
+    const float3 viewZ = { camera.view[0].z, camera.view[1].z, camera.view[2].z };
+    const float* const splits = mCascadeSplits.beginWs();
+    const size_t cascadeCount = mCascadeShadowMaps.size();
+    auto getTexelSize = [&](size_t i) {
+        const float vz = dot(viewZ, centers[i]) + camera.view[3].z + dot(abs(viewZ), extents[i]);
+        size_t cascade = 0;
+        while (cascade < cascadeCount - 1 && vz < splits[cascade + 1]) {
+            cascade++;
+        }
+        ShadowMapEntry const& entry = mCascadeShadowMaps[cascade];
+        return entry.hasVisibleShadows() ? entry.getShadowMap()->getTexelSizeWorldSpace() : 0.0f;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        if (!(visibleMask[i] & VISIBLE_DIR_SHADOW_RENDERABLE) || !visibility[i].culling) {
+            continue;
+        }
+        uint2 lo, hi;
+        const Bounds b = getLightSpaceBounds(i);
+        bool reachesReceiver = false;
+        if (getCells(b, lo, hi)) {
+            for (uint32_t cy = lo.y; cy <= hi.y && !reachesReceiver; cy++) {
+                for (uint32_t cx = lo.x; cx <= hi.x && !reachesReceiver; cx++) {
+                    reachesReceiver = depths[cy * GRID_SIZE + cx] >= b.min.z;
+                }
+            }
+        }
+        bool tooSmall = false;
+        if (reachesReceiver && minTexels > 0.0f) {
+            const float2 size = b.max.xy - b.min.xy;
+            tooSmall = std::max(size.x, size.y) < minTexels * getTexelSize(i);
+        }
+        if (!reachesReceiver || tooSmall) {
+            visibleMask[i] &= ~VISIBLE_DIR_SHADOW_RENDERABLE;
+        }
+    }
+}
+
+bool ShadowMapManager::updateCachedShadowMap(size_t index, ShadowMapEntry const& entry,
+        bool vsm, bool cacheable, size_t casters) noexcept {
+    ShadowMap const& shadowMap = *entry.getShadowMap();
+    mat4f const& lightSpace =
+            vsm ? shadowMap.getLightSpaceMatrixVsm() : shadowMap.getLightSpaceMatrix();
+    const CachedShadowMap current{
+            .lightSpace = lightSpace,
+            .polygonOffset = shadowMap.getPolygonOffset(),
+            .casters = casters,
+            .layout = entry.getLayout(),
+            .valid = cacheable && entry.isStatic()
+    };
+    CachedShadowMap& cached = mCachedShadowMaps[index];
+    const bool hit = cached.valid && current.valid &&
+            cached.lightSpace == current.lightSpace &&
+            cached.polygonOffset.slope == current.polygonOffset.slope &&
+            cached.polygonOffset.constant == current.polygonOffset.constant &&
+            cached.casters == current.casters &&
+            cached.layout.layer == current.layout.layer &&
+            cached.layout.size == current.layout.size &&
+            cached.layout.vsmBlurWidth == current.layout.vsmBlurWidth &&
+            cached.layout.offset == current.layout.offset;
+    cached = current;
+    return !hit;
+}
+
 void ShadowMapManager::prepareShadow(backend::Handle<backend::HwTexture> texture,
         FView const& view) const noexcept {
     uint8_t anisotropy = 0;
@@ -303,12 +666,13 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateCascadeShadowMaps(
                 .zResolution = mTextureZResolution,
                 .atlasDimension = textureSize,
                 .textureDimension = textureDimension,
-                .shadowDimension = textureDimension - 2
+                .shadowDimension = textureDimension - 2,
+                .offset = mCascadeShadowMaps[0].getLayout().offset
         };
         map.update(lightData, 0, scene, viewingCameraInfo, visibleLayers,
                 layout, cascadeParams);
         Frustum const& frustum = map.getCamera().getFrustum();
-        FView::cullRenderables(engine.getJobSystem(), renderableData, frustum,
+        FView::cullRenderables(engine.getJobSystem(), *scene, renderableData, frustum,
                 VISIBLE_DIR_SHADOW_RENDERABLE_BIT);
 
         // Set shadowBias, using the first directional cascade.
@@ -386,7 +750,8 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateCascadeShadowMaps(
                 .zResolution = mTextureZResolution,
                 .atlasDimension = textureSize,
                 .textureDimension = textureDimension,
-                .shadowDimension = textureDimension - 2
+                .shadowDimension = textureDimension - 2,
+                .offset = entry.getLayout().offset
         };
         cascadeParams.csNearFar = { csSplitPosition[i], csSplitPosition[i + 1] };
         shadowMap.update(lightData, 0, scene, viewingCameraInfo, visibleLayers, layout, cascadeParams);
@@ -403,6 +768,11 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateCascadeShadowMaps(
         }
     }
 
+    if (cascadeHasVisibleShadows) {
+        cullDirectionalShadowCasters(view, renderableData,
+                lightData.elementAt<FScene::DIRECTION>(0), options.minCasterTexels);
+    }
+
     // screen-space contact shadows for the directional light
     screenSpaceShadowDistance = options.maxShadowDistance;
     if (options.screenSpaceContactShadows) {
@@ -444,6 +814,9 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateSpotShadowMaps(
     // shadow-map shadows for point/spot lights
     auto& lcm = engine.getLightManager();
     FScene::ShadowInfo* const shadowInfo = lightData.data<FScene::SHADOW_INFO>();
+    Frustum frusta[CONFIG_MAX_SHADOW_MAPS_PUNCTUAL];
+    size_t cullingBits[CONFIG_MAX_SHADOW_MAPS_PUNCTUAL];
+    size_t cullingCount = 0;
     for (size_t i = 0, c = mSpotShadowMaps.size(); i < c; i++) {
         auto& entry = mSpotShadowMaps[i];
 
@@ -456,7 +829,9 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateSpotShadowMaps(
                 .zResolution = mTextureZResolution,
                 .atlasDimension = textureSize,
                 .textureDimension = textureDimension,
-                .shadowDimension = textureDimension - 2
+                .shadowDimension = textureDimension - 2,
+                .offset = entry.getLayout().offset,
+                .face = entry.getFace()
         };
         shadowMap.update(lightData, l, scene, viewingCameraInfo, visibleLayers, layout, {});
 
@@ -464,22 +839,28 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateSpotShadowMaps(
         if (shadowMap.hasVisibleShadows()) {
             entry.setHasVisibleShadows(true);
 
-            // Cull shadow casters
+            // shadow casters are culled below, for all the spot lights and point light faces at
+            // once. The faces of a point light share a visibility bit, which ends up set for the
+            // casters visible in any of them.
             UniformBuffer& u = shadowUb;
-            Frustum const& frustum = shadowMap.getCamera().getFrustum();
-            FView::cullRenderables(engine.getJobSystem(), renderableData, frustum,
-                    VISIBLE_SPOT_SHADOW_RENDERABLE_N_BIT(i));
+            frusta[cullingCount] = shadowMap.getCamera().getFrustum();
+            cullingBits[cullingCount] =
+                    VISIBLE_SPOT_SHADOW_RENDERABLE_N_BIT(entry.getLightSlot());
+            cullingCount++;
 
             mat4f const& lightFromWorldMatrix =
                 view.hasVsm() ? shadowMap.getLightSpaceMatrixVsm() : shadowMap.getLightSpaceMatrix();
             u.setUniform(offsetof(ShadowUib, spotLightFromWorldMatrix) +
                     sizeof(mat4f) * i, lightFromWorldMatrix);
 
+            // a point light's index is the one of its first face, they're all in the same layer
             shadowInfo[l].castsShadows = true;
-            shadowInfo[l].index = i;
+            shadowInfo[l].index = i - entry.getFace();
             shadowInfo[l].layer = mSpotShadowMaps[i].getLayout().layer;
 
-            const float3 dir = lightData.elementAt<FScene::DIRECTION>(l);
+            const float3 dir = entry.isPointLight() ?
+                    ShadowMap::getCubeFaceDirection(entry.getFace()) :
+                    lightData.elementAt<FScene::DIRECTION>(l);
             const float texelSizeWorldSpace = shadowMap.getTexelSizeWorldSpace();
             const float normalBias = lcm.getShadowNormalBias(light);
             u.setUniform(offsetof(ShadowUib, directionShadowBias) + sizeof(float4) * i,
@@ -489,6 +870,10 @@ ShadowMapManager::ShadowTechnique ShadowMapManager::updateSpotShadowMaps(
         }
     }
 
+    // Cull shadow casters
+    FView::cullRenderables(engine.getJobSystem(), *scene, renderableData,
+            frusta, cullingBits, cullingCount);
+
     // screen-space contact shadows for point/spot lights
     auto *pInstance = lightData.data<FScene::LIGHT_INSTANCE>();
     for (size_t i = 0, c = lightData.size(); i < c; i++) {
@@ -537,33 +922,164 @@ void ShadowMapManager::calculateTextureRequirements(FEngine& engine, FView& view
         return std::max((uint8_t) 1u, options.vsm.msaaSamples);
     };
 
-    // Lay out the shadow maps. For now, we take the largest requested dimension and allocate a
-    // texture of that size. Each cascade / shadow map gets its own layer in the array texture.
-    // The directional shadow cascades start on layer 0, followed by spot lights.
+    auto getShadowMapVsmBlurWidth = [&](size_t lightIndex) {
+        if (!view.hasVsm()) {
+            return 0.0f;
+        }
+        FLightManager::Instance light = lightData.elementAt<FScene::LIGHT_INSTANCE>(lightIndex);
+        return lcm.getShadowOptions(light).vsm.blurWidth;
+    };
+
+    auto isStatic = [&](size_t lightIndex) {
+        FLightManager::Instance light = lightData.elementAt<FScene::LIGHT_INSTANCE>(lightIndex);
+        return lcm.getShadowOptions(light).isStatic;
+    };
+
+    // Fraction of the viewport height covered by the light's sphere of influence.
+    CameraInfo const& camera = view.getCameraInfo();
+    auto getScreenCoverage = [&](size_t lightIndex) {
+        const float4 sphere = lightData.elementAt<FScene::POSITION_RADIUS>(lightIndex);
+        if (camera.projection[3][3] != 0.0f) {
+            // orthographic projection
+            return std::min(1.0f, sphere.w * camera.projection[1][1]);
+        }
+        const float d2 = length2(sphere.xyz - camera.getPosition());
+        const float r2 = sphere.w * sphere.w;
+        if (d2 <= r2) {
+            return 1.0f;
+        }
+        // tangent of the half-angle subtended by the sphere
+        const float t = sphere.w / std::sqrt(d2 - r2);
+        return std::min(1.0f, t * camera.projection[1][1]);
+    };
+
+    // Lay out the shadow maps. We take the largest requested dimension and allocate a texture of
+    // that size. Each cascade gets its own layer in the array texture, starting on layer 0.
+    // Point lights get a layer each. Spot lights that don't cover much of the screen get a smaller
+    // shadow map, which are packed together in the following layers.
     uint8_t layer = 0;
     uint16_t maxDimension = 0;
-    for (auto& cascade : mCascadeShadowMaps) {
-        // Shadow map size should be the same for all cascades.
-        const size_t lightIndex = cascade.getLightIndex();
+    if (!mCascadeShadowMaps.empty()) {
+        // The shadow map size of the directional light is an upper bound. Each cascade gets the
+        // smallest power-of-two size giving it about one texel per pixel, so that distant
+        // cascades don't waste memory and fill-rate. Sizes only change at power-of-two
+        // thresholds, so the shadow texture is rarely reallocated.
+        const size_t lightIndex = mCascadeShadowMaps[0].getLightIndex();
         const uint16_t dim = getShadowMapSize(lightIndex);
         const uint8_t vsmSamples = getShadowMapVsmSamples(lightIndex);
+        const float vsmBlurWidth = getShadowMapVsmBlurWidth(lightIndex);
+        FLightManager::Instance light = lightData.elementAt<FScene::LIGHT_INSTANCE>(lightIndex);
+        LightManager::ShadowOptions const& options = lcm.getShadowOptions(light);
+        const float viewportHeight = float(view.getViewport().height);
+        const size_t cascadeCount = mCascadeShadowMaps.size();
+        for (size_t i = 0; i < cascadeCount; i++) {
+            // the split positions are computed the same way in updateCascadeShadowMaps()
+            const float splitNear = i == 0 ? 0.0f : options.cascadeSplitPositions[i - 1];
+            const float splitFar = i == cascadeCount - 1 ? 1.0f : options.cascadeSplitPositions[i];
+            const float near = camera.zn + (camera.zf - camera.zn) * splitNear;
+            const float far = camera.zn + (camera.zf - camera.zn) * splitFar;
+            const float required = std::min(float(dim),
+                    ShadowMap::computeCascadeDimension(camera, viewportHeight, near, far));
+            const uint32_t size = std::max(MIN_CASCADE_SHADOW_MAP_SIZE, uint32_t(required));
+            const uint16_t cascadeDim = uint16_t(std::min(uint32_t(dim),
+                    1u << (32u - utils::clz(size - 1u))));
+            maxDimension = std::max(maxDimension, cascadeDim);
+            mCascadeShadowMaps[i].setLayout({
+                .layer = layer++,
+                .size = cascadeDim,
+                .vsmSamples = vsmSamples,
+                .vsmBlurWidth = vsmBlurWidth
+            });
+            mCascadeShadowMaps[i].setStatic(isStatic(lightIndex));
+        }
+    }
+    for (auto& spotShadowMap : mSpotShadowMaps) {
+        uint16_t dim = getShadowMapSize(spotShadowMap.getLightIndex());
+        if (spotShadowMap.isPointLight()) {
+            // the layer of a point light must fit 3 faces of at least 3 texels across
+            dim = std::max(dim, uint16_t(9u));
+        }
         maxDimension = std::max(maxDimension, dim);
-        cascade.setLayout({
-            .layer = layer++,
-            .size = dim,
-            .vsmSamples = vsmSamples
-        });
     }
+
+    // The packed shadow maps have power-of-two sizes, and fill the largest power-of-two square
+    // of a layer.
+    const uint32_t tileArea = maxDimension ?
+            1u << (2u * (31u - utils::clz(uint32_t(maxDimension)))) : 0u;
+
+    ShadowMapEntry* packedShadowMaps[CONFIG_MAX_SHADOW_CASTING_SPOTS];
+    size_t packedCount = 0;
     for (auto& spotShadowMap : mSpotShadowMaps) {
         const size_t lightIndex = spotShadowMap.getLightIndex();
         const uint16_t dim = getShadowMapSize(lightIndex);
         const uint8_t vsmSamples = getShadowMapVsmSamples(lightIndex);
-        maxDimension = std::max(maxDimension, dim);
+        const float vsmBlurWidth = getShadowMapVsmBlurWidth(lightIndex);
+        spotShadowMap.setStatic(isStatic(lightIndex));
+
+        if (spotShadowMap.isPointLight()) {
+            // The faces of a point light are laid out on a 3x2 grid in their own layer, so that
+            // they're all sampled from the layer of the light. The light's shadow map size is
+            // the size of this layer, the faces are sized by the light's screen coverage.
+            const uint32_t maxFaceSize = std::max(uint32_t(dim), 9u) / 3u;
+            const uint32_t coverage =
+                    uint32_t(std::ceil(maxFaceSize * getScreenCoverage(lightIndex)));
+            const uint32_t faceSize = std::min(maxFaceSize,
+                    std::max(coverage, MIN_SPOT_SHADOW_MAP_SIZE));
+            const uint8_t face = spotShadowMap.getFace();
+            if (face == 0) {
+                layer++;
+            }
+            spotShadowMap.setLayout({
+                .layer = uint8_t(layer - 1),
+                .size = faceSize,
+                .vsmSamples = vsmSamples,
+                .vsmBlurWidth = vsmBlurWidth,
+                .offset = { (face % 3u) * faceSize, (face / 3u) * faceSize }
+            });
+            continue;
+        }
+
+        const uint32_t coverage = uint32_t(std::ceil(dim * getScreenCoverage(lightIndex)));
+        const uint32_t size = std::max(coverage, std::min(uint32_t(dim), MIN_SPOT_SHADOW_MAP_SIZE));
+        const uint32_t tileSize = std::max(4u, 1u << (32u - utils::clz(size - 1u)));
+
+        // Shadow maps that don't fit in a quarter of a layer keep their own layer, as do
+        // multisampled VSM shadow maps (which are resolved as a whole layer).
+        if (tileSize * tileSize * 4u > tileArea || vsmSamples > 1) {
+            spotShadowMap.setLayout({
+                .layer = layer++,
+                .size = dim,
+                .vsmSamples = vsmSamples,
+                .vsmBlurWidth = vsmBlurWidth
+            });
+            continue;
+        }
         spotShadowMap.setLayout({
-            .layer = layer++,
-            .size = dim,
-            .vsmSamples = vsmSamples
+            .size = tileSize,
+            .vsmSamples = vsmSamples,
+            .vsmBlurWidth = vsmBlurWidth
         });
+        packedShadowMaps[packedCount++] = &spotShadowMap;
+    }
+
+    // Packing the shadow maps from the largest to the smallest along a Morton curve wastes no
+    // space: the position on the curve is always a multiple of the area of the next shadow map.
+    std::stable_sort(packedShadowMaps, packedShadowMaps + packedCount,
+            [](ShadowMapEntry const* lhs, ShadowMapEntry const* rhs) {
+                return lhs->getLayout().size > rhs->getLayout().size;
+            });
+    uint32_t position = tileArea;
+    for (size_t i = 0; i < packedCount; i++) {
+        ShadowLayout layout = packedShadowMaps[i]->getLayout();
+        const uint32_t area = layout.size * layout.size;
+        if (position + area > tileArea) {
+            position = 0;
+            layer++;
+        }
+        layout.layer = layer - 1;
+        layout.offset = { compactBits(position), compactBits(position >> 1u) };
+        packedShadowMaps[i]->setLayout(layout);
+        position += area;
     }
 
     const uint8_t layersNeeded = layer;
@@ -119,9 +119,7 @@ FSkybox::FSkybox(FEngine& engine, const Builder& builder) noexcept
 }
 
 FMaterial const* FSkybox::createMaterial(FEngine& engine) {
-    FMaterial const* material = upcast(Material::Builder().package(
-            MATERIALS_SKYBOX_DATA, MATERIALS_SKYBOX_SIZE).build(engine));
-    return material;
+    return engine.createEmbeddedMaterial(MATERIALS_SKYBOX_DATA, MATERIALS_SKYBOX_SIZE);
 }
 
 void FSkybox::terminate(FEngine& engine) noexcept {
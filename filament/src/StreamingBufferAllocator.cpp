@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StreamingBufferAllocator.h"
+
+#include <utils/compiler.h>
+#include <utils/memalign.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdlib.h>
+
+namespace filament {
+
+using namespace backend;
+
+StreamingBufferAllocator::~StreamingBufferAllocator() noexcept {
+    utils::aligned_free(mStorage);
+}
+
+BufferDescriptor StreamingBufferAllocator::allocate(size_t size) noexcept {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    if (UTILS_UNLIKELY(!mStorage)) {
+        mStorage = (uint8_t*)utils::aligned_alloc(CAPACITY, ALIGNMENT);
+    }
+
+    // the free space is [head, CAPACITY) and [0, tail) when the used space doesn't wrap around,
+    // [head, tail) when it does.
+    uint32_t begin = uint32_t(CAPACITY);
+    if (mAllocations.empty()) {
+        mHead = mTail = 0;
+    }
+    if (mAllocations.empty() || mHead > mTail) {
+        if (CAPACITY - mHead >= size) {
+            begin = mHead;
+        } else if (mTail >= size) {
+            begin = 0;
+        }
+    } else if (mHead < mTail && mTail - mHead >= size) {
+        begin = mHead;
+    }
+
+    if (UTILS_UNLIKELY(!mStorage || begin == CAPACITY)) {
+        // the ring is full, or too small for this update
+        return BufferDescriptor(malloc(size), size,
+                [](void* buffer, size_t, void*) { free(buffer); });
+    }
+
+    mHead = begin + uint32_t(size);
+    mAllocations.push_back({ begin, mHead, false });
+    return BufferDescriptor(mStorage + begin, size, &StreamingBufferAllocator::release, this);
+}
+
+void StreamingBufferAllocator::release(void* buffer, size_t, void* user) {
+    static_cast<StreamingBufferAllocator*>(user)->release(buffer);
+}
+
+void StreamingBufferAllocator::release(void const* buffer) noexcept {
+    // Allocations are normally released in order, but we don't rely on it: the ring only
+    // reclaims the oldest ones.
+    const uint32_t begin = uint32_t((uint8_t const*)buffer - mStorage);
+    auto pos = std::find_if(mAllocations.begin(), mAllocations.end(),
+            [begin](Allocation const& allocation) { return allocation.begin == begin; });
+    assert(pos != mAllocations.end());
+    pos->released = true;
+    while (!mAllocations.empty() && mAllocations.front().released) {
+        mAllocations.pop_front();
+    }
+    mTail = mAllocations.empty() ? mHead : mAllocations.front().begin;
+}
+
+size_t StreamingBufferAllocator::getUsedSize() const noexcept {
+    if (mAllocations.empty()) {
+        return 0;
+    }
+    return mHead > mTail ? mHead - mTail : CAPACITY - mTail + mHead;
+}
+
+} // namespace filament
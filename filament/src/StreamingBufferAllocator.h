@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_STREAMINGBUFFERALLOCATOR_H
+#define TNT_FILAMENT_STREAMINGBUFFERALLOCATOR_H
+
+#include <backend/BufferDescriptor.h>
+
+#include <deque>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+// Provides the memory of the buffer updates of streaming geometry, which the client writes to
+// directly (see VertexBuffer::mapBufferAt()). The memory comes from a ring that spans a few
+// frames: each allocation returns to the ring when the backend has consumed it, i.e. when the
+// callback of its BufferDescriptor is called, so there is no malloc or free per update.
+// This is only used from the thread of the Engine, where the callbacks are called.
+class StreamingBufferAllocator {
+public:
+    static constexpr size_t CAPACITY = 4u * 1024u * 1024u;
+
+    // allocations are aligned to this
+    static constexpr size_t ALIGNMENT = 16u;
+
+    StreamingBufferAllocator() noexcept = default;
+    ~StreamingBufferAllocator() noexcept;
+
+    StreamingBufferAllocator(StreamingBufferAllocator const& rhs) = delete;
+    StreamingBufferAllocator& operator=(StreamingBufferAllocator const& rhs) = delete;
+
+    // Returns a BufferDescriptor of 'size' bytes whose callback gives the memory back. When the
+    // ring is full the memory is allocated on the heap instead.
+    backend::BufferDescriptor allocate(size_t size) noexcept;
+
+    // number of bytes of the ring in use, including the end skipped when it wraps around
+    size_t getUsedSize() const noexcept;
+
+private:
+    struct Allocation {
+        uint32_t begin;
+        uint32_t end;
+        bool released;
+    };
+
+    static void release(void* buffer, size_t size, void* user);
+    void release(void const* buffer) noexcept;
+
+    uint8_t* mStorage = nullptr;            // allocated on first use
+    uint32_t mHead = 0;                     // where the next allocation goes
+    uint32_t mTail = 0;                     // start of the oldest allocation in use
+    std::deque<Allocation> mAllocations;    // in the order of the ring
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_STREAMINGBUFFERALLOCATOR_H
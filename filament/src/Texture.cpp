@@ -28,9 +28,16 @@
 #include <ibl/CubemapUtils.h>
 #include <ibl/Image.h>
 
+#include <utils/JobSystem.h>
+#include <utils/Mutex.h>
 #include <utils/Panic.h>
 #include <filament/Texture.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 using namespace utils;
 
 namespace filament {
@@ -46,6 +53,8 @@ struct Texture::BuilderDetails {
     Sampler mTarget = Sampler::SAMPLER_2D;
     InternalFormat mFormat = InternalFormat::RGBA8;
     Usage mUsage = Usage::DEFAULT;
+    StreamingCallback mStreamingCallback = nullptr;
+    void* mStreamingUser = nullptr;
     bool mTextureIsSwizzled = false;
     std::array<Swizzle, 4> mSwizzle = {
            Swizzle::CHANNEL_0, Swizzle::CHANNEL_1,
@@ -108,6 +117,12 @@ Texture::Builder& Texture::Builder::swizzle(Swizzle r, Swizzle g, Swizzle b, Swi
     return *this;
 }
 
+Texture::Builder& Texture::Builder::streaming(StreamingCallback callback, void* user) noexcept {
+    mImpl->mStreamingCallback = callback;
+    mImpl->mStreamingUser = user;
+    return *this;
+}
+
 Texture* Texture::Builder::build(Engine& engine) {
     if (!ASSERT_POSTCONDITION_NON_FATAL(Texture::isTextureFormatSupported(engine, mImpl->mFormat),
             "Texture format %u not supported on this platform", mImpl->mFormat)) {
@@ -128,6 +143,15 @@ Texture* Texture::Builder::build(Engine& engine) {
     ASSERT_POSTCONDITION_NON_FATAL((imported && sampleable) || !imported,
             "Imported texture must be SAMPLEABLE");
 
+    if (mImpl->mStreamingCallback) {
+        ASSERT_PRECONDITION(mImpl->mTarget == Sampler::SAMPLER_2D,
+                "Streamed texture must be a SAMPLER_2D");
+        ASSERT_PRECONDITION(mImpl->mUsage == TextureUsage::DEFAULT,
+                "Streamed texture must have the DEFAULT usage");
+        ASSERT_PRECONDITION(!swizzled && !imported,
+                "Streamed texture can't be swizzled or imported");
+    }
+
     return upcast(engine).createTexture(*this);
 }
 
@@ -142,7 +166,17 @@ FTexture::FTexture(FEngine& engine, const Builder& builder) {
     mDepth  = static_cast<uint32_t>(builder->mDepth);
     mLevelCount = std::min(builder->mLevels, FTexture::maxLevelCount(mWidth, mHeight));
 
-    FEngine::DriverApi& driver = engine.getDriverApi();
+    FEngine::ResourceCommands commands(engine);
+    FEngine::DriverApi& driver = commands.getDriverApi();
+    if (UTILS_UNLIKELY(builder->mStreamingCallback)) {
+        // the TextureStreamer is only used by the engine's thread
+        ASSERT_PRECONDITION(engine.isEngineThread(),
+                "Streamed textures must be created on the engine's thread.");
+        mResidency = engine.getTextureStreamer().add(driver, *this,
+                builder->mStreamingCallback, builder->mStreamingUser);
+        return;
+    }
+
     if (UTILS_LIKELY(builder->mImportedId == 0)) {
         if (UTILS_LIKELY(!builder->mTextureIsSwizzled)) {
             mHandle = driver.createTexture(
@@ -162,6 +196,11 @@ FTexture::FTexture(FEngine& engine, const Builder& builder) {
 // frees driver resources, object becomes invalid
 void FTexture::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
+    if (UTILS_UNLIKELY(mResidency)) {
+        engine.getTextureStreamer().remove(driver, *this);
+        mResidency = nullptr;
+        return;
+    }
     driver.destroyTexture(mHandle);
 }
 
@@ -235,7 +274,21 @@ void FTexture::setImage(FEngine& engine,
         return;
     }
 
-    engine.getDriverApi().update2DImage(mHandle,
+    if (UTILS_UNLIKELY(mResidency)) {
+        if (!ASSERT_POSTCONDITION_NON_FATAL(xoffset == 0 && yoffset == 0 &&
+                        width == valueForLevel(level, mWidth) &&
+                        height == valueForLevel(level, mHeight),
+                "Levels of a streamed texture must be set whole.")) {
+            return;
+        }
+        ASSERT_PRECONDITION(engine.isEngineThread(),
+                "Streamed textures must be set on the engine's thread.");
+        engine.getTextureStreamer().upload(engine.getDriverApi(), *this, level, std::move(buffer));
+        return;
+    }
+
+    FEngine::ResourceCommands commands(engine);
+    commands.getDriverApi().update2DImage(mHandle,
             uint8_t(level), xoffset, yoffset, width, height, std::move(buffer));
 }
 
@@ -306,7 +359,8 @@ void FTexture::setImage(FEngine& engine,
         return;
     }
 
-    engine.getDriverApi().update3DImage(mHandle,
+    FEngine::ResourceCommands commands(engine);
+    commands.getDriverApi().update3DImage(mHandle,
             uint8_t(level), xoffset, yoffset, zoffset, width, height, depth, std::move(buffer));
 }
 
@@ -350,7 +404,8 @@ void FTexture::setImage(FEngine& engine, size_t level,
         return;
     }
 
-    engine.getDriverApi().updateCubeImage(mHandle, uint8_t(level),
+    FEngine::ResourceCommands commands(engine);
+    commands.getDriverApi().updateCubeImage(mHandle, uint8_t(level),
             std::move(buffer), faceOffsets);
 }
 
@@ -392,6 +447,11 @@ void FTexture::generateMipmaps(FEngine& engine) const noexcept {
         return;
     }
 
+    if (!ASSERT_POSTCONDITION_NON_FATAL(!mResidency,
+            "generateMipmaps() called on a streamed texture.")) {
+        return;
+    }
+
     if (mLevelCount < 2 || (mWidth == 1 && mHeight == 1)) {
         return;
     }
@@ -436,6 +496,10 @@ void FTexture::generateMipmaps(FEngine& engine) const noexcept {
         for (uint16_t layer = 0; layer < 6; ++layer) {
             generateMipsForLayer(layer);
         }
+    } else if (mTarget == Sampler::SAMPLER_2D_ARRAY) {
+        for (uint16_t layer = 0; layer < mDepth; ++layer) {
+            generateMipsForLayer(layer);
+        }
     }
 }
 
@@ -443,6 +507,10 @@ bool FTexture::isTextureFormatSupported(FEngine& engine, InternalFormat format)
     return engine.getDriverApi().isTextureFormatSupported(format);
 }
 
+bool FTexture::isTextureFormatMipmappable(FEngine& engine, InternalFormat format) noexcept {
+    return engine.getDriverApi().isTextureFormatMipmappable(format);
+}
+
 size_t FTexture::computeTextureDataSize(Texture::Format format, Texture::Type type,
         size_t stride, size_t height, size_t alignment) noexcept {
     return PixelBufferDescriptor::computeDataSize(format, type, stride, height, alignment);
@@ -452,6 +520,17 @@ size_t FTexture::getFormatSize(InternalFormat format) noexcept {
     return backend::getFormatSize(format);
 }
 
+size_t FTexture::getMemorySize() const noexcept {
+    if (mTarget == Sampler::SAMPLER_EXTERNAL) {
+        // the memory belongs to the external image
+        return 0;
+    }
+    const uint8_t baseLevel = UTILS_UNLIKELY(mResidency) ? mResidency->current.baseLevel : 0;
+    const size_t layerCount = isCubemap() ? 6 : mDepth;
+    return TextureStreamer::getLevelsSize(mWidth, mHeight, mFormat, baseLevel, mLevelCount) *
+            layerCount * mSampleCount;
+}
+
 
 // this is a hack to be able to create a std::function<> with a non-copyable closure
 template<class F>
@@ -463,6 +542,111 @@ auto make_copyable_function(F&& f) {
     };
 }
 
+namespace {
+
+// a prefiltered level of a reflection map, ready to be uploaded
+struct PrefilteredLevel {
+    size_t level;
+    ibl::Image image;
+    backend::FaceOffsets offsets;
+};
+
+// State of an asynchronous generatePrefilterMipmap(), shared by the low priority job doing the
+// prefiltering and the frame job uploading the levels as soon as they're ready.
+struct AsyncPrefilter {
+    explicit AsyncPrefilter(JobSystem& js) noexcept : js(js) { }
+
+    ~AsyncPrefilter() {
+        // if the texture is destroyed first, the job stops after its current level
+        canceled.store(true, std::memory_order_relaxed);
+        if (job) {
+            js.waitAndRelease(job);
+        }
+    }
+
+    JobSystem& js;
+    JobSystem::Job* job = nullptr;
+    std::atomic<bool> canceled = { false };
+
+    // the base level, the job creates the others
+    std::vector<ibl::Image> images;
+    std::vector<ibl::Cubemap> levels;
+
+    utils::Mutex lock;
+    std::vector<PrefilteredLevel> ready;    // guarded by lock
+    bool done = false;                      // guarded by lock
+};
+
+} // anonymous namespace
+
+// Prefilters each level of a reflection map from the base level of the environment, which must
+// be the only element of 'levels', and calls emit() with each of them, in order. Stops early
+// if canceled() returns true.
+template<typename Emit, typename Canceled>
+static void prefilterLevels(JobSystem& js,
+        std::vector<ibl::Image>& images, std::vector<ibl::Cubemap>& levels,
+        Texture::PrefilterOptions const& options, Emit emit, Canceled canceled) {
+    using namespace ibl;
+    using namespace math;
+
+    const size_t size = levels[0].getDimensions();
+    const size_t baseExp = ctz(size);
+    const size_t numLevels = baseExp + 1;
+    images.reserve(numLevels);
+    levels.reserve(numLevels);
+
+    // make the cubemap seamless
+    levels[0].makeSeamless();
+
+    // Now generate all the mipmap levels
+    Image temp;
+    for (size_t dim = size, mipLevel = 0; dim > 1; mipLevel++) {
+        dim >>= 1u;
+        Cubemap dst = CubemapUtils::create(temp, dim);
+        CubemapUtils::downsampleCubemapLevelBoxFilter(js, dst, levels[mipLevel]);
+        dst.makeSeamless();
+        images.push_back(std::move(temp));
+        levels.push_back(std::move(dst));
+    }
+
+    const float3 mirror = options.mirror ? float3{ -1, 1, 1 } : float3{ 1, 1, 1 };
+
+    // Finally generate each pre-filtered mipmap level
+    size_t numSamples = options.sampleCount;
+    for (ssize_t i = baseExp; i >= 0 && !canceled(); --i) {
+        const size_t dim = 1U << i;
+        const size_t level = baseExp - i;
+        const float lod = saturate(level / (numLevels - 1.0f));
+        const float linearRoughness = lod * lod;
+
+        Image image;
+        Cubemap dst = CubemapUtils::create(image, dim);
+        CubemapIBL::roughnessFilter(js, dst, levels, linearRoughness, numSamples, mirror, true);
+
+        uintptr_t base = uintptr_t(image.getData());
+        backend::FaceOffsets offsets{};
+        for (size_t j = 0; j < 6; j++) {
+            Image const& faceImage = dst.getImageForFace((Cubemap::Face)j);
+            offsets[j] = uintptr_t(faceImage.getData()) - base;
+        }
+        emit(PrefilteredLevel{ level, std::move(image), offsets });
+    }
+}
+
+static void uploadPrefilteredLevel(FEngine::DriverApi& driver,
+        backend::Handle<backend::HwTexture> handle, PrefilteredLevel& level) {
+    ibl::Image& image = level.image;
+    Texture::PixelBufferDescriptor pbd(image.getData(), image.getSize(),
+            Texture::PixelBufferDescriptor::PixelDataFormat::RGB,
+            Texture::PixelBufferDescriptor::PixelDataType::FLOAT, 1, 0, 0, image.getStride());
+
+    // upload all 6 faces into the texture
+    driver.updateCubeImage(handle, level.level, std::move(pbd), level.offsets);
+
+    // enqueue a commands that holds the image data until it's executed
+    driver.queueCommand(make_copyable_function([data = image.detach()]() {}));
+}
+
 void FTexture::generatePrefilterMipmap(FEngine& engine,
         PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
         PrefilterOptions const* options) {
@@ -508,24 +692,6 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
     JobSystem& js = engine.getJobSystem();
     FEngine::DriverApi& driver = engine.getDriverApi();
 
-    auto generateMipmaps = [](JobSystem& js,
-            std::vector<Cubemap>& levels, std::vector<Image>& images) {
-        Image temp;
-        const Cubemap& base(levels[0]);
-        size_t dim = base.getDimensions();
-        size_t mipLevel = 0;
-        while (dim > 1) {
-            dim >>= 1u;
-            Cubemap dst = CubemapUtils::create(temp, dim);
-            const Cubemap& src(levels[mipLevel++]);
-            CubemapUtils::downsampleCubemapLevelBoxFilter(js, dst, src);
-            dst.makeSeamless();
-            images.push_back(std::move(temp));
-            levels.push_back(std::move(dst));
-        }
-    };
-
-
     /*
      * Create a Cubemap data structure
      */
@@ -597,58 +763,136 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
     }
 
     /*
-     * Create the mipmap chain
+     * Prefilter all the levels from the base
      */
 
-    std::vector<Image> images;
-    std::vector<Cubemap> levels;
-    images.reserve(getLevels());
-    levels.reserve(getLevels());
+    if (!options->async) {
+        std::vector<Image> images;
+        std::vector<Cubemap> levels;
+        images.push_back(std::move(temp));
+        levels.push_back(std::move(cml));
+        const size_t levelCount = ctz(size) + 1;
+        prefilterLevels(js, images, levels, *options,
+                [this, &driver, options, levelCount](PrefilteredLevel&& level) {
+                    uploadPrefilteredLevel(driver, mHandle, level);
+                    if (options->callback) {
+                        options->callback(this, (level.level + 1) / float(levelCount),
+                                options->user);
+                    }
+                }, []() { return false; });
+        return;
+    }
 
-    images.push_back(std::move(temp));
-    levels.push_back(std::move(cml));
+    // The prefiltering runs in a low priority job, the levels are uploaded by a frame job
+    // because the DriverApi can only be used from this thread. The state is shared between
+    // them, its destruction waits for the prefiltering job.
+    auto state = std::make_shared<AsyncPrefilter>(js);
+    AsyncPrefilter* const s = state.get();
+    s->images.push_back(std::move(temp));
+    s->levels.push_back(std::move(cml));
+    const PrefilterOptions prefilterOptions = *options;
+    s->job = js.runAndRetain(jobs::createJob(js, nullptr, [s, prefilterOptions]() {
+        prefilterLevels(s->js, s->images, s->levels, prefilterOptions,
+                [s](PrefilteredLevel&& level) {
+                    std::lock_guard<utils::Mutex> guard(s->lock);
+                    s->ready.push_back(std::move(level));
+                },
+                [s]() { return s->canceled.load(std::memory_order_relaxed); });
+        std::lock_guard<utils::Mutex> guard(s->lock);
+        s->done = true;
+    }), JobSystem::LOW_PRIORITY);
+
+    const size_t levelCount = ctz(size) + 1;
+    engine.addFrameJob(this, nullptr,
+            [this, state, prefilterOptions, levelCount](FEngine::DriverApi& driver) {
+                std::vector<PrefilteredLevel> ready;
+                bool done;
+                {
+                    std::lock_guard<utils::Mutex> guard(state->lock);
+                    std::swap(ready, state->ready);
+                    done = state->done;
+                }
+                for (PrefilteredLevel& level : ready) {
+                    uploadPrefilteredLevel(driver, mHandle, level);
+                }
+                if (!ready.empty() && prefilterOptions.callback) {
+                    prefilterOptions.callback(this, (ready.back().level + 1) / float(levelCount),
+                            prefilterOptions.user);
+                }
+                return done;
+            });
 
-    const float3 mirror = options->mirror ? float3{ -1, 1, 1 } : float3{ 1, 1, 1 };
+    // no need to call the user callback because buffer is a reference and it'll be destroyed
+    // by the caller (without being move()d here).
+}
 
-    // make the cubemap seamless
-    levels[0].makeSeamless();
+void FTexture::generatePrefilterMipmap(FEngine& engine, FTexture const* environment,
+        PrefilterOptions const* options) {
+    const size_t size = getWidth();
 
-    // Now generate all the mipmap levels
-    generateMipmaps(js, levels, images);
+    /* validate the environment */
 
-    // Finally generate each pre-filtered mipmap level
-    const size_t baseExp = ctz(size);
-    size_t numSamples = options->sampleCount;
-    const size_t numLevels = baseExp + 1;
-    for (ssize_t i = baseExp; i >= 0; --i) {
-        const size_t dim = 1U << i;
-        const size_t level = baseExp - i;
-        const float lod = saturate(level / (numLevels - 1.0f));
-        const float linearRoughness = lod * lod;
+    if (!ASSERT_PRECONDITION_NON_FATAL(environment && environment->isCubemap(),
+            "the environment must be a cubemap")) {
+        return;
+    }
 
-        Image image;
-        Cubemap dst = CubemapUtils::create(image, dim);
-        CubemapIBL::roughnessFilter(js, dst, levels, linearRoughness, numSamples, mirror, true);
+    if (!ASSERT_PRECONDITION_NON_FATAL(environment != this,
+            "the environment cannot be the reflections texture")) {
+        return;
+    }
 
-        Texture::PixelBufferDescriptor pbd(image.getData(), image.getSize(),
-                Texture::PixelBufferDescriptor::PixelDataFormat::RGB,
-                Texture::PixelBufferDescriptor::PixelDataType::FLOAT, 1, 0, 0, image.getStride());
+    /* validate texture */
 
-        uintptr_t base = uintptr_t(image.getData());
-        backend::FaceOffsets offsets{};
-        for (size_t j = 0; j < 6; j++) {
-            Image const& faceImage = dst.getImageForFace((Cubemap::Face)j);
-            offsets[j] = uintptr_t(faceImage.getData()) - base;
-        }
-        // upload all 6 faces into the texture
-        driver.updateCubeImage(mHandle, level, std::move(pbd), offsets);
+    if (!ASSERT_PRECONDITION_NON_FATAL(isCubemap(), "reflections texture must be a cubemap")) {
+        return;
+    }
 
-        // enqueue a commands that holds the image data until it's executed
-        driver.queueCommand(make_copyable_function([data = image.detach()]() {}));
+    if (!ASSERT_PRECONDITION_NON_FATAL(!(size & (size-1)),
+            "reflections cubemap dimensions must be a power-of-two")) {
+        return;
     }
 
-    // no need to call the user callback because buffer is a reference and it'll be destroyed
-    // by the caller (without being move()d here).
+    if (!ASSERT_PRECONDITION_NON_FATAL(!isCompressed(),
+            "reflections texture cannot be compressed")) {
+        return;
+    }
+
+    if (!ASSERT_PRECONDITION_NON_FATAL(any(mUsage & Usage::COLOR_ATTACHMENT) &&
+            engine.getDriverApi().isRenderTargetFormatSupported(mFormat),
+            "reflections texture must be a color attachment")) {
+        return;
+    }
+
+    PrefilterOptions prefilterOptions = options ? *options : PrefilterOptions{};
+    engine.addFrameJob(this, environment,
+            [&engine, this, environment, prefilterOptions](FEngine::DriverApi& driver) {
+                engine.getPostProcessManager().prefilterEnvironment(driver,
+                        environment, this, prefilterOptions, 0, getLevelCount());
+                if (prefilterOptions.callback) {
+                    prefilterOptions.callback(this, 1.0f, prefilterOptions.user);
+                }
+                return true;
+            });
+}
+
+void FTexture::computeIrradianceSH(FEngine& engine,
+        SphericalHarmonicsCallback callback, void* user, PrefilterOptions const* options) const {
+    if (!ASSERT_PRECONDITION_NON_FATAL(isCubemap(), "the environment must be a cubemap")) {
+        return;
+    }
+
+    if (!ASSERT_PRECONDITION_NON_FATAL(callback, "a callback is needed")) {
+        return;
+    }
+
+    const bool mirror = options ? options->mirror : PrefilterOptions{}.mirror;
+    engine.addFrameJob(this, nullptr,
+            [&engine, this, mirror, callback, user](FEngine::DriverApi& driver) {
+                engine.getPostProcessManager().computeIrradianceSH(driver,
+                        this, mirror, callback, user);
+                return true;
+            });
 }
 
 bool FTexture::validatePixelFormatAndType(TextureFormat internalFormat,
@@ -809,6 +1053,8 @@ bool FTexture::validatePixelFormatAndType(TextureFormat internalFormat,
         case TextureFormat::SRGB8_ALPHA8_ASTC_10x10:
         case TextureFormat::SRGB8_ALPHA8_ASTC_12x10:
         case TextureFormat::SRGB8_ALPHA8_ASTC_12x12:
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT:
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT:
             return false;
     }
 
@@ -1009,6 +1255,8 @@ bool FTexture::validatePixelFormatAndType(TextureFormat internalFormat,
         case TextureFormat::SRGB8_ALPHA8_ASTC_10x10:
         case TextureFormat::SRGB8_ALPHA8_ASTC_12x10:
         case TextureFormat::SRGB8_ALPHA8_ASTC_12x12:
+        case TextureFormat::RGB_BPTC_SIGNED_FLOAT:
+        case TextureFormat::RGB_BPTC_UNSIGNED_FLOAT:
             return false;
     }
 
@@ -1090,6 +1338,10 @@ bool Texture::isTextureFormatSupported(Engine& engine, InternalFormat format) no
     return FTexture::isTextureFormatSupported(upcast(engine), format);
 }
 
+bool Texture::isTextureFormatMipmappable(Engine& engine, InternalFormat format) noexcept {
+    return FTexture::isTextureFormatMipmappable(upcast(engine), format);
+}
+
 size_t Texture::computeTextureDataSize(Texture::Format format, Texture::Type type, size_t stride,
         size_t height, size_t alignment) noexcept {
     return FTexture::computeTextureDataSize(format, type, stride, height, alignment);
@@ -1100,4 +1352,14 @@ void Texture::generatePrefilterMipmap(Engine& engine, Texture::PixelBufferDescri
     upcast(this)->generatePrefilterMipmap(upcast(engine), std::move(buffer), faceOffsets, options);
 }
 
+void Texture::generatePrefilterMipmap(Engine& engine, Texture const* environment,
+        PrefilterOptions const* options) {
+    upcast(this)->generatePrefilterMipmap(upcast(engine), upcast(environment), options);
+}
+
+void Texture::computeIrradianceSH(Engine& engine, SphericalHarmonicsCallback callback,
+        void* user, PrefilterOptions const* options) const {
+    upcast(this)->computeIrradianceSH(upcast(engine), callback, user, options);
+}
+
 } // namespace filament
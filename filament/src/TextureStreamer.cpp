@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextureStreamer.h"
+
+#include "details/Texture.h"
+
+#include "private/backend/BackendUtils.h"
+#include "private/backend/DriverApi.h"
+
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace utils;
+
+namespace filament {
+
+using namespace backend;
+
+// the finest level wanted for a required level, the tail if the texture isn't needed
+static uint8_t clampLevel(float level, uint8_t tailLevel) noexcept {
+    if (!(level < float(tailLevel))) {
+        return tailLevel;
+    }
+    return uint8_t(std::max(0.0f, std::floor(level)));
+}
+
+TextureStreamer::TextureStreamer(size_t budget) noexcept : mBudget(budget) {
+}
+
+TextureStreamer::~TextureStreamer() noexcept {
+    assert(mTextures.empty());
+}
+
+TextureResidency* TextureStreamer::add(DriverApi& driver, FTexture& texture,
+        Texture::StreamingCallback callback, void* user) {
+    TextureResidency* const residency = new TextureResidency{};
+    residency->callback = callback;
+    residency->user = user;
+
+    uint8_t tailLevel = 0;
+    const uint8_t lastLevel = uint8_t(texture.getLevelCount() - 1);
+    while (tailLevel < lastLevel &&
+            std::max(texture.getWidth(tailLevel), texture.getHeight(tailLevel)) > TAIL_SIZE) {
+        tailLevel++;
+    }
+    residency->tailLevel = tailLevel;
+
+    // the levels are requested by the next update()
+    residency->current = allocate(driver, texture, tailLevel);
+
+    residency->index = uint32_t(mTextures.size());
+    mTextures.push_back(&texture);
+    return residency;
+}
+
+void TextureStreamer::remove(DriverApi& driver, FTexture const& texture) noexcept {
+    TextureResidency* const residency = texture.getResidency();
+    driver.destroyTexture(residency->current.handle);
+    if (residency->pending.handle) {
+        driver.destroyTexture(residency->pending.handle);
+    }
+
+    FTexture* const last = mTextures.back();
+    mTextures[residency->index] = last;
+    last->getResidency()->index = residency->index;
+    mTextures.pop_back();
+    delete residency;
+}
+
+void TextureStreamer::upload(DriverApi& driver, FTexture const& texture, size_t level,
+        Texture::PixelBufferDescriptor&& buffer) noexcept {
+    TextureResidency& residency = *texture.getResidency();
+
+    // levels are requested again each time a texture is reallocated, so they can arrive after
+    // the allocation they were requested for is gone, or more than once
+    TextureResidency::Allocation* allocation = nullptr;
+    if (residency.pending.handle && level >= residency.pending.baseLevel) {
+        allocation = &residency.pending;
+    } else if (level >= residency.current.baseLevel) {
+        allocation = &residency.current;
+    }
+    const uint32_t bit = 1u << level;
+    if (!allocation || (allocation->uploaded & bit)) {
+        // nothing needs this level, the buffer is released by its destructor
+        return;
+    }
+
+    allocation->uploaded |= bit;
+    driver.update2DImage(allocation->handle, uint8_t(level - allocation->baseLevel), 0, 0,
+            uint32_t(texture.getWidth(level)), uint32_t(texture.getHeight(level)),
+            std::move(buffer));
+
+    if (allocation == &residency.current) {
+        // the range is set again even if it didn't change, because some backends (e.g. Metal)
+        // extend it to the levels uploaded
+        const uint8_t levelCount = uint8_t(texture.getLevelCount());
+        setSampledLevels(driver, residency.current, levelCount, true);
+    }
+}
+
+void TextureStreamer::setSampledLevels(DriverApi& driver,
+        TextureResidency::Allocation& allocation, uint8_t levelCount, bool force) noexcept {
+    // shaders only sample the levels uploaded so far
+    const uint8_t residentLevel = getResidentLevel(allocation, levelCount);
+    if (residentLevel < levelCount && (force || residentLevel != allocation.sampledLevel)) {
+        driver.setMinMaxLevels(allocation.handle,
+                residentLevel - allocation.baseLevel, levelCount - 1 - allocation.baseLevel);
+        allocation.sampledLevel = residentLevel;
+    }
+}
+
+void TextureStreamer::require(FTexture const& texture, float pixels) noexcept {
+    TextureResidency& residency = *texture.getResidency();
+    // the level with about as many texels as there are pixels on screen
+    const float size = float(std::max(texture.getWidth(), texture.getHeight()));
+    const float level = std::log2(size / std::max(pixels, 1.0f));
+    residency.requiredLevel = std::min(residency.requiredLevel, level);
+}
+
+bool TextureStreamer::update(DriverApi& driver) {
+    SYSTRACE_CALL();
+
+    constexpr float NOT_REQUIRED = std::numeric_limits<float>::infinity();
+    const uint32_t frame = ++mFrame;
+
+    // pick the finest level wanted by each texture, from the sizes reported by the views
+    std::vector<FTexture*> const& textures = mTextures;
+    std::vector<Target>& targets = mTargets;
+    targets.resize(textures.size());
+    for (size_t i = 0, c = textures.size(); i < c; i++) {
+        FTexture const* const texture = textures[i];
+        TextureResidency& residency = *texture->getResidency();
+
+        const bool visible = residency.requiredLevel != NOT_REQUIRED;
+        if (visible) {
+            residency.lastRequiredLevel = residency.requiredLevel;
+            residency.lastRequiredFrame = frame;
+            residency.requiredLevel = NOT_REQUIRED;
+        }
+        const float required = (frame - residency.lastRequiredFrame < IDLE_FRAMES) ?
+                residency.lastRequiredLevel : NOT_REQUIRED;
+
+        const uint8_t allocated = residency.pending.handle ?
+                residency.pending.baseLevel : residency.current.baseLevel;
+        uint8_t wanted = clampLevel(required, residency.tailLevel);
+        if (wanted > allocated) {
+            wanted = std::max(allocated, clampLevel(required - HYSTERESIS, residency.tailLevel));
+        }
+
+        targets[i] = {
+                .width = uint32_t(texture->getWidth()),
+                .height = uint32_t(texture->getHeight()),
+                .format = texture->getFormat(),
+                .levelCount = uint8_t(texture->getLevelCount()),
+                .tailLevel = residency.tailLevel,
+                .baseLevel = wanted,
+                .visible = visible
+        };
+    }
+
+    mResidentSize = fitToBudget(targets.data(), targets.size(), mBudget);
+
+    // reallocate the textures whose base level changed, and swap in the allocations ready
+    bool swapped = false;
+    mRequests.clear();
+    for (size_t i = 0, c = textures.size(); i < c; i++) {
+        FTexture* const texture = textures[i];
+        TextureResidency& residency = *texture->getResidency();
+        TextureResidency::Allocation& current = residency.current;
+        TextureResidency::Allocation& pending = residency.pending;
+        const uint8_t levelCount = uint8_t(texture->getLevelCount());
+        const uint8_t baseLevel = targets[i].baseLevel;
+
+        const uint8_t allocated = pending.handle ? pending.baseLevel : current.baseLevel;
+        if (baseLevel != allocated) {
+            if (pending.handle) {
+                // it was never sampled
+                driver.destroyTexture(pending.handle);
+                pending = {};
+            }
+            if (baseLevel != current.baseLevel) {
+                pending = allocate(driver, *texture, baseLevel);
+            }
+        }
+
+        if (pending.handle) {
+            const uint8_t pendingLevel = getResidentLevel(pending, levelCount);
+            if (pendingLevel <= std::max(getResidentLevel(current, levelCount), pending.baseLevel)) {
+                // the material instances using current are updated before the next draw
+                driver.destroyTexture(current.handle);
+                current = pending;
+                pending = {};
+                swapped = true;
+            }
+        }
+
+        setSampledLevels(driver, current, levelCount, false);
+
+        for (TextureResidency::Allocation* allocation : { &current, &pending }) {
+            if (allocation->handle && !allocation->requested) {
+                allocation->requested = true;
+                mRequests.push_back({ texture, allocation->baseLevel });
+            }
+        }
+    }
+
+    // The callbacks can upload the levels right away, so they're called once we're done with
+    // the residencies. The coarsest levels are requested first, they become visible first.
+    for (Request const& request : mRequests) {
+        TextureResidency const& residency = *request.texture->getResidency();
+        for (size_t level = request.texture->getLevelCount(); level-- > request.baseLevel;) {
+            residency.callback(request.texture, level, residency.user);
+        }
+    }
+
+    return swapped;
+}
+
+size_t TextureStreamer::fitToBudget(Target* targets, size_t count, size_t budget) noexcept {
+    auto getSize = [targets, count](uint8_t bias) {
+        size_t size = 0;
+        for (size_t i = 0; i < count; i++) {
+            Target const& t = targets[i];
+            const uint8_t baseLevel = std::min(uint8_t(t.baseLevel + bias), t.tailLevel);
+            size += getLevelsSize(t.width, t.height, t.format, baseLevel, t.levelCount);
+        }
+        return size;
+    };
+
+    size_t size = getSize(0);
+    if (size <= budget) {
+        return size;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!targets[i].visible) {
+            targets[i].baseLevel = targets[i].tailLevel;
+        }
+    }
+    size = getSize(0);
+    if (size <= budget) {
+        return size;
+    }
+
+    // find the smallest bias that fits, a bias past all the tails doesn't free anything
+    uint8_t maxBias = 0;
+    for (size_t i = 0; i < count; i++) {
+        maxBias = std::max(maxBias, uint8_t(targets[i].tailLevel - targets[i].baseLevel));
+    }
+    uint8_t bias = 0;
+    while (size > budget && bias < maxBias) {
+        size = getSize(++bias);
+    }
+    for (size_t i = 0; i < count; i++) {
+        Target& t = targets[i];
+        t.baseLevel = std::min(uint8_t(t.baseLevel + bias), t.tailLevel);
+    }
+    return size;
+}
+
+size_t TextureStreamer::getLevelsSize(uint32_t width, uint32_t height, TextureFormat format,
+        uint8_t baseLevel, uint8_t levelCount) noexcept {
+    const size_t blockWidth = getBlockWidth(format);
+    const size_t blockHeight = getBlockHeight(format);
+    const size_t formatSize = getFormatSize(format);
+    size_t size = 0;
+    for (uint8_t level = baseLevel; level < levelCount; level++) {
+        size_t w = FTexture::valueForLevel(level, width);
+        size_t h = FTexture::valueForLevel(level, height);
+        if (blockWidth && blockHeight) {
+            w = (w + blockWidth - 1) / blockWidth;
+            h = (h + blockHeight - 1) / blockHeight;
+        }
+        size += w * h * formatSize;
+    }
+    return size;
+}
+
+TextureResidency::Allocation TextureStreamer::allocate(DriverApi& driver,
+        FTexture const& texture, uint8_t baseLevel) {
+    TextureResidency::Allocation allocation;
+    allocation.baseLevel = baseLevel;
+    allocation.handle = driver.createTexture(texture.getTarget(),
+            uint8_t(texture.getLevelCount() - baseLevel), texture.getFormat(), 1,
+            uint32_t(texture.getWidth(baseLevel)), uint32_t(texture.getHeight(baseLevel)), 1,
+            texture.getUsage());
+    return allocation;
+}
+
+uint8_t TextureStreamer::getResidentLevel(TextureResidency::Allocation const& allocation,
+        uint8_t levelCount) noexcept {
+    uint8_t level = levelCount;
+    while (level > allocation.baseLevel && (allocation.uploaded & (1u << (level - 1u)))) {
+        level--;
+    }
+    return level;
+}
+
+} // namespace filament
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_TEXTURESTREAMER_H
+#define TNT_FILAMENT_TEXTURESTREAMER_H
+
+#include <filament/Texture.h>
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include "private/backend/DriverApiForward.h"
+
+#include <limits>
+#include <vector>
+
+#include <stdint.h>
+
+namespace filament {
+
+class FTexture;
+
+// Residency of the levels of a streamed texture (see Texture::Builder::streaming()).
+// The HwTexture of a streamed texture only stores the levels from its base level to the last
+// one, and the shaders only sample the levels uploaded so far.
+struct TextureResidency {
+    struct Allocation {
+        backend::Handle<backend::HwTexture> handle;
+        uint32_t uploaded = 0;          // bit N is set once level N is uploaded
+        uint8_t baseLevel = 0;          // level of the texture stored in the level 0 of handle
+        uint8_t sampledLevel = 0xFF;    // finest level sampled, as set with setMinMaxLevels()
+        bool requested = false;         // whether the levels were requested from the callback
+    };
+
+    Texture::StreamingCallback callback = nullptr;
+    void* user = nullptr;
+    Allocation current;                 // the allocation sampled by the shaders
+    Allocation pending;                 // replaces current once it's at least as detailed
+    uint8_t tailLevel = 0;              // the levels from this one are always resident
+    float requiredLevel = std::numeric_limits<float>::infinity();   // during this frame
+    float lastRequiredLevel = std::numeric_limits<float>::infinity();
+    uint32_t lastRequiredFrame = 0;
+    uint32_t index = 0;                 // in TextureStreamer::mTextures
+};
+
+// Decides which levels of the streamed textures are resident. The views report the finest level
+// each texture needs on screen, then update() picks the resident levels that fit in the budget
+// and requests the missing ones from the application.
+class TextureStreamer {
+public:
+    static constexpr size_t DEFAULT_BUDGET = 256u << 20u;
+
+    // the levels not larger than this are always resident
+    static constexpr uint32_t TAIL_SIZE = 128;
+
+    // number of frames a texture keeps its levels after it's last seen, unless we're over budget
+    static constexpr uint32_t IDLE_FRAMES = 30;
+
+    // a level is evicted only when the required level is past it by this fraction, so textures
+    // whose size on screen hovers around a power of two don't alternate between two allocations
+    static constexpr float HYSTERESIS = 0.25f;
+
+    explicit TextureStreamer(size_t budget = DEFAULT_BUDGET) noexcept;
+    ~TextureStreamer() noexcept;
+
+    TextureStreamer(TextureStreamer const& rhs) = delete;
+    TextureStreamer& operator=(TextureStreamer const& rhs) = delete;
+
+    bool empty() const noexcept { return mTextures.empty(); }
+
+    // Starts streaming a texture, only the levels of its tail are allocated at first.
+    TextureResidency* add(backend::DriverApi& driver, FTexture& texture,
+            Texture::StreamingCallback callback, void* user);
+
+    // Stops streaming a texture and destroys its allocations.
+    void remove(backend::DriverApi& driver, FTexture const& texture) noexcept;
+
+    // Uploads a whole level of a streamed texture in the allocation that needs it. Levels nobody
+    // needs anymore are dropped.
+    void upload(backend::DriverApi& driver, FTexture const& texture, size_t level,
+            Texture::PixelBufferDescriptor&& buffer) noexcept;
+
+    // Records that the texture covers about the given number of pixels on screen this frame.
+    void require(FTexture const& texture, float pixels) noexcept;
+
+    // Called once per frame: chooses the resident levels of all the streamed textures, swaps
+    // the allocations that are ready and requests the levels to stream in. Returns true if the
+    // HwTexture of some textures changed, in which case the material instances using them
+    // must be updated.
+    bool update(backend::DriverApi& driver);
+
+    // Bytes of the levels the textures keep resident, after update()
+    size_t getResidentSize() const noexcept { return mResidentSize; }
+
+    // What fitToBudget() needs to know about a texture
+    struct Target {
+        uint32_t width;
+        uint32_t height;
+        backend::TextureFormat format;
+        uint8_t levelCount;
+        uint8_t tailLevel;
+        uint8_t baseLevel;      // the finest level wanted, then the one that fits the budget
+        bool visible;           // whether the texture was seen during this frame
+    };
+
+    // Raises the base levels of the targets until they fit in the budget: first the textures
+    // not visible this frame fall back to their tail, then all the others lose the same number
+    // of levels. Returns the total size of the levels kept.
+    static size_t fitToBudget(Target* targets, size_t count, size_t budget) noexcept;
+
+    // Size in bytes of the levels from baseLevel to the last one
+    static size_t getLevelsSize(uint32_t width, uint32_t height, backend::TextureFormat format,
+            uint8_t baseLevel, uint8_t levelCount) noexcept;
+
+private:
+    TextureResidency::Allocation allocate(backend::DriverApi& driver,
+            FTexture const& texture, uint8_t baseLevel);
+
+    // finest level from which all the levels of an allocation are uploaded, levelCount if none
+    static uint8_t getResidentLevel(TextureResidency::Allocation const& allocation,
+            uint8_t levelCount) noexcept;
+
+    // restricts sampling to the levels of the allocation uploaded so far
+    static void setSampledLevels(backend::DriverApi& driver,
+            TextureResidency::Allocation& allocation, uint8_t levelCount, bool force) noexcept;
+
+    struct Request {
+        FTexture* texture;
+        uint8_t baseLevel;
+    };
+
+    std::vector<FTexture*> mTextures;
+    std::vector<Target> mTargets;
+    std::vector<Request> mRequests;
+    size_t mBudget;
+    size_t mResidentSize = 0;
+    uint32_t mFrame = 0;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_TEXTURESTREAMER_H
@@ -18,6 +18,7 @@
 #define TNT_FILAMENT_DRIVER_UNIFORMBUFFER_H
 
 #include <algorithm>
+#include <limits>
 
 #include "private/backend/DriverApi.h"
 
@@ -69,7 +70,9 @@ public:
     // invalidate a range of uniforms and return a pointer to it. offset and size given in bytes
     void* invalidateUniforms(size_t offset, size_t size) {
         assert(offset + size <= mSize);
-        mSomethingDirty = true;
+        // the modified ranges are coalesced into a single one
+        mDirtyBegin = std::min(mDirtyBegin, uint32_t(offset));
+        mDirtyEnd = std::max(mDirtyEnd, uint32_t(offset + size));
         return static_cast<char*>(mBuffer) + offset;
     }
 
@@ -84,10 +87,19 @@ public:
     size_t getSize() const noexcept { return mSize; }
 
     // return if any uniform has been changed
-    bool isDirty() const noexcept { return mSomethingDirty; }
+    bool isDirty() const noexcept { return mDirtyBegin < mDirtyEnd; }
+
+    // offset in bytes of the range of uniforms changed since the last clean()
+    size_t getDirtyOffset() const noexcept { return mDirtyBegin; }
+
+    // size in bytes of the range of uniforms changed since the last clean(), 0 if none
+    size_t getDirtySize() const noexcept { return isDirty() ? mDirtyEnd - mDirtyBegin : 0; }
 
     // mark the whole buffer as clean (no modified uniforms)
-    void clean() const noexcept { mSomethingDirty = false; }
+    void clean() const noexcept {
+        mDirtyBegin = std::numeric_limits<uint32_t>::max();
+        mDirtyEnd = 0;
+    }
 
     /*
      * -----------------------------------------------
@@ -196,7 +208,8 @@ private:
     char mStorage[96];
     void *mBuffer = nullptr;
     uint32_t mSize = 0;
-    mutable bool mSomethingDirty = false;
+    mutable uint32_t mDirtyBegin = std::numeric_limits<uint32_t>::max();
+    mutable uint32_t mDirtyEnd = 0;
 };
 
 // specialization for mat3f (which has a different alignment, see std140 layout rules)
@@ -36,6 +36,7 @@ struct VertexBuffer::BuilderDetails {
     AttributeBitset mDeclaredAttributes;
     uint32_t mVertexCount = 0;
     uint8_t mBufferCount = 0;
+    bool mStreaming = false;
 };
 
 using BuilderType = VertexBuffer;
@@ -107,6 +108,11 @@ VertexBuffer::Builder& VertexBuffer::Builder::normalized(VertexAttribute attribu
     return *this;
 }
 
+VertexBuffer::Builder& VertexBuffer::Builder::streaming(bool enabled) noexcept {
+    mImpl->mStreaming = enabled;
+    return *this;
+}
+
 VertexBuffer* VertexBuffer::Builder::build(Engine& engine) {
     if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mVertexCount > 0, "vertexCount cannot be 0")) {
         return nullptr;
@@ -140,22 +146,21 @@ VertexBuffer* VertexBuffer::Builder::build(Engine& engine) {
 // ------------------------------------------------------------------------------------------------
 
 FVertexBuffer::FVertexBuffer(FEngine& engine, const VertexBuffer::Builder& builder)
-        : mVertexCount(builder->mVertexCount), mBufferCount(builder->mBufferCount) {
-    std::copy(std::begin(builder->mAttributes), std::end(builder->mAttributes), mAttributes.begin());
-
+        : mVertexCount(builder->mVertexCount), mBufferCount(builder->mBufferCount),
+          mStreaming(builder->mStreaming) {
     mDeclaredAttributes = builder->mDeclaredAttributes;
     uint8_t attributeCount = (uint8_t) mDeclaredAttributes.count();
 
-    AttributeArray attributeArray;
+    AttributeArray& attributeArray = mAttributes;
 
-    static_assert(attributeArray.size() == MAX_VERTEX_ATTRIBUTE_COUNT,
+    static_assert(std::tuple_size<AttributeArray>::value == MAX_VERTEX_ATTRIBUTE_COUNT,
             "Attribute and Builder::Attribute arrays must match");
 
     static_assert(sizeof(Attribute) == sizeof(AttributeData),
             "Attribute and Builder::Attribute must match");
 
     auto const& declaredAttributes = mDeclaredAttributes;
-    auto const& attributes = mAttributes;
+    auto const& attributes = builder->mAttributes;
     #pragma nounroll
     for (size_t i = 0, n = attributeArray.size(); i < n; ++i) {
         if (declaredAttributes[i]) {
@@ -172,9 +177,10 @@ FVertexBuffer::FVertexBuffer(FEngine& engine, const VertexBuffer::Builder& build
     // NOTE: This flag needs to be set regardless of whether the attribute is actually declared.
     attributeArray[BONE_INDICES].flags |= Attribute::FLAG_INTEGER_TARGET;
 
-    FEngine::DriverApi& driver = engine.getDriverApi();
-    mHandle = driver.createVertexBuffer(
-            mBufferCount, attributeCount, mVertexCount, attributeArray, backend::BufferUsage::STATIC);
+    FEngine::ResourceCommands commands(engine);
+    FEngine::DriverApi& driver = commands.getDriverApi();
+    mHandle = driver.createVertexBuffer(mBufferCount, attributeCount, mVertexCount, attributeArray,
+            mStreaming ? backend::BufferUsage::STREAM : backend::BufferUsage::STATIC);
 }
 
 void FVertexBuffer::terminate(FEngine& engine) {
@@ -186,10 +192,26 @@ size_t FVertexBuffer::getVertexCount() const noexcept {
     return mVertexCount;
 }
 
+size_t FVertexBuffer::getMemorySize() const noexcept {
+    // the attributes of a buffer all have its stride
+    uint32_t strides[backend::MAX_VERTEX_ATTRIBUTE_COUNT] = {};
+    for (auto const& attribute : mAttributes) {
+        if (attribute.buffer < backend::MAX_VERTEX_ATTRIBUTE_COUNT) {
+            strides[attribute.buffer] = attribute.stride;
+        }
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < mBufferCount; i++) {
+        size += size_t(strides[i]) * mVertexCount;
+    }
+    return size;
+}
+
 void FVertexBuffer::setBufferAt(FEngine& engine, uint8_t bufferIndex,
         backend::BufferDescriptor&& buffer, uint32_t byteOffset) {
     if (bufferIndex < mBufferCount) {
-        engine.getDriverApi().updateVertexBuffer(mHandle,
+        FEngine::ResourceCommands commands(engine);
+        commands.getDriverApi().updateVertexBuffer(mHandle,
                 bufferIndex, std::move(buffer), byteOffset);
     } else {
         ASSERT_PRECONDITION_NON_FATAL(bufferIndex < mBufferCount,
@@ -197,6 +219,24 @@ void FVertexBuffer::setBufferAt(FEngine& engine, uint8_t bufferIndex,
     }
 }
 
+void* FVertexBuffer::mapBufferAt(FEngine& engine, uint8_t bufferIndex, uint32_t byteCount,
+        uint32_t byteOffset) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(bufferIndex < mBufferCount,
+            "bufferIndex must be < bufferCount")) {
+        return nullptr;
+    }
+    if (byteCount == 0) {
+        return nullptr;
+    }
+    // The update is queued now, but the backend only reads it once the commands are flushed,
+    // by which time the client has written it.
+    backend::BufferDescriptor buffer = engine.getStreamingBufferAllocator().allocate(byteCount);
+    void* const data = const_cast<void*>(buffer.buffer);
+    engine.getDriverApi().updateVertexBuffer(mHandle,
+            bufferIndex, std::move(buffer), byteOffset);
+    return data;
+}
+
 // ------------------------------------------------------------------------------------------------
 // Trampoline calling into private implementation
 // ------------------------------------------------------------------------------------------------
@@ -210,6 +250,11 @@ void VertexBuffer::setBufferAt(Engine& engine, uint8_t bufferIndex,
     upcast(this)->setBufferAt(upcast(engine), bufferIndex, std::move(buffer), byteOffset);
 }
 
+void* VertexBuffer::mapBufferAt(Engine& engine, uint8_t bufferIndex, uint32_t byteCount,
+        uint32_t byteOffset) {
+    return upcast(this)->mapBufferAt(upcast(engine), bufferIndex, byteCount, byteOffset);
+}
+
 void VertexBuffer::populateTangentQuaternions(const QuatTangentContext& ctx) {
     auto* quats = geometry::SurfaceOrientation::Builder()
         .vertexCount(ctx.quatCount)
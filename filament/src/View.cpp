@@ -23,10 +23,13 @@
 #include "details/DFG.h"
 #include "details/Froxelizer.h"
 #include "details/IndirectLight.h"
+#include "details/MaterialInstance.h"
 #include "details/Renderer.h"
+#include "details/RenderPrimitive.h"
 #include "details/RenderTarget.h"
 #include "details/Scene.h"
 #include "details/Skybox.h"
+#include "details/Texture.h"
 
 #include <filament/Exposure.h>
 #include <filament/TextureSampler.h>
@@ -41,6 +44,7 @@
 #include <math/scalar.h>
 #include <math/fast.h>
 
+#include <limits>
 #include <memory>
 #include <filament/View.h>
 
@@ -51,6 +55,9 @@ namespace filament {
 
 using namespace backend;
 
+// number of groups of Culler::MODULO lights culled by one job
+static constexpr size_t LIGHT_CULLING_GROUPS_PER_JOB = 16;
+
 FView::FView(FEngine& engine)
     : mFroxelizer(engine),
       mPerViewUb(PerViewUib::getUib().getSize()),
@@ -62,6 +69,8 @@ FView::FView(FEngine& engine)
     FDebugRegistry& debugRegistry = engine.getDebugRegistry();
     debugRegistry.registerProperty("d.view.camera_at_origin",
             &engine.debug.view.camera_at_origin);
+    debugRegistry.registerProperty("d.froxelizer.gpu_binning",
+            &engine.debug.froxelizer.gpu_binning);
 
     // set-up samplers
     mFroxelizer.getRecordBuffer().setSampler(PerViewSib::RECORDS, mPerViewSb);
@@ -99,6 +108,81 @@ void FView::terminate(FEngine& engine) {
     driver.destroyUniformBuffer(mRenderableUbh);
     drainFrameHistory(engine);
     mFroxelizer.terminate(driver);
+    mOcclusionCuller.terminate(engine);
+    mShadowMapManager.terminate(engine);
+
+    // the readbacks in flight call back into this view, let them complete
+    if (mPickingQueriesInFlight) {
+        engine.flushAndWait();
+    }
+    assert(!mPickingQueriesInFlight);
+    for (PickingQuery* query : mPickingQueries) {
+        delete query;
+    }
+    for (PickingQuery* query : mFreePickingQueries) {
+        delete query;
+    }
+    mPickingQueries.clear();
+    mFreePickingQueries.clear();
+}
+
+void FView::pick(uint32_t x, uint32_t y, View::PickingQueryResultCallback callback,
+        void* user) noexcept {
+    PickingQuery* query;
+    if (mFreePickingQueries.empty()) {
+        query = new PickingQuery;
+    } else {
+        query = mFreePickingQueries.back();
+        mFreePickingQueries.pop_back();
+    }
+    *query = { .view = this, .x = x, .y = y, .callback = callback, .user = user };
+    mPickingQueries.push_back(query);
+}
+
+std::vector<FView::PickingQuery*> FView::takePickingQueries() noexcept {
+    std::vector<PickingQuery*> queries;
+    std::swap(queries, mPickingQueries);
+    mPickingQueriesInFlight += queries.size();
+    return queries;
+}
+
+PixelBufferDescriptor FView::getPickingQueryBuffer(PickingQuery* query) noexcept {
+    // the callback is called on the engine thread once the texel has been read back
+    return PixelBufferDescriptor(query->texel, sizeof(query->texel),
+            PixelDataFormat::RGBA_INTEGER, PixelDataType::UINT,
+            [](void*, size_t, void* user) {
+                PickingQuery* const query = static_cast<PickingQuery*>(user);
+                FView* const view = query->view;
+
+                float depth;
+                static_assert(sizeof(depth) == sizeof(query->texel[1]), "");
+                memcpy(&depth, &query->texel[1], sizeof(depth));
+
+                View::PickingQueryResult result;
+                result.renderable = Entity::import(int32_t(query->texel[0]));
+                result.depth = depth;
+                result.fragCoords = { float(query->x), float(query->y), depth };
+                query->callback(result, query->user);
+
+                view->mPickingQueriesInFlight--;
+                view->mFreePickingQueries.push_back(query);
+            }, query);
+}
+
+void FView::setOcclusionCullingEnabled(bool enabled) noexcept {
+    mOcclusionCulling = enabled;
+    if (!enabled) {
+        mOcclusionCuller.reset();
+    }
+}
+
+void FView::setTemporalSortingEnabled(bool enabled) noexcept {
+    mTemporalSorting = enabled;
+    if (!enabled) {
+        for (RenderPass::CommandOrder& order : mCommandOrders) {
+            order.reset();
+        }
+    }
 }
 
 void FView::setViewport(filament::Viewport const& viewport) noexcept {
@@ -126,6 +210,8 @@ void FView::setDynamicResolutionOptions(DynamicResolutionOptions const& options)
         // clamp maxScale to 2x because we're doing bilinear filtering, so super-sampling
         // is not useful above that.
         dynamicResolution.maxScale = min(dynamicResolution.maxScale, float2(2.0f));
+
+        dynamicResolution.scaleStep = std::max(dynamicResolution.scaleStep, 0.0f);
     }
 }
 
@@ -136,6 +222,7 @@ void FView::setDynamicLightingOptions(float zLightNear, float zLightFar) noexcep
 float2 FView::updateScale(FrameInfo const& info) noexcept {
     DynamicResolutionOptions const& options = mDynamicResolution;
     if (options.enabled) {
+        const float2 previousScale = mScale;
         if (!UTILS_UNLIKELY(info.valid)) {
             mScale = 1.0f;
             return mScale;
@@ -170,9 +257,21 @@ float2 FView::updateScale(FrameInfo const& info) noexcept {
             mScale = std::sqrt(scale);
         }
 
-        // now tweak the scaling factor to get multiples of 8 (to help quad-shading)
-        // i.e. 8x8=64 fragments, to try to help with warp sizes.
-        mScale = (floor(mScale * float2{ w, h } / 8) * 8) / float2{ w, h };
+        if (options.scaleStep > 0.0f) {
+            // Snap each axis to a multiple of the step. The current step is kept until the
+            // scale needed is past it by three quarters of a step, so that the size of the
+            // buffers doesn't change back and forth.
+            const float step = options.scaleStep;
+            for (size_t i = 0; i < 2; i++) {
+                const float current = std::round(previousScale[i] / step);
+                const float wanted = mScale[i] / step;
+                mScale[i] = (std::abs(wanted - current) < 0.75f ? current : std::round(wanted)) * step;
+            }
+        } else {
+            // now tweak the scaling factor to get multiples of 8 (to help quad-shading)
+            // i.e. 8x8=64 fragments, to try to help with warp sizes.
+            mScale = (floor(mScale * float2{ w, h } / 8) * 8) / float2{ w, h };
+        }
 
         // always clamp to the min/max scale range
         mScale = clamp(mScale, options.minScale, options.maxScale);
@@ -232,23 +331,38 @@ void FView::prepareShadowing(FEngine& engine, backend::DriverApi& driver,
         mShadowMapManager.setShadowCascades(0, shadowOptions.shadowCascades);
     }
 
-    // Find all shadow-casting spot lights.
+    // Find all shadow-casting spot and point lights.
     size_t shadowCastingSpotCount = 0;
 
-    // We allow a max of CONFIG_MAX_SHADOW_CASTING_SPOTS spot light shadows. Any additional
-    // shadow-casting spot lights are ignored.
+    // We allow a max of CONFIG_MAX_SHADOW_CASTING_SPOTS spot and point light shadows, using at
+    // most CONFIG_MAX_SHADOW_MAPS_PUNCTUAL shadow maps. Any additional shadow-casting lights are
+    // ignored.
     for (size_t l = 1; l < lightData.size(); l++) {
         FLightManager::Instance light = lightData.elementAt<FScene::LIGHT_INSTANCE>(l);
 
         // Invisible lights get culled and should not count towards the spot limit.
         bool visible = lightData.elementAt<FScene::VISIBILITY>(l) != 0;
 
-        if (UTILS_LIKELY(!(light && lcm.isSpotLight(light) &&
+        if (UTILS_LIKELY(!(light && (lcm.isSpotLight(light) || lcm.isPointLight(light)) &&
                 lcm.isShadowCaster(light) && visible))) {
             continue;
         }
 
-        mShadowMapManager.addSpotShadowMap(l);
+        if (lcm.isPointLight(light)) {
+            // a point light needs a shadow map for each face of its cube
+            if (mShadowMapManager.getPunctualShadowMapCount() +
+                    ShadowMapManager::CUBE_FACE_COUNT >
+                    CONFIG_MAX_SHADOW_MAPS_PUNCTUAL) {
+                continue;
+            }
+            mShadowMapManager.addPointShadowMap(l);
+        } else {
+            if (mShadowMapManager.getPunctualShadowMapCount() ==
+                    CONFIG_MAX_SHADOW_MAPS_PUNCTUAL) {
+                continue;
+            }
+            mShadowMapManager.addSpotShadowMap(l);
+        }
 
         shadowCastingSpotCount++;
         if (shadowCastingSpotCount > CONFIG_MAX_SHADOW_CASTING_SPOTS - 1) {
@@ -349,14 +463,16 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     mHasDynamicLighting = scene->getLightData().size() > FScene::DIRECTIONAL_LIGHTS_COUNT;
     if (mHasDynamicLighting) {
         Froxelizer& froxelizer = mFroxelizer;
-        if (froxelizer.prepare(driver, arena, viewport, camera.projection, camera.zn, camera.zf)) {
+        froxelizer.setGpuBinningEnabled(engine.debug.froxelizer.gpu_binning);
+        if (froxelizer.prepare(driver, arena, viewport, camera.projection, camera.zn, camera.zf,
+                lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT)) {
             froxelizer.updateUniforms(u); // update our uniform buffer if needed
         }
     }
 }
 
 void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
-        filament::Viewport const& viewport, float4 const& userTime) noexcept {
+        filament::Viewport const& viewport, float4 const& userTime, uint32_t frameId) noexcept {
     JobSystem& js = engine.getJobSystem();
 
     /*
@@ -398,15 +514,21 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
     // is set
     mViewingCameraInfo = CameraInfo(*camera, worldOriginScene);
 
-    mCullingFrustum = FCamera::getFrustum(
-            mCullingCamera->getCullingProjectionMatrix(),
-            FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix()));
+    if (UTILS_UNLIKELY(mRightEyeCamera)) {
+        // both eyes share the world origin, so the shaders see the same world for both
+        mRightEyeCameraInfo = CameraInfo(*mRightEyeCamera, worldOriginScene);
+        mCullingFrustum = getStereoFrustum(*mCullingCamera, *mRightEyeCamera, worldOriginScene);
+    } else {
+        mCullingFrustum = FCamera::getFrustum(
+                mCullingCamera->getCullingProjectionMatrix(),
+                FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix()));
+    }
 
     /*
      * Gather all information needed to render this scene. Apply the world origin to all
      * objects in the scene.
      */
-    scene->prepare(worldOriginScene);
+    scene->prepare(worldOriginScene, frameId);
 
     /*
      * Light culling: runs in parallel with Renderable culling (below)
@@ -431,7 +553,28 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
          * (this will set the VISIBLE_RENDERABLE bit)
          */
 
-        prepareVisibleRenderables(js, mCullingFrustum, renderableData);
+        prepareVisibleRenderables(js, *scene, mCullingFrustum, renderableData);
+
+        /*
+         * Cell culling: reject the renderables of the cells the camera can't see through the
+         * scene's portals (this can clear the VISIBLE_RENDERABLE bit). With two eyes, the
+         * frustum isn't narrowed to the portals from the left eye only.
+         */
+
+        if (isFrustumCullingEnabled()) {
+            scene->cullCells(mCullingFrustum, worldOriginScene, mCullingCamera->getPosition(),
+                    !mRightEyeCamera, VISIBLE_RENDERABLE_BIT);
+        }
+
+        /*
+         * Occlusion culling: test the renderables still visible against the depth of a
+         * previous frame (this can clear the VISIBLE_RENDERABLE bit)
+         */
+
+        if (mOcclusionCulling && isFrustumCullingEnabled()) {
+            mOcclusionCuller.cull(renderableData, worldOriginScene,
+                    camera->getPosition(), VISIBLE_RENDERABLE_BIT);
+        }
 
 
         /*
@@ -497,11 +640,14 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
                 driver.destroyUniformBuffer(mRenderableUbh);
                 mRenderableUbh = driver.createUniformBuffer(mRenderableUBOSize,
                         backend::BufferUsage::STREAM);
+                mRenderableUboScene = nullptr;
             } else {
                 // TODO: should we shrink the underlying UBO at some point?
             }
             assert(mRenderableUbh);
-            scene->updateUBOs(merged, mRenderableUbh);
+            // the scene can skip the upload only if it's the one that wrote this UBO last
+            scene->updateUBOs(merged, mRenderableUbh, mRenderableUboScene != scene);
+            mRenderableUboScene = scene;
         }
     }
 
@@ -511,7 +657,9 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
      * Relies on FScene::prepare() and prepareVisibleLights()
      */
 
-    prepareLighting(engine, driver, arena, viewport);
+    // in stereo, the lights are froxelized for the left eye and its half of the viewport
+    prepareLighting(engine, driver, arena,
+            UTILS_UNLIKELY(mRightEyeCamera) ? getEyeViewport(viewport, 0) : viewport);
 
     /*
      * Update driver state
@@ -546,6 +694,11 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
     u.setUniform(offsetof(PerViewUib, fogInscatteringSize),  fogOptions.inScatteringSize);
     u.setUniform(offsetof(PerViewUib, fogColorFromIbl),      fogOptions.fogColorFromIbl ? 1.0f : 0.0f);
 
+    u.setUniform(offsetof(PerViewUib, orderIndependentTransparency),
+            uint32_t(hasOrderIndependentTransparency()));
+    u.setUniform(offsetof(PerViewUib, screenSpaceReflections),
+            uint32_t(hasScreenSpaceReflections()));
+
     // upload the renderables's dirty UBOs
     engine.getRenderableManager().prepare(driver,
             renderableData.data<FScene::RENDERABLE_INSTANCE>(), merged);
@@ -614,6 +767,37 @@ UTILS_NOINLINE
     });
 }
 
+Frustum FView::getStereoFrustum(FCamera const& left, FCamera const& right,
+        mat4f const& worldOrigin) noexcept {
+    // The frustum is built from the corners on the left side of the left eye's frustum and the
+    // ones on the right side of the right eye's, so it contains both as long as the right eye
+    // is (mostly) to the right of the left eye.
+    // The corners are in the order expected by Frustum, the odd ones are on the right side.
+    FCamera const* const eyes[2] = { &left, &right };
+    float3 corners[8];
+    for (size_t i = 0; i < 8; i++) {
+        FCamera const& eye = *eyes[i & 1u];
+        const mat4 clipFromWorld = eye.getCullingProjectionMatrix() *
+                mat4(FCamera::getViewMatrix(worldOrigin * eye.getModelMatrix()));
+        const double4 clip{
+                (i & 1u) ? 1.0 : -1.0,
+                (i & 2u) ? 1.0 : -1.0,
+                (i < 4u) ? 1.0 : -1.0,
+                1.0 };
+        const double4 p = inverse(clipFromWorld) * clip;
+        corners[i] = float3{ p.xyz / p.w };
+    }
+    return Frustum(corners);
+}
+
+filament::Viewport FView::getEyeViewport(filament::Viewport const& viewport, size_t eye) noexcept {
+    const uint32_t width = viewport.width / 2;
+    return eye == 0 ?
+            filament::Viewport{ viewport.left, viewport.bottom, width, viewport.height } :
+            filament::Viewport{ viewport.left + int32_t(width), viewport.bottom,
+                    viewport.width - width, viewport.height };
+}
+
 void FView::prepareCamera(const CameraInfo& camera) const noexcept {
     SYSTRACE_CALL();
 
@@ -679,6 +863,14 @@ void FView::prepareStructure(backend::Handle<backend::HwTexture> structure) cons
     mPerViewSb.setSampler(PerViewSib::STRUCTURE, structure, {});
 }
 
+void FView::prepareScreenSpaceReflections(
+        backend::Handle<backend::HwTexture> reflections) const noexcept {
+    // the reflections are at half resolution
+    mPerViewSb.setSampler(PerViewSib::SSR_REFLECTIONS, reflections, {
+            .filterMag = SamplerMagFilter::LINEAR
+    });
+}
+
 void FView::prepareShadow(backend::Handle<backend::HwTexture> texture) const noexcept {
     mShadowMapManager.prepareShadow(texture, *this);
 }
@@ -688,6 +880,7 @@ void FView::cleanupRenderPasses() const noexcept {
     samplerGroup.setSampler(PerViewSib::SSAO, {}, {});
     samplerGroup.setSampler(PerViewSib::SSR, {}, {});
     samplerGroup.setSampler(PerViewSib::STRUCTURE, {}, {});
+    samplerGroup.setSampler(PerViewSib::SSR_REFLECTIONS, {}, {});
 }
 
 void FView::froxelize(FEngine& engine) const noexcept {
@@ -720,20 +913,26 @@ void FView::commitFroxels(backend::DriverApi& driverApi) const noexcept {
 }
 
 UTILS_NOINLINE
-void FView::prepareVisibleRenderables(JobSystem& js,
+void FView::prepareVisibleRenderables(JobSystem& js, FScene const& scene,
         Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept {
     SYSTRACE_CALL();
     if (UTILS_LIKELY(isFrustumCullingEnabled())) {
-        FView::cullRenderables(js, renderableData, frustum, VISIBLE_RENDERABLE_BIT);
+        FView::cullRenderables(js, scene, renderableData, frustum, VISIBLE_RENDERABLE_BIT);
     } else {
         std::uninitialized_fill(renderableData.begin<FScene::VISIBLE_MASK>(),
                   renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
     }
 }
 
-void FView::cullRenderables(JobSystem& js,
+void FView::cullRenderables(JobSystem& js, FScene const& scene,
         FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
 
+    CullingHierarchy const* const hierarchy = scene.getCullingHierarchy();
+    if (hierarchy) {
+        hierarchy->cull(renderableData.data<FScene::VISIBLE_MASK>(), frustum, bit);
+        return;
+    }
+
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
     FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
@@ -754,7 +953,47 @@ void FView::cullRenderables(JobSystem& js,
     js.runAndWait(job);
 }
 
-void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
+void FView::cullRenderables(JobSystem& js, FScene const& scene,
+        FScene::RenderableSoa& renderableData, Frustum const* frusta, size_t const* bits,
+        size_t count) noexcept {
+    if (!count) {
+        return;
+    }
+
+    CullingHierarchy const* const hierarchy = scene.getCullingHierarchy();
+    if (hierarchy) {
+        // the hierarchical culling is not split across threads, and the frusta can't be culled
+        // concurrently either, as they write to the same visibility masks.
+        for (size_t i = 0; i < count; i++) {
+            hierarchy->cull(renderableData.data<FScene::VISIBLE_MASK>(), frusta[i], bits[i]);
+        }
+        return;
+    }
+
+    float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    FScene::VisibleMaskType* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
+
+    // culling job (this runs on multiple threads), each job culls its renderables against all
+    // frusta, which keeps the writes to the visibility masks disjoint between jobs.
+    auto functor = [frusta, bits, count, worldAABBCenter, worldAABBExtent, visibleArray]
+            (uint32_t index, uint32_t c) {
+        for (size_t i = 0; i < count; i++) {
+            Culler::intersects(
+                    visibleArray + index,
+                    frusta[i],
+                    worldAABBCenter + index,
+                    worldAABBExtent + index, c, bits[i]);
+        }
+    };
+
+    // launch the computation on multiple threads
+    auto *job = jobs::parallel_for(js, nullptr, 0, (uint32_t)renderableData.size(),
+            std::ref(functor), jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>());
+    js.runAndWait(job);
+}
+
+void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem& js,
         Frustum const& frustum, FScene::LightSoa& lightData) noexcept {
     SYSTRACE_CALL();
 
@@ -763,61 +1002,121 @@ void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
     auto const* UTILS_RESTRICT instanceArray   = lightData.data<FScene::LIGHT_INSTANCE>();
     auto      * UTILS_RESTRICT visibleArray    = lightData.data<FScene::VISIBILITY>();
 
-    Culler::intersects(visibleArray, frustum, sphereArray, lightData.size());
-
-    const float4* const UTILS_RESTRICT planes = frustum.getNormalizedPlanes();
-    // the directional light is considered visible
-    size_t visibleLightCount = FScene::DIRECTIONAL_LIGHTS_COUNT;
-    // skip directional light
-    for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT; i < lightData.size(); i++) {
-        FLightManager::Instance li = instanceArray[i];
-        if (visibleArray[i]) {
-            if (!lcm.isLightCaster(li)) {
-                visibleArray[i] = 0;
-                continue;
-            }
-            if (lcm.getIntensity(li) <= 0.0f) {
-                visibleArray[i] = 0;
-                continue;
-            }
-            // cull spotlights that cannot possibly intersect the view frustum
-            if (lcm.isSpotLight(li)) {
-                const float3 position = sphereArray[i].xyz;
-                const float3 axis = directions[i];
-                const float cosSqr = lcm.getCosOuterSquared(li);
-                bool invisible = false;
-                for (size_t j = 0; j < 6; ++j) {
-                    const float p = dot(position + planes[j].xyz * planes[j].w, planes[j].xyz);
-                    const float c = dot(planes[j].xyz, axis);
-                    invisible |= ((1.0f - c * c) < cosSqr && c > 0 && p > 0);
-                }
-                if (invisible) {
-                    visibleArray[i] = 0;
+    // The lights are culled in groups of Culler::MODULO, so that each job owns whole groups
+    // of results. The directional light goes through the tests too, but is always visible.
+    auto cull = [&lcm, &frustum, sphereArray, directions, instanceArray, visibleArray,
+            count = lightData.size()](uint32_t firstGroup, uint32_t groupCount) {
+        const size_t first = firstGroup * Culler::MODULO;
+        const size_t last = std::min(count, (firstGroup + groupCount) * Culler::MODULO);
+        Culler::intersects(visibleArray + first, frustum, sphereArray + first, last - first);
+
+        // cull spotlights that cannot possibly intersect the view frustum, the outer angles
+        // are gathered in blocks for the cone test
+        constexpr size_t BLOCK_SIZE = 64;
+        float cosSqr[BLOCK_SIZE];
+        for (size_t block = first; block < last; block += BLOCK_SIZE) {
+            const size_t c = std::min(BLOCK_SIZE, last - block);
+            for (size_t i = 0; i < c; i++) {
+                FLightManager::Instance li = instanceArray[block + i];
+                if (block + i < FScene::DIRECTIONAL_LIGHTS_COUNT) {
+                    cosSqr[i] = -std::numeric_limits<float>::infinity();
                     continue;
                 }
+                if (!lcm.isLightCaster(li) || lcm.getIntensity(li) <= 0.0f) {
+                    visibleArray[block + i] = 0;
+                }
+                cosSqr[i] = lcm.isSpotLight(li) ? lcm.getCosOuterSquared(li) :
+                        -std::numeric_limits<float>::infinity();
             }
-            visibleLightCount++;
+            Culler::intersectsCones(visibleArray + block, frustum,
+                    sphereArray + block, directions + block, cosSqr, c);
         }
-    }
+    };
 
-    // Partition array such that all visible lights appear first
-    UTILS_UNUSED_IN_RELEASE auto last =
+    const uint32_t groupCount = uint32_t(Culler::round(lightData.size()) / Culler::MODULO);
+    auto* job = jobs::parallel_for(js, nullptr, 0, groupCount, std::cref(cull),
+            jobs::CountSplitter<LIGHT_CULLING_GROUPS_PER_JOB>());
+    js.runAndWait(job);
+
+    // Partition array such that all visible lights appear first, the directional light is
+    // considered visible
+    auto last =
             std::partition(lightData.begin() + FScene::DIRECTIONAL_LIGHTS_COUNT, lightData.end(),
                     [](auto const& it) {
                         return it.template get<FScene::VISIBILITY>() != 0;
                     });
-    assert(visibleLightCount == size_t(last - lightData.begin()));
 
-    lightData.resize(visibleLightCount);
+    lightData.resize(size_t(last - lightData.begin()));
+}
+
+// Height on screen of the bounding sphere of a renderable, in the unit of the given scale. A sphere
+// of radius r at distance d covers 2.r.scale/d in height (2.r.scale with an orthographic
+// projection), where scale is half the viewport height times projection[1][1].
+static float getProjectedHeight(const CameraInfo& camera, bool perspective, float scale,
+        float3 const& center, float3 const& extent) noexcept {
+    const float radius = length(extent);
+    float height = 2.0f * radius * scale;
+    if (perspective) {
+        const float3 c = (camera.view * float4{ center, 1.0f }).xyz;
+        height /= std::max(length(c) - radius, camera.zn);
+    }
+    return height;
 }
 
-void FView::updatePrimitivesLod(FEngine& engine, const CameraInfo&,
+void FView::updatePrimitivesLod(FEngine& engine, const CameraInfo& camera,
         FScene::RenderableSoa& renderableData, Range visible) noexcept {
     FRenderableManager const& rcm = engine.getRenderableManager();
+
+    // screen sizes are fractions of the viewport height
+    const mat4f& projection = camera.projection;
+    const bool perspective = projection[2][3] != 0.0f;
+    const float scale = 0.5f * projection[1][1];
+
+    auto const* const instances = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    Slice<FRenderPrimitive>* const primitives = renderableData.data<FScene::PRIMITIVES>();
+    for (uint32_t index : visible) {
+        const auto ri = instances[index];
+        uint8_t level = 0;
+        if (UTILS_UNLIKELY(rcm.hasLevels(ri))) {
+            const float screenSize = getProjectedHeight(camera, perspective, scale,
+                    worldAABBCenter[index], worldAABBExtent[index]);
+            // past its screen size, an impostor replaces all the levels
+            if (auto const* impostor = rcm.getImpostor(ri, screenSize)) {
+                primitives[index] = *impostor;
+                continue;
+            }
+            level = rcm.getLevelOfDetail(ri, screenSize);
+        }
+        primitives[index] = rcm.getRenderPrimitives(ri, level);
+    }
+}
+
+void FView::updateTextureStreaming(FEngine& engine, const CameraInfo& camera,
+        FScene::RenderableSoa const& renderableData, Range visible) const noexcept {
+    TextureStreamer& streamer = engine.getTextureStreamer();
+    if (UTILS_LIKELY(streamer.empty())) {
+        return;
+    }
+
+    // sizes are in pixels
+    const mat4f& projection = camera.projection;
+    const bool perspective = projection[2][3] != 0.0f;
+    const float scale = 0.5f * float(mViewport.height) * projection[1][1];
+
+    float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    Slice<FRenderPrimitive> const* primitives = renderableData.data<FScene::PRIMITIVES>();
     for (uint32_t index : visible) {
-        uint8_t level = 0; // TODO: pick the proper level of detail
-        auto ri = renderableData.elementAt<FScene::RENDERABLE_INSTANCE>(index);
-        renderableData.elementAt<FScene::PRIMITIVES>(index) = rcm.getRenderPrimitives(ri, level);
+        const float pixels = getProjectedHeight(camera, perspective, scale,
+                worldAABBCenter[index], worldAABBExtent[index]);
+        for (FRenderPrimitive const& primitive : primitives[index]) {
+            FMaterialInstance const* const mi = primitive.getMaterialInstance();
+            for (auto const& entry : mi->getStreamedTextures()) {
+                streamer.require(*entry.texture, pixels);
+            }
+        }
     }
 }
 
@@ -831,6 +1130,8 @@ void FView::commitFrameHistory(FEngine& engine) noexcept {
     auto& frameHistory = mFrameHistory;
     FrameHistoryEntry& last = frameHistory.back();
     last.color.destroy(engine.getResourceAllocator());
+    last.ssr.destroy(engine.getResourceAllocator());
+    last.exposure.destroy(engine.getResourceAllocator());
 
     // and then push the new history entry to the history stack
     frameHistory.commit();
@@ -864,6 +1165,14 @@ Camera& View::getCamera() noexcept {
     return upcast(this)->getCameraUser();
 }
 
+void View::setRightEyeCamera(Camera* camera) noexcept {
+    upcast(this)->setRightEyeCamera(upcast(camera));
+}
+
+Camera const* View::getRightEyeCamera() const noexcept {
+    return upcast(this)->getRightEyeCamera();
+}
+
 void View::setViewport(filament::Viewport const& viewport) noexcept {
     upcast(this)->setViewport(viewport);
 }
@@ -880,6 +1189,35 @@ bool View::isFrustumCullingEnabled() const noexcept {
     return upcast(this)->isFrustumCullingEnabled();
 }
 
+void View::setOcclusionCullingEnabled(bool enabled) noexcept {
+    upcast(this)->setOcclusionCullingEnabled(enabled);
+}
+
+bool View::isOcclusionCullingEnabled() const noexcept {
+    return upcast(this)->isOcclusionCullingEnabled();
+}
+
+void View::setTemporalSortingEnabled(bool enabled) noexcept {
+    upcast(this)->setTemporalSortingEnabled(enabled);
+}
+
+bool View::isTemporalSortingEnabled() const noexcept {
+    return upcast(this)->isTemporalSortingEnabled();
+}
+
+void View::setOrderIndependentTransparencyEnabled(bool enabled) noexcept {
+    upcast(this)->setOrderIndependentTransparencyEnabled(enabled);
+}
+
+bool View::isOrderIndependentTransparencyEnabled() const noexcept {
+    return upcast(this)->isOrderIndependentTransparencyEnabled();
+}
+
+void View::pick(uint32_t x, uint32_t y, PickingQueryResultCallback callback,
+        void* user) noexcept {
+    upcast(this)->pick(x, y, callback, user);
+}
+
 void View::setDebugCamera(Camera* camera) noexcept {
     upcast(this)->setViewingCamera(upcast(camera));
 }
@@ -936,6 +1274,22 @@ const View::TemporalAntiAliasingOptions& View::getTemporalAntiAliasingOptions()
     return upcast(this)->getTemporalAntiAliasingOptions();
 }
 
+void View::setScreenSpaceReflectionsOptions(ScreenSpaceReflectionsOptions options) noexcept {
+    upcast(this)->setScreenSpaceReflectionsOptions(options);
+}
+
+const View::ScreenSpaceReflectionsOptions& View::getScreenSpaceReflectionsOptions() const noexcept {
+    return upcast(this)->getScreenSpaceReflectionsOptions();
+}
+
+void View::setAutoExposureOptions(AutoExposureOptions options) noexcept {
+    upcast(this)->setAutoExposureOptions(options);
+}
+
+const View::AutoExposureOptions& View::getAutoExposureOptions() const noexcept {
+    return upcast(this)->getAutoExposureOptions();
+}
+
 void View::setToneMapping(ToneMapping type) noexcept {
     upcast(this)->setToneMapping(type);
 }
@@ -1056,6 +1410,14 @@ View::VignetteOptions View::getVignetteOptions() const noexcept {
     return upcast(this)->getVignetteOptions();
 }
 
+void View::setFoveationOptions(View::FoveationOptions options) noexcept {
+    upcast(this)->setFoveationOptions(options);
+}
+
+View::FoveationOptions View::getFoveationOptions() const noexcept {
+    return upcast(this)->getFoveationOptions();
+}
+
 void View::setBlendMode(BlendMode blendMode) noexcept {
     upcast(this)->setBlendMode(blendMode);
 }
@@ -1080,4 +1442,12 @@ bool View::isScreenSpaceRefractionEnabled() const noexcept {
     return upcast(this)->isScreenSpaceRefractionEnabled();
 }
 
+void View::setDepthPrepassEnabled(bool enabled) noexcept {
+    upcast(this)->setDepthPrepassEnabled(enabled);
+}
+
+bool View::isDepthPrepassEnabled() const noexcept {
+    return upcast(this)->isDepthPrepassEnabled();
+}
+
 } // namespace filament
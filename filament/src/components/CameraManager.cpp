@@ -50,11 +50,11 @@ void FCameraManager::terminate() noexcept {
     }
 }
 
-void FCameraManager::gc(utils::EntityManager& em) noexcept {
+void FCameraManager::gc(utils::EntityManager& em, size_t maxCount) noexcept {
     auto& manager = mManager;
     manager.gc(em, 4, [this](Entity e) {
         destroy(e);
-    });
+    }, maxCount);
 }
 
 FCamera* FCameraManager::create(Entity entity) {
@@ -46,7 +46,7 @@ public:
     // free-up all resources
     void terminate() noexcept;
 
-    void gc(utils::EntityManager& em) noexcept;
+    void gc(utils::EntityManager& em, size_t maxCount) noexcept;
 
     /*
     * Component Manager APIs
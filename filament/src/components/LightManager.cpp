@@ -162,6 +162,7 @@ void FLightManager::create(const FLightManager::Builder& builder, utils::Entity
     }
     Instance i = manager.addComponent(entity);
     assert(i);
+    mVersion++;
 
     if (i) {
         // This needs to happen before we call the set() methods below
@@ -210,6 +211,7 @@ void FLightManager::destroy(utils::Entity e) noexcept {
     if (i) {
         auto& manager = mManager;
         manager.removeComponent(e);
+        mVersion++;
     }
 }
 
@@ -231,12 +233,14 @@ void FLightManager::setLocalPosition(Instance i, const float3& position) noexcep
     assert(i);
     auto& manager = mManager;
     manager[i].position = position;
+    mVersion++;
 }
 
 void FLightManager::setLocalDirection(Instance i, float3 direction) noexcept {
     assert(i);
     auto& manager = mManager;
     manager[i].direction = direction;
+    mVersion++;
 }
 
 void FLightManager::setColor(Instance i, const LinearColor& color) noexcept {
@@ -298,6 +302,7 @@ void FLightManager::setIntensity(Instance i, float intensity, IntensityUnit unit
                 break;
         }
         manager[i].intensity = luminousIntensity;
+        mVersion++;
     }
 }
 
@@ -308,6 +313,7 @@ void FLightManager::setFalloff(Instance i, float falloff) noexcept {
         SpotParams& spotParams = manager[i].spotParams;
         manager[i].squaredFallOffInv = sqFalloff > 0.0f ? (1 / sqFalloff) : 0;
         spotParams.radius = falloff;
+        mVersion++;
     }
 }
 
@@ -340,6 +346,7 @@ void FLightManager::setSpotLightCone(Instance i, float inner, float outer) noexc
             float luminousPower = spotParams.luminousPower;
             float luminousIntensity = luminousPower / (f::TAU * (1.0f - cosOuter));
             manager[i].intensity = luminousIntensity;
+            mVersion++;
         }
     }
 }
@@ -60,14 +60,19 @@ public:
         return mManager.getInstance(e);
     }
 
+    // Incremented each time the light data gathered by FScene::prepare() may have changed.
+    uint32_t getVersion() const noexcept { return mVersion; }
+
     void create(const FLightManager::Builder& builder, utils::Entity entity);
 
     void destroy(utils::Entity e) noexcept;
 
     void prepare(backend::DriverApi& driver) const noexcept;
 
-    void gc(utils::EntityManager& em) noexcept {
-        mManager.gc(em);
+    void gc(utils::EntityManager& em, size_t maxCount) noexcept {
+        mManager.gc(em, 4, [this](utils::Entity e) {
+            mManager.removeComponent(e);
+        }, maxCount);
     }
 
     struct LightType {
@@ -236,7 +241,7 @@ private:
         FALLOFF,
     };
 
-    using Base = utils::SingleInstanceComponentManager<  // 120 bytes
+    using Base = utils::SparseSingleInstanceComponentManager<  // 120 bytes
             LightType,      //  1
             math::float3,   // 12
             math::float3,   // 12
@@ -286,6 +291,7 @@ private:
 
     Sim mManager;
     FEngine& mEngine;
+    uint32_t mVersion = 0;
 };
 
 FILAMENT_UPCAST(LightManager)
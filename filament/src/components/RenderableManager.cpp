@@ -26,9 +26,14 @@
 
 #include <backend/DriverEnums.h>
 
+#include <math/simd.h>
+
+#include <utils/JobSystem.h>
 #include <utils/Log.h>
 #include <utils/Panic.h>
 
+#include <stdlib.h>
+
 using namespace filament::math;
 using namespace utils;
 
@@ -45,13 +50,25 @@ struct RenderableManager::BuilderDetails {
     bool mReceiveShadows : 1;
     bool mScreenSpaceContactShadows : 1;
     bool mMorphingEnabled : 1;
+    bool mComputeSkinning : 1;
+    bool mDynamicBounds : 1;
     size_t mSkinningBoneCount = 0;
+    size_t mMorphTargetCount = 0;
     Bone const* mUserBones = nullptr;
     mat4f const* mUserBoneMatrices = nullptr;
+    Box const* mBoneBoxes = nullptr;
+    size_t mInstanceCount = 1;
+    mat4f const* mUserInstanceTransforms = nullptr;
+    struct LevelOfDetail {
+        size_t primitiveCount;
+        float screenSize;
+    };
+    std::vector<LevelOfDetail> mLevels;
 
     explicit BuilderDetails(size_t count)
             : mEntries(count), mCulling(true), mCastShadows(false), mReceiveShadows(true),
-              mScreenSpaceContactShadows(false), mMorphingEnabled(false) {
+              mScreenSpaceContactShadows(false), mMorphingEnabled(false),
+              mComputeSkinning(false), mDynamicBounds(false) {
     }
     // this is only needed for the explicit instantiation below
     BuilderDetails() = default;
@@ -96,6 +113,14 @@ RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index,
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::depthGeometry(size_t index,
+        VertexBuffer* vertices) noexcept {
+    if (index < mImpl->mEntries.size()) {
+        mImpl->mEntries[index].depthVertices = vertices;
+    }
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::material(size_t index,
         MaterialInstance const* materialInstance) noexcept {
     if (index < mImpl->mEntries.size()) {
@@ -158,11 +183,42 @@ RenderableManager::Builder& RenderableManager::Builder::skinning(
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::computeSkinning(bool enable) noexcept {
+    mImpl->mComputeSkinning = enable;
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::dynamicBounds(bool enable,
+        Box const* boneBoxes) noexcept {
+    mImpl->mDynamicBounds = enable;
+    mImpl->mBoneBoxes = boneBoxes;
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::morphing(bool enable) noexcept {
     mImpl->mMorphingEnabled = enable;
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::computeMorphing(
+        size_t targetCount) noexcept {
+    mImpl->mMorphTargetCount = targetCount;
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::instances(size_t instanceCount) noexcept {
+    mImpl->mInstanceCount = instanceCount;
+    mImpl->mUserInstanceTransforms = nullptr;
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::instances(
+        size_t instanceCount, mat4f const* transforms) noexcept {
+    mImpl->mInstanceCount = instanceCount;
+    mImpl->mUserInstanceTransforms = transforms;
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index, uint16_t blendOrder) noexcept {
     if (index < mImpl->mEntries.size()) {
         mImpl->mEntries[index].blendOrder = blendOrder;
@@ -170,14 +226,106 @@ RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index,
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::levelOfDetail(uint8_t level,
+        size_t primitiveCount, float screenSize) noexcept {
+    auto& levels = mImpl->mLevels;
+    if (level < FRenderableManager::MAX_LEVEL_OF_DETAIL_COUNT) {
+        if (level >= levels.size()) {
+            levels.resize(level + 1, { 0, 0.0f });
+        }
+        levels[level] = { primitiveCount, screenSize };
+    }
+    return *this;
+}
+
 RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& engine, Entity entity) {
     bool isEmpty = true;
 
-    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mSkinningBoneCount <= CONFIG_MAX_BONE_COUNT,
-            "bone count > %u", CONFIG_MAX_BONE_COUNT)) {
+    const bool computeMorphing = mImpl->mMorphTargetCount > 0;
+    if (computeMorphing) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(!mImpl->mMorphingEnabled,
+                "computeMorphing() can't be combined with morphing()")) {
+            return Error;
+        }
+        // the morphed vertices are skinned in the same compute pass
+        mImpl->mComputeSkinning = true;
+    }
+
+    const bool skinning = mImpl->mSkinningBoneCount > 0;
+    if (mImpl->mComputeSkinning && (skinning || computeMorphing)) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(!mImpl->mMorphingEnabled,
+                "compute skinning can't be combined with morphing")) {
+            return Error;
+        }
+        // fall back to skinning in the vertex shader if any of the vertices can't be skinned in
+        // a compute pass
+        bool supported = upcast(engine).getComputeSkinning().isSupported();
+        for (auto const& entry : mImpl->mEntries) {
+            supported = supported && (!entry.vertices ||
+                    ComputeSkinning::isSupported(*upcast(entry.vertices), skinning));
+        }
+        // there is no fallback for the morph targets
+        if (!ASSERT_PRECONDITION_NON_FATAL(supported || !computeMorphing,
+                "computeMorphing() requires compute support and supported vertex formats")) {
+            return Error;
+        }
+        mImpl->mComputeSkinning = supported;
+    }
+
+    if (mImpl->mDynamicBounds) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(skinning || computeMorphing,
+                "dynamicBounds() requires skinning() or computeMorphing()")) {
+            return Error;
+        }
+        if (!ASSERT_PRECONDITION_NON_FATAL(!skinning || mImpl->mBoneBoxes,
+                "dynamicBounds() requires a box per bone when skinned")) {
+            return Error;
+        }
+    }
+
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mComputeSkinning ||
+            mImpl->mSkinningBoneCount <= CONFIG_MAX_BONE_COUNT,
+            "bone count > %u without compute skinning", CONFIG_MAX_BONE_COUNT)) {
         return Error;
     }
 
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mInstanceCount >= 1 &&
+            mImpl->mInstanceCount <= CONFIG_MAX_INSTANCE_COUNT,
+            "instance count must be between 1 and %u", CONFIG_MAX_INSTANCE_COUNT)) {
+        return Error;
+    }
+
+    if (mImpl->mUserInstanceTransforms) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mInstanceCount <= CONFIG_MAX_INSTANCES,
+                "instance count > %u with per-instance transforms", CONFIG_MAX_INSTANCES)) {
+            return Error;
+        }
+        if (!ASSERT_PRECONDITION_NON_FATAL(
+                !mImpl->mSkinningBoneCount && !mImpl->mMorphingEnabled,
+                "per-instance transforms can't be combined with skinning or morphing")) {
+            return Error;
+        }
+    }
+
+    if (!mImpl->mLevels.empty()) {
+        auto const& levels = mImpl->mLevels;
+        size_t primitiveCount = 0;
+        for (size_t i = 0, c = levels.size(); i < c; i++) {
+            primitiveCount += levels[i].primitiveCount;
+            if (!ASSERT_PRECONDITION_NON_FATAL(i == 0 ||
+                    levels[i].screenSize < levels[i - 1].screenSize,
+                    "[entity=%u] the screen size of level %u isn't smaller than the previous one",
+                    entity.getId(), i)) {
+                return Error;
+            }
+        }
+        if (!ASSERT_PRECONDITION_NON_FATAL(primitiveCount == mImpl->mEntries.size(),
+                "[entity=%u] the levels of detail have %u primitives, the renderable has %u",
+                entity.getId(), primitiveCount, mImpl->mEntries.size())) {
+            return Error;
+        }
+    }
+
     for (size_t i = 0, c = mImpl->mEntries.size(); i < c; i++) {
         auto& entry = mImpl->mEntries[i];
 
@@ -212,6 +360,22 @@ RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& eng
             return Error;
         }
 
+        if (entry.depthVertices) {
+            if (!ASSERT_PRECONDITION_NON_FATAL(
+                    entry.depthVertices->getVertexCount() == entry.vertices->getVertexCount(),
+                    "[entity=%u, primitive @ %u] the depth vertices have %u vertices, not %u",
+                    entity.getId(), i,
+                    entry.depthVertices->getVertexCount(), entry.vertices->getVertexCount())) {
+                return Error;
+            }
+            if (!ASSERT_PRECONDITION_NON_FATAL(
+                    upcast(entry.depthVertices)->getDeclaredAttributes()[VertexAttribute::POSITION],
+                    "[entity=%u, primitive @ %u] the depth vertices have no POSITION",
+                    entity.getId(), i)) {
+                return Error;
+            }
+        }
+
         // this can't be an error because (1) those values are not immutable, so the caller
         // could fix later, and (2) the material's shader will work (i.e. compile), and
         // use the default values for this attribute, which maybe be acceptable.
@@ -264,16 +428,39 @@ void FRenderableManager::create(
     }
     Instance ci = manager.addComponent(entity);
     assert(ci);
+    mVersion++;
 
     if (ci) {
         // create and initialize all needed RenderPrimitives
         using size_type = Slice<FRenderPrimitive>::size_type;
         Builder::Entry const * const entries = builder->mEntries.data();
-        FRenderPrimitive* rp = new FRenderPrimitive[builder->mEntries.size()];
-        for (size_t i = 0, c = builder->mEntries.size(); i < c; ++i) {
-            rp[i].init(driver, entries[i]);
+        const size_t primitiveCount = builder->mEntries.size();
+        FRenderPrimitive* rp = new FRenderPrimitive[primitiveCount];
+        if (primitiveCount) {
+            // allocate all the handles at once, and create them with a single command
+            auto* handles = driver.allocatePod<backend::RenderPrimitiveHandle>(primitiveCount);
+            driver.allocateRenderPrimitives(handles, uint32_t(primitiveCount));
+            driver.createRenderPrimitives(handles, uint32_t(primitiveCount));
+            for (size_t i = 0; i < primitiveCount; ++i) {
+                rp[i].init(driver, handles[i], entries[i]);
+            }
+        }
+        setPrimitives(ci, { rp, size_type(primitiveCount) });
+
+        // the levels of detail are consecutive ranges of the primitives
+        auto const& builderLevels = builder->mLevels;
+        if (UTILS_UNLIKELY(builderLevels.size() > 1)) {
+            std::unique_ptr<Levels>& levels = manager[ci].levels;
+            levels = std::unique_ptr<Levels>(new Levels{});
+            levels->count = builderLevels.size();
+            size_type first = 0;
+            for (size_t i = 0, c = builderLevels.size(); i < c; i++) {
+                const size_type count = size_type(builderLevels[i].primitiveCount);
+                levels->primitives[i] = { rp + first, count };
+                levels->screenSizes[i] = builderLevels[i].screenSize;
+                first += count;
+            }
         }
-        setPrimitives(ci, { rp, size_type(builder->mEntries.size()) });
 
         setAxisAlignedBoundingBox(ci, builder->mAABB);
         setLayerMask(ci, builder->mLayerMask);
@@ -287,7 +474,28 @@ void FRenderableManager::create(
         setMorphWeights(ci, {0, 0, 0, 0});
 
         const size_t count = builder->mSkinningBoneCount;
-        if (UTILS_UNLIKELY(count > 0 || builder->mMorphingEnabled)) {
+        const size_t targetCount = builder->mMorphTargetCount;
+        const bool computeSkinning = (count > 0 || targetCount > 0) && builder->mComputeSkinning;
+        if (UTILS_UNLIKELY(computeSkinning)) {
+            // The bones live in the engine's palette, and each primitive draws its own copy of
+            // the vertices, which gets skinned when the bones or the morph weights change.
+            std::unique_ptr<Bones>& bones = manager[ci].bones;
+            bones = std::unique_ptr<Bones>(new Bones{
+                    {},
+                    UniformBuffer{ count * sizeof(PerRenderableUibBone) },
+                    count,
+                    count ? engine.getComputeSkinning().allocateBones(driver, uint32_t(count)) :
+                            ComputeSkinning::Range{},
+                    0,
+                    std::unique_ptr<SkinnedVertices[]>(new SkinnedVertices[primitiveCount]),
+                    std::vector<float>(targetCount, 0.0f),
+                    true
+            });
+            for (size_t i = 0; i < primitiveCount; ++i) {
+                setSkinnedVertices(*bones, i, rp[i],
+                        upcast(entries[i].vertices), upcast(entries[i].indices));
+            }
+        } else if (UTILS_UNLIKELY(count > 0 || builder->mMorphingEnabled)) {
             std::unique_ptr<Bones>& bones = manager[ci].bones;
             // Note that we are sizing the bones UBO according to CONFIG_MAX_BONE_COUNT rather than
             // mSkinningBoneCount. According to the OpenGL ES 3.2 specification in 7.6.3 Uniform
@@ -307,18 +515,51 @@ void FRenderableManager::create(
                     UniformBuffer{ count * sizeof(PerRenderableUibBone) },
                     count
             });
-            assert(bones);
-            if (bones) {
-                setSkinning(ci, count > 0);
-                if (builder->mUserBones) {
-                    setBones(ci, builder->mUserBones, count);
-                } else if (builder->mUserBoneMatrices) {
-                    setBones(ci, builder->mUserBoneMatrices, count);
-                } else {
-                    // initialize the bones to identity
-                    PerRenderableUibBone* out = (PerRenderableUibBone*)bones->bones.invalidate();
-                    std::uninitialized_fill_n(out, count, PerRenderableUibBone{});
-                }
+        }
+        std::unique_ptr<Bones> const& bones = manager[ci].bones;
+        if (bones) {
+            if (builder->mDynamicBounds) {
+                Box const* const boneBoxes = builder->mBoneBoxes;
+                bones->bounds = std::unique_ptr<DynamicBounds>(new DynamicBounds{
+                        builder->mAABB,
+                        boneBoxes ? std::vector<Box>(boneBoxes, boneBoxes + count) :
+                                std::vector<Box>{},
+                        std::vector<mat4f>(boneBoxes ? count : 0),
+                        std::vector<float3>(targetCount)
+                });
+                invalidateDynamicBounds(ci, *bones->bounds);
+            }
+            // the vertices skinned in a compute pass are drawn without skinning
+            setSkinning(ci, count > 0 && !computeSkinning);
+            if (builder->mUserBones) {
+                setBones(ci, builder->mUserBones, count);
+            } else if (builder->mUserBoneMatrices) {
+                setBones(ci, builder->mUserBoneMatrices, count);
+            } else {
+                // initialize the bones to identity
+                PerRenderableUibBone* out = (PerRenderableUibBone*)bones->bones.invalidate();
+                std::uninitialized_fill_n(out, count, PerRenderableUibBone{});
+            }
+        }
+
+        const size_t instanceCount = builder->mInstanceCount;
+        if (UTILS_UNLIKELY(instanceCount > 1 || builder->mUserInstanceTransforms)) {
+            std::unique_ptr<Instances>& instances = manager[ci].instances;
+            // The per-instance transforms UBO is sized according to CONFIG_MAX_INSTANCES for
+            // the same reasons as the bones UBO above.
+            const bool hasTransforms = builder->mUserInstanceTransforms != nullptr;
+            instances = std::unique_ptr<Instances>(new Instances{
+                    hasTransforms ?
+                        driver.createUniformBuffer(CONFIG_MAX_INSTANCES * sizeof(mat4f),
+                                backend::BufferUsage::DYNAMIC) :
+                        backend::Handle<backend::HwUniformBuffer>{},
+                    hasTransforms ?
+                        UniformBuffer{ instanceCount * sizeof(mat4f) } : UniformBuffer{},
+                    instanceCount,
+                    builder->mAABB
+            });
+            if (hasTransforms) {
+                setInstanceTransforms(ci, builder->mUserInstanceTransforms, instanceCount);
             }
         }
     }
@@ -328,6 +569,7 @@ void FRenderableManager::create(
 void FRenderableManager::destroy(utils::Entity e) noexcept {
     Instance ci = getInstance(e);
     if (ci) {
+        mVersion++;
         destroyComponent(ci);
         mManager.removeComponent(e);
     }
@@ -361,15 +603,43 @@ void FRenderableManager::destroyComponent(Instance ci) noexcept {
 
     // destroy the bones structures if any
     std::unique_ptr<Bones> const& bones = manager[ci].bones;
-    if (bones) {
+    if (bones && bones->handle) {
         driver.destroyUniformBuffer(bones->handle);
     }
+    if (bones && bones->skinnedVertices) {
+        Slice<FRenderPrimitive> const& primitives = manager[ci].primitives;
+        for (size_t i = 0, c = primitives.size(); i < c; i++) {
+            SkinnedVertices const& skinned = bones->skinnedVertices[i];
+            if (skinned.handle) {
+                driver.destroyVertexBuffer(skinned.handle);
+            }
+            if (skinned.deltas) {
+                driver.destroyBufferObject(skinned.deltas);
+            }
+        }
+        if (bones->palette.count) {
+            engine.getComputeSkinning().freeBones(bones->palette);
+        }
+    }
+
+    // destroy the per-instance transforms if any
+    std::unique_ptr<Instances> const& instances = manager[ci].instances;
+    if (instances && instances->handle) {
+        driver.destroyUniformBuffer(instances->handle);
+    }
 }
 
 void FRenderableManager::destroyComponentPrimitives(
         FEngine& engine, Slice<FRenderPrimitive>& primitives) noexcept {
-    for (auto& primitive : primitives) {
-        primitive.terminate(engine);
+    const size_t count = primitives.size();
+    if (count) {
+        FEngine::DriverApi& driver = engine.getDriverApi();
+        auto* handles = driver.allocatePod<backend::RenderPrimitiveHandle>(count);
+        for (size_t i = 0; i < count; ++i) {
+            handles[i] = primitives[i].getHwHandle();
+            primitives[i].terminate(driver);
+        }
+        driver.destroyRenderPrimitives(handles, uint32_t(count));
     }
     delete[] primitives.data();
 }
@@ -382,17 +652,70 @@ void FRenderableManager::prepare(
     const auto& manager = mManager;
 
     std::unique_ptr<Bones>  const * const UTILS_RESTRICT bones = manager.raw_array<BONES>();
+    Slice<FRenderPrimitive> const* const UTILS_RESTRICT primitives =
+            manager.raw_array<PRIMITIVES>();
+    std::unique_ptr<Instances> const* const UTILS_RESTRICT transforms =
+            manager.raw_array<INSTANCES>();
     for (uint32_t index : list) {
         size_t i = instances[index].asValue();
         assert(i);  // we should never get the null instance here
         if (UTILS_UNLIKELY(bones[i])) {
-            if (bones[i]->bones.isDirty()) {
-                driver.loadUniformBuffer(bones[i]->handle, bones[i]->bones.toBufferDescriptor(driver));
+            Bones& b = *bones[i];
+            if (UTILS_UNLIKELY(b.skinnedVertices)) {
+                // skin the vertices once for all the passes, only when the bones or the morph
+                // weights have changed
+                ComputeSkinning& skinning = mEngine.getComputeSkinning();
+                if (b.dirty || b.bones.isDirty() ||
+                        (b.palette.count &&
+                                b.paletteGeneration != skinning.getPaletteGeneration())) {
+                    if (b.palette.count) {
+                        skinning.updateBones(driver, b.palette,
+                                b.bones.toBufferDescriptor(driver));
+                        b.paletteGeneration = skinning.getPaletteGeneration();
+                    }
+                    b.dirty = false;
+                    for (size_t j = 0, c = primitives[i].size(); j < c; j++) {
+                        deform(driver, b, b.skinnedVertices[j]);
+                    }
+                }
+            } else if (b.bones.isDirty()) {
+                driver.loadUniformBuffer(b.handle, b.bones.toBufferDescriptor(driver));
+            }
+        }
+        if (UTILS_UNLIKELY(transforms[i] && transforms[i]->handle)) {
+            if (transforms[i]->transforms.isDirty()) {
+                driver.loadUniformBuffer(transforms[i]->handle,
+                        transforms[i]->transforms.toBufferDescriptor(driver));
             }
         }
     }
 }
 
+void FRenderableManager::setImpostor(Instance instance, Slice<FRenderPrimitive> primitives,
+        float screenSize) noexcept {
+    if (instance) {
+        std::unique_ptr<Levels>& levels = mManager[instance].levels;
+        if (primitives.empty()) {
+            if (levels) {
+                levels->impostor = {};
+                // the levels were only allocated for the impostor
+                if (levels->count == 1) {
+                    levels.reset();
+                }
+            }
+            return;
+        }
+        if (!levels) {
+            // a single level with all the primitives
+            levels = std::unique_ptr<Levels>(new Levels{});
+            levels->count = 1;
+            levels->primitives[0] = mManager[instance].primitives;
+        }
+        levels->impostor = primitives;
+        levels->impostorScreenSize = screenSize;
+    }
+}
+
 void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
         size_t primitiveIndex, FMaterialInstance const* mi) noexcept {
     if (instance) {
@@ -450,8 +773,23 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
     if (instance) {
         Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
-            primitives[primitiveIndex].set(mEngine, type, vertices, indices, offset,
+            std::unique_ptr<Bones> const& bones = mManager[instance].bones;
+            const bool computeSkinning = bones && bones->skinnedVertices;
+            if (UTILS_UNLIKELY(computeSkinning)) {
+                if (!ASSERT_PRECONDITION_NON_FATAL(
+                        ComputeSkinning::isSupported(*vertices, bones->palette.count > 0),
+                        "these vertices can't be skinned in a compute pass")) {
+                    return;
+                }
+            }
+            FRenderPrimitive& primitive = primitives[primitiveIndex];
+            primitive.set(mEngine, type, vertices, indices, offset,
                     0, vertices->getVertexCount() - 1, count);
+            if (UTILS_UNLIKELY(computeSkinning)) {
+                Slice<FRenderPrimitive> const& all = mManager[instance].primitives;
+                const size_t index = &primitive - all.data();
+                setSkinnedVertices(*bones, index, primitive, vertices, indices);
+            }
         }
     }
 }
@@ -481,6 +819,14 @@ void FRenderableManager::setBones(Instance ci,
                 out[i].t.xyz = transforms[i].translation;
                 out[i].s = out[i].ns = { 1, 1, 1, 0 };
             }
+            if (UTILS_UNLIKELY(bones->bounds)) {
+                mat4f* const boneTransforms = bones->bounds->boneTransforms.data() + offset;
+                for (size_t i = 0, c = boneCount; i < c; ++i) {
+                    boneTransforms[i] = mat4f(transforms[i].unitQuaternion);
+                    boneTransforms[i][3].xyz = transforms[i].translation;
+                }
+                invalidateDynamicBounds(ci, *bones->bounds);
+            }
         }
     }
 }
@@ -498,16 +844,238 @@ void FRenderableManager::setBones(Instance ci,
             for (size_t i = 0, c = boneCount; i < c; ++i) {
                 makeBone(&out[i], transforms[i]);
             }
+            if (UTILS_UNLIKELY(bones->bounds)) {
+                std::copy_n(transforms, boneCount,
+                        bones->bounds->boneTransforms.data() + offset);
+                invalidateDynamicBounds(ci, *bones->bounds);
+            }
         }
     }
 }
 
 void FRenderableManager::setMorphWeights(Instance ci, const float4& weights) noexcept {
     if (ci) {
+        mVersion++;
         mManager[ci].morphWeights = weights;
     }
 }
 
+void FRenderableManager::setMorphWeights(Instance ci, float const* weights, size_t count,
+        size_t offset) noexcept {
+    if (ci) {
+        std::unique_ptr<Bones> const& bones = mManager[ci].bones;
+        const bool computeMorphing = bones && !bones->morphWeights.empty();
+        assert(computeMorphing && offset + count <= bones->morphWeights.size());
+        if (computeMorphing && offset < bones->morphWeights.size()) {
+            count = std::min(count, bones->morphWeights.size() - offset);
+            std::copy_n(weights, count, bones->morphWeights.data() + offset);
+            bones->dirty = true;
+            if (UTILS_UNLIKELY(bones->bounds)) {
+                invalidateDynamicBounds(ci, *bones->bounds);
+            }
+        }
+    }
+}
+
+void FRenderableManager::setMorphTargetAt(Instance ci, size_t primitiveIndex, size_t targetIndex,
+        uint32_t const* vertices, float3 const* positions, float3 const* normals,
+        size_t count) noexcept {
+    if (ci) {
+        std::unique_ptr<Bones> const& bones = mManager[ci].bones;
+        const bool computeMorphing = bones && !bones->morphWeights.empty();
+        if (!ASSERT_PRECONDITION_NON_FATAL(computeMorphing &&
+                primitiveIndex < getPrimitiveCount(ci) &&
+                targetIndex < bones->morphWeights.size(),
+                "the renderable has no morph target %u at primitive %u (see computeMorphing())",
+                unsigned(targetIndex), unsigned(primitiveIndex))) {
+            return;
+        }
+        SkinnedVertices& skinned = bones->skinnedVertices[primitiveIndex];
+        std::vector<ComputeSkinning::MorphDelta>& deltas = skinned.targets[targetIndex];
+        deltas.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            deltas[i] = { positions[i], vertices[i], normals ? normals[i] : float3{}, 0 };
+        }
+        skinned.deltasDirty = true;
+        bones->dirty = true;
+        if (UTILS_UNLIKELY(bones->bounds)) {
+            // the extent is shared by the primitives, and never shrinks when a target is set again
+            float3& extent = bones->bounds->morphExtents[targetIndex];
+            for (size_t i = 0; i < count; i++) {
+                extent = max(extent, abs(positions[i]));
+            }
+            invalidateDynamicBounds(ci, *bones->bounds);
+        }
+    }
+}
+
+void FRenderableManager::setInstanceTransforms(Instance ci,
+        mat4f const* UTILS_RESTRICT transforms, size_t count, size_t offset) noexcept {
+    if (ci) {
+        std::unique_ptr<Instances> const& instances = mManager[ci].instances;
+        assert(instances && instances->handle && offset + count <= instances->count);
+        if (instances && instances->handle && offset < instances->count) {
+            count = std::min(count, instances->count - offset);
+            mat4f* UTILS_RESTRICT out = (mat4f*)instances->transforms.invalidateUniforms(
+                    offset * sizeof(mat4f), count * sizeof(mat4f));
+            std::copy_n(transforms, count, out);
+            updateInstancesAABB(ci);
+        }
+    }
+}
+
+void FRenderableManager::updateInstancesAABB(Instance ci) noexcept {
+    std::unique_ptr<Instances> const& instances = mManager[ci].instances;
+    mat4f const* const UTILS_RESTRICT transforms =
+            static_cast<mat4f const*>(instances->transforms.getBuffer());
+    Box aabb = rigidTransform(instances->aabb, transforms[0]);
+    for (size_t i = 1, c = instances->count; i < c; i++) {
+        aabb.unionSelf(rigidTransform(instances->aabb, transforms[i]));
+    }
+    mManager[ci].aabb = aabb;
+    mVersion++;
+}
+
+void FRenderableManager::invalidateDynamicBounds(Instance ci, DynamicBounds& bounds) noexcept {
+    if (!bounds.dirty) {
+        bounds.dirty = true;
+        mDirtyBounds.push_back(mManager.getEntity(ci));
+    }
+}
+
+Box FRenderableManager::computeDynamicBounds(Bones const& bones) noexcept {
+    DynamicBounds const& bounds = *bones.bounds;
+
+    // a vertex moves by at most the sum of its weighted deltas, before it's skinned
+    float3 growth{};
+    for (size_t i = 0, c = bounds.morphExtents.size(); i < c; i++) {
+        growth += std::abs(bones.morphWeights[i]) * bounds.morphExtents[i];
+    }
+
+    const size_t boneCount = bounds.boneBoxes.size();
+    if (!boneCount) {
+        return { bounds.rest.center, bounds.rest.halfExtent + growth };
+    }
+
+    // A skinned vertex is a weighted average of its positions transformed by each of its bones,
+    // so it stays in the union of the boxes of these bones, once transformed.
+    constexpr size_t BATCH_SIZE = 64;
+    float3 centers[BATCH_SIZE];
+    float3 halfExtents[BATCH_SIZE];
+    float3 outCenters[BATCH_SIZE];
+    float3 outHalfExtents[BATCH_SIZE];
+    float3 aabbMin{ std::numeric_limits<float>::max() };
+    float3 aabbMax{ std::numeric_limits<float>::lowest() };
+    for (size_t first = 0; first < boneCount; first += BATCH_SIZE) {
+        const size_t count = std::min(BATCH_SIZE, boneCount - first);
+        for (size_t i = 0; i < count; i++) {
+            centers[i] = bounds.boneBoxes[first + i].center;
+            halfExtents[i] = bounds.boneBoxes[first + i].halfExtent + growth;
+        }
+        simd::rigidTransform(outCenters, outHalfExtents,
+                bounds.boneTransforms.data() + first, centers, halfExtents, count);
+        for (size_t i = 0; i < count; i++) {
+            aabbMin = min(aabbMin, outCenters[i] - outHalfExtents[i]);
+            aabbMax = max(aabbMax, outCenters[i] + outHalfExtents[i]);
+        }
+    }
+    return Box().set(aabbMin, aabbMax);
+}
+
+void FRenderableManager::updateDynamicBounds(JobSystem& js) noexcept {
+    if (mDirtyBounds.empty()) {
+        return;
+    }
+
+    auto& manager = mManager;
+    Entity const* const entities = mDirtyBounds.data();
+    auto work = [&manager, entities](uint32_t first, uint32_t count) {
+        for (uint32_t i = first, last = first + count; i < last; i++) {
+            // the renderable may have been destroyed since
+            Instance const ci = manager.getInstance(entities[i]);
+            if (ci) {
+                std::unique_ptr<Bones> const& bones = manager[ci].bones;
+                manager[ci].aabb = computeDynamicBounds(*bones);
+                bones->bounds->dirty = false;
+            }
+        }
+    };
+
+    auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(mDirtyBounds.size()),
+            std::cref(work), jobs::CountSplitter<16, 8>());
+    js.runAndWait(job);
+
+    mDirtyBounds.clear();
+    mVersion++;
+}
+
+void FRenderableManager::setSkinnedVertices(Bones& bones, size_t index,
+        FRenderPrimitive& primitive, FVertexBuffer* vertices, FIndexBuffer* indices) noexcept {
+    FEngine::DriverApi& driver = mEngine.getDriverApi();
+    SkinnedVertices& skinned = bones.skinnedVertices[index];
+    if (skinned.handle) {
+        driver.destroyVertexBuffer(skinned.handle);
+    }
+    skinned = {};
+    // the depth vertices wouldn't be skinned
+    primitive.terminate(driver);
+    if (vertices && indices) {
+        skinned.vertices = vertices;
+        skinned.handle = mEngine.getComputeSkinning().createSkinnedVertexBuffer(driver, *vertices);
+        driver.setRenderPrimitiveBuffer(primitive.getHwHandle(), skinned.handle,
+                indices->getHwHandle(), (uint32_t)primitive.getEnabledAttributes().getValue());
+    }
+    // the new vertices need skinning, the morph targets are kept and must match them
+    skinned.targets.resize(bones.morphWeights.size());
+    skinned.deltasDirty = true;
+    bones.dirty = true;
+}
+
+void FRenderableManager::deform(backend::DriverApi& driver, Bones const& bones,
+        SkinnedVertices& skinned) const noexcept {
+    if (!skinned.handle) {
+        return;
+    }
+
+    ComputeSkinning& skinning = mEngine.getComputeSkinning();
+    const size_t targetCount = skinned.targets.size();
+    if (skinned.deltasDirty) {
+        // all the targets are packed in a single buffer, which is only rebuilt when they change
+        skinned.deltasDirty = false;
+        if (skinned.deltas) {
+            driver.destroyBufferObject(skinned.deltas);
+            skinned.deltas = {};
+        }
+        size_t deltaCount = 0;
+        for (auto const& target : skinned.targets) {
+            deltaCount += target.size();
+        }
+        if (deltaCount) {
+            const size_t size = deltaCount * sizeof(ComputeSkinning::MorphDelta);
+            auto* const data = (ComputeSkinning::MorphDelta*)malloc(size);
+            auto* out = data;
+            for (auto const& target : skinned.targets) {
+                out = std::copy(target.begin(), target.end(), out);
+            }
+            skinned.deltas = driver.createBufferObject(uint32_t(size),
+                    backend::BufferObjectBinding::SHADER_STORAGE, backend::BufferUsage::STATIC);
+            driver.updateBufferObject(skinned.deltas, { data, size,
+                    [](void* buffer, size_t, void*) { free(buffer); }}, 0);
+        }
+    }
+
+    ComputeSkinning::MorphTarget* const targets = targetCount ?
+            driver.allocatePod<ComputeSkinning::MorphTarget>(targetCount) : nullptr;
+    uint32_t offset = 0;
+    for (size_t i = 0; i < targetCount; i++) {
+        const uint32_t count = uint32_t(skinned.targets[i].size());
+        targets[i] = { offset, count, bones.morphWeights[i] };
+        offset += count;
+    }
+    skinning.deform(driver, *skinned.vertices, skinned.handle, bones.palette,
+            skinned.deltas, targets, targetCount);
+}
+
 void FRenderableManager::makeBone(PerRenderableUibBone* UTILS_RESTRICT out, mat4f const& t) noexcept {
     mat4f m(t);
 
@@ -593,37 +1161,49 @@ uint8_t RenderableManager::getLayerMask(Instance instance) const noexcept {
 }
 
 size_t RenderableManager::getPrimitiveCount(Instance instance) const noexcept {
-    return upcast(this)->getPrimitiveCount(instance, 0);
+    return upcast(this)->getPrimitiveCount(instance);
 }
 
+size_t RenderableManager::getLevelOfDetailCount(Instance instance) const noexcept {
+    return upcast(this)->getLevelCount(instance);
+}
+
+// the public API indexes the primitives of all the levels of detail, as the Builder does
+
 void RenderableManager::setMaterialInstanceAt(Instance instance,
         size_t primitiveIndex, MaterialInstance const* materialInstance) noexcept {
-    upcast(this)->setMaterialInstanceAt(instance, 0, primitiveIndex, upcast(materialInstance));
+    const uint8_t level = upcast(this)->getPrimitiveLevel(instance, primitiveIndex);
+    upcast(this)->setMaterialInstanceAt(instance, level, primitiveIndex, upcast(materialInstance));
 }
 
 MaterialInstance* RenderableManager::getMaterialInstanceAt(
         Instance instance, size_t primitiveIndex) const noexcept {
-    return upcast(this)->getMaterialInstanceAt(instance, 0, primitiveIndex);
+    const uint8_t level = upcast(this)->getPrimitiveLevel(instance, primitiveIndex);
+    return upcast(this)->getMaterialInstanceAt(instance, level, primitiveIndex);
 }
 
 void RenderableManager::setBlendOrderAt(Instance instance, size_t primitiveIndex, uint16_t order) noexcept {
-    upcast(this)->setBlendOrderAt(instance, 0, primitiveIndex, order);
+    const uint8_t level = upcast(this)->getPrimitiveLevel(instance, primitiveIndex);
+    upcast(this)->setBlendOrderAt(instance, level, primitiveIndex, order);
 }
 
 AttributeBitset RenderableManager::getEnabledAttributesAt(Instance instance, size_t primitiveIndex) const noexcept {
-    return upcast(this)->getEnabledAttributesAt(instance, 0, primitiveIndex);
+    const uint8_t level = upcast(this)->getPrimitiveLevel(instance, primitiveIndex);
+    return upcast(this)->getEnabledAttributesAt(instance, level, primitiveIndex);
 }
 
 void RenderableManager::setGeometryAt(Instance instance, size_t primitiveIndex,
         PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
         size_t offset, size_t count) noexcept {
-    upcast(this)->setGeometryAt(instance, 0, primitiveIndex,
+    const uint8_t level = upcast(this)->getPrimitiveLevel(instance, primitiveIndex);
+    upcast(this)->setGeometryAt(instance, level, primitiveIndex,
             type, upcast(vertices), upcast(indices), offset, count);
 }
 
 void RenderableManager::setGeometryAt(RenderableManager::Instance instance, size_t primitiveIndex,
         RenderableManager::PrimitiveType type, size_t offset, size_t count) noexcept {
-    upcast(this)->setGeometryAt(instance, 0, primitiveIndex, type, offset, count);
+    const uint8_t level = upcast(this)->getPrimitiveLevel(instance, primitiveIndex);
+    upcast(this)->setGeometryAt(instance, level, primitiveIndex, type, offset, count);
 }
 
 void RenderableManager::setBones(Instance instance,
@@ -640,4 +1220,25 @@ void RenderableManager::setMorphWeights(Instance instance, float4 const& weights
     upcast(this)->setMorphWeights(instance, weights);
 }
 
+void RenderableManager::setMorphWeights(Instance instance, float const* weights,
+        size_t count, size_t offset) noexcept {
+    upcast(this)->setMorphWeights(instance, weights, count, offset);
+}
+
+void RenderableManager::setMorphTargetAt(Instance instance, size_t primitiveIndex,
+        size_t targetIndex, uint32_t const* vertices, float3 const* positions,
+        float3 const* normals, size_t count) noexcept {
+    upcast(this)->setMorphTargetAt(instance, primitiveIndex, targetIndex,
+            vertices, positions, normals, count);
+}
+
+void RenderableManager::setInstanceTransforms(Instance instance,
+        mat4f const* transforms, size_t count, size_t offset) noexcept {
+    upcast(this)->setInstanceTransforms(instance, transforms, count, offset);
+}
+
+size_t RenderableManager::getInstanceCount(Instance instance) const noexcept {
+    return upcast(this)->getInstanceCount(instance);
+}
+
 } // namespace filament
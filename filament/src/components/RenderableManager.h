@@ -19,6 +19,7 @@
 
 #include "upcast.h"
 
+#include "ComputeSkinning.h"
 #include "UniformBuffer.h"
 
 #include "private/backend/DriverApiForward.h"
@@ -35,8 +36,15 @@
 #include <utils/Slice.h>
 #include <utils/Range.h>
 
+#include <vector>
+
 // for gtest
 class FilamentTest_Bones_Test;
+class FilamentTest_DynamicBounds_Test;
+
+namespace utils {
+class JobSystem;
+} // namespace utils
 
 namespace filament {
 
@@ -62,6 +70,8 @@ public:
 
     static_assert(sizeof(Visibility) == sizeof(uint16_t), "Visibility should be 16 bits");
 
+    static constexpr size_t MAX_LEVEL_OF_DETAIL_COUNT = 8;
+
     explicit FRenderableManager(FEngine& engine) noexcept;
     ~FRenderableManager();
 
@@ -80,6 +90,10 @@ public:
         return mManager.getInstance(e);
     }
 
+    utils::Entity getEntity(Instance instance) const noexcept {
+        return mManager.getEntity(instance);
+    }
+
     void create(const RenderableManager::Builder& builder, utils::Entity entity);
 
     void destroy(utils::Entity e) noexcept;
@@ -90,8 +104,10 @@ public:
             RenderableManager::Instance const* instances,
             utils::Range<uint32_t> list) const noexcept;
 
-    void gc(utils::EntityManager& em) noexcept {
-        mManager.gc(em);
+    void gc(utils::EntityManager& em, size_t maxCount) noexcept {
+        mManager.gc(em, 4, [this](utils::Entity e) {
+            mManager.removeComponent(e);
+        }, maxCount);
     }
 
     inline void setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept;
@@ -113,6 +129,13 @@ public:
     inline void setBones(Instance instance, Bone const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setBones(Instance instance, math::mat4f const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setMorphWeights(Instance instance, const math::float4& weights) noexcept;
+    void setMorphWeights(Instance instance, float const* weights, size_t count,
+            size_t offset) noexcept;
+    void setMorphTargetAt(Instance instance, size_t primitiveIndex, size_t targetIndex,
+            uint32_t const* vertices, math::float3 const* positions, math::float3 const* normals,
+            size_t count) noexcept;
+    void setInstanceTransforms(Instance instance, math::mat4f const* transforms,
+            size_t count, size_t offset = 0) noexcept;
 
 
     inline bool isShadowCaster(Instance instance) const noexcept;
@@ -127,11 +150,34 @@ public:
     inline uint8_t getPriority(Instance instance) const noexcept;
     inline filament::math::float4 getMorphWeights(Instance instance) const noexcept;
 
+    // Incremented each time the renderable data gathered by FScene::prepare() may have changed.
+    uint32_t getVersion() const noexcept { return mVersion; }
+
+    // Recomputes, in parallel, the bounding boxes of the renderables built with dynamicBounds()
+    // whose bones or morph weights changed since the last call.
+    void updateDynamicBounds(utils::JobSystem& js) noexcept;
+
     inline backend::Handle<backend::HwUniformBuffer> getBonesUbh(Instance instance) const noexcept;
     inline uint32_t getBoneCount(Instance instance) const noexcept;
 
-
-    inline size_t getLevelCount(Instance instance) const noexcept { return 1; }
+    inline backend::Handle<backend::HwUniformBuffer> getInstancesUbh(Instance instance) const noexcept;
+    inline size_t getInstanceCount(Instance instance) const noexcept;
+
+
+    inline size_t getLevelCount(Instance instance) const noexcept;
+    // the level of detail to draw for a bounding sphere covering this fraction of the viewport
+    inline uint8_t getLevelOfDetail(Instance instance, float screenSize) const noexcept;
+    // whether the screen size of the renderable selects what's drawn (levels or impostor)
+    inline bool hasLevels(Instance instance) const noexcept;
+    // the impostor drawn instead of the levels at this screen size, or nullptr (see FImpostor)
+    inline utils::Slice<FRenderPrimitive> const* getImpostor(
+            Instance instance, float screenSize) const noexcept;
+    // an empty slice removes the impostor
+    void setImpostor(Instance instance, utils::Slice<FRenderPrimitive> primitives,
+            float screenSize) noexcept;
+    // converts an index in all the primitives of a renderable to an index in its level
+    inline uint8_t getPrimitiveLevel(Instance instance, size_t& primitiveIndex) const noexcept;
+    inline size_t getPrimitiveCount(Instance instance) const noexcept;
     inline size_t getPrimitiveCount(Instance instance, uint8_t level) const noexcept;
     void setMaterialInstanceAt(Instance instance, uint8_t level,
             size_t primitiveIndex, FMaterialInstance const* materialInstance) noexcept;
@@ -151,32 +197,90 @@ private:
     static void destroyComponentPrimitives(FEngine& engine,
             utils::Slice<FRenderPrimitive>& primitives) noexcept;
 
+    // the vertices a primitive draws when it's skinned or morphed in a compute pass
+    struct SkinnedVertices {
+        FVertexBuffer const* vertices = nullptr;            // the vertices to skin
+        backend::Handle<backend::HwVertexBuffer> handle;    // the skinned vertices
+        // only with compute morphing, the sparse deltas of each morph target
+        std::vector<std::vector<ComputeSkinning::MorphDelta>> targets;
+        backend::Handle<backend::HwBufferObject> deltas;    // all the targets, one after the other
+        bool deltasDirty = false;
+    };
+
+    // only with Builder::dynamicBounds()
+    struct DynamicBounds {
+        Box rest;                                   // the bounds at rest, when morphed only
+        std::vector<Box> boneBoxes;                 // bind pose bounds of each bone's vertices
+        std::vector<math::mat4f> boneTransforms;    // CPU copy of the bones
+        std::vector<math::float3> morphExtents;     // largest position delta of each target
+        bool dirty = false;                         // queued in mDirtyBounds
+    };
+
     struct Bones {
-        filament::backend::Handle<backend::HwUniformBuffer> handle;
+        filament::backend::Handle<backend::HwUniformBuffer> handle; // only when skinned by the VS
         UniformBuffer bones;
         size_t count;
+        // only when skinned or morphed in a compute pass
+        ComputeSkinning::Range palette;     // empty when morphed only
+        uint32_t paletteGeneration;
+        std::unique_ptr<SkinnedVertices[]> skinnedVertices; // one per primitive of all the levels
+        std::vector<float> morphWeights;    // one per morph target
+        bool dirty;                         // the vertices need deforming
+        std::unique_ptr<DynamicBounds> bounds;
+    };
+
+    // only allocated for the renderables with several levels of detail, or with an impostor
+    struct Levels {
+        size_t count;
+        utils::Slice<FRenderPrimitive> primitives[MAX_LEVEL_OF_DETAIL_COUNT];
+        float screenSizes[MAX_LEVEL_OF_DETAIL_COUNT];
+        utils::Slice<FRenderPrimitive> impostor;    // owned by the FImpostor, empty without one
+        float impostorScreenSize;
+    };
+
+    struct Instances {
+        filament::backend::Handle<backend::HwUniformBuffer> handle; // only with transforms
+        UniformBuffer transforms;
+        size_t count;
+        Box aabb;   // bounding box of a single instance
     };
 
     friend class ::FilamentTest_Bones_Test;
+    friend class ::FilamentTest_DynamicBounds_Test;
 
     static void makeBone(PerRenderableUibBone* out, math::mat4f const& transforms) noexcept;
 
+    void setSkinnedVertices(Bones& bones, size_t index, FRenderPrimitive& primitive,
+            FVertexBuffer* vertices, FIndexBuffer* indices) noexcept;
+
+    void deform(backend::DriverApi& driver, Bones const& bones,
+            SkinnedVertices& skinned) const noexcept;
+
+    void updateInstancesAABB(Instance instance) noexcept;
+
+    void invalidateDynamicBounds(Instance instance, DynamicBounds& bounds) noexcept;
+    static Box computeDynamicBounds(Bones const& bones) noexcept;
+
     enum {
         AABB,               // user data
         LAYERS,             // user data
         MORPH_WEIGHTS,      // user data
         VISIBILITY,         // user data
-        PRIMITIVES,         // user data
+        PRIMITIVES,         // user data, the primitives of all the levels of detail
         BONES,              // filament data, UBO storing a pointer to the bones information
+        INSTANCES,          // filament data, instance count and per-instance transforms UBO
+        LEVELS,             // user data, the primitives and screen sizes of each level of detail
     };
 
-    using Base = utils::SingleInstanceComponentManager<
+    using Base = utils::SparseSingleInstanceComponentManager<
             Box,                             // AABB
             uint8_t,                         // LAYERS
             filament::math::float4,          // MORPH_WEIGHTS
             Visibility,                      // VISIBILITY
             utils::Slice<FRenderPrimitive>,  // PRIMITIVES
-            std::unique_ptr<Bones>           // BONES
+            std::unique_ptr<Bones>,          // BONES
+            std::unique_ptr<Instances>,      // INSTANCES
+            std::unique_ptr<Levels>          // LEVELS
     >;
 
     struct Sim : public Base {
@@ -197,6 +301,8 @@ private:
                 Field<VISIBILITY>   visibility;
                 Field<PRIMITIVES>   primitives;
                 Field<BONES>        bones;
+                Field<INSTANCES>    instances;
+                Field<LEVELS>       levels;
             };
         };
 
@@ -210,19 +316,30 @@ private:
 
     Sim mManager;
     FEngine& mEngine;
+    uint32_t mVersion = 0;
+    std::vector<utils::Entity> mDirtyBounds;
 };
 
 FILAMENT_UPCAST(RenderableManager)
 
 void FRenderableManager::setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept {
     if (instance) {
-        mManager[instance].aabb = aabb;
+        mVersion++;
+        std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+        if (UTILS_UNLIKELY(instances && instances->handle)) {
+            // with per-instance transforms, the culling box encloses all the instances
+            instances->aabb = aabb;
+            updateInstancesAABB(instance);
+        } else {
+            mManager[instance].aabb = aabb;
+        }
     }
 }
 
 void FRenderableManager::setLayerMask(Instance instance,
         uint8_t select, uint8_t values) noexcept {
     if (instance) {
+        mVersion++;
         uint8_t& layers = mManager[instance].layers;
         layers = (layers & ~select) | (values & select);
     }
@@ -230,12 +347,14 @@ void FRenderableManager::setLayerMask(Instance instance,
 
 void FRenderableManager::setLayerMask(Instance instance, uint8_t layerMask) noexcept {
     if (instance) {
+        mVersion++;
         mManager[instance].layers = layerMask;
     }
 }
 
 void FRenderableManager::setPriority(Instance instance, uint8_t priority) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.priority = priority;
     }
@@ -243,6 +362,7 @@ void FRenderableManager::setPriority(Instance instance, uint8_t priority) noexce
 
 void FRenderableManager::setCastShadows(Instance instance, bool enable) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.castShadows = enable;
     }
@@ -250,6 +370,7 @@ void FRenderableManager::setCastShadows(Instance instance, bool enable) noexcept
 
 void FRenderableManager::setReceiveShadows(Instance instance, bool enable) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.receiveShadows = enable;
     }
@@ -257,6 +378,7 @@ void FRenderableManager::setReceiveShadows(Instance instance, bool enable) noexc
 
 void FRenderableManager::setScreenSpaceContactShadows(Instance instance, bool enable) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.screenSpaceContactShadows = enable;
     }
@@ -264,6 +386,7 @@ void FRenderableManager::setScreenSpaceContactShadows(Instance instance, bool en
 
 void FRenderableManager::setCulling(Instance instance, bool enable) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.culling = enable;
     }
@@ -271,6 +394,7 @@ void FRenderableManager::setCulling(Instance instance, bool enable) noexcept {
 
 void FRenderableManager::setSkinning(Instance instance, bool enable) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.skinning = enable;
     }
@@ -278,6 +402,7 @@ void FRenderableManager::setSkinning(Instance instance, bool enable) noexcept {
 
 void FRenderableManager::setMorphing(Instance instance, bool enable) noexcept {
     if (instance) {
+        mVersion++;
         Visibility& visibility = mManager[instance].visibility;
         visibility.morphing = enable;
     }
@@ -333,16 +458,85 @@ inline uint32_t FRenderableManager::getBoneCount(Instance instance) const noexce
     return bones ? bones->count : 0;
 }
 
+backend::Handle<backend::HwUniformBuffer> FRenderableManager::getInstancesUbh(Instance instance) const noexcept {
+    std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+    return instances ? instances->handle : backend::Handle<backend::HwUniformBuffer>{};
+}
+
+size_t FRenderableManager::getInstanceCount(Instance instance) const noexcept {
+    std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+    return instances ? instances->count : 1;
+}
+
+size_t FRenderableManager::getLevelCount(Instance instance) const noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    return levels ? levels->count : 1;
+}
+
+uint8_t FRenderableManager::getLevelOfDetail(Instance instance, float screenSize) const noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    if (UTILS_LIKELY(!levels)) {
+        return 0;
+    }
+    uint8_t level = 0;
+    while (level < levels->count - 1 && screenSize < levels->screenSizes[level]) {
+        level++;
+    }
+    return level;
+}
+
+bool FRenderableManager::hasLevels(Instance instance) const noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    return levels != nullptr;
+}
+
+utils::Slice<FRenderPrimitive> const* FRenderableManager::getImpostor(
+        Instance instance, float screenSize) const noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    if (UTILS_LIKELY(!levels || levels->impostor.empty() ||
+            screenSize >= levels->impostorScreenSize)) {
+        return nullptr;
+    }
+    return &levels->impostor;
+}
+
+uint8_t FRenderableManager::getPrimitiveLevel(Instance instance,
+        size_t& primitiveIndex) const noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    if (UTILS_LIKELY(!levels)) {
+        return 0;
+    }
+    uint8_t level = 0;
+    while (level < levels->count - 1 && primitiveIndex >= levels->primitives[level].size()) {
+        primitiveIndex -= levels->primitives[level].size();
+        level++;
+    }
+    return level;
+}
+
 utils::Slice<FRenderPrimitive> const& FRenderableManager::getRenderPrimitives(
         Instance instance, uint8_t level) const noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    if (UTILS_UNLIKELY(levels)) {
+        return levels->primitives[std::min(size_t(level), levels->count - 1)];
+    }
     return mManager[instance].primitives;
 }
 
 utils::Slice<FRenderPrimitive>& FRenderableManager::getRenderPrimitives(
         Instance instance, uint8_t level) noexcept {
+    std::unique_ptr<Levels> const& levels = mManager[instance].levels;
+    if (UTILS_UNLIKELY(levels)) {
+        return levels->primitives[std::min(size_t(level), levels->count - 1)];
+    }
     return mManager[instance].primitives;
 }
 
+size_t FRenderableManager::getPrimitiveCount(Instance instance) const noexcept {
+    utils::Slice<FRenderPrimitive> const& primitives = mManager[instance].primitives;
+    return primitives.size();
+}
+
 size_t FRenderableManager::getPrimitiveCount(Instance instance, uint8_t level) const noexcept {
     return getRenderPrimitives(instance, level).size();
 }
@@ -16,14 +16,24 @@
 
 #include "components/TransformManager.h"
 
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
 #include <math/mat4.h>
+#include <math/simd.h>
+
+#include <algorithm>
 
 using namespace utils;
 using namespace filament::math;
 
 namespace filament {
 
-FTransformManager::FTransformManager() noexcept = default;
+// levels with fewer nodes than this are updated on the calling thread
+static constexpr size_t PARALLEL_LEVEL_MIN_SIZE = 1024;
+
+FTransformManager::FTransformManager(JobSystem* js) noexcept : mJobSystem(js) {
+}
 
 FTransformManager::~FTransformManager() noexcept = default;
 
@@ -53,6 +63,9 @@ void FTransformManager::create(Entity entity, Instance parent, const mat4f& loca
         manager[i].firstChild = 0;
         insertNode(i, parent);
         setTransform(i, localTransform);
+        // new nodes are rendered where they're created until the next commitSnapshot()
+        manager[i].snapshot = manager[i].world;
+        mSnapshotVersion = mVersion;
     }
 }
 
@@ -66,6 +79,7 @@ void FTransformManager::setParent(Instance i, Instance parent) noexcept {
             removeNode(i);
             insertNode(i, parent);
             updateNodeTransform(i);
+            mSnapshotVersion = mVersion;
             // Note: setParent() doesn't reorder the child after the parent in the array,
             // but that's not a problem because TransformManager doesn't rely on that.
             // Also note that commitLocalTransformTransaction() does reorder all children after
@@ -111,6 +125,7 @@ void FTransformManager::destroy(Entity e) noexcept {
     Instance i = manager.getInstance(e);
     validateNode(i);
     if (i) {
+        mVersion++;
         // 1) remove the entry from the linked lists
         removeNode(i);
 
@@ -128,6 +143,7 @@ void FTransformManager::destroy(Entity e) noexcept {
         if (moved != i) {
             updateNode(i);
         }
+        mSnapshotVersion = mVersion;
     }
 }
 
@@ -141,8 +157,35 @@ void FTransformManager::setTransform(Instance ci, const mat4f& model) noexcept {
     }
 }
 
+void FTransformManager::setRootTransform(Instance ci, const mat4f& model) noexcept {
+    auto& manager = mManager;
+    assert(ci && !Instance(manager[ci].parent) && !Instance(manager[ci].firstChild));
+    manager[ci].local = model;
+    manager[ci].world = model;
+    manager[ci].snapshot = model;
+}
+
+void FTransformManager::setSnapshotEnabled(bool enabled) noexcept {
+    if (enabled && !mSnapshotEnabled) {
+        commitSnapshot();
+    }
+    mSnapshotEnabled = enabled;
+}
+
+void FTransformManager::commitSnapshot() noexcept {
+    SYSTRACE_CALL();
+    auto& soa = mManager.getSoA();
+    std::copy_n(soa.data<WORLD>(), soa.size(), soa.data<SNAPSHOT>());
+    mSnapshotVersion = mVersion;
+}
+
 void FTransformManager::updateNodeTransform(Instance i) noexcept {
+    mVersion++;
     if (UTILS_UNLIKELY(mLocalTransformTransactionOpen)) {
+        // the world transforms of this node and its descendants are updated when committing
+        if (!mHierarchyChanged) {
+            mDirty[i] = 1;
+        }
         return;
     }
 
@@ -172,28 +215,100 @@ void FTransformManager::openLocalTransformTransaction() noexcept {
 void FTransformManager::commitLocalTransformTransaction() noexcept {
     if (mLocalTransformTransactionOpen) {
         mLocalTransformTransactionOpen = false;
-        auto& manager = mManager;
+        mVersion++;
+        if (UTILS_UNLIKELY(mHierarchyChanged)) {
+            buildLevels();
+        }
+        updateLevels();
+    }
+}
+
+void FTransformManager::buildLevels() noexcept {
+    SYSTRACE_CALL();
+
+    auto& manager = mManager;
 
-        // swapNode() below needs some temporary storage which we provide here
-        auto& soa = manager.getSoA();
-        soa.ensureCapacity(soa.size() + 1);
+    // swapNode() below needs some temporary storage which we provide here
+    auto& soa = manager.getSoA();
+    soa.ensureCapacity(soa.size() + 1);
+
+    // Ensure that children are always sorted after their parent, so a node's depth is known
+    // before its children's.
+    const size_t count = manager.end();
+    std::vector<uint32_t> depths(count, 0);
+    uint32_t maxDepth = 0;
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        while (UTILS_UNLIKELY(Instance(manager[i].parent) > i)) {
+            swapNode(i, manager[i].parent);
+        }
+        Instance parent = manager[i].parent;
+        assert(parent < i);
+        depths[i] = parent ? depths[parent] + 1 : 0;
+        maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    // counting sort of the nodes by depth, siblings stay in the order of the array
+    mLevelOffsets.assign(maxDepth + 2, 0);
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        mLevelOffsets[depths[i] + 1]++;
+    }
+    for (size_t d = 1; d < mLevelOffsets.size(); d++) {
+        mLevelOffsets[d] += mLevelOffsets[d - 1];
+    }
+    mLevels.resize(count - manager.begin());
+    std::vector<uint32_t> cursors(mLevelOffsets.begin(), mLevelOffsets.end() - 1);
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        mLevels[cursors[depths[i]]++] = i;
+    }
+
+    // after a change of the hierarchy, all the world transforms are recomputed
+    mDirty.assign(count, 1);
+    mDirty[0] = 0;
+    mHierarchyChanged = false;
+}
+
+void FTransformManager::updateLevels() noexcept {
+    SYSTRACE_CALL();
 
-        mat4f const* const UTILS_RESTRICT world = manager.raw_array<WORLD>();
-        for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
-            // Ensure that children are always sorted after their parent.
-            while (UTILS_UNLIKELY(Instance(manager[i].parent) > i)) {
-                swapNode(i, manager[i].parent);
+    auto& manager = mManager;
+    mat4f* const UTILS_RESTRICT world = manager.getSoA().data<WORLD>();
+    mat4f const* const UTILS_RESTRICT local = manager.raw_array<LOCAL>();
+    Instance const* const UTILS_RESTRICT parents = manager.raw_array<PARENT>();
+    uint8_t* const UTILS_RESTRICT dirty = mDirty.data();
+
+    // A node is updated if it or one of its ancestors is dirty. Its parent is on the previous
+    // level and is already up-to-date, so the nodes of a level can be updated concurrently.
+    auto update = [=](Instance const* nodes, size_t count) {
+        for (size_t k = 0; k < count; k++) {
+            const Instance i = nodes[k];
+            const Instance parent = parents[i];
+            if (dirty[i] | dirty[parent]) {
+                dirty[i] = 1;
+                simd::multiply(world[i], world[parent], local[i]);
             }
-            Instance parent = manager[i].parent;
-            assert(parent < i);
-            manager[i].world = world[parent] * static_cast<mat4f const&>(manager[i].local);
+        }
+    };
+
+    for (size_t d = 0, c = mLevelOffsets.size() - 1; d < c; d++) {
+        Instance const* const nodes = mLevels.data() + mLevelOffsets[d];
+        const uint32_t count = mLevelOffsets[d + 1] - mLevelOffsets[d];
+        if (mJobSystem && count >= PARALLEL_LEVEL_MIN_SIZE) {
+            JobSystem& js = *mJobSystem;
+            auto* job = jobs::parallel_for(js, nullptr, nodes, count, std::cref(update),
+                    jobs::CountSplitter<PARALLEL_LEVEL_MIN_SIZE / 2, 8>());
+            js.runAndWait(job);
+        } else {
+            update(nodes, count);
         }
     }
+
+    std::fill(mDirty.begin(), mDirty.end(), 0);
 }
 
 // Inserts a parentless node in the hierarchy
 void FTransformManager::insertNode(Instance i, Instance parent) noexcept {
     auto& manager = mManager;
+    mHierarchyChanged = true;
 
     assert(manager[i].parent == Instance{});
 
@@ -225,6 +340,7 @@ void FTransformManager::swapNode(Instance i, Instance j) noexcept {
     // swap the content of the nodes directly
     std::swap(manager.elementAt<LOCAL>(i), manager.elementAt<LOCAL>(j));
     std::swap(manager.elementAt<WORLD>(i), manager.elementAt<WORLD>(j));
+    std::swap(manager.elementAt<SNAPSHOT>(i), manager.elementAt<SNAPSHOT>(j));
     manager.swap(i, j); // this swaps the data relative to SingleInstanceComponentManager
 
     // now swap the linked-list references, to do that correctly we must use a temporary
@@ -258,6 +374,7 @@ void FTransformManager::swapNode(Instance i, Instance j) noexcept {
 // (making everybody orphaned).
 void FTransformManager::removeNode(Instance i) noexcept {
     auto& manager = mManager;
+    mHierarchyChanged = true;
     Instance parent = manager[i].parent;
     Instance prev = manager[i].prev;
     Instance next = manager[i].next;
@@ -284,6 +401,7 @@ void FTransformManager::removeNode(Instance i) noexcept {
 // update references to this node after it has been moved in the array
 void FTransformManager::updateNode(Instance i) noexcept {
     auto& manager = mManager;
+    mHierarchyChanged = true;
     // update our preview sibling's next reference (to ourselves)
     Instance parent = manager[i].parent;
     Instance prev = manager[i].prev;
@@ -372,11 +490,11 @@ void FTransformManager::validateNode(Instance i) noexcept {
 #endif
 }
 
-void FTransformManager::gc(utils::EntityManager& em) noexcept {
+void FTransformManager::gc(utils::EntityManager& em, size_t maxCount) noexcept {
     auto& manager = mManager;
     manager.gc(em, 4, [this](Entity e) {
                 destroy(e);
-            });
+            }, maxCount);
 }
 
 TransformManager::children_iterator& TransformManager::children_iterator::operator++() {
@@ -446,6 +564,18 @@ void TransformManager::commitLocalTransformTransaction() noexcept {
     upcast(this)->commitLocalTransformTransaction();
 }
 
+void TransformManager::setSnapshotEnabled(bool enabled) noexcept {
+    upcast(this)->setSnapshotEnabled(enabled);
+}
+
+bool TransformManager::isSnapshotEnabled() const noexcept {
+    return upcast(this)->isSnapshotEnabled();
+}
+
+void TransformManager::commitSnapshot() noexcept {
+    upcast(this)->commitSnapshot();
+}
+
 TransformManager::children_iterator TransformManager::getChildrenBegin(
         TransformManager::Instance parent) const noexcept {
     return upcast(this)->getChildrenBegin(parent);
@@ -28,13 +28,20 @@
 
 #include <math/mat4.h>
 
+#include <vector>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 class UTILS_PRIVATE FTransformManager : public TransformManager {
 public:
     using Instance = TransformManager::Instance;
 
-    FTransformManager() noexcept;
+    // If 'js' is set, commitLocalTransformTransaction() updates large hierarchies in parallel.
+    explicit FTransformManager(utils::JobSystem* js = nullptr) noexcept;
     ~FTransformManager() noexcept;
 
     // free-up all resources
@@ -75,7 +82,7 @@ public:
 
     void commitLocalTransformTransaction() noexcept;
 
-    void gc(utils::EntityManager& em) noexcept;
+    void gc(utils::EntityManager& em, size_t maxCount) noexcept;
 
     utils::Slice<const math::mat4f> getWorldTransforms() const noexcept {
         return mManager.slice<WORLD>();
@@ -91,6 +98,35 @@ public:
         return mManager[ci].world;
     }
 
+    // Incremented each time a world transform may have changed, or instances moved.
+    uint32_t getVersion() const noexcept { return mVersion; }
+
+    void setSnapshotEnabled(bool enabled) noexcept;
+
+    bool isSnapshotEnabled() const noexcept { return mSnapshotEnabled; }
+
+    void commitSnapshot() noexcept;
+
+    // The world transform rendering uses: the one of the last commitSnapshot() in snapshot mode,
+    // the current one otherwise.
+    const math::mat4f& getRenderWorldTransform(Instance ci) const noexcept {
+        if (UTILS_UNLIKELY(mSnapshotEnabled)) {
+            return mManager[ci].snapshot;
+        }
+        return mManager[ci].world;
+    }
+
+    // The version of the world transforms rendering uses, see getVersion().
+    uint32_t getRenderVersion() const noexcept {
+        return UTILS_UNLIKELY(mSnapshotEnabled) ? mSnapshotVersion : mVersion;
+    }
+
+    // Sets the transform of a node without parent nor children while rendering, e.g. of a
+    // shadow map camera. Unlike setTransform(), this ignores local transform transactions and
+    // doesn't change the version, so that in snapshot mode this doesn't race with the
+    // setTransform() of the application's other nodes.
+    void setRootTransform(Instance ci, const math::mat4f& model) noexcept;
+
 private:
     struct Sim;
 
@@ -101,6 +137,8 @@ private:
     void insertNode(Instance i, Instance p) noexcept;
     void swapNode(Instance i, Instance j) noexcept;
     static void transformChildren(Sim& manager, Instance firstChild) noexcept;
+    void buildLevels() noexcept;
+    void updateLevels() noexcept;
 
     friend class TransformManager::children_iterator;
 
@@ -111,15 +149,17 @@ private:
         FIRST_CHILD,    // instance to our first child
         NEXT,           // instance to our next sibling
         PREV,           // instance to our previous sibling
+        SNAPSHOT,       // world transform as of the last commitSnapshot()
     };
 
-    using Base = utils::SingleInstanceComponentManager<
+    using Base = utils::SparseSingleInstanceComponentManager<
             math::mat4f,
             math::mat4f,
             Instance,
             Instance,
             Instance,
-            Instance
+            Instance,
+            math::mat4f
     >;
 
     struct Sim : public Base {
@@ -142,6 +182,7 @@ private:
                 Field<FIRST_CHILD>  firstChild;
                 Field<NEXT>         next;
                 Field<PREV>         prev;
+                Field<SNAPSHOT>     snapshot;
             };
         };
 
@@ -155,6 +196,24 @@ private:
 
     Sim mManager;
     bool mLocalTransformTransactionOpen = false;
+
+    // Nodes sorted by depth in the hierarchy, the nodes of depth d are in
+    // [mLevelOffsets[d], mLevelOffsets[d + 1]). Rebuilt when the hierarchy changes.
+    std::vector<Instance> mLevels;
+    std::vector<uint32_t> mLevelOffsets;
+    bool mHierarchyChanged = true;
+
+    // Nodes whose local transform was set during the transaction, only valid if the hierarchy
+    // didn't change. This is a byte per node, so it can be written concurrently.
+    std::vector<uint8_t> mDirty;
+
+    utils::JobSystem* mJobSystem;
+    uint32_t mVersion = 0;
+
+    // In snapshot mode, the world transforms are double-buffered: the application writes the
+    // WORLD ones while rendering reads the SNAPSHOT ones, copied by commitSnapshot().
+    bool mSnapshotEnabled = false;
+    uint32_t mSnapshotVersion = 0;  // the value of mVersion the snapshot reflects
 };
 
 FILAMENT_UPCAST(TransformManager)
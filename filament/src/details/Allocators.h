@@ -44,6 +44,11 @@ static constexpr size_t CONFIG_PER_FRAME_COMMANDS_SIZE     = FILAMENT_PER_FRAME_
 static constexpr size_t CONFIG_MIN_COMMAND_BUFFERS_SIZE    = FILAMENT_MIN_COMMAND_BUFFERS_SIZE_IN_MB * 1024 * 1024;
 static constexpr size_t CONFIG_COMMAND_BUFFERS_SIZE        = 3 * CONFIG_MIN_COMMAND_BUFFERS_SIZE;
 
+// size of the command-stream buffers of the threads creating resources besides the engine's, which
+// are flushed after each call, so they only need to hold the commands of one call
+static constexpr size_t CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE = 64 * 1024;
+static constexpr size_t CONFIG_PRODUCER_COMMAND_BUFFERS_SIZE     = 4 * CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE;
+
 #ifndef NDEBUG
 
 // on Debug builds, HeapAllocatorArena needs LockingPolicy::Mutex because it uses a
@@ -66,9 +71,11 @@ using HeapAllocatorArena = utils::Arena<
         utils::HeapAllocator,
         utils::LockingPolicy::NoLock>;
 
+// the high watermark is cheap to track and reported by the Engine
 using LinearAllocatorArena = utils::Arena<
         utils::LinearAllocator,
-        utils::LockingPolicy::NoLock>;
+        utils::LockingPolicy::NoLock,
+        utils::TrackingPolicy::HighWatermark>;
 
 #endif
 
@@ -81,10 +81,14 @@ public:
     // sets the camera's view matrix (must be a rigid transform)
     void setModelMatrix(const math::mat4f& modelMatrix) noexcept;
 
+    // same as setModelMatrix() for the cameras the engine sets while rendering, e.g. the shadow
+    // maps', see FTransformManager::setRootTransform()
+    void setRootModelMatrix(const math::mat4f& modelMatrix) noexcept;
+
     // sets the camera's view matrix
     void lookAt(const math::float3& eye, const math::float3& center, const math::float3& up = { 0, 1, 0 })  noexcept;
 
-    // returns the view matrix
+    // returns the view matrix, the one of the last snapshot in snapshot mode
     math::mat4f const& getModelMatrix() const noexcept;
 
     // returns the inverse of the view matrix
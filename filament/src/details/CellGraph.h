@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TNT_FILAMENT_DETAILS_CELLGRAPH_H
+#define TNT_FILAMENT_DETAILS_CELLGRAPH_H
+
+#include "details/Culler.h"
+
+#include <filament/Box.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <limits>
+#include <vector>
+
+namespace filament {
+
+/*
+ * The cells and portals of a scene, used to reject the renderables of the cells the camera
+ * can't see, e.g. the other rooms of a building.
+ *
+ * Cells are boxes, connected by portals: convex polygons through which one cell sees into the
+ * other. Starting from the cells that contain the camera, the graph is traversed through the
+ * portals that are in the frustum, narrowing the frustum to each portal along the way.
+ *
+ * Everything is in world space, frustum planes face outside.
+ */
+class CellGraph {
+public:
+    static constexpr uint32_t NO_CELL = std::numeric_limits<uint32_t>::max();
+
+    // maximum number of vertices of a portal
+    static constexpr size_t MAX_PORTAL_VERTEX_COUNT = 8;
+
+    // cells more than this many portals away from the camera's cell are never visible
+    static constexpr size_t MAX_DEPTH = 16;
+
+    uint32_t addCell(Box const& bounds) noexcept;
+
+    // 'vertices' are the 'count' vertices of a convex planar polygon, in order
+    void addPortal(uint32_t cellA, uint32_t cellB,
+            math::float3 const* vertices, size_t count) noexcept;
+
+    void clear() noexcept;
+
+    size_t getCellCount() const noexcept { return mCells.size(); }
+    bool empty() const noexcept { return mCells.empty(); }
+
+    // Computes the cells visible from 'eye' through the frustum defined by six 'planes'. When
+    // 'narrow' is false the frustum isn't narrowed to the portals, which stays conservative when
+    // the frustum covers several eyes.
+    // Returns false if 'eye' is outside all cells, in which case all cells are visible.
+    bool update(math::float4 const planes[6], math::float3 const& eye, bool narrow) noexcept;
+
+    // cells that don't exist (e.g. NO_CELL) are always visible
+    bool isVisible(uint32_t cell) const noexcept {
+        return cell >= mVisible.size() || mVisible[cell];
+    }
+
+    // Clears 'bit' in results[i] if the cell of the i-th renderable, cells[indices[i]], isn't
+    // visible. The other results are left untouched.
+    void cull(Culler::result_type* results, uint32_t const* cells, uint32_t const* indices,
+            size_t count, size_t bit) const noexcept;
+
+private:
+    // planes of the narrowed frustum, up to the edges of a portal clipped by the frustum, the
+    // plane of the portal and the far plane
+    static constexpr size_t MAX_PLANE_COUNT = 16;
+
+    struct Volume {
+        math::float4 planes[MAX_PLANE_COUNT];
+        size_t count;
+    };
+
+    struct Portal {
+        math::float3 vertices[MAX_PORTAL_VERTEX_COUNT];
+        math::float4 plane;     // plane of the polygon, in either direction
+        uint32_t cells[2];
+        uint32_t count;
+    };
+
+    void traverse(uint32_t cell, Volume const& volume, size_t depth) noexcept;
+    bool narrow(Portal const& portal, Volume const& volume, Volume& result) const noexcept;
+
+    std::vector<Box> mCells;
+    std::vector<std::vector<uint32_t>> mCellPortals;  // portals of each cell
+    std::vector<Portal> mPortals;
+
+    // state of the last update()
+    std::vector<bool> mVisible;
+    std::vector<bool> mOnPath;      // cells on the path to the cell being traversed
+    math::float4 mFarPlane{};
+    math::float3 mEye{};
+    bool mNarrow = true;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_CELLGRAPH_H
@@ -24,14 +24,82 @@
 
 #include <filament/ColorGrading.h>
 
-#include <math/mathfwd.h>
+#include "private/backend/DriverApiForward.h"
+
+#include <math/vec2.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <vector>
+
+#include <stdint.h>
 
 namespace filament {
 
 class FEngine;
 
+struct ColorGrading::BuilderDetails {
+    ColorGrading::QualityLevel quality = QualityLevel::MEDIUM;
+
+    ToneMapping toneMapping = ToneMapping::ACES_LEGACY;
+    // White balance
+    math::float2 whiteBalance   = {0.0f, 0.0f};
+    // Channel mixer
+    math::float3 outRed         = {1.0f, 0.0f, 0.0f};
+    math::float3 outGreen       = {0.0f, 1.0f, 0.0f};
+    math::float3 outBlue        = {0.0f, 0.0f, 1.0f};
+    // Tonal ranges
+    math::float3 shadows        = {1.0f, 1.0f, 1.0f};
+    math::float3 midtones       = {1.0f, 1.0f, 1.0f};
+    math::float3 highlights     = {1.0f, 1.0f, 1.0f};
+    math::float4 tonalRanges    = {0.0f, 0.333f, 0.550f, 1.0f}; // defaults in DaVinci Resolve
+    // ASC CDL
+    math::float3 slope          = {1.0f};
+    math::float3 offset         = {0.0f};
+    math::float3 power          = {1.0f};
+    // Color adjustments
+    float        contrast       = 1.0f;
+    float        vibrance       = 1.0f;
+    float        saturation     = 1.0f;
+    // Curves
+    math::float3 shadowGamma    = {1.0f};
+    math::float3 midPoint       = {1.0f};
+    math::float3 highlightScale = {1.0f};
+    // Keep last
+    bool         hasAdjustments = false;
+
+    bool operator!=(const BuilderDetails &rhs) const {
+        return !(rhs == *this);
+    }
+
+    bool operator==(const BuilderDetails &rhs) const {
+        // Note: Do NOT compare hasAdjustments
+        return quality == rhs.quality &&
+               toneMapping == rhs.toneMapping &&
+               whiteBalance == rhs.whiteBalance &&
+               outRed == rhs.outRed &&
+               outGreen == rhs.outGreen &&
+               outBlue == rhs.outBlue &&
+               shadows == rhs.shadows &&
+               midtones == rhs.midtones &&
+               highlights == rhs.highlights &&
+               tonalRanges == rhs.tonalRanges &&
+               slope == rhs.slope &&
+               offset == rhs.offset &&
+               power == rhs.power &&
+               contrast == rhs.contrast &&
+               vibrance == rhs.vibrance &&
+               saturation == rhs.saturation &&
+               shadowGamma == rhs.shadowGamma &&
+               midPoint == rhs.midPoint &&
+               highlightScale == rhs.highlightScale;
+    }
+};
+
 class FColorGrading : public ColorGrading {
 public:
+    class LutCache;
+
     FColorGrading(FEngine& engine, const Builder& builder);
     FColorGrading(const FColorGrading& rhs) = delete;
     FColorGrading& operator=(const FColorGrading& rhs) = delete;
@@ -44,9 +112,52 @@ public:
     backend::TextureHandle getHwHandle() const noexcept { return mLutHandle; }
 
 private:
+    static backend::TextureHandle generateLut(FEngine& engine, BuilderDetails const& builder);
+
     backend::TextureHandle mLutHandle;
 };
 
+// The 3D LUTs are shared by the color gradings created with the same parameters. A LUT nobody
+// uses anymore isn't destroyed right away: the last few are kept, so that going back to a
+// previous configuration (e.g. while tweaking a setting) doesn't generate the LUT again.
+class FColorGrading::LutCache {
+public:
+    // number of LUTs kept after they're released
+    static constexpr size_t UNUSED_CAPACITY = 4;
+
+    LutCache() noexcept;
+    ~LutCache() noexcept;
+
+    LutCache(LutCache const& rhs) = delete;
+    LutCache& operator=(LutCache const& rhs) = delete;
+
+    // Returns the LUT generated for these parameters and adds a reference to it, or a null
+    // handle if there is none.
+    backend::TextureHandle acquire(BuilderDetails const& details) noexcept;
+
+    // Adds a LUT generated for these parameters, with one reference.
+    void add(BuilderDetails const& details, backend::TextureHandle handle);
+
+    // Removes a reference to a LUT, and destroys the oldest unused LUTs past UNUSED_CAPACITY.
+    void release(backend::DriverApi& driver, backend::TextureHandle handle) noexcept;
+
+    // Destroys all the LUTs, they must all have been released.
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // number of LUTs, used or not
+    size_t getSize() const noexcept { return mEntries.size(); }
+
+private:
+    struct Entry {
+        BuilderDetails details;
+        backend::TextureHandle handle;
+        uint32_t references;
+        uint32_t lastUsed;
+    };
+    std::vector<Entry> mEntries;
+    uint32_t mAge = 0;
+};
+
 FILAMENT_UPCAST(ColorGrading)
 
 } // namespace filament
@@ -47,6 +47,16 @@ public:
 
     using result_type = uint8_t;
 
+    // Implementations of the AABB and sphere tests, the best one supported by the CPU is
+    // selected at runtime.
+    enum class Kernel : uint8_t {
+        SCALAR,     // portable, relies on auto-vectorization
+        SSE,        // 8 items per iteration with SSE2
+        AVX2,       // 8 items per iteration with AVX2, if the CPU supports it
+        NEON,       // 8 items per iteration with NEON
+        WASM_SIMD   // 8 items per iteration with WebAssembly SIMD, if compiled with -msimd128
+    };
+
     /*
      * returns whether each AABB in an array intersects with the frustum
      */
@@ -65,6 +75,19 @@ public:
             math::float4 const* b,
             size_t count) noexcept;
 
+    /*
+     * clears the results of the spot light cones that can't intersect with the frustum, given
+     * their apex (xyz of the bounding spheres), axis and squared cosine of their outer angle.
+     * Point lights use a cosSqr of -infinity. Unlike the other tests, count can be any number.
+     */
+    static void intersectsCones(
+            result_type* results,
+            Frustum const& frustum,
+            math::float4 const* spheres,
+            math::float3 const* axes,
+            float const* cosSqr,
+            size_t count) noexcept;
+
     /*
      * returns whether an AABB intersects with the frustum
      */
@@ -91,6 +114,23 @@ public:
                 Frustum const& frustum,
                 math::float4 const* b,
                 size_t count) noexcept;
+
+        // returns the kernel used by the methods above
+        static Kernel getKernel() noexcept;
+
+        // returns whether a kernel can run on this CPU
+        static bool isSupported(Kernel kernel) noexcept;
+
+        static void intersects(Kernel kernel, result_type* results,
+                Frustum const& frustum,
+                math::float3 const* c,
+                math::float3 const* e,
+                size_t count) noexcept;
+
+        static void intersects(Kernel kernel, result_type* results,
+                Frustum const& frustum,
+                math::float4 const* b,
+                size_t count) noexcept;
     };
 };
 
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_CULLINGHIERARCHY_H
+#define TNT_FILAMENT_DETAILS_CULLINGHIERARCHY_H
+
+#include "details/Culler.h"
+
+#include <filament/Box.h>
+#include <filament/RenderableManager.h>
+
+#include <utils/compiler.h>
+#include <utils/EntityInstance.h>
+
+#include <math/vec3.h>
+
+#include <vector>
+
+namespace filament {
+
+/*
+ * A bounding volume hierarchy of the renderables of a scene, used to reject whole groups
+ * of renderables during culling.
+ *
+ * The hierarchy is indexed like the scene's RenderableSoa. It's rebuilt when the list of
+ * renderables changes, otherwise only the nodes containing renderables whose bounds changed
+ * are refit.
+ */
+class CullingHierarchy {
+public:
+    // maximum number of renderables in a leaf
+    static constexpr size_t LEAF_SIZE = 8;
+
+    using Instance = utils::EntityInstance<RenderableManager>;
+
+    void update(Instance const* instances, math::float3 const* centers,
+            math::float3 const* extents, size_t count) noexcept;
+
+    // sets 'bit' in 'results' for each renderable intersecting the frustum, the other
+    // results are left untouched.
+    void cull(Culler::result_type* results, Frustum const& frustum, size_t bit) const noexcept;
+
+    void clear() noexcept;
+
+private:
+    struct Node {
+        Box box;                // bounds of the subtree
+        uint32_t first;         // first entry in mIndices covered by the subtree
+        uint32_t count;         // number of renderables in the subtree
+        uint32_t right;         // index of the second child (the first child follows), 0 if leaf
+        uint32_t parent;        // index of the parent node, the root is its own parent
+    };
+
+    void rebuild(size_t count) noexcept;
+    uint32_t build(uint32_t parent, uint32_t first, uint32_t count) noexcept;
+    void refit() noexcept;
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mIndices;     // renderable indices, ordered so subtrees are contiguous
+    std::vector<uint32_t> mLeaves;      // leaf of each renderable
+    std::vector<Instance> mInstances;   // renderables the hierarchy was built for
+    std::vector<Box> mBoxes;            // bounds of each renderable
+    std::vector<bool> mDirty;           // nodes needing a refit
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_CULLINGHIERARCHY_H
@@ -18,7 +18,11 @@
 #define TNT_FILAMENT_DETAILS_ENGINE_H
 
 #include "upcast.h"
+#include "ComputeSkinning.h"
 #include "PostProcessManager.h"
+#include "ProgramCache.h"
+#include "StreamingBufferAllocator.h"
+#include "TextureStreamer.h"
 
 #include "components/CameraManager.h"
 #include "components/LightManager.h"
@@ -33,6 +37,7 @@
 #include "details/RenderTarget.h"
 #include "details/ResourceList.h"
 #include "details/ColorGrading.h"
+#include "details/ReflectionProbe.h"
 #include "details/Skybox.h"
 
 #include "private/backend/CommandStream.h"
@@ -49,6 +54,8 @@
 #include <filament/MaterialEnums.h>
 #include <filament/Texture.h>
 #include <filament/ColorGrading.h>
+#include <filament/Impostor.h>
+#include <filament/ReflectionProbe.h>
 #include <filament/Skybox.h>
 
 #include <filament/Stream.h>
@@ -63,17 +70,23 @@ class DebugServer;
 } // namespace filament
 #endif
 
+#include <filaflat/BlobDictionary.h>
 #include <filaflat/ShaderBuilder.h>
 
 #include <utils/compiler.h>
 #include <utils/Allocator.h>
 #include <utils/JobSystem.h>
 #include <utils/CountDownLatch.h>
+#include <utils/Mutex.h>
 
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <random>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace filament {
 
@@ -86,6 +99,7 @@ class Program;
 } // namespace driver
 
 class FFence;
+class FImpostor;
 class FMaterialInstance;
 class FRenderer;
 class FScene;
@@ -128,12 +142,14 @@ public:
 
 public:
     static FEngine* create(Backend backend = Backend::DEFAULT,
-            Platform* platform = nullptr, void* sharedGLContext = nullptr);
+            Platform* platform = nullptr, void* sharedGLContext = nullptr,
+            const Config* config = nullptr);
 
 #if UTILS_HAS_THREADING
     static void createAsync(CreateCallback callback, void* user,
             Backend backend = Backend::DEFAULT,
-            Platform* platform = nullptr, void* sharedGLContext = nullptr);
+            Platform* platform = nullptr, void* sharedGLContext = nullptr,
+            const Config* config = nullptr);
 
     static FEngine* getEngine(void* token);
 #endif
@@ -144,6 +160,38 @@ public:
 
     backend::Driver& getDriver() const noexcept { return *mDriver; }
     DriverApi& getDriverApi() noexcept { return mCommandStream; }
+
+    // whether this is called from the thread that created the engine
+    bool isEngineThread() const noexcept {
+        return std::this_thread::get_id() == mMainThreadId;
+    }
+
+    /*
+     * The DriverApi to create and update resources with. VertexBuffer, IndexBuffer and Texture
+     * can be built, and their buffers and images set, from any thread: the engine's thread
+     * records into the engine's CommandStream, the other threads each into one of their own,
+     * which is flushed to the engine's CommandBufferQueue when the ResourceCommands goes out of
+     * scope. So the commands of a call from another thread execute in order with the calls that
+     * thread made before, and before the commands the engine's thread flushes after the call
+     * returned.
+     */
+    struct ProducerStream;
+    class ResourceCommands {
+    public:
+        explicit ResourceCommands(FEngine& engine) noexcept;
+        ~ResourceCommands() noexcept;
+
+        ResourceCommands(ResourceCommands const&) = delete;
+        ResourceCommands& operator=(ResourceCommands const&) = delete;
+
+        DriverApi& getDriverApi() noexcept { return mDriverApi; }
+
+    private:
+        FEngine& mEngine;
+        ProducerStream* mProducer;
+        DriverApi& mDriverApi;
+    };
+
     DFG* getDFG() const noexcept { return mDFG.get(); }
 
     // the per-frame Area is used by all Renderer, so they must run in sequence and
@@ -151,14 +199,31 @@ public:
     // we'll simply have to use separate Areas (for instance).
     LinearAllocatorArena& getPerRenderPassAllocator() noexcept { return mPerRenderPassAllocator; }
 
+    // the configuration given to create(), with its defaults filled-in
+    Config const& getConfig() const noexcept { return mConfig; }
+
+    // how the memory of the per-frame arenas is backed, see Config::arenaHugePages
+    utils::HeapArea::Options getArenaOptions() const noexcept {
+        return { mConfig.arenaHugePages, mConfig.arenaPrefault };
+    }
+
+    // backs Engine::ScratchScope, separate from the per-frame arena so that client allocations
+    // can't starve the renderer
+    LinearAllocatorArena& getScratchArena() noexcept { return mScratchArena; }
+
     // Material IDs...
     uint32_t getMaterialId() const noexcept { return mMaterialId++; }
 
     const FMaterial* getDefaultMaterial() const noexcept { return mDefaultMaterial; }
     const FMaterial* getSkyboxMaterial() const noexcept;
+    const FMaterial* getImpostorMaterial(bool instanced) const noexcept;
     const FIndirectLight* getDefaultIndirectLight() const noexcept { return mDefaultIbl; }
     const FTexture* getDummyCubemap() const noexcept { return mDefaultIblTexture; }
-    const FColorGrading* getDefaultColorGrading() const noexcept { return mDefaultColorGrading; }
+    const FColorGrading* getDefaultColorGrading() const noexcept;
+
+    FColorGrading::LutCache& getColorGradingLutCache() noexcept { return mColorGradingLutCache; }
+
+    ProgramCache& getProgramCache() noexcept { return mProgramCache; }
 
     backend::Handle<backend::HwRenderPrimitive> getFullScreenRenderPrimitive() const noexcept {
         return mFullScreenTriangleRph;
@@ -180,6 +245,10 @@ public:
         return mPostProcessManager;
     }
 
+    ComputeSkinning& getComputeSkinning() noexcept {
+        return mComputeSkinning;
+    }
+
     FRenderableManager& getRenderableManager() noexcept {
         return mRenderableManager;
     }
@@ -208,6 +277,34 @@ public:
         return mBackend;
     }
 
+    bool isAsyncShaderCompilationSupported() noexcept {
+        return getDriverApi().isParallelShaderCompileSupported();
+    }
+
+    void setAsyncShaderCompilationEnabled(bool enabled) noexcept {
+        mAsyncShaderCompilation = enabled;
+    }
+
+    bool isAsyncShaderCompilationEnabled() const noexcept {
+        return mAsyncShaderCompilation;
+    }
+
+    bool loadShaderDictionary(const void* data, size_t size) noexcept;
+
+    // returns nullptr if the dictionary isn't loaded
+    filaflat::BlobDictionary const* getShaderDictionary(uint64_t id) const noexcept {
+        auto pos = mShaderDictionaries.find(id);
+        return pos != mShaderDictionaries.end() ? pos->second.get() : nullptr;
+    }
+
+    TextureStreamer& getTextureStreamer() noexcept {
+        return mTextureStreamer;
+    }
+
+    StreamingBufferAllocator& getStreamingBufferAllocator() noexcept {
+        return mStreamingBufferAllocator;
+    }
+
     ResourceAllocator& getResourceAllocator() noexcept {
         assert(mResourceAllocator);
         return *mResourceAllocator;
@@ -220,16 +317,21 @@ public:
         return clock::now() - getEngineEpoch();
     }
 
-    template <typename T>
-    T* create(ResourceList<T>& list, typename T::Builder const& builder) noexcept;
+    template <typename T, typename L>
+    T* create(ResourceList<T, L>& list, typename T::Builder const& builder) noexcept;
 
     FVertexBuffer* createVertexBuffer(const VertexBuffer::Builder& builder) noexcept;
     FIndexBuffer* createIndexBuffer(const IndexBuffer::Builder& builder) noexcept;
     FIndirectLight* createIndirectLight(const IndirectLight::Builder& builder) noexcept;
     FMaterial* createMaterial(const Material::Builder& builder) noexcept;
+    // the materials embedded in the engine are compressed, they're decompressed when first built
+    FMaterial* createEmbeddedMaterial(uint8_t const* data, size_t size,
+            bool defaultMaterial = false) noexcept;
     FTexture* createTexture(const Texture::Builder& builder) noexcept;
     FSkybox* createSkybox(const Skybox::Builder& builder) noexcept;
     FColorGrading* createColorGrading(const ColorGrading::Builder& builder) noexcept;
+    FReflectionProbe* createReflectionProbe(const ReflectionProbe::Builder& builder) noexcept;
+    FImpostor* createImpostor(const Impostor::Builder& builder) noexcept;
     FStream* createStream(const Stream::Builder& builder) noexcept;
     FRenderTarget* createRenderTarget(const RenderTarget::Builder& builder) noexcept;
 
@@ -260,6 +362,8 @@ public:
     bool destroy(const FScene* p);
     bool destroy(const FSkybox* p);
     bool destroy(const FColorGrading* p);
+    bool destroy(const FReflectionProbe* p);
+    bool destroy(const FImpostor* p);
     bool destroy(const FStream* p);
     bool destroy(const FTexture* p);
     bool destroy(const FRenderTarget* p);
@@ -273,6 +377,28 @@ public:
     // flush the current buffer
     void flush();
 
+    // Called between frames, grows the command buffer if it came close to being full and
+    // Config::maxCommandBufferSizeMB allows it.
+    void growCommandBufferIfNeeded();
+
+    size_t getCommandBufferHighWatermark() const noexcept {
+        return mCommandBufferQueue.getHighWatermark();
+    }
+
+    size_t getCommandBufferSize() const noexcept {
+        return mCommandBufferQueue.getCapacity();
+    }
+
+    size_t getPerRenderPassArenaHighWatermark() const noexcept {
+        return mPerRenderPassAllocator.getListener().getHighWatermark();
+    }
+
+    size_t getScratchArenaHighWatermark() const noexcept {
+        return mScratchArena.getListener().getHighWatermark();
+    }
+
+    MemoryStats getMemoryStats() const noexcept;
+
     /**
      * Processes the platform's event queue when called from the platform's event-handling thread.
      * Returns false when called from any other thread.
@@ -284,6 +410,16 @@ public:
     void prepare();
     void gc();
 
+    // Releases up to Config::destructionBudget of the objects whose destruction was deferred,
+    // oldest first, or all of them when 'all' is true.
+    void processDeferredDestructions(bool all = false);
+
+    // Work that renders or needs to be polled (e.g. FTexture::generatePrefilterMipmap()) runs
+    // within frames: the job is called by each prepare() until it returns true. It's dropped if
+    // one of its textures is destroyed before then.
+    using FrameJob = std::function<bool(DriverApi& driver)>;
+    void addFrameJob(FTexture const* texture0, FTexture const* texture1, FrameJob job);
+
     filaflat::ShaderBuilder& getVertexShaderBuilder() const noexcept {
         return mVertexShaderBuilder;
     }
@@ -307,7 +443,7 @@ public:
     }
 
 private:
-    FEngine(Backend backend, Platform* platform, void* sharedGLContext);
+    FEngine(Backend backend, Platform* platform, void* sharedGLContext, Config const& config);
     void init();
     void shutdown();
 
@@ -317,21 +453,34 @@ private:
     template<typename T, typename L>
     bool terminateAndDestroy(const T* p, ResourceList<T, L>& list);
 
+    // Same as terminateAndDestroy(), but with a destruction budget the object is only removed
+    // from its list: it is terminated and freed by processDeferredDestructions().
+    template<typename T, typename L>
+    bool terminateAndDestroyDeferred(const T* p, ResourceList<T, L>& list);
+
     template<typename T, typename L>
     void cleanupResourceList(ResourceList<T, L>& list);
 
+    // calls f() with all the material instances, including the default ones
+    template<typename F>
+    void forEachMaterialInstance(F f);
+
     backend::Driver* mDriver = nullptr;
 
     Backend mBackend;
     Platform* mPlatform = nullptr;
     bool mOwnPlatform = false;
     void* mSharedGLContext = nullptr;
+    Config mConfig;
     bool mTerminated = false;
+    bool mAsyncShaderCompilation = false;
+    std::unordered_map<uint64_t, std::unique_ptr<filaflat::BlobDictionary>> mShaderDictionaries;
     backend::Handle<backend::HwRenderPrimitive> mFullScreenTriangleRph;
     FVertexBuffer* mFullScreenTriangleVb = nullptr;
     FIndexBuffer* mFullScreenTriangleIb = nullptr;
 
     PostProcessManager mPostProcessManager;
+    ComputeSkinning mComputeSkinning;
 
     utils::EntityManager& mEntityManager;
     FRenderableManager mRenderableManager;
@@ -339,6 +488,10 @@ private:
     FLightManager mLightManager;
     FCameraManager mCameraManager;
     ResourceAllocator* mResourceAllocator = nullptr;
+    TextureStreamer mTextureStreamer;
+    StreamingBufferAllocator mStreamingBufferAllocator;
+    FColorGrading::LutCache mColorGradingLutCache;
+    ProgramCache mProgramCache;
 
     ResourceList<FRenderer> mRenderers{ "Renderer" };
     ResourceList<FView> mViews{ "View" };
@@ -346,13 +499,16 @@ private:
     ResourceList<FFence, utils::LockingPolicy::SpinLock> mFences{"Fence"};
     ResourceList<FSwapChain> mSwapChains{ "SwapChain" };
     ResourceList<FStream> mStreams{ "Stream" };
-    ResourceList<FIndexBuffer> mIndexBuffers{ "IndexBuffer" };
-    ResourceList<FVertexBuffer> mVertexBuffers{ "VertexBuffer" };
+    // these can be created from any thread, see ResourceCommands
+    ResourceList<FIndexBuffer, utils::LockingPolicy::Mutex> mIndexBuffers{ "IndexBuffer" };
+    ResourceList<FVertexBuffer, utils::LockingPolicy::Mutex> mVertexBuffers{ "VertexBuffer" };
     ResourceList<FIndirectLight> mIndirectLights{ "IndirectLight" };
     ResourceList<FMaterial> mMaterials{ "Material" };
-    ResourceList<FTexture> mTextures{ "Texture" };
+    ResourceList<FTexture, utils::LockingPolicy::Mutex> mTextures{ "Texture" };
     ResourceList<FSkybox> mSkyboxes{ "Skybox" };
     ResourceList<FColorGrading> mColorGradings{ "ColorGrading" };
+    ResourceList<FReflectionProbe> mReflectionProbes{ "ReflectionProbe" };
+    ResourceList<FImpostor> mImpostors{ "Impostor" };
     ResourceList<FRenderTarget> mRenderTargets{ "RenderTarget" };
 
     mutable uint32_t mMaterialId = 0;
@@ -362,12 +518,30 @@ private:
 
     std::unique_ptr<DFG> mDFG;
 
+    struct PendingFrameJob {
+        FTexture const* textures[2];
+        FrameJob job;
+    };
+    std::vector<PendingFrameJob> mFrameJobs;
+
+    struct DeferredDestruction {
+        void* object;
+        void (*destroy)(FEngine& engine, void* object);
+    };
+    std::deque<DeferredDestruction> mDeferredDestructions;
+
     std::thread mDriverThread;
     backend::CommandBufferQueue mCommandBufferQueue;
     DriverApi mCommandStream;
 
+    // the CommandStreams of the threads other than the engine's, see ResourceCommands
+    ProducerStream& getProducerStream();
+    utils::Mutex mProducerStreamsLock;
+    std::unordered_map<std::thread::id, std::unique_ptr<ProducerStream>> mProducerStreams;
+
     LinearAllocatorArena mPerRenderPassAllocator;
     HeapAllocatorArena mHeapAllocator;
+    LinearAllocatorArena mScratchArena;
 
     utils::JobSystem mJobSystem;
 
@@ -377,6 +551,7 @@ private:
 
     mutable FMaterial const* mDefaultMaterial = nullptr;
     mutable FMaterial const* mSkyboxMaterial = nullptr;
+    mutable FMaterial const* mImpostorMaterials[2] = {};   // without and with instance transforms
 
     mutable FTexture* mDefaultIblTexture = nullptr;
     mutable FIndirectLight* mDefaultIbl = nullptr;
@@ -410,11 +585,29 @@ public:
         struct {
             bool camera_at_origin = true;
         } view;
+        struct {
+            // bin the lights into froxels with a compute shader, when supported
+            bool gpu_binning = false;
+        } froxelizer;
         struct {
             // When set to true, the backend will attempt to capture the next frame and write the
             // capture to file. At the moment, only supported by the Metal backend.
             bool doFrameCapture = false;
         } renderer;
+        struct {
+            // statistics of the last frame graph executed, CPU times are in ms
+            int pass_count = 0;
+            int culled_pass_count = 0;
+            float execute_ms = 0.0f;
+            float slowest_pass_ms = 0.0f;
+        } framegraph;
+        struct {
+            // statistics of the last frame executed by the backend
+            int draw_count = 0;
+            int pipeline_change_count = 0;
+            int uniform_bind_count = 0;
+            int sampler_bind_count = 0;
+        } draws;
         matdbg::DebugServer* server = nullptr;
     } debug;
 };
@@ -26,8 +26,12 @@ namespace filament {
 class FEngine;
 
 class FrameSkipper {
-    static constexpr size_t MAX_FRAME_LATENCY = 4;
 public:
+    static constexpr size_t MAX_FRAME_LATENCY = 4;
+
+    // number of consecutive frames the GPU must be ahead before the adaptive latency is lowered
+    static constexpr uint32_t LATENCY_DECREASE_FRAME_COUNT = 30;
+
     explicit FrameSkipper(FEngine& engine, size_t latency = 2) noexcept;
     ~FrameSkipper() noexcept;
 
@@ -38,11 +42,28 @@ public:
 
     void endFrame() noexcept;
 
+    // In adaptive mode, when the gpu is behind, the latency grows up to MAX_FRAME_LATENCY - 1
+    // instead of skipping the frame, and it goes back down to the latency given at construction
+    // once the gpu has caught up for LATENCY_DECREASE_FRAME_COUNT frames.
+    void setAdaptive(bool adaptive) noexcept;
+
+    // number of frames the cpu can currently be ahead of the gpu
+    size_t getLatency() const noexcept { return mLatency; }
+
 private:
+    // the sync of the current frame is stored last, the one of the frame 'n' frames before
+    // at index LAST - n.
+    static constexpr size_t LAST = MAX_FRAME_LATENCY - 1;
+
+    bool isSignaled(size_t latency) const noexcept;
+
     FEngine& mEngine;
     using Container = std::array<backend::Handle<backend::HwSync>, MAX_FRAME_LATENCY>;
     mutable Container mDelayedSyncs{};
-    size_t mLast;
+    size_t const mMinLatency;
+    size_t mLatency;
+    uint32_t mAheadFrameCount = 0;
+    bool mAdaptive = false;
 };
 
 } // namespace filament
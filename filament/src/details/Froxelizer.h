@@ -73,7 +73,7 @@ public:
 //  |....|                                          h = num froxels
 //  |....|
 //  +----+
-// 256 lights max
+// CONFIG_MAX_LIGHT_COUNT lights max (256 by default)
 //
 
 // Max number of froxels limited by:
@@ -101,6 +101,12 @@ public:
 
     void setOptions(float zLightNear, float zLightFar) noexcept;
 
+    // Bins the lights with a compute shader instead of the CPU, if the backend supports it.
+    // This must be set before prepare().
+    void setGpuBinningEnabled(bool enabled) noexcept {
+        mGpuBinning = enabled && mGpuBinningSupported;
+    }
+
     /*
      * Allocate per-frame data structures for froxelization.
      *
@@ -110,11 +116,13 @@ public:
      * projection        camera projection matrix
      * projectionNear    near plane
      * projectionFar     far plane
+     * lightCount        number of point and spot lights that will be froxelized
      *
      * return true if updateUniforms() needs to be called
      */
     bool prepare(backend::DriverApi& driverApi, ArenaScope& arena, Viewport const& viewport,
-            const math::mat4f& projection, float projectionNear, float projectionFar) noexcept;
+            const math::mat4f& projection, float projectionNear, float projectionFar,
+            size_t lightCount) noexcept;
 
     Froxel getFroxelAt(size_t x, size_t y, size_t z) const noexcept;
     size_t getFroxelCountX() const noexcept { return mFroxelCountX; }
@@ -152,21 +160,19 @@ public:
             };
         };
     };
-    // This depends on the maximum number of lights (currently 255),and can't be more than 16 bits.
+    // This depends on the maximum number of lights (256 by default), and can't be more than 16 bits.
     static_assert(CONFIG_MAX_LIGHT_INDEX <= std::numeric_limits<uint16_t>::max(), "can't have more than 65536 lights");
     using RecordBufferType = std::conditional_t<CONFIG_MAX_LIGHT_INDEX <= std::numeric_limits<uint8_t>::max(), uint8_t, uint16_t>;
     const utils::Slice<FroxelEntry>& getFroxelBufferUser() const { return mFroxelBufferUser; }
     const utils::Slice<RecordBufferType>& getRecordBufferUser() const { return mRecordBufferUser; }
 
     // this is chosen so froxelizePointAndSpotLight() vectorizes 4 froxel tests / spotlight
-    // with 256 lights this implies 8 jobs (256 / 32) for froxelization.
+    // with 256 lights this implies at most 8 jobs (256 / 32) for froxelization.
     using LightGroupType = uint32_t;
 
 private:
-    struct LightRecord {
-        using bitset = utils::bitset<uint64_t, (CONFIG_MAX_LIGHT_COUNT + 63) / 64>;
-        bitset lights;
-    };
+    // the light records of a froxel are stored as mLightRecordWordCount of these
+    using LightRecordWord = uint64_t;
 
     struct LightParams {
         math::float3 position;
@@ -177,6 +183,8 @@ private:
         // radius is not used in the hot loop, so leave it at the end
         float radius;
     };
+    // LightParams are compared with memcmp()
+    static_assert(sizeof(LightParams) == 9 * sizeof(float), "LightParams must not have padding");
 
     struct LightTreeNode {
         float min;          // lights z-range min
@@ -196,14 +204,19 @@ private:
     void setProjection(const math::mat4f& projection, float near, float far) noexcept;
     bool update() noexcept;
 
-    void froxelizeLoop(FEngine& engine,
+    // returns false if the froxels didn't change since the last call
+    bool froxelizeLoop(FEngine& engine,
             const CameraInfo& camera, const FScene::LightSoa& lightData) noexcept;
 
-    void froxelizeAssignRecordsCompress() noexcept;
+    void froxelizeAssignRecordsCompress(utils::JobSystem& js) noexcept;
 
     void froxelizePointAndSpotLight(FroxelThreadData& froxelThread, size_t bit,
             math::mat4f const& projection, const LightParams& light) const noexcept;
 
+    void commitFroxelBufferChanges(backend::DriverApi& driverApi) noexcept;
+
+    void commitGpuBinning(backend::DriverApi& driverApi) noexcept;
+
     static void computeLightTree(LightTreeNode* lightTree,
             utils::Slice<RecordBufferType> const& lightList,
             const FScene::LightSoa& lightData, size_t lightRecordsOffset) noexcept;
@@ -228,12 +241,32 @@ private:
     math::float4* mPlanesY = nullptr;
     math::float4* mBoundingSpheres = nullptr;
 
-    utils::Slice<FroxelThreadData> mFroxelShardedData;  // 256 KiB w/  256 lights
+    // the sizes below are for 256 visible lights, they scale with the number of visible lights
+    std::vector<FroxelThreadData> mFroxelShardedData;   // 256 KiB w/  256 lights
     utils::Slice<FroxelEntry> mFroxelBufferUser;        //  32 KiB w/ 8192 froxels
 
     // max 32 KiB  (actual: resolution dependant)
     utils::Slice<RecordBufferType> mRecordBufferUser;   //  64 KiB
-    utils::Slice<LightRecord> mLightRecords;            // 256 KiB w/ 256 lights
+    utils::Slice<LightRecordWord> mLightRecords;        // 256 KiB w/ 256 lights & 8192 froxels
+
+    size_t mGroupCount = 0;             // number of light groups (i.e. jobs) used this frame
+    size_t mLightRecordWordCount = 0;   // number of LightRecordWord per froxel
+    size_t mRecordCount = 0;            // number of entries used in the record buffer
+
+    // state of the last froxelization, used to only froxelize lights that changed
+    std::vector<LightParams> mLightParams;  // view-space parameters of each light
+    std::vector<uint32_t> mChangedLights;   // lights that changed since the last froxelization
+    bool mFroxelsValid = false;             // mFroxelShardedData matches mLightParams
+    bool mFroxelsChanged = false;           // the GPU buffers need to be updated
+    std::vector<FroxelEntry> mFroxelBufferUploaded; // froxel buffer as last uploaded to the GPU
+
+    // state of the GPU light binning, the program and buffers are created when first needed
+    bool mGpuBinningSupported = false;
+    bool mGpuBinning = false;
+    utils::Slice<math::float4> mGpuLights;  // view-space position and radius of each light
+    backend::Handle<backend::HwProgram> mBinningProgram;
+    backend::Handle<backend::HwUniformBuffer> mBinningParamsUbh;
+    backend::Handle<backend::HwUniformBuffer> mBinningLightsUbh;
 
     uint16_t mFroxelCountX = 0;
     uint16_t mFroxelCountY = 0;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_IMPOSTOR_H
+#define TNT_FILAMENT_DETAILS_IMPOSTOR_H
+
+#include "upcast.h"
+
+#include "details/RenderPrimitive.h"
+
+#include <filament/Impostor.h>
+
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+
+#include <vector>
+
+namespace filament {
+
+class FCamera;
+class FEngine;
+class FIndexBuffer;
+class FIndirectLight;
+class FMaterialInstance;
+class FRenderer;
+class FRenderTarget;
+class FScene;
+class FTexture;
+class FVertexBuffer;
+class FView;
+
+class FImpostor : public Impostor {
+public:
+    FImpostor(FEngine& engine, const Builder& builder);
+
+    void terminate(FEngine& engine) noexcept;
+
+    void bake(FRenderer& renderer);
+
+    bool isBaked() const noexcept { return mBaked; }
+
+    void setScreenSize(float screenSize) noexcept;
+    float getScreenSize() const noexcept { return mScreenSize; }
+
+    FTexture* getAtlas() const noexcept { return mAtlas; }
+
+    FView* getView() noexcept { return mView; }
+
+private:
+    FEngine& mEngine;
+    const utils::Entity mRenderable;
+    const utils::Entity mSource;
+
+    // we own these
+    FView* mView = nullptr;
+    FScene* mScene = nullptr;
+    FCamera* mCamera = nullptr;
+    utils::Entity mCameraEntity;
+    FTexture* mAtlas = nullptr;
+    FTexture* mDepth = nullptr;
+    std::vector<FRenderTarget*> mTargets;   // one per frame, i.e. per layer of the atlas
+    FVertexBuffer* mVertices = nullptr;
+    FIndexBuffer* mIndices = nullptr;
+    FMaterialInstance* mMaterialInstance = nullptr;
+    backend::Handle<backend::HwRenderPrimitive> mPrimitiveHandle;
+    FRenderPrimitive mPrimitive;            // the quad, drawn in place of the renderable
+
+    float mScreenSize;
+    uint8_t mFrames;
+    bool mBaked = false;
+};
+
+FILAMENT_UPCAST(Impostor)
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_IMPOSTOR_H
@@ -40,12 +40,17 @@ public:
 
     size_t getIndexCount() const noexcept { return mIndexCount; }
 
+    size_t getMemorySize() const noexcept { return size_t(mIndexCount) * mIndexSize; }
+
     void setBuffer(FEngine& engine, BufferDescriptor&& buffer, uint32_t byteOffset = 0);
 
+    void* mapBuffer(FEngine& engine, uint32_t byteCount, uint32_t byteOffset = 0);
+
 private:
     friend class IndexBuffer;
     backend::Handle<backend::HwIndexBuffer> mHandle;
     uint32_t mIndexCount;
+    uint8_t mIndexSize;
 };
 
 FILAMENT_UPCAST(IndexBuffer)
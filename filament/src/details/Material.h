@@ -72,6 +72,9 @@ public:
 
     UniformInterfaceBlock::UniformInfo const* reflect(utils::StaticString const& name) const noexcept;
 
+    // creates the programs of the variants made of the features in 'variants' ahead of time
+    void compile(uint8_t variants, Material::CompilationCallback callback, void* user) noexcept;
+
     FMaterialInstance const* getDefaultInstance() const noexcept { return &mDefaultInstance; }
     FMaterialInstance* getDefaultInstance() noexcept { return &mDefaultInstance; }
 
@@ -86,6 +89,9 @@ public:
         backend::Handle<backend::HwProgram> const entry = mCachedPrograms[variantKey];
         return UTILS_LIKELY(entry) ? entry : getProgramSlow(variantKey);
     }
+    // whether the program of this surface variant exists or can be created
+    bool hasVariant(uint8_t variantKey) const noexcept;
+
     backend::Program getProgramBuilderWithVariants(uint8_t variantKey, uint8_t vertexVariantKey,
             uint8_t fragmentVariantKey) const noexcept;
     backend::Handle<backend::HwProgram> createAndCacheProgram(backend::Program&& p,
@@ -115,8 +121,11 @@ public:
     float getMaskThreshold() const noexcept { return mMaskThreshold; }
     bool hasShadowMultiplier() const noexcept { return mHasShadowMultiplier; }
     AttributeBitset getRequiredAttributes() const noexcept { return mRequiredAttributes; }
+    // the attributes the depth variant may read
+    AttributeBitset getDepthAttributes() const noexcept { return mDepthAttributes; }
     RefractionMode getRefractionMode() const noexcept { return mRefractionMode; }
     RefractionType getRefractionType() const noexcept { return mRefractionType; }
+    bool isFoveationEnabled() const noexcept { return mFoveationEnabled; }
 
     bool hasSpecularAntiAliasing() const noexcept { return mSpecularAntiAliasing; }
     float getSpecularAntiAliasingVariance() const noexcept { return mSpecularAntiAliasingVariance; }
@@ -175,6 +184,7 @@ private:
     MaterialDomain mMaterialDomain = MaterialDomain::SURFACE;
     CullingMode mCullingMode = CullingMode::NONE;
     AttributeBitset mRequiredAttributes;
+    AttributeBitset mDepthAttributes;
     RefractionMode mRefractionMode = RefractionMode::NONE;
     RefractionType mRefractionType = RefractionType::SOLID;
     uint64_t mMaterialProperties = 0;
@@ -189,6 +199,7 @@ private:
     bool mHasCustomDepthShader = false;
     bool mIsDefaultMaterial = false;
     bool mSpecularAntiAliasing = false;
+    bool mFoveationEnabled = true;
 
     FMaterialInstance mDefaultInstance;
     SamplerInterfaceBlock mSamplerInterfaceBlock;
@@ -22,6 +22,7 @@
 #include "details/Engine.h"
 
 #include "private/backend/DriverApi.h"
+#include "private/backend/UniformBufferUpdate.h"
 
 #include <backend/Handle.h>
 
@@ -31,9 +32,12 @@
 
 #include <filament/MaterialInstance.h>
 
+#include <vector>
+
 namespace filament {
 
 class FMaterial;
+class FTexture;
 
 class FMaterialInstance : public MaterialInstance {
 public:
@@ -51,6 +55,17 @@ public:
         }
     }
 
+    // size in bytes of the update of this instance's uniforms in a batch given to
+    // DriverApi::updateUniformBuffers(), 0 if none of them changed
+    size_t getUniformsUpdateSize() const noexcept {
+        return mUniforms.isDirty() ?
+                backend::UniformBufferUpdate::getStorageSize(mUniforms.getDirtySize()) : 0;
+    }
+
+    // writes the update of the range of uniforms that changed at 'out' and cleans them, returns
+    // the end of the update. The uniforms must be dirty.
+    void* writeUniformsUpdate(void* out) const noexcept;
+
     void use(FEngine::DriverApi& driver) const {
         if (mUbHandle) {
             driver.bindUniformBuffer(BindingPoints::PER_MATERIAL_INSTANCE, mUbHandle);
@@ -66,12 +81,34 @@ public:
     template <typename T, typename = is_supported_parameter_t<T>>
     void setParameter(const char* name, const T* value, size_t count) noexcept;
 
+    // sets values[i] on instances[i], or values[0] on all of them if valueStride is 0
+    template <typename T, typename = is_supported_parameter_t<T>>
+    static void setParameter(MaterialInstance* const* instances, size_t count,
+            const char* name, const T* values, size_t valueStride) noexcept;
+
     void setParameter(const char* name,
             Texture const* texture, TextureSampler const& sampler) noexcept;
 
     void setParameter(const char* name,
             backend::Handle<backend::HwTexture> texture, backend::SamplerParams params) noexcept;
 
+    // The streamed textures bound to this instance, their HwTexture changes as their levels are
+    // streamed in or evicted.
+    struct StreamedTexture {
+        FTexture const* texture;
+        uint32_t index;         // in the sampler group
+    };
+
+    std::vector<StreamedTexture> const& getStreamedTextures() const noexcept {
+        return mStreamedTextures;
+    }
+
+    // rebinds the streamed textures whose HwTexture changed
+    void updateStreamedTextures() noexcept;
+
+    // called when a streamed texture is destroyed
+    void forgetStreamedTexture(FTexture const* texture) noexcept;
+
     FMaterial const* getMaterial() const noexcept { return mMaterial; }
 
     uint64_t getSortingKey() const noexcept { return mMaterialSortingKey; }
@@ -151,6 +188,7 @@ private:
 
     UniformBuffer mUniforms;
     backend::SamplerGroup mSamplers;
+    std::vector<StreamedTexture> mStreamedTextures;
     backend::PolygonOffset mPolygonOffset;
     backend::CullingMode mCulling;
     bool mColorWrite;
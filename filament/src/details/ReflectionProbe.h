@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TNT_FILAMENT_DETAILS_REFLECTIONPROBE_H
+#define TNT_FILAMENT_DETAILS_REFLECTIONPROBE_H
+
+#include "upcast.h"
+
+#include <filament/ReflectionProbe.h>
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+
+#include <math/vec3.h>
+
+namespace filament {
+
+class FCamera;
+class FEngine;
+class FIndirectLight;
+class FRenderer;
+class FRenderTarget;
+class FScene;
+class FTexture;
+class FView;
+
+class FReflectionProbe : public ReflectionProbe {
+public:
+    FReflectionProbe(FEngine& engine, const Builder& builder);
+
+    void terminate(FEngine& engine) noexcept;
+
+    void setPosition(math::float3 const& position) noexcept { mPosition = position; }
+    math::float3 getPosition() const noexcept { return mPosition; }
+
+    void render(FRenderer& renderer);
+
+    FIndirectLight* getIndirectLight() const noexcept { return mIndirectLight; }
+
+    FView* getView() noexcept { return mView; }
+
+private:
+    // A capture goes through these states, render() moves it to the next one.
+    enum class State : uint8_t {
+        CAPTURE,    // the faces are rendered, a few per frame
+        FILTER,     // the reflections are filtered by a frame job, a level per frame
+        SWAP        // waiting for the irradiance, then the IndirectLight is replaced
+    };
+
+    // The irradiance is read back asynchronously, it can arrive after the probe is destroyed.
+    struct PendingIrradiance {
+        FReflectionProbe* probe;
+    };
+
+    void filter() noexcept;
+    void swap() noexcept;
+
+    FEngine& mEngine;
+    FScene* const mScene;
+
+    // we own these
+    FView* mView = nullptr;
+    FCamera* mCamera = nullptr;
+    utils::Entity mCameraEntity;
+    FTexture* mCapture = nullptr;
+    FTexture* mDepth = nullptr;
+    FRenderTarget* mTargets[6] = {};
+    FTexture* mReflections[2] = {};     // the one in use by mIndirectLight, and the next one
+    FIndirectLight* mIndirectLight = nullptr;
+    PendingIrradiance* mPendingIrradiance = nullptr;
+
+    math::float3 mPosition;
+    math::float3 mCapturePosition;
+    math::float3 mIrradiance[9] = {};
+    float mNear;
+    float mFar;
+    uint16_t mSampleCount;
+    uint8_t mFacesPerFrame;
+    uint8_t mNextFace = 0;
+    uint8_t mBack = 0;                  // index of the reflections being filtered
+    State mState = State::CAPTURE;
+    bool mHasIrradiance = false;
+};
+
+FILAMENT_UPCAST(ReflectionProbe)
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_REFLECTIONPROBE_H
@@ -36,8 +36,14 @@ class FRenderPrimitive {
 public:
     FRenderPrimitive() noexcept = default;
 
-    void init(backend::DriverApi& driver, const RenderableManager::Builder::Entry& entry) noexcept;
+    // 'handle' must have been created by the caller, FRenderPrimitive doesn't own it
+    void init(backend::DriverApi& driver, backend::Handle<backend::HwRenderPrimitive> handle,
+            const RenderableManager::Builder::Entry& entry) noexcept;
 
+    // destroys the depth primitive, which FRenderPrimitive owns
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // this removes the depth vertices
     void set(FEngine& engine, RenderableManager::PrimitiveType type,
             FVertexBuffer* vertices, FIndexBuffer* indices, size_t offset,
             size_t minIndex, size_t maxIndex, size_t count) noexcept;
@@ -45,11 +51,17 @@ public:
     void set(FEngine& engine, RenderableManager::PrimitiveType type,
             size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept;
 
-    // frees driver resources, object becomes invalid
-    void terminate(FEngine& engine);
-
     const FMaterialInstance* getMaterialInstance() const noexcept { return mMaterialInstance; }
     backend::Handle<backend::HwRenderPrimitive> getHwHandle() const noexcept { return mHandle; }
+
+    // The primitive drawn by the depth passes: the depth vertices are used unless they lack one
+    // of the attributes of the vertices that the depth variant of the material reads.
+    backend::Handle<backend::HwRenderPrimitive> getDepthHwHandle(
+            AttributeBitset depthAttributes) const noexcept {
+        const bool missing = (depthAttributes & mEnabledAttributes & ~mDepthAttributes).any();
+        return (mDepthHandle && !missing) ? mDepthHandle : mHandle;
+    }
+
     backend::PrimitiveType getPrimitiveType() const noexcept { return mPrimitiveType; }
     AttributeBitset getEnabledAttributes() const noexcept { return mEnabledAttributes; }
     uint16_t getBlendOrder() const noexcept { return mBlendOrder; }
@@ -62,8 +74,10 @@ public:
 private:
     FMaterialInstance const* mMaterialInstance = nullptr;
     backend::Handle<backend::HwRenderPrimitive> mHandle;
+    backend::Handle<backend::HwRenderPrimitive> mDepthHandle;
     backend::PrimitiveType mPrimitiveType = backend::PrimitiveType::NONE;
     AttributeBitset mEnabledAttributes;
+    AttributeBitset mDepthAttributes;
     uint16_t mBlendOrder = 0;
 };
 
@@ -73,6 +73,11 @@ public:
 
     // do all the work here!
     void render(FView const* view);
+    // renders a View into its RenderTarget cleared to the given color, regardless of the
+    // ClearOptions, which still apply to the next View (see FImpostor)
+    void renderCleared(FView const* view, math::float4 const& clearColor);
+    void renderStandaloneView(FView const* view);
+    void renderInternal(FView const* view);
     void renderJob(ArenaScope& arena, FView& view);
 
     void copyFrame(FSwapChain* dstSwapChain, Viewport const& dstViewport,
@@ -91,6 +96,8 @@ public:
             uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
             backend::PixelBufferDescriptor&& buffer);
 
+    void readPixels(ReadPixelsRequest* requests, size_t count);
+
     // Clean-up everything, this is typically called when the client calls Engine::destroyRenderer()
     void terminate(FEngine& engine);
 
@@ -114,12 +121,18 @@ public:
         // headroom can't be larger than frame time, or less than 0
         frameRateOptions.headRoomRatio = std::min(frameRateOptions.headRoomRatio, 1.0f);
         frameRateOptions.headRoomRatio = std::max(frameRateOptions.headRoomRatio, 0.0f);
+
+        mFrameSkipper.setAdaptive(frameRateOptions.adaptiveLatency);
     }
 
     void setClearOptions(const ClearOptions& options) {
         mClearOptions = options;
     }
 
+    void setFrameTimingsCallback(FrameTimingsCallback callback, void* user) noexcept {
+        mPassTimer.setCallback(callback, user);
+    }
+
 private:
     friend class Renderer;
     using Command = RenderPass::Command;
@@ -148,11 +161,29 @@ private:
             PostProcessManager::ColorGradingConfig colorGradingConfig,
             RenderPass const& pass, FView const& view) const noexcept;
 
+    // returns an invalid handle when there are no refractive objects
     FrameGraphId<FrameGraphTexture> refractionPass(FrameGraph& fg,
             ColorPassConfig config,
             PostProcessManager::ColorGradingConfig colorGradingConfig,
             RenderPass const& pass, FView const& view) const noexcept;
 
+    // renders the weighted blended commands of the pass and composites them over the color buffer
+    FrameGraphId<FrameGraphTexture> orderIndependentTransparencyPass(FrameGraph& fg,
+            ColorPassConfig const& config, RenderPass const& pass, FView const& view,
+            FrameGraphId<FrameGraphTexture> input) const noexcept;
+
+    // issues the commands of a color pass for each eye of a stereo view
+    static void renderStereo(backend::DriverApi& driver, FrameGraphRenderTarget out,
+            RenderPass const& pass, const char* name, FView const& view) noexcept;
+
+    // renders the depth of the opaque objects in the depth buffer used by the color passes
+    void depthPrepassPass(FrameGraph& fg, ColorPassConfig const& config,
+            RenderPass const& pass) const noexcept;
+
+    // renders the object ids of the view's picking queries and reads them back
+    void pickingPass(FrameGraph& fg, ColorPassConfig const& config,
+            RenderPass const& pass, FView& view) const noexcept;
+
     void recordHighWatermark(size_t watermark) noexcept {
         mCommandsHighWatermark = std::max(mCommandsHighWatermark, watermark);
     }
@@ -183,6 +214,7 @@ private:
     size_t mCommandsHighWatermark = 0;
     uint32_t mFrameId = 0;
     FrameInfoManager mFrameInfoManager;
+    PassTimer mPassTimer;
     backend::TextureFormat mHdrTranslucent{};
     backend::TextureFormat mHdrQualityMedium{};
     backend::TextureFormat mHdrQualityHigh{};
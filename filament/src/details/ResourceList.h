@@ -125,6 +125,15 @@ public:
         return std::move(reinterpret_cast<tsl::robin_set<T*>&>(list));
     }
 
+    // calls f() with each item, holding the lock
+    template<typename F>
+    void forEach(F f) const {
+        std::lock_guard<LockingPolicy> guard(mLock);
+        for (void* item : mList) {
+            f(static_cast<T*>(item));
+        }
+    }
+
     /*
      * the methods below are only safe when LockingPolicy is NoLock, so disable them
      * otherwise
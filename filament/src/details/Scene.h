@@ -22,13 +22,18 @@
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 
+#include "details/CellGraph.h"
 #include "details/Culler.h"
+#include "details/CullingHierarchy.h"
 
 #include "Allocators.h"
 
+#include <private/filament/UibGenerator.h>
+
 #include <filament/Box.h>
 #include <filament/Scene.h>
 
+#include <utils/architecture.h>
 #include <utils/compiler.h>
 #include <utils/Entity.h>
 #include <utils/Slice.h>
@@ -36,6 +41,9 @@
 #include <utils/Range.h>
 
 #include <cstddef>
+#include <vector>
+
+#include <tsl/robin_map.h>
 #include <tsl/robin_set.h>
 
 namespace filament {
@@ -70,6 +78,15 @@ public:
     size_t getLightCount() const noexcept;
     bool hasEntity(utils::Entity entity) const noexcept;
 
+    void setHierarchicalCullingEnabled(bool enabled) noexcept;
+    bool isHierarchicalCullingEnabled() const noexcept { return mHierarchicalCulling; }
+
+    uint32_t addCell(Box const& bounds) noexcept;
+    void addPortal(uint32_t cellA, uint32_t cellB, math::float3 const* vertices, size_t count);
+    void setCell(utils::Entity entity, uint32_t cell);
+    void clearCells() noexcept;
+    size_t getCellCount() const noexcept { return mCellGraph.getCellCount(); }
+
 public:
     /*
      * Filaments-scope Public API
@@ -83,7 +100,9 @@ public:
     ~FScene() noexcept;
     void terminate(FEngine& engine);
 
-    void prepare(const math::mat4f& worldOriginTransform);
+    // Gathers the renderables and lights of the scene. Several Views of the same frame (same
+    // frameId) showing this scene with the same world origin share the work of the first one.
+    void prepare(const math::mat4f& worldOriginTransform, uint32_t frameId);
     void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena, backend::Handle<backend::HwUniformBuffer> lightUbh) noexcept;
 
 
@@ -102,10 +121,12 @@ public:
         WORLD_TRANSFORM,        // 16 | instance of the Transform component
         REVERSED_WINDING_ORDER, //  1 | det(WORLD_TRANSFORM)<0
         VISIBILITY_STATE,       //  1 | visibility data of the component
-        BONES_UBH,              //  4 | bones uniform buffer handle
+        BONES_UBH,              //  4 | bones or per-instance transforms uniform buffer handle
+        INSTANCE_COUNT,         //  2 | number of instances to draw
         WORLD_AABB_CENTER,      // 12 | world-space bounding box center of the renderable
         VISIBLE_MASK,           //  1 | each bit represents a visibility in a pass
         MORPH_WEIGHTS,          //  4 | floats for morphing
+        PREPARED_INDEX,         //  4 | index of the renderable in prepare(), for its cached UBO
 
         // These are not needed anymore after culling
         LAYERS,                 //  1 | layers
@@ -122,9 +143,11 @@ public:
             bool,                                       // REVERSED_WINDING_ORDER
             FRenderableManager::Visibility,             // VISIBILITY_STATE
             backend::Handle<backend::HwUniformBuffer>,  // BONES_UBH
+            uint16_t,                                   // INSTANCE_COUNT
             math::float3,                               // WORLD_AABB_CENTER
             VisibleMaskType,                            // VISIBLE_MASK
             math::float4,                               // MORPH_WEIGHTS
+            uint32_t,                                   // PREPARED_INDEX
             uint8_t,                                    // LAYERS
             math::float3,                               // WORLD_AABB_EXTENT
             utils::Slice<FRenderPrimitive>,             // PRIMITIVES
@@ -196,11 +219,37 @@ public:
     LightSoa const& getLightData() const noexcept { return mLightData; }
     LightSoa& getLightData() noexcept { return mLightData; }
 
-    void updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept;
+    // The upload is skipped if renderableUbh already holds the current data of these renderables,
+    // unless forceUpload is set (e.g. renderableUbh was last written by another scene).
+    void updateUBOs(utils::Range<uint32_t> visibleRenderables,
+            backend::Handle<backend::HwUniformBuffer> renderableUbh, bool forceUpload) noexcept;
 
     bool hasContactShadows() const noexcept;
 
+    // null when hierarchical culling is disabled, valid after prepare()
+    CullingHierarchy const* getCullingHierarchy() const noexcept {
+        return mHierarchicalCulling ? &mCullingHierarchy : nullptr;
+    }
+
+    // Clears 'bit' in the VISIBLE_MASK of the renderables whose cell can't be seen from 'eye'
+    // through 'frustum'. 'frustum' has the world origin applied, 'eye' is in API world space.
+    // Nothing is culled when the eye is outside all cells. Must be called before the renderables
+    // are reordered.
+    void cullCells(Frustum const& frustum, math::mat4f const& worldOrigin,
+            math::float3 const& eye, bool narrow, size_t bit) noexcept;
+
 private:
+    // number of renderables prepared by each job of prepare(), so that no two jobs share a
+    // cache line of the RenderableSoa arrays
+    static constexpr size_t PREPARE_CHUNK_SIZE = utils::CACHELINE_SIZE;
+    // below that many chunks, prepare() doesn't split its work further
+    static constexpr size_t PREPARE_MIN_CHUNK_COUNT = 4;
+    // below that many renderables, updateUBOs() doesn't split its work further
+    static constexpr size_t UBO_MIN_RENDERABLE_COUNT = 64;
+
+    // looks up the renderables and lights of mEntities, for prepare()
+    void gatherEntities(const math::mat4f& worldOriginTransform);
+
     static inline void computeLightRanges(math::float2* zrange,
             CameraInfo const& camera, const math::float4* spheres, size_t count) noexcept;
 
@@ -217,6 +266,43 @@ private:
      * nicely as vector<>, which is a good compromise.
      */
     tsl::robin_set<utils::Entity> mEntities;
+    uint32_t mVersion = 0;  // incremented when mEntities or how they're prepared change
+
+    // renderables found by prepare(), their data is gathered in parallel
+    struct PreparedRenderable {
+        FRenderableManager::Instance renderable;
+        FTransformManager::Instance transform;
+    };
+    std::vector<PreparedRenderable> mPreparedRenderables;
+    std::vector<PreparedRenderable> mLastPreparedRenderables; // of the previous prepare()
+
+    // cells and portals, and the cell of each prepared renderable when any has one
+    CellGraph mCellGraph;
+    tsl::robin_map<utils::Entity, uint32_t> mEntityCells;
+    std::vector<uint32_t> mPreparedCells;
+
+    // The renderables' data as computed by the last prepare(), in the order of
+    // mPreparedRenderables. A renderable's data isn't computed again unless its transform or
+    // renderable component changed.
+    RenderableSoa mPreparedData;
+    math::mat4f mPreparedWorldOrigin;
+    uint32_t mPreparedTransformVersion = 0;
+    uint32_t mPreparedRenderableVersion = 0;
+
+    // The lights found by the last prepare(), before the View reorders them in mLightData, and
+    // what they were found from, so the other Views of the same frame can reuse them.
+    LightSoa mPreparedLightData;
+    uint32_t mPreparedLightVersion = 0;
+    uint32_t mPreparedSceneVersion = 0;
+    uint32_t mPreparedFrameId = 0;
+    bool mPreparedFrameValid = false;
+
+    // Per-renderable UBO contents of the prepared renderables, recomputed only when dirty.
+    std::vector<PerRenderableUib> mUboCache;
+    std::vector<uint8_t> mUboDirty;
+
+    // What was last uploaded to mRenderableViewUbh, which is reused as is if nothing changed.
+    std::vector<uint32_t> mUploadedIndices;
 
 
     /*
@@ -229,6 +315,9 @@ private:
     LightSoa mLightData;
     backend::Handle<backend::HwUniformBuffer> mRenderableViewUbh; // This is actually owned by the view.
     bool mHasContactShadows = false;
+
+    CullingHierarchy mCullingHierarchy;
+    bool mHierarchicalCulling = false;
 };
 
 FILAMENT_UPCAST(Scene)
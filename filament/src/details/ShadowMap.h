@@ -28,6 +28,7 @@
 #include <filament/Viewport.h>
 
 #include <math/mat4.h>
+#include <math/vec2.h>
 #include <math/vec4.h>
 
 namespace filament {
@@ -55,6 +56,14 @@ public:
         // the dimension of the actual shadow map, taking into account the 1 texel border
         // e.g., for a texture dimension of 512, shadowDimension would be 510
         size_t shadowDimension = 0;
+
+        // the position of the shadow map texture within the atlas, in texels
+        // e.g., for the top-right quadrant of a 1024 atlas, offset would be (512, 512)
+        math::uint2 offset = {};
+
+        // for point lights, the face of the cube rendered in this shadow map
+        // (0 to 5 for +x, -x, +y, -y, +z, -z)
+        uint8_t face = 0;
     };
 
     struct CascadeParameters {
@@ -82,14 +91,25 @@ public:
             FView const& view, filament::CameraInfo const& camera, uint8_t visibleLayers,
             CascadeParameters& cascadeParams);
 
+    // Computes the dimension of the shadow map a cascade needs for its texels to be no larger
+    // than a pixel, at the near end of the cascade. 'near' and 'far' are the (positive) distances
+    // of the cascade from the camera, and 'viewportHeight' is in pixels.
+    static float computeCascadeDimension(filament::CameraInfo const& camera,
+            float viewportHeight, float near, float far) noexcept;
+
+    // Returns the direction a point light's shadow map looks at for the given cube face.
+    static math::float3 getCubeFaceDirection(size_t face) noexcept;
+
     // Call once per frame if the light, scene (or visible layers) or camera changes.
     // This computes the light's camera.
     void update(const FScene::LightSoa& lightData, size_t index, FScene const* scene,
             filament::CameraInfo const& camera, uint8_t visibleLayers,
             ShadowMapLayout layout, const CascadeParameters& cascadeParams) noexcept;
 
-    void render(backend::DriverApi& driver, utils::Range<uint32_t> const& range, RenderPass& pass,
-            FView& view) noexcept;
+    // Sets up 'pass' to render the shadow casters in 'range' with this shadow map's camera.
+    // The casters' level of detail must be up-to-date (see FView::updatePrimitivesLod()).
+    void prepareRenderPass(RenderPass& pass, utils::Range<uint32_t> const& range,
+            FView const& view) const noexcept;
 
     // Do we have visible shadows. Valid after calling update().
     bool hasVisibleShadows() const noexcept { return mHasVisibleShadows; }
@@ -32,6 +32,10 @@
 #include "fg/FrameGraph.h"
 #include "fg/FrameGraphPassResources.h"
 
+#include <utils/Range.h>
+
+#include <math/mat4.h>
+#include <math/vec2.h>
 #include <math/vec3.h>
 
 #include <array>
@@ -55,15 +59,27 @@ public:
     };
 
 
+    // Number of shadow maps used by a point light.
+    static constexpr size_t CUBE_FACE_COUNT = 6;
+
     explicit ShadowMapManager(FEngine& engine);
     ~ShadowMapManager();
 
+    // Frees the shadow maps kept across frames.
+    void terminate(FEngine& engine) noexcept;
+
     // Reset shadow map layout.
     void reset() noexcept;
 
     void setShadowCascades(size_t lightIndex, size_t cascades) noexcept;
     void addSpotShadowMap(size_t lightIndex) noexcept;
 
+    // A point light has a shadow map for each face of its cube, all in the same layer.
+    void addPointShadowMap(size_t lightIndex) noexcept;
+
+    // Number of spot and point light shadow maps added since the last reset().
+    size_t getPunctualShadowMapCount() const noexcept { return mSpotShadowMaps.size(); }
+
     // Updates all of the shadow maps and performs culling.
     // Returns true if any of the shadow maps have visible shadows.
     ShadowTechnique update(FEngine& engine, FView& view, UniformBuffer& perViewUb, UniformBuffer& shadowUb,
@@ -81,12 +97,34 @@ public:
         return mCascadeShadowMapCache[c].get();
     }
 
+    // Size in bytes of the shadow texture of the last render().
+    size_t getMemorySize() const noexcept { return mMemorySize; }
+
 private:
+    static constexpr size_t MAX_SHADOW_MAPS =
+            CONFIG_MAX_SHADOW_CASCADES + CONFIG_MAX_SHADOW_MAPS_PUNCTUAL;
+
+    // at worst, each cascade and each spot or point light has its own layer
+    static constexpr size_t MAX_SHADOW_LAYERS =
+            CONFIG_MAX_SHADOW_CASCADES + CONFIG_MAX_SHADOW_CASTING_SPOTS;
+
+
+    // Spot light shadow maps are sized by the light's screen coverage, down to this dimension.
+    static constexpr uint32_t MIN_SPOT_SHADOW_MAP_SIZE = 32;
+
+    // Cascades are sized by the texel density they need, down to this dimension.
+    static constexpr uint32_t MIN_CASCADE_SHADOW_MAP_SIZE = 128;
+
+    // Added to the second moment of the blurred 16-bit VSM shadow maps, about the rounding error
+    // of a half-float below 1.0, so that the variance of flat receivers doesn't become negative.
+    static constexpr float VSM_MOMENT_BIAS_16 = 1.0f / 2048.0f;
 
     struct ShadowLayout {
         uint8_t layer = 0;
         uint32_t size = 0;
         uint8_t vsmSamples = 1;
+        float vsmBlurWidth = 0.0f;
+        math::uint2 offset = {};    // position of the shadow map within the layer, in texels
     };
 
     struct TextureRequirements {
@@ -104,6 +142,12 @@ private:
 
     void calculateTextureRequirements(FEngine& engine, FView& view, FScene::LightSoa& lightData) noexcept;
 
+    // Computes a hash of the shadow casters in 'range' visible in 'mask'. Returns false if a
+    // caster can change without this being detected (e.g. skinning), in which case the shadow
+    // maps using them can't be cached.
+    static bool hashShadowCasters(FScene::RenderableSoa const& renderableData,
+            utils::Range<uint32_t> range, FScene::VisibleMaskType mask, size_t* hash) noexcept;
+
     class ShadowMapEntry {
     public:
         ShadowMapEntry() = default;
@@ -111,6 +155,14 @@ private:
                 mShadowMap(shadowMap),
                 mLightIndex(light),
                 mLayout({}) {}
+        ShadowMapEntry(ShadowMap* shadowMap, const size_t light, uint8_t lightSlot,
+                bool point, uint8_t face) :
+                mShadowMap(shadowMap),
+                mLightIndex(light),
+                mLayout({}),
+                mLightSlot(lightSlot),
+                mPoint(point),
+                mFace(face) {}
 
         explicit operator bool() const { return mShadowMap != nullptr; }
 
@@ -118,17 +170,49 @@ private:
         size_t getLightIndex() const { return mLightIndex; }
         const ShadowLayout& getLayout() const { return mLayout; }
         bool hasVisibleShadows() const { return mHasVisibleShadows; }
+        bool isStatic() const { return mStatic; }
+        // Index of the spot or point light among the shadow casting ones, selects the
+        // VISIBLE_SPOT_SHADOW_RENDERABLE bit of its casters.
+        uint8_t getLightSlot() const { return mLightSlot; }
+        bool isPointLight() const { return mPoint; }
+        uint8_t getFace() const { return mFace; }
 
         void setHasVisibleShadows(bool hasVisibleShadows) { mHasVisibleShadows = hasVisibleShadows; }
         void setLayout(const ShadowLayout& layout) { mLayout = layout; }
+        void setStatic(bool isStatic) { mStatic = isStatic; }
 
     private:
         ShadowMap* mShadowMap = nullptr;
         size_t mLightIndex = 0;
         ShadowLayout mLayout = {};
         bool mHasVisibleShadows = false;
+        bool mStatic = false;
+        uint8_t mLightSlot = 0;
+        bool mPoint = false;
+        uint8_t mFace = 0;
     };
 
+    // What a shadow map was last rendered with. The layer holding it is rendered again only
+    // when this changes for one of the layer's shadow maps.
+    struct CachedShadowMap {
+        math::mat4f lightSpace;
+        backend::PolygonOffset polygonOffset;
+        size_t casters = 0;     // hash of the shadow casters
+        ShadowLayout layout;
+        bool valid = false;
+    };
+
+    // Clears the directional shadow bit of the casters whose shadow volume, i.e. their bounds
+    // extruded along the light direction, doesn't reach a visible receiver, and of the ones
+    // smaller than 'minTexels' texels in their cascade (if not 0).
+    void cullDirectionalShadowCasters(FView const& view, FScene::RenderableSoa& renderableData,
+            math::float3 direction, float minTexels) noexcept;
+
+    // Updates the cached state of shadow map 'index' (cascades first, then spot lights),
+    // returns whether it must be rendered.
+    bool updateCachedShadowMap(size_t index, ShadowMapEntry const& entry, bool vsm,
+            bool cacheable, size_t casters) noexcept;
+
     class CascadeSplits {
     public:
         constexpr static size_t SPLIT_COUNT = CONFIG_MAX_SHADOW_CASCADES + 1;
@@ -179,7 +263,13 @@ private:
     backend::RenderPassParams mRenderPassParams;
 
     std::array<std::unique_ptr<ShadowMap>, CONFIG_MAX_SHADOW_CASCADES> mCascadeShadowMapCache;
-    std::array<std::unique_ptr<ShadowMap>, CONFIG_MAX_SHADOW_CASTING_SPOTS> mSpotShadowMapCache;
+    std::array<std::unique_ptr<ShadowMap>, CONFIG_MAX_SHADOW_MAPS_PUNCTUAL> mSpotShadowMapCache;
+
+    // The shadow texture is kept across frames when lights with the static hint cast shadows.
+    FrameGraphTexture mShadowTexture;
+    FrameGraphTexture::Descriptor mShadowTextureDesc;
+    std::array<CachedShadowMap, MAX_SHADOW_MAPS> mCachedShadowMaps;
+    size_t mMemorySize = 0;
 };
 
 } // namespace filament
@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "TextureStreamer.h"
+
 #include <backend/Handle.h>
 
 #include <filament/Texture.h>
@@ -37,7 +39,9 @@ public:
     // frees driver resources, object becomes invalid
     void terminate(FEngine& engine);
 
-    backend::Handle<backend::HwTexture> getHwHandle() const noexcept { return mHandle; }
+    backend::Handle<backend::HwTexture> getHwHandle() const noexcept {
+        return UTILS_UNLIKELY(mResidency) ? mResidency->current.handle : mHandle;
+    }
 
     size_t getWidth(size_t level = 0) const noexcept;
     size_t getHeight(size_t level = 0) const noexcept;
@@ -64,6 +68,12 @@ public:
             PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
             PrefilterOptions const* options);
 
+    void generatePrefilterMipmap(FEngine& engine, FTexture const* environment,
+            PrefilterOptions const* options);
+
+    void computeIrradianceSH(FEngine& engine, SphericalHarmonicsCallback callback, void* user,
+            PrefilterOptions const* options) const;
+
     void setExternalImage(FEngine& engine, void* image) noexcept;
     void setExternalImage(FEngine& engine, void* image, size_t plane) noexcept;
     void setExternalStream(FEngine& engine, FStream* stream) noexcept;
@@ -79,6 +89,13 @@ public:
 
     FStream const* getStream() const noexcept { return mStream; }
 
+    // streamed textures change their HwTexture when levels are streamed in or evicted
+    bool isStreamed() const noexcept { return mResidency != nullptr; }
+    TextureResidency* getResidency() const noexcept { return mResidency; }
+
+    // estimated GPU memory of the texture in bytes, only the resident levels of streamed textures
+    size_t getMemorySize() const noexcept;
+
     /*
      * Utilities
      */
@@ -86,6 +103,9 @@ public:
     // synchronous call to the backend. returns whether a backend supports a particular format.
     static bool isTextureFormatSupported(FEngine& engine, InternalFormat format) noexcept;
 
+    // synchronous call to the backend. returns whether generateMipmaps() works with a format.
+    static bool isTextureFormatMipmappable(FEngine& engine, InternalFormat format) noexcept;
+
     // storage needed on the CPU side for texture data uploads
     static size_t computeTextureDataSize(Texture::Format format, Texture::Type type,
             size_t stride, size_t height, size_t alignment) noexcept;
@@ -114,6 +134,7 @@ public:
 private:
     friend class Texture;
     FStream* mStream = nullptr;
+    TextureResidency* mResidency = nullptr; // owned by the TextureStreamer
     backend::Handle<backend::HwTexture> mHandle;
     uint32_t mWidth = 1;
     uint32_t mHeight = 1;
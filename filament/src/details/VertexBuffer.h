@@ -45,6 +45,14 @@ public:
 
     size_t getVertexCount() const noexcept;
 
+    uint8_t getBufferCount() const noexcept { return mBufferCount; }
+
+    // size in bytes of the vertex data of all the buffers
+    size_t getMemorySize() const noexcept;
+
+    // the layout of the vertices, as given to the driver
+    backend::AttributeArray const& getAttributes() const noexcept { return mAttributes; }
+
     AttributeBitset getDeclaredAttributes() const noexcept {
         return mDeclaredAttributes;
     }
@@ -53,6 +61,10 @@ public:
     void setBufferAt(FEngine& engine, uint8_t bufferIndex,
             backend::BufferDescriptor&& buffer, uint32_t byteOffset = 0);
 
+    // returns nullptr if bufferIndex out of range
+    void* mapBufferAt(FEngine& engine, uint8_t bufferIndex, uint32_t byteCount,
+            uint32_t byteOffset = 0);
+
 private:
     friend class VertexBuffer;
 
@@ -61,10 +73,11 @@ private:
     };
 
     backend::Handle<backend::HwVertexBuffer> mHandle;
-    std::array<AttributeData, backend::MAX_VERTEX_ATTRIBUTE_COUNT> mAttributes;
+    backend::AttributeArray mAttributes;
     AttributeBitset mDeclaredAttributes;
     uint32_t mVertexCount = 0;
     uint8_t mBufferCount = 0;
+    bool mStreaming = false;
 };
 
 FILAMENT_UPCAST(VertexBuffer)
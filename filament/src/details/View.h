@@ -23,6 +23,8 @@
 
 #include "FrameInfo.h"
 #include "FrameHistory.h"
+#include "OcclusionCuller.h"
+#include "RenderPass.h"
 #include "UniformBuffer.h"
 
 #include "details/Allocators.h"
@@ -38,6 +40,8 @@
 
 #include "private/backend/DriverApi.h"
 
+#include <backend/PixelBufferDescriptor.h>
+
 #include <backend/Handle.h>
 
 #include <utils/compiler.h>
@@ -48,6 +52,8 @@
 
 #include <math/scalar.h>
 
+#include <vector>
+
 namespace utils {
 class JobSystem;
 } // namespace utils;
@@ -78,6 +84,9 @@ class FScene;
 // VISIBLE_SPOT_SHADOW_RENDERABLE_0             X
 // VISIBLE_SPOT_SHADOW_RENDERABLE_1           X
 // ...
+//
+// The VISIBLE_SPOT_SHADOW_RENDERABLE bits are per shadow casting spot or point light, the six
+// faces of a point light share one.
 
 // A "shadow renderable" is a renderable rendered to the shadow map during a shadow pass:
 // PCF shadows: only shadow casters
@@ -113,8 +122,10 @@ public:
 
     void terminate(FEngine& engine);
 
+    // frameId identifies the frame of the Renderer, the Views of a frame share the preparation
+    // of their scene (see FScene::prepare())
     void prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
-            Viewport const& viewport, math::float4 const& userTime) noexcept;
+            Viewport const& viewport, math::float4 const& userTime, uint32_t frameId) noexcept;
 
     void setScene(FScene* scene) { mScene = scene; }
     FScene const* getScene() const noexcept { return mScene; }
@@ -125,6 +136,15 @@ public:
 
     CameraInfo const& getCameraInfo() const noexcept { return mViewingCameraInfo; }
 
+    // stereoscopic rendering, the culling camera is the left eye
+    void setRightEyeCamera(FCamera* camera) noexcept { mRightEyeCamera = camera; }
+    FCamera const* getRightEyeCamera() const noexcept { return mRightEyeCamera; }
+    bool isStereoEnabled() const noexcept { return mRightEyeCamera != nullptr; }
+    CameraInfo const& getRightEyeCameraInfo() const noexcept { return mRightEyeCameraInfo; }
+
+    // the half of the viewport an eye (0 for left, 1 for right) is rendered into
+    static filament::Viewport getEyeViewport(filament::Viewport const& viewport, size_t eye) noexcept;
+
     void setViewport(Viewport const& viewport) noexcept;
     Viewport const& getViewport() const noexcept {
         return mViewport;
@@ -142,6 +162,49 @@ public:
     void setFrontFaceWindingInverted(bool inverted) noexcept { mFrontFaceWindingInverted = inverted; }
     bool isFrontFaceWindingInverted() const noexcept { return mFrontFaceWindingInverted; }
 
+    void setOcclusionCullingEnabled(bool enabled) noexcept;
+    bool isOcclusionCullingEnabled() const noexcept { return mOcclusionCulling; }
+    OcclusionCuller& getOcclusionCuller() noexcept { return mOcclusionCuller; }
+
+    // the passes of the view that keep the order of their commands from a frame to the next
+    enum class SortedPass : uint8_t { STRUCTURE, DEPTH_PREPASS, COLOR };
+    void setTemporalSortingEnabled(bool enabled) noexcept;
+    bool isTemporalSortingEnabled() const noexcept { return mTemporalSorting; }
+    // null when temporal sorting is disabled
+    RenderPass::CommandOrder* getCommandOrder(SortedPass pass) noexcept {
+        return mTemporalSorting ? &mCommandOrders[size_t(pass)] : nullptr;
+    }
+
+    void setOrderIndependentTransparencyEnabled(bool enabled) noexcept {
+        mOrderIndependentTransparency = enabled;
+    }
+    bool isOrderIndependentTransparencyEnabled() const noexcept {
+        return mOrderIndependentTransparency;
+    }
+    // the order-independent transparency pass isn't supported in stereo
+    bool hasOrderIndependentTransparency() const noexcept {
+        return mOrderIndependentTransparency && !isStereoEnabled();
+    }
+
+    // A picking query and the staging buffer its texel is read back into. The queries are
+    // pooled, they go back to the pool once their callback is called.
+    struct PickingQuery {
+        FView* view = nullptr;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        View::PickingQueryResultCallback callback = nullptr;
+        void* user = nullptr;
+        uint32_t texel[4] = {};     // object id, depth bits
+    };
+
+    void pick(uint32_t x, uint32_t y, View::PickingQueryResultCallback callback,
+            void* user) noexcept;
+    bool hasPickingQueries() const noexcept { return !mPickingQueries.empty(); }
+    // takes the queries to render this frame, each one must then be read back into the
+    // descriptor returned by getPickingQueryBuffer()
+    std::vector<PickingQuery*> takePickingQueries() noexcept;
+    static backend::PixelBufferDescriptor getPickingQueryBuffer(PickingQuery* query) noexcept;
+
 
     void setVisibleLayers(uint8_t select, uint8_t values) noexcept;
     uint8_t getVisibleLayers() const noexcept {
@@ -166,6 +229,8 @@ public:
     void prepareSSAO(backend::Handle<backend::HwTexture> ssao) const noexcept;
     void prepareSSR(backend::Handle<backend::HwTexture> ssr, float refractionLodOffset) const noexcept;
     void prepareStructure(backend::Handle<backend::HwTexture> structure) const noexcept;
+    void prepareScreenSpaceReflections(
+            backend::Handle<backend::HwTexture> reflections) const noexcept;
     void prepareShadow(backend::Handle<backend::HwTexture> structure) const noexcept;
     void cleanupRenderPasses() const noexcept;
     void froxelize(FEngine& engine) const noexcept;
@@ -175,6 +240,11 @@ public:
     bool hasDirectionalLight() const noexcept { return mHasDirectionalLight; }
     bool hasDynamicLighting() const noexcept { return mHasDynamicLighting; }
     bool hasShadowing() const noexcept { return mHasShadowing; }
+
+    // size in bytes of the shadow maps of the last frame
+    size_t getShadowMapMemorySize() const noexcept {
+        return mHasShadowing ? mShadowMapManager.getMemorySize() : 0;
+    }
     bool needsShadowMap() const noexcept { return mNeedsShadowMap; }
     bool hasFog() const noexcept { return mFogOptions.enabled && mFogOptions.density > 0.0f; }
     bool hasVsm() const noexcept { return mShadowType == ShadowType::VSM; }
@@ -182,10 +252,17 @@ public:
     void renderShadowMaps(FrameGraph& fg, FEngine& engine, FEngine::DriverApi& driver,
             RenderPass& pass) noexcept;
 
+    // picks the level of detail, or the impostor, of the visible renderables from their size on
+    // screen
     void updatePrimitivesLod(
             FEngine& engine, const CameraInfo& camera,
             FScene::RenderableSoa& renderableData, Range visible) noexcept;
 
+    // reports the size on screen of the visible renderables to the streamed textures they use
+    void updateTextureStreaming(
+            FEngine& engine, const CameraInfo& camera,
+            FScene::RenderableSoa const& renderableData, Range visible) const noexcept;
+
     void setShadowingEnabled(bool enabled) noexcept { mShadowingEnabled = enabled; }
 
     bool isShadowingEnabled() const noexcept { return mShadowingEnabled; }
@@ -194,6 +271,10 @@ public:
 
     bool isScreenSpaceRefractionEnabled() const noexcept { return mScreenSpaceRefractionEnabled; }
 
+    void setDepthPrepassEnabled(bool enabled) noexcept { mDepthPrepassEnabled = enabled; }
+
+    bool isDepthPrepassEnabled() const noexcept { return mDepthPrepassEnabled; }
+
     FCamera const* getDirectionalLightCamera() const noexcept {
         return &mShadowMapManager.getCascadeShadowMap(0)->getDebugCamera();
     }
@@ -232,6 +313,36 @@ public:
         return mTemporalAntiAliasingOptions;
     }
 
+    void setScreenSpaceReflectionsOptions(ScreenSpaceReflectionsOptions options) noexcept {
+        options.thickness = std::max(0.0f, options.thickness);
+        options.bias = std::max(0.0f, options.bias);
+        options.maxDistance = std::max(0.0f, options.maxDistance);
+        mScreenSpaceReflectionsOptions = options;
+    }
+
+    const ScreenSpaceReflectionsOptions& getScreenSpaceReflectionsOptions() const noexcept {
+        return mScreenSpaceReflectionsOptions;
+    }
+
+    // screen-space reflections aren't supported in stereo
+    bool hasScreenSpaceReflections() const noexcept {
+        return mScreenSpaceReflectionsOptions.enabled && !isStereoEnabled();
+    }
+
+    void setAutoExposureOptions(AutoExposureOptions options) noexcept {
+        options.maxCompensation = std::max(options.minCompensation, options.maxCompensation);
+        options.lowPercentile = math::clamp(options.lowPercentile, 0.0f, 1.0f);
+        options.highPercentile = math::clamp(options.highPercentile, options.lowPercentile, 1.0f);
+        options.key = std::max(1e-4f, options.key);
+        options.speedUp = std::max(0.0f, options.speedUp);
+        options.speedDown = std::max(0.0f, options.speedDown);
+        mAutoExposureOptions = options;
+    }
+
+    const AutoExposureOptions& getAutoExposureOptions() const noexcept {
+        return mAutoExposureOptions;
+    }
+
     void setToneMapping(ToneMapping type) noexcept {
         mToneMapping = type;
     }
@@ -294,9 +405,9 @@ public:
         options.radius = math::max(0.0f, options.radius);
         options.bias = math::clamp(options.bias, 0.0f, 0.1f);
         options.power = std::max(0.0f, options.power);
-        // snap to the closer of 0.5 or 1.0
-        options.resolution = std::floor(
-                math::clamp(options.resolution * 2.0f, 1.0f, 2.0f) + 0.5f) * 0.5f;
+        // snap to the closer of 0.25, 0.5 or 1.0
+        options.resolution = std::exp2(std::round(
+                std::log2(math::clamp(options.resolution, 0.25f, 1.0f))));
         options.intensity = std::max(0.0f, options.intensity);
         options.minHorizonAngleRad = math::clamp(options.minHorizonAngleRad, 0.0f, math::f::PI_2);
         options.ssct.lightConeRad = math::clamp(options.ssct.lightConeRad, 0.0f, math::f::PI_2);
@@ -378,6 +489,17 @@ public:
         return mVignetteOptions;
     }
 
+    void setFoveationOptions(FoveationOptions options) noexcept {
+        options.center = min(max(options.center, math::float2{ -1.0f }), math::float2{ 1.0f });
+        options.gain = max(options.gain, math::float2{ 0.0f });
+        options.area = std::max(options.area, 0.0f);
+        mFoveationOptions = options;
+    }
+
+    FoveationOptions getFoveationOptions() const noexcept {
+        return mFoveationOptions;
+    }
+
     void setBlendMode(BlendMode blendMode) noexcept {
         mBlendMode = blendMode;
     }
@@ -407,8 +529,14 @@ public:
         return mRenderTarget == nullptr ? kEmptyHandle : mRenderTarget->getHwHandle();
     }
 
-    static void cullRenderables(utils::JobSystem& js, FScene::RenderableSoa& renderableData,
-            Frustum const& frustum, size_t bit) noexcept;
+    // culls using the scene's CullingHierarchy if there is one
+    static void cullRenderables(utils::JobSystem& js, FScene const& scene,
+            FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept;
+
+    // same as above for 'count' frusta at once, renderables intersecting frusta[i] get bits[i]
+    static void cullRenderables(utils::JobSystem& js, FScene const& scene,
+            FScene::RenderableSoa& renderableData, Frustum const* frusta, size_t const* bits,
+            size_t count) noexcept;
 
     UniformBuffer& getViewUniforms() const { return mPerViewUb; }
     backend::SamplerGroup& getViewSamplers() const { return mPerViewSb; }
@@ -425,13 +553,17 @@ public:
     void commitFrameHistory(FEngine& engine) noexcept;
 
 private:
-    void prepareVisibleRenderables(utils::JobSystem& js,
+    void prepareVisibleRenderables(utils::JobSystem& js, FScene const& scene,
             Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
 
     static void prepareVisibleLights(
             FLightManager const& lcm, utils::JobSystem& js, Frustum const& frustum,
             FScene::LightSoa& lightData) noexcept;
 
+    // a frustum containing the culling frusta of both eyes
+    static Frustum getStereoFrustum(FCamera const& left, FCamera const& right,
+            math::mat4f const& worldOrigin) noexcept;
+
     static void computeVisibilityMasks(
             uint8_t visibleLayers, uint8_t const* layers,
             FRenderableManager::Visibility const* visibility, uint8_t* visibleMask,
@@ -461,12 +593,15 @@ private:
     backend::Handle<backend::HwUniformBuffer> mLightUbh;
     backend::Handle<backend::HwUniformBuffer> mShadowUbh;
     backend::Handle<backend::HwUniformBuffer> mRenderableUbh;
+    FScene const* mRenderableUboScene = nullptr; // scene which last updated mRenderableUbh
 
     FScene* mScene = nullptr;
     FCamera* mCullingCamera = nullptr;
     FCamera* mViewingCamera = nullptr;
 
     CameraInfo mViewingCameraInfo;
+    FCamera* mRightEyeCamera = nullptr;
+    CameraInfo mRightEyeCameraInfo;
     Frustum mCullingFrustum{};
 
     mutable Froxelizer mFroxelizer;
@@ -474,6 +609,14 @@ private:
     Viewport mViewport;
     bool mCulling = true;
     bool mFrontFaceWindingInverted = false;
+    bool mOcclusionCulling = false;
+    OcclusionCuller mOcclusionCuller;
+    bool mTemporalSorting = false;
+    RenderPass::CommandOrder mCommandOrders[3];
+    bool mOrderIndependentTransparency = false;
+    std::vector<PickingQuery*> mPickingQueries;         // waiting for the next frame
+    std::vector<PickingQuery*> mFreePickingQueries;
+    uint32_t mPickingQueriesInFlight = 0;
 
     FRenderTarget* mRenderTarget = nullptr;
 
@@ -484,6 +627,7 @@ private:
     Dithering mDithering = Dithering::TEMPORAL;
     bool mShadowingEnabled = true;
     bool mScreenSpaceRefractionEnabled = true;
+    bool mDepthPrepassEnabled = false;
     bool mHasPostProcessPass = true;
     AmbientOcclusionOptions mAmbientOcclusionOptions{};
     ShadowType mShadowType = ShadowType::PCF;
@@ -492,7 +636,10 @@ private:
     FogOptions mFogOptions;
     DepthOfFieldOptions mDepthOfFieldOptions;
     VignetteOptions mVignetteOptions;
+    FoveationOptions mFoveationOptions;
     TemporalAntiAliasingOptions mTemporalAntiAliasingOptions;
+    ScreenSpaceReflectionsOptions mScreenSpaceReflectionsOptions;
+    AutoExposureOptions mAutoExposureOptions;
     BlendMode mBlendMode = BlendMode::OPAQUE;
     const FColorGrading* mColorGrading = nullptr;
     const FColorGrading* mDefaultColorGrading = nullptr;
@@ -24,6 +24,7 @@
 #include "fg/fg/VirtualResource.h"
 
 #include "details/Engine.h"
+#include "FrameInfo.h"
 
 #include <backend/DriverEnums.h>
 #include <backend/Handle.h>
@@ -31,6 +32,9 @@
 #include <utils/Panic.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+#include <chrono>
+
 using namespace utils;
 
 namespace filament {
@@ -79,6 +83,16 @@ FrameGraphId<FrameGraphTexture> FrameGraph::Builder::sample(FrameGraphId<FrameGr
     return mPass.sample(mFrameGraph, input);
 }
 
+FrameGraphId<FrameGraphTexture> FrameGraph::Builder::sampleAtPixel(
+        FrameGraphId<FrameGraphTexture> input) {
+    return mPass.sampleAtPixel(mFrameGraph, input);
+}
+
+FrameGraph::Builder& FrameGraph::Builder::allowSubpass() noexcept {
+    mPass.allowsSubpass = true;
+    return *this;
+}
+
 FrameGraph::Builder& FrameGraph::Builder::sideEffect() noexcept {
     mPass.hasSideEffect = true;
     return *this;
@@ -325,27 +339,40 @@ FrameGraph& FrameGraph::compile() noexcept {
         node->resource->refs += node->readerCount;
     }
 
+    mergeSubpasses();
+
     /*
      * compute first/last users for active passes
      */
 
+    // Passes are visited in order, except subpasses which are executed by the pass they're merged
+    // into -- which therefore becomes the user of their resources.
+    auto addUser = [](VirtualResource* pResource, PassNode* pass) {
+        // figure out which is the first pass to need this resource
+        if (!pResource->first || pResource->first->id > pass->id) {
+            pResource->first = pass;
+        }
+        // figure out which is the last pass to need this resource
+        if (!pResource->last || pResource->last->id < pass->id) {
+            pResource->last = pass;
+        }
+    };
+
     for (PassNode& pass : passNodes) {
         if (!pass.refCount) {
             continue;
         }
+        PassNode* const user = pass.mergedInto ? pass.mergedInto : &pass;
         for (FrameGraphHandle resource : pass.reads) {
-            VirtualResource* const pResource = resourceNodes[resource.index]->resource;
-            // figure out which is the first pass to need this resource
-            pResource->first = pResource->first ? pResource->first : &pass;
-            // figure out which is the last pass to need this resource
-            pResource->last = &pass;
+            ResourceEntryBase* const pResource = resourceNodes[resource.index]->resource;
+            if (pass.mergedInto && pResource->asRenderTargetResourceEntry()) {
+                // a subpass renders into the target of the pass it's merged into
+                continue;
+            }
+            addUser(pResource, user);
         }
         for (FrameGraphHandle resource : pass.writes) {
-            VirtualResource* const pResource = resourceNodes[resource.index]->resource;
-            // figure out which is the first pass to need this resource
-            pResource->first = pResource->first ? pResource->first : &pass;
-            // figure out which is the last pass to need this resource
-            pResource->last = &pass;
+            addUser(resourceNodes[resource.index]->resource, user);
         }
     }
 
@@ -356,6 +383,12 @@ FrameGraph& FrameGraph::compile() noexcept {
                 auto& texture = getResourceEntryUnchecked(handle);
                 texture.descriptor.usage |= backend::TextureUsage::SAMPLEABLE;
             }
+            if (!pass.mergedInto) {
+                for (auto handle : pass.pixelSamples) {
+                    auto& texture = getResourceEntryUnchecked(handle);
+                    texture.descriptor.usage |= backend::TextureUsage::SAMPLEABLE;
+                }
+            }
         }
     }
 
@@ -381,9 +414,107 @@ FrameGraph& FrameGraph::compile() noexcept {
         }
     }
 
+    // Memory needed by the resources we create, if those whose lifetimes don't overlap share it.
+    // In practice, the ResourceAllocator hands a destroyed texture to the next one of the same
+    // shape, even within a frame.
+    size_t live = 0;
+    mTransientMemory = {};
+    mStats = { .passCount = uint32_t(passNodes.size()) };
+    for (PassNode const& pass : passNodes) {
+        if (!pass.refCount) {
+            mStats.culledPassCount++;
+            continue;
+        }
+        mStats.subpassCount += pass.mergedInto ? 1 : 0;
+        for (VirtualResource const* resource : pass.devirtualize) {
+            live += resource->getMemorySize();
+            mTransientMemory.total += resource->getMemorySize();
+        }
+        mTransientMemory.peak = std::max(mTransientMemory.peak, live);
+        for (VirtualResource const* resource : pass.destroy) {
+            live -= resource->getMemorySize();
+        }
+    }
+
     return *this;
 }
 
+void FrameGraph::mergeSubpasses() noexcept {
+    Vector<ResourceNode*>& resourceNodes = mResourceNodes;
+
+    auto getTarget = [this](FrameGraphId<FrameGraphRenderTarget> handle) {
+        return getResourceEntryBaseUnchecked(handle).asRenderTargetResourceEntry();
+    };
+
+    // Merge a pass sampling its input only at the shaded pixel into the pass writing that input,
+    // as a second subpass. The drivers support a single input attachment, which must be COLOR0,
+    // and the subpass writes into COLOR1, which becomes an attachment of the merged render pass.
+    for (PassNode& pass : mPassNodes) {
+        if (!pass.refCount || pass.pixelSamples.size() != 1 || pass.writes.size() != 1 ||
+                pass.renderTargets.size() != 1) {
+            continue;
+        }
+
+        // the input must only be needed by this pass
+        ResourceNode const& input = *resourceNodes[pass.pixelSamples[0].index];
+        PassNode* const host = input.writer;
+        if (!host || !host->allowsSubpass || host->subpass || host->mergedInto ||
+                host->renderTargets.size() != 1 ||
+                input.readerCount != 1 || input.resource->imported) {
+            continue;
+        }
+
+        RenderTargetResourceEntry* const hostTarget = getTarget(host->renderTargets[0]);
+        RenderTargetResourceEntry* const target = getTarget(pass.renderTargets[0]);
+        if (!hostTarget || !target || hostTarget->imported || target->imported ||
+                hostTarget->descriptor.samples > 1 || target->descriptor.samples > 1) {
+            continue;
+        }
+
+        auto& hostAttachments = hostTarget->descriptor.attachments.textures;
+        auto const& attachments = target->descriptor.attachments.textures;
+        const bool attachmentsMatch =
+                hostAttachments[0].isValid() && !hostAttachments[1].isValid() &&
+                !hostAttachments[0].getLevel() && !attachments[0].getLevel() &&
+                resourceNodes[hostAttachments[0].getHandle().index]->resource == input.resource &&
+                std::none_of(attachments.begin() + 1, attachments.end(),
+                        [](auto const& attachment) { return attachment.isValid(); });
+        if (!attachmentsMatch) {
+            continue;
+        }
+
+        // we only render into our output, which we're the first to write
+        ResourceNode const& output = *resourceNodes[pass.writes[0].index];
+        if (!attachments[0].isValid() || output.resource->imported || output.version != 1 ||
+                resourceNodes[attachments[0].getHandle().index]->resource != output.resource) {
+            continue;
+        }
+
+        auto const& inputDesc = getResourceEntryUnchecked(pass.pixelSamples[0]).descriptor;
+        auto const& outputDesc = getResourceEntryUnchecked(attachments[0].getHandle()).descriptor;
+        if (inputDesc.width != outputDesc.width || inputDesc.height != outputDesc.height) {
+            continue;
+        }
+
+        // we're executed right after the host, so our inputs must be ready by then
+        const bool inputsReady = std::all_of(pass.reads.begin(), pass.reads.end(),
+                [host, &resourceNodes](FrameGraphHandle handle) {
+                    PassNode const* const writer = resourceNodes[handle.index]->writer;
+                    return !writer || writer->id <= host->id;
+                });
+        if (!inputsReady) {
+            continue;
+        }
+
+        getResourceEntryUnchecked(pass.pixelSamples[0]).descriptor.usage |=
+                TextureUsage::SUBPASS_INPUT;
+        hostAttachments[1] = attachments[0];
+        hostTarget->getResource().params.subpassMask = 1;
+        host->subpass = &pass;
+        pass.mergedInto = host;
+    }
+}
+
 void FrameGraph::executeInternal(PassNode const& node, DriverApi& driver) noexcept {
     assert(node.base);
     // create concrete resources and rendertargets
@@ -402,9 +533,19 @@ void FrameGraph::executeInternal(PassNode const& node, DriverApi& driver) noexce
         static_cast<RenderTargetResourceEntry&>(entry).update(*this, node);
     }
 
-    // execute the pass
-    FrameGraphPassResources resources(*this, node);
-    node.base->execute(resources, driver);
+    // execute the pass, followed by the pass merged into it as its subpass, if any
+    for (PassNode const* pass = &node; pass; pass = pass->subpass) {
+        FrameGraphPassResources resources(*this, *pass);
+        const auto start = std::chrono::steady_clock::now();
+        pass->base->execute(resources, driver);
+        const std::chrono::duration<float, std::milli> time =
+                std::chrono::steady_clock::now() - start;
+        mStats.executeTime += time.count();
+        if (time.count() > mStats.slowestPassTime) {
+            mStats.slowestPassTime = time.count();
+            mStats.slowestPass = pass->name;
+        }
+    }
 
     for (VirtualResource* resource : node.devirtualize) {
         resource->postExecuteDevirtualize(*this);
@@ -423,16 +564,24 @@ void FrameGraph::reset() noexcept {
     mResourceNodes.clear();
     mResourceNodeEntries.clear();
     mResourceEntries.clear();
+    mTransientMemory = {};
     mId = 0;
 }
 
-void FrameGraph::execute(FEngine& engine, DriverApi& driver) noexcept {
+void FrameGraph::execute(FEngine& engine, DriverApi& driver, PassTimer* passTimer) noexcept {
     auto const& passNodes = mPassNodes;
     driver.pushGroupMarker("FrameGraph");
     for (PassNode const& node : passNodes) {
-        if (node.refCount) {
+        // subpasses are executed by the pass they're merged into
+        if (node.refCount && !node.mergedInto) {
             driver.pushGroupMarker(node.name);
+            if (UTILS_UNLIKELY(passTimer)) {
+                passTimer->beginPass(node.name);
+            }
             executeInternal(node, driver);
+            if (UTILS_UNLIKELY(passTimer)) {
+                passTimer->endPass();
+            }
             driver.popGroupMarker();
         }
     }
@@ -444,7 +593,7 @@ void FrameGraph::execute(FEngine& engine, DriverApi& driver) noexcept {
 
 void FrameGraph::execute(DriverApi& driver) noexcept {
     for (PassNode const& node : mPassNodes) {
-        if (node.refCount) {
+        if (node.refCount && !node.mergedInto) {
             executeInternal(node, driver);
         }
     }
@@ -459,7 +608,10 @@ void FrameGraph::export_graphviz(utils::io::ostream& out, const char* viewName)
     out << "digraph \"" << label << "\" {\n";
     out << "rankdir = LR\n";
     out << "bgcolor = black\n";
-    out << "node [shape=rectangle, fontname=\"helvetica\", fontsize=10]\n\n";
+    out << "node [shape=rectangle, fontname=\"helvetica\", fontsize=10]\n";
+    out << "fontname = \"helvetica\"\nfontcolor = white\n";
+    out << "label = \"peak transient memory: " << mTransientMemory.peak / float(1u << 20u)
+        << " MiB (" << mTransientMemory.total / float(1u << 20u) << " MiB without reuse)\"\n\n";
 
     auto const& registry = mResourceNodes;
     auto const& frameGraphPasses = mPassNodes;
@@ -469,6 +621,7 @@ void FrameGraph::export_graphviz(utils::io::ostream& out, const char* viewName)
         out << "\"P" << node.id << "\" [label=\"" << node.name
                << "\\nrefs: " << node.refCount
                << "\\nseq: " << node.id
+               << (node.mergedInto ? "\\nsubpass" : "")
                << "\", style=filled, fillcolor="
                << (node.refCount ? "darkorange" : "darkorange4") << "]\n";
     }
@@ -47,6 +47,7 @@
 namespace filament {
 
 class FEngine;
+class PassTimer;
 class ResourceAllocatorInterface;
 
 namespace fg {
@@ -113,6 +114,15 @@ public:
         // Sample from a texture resource (implies read())
         FrameGraphId<FrameGraphTexture> sample(FrameGraphId<FrameGraphTexture> input);
 
+        // Sample from a texture resource only at the pixel being shaded (implies read()).
+        // When possible, this pass is merged into the pass writing 'input' and executed as its
+        // subpass, reading 'input' as an input attachment (see FrameGraphPassResources::isSubpass).
+        FrameGraphId<FrameGraphTexture> sampleAtPixel(FrameGraphId<FrameGraphTexture> input);
+
+        // Declare that a pass reading our color attachment with sampleAtPixel() can be merged
+        // into this one (see FrameGraphPassResources::hasSubpass)
+        Builder& allowSubpass() noexcept;
+
         // Declare that this pass has side effects outside the framegraph (i.e. it can't be culled)
         // Calling write() on an imported resource automatically adds a side-effect.
         Builder& sideEffect() noexcept;
@@ -239,8 +249,10 @@ public:
     // allocates concrete resources and culls unreferenced passes
     FrameGraph& compile() noexcept;
 
-    // execute all referenced passes and flush the command queue after each pass
-    void execute(FEngine& engine, backend::DriverApi& driver) noexcept;
+    // execute all referenced passes and flush the command queue after each pass, each pass
+    // is timed on the GPU if a PassTimer is given
+    void execute(FEngine& engine, backend::DriverApi& driver,
+            PassTimer* passTimer = nullptr) noexcept;
 
 
     /*
@@ -254,6 +266,25 @@ public:
     // print the frame graph as a graphviz file in the log
     void export_graphviz(utils::io::ostream& out, const char* viewName);
 
+    // estimated memory of the resources created by the frame graph, computed by compile()
+    struct TransientMemory {
+        size_t peak = 0;    // largest amount alive at the same time
+        size_t total = 0;   // sum of all resources
+    };
+    TransientMemory getTransientMemory() const noexcept { return mTransientMemory; }
+
+    // passes culled by compile() and CPU time spent in the execute() of the other passes
+    struct Stats {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        uint32_t subpassCount = 0;          // passes merged into another one
+        float executeTime = 0.0f;           // in ms
+        float slowestPassTime = 0.0f;       // in ms
+        const char* slowestPass = nullptr;
+    };
+    // valid after execute(), until the next compile()
+    Stats const& getStats() const noexcept { return mStats; }
+
 private:
     friend class FrameGraphPassResources;
     friend struct FrameGraphTexture;
@@ -278,6 +309,8 @@ private:
 
     FrameGraphHandle createResourceNode(fg::ResourceEntryBase* resource) noexcept;
 
+    void mergeSubpasses() noexcept;
+
     void executeInternal(fg::PassNode const& node, backend::DriverApi& driver) noexcept;
 
     ResourceAllocatorInterface& getResourceAllocator() noexcept { return mResourceAllocator; }
@@ -326,6 +359,8 @@ private:
     Vector<fg::ResourceNode *> mResourceNodes;          // list of resource nodes
     Vector<UniquePtr<fg::ResourceNode>> mResourceNodeEntries;
     Vector<UniquePtr<fg::ResourceEntryBase>> mResourceEntries;
+    TransientMemory mTransientMemory;
+    Stats mStats;
     uint16_t mId = 0;
 };
 
@@ -40,6 +40,14 @@ const char* FrameGraphPassResources::getPassName() const noexcept {
     return mPass.name;
 }
 
+bool FrameGraphPassResources::hasSubpass() const noexcept {
+    return mPass.subpass != nullptr;
+}
+
+bool FrameGraphPassResources::isSubpass() const noexcept {
+    return mPass.mergedInto != nullptr;
+}
+
 fg::ResourceEntryBase const& FrameGraphPassResources::getResourceEntryBase(FrameGraphHandle r) const noexcept {
     ResourceNode& node = mFrameGraph.getResourceNodeUnchecked(r);
 
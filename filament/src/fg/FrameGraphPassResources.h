@@ -43,6 +43,15 @@ public:
     // Return the name of the pass being executed
     const char* getPassName() const noexcept;
 
+    // Whether a pass was merged into this one as its subpass, in which case this pass must leave
+    // its render pass open -- the subpass executes right after and ends it.
+    bool hasSubpass() const noexcept;
+
+    // Whether this pass is executed as the subpass of the pass writing its sampleAtPixel() input.
+    // It must then call nextSubpass() instead of beginRenderPass(), read that input as a subpass
+    // input instead of sampling it, and end the render pass.
+    bool isSubpass() const noexcept;
+
     // get the resource for this handle
     template<typename T>
     T const& get(FrameGraphId<T> handle) const noexcept {
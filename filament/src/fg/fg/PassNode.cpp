@@ -27,6 +27,7 @@ PassNode::PassNode(FrameGraph& fg, const char* name, uint32_t id,
           reads(fg.getArena()),
           writes(fg.getArena()),
           samples(fg.getArena()),
+          pixelSamples(fg.getArena()),
           renderTargets(fg.getArena()),
           devirtualize(fg.getArena()),
           destroy(fg.getArena()) {
@@ -63,6 +64,20 @@ FrameGraphId<FrameGraphTexture> PassNode::sample(FrameGraph& fg,
     return handle;
 }
 
+FrameGraphId<FrameGraphTexture> PassNode::sampleAtPixel(FrameGraph& fg,
+        FrameGraphId<FrameGraphTexture> handle) {
+    // sampleAtPixel() implies a read
+    read(fg, handle);
+
+    // whether it's actually sampled is decided in compile(), when merging subpasses
+    auto pos = std::find_if(pixelSamples.begin(), pixelSamples.end(),
+            [&handle](FrameGraphHandle cur) { return handle.index == cur.index; });
+    if (pos == pixelSamples.end()) {
+        pixelSamples.push_back(handle);
+    }
+    return handle;
+}
+
 FrameGraphId<FrameGraphRenderTarget> PassNode::use(FrameGraph& fg,
         FrameGraphId<FrameGraphRenderTarget> handle) {
     // use() implies a read
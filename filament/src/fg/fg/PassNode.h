@@ -44,6 +44,8 @@ struct PassNode {
     // for Builder
     FrameGraphHandle read(FrameGraph& fg, FrameGraphHandle handle);
     FrameGraphId<FrameGraphTexture> sample(FrameGraph& fg, FrameGraphId<FrameGraphTexture> handle);
+    FrameGraphId<FrameGraphTexture> sampleAtPixel(FrameGraph& fg,
+            FrameGraphId<FrameGraphTexture> handle);
     FrameGraphId<FrameGraphRenderTarget> use(FrameGraph& fg, FrameGraphId<FrameGraphRenderTarget> handle);
     FrameGraphHandle write(FrameGraph& fg, const FrameGraphHandle& handle);
 
@@ -56,15 +58,19 @@ struct PassNode {
     Vector<FrameGraphHandle> reads;                     // resources we're reading from
     Vector<FrameGraphHandle> writes;                    // resources we're writing to
     Vector<FrameGraphId<FrameGraphTexture>> samples;    // resources we're sampling from
+    Vector<FrameGraphId<FrameGraphTexture>> pixelSamples; // same, only at the shaded pixel
     Vector<FrameGraphId<FrameGraphRenderTarget>> renderTargets;
 
     // computed during compile()
     Vector<VirtualResource*> devirtualize;         // resources we need to create before executing
     Vector<VirtualResource*> destroy;              // resources we need to destroy after executing
     uint32_t refCount = 0;                  // count resources that have a reference to us
+    PassNode* subpass = nullptr;            // pass merged into us, executed as our subpass
+    PassNode* mergedInto = nullptr;         // pass we're executed as a subpass of
 
     // set by the builder
     bool hasSideEffect = false;             // whether this pass has side effects
+    bool allowsSubpass = false;             // whether a subpass can be merged into this pass
 };
 
 } // namespace fg
@@ -79,6 +79,15 @@ void RenderTargetResourceEntry::resolve(FrameGraph& fg) noexcept {
             // update usage flags for referenced attachments
             entry.descriptor.usage |= usages[i];
 
+            // transient attachments can't outlive the pass that creates them (but can be read
+            // by its subpass)
+            if (any(entry.descriptor.usage & TextureUsage::TRANSIENT_ATTACHMENT) &&
+                    (entry.imported || entry.first != entry.last ||
+                     any(entry.descriptor.usage &
+                             (TextureUsage::SAMPLEABLE | TextureUsage::UPLOADABLE)))) {
+                entry.descriptor.usage &= ~TextureUsage::TRANSIENT_ATTACHMENT;
+            }
+
             // update attachment sample count if not specified and usage permits it
             if (!entry.descriptor.samples &&
                 none(entry.descriptor.usage & backend::TextureUsage::SAMPLEABLE)) {
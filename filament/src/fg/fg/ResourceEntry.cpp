@@ -18,6 +18,8 @@
 
 #include <fg/FrameGraph.h>
 
+#include "details/Texture.h"
+
 namespace filament {
 namespace fg {
 
@@ -33,5 +35,22 @@ ResourceAllocatorInterface& ResourceEntryBase::getResourceAllocator(FrameGraph&
 
 ResourceEntryBase::~ResourceEntryBase() = default;
 
+size_t getMemorySize(FrameGraphTexture::Descriptor const& desc) noexcept {
+    if (none(desc.usage)) {
+        // the texture is never created
+        return 0;
+    }
+    size_t size = size_t(desc.width) * desc.height * desc.depth *
+            FTexture::getFormatSize(desc.format);
+    if (desc.samples > 1) {
+        size *= desc.samples;
+    }
+    if (desc.levels > 1 && any(desc.usage & backend::TextureUsage::SAMPLEABLE)) {
+        // assume the full pyramid
+        size += size / 3;
+    }
+    return size;
+}
+
 } // namespace fg
 } // namespace filament
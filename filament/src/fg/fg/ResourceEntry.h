@@ -19,6 +19,8 @@
 
 #include "fg/fg/VirtualResource.h"
 
+#include "fg/FrameGraphHandle.h"
+
 #include <stdint.h>
 
 namespace filament {
@@ -31,6 +33,11 @@ namespace fg {
 struct PassNode;
 class RenderTargetResourceEntry;
 
+// estimated memory size of a resource created from the given descriptor
+template<typename D>
+size_t getMemorySize(D const&) noexcept { return 0; }
+size_t getMemorySize(FrameGraphTexture::Descriptor const& desc) noexcept;
+
 class ResourceEntryBase : public VirtualResource {
 public:
     explicit ResourceEntryBase(const char* name, uint16_t id, bool imported, uint8_t priority) noexcept;
@@ -92,6 +99,10 @@ public:
 
     void resolve(FrameGraph& fg) noexcept override { }
 
+    size_t getMemorySize() const noexcept override {
+        return imported ? 0 : fg::getMemorySize(descriptor);
+    }
+
     void preExecuteDevirtualize(FrameGraph& fg) noexcept override {
         if (!imported) {
             resource.create(getResourceAllocator(fg), name, descriptor);
@@ -17,6 +17,8 @@
 #ifndef TNT_FILAMENT_VIRTUALRESOURCE_H
 #define TNT_FILAMENT_VIRTUALRESOURCE_H
 
+#include <stddef.h>
+
 namespace filament {
 
 class FrameGraph;
@@ -33,6 +35,8 @@ struct VirtualResource {
     virtual void preExecuteDestroy(FrameGraph& fg) noexcept = 0;
     virtual void postExecuteDestroy(FrameGraph& fg) noexcept = 0;
     virtual void postExecuteDevirtualize(FrameGraph& fg) noexcept = 0;
+    // estimated memory used by the concrete resource, 0 if it's unknown or not ours
+    virtual size_t getMemorySize() const noexcept { return 0; }
     virtual ~VirtualResource();
 
     // computed during compile()
@@ -0,0 +1,9 @@
+void material(inout MaterialInputs material) {
+    prepareMaterial(material);
+
+    // The frames are cleared to transparent black, so the lower mipmap levels darken the edges
+    // as much as they lower the coverage: un-premultiplying restores the colors.
+    vec4 color = texture(materialParams_atlas,
+            vec3(variable_impostor.xy, floor(variable_impostor.z + 0.5)));
+    material.baseColor = vec4(color.rgb / max(color.a, 1.0 / 255.0), color.a);
+}
@@ -0,0 +1,52 @@
+// Vertex shader of the impostor materials, which draw a quad in place of a renderable. The quad
+// shows the frame of the atlas captured from the direction of the grid closest to the camera's.
+// IMPOSTOR_INSTANCED applies the per-instance transforms of the renderable, which exclude
+// skinning and morphing.
+
+// Octahedral mapping of the unit sphere to [-1, 1]^2, +y at the center, -y at the corners. It
+// must match the one used by FImpostor to capture the frames.
+highp vec2 octahedralEncode(highp vec3 d) {
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    highp vec2 p = d.xz;
+    if (d.y < 0.0) {
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return p;
+}
+
+highp vec3 octahedralDecode(highp vec2 p) {
+    highp vec3 d = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (d.y < 0.0) {
+        d.xz = (1.0 - abs(d.zx)) * vec2(d.x >= 0.0 ? 1.0 : -1.0, d.z >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(d);
+}
+
+void materialVertex(inout MaterialVertexInputs material) {
+    highp mat4 worldFromObject = getWorldFromModelMatrix();
+#if defined(IMPOSTOR_INSTANCED) && !defined(HAS_SKINNING_OR_MORPHING)
+    worldFromObject = worldFromObject * getInstanceTransform();
+#endif
+    highp vec3 center = materialParams.center;
+
+    // the direction the object is seen from, in its own space (assumes no non-uniform scaling)
+    highp vec3 eye = getWorldCameraPosition() - mulMat4x4Float3(worldFromObject, center).xyz;
+    highp vec3 direction = normalize(transpose(mat3(worldFromObject)) * eye);
+
+    // the closest direction of the grid, i.e. the frame to show
+    float last = float(materialParams.frames - 1);
+    highp vec2 cell = floor((octahedralEncode(direction) * 0.5 + 0.5) * last + 0.5);
+    highp vec3 d = octahedralDecode(cell / last * 2.0 - 1.0);
+
+    // the quad is where the frame's orthographic capture was, through the center
+    highp vec3 up = abs(d.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    highp vec3 right = normalize(cross(up, d));
+    up = cross(d, right);
+    highp vec2 corner = getPosition().xy;
+    highp vec3 position = center + (right * corner.x + up * corner.y) * materialParams.radius;
+    material.worldPosition = mulMat4x4Float3(worldFromObject, position);
+
+    // uv and layer in the atlas
+    float layer = cell.y * float(materialParams.frames) + cell.x;
+    material.impostor = vec4(corner * 0.5 + 0.5, layer, 0.0);
+}
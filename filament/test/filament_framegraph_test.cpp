@@ -77,6 +77,43 @@ private:
 int GenericResource::state = 0;
 
 
+TEST_F(FrameGraphTest, ResourceAllocatorCache) {
+    // the cache can hold 3 KiB of textures
+    ResourceAllocator resourceAllocator(driverApi, 3 * 1024);
+
+    auto create = [&](uint32_t width, uint32_t height) {
+        return resourceAllocator.createTexture("texture", SamplerType::SAMPLER_2D, 1,
+                TextureFormat::RGBA8, 1, width, height, 1,
+                TextureUsage::COLOR_ATTACHMENT | TextureUsage::SAMPLEABLE);
+    };
+
+    auto small = create(16, 16);    // 1 KiB
+    auto large = create(32, 16);    // 2 KiB
+    resourceAllocator.destroyTexture(small);
+    resourceAllocator.destroyTexture(large);
+    EXPECT_EQ(3u * 1024, resourceAllocator.getStats().cacheSize);
+
+    // the least recently used texture goes first
+    resourceAllocator.gc();
+    EXPECT_EQ(2u * 1024, resourceAllocator.getStats().cacheSize);
+    EXPECT_EQ(1u, resourceAllocator.getStats().evictions);
+
+    // both textures were in use at the same time before gc()
+    EXPECT_EQ(3u * 1024, resourceAllocator.getStats().inUsePeak);
+
+    auto reused = create(32, 16);
+    EXPECT_EQ(large, reused);
+    EXPECT_EQ(1u, resourceAllocator.getStats().hits);
+    EXPECT_EQ(2u, resourceAllocator.getStats().misses);
+    EXPECT_EQ(2u * 1024, resourceAllocator.getStats().inUseSize);
+
+    resourceAllocator.destroyTexture(reused);
+    resourceAllocator.gc();
+    EXPECT_EQ(2u * 1024, resourceAllocator.getStats().inUsePeak);
+
+    resourceAllocator.terminate();
+}
+
 TEST_F(FrameGraphTest, SimpleRenderPass) {
 
     ResourceAllocator resourceAllocator(driverApi);
@@ -255,6 +292,236 @@ TEST_F(FrameGraphTest, ScenarioDepthPrePass) {
     resourceAllocator.terminate();
 }
 
+TEST_F(FrameGraphTest, TransientAttachments) {
+
+    ResourceAllocator resourceAllocator(driverApi);
+    FrameGraph fg(resourceAllocator);
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> color;
+        FrameGraphId<FrameGraphTexture> depth;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // the depth of the first pass is kept for the second pass, so it can't be transient
+    auto& firstPass = fg.addPass<PassData>("first pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.depth = builder.createTexture("kept depth", {
+                        .format = TextureFormat::DEPTH24,
+                        .usage = TextureUsage::TRANSIENT_ATTACHMENT });
+                data.depth = builder.write(builder.read(data.depth));
+                data.rt = builder.createRenderTarget("rt first", {
+                        .attachments = {{}, data.depth } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                EXPECT_FALSE(any(resources.getDescriptor(data.depth).usage &
+                        TextureUsage::TRANSIENT_ATTACHMENT));
+            });
+
+    auto& secondPass = fg.addPass<PassData>("second pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.color = builder.createTexture("color", { .format = TextureFormat::RGBA16F });
+                data.color = builder.write(builder.read(data.color));
+                data.depth = builder.write(builder.read(firstPass.getData().depth));
+                data.rt = builder.createRenderTarget("rt second", {
+                        .attachments = { data.color, data.depth } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+            });
+
+    // this depth only lives within the pass, the hint is kept
+    auto& thirdPass = fg.addPass<PassData>("third pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.depth = builder.createTexture("transient depth", {
+                        .format = TextureFormat::DEPTH24,
+                        .usage = TextureUsage::TRANSIENT_ATTACHMENT });
+                data.depth = builder.write(builder.read(data.depth));
+                data.color = builder.write(builder.read(secondPass.getData().color));
+                data.rt = builder.createRenderTarget("rt third", {
+                        .attachments = { data.color, data.depth } });
+            },
+            [=](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                auto const& usage = resources.getDescriptor(data.depth).usage;
+                EXPECT_TRUE(any(usage & TextureUsage::TRANSIENT_ATTACHMENT));
+                EXPECT_TRUE(any(usage & TextureUsage::DEPTH_ATTACHMENT));
+                EXPECT_EQ(TargetBufferFlags::DEPTH,
+                        resources.get(data.rt).params.flags.discardEnd & TargetBufferFlags::DEPTH);
+            });
+
+    fg.present(thirdPass.getData().color);
+    fg.compile();
+    fg.execute(driverApi);
+
+    resourceAllocator.terminate();
+}
+
+TEST_F(FrameGraphTest, SubpassMerging) {
+
+    ResourceAllocator resourceAllocator(driverApi);
+    FrameGraph fg(resourceAllocator);
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> input;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    std::vector<std::string> order;
+
+    auto& colorPass = fg.addPass<PassData>("color pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.output = builder.createTexture("color", {
+                        .format = TextureFormat::RGBA16F,
+                        .usage = TextureUsage::TRANSIENT_ATTACHMENT });
+                data.output = builder.write(data.output);
+                data.rt = builder.createRenderTarget("rt color", {
+                        .attachments = { data.output } });
+                builder.allowSubpass();
+            },
+            [&](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                order.emplace_back("color");
+                EXPECT_TRUE(resources.hasSubpass());
+                EXPECT_FALSE(resources.isSubpass());
+                EXPECT_EQ(1u, resources.get(data.rt).params.subpassMask);
+            });
+
+    // executed after the subpass, which doesn't depend on it
+    fg.addTrivialSideEffectPass("unrelated pass", [&](DriverApi&) {
+        order.emplace_back("unrelated");
+    });
+
+    auto& tonemapPass = fg.addPass<PassData>("tonemap pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.input = builder.sampleAtPixel(colorPass.getData().output);
+                data.output = builder.createTexture("ldr", { .format = TextureFormat::RGBA8 });
+                data.output = builder.write(data.output);
+                data.rt = builder.createRenderTarget("rt tonemap", {
+                        .attachments = { data.output } });
+            },
+            [&](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                order.emplace_back("tonemap");
+                EXPECT_TRUE(resources.isSubpass());
+                auto const& usage = resources.getDescriptor(data.input).usage;
+                EXPECT_TRUE(any(usage & TextureUsage::SUBPASS_INPUT));
+                EXPECT_FALSE(any(usage & TextureUsage::SAMPLEABLE));
+                EXPECT_TRUE(any(usage & TextureUsage::TRANSIENT_ATTACHMENT));
+            });
+
+    fg.present(tonemapPass.getData().output);
+    fg.compile();
+    fg.execute(driverApi);
+
+    EXPECT_EQ(1u, fg.getStats().subpassCount);
+    EXPECT_EQ((std::vector<std::string>{ "color", "tonemap", "unrelated" }), order);
+
+    resourceAllocator.terminate();
+}
+
+TEST_F(FrameGraphTest, SubpassMergingWithOtherReader) {
+
+    ResourceAllocator resourceAllocator(driverApi);
+    FrameGraph fg(resourceAllocator);
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> input;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    auto& colorPass = fg.addPass<PassData>("color pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.output = builder.createTexture("color", { .format = TextureFormat::RGBA16F });
+                data.output = builder.write(data.output);
+                data.rt = builder.createRenderTarget("rt color", {
+                        .attachments = { data.output } });
+                builder.allowSubpass();
+            },
+            [&](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                EXPECT_FALSE(resources.hasSubpass());
+            });
+
+    // the color buffer also needs to be sampled by another pass, so it must be stored
+    auto& bloomPass = fg.addPass<PassData>("bloom pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.input = builder.sample(colorPass.getData().output);
+                data.output = builder.createTexture("bloom", { .format = TextureFormat::RGBA16F });
+                data.output = builder.write(data.output);
+                data.rt = builder.createRenderTarget("rt bloom", {
+                        .attachments = { data.output } });
+            },
+            [&](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+            });
+
+    auto& tonemapPass = fg.addPass<PassData>("tonemap pass",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.input = builder.sampleAtPixel(colorPass.getData().output);
+                builder.sample(bloomPass.getData().output);
+                data.output = builder.createTexture("ldr", { .format = TextureFormat::RGBA8 });
+                data.output = builder.write(data.output);
+                data.rt = builder.createRenderTarget("rt tonemap", {
+                        .attachments = { data.output } });
+            },
+            [&](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                EXPECT_FALSE(resources.isSubpass());
+                auto const& usage = resources.getDescriptor(data.input).usage;
+                EXPECT_FALSE(any(usage & TextureUsage::SUBPASS_INPUT));
+                EXPECT_TRUE(any(usage & TextureUsage::SAMPLEABLE));
+            });
+
+    fg.present(tonemapPass.getData().output);
+    fg.compile();
+    fg.execute(driverApi);
+
+    EXPECT_EQ(0u, fg.getStats().subpassCount);
+
+    resourceAllocator.terminate();
+}
+
+TEST_F(FrameGraphTest, TransientMemory) {
+
+    ResourceAllocator resourceAllocator(driverApi);
+    FrameGraph fg(resourceAllocator);
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> input;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // each pass samples the output of the previous one and renders into a 16x16 RGBA8 texture
+    auto addPass = [&fg](const char* name, FrameGraphId<FrameGraphTexture> input) {
+        return fg.addPass<PassData>(name,
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    if (input.isValid()) {
+                        data.input = builder.sample(input);
+                    }
+                    data.output = builder.createTexture(name,
+                            { .width = 16, .height = 16, .format = TextureFormat::RGBA8 });
+                    data.output = builder.write(data.output);
+                    data.rt = builder.createRenderTarget(name, {
+                            .attachments = { data.output } });
+                },
+                [=](FrameGraphPassResources const& resources, auto const& data,
+                        DriverApi& driver) {
+                }).getData().output;
+    };
+
+    auto output = addPass("pass 0", {});
+    output = addPass("pass 1", output);
+    output = addPass("pass 2", output);
+
+    fg.present(output);
+    fg.compile();
+
+    // no more than two of the textures are ever alive at the same time
+    EXPECT_EQ(3u * 16 * 16 * 4, fg.getTransientMemory().total);
+    EXPECT_EQ(2u * 16 * 16 * 4, fg.getTransientMemory().peak);
+
+    fg.execute(driverApi);
+
+    resourceAllocator.terminate();
+}
+
 TEST_F(FrameGraphTest, SimplePassCulling) {
 
     ResourceAllocator resourceAllocator(driverApi);
@@ -355,6 +622,7 @@ TEST_F(FrameGraphTest, SimplePassCulling) {
     EXPECT_TRUE(renderPassExecuted);
     EXPECT_TRUE(postProcessPassExecuted);
     EXPECT_FALSE(culledPassExecuted);
+    EXPECT_EQ(1u, fg.getStats().culledPassCount);
 
     resourceAllocator.terminate();
 }
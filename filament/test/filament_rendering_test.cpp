@@ -20,6 +20,7 @@
 #include <filament/Renderer.h>
 #include <filament/Skybox.h>
 #include <filament/Scene.h>
+#include <filament/Texture.h>
 #include <filament/View.h>
 #include <filament/Viewport.h>
 #include <filament/ColorGrading.h>
@@ -28,6 +29,9 @@
 
 #include <backend/PixelBufferDescriptor.h>
 
+#include <algorithm>
+#include <vector>
+
 using namespace filament;
 using namespace backend;
 
@@ -138,3 +142,51 @@ TEST_F(RenderingTest, ClearGreen) {
         EXPECT_EQ(rgba[3], 0xff);
     });
 }
+
+TEST_F(RenderingTest, AsyncPrefilterMipmap) {
+    constexpr uint32_t size = 16;
+    Texture* texture = Texture::Builder()
+            .width(size)
+            .height(size)
+            .levels(5)
+            .sampler(Texture::Sampler::SAMPLER_CUBEMAP)
+            .format(Texture::InternalFormat::R11F_G11F_B10F)
+            .build(*mEngine);
+
+    const size_t faceSize = size * size * 3 * sizeof(float);
+    std::vector<float> pixels(6 * size * size * 3, 0.5f);
+    Texture::FaceOffsets offsets;
+    for (size_t i = 0; i < 6; i++) {
+        offsets[i] = i * faceSize;
+    }
+
+    std::vector<float> progress;
+    Texture::PrefilterOptions options;
+    options.async = true;
+    options.user = &progress;
+    options.callback = [](Texture*, float p, void* user) {
+        static_cast<std::vector<float>*>(user)->push_back(p);
+    };
+
+    // the environment is copied, the buffer can go as soon as generatePrefilterMipmap() returns
+    texture->generatePrefilterMipmap(*mEngine,
+            { pixels.data(), pixels.size() * sizeof(float), Texture::Format::RGB,
+              Texture::Type::FLOAT }, offsets, &options);
+    pixels.clear();
+
+    // the levels are uploaded by the frames rendered until the prefiltering is done
+    for (size_t frame = 0; frame < 10000 && (progress.empty() || progress.back() < 1.0f);
+            frame++) {
+        if (mRenderer->beginFrame(mSurface)) {
+            mRenderer->render(mView);
+            mRenderer->endFrame();
+        }
+        mEngine->flushAndWait();
+    }
+
+    ASSERT_FALSE(progress.empty());
+    EXPECT_EQ(progress.back(), 1.0f);
+    EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+
+    mEngine->destroy(texture);
+}
@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <array>
 #include <iostream>
+#include <limits>
 #include <random>
 
 #include <gtest/gtest.h>
@@ -31,18 +33,33 @@
 #include <filament/Frustum.h>
 #include <filament/Material.h>
 #include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/VertexBuffer.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
 #include <private/filament/UibGenerator.h>
+#include <private/filament/Variant.h>
 #include <private/backend/BackendUtils.h>
 
 #include "details/Allocators.h"
 #include "details/Material.h"
 #include "details/Camera.h"
+#include "details/ColorGrading.h"
+#include "details/Culler.h"
+#include "details/CellGraph.h"
+#include "details/CullingHierarchy.h"
 #include "details/Froxelizer.h"
+#include "details/RenderPrimitive.h"
+#include "details/Scene.h"
 #include "details/Engine.h"
+#include "details/View.h"
+#include "PostProcessManager.h"
+#include "ProgramCache.h"
+#include "RenderPass.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
+#include "StreamingBufferAllocator.h"
+#include "TextureStreamer.h"
 #include "UniformBuffer.h"
 
 using namespace filament;
@@ -277,6 +294,94 @@ TEST(FilamentTest, TransformManager) {
     EXPECT_EQ(c, tcm.getChildCount(newParent));
 }
 
+TEST(FilamentTest, TransformManagerTransactionHierarchy) {
+    filament::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    // a root with two chains of 3 nodes each
+    std::array<Entity, 7> entities;
+    em.create(entities.size(), entities.data());
+
+    tcm.create(entities[0]);
+    TransformManager::Instance parents[2] = {
+            tcm.getInstance(entities[0]), tcm.getInstance(entities[0]) };
+    for (size_t i = 1; i < entities.size(); i++) {
+        tcm.create(entities[i], parents[i % 2], mat4f::translation(float3{ 1, 0, 0 }));
+        parents[i % 2] = tcm.getInstance(entities[i]);
+    }
+
+    // first transaction, the whole hierarchy is updated
+    tcm.openLocalTransformTransaction();
+    tcm.setTransform(tcm.getInstance(entities[0]), mat4f::translation(float3{ 0, 1, 0 }));
+    tcm.commitLocalTransformTransaction();
+    for (size_t i = 1; i < entities.size(); i++) {
+        const float depth = float((i + 1) / 2);
+        EXPECT_EQ(tcm.getWorldTransform(tcm.getInstance(entities[i])),
+                mat4f::translation(float3{ depth, 1, 0 }));
+    }
+
+    // only the subtree of the node that changed is updated
+    tcm.openLocalTransformTransaction();
+    tcm.setTransform(tcm.getInstance(entities[3]), mat4f::translation(float3{ 0, 0, 1 }));
+    tcm.commitLocalTransformTransaction();
+    EXPECT_EQ(tcm.getWorldTransform(tcm.getInstance(entities[1])),
+            mat4f::translation(float3{ 1, 1, 0 }));
+    EXPECT_EQ(tcm.getWorldTransform(tcm.getInstance(entities[3])),
+            mat4f::translation(float3{ 1, 1, 1 }));
+    EXPECT_EQ(tcm.getWorldTransform(tcm.getInstance(entities[5])),
+            mat4f::translation(float3{ 2, 1, 1 }));
+    EXPECT_EQ(tcm.getWorldTransform(tcm.getInstance(entities[6])),
+            mat4f::translation(float3{ 3, 1, 0 }));
+}
+
+TEST(FilamentTest, TransformManagerSnapshot) {
+    filament::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 3> entities;
+    em.create(entities.size(), entities.data());
+
+    tcm.create(entities[0]);
+    tcm.create(entities[1], tcm.getInstance(entities[0]), mat4f::translation(float3{ 1, 0, 0 }));
+    TransformManager::Instance parent = tcm.getInstance(entities[0]);
+    TransformManager::Instance child = tcm.getInstance(entities[1]);
+
+    // without snapshot, rendering uses the current transforms
+    tcm.setTransform(parent, mat4f::translation(float3{ 0, 1, 0 }));
+    EXPECT_EQ(tcm.getRenderWorldTransform(child), mat4f::translation(float3{ 1, 1, 0 }));
+    EXPECT_EQ(tcm.getRenderVersion(), tcm.getVersion());
+
+    // enabling the snapshot mode commits the current transforms
+    tcm.setSnapshotEnabled(true);
+    const uint32_t version = tcm.getRenderVersion();
+    tcm.setTransform(parent, mat4f::translation(float3{ 0, 2, 0 }));
+    EXPECT_EQ(tcm.getWorldTransform(child), mat4f::translation(float3{ 1, 2, 0 }));
+    EXPECT_EQ(tcm.getRenderWorldTransform(child), mat4f::translation(float3{ 1, 1, 0 }));
+    EXPECT_EQ(tcm.getRenderVersion(), version);
+
+    // new components are rendered where they're created
+    tcm.create(entities[2], 0, mat4f::translation(float3{ 0, 0, 3 }));
+    TransformManager::Instance other = tcm.getInstance(entities[2]);
+    EXPECT_EQ(tcm.getRenderWorldTransform(other), mat4f::translation(float3{ 0, 0, 3 }));
+    EXPECT_EQ(tcm.getRenderWorldTransform(child), mat4f::translation(float3{ 1, 1, 0 }));
+
+    // the snapshot follows the components moved by the reordering of a transaction
+    tcm.setParent(parent, other);
+    tcm.openLocalTransformTransaction();
+    tcm.commitLocalTransformTransaction();
+    parent = tcm.getInstance(entities[0]);
+    child = tcm.getInstance(entities[1]);
+    EXPECT_EQ(tcm.getRenderWorldTransform(parent), mat4f::translation(float3{ 0, 1, 0 }));
+    EXPECT_EQ(tcm.getRenderWorldTransform(child), mat4f::translation(float3{ 1, 1, 0 }));
+
+    tcm.commitSnapshot();
+    EXPECT_EQ(tcm.getRenderWorldTransform(child), mat4f::translation(float3{ 1, 2, 3 }));
+    EXPECT_NE(tcm.getRenderVersion(), version);
+
+    tcm.setSnapshotEnabled(false);
+    tcm.setTransform(parent, mat4f{});
+    EXPECT_EQ(tcm.getRenderWorldTransform(child), mat4f::translation(float3{ 1, 0, 3 }));
+
+}
+
 TEST(FilamentTest, UniformInterfaceBlock) {
 
     UniformInterfaceBlock::Builder b;
@@ -501,6 +606,50 @@ TEST(FilamentTest, UniformBufferSize2) {
     buffer.invalidate();
 }
 
+TEST(FilamentTest, UniformBufferDirtyRange) {
+    UniformInterfaceBlock::Builder b;
+    b.name("UniformBufferDirtyRange");
+    b.add("f4a", 1, UniformInterfaceBlock::Type::FLOAT4); // offset = 0
+    b.add("f4b", 1, UniformInterfaceBlock::Type::FLOAT4); // offset = 16
+    b.add("f1a", 1, UniformInterfaceBlock::Type::FLOAT);  // offset = 32
+    b.add("f1b", 1, UniformInterfaceBlock::Type::FLOAT);  // offset = 36
+    UniformInterfaceBlock uib(b.build());
+    UniformBuffer buffer(uib.getSize());
+
+    // a new buffer is entirely dirty
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(buffer.getDirtyOffset(), 0u);
+    EXPECT_EQ(buffer.getDirtySize(), buffer.getSize());
+
+    buffer.clean();
+    EXPECT_FALSE(buffer.isDirty());
+    EXPECT_EQ(buffer.getDirtySize(), 0u);
+
+    buffer.setUniform(uib.getUniformOffset("f4b", 0), float4(1.0f));
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(buffer.getDirtyOffset(), 16u);
+    EXPECT_EQ(buffer.getDirtySize(), 16u);
+
+    // the modified ranges are coalesced
+    buffer.setUniform(uib.getUniformOffset("f1b", 0), 1.0f);
+    EXPECT_EQ(buffer.getDirtyOffset(), 16u);
+    EXPECT_EQ(buffer.getDirtySize(), 24u);
+
+    buffer.setUniform(uib.getUniformOffset("f4a", 0), float4(1.0f));
+    EXPECT_EQ(buffer.getDirtyOffset(), 0u);
+    EXPECT_EQ(buffer.getDirtySize(), 40u);
+
+    // and moved with the buffer
+    UniformBuffer move(std::move(buffer));
+    EXPECT_EQ(move.getDirtyOffset(), 0u);
+    EXPECT_EQ(move.getDirtySize(), 40u);
+
+    move.clean();
+    move.setUniform(uib.getUniformOffset("f1a", 0), 1.0f);
+    EXPECT_EQ(move.getDirtyOffset(), 32u);
+    EXPECT_EQ(move.getDirtySize(), 4u);
+}
+
 TEST(FilamentTest, BoxCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -581,6 +730,603 @@ TEST(FilamentTest, SphereCulling) {
     EXPECT_TRUE(frustum.intersects({ 0, 200 }));
 }
 
+TEST(FilamentTest, ConeCulling) {
+    Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    // apexes behind the camera, outside of the near plane
+    const float4 spheres[] = {
+            { 0, 0, 10, 20 }, { 0, 0, 10, 20 }, { 0, 0, 10, 20 }, { 0, 0, 10, 20 } };
+    const float3 axes[] = { { 0, 0, 1 }, { 0, 0, -1 }, { 0, 0, 1 }, { 1, 0, 0 } };
+    const float cosSqr[] = { 0.75f, 0.75f, -std::numeric_limits<float>::infinity(), 0.75f };
+    Culler::result_type results[] = { 1, 1, 1, 0 };
+    Culler::intersectsCones(results, frustum, spheres, axes, cosSqr, 4);
+
+    // a spot light pointing away from the frustum is culled
+    EXPECT_EQ(0, results[0]);
+    // but not one pointing towards it
+    EXPECT_EQ(1, results[1]);
+    // point lights are never culled
+    EXPECT_EQ(1, results[2]);
+    // and culled results stay culled
+    EXPECT_EQ(0, results[3]);
+}
+
+TEST(FilamentTest, HierarchicalCulling) {
+    Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    constexpr size_t COUNT = 1024;
+    std::default_random_engine generator(82828);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+    std::vector<CullingHierarchy::Instance> instances(COUNT);
+    std::vector<float3> centers(COUNT);
+    std::vector<float3> extents(COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        instances[i] = CullingHierarchy::Instance(uint32_t(i + 1));
+        centers[i] = { position(generator), position(generator), position(generator) };
+        extents[i] = size(generator);
+    }
+
+    auto check = [&](CullingHierarchy const& hierarchy) {
+        std::vector<Culler::result_type> expected(COUNT);
+        std::vector<Culler::result_type> results(COUNT);
+        Culler::Test::intersects(expected.data(), frustum, centers.data(), extents.data(), COUNT);
+        hierarchy.cull(results.data(), frustum, 0);
+        for (size_t i = 0; i < COUNT; i++) {
+            EXPECT_EQ(bool(expected[i]), bool(results[i])) << "renderable " << i;
+        }
+    };
+
+    CullingHierarchy hierarchy;
+    hierarchy.update(instances.data(), centers.data(), extents.data(), COUNT);
+    check(hierarchy);
+
+    // move some renderables, the hierarchy is refit
+    for (size_t i = 0; i < COUNT; i += 7) {
+        centers[i] = { position(generator), position(generator), position(generator) };
+    }
+    hierarchy.update(instances.data(), centers.data(), extents.data(), COUNT);
+    check(hierarchy);
+
+    // change the renderables, the hierarchy is rebuilt
+    std::reverse(instances.begin(), instances.end());
+    std::reverse(centers.begin(), centers.end());
+    std::reverse(extents.begin(), extents.end());
+    hierarchy.update(instances.data(), centers.data(), extents.data(), COUNT);
+    check(hierarchy);
+}
+
+TEST(FilamentTest, CellCulling) {
+    // three rooms along +x, each connected to the next by a door. The second door is on the
+    // far side of the second room, to the right.
+    CellGraph graph;
+    const uint32_t a = graph.addCell({{  0, 1.5f, 0 }, { 5, 1.5f, 5 }});
+    const uint32_t b = graph.addCell({{ 10, 1.5f, 0 }, { 5, 1.5f, 5 }});
+    const uint32_t c = graph.addCell({{ 20, 1.5f, 0 }, { 5, 1.5f, 5 }});
+    const float3 door0[4] = {{ 5, 0, -0.5f }, { 5, 0, 0.5f }, { 5, 2, 0.5f }, { 5, 2, -0.5f }};
+    const float3 door1[4] = {{ 15, 0, -10 }, { 15, 0, -9 }, { 15, 2, -9 }, { 15, 2, -10 }};
+    graph.addPortal(a, b, door0, 4);
+    graph.addPortal(b, c, door1, 4);
+
+    auto planes = [](float3 eye, float3 center) {
+        const mat4f model = mat4f::lookAt(eye, center, float3{ 0, 1, 0 });
+        const Frustum frustum(mat4f::perspective(120, 1, 0.1f, 100, mat4f::Fov::HORIZONTAL) *
+                inverse(model));
+        std::array<float4, 6> result;
+        frustum.getNormalizedPlanes(result.data());
+        return result;
+    };
+
+    // looking through the first door, the second one is out of sight
+    float3 eye{ 0, 1.5f, 0 };
+    EXPECT_TRUE(graph.update(planes(eye, eye + float3{ 1, 0, 0 }).data(), eye, true));
+    EXPECT_TRUE(graph.isVisible(a));
+    EXPECT_TRUE(graph.isVisible(b));
+    EXPECT_FALSE(graph.isVisible(c));
+
+    // without narrowing the frustum to the first door, the second one is visible
+    EXPECT_TRUE(graph.update(planes(eye, eye + float3{ 1, 0, 0 }).data(), eye, false));
+    EXPECT_TRUE(graph.isVisible(c));
+
+    // from the left of the first room, both doors line up
+    eye = { 0, 1.5f, 4.9f };
+    EXPECT_TRUE(graph.update(planes(eye, eye + float3{ 1, 0, 0 }).data(), eye, true));
+    EXPECT_TRUE(graph.isVisible(a));
+    EXPECT_TRUE(graph.isVisible(b));
+    EXPECT_TRUE(graph.isVisible(c));
+
+    // looking away from the door, only the first room is visible
+    EXPECT_TRUE(graph.update(planes(eye, eye - float3{ 1, 0, 0 }).data(), eye, true));
+    EXPECT_TRUE(graph.isVisible(a));
+    EXPECT_FALSE(graph.isVisible(b));
+    EXPECT_FALSE(graph.isVisible(c));
+
+    // renderables without a cell, or whose cell is visible, are left untouched
+    const uint32_t cells[4] = { a, b, c, CellGraph::NO_CELL };
+    const uint32_t indices[4] = { 3, 2, 1, 0 };
+    Culler::result_type results[4] = { 3, 3, 3, 3 };
+    graph.cull(results, cells, indices, 4, 1);
+    EXPECT_EQ(3, results[0]);
+    EXPECT_EQ(1, results[1]);
+    EXPECT_EQ(1, results[2]);
+    EXPECT_EQ(3, results[3]);
+
+    // outside all cells, everything is visible
+    eye = { 0, 10, 0 };
+    EXPECT_FALSE(graph.update(planes(eye, eye + float3{ 1, 0, 0 }).data(), eye, true));
+    EXPECT_TRUE(graph.isVisible(a));
+    EXPECT_TRUE(graph.isVisible(b));
+    EXPECT_TRUE(graph.isVisible(c));
+}
+
+TEST(FilamentTest, TextureStreamingBudget) {
+    using backend::TextureFormat;
+
+    // blocks are counted whole for compressed formats
+    EXPECT_EQ(1024u * 1024u * 4u, TextureStreamer::getLevelsSize(1024, 1024, TextureFormat::RGBA8, 0, 1));
+    EXPECT_EQ(128u + 32u + 8u + 8u + 8u, TextureStreamer::getLevelsSize(16, 16, TextureFormat::DXT1_RGB, 0, 5));
+
+    auto size = [](uint8_t baseLevel) {
+        return TextureStreamer::getLevelsSize(1024, 1024, TextureFormat::RGBA8, baseLevel, 11);
+    };
+
+    // two 1024x1024 textures whose tail starts at 128x128, the second one isn't visible
+    TextureStreamer::Target targets[2];
+    auto reset = [&targets]() {
+        targets[0] = { 1024, 1024, TextureFormat::RGBA8, 11, 3, 0, true };
+        targets[1] = { 1024, 1024, TextureFormat::RGBA8, 11, 3, 0, false };
+    };
+
+    reset();
+    EXPECT_EQ(2 * size(0), TextureStreamer::fitToBudget(targets, 2, 2 * size(0)));
+    EXPECT_EQ(0, targets[0].baseLevel);
+    EXPECT_EQ(0, targets[1].baseLevel);
+
+    // the texture not visible is evicted first
+    reset();
+    EXPECT_EQ(size(0) + size(3), TextureStreamer::fitToBudget(targets, 2, size(0) + size(3)));
+    EXPECT_EQ(0, targets[0].baseLevel);
+    EXPECT_EQ(3, targets[1].baseLevel);
+
+    // then the visible ones lose levels
+    reset();
+    EXPECT_EQ(size(1) + size(3), TextureStreamer::fitToBudget(targets, 2, size(1) + size(3)));
+    EXPECT_EQ(1, targets[0].baseLevel);
+    EXPECT_EQ(3, targets[1].baseLevel);
+
+    // the tails stay resident even over budget
+    reset();
+    EXPECT_EQ(2 * size(3), TextureStreamer::fitToBudget(targets, 2, 0));
+    EXPECT_EQ(3, targets[0].baseLevel);
+    EXPECT_EQ(3, targets[1].baseLevel);
+}
+
+TEST(FilamentTest, StreamingBufferAllocator) {
+    using backend::BufferDescriptor;
+    constexpr size_t CAPACITY = StreamingBufferAllocator::CAPACITY;
+    StreamingBufferAllocator allocator;
+
+    // this is what the backend does once it has consumed an update
+    auto release = [](BufferDescriptor& buffer) {
+        BufferDescriptor released(std::move(buffer));
+    };
+
+    // sizes are rounded up to the alignment
+    BufferDescriptor a = allocator.allocate(CAPACITY / 2 - 1);
+    EXPECT_EQ(CAPACITY / 2, a.size);
+    EXPECT_EQ(0u, uintptr_t(a.buffer) % StreamingBufferAllocator::ALIGNMENT);
+    BufferDescriptor b = allocator.allocate(CAPACITY / 4);
+    EXPECT_EQ((uint8_t const*)a.buffer + CAPACITY / 2, b.buffer);
+    EXPECT_EQ(CAPACITY * 3 / 4, allocator.getUsedSize());
+
+    // the end of the ring is too small and its start is still in use, this goes to the heap
+    BufferDescriptor c = allocator.allocate(CAPACITY / 2);
+    EXPECT_EQ(CAPACITY * 3 / 4, allocator.getUsedSize());
+    release(c);
+
+    // once the oldest allocation is released, the ring wraps around
+    void const* const start = a.buffer;
+    release(a);
+    EXPECT_EQ(CAPACITY / 4, allocator.getUsedSize());
+    BufferDescriptor d = allocator.allocate(CAPACITY / 2);
+    EXPECT_EQ(start, d.buffer);
+    EXPECT_EQ(CAPACITY, allocator.getUsedSize());
+
+    // releasing out of order only reclaims the oldest allocations
+    release(d);
+    EXPECT_EQ(CAPACITY, allocator.getUsedSize());
+    release(b);
+    EXPECT_EQ(0u, allocator.getUsedSize());
+}
+
+TEST(FilamentTest, LevelsOfDetail) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FRenderableManager& rcm = upcast(engine->getRenderableManager());
+    Entity e = EntityManager::get().create();
+
+    // 4 primitives: 2 in level 0, 1 in each of the next two levels
+    RenderableManager::Builder(4)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .levelOfDetail(0, 2, 0.5f)
+            .levelOfDetail(1, 1, 0.25f)
+            .levelOfDetail(2, 1, 0.1f)
+            .build(*engine, e);
+
+    auto ri = rcm.getInstance(e);
+    EXPECT_EQ(rcm.getLevelCount(ri), 3);
+    EXPECT_EQ(engine->getRenderableManager().getPrimitiveCount(ri), 4);
+    EXPECT_EQ(rcm.getPrimitiveCount(ri, 0), 2);
+    EXPECT_EQ(rcm.getPrimitiveCount(ri, 1), 1);
+    EXPECT_EQ(rcm.getPrimitiveCount(ri, 2), 1);
+    EXPECT_EQ(rcm.getRenderPrimitives(ri, 1).data(), rcm.getRenderPrimitives(ri, 0).data() + 2);
+
+    EXPECT_EQ(rcm.getLevelOfDetail(ri, 2.0f), 0);
+    EXPECT_EQ(rcm.getLevelOfDetail(ri, 0.5f), 0);
+    EXPECT_EQ(rcm.getLevelOfDetail(ri, 0.3f), 1);
+    EXPECT_EQ(rcm.getLevelOfDetail(ri, 0.1f), 2);
+    EXPECT_EQ(rcm.getLevelOfDetail(ri, 0.01f), 2);
+
+    // the public API indexes the primitives of all the levels
+    size_t primitiveIndex = 3;
+    EXPECT_EQ(rcm.getPrimitiveLevel(ri, primitiveIndex), 2);
+    EXPECT_EQ(primitiveIndex, 0);
+
+    // renderables without levels of detail have a single one
+    Entity single = EntityManager::get().create();
+    RenderableManager::Builder(2)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .build(*engine, single);
+    auto si = rcm.getInstance(single);
+    EXPECT_EQ(rcm.getLevelCount(si), 1);
+    EXPECT_EQ(rcm.getLevelOfDetail(si, 0.01f), 0);
+    EXPECT_EQ(rcm.getPrimitiveCount(si, 0), 2);
+
+    engine->destroy(e);
+    engine->destroy(single);
+    EntityManager::get().destroy(e);
+    EntityManager::get().destroy(single);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, Impostor) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FRenderableManager& rcm = upcast(engine->getRenderableManager());
+    FRenderPrimitive quad;
+
+    // 3 primitives: 2 in level 0, 1 in level 1
+    Entity e = EntityManager::get().create();
+    RenderableManager::Builder(3)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .levelOfDetail(0, 2, 0.5f)
+            .levelOfDetail(1, 1, 0.25f)
+            .build(*engine, e);
+    auto ri = rcm.getInstance(e);
+    EXPECT_EQ(rcm.getImpostor(ri, 0.01f), nullptr);
+
+    // the impostor replaces all the levels below its screen size
+    rcm.setImpostor(ri, { &quad, 1u }, 0.1f);
+    EXPECT_EQ(rcm.getLevelCount(ri), 2);
+    EXPECT_EQ(rcm.getImpostor(ri, 0.3f), nullptr);
+    EXPECT_EQ(rcm.getImpostor(ri, 0.1f), nullptr);
+    ASSERT_NE(rcm.getImpostor(ri, 0.05f), nullptr);
+    EXPECT_EQ(rcm.getImpostor(ri, 0.05f)->data(), &quad);
+    rcm.setImpostor(ri, {}, 0.0f);
+    EXPECT_EQ(rcm.getImpostor(ri, 0.05f), nullptr);
+    EXPECT_EQ(rcm.getLevelCount(ri), 2);
+
+    // a renderable without levels of detail gets a single level, until the impostor is removed
+    Entity single = EntityManager::get().create();
+    RenderableManager::Builder(2)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .build(*engine, single);
+    auto si = rcm.getInstance(single);
+    EXPECT_FALSE(rcm.hasLevels(si));
+    rcm.setImpostor(si, { &quad, 1u }, 0.1f);
+    EXPECT_TRUE(rcm.hasLevels(si));
+    EXPECT_EQ(rcm.getLevelCount(si), 1);
+    EXPECT_EQ(rcm.getPrimitiveCount(si, 0), 2);
+    EXPECT_EQ(rcm.getLevelOfDetail(si, 0.01f), 0);
+    EXPECT_NE(rcm.getImpostor(si, 0.01f), nullptr);
+    rcm.setImpostor(si, {}, 0.0f);
+    EXPECT_FALSE(rcm.hasLevels(si));
+
+    engine->destroy(e);
+    engine->destroy(single);
+    EntityManager::get().destroy(e);
+    EntityManager::get().destroy(single);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, DepthVertices) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FRenderableManager& rcm = upcast(engine->getRenderableManager());
+    Entity e = EntityManager::get().create();
+
+    VertexBuffer* vertices = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3, 0, 24)
+            .attribute(VertexAttribute::UV0, 0, VertexBuffer::AttributeType::FLOAT3, 12, 24)
+            .build(*engine);
+    VertexBuffer* depthVertices = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    IndexBuffer* indices = IndexBuffer::Builder()
+            .indexCount(3)
+            .build(*engine);
+
+    RenderableManager::Builder(1)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vertices, indices)
+            .depthGeometry(0, depthVertices)
+            .build(*engine, e);
+
+    auto ri = rcm.getInstance(e);
+    FRenderPrimitive const& primitive = rcm.getRenderPrimitives(ri, 0)[0];
+    FMaterial const* material = primitive.getMaterialInstance()->getMaterial();
+
+    // the depth passes of an opaque material only read the positions
+    EXPECT_NE(primitive.getDepthHwHandle(material->getDepthAttributes()),
+            primitive.getHwHandle());
+
+    // the full vertices are drawn when the depth vertices miss an attribute the depth pass reads
+    AttributeBitset masked = material->getDepthAttributes();
+    masked.set(VertexAttribute::UV0);
+    EXPECT_EQ(primitive.getDepthHwHandle(masked), primitive.getHwHandle());
+
+    // new vertices remove the depth vertices
+    engine->getRenderableManager().setGeometryAt(ri, 0,
+            RenderableManager::PrimitiveType::TRIANGLES, vertices, indices, 0, 3);
+    EXPECT_EQ(primitive.getDepthHwHandle(material->getDepthAttributes()),
+            primitive.getHwHandle());
+
+    engine->destroy(e);
+    engine->destroy(vertices);
+    engine->destroy(depthVertices);
+    engine->destroy(indices);
+    EntityManager::get().destroy(e);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, TemporalSorting) {
+    using Command = RenderPass::Command;
+    FEngine* engine = upcast(Engine::create(Engine::Backend::NOOP));
+    constexpr uint32_t count = 1000;
+    std::vector<Command> storage(count + 1);
+    RenderPass::CommandOrder order;
+
+    // the depth commands of 'count' primitives, at the given distances, and a sentinel
+    auto sort = [&](std::vector<uint32_t> const& distances) {
+        RenderPass pass(*engine, GrowingSlice<Command>(storage.data(), count + 1));
+        Command* commands = pass.getCommands().grow(count + 1);
+        for (uint32_t i = 0; i < count; i++) {
+            commands[i].key = uint64_t(RenderPass::Pass::DEPTH) |
+                    uint64_t(RenderPass::CustomCommand::PASS) | distances[i];
+            commands[i].primitive.primitiveHandle = backend::RenderPrimitiveHandle(i + 1);
+        }
+        commands[count].key = uint64_t(RenderPass::Pass::SENTINEL);
+        pass.sortCommands(&order);
+        ASSERT_EQ(pass.getCommands().size(), count);
+        for (uint32_t i = 1; i < count; i++) {
+            ASSERT_LE(commands[i - 1].key, commands[i].key);
+        }
+    };
+
+    std::vector<uint32_t> distances(count);
+    std::default_random_engine generator(17);
+    for (uint32_t i = 0; i < count; i++) {
+        distances[i] = generator() % 100000;
+    }
+    sort(distances);
+
+    // the next frame, most commands keep their place
+    for (uint32_t i = 0; i < count; i += 10) {
+        distances[i] = generator() % 100000;
+    }
+    sort(distances);
+
+    // and when they all move, they're sorted from scratch
+    for (uint32_t i = 0; i < count; i++) {
+        distances[i] = generator() % 100000;
+    }
+    sort(distances);
+
+    Engine::destroy((Engine **)&engine);
+}
+
+TEST(FilamentTest, OrderIndependentTransparency) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    View* view = engine->createView();
+
+    EXPECT_FALSE(view->isOrderIndependentTransparencyEnabled());
+    view->setOrderIndependentTransparencyEnabled(true);
+    EXPECT_TRUE(view->isOrderIndependentTransparencyEnabled());
+    EXPECT_TRUE(upcast(view)->hasOrderIndependentTransparency());
+
+    // the weighted blended commands are sorted after all the other draw commands, the most
+    // distant blended command included, so that they can be split off the color pass
+    const uint64_t blended = uint64_t(RenderPass::Pass::BLENDED) |
+            uint64_t(RenderPass::CustomCommand::PASS) | RenderPass::BLEND_DISTANCE_MASK;
+    const uint64_t oit = uint64_t(RenderPass::Pass::OIT) |
+            uint64_t(RenderPass::CustomCommand::PASS);
+    EXPECT_LT(blended, oit);
+    EXPECT_LT(oit | RenderPass::PRIORITY_MASK | RenderPass::MATERIAL_MASK,
+            uint64_t(RenderPass::Pass::SENTINEL));
+
+    engine->destroy(view);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, HiZLayout) {
+    const uint32_t sizes[][2] = {
+            { 32, 32 }, { 33, 47 }, { 1920, 1080 }, { 1283, 719 }, { 32, 4096 }};
+    for (auto const& size : sizes) {
+        auto layout = PostProcessManager::getHiZLayout(size[0], size[1]);
+
+        // the occlusion culler reads back level 2
+        ASSERT_GT(layout.levels, 2);
+
+        // each level is exactly half the size of the previous one
+        const uint32_t last = layout.levels - 1u;
+        EXPECT_EQ((layout.width  >> last) << last, layout.width);
+        EXPECT_EQ((layout.height >> last) << last, layout.height);
+        EXPECT_GE(layout.width  >> last, 1u);
+        EXPECT_GE(layout.height >> last, 1u);
+
+        // level 0 covers the structure buffer, level 2 its tiles of 8 x 8 texels
+        EXPECT_GE(layout.width  * 2u, size[0]);
+        EXPECT_GE(layout.height * 2u, size[1]);
+        EXPECT_GE(layout.width  >> 2u, (size[0] + 7u) / 8u);
+        EXPECT_GE(layout.height >> 2u, (size[1] + 7u) / 8u);
+    }
+}
+
+TEST(FilamentTest, ScreenSpaceReflectionsOptions) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    View* view = engine->createView();
+
+    EXPECT_FALSE(view->getScreenSpaceReflectionsOptions().enabled);
+    EXPECT_FALSE(upcast(view)->hasScreenSpaceReflections());
+    view->setScreenSpaceReflectionsOptions({ .thickness = -1.0f, .enabled = true });
+    EXPECT_EQ(view->getScreenSpaceReflectionsOptions().thickness, 0.0f);
+    EXPECT_TRUE(upcast(view)->hasScreenSpaceReflections());
+
+    engine->destroy(view);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, AutoExposureOptions) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    View* view = engine->createView();
+
+    EXPECT_FALSE(view->getAutoExposureOptions().enabled);
+    view->setAutoExposureOptions({
+            .minCompensation = 2.0f,
+            .maxCompensation = -2.0f,
+            .lowPercentile = 0.8f,
+            .highPercentile = 0.5f,
+            .key = 0.0f,
+            .speedUp = -1.0f,
+            .enabled = true });
+    auto const& options = view->getAutoExposureOptions();
+    EXPECT_EQ(options.maxCompensation, 2.0f);
+    EXPECT_EQ(options.highPercentile, 0.8f);
+    EXPECT_GT(options.key, 0.0f);
+    EXPECT_EQ(options.speedUp, 0.0f);
+    EXPECT_TRUE(options.enabled);
+
+    engine->destroy(view);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, PickingVariants) {
+    // the picking variants are depth variants that reuse the fog bit
+    Variant picking(Variant::DEPTH_VARIANT);
+    picking.setPicking(true);
+    EXPECT_TRUE(picking.isDepthPass());
+    EXPECT_TRUE(picking.hasPicking());
+    EXPECT_FALSE(picking.hasFog());
+    EXPECT_FALSE(Variant::isReserved(picking.key));
+    EXPECT_EQ(Variant::filterVariant(picking.key, false), picking.key);
+    EXPECT_EQ(Variant::filterVariantFragment(picking.key), picking.key);
+
+    // they share the vertex shader of the depth variants
+    EXPECT_EQ(Variant::filterVariantVertex(picking.key), Variant::DEPTH_VARIANT);
+    picking.setSkinning(true);
+    EXPECT_FALSE(Variant::isReserved(picking.key));
+    EXPECT_EQ(Variant::filterVariantVertex(picking.key),
+            Variant::DEPTH_VARIANT | Variant::SKINNING_OR_MORPHING);
+
+    // they don't write the VSM moments
+    picking.setVsm(true);
+    EXPECT_TRUE(Variant::isReserved(picking.key));
+
+    // fog is still a color variant
+    Variant fog;
+    fog.setFog(true);
+    EXPECT_TRUE(fog.hasFog());
+    EXPECT_FALSE(fog.hasPicking());
+    EXPECT_FALSE(fog.isDepthPass());
+}
+
+TEST(FilamentTest, ColorGradingLutCache) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FColorGrading::LutCache& cache = upcast(engine)->getColorGradingLutCache();
+
+    // the default color grading has a LUT
+    const size_t size = cache.getSize();
+    EXPECT_EQ(size, 1);
+
+    auto build = [engine](float contrast) {
+        return upcast(ColorGrading::Builder().contrast(contrast).build(*engine));
+    };
+
+    // the same parameters share the same LUT
+    FColorGrading* a = build(1.5f);
+    FColorGrading* b = build(1.5f);
+    EXPECT_EQ(a->getHwHandle(), b->getHwHandle());
+    EXPECT_EQ(cache.getSize(), size + 1);
+
+    // the LUT is kept after it's released
+    engine->destroy(a);
+    engine->destroy(b);
+    EXPECT_EQ(cache.getSize(), size + 1);
+    a = build(1.5f);
+    EXPECT_EQ(cache.getSize(), size + 1);
+    engine->destroy(a);
+
+    // but only the last few of them
+    for (size_t i = 0; i < FColorGrading::LutCache::UNUSED_CAPACITY * 2; i++) {
+        engine->destroy(build(1.0f + float(i + 2) * 0.1f));
+    }
+    EXPECT_EQ(cache.getSize(), size + FColorGrading::LutCache::UNUSED_CAPACITY);
+
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, ProgramCache) {
+    using namespace filament::backend;
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    DriverApi& driver = upcast(engine)->getDriverApi();
+
+    const uint32_t vertex[] = { 0x07230203, 1, 2, 3 };
+    const uint32_t fragment[] = { 0x07230203, 4, 5, 6 };
+    auto build = [&](const char* name, uint32_t binding) {
+        const Program::Sampler sampler{ utils::CString("materialParams_texture"),
+                uint16_t(binding) };
+        Program program;
+        program.diagnostics(utils::CString(name))
+                .withVertexShader(vertex, sizeof(vertex))
+                .withFragmentShader(fragment, sizeof(fragment))
+                .setSamplerGroup(0, &sampler, 1);
+        return program;
+    };
+
+    // the diagnostics aren't part of the program, the bindings are
+    EXPECT_EQ(ProgramCache::hash(build("a", 0)), ProgramCache::hash(build("b", 0)));
+    EXPECT_NE(ProgramCache::hash(build("a", 0)), ProgramCache::hash(build("a", 1)));
+
+    ProgramCache cache;
+    auto a = cache.acquire(driver, build("a", 0));
+    auto b = cache.acquire(driver, build("b", 0));
+    auto c = cache.acquire(driver, build("c", 1));
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(cache.getProgramCount(), 2);
+
+    // the shared program is destroyed with its last reference
+    cache.release(driver, a);
+    EXPECT_EQ(cache.getProgramCount(), 2);
+    cache.release(driver, b);
+    cache.release(driver, c);
+    EXPECT_EQ(cache.getProgramCount(), 0);
+
+    Engine::destroy(&engine);
+}
+
 TEST(FilamentTest, ColorConversion) {
     // Linear to Gamma
     // 0.0 stays 0.0
@@ -641,7 +1387,7 @@ TEST(FilamentTest, FroxelData) {
 
     Froxelizer froxelData(*engine);
     froxelData.setOptions(5, 100);
-    froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100);
+    froxelData.prepare(engine->getDriverApi(), scope, vp, p, 0.1, 100, 1);
 
     Froxel f = froxelData.getFroxelAt(0,0,0);
 
@@ -860,6 +1606,89 @@ TEST(FilamentTest, Bones) {
     }
 }
 
+TEST(FilamentTest, DynamicBounds) {
+    using Bones = FRenderableManager::Bones;
+    using DynamicBounds = FRenderableManager::DynamicBounds;
+
+    auto expectBox = [](Box const& box, float3 min, float3 max) {
+        for (size_t i = 0; i < 3; i++) {
+            EXPECT_FLOAT_EQ(box.getMin()[i], min[i]);
+            EXPECT_FLOAT_EQ(box.getMax()[i], max[i]);
+        }
+    };
+
+    // two bones, the second one moved up
+    Bones bones{};
+    bones.bounds = std::unique_ptr<DynamicBounds>(new DynamicBounds{
+            {},
+            { Box{{ 0, 0, 0 }, { 1, 1, 1 }}, Box{{ 2, 0, 0 }, { 1, 1, 1 }} },
+            { mat4f{}, mat4f::translation(float3{ 0, 3, 0 }) },
+            {}
+    });
+    expectBox(FRenderableManager::computeDynamicBounds(bones), { -1, -1, -1 }, { 3, 4, 1 });
+
+    // the second bone turned a quarter around z
+    bones.bounds->boneTransforms[1] = mat4f::rotation(F_PI_2, float3{ 0, 0, 1 });
+    expectBox(FRenderableManager::computeDynamicBounds(bones), { -1, -1, -1 }, { 1, 3, 1 });
+
+    // a morph target moving the vertices by up to 2 along x, at half its weight
+    bones.morphWeights = { 0.5f };
+    bones.bounds->morphExtents = { float3{ 2, 0, 0 } };
+    expectBox(FRenderableManager::computeDynamicBounds(bones), { -2, -1, -1 }, { 2, 4, 1 });
+
+    // only morphed, the bounds at rest grow
+    bones.bounds->boneBoxes.clear();
+    bones.bounds->rest = Box{{ 0, 0, 0 }, { 1, 1, 1 }};
+    bones.morphWeights = { -1.0f };
+    expectBox(FRenderableManager::computeDynamicBounds(bones), { -3, -1, -1 }, { 3, 1, 1 });
+}
+
+TEST(FilamentTest, ScenePrepareSharedByViews) {
+    FEngine* engine = FEngine::create();
+    FScene* scene = upcast(engine->createScene());
+    FLightManager& lcm = engine->getLightManager();
+
+    Entity e = engine->getEntityManager().create();
+    engine->getTransformManager().create(e);
+    LightManager::Builder(LightManager::Type::POINT)
+            .position({ 1, 2, 3 })
+            .falloff(4)
+            .build(*engine, e);
+    LightManager::Instance instance = lcm.getInstance(e);
+    scene->addEntity(e);
+
+    // the first View of the frame gathers the light, then reorders the lights as Views do
+    FScene::LightSoa& lights = scene->getLightData();
+    scene->prepare(mat4f{}, 1);
+    ASSERT_EQ(lights.size(), 2);
+    EXPECT_EQ(lights.elementAt<FScene::POSITION_RADIUS>(1), float4(1, 2, 3, 4));
+    EXPECT_EQ(lights.elementAt<FScene::LIGHT_INSTANCE>(1), instance);
+    lights.elementAt<FScene::POSITION_RADIUS>(1) = float4{};
+    lights.resize(1);
+
+    // the next View of the same frame gets the lights as they were gathered
+    scene->prepare(mat4f{}, 1);
+    ASSERT_EQ(lights.size(), 2);
+    EXPECT_EQ(lights.elementAt<FScene::POSITION_RADIUS>(1), float4(1, 2, 3, 4));
+
+    // changes made between the Views are seen
+    lcm.setLocalPosition(instance, { 5, 6, 7 });
+    scene->prepare(mat4f{}, 1);
+    EXPECT_EQ(lights.elementAt<FScene::POSITION_RADIUS>(1), float4(5, 6, 7, 4));
+
+    // and so is a different world origin
+    scene->prepare(mat4f::translation(float3{ 1, 0, 0 }), 1);
+    EXPECT_EQ(lights.elementAt<FScene::POSITION_RADIUS>(1), float4(6, 6, 7, 4));
+
+    scene->remove(e);
+    scene->prepare(mat4f{}, 2);
+    EXPECT_EQ(lights.size(), 1);
+
+    engine->destroy(e);
+    engine->destroy(scene);
+    Engine::destroy((Engine **)&engine);
+}
+
 TEST(FilamentTest, GoogleLineDirective) {
     {
         char s[512] = "#line 10 \"foobar\"";
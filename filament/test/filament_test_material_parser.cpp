@@ -17,10 +17,14 @@
 #include <fstream>
 #include <iostream>
 
+#include <string.h>
+
 #include <gtest/gtest.h>
 
 #include "MaterialParser.h"
 
+#include <filaflat/ShaderBuilder.h>
+
 #include "filament_test_resources.h"
 
 using namespace filament;
@@ -41,6 +45,50 @@ TEST(MaterialParser, Parse) {
             "See instructions in filament_test_material_parser.cpp" << std::endl;
 }
 
+TEST(MaterialParser, HasShader) {
+    MaterialParser parser(backend::Backend::OPENGL,
+            FILAMENT_TEST_RESOURCES_TEST_MATERIAL_DATA, FILAMENT_TEST_RESOURCES_TEST_MATERIAL_SIZE);
+    ASSERT_TRUE(parser.parse() == MaterialParser::ParseResult::SUCCESS);
+
+    uint32_t shaderModels = 0;
+    ASSERT_TRUE(parser.getShaderModels(&shaderModels));
+    const auto shaderModel = backend::ShaderModel(__builtin_ctz(shaderModels));
+
+    // hasShader() must agree with getShader() on every variant
+    filaflat::ShaderBuilder builder;
+    for (size_t variant = 0; variant < 128; variant++) {
+        for (auto stage : { backend::ShaderType::VERTEX, backend::ShaderType::FRAGMENT }) {
+            EXPECT_EQ(parser.hasShader(shaderModel, uint8_t(variant), stage),
+                    parser.getShader(builder, shaderModel, uint8_t(variant), stage));
+        }
+    }
+    EXPECT_TRUE(parser.hasShader(shaderModel, 0, backend::ShaderType::VERTEX));
+}
+
+TEST(MaterialParser, NoCopy) {
+    MaterialParser copy(backend::Backend::OPENGL,
+            FILAMENT_TEST_RESOURCES_TEST_MATERIAL_DATA, FILAMENT_TEST_RESOURCES_TEST_MATERIAL_SIZE);
+    MaterialParser noCopy(backend::Backend::OPENGL,
+            FILAMENT_TEST_RESOURCES_TEST_MATERIAL_DATA, FILAMENT_TEST_RESOURCES_TEST_MATERIAL_SIZE,
+            false);
+    ASSERT_TRUE(copy.parse() == MaterialParser::ParseResult::SUCCESS);
+    ASSERT_TRUE(noCopy.parse() == MaterialParser::ParseResult::SUCCESS);
+
+    uint32_t shaderModels = 0;
+    ASSERT_TRUE(noCopy.getShaderModels(&shaderModels));
+    const auto shaderModel = backend::ShaderModel(__builtin_ctz(shaderModels));
+
+    // the shaders are the same, the dictionary being read by the first getShader()
+    filaflat::ShaderBuilder expected;
+    filaflat::ShaderBuilder builder;
+    for (auto stage : { backend::ShaderType::VERTEX, backend::ShaderType::FRAGMENT }) {
+        ASSERT_TRUE(copy.getShader(expected, shaderModel, 0, stage));
+        ASSERT_TRUE(noCopy.getShader(builder, shaderModel, 0, stage));
+        EXPECT_EQ(builder.size(), expected.size());
+        EXPECT_EQ(memcmp(builder.data(), expected.data(), expected.size()), 0);
+    }
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
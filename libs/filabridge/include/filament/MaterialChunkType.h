@@ -44,6 +44,11 @@ enum UTILS_PUBLIC ChunkType : uint64_t {
     MaterialGlsl = charTo64bitNum("MAT_GLSL"),
     MaterialSpirv = charTo64bitNum("MAT_SPIR"),
     MaterialMetal = charTo64bitNum("MAT_METL"),
+    // text shaders compressed individually, which don't use the text dictionary
+    MaterialGlslCompressed = charTo64bitNum("MAT_GLSZ"),
+    MaterialMetalCompressed = charTo64bitNum("MAT_METZ"),
+    // Metal libraries compiled ahead of time, used instead of the MSL when present
+    MaterialMetalLibrary = charTo64bitNum("MAT_MLIB"),
     MaterialShaderModels = charTo64bitNum("MAT_SMDL"),
     MaterialSamplerBindings = charTo64bitNum("MAT_SAMP"),   // no longer used
     MaterialProperties = charTo64bitNum("MAT_PROP"),
@@ -74,12 +79,16 @@ enum UTILS_PUBLIC ChunkType : uint64_t {
     MaterialCullingMode = charTo64bitNum("MAT_CUMO"),
 
     MaterialHasCustomDepthShader =charTo64bitNum("MAT_CSDP"),
+    MaterialFoveation = charTo64bitNum("MAT_FOVE"),
 
     MaterialVertexDomain = charTo64bitNum("MAT_VEDO"),
     MaterialInterpolation = charTo64bitNum("MAT_INTR"),
 
     DictionaryText = charTo64bitNum("DIC_TEXT"),
     DictionarySpirv = charTo64bitNum("DIC_SPIR"),
+    // id of a shared text dictionary: its own id in a shared dictionary package, the id of the
+    // dictionary whose lines come first in the text dictionary of a material
+    DictionaryShared = charTo64bitNum("DIC_SHAR"),
 };
 
 } // namespace filamat
@@ -46,14 +46,31 @@ static_assert(BindingPoints::PER_MATERIAL_INSTANCE == BindingPoints::COUNT - 1,
 
 // This value is limited by UBO size, ES3.0 only guarantees 16 KiB.
 // Values <= 256, use less CPU and GPU resources.
-constexpr size_t CONFIG_MAX_LIGHT_COUNT = 256;
+// It can be raised at build time with FILAMENT_MAX_LIGHT_COUNT, up to 1024 lights (64 KiB, the
+// UBO size guaranteed by most desktop drivers). Above 256, froxel records use 16-bit indices.
+// Materials must be compiled with the same value as the engine.
+#ifndef FILAMENT_MAX_LIGHT_COUNT
+#    define FILAMENT_MAX_LIGHT_COUNT 256
+#endif
+constexpr size_t CONFIG_MAX_LIGHT_COUNT = FILAMENT_MAX_LIGHT_COUNT;
+static_assert(CONFIG_MAX_LIGHT_COUNT >= 64 && CONFIG_MAX_LIGHT_COUNT <= 1024 &&
+        CONFIG_MAX_LIGHT_COUNT % 64 == 0,
+        "FILAMENT_MAX_LIGHT_COUNT must be a multiple of 64 between 64 and 1024");
 constexpr size_t CONFIG_MAX_LIGHT_INDEX = CONFIG_MAX_LIGHT_COUNT - 1;
 
-// The maximum number of spot lights in a scene that can cast shadows.
+// The maximum number of spot and point lights in a scene that can cast shadows.
 // Light space coordinates are computed in the vertex shader and interpolated across fragments.
 // Thus, each additional shadow-casting spot light adds 4 additional varying components. Higher
 // values may cause the number of varyings to exceed the driver limit.
-constexpr size_t CONFIG_MAX_SHADOW_CASTING_SPOTS = 2;
+// Their shadow maps are packed in the shadow texture, so more of them don't need more layers.
+constexpr size_t CONFIG_MAX_SHADOW_CASTING_SPOTS = 4;
+
+// The maximum number of spot and point light shadow maps, a point light uses one for each face
+// of its cube. They're indexed with 4 bits in the lights' shadow info.
+constexpr size_t CONFIG_MAX_SHADOW_MAPS_PUNCTUAL = 12;
+static_assert(CONFIG_MAX_SHADOW_MAPS_PUNCTUAL >= CONFIG_MAX_SHADOW_CASTING_SPOTS &&
+        CONFIG_MAX_SHADOW_MAPS_PUNCTUAL <= 16,
+        "CONFIG_MAX_SHADOW_MAPS_PUNCTUAL must be between CONFIG_MAX_SHADOW_CASTING_SPOTS and 16");
 
 // The maximum number of shadow cascades that can be used for directional lights.
 constexpr size_t CONFIG_MAX_SHADOW_CASCADES = 4;
@@ -62,6 +79,13 @@ constexpr size_t CONFIG_MAX_SHADOW_CASCADES = 4;
 // We store 64 bytes per bone.
 constexpr size_t CONFIG_MAX_BONE_COUNT = 256;
 
+// This value is also limited by UBO size, ES3.0 only guarantees 16 KiB.
+// We store 64 bytes per instance transform.
+constexpr size_t CONFIG_MAX_INSTANCES = 256;
+
+// Maximum number of instances of an instanced renderable without per-instance transforms.
+constexpr size_t CONFIG_MAX_INSTANCE_COUNT = 65535;
+
 } // namespace filament
 
 #endif // TNT_FILAMENT_driver/EngineEnums.h
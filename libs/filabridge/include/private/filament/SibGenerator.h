@@ -43,8 +43,9 @@ struct PerViewSib {
     static constexpr size_t SSAO           = 5;
     static constexpr size_t SSR            = 6;
     static constexpr size_t STRUCTURE      = 7;
+    static constexpr size_t SSR_REFLECTIONS = 8;
 
-    static constexpr size_t SAMPLER_COUNT  = 8;
+    static constexpr size_t SAMPLER_COUNT  = 9;
 };
 
 }
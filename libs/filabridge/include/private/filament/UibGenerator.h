@@ -33,6 +33,7 @@ public:
     static UniformInterfaceBlock const& getLightsUib() noexcept;
     static UniformInterfaceBlock const& getShadowUib() noexcept;
     static UniformInterfaceBlock const& getPerRenderableBonesUib() noexcept;
+    static UniformInterfaceBlock const& getPerRenderableInstancesUib() noexcept;
 };
 
 /*
@@ -126,7 +127,8 @@ struct PerViewUib { // NOLINT(cppcoreguidelines-pro-type-member-init)
     float aoReserved3;
 
     math::float2 clipControl;
-    math::float2 padding1;
+    uint32_t orderIndependentTransparency;      // 0: sorted blending, 1: weighted blended OIT
+    uint32_t screenSpaceReflections;            // 0: disabled, 1: ssrReflections is bound
 
     // bring PerViewUib to 2 KiB
     filament::math::float4 padding2[60];
@@ -145,7 +147,7 @@ struct alignas(256) PerRenderableUib {
     int32_t skinningEnabled; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
     int32_t morphingEnabled; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
     uint32_t screenSpaceContactShadows; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
-    float padding0;
+    uint32_t objectId; // id of the renderable's entity, written by the picking variants
 };
 
 struct LightsUib {
@@ -160,14 +162,15 @@ struct LightsUib {
     uint32_t               type;              // { 0=point, 1=spot }
 };
 
-// UBO for punctual (spot light) shadows.
+// UBO for punctual (spot and point light) shadows.
+// A point light has 6 consecutive entries, one per cube face in the order +x, -x, +y, -y, +z, -z.
 struct ShadowUib {
     static const UniformInterfaceBlock& getUib() noexcept {
         return UibGenerator::getShadowUib();
     }
 
-    filament::math::mat4f spotLightFromWorldMatrix[CONFIG_MAX_SHADOW_CASTING_SPOTS];
-    filament::math::float4 directionShadowBias[CONFIG_MAX_SHADOW_CASTING_SPOTS]; // light direction, normal bias
+    filament::math::mat4f spotLightFromWorldMatrix[CONFIG_MAX_SHADOW_MAPS_PUNCTUAL];
+    filament::math::float4 directionShadowBias[CONFIG_MAX_SHADOW_MAPS_PUNCTUAL]; // light direction, normal bias
 };
 
 // This is not the UBO proper, but just an element of a bone array.
@@ -36,6 +36,7 @@ namespace filament {
         // SKN: Skinning
         // DEP: Depth only
         // FOG: Fog
+        // PCK: Picking (depth only variants, shares the FOG bit)
         // VSM: Variance shadow maps
         //
         //   X: either 1 or 0
@@ -46,6 +47,7 @@ namespace filament {
         // Reserved variants:
         //       Vertex depth            X     0     1     X     0     0     0
         //     Fragment depth            X     0     1     0     0     0     0
+        //   Fragment picking            0     1     1     0     0     0     0
         //           Reserved            X     X     1     X     X     X     X
         //           Reserved            X     X     0     X     1     0     0
         //           Reserved            1     X     0     X     0     X     X
@@ -65,6 +67,7 @@ namespace filament {
         static constexpr uint8_t DEPTH                  = 0x10; // depth only variants
         static constexpr uint8_t FOG                    = 0x20; // fog
         static constexpr uint8_t VSM                    = 0x40; // variance shadow maps
+        static constexpr uint8_t PICKING                = FOG;  // picking, only with DEPTH
 
         static constexpr uint8_t VERTEX_MASK = DIRECTIONAL_LIGHTING |
                                                DYNAMIC_LIGHTING |
@@ -82,8 +85,7 @@ namespace filament {
         static constexpr uint8_t DEPTH_MASK = DIRECTIONAL_LIGHTING |
                                               DYNAMIC_LIGHTING |
                                               SHADOW_RECEIVER |
-                                              DEPTH |
-                                              FOG;
+                                              DEPTH;
 
         // the depth variant deactivates all variants that make no sense when writing the depth
         // only -- essentially, all fragment-only variants.
@@ -96,8 +98,11 @@ namespace filament {
         inline bool hasDirectionalLighting() const noexcept { return key & DIRECTIONAL_LIGHTING; }
         inline bool hasDynamicLighting() const noexcept { return key & DYNAMIC_LIGHTING; }
         inline bool hasShadowReceiver() const noexcept { return key & SHADOW_RECEIVER; }
-        inline bool hasFog() const noexcept { return key & FOG; }
+        inline bool hasFog() const noexcept { return (key & (DEPTH | FOG)) == FOG; }
         inline bool hasVsm() const noexcept { return key & VSM; }
+        inline bool hasPicking() const noexcept {
+            return (key & (DEPTH | PICKING)) == (DEPTH | PICKING);
+        }
 
         inline void setSkinning(bool v) noexcept { set(v, SKINNING_OR_MORPHING); }
         inline void setDirectionalLighting(bool v) noexcept { set(v, DIRECTIONAL_LIGHTING); }
@@ -105,6 +110,7 @@ namespace filament {
         inline void setShadowReceiver(bool v) noexcept { set(v, SHADOW_RECEIVER); }
         inline void setFog(bool v) noexcept { set(v, FOG); }
         inline void setVsm(bool v) noexcept { set(v, VSM); }
+        inline void setPicking(bool v) noexcept { set(v, PICKING); }
 
         inline constexpr bool isDepthPass() const noexcept {
             return isValidDepthVariant(key);
@@ -112,8 +118,9 @@ namespace filament {
 
         inline static constexpr bool isValidDepthVariant(uint8_t variantKey) noexcept {
             // For a variant to be a valid depth variant, all of the bits in DEPTH_MASK must be 0,
-            // except for DEPTH.
-            return (variantKey & DEPTH_MASK) == DEPTH_VARIANT;
+            // except for DEPTH. The picking variants don't write the VSM moments.
+            return (variantKey & DEPTH_MASK) == DEPTH_VARIANT &&
+                   (variantKey & (PICKING | VSM)) != (PICKING | VSM);
         }
 
         static constexpr bool isReserved(uint8_t variantKey) noexcept {
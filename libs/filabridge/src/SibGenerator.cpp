@@ -49,6 +49,7 @@ SamplerInterfaceBlock const& SibGenerator::getPerViewSib(uint8_t variantKey) noe
             .add("ssao",          Type::SAMPLER_2D,         Format::FLOAT,   Precision::MEDIUM)
             .add("ssr",           Type::SAMPLER_2D,         Format::FLOAT,   Precision::MEDIUM)
             .add("structure",     Type::SAMPLER_2D,         Format::FLOAT,   Precision::MEDIUM)
+            .add("ssrReflections", Type::SAMPLER_2D,        Format::FLOAT,   Precision::MEDIUM)
             .build();
     };
 
@@ -31,6 +31,9 @@ static_assert(sizeof(PerRenderableUib) % 256 == 0,
 static_assert(CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone) <= 16384,
         "Bones exceed max UBO size");
 
+static_assert(CONFIG_MAX_INSTANCES * sizeof(math::mat4f) <= 16384,
+        "Instances exceed max UBO size");
+
 static_assert(CONFIG_MAX_SHADOW_CASCADES == 4,
         "Changing CONFIG_MAX_SHADOW_CASCADES affects PerView size and breaks materials.");
 
@@ -107,7 +110,10 @@ UniformInterfaceBlock const& UibGenerator::getPerViewUib() noexcept  {
             .add("aoReserved3",             1, UniformInterfaceBlock::Type::FLOAT)
 
             .add("clipControl",             1, UniformInterfaceBlock::Type::FLOAT2)
-            .add("padding1",                1, UniformInterfaceBlock::Type::FLOAT2)
+            // transparency
+            .add("orderIndependentTransparency", 1, UniformInterfaceBlock::Type::UINT)
+            // screen-space reflections
+            .add("screenSpaceReflections",  1, UniformInterfaceBlock::Type::UINT)
 
             // bring PerViewUib to 2 KiB
             .add("padding2", 60, UniformInterfaceBlock::Type::FLOAT4)
@@ -124,7 +130,7 @@ UniformInterfaceBlock const& UibGenerator::getPerRenderableUib() noexcept {
             .add("skinningEnabled", 1, UniformInterfaceBlock::Type::INT)
             .add("morphingEnabled", 1, UniformInterfaceBlock::Type::INT)
             .add("screenSpaceContactShadows", 1, UniformInterfaceBlock::Type::UINT)
-            .add("padding0", 1, UniformInterfaceBlock::Type::FLOAT)
+            .add("objectId", 1, UniformInterfaceBlock::Type::UINT, Precision::HIGH)
             .build();
     return uib;
 }
@@ -140,8 +146,8 @@ UniformInterfaceBlock const& UibGenerator::getLightsUib() noexcept {
 UniformInterfaceBlock const& UibGenerator::getShadowUib() noexcept {
     static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
             .name("ShadowUniforms")
-            .add("spotLightFromWorldMatrix", CONFIG_MAX_SHADOW_CASTING_SPOTS, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
-            .add("directionShadowBias", CONFIG_MAX_SHADOW_CASTING_SPOTS, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
+            .add("spotLightFromWorldMatrix", CONFIG_MAX_SHADOW_MAPS_PUNCTUAL, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            .add("directionShadowBias", CONFIG_MAX_SHADOW_MAPS_PUNCTUAL, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
             .build();
     return uib;
 }
@@ -154,4 +160,13 @@ UniformInterfaceBlock const& UibGenerator::getPerRenderableBonesUib() noexcept {
     return uib;
 }
 
+UniformInterfaceBlock const& UibGenerator::getPerRenderableInstancesUib() noexcept {
+    // shares the PER_RENDERABLE_BONES binding, instancing and skinning are mutually exclusive
+    static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
+            .name("InstancesUniforms")
+            .add("transforms", CONFIG_MAX_INSTANCES, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            .build();
+    return uib;
+}
+
 } // namespace filament
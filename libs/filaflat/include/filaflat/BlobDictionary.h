@@ -41,7 +41,14 @@ public:
     }
 
     inline bool isEmpty() const noexcept {
-        return mBlobs.empty();
+        return size() == 0;
+    }
+
+    // The blobs of 'base' then come first and are referenced, not copied. It must outlive this
+    // dictionary.
+    inline void setBase(BlobDictionary const* base) noexcept {
+        mBase = base;
+        mBaseSize = base ? base->size() : 0;
     }
 
     inline void reserve(size_t size) {
@@ -49,20 +56,29 @@ public:
     }
 
     inline const char* getBlob(size_t index, size_t* size) const noexcept {
+        if (index < mBaseSize) {
+            return mBase->getBlob(index, size);
+        }
+        index -= mBaseSize;
         *size = mBlobs[index].size();
         return (const char*) mBlobs[index].data();
     }
 
     inline const char* getString(size_t index) const noexcept {
-        return (const char*) mBlobs[index].data();
+        if (index < mBaseSize) {
+            return mBase->getString(index);
+        }
+        return (const char*) mBlobs[index - mBaseSize].data();
     }
 
     inline size_t size() const noexcept {
-        return mBlobs.size();
+        return mBaseSize + mBlobs.size();
     }
 
 private:
     std::vector<Blob> mBlobs;
+    BlobDictionary const* mBase = nullptr;
+    size_t mBaseSize = 0;
 };
 
 } // namespace filaflat
@@ -42,6 +42,9 @@ public:
             BlobDictionary const& dictionary,
             uint8_t shaderModel, uint8_t variant, uint8_t stage);
 
+    // returns whether the chunk has the given shader, without decoding it
+    bool hasShader(uint8_t shaderModel, uint8_t variant, uint8_t stage) const noexcept;
+
 private:
     ChunkContainer const& mContainer;
     filamat::ChunkType mMaterialTag = filamat::ChunkType::Unknown;
@@ -49,10 +52,20 @@ private:
     const uint8_t* mBase = nullptr;
     tsl::robin_map<uint32_t, uint32_t> mOffsets;
 
+    // preset dictionary of the compressed text shaders
+    const char* mPresetDictionary = nullptr;
+    size_t mPresetDictionarySize = 0;
+
     bool getTextShader(Unflattener unflattener,
             BlobDictionary const& dictionary, ShaderBuilder& shaderBuilder,
             uint8_t shaderModel, uint8_t variant, uint8_t stage);
 
+    bool getCompressedTextShader(Unflattener unflattener, ShaderBuilder& shaderBuilder,
+            uint8_t shaderModel, uint8_t variant, uint8_t stage);
+
+    bool getBinaryShader(Unflattener unflattener, ShaderBuilder& shaderBuilder,
+            uint8_t shaderModel, uint8_t variant, uint8_t stage);
+
     bool getSpirvShader(
             BlobDictionary const& dictionary, ShaderBuilder& shaderBuilder,
             uint8_t shaderModel, uint8_t variant, uint8_t stage);
@@ -21,8 +21,21 @@
 
 #include <utils/Log.h>
 
+#if defined(FILAMENT_SUPPORTS_COMPRESSED_MATERIALS)
+#include <zlib.h>
+#endif
+
 namespace filaflat {
 
+#if defined(FILAMENT_SUPPORTS_COMPRESSED_MATERIALS)
+static constexpr uint32_t COMPRESSION_SCHEME_ZLIB = 1;
+#endif
+
+static bool isCompressed(filamat::ChunkType materialTag) noexcept {
+    return materialTag == filamat::ChunkType::MaterialGlslCompressed ||
+            materialTag == filamat::ChunkType::MaterialMetalCompressed;
+}
+
 static inline uint32_t makeKey(uint8_t shaderModel, uint8_t variant, uint8_t type) noexcept {
     return (shaderModel << 16) | (type << 8) | variant;
 }
@@ -42,6 +55,21 @@ bool MaterialChunk::readIndex(filamat::ChunkType materialTag) {
             mContainer.getChunkStart(materialTag),
             mContainer.getChunkEnd(materialTag));
 
+    if (isCompressed(materialTag)) {
+#if defined(FILAMENT_SUPPORTS_COMPRESSED_MATERIALS)
+        // The shaders are only decompressed when requested.
+        uint32_t scheme;
+        if (!unflattener.read(&scheme) || scheme != COMPRESSION_SCHEME_ZLIB ||
+                !unflattener.read(&mPresetDictionary, &mPresetDictionarySize)) {
+            return false;
+        }
+#else
+        utils::slog.e << "The shaders of this material are compressed, "
+                "build with FILAMENT_SUPPORTS_COMPRESSED_MATERIALS to load it." << utils::io::endl;
+        return false;
+#endif
+    }
+
     mUnflattener = unflattener;
     mMaterialTag = materialTag;
     mBase = unflattener.getCursor();
@@ -121,7 +149,7 @@ bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary const&
     // Read all lines.
     for(int32_t i = 0 ; i < lineCount; i++) {
         uint16_t lineIndex;
-        if (!unflattener.read(&lineIndex)) {
+        if (!unflattener.read(&lineIndex) || lineIndex >= dictionary.size()) {
             return false;
         }
         const char* string = dictionary.getString(lineIndex);
@@ -135,6 +163,82 @@ bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary const&
     return true;
 }
 
+bool MaterialChunk::getCompressedTextShader(Unflattener unflattener,
+        ShaderBuilder& shaderBuilder, uint8_t shaderModel, uint8_t variant, uint8_t stage) {
+#if defined(FILAMENT_SUPPORTS_COMPRESSED_MATERIALS)
+    if (mBase == nullptr) {
+        return false;
+    }
+
+    shaderBuilder.reset();
+
+    uint32_t key = makeKey(shaderModel, variant, stage);
+    auto pos = mOffsets.find(key);
+    if (pos == mOffsets.end() || pos->second == 0) {
+        return false;
+    }
+    unflattener.setCursor(mBase + pos->second);
+
+    // Read how big the shader is, including the null terminator, and its compressed data.
+    uint32_t shaderSize = 0;
+    const char* data;
+    size_t dataSize;
+    if (!unflattener.read(&shaderSize) || shaderSize == 0 ||
+            !unflattener.read(&data, &dataSize)) {
+        return false;
+    }
+
+    shaderBuilder.announce(shaderSize);
+
+    z_stream stream = {};
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    stream.next_in = (Bytef*) data;
+    stream.avail_in = uInt(dataSize);
+
+    // Decompress in slices, so that the shader is written once.
+    char buffer[16384];
+    size_t size = 0;
+    int result;
+    do {
+        stream.next_out = (Bytef*) buffer;
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_NEED_DICT) {
+            result = inflateSetDictionary(&stream,
+                    (const Bytef*) mPresetDictionary, uInt(mPresetDictionarySize));
+            if (result != Z_OK) {
+                break;
+            }
+            continue;
+        }
+        if (result != Z_OK && result != Z_STREAM_END) {
+            break;
+        }
+        const size_t count = sizeof(buffer) - stream.avail_out;
+        if (size + count >= shaderSize) {
+            // the data doesn't match the size
+            result = Z_DATA_ERROR;
+            break;
+        }
+        shaderBuilder.append(buffer, count);
+        size += count;
+    } while (result != Z_STREAM_END);
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || size + 1 != shaderSize) {
+        return false;
+    }
+
+    // Write the terminating null character.
+    shaderBuilder.append("", 1);
+
+    return true;
+#else
+    return false;
+#endif
+}
 
 bool MaterialChunk::getSpirvShader(BlobDictionary const& dictionary,
         ShaderBuilder& shaderBuilder, uint8_t shaderModel, uint8_t variant, uint8_t stage) {
@@ -159,18 +263,54 @@ bool MaterialChunk::getSpirvShader(BlobDictionary const& dictionary,
     return true;
 }
 
+bool MaterialChunk::getBinaryShader(Unflattener unflattener,
+        ShaderBuilder& shaderBuilder, uint8_t shaderModel, uint8_t variant, uint8_t stage) {
+    if (mBase == nullptr) {
+        return false;
+    }
+
+    uint32_t key = makeKey(shaderModel, variant, stage);
+    auto pos = mOffsets.find(key);
+    if (pos == mOffsets.end() || pos->second == 0) {
+        return false;
+    }
+    unflattener.setCursor(mBase + pos->second);
+
+    const char* data;
+    size_t dataSize;
+    if (!unflattener.read(&data, &dataSize)) {
+        return false;
+    }
+
+    shaderBuilder.reset();
+    shaderBuilder.announce(dataSize);
+    shaderBuilder.append(data, dataSize);
+    return true;
+}
+
 bool MaterialChunk::getShader(ShaderBuilder& shaderBuilder,
         BlobDictionary const& dictionary, uint8_t shaderModel, uint8_t variant, uint8_t stage) {
     switch (mMaterialTag) {
         case filamat::ChunkType::MaterialGlsl:
         case filamat::ChunkType::MaterialMetal:
             return getTextShader(mUnflattener, dictionary, shaderBuilder, shaderModel, variant, stage);
+        case filamat::ChunkType::MaterialGlslCompressed:
+        case filamat::ChunkType::MaterialMetalCompressed:
+            return getCompressedTextShader(mUnflattener, shaderBuilder,
+                    shaderModel, variant, stage);
         case filamat::ChunkType::MaterialSpirv:
             return getSpirvShader(dictionary, shaderBuilder, shaderModel, variant, stage);
+        case filamat::ChunkType::MaterialMetalLibrary:
+            return getBinaryShader(mUnflattener, shaderBuilder, shaderModel, variant, stage);
         default:
             return false;
     }
 }
 
+bool MaterialChunk::hasShader(uint8_t shaderModel, uint8_t variant, uint8_t stage) const noexcept {
+    return mBase != nullptr &&
+            mOffsets.find(makeKey(shaderModel, variant, stage)) != mOffsets.end();
+}
+
 } // namespace filaflat
 
@@ -23,6 +23,7 @@
 #include <cstdint>
 
 #include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -104,6 +105,7 @@ protected:
     Optimization mOptimization = Optimization::PERFORMANCE;
     bool mPrintShaders = false;
     bool mGenerateDebugInfo = false;
+    bool mInferPrecision = false;
     utils::bitset32 mShaderModels;
     struct CodeGenParams {
         int shaderModel;
@@ -419,9 +421,24 @@ public:
      */
     MaterialBuilder& clearCoatIorChange(bool clearCoatIorChange) noexcept;
 
+    /**
+     * Enables or disables foveated rendering of this material, when the View enables it (see
+     * View::setFoveationOptions()). Disable it for content that must be shaded at full rate
+     * everywhere, e.g. text. A color pass drawing such a material isn't foveated.
+     *
+     * Enabled by default.
+     */
+    MaterialBuilder& foveation(bool foveation) noexcept;
+
     //! Enable / disable flipping of the Y coordinate of UV attributes, enabled by default.
     MaterialBuilder& flipUV(bool flipUV) noexcept;
 
+    /**
+     * Allows the precision of the shaders of this material to be lowered when inferPrecision()
+     * is enabled. Disable it for materials that need highp intermediates. Enabled by default.
+     */
+    MaterialBuilder& relaxPrecision(bool relaxPrecision) noexcept;
+
     //! Enable / disable multi-bounce ambient occlusion, disabled by default on mobile.
     MaterialBuilder& multiBounceAmbientOcclusion(bool multiBounceAO) noexcept;
 
@@ -466,9 +483,63 @@ public:
     //! If true, will include debugging information in generated SPIRV.
     MaterialBuilder& generateDebugInfo(bool generateDebugInfo) noexcept;
 
+    /**
+     * If true, the optimized mobile fragment shaders (GLSL ES and SPIR-V) compute in mediump the
+     * values derived only from mediump values, e.g. colors and lighting terms, instead of the
+     * highp the optimizer falls back to. Values used as texture coordinates, by derivatives, by
+     * the depth output or converted to integers stay highp, and the mediump values already used
+     * this way are reported. Materials can opt out with relaxPrecision(). Requires an
+     * optimization level of SIZE or PERFORMANCE and is ignored by filamat_lite. Disabled by
+     * default.
+     */
+    MaterialBuilder& inferPrecision(bool inferPrecision) noexcept;
+
     //! Specifies a list of variants that should be filtered out during code generation.
     MaterialBuilder& variantFilter(uint8_t variantFilter) noexcept;
 
+    /**
+     * Specifies a directory where the optimized GLSL, SPIR-V and MSL of the shaders are cached
+     * across builds. Shaders found in the cache skip glslang, SPIRV-Tools and SPIRV-Cross. The
+     * directory is created if needed and can be shared by concurrent builds. By default, or if
+     * the path is null or empty, the shaders are only cached in memory, which deduplicates the
+     * shaders shared by the materials built until the last call to shutdown(). Ignored by
+     * filamat_lite.
+     */
+    MaterialBuilder& shaderCacheDirectory(const char* path) noexcept;
+
+    /**
+     * Specifies a shared dictionary, built with buildSharedDictionary(). The lines of the GLSL
+     * and MSL shaders that are in the dictionary are not stored in the package, which references
+     * the dictionary instead: it must be loaded with Engine::loadShaderDictionary() before the
+     * material is created. The data is copied, build() fails if it isn't a shared dictionary.
+     * SPIR-V shaders are not affected.
+     */
+    MaterialBuilder& sharedDictionary(const void* data, size_t size) noexcept;
+
+    /**
+     * Compresses each GLSL and MSL shader on its own, rather than storing their lines in the text
+     * dictionary of the package. The packages are smaller and the engine only decompresses the
+     * shaders of the variants it uses, but they can only be loaded by an engine built with
+     * FILAMENT_SUPPORTS_COMPRESSED_MATERIALS. When set, the shared dictionary is ignored. SPIR-V
+     * shaders are not affected. Ignored by filamat_lite. Disabled by default.
+     */
+    MaterialBuilder& compressShaders(bool compressShaders) noexcept;
+
+    /**
+     * Compiles the MSL of a shader into a Metal library (the contents of a .metallib file) for
+     * the given shader model. Returns false on failure. Called from several threads at once.
+     */
+    using MetalLibraryCompiler = std::function<bool(const std::string& msl,
+            ShaderModel shaderModel, std::vector<uint8_t>& library)>;
+
+    /**
+     * Sets a compiler used to precompile the Metal shaders, e.g. by invoking the Metal toolchain.
+     * The libraries are stored in the package along with the MSL, and the Metal backend loads
+     * them instead of compiling the MSL at runtime. build() fails if a shader can't be compiled.
+     * Ignored by filamat_lite. Not set by default.
+     */
+    MaterialBuilder& metalLibraryCompiler(MetalLibraryCompiler compiler) noexcept;
+
     //! Adds a new preprocessor macro definition to the shader code. Can be called repeatedly.
     MaterialBuilder& shaderDefine(const char* name, const char* value) noexcept;
 
@@ -484,6 +555,15 @@ public:
      */
     Package build(utils::JobSystem& jobSystem) noexcept;
 
+    /**
+     * Builds a shared dictionary holding the lines of the GLSL and MSL shaders that at least
+     * minMaterialCount of the given material packages have in common, see sharedDictionary().
+     * The materials must have been built without a shared dictionary. Returns an invalid package
+     * on failure.
+     */
+    static Package buildSharedDictionary(const Package* materials, size_t count,
+            size_t minMaterialCount = 2) noexcept;
+
 public:
     // The methods and types below are for internal use
     /// @cond never
@@ -610,6 +690,16 @@ private:
 
     utils::CString mMaterialName;
     utils::CString mFileName;
+    utils::CString mShaderCacheDirectory;
+
+    // lines of the shared dictionary, its id is 0 if there is none
+    std::vector<std::string> mSharedDictionaryLines;
+    uint64_t mSharedDictionaryId = 0;
+    bool mSharedDictionaryInvalid = false;
+
+    bool mCompressShaders = false;
+
+    MetalLibraryCompiler mMetalLibraryCompiler;
 
     class ShaderCode {
     public:
@@ -675,9 +765,12 @@ private:
 
     bool mSpecularAntiAliasing = false;
     bool mClearCoatIorChange = true;
+    bool mFoveation = true;
 
     bool mFlipUV = true;
 
+    bool mRelaxPrecision = true;
+
     bool mMultiBounceAO = false;
     bool mMultiBounceAOSet = false;
 
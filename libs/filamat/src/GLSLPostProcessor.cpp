@@ -29,6 +29,8 @@
 #include "sca/builtinResource.h"
 #include "sca/GLSLTools.h"
 
+#include "PrecisionInference.h"
+
 #include <utils/Log.h>
 
 using namespace glslang;
@@ -40,7 +42,8 @@ namespace filamat {
 GLSLPostProcessor::GLSLPostProcessor(MaterialBuilder::Optimization optimization, uint32_t flags)
         : mOptimization(optimization),
           mPrintShaders(flags & PRINT_SHADERS),
-          mGenerateDebugInfo(flags & GENERATE_DEBUG_INFO) {
+          mGenerateDebugInfo(flags & GENERATE_DEBUG_INFO),
+          mInferPrecision(flags & INFER_PRECISION) {
 }
 
 GLSLPostProcessor::~GLSLPostProcessor() {
@@ -321,6 +324,22 @@ void GLSLPostProcessor::fullOptimization(const TShader& tShader,
     OptimizerPtr optimizer = createOptimizer(mOptimization, config);
     optimizeSpirv(optimizer, spirv);
 
+    // Restore the mediump precision lost by the optimizer, for the ES GLSL and the mobile SPIR-V.
+    if (mInferPrecision && config.shaderType == filament::backend::FRAGMENT &&
+            config.shaderModel == filament::backend::ShaderModel::GL_ES_30) {
+        PrecisionReport report;
+        if (!inferRelaxedPrecision(spirv, &report)) {
+            utils::slog.w << "Precision inference could not parse the SPIR-V" << utils::io::endl;
+        } else if (report.getWarningCount()) {
+            utils::slog.w << "Warning: mediump values are used by "
+                    << report.mediumpTextureCoordinates << " texture coordinates, "
+                    << report.mediumpDerivatives << " derivatives, "
+                    << report.mediumpDepthOutputs << " depth outputs and "
+                    << report.mediumpIntegerConversions << " conversions to integers"
+                    << utils::io::endl;
+        }
+    }
+
     if (internalConfig.spirvOutput) {
         *internalConfig.spirvOutput = spirv;
     }
@@ -41,6 +41,7 @@ public:
     enum Flags : uint32_t {
         PRINT_SHADERS = 1 << 0,
         GENERATE_DEBUG_INFO = 1 << 1,
+        INFER_PRECISION = 1 << 2,
     };
 
     GLSLPostProcessor(MaterialBuilder::Optimization optimization, uint32_t flags);
@@ -94,6 +95,7 @@ private:
     const MaterialBuilder::Optimization mOptimization;
     const bool mPrintShaders;
     const bool mGenerateDebugInfo;
+    const bool mInferPrecision;
 };
 
 } // namespace filamat
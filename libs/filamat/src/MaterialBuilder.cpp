@@ -17,11 +17,11 @@
 #include "filamat/MaterialBuilder.h"
 
 #include <atomic>
+#include <unordered_map>
 #include <vector>
 
 #include <utils/JobSystem.h>
 #include <utils/Log.h>
-#include <utils/Mutex.h>
 #include <utils/Panic.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
@@ -45,9 +45,13 @@
 #include "eiff/DictionarySpirvChunk.h"
 
 #include "Includes.h"
+#include "SharedDictionary.h"
 
 #ifndef FILAMAT_LITE
 #include "GLSLPostProcessor.h"
+#include "ShaderCache.h"
+#include "eiff/MaterialBinaryChunk.h"
+#include "eiff/MaterialCompressedTextChunk.h"
 #include "sca/GLSLTools.h"
 #else
 #include "sca/GLSLToolsLite.h"
@@ -124,9 +128,12 @@ void MaterialBuilderBase::init() {
 }
 
 void MaterialBuilderBase::shutdown() {
-    materialBuilderClients--;
+    const int clients = --materialBuilderClients;
 #ifndef FILAMAT_LITE
     GLSLTools::shutdown();
+    if (clients == 0) {
+        ShaderCache::clearMemoryCache();
+    }
 #endif
 }
 
@@ -334,11 +341,21 @@ MaterialBuilder& MaterialBuilder::clearCoatIorChange(bool clearCoatIorChange) no
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::foveation(bool foveation) noexcept {
+    mFoveation = foveation;
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::flipUV(bool flipUV) noexcept {
     mFlipUV = flipUV;
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::relaxPrecision(bool relaxPrecision) noexcept {
+    mRelaxPrecision = relaxPrecision;
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::multiBounceAmbientOcclusion(bool multiBounceAO) noexcept {
     mMultiBounceAO = multiBounceAO;
     mMultiBounceAOSet = true;
@@ -381,11 +398,42 @@ MaterialBuilder& MaterialBuilder::generateDebugInfo(bool generateDebugInfo) noex
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::inferPrecision(bool inferPrecision) noexcept {
+    mInferPrecision = inferPrecision;
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::variantFilter(uint8_t variantFilter) noexcept {
     mVariantFilter = variantFilter;
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::shaderCacheDirectory(const char* path) noexcept {
+    mShaderCacheDirectory = CString(path);
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::sharedDictionary(const void* data, size_t size) noexcept {
+    mSharedDictionaryInvalid = !readTextDictionary(static_cast<const uint8_t*>(data), size,
+            &mSharedDictionaryId, &mSharedDictionaryLines) || !mSharedDictionaryId ||
+            mSharedDictionaryLines.size() > MAX_SHARED_DICTIONARY_LINES;
+    if (mSharedDictionaryInvalid) {
+        mSharedDictionaryId = 0;
+        mSharedDictionaryLines.clear();
+    }
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::compressShaders(bool compressShaders) noexcept {
+    mCompressShaders = compressShaders;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::metalLibraryCompiler(MetalLibraryCompiler compiler) noexcept {
+    mMetalLibraryCompiler = std::move(compiler);
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::shaderDefine(const char* name, const char* value) noexcept {
     mDefines.emplace_back(name, value);
     return *this;
@@ -591,7 +639,8 @@ static void showErrorMessage(const char* materialName, uint8_t variant,
     utils::slog.e
             << "Error in \"" << materialName << "\""
             << ", Variant 0x" << io::hex << (int) variant
-            << (targetApi == TargetApi::VULKAN ? ", Vulkan.\n" : ", OpenGL.\n")
+            << (targetApi == TargetApi::VULKAN ? ", Vulkan.\n" :
+                targetApi == TargetApi::METAL ? ", Metal.\n" : ", OpenGL.\n")
             << "=========================\n"
             << "Generated "
             << (shaderType == ShaderType::VERTEX ? "Vertex Shader\n" : "Fragment Shader\n")
@@ -606,19 +655,13 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
     uint32_t flags = 0;
     flags |= mPrintShaders ? GLSLPostProcessor::PRINT_SHADERS : 0;
     flags |= mGenerateDebugInfo ? GLSLPostProcessor::GENERATE_DEBUG_INFO : 0;
+    flags |= (mInferPrecision && mRelaxPrecision) ? GLSLPostProcessor::INFER_PRECISION : 0;
     GLSLPostProcessor postProcessor(mOptimization, flags);
-#endif
 
-    // Start: must be protected by lock
-    Mutex entriesLock;
-    std::vector<TextEntry> glslEntries;
-    std::vector<SpirvEntry> spirvEntries;
-    std::vector<TextEntry> metalEntries;
-    LineDictionary textDictionary;
-#ifndef FILAMAT_LITE
-    BlobDictionary spirvDictionary;
+    // shaders identical to ones of this or other materials built since init() are only
+    // compiled once, even without a cache directory
+    ShaderCache shaderCache(mShaderCacheDirectory.c_str_safe());
 #endif
-    // End: must be protected by lock
 
     ShaderGenerator sg(
             mProperties, mVariables, mOutputs, mDefines, mMaterialCode.getResolved(),
@@ -630,59 +673,56 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
             mBlendingMode == BlendingMode::MASKED || !emptyVertexCode;
     container.addSimpleChild<bool>(ChunkType::MaterialHasCustomDepthShader, customDepth);
 
+    for (const auto& params : mCodeGenPermutations) {
+        assertSingleTargetApi(params.targetApi);
+    }
+
+    // Output of the job of a (permutation, variant) pair. Each job writes to its own result,
+    // which are gathered into the chunks once all the jobs are done, in a deterministic order.
+    struct ShaderResult {
+        std::string shader; // GLSL
+        std::vector<uint32_t> spirv;
+        std::string msl;
+        std::vector<uint8_t> metalLibrary;
+    };
+    const size_t variantCount = variants.size();
+    std::vector<ShaderResult> results(mCodeGenPermutations.size() * variantCount);
+
     std::atomic_bool cancelJobs(false);
-    bool firstJob = true;
 
-    for (const auto& params : mCodeGenPermutations) {
-        if (cancelJobs.load()) {
-            return false;
-        }
+    // All the jobs are children of the same parent, so that the variants of all the
+    // permutations are compiled in parallel.
+    JobSystem::Job* parent = jobSystem.createJob();
 
+    for (size_t p = 0, c = mCodeGenPermutations.size(); p < c; p++) {
+        const CodeGenParams& params = mCodeGenPermutations[p];
         const ShaderModel shaderModel = ShaderModel(params.shaderModel);
         const TargetApi targetApi = params.targetApi;
         const TargetLanguage targetLanguage = params.targetLanguage;
 
-        assertSingleTargetApi(targetApi);
-
         // Metal Shading Language is cross-compiled from Vulkan.
         const bool targetApiNeedsSpirv =
                 (targetApi == TargetApi::VULKAN || targetApi == TargetApi::METAL);
         const bool targetApiNeedsMsl = targetApi == TargetApi::METAL;
         const bool targetApiNeedsGlsl = targetApi == TargetApi::OPENGL;
 
-        // Set when a job fails
-        JobSystem::Job* parent = jobSystem.createJob();
-
-        for (const auto& v : variants) {
-            JobSystem::Job* job = jobs::createJob(jobSystem, parent, [&]() {
+        for (size_t i = 0; i < variantCount; i++) {
+            JobSystem::Job* job = jobs::createJob(jobSystem, parent,
+                    [&, v = variants[i], &result = results[p * variantCount + i],
+                            shaderModel, targetApi, targetLanguage,
+                            targetApiNeedsSpirv, targetApiNeedsMsl, targetApiNeedsGlsl]() {
                 if (cancelJobs.load()) {
                     return;
                 }
 
-                // TODO: avoid allocations when not required
-                std::vector<uint32_t> spirv;
-                std::string msl;
-
-                std::vector<uint32_t>* pSpirv = targetApiNeedsSpirv ? &spirv : nullptr;
-                std::string* pMsl = targetApiNeedsMsl ? &msl : nullptr;
-
-                TextEntry glslEntry{0};
-                SpirvEntry spirvEntry{0};
-                TextEntry metalEntry{0};
-
-                glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-                spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-                metalEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-
-                glslEntry.variant = v.variant;
-                spirvEntry.variant = v.variant;
-                metalEntry.variant = v.variant;
+                std::vector<uint32_t>* pSpirv = targetApiNeedsSpirv ? &result.spirv : nullptr;
+                std::string* pMsl = targetApiNeedsMsl ? &result.msl : nullptr;
 
                 // Generate raw shader code.
                 // The quotes in Google-style line directives cause problems with certain drivers. These
                 // directives are optimized away when using the full filamat, so down below we
                 // explicitly remove them when using filamat lite.
-                std::string shader;
+                std::string& shader = result.shader;
                 if (v.stage == filament::backend::ShaderType::VERTEX) {
                     shader = sg.createVertexProgram(
                             shaderModel, targetApi, targetLanguage, info, v.variant,
@@ -718,7 +758,23 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                     config.glsl.subpassInputToColorLocation.emplace_back(0, 0);
                 }
 
-                bool ok = postProcessor.process(shader, config, pGlsl, pSpirv, pMsl);
+                // without optimization, nothing is worth caching for OpenGL; the cache is also
+                // bypassed when printing the shaders, since they're printed by the post-processor
+                std::string cacheKey;
+                const bool useCache = !mPrintShaders &&
+                        (pSpirv || mEnableFramebufferFetch || mOptimization != Optimization::NONE);
+                if (useCache) {
+                    cacheKey = ShaderCache::getKey(shader, config, mOptimization, flags,
+                            pGlsl != nullptr, pSpirv != nullptr, pMsl != nullptr);
+                }
+
+                bool ok = true;
+                if (!useCache || !shaderCache.get(cacheKey, pGlsl, pSpirv, pMsl)) {
+                    ok = postProcessor.process(shader, config, pGlsl, pSpirv, pMsl);
+                    if (ok && useCache) {
+                        shaderCache.put(cacheKey, pGlsl, pSpirv, pMsl);
+                    }
+                }
 #else
                 bool ok = true;
 #endif
@@ -728,71 +784,140 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
                     return;
                 }
 
+#ifndef FILAMAT_LITE
+                if (pMsl && mMetalLibraryCompiler &&
+                        !mMetalLibraryCompiler(*pMsl, shaderModel, result.metalLibrary)) {
+                    showErrorMessage(mMaterialName.c_str_safe(), v.variant, targetApi, v.stage,
+                            *pMsl);
+                    cancelJobs = true;
+                    return;
+                }
+#endif
+
                 if (targetApi == TargetApi::OPENGL) {
                     if (targetLanguage == TargetLanguage::SPIRV) {
                         sg.fixupExternalSamplers(shaderModel, shader, info);
                     }
                 }
+            });
 
-                // NOTE: Everything below touches shared structures protected by a lock
-                // NOTE: do not execute expensive work from here on!
-                std::unique_lock<utils::Mutex> lock(entriesLock);
+            // NOTE: We run the first job separately to work the lack of thread safety
+            //       guarantees in glslang. This library performs unguarded global
+            //       operations on first use.
+            if (p == 0 && i == 0) {
+                jobSystem.runAndWait(job);
+            } else {
+                jobSystem.run(job);
+            }
+        }
+    }
 
-                if (targetApi == TargetApi::OPENGL) {
-                    glslEntry.stage = v.stage;
-                    glslEntry.shader = shader;
+    jobSystem.runAndWait(parent);
+
+    if (cancelJobs.load()) {
+        return false;
+    }
 
+    // Gather the results into the dictionaries and the entries.
+    std::vector<TextEntry> glslEntries;
+    std::vector<SpirvEntry> spirvEntries;
+    std::vector<TextEntry> metalEntries;
+    std::vector<BinaryEntry> metalLibraryEntries;
+    LineDictionary textDictionary;
+#ifndef FILAMAT_LITE
+    BlobDictionary spirvDictionary;
+    // compressed shaders don't use the text dictionary, so neither the shared one
+    const bool compressShaders = mCompressShaders;
+#else
+    const bool compressShaders = false;
+#endif
+    if (!compressShaders) {
+        textDictionary.addSharedLines(mSharedDictionaryLines);
+    }
+
+    for (size_t p = 0, c = mCodeGenPermutations.size(); p < c; p++) {
+        const CodeGenParams& params = mCodeGenPermutations[p];
+        const TargetApi targetApi = params.targetApi;
+        for (size_t i = 0; i < variantCount; i++) {
+            const Variant& v = variants[i];
+            ShaderResult& result = results[p * variantCount + i];
+
+            if (targetApi == TargetApi::OPENGL) {
+                TextEntry glslEntry{ uint8_t(params.shaderModel), v.variant, uint8_t(v.stage) };
+                glslEntry.shader = std::move(result.shader);
+
+                if (!compressShaders) {
                     textDictionary.addText(glslEntry.shader);
-                    glslEntries.push_back(glslEntry);
                 }
+                glslEntries.push_back(std::move(glslEntry));
+            }
 
 #ifndef FILAMAT_LITE
-                if (targetApi == TargetApi::VULKAN) {
-                    assert(!spirv.empty());
-                    spirvEntry.stage = v.stage;
+            if (targetApi == TargetApi::VULKAN) {
+                assert(!result.spirv.empty());
+                SpirvEntry spirvEntry{ uint8_t(params.shaderModel), v.variant, uint8_t(v.stage) };
 
-                    spirvEntry.dictionaryIndex = spirvDictionary.addBlob(spirv);
-                    spirvEntries.push_back(spirvEntry);
-                }
+                spirvEntry.dictionaryIndex = spirvDictionary.addBlob(result.spirv);
+                spirvEntries.push_back(spirvEntry);
+            }
 
-                if (targetApi == TargetApi::METAL) {
-                    assert(!spirv.empty());
-                    assert(msl.length() > 0);
-                    metalEntry.stage = v.stage;
-                    metalEntry.shader = msl;
+            if (targetApi == TargetApi::METAL) {
+                assert(!result.spirv.empty());
+                assert(result.msl.length() > 0);
+                TextEntry metalEntry{ uint8_t(params.shaderModel), v.variant, uint8_t(v.stage) };
+                metalEntry.shader = std::move(result.msl);
 
-                    textDictionary.addText(metalEntry.shader);
-                    metalEntries.push_back(metalEntry);
+                if (!result.metalLibrary.empty()) {
+                    metalLibraryEntries.push_back({ uint8_t(params.shaderModel), v.variant,
+                            uint8_t(v.stage), std::move(result.metalLibrary) });
                 }
-#endif
-            });
 
-            // NOTE: We run the first job separately to work the lack of thread safety
-            //       guarantees in glslang. This library performs unguarded global
-            //       operations on first use.
-            if (firstJob) {
-                jobSystem.runAndWait(job);
-                firstJob = false;
-            } else {
-                jobSystem.run(job);
+                if (!compressShaders) {
+                    textDictionary.addText(metalEntry.shader);
+                }
+                metalEntries.push_back(std::move(metalEntry));
             }
+#endif
         }
-
-        jobSystem.runAndWait(parent);
     }
 
-    if (cancelJobs.load()) {
+    // Lines are indexed with 16 bits.
+    if (textDictionary.getLineCount() > UINT16_MAX + 1u) {
+        utils::slog.e << "Error: the shaders of material '" << mMaterialName.c_str_safe()
+                << "' have too many distinct lines." << utils::io::endl;
         return false;
     }
 
-    // Emit dictionary chunk (TextDictionaryReader and DictionaryTextChunk)
-    const auto& dictionaryChunk = container.addChild<filamat::DictionaryTextChunk>(
-            std::move(textDictionary), ChunkType::DictionaryText);
+#ifndef FILAMAT_LITE
+    if (compressShaders) {
+        // Emit the compressed GLSL and Metal chunks (MaterialCompressedTextChunk)
+        if (!glslEntries.empty() && !container.addChild<MaterialCompressedTextChunk>(
+                std::move(glslEntries), ChunkType::MaterialGlslCompressed).isValid()) {
+            return false;
+        }
+        if (!metalEntries.empty() && !container.addChild<MaterialCompressedTextChunk>(
+                std::move(metalEntries), ChunkType::MaterialMetalCompressed).isValid()) {
+            return false;
+        }
+    }
+#endif
+
+    const DictionaryTextChunk* dictionaryChunk = nullptr;
+    if (!compressShaders) {
+        // Reference the shared dictionary, whose lines come first
+        if (mSharedDictionaryId) {
+            container.addSimpleChild<uint64_t>(ChunkType::DictionaryShared, mSharedDictionaryId);
+        }
+
+        // Emit dictionary chunk (TextDictionaryReader and DictionaryTextChunk)
+        dictionaryChunk = &container.addChild<filamat::DictionaryTextChunk>(
+                std::move(textDictionary), ChunkType::DictionaryText);
 
-    // Emit GLSL chunk (MaterialTextChunk).
-    if (!glslEntries.empty()) {
-        container.addChild<MaterialTextChunk>(std::move(glslEntries),
-                dictionaryChunk.getDictionary(), ChunkType::MaterialGlsl);
+        // Emit GLSL chunk (MaterialTextChunk).
+        if (!glslEntries.empty()) {
+            container.addChild<MaterialTextChunk>(std::move(glslEntries),
+                    dictionaryChunk->getDictionary(), ChunkType::MaterialGlsl);
+        }
     }
 
     // Emit SPIRV chunks (SpirvDictionaryReader and MaterialSpirvChunk).
@@ -804,9 +929,15 @@ bool MaterialBuilder::generateShaders(JobSystem& jobSystem, const std::vector<Va
     }
 
     // Emit Metal chunk (MaterialTextChunk).
-    if (!metalEntries.empty()) {
+    if (!metalEntries.empty() && dictionaryChunk) {
         container.addChild<MaterialTextChunk>(std::move(metalEntries),
-                dictionaryChunk.getDictionary(), ChunkType::MaterialMetal);
+                dictionaryChunk->getDictionary(), ChunkType::MaterialMetal);
+    }
+
+    // Emit the precompiled Metal chunk (MaterialBinaryChunk).
+    if (!metalLibraryEntries.empty()) {
+        container.addChild<MaterialBinaryChunk>(std::move(metalLibraryEntries),
+                ChunkType::MaterialMetalLibrary);
     }
 #endif
 
@@ -874,6 +1005,11 @@ Package MaterialBuilder::build(JobSystem& jobSystem) noexcept {
         output(VariableQualifier::OUT, OutputTarget::COLOR, OutputType::FLOAT4, "color");
     }
 
+    if (mSharedDictionaryInvalid) {
+        utils::slog.e << "Error: invalid shared dictionary." << utils::io::endl;
+        return Package::invalidPackage();
+    }
+
     // Resolve all the #include directives within user code.
     if (!mMaterialCode.resolveIncludes(mIncludeCallback, mFileName) ||
         !mMaterialVertexCode.resolveIncludes(mIncludeCallback, mFileName)) {
@@ -923,6 +1059,62 @@ Package MaterialBuilder::build(JobSystem& jobSystem) noexcept {
     return package;
 }
 
+Package MaterialBuilder::buildSharedDictionary(const Package* materials, size_t count,
+        size_t minMaterialCount) noexcept {
+    // count the materials each line appears in, a text dictionary has no duplicates
+    std::unordered_map<std::string, size_t> materialCounts;
+    std::vector<std::string> lines;
+    std::vector<std::string> materialLines;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t sharedDictionaryId;
+        if (!materials[i].isValid() || !readTextDictionary(materials[i].getData(),
+                materials[i].getSize(), &sharedDictionaryId, &materialLines)) {
+            utils::slog.e << "Error: invalid material package." << utils::io::endl;
+            return Package::invalidPackage();
+        }
+        if (sharedDictionaryId) {
+            utils::slog.e << "Error: the materials of a shared dictionary must not use one."
+                    << utils::io::endl;
+            return Package::invalidPackage();
+        }
+        for (std::string& line : materialLines) {
+            auto pos = materialCounts.find(line);
+            if (pos == materialCounts.end()) {
+                materialCounts.emplace(line, 1);
+                lines.push_back(std::move(line));
+            } else {
+                pos->second++;
+            }
+        }
+    }
+
+    // keep the order in which the lines first appear, so that the dictionary is deterministic
+    std::string text;
+    std::vector<std::string> sharedLines;
+    for (std::string& line : lines) {
+        if (sharedLines.size() == MAX_SHARED_DICTIONARY_LINES) {
+            break;
+        }
+        if (materialCounts[line] >= minMaterialCount) {
+            text.append(line).append("\n");
+            sharedLines.push_back(std::move(line));
+        }
+    }
+
+    LineDictionary dictionary;
+    dictionary.addText(text);
+
+    ChunkContainer container;
+    container.addSimpleChild<uint64_t>(ChunkType::DictionaryShared,
+            getSharedDictionaryId(sharedLines));
+    container.addChild<DictionaryTextChunk>(std::move(dictionary), ChunkType::DictionaryText);
+
+    Package package(container.getSize());
+    Flattener f(package);
+    container.flatten(f);
+    return package;
+}
+
 const std::string MaterialBuilder::peek(filament::backend::ShaderType type,
         const CodeGenParams& params, const PropertyList& properties) noexcept {
     ShaderGenerator sg(properties, mVariables, mOutputs, mDefines, mMaterialCode.getResolved(),
@@ -996,6 +1188,7 @@ void MaterialBuilder::writeSurfaceChunks(ChunkContainer& container) const noexce
     }
 
     container.addSimpleChild<bool>(ChunkType::MaterialClearCoatIorChange, mClearCoatIorChange);
+    container.addSimpleChild<bool>(ChunkType::MaterialFoveation, mFoveation);
     container.addSimpleChild<uint32_t>(ChunkType::MaterialRequiredAttributes, mRequiredAttributes.getValue());
     container.addSimpleChild<bool>(ChunkType::MaterialSpecularAntiAliasing, mSpecularAntiAliasing);
     container.addSimpleChild<float>(ChunkType::MaterialSpecularAntiAliasingVariance, mSpecularAntiAliasingVariance);
@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "PrecisionInference.h"
+
+#include <GLSL.std.450.h>
+#include <spirv.hpp>
+#include <spirv-tools/libspirv.h>
+
+namespace filamat {
+
+using namespace spv;
+
+namespace {
+
+class PrecisionAnalyzer {
+public:
+    PrecisionAnalyzer(const uint32_t* base, uint32_t bound) : mIds(bound), mBase(base) { }
+
+    static spv_result_t parseInstruction(void* user, const spv_parsed_instruction_t* instruction) {
+        return static_cast<PrecisionAnalyzer*>(user)->addInstruction(*instruction);
+    }
+
+    void run(PrecisionReport& report);
+
+    // where the new decorations go, in words from the start of the module
+    size_t getInsertOffset() const noexcept { return mInsertOffset; }
+    const std::vector<uint32_t>& getRelaxedIds() const noexcept { return mRelaxedIds; }
+
+private:
+    enum class Sensitivity : uint8_t {
+        NONE, TEXTURE_COORDINATE, DERIVATIVE, DEPTH_OUTPUT, INTEGER_CONVERSION
+    };
+
+    struct Instruction {
+        uint32_t resultId;
+        Sensitivity sensitivity;
+        std::vector<uint32_t> operands;     // the id operands
+    };
+
+    struct Id {
+        uint32_t type = 0;
+        bool floatType = false;         // for type ids, whether it's a float scalar, vector or matrix
+        bool constant = false;
+        bool decorated = false;         // already RelaxedPrecision
+        bool fragDepth = false;
+        int32_t candidate = -1;         // index of the instruction computing it, if inferred
+        bool reached = false;           // derives from a mediump value
+        bool relaxed = false;
+        bool high = false;              // feeds a precision-sensitive operation
+    };
+
+    spv_result_t addInstruction(spv_parsed_instruction_t const& instruction);
+
+    bool isFloat(uint32_t id) const noexcept {
+        return id < mIds.size() && mIds[mIds[id].type].floatType;
+    }
+
+    static bool isCandidate(spv_parsed_instruction_t const& instruction) noexcept;
+    static bool isModuleHeader(Op op) noexcept;
+
+    std::vector<Id> mIds;
+    std::vector<Instruction> mInstructions;
+    std::vector<uint32_t> mRelaxedIds;
+    const uint32_t* const mBase;
+    size_t mInsertOffset = 0;
+    bool mInFunction = false;
+};
+
+bool PrecisionAnalyzer::isModuleHeader(Op op) noexcept {
+    switch (op) {
+        case OpCapability:
+        case OpExtension:
+        case OpExtInstImport:
+        case OpMemoryModel:
+        case OpEntryPoint:
+        case OpExecutionMode:
+        case OpString:
+        case OpSourceExtension:
+        case OpSource:
+        case OpSourceContinued:
+        case OpName:
+        case OpMemberName:
+        case OpModuleProcessed:
+        case OpDecorate:
+        case OpMemberDecorate:
+        case OpDecorationGroup:
+        case OpGroupDecorate:
+        case OpGroupMemberDecorate:
+        case OpDecorateId:
+        case OpDecorateString:
+        case OpMemberDecorateString:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The operations computed at the precision of their operands, the transcendental functions are
+// left out since mediump easily overflows with them.
+bool PrecisionAnalyzer::isCandidate(spv_parsed_instruction_t const& instruction) noexcept {
+    switch (Op(instruction.opcode)) {
+        case OpFNegate:
+        case OpFAdd:
+        case OpFSub:
+        case OpFMul:
+        case OpFDiv:
+        case OpFRem:
+        case OpFMod:
+        case OpVectorTimesScalar:
+        case OpMatrixTimesScalar:
+        case OpVectorTimesMatrix:
+        case OpMatrixTimesVector:
+        case OpMatrixTimesMatrix:
+        case OpOuterProduct:
+        case OpDot:
+        case OpCompositeConstruct:
+        case OpCompositeExtract:
+        case OpCompositeInsert:
+        case OpVectorShuffle:
+        case OpCopyObject:
+        case OpSelect:
+        case OpPhi:
+            return true;
+        case OpExtInst:
+            if (instruction.ext_inst_type != SPV_EXT_INST_TYPE_GLSL_STD_450) {
+                return false;
+            }
+            switch (instruction.words[4]) {
+                case GLSLstd450FAbs:
+                case GLSLstd450FSign:
+                case GLSLstd450Floor:
+                case GLSLstd450Ceil:
+                case GLSLstd450Fract:
+                case GLSLstd450Sqrt:
+                case GLSLstd450InverseSqrt:
+                case GLSLstd450FMin:
+                case GLSLstd450FMax:
+                case GLSLstd450FClamp:
+                case GLSLstd450FMix:
+                case GLSLstd450Step:
+                case GLSLstd450SmoothStep:
+                case GLSLstd450Fma:
+                case GLSLstd450Length:
+                case GLSLstd450Distance:
+                case GLSLstd450Cross:
+                case GLSLstd450Normalize:
+                case GLSLstd450FaceForward:
+                case GLSLstd450Reflect:
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+spv_result_t PrecisionAnalyzer::addInstruction(spv_parsed_instruction_t const& instruction) {
+    const Op op = Op(instruction.opcode);
+    const uint32_t* const words = instruction.words;
+
+    if (!mInsertOffset && !isModuleHeader(op)) {
+        mInsertOffset = size_t(words - mBase);
+    }
+    if (instruction.result_id >= mIds.size() || instruction.type_id >= mIds.size()) {
+        return SPV_ERROR_INVALID_ID;
+    }
+    if (instruction.result_id) {
+        mIds[instruction.result_id].type = instruction.type_id;
+    }
+
+    switch (op) {
+        case OpTypeFloat:
+            mIds[instruction.result_id].floatType = words[2] == 32;
+            return SPV_SUCCESS;
+        case OpTypeVector:
+        case OpTypeMatrix:
+            mIds[instruction.result_id].floatType = words[2] < mIds.size() &&
+                    mIds[words[2]].floatType;
+            return SPV_SUCCESS;
+        case OpDecorate:
+            if (words[1] < mIds.size()) {
+                if (words[2] == DecorationRelaxedPrecision) {
+                    mIds[words[1]].decorated = true;
+                } else if (words[2] == DecorationBuiltIn && words[3] == BuiltInFragDepth) {
+                    mIds[words[1]].fragDepth = true;
+                }
+            }
+            return SPV_SUCCESS;
+        case OpUndef:
+            mIds[instruction.result_id].constant = true;
+            return SPV_SUCCESS;
+        case OpFunction:
+            mInFunction = true;
+            return SPV_SUCCESS;
+        case OpFunctionEnd:
+            mInFunction = false;
+            return SPV_SUCCESS;
+        default:
+            break;
+    }
+
+    if ((op >= OpConstantTrue && op <= OpConstantNull) ||
+            (op >= OpSpecConstantTrue && op <= OpSpecConstantOp)) {
+        mIds[instruction.result_id].constant = true;
+        return SPV_SUCCESS;
+    }
+
+    if (!mInFunction) {
+        return SPV_SUCCESS;
+    }
+
+    Sensitivity sensitivity = Sensitivity::NONE;
+    if (op >= OpImageSampleImplicitLod && op <= OpImageRead) {
+        sensitivity = Sensitivity::TEXTURE_COORDINATE;
+    } else if (op >= OpDPdx && op <= OpFwidthCoarse) {
+        sensitivity = Sensitivity::DERIVATIVE;
+    } else if (op == OpConvertFToU || op == OpConvertFToS) {
+        sensitivity = Sensitivity::INTEGER_CONVERSION;
+    } else if (op == OpStore && words[1] < mIds.size() && mIds[words[1]].fragDepth) {
+        sensitivity = Sensitivity::DEPTH_OUTPUT;
+    }
+
+    const bool candidate = isCandidate(instruction) && isFloat(instruction.result_id) &&
+            !mIds[instruction.result_id].decorated;
+    if (!candidate && sensitivity == Sensitivity::NONE) {
+        return SPV_SUCCESS;
+    }
+
+    Instruction item{ candidate ? instruction.result_id : 0, sensitivity };
+    for (uint16_t i = 0; i < instruction.num_operands; i++) {
+        spv_parsed_operand_t const& operand = instruction.operands[i];
+        if (operand.type == SPV_OPERAND_TYPE_ID) {
+            item.operands.push_back(words[operand.offset]);
+        }
+    }
+    if (candidate) {
+        mIds[instruction.result_id].candidate = int32_t(mInstructions.size());
+    }
+    mInstructions.push_back(std::move(item));
+    return SPV_SUCCESS;
+}
+
+void PrecisionAnalyzer::run(PrecisionReport& report) {
+    // The values computed from at least one mediump value. The types and the constants are
+    // parsed first, so only the phis of loops need more than one iteration.
+    for (Id& id : mIds) {
+        id.reached = id.decorated;
+    }
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (Instruction const& instruction : mInstructions) {
+            if (!instruction.resultId || mIds[instruction.resultId].reached) {
+                continue;
+            }
+            Id& result = mIds[instruction.resultId];
+            for (uint32_t operand : instruction.operands) {
+                if (isFloat(operand) && mIds[operand].reached) {
+                    result.reached = changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Of these, the values whose float operands are all mediump or constants, starting from all
+    // of them so that the values carried by loops can stay mediump.
+    for (Id& id : mIds) {
+        id.relaxed = id.decorated || (id.candidate >= 0 && id.reached);
+    }
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (Instruction const& instruction : mInstructions) {
+            if (!instruction.resultId || !mIds[instruction.resultId].relaxed) {
+                continue;
+            }
+            Id& result = mIds[instruction.resultId];
+            for (uint32_t operand : instruction.operands) {
+                if (isFloat(operand) && !mIds[operand].constant && !mIds[operand].relaxed) {
+                    result.relaxed = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // The values feeding precision-sensitive operations are kept highp, the mediump values that
+    // already did are reported.
+    std::vector<uint32_t> stack;
+    for (Instruction const& instruction : mInstructions) {
+        if (instruction.sensitivity == Sensitivity::NONE) {
+            continue;
+        }
+        bool mediump = false;
+        for (uint32_t operand : instruction.operands) {
+            if (isFloat(operand)) {
+                mediump |= mIds[operand].decorated;
+                stack.push_back(operand);
+            }
+        }
+        if (mediump) {
+            switch (instruction.sensitivity) {
+                case Sensitivity::NONE:
+                    break;
+                case Sensitivity::TEXTURE_COORDINATE:
+                    report.mediumpTextureCoordinates++;
+                    break;
+                case Sensitivity::DERIVATIVE:
+                    report.mediumpDerivatives++;
+                    break;
+                case Sensitivity::DEPTH_OUTPUT:
+                    report.mediumpDepthOutputs++;
+                    break;
+                case Sensitivity::INTEGER_CONVERSION:
+                    report.mediumpIntegerConversions++;
+                    break;
+            }
+        }
+    }
+    while (!stack.empty()) {
+        Id& id = mIds[stack.back()];
+        stack.pop_back();
+        if (id.candidate < 0 || id.high) {
+            continue;
+        }
+        id.high = true;
+        for (uint32_t operand : mInstructions[id.candidate].operands) {
+            if (isFloat(operand)) {
+                stack.push_back(operand);
+            }
+        }
+    }
+
+    for (Instruction const& instruction : mInstructions) {
+        if (instruction.resultId && mIds[instruction.resultId].relaxed &&
+                !mIds[instruction.resultId].high) {
+            mRelaxedIds.push_back(instruction.resultId);
+        }
+    }
+    report.relaxedCount = uint32_t(mRelaxedIds.size());
+}
+
+} // anonymous namespace
+
+bool inferRelaxedPrecision(std::vector<uint32_t>& spirv, PrecisionReport* report) {
+    *report = {};
+    if (spirv.size() < 5) {
+        return false;
+    }
+
+    PrecisionAnalyzer analyzer(spirv.data(), spirv[3]);
+    spv_context context = spvContextCreate(SPV_ENV_UNIVERSAL_1_0);
+    const spv_result_t result = spvBinaryParse(context, &analyzer, spirv.data(), spirv.size(),
+            nullptr, &PrecisionAnalyzer::parseInstruction, nullptr);
+    spvContextDestroy(context);
+    if (result != SPV_SUCCESS) {
+        return false;
+    }
+
+    analyzer.run(*report);
+
+    const std::vector<uint32_t>& ids = analyzer.getRelaxedIds();
+    if (!ids.empty()) {
+        std::vector<uint32_t> decorations;
+        decorations.reserve(ids.size() * 3);
+        for (uint32_t id : ids) {
+            decorations.push_back((3u << WordCountShift) | OpDecorate);
+            decorations.push_back(id);
+            decorations.push_back(DecorationRelaxedPrecision);
+        }
+        spirv.insert(spirv.begin() + analyzer.getInsertOffset(),
+                decorations.begin(), decorations.end());
+    }
+    return true;
+}
+
+} // namespace filamat
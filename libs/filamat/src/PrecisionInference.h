@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TNT_FILAMAT_PRECISION_INFERENCE_H
+#define TNT_FILAMAT_PRECISION_INFERENCE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace filamat {
+
+struct PrecisionReport {
+    // float values newly decorated with RelaxedPrecision
+    uint32_t relaxedCount = 0;
+    // operations whose result is sensitive to precision but take a mediump value
+    uint32_t mediumpTextureCoordinates = 0;
+    uint32_t mediumpDerivatives = 0;
+    uint32_t mediumpDepthOutputs = 0;
+    uint32_t mediumpIntegerConversions = 0;
+
+    uint32_t getWarningCount() const noexcept {
+        return mediumpTextureCoordinates + mediumpDerivatives + mediumpDepthOutputs +
+                mediumpIntegerConversions;
+    }
+};
+
+/**
+ * Lowers the precision of the float values of an optimized fragment shader for mobile GPUs.
+ *
+ * The optimizer drops most of the RelaxedPrecision decorations that glslang derives from the
+ * mediump qualifiers, which makes SPIRV-Cross declare the temporaries highp and the Vulkan
+ * drivers compute them at full precision. Following the GLSL ES rules, the result of an
+ * arithmetic operation whose operands are all mediump (or constants) is made mediump again.
+ * Values that feed texture coordinates, derivatives, the depth output or conversions to integers
+ * are left alone, and the mediump values that already did are counted in the report.
+ *
+ * Returns false if the SPIR-V can't be parsed, in which case it's left untouched.
+ */
+bool inferRelaxedPrecision(std::vector<uint32_t>& spirv, PrecisionReport* report);
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_PRECISION_INFERENCE_H
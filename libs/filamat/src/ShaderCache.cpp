@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderCache.h"
+
+#include <filament/MaterialEnums.h>
+
+#include <utils/Mutex.h>
+#include <utils/Path.h>
+
+#include <ShaderLang.h>
+
+#include <spirv-tools/libspirv.h>
+
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace filamat {
+
+// Must be incremented when GLSLPostProcessor changes in a way that affects its output, this
+// invalidates the existing entries.
+static constexpr uint32_t CACHE_VERSION = 1;
+
+static constexpr uint32_t ENTRY_MAGIC = 0x43534d46; // 'FMSC'
+
+enum Outputs : uint8_t {
+    GLSL  = 0x1,
+    SPIRV = 0x2,
+    MSL   = 0x4,
+};
+
+// Entries are no longer added to the memory cache past this size, in bytes.
+static constexpr size_t MEMORY_CACHE_BUDGET = 256u * 1024u * 1024u;
+
+// Entries shared by all the instances, they're stored serialized as in the files.
+struct MemoryCache {
+    utils::Mutex lock;
+    std::unordered_map<std::string, std::string> entries;
+    size_t size = 0;
+};
+
+static MemoryCache& getMemoryCache() noexcept {
+    static MemoryCache sMemoryCache;
+    return sMemoryCache;
+}
+
+static void addToMemoryCache(const std::string& key, const std::string& entry) {
+    MemoryCache& cache = getMemoryCache();
+    std::lock_guard<utils::Mutex> guard(cache.lock);
+    const size_t size = key.size() + entry.size();
+    if (cache.size + size <= MEMORY_CACHE_BUDGET && cache.entries.emplace(key, entry).second) {
+        cache.size += size;
+    }
+}
+
+// 64-bit FNV-1a, only used to name the entries
+static uint64_t hash(const std::string& key) noexcept {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : key) {
+        h = (h ^ uint8_t(c)) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+template<typename T>
+static void write(std::string& out, T const& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write(std::string& out, const void* data, size_t size) {
+    write(out, uint64_t(size));
+    out.append(static_cast<const char*>(data), size);
+}
+
+template<typename T>
+static bool read(const std::string& in, size_t& cursor, T* value) {
+    if (in.size() - cursor < sizeof(T)) {
+        return false;
+    }
+    memcpy(value, in.data() + cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+static bool read(const std::string& in, size_t& cursor, const char** data, size_t* size) {
+    uint64_t s;
+    if (!read(in, cursor, &s) || in.size() - cursor < s) {
+        return false;
+    }
+    *data = in.data() + cursor;
+    *size = size_t(s);
+    cursor += size_t(s);
+    return true;
+}
+
+ShaderCache::ShaderCache(std::string directory) : mDirectory(std::move(directory)) {
+    if (!mDirectory.empty()) {
+        utils::Path(mDirectory).mkdirRecursive();
+    }
+}
+
+void ShaderCache::clearMemoryCache() {
+    MemoryCache& cache = getMemoryCache();
+    std::lock_guard<utils::Mutex> guard(cache.lock);
+    cache.entries.clear();
+    cache.size = 0;
+}
+
+std::string ShaderCache::getKey(const std::string& shader,
+        GLSLPostProcessor::Config const& config,
+        MaterialBuilder::Optimization optimization, uint32_t flags,
+        bool glsl, bool spirv, bool msl) {
+    // printing the shaders doesn't change the output
+    flags &= ~GLSLPostProcessor::PRINT_SHADERS;
+
+    std::ostringstream key;
+    key << "filamat " << CACHE_VERSION << " " << filament::MATERIAL_VERSION << "\n"
+        << "glslang " << glslang::GetGlslVersionString() << "\n"
+        << "spirv-tools " << spvSoftwareVersionString() << "\n"
+        << "optimization " << int(optimization) << " flags " << flags << "\n"
+        << "outputs " << glsl << spirv << msl << "\n"
+        << "stage " << int(config.shaderType) << " model " << int(config.shaderModel)
+        << " fbf " << config.hasFramebufferFetch << "\n";
+    for (auto const& subpass : config.glsl.subpassInputToColorLocation) {
+        key << "subpass " << subpass.first << " " << subpass.second << "\n";
+    }
+    key << "\n" << shader;
+    return key.str();
+}
+
+std::string ShaderCache::getPath(const std::string& key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.shader", (unsigned long long) hash(key));
+    return utils::Path::concat(mDirectory, name).getPath();
+}
+
+bool ShaderCache::load(const std::string& key, std::string* entry) const {
+    MemoryCache& cache = getMemoryCache();
+    {
+        std::lock_guard<utils::Mutex> guard(cache.lock);
+        auto pos = cache.entries.find(key);
+        if (pos != cache.entries.end()) {
+            *entry = pos->second;
+            return true;
+        }
+    }
+    if (mDirectory.empty()) {
+        return false;
+    }
+    std::ifstream file(getPath(key), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    entry->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool ShaderCache::get(const std::string& key,
+        std::string* outputGlsl, SpirvBlob* outputSpirv, std::string* outputMsl) {
+    std::string entry;
+    if (!load(key, &entry)) {
+        mMisses++;
+        return false;
+    }
+
+    size_t cursor = 0;
+    uint32_t magic;
+    const char* entryKey;
+    size_t entryKeySize;
+    uint8_t outputs;
+    if (!read(entry, cursor, &magic) || magic != ENTRY_MAGIC ||
+            !read(entry, cursor, &entryKey, &entryKeySize) ||
+            key.compare(0, std::string::npos, entryKey, entryKeySize) != 0 ||
+            !read(entry, cursor, &outputs)) {
+        // a collision or a corrupted entry, it is replaced by the caller
+        mMisses++;
+        return false;
+    }
+
+    // the outputs are part of the key, so the entry has all the ones requested
+    const char* data;
+    size_t size;
+    std::string glsl, msl;
+    SpirvBlob spirv;
+    if (outputs & GLSL) {
+        if (!read(entry, cursor, &data, &size)) {
+            mMisses++;
+            return false;
+        }
+        glsl.assign(data, size);
+    }
+    if (outputs & SPIRV) {
+        if (!read(entry, cursor, &data, &size) || size % sizeof(uint32_t)) {
+            mMisses++;
+            return false;
+        }
+        spirv.resize(size / sizeof(uint32_t));
+        memcpy(spirv.data(), data, size);
+    }
+    if (outputs & MSL) {
+        if (!read(entry, cursor, &data, &size)) {
+            mMisses++;
+            return false;
+        }
+        msl.assign(data, size);
+    }
+
+    if (outputGlsl) {
+        *outputGlsl = std::move(glsl);
+    }
+    if (outputSpirv) {
+        *outputSpirv = std::move(spirv);
+    }
+    if (outputMsl) {
+        *outputMsl = std::move(msl);
+    }
+    if (!mDirectory.empty()) {
+        // no-op if it came from memory
+        addToMemoryCache(key, entry);
+    }
+    mHits++;
+    return true;
+}
+
+void ShaderCache::put(const std::string& key,
+        const std::string* glsl, const SpirvBlob* spirv, const std::string* msl) {
+    std::string entry;
+    write(entry, ENTRY_MAGIC);
+    write(entry, key.data(), key.size());
+    write(entry, uint8_t((glsl ? GLSL : 0) | (spirv ? SPIRV : 0) | (msl ? MSL : 0)));
+    if (glsl) {
+        write(entry, glsl->data(), glsl->size());
+    }
+    if (spirv) {
+        write(entry, spirv->data(), spirv->size() * sizeof(uint32_t));
+    }
+    if (msl) {
+        write(entry, msl->data(), msl->size());
+    }
+
+    addToMemoryCache(key, entry);
+    if (mDirectory.empty()) {
+        return;
+    }
+
+    // write to a file of our own first, so that other jobs or processes never read a partial
+    // entry; if several of them write the same entry, the last one wins
+    static thread_local std::mt19937_64 sRandom{ std::random_device{}() };
+    const std::string path = getPath(key);
+    const std::string temporaryPath = path + "." + std::to_string(sRandom()) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        if (!file.write(entry.data(), entry.size())) {
+            file.close();
+            remove(temporaryPath.c_str());
+            return;
+        }
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        // rename() doesn't replace an existing file on Windows
+        remove(path.c_str());
+        if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            remove(temporaryPath.c_str());
+        }
+    }
+}
+
+} // namespace filamat
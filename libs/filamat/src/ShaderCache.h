@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_SHADERCACHE_H
+#define TNT_FILAMAT_SHADERCACHE_H
+
+#include "GLSLPostProcessor.h"
+
+#include <atomic>
+#include <string>
+
+namespace filamat {
+
+// Cache of the output of GLSLPostProcessor (optimized GLSL, SPIR-V and MSL).
+//
+// The entries are kept in memory, shared by all the ShaderCache instances of the process so that
+// identical shaders of different materials are only compiled once, until the last call to
+// MaterialBuilder::shutdown(). If a directory is given, they're also stored on disk and persist
+// across builds.
+//
+// Entries are content-addressed: the key holds the generated shader and everything else that
+// affects the output of GLSLPostProcessor (its configuration, the optimization level and the
+// versions of glslang and SPIRV-Tools). Each entry is a file named after the hash of its key,
+// the key is stored in the file and compared on lookup so that hash collisions are misses.
+//
+// The cache can be used concurrently by several jobs and processes, entries are written to a
+// temporary file first which is then renamed.
+class ShaderCache {
+public:
+    // 'directory' is created if it doesn't exist, if empty the entries are only kept in memory
+    explicit ShaderCache(std::string directory);
+
+    // Frees the entries kept in memory.
+    static void clearMemoryCache();
+
+    // Returns the key of the output of GLSLPostProcessor::process() for these parameters.
+    // 'flags' are the GLSLPostProcessor::Flags and the outputs requested are the non-null ones.
+    static std::string getKey(const std::string& shader,
+            GLSLPostProcessor::Config const& config,
+            MaterialBuilder::Optimization optimization, uint32_t flags,
+            bool glsl, bool spirv, bool msl);
+
+    // Fills the outputs that aren't null from the entry of 'key', returns false on a miss.
+    bool get(const std::string& key,
+            std::string* outputGlsl, SpirvBlob* outputSpirv, std::string* outputMsl);
+
+    // Adds an entry for 'key' with the outputs that aren't null. Failures are ignored.
+    void put(const std::string& key,
+            const std::string* glsl, const SpirvBlob* spirv, const std::string* msl);
+
+    size_t getHitCount() const noexcept { return mHits.load(std::memory_order_relaxed); }
+    size_t getMissCount() const noexcept { return mMisses.load(std::memory_order_relaxed); }
+
+private:
+    std::string getPath(const std::string& key) const;
+    bool load(const std::string& key, std::string* entry) const;
+
+    const std::string mDirectory;
+    std::atomic<size_t> mHits = { 0 };
+    std::atomic<size_t> mMisses = { 0 };
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_SHADERCACHE_H
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedDictionary.h"
+
+#include <filament/MaterialChunkType.h>
+
+#include <string.h>
+
+namespace filamat {
+
+// Values are flattened in little-endian order, see Flattener.
+template<typename T>
+static bool read(const uint8_t*& cursor, const uint8_t* end, T* value) noexcept {
+    if (size_t(end - cursor) < sizeof(T)) {
+        return false;
+    }
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        v |= T(cursor[i]) << (i * 8);
+    }
+    *value = v;
+    cursor += sizeof(T);
+    return true;
+}
+
+static bool readLines(const uint8_t* cursor, const uint8_t* end,
+        std::vector<std::string>* lines) noexcept {
+    uint32_t count;
+    if (!read(cursor, end, &count)) {
+        return false;
+    }
+    lines->clear();
+    lines->reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const void* terminator = memchr(cursor, '\0', size_t(end - cursor));
+        if (!terminator) {
+            return false;
+        }
+        const char* line = reinterpret_cast<const char*>(cursor);
+        lines->emplace_back(line, static_cast<const char*>(terminator) - line);
+        cursor = static_cast<const uint8_t*>(terminator) + 1;
+    }
+    return true;
+}
+
+bool readTextDictionary(const uint8_t* data, size_t size,
+        uint64_t* sharedDictionaryId, std::vector<std::string>* lines) noexcept {
+    *sharedDictionaryId = 0;
+    bool hasLines = false;
+    const uint8_t* cursor = data;
+    const uint8_t* const end = data + size;
+    while (cursor < end) {
+        uint64_t type;
+        uint32_t chunkSize;
+        if (!read(cursor, end, &type) || !read(cursor, end, &chunkSize) ||
+                size_t(end - cursor) < chunkSize) {
+            return false;
+        }
+        const uint8_t* chunkEnd = cursor + chunkSize;
+        if (type == ChunkType::DictionaryShared) {
+            if (!read(cursor, chunkEnd, sharedDictionaryId)) {
+                return false;
+            }
+        } else if (type == ChunkType::DictionaryText) {
+            if (!readLines(cursor, chunkEnd, lines)) {
+                return false;
+            }
+            hasLines = true;
+        }
+        cursor = chunkEnd;
+    }
+    return hasLines;
+}
+
+uint64_t getSharedDictionaryId(const std::vector<std::string>& lines) noexcept {
+    // 64-bit FNV-1a of the lines, each followed by a new line
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&h](char c) { h = (h ^ uint8_t(c)) * 0x100000001b3ull; };
+    for (const std::string& line : lines) {
+        for (char c : line) {
+            add(c);
+        }
+        add('\n');
+    }
+    return h ? h : 1;
+}
+
+} // namespace filamat
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_SHAREDDICTIONARY_H
+#define TNT_FILAMAT_SHAREDDICTIONARY_H
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filamat {
+
+// A shared dictionary holds the lines of text shaders that several materials have in common. It's
+// a package with a DictionaryShared chunk, its id, and a DictionaryText chunk. The text dictionary
+// of a material that uses it only holds the lines that follow the ones of the shared dictionary.
+
+// The number of lines of a shared dictionary is limited, so that the materials that use it can
+// still index their own lines with 16 bits.
+static constexpr size_t MAX_SHARED_DICTIONARY_LINES = 32768;
+
+// Reads the lines of the DictionaryText chunk of a package and its DictionaryShared chunk, 0 if
+// it has none. Returns false if the package is invalid or doesn't have a text dictionary.
+bool readTextDictionary(const uint8_t* data, size_t size,
+        uint64_t* sharedDictionaryId, std::vector<std::string>* lines) noexcept;
+
+// Returns the id of a shared dictionary holding these lines, never 0.
+uint64_t getSharedDictionaryId(const std::vector<std::string>& lines) noexcept;
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_SHAREDDICTIONARY_H
@@ -23,11 +23,14 @@ DictionaryTextChunk::DictionaryTextChunk(LineDictionary&& dictionary, ChunkType
 }
 
 void DictionaryTextChunk::flatten(Flattener& f) {
+    // The lines of the shared dictionary are not stored with the material
+    const size_t sharedLineCount = mDictionary.getSharedLineCount();
+
     // NumStrings
-    f.writeUint32(mDictionary.getLineCount());
+    f.writeUint32(mDictionary.getLineCount() - sharedLineCount);
 
     // Strings
-    for (size_t i = 0 ; i < mDictionary.getLineCount() ; i++) {
+    for (size_t i = sharedLineCount ; i < mDictionary.getLineCount() ; i++) {
         f.writeString(mDictionary.getString(i).c_str());
     }
 }
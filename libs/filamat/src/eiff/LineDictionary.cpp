@@ -61,6 +61,15 @@ void LineDictionary::addText(const std::string& line) noexcept {
     }
 }
 
+void LineDictionary::addSharedLines(const std::vector<std::string>& lines) noexcept {
+    assert(mStrings.empty());
+    for (const std::string& line : lines) {
+        addLine(std::string(line));
+    }
+    mSharedLineCount = mStrings.size();
+    mStorageSize = 0;
+}
+
 void LineDictionary::addLine(const std::string&& line) noexcept {
     // Never add a line twice.
     if (mLineIndices.find(line) != mLineIndices.end()) {
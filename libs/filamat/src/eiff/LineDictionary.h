@@ -33,6 +33,14 @@ public:
     void addText(const std::string& text) noexcept;
     size_t getLineCount() const;
 
+    // Adds the lines of a shared dictionary, before any other. They're not part of the
+    // flattened dictionary.
+    void addSharedLines(const std::vector<std::string>& lines) noexcept;
+
+    size_t getSharedLineCount() const noexcept {
+        return mSharedLineCount;
+    }
+
     constexpr size_t getSize() const noexcept {
         return mStorageSize;
     }
@@ -50,6 +58,7 @@ private:
     std::unordered_map<std::string, size_t> mLineIndices;
     std::vector<std::string> mStrings;
     size_t mStorageSize = 0;
+    size_t mSharedLineCount = 0;
 };
 
 } // namespace filamat
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "MaterialBinaryChunk.h"
+
+#include "Flattener.h"
+
+#include <map>
+
+namespace filamat {
+
+MaterialBinaryChunk::MaterialBinaryChunk(std::vector<BinaryEntry>&& entries, ChunkType type)
+        : Chunk(type), mEntries(std::move(entries)) {
+    // identical shaders are stored once
+    std::map<std::vector<uint8_t>, size_t> shaderIndices;
+    mShaderIndices.reserve(mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        mShaderIndices.push_back(shaderIndices.emplace(mEntries[i].data, i).first->second);
+    }
+}
+
+void MaterialBinaryChunk::flatten(Flattener& f) {
+    f.resetOffsets();
+
+    // All offsets expressed later will start at the current flattener cursor position
+    f.markOffsetBase();
+
+    f.writeUint64(mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const BinaryEntry& entry = mEntries[i];
+        f.writeUint8(entry.shaderModel);
+        f.writeUint8(entry.variant);
+        f.writeUint8(entry.stage);
+        f.writeOffsetplaceholder(mShaderIndices[i]);
+    }
+
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        if (mShaderIndices[i] == i) {
+            f.writeOffsets(i);
+            const std::vector<uint8_t>& data = mEntries[i].data;
+            f.writeBlob((const char*) data.data(), data.size());
+        }
+    }
+}
+
+} // namespace filamat
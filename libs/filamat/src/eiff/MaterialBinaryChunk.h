@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TNT_FILAMAT_MATERIAL_BINARY_CHUNK_H
+#define TNT_FILAMAT_MATERIAL_BINARY_CHUNK_H
+
+#include <vector>
+
+#include "Chunk.h"
+#include "ShaderEntry.h"
+
+namespace filamat {
+
+// Shaders compiled ahead of time into an opaque binary format, e.g. Metal libraries.
+//
+// Layout:
+//     uint64 number of shaders
+//     [uint8 shader model, uint8 variant, uint8 stage, uint32 offset of the shader]
+//     [blob shader]
+// Offsets are relative to the number of shaders, identical shaders are stored once.
+class MaterialBinaryChunk final : public Chunk {
+public:
+    MaterialBinaryChunk(std::vector<BinaryEntry>&& entries, ChunkType type);
+    ~MaterialBinaryChunk() override = default;
+
+private:
+    void flatten(Flattener& f) override;
+
+    const std::vector<BinaryEntry> mEntries;
+    // index of the first entry with the same shader, for each entry
+    std::vector<size_t> mShaderIndices;
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_MATERIAL_BINARY_CHUNK_H
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MaterialCompressedTextChunk.h"
+
+#include "Flattener.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace filamat {
+
+static constexpr uint32_t COMPRESSION_SCHEME_ZLIB = 1;
+
+// zlib only looks back this far, so a longer preset dictionary would be wasted
+static constexpr size_t MAX_PRESET_DICTIONARY_SIZE = 32768;
+
+static void forEachLine(const std::string& text, const std::function<void(std::string)>& f) {
+    for (size_t cur = 0; cur < text.size(); ) {
+        size_t end = text.find('\n', cur);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        f(text.substr(cur, end - cur));
+        cur = end + 1;
+    }
+}
+
+// The lines that the most shaders have in common, the most common last as zlib recommends.
+static std::string buildPresetDictionary(const std::vector<const std::string*>& shaders) {
+    std::unordered_map<std::string, size_t> shaderCounts;
+    std::vector<std::string> lines;
+    for (const std::string* shader : shaders) {
+        std::unordered_set<std::string> shaderLines;
+        forEachLine(*shader, [&](std::string line) {
+            if (shaderLines.insert(line).second) {
+                auto pos = shaderCounts.find(line);
+                if (pos == shaderCounts.end()) {
+                    shaderCounts.emplace(line, 1);
+                    lines.push_back(std::move(line));
+                } else {
+                    pos->second++;
+                }
+            }
+        });
+    }
+
+    // most common first, in the order they first appear otherwise
+    std::stable_sort(lines.begin(), lines.end(), [&](const std::string& a, const std::string& b) {
+        return shaderCounts[a] > shaderCounts[b];
+    });
+
+    std::vector<const std::string*> selected;
+    size_t size = 0;
+    for (const std::string& line : lines) {
+        if (shaderCounts[line] < 2 || size + line.size() + 1 > MAX_PRESET_DICTIONARY_SIZE) {
+            break;
+        }
+        selected.push_back(&line);
+        size += line.size() + 1;
+    }
+
+    std::string dictionary;
+    dictionary.reserve(size);
+    for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+        dictionary.append(**it).append("\n");
+    }
+    return dictionary;
+}
+
+static bool compress(const std::string& text, const std::string& dictionary, std::string* out) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    bool success = dictionary.empty() || deflateSetDictionary(&stream,
+            (const Bytef*) dictionary.data(), uInt(dictionary.size())) == Z_OK;
+    if (success) {
+        out->resize(deflateBound(&stream, uLong(text.size())));
+        stream.next_in = (Bytef*) text.data();
+        stream.avail_in = uInt(text.size());
+        stream.next_out = (Bytef*) &(*out)[0];
+        stream.avail_out = uInt(out->size());
+        success = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+        out->resize(stream.total_out);
+    }
+    deflateEnd(&stream);
+    return success;
+}
+
+MaterialCompressedTextChunk::MaterialCompressedTextChunk(std::vector<TextEntry>&& entries,
+        ChunkType type) : Chunk(type), mEntries(std::move(entries)) {
+    // identical shaders are stored once
+    std::unordered_map<std::string, size_t> shaderIndices;
+    std::vector<const std::string*> shaders;
+    mShaderIndices.reserve(mEntries.size());
+    for (const TextEntry& entry : mEntries) {
+        auto pos = shaderIndices.emplace(entry.shader, shaders.size());
+        if (pos.second) {
+            shaders.push_back(&entry.shader);
+        }
+        mShaderIndices.push_back(pos.first->second);
+    }
+
+    mPresetDictionary = buildPresetDictionary(shaders);
+
+    mShaders.resize(shaders.size());
+    for (size_t i = 0; i < shaders.size() && mValid; i++) {
+        mShaders[i].size = uint32_t(shaders[i]->size() + 1);
+        mValid = compress(*shaders[i], mPresetDictionary, &mShaders[i].data);
+    }
+}
+
+void MaterialCompressedTextChunk::flatten(Flattener& f) {
+    f.resetOffsets();
+
+    f.writeUint32(COMPRESSION_SCHEME_ZLIB);
+    f.writeBlob(mPresetDictionary.data(), mPresetDictionary.size());
+
+    // All offsets expressed later will start at the current flattener cursor position
+    f.markOffsetBase();
+
+    f.writeUint64(mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const TextEntry& entry = mEntries[i];
+        f.writeUint8(entry.shaderModel);
+        f.writeUint8(entry.variant);
+        f.writeUint8(entry.stage);
+        f.writeOffsetplaceholder(mShaderIndices[i]);
+    }
+
+    for (size_t i = 0; i < mShaders.size(); i++) {
+        f.writeOffsets(i);
+        f.writeUint32(mShaders[i].size);
+        f.writeBlob(mShaders[i].data.data(), mShaders[i].data.size());
+    }
+}
+
+} // namespace filamat
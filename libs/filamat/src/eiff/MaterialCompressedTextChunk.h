@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_MATERIAL_COMPRESSED_TEXT_CHUNK_H
+#define TNT_FILAMAT_MATERIAL_COMPRESSED_TEXT_CHUNK_H
+
+#include <string>
+#include <vector>
+
+#include "Chunk.h"
+#include "ShaderEntry.h"
+
+namespace filamat {
+
+// Text shaders compressed individually with zlib, so that each can be decompressed on its own.
+// They share a preset dictionary made of the lines most shaders have in common.
+//
+// Layout:
+//     uint32 compression scheme (1: zlib)
+//     blob   preset dictionary
+//     uint64 number of shaders
+//     [uint8 shader model, uint8 variant, uint8 stage, uint32 offset of the shader]
+//     [uint32 size of the shader including the null terminator, blob compressed shader]
+// Offsets are relative to the number of shaders, identical shaders are stored once.
+class MaterialCompressedTextChunk final : public Chunk {
+public:
+    MaterialCompressedTextChunk(std::vector<TextEntry>&& entries, ChunkType type);
+    ~MaterialCompressedTextChunk() override = default;
+
+    // false if a shader couldn't be compressed
+    bool isValid() const noexcept { return mValid; }
+
+private:
+    void flatten(Flattener& f) override;
+
+    struct CompressedShader {
+        uint32_t size;
+        std::string data;
+    };
+
+    const std::vector<TextEntry> mEntries;
+    std::string mPresetDictionary;
+    std::vector<CompressedShader> mShaders;
+    // index of the compressed shader of each entry
+    std::vector<size_t> mShaderIndices;
+    bool mValid = true;
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_MATERIAL_COMPRESSED_TEXT_CHUNK_H
@@ -18,6 +18,7 @@
 #define TNT_FILAMAT_SHADER_ENTRY_H
 
 #include <string>
+#include <vector>
 
 namespace filamat {
 
@@ -36,6 +37,14 @@ struct SpirvEntry {
     size_t dictionaryIndex;
 };
 
+// BinaryEntry stores a shader compiled ahead of time, like a Metal library.
+struct BinaryEntry {
+    uint8_t shaderModel;
+    uint8_t variant;
+    uint8_t stage;
+    std::vector<uint8_t> data;
+};
+
 }  // namespace filamat
 
 #endif // TNT_FILAMAT_SHADER_ENTRY_H
@@ -124,6 +124,37 @@ io::sstream& CodeGenerator::generateShaderMain(io::sstream& out, ShaderType type
     return out;
 }
 
+io::sstream& CodeGenerator::generateTransparentShaderMain(io::sstream& out,
+        ShaderType type) const {
+    if (type == ShaderType::VERTEX) {
+        out << SHADERS_MAIN_VS_DATA;
+    } else if (type == ShaderType::FRAGMENT) {
+        // the regular entry point is renamed and called by the one below
+        out << "#define main shadeFragment\n";
+        out << SHADERS_MAIN_FS_DATA;
+        out << "#undef main\n";
+        out << R"(
+LAYOUT_LOCATION(1) out float fragWeight;
+
+void main() {
+    shadeFragment();
+    fragWeight = 0.0;
+    if (frameUniforms.orderIndependentTransparency != 0u) {
+        // McGuire and Bavoil 2013, "Weighted Blended Order-Independent Transparency", the weight
+        // of equation 10 with a reversed-z depth, i.e. 1.0 on the near plane. The color is
+        // premultiplied, its alpha is blended into the revealage and the weighted alpha into
+        // fragWeight.
+        highp float z = gl_FragCoord.z;
+        float weight = clamp(3e3 * z * z * z, 1e-2, 3e3);
+        fragColor.rgb *= weight;
+        fragWeight = fragColor.a * weight;
+    }
+}
+)";
+    }
+    return out;
+}
+
 io::sstream& CodeGenerator::generatePostProcessMain(io::sstream& out, ShaderType type) const {
     if (type == ShaderType::VERTEX) {
         out << SHADERS_POST_PROCESS_VS_DATA;
@@ -239,11 +270,25 @@ utils::io::sstream& CodeGenerator::generateOutput(utils::io::sstream& out, Shade
 }
 
 
-io::sstream& CodeGenerator::generateDepthShaderMain(io::sstream& out, ShaderType type) const {
+io::sstream& CodeGenerator::generateDepthShaderMain(io::sstream& out, ShaderType type,
+        bool picking) const {
     if (type == ShaderType::VERTEX) {
         out << SHADERS_DEPTH_MAIN_VS_DATA;
     } else if (type == ShaderType::FRAGMENT) {
+        if (picking) {
+            // the depth main still runs, e.g. to discard the alpha masked fragments
+            out << "\nLAYOUT_LOCATION(0) out highp uvec4 outPicking;\n";
+            out << "#define main depthMain\n";
+        }
         out << SHADERS_DEPTH_MAIN_FS_DATA;
+        if (picking) {
+            out << "#undef main\n";
+            out << "void main() {\n";
+            out << "    depthMain();\n";
+            out << "    outPicking = uvec4(objectUniforms.objectId, "
+                   "floatBitsToUint(gl_FragCoord.z), 0u, 0u);\n";
+            out << "}\n";
+        }
     }
     return out;
 }
@@ -496,6 +541,24 @@ io::sstream& CodeGenerator::generateGetters(io::sstream& out, ShaderType type) c
     return out;
 }
 
+io::sstream& CodeGenerator::generateInstanceGetters(io::sstream& out, ShaderType type,
+        bool hasInstanceTransforms) const {
+    if (type == ShaderType::VERTEX) {
+        // Vulkan semantics (which we also use to produce SPIR-V for Metal) rename gl_InstanceID
+        if (mTargetLanguage == TargetLanguage::SPIRV) {
+            out << "int getInstanceIndex() {\n    return gl_InstanceIndex;\n}\n";
+        } else {
+            out << "int getInstanceIndex() {\n    return gl_InstanceID;\n}\n";
+        }
+        if (hasInstanceTransforms) {
+            out << "highp mat4 getInstanceTransform() {\n"
+                   "    return instancesUniforms.transforms[getInstanceIndex()];\n"
+                   "}\n";
+        }
+    }
+    return out;
+}
+
 io::sstream& CodeGenerator::generateParameters(io::sstream& out, ShaderType type) const {
     if (type == ShaderType::VERTEX) {
     } else if (type == ShaderType::FRAGMENT) {
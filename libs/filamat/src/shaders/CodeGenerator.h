@@ -72,6 +72,11 @@ public:
     utils::io::sstream& generateShaderMain(utils::io::sstream& out, ShaderType type) const;
     utils::io::sstream& generatePostProcessMain(utils::io::sstream& out, ShaderType type) const;
 
+    // generate the shader's main() of the transparent materials, which also writes the weighted
+    // outputs of the order-independent transparency pass when the view enables it
+    utils::io::sstream& generateTransparentShaderMain(utils::io::sstream& out,
+            ShaderType type) const;
+
     // generate the shader's code for the lit shading model
     utils::io::sstream& generateShaderLit(utils::io::sstream& out, ShaderType type,
             filament::Variant variant, filament::Shading shading) const;
@@ -95,8 +100,10 @@ public:
             MaterialBuilder::VariableQualifier qualifier,
             MaterialBuilder::OutputType outputType) const;
 
-    // generate no-op shader for depth prepass
-    utils::io::sstream& generateDepthShaderMain(utils::io::sstream& out, ShaderType type) const;
+    // generate no-op shader for depth prepass, or the picking shader that also writes the object
+    // id of the renderable
+    utils::io::sstream& generateDepthShaderMain(utils::io::sstream& out, ShaderType type,
+            bool picking = false) const;
 
     // generate uniforms
     utils::io::sstream& generateUniforms(utils::io::sstream& out, ShaderType type, uint8_t binding,
@@ -122,6 +129,8 @@ public:
 
     utils::io::sstream& generatePostProcessGetters(utils::io::sstream& out, ShaderType type) const;
     utils::io::sstream& generateGetters(utils::io::sstream& out, ShaderType type) const;
+    utils::io::sstream& generateInstanceGetters(utils::io::sstream& out, ShaderType type,
+            bool hasInstanceTransforms) const;
     utils::io::sstream& generateParameters(utils::io::sstream& out, ShaderType type) const;
 
     static void fixupExternalSamplers(
@@ -234,6 +234,11 @@ std::string ShaderGenerator::createVertexProgram(filament::backend::ShaderModel
         cg.generateUniforms(vs, ShaderType::VERTEX,
                 BindingPoints::PER_RENDERABLE_BONES,
                 UibGenerator::getPerRenderableBonesUib());
+    } else {
+        // per-instance transforms can't be combined with skinning and share its binding
+        cg.generateUniforms(vs, ShaderType::VERTEX,
+                BindingPoints::PER_RENDERABLE_BONES,
+                UibGenerator::getPerRenderableInstancesUib());
     }
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::PER_MATERIAL_INSTANCE, material.uib);
@@ -246,6 +251,7 @@ std::string ShaderGenerator::createVertexProgram(filament::backend::ShaderModel
     // shader code
     cg.generateCommon(vs, ShaderType::VERTEX);
     cg.generateGetters(vs, ShaderType::VERTEX);
+    cg.generateInstanceGetters(vs, ShaderType::VERTEX, !variant.hasSkinningOrMorphing());
     cg.generateCommonMaterial(vs, ShaderType::VERTEX);
 
     if (variant.isDepthPass() &&
@@ -306,6 +312,7 @@ std::string ShaderGenerator::createFragmentProgram(filament::backend::ShaderMode
     cg.generateDefine(fs, "CLEAR_COAT_IOR_CHANGE", material.clearCoatIorChange);
 
     cg.generateDefine(fs, "MAX_SHADOW_CASTING_SPOTS", uint32_t(CONFIG_MAX_SHADOW_CASTING_SPOTS));
+    cg.generateDefine(fs, "MAX_SHADOW_MAPS_PUNCTUAL", uint32_t(CONFIG_MAX_SHADOW_MAPS_PUNCTUAL));
 
     auto defaultSpecularAO = isMobileTarget(shaderModel) ?
             SpecularAmbientOcclusion::NONE : SpecularAmbientOcclusion::SIMPLE;
@@ -440,7 +447,7 @@ std::string ShaderGenerator::createFragmentProgram(filament::backend::ShaderMode
         }
         // these variants are special and are treated as DEPTH variants. Filament will never
         // request that variant for the color pass.
-        cg.generateDepthShaderMain(fs, ShaderType::FRAGMENT);
+        cg.generateDepthShaderMain(fs, ShaderType::FRAGMENT, variant.hasPicking());
     } else {
         appendShader(fs, mMaterialCode, mMaterialLineOffset);
         if (material.isLit) {
@@ -448,8 +455,16 @@ std::string ShaderGenerator::createFragmentProgram(filament::backend::ShaderMode
         } else {
             cg.generateShaderUnlit(fs, ShaderType::FRAGMENT, variant, material.hasShadowMultiplier);
         }
-        // entry point
-        cg.generateShaderMain(fs, ShaderType::FRAGMENT);
+        // entry point, the transparent materials can be rendered by the order-independent
+        // transparency pass, except the refractive ones which are rendered by their own pass
+        const bool transparent = (material.blendingMode == BlendingMode::TRANSPARENT ||
+                material.blendingMode == BlendingMode::FADE) &&
+                material.refractionMode != RefractionMode::SCREEN_SPACE;
+        if (transparent) {
+            cg.generateTransparentShaderMain(fs, ShaderType::FRAGMENT);
+        } else {
+            cg.generateShaderMain(fs, ShaderType::FRAGMENT);
+        }
     }
 
     cg.generateEpilog(fs);
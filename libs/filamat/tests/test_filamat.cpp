@@ -20,12 +20,17 @@
 #include "shaders/ShaderGenerator.h"
 
 #include "MockIncluder.h"
+#include "PrecisionInference.h"
+#include "SharedDictionary.h"
+
+#include <filament/MaterialChunkType.h>
 
 #include <filamat/Enums.h>
 
 #include <utils/JobSystem.h>
 
 #include <memory>
+#include <set>
 
 using namespace utils;
 using namespace ASTUtils;
@@ -729,6 +734,144 @@ TEST_F(MaterialCompiler, Arrays) {
     EXPECT_TRUE(result.isValid());
 }
 
+TEST_F(MaterialCompiler, SharedDictionary) {
+    auto buildMaterial = [this](const char* name, const void* dictionary, size_t size) {
+        filamat::MaterialBuilder builder;
+        builder.name(name)
+                .targetApi(MaterialBuilder::TargetApi::OPENGL)
+                .platform(MaterialBuilder::Platform::MOBILE)
+                .parameter(UniformType::FLOAT4, name);
+        if (dictionary) {
+            builder.sharedDictionary(dictionary, size);
+        }
+        return builder.build(*jobSystem);
+    };
+
+    Package materials[2] = {
+            buildMaterial("first", nullptr, 0),
+            buildMaterial("second", nullptr, 0)
+    };
+    ASSERT_TRUE(materials[0].isValid());
+    ASSERT_TRUE(materials[1].isValid());
+
+    Package dictionary = MaterialBuilder::buildSharedDictionary(materials, 2);
+    ASSERT_TRUE(dictionary.isValid());
+    uint64_t dictionaryId;
+    std::vector<std::string> dictionaryLines;
+    ASSERT_TRUE(readTextDictionary(dictionary.getData(), dictionary.getSize(),
+            &dictionaryId, &dictionaryLines));
+    EXPECT_NE(dictionaryId, 0u);
+    EXPECT_FALSE(dictionaryLines.empty());
+
+    // the material only keeps the lines that aren't in the dictionary, and references it
+    Package material = buildMaterial("first", dictionary.getData(), dictionary.getSize());
+    ASSERT_TRUE(material.isValid());
+    EXPECT_LT(material.getSize(), materials[0].getSize());
+
+    uint64_t id;
+    std::vector<std::string> lines;
+    ASSERT_TRUE(readTextDictionary(material.getData(), material.getSize(), &id, &lines));
+    EXPECT_EQ(id, dictionaryId);
+    std::vector<std::string> originalLines;
+    ASSERT_TRUE(readTextDictionary(materials[0].getData(), materials[0].getSize(),
+            &id, &originalLines));
+    EXPECT_EQ(id, 0u);
+    lines.insert(lines.begin(), dictionaryLines.begin(), dictionaryLines.end());
+    EXPECT_EQ(std::set<std::string>(lines.begin(), lines.end()),
+            std::set<std::string>(originalLines.begin(), originalLines.end()));
+
+    // the materials of a shared dictionary must not use one
+    EXPECT_FALSE(MaterialBuilder::buildSharedDictionary(&material, 1).isValid());
+
+    const char garbage[] = "not a dictionary";
+    EXPECT_FALSE(buildMaterial("first", garbage, sizeof(garbage)).isValid());
+}
+
+static bool hasChunk(const Package& package, ChunkType type) {
+    // chunks are a 64-bit type and a 32-bit size, followed by their data
+    for (const uint8_t* p = package.getData(); package.getEnd() - p >= 12; ) {
+        uint64_t chunkType;
+        uint32_t chunkSize;
+        memcpy(&chunkType, p, sizeof(chunkType));
+        memcpy(&chunkSize, p + 8, sizeof(chunkSize));
+        if (chunkType == uint64_t(type)) {
+            return true;
+        }
+        p += 12 + chunkSize;
+    }
+    return false;
+}
+
+TEST_F(MaterialCompiler, CompressedShaders) {
+    auto buildMaterial = [this](bool compress) {
+        filamat::MaterialBuilder builder;
+        builder.name("compressed")
+                .targetApi(MaterialBuilder::TargetApi::OPENGL)
+                .platform(MaterialBuilder::Platform::MOBILE)
+                .compressShaders(compress);
+        return builder.build(*jobSystem);
+    };
+
+    Package material = buildMaterial(false);
+    Package compressed = buildMaterial(true);
+    ASSERT_TRUE(material.isValid());
+    ASSERT_TRUE(compressed.isValid());
+    EXPECT_LT(compressed.getSize(), material.getSize());
+
+    // the compressed shaders don't use the text dictionary
+    EXPECT_TRUE(hasChunk(compressed, ChunkType::MaterialGlslCompressed));
+    EXPECT_FALSE(hasChunk(compressed, ChunkType::MaterialGlsl));
+    EXPECT_FALSE(hasChunk(compressed, ChunkType::DictionaryText));
+    EXPECT_TRUE(hasChunk(material, ChunkType::MaterialGlsl));
+}
+
+TEST(PrecisionInference, RelaxesValuesDerivedFromMediump) {
+    enum : uint32_t {
+        VOID = 1, FUNCTION_TYPE, FLOAT, POINTER, INPUT, TWO, MAIN, LABEL,
+        A, B, X, Y, Z, DZ, DA, BOUND
+    };
+    auto op = [](uint32_t wordCount, uint32_t opcode) { return (wordCount << 16u) | opcode; };
+    std::vector<uint32_t> spirv = {
+            0x07230203, 0x00010000, 0, BOUND, 0,
+            op(2, 17), 1,                               // OpCapability Shader
+            op(3, 14), 0, 1,                            // OpMemoryModel Logical GLSL450
+            op(3, 71), A, 0,                            // OpDecorate %a RelaxedPrecision
+            op(2, 19), VOID,                            // OpTypeVoid
+            op(3, 33), FUNCTION_TYPE, VOID,             // OpTypeFunction
+            op(3, 22), FLOAT, 32,                       // OpTypeFloat 32
+            op(4, 32), POINTER, 1, FLOAT,               // OpTypePointer Input %float
+            op(4, 59), POINTER, INPUT, 1,               // OpVariable Input
+            op(4, 43), FLOAT, TWO, 0x40000000,          // OpConstant 2.0
+            op(5, 54), VOID, MAIN, 0, FUNCTION_TYPE,    // OpFunction
+            op(2, 248), LABEL,                          // OpLabel
+            op(4, 61), FLOAT, A, INPUT,                 // %a = OpLoad, mediump
+            op(4, 61), FLOAT, B, INPUT,                 // %b = OpLoad, highp
+            op(5, 133), FLOAT, X, A, TWO,               // %x = %a * 2.0
+            op(5, 129), FLOAT, Y, X, B,                 // %y = %x + %b
+            op(5, 133), FLOAT, Z, A, A,                 // %z = %a * %a
+            op(4, 207), FLOAT, DZ, Z,                   // OpDPdx %z
+            op(4, 207), FLOAT, DA, A,                   // OpDPdx %a
+            op(1, 253),                                 // OpReturn
+            op(1, 56),                                  // OpFunctionEnd
+    };
+    const size_t size = spirv.size();
+
+    filamat::PrecisionReport report;
+    ASSERT_TRUE(filamat::inferRelaxedPrecision(spirv, &report));
+
+    // only %x is derived from mediump values alone, %z is used by a derivative
+    EXPECT_EQ(report.relaxedCount, 1u);
+    EXPECT_EQ(report.mediumpDerivatives, 1u);
+    EXPECT_EQ(report.getWarningCount(), 1u);
+
+    // the decoration is added after the existing one
+    ASSERT_EQ(spirv.size(), size + 3);
+    EXPECT_EQ(spirv[13], op(3, 71));
+    EXPECT_EQ(spirv[14], uint32_t(X));
+    EXPECT_EQ(spirv[15], 0u);
+    EXPECT_EQ(spirv[16], op(2, 19));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
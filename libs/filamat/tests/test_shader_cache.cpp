@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ShaderCache.h"
+
+#include <utils/Path.h>
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+using namespace filamat;
+using namespace utils;
+
+// -------------------------------------------------------------------------------------------------
+
+class ShaderCacheTest : public testing::Test {
+protected:
+    void SetUp() override {
+        mDirectory = Path::concat(Path::getTemporaryDirectory(),
+                "filamat_shader_cache_" + std::to_string(std::random_device{}())).getPath();
+        ShaderCache::clearMemoryCache();
+    }
+
+    void TearDown() override {
+        for (Path const& file : Path(mDirectory).listContents()) {
+            Path(file).unlinkFile();
+        }
+        // only removes the directory once empty
+        remove(mDirectory.c_str());
+        ShaderCache::clearMemoryCache();
+    }
+
+    static GLSLPostProcessor::Config getConfig() {
+        return GLSLPostProcessor::Config{
+                .shaderType = filament::backend::ShaderType::FRAGMENT,
+                .shaderModel = filament::backend::ShaderModel::GL_CORE_41,
+                .hasFramebufferFetch = false,
+                .glsl = {}
+        };
+    }
+
+    std::string mDirectory;
+};
+
+TEST_F(ShaderCacheTest, Miss) {
+    ShaderCache cache(mDirectory);
+    const std::string key = ShaderCache::getKey("void main() {}", getConfig(),
+            MaterialBuilder::Optimization::PERFORMANCE, 0, true, false, false);
+    std::string glsl;
+    EXPECT_FALSE(cache.get(key, &glsl, nullptr, nullptr));
+    EXPECT_EQ(cache.getMissCount(), 1u);
+    EXPECT_EQ(cache.getHitCount(), 0u);
+}
+
+TEST_F(ShaderCacheTest, RoundTrip) {
+    const std::string key = ShaderCache::getKey("void main() {}", getConfig(),
+            MaterialBuilder::Optimization::PERFORMANCE, 0, false, true, true);
+    const SpirvBlob spirv = { 0x07230203, 0x00010000, 42 };
+    const std::string msl = "fragment void main0() {}";
+    ShaderCache(mDirectory).put(key, nullptr, &spirv, &msl);
+
+    // the entries persist on disk
+    ShaderCache::clearMemoryCache();
+    ShaderCache cache(mDirectory);
+    SpirvBlob cachedSpirv;
+    std::string cachedMsl;
+    EXPECT_TRUE(cache.get(key, nullptr, &cachedSpirv, &cachedMsl));
+    EXPECT_EQ(cachedSpirv, spirv);
+    EXPECT_EQ(cachedMsl, msl);
+    EXPECT_EQ(cache.getHitCount(), 1u);
+}
+
+TEST_F(ShaderCacheTest, KeyDependsOnParameters) {
+    const std::string shader = "void main() {}";
+    const auto config = getConfig();
+    const std::string key = ShaderCache::getKey(shader, config,
+            MaterialBuilder::Optimization::PERFORMANCE, 0, true, false, false);
+
+    EXPECT_NE(key, ShaderCache::getKey("void main() { }", config,
+            MaterialBuilder::Optimization::PERFORMANCE, 0, true, false, false));
+    EXPECT_NE(key, ShaderCache::getKey(shader, config,
+            MaterialBuilder::Optimization::SIZE, 0, true, false, false));
+    EXPECT_NE(key, ShaderCache::getKey(shader, config,
+            MaterialBuilder::Optimization::PERFORMANCE,
+            GLSLPostProcessor::GENERATE_DEBUG_INFO, true, false, false));
+    EXPECT_NE(key, ShaderCache::getKey(shader, config,
+            MaterialBuilder::Optimization::PERFORMANCE, 0, false, true, false));
+
+    auto vertexConfig = config;
+    vertexConfig.shaderType = filament::backend::ShaderType::VERTEX;
+    EXPECT_NE(key, ShaderCache::getKey(shader, vertexConfig,
+            MaterialBuilder::Optimization::PERFORMANCE, 0, true, false, false));
+
+    // printing the shaders doesn't change the output
+    EXPECT_EQ(key, ShaderCache::getKey(shader, config,
+            MaterialBuilder::Optimization::PERFORMANCE,
+            GLSLPostProcessor::PRINT_SHADERS, true, false, false));
+}
+
+TEST_F(ShaderCacheTest, MemoryOnly) {
+    const std::string key = ShaderCache::getKey("void main() {}", getConfig(),
+            MaterialBuilder::Optimization::PERFORMANCE, 0, true, false, false);
+    const std::string glsl = "#version 410\nvoid main() {}";
+    ShaderCache("").put(key, &glsl, nullptr, nullptr);
+
+    // the entries are shared by all the instances
+    ShaderCache cache("");
+    std::string cachedGlsl;
+    EXPECT_TRUE(cache.get(key, &cachedGlsl, nullptr, nullptr));
+    EXPECT_EQ(cachedGlsl, glsl);
+
+    ShaderCache::clearMemoryCache();
+    EXPECT_FALSE(cache.get(key, &cachedGlsl, nullptr, nullptr));
+}
+
+TEST_F(ShaderCacheTest, CorruptedEntry) {
+    const std::string key = ShaderCache::getKey("void main() {}", getConfig(),
+            MaterialBuilder::Optimization::PERFORMANCE, 0, true, false, false);
+    const std::string glsl = "#version 410\nvoid main() {}";
+    ShaderCache cache(mDirectory);
+    cache.put(key, &glsl, nullptr, nullptr);
+
+    // truncate the entry
+    std::vector<Path> files = Path(mDirectory).listContents();
+    ASSERT_EQ(files.size(), 1u);
+    std::ofstream(files[0].getPath(), std::ios::binary | std::ios::trunc) << "FMSC";
+    ShaderCache::clearMemoryCache();
+
+    std::string cachedGlsl;
+    EXPECT_FALSE(cache.get(key, &cachedGlsl, nullptr, nullptr));
+
+    // and it's replaced
+    cache.put(key, &glsl, nullptr, nullptr);
+    EXPECT_TRUE(cache.get(key, &cachedGlsl, nullptr, nullptr));
+    EXPECT_EQ(cachedGlsl, glsl);
+}
@@ -26,7 +26,7 @@
 #include <filament/Texture.h>
 #include <filament/Skybox.h>
 
-#include <image/KtxBundle.h>
+#include <image/KtxReader.h>
 #include <image/KtxUtility.h>
 
 #include <stb_image.h>
@@ -52,32 +52,48 @@ IBL::~IBL() {
 }
 
 bool IBL::loadFromKtx(const std::string& prefix) {
-    Path iblPath(prefix + "_ibl.ktx");
-    if (!iblPath.exists()) {
-        return false;
-    }
     Path skyPath(prefix + "_skybox.ktx");
     if (!skyPath.exists()) {
         return false;
     }
 
-    auto createKtx = [] (Path path) {
-        using namespace std;
-        ifstream file(path.getPath(), ios::binary);
-        vector<uint8_t> contents((istreambuf_iterator<char>(file)), {});
-        return new image::KtxBundle(contents.data(), contents.size());
-    };
+    // the files are mapped and their miplevels uploaded straight from the mapping
 
-    KtxBundle* iblKtx = createKtx(iblPath);
-    KtxBundle* skyKtx = createKtx(skyPath);
+    // cmgen --ibl-compression writes compressed reflections next to the default ones, we use them
+    // when the GPU supports their format. ASTC files aren't considered, HDR and LDR ASTC share
+    // their formats so isTextureFormatSupported() can't tell whether HDR blocks can be decoded.
+    KtxReader* iblKtx = nullptr;
+    for (const char* suffix : { "_ibl_bc6h.ktx", "_ibl.ktx" }) {
+        Path iblPath(prefix + suffix);
+        if (!iblPath.exists()) {
+            continue;
+        }
+        iblKtx = KtxReader::open(iblPath.c_str());
+        if (iblKtx && Texture::isTextureFormatSupported(mEngine,
+                ktx::toTextureFormat(iblKtx->getInfo()))) {
+            break;
+        }
+        delete iblKtx;
+        iblKtx = nullptr;
+    }
 
-    mSkyboxTexture = ktx::createTexture(&mEngine, skyKtx, false);
-    mTexture = ktx::createTexture(&mEngine, iblKtx, false);
+    KtxReader* skyKtx = KtxReader::open(skyPath.c_str());
+    if (!iblKtx || !skyKtx) {
+        delete iblKtx;
+        delete skyKtx;
+        return false;
+    }
 
     if (!iblKtx->getSphericalHarmonics(mBands)) {
+        delete iblKtx;
+        delete skyKtx;
         return false;
     }
 
+    // the readers are destroyed by createTexture() once the upload is done
+    mSkyboxTexture = ktx::createTexture(&mEngine, skyKtx, false);
+    mTexture = ktx::createTexture(&mEngine, iblKtx, false);
+
     mIndirectLight = IndirectLight::Builder()
             .reflections(mTexture)
             .intensity(IBL_INTENSITY)
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <filament/Engine.h>
+#include <filament/Material.h>
+
+#include <filameshio/filamesh.h>
+#include <filameshio/MeshReader.h>
+
+#include <math/half.h>
+#include <math/norm.h>
+#include <math/vec2.h>
+#include <math/vec4.h>
+
+#include <utils/EntityManager.h>
+
+#include <benchmark/benchmark.h>
+
+#include <meshoptimizer.h>
+
+#include <string.h>
+
+#include <limits>
+#include <vector>
+
+using namespace filament;
+using namespace filament::math;
+using namespace filamesh;
+
+class MeshReaderBenchmark : public benchmark::Fixture {
+public:
+    MeshReaderBenchmark();
+    ~MeshReaderBenchmark() override;
+
+protected:
+    static constexpr uint32_t GRID_SIZE = 256;
+
+    // a GRID_SIZE x GRID_SIZE grid of quads in the filamesh format
+    std::vector<uint8_t> createGrid(uint32_t flags) const;
+
+    void load(benchmark::State& state, std::vector<uint8_t> const& data);
+
+    Engine* mEngine = nullptr;
+    MaterialInstance* mMaterialInstance = nullptr;
+};
+
+MeshReaderBenchmark::MeshReaderBenchmark() {
+    mEngine = Engine::create(Engine::Backend::NOOP);
+    mMaterialInstance = mEngine->getDefaultMaterial()->createInstance();
+}
+
+MeshReaderBenchmark::~MeshReaderBenchmark() {
+    mEngine->destroy(mMaterialInstance);
+    Engine::destroy(&mEngine);
+}
+
+template<typename T>
+static void append(std::vector<uint8_t>& out, const T* data, size_t size) {
+    out.insert(out.end(), (const uint8_t*) data, (const uint8_t*) data + size);
+}
+
+template<typename T>
+static void append(std::vector<uint8_t>& out, std::vector<T> const& data, bool compress,
+        uint32_t* compressedSize = nullptr) {
+    if (!compress) {
+        append(out, data.data(), data.size() * sizeof(T));
+        return;
+    }
+    std::vector<uint8_t> encoded(meshopt_encodeVertexBufferBound(data.size(), sizeof(T)));
+    encoded.resize(meshopt_encodeVertexBuffer(encoded.data(), encoded.size(),
+            data.data(), data.size(), sizeof(T)));
+    append(out, encoded.data(), encoded.size());
+    *compressedSize = uint32_t(encoded.size());
+}
+
+std::vector<uint8_t> MeshReaderBenchmark::createGrid(uint32_t flags) const {
+    const bool compress = flags & COMPRESSION;
+    const uint32_t vertexCount = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+
+    std::vector<half4> positions;
+    std::vector<byte4> tangents8;
+    std::vector<short4> tangents;
+    std::vector<ubyte4> colors;
+    std::vector<short2> uv0;
+    for (uint32_t y = 0; y <= GRID_SIZE; y++) {
+        for (uint32_t x = 0; x <= GRID_SIZE; x++) {
+            const float2 uv = float2(x, y) / float(GRID_SIZE);
+            positions.emplace_back(half4(float4(uv * 2.0f - 1.0f, 0.0f, 1.0f)));
+            tangents8.push_back(packSnorm8(float4(0, 0, 0, 1)));
+            tangents.push_back(packSnorm16(float4(0, 0, 0, 1)));
+            colors.emplace_back(255);
+            uv0.push_back(packSnorm16(uv));
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y < GRID_SIZE; y++) {
+        for (uint32_t x = 0; x < GRID_SIZE; x++) {
+            const uint32_t i = y * (GRID_SIZE + 1) + x;
+            const uint32_t quad[] = { i, i + 1, i + GRID_SIZE + 1,
+                    i + 1, i + GRID_SIZE + 2, i + GRID_SIZE + 1 };
+            indices.insert(indices.end(), std::begin(quad), std::end(quad));
+        }
+    }
+
+    std::vector<uint8_t> vertices;
+    CompressionHeader cheader{};
+    if (compress) {
+        vertices.resize(sizeof(cheader));
+    }
+    append(vertices, positions, compress, &cheader.positions);
+    if (flags & TANGENTS_SNORM8) {
+        append(vertices, tangents8, compress, &cheader.tangents);
+    } else {
+        append(vertices, tangents, compress, &cheader.tangents);
+    }
+    append(vertices, colors, compress, &cheader.colors);
+    append(vertices, uv0, compress, &cheader.uv0);
+    if (compress) {
+        memcpy(vertices.data(), &cheader, sizeof(cheader));
+    }
+
+    std::vector<uint8_t> indexData;
+    if (compress) {
+        indexData.resize(meshopt_encodeIndexBufferBound(indices.size(), vertexCount));
+        indexData.resize(meshopt_encodeIndexBuffer(indexData.data(), indexData.size(),
+                indices.data(), indices.size()));
+    } else {
+        append(indexData, indices.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    const size_t tangentSize = (flags & TANGENTS_SNORM8) ? sizeof(byte4) : sizeof(short4);
+    const Box aabb = { .center = float3(0), .halfExtent = float3(1, 1, 0) };
+    const Header header {
+        .version = VERSION,
+        .parts = 1,
+        .aabb = aabb,
+        .flags = flags | TEXCOORD_SNORM16,
+        .offsetTangents = uint32_t(vertexCount * sizeof(half4)),
+        .offsetColor = uint32_t(vertexCount * (sizeof(half4) + tangentSize)),
+        .offsetUV0 = uint32_t(vertexCount * (sizeof(half4) + tangentSize + sizeof(ubyte4))),
+        .offsetUV1 = std::numeric_limits<uint32_t>::max(),
+        .strideUV1 = std::numeric_limits<uint32_t>::max(),
+        .vertexCount = vertexCount,
+        .vertexSize = uint32_t(vertices.size()),
+        .indexType = UI32,
+        .indexCount = uint32_t(indices.size()),
+        .indexSize = uint32_t(indexData.size())
+    };
+    const Part part {
+        .offset = 0,
+        .indexCount = uint32_t(indices.size()),
+        .minIndex = 0,
+        .maxIndex = vertexCount - 1,
+        .material = 0,
+        .aabb = aabb
+    };
+    const char material[] = "DefaultMaterial";
+    const uint32_t materialCount = 1;
+    const uint32_t materialLength = sizeof(material) - 1;
+
+    std::vector<uint8_t> data;
+    append(data, MAGICID, sizeof(MAGICID));
+    append(data, &header, sizeof(header));
+    append(data, vertices.data(), vertices.size());
+    append(data, indexData.data(), indexData.size());
+    append(data, &part, sizeof(part));
+    append(data, &materialCount, sizeof(materialCount));
+    append(data, &materialLength, sizeof(materialLength));
+    append(data, material, sizeof(material));
+    return data;
+}
+
+void MeshReaderBenchmark::load(benchmark::State& state, std::vector<uint8_t> const& data) {
+    for (auto _ : state) {
+        MeshReader::Mesh mesh = MeshReader::loadMeshFromBuffer(mEngine, data.data(),
+                nullptr, nullptr, mMaterialInstance);
+        benchmark::DoNotOptimize(mesh);
+        state.PauseTiming();
+        mEngine->destroy(mesh.renderable);
+        mEngine->destroy(mesh.vertexBuffer);
+        mEngine->destroy(mesh.indexBuffer);
+        utils::EntityManager::get().destroy(mesh.renderable);
+        mEngine->flushAndWait();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations() * data.size()));
+}
+
+BENCHMARK_F(MeshReaderBenchmark, Uncompressed)(benchmark::State& state) {
+    load(state, createGrid(0));
+}
+
+BENCHMARK_F(MeshReaderBenchmark, Compressed)(benchmark::State& state) {
+    load(state, createGrid(COMPRESSION));
+}
+
+BENCHMARK_F(MeshReaderBenchmark, CompressedQuantized)(benchmark::State& state) {
+    load(state, createGrid(COMPRESSION | TANGENTS_SNORM8));
+}
@@ -25,7 +25,9 @@ using Box = filament::Box;
 
 static const char MAGICID[] { 'F', 'I', 'L', 'A', 'M', 'E', 'S', 'H' };
 
-static const uint32_t VERSION = 1;
+// Version 2 adds TANGENTS_SNORM8, version 3 adds LEVELS_OF_DETAIL. Version 1 files are still
+// supported.
+static const uint32_t VERSION = 3;
 
 enum IndexType : uint32_t {
     UI32 = 0,
@@ -36,6 +38,8 @@ enum Flags : uint32_t {
     INTERLEAVED         = 1 << 0,
     TEXCOORD_SNORM16    = 1 << 1,
     COMPRESSION         = 1 << 2,
+    TANGENTS_SNORM8     = 1 << 3,   // tangent frames quantized to 4 x snorm8, never interleaved
+    LEVELS_OF_DETAIL    = 1 << 4,   // the materials are followed by the levels of detail
 };
 
 // Each of these fields specifies a number of bytes within the compressed data. This is ignored
@@ -79,6 +83,14 @@ struct Part {
     Box aabb;
 };
 
+// With the LEVELS_OF_DETAIL flag, the materials are followed by the number of levels (uint32_t)
+// and one of these per level. The parts of a level follow those of the previous level, see
+// RenderableManager::Builder::levelOfDetail().
+struct LevelOfDetail {
+    uint32_t parts;
+    float screenSize;
+};
+
 } // namespace filamesh
 
 #endif // TNT_FILAMENT_FILAMESHIO_FILAMESH_H
@@ -32,10 +32,11 @@
 #include <utils/Log.h>
 #include <utils/Path.h>
 
-#include <string>
-#include <vector>
+#include <algorithm>
+#include <limits>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <fcntl.h>
 #if !defined(WIN32)
@@ -157,6 +158,84 @@ static size_t fileSize(int fd) {
     return filesize;
 }
 
+static void freeCallback(void* buffer, size_t size, void* user) {
+    free(buffer);
+}
+
+static bool hasUV1(Header const* header) {
+    constexpr uint32_t uintmax = std::numeric_limits<uint32_t>::max();
+    return header->offsetUV1 != uintmax && header->strideUV1 != uintmax;
+}
+
+static bool decodeIndices(Header const* header, uint8_t const* indices,
+        void** decoded, size_t* decodedSize) {
+    const size_t indexSize = header->indexType == UI16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    *decodedSize = indexSize * header->indexCount;
+    *decoded = malloc(*decodedSize);
+    if (meshopt_decodeIndexBuffer(*decoded, header->indexCount, indexSize,
+            indices, header->indexSize)) {
+        free(*decoded);
+        return false;
+    }
+    return true;
+}
+
+static bool decodeVertices(Header const* header, uint8_t const* vertexData,
+        void** decoded, size_t* decodedSize) {
+    const size_t vertexCount = header->vertexCount;
+    const uint8_t* src = vertexData + sizeof(CompressionHeader);
+    const size_t srcSize = header->vertexSize - sizeof(CompressionHeader);
+
+    if (header->flags & INTERLEAVED) {
+        const size_t stride = header->stridePosition;
+        *decodedSize = stride * vertexCount;
+        *decoded = malloc(*decodedSize);
+        if (meshopt_decodeVertexBuffer(*decoded, vertexCount, stride, src, srcSize)) {
+            free(*decoded);
+            return false;
+        }
+        return true;
+    }
+
+    // Each stream is decoded at the offset the vertex buffer attributes use.
+    const CompressionHeader* sizes = (CompressionHeader const*) vertexData;
+    const size_t tangentSize = (header->flags & TANGENTS_SNORM8) ? sizeof(byte4) : sizeof(short4);
+    const struct {
+        uint32_t offset;
+        size_t size;
+        uint32_t compressedSize;
+    } streams[] = {
+        { header->offsetPosition, sizeof(half4),   sizes->positions },
+        { header->offsetTangents, tangentSize,     sizes->tangents },
+        { header->offsetColor,    sizeof(ubyte4),  sizes->colors },
+        { header->offsetUV0,      sizeof(ushort2), sizes->uv0 },
+        { header->offsetUV1,      sizeof(ushort2), sizes->uv1 },
+    };
+    const size_t streamCount = hasUV1(header) ? 5 : 4;
+
+    *decodedSize = 0;
+    for (size_t i = 0; i < streamCount; i++) {
+        *decodedSize = std::max(*decodedSize, streams[i].offset + streams[i].size * vertexCount);
+    }
+    *decoded = malloc(*decodedSize);
+
+    int err = 0;
+    for (size_t i = 0; i < streamCount && !err; i++) {
+        if (src + streams[i].compressedSize > vertexData + header->vertexSize) {
+            err = -1;
+            break;
+        }
+        err = meshopt_decodeVertexBuffer((uint8_t*) *decoded + streams[i].offset, vertexCount,
+                streams[i].size, src, streams[i].compressedSize);
+        src += streams[i].compressedSize;
+    }
+    if (err) {
+        free(*decoded);
+        return false;
+    }
+    return true;
+}
+
 namespace filamesh {
 
 MeshReader::Mesh MeshReader::loadMeshFromFile(filament::Engine* engine, const utils::Path& path,
@@ -179,7 +258,12 @@ MeshReader::Mesh MeshReader::loadMeshFromFile(filament::Engine* engine, const ut
             mesh = loadMeshFromBuffer(engine, data, nullptr, nullptr, materials);
         }
 
-        Fence::waitAndDestroy(engine->createFence());
+        // Compressed meshes are decoded into their own buffers, otherwise the buffers point
+        // into data until they're uploaded.
+        Header const* header = (Header const*) p;
+        if (mesh.vertexBuffer && !(header->flags & COMPRESSION)) {
+            Fence::waitAndDestroy(engine->createFence());
+        }
         free(data);
     }
     close(fd);
@@ -208,6 +292,11 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
     Header* header = (Header*) p;
     p += sizeof(Header);
 
+    if (header->version > VERSION) {
+        utils::slog.e << "Unsupported filamesh version " << header->version << "." << utils::io::endl;
+        return {};
+    }
+
     uint8_t const* vertexData = p;
     p += header->vertexSize;
 
@@ -217,17 +306,49 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
     Part* parts = (Part*) p;
     p += header->parts * sizeof(Part);
 
-    uint32_t materialCount = (uint32_t) *p;
+    uint32_t materialCount = *(uint32_t const*) p;
     p += sizeof(uint32_t);
 
     std::vector<std::string> partsMaterial(materialCount);
     for (size_t i = 0; i < materialCount; i++) {
-        uint32_t nameLength = (uint32_t) *p;
+        uint32_t nameLength = *(uint32_t const*) p;
         p += sizeof(uint32_t);
         partsMaterial[i] = (const char*) p;
         p += nameLength + 1; // null terminated
     }
 
+    uint32_t levelCount = 0;
+    LevelOfDetail const* levels = nullptr;
+    if (header->flags & LEVELS_OF_DETAIL) {
+        levelCount = *(uint32_t const*) p;
+        p += sizeof(uint32_t);
+        levels = (LevelOfDetail const*) p;
+    }
+
+    // Compressed streams are decoded straight into the memory handed over to the buffers, in
+    // which case the source data isn't passed to the GPU and the user callback is called right
+    // away. This is done before creating the buffers so that a corrupted mesh doesn't leak them.
+    const bool compressed = header->flags & COMPRESSION;
+    void* decodedIndices = nullptr;
+    size_t decodedIndicesSize = 0;
+    void* decodedVertices = nullptr;
+    size_t decodedVerticesSize = 0;
+    if (compressed) {
+        if (!decodeIndices(header, indices, &decodedIndices, &decodedIndicesSize)) {
+            utils::slog.e << "Unable to decode index buffer." << utils::io::endl;
+            return {};
+        }
+        if (!decodeVertices(header, vertexData, &decodedVertices, &decodedVerticesSize)) {
+            utils::slog.e << "Unable to decode vertex buffer." << utils::io::endl;
+            free(decodedIndices);
+            return {};
+        }
+        if (destructor) {
+            destructor((void*) indices, header->indexSize, user);
+            destructor((void*) vertexData, header->vertexSize, user);
+        }
+    }
+
     Mesh mesh;
 
     mesh.indexBuffer = IndexBuffer::Builder()
@@ -236,30 +357,12 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
                     : IndexBuffer::IndexType::UINT)
             .build(*engine);
 
-    // If the index buffer is compressed, then decode the indices into a temporary buffer.
-    // The user callback can be called immediately afterwards because the source data does not get
-    // passed to the GPU.
-    const size_t indicesSize = header->indexSize;
-    if (header->flags & COMPRESSION) {
-        size_t indexSize = header->indexType == UI16 ? sizeof(uint16_t) : sizeof(uint32_t);
-        size_t indexCount = header->indexCount;
-        size_t uncompressedSize = indexSize * indexCount;
-        void* uncompressed = malloc(uncompressedSize);
-        int err = meshopt_decodeIndexBuffer(uncompressed, indexCount, indexSize, indices,
-                indicesSize);
-        if (err) {
-            utils::slog.e << "Unable to decode index buffer." << utils::io::endl;
-            return {};
-        }
-        if (destructor) {
-            destructor((void*) indices, indicesSize, user);
-        }
-        auto freecb = [](void* buffer, size_t size, void* user) { free(buffer); };
-        mesh.indexBuffer->setBuffer(*engine,
-                IndexBuffer::BufferDescriptor(uncompressed, uncompressedSize, freecb, nullptr));
+    if (compressed) {
+        mesh.indexBuffer->setBuffer(*engine, IndexBuffer::BufferDescriptor(
+                decodedIndices, decodedIndicesSize, freeCallback, nullptr));
     } else {
         mesh.indexBuffer->setBuffer(*engine,
-                IndexBuffer::BufferDescriptor(indices, indicesSize, destructor, user));
+                IndexBuffer::BufferDescriptor(indices, header->indexSize, destructor, user));
     }
 
     VertexBuffer::Builder vbb;
@@ -271,10 +374,13 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
     VertexBuffer::AttributeType uvtype = (header->flags & TEXCOORD_SNORM16) ?
             VertexBuffer::AttributeType::SHORT2 : VertexBuffer::AttributeType::HALF2;
 
+    VertexBuffer::AttributeType tangentsType = (header->flags & TANGENTS_SNORM8) ?
+            VertexBuffer::AttributeType::BYTE4 : VertexBuffer::AttributeType::SHORT4;
+
     vbb
             .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::HALF4,
                         header->offsetPosition, uint8_t(header->stridePosition))
-            .attribute(VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::SHORT4,
+            .attribute(VertexAttribute::TANGENTS, 0, tangentsType,
                         header->offsetTangents, uint8_t(header->strideTangents))
             .attribute(VertexAttribute::COLOR, 0, VertexBuffer::AttributeType::UBYTE4,
                         header->offsetColor, uint8_t(header->strideColor))
@@ -282,10 +388,7 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
                         header->offsetUV0, uint8_t(header->strideUV0))
             .normalized(VertexAttribute::UV0, header->flags & TEXCOORD_SNORM16);
 
-    constexpr uint32_t uintmax = std::numeric_limits<uint32_t>::max();
-    const bool hasUV1 = header->offsetUV1 != uintmax && header->strideUV1 != uintmax;
-
-    if (hasUV1) {
+    if (hasUV1(header)) {
         vbb
             .attribute(VertexAttribute::UV1, 0, VertexBuffer::AttributeType::HALF2,
                     header->offsetUV1, uint8_t(header->strideUV1))
@@ -294,65 +397,21 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
 
     mesh.vertexBuffer = vbb.build(*engine);
 
-    // If the vertex buffer is compressed, then decode the vertices into a temporary buffer.
-    // The user callback can be called immediately afterwards because the source data does not get
-    // passed to the GPU.
-    const size_t verticesSize = header->vertexSize;
-    if (header->flags & COMPRESSION) {
-        size_t vertexSize = sizeof(half4) + sizeof(short4) + sizeof(ubyte4) + sizeof(ushort2) +
-                (hasUV1 ? sizeof(ushort2) : 0);
-        size_t vertexCount = header->vertexCount;
-        size_t uncompressedSize = vertexSize * vertexCount;
-        void* uncompressed = malloc(uncompressedSize);
-        const uint8_t* srcdata = vertexData + sizeof(CompressionHeader);
-        int err = 0;
-        if (header->flags & INTERLEAVED) {
-            err |= meshopt_decodeVertexBuffer(uncompressed, vertexCount, vertexSize, srcdata,
-                    vertexSize);
-        } else {
-            const CompressionHeader* sizes = (CompressionHeader*) vertexData;
-            uint8_t* dstdata = (uint8_t*) uncompressed;
-            auto decode = meshopt_decodeVertexBuffer;
-
-            err |= decode(dstdata, vertexCount, sizeof(half4), srcdata, sizes->positions);
-            srcdata += sizes->positions;
-            dstdata += sizeof(half4) * vertexCount;
-
-            err |= decode(dstdata, vertexCount, sizeof(short4), srcdata, sizes->tangents);
-            srcdata += sizes->tangents;
-            dstdata += sizeof(short4) * vertexCount;
-
-            err |= decode(dstdata, vertexCount, sizeof(ubyte4), srcdata, sizes->colors);
-            srcdata += sizes->colors;
-            dstdata += sizeof(ubyte4) * vertexCount;
-
-            err |= decode(dstdata, vertexCount, sizeof(ushort2), srcdata, sizes->uv0);
-
-            if (sizes->uv1) {
-                srcdata += sizes->uv0;
-                dstdata += sizeof(ushort2) * vertexCount;
-                err |= decode(dstdata, vertexCount, sizeof(ushort2), srcdata, sizes->uv1);
-            }
-        }
-        if (err) {
-            utils::slog.e << "Unable to decode vertex buffer." << utils::io::endl;
-            return {};
-        }
-        if (destructor) {
-            destructor((void*) vertexData, verticesSize, user);
-        }
-        auto freecb = [](void* buffer, size_t size, void* user) { free(buffer); };
-        mesh.vertexBuffer->setBufferAt(*engine, 0,
-                IndexBuffer::BufferDescriptor(uncompressed, uncompressedSize, freecb, nullptr));
+    if (compressed) {
+        mesh.vertexBuffer->setBufferAt(*engine, 0, VertexBuffer::BufferDescriptor(
+                decodedVertices, decodedVerticesSize, freeCallback, nullptr));
     } else {
         mesh.vertexBuffer->setBufferAt(*engine, 0,
-                VertexBuffer::BufferDescriptor(vertexData, verticesSize, destructor, user));
+                VertexBuffer::BufferDescriptor(vertexData, header->vertexSize, destructor, user));
     }
 
     mesh.renderable = utils::EntityManager::get().create();
 
     RenderableManager::Builder builder(header->parts);
     builder.boundingBox(header->aabb);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        builder.levelOfDetail(uint8_t(i), levels[i].parts, levels[i].screenSize);
+    }
 
     const auto defaultmi = materials.getMaterialInstance(utils::CString(DEFAULT_MATERIAL));
     for (size_t i = 0; i < header->parts; i++) {
@@ -27,6 +27,8 @@
 #include <math/quat.h>
 #include <math/vec3.h>
 
+#include <meshoptimizer.h>
+
 #include <gtest/gtest.h>
 
 #include <sstream>
@@ -53,6 +55,12 @@ static const short4 tangents[] = {
     packSnorm16(float4(8, 9, 10, 11))
 };
 
+static const byte4 tangents8[] = {
+    packSnorm8(float4(0, 1, 2, 3)),
+    packSnorm8(float4(4, 5, 6, 7)),
+    packSnorm8(float4(8, 9, 10, 11))
+};
+
 static const ubyte4 colors[] = {
     ubyte4(0, 1, 2, 3),
     ubyte4(4, 5, 6, 7),
@@ -216,6 +224,154 @@ TEST_F(FilameshTest, Interleaved) {
     engine->destroy(mi);
 }
 
+template<typename T>
+vector<unsigned char> encode(const T* data, size_t count) {
+    vector<unsigned char> encoded(meshopt_encodeVertexBufferBound(count, sizeof(T)));
+    encoded.resize(meshopt_encodeVertexBuffer(encoded.data(), encoded.size(),
+            data, count, sizeof(T)));
+    return encoded;
+}
+
+TEST_F(FilameshTest, CompressedQuantized) {
+    // Compress the streams of a single-triangle mesh with 8 bits tangents
+    CompressionHeader cheader {};
+    vector<unsigned char> streams[4] = {
+        encode(positions, vertexCount),
+        encode(tangents8, vertexCount),
+        encode(colors, vertexCount),
+        encode(uv0, vertexCount)
+    };
+    cheader.positions = streams[0].size();
+    cheader.tangents = streams[1].size();
+    cheader.colors = streams[2].size();
+    cheader.uv0 = streams[3].size();
+
+    vector<unsigned char> compressedIndices(meshopt_encodeIndexBufferBound(3, vertexCount));
+    const uint32_t indices32[] = { 0, 1, 2 };
+    compressedIndices.resize(meshopt_encodeIndexBuffer(compressedIndices.data(),
+            compressedIndices.size(), indices32, 3));
+
+    const Header header {
+        .version = VERSION,
+        .parts = 1,
+        .aabb = unitBox,
+        .flags = COMPRESSION | TANGENTS_SNORM8,
+        .offsetTangents = sizeof(positions),
+        .offsetColor = sizeof(positions) + sizeof(tangents8),
+        .offsetUV0 = sizeof(positions) + sizeof(tangents8) + sizeof(colors),
+        .offsetUV1 = maxint,
+        .strideUV1 = maxint,
+        .vertexCount = vertexCount,
+        .vertexSize = uint32_t(sizeof(cheader) + cheader.positions + cheader.tangents +
+                cheader.colors + cheader.uv0),
+        .indexType = IndexType::UI16,
+        .indexCount = 3,
+        .indexSize = uint32_t(compressedIndices.size())
+    };
+    const uint32_t nmats = 1;
+    const string matname = "DefaultMaterial";
+    const uint32_t matnamelength = matname.size();
+
+    stringstream stream(ios_base::out);
+    write(stream, MAGICID, sizeof(MAGICID));
+    write(stream, &header, sizeof(header));
+    write(stream, &cheader, sizeof(cheader));
+    for (auto const& s : streams) {
+        write(stream, s.data(), s.size());
+    }
+    write(stream, compressedIndices.data(), compressedIndices.size());
+    write(stream, parts, sizeof(parts));
+    write(stream, &nmats, sizeof(nmats));
+    write(stream, &matnamelength, sizeof(matnamelength));
+    write(stream, matname.c_str(), matnamelength + 1);
+
+    // The streams are decoded right away, the source data isn't referenced anymore.
+    size_t released = 0;
+    auto callback = [](void* buffer, size_t size, void* user) { *(size_t*) user += size; };
+
+    MaterialInstance* mi = engine->getDefaultMaterial()->createInstance();
+    const string data = stream.str();
+    auto mesh = MeshReader::loadMeshFromBuffer(engine, data.data(), callback, &released, mi);
+    EXPECT_EQ(released, header.vertexSize + header.indexSize);
+    auto& rm = engine->getRenderableManager();
+    auto inst = rm.getInstance(mesh.renderable);
+    EXPECT_EQ(rm.getPrimitiveCount(inst), 1);
+
+    // Cleanup.
+    engine->destroy(mesh.renderable);
+    engine->destroy(mesh.vertexBuffer);
+    engine->destroy(mesh.indexBuffer);
+    engine->destroy(mi);
+}
+
+TEST_F(FilameshTest, LevelsOfDetail) {
+    // Serialize a single-triangle mesh with 2 levels of detail sharing the same triangle
+    const Header header {
+        .version = VERSION,
+        .parts = 2,
+        .aabb = unitBox,
+        .flags = LEVELS_OF_DETAIL,
+        .offsetTangents = sizeof(positions),
+        .offsetColor = sizeof(positions) + sizeof(tangents),
+        .offsetUV0 = sizeof(positions) + sizeof(tangents) + sizeof(colors),
+        .offsetUV1 = maxint,
+        .strideUV1 = maxint,
+        .vertexCount = vertexCount,
+        .vertexSize = sizeof(positions) + sizeof(tangents) + sizeof(colors) + sizeof(uv0),
+        .indexType = IndexType::UI16,
+        .indexCount = 3,
+        .indexSize = sizeof(uint16_t) * 3
+    };
+    const uint32_t nmats = 1;
+    const string matname = "DefaultMaterial";
+    const uint32_t matnamelength = matname.size();
+    const uint32_t nlevels = 2;
+    const LevelOfDetail levels[] = { { 1, 0.5f }, { 1, 0.25f } };
+
+    stringstream stream(ios_base::out);
+    write(stream, MAGICID, sizeof(MAGICID));
+    write(stream, &header, sizeof(header));
+    write(stream, positions, sizeof(positions));
+    write(stream, tangents, sizeof(tangents));
+    write(stream, colors, sizeof(colors));
+    write(stream, uv0, sizeof(uv0));
+    write(stream, indices, sizeof(indices));
+    write(stream, parts, sizeof(parts));
+    write(stream, parts, sizeof(parts));
+    write(stream, &nmats, sizeof(nmats));
+    write(stream, &matnamelength, sizeof(matnamelength));
+    write(stream, matname.c_str(), matnamelength + 1);
+    write(stream, &nlevels, sizeof(nlevels));
+    write(stream, levels, sizeof(levels));
+
+    MaterialInstance* mi = engine->getDefaultMaterial()->createInstance();
+    auto mesh = MeshReader::loadMeshFromBuffer(engine, stream.str().data(), nullptr, nullptr, mi);
+    auto& rm = engine->getRenderableManager();
+    auto inst = rm.getInstance(mesh.renderable);
+    EXPECT_EQ(rm.getPrimitiveCount(inst), 2);
+    EXPECT_EQ(rm.getLevelOfDetailCount(inst), 2);
+
+    // Cleanup.
+    engine->destroy(mesh.renderable);
+    engine->destroy(mi);
+}
+
+TEST_F(FilameshTest, UnsupportedVersion) {
+    const Header header {
+        .version = VERSION + 1,
+    };
+
+    stringstream stream(ios_base::out);
+    write(stream, MAGICID, sizeof(MAGICID));
+    write(stream, &header, sizeof(header));
+
+    MaterialInstance* mi = engine->getDefaultMaterial()->createInstance();
+    auto mesh = MeshReader::loadMeshFromBuffer(engine, stream.str().data(), nullptr, nullptr, mi);
+    EXPECT_EQ(mesh.vertexBuffer, nullptr);
+    EXPECT_EQ(mesh.indexBuffer, nullptr);
+    engine->destroy(mi);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
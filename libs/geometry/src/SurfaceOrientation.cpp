@@ -16,13 +16,19 @@
 
 #include <geometry/SurfaceOrientation.h>
 
+#include <utils/compiler.h>
 #include <utils/Panic.h>
 
 #include <math/mat3.h>
 #include <math/norm.h>
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 
+#include <limits.h>
+#include <math.h>
+
 namespace filament {
 namespace geometry {
 
@@ -151,18 +157,112 @@ static float3 randomPerp(const float3& n) {
     return perp / sqrlen;
 }
 
+// The per-vertex methods process the vertices in chunks of this size. Each chunk is transposed
+// into arrays of floats (one per component), so that the loops below get vectorized.
+static constexpr size_t CHUNK_SIZE = 256;
+
+// A chunk of tangent frames {t, b, n}, one array per component.
+struct TangentFrames {
+    float tx[CHUNK_SIZE], ty[CHUNK_SIZE], tz[CHUNK_SIZE];
+    float bx[CHUNK_SIZE], by[CHUNK_SIZE], bz[CHUNK_SIZE];
+    float nx[CHUNK_SIZE], ny[CHUNK_SIZE], nz[CHUNK_SIZE];
+};
+
+// Equivalent to mat3f::packTangentFrame() for each frame of the chunk. The branches of the
+// quaternion extraction are replaced by selections, so that the loop gets vectorized.
+static void packTangentFrames(const TangentFrames& UTILS_RESTRICT frames,
+        quatf* UTILS_RESTRICT quats, size_t count) noexcept {
+    // Bias is 2^(nb_bits - 1) - 1, used to ensure w is never 0.
+    constexpr float bias = 1.0f / float((1 << (sizeof(int16_t) * CHAR_BIT - 1)) - 1);
+    const float factor = float(std::sqrt(1.0 - double(bias) * double(bias)));
+
+    for (size_t i = 0; i < count; i++) {
+        // The rotation is {t, cross(n, t), n}.
+        const float m00 = frames.tx[i], m01 = frames.ty[i], m02 = frames.tz[i];
+        const float m20 = frames.nx[i], m21 = frames.ny[i], m22 = frames.nz[i];
+        const float m10 = m21 * m02 - m22 * m01;
+        const float m11 = m22 * m00 - m20 * m02;
+        const float m12 = m20 * m01 - m21 * m00;
+
+        // Same as extractQuat(): use the trace if it is positive, otherwise the greatest
+        // diagonal element.
+        const bool useTrace = m00 + m11 + m22 > 0;
+        const bool use0 = !useTrace && m00 >= m11 && m00 >= m22;
+        const bool use1 = !useTrace && !use0 && m11 >= m22;
+        const bool use2 = !useTrace && !use0 && !use1;
+        const float e0 = (useTrace || use0) ? 1.0f : -1.0f;
+        const float e1 = (useTrace || use1) ? 1.0f : -1.0f;
+        const float e2 = (useTrace || use2) ? 1.0f : -1.0f;
+        const float s = std::sqrt(std::max(0.0f, e0 * m00 + e1 * m11 + e2 * m22 + 1.0f));
+        const float h = 0.5f * s;
+        const float r = s != 0.0f ? 0.5f / s : 0.0f;
+        const float a = (m12 - m21) * r, b = (m20 - m02) * r, c = (m01 - m10) * r;
+        const float d = (m01 + m10) * r, e = (m02 + m20) * r, f = (m12 + m21) * r;
+        float x = useTrace ? a : use0 ? h : use1 ? d : e;
+        float y = useTrace ? b : use0 ? d : use1 ? h : f;
+        float z = useTrace ? c : use0 ? e : use1 ? f : h;
+        float w = useTrace ? h : use0 ? a : use1 ? b : c;
+
+        // Normalize and make w positive.
+        const float length = std::sqrt(x * x + y * y + z * z + w * w);
+        const float il = (w < 0.0f ? -1.0f : 1.0f) / length;
+        x *= il;
+        y *= il;
+        z *= il;
+        w *= il;
+
+        // Ensure w is never 0.
+        const float k = w < bias ? factor : 1.0f;
+        w = w < bias ? bias : w;
+
+        // If there's a reflection ((t x n) . b <= 0), make sure w is negative.
+        const float bx = frames.bx[i], by = frames.by[i], bz = frames.bz[i];
+        const float reflection = (m01 * m22 - m02 * m21) * bx + (m02 * m20 - m00 * m22) * by +
+                (m00 * m21 - m01 * m20) * bz;
+        const float sign = reflection < 0.0f ? -1.0f : 1.0f;
+
+        quats[i] = quatf(w * sign, x * k * sign, y * k * sign, z * k * sign);
+    }
+}
+
 SurfaceOrientation* OrientationBuilderImpl::buildWithNormalsOnly() {
     vector<quatf> quats(vertexCount);
 
     const float3* normal = this->normals;
     size_t nstride = this->normalStride ? this->normalStride : sizeof(float3);
 
-    for (size_t qindex = 0; qindex < vertexCount; ++qindex) {
-        float3 n = *normal;
-        float3 b = randomPerp(n);
-        float3 t = cross(n, b);
-        quats[qindex] = mat3f::packTangentFrame({t, b, n});
-        normal = (const float3*) (((const uint8_t*) normal) + nstride);
+    TangentFrames frames;
+    for (size_t first = 0; first < vertexCount; first += CHUNK_SIZE) {
+        const size_t count = std::min(CHUNK_SIZE, vertexCount - first);
+        for (size_t i = 0; i < count; ++i) {
+            frames.nx[i] = normal->x;
+            frames.ny[i] = normal->y;
+            frames.nz[i] = normal->z;
+            normal = (const float3*) (((const uint8_t*) normal) + nstride);
+        }
+
+        // Same as randomPerp(n) and t = cross(n, b).
+        for (size_t i = 0; i < count; ++i) {
+            const float nx = frames.nx[i], ny = frames.ny[i], nz = frames.nz[i];
+            // cross(n, {1, 0, 0}) or, if it is too small, cross(n, {0, 1, 0})
+            const float sqrlen1 = nz * nz + ny * ny;
+            const bool useX = sqrlen1 > std::numeric_limits<float>::epsilon();
+            const float px = useX ? 0.0f : -nz;
+            const float py = useX ? nz : 0.0f;
+            const float pz = useX ? -ny : nx;
+            const float sqrlen = useX ? sqrlen1 : nz * nz + nx * nx;
+            const float bx = px / sqrlen;
+            const float by = py / sqrlen;
+            const float bz = pz / sqrlen;
+            frames.bx[i] = bx;
+            frames.by[i] = by;
+            frames.bz[i] = bz;
+            frames.tx[i] = ny * bz - nz * by;
+            frames.ty[i] = nz * bx - nx * bz;
+            frames.tz[i] = nx * by - ny * bx;
+        }
+
+        packTangentFrames(frames, quats.data() + first, count);
     }
 
     return new SurfaceOrientation(new OrientationImpl( { std::move(quats) } ));
@@ -174,25 +274,47 @@ SurfaceOrientation* OrientationBuilderImpl::buildWithSuppliedTangents() {
     const float3* normal = this->normals;
     size_t nstride = this->normalStride ? this->normalStride : sizeof(float3);
 
-    const float3* tanvec = (const float3*) this->tangents;
-    const float* tandir = &this->tangents->w;
+    const float4* tangent = this->tangents;
     size_t tstride = this->tangentStride ? this->tangentStride : sizeof(float4);
 
-    for (size_t qindex = 0; qindex < vertexCount; ++qindex) {
-        float3 n = *normal;
-        float3 t = *tanvec;
-        float3 b = *tandir > 0 ? cross(t, n) : cross(n, t);
+    TangentFrames frames;
+    float handedness[CHUNK_SIZE];
+    for (size_t first = 0; first < vertexCount; first += CHUNK_SIZE) {
+        const size_t count = std::min(CHUNK_SIZE, vertexCount - first);
+        for (size_t i = 0; i < count; ++i) {
+            frames.nx[i] = normal->x;
+            frames.ny[i] = normal->y;
+            frames.nz[i] = normal->z;
+            frames.tx[i] = tangent->x;
+            frames.ty[i] = tangent->y;
+            frames.tz[i] = tangent->z;
+            handedness[i] = tangent->w;
+            normal = (const float3*) (((const uint8_t*) normal) + nstride);
+            tangent = (const float4*) (((const uint8_t*) tangent) + tstride);
+        }
 
         // Some assets do not provide perfectly orthogonal tangents and normals, so we adjust the
         // tangent to enforce orthonormality. We would rather honor the exact normal vector than
         // the exact tangent vector since the latter is only used for bump mapping and anisotropic
         // lighting.
-        t = *tandir > 0 ? cross(n, b) : cross(b, n);
+        for (size_t i = 0; i < count; ++i) {
+            const float nx = frames.nx[i], ny = frames.ny[i], nz = frames.nz[i];
+            const float tx = frames.tx[i], ty = frames.ty[i], tz = frames.tz[i];
+            // b = w > 0 ? cross(t, n) : cross(n, t)
+            const float sign = handedness[i] > 0 ? 1.0f : -1.0f;
+            const float bx = (ty * nz - tz * ny) * sign;
+            const float by = (tz * nx - tx * nz) * sign;
+            const float bz = (tx * ny - ty * nx) * sign;
+            frames.bx[i] = bx;
+            frames.by[i] = by;
+            frames.bz[i] = bz;
+            // t = w > 0 ? cross(n, b) : cross(b, n)
+            frames.tx[i] = (ny * bz - nz * by) * sign;
+            frames.ty[i] = (nz * bx - nx * bz) * sign;
+            frames.tz[i] = (nx * by - ny * bx) * sign;
+        }
 
-        quats[qindex] = mat3f::packTangentFrame({t, b, n});
-        normal = (const float3*) (((const uint8_t*) normal) + nstride);
-        tanvec = (const float3*) (((const uint8_t*) tanvec) + tstride);
-        tandir = (const float*) (((const uint8_t*) tandir) + tstride);
+        packTangentFrames(frames, quats.data() + first, count);
     }
 
     return new SurfaceOrientation(new OrientationImpl( { std::move(quats) } ));
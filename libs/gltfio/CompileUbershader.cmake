@@ -0,0 +1,28 @@
+# Compiles one of the ubershader materials with matc, using the list written by uberscan to prune
+# the archive. Materials that the glTF corpus doesn't use get an empty package instead, except for
+# lit_opaque which UbershaderLoader falls back to. The skinning and morphing variants are filtered
+# out when the corpus has neither skins nor morph targets.
+#
+# Usage:
+#   cmake -DMATC=<path> -DMATC_FLAGS=<flags separated by '|'> -DUSAGE=<uberscan output>
+#         -DINPUT=<material> -DOUTPUT=<package> -P CompileUbershader.cmake
+
+get_filename_component(NAME ${INPUT} NAME_WE)
+file(STRINGS ${USAGE} USED)
+
+list(FIND USED "material ${NAME}" MATERIAL_INDEX)
+if (MATERIAL_INDEX EQUAL -1 AND NOT NAME STREQUAL "lit_opaque")
+    file(WRITE ${OUTPUT} "")
+    return()
+endif()
+
+string(REPLACE "|" ";" FLAGS "${MATC_FLAGS}")
+list(FIND USED "skinning" SKINNING_INDEX)
+if (SKINNING_INDEX EQUAL -1)
+    list(APPEND FLAGS -V skinning)
+endif()
+
+execute_process(COMMAND ${MATC} ${FLAGS} -o ${OUTPUT} ${INPUT} RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "Unable to compile ${INPUT}")
+endif()
@@ -42,6 +42,10 @@ public:
      * Applies rotation, translation, and scale to entities that have been targeted by the given
      * animation definition. Uses filament::TransformManager.
      *
+     * The channels are evaluated in parallel on the engine's JobSystem, so this must be called
+     * from the thread that owns the engine. When many entities are animated, their transforms
+     * are updated within a local transform transaction.
+     *
      * @param animationIndex Zero-based index for the \c animation of interest.
      * @param time Elapsed time of interest in seconds.
      */
@@ -52,6 +56,9 @@ public:
      * the results into filament::RenderableManager::setBones.
      * Uses filament::TransformManager and filament::RenderableManager.
      *
+     * The bones of all skins are computed in parallel on the engine's JobSystem, then set with
+     * one call per renderable.
+     *
      * NOTE: this operation is independent of \c animation.
      */
     void updateBoneMatrices();
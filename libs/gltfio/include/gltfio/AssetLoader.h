@@ -58,6 +58,31 @@ struct AssetConfiguration {
 
     //! Optional default node name for anonymous nodes
     char* defaultNodeName = nullptr;
+
+    //! Allows assets to share the material instances of untextured glTF materials, when their
+    //! parameters are identical. The shared instances are listed by each asset that uses them and
+    //! are destroyed with the last one, so changing the parameters of one affects all of them.
+    bool shareMaterialInstances = false;
+
+    //! Draws the instances created by AssetLoader::createInstancedAsset() with a single instanced
+    //! renderable for each mesh, rather than one renderable per instance. Skinned and morphed
+    //! meshes, and instances added with AssetLoader::createInstance(), are still drawn on their
+    //! own. This requires a MaterialProvider that supports per-instance transforms, such as the
+    //! one returned by createMaterialGenerator(). See FilamentAsset::updateInstanceTransforms().
+    bool gpuInstancing = false;
+
+    //! Creates a compact vertex buffer for each primitive, holding only the positions, the
+    //! skinning attributes and the morph target positions, which the depth and shadow passes
+    //! draw instead of the full vertex buffer. See RenderableManager::Builder::depthGeometry().
+    //! Primitives with a MASKED material keep drawing their full vertex buffer.
+    bool depthVertices = false;
+
+    //! Packs the indices of all the primitives of an asset into a single index buffer, which
+    //! each primitive addresses with an offset and a count, rather than creating an index buffer
+    //! per primitive. This saves thousands of buffer objects for assets made of many small
+    //! primitives. The packed buffer holds 32-bit indices if any primitive needs them, 16-bit
+    //! indices otherwise.
+    bool packIndexBuffers = false;
 };
 
 /**
@@ -152,6 +177,16 @@ public:
      */
     FilamentAsset* createAssetFromBinary(const uint8_t* bytes, uint32_t nbytes);
 
+    /**
+     * Memory-maps the given JSON-based or GLB glTF 2.0 file and returns a bundle of Filament
+     * objects. Returns null on failure.
+     *
+     * Unlike createAssetFromBinary, the content of the file is not copied: the buffers of GLB
+     * files point into the mapping, which is released with the asset's source data. For large
+     * files, use this with ResourceConfiguration::mapBuffers to avoid copying buffer data.
+     */
+    FilamentAsset* createAssetFromFile(const char* path);
+
     /**
      * Consumes the contents of a glTF 2.0 file and produces a primary asset with one or more
      * instances. The primary asset has ownership over the instances.
@@ -205,7 +240,9 @@ public:
      *
      * This destroys entities, components, material instances, vertex buffers, index buffers,
      * and textures. This does not necessarily immediately free all source data, since
-     * texture decoding or GPU uploading might be underway.
+     * texture decoding or GPU uploading might be underway. Material instances shared with other
+     * assets (see AssetConfiguration::shareMaterialInstances) are destroyed with the last of
+     * them, which must happen before the loader is destroyed.
      */
     void destroyAsset(const FilamentAsset* asset);
 
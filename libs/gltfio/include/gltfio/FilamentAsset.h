@@ -139,6 +139,17 @@ public:
      */
     size_t popRenderables(utils::Entity* entities, size_t count) noexcept;
 
+    /**
+     * Checks if the given renderable is ready, i.e. if its geometry and all of its textures have
+     * been uploaded. Entities that are not renderables are always considered ready.
+     *
+     * This is the same condition that adds an entity to the queue of popRenderables(), it allows
+     * clients to query the status of particular entities during an asynchronous load.
+     *
+     * \see ResourceLoader#asyncBeginLoad
+     */
+    bool isRenderableReady(utils::Entity entity) const noexcept;
+
     /** Gets all material instances. These are already bound to renderables. */
     const filament::MaterialInstance* const* getMaterialInstances() const noexcept;
 
@@ -225,6 +236,15 @@ public:
      */
     const void* getSourceAsset() noexcept;
 
+    /**
+     * Updates the renderables shared by the instances of the asset (see
+     * AssetConfiguration::gpuInstancing) from the world transforms of the instances' entities.
+     *
+     * This must be called after moving or animating instances, since the entities of all but the
+     * first instance have no renderable of their own.
+     */
+    void updateInstanceTransforms() noexcept;
+
     /*! \cond PRIVATE */
 
     FilamentInstance** getAssetInstances() noexcept;
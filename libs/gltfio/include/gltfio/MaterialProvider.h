@@ -81,6 +81,7 @@ struct alignas(4) MaterialKey {
     bool hasSheenRoughnessTexture : 1;
     uint8_t sheenRoughnessUV : 7;
     bool hasSheen : 1;
+    bool hasInstanceTransforms : 1;
 };
 
 static_assert(sizeof(MaterialKey) == 16, "MaterialKey has unexpected padding.");
@@ -132,7 +133,9 @@ public:
     /**
      * Creates or fetches a compiled Filament material, then creates an instance from it.
      *
-     * @param config Specifies requirements; might be mutated due to resource constraints.
+     * @param config Specifies requirements; might be mutated due to resource constraints. Providers
+     *               that can't apply the per-instance transforms of instanced renderables clear
+     *               \c hasInstanceTransforms, the returned instance is then a regular one.
      * @param uvmap Output argument that gets populated with a small table that maps from a glTF uv
      *              index to a Filament uv index.
      * @param label Optional tag that is not a part of the cache key.
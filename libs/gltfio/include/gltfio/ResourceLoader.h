@@ -29,6 +29,7 @@ namespace gltfio {
 
 struct FFilamentAsset;
 class AssetPool;
+class TextureDecoder;
 
 /**
  * \struct ResourceConfiguration ResourceLoader.h gltfio/ResourceLoader.h
@@ -50,6 +51,19 @@ struct ResourceConfiguration {
     //! If true, computes the bounding boxes of all \c POSITION attibutes. Well formed glTF files
     //! do not need this, but it is useful for robustness.
     bool recomputeBoundingBoxes;
+
+    //! If true, buffers are loaded without copies: external buffer files are memory-mapped,
+    //! and the data given to ResourceLoader::addResourceData() is used in place. Vertex and
+    //! index data is then uploaded straight from this memory, which is released once the last
+    //! asset using it is destroyed (or releases its source data) and the ResourceLoader is
+    //! destroyed. In this mode, gltfio can modify the data given to addResourceData(), e.g. when
+    //! normalizeSkinningWeights is set.
+    bool mapBuffers = false;
+
+    //! If non-zero, the decoded images whose width or height exceed this size are loaded at a
+    //! reduced resolution, halved until they fit, e.g. to stay within a texture memory budget.
+    //! Their decoder downscales them, KTX containers are loaded as they are.
+    uint32_t maxTextureSize = 0;
 };
 
 /**
@@ -58,6 +72,11 @@ struct ResourceConfiguration {
  *
  * For a usage example, see the documentation for AssetLoader.
  *
+ * PNG and JPEG images are decoded into RGB8 or RGBA8 textures whose mipmaps are generated on the
+ * GPU, other decoders can be plugged in with #addTextureDecoder. Images stored in KTX 1.1
+ * containers are uploaded as they are, including their block-compressed mip chains (ASTC, ETC2 or
+ * S3TC). Textures whose format the device does not support are skipped.
+ *
  * ResourceLoader must be destroyed on the same thread that calls filament::Renderer::render()
  * because it listens to filament::backend::BufferDescriptor callbacks in order to determine when to
  * free CPU-side data blobs.
@@ -85,6 +104,9 @@ public:
      *
      * When loading GLB files (as opposed to JSON-based glTF files), clients typically do not
      * need to call this method.
+     *
+     * The buffer is copied when resources are loaded, unless ResourceConfiguration::mapBuffers
+     * is set, in which case its callback is only called when no asset uses it anymore.
      */
     void addResourceData(const char* uri, BufferDescriptor&& buffer);
 
@@ -93,6 +115,14 @@ public:
      */
     bool hasResourceData(const char* uri) const;
 
+    /**
+     * Adds a decoder for the images of the textures, which takes precedence over the decoders
+     * added before it and over the default one, based on stb_image. See TextureDecoder.
+     *
+     * The decoder isn't owned by the loader, it must outlive the loads that use it.
+     */
+    void addTextureDecoder(const TextureDecoder* decoder);
+
     /**
      * Loads resources for the given asset from the filesystem or data cache and "finalizes" the
      * asset by transforming the vertex data format if necessary, decoding image files, supplying
@@ -112,7 +142,12 @@ public:
      * Returns false if the loading process was unable to start.
      *
      * This is an alternative to #loadResources and requires periodic calls to #asyncUpdateLoad.
-     * On multi-threaded systems this creates threads for texture decoding.
+     * On multi-threaded systems this creates jobs for Draco decompression, tangent generation
+     * and texture decoding.
+     *
+     * Geometry is uploaded one primitive at a time and textures are uploaded as soon as they
+     * have been decoded, so renderables become ready progressively: see
+     * FilamentAsset#popRenderables and FilamentAsset#isRenderableReady.
      */
     bool asyncBeginLoad(FilamentAsset* asset);
 
@@ -123,7 +158,7 @@ public:
 
     /**
      * Updates an asynchronous load by performing any pending work that must take place
-     * on the main thread.
+     * on the main thread, such as uploading the primitives and textures that are ready.
      *
      * Clients must periodically call this until #asyncGetLoadProgress returns 100%.
      * After progress reaches 100%, calling this is harmless; it just does nothing.
@@ -131,7 +166,8 @@ public:
     void asyncUpdateLoad();
 
     /**
-     * Cancels pending decoder jobs, frees all CPU-side texel data, and flushes the Engine.
+     * Cancels pending decoder jobs, frees all CPU-side texel and geometry data, and flushes the
+     * Engine.
      *
      * Calling this is only necessary if the asyncBeginLoad API was used
      * and cancellation is required before progress reaches 100%.
@@ -140,7 +176,6 @@ public:
 
 private:
     bool loadResources(FFilamentAsset* asset, bool async);
-    void applySparseData(FFilamentAsset* asset) const;
     void normalizeSkinningWeights(FFilamentAsset* asset) const;
     void updateBoundingBoxes(FFilamentAsset* asset) const;
     AssetPool* mPool;
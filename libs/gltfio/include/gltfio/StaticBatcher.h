@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_STATICBATCHER_H
+#define GLTFIO_STATICBATCHER_H
+
+#include <filament/Engine.h>
+#include <filament/MaterialInstance.h>
+
+#include <gltfio/FilamentAsset.h>
+
+#include <utils/Entity.h>
+
+#include <math/mat4.h>
+#include <math/vec2.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gltfio {
+
+struct StaticBatcherImpl;
+
+/**
+ * \struct StaticBatcherConfig StaticBatcher.h gltfio/StaticBatcher.h
+ * \brief Construction parameters for StaticBatcher.
+ */
+struct StaticBatcherConfig {
+    //! Size of the side of the cubic cells that group the primitives, in world units.
+    float chunkSize = 16.0f;
+
+    //! Largest number of vertices of a batch, larger chunks are split into several batches.
+    uint32_t maxVertexCount = 1u << 18u;
+};
+
+/**
+ * \class StaticBatcher StaticBatcher.h gltfio/StaticBatcher.h
+ * \brief Merges static primitives that share a material into fewer renderables.
+ *
+ * Scenes made of many small static meshes (e.g. CAD data) create many renderables, each one
+ * costing a draw command, a per-renderable uniform buffer slot and a draw call. StaticBatcher
+ * merges the triangles of the primitives that share a filament::MaterialInstance and the same
+ * shadow and visibility settings into combined vertex and index buffers, with vertices that are
+ * pre-transformed into world space. The primitives are grouped into spatial chunks so that the
+ * batches can still be culled.
+ *
+ * Filament doesn't keep a CPU copy of its vertex buffers, so the geometry of the primitives is
+ * given by the client, or read from the source data of a glTF asset. The original renderables
+ * are left untouched: once build() is called, they should be removed from the scene and the
+ * batches added instead. The batches don't move, animating the original entities has no effect
+ * on them.
+ *
+ * Usage example:
+ *
+ * \code
+ * gltfio::StaticBatcher batcher(engine);
+ * batcher.addAsset(asset); // before asset->releaseSourceData()
+ * batcher.build();
+ * scene->removeEntities(batcher.getSourceEntities(), batcher.getSourceEntityCount());
+ * scene->addEntities(batcher.getEntities(), batcher.getEntityCount());
+ * \endcode
+ *
+ * The batches and their buffers are destroyed with the StaticBatcher.
+ */
+class UTILS_PUBLIC StaticBatcher {
+public:
+    /**
+     * CPU copy of the geometry of a triangle primitive, in object space. Only the positions are
+     * required, primitives with different sets of texture coordinates or colors aren't merged.
+     */
+    struct Geometry {
+        const filament::math::float3* positions = nullptr;
+        const filament::math::float3* normals = nullptr;
+        const filament::math::float4* tangents = nullptr;   //!< xyz, w is the bitangent sign
+        const filament::math::float2* uv0 = nullptr;
+        const filament::math::float2* uv1 = nullptr;
+        const filament::math::float4* colors = nullptr;
+        size_t vertexCount = 0;
+        const uint32_t* indices = nullptr;                  //!< nullptr for unindexed triangles
+        size_t indexCount = 0;
+    };
+
+    explicit StaticBatcher(filament::Engine* engine,
+            const StaticBatcherConfig& config = StaticBatcherConfig());
+    ~StaticBatcher();
+
+    StaticBatcher(const StaticBatcher&) = delete;
+    StaticBatcher& operator=(const StaticBatcher&) = delete;
+
+    /**
+     * Adds a triangle primitive that uses the given material, transformed by the given
+     * object-to-world matrix. The geometry is copied.
+     */
+    void addPrimitive(const Geometry& geometry, filament::MaterialInstance* materialInstance,
+            const filament::math::mat4f& transform, bool castShadows = true,
+            bool receiveShadows = true, uint8_t layerMask = 0x1);
+
+    /**
+     * Adds a primitive of a renderable. Its material, world transform, shadow settings and
+     * layer mask are read from the RenderableManager and the TransformManager, its geometry
+     * must be given since Filament doesn't keep it. Once all its primitives are added, the
+     * renderable is listed by getSourceEntities().
+     */
+    void addRenderablePrimitive(utils::Entity entity, size_t primitiveIndex,
+            const Geometry& geometry);
+
+    /**
+     * Adds the triangle primitives of the static renderables of a glTF asset, i.e. the ones that
+     * aren't skinned, morphed, instanced or compressed with Draco. This reads the source data of
+     * the asset, so this must be called after its resources are loaded and before
+     * FilamentAsset::releaseSourceData(), and isn't supported for instanced assets.
+     *
+     * The renderables whose primitives were all added are listed by getSourceEntities().
+     *
+     * @return the number of primitives added
+     */
+    size_t addAsset(const FilamentAsset* asset);
+
+    /**
+     * Creates the batched renderables from the primitives added so far, and releases their
+     * geometry. Returns the number of batches created.
+     */
+    size_t build();
+
+    /** Returns the batched renderables, which have no transform component. */
+    const utils::Entity* getEntities() const noexcept;
+    size_t getEntityCount() const noexcept;
+
+    /**
+     * Returns the renderables entirely replaced by the batches, see addRenderablePrimitive()
+     * and addAsset().
+     */
+    const utils::Entity* getSourceEntities() const noexcept;
+    size_t getSourceEntityCount() const noexcept;
+
+private:
+    StaticBatcherImpl* mImpl;
+};
+
+} // namespace gltfio
+
+#endif // GLTFIO_STATICBATCHER_H
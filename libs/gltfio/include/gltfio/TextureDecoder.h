@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GLTFIO_TEXTUREDECODER_H
+#define GLTFIO_TEXTUREDECODER_H
+
+#include <filament/Texture.h>
+
+#include <utils/compiler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gltfio {
+
+/**
+ * \class TextureDecoder TextureDecoder.h gltfio/TextureDecoder.h
+ * \brief Decodes the images of the textures loaded by ResourceLoader.
+ *
+ * ResourceLoader decodes PNG and JPEG images with stb_image by default. Clients can plug in
+ * decoders that are faster (e.g. libjpeg-turbo or a SIMD PNG decoder) or that support other
+ * formats with ResourceLoader::addTextureDecoder(): the first decoder whose getInfo() accepts an
+ * image decodes it. KTX containers are always handled by ResourceLoader itself.
+ *
+ * Images are decoded into 8-bit texels with the number of channels of the texture that receives
+ * them, straight into the filament::Texture::PixelBufferDescriptor that uploads them. They can
+ * also be decoded at a reduced resolution, see ResourceConfiguration::maxTextureSize.
+ *
+ * decode() is called concurrently from JobSystem jobs, and must be thread-safe.
+ */
+class UTILS_PUBLIC TextureDecoder {
+public:
+    //! Description of an encoded image.
+    struct Info {
+        uint32_t width;
+        uint32_t height;
+        uint8_t channels;   //!< number of channels stored in the image, 1 to 4
+    };
+
+    virtual ~TextureDecoder() = default;
+
+    /**
+     * Reads the description of an encoded image. Returns false if the image isn't in a format
+     * supported by this decoder, in which case the next decoder is tried.
+     */
+    virtual bool getInfo(const uint8_t* data, size_t size, Info* info) const noexcept = 0;
+
+    /**
+     * Decodes an image into tightly packed rows of 8-bit texels with the given number of channels
+     * (1 to 4). Gray images are expanded to RGB, missing alpha channels are set to 255.
+     *
+     * The image is downscaled by 2^lod, each of its dimensions is max(1, size >> lod), where size
+     * is given by getInfo(). Decoders that can, e.g. with the DCT scaling of JPEG decoders, should
+     * reduce the resolution while decoding.
+     *
+     * @param pixels receives the texels, with the R, RG, RGB or RGBA format and the UBYTE type,
+     *               and a callback that releases them once they have been uploaded.
+     * @return false if the image could not be decoded.
+     */
+    virtual bool decode(const uint8_t* data, size_t size, uint8_t channels, uint8_t lod,
+            filament::Texture::PixelBufferDescriptor* pixels) const noexcept = 0;
+
+    //! Pixel format of the texels decoded with the given number of channels.
+    static filament::Texture::Format getFormat(uint8_t channels) noexcept;
+
+    /**
+     * Creates the default PNG and JPEG decoder, which is based on stb_image and reduces the
+     * resolution of images with a box filter after decoding them. Destroy it with delete.
+     */
+    static TextureDecoder* createStbDecoder();
+};
+
+} // namespace gltfio
+
+#endif // GLTFIO_TEXTUREDECODER_H
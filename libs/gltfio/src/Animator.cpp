@@ -25,7 +25,9 @@
 #include <filament/RenderableManager.h>
 #include <filament/TransformManager.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Log.h>
+#include <utils/Systrace.h>
 
 #include <math/mat4.h>
 #include <math/quat.h>
@@ -33,7 +35,7 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
-#include <map>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -44,14 +46,27 @@ using namespace utils;
 
 namespace gltfio {
 
-using TimeValues = std::map<float, size_t>;
+using TimeValues = std::vector<float>;
 using SourceValues = std::vector<float>;
 using BoneVector = std::vector<filament::math::mat4f>;
 
+const uint8_t* computeBindingData(const cgltf_accessor* accessor);
+
 struct Sampler {
     TimeValues times;
     SourceValues values;
     enum { LINEAR, STEP, CUBIC } interpolation;
+
+    // Index of the keyframe found by the previous search. Animations are usually played forward,
+    // so the next search starts from there.
+    size_t cursor = 0;
+};
+
+// The keyframes around the current time of a sampler, and the interpolant between them.
+struct Keyframes {
+    size_t prev;
+    size_t next;
+    float t;
 };
 
 struct Channel {
@@ -60,16 +75,45 @@ struct Channel {
     enum { TRANSLATION, ROTATION, SCALE, WEIGHTS } transformType;
 };
 
+// The channels of an animation that target the same entity, which are applied together.
+struct ChannelRange {
+    uint32_t first;
+    uint32_t last;
+};
+
+// The new local transform and morph weights of the entity targeted by a ChannelRange.
+struct TargetState {
+    mat4f transform;
+    float4 weights;
+    bool hasTransform;
+    bool hasWeights;
+};
+
+// A renderable deformed by a skin, its bones are stored in AnimatorImpl::boneMatrices.
+struct SkinTarget {
+    const Skin* skin;
+    utils::Entity entity;
+    RenderableManager::Instance renderable;
+    size_t firstBone;
+};
+
 struct Animation {
     float duration;
     std::string name;
     vector<Sampler> samplers;
-    vector<Channel> channels;
+    vector<Channel> channels; // sorted by target entity
+    vector<ChannelRange> targets;
 };
 
 struct AnimatorImpl {
     vector<Animation> animations;
     BoneVector boneMatrices;
+
+    // Scratch space of applyAnimation() and updateBoneMatrices(), kept to avoid allocations.
+    vector<Keyframes> keyframes;
+    vector<TargetState> targetStates;
+    vector<SkinTarget> skinTargets;
+
     FFilamentAsset* asset = nullptr;
     FFilamentInstance* instance = nullptr;
     RenderableManager* renderableManager;
@@ -77,14 +121,10 @@ struct AnimatorImpl {
 };
 
 static void createSampler(const cgltf_animation_sampler& src, Sampler& dst) {
-    // Copy the time values into a red-black tree.
+    // Copy the time values, which glTF requires to be strictly increasing.
     const cgltf_accessor* timelineAccessor = src.input;
-    const uint8_t* timelineBlob = (const uint8_t*) timelineAccessor->buffer_view->buffer->data;
-    const float* timelineFloats = (const float*) (timelineBlob + timelineAccessor->offset +
-            timelineAccessor->buffer_view->offset);
-    for (size_t i = 0, len = timelineAccessor->count; i < len; ++i) {
-        dst.times[timelineFloats[i]] = i;
-    }
+    const float* timelineFloats = (const float*) computeBindingData(timelineAccessor);
+    dst.times.assign(timelineFloats, timelineFloats + timelineAccessor->count);
 
     // Convert source data to float.
     const cgltf_accessor* valuesAccessor = src.output;
@@ -190,134 +230,78 @@ static void addChannels(const NodeMap& nodeMap, const cgltf_animation& srcAnim,
         setTransformType(srcChannel, dstChannel);
         dst.channels.push_back(dstChannel);
     }
-}
-
-Animator::Animator(FFilamentAsset* asset, FFilamentInstance* instance) {
-    assert(asset->mResourcesLoaded && asset->mSourceAsset);
-    mImpl = new AnimatorImpl();
-    mImpl->asset = asset;
-    mImpl->instance = instance;
-    mImpl->renderableManager = &asset->mEngine->getRenderableManager();
-    mImpl->transformManager = &asset->mEngine->getTransformManager();
 
-    const cgltf_data* srcAsset = asset->mSourceAsset->hierarchy;
-    const cgltf_animation* srcAnims = srcAsset->animations;
-    for (cgltf_size i = 0, len = srcAsset->animations_count; i < len; ++i) {
-        const cgltf_animation& anim = srcAnims[i];
-        if (!validateAnimation(anim)) {
-            slog.e << "Disabling animation due to validation failure." << io::endl;
-            return;
+    // Sort the channels by target, so that the channels of each entity can be applied together.
+    // The sort is stable, when several channels animate the same property, the last one wins.
+    std::stable_sort(dst.channels.begin(), dst.channels.end(),
+            [](auto const& lhs, auto const& rhs) {
+        return lhs.targetEntity.getId() < rhs.targetEntity.getId();
+    });
+    dst.targets.clear();
+    for (uint32_t i = 0, n = dst.channels.size(); i < n; ++i) {
+        if (i == 0 || dst.channels[i].targetEntity != dst.channels[i - 1].targetEntity) {
+            dst.targets.push_back({ i, i });
         }
+        dst.targets.back().last = i + 1;
     }
+}
 
-    // Loop over the glTF animation definitions.
-    mImpl->animations.resize(srcAsset->animations_count);
-    for (cgltf_size i = 0, len = srcAsset->animations_count; i < len; ++i) {
-        const cgltf_animation& srcAnim = srcAnims[i];
-        Animation& dstAnim = mImpl->animations[i];
-        dstAnim.duration = 0;
-        if (srcAnim.name) {
-            dstAnim.name = srcAnim.name;
-        }
-
-        // Import each glTF sampler into a custom data structure.
-        cgltf_animation_sampler* srcSamplers = srcAnim.samplers;
-        dstAnim.samplers.resize(srcAnim.samplers_count);
-        for (cgltf_size j = 0, nsamps = srcAnim.samplers_count; j < nsamps; ++j) {
-            const cgltf_animation_sampler& srcSampler = srcSamplers[j];
-            Sampler& dstSampler = dstAnim.samplers[j];
-            createSampler(srcSampler, dstSampler);
-            if (dstSampler.times.size() > 1) {
-                float maxtime = (--dstSampler.times.end())->first;
-                dstAnim.duration = std::max(dstAnim.duration, maxtime);
-            }
-        }
+// Finds the keyframes around the given time, starting from the ones of the previous search.
+static Keyframes findKeyframes(Sampler& sampler, float time) {
+    const TimeValues& times = sampler.times;
+    const size_t count = times.size();
 
-        // Import each glTF channel into a custom data structure.
-        if (instance) {
-            addChannels(instance->nodeMap, srcAnim, dstAnim);
-        } else if (!asset->isInstanced()) {
-            addChannels(asset->mNodeMap, srcAnim, dstAnim);
+    // Find the first keyframe after the given time, or the keyframe that matches it exactly.
+    auto isLowerBound = [&times, count, time](size_t i) {
+        return (i == count || times[i] >= time) && (i == 0 || times[i - 1] < time);
+    };
+    size_t next = sampler.cursor;
+    if (!isLowerBound(next)) {
+        if (next < count && isLowerBound(next + 1)) {
+            next++;
         } else {
-            for (FFilamentInstance* instance : asset->mInstances) {
-                addChannels(instance->nodeMap, srcAnim, dstAnim);
-            }
+            next = std::lower_bound(times.begin(), times.end(), time) - times.begin();
         }
     }
-}
+    sampler.cursor = next;
 
-void Animator::addInstance(FFilamentInstance* instance) {
-    const cgltf_data* srcAsset = mImpl->asset->mSourceAsset->hierarchy;
-    const cgltf_animation* srcAnims = srcAsset->animations;
-    for (cgltf_size i = 0, len = srcAsset->animations_count; i < len; ++i) {
-        const cgltf_animation& srcAnim = srcAnims[i];
-        Animation& dstAnim = mImpl->animations[i];
-        addChannels(instance->nodeMap, srcAnim, dstAnim);
+    // Compute the interpolant (between 0 and 1) and determine the keyframe pair.
+    if (next == count) {
+        return { count - 1, count - 1, 0.0f };
     }
+    if (next == 0) {
+        return { 0, 0, 0.0f };
+    }
+    const float nextTime = times[next];
+    const float prevTime = times[next - 1];
+    const float deltaTime = nextTime - prevTime;
+    assert(deltaTime >= 0);
+    const float t = deltaTime > 0 ? (time - prevTime) / deltaTime : 0.0f;
+    return { next - 1, next, sampler.interpolation == Sampler::STEP ? 0.0f : t };
 }
 
-Animator::~Animator() {
-    delete mImpl;
-}
-
-size_t Animator::getAnimationCount() const {
-    return mImpl->animations.size();
-}
-
-void Animator::applyAnimation(size_t animationIndex, float time) const {
-    const Animation& anim = mImpl->animations[animationIndex];
-    TransformManager* transformManager = mImpl->transformManager;
-    RenderableManager* renderableManager = mImpl->renderableManager;
-    time = fmod(time, anim.duration);
-    for (const auto& channel : anim.channels) {
-        const Sampler* sampler = channel.sourceData;
+// Evaluates the channels that target a single entity, this is run in a job.
+static void applyChannels(const Channel* channels, size_t count, const Sampler* samplers,
+        const Keyframes* keyframes, const TransformManager& transformManager,
+        TargetState* state) {
+    enum { TRANSLATION = 1, ROTATION = 2, SCALE = 4, ALL = 7 };
+    uint32_t animated = 0;
+    float3 scale;
+    quatf rotation;
+    float3 translation;
+    state->hasWeights = false;
+
+    for (const Channel* channel = channels; channel != channels + count; ++channel) {
+        const Sampler* sampler = channel->sourceData;
         if (sampler->times.size() < 2) {
             continue;
         }
+        const Keyframes& keyframe = keyframes[sampler - samplers];
+        const size_t prevIndex = keyframe.prev;
+        const size_t nextIndex = keyframe.next;
+        const float t = keyframe.t;
 
-        TransformManager::Instance node = transformManager->getInstance(channel.targetEntity);
-        const TimeValues& times = sampler->times;
-
-        // Find the first keyframe after the given time, or the keyframe that matches it exactly.
-        TimeValues::const_iterator iter = times.lower_bound(time);
-
-        // Compute the interpolant (between 0 and 1) and determine the keyframe pair.
-        float t = 0.0f;
-        size_t nextIndex;
-        size_t prevIndex;
-        if (iter == times.end()) {
-            nextIndex = times.size() - 1;
-            prevIndex = nextIndex;
-        } else if (iter == times.begin()) {
-            nextIndex = 0;
-            prevIndex = 0;
-        } else {
-            TimeValues::const_iterator prev = iter; --prev;
-            nextIndex = iter->second;
-            prevIndex = prev->second;
-            const float nextTime = iter->first;
-            const float prevTime = prev->first;
-            float deltaTime = nextTime - prevTime;
-            assert(deltaTime >= 0);
-            if (deltaTime > 0) {
-                t = (time - prevTime) / deltaTime;
-            }
-        }
-
-        // Perform the interpolation. This is a simple but inefficient implementation; Filament
-        // stores transforms as mat4's but glTF animation is based on TRS (translation rotation
-        // scale).
-        mat4f xform = transformManager->getTransform(node);
-        float3 scale;
-        quatf rotation;
-        float3 translation;
-        decomposeMatrix(xform, &translation, &rotation, &scale);
-
-        if (sampler->interpolation == Sampler::STEP) {
-            t = 0.0f;
-        }
-
-        switch (channel.transformType) {
+        switch (channel->transformType) {
 
             case Channel::SCALE: {
                 const float3* srcVec3 = (const float3*) sampler->values.data();
@@ -330,6 +314,7 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                 } else {
                     scale = ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]);
                 }
+                animated |= SCALE;
                 break;
             }
 
@@ -344,6 +329,7 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                 } else {
                     translation = ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]);
                 }
+                animated |= TRANSLATION;
                 break;
             }
 
@@ -358,14 +344,15 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                 } else {
                     rotation = slerp(srcQuat[prevIndex], srcQuat[nextIndex], t);
                 }
+                animated |= ROTATION;
                 break;
             }
 
             case Channel::WEIGHTS: {
                 float4 weights(0, 0, 0, 0);
                 const float* const samplerValues = sampler->values.data();
-                assert(sampler->values.size() % times.size() == 0);
-                const int valuesPerKeyframe = sampler->values.size() / times.size();
+                assert(sampler->values.size() % sampler->times.size() == 0);
+                const int valuesPerKeyframe = sampler->values.size() / sampler->times.size();
 
                 if (sampler->interpolation == Sampler::CUBIC) {
                     assert(valuesPerKeyframe % 3 == 0);
@@ -390,59 +377,228 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                         weights[comp] = (1 - t) * previous + t * current;
                     }
                 }
+                state->weights = weights;
+                state->hasWeights = true;
+                break;
+            }
+        }
+    }
+
+    state->hasTransform = animated != 0;
+    if (!state->hasTransform) {
+        return;
+    }
+
+    // Filament stores transforms as mat4's but glTF animation is based on TRS (translation
+    // rotation scale), the properties that aren't animated are extracted from the current
+    // transform.
+    if (animated != ALL) {
+        float3 currentScale;
+        quatf currentRotation;
+        float3 currentTranslation;
+        const mat4f xform = transformManager.getTransform(
+                transformManager.getInstance(channels->targetEntity));
+        decomposeMatrix(xform, &currentTranslation, &currentRotation, &currentScale);
+        translation = (animated & TRANSLATION) ? translation : currentTranslation;
+        rotation = (animated & ROTATION) ? rotation : currentRotation;
+        scale = (animated & SCALE) ? scale : currentScale;
+    }
+    state->transform = composeMatrix(translation, rotation, scale);
+}
+
+Animator::Animator(FFilamentAsset* asset, FFilamentInstance* instance) {
+    assert(asset->mResourcesLoaded && asset->mSourceAsset);
+    mImpl = new AnimatorImpl();
+    mImpl->asset = asset;
+    mImpl->instance = instance;
+    mImpl->renderableManager = &asset->mEngine->getRenderableManager();
+    mImpl->transformManager = &asset->mEngine->getTransformManager();
+
+    const cgltf_data* srcAsset = asset->mSourceAsset->hierarchy;
+    const cgltf_animation* srcAnims = srcAsset->animations;
+    for (cgltf_size i = 0, len = srcAsset->animations_count; i < len; ++i) {
+        const cgltf_animation& anim = srcAnims[i];
+        if (!validateAnimation(anim)) {
+            slog.e << "Disabling animation due to validation failure." << io::endl;
+            return;
+        }
+    }
 
-                auto renderable = renderableManager->getInstance(channel.targetEntity);
-                renderableManager->setMorphWeights(renderable, weights);
-                continue;
+    // Loop over the glTF animation definitions.
+    mImpl->animations.resize(srcAsset->animations_count);
+    for (cgltf_size i = 0, len = srcAsset->animations_count; i < len; ++i) {
+        const cgltf_animation& srcAnim = srcAnims[i];
+        Animation& dstAnim = mImpl->animations[i];
+        dstAnim.duration = 0;
+        if (srcAnim.name) {
+            dstAnim.name = srcAnim.name;
+        }
+
+        // Import each glTF sampler into a custom data structure.
+        cgltf_animation_sampler* srcSamplers = srcAnim.samplers;
+        dstAnim.samplers.resize(srcAnim.samplers_count);
+        for (cgltf_size j = 0, nsamps = srcAnim.samplers_count; j < nsamps; ++j) {
+            const cgltf_animation_sampler& srcSampler = srcSamplers[j];
+            Sampler& dstSampler = dstAnim.samplers[j];
+            createSampler(srcSampler, dstSampler);
+            if (dstSampler.times.size() > 1) {
+                float maxtime = dstSampler.times.back();
+                dstAnim.duration = std::max(dstAnim.duration, maxtime);
+            }
+        }
+
+        // Import each glTF channel into a custom data structure.
+        if (instance) {
+            addChannels(instance->nodeMap, srcAnim, dstAnim);
+        } else if (!asset->isInstanced()) {
+            addChannels(asset->mNodeMap, srcAnim, dstAnim);
+        } else {
+            for (FFilamentInstance* instance : asset->mInstances) {
+                addChannels(instance->nodeMap, srcAnim, dstAnim);
             }
         }
+    }
+}
 
-        xform = composeMatrix(translation, rotation, scale);
-        transformManager->setTransform(node, xform);
+void Animator::addInstance(FFilamentInstance* instance) {
+    const cgltf_data* srcAsset = mImpl->asset->mSourceAsset->hierarchy;
+    const cgltf_animation* srcAnims = srcAsset->animations;
+    for (cgltf_size i = 0, len = srcAsset->animations_count; i < len; ++i) {
+        const cgltf_animation& srcAnim = srcAnims[i];
+        Animation& dstAnim = mImpl->animations[i];
+        addChannels(instance->nodeMap, srcAnim, dstAnim);
+    }
+}
+
+Animator::~Animator() {
+    delete mImpl;
+}
+
+size_t Animator::getAnimationCount() const {
+    return mImpl->animations.size();
+}
+
+void Animator::applyAnimation(size_t animationIndex, float time) const {
+    SYSTRACE_CALL();
+
+    Animation& anim = mImpl->animations[animationIndex];
+    TransformManager* transformManager = mImpl->transformManager;
+    RenderableManager* renderableManager = mImpl->renderableManager;
+    time = fmod(time, anim.duration);
+
+    // Search the keyframes once per sampler, rather than once per channel.
+    vector<Keyframes>& keyframes = mImpl->keyframes;
+    keyframes.resize(anim.samplers.size());
+    for (size_t i = 0, n = anim.samplers.size(); i < n; ++i) {
+        if (anim.samplers[i].times.size() >= 2) {
+            keyframes[i] = findKeyframes(anim.samplers[i], time);
+        }
+    }
+
+    // Evaluate the new state of each target in parallel, only their transforms are read.
+    vector<TargetState>& states = mImpl->targetStates;
+    states.resize(anim.targets.size());
+    auto evaluate = [&anim, &keyframes, &states, transformManager](uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; ++i) {
+            const ChannelRange& range = anim.targets[i];
+            applyChannels(anim.channels.data() + range.first, range.last - range.first,
+                    anim.samplers.data(), keyframes.data(), *transformManager, &states[i]);
+        }
+    };
+    JobSystem& js = mImpl->asset->mEngine->getJobSystem();
+    JobSystem::Job* job = jobs::parallel_for(js, nullptr, 0, uint32_t(states.size()),
+            std::cref(evaluate), jobs::CountSplitter<64>());
+    js.runAndWait(job);
+
+    // Then update the components. When many entities are animated, updating all the world
+    // transforms once is cheaper than updating the subtree of each animated entity.
+    const bool useTransaction = states.size() >= 16;
+    if (useTransaction) {
+        transformManager->openLocalTransformTransaction();
+    }
+    for (size_t i = 0, n = states.size(); i < n; ++i) {
+        const TargetState& state = states[i];
+        const Entity entity = anim.channels[anim.targets[i].first].targetEntity;
+        if (state.hasTransform) {
+            transformManager->setTransform(transformManager->getInstance(entity),
+                    state.transform);
+        }
+        if (state.hasWeights) {
+            renderableManager->setMorphWeights(renderableManager->getInstance(entity),
+                    state.weights);
+        }
+    }
+    if (useTransaction) {
+        transformManager->commitLocalTransformTransaction();
     }
 }
 
 void Animator::updateBoneMatrices() {
+    SYSTRACE_CALL();
+
     auto renderableManager = mImpl->renderableManager;
     auto transformManager = mImpl->transformManager;
 
-    auto update = [=](const SkinVector& skins, BoneVector& boneVector) {
+    // Gather the skinned renderables of all the instances, and allot their bones.
+    vector<SkinTarget>& targets = mImpl->skinTargets;
+    targets.clear();
+    size_t boneCount = 0;
+    auto gather = [&](const SkinVector& skins) {
         for (const auto& skin : skins) {
-            size_t njoints = skin.joints.size();
-            boneVector.resize(njoints);
             for (const auto& entity : skin.targets) {
                 auto renderable = renderableManager->getInstance(entity);
                 if (!renderable) {
                     continue;
                 }
-                mat4f inverseGlobalTransform;
-                auto xformable = transformManager->getInstance(entity);
-                if (xformable) {
-                    inverseGlobalTransform = inverse(transformManager->getWorldTransform(xformable));
-                }
-                for (size_t boneIndex = 0; boneIndex < njoints; ++boneIndex) {
-                    const auto& joint = skin.joints[boneIndex];
-                    TransformManager::Instance jointInstance = transformManager->getInstance(joint);
-                    mat4f globalJointTransform = transformManager->getWorldTransform(jointInstance);
-                    boneVector[boneIndex] =
-                            inverseGlobalTransform *
-                            globalJointTransform *
-                            skin.inverseBindMatrices[boneIndex];
-                }
-                renderableManager->setBones(renderable, boneVector.data(), boneVector.size());
+                targets.push_back({ &skin, entity, renderable, boneCount });
+                boneCount += skin.joints.size();
             }
         }
     };
-
     if (mImpl->instance) {
-        update(mImpl->instance->skins, mImpl->boneMatrices);
+        gather(mImpl->instance->skins);
     } else if (!mImpl->asset->isInstanced()) {
-        update(mImpl->asset->mSkins, mImpl->boneMatrices);
+        gather(mImpl->asset->mSkins);
     } else {
         for (FFilamentInstance* instance : mImpl->asset->mInstances) {
-            update(instance->skins, mImpl->boneMatrices);
+            gather(instance->skins);
         }
     }
+    BoneVector& boneVector = mImpl->boneMatrices;
+    boneVector.resize(boneCount);
+
+    // Compute the bones in parallel, this only reads the world transforms.
+    auto compute = [&targets, &boneVector, transformManager](uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; ++i) {
+            const SkinTarget& target = targets[i];
+            const Skin& skin = *target.skin;
+            mat4f inverseGlobalTransform;
+            auto xformable = transformManager->getInstance(target.entity);
+            if (xformable) {
+                inverseGlobalTransform = inverse(transformManager->getWorldTransform(xformable));
+            }
+            mat4f* bones = boneVector.data() + target.firstBone;
+            for (size_t boneIndex = 0, n = skin.joints.size(); boneIndex < n; ++boneIndex) {
+                const auto& joint = skin.joints[boneIndex];
+                TransformManager::Instance jointInstance = transformManager->getInstance(joint);
+                mat4f globalJointTransform = transformManager->getWorldTransform(jointInstance);
+                bones[boneIndex] =
+                        inverseGlobalTransform *
+                        globalJointTransform *
+                        skin.inverseBindMatrices[boneIndex];
+            }
+        }
+    };
+    JobSystem& js = mImpl->asset->mEngine->getJobSystem();
+    JobSystem::Job* job = jobs::parallel_for(js, nullptr, 0, uint32_t(targets.size()),
+            std::cref(compute), jobs::CountSplitter<4>());
+    js.runAndWait(job);
+
+    // Finally, hand the bones of each renderable to the engine in a single call.
+    for (const SkinTarget& target : targets) {
+        renderableManager->setBones(target.renderable, boneVector.data() + target.firstBone,
+                target.skin->joints.size());
+    }
 }
 
 float Animator::getAnimationDuration(size_t animationIndex) const {
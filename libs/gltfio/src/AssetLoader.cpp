@@ -20,6 +20,7 @@
 
 #include "FFilamentAsset.h"
 #include "GltfEnums.h"
+#include "MappedFile.h"
 
 #include <filament/Box.h>
 #include <filament/Camera.h>
@@ -38,6 +39,8 @@
 #include <math/vec4.h>
 
 #include <utils/EntityManager.h>
+#include <utils/Hash.h>
+#include <utils/JobSystem.h>
 #include <utils/Log.h>
 #include <utils/Panic.h>
 #include <utils/NameComponentManager.h>
@@ -47,6 +50,8 @@
 
 #include <vector>
 
+#include <string.h>
+
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
 
@@ -63,6 +68,60 @@ void importSkins(const cgltf_data* gltf, const NodeMap& nodeMap, SkinVector& dst
 
 static const auto FREE_CALLBACK = [](void* mem, size_t, void*) { free(mem); };
 
+// The maximum number of instances of a renderable with per-instance transforms, as enforced by
+// RenderableManager::Builder::instances().
+static constexpr size_t MAX_GPU_INSTANCES = 256;
+
+// Content that AssetLoader generates for the buffers of a primitive: the trivial indices of
+// primitives that have none, and the constant attributes that stand in for missing ones. The
+// primitives only record what they need, the data is filled in by jobs once all of them have
+// been created, then uploaded from the loader's thread.
+struct GeneratedBuffer {
+    enum Type : uint8_t { INDICES_16, INDICES_32, DUMMY_VERTICES };
+    Type type;
+    uint8_t bufferIndex;        // for vertex buffers only
+    uint32_t count;             // number of indices or vertices
+    uint32_t byteOffset;        // for index buffers only
+    IndexBuffer* indexBuffer;
+    VertexBuffer* vertexBuffer;
+    void* data;
+    size_t size;
+};
+
+static void fillGeneratedBuffer(GeneratedBuffer& buffer) {
+    switch (buffer.type) {
+        case GeneratedBuffer::INDICES_16: {
+            buffer.size = buffer.count * sizeof(uint16_t);
+            uint16_t* indices = (uint16_t*) malloc(buffer.size);
+            for (uint32_t i = 0; i < buffer.count; ++i) {
+                indices[i] = uint16_t(i);
+            }
+            buffer.data = indices;
+            break;
+        }
+        case GeneratedBuffer::INDICES_32: {
+            buffer.size = buffer.count * sizeof(uint32_t);
+            uint32_t* indices = (uint32_t*) malloc(buffer.size);
+            for (uint32_t i = 0; i < buffer.count; ++i) {
+                indices[i] = i;
+            }
+            buffer.data = indices;
+            break;
+        }
+        case GeneratedBuffer::DUMMY_VERTICES:
+            buffer.size = buffer.count * sizeof(ubyte4);
+            buffer.data = malloc(buffer.size);
+            memset(buffer.data, 0xff, buffer.size);
+            break;
+    }
+}
+
+// The size of an element of an accessor, which is smaller than its stride when the buffer view is
+// interleaved.
+uint32_t computeElementSize(const cgltf_accessor* accessor) {
+    return uint32_t(cgltf_calc_size(accessor->type, accessor->component_type));
+}
+
 // Sometimes a glTF bufferview includes unused data at the end (e.g. in skinning.gltf) so we need to
 // compute the correct size of the vertex buffer. Filament automatically infers the size of
 // driver-level vertex buffers from the attribute data (stride, count, offset) and clients are
@@ -70,12 +129,36 @@ static const auto FREE_CALLBACK = [](void* mem, size_t, void*) { free(mem); };
 // exist in the glTF we need to compute it manually. This is a bit of a cheat, cgltf_calc_size is
 // private but its implementation file is available in this cpp file.
 uint32_t computeBindingSize(const cgltf_accessor* accessor) {
-    cgltf_size element_size = cgltf_calc_size(accessor->type, accessor->component_type);
-    return uint32_t(accessor->stride * (accessor->count - 1) + element_size);
+    return uint32_t(accessor->stride * (accessor->count - 1) + computeElementSize(accessor));
+}
+
+// Gets the address of the first element of an accessor, or null if its buffer hasn't been loaded.
+// Buffer views compressed with EXT_meshopt_compression are decoded into their own memory, which
+// cgltf_buffer_view_data() knows about.
+const uint8_t* computeBindingData(const cgltf_accessor* accessor) {
+    const uint8_t* data = cgltf_buffer_view_data(accessor->buffer_view);
+    return data ? data + accessor->offset : nullptr;
 }
 
-uint32_t computeBindingOffset(const cgltf_accessor* accessor) {
-    return uint32_t(accessor->offset + accessor->buffer_view->offset);
+// Gets the "min" or "max" property of a positions accessor. With KHR_mesh_quantization, the
+// bounds are expressed in the accessor's component type, so normalized ones need to be converted.
+static float3 getPositionBound(const cgltf_accessor* accessor, const cgltf_float* bound) {
+    const float3 value(bound[0], bound[1], bound[2]);
+    if (!accessor->normalized) {
+        return value;
+    }
+    switch (accessor->component_type) {
+        case cgltf_component_type_r_8:
+            return max(value / 127.0f, float3(-1.0f));
+        case cgltf_component_type_r_8u:
+            return value / 255.0f;
+        case cgltf_component_type_r_16:
+            return max(value / 32767.0f, float3(-1.0f));
+        case cgltf_component_type_r_16u:
+            return value / 65535.0f;
+        default:
+            return value;
+    }
 }
 
 static const char* getNodeName(const cgltf_node* node, const char* defaultNodeName) {
@@ -86,6 +169,69 @@ static const char* getNodeName(const cgltf_node* node, const char* defaultNodeNa
     return defaultNodeName;
 }
 
+// The inputs of a material instance without textures. Two glTF materials with identical inputs
+// are rendered identically, even when they come from different assets, so they can share their
+// material instance. This key is processed by MurmurHashFn so please make padding explicit.
+struct alignas(4) SharedMaterialKey {
+    MaterialKey config;
+    float baseColorFactor[4];
+    float diffuseFactor[4];
+    float emissiveFactor[3];
+    float specularFactor[3];
+    float sheenColorFactor[3];
+    float metallicFactor;
+    float roughnessFactor;
+    float glossinessFactor;
+    float clearCoatFactor;
+    float clearCoatRoughnessFactor;
+    float sheenRoughnessFactor;
+    float transmissionFactor;
+    float alphaCutoff;
+};
+
+static_assert(sizeof(SharedMaterialKey) == 116, "SharedMaterialKey has unexpected padding.");
+
+bool operator==(const SharedMaterialKey& k1, const SharedMaterialKey& k2) {
+    return memcmp(&k1, &k2, sizeof(SharedMaterialKey)) == 0;
+}
+
+struct SharedMaterialEntry {
+    MaterialInstance* instance;
+    UvMap uvmap;
+    uint32_t refs; // number of assets using the instance
+};
+
+static bool hasTextures(const MaterialKey& config) {
+    return config.hasBaseColorTexture || config.hasMetallicRoughnessTexture ||
+            config.hasNormalTexture || config.hasOcclusionTexture || config.hasEmissiveTexture ||
+            config.hasClearCoatTexture || config.hasClearCoatRoughnessTexture ||
+            config.hasClearCoatNormalTexture || config.hasTransmissionTexture ||
+            config.hasSheenColorTexture || config.hasSheenRoughnessTexture;
+}
+
+static SharedMaterialKey getSharedMaterialKey(const MaterialKey& config,
+        const cgltf_material* inputMat) {
+    SharedMaterialKey key;
+    memset(&key, 0, sizeof(key));
+    key.config = config;
+    const auto& mrConfig = inputMat->pbr_metallic_roughness;
+    const auto& sgConfig = inputMat->pbr_specular_glossiness;
+    std::copy_n(mrConfig.base_color_factor, 4, key.baseColorFactor);
+    std::copy_n(sgConfig.diffuse_factor, 4, key.diffuseFactor);
+    std::copy_n(inputMat->emissive_factor, 3, key.emissiveFactor);
+    std::copy_n(sgConfig.specular_factor, 3, key.specularFactor);
+    std::copy_n(inputMat->sheen.sheen_color_factor, 3, key.sheenColorFactor);
+    key.metallicFactor = mrConfig.metallic_factor;
+    key.roughnessFactor = mrConfig.roughness_factor;
+    key.glossinessFactor = sgConfig.glossiness_factor;
+    key.clearCoatFactor = inputMat->clearcoat.clearcoat_factor;
+    key.clearCoatRoughnessFactor = inputMat->clearcoat.clearcoat_roughness_factor;
+    key.sheenRoughnessFactor = inputMat->sheen.sheen_roughness_factor;
+    key.transmissionFactor = inputMat->transmission.transmission_factor;
+    key.alphaCutoff = inputMat->alpha_cutoff;
+    return key;
+}
+
 struct FAssetLoader : public AssetLoader {
     FAssetLoader(const AssetConfiguration& config) :
             mEntityManager(config.entities ? *config.entities : EntityManager::get()),
@@ -94,10 +240,15 @@ struct FAssetLoader : public AssetLoader {
             mTransformManager(config.engine->getTransformManager()),
             mMaterials(config.materials),
             mEngine(config.engine),
-            mDefaultNodeName(config.defaultNodeName) {}
+            mDefaultNodeName(config.defaultNodeName),
+            mShareMaterialInstances(config.shareMaterialInstances),
+            mGpuInstancing(config.gpuInstancing),
+            mDepthVertices(config.depthVertices),
+            mPackIndexBuffers(config.packIndexBuffers) {}
 
     FFilamentAsset* createAssetFromJson(const uint8_t* bytes, uint32_t nbytes);
     FFilamentAsset* createAssetFromBinary(const uint8_t* bytes, uint32_t nbytes);
+    FFilamentAsset* createAssetFromFile(const char* path);
     FFilamentAsset* createInstancedAsset(const uint8_t* bytes, uint32_t numBytes,
         FilamentInstance** instances, size_t numInstances);
     FilamentInstance* createInstance(FFilamentAsset* primary);
@@ -110,7 +261,12 @@ struct FAssetLoader : public AssetLoader {
     }
 
     void destroyAsset(const FFilamentAsset* asset) {
+        // Release the shared material instances once the renderables that use them are gone.
+        const std::vector<MaterialInstance*> shared = asset->mSharedMaterialInstances;
         delete asset;
+        for (MaterialInstance* mi : shared) {
+            releaseSharedMaterialInstance(mi);
+        }
     }
 
     size_t getMaterialsCount() const noexcept {
@@ -132,13 +288,19 @@ struct FAssetLoader : public AssetLoader {
     void createRenderable(const cgltf_node* node, Entity entity, const char* name);
     bool createPrimitive(const cgltf_primitive* inPrim, Primitive* outPrim, const UvMap& uvmap,
             const char* name);
+    void createPackedIndexBuffer(const cgltf_data* srcAsset);
+    void uploadGeneratedBuffers();
     void createLight(const cgltf_light* light, Entity entity);
     void createCamera(const cgltf_camera* camera, Entity entity);
     MaterialInstance* createMaterialInstance(const cgltf_material* inputMat, UvMap* uvmap,
-            bool vertexColor);
+            bool vertexColor, bool* instanceTransforms);
     void addTextureBinding(MaterialInstance* materialInstance, const char* parameterName,
             const cgltf_texture* srcTexture, bool srgb);
     bool primitiveHasVertexColor(const cgltf_primitive* inPrim) const;
+    bool addInstancedNode(const cgltf_node* node, Entity entity);
+    void addSharedMaterialInstance(const SharedMaterialKey& key, MaterialInstance* mi,
+            const UvMap& uvmap);
+    void releaseSharedMaterialInstance(MaterialInstance* mi);
 
     static LightManager::Type getLightType(const cgltf_light_type type);
 
@@ -149,11 +311,38 @@ struct FAssetLoader : public AssetLoader {
     MaterialProvider* mMaterials;
     Engine* mEngine;
 
+    // Material instances shared by the assets of this loader.
+    using SharedMaterialCache = tsl::robin_map<SharedMaterialKey, SharedMaterialEntry,
+            hash::MurmurHashFn<SharedMaterialKey>>;
+    SharedMaterialCache mSharedMaterials;
+    tsl::robin_map<const MaterialInstance*, SharedMaterialKey> mSharedMaterialKeys;
+
     // Transient state used only for the asset currently being loaded:
     FFilamentAsset* mResult;
     const char* mDefaultNodeName;
     bool mError = false;
     bool mDiagnosticsEnabled = false;
+    const bool mShareMaterialInstances;
+    const bool mGpuInstancing;
+    const bool mDepthVertices;
+    const bool mPackIndexBuffers;
+
+    // Transient state used only while the primitives of the current asset are created with
+    // packIndexBuffers: the shared index buffer, its size and the number of indices allocated.
+    IndexBuffer* mPackedIndices = nullptr;
+    uint32_t mPackedIndexCapacity = 0;
+    uint32_t mPackedIndexCount = 0;
+    bool mPackedIndicesWide = false;
+
+    // Buffer content requested by the primitives created so far, see uploadGeneratedBuffers().
+    std::vector<GeneratedBuffer> mGeneratedBuffers;
+
+    // Transient state used only for the instances of the asset currently being loaded that
+    // share their renderables: the size of their group, the index of the current instance in it,
+    // and the renderable created by the first instance for each node.
+    size_t mGpuInstanceCount = 0;
+    size_t mGpuInstanceIndex = 0;
+    tsl::robin_map<const cgltf_node*, size_t> mInstancedNodes;
 };
 
 FILAMENT_UPCAST(AssetLoader)
@@ -195,6 +384,29 @@ FFilamentAsset* FAssetLoader::createAssetFromBinary(const uint8_t* bytes, uint32
     return mResult;
 }
 
+FFilamentAsset* FAssetLoader::createAssetFromFile(const char* path) {
+    // Parse the mapping in place, cgltf points the buffer views of GLB files into it. The asset
+    // keeps the mapping until its source data is released.
+    SharedBuffer file = mapFile(path);
+    if (!file) {
+        slog.e << "Unable to open " << path << io::endl;
+        return nullptr;
+    }
+
+    cgltf_options options {};
+    cgltf_data* sourceAsset;
+    cgltf_result result = cgltf_parse(&options, file->buffer, file->size, &sourceAsset);
+    if (result != cgltf_result_success) {
+        slog.e << "Unable to parse " << path << io::endl;
+        return nullptr;
+    }
+    createAsset(sourceAsset, 0);
+    if (mResult) {
+        mResult->mSourceAsset->externalBuffers.push_back(std::move(file));
+    }
+    return mResult;
+}
+
 FFilamentAsset* FAssetLoader::createInstancedAsset(const uint8_t* bytes, uint32_t numBytes,
         FilamentInstance** instances, size_t numInstances) {
     ASSERT_PRECONDITION(numInstances > 0, "Instance count must be 1 or more.");
@@ -238,6 +450,7 @@ FilamentInstance* FAssetLoader::createInstance(FFilamentAsset* primary) {
         return nullptr;
     }
     FFilamentInstance* instance = createInstance(primary, scene);
+    uploadGeneratedBuffers();
 
     // Import the skin data. This is normally done by ResourceLoader but dynamically created
     // instances are a bit special.
@@ -246,6 +459,8 @@ FilamentInstance* FAssetLoader::createInstance(FFilamentAsset* primary) {
         primary->mAnimator->addInstance(instance);
     }
 
+    // The instance shares the geometry of the primary, which might still be loading.
+    primary->addGeometryEdges(instance->nodeMap);
     primary->mDependencyGraph.refinalize();
     return instance;
 }
@@ -275,6 +490,12 @@ void FAssetLoader::createAsset(const cgltf_data* srcAsset, size_t numInstances)
     mResult->mRoot = mEntityManager.create();
     mTransformManager.create(mResult->mRoot);
 
+    if (mPackIndexBuffers) {
+        createPackedIndexBuffer(srcAsset);
+    }
+
+    SYSTRACE_NAME_BEGIN("Create entities");
+
     if (numInstances == 0) {
         // For each scene root, recursively create all entities.
         for (cgltf_size i = 0, len = scene->nodes_count; i < len; ++i) {
@@ -286,12 +507,31 @@ void FAssetLoader::createAsset(const cgltf_data* srcAsset, size_t numInstances)
         // buffers and index buffers) and MatInstanceCache (materials and textures) help avoid
         // needless duplication of resources.
         for (size_t index = 0; index < numInstances; ++index) {
+            // With GPU instancing, each group of instances shares a renderable for each node.
+            if (mGpuInstancing) {
+                mGpuInstanceIndex = index % MAX_GPU_INSTANCES;
+                mGpuInstanceCount = std::min(MAX_GPU_INSTANCES,
+                        numInstances - (index - mGpuInstanceIndex));
+                if (mGpuInstanceIndex == 0) {
+                    mInstancedNodes.clear();
+                }
+            }
             if (createInstance(mResult, scene) == nullptr) {
                 mError = true;
                 break;
             }
         }
+        mGpuInstanceCount = 0;
+        mInstancedNodes.clear();
     }
+    SYSTRACE_NAME_END();
+
+    uploadGeneratedBuffers();
+
+    // Primitives created later on, by createInstance(), get their own index buffer.
+    mPackedIndices = nullptr;
+    mPackedIndexCapacity = 0;
+    mPackedIndexCount = 0;
 
     // Find every unique resource URI and store a pointer to any of the cgltf-owned cstrings
     // that match the URI. These strings get freed during releaseSourceData().
@@ -401,6 +641,20 @@ void FAssetLoader::createEntity(const cgltf_node* node, Entity parent, bool enab
 void FAssetLoader::createRenderable(const cgltf_node* node, Entity entity, const char* name) {
     const cgltf_mesh* mesh = node->mesh;
 
+    // Instances of a node can share a renderable, unless it has skinning or morphing, which the
+    // per-instance transforms can't be combined with.
+    bool instanced = mGpuInstanceCount > 1 && !node->skin;
+    for (cgltf_size index = 0; index < mesh->primitives_count; ++index) {
+        instanced = instanced && mesh->primitives[index].targets_count == 0;
+    }
+    if (instanced && mGpuInstanceIndex > 0) {
+        if (addInstancedNode(node, entity)) {
+            return;
+        }
+        // The first instance couldn't create an instanced renderable for this node.
+        instanced = false;
+    }
+
     // Compute the transform relative to the root.
     auto thisTransform = mTransformManager.getInstance(entity);
     mat4f worldTransform = mTransformManager.getWorldTransform(thisTransform);
@@ -440,12 +694,18 @@ void FAssetLoader::createRenderable(const cgltf_node* node, Entity entity, const
         // Create a material instance for this primitive or fetch one from the cache.
         UvMap uvmap {};
         bool hasVertexColor = primitiveHasVertexColor(inputPrim);
-        MaterialInstance* mi = createMaterialInstance(inputPrim->material, &uvmap, hasVertexColor);
+        bool instanceTransforms = instanced;
+        MaterialInstance* mi = createMaterialInstance(inputPrim->material, &uvmap, hasVertexColor,
+                &instanceTransforms);
         if (!mi) {
             mError = true;
             continue;
         }
 
+        // Providers that don't support per-instance transforms don't support them for any
+        // material, so they have been refused by the first primitive if at all.
+        instanced = instanced && instanceTransforms;
+
         mResult->mDependencyGraph.addEdge(entity, mi);
         builder.material(index, mi);
 
@@ -463,7 +723,11 @@ void FAssetLoader::createRenderable(const cgltf_node* node, Entity entity, const
         // calling geometry() on the builder. It appears that the glTF spec does not have
         // facilities for these parameters, which is not a huge loss since some of the buffer
         // view and accessor features already have this functionality.
-        builder.geometry(index, primType, outputPrim->vertices, outputPrim->indices);
+        builder.geometry(index, primType, outputPrim->vertices, outputPrim->indices,
+                outputPrim->indexOffset, outputPrim->indexCount);
+        if (outputPrim->depthVertices) {
+            builder.depthGeometry(index, outputPrim->depthVertices);
+        }
     }
 
     if (numMorphTargets > 0) {
@@ -480,6 +744,13 @@ void FAssetLoader::createRenderable(const cgltf_node* node, Entity entity, const
        builder.skinning(node->skin->joints_count);
     }
 
+    // The instances start at the same place, which updateInstanceTransforms() then updates.
+    std::vector<mat4f> instanceTransforms;
+    if (instanced) {
+        instanceTransforms.resize(mGpuInstanceCount);
+        builder.instances(mGpuInstanceCount, instanceTransforms.data());
+    }
+
     // Per the spec, glTF models must have valid mix / max annotations for position attributes.
     // However in practice these can be missing and we should be as robust as other glTF viewers.
     // If desired, clients can enable the "recomputeBoundingBoxes" feature in ResourceLoader.
@@ -496,6 +767,11 @@ void FAssetLoader::createRenderable(const cgltf_node* node, Entity entity, const
         .receiveShadows(true)
         .build(*mEngine, entity);
 
+    if (instanced) {
+        mInstancedNodes[node] = mResult->mInstancedRenderables.size();
+        mResult->mInstancedRenderables.push_back({ entity, { entity } });
+    }
+
     // According to the spec, the mesh may or may not specify default weights, regardless of whether
     // it actually has morph targets. If it has morphing enabled then the default weights are 0. If
     // node weights are provided, they override the ones specified on the mesh.
@@ -523,6 +799,18 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
     // In glTF, each primitive may or may not have an index buffer.
     IndexBuffer* indices = nullptr;
     const cgltf_accessor* accessor = inPrim->indices;
+    const uint32_t indexCount = accessor ? accessor->count :
+            inPrim->attributes_count > 0 ? inPrim->attributes[0].data->count : 0;
+
+    // The indices go into the packed index buffer if it was sized for this primitive.
+    const bool packed = mPackedIndices && mPackedIndexCount + indexCount <= mPackedIndexCapacity;
+    const uint32_t indexOffset = packed ? mPackedIndexCount : 0;
+    const uint32_t indexByteOffset = indexOffset * (mPackedIndicesWide ? 4 : 2);
+    if (packed) {
+        indices = mPackedIndices;
+        mPackedIndexCount += indexCount;
+    }
+
     if (accessor) {
         IndexBuffer::IndexType indexType;
         if (!getIndexType(accessor->component_type, &indexType)) {
@@ -530,35 +818,59 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
             return false;
         }
 
-        indices = IndexBuffer::Builder()
-            .indexCount(accessor->count)
-            .bufferType(indexType)
-            .build(*mEngine);
+        if (!packed) {
+            indices = IndexBuffer::Builder()
+                .indexCount(accessor->count)
+                .bufferType(indexType)
+                .build(*mEngine);
+        }
 
         BufferSlot slot = { accessor };
         slot.indexBuffer = indices;
+        slot.wideIndices = packed && mPackedIndicesWide;
+        slot.indexOffset = indexOffset;
         addBufferSlot(slot);
     } else if (inPrim->attributes_count > 0) {
         // If a primitive does not have an index buffer, generate a trivial one now.
-        const uint32_t vertexCount = inPrim->attributes[0].data->count;
-
-        indices = IndexBuffer::Builder()
-            .indexCount(vertexCount)
-            .bufferType(IndexBuffer::IndexType::UINT)
-            .build(*mEngine);
-
-        const size_t indexDataSize = vertexCount * sizeof(uint32_t);
-        uint32_t* indexData = (uint32_t*) malloc(indexDataSize);
-        for (size_t i = 0; i < vertexCount; ++i) {
-            indexData[i] = i;
+        if (!packed) {
+            indices = IndexBuffer::Builder()
+                .indexCount(indexCount)
+                .bufferType(IndexBuffer::IndexType::UINT)
+                .build(*mEngine);
         }
-        IndexBuffer::BufferDescriptor bd(indexData, indexDataSize, FREE_CALLBACK);
-        indices->setBuffer(*mEngine, std::move(bd));
+        GeneratedBuffer generated{};
+        generated.type = packed && !mPackedIndicesWide ?
+                GeneratedBuffer::INDICES_16 : GeneratedBuffer::INDICES_32;
+        generated.count = indexCount;
+        generated.byteOffset = indexByteOffset;
+        generated.indexBuffer = indices;
+        mGeneratedBuffers.push_back(generated);
+    }
+    if (!packed) {
+        mResult->mIndexBuffers.push_back(indices);
     }
-    mResult->mIndexBuffers.push_back(indices);
+    outPrim->indexOffset = indexOffset;
+    outPrim->indexCount = indexCount;
 
     VertexBuffer::Builder vbb;
 
+    // The depth passes only read the positions, skinned and morphed, unless the material is
+    // masked. They draw a tightly packed copy of these attributes.
+    const bool hasDepthVertices = mDepthVertices &&
+            !(inPrim->material && inPrim->material->alpha_mode == cgltf_alpha_mode_mask);
+    VertexBuffer::Builder depthVbb;
+    std::vector<BufferSlot> depthSlots;
+    auto addDepthAttribute = [&depthVbb, &depthSlots](VertexAttribute semantic,
+            VertexBuffer::AttributeType fatype, const cgltf_accessor* accessor,
+            cgltf_attribute_type atype, int morphId) {
+        const int slot = int(depthSlots.size());
+        depthVbb.attribute(semantic, slot, fatype);
+        depthVbb.normalized(semantic, accessor->normalized);
+        BufferSlot entry = { accessor, atype, slot, morphId };
+        entry.compact = true;
+        depthSlots.push_back(entry);
+    };
+
     bool hasUv0 = false, hasUv1 = false, hasVertexColor = false, hasNormals = false;
     uint32_t vertexCount = 0;
 
@@ -633,10 +945,8 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
         // The positions accessor is required to have min/max properties, use them to expand
         // the bounding box for this primitive.
         if (atype == cgltf_attribute_type_position) {
-            const float* minp = &accessor->min[0];
-            const float* maxp = &accessor->max[0];
-            outPrim->aabb.min = min(outPrim->aabb.min, float3(minp[0], minp[1], minp[2]));
-            outPrim->aabb.max = max(outPrim->aabb.max, float3(maxp[0], maxp[1], maxp[2]));
+            outPrim->aabb.min = min(outPrim->aabb.min, getPositionBound(accessor, accessor->min));
+            outPrim->aabb.max = max(outPrim->aabb.max, getPositionBound(accessor, accessor->max));
         }
 
         VertexBuffer::AttributeType fatype;
@@ -651,6 +961,11 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
         vbb.attribute(semantic, slot, fatype, 0, accessor->stride);
         vbb.normalized(semantic, accessor->normalized);
         addBufferSlot({accessor, atype, slot++});
+
+        if (hasDepthVertices && (atype == cgltf_attribute_type_position ||
+                atype == cgltf_attribute_type_joints || atype == cgltf_attribute_type_weights)) {
+            addDepthAttribute(semantic, fatype, accessor, atype, 0);
+        }
     }
 
     // If the model is lit but does not have normals, we'll need to generate flat normals.
@@ -697,10 +1012,8 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
                 return false;
             }
 
-            const float* minp = &accessor->min[0];
-            const float* maxp = &accessor->max[0];
-            outPrim->aabb.min = min(outPrim->aabb.min, float3(minp[0], minp[1], minp[2]));
-            outPrim->aabb.max = max(outPrim->aabb.max, float3(maxp[0], maxp[1], maxp[2]));
+            outPrim->aabb.min = min(outPrim->aabb.min, getPositionBound(accessor, accessor->min));
+            outPrim->aabb.max = max(outPrim->aabb.max, getPositionBound(accessor, accessor->max));
 
             VertexBuffer::AttributeType fatype;
             if (!getElementType(accessor->type, accessor->component_type, &fatype)) {
@@ -712,6 +1025,10 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
             vbb.attribute(attr, slot, fatype, 0, accessor->stride);
             vbb.normalized(attr, accessor->normalized);
             addBufferSlot({accessor, atype, slot++, morphId});
+
+            if (hasDepthVertices) {
+                addDepthAttribute(attr, fatype, accessor, atype, morphId);
+            }
         }
     }
 
@@ -771,17 +1088,94 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
         mResult->mBufferSlots[i].vertexBuffer = vertices;
     }
 
+    if (!depthSlots.empty()) {
+        VertexBuffer* depthVertices = depthVbb
+                .vertexCount(vertexCount)
+                .bufferCount(depthSlots.size())
+                .build(*mEngine);
+        outPrim->depthVertices = depthVertices;
+        mResult->mVertexBuffers.push_back(depthVertices);
+        for (BufferSlot& entry : depthSlots) {
+            entry.vertexBuffer = depthVertices;
+            addBufferSlot(entry);
+        }
+    }
+
     if (needsDummyData) {
-        uint32_t size = sizeof(ubyte4) * vertexCount;
-        uint32_t* dummyData = (uint32_t*) malloc(size);
-        memset(dummyData, 0xff, size);
-        VertexBuffer::BufferDescriptor bd(dummyData, size, FREE_CALLBACK);
-        vertices->setBufferAt(*mEngine, slot, std::move(bd));
+        GeneratedBuffer generated{};
+        generated.type = GeneratedBuffer::DUMMY_VERTICES;
+        generated.bufferIndex = uint8_t(slot);
+        generated.count = vertexCount;
+        generated.vertexBuffer = vertices;
+        mGeneratedBuffers.push_back(generated);
     }
 
     return true;
 }
 
+// Fills the buffers requested by the primitives in jobs, then uploads them. Engine calls are made
+// from the loader's thread only.
+void FAssetLoader::uploadGeneratedBuffers() {
+    SYSTRACE_CALL();
+    if (mGeneratedBuffers.empty()) {
+        return;
+    }
+
+    JobSystem& js = mEngine->getJobSystem();
+    auto fill = [](GeneratedBuffer* buffers, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            fillGeneratedBuffer(buffers[i]);
+        }
+    };
+    SYSTRACE_NAME_BEGIN("Fill generated buffers");
+    js.runAndWait(jobs::parallel_for(js, nullptr, mGeneratedBuffers.data(),
+            uint32_t(mGeneratedBuffers.size()), fill, jobs::CountSplitter<16>()));
+    SYSTRACE_NAME_END();
+
+    for (GeneratedBuffer& buffer : mGeneratedBuffers) {
+        if (buffer.indexBuffer) {
+            IndexBuffer::BufferDescriptor bd(buffer.data, buffer.size, FREE_CALLBACK);
+            buffer.indexBuffer->setBuffer(*mEngine, std::move(bd), buffer.byteOffset);
+        } else {
+            VertexBuffer::BufferDescriptor bd(buffer.data, buffer.size, FREE_CALLBACK);
+            buffer.vertexBuffer->setBufferAt(*mEngine, buffer.bufferIndex, std::move(bd));
+        }
+    }
+    mGeneratedBuffers.clear();
+}
+
+// Sizes the index buffer shared by the primitives of the asset. It holds 16-bit indices unless
+// some primitive has 32-bit indices, or more vertices than 16-bit indices can address.
+void FAssetLoader::createPackedIndexBuffer(const cgltf_data* srcAsset) {
+    size_t indexCount = 0;
+    bool wide = false;
+    for (cgltf_size i = 0; i < srcAsset->meshes_count; ++i) {
+        const cgltf_mesh& mesh = srcAsset->meshes[i];
+        for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+            const cgltf_primitive& prim = mesh.primitives[j];
+            if (const cgltf_accessor* accessor = prim.indices) {
+                indexCount += accessor->count;
+                wide = wide || accessor->component_type == cgltf_component_type_r_32u;
+            } else if (prim.attributes_count > 0) {
+                const cgltf_size vertexCount = prim.attributes[0].data->count;
+                indexCount += vertexCount;
+                wide = wide || vertexCount > 0x10000;
+            }
+        }
+    }
+    if (indexCount == 0 || indexCount > std::numeric_limits<uint32_t>::max() / 4) {
+        return;
+    }
+    mPackedIndices = IndexBuffer::Builder()
+            .indexCount(uint32_t(indexCount))
+            .bufferType(wide ? IndexBuffer::IndexType::UINT : IndexBuffer::IndexType::USHORT)
+            .build(*mEngine);
+    mPackedIndexCapacity = uint32_t(indexCount);
+    mPackedIndexCount = 0;
+    mPackedIndicesWide = wide;
+    mResult->mIndexBuffers.push_back(mPackedIndices);
+}
+
 void FAssetLoader::createLight(const cgltf_light* light, Entity entity) {
     LightManager::Type type = getLightType(light->type);
     LightManager::Builder builder(type);
@@ -857,11 +1251,12 @@ void FAssetLoader::createCamera(const cgltf_camera* camera, Entity entity) {
 }
 
 MaterialInstance* FAssetLoader::createMaterialInstance(const cgltf_material* inputMat,
-        UvMap* uvmap, bool vertexColor) {
-    intptr_t key = ((intptr_t) inputMat) ^ (vertexColor ? 1 : 0);
+        UvMap* uvmap, bool vertexColor, bool* instanceTransforms) {
+    intptr_t key = ((intptr_t) inputMat) ^ (vertexColor ? 1 : 0) ^ (*instanceTransforms ? 2 : 0);
     auto iter = mResult->mMatInstanceCache.find(key);
     if (iter != mResult->mMatInstanceCache.end()) {
         *uvmap = iter->second.uvmap;
+        *instanceTransforms = iter->second.instanceTransforms;
         return iter->second.instance;
     }
 
@@ -936,6 +1331,7 @@ MaterialInstance* FAssetLoader::createMaterialInstance(const cgltf_material* inp
         .hasSheenRoughnessTexture = !!shConfig.sheen_roughness_texture.texture,
         .sheenRoughnessUV = (uint8_t) shConfig.sheen_roughness_texture.texcoord,
         .hasSheen = !!inputMat->has_sheen,
+        .hasInstanceTransforms = *instanceTransforms,
     };
 
     if (inputMat->has_pbr_specular_glossiness) {
@@ -967,6 +1363,22 @@ MaterialInstance* FAssetLoader::createMaterialInstance(const cgltf_material* inp
             break;
     }
 
+    // Textures belong to each asset, so only the instances of untextured materials are shared.
+    const bool shared = mShareMaterialInstances && !hasTextures(matkey) &&
+            !matkey.hasInstanceTransforms;
+    SharedMaterialKey sharedKey;
+    if (shared) {
+        sharedKey = getSharedMaterialKey(matkey, inputMat);
+        auto pos = mSharedMaterials.find(sharedKey);
+        if (pos != mSharedMaterials.end()) {
+            MaterialInstance* mi = pos->second.instance;
+            *uvmap = pos->second.uvmap;
+            addSharedMaterialInstance(sharedKey, mi, *uvmap);
+            mResult->mMatInstanceCache[key] = {mi, *uvmap, false};
+            return mi;
+        }
+    }
+
     // This not only creates a material instance, it modifies the material key according to our
     // rendering constraints. For example, Filament only supports 2 sets of texture coordinates.
     MaterialInstance* mi = mMaterials->createMaterialInstance(&matkey, uvmap, inputMat->name);
@@ -974,6 +1386,7 @@ MaterialInstance* FAssetLoader::createMaterialInstance(const cgltf_material* inp
         slog.e << "No material with the specified requirements exists." << io::endl;
         return nullptr;
     }
+    *instanceTransforms = matkey.hasInstanceTransforms;
 
     mResult->mMaterialInstances.push_back(mi);
 
@@ -1121,10 +1534,66 @@ MaterialInstance* FAssetLoader::createMaterialInstance(const cgltf_material* inp
         }
     }
 
-    mResult->mMatInstanceCache[key] = {mi, *uvmap};
+    if (shared) {
+        addSharedMaterialInstance(sharedKey, mi, *uvmap);
+    }
+
+    mResult->mMatInstanceCache[key] = {mi, *uvmap, *instanceTransforms};
     return mi;
 }
 
+bool FAssetLoader::addInstancedNode(const cgltf_node* node, Entity entity) {
+    auto pos = mInstancedNodes.find(node);
+    if (pos == mInstancedNodes.end()) {
+        return false;
+    }
+    mResult->mInstancedRenderables[pos->second].nodes.push_back(entity);
+
+    // The node has no renderable, but its instance still contributes to the asset's bounds.
+    Aabb aabb;
+    for (const Primitive& prim : mResult->mMeshCache[node->mesh]) {
+        aabb.min = min(prim.aabb.min, aabb.min);
+        aabb.max = max(prim.aabb.max, aabb.max);
+    }
+    const mat4f worldTransform = mTransformManager.getWorldTransform(
+            mTransformManager.getInstance(entity));
+    const Aabb transformed = aabb.transform(worldTransform);
+    mResult->mBoundingBox.min = min(mResult->mBoundingBox.min, transformed.min);
+    mResult->mBoundingBox.max = max(mResult->mBoundingBox.max, transformed.max);
+    return true;
+}
+
+void FAssetLoader::addSharedMaterialInstance(const SharedMaterialKey& key, MaterialInstance* mi,
+        const UvMap& uvmap) {
+    // Several glTF materials of an asset can map to the same instance, which the asset only
+    // references once.
+    auto& assetInstances = mResult->mSharedMaterialInstances;
+    if (std::find(assetInstances.begin(), assetInstances.end(), mi) != assetInstances.end()) {
+        return;
+    }
+    auto pos = mSharedMaterials.find(key);
+    if (pos == mSharedMaterials.end()) {
+        // The instance was just created, and already added to the asset's list.
+        mSharedMaterials[key] = { mi, uvmap, 1 };
+        mSharedMaterialKeys[mi] = key;
+    } else {
+        pos.value().refs++;
+        mResult->mMaterialInstances.push_back(mi);
+    }
+    assetInstances.push_back(mi);
+}
+
+void FAssetLoader::releaseSharedMaterialInstance(MaterialInstance* mi) {
+    auto keyPos = mSharedMaterialKeys.find(mi);
+    assert(keyPos != mSharedMaterialKeys.end());
+    auto pos = mSharedMaterials.find(keyPos->second);
+    if (--pos.value().refs == 0) {
+        mEngine->destroy(mi);
+        mSharedMaterials.erase(pos);
+        mSharedMaterialKeys.erase(keyPos);
+    }
+}
+
 void FAssetLoader::addTextureBinding(MaterialInstance* materialInstance, const char* parameterName,
         const cgltf_texture* srcTexture, bool srgb) {
     if (!srcTexture->image) {
@@ -1199,6 +1668,10 @@ FilamentAsset* AssetLoader::createAssetFromBinary(uint8_t const* bytes, uint32_t
     return upcast(this)->createAssetFromBinary(bytes, nbytes);
 }
 
+FilamentAsset* AssetLoader::createAssetFromFile(const char* path) {
+    return upcast(this)->createAssetFromFile(path);
+}
+
 FilamentAsset* AssetLoader::createInstancedAsset(const uint8_t* bytes, uint32_t numBytes,
         FilamentInstance** instances, size_t numInstances) {
     return upcast(this)->createInstancedAsset(bytes, numBytes, instances, numInstances);
@@ -33,30 +33,65 @@ size_t DependencyGraph::popRenderables(Entity* result, size_t count) noexcept {
     return numWritten;
 }
 
+bool DependencyGraph::isReady(Entity entity) const noexcept {
+    auto iter = mEntityToMaterial.find(entity);
+    return iter == mEntityToMaterial.end() || isReady(iter->second);
+}
+
+bool DependencyGraph::isReady(const EntityNode& status) noexcept {
+    return status.numReadyMaterials == status.materials.size() && !status.numPendingPrimitives;
+}
+
 void DependencyGraph::addEdge(Entity entity, MaterialInstance* mi) {
 
     // Permit adding an Entity-Material edge to a finalized graph as long as the material is already
     // known. Since we already encountered this material instance, we already know what textures it
     // is associated with.
-    assert(!mFinalized || mMaterialToEntity.find(mi) != mMaterialToEntity.end());
+    assert(!mFinalized || mMaterials.find(mi) != mMaterials.end());
 
-    mMaterialToEntity[mi].insert(entity);
-    mEntityToMaterial[entity].materials.insert(mi);
+    MaterialNode& material = mMaterials[mi];
+    if (!material.entities.insert(entity).second) {
+        return;
+    }
+    EntityNode& status = mEntityToMaterial[entity];
+    status.materials.insert(mi);
+    if (material.ready) {
+        status.numReadyMaterials++;
+    }
+    if (mFinalized) {
+        mPendingEntities.push_back(entity);
+    }
 }
 
 void DependencyGraph::addEdge(MaterialInstance* mi, const char* parameter) {
     assert(!mFinalized);
-    mMaterialToTexture[mi].params[parameter] = nullptr;
+    MaterialNode& material = mMaterials[mi];
+    if (material.params.emplace(parameter, nullptr).second) {
+        material.numPendingParams++;
+    }
+}
+
+void DependencyGraph::addEdge(Entity entity, VertexBuffer* vertices) {
+    if (mFinalized) {
+        // Geometry that was not declared before finalization has already been uploaded.
+        auto iter = mGeometryToEntity.find(vertices);
+        if (iter == mGeometryToEntity.end() || iter->second.ready) {
+            return;
+        }
+    }
+    GeometryNode& status = mGeometryToEntity[vertices];
+    if (status.entities.insert(entity).second) {
+        mEntityToMaterial[entity].numPendingPrimitives++;
+    }
 }
 
 // During finalization, the structure of the glTF is known but we have not yet created texture
-// objects. Find all non-textured entities and immediately add mark them as ready.
+// objects. Find all non-textured materials and immediately mark them (and their entities) as ready.
 void DependencyGraph::finalize() {
     assert(!mFinalized);
-    for (auto pair : mMaterialToEntity) {
-        auto mi = pair.first;
-        if (mMaterialToTexture.find(mi) == mMaterialToTexture.end()) {
-            markAsReady(mi);
+    for (auto& pair : mMaterials) {
+        if (pair.second.numPendingParams == 0) {
+            markAsReady(pair.first);
         }
     }
     mFinalized = true;
@@ -64,71 +99,106 @@ void DependencyGraph::finalize() {
 
 void DependencyGraph::refinalize() {
     assert(mFinalized);
-    for (auto pair : mMaterialToEntity) {
-        auto material = pair.first;
-        if (mMaterialToTexture.find(material) == mMaterialToTexture.end()) {
-            markAsReady(material);
-        } else {
-            checkReadiness(material);
+    for (Entity entity : mPendingEntities) {
+        EntityNode& status = mEntityToMaterial.at(entity);
+        if (isReady(status)) {
+            enqueue(entity, status);
         }
     }
+    mPendingEntities.clear();
 }
 
-void DependencyGraph::addEdge(Texture* texture, MaterialInstance* material, const char* parameter) {
+void DependencyGraph::addEdge(Texture* texture, MaterialInstance* mi, const char* parameter) {
     assert(mFinalized);
-    mTextureToMaterial[texture].insert(material);
-    mMaterialToTexture.at(material).params.at(parameter) = getStatus(texture);
-}
-
-void DependencyGraph::checkReadiness(Material* material) {
-    auto& status = mMaterialToTexture.at(material);
+    MaterialNode& material = mMaterials.at(mi);
+    TextureNode* status = getStatus(texture);
+    TextureNode*& param = material.params.at(parameter);
+    if (param == status) {
+        return;
+    }
 
-    // Check this material's texture parameters, there are 5 in the worst case.
-    bool materialIsReady = true;
-    for (auto pair : status.params) {
-        if (!pair.second->ready) {
-            materialIsReady = false;
-            break;
+    // A parameter whose texture is replaced is pending again, unless the material has already
+    // become ready: readiness is never revoked.
+    if (param) {
+        auto iter = param->materials.find(mi);
+        if (--iter.value() == 0) {
+            param->materials.erase(iter);
+        }
+        if (param->ready) {
+            material.numPendingParams++;
         }
     }
-
-    // If all of its textures are ready, then the material has become ready.
-    if (materialIsReady) {
-        markAsReady(material);
+    param = status;
+    status->materials[mi]++;
+    if (status->ready && --material.numPendingParams == 0) {
+        markAsReady(mi);
     }
 }
 
 void DependencyGraph::markAsReady(Texture* texture) {
     assert(texture && mFinalized);
-    mTextureNodes.at(texture)->ready = true;
-
-    // Iterate over the materials associated with this texture to check if any have become ready.
-    // This is O(n2) but the inner loop is always small.
-    auto& materials = mTextureToMaterial.at(texture);
-    for (auto material : materials) {
-        checkReadiness(material);
+    TextureNode* status = mTextureNodes.at(texture).get();
+    if (status->ready) {
+        return;
+    }
+    status->ready = true;
+
+    // Only the materials that use this texture are visited, each parameter bound to it is no
+    // longer pending.
+    for (auto const& pair : status->materials) {
+        MaterialNode& material = mMaterials.at(pair.first);
+        assert(material.numPendingParams >= pair.second);
+        material.numPendingParams -= pair.second;
+        if (material.numPendingParams == 0) {
+            markAsReady(pair.first);
+        }
     }
 }
 
-void DependencyGraph::markAsReady(MaterialInstance* material) {
-    auto& entities = mMaterialToEntity.at(material);
-    for (auto entity : entities) {
+void DependencyGraph::markAsReady(VertexBuffer* vertices) {
+    auto iter = mGeometryToEntity.find(vertices);
+    if (iter == mGeometryToEntity.end() || iter->second.ready) {
+        return;
+    }
+    iter.value().ready = true;
+    for (auto entity : iter->second.entities) {
         auto& status = mEntityToMaterial.at(entity);
-        assert(status.numReadyMaterials <= status.materials.size());
-        if (status.numReadyMaterials == status.materials.size()) {
-            continue;
+        assert(status.numPendingPrimitives > 0);
+        if (--status.numPendingPrimitives == 0 && isReady(status)) {
+            enqueue(entity, status);
         }
-        if (++status.numReadyMaterials == status.materials.size()) {
-            mReadyRenderables.push(entity);
+    }
+}
+
+void DependencyGraph::markAsReady(MaterialInstance* mi) {
+    MaterialNode& material = mMaterials.at(mi);
+    if (material.ready) {
+        return;
+    }
+    material.ready = true;
+    for (auto entity : material.entities) {
+        auto& status = mEntityToMaterial.at(entity);
+        assert(status.numReadyMaterials < status.materials.size());
+        if (++status.numReadyMaterials == status.materials.size() &&
+                !status.numPendingPrimitives) {
+            enqueue(entity, status);
         }
     }
 }
 
+void DependencyGraph::enqueue(Entity entity, EntityNode& status) {
+    if (!status.queued) {
+        status.queued = true;
+        mReadyRenderables.push(entity);
+    }
+}
+
 DependencyGraph::TextureNode* DependencyGraph::getStatus(Texture* texture) {
     auto iter = mTextureNodes.find(texture);
     if (iter == mTextureNodes.end()) {
         TextureNode* status = (mTextureNodes[texture] = std::make_unique<TextureNode>()).get();
-        *status = {texture, false};
+        status->texture = texture;
+        status->ready = false;
         return status;
     }
     return iter->second.get();
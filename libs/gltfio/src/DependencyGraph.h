@@ -22,19 +22,23 @@
 #include <tsl/robin_map.h>
 #include <tsl/robin_set.h>
 
+#include <memory>
 #include <queue>
 #include <string>
+#include <vector>
 
 namespace filament {
     class MaterialInstance;
     class Texture;
+    class VertexBuffer;
 }
 
 namespace gltfio {
 
 /**
  * Internal graph that enables FilamentAsset to discover "ready-to-render" entities by tracking
- * the loading status of Texture objects that each entity depends on.
+ * the loading status of Texture objects that each entity depends on, and of its geometry when it
+ * is loaded asynchronously.
  *
  * Renderables connect to a set of material instances, which in turn connect to a set of parameter
  * names, which in turn connect to a set of texture objects. These relationships are not easily
@@ -56,63 +60,96 @@ namespace gltfio {
  *
  * Note that the left-most entity in the above graph has no textures, so it becomes ready as soon as
  * finalize is called.
+ *
+ * Entities can also connect to the vertex buffers of their primitives, in which case they only
+ * become ready once all of these have been marked as ready too.
+ *
+ * Readiness is propagated with counters: each material counts its parameters whose texture is not
+ * ready yet, and each entity counts its ready materials and its pending primitives. Marking a
+ * texture or a vertex buffer as ready only visits the nodes that depend on it.
  */
 class DependencyGraph {
 public:
     using Material = filament::MaterialInstance;
     using Entity = utils::Entity;
 
-    // Pops up to "count" ready-to-render entities off the queue.
+    // Pops up to "count" ready-to-render entities off the queue, in the order they became ready.
     // If "result" is non-null, returns the number of written items.
     // If "result" is null, returns the number of available entities.
     size_t popRenderables(Entity* result, size_t count) noexcept;
 
+    // Checks if the given entity is ready to render, i.e. if all of its textures and geometry
+    // have been loaded. Entities that are not renderables have nothing to wait for.
+    bool isReady(Entity entity) const noexcept;
+
     // These are called during the initial asset loader phase.
     void addEdge(Entity entity, Material* material);
     void addEdge(Material* material, const char* parameter);
 
+    // This is called before finalization for primitives whose geometry is loaded asynchronously.
+    // After finalization, it only connects entities to vertex buffers that are not ready yet.
+    void addEdge(Entity entity, filament::VertexBuffer* vertices);
+
     // This is called at the end of the initial asset loading phase.
     // Makes a guarantee that no new material nodes or parameter nodes will be added to the graph.
     void finalize();
 
     // This can be called after finalization to allow for dynamic addition of entities.
-    // It is slower than finalize() because it checks the readiness of existing materials.
+    // It only checks the entities that were connected since the last call.
     void refinalize();
 
     // These are called after textures have created and decoded.
     void addEdge(filament::Texture* texture, Material* material, const char* parameter);
     void markAsReady(filament::Texture* texture);
 
+    // This is called after the geometry of a primitive has been uploaded.
+    void markAsReady(filament::VertexBuffer* vertices);
+
 private:
     struct TextureNode {
         filament::Texture* texture;
         bool ready;
+        // materials bound to this texture, with the number of their parameters it is bound to
+        tsl::robin_map<Material*, uint32_t> materials;
     };
 
     struct MaterialNode {
         tsl::robin_map<std::string, TextureNode*> params;
+        tsl::robin_set<Entity> entities;
+        size_t numPendingParams = 0;
+        bool ready = false;
     };
 
     struct EntityNode {
         tsl::robin_set<Material*> materials;
         size_t numReadyMaterials = 0;
+        size_t numPendingPrimitives = 0;
+        bool queued = false;
+    };
+
+    struct GeometryNode {
+        tsl::robin_set<Entity> entities;
+        bool ready = false;
     };
 
-    void checkReadiness(Material* material);
     void markAsReady(Material* material);
+    void enqueue(Entity entity, EntityNode& status);
+    static bool isReady(const EntityNode& status) noexcept;
     TextureNode* getStatus(filament::Texture* texture);
 
     // The following maps contain the directed edges in the graph.
     tsl::robin_map<Entity, EntityNode> mEntityToMaterial;
-    tsl::robin_map<Material*, tsl::robin_set<Entity>> mMaterialToEntity;
-    tsl::robin_map<Material*, MaterialNode> mMaterialToTexture;
-    tsl::robin_map<filament::Texture*, tsl::robin_set<Material*>> mTextureToMaterial;
+    tsl::robin_map<Material*, MaterialNode> mMaterials;
+    tsl::robin_map<filament::VertexBuffer*, GeometryNode> mGeometryToEntity;
 
     // Each texture (and its readiness flag) can be referenced from multiple nodes, so we own
     // a collection of wrapper objects in the following map. This uses std::unique_ptr to allow
     // nodes to refer to a texture wrapper using a stable weak pointer.
     tsl::robin_map<filament::Texture*, std::unique_ptr<TextureNode>> mTextureNodes;
 
+    // Entities connected to materials after finalization, checked by refinalize().
+    std::vector<Entity> mPendingEntities;
+
     std::queue<Entity> mReadyRenderables;
     bool mFinalized = false;
 };
@@ -23,6 +23,7 @@
 #include <utils/Log.h>
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 using std::unique_ptr;
@@ -33,15 +34,21 @@ using namespace utils;
 namespace gltfio {
 
 DracoMesh* DracoCache::findOrCreateMesh(const cgltf_buffer_view* key) {
-    auto iter = mCache.find(key);
-    if (iter != mCache.end()) {
-        return iter->second.get();
+    {
+        std::lock_guard<utils::Mutex> guard(mMutex);
+        auto iter = mCache.find(key);
+        if (iter != mCache.end()) {
+            return iter->second.get();
+        }
     }
+
+    // Decode without holding the lock, so that other meshes can be decoded concurrently. If
+    // another job decoded the same mesh in the meantime, its result is kept instead.
     assert(key->buffer && key->buffer->data);
     const uint8_t* compressedData = key->offset + (uint8_t*) key->buffer->data;
-    DracoMesh* mesh = DracoMesh::decode(compressedData, key->size);
-    mCache.emplace(key, mesh);
-    return mesh;
+    std::unique_ptr<DracoMesh> mesh(DracoMesh::decode(compressedData, key->size));
+    std::lock_guard<utils::Mutex> guard(mMutex);
+    return mCache.emplace(key, std::move(mesh)).first->second.get();
 }
 
 DracoMesh::DracoMesh(struct DracoMeshDetails* details) : mDetails(details) {}
@@ -118,6 +125,8 @@ DracoMesh* DracoMesh::decode(const uint8_t* data, size_t dataSize) {
 }
 
 void DracoMesh::getFaceIndices(cgltf_accessor* target) const {
+    std::lock_guard<utils::Mutex> guard(mMutex);
+
     // Return early if we've already decompressed this data.
     if (target->buffer_view) {
         return;
@@ -154,6 +163,8 @@ void DracoMesh::getFaceIndices(cgltf_accessor* target) const {
 }
 
 bool DracoMesh::getVertexAttributes(uint32_t attributeId, cgltf_accessor* target) const {
+    std::lock_guard<utils::Mutex> guard(mMutex);
+
     // Return early if we've already decompressed this data.
     if (target->buffer_view) {
         return true;
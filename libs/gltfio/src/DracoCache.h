@@ -19,6 +19,8 @@
 
 #include <cgltf.h>
 
+#include <utils/Mutex.h>
+
 #include <tsl/robin_map.h>
 
 #include <memory>
@@ -35,11 +37,14 @@ class DracoMesh;
 //
 // The cache key is the buffer view that holds the compressed data. This allows the loader to
 // avoid duplicated work when a single Draco mesh is referenced from multiple primitives.
+//
+// The cache and its meshes can be used from several jobs at once.
 class DracoCache {
 public:
     DracoMesh* findOrCreateMesh(const cgltf_buffer_view* key);
 private:
     tsl::robin_map<const cgltf_buffer_view*, std::unique_ptr<DracoMesh>> mCache;
+    utils::Mutex mMutex;
 };
 
 // Decodes a Draco mesh upon construction and retains the results.
@@ -60,6 +65,8 @@ public:
 private:
     DracoMesh(struct DracoMeshDetails* details);
     std::unique_ptr<struct DracoMeshDetails> mDetails;
+    // protects the decoded buffers, which are shared by the primitives that use this mesh
+    mutable utils::Mutex mMutex;
 };
 
 } // namespace gltfio
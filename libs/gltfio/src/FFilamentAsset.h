@@ -40,6 +40,7 @@
 #include "DependencyGraph.h"
 #include "DracoCache.h"
 #include "FFilamentInstance.h"
+#include "MappedFile.h"
 
 #include <tsl/robin_map.h>
 #include <tsl/htrie_map.h>
@@ -64,6 +65,9 @@ struct BufferSlot {
     int morphTarget; // 0 if no morphing, otherwise 1-based index
     filament::VertexBuffer* vertexBuffer;
     filament::IndexBuffer* indexBuffer;
+    bool compact; // the vertex buffer expects tightly packed data
+    bool wideIndices; // the index buffer expects 32-bit indices, narrower ones are widened
+    uint32_t indexOffset; // where the indices go in a packed index buffer
 };
 
 // Encapsulates a connection between Texture and MaterialInstance.
@@ -84,7 +88,10 @@ struct TextureSlot {
 // primitives, where a "primitive" is a reference to a Filament VertexBuffer and IndexBuffer.
 struct Primitive {
     filament::VertexBuffer* vertices = nullptr;
+    filament::VertexBuffer* depthVertices = nullptr; // optional, see AssetConfiguration
     filament::IndexBuffer* indices = nullptr;
+    uint32_t indexOffset = 0; // first index, when the index buffer is packed
+    uint32_t indexCount = 0;
     filament::Aabb aabb; // object-space bounding box
 };
 using MeshCache = tsl::robin_map<const cgltf_mesh*, std::vector<Primitive>>;
@@ -99,9 +106,18 @@ using MeshCache = tsl::robin_map<const cgltf_mesh*, std::vector<Primitive>>;
 struct MaterialEntry {
     filament::MaterialInstance* instance;
     UvMap uvmap;
+    bool instanceTransforms;
 };
 using MatInstanceCache = tsl::robin_map<intptr_t, MaterialEntry>;
 
+// With AssetConfiguration::gpuInstancing, the instances of a node that has a mesh share a single
+// renderable, which is held by the node of the first instance. Its per-instance transforms are
+// computed from the nodes of all the instances.
+struct InstancedRenderable {
+    utils::Entity renderable;
+    std::vector<utils::Entity> nodes;
+};
+
 struct FFilamentAsset : public FilamentAsset {
     FFilamentAsset(filament::Engine* engine, utils::NameComponentManager* names,
             utils::EntityManager* entityManager, const cgltf_data* srcAsset) :
@@ -143,6 +159,10 @@ struct FFilamentAsset : public FilamentAsset {
         return mDependencyGraph.popRenderables(entities, count);
     }
 
+    bool isRenderableReady(utils::Entity entity) const noexcept {
+        return mDependencyGraph.isReady(entity);
+    }
+
     size_t getMaterialInstanceCount() const noexcept {
         return mMaterialInstances.size();
     }
@@ -187,6 +207,8 @@ struct FFilamentAsset : public FilamentAsset {
 
     void releaseSourceData() noexcept;
 
+    void updateInstanceTransforms() noexcept;
+
     const void* getSourceAsset() noexcept {
         return mSourceAsset.get() ? mSourceAsset->hierarchy : nullptr;
     }
@@ -212,6 +234,9 @@ struct FFilamentAsset : public FilamentAsset {
         return mInstances.size() > 0;
     }
 
+    // Makes the renderables of the given nodes wait for the geometry that is still being loaded.
+    void addGeometryEdges(const NodeMap& nodeMap);
+
     filament::Engine* mEngine;
     utils::NameComponentManager* mNameManager;
     utils::EntityManager* mEntityManager;
@@ -219,12 +244,14 @@ struct FFilamentAsset : public FilamentAsset {
     std::vector<utils::Entity> mLightEntities;
     std::vector<utils::Entity> mCameraEntities;
     std::vector<filament::MaterialInstance*> mMaterialInstances;
+    std::vector<filament::MaterialInstance*> mSharedMaterialInstances; // owned by the AssetLoader
     std::vector<filament::VertexBuffer*> mVertexBuffers;
     std::vector<filament::IndexBuffer*> mIndexBuffers;
     std::vector<filament::Texture*> mTextures;
     filament::Aabb mBoundingBox;
     utils::Entity mRoot;
     std::vector<FFilamentInstance*> mInstances;
+    std::vector<InstancedRenderable> mInstancedRenderables;
     SkinVector mSkins; // unused for instanced assets
     Animator* mAnimator = nullptr;
     Wireframe* mWireframe = nullptr;
@@ -239,10 +266,14 @@ struct FFilamentAsset : public FilamentAsset {
     // Encapsulates reference-counted source data, which includes the cgltf hierachy
     // and potentially also includes buffer data that can be uploaded to the GPU.
     struct SourceAsset {
-        ~SourceAsset() { cgltf_free(hierarchy); }
+        ~SourceAsset();
         cgltf_data* hierarchy;
         DracoCache dracoCache;
         std::vector<uint8_t> glbData;
+
+        // Memory that cgltf points into but doesn't own: mapped files, and the data given to
+        // ResourceLoader::addResourceData() when buffers aren't copied (see mapBuffers).
+        std::vector<SharedBuffer> externalBuffers;
     };
 
     // We used shared ownership for the raw cgltf data in order to permit ResourceLoader to
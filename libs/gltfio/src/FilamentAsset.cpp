@@ -22,13 +22,30 @@
 #include <utils/Log.h>
 #include <utils/NameComponentManager.h>
 
+#include <algorithm>
+
 #include "Wireframe.h"
 
 using namespace filament;
+using namespace filament::math;
 using namespace utils;
 
 namespace gltfio {
 
+FFilamentAsset::SourceAsset::~SourceAsset() {
+    // cgltf frees the buffers it loaded, but not the ones we handed to it
+    for (cgltf_size i = 0, n = hierarchy ? hierarchy->buffers_count : 0; i < n; ++i) {
+        cgltf_buffer& buffer = hierarchy->buffers[i];
+        for (SharedBuffer const& external : externalBuffers) {
+            if (buffer.data == external->buffer) {
+                buffer.data = nullptr;
+                break;
+            }
+        }
+    }
+    cgltf_free(hierarchy);
+}
+
 FFilamentAsset::~FFilamentAsset() {
     releaseSourceData();
 
@@ -56,7 +73,10 @@ FFilamentAsset::~FFilamentAsset() {
         mEntityManager->destroy(entity);
     }
     for (auto mi : mMaterialInstances) {
-        mEngine->destroy(mi);
+        auto& shared = mSharedMaterialInstances;
+        if (std::find(shared.begin(), shared.end(), mi) == shared.end()) {
+            mEngine->destroy(mi);
+        }
     }
     for (auto vb : mVertexBuffers) {
         mEngine->destroy(vb);
@@ -108,6 +128,41 @@ void FFilamentAsset::releaseSourceData() noexcept {
     }
 }
 
+void FFilamentAsset::updateInstanceTransforms() noexcept {
+    TransformManager& tm = mEngine->getTransformManager();
+    RenderableManager& rm = mEngine->getRenderableManager();
+    std::vector<mat4f> transforms;
+    for (const InstancedRenderable& instanced : mInstancedRenderables) {
+        // The instance transforms are relative to the transform of the renderable.
+        const mat4f inverseWorld = inverse(tm.getWorldTransform(
+                tm.getInstance(instanced.renderable)));
+        transforms.resize(instanced.nodes.size());
+        for (size_t i = 0, n = instanced.nodes.size(); i < n; ++i) {
+            transforms[i] = inverseWorld * tm.getWorldTransform(
+                    tm.getInstance(instanced.nodes[i]));
+        }
+        rm.setInstanceTransforms(rm.getInstance(instanced.renderable), transforms.data(),
+                transforms.size());
+    }
+}
+
+void FFilamentAsset::addGeometryEdges(const NodeMap& nodeMap) {
+    const RenderableManager& rm = mEngine->getRenderableManager();
+    for (auto pair : nodeMap) {
+        const cgltf_mesh* mesh = pair.first->mesh;
+        auto iter = mesh ? mMeshCache.find(mesh) : mMeshCache.end();
+        // The nodes of instances that share a renderable have none of their own.
+        if (iter == mMeshCache.end() || !rm.hasComponent(pair.second)) {
+            continue;
+        }
+        for (const Primitive& prim : iter->second) {
+            if (prim.vertices) {
+                mDependencyGraph.addEdge(pair.second, prim.vertices);
+            }
+        }
+    }
+}
+
 const char* FFilamentAsset::getName(utils::Entity entity) const noexcept {
     if (mNameManager == nullptr) {
         return nullptr;
@@ -213,6 +268,10 @@ size_t FilamentAsset::popRenderables(Entity* result, size_t count) noexcept {
     return upcast(this)->popRenderables(result, count);
 }
 
+bool FilamentAsset::isRenderableReady(Entity entity) const noexcept {
+    return upcast(this)->isRenderableReady(entity);
+}
+
 size_t FilamentAsset::getMaterialInstanceCount() const noexcept {
     return upcast(this)->getMaterialInstanceCount();
 }
@@ -271,6 +330,10 @@ void FilamentAsset::releaseSourceData() noexcept {
     return upcast(this)->releaseSourceData();
 }
 
+void FilamentAsset::updateInstanceTransforms() noexcept {
+    upcast(this)->updateInstanceTransforms();
+}
+
 const void* FilamentAsset::getSourceAsset() noexcept {
     return upcast(this)->getSourceAsset();
 }
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MappedFile.h"
+
+#include <utils/Log.h>
+
+#if defined(WIN32) || defined(__EMSCRIPTEN__)
+#include <stdio.h>
+#include <stdlib.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace filament::backend;
+using namespace utils;
+
+namespace gltfio {
+
+#if defined(WIN32) || defined(__EMSCRIPTEN__)
+
+SharedBuffer mapFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return {};
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void* data = size > 0 ? malloc(size_t(size)) : nullptr;
+    const bool ok = data && fread(data, 1, size_t(size), file) == size_t(size);
+    fclose(file);
+    if (!ok) {
+        free(data);
+        slog.e << "Unable to read " << path << io::endl;
+        return {};
+    }
+    return std::make_shared<BufferDescriptor>(data, size_t(size),
+            [](void* buffer, size_t, void*) { free(buffer); });
+}
+
+#else
+
+SharedBuffer mapFile(const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return {};
+    }
+    struct stat st = {};
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid after the file is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        slog.e << "Unable to map " << path << io::endl;
+        return {};
+    }
+    return std::make_shared<BufferDescriptor>(data, size_t(st.st_size),
+            [](void* buffer, size_t size, void*) { munmap(buffer, size); });
+}
+
+#endif
+
+} // namespace gltfio
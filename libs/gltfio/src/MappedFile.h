@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_MAPPED_FILE_H
+#define GLTFIO_MAPPED_FILE_H
+
+#include <backend/BufferDescriptor.h>
+
+#include <memory>
+
+namespace gltfio {
+
+using SharedBuffer = std::shared_ptr<filament::backend::BufferDescriptor>;
+
+// Maps the content of the file at 'path' in memory, or returns null if it can't be opened.
+//
+// The mapping is private and writable: pages are only copied when gltfio modifies the data in
+// place (e.g. to normalize skinning weights), the file itself is never written. The mapping is
+// released by the callback of the returned descriptor, i.e. when its last reference goes away.
+// On platforms without mmap, the file is read into memory instead.
+SharedBuffer mapFile(const char* path);
+
+} // namespace gltfio
+
+#endif // GLTFIO_MAPPED_FILE_H
@@ -317,6 +317,25 @@ static Material* createMaterial(Engine* engine, const MaterialKey& config, const
         builder.parameter(MaterialBuilder::UniformType::BOOL, "enableDiagnostics");
     }
 
+    // The transforms of instanced renderables are relative to the renderable's transform, and not
+    // available to the skinning and morphing variants. The normals assume instance transforms
+    // without non-uniform scaling.
+    if (config.hasInstanceTransforms) {
+        builder.materialVertex(R"SHADER(
+            void materialVertex(inout MaterialVertexInputs material) {
+            #if !defined(HAS_SKINNING_OR_MORPHING)
+                highp mat4 worldFromModel = getWorldFromModelMatrix();
+                highp mat4 instance = getInstanceTransform();
+                material.worldPosition = worldFromModel * (instance * vec4(getPosition().xyz, 1.0));
+            #if defined(HAS_ATTRIBUTE_TANGENTS)
+                material.worldNormal = normalize(getWorldFromModelNormalMatrix() * mat3(instance) *
+                        (transpose(mat3(worldFromModel)) * material.worldNormal));
+            #endif
+            #endif
+            }
+        )SHADER");
+    }
+
     // BASE COLOR
     builder.parameter(MaterialBuilder::UniformType::FLOAT4, "baseColorFactor");
     if (config.hasBaseColorTexture) {
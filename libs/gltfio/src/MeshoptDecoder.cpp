@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MeshoptDecoder.h"
+
+#include <meshoptimizer.h>
+
+#include <utils/Log.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace gltfio {
+
+// The filters below are specified by EXT_meshopt_compression. They are applied in place, after
+// the data has been decoded.
+
+// Rounds to the nearest signed integer.
+static int roundToInt(float value) {
+    return int(value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+// Unit vectors encoded as octahedral coordinates, with 8 or 16 bits per component. The third
+// component holds the encoding of 1.0, the fourth one is left as is.
+template<typename T>
+static void decodeFilterOct(T* data, size_t count) {
+    const float one = float((1 << (sizeof(T) * 8 - 1)) - 1);
+    for (size_t i = 0; i < count; ++i, data += 4) {
+        float x = float(data[0]);
+        float y = float(data[1]);
+        float z = float(data[2]) - fabsf(x) - fabsf(y);
+
+        // Unfold the lower hemisphere.
+        float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        const float scale = one / sqrtf(x * x + y * y + z * z);
+        data[0] = T(roundToInt(x * scale));
+        data[1] = T(roundToInt(y * scale));
+        data[2] = T(roundToInt(z * scale));
+    }
+}
+
+// Unit quaternions encoded as three 16-bit components in [-1/sqrt(2), 1/sqrt(2)]. The fourth
+// component holds the index of the dropped (largest) component in its two lowest bits, and the
+// encoding of 1.0 in the other ones.
+static void decodeFilterQuat(int16_t* data, size_t count) {
+    const float range = 1.0f / sqrtf(2.0f);
+    for (size_t i = 0; i < count; ++i, data += 4) {
+        const float scale = range / float(data[3] | 3);
+        const float x = float(data[0]) * scale;
+        const float y = float(data[1]) * scale;
+        const float z = float(data[2]) * scale;
+        const float ww = 1.0f - x * x - y * y - z * z;
+        const float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+        // The components are stored in their original order.
+        const int index = data[3] & 3;
+        data[(index + 1) & 3] = int16_t(roundToInt(x * 32767.0f));
+        data[(index + 2) & 3] = int16_t(roundToInt(y * 32767.0f));
+        data[(index + 3) & 3] = int16_t(roundToInt(z * 32767.0f));
+        data[(index + 0) & 3] = int16_t(roundToInt(w * 32767.0f));
+    }
+}
+
+// Floats encoded as a signed 24-bit mantissa and a signed 8-bit exponent.
+static void decodeFilterExp(uint32_t* data, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t mantissa = int32_t(data[i] << 8) >> 8;
+        const int32_t exponent = int32_t(data[i]) >> 24;
+        const float value = ldexpf(float(mantissa), exponent);
+        memcpy(&data[i], &value, sizeof(value));
+    }
+}
+
+bool decodeMeshoptCompression(cgltf_buffer_view* view) {
+    const cgltf_meshopt_compression& mc = view->meshopt_compression;
+    if (!mc.buffer->data) {
+        slog.e << "Missing EXT_meshopt_compression buffer." << io::endl;
+        return false;
+    }
+
+    // The codecs only assert on these, so they're checked even when cgltf_validate() isn't run.
+    const bool isIndexData = mc.mode != cgltf_meshopt_compression_mode_attributes;
+    const bool validStride = isIndexData ? (mc.stride == 2 || mc.stride == 4) :
+            (mc.stride % 4 == 0 && mc.stride <= 256);
+    const bool validFilter = mc.filter == cgltf_meshopt_compression_filter_none ||
+            (!isIndexData && (mc.filter == cgltf_meshopt_compression_filter_exponential ||
+            (mc.filter == cgltf_meshopt_compression_filter_octahedral &&
+                    (mc.stride == 4 || mc.stride == 8)) ||
+            (mc.filter == cgltf_meshopt_compression_filter_quaternion && mc.stride == 8)));
+    if (!validStride || !validFilter || mc.stride * mc.count < view->size ||
+            (mc.mode == cgltf_meshopt_compression_mode_triangles && mc.count % 3 != 0)) {
+        slog.e << "Invalid EXT_meshopt_compression buffer view." << io::endl;
+        return false;
+    }
+
+    const uint8_t* source = (const uint8_t*) mc.buffer->data + mc.offset;
+    void* result = malloc(mc.count * mc.stride);
+    int error = -1;
+    switch (mc.mode) {
+        case cgltf_meshopt_compression_mode_attributes:
+            error = meshopt_decodeVertexBuffer(result, mc.count, mc.stride, source, mc.size);
+            break;
+        case cgltf_meshopt_compression_mode_triangles:
+            error = meshopt_decodeIndexBuffer(result, mc.count, mc.stride, source, mc.size);
+            break;
+        default:
+            break;
+    }
+    if (error) {
+        slog.e << "Unable to decode EXT_meshopt_compression buffer view." << io::endl;
+        free(result);
+        return false;
+    }
+
+    switch (mc.filter) {
+        case cgltf_meshopt_compression_filter_octahedral:
+            if (mc.stride == 4) {
+                decodeFilterOct((int8_t*) result, mc.count);
+            } else {
+                decodeFilterOct((int16_t*) result, mc.count);
+            }
+            break;
+        case cgltf_meshopt_compression_filter_quaternion:
+            decodeFilterQuat((int16_t*) result, mc.count);
+            break;
+        case cgltf_meshopt_compression_filter_exponential:
+            decodeFilterExp((uint32_t*) result, mc.count * mc.stride / sizeof(uint32_t));
+            break;
+        default:
+            break;
+    }
+
+    view->data = result;
+    return true;
+}
+
+} // namespace gltfio
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_MESHOPT_DECODER_H
+#define GLTFIO_MESHOPT_DECODER_H
+
+#include <cgltf.h>
+
+namespace gltfio {
+
+// Decodes a buffer view compressed with EXT_meshopt_compression, and applies its filter.
+//
+// The decoded data is stored in the "data" field of the view, which cgltf_buffer_view_data()
+// looks at and cgltf_free() releases, so the view can then be used like any other.
+//
+// Returns false if the data can't be decoded. Note that the vendored meshoptimizer only has the
+// first version of the codecs, and no decoder for the "INDICES" mode.
+bool decodeMeshoptCompression(cgltf_buffer_view* view);
+
+} // namespace gltfio
+
+#endif // GLTFIO_MESHOPT_DECODER_H
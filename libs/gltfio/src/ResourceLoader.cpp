@@ -15,9 +15,11 @@
  */
 
 #include <gltfio/ResourceLoader.h>
-#include <gltfio/Image.h>
+#include <gltfio/TextureDecoder.h>
 
 #include "FFilamentAsset.h"
+#include "MappedFile.h"
+#include "MeshoptDecoder.h"
 #include "upcast.h"
 
 #include <filament/Engine.h>
@@ -28,6 +30,9 @@
 
 #include <geometry/SurfaceOrientation.h>
 
+#include <image/KtxBundle.h>
+#include <image/KtxUtility.h>
+
 #include <utils/JobSystem.h>
 #include <utils/Log.h>
 #include <utils/Systrace.h>
@@ -40,7 +45,15 @@
 
 #include <tsl/robin_map.h>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
 
 #if defined(__EMSCRIPTEN__) || defined(ANDROID)
 #define USE_FILESYSTEM 0
@@ -58,18 +71,59 @@ static const auto FREE_CALLBACK = [](void* mem, size_t, void*) { free(mem); };
 namespace {
     struct TextureCacheEntry {
         Texture* texture;
-        std::atomic<stbi_uc*> texels;
+        std::atomic<Texture::PixelBufferDescriptor*> pixels;
+        // KTX containers hold GPU-ready mip chains (typically block-compressed), they are
+        // uploaded as they are rather than being decoded into 8-bit texels.
+        std::atomic<image::KtxBundle*> ktx;
+        const gltfio::TextureDecoder* decoder;
+        Texture::InternalFormat format;
+        uint8_t levels;
+        uint8_t channels;
+        uint8_t lod;
         uint32_t bufferSize;
         int width;
         int height;
-        int numComponents;
         bool srgb;
+        bool isKtx;
         bool completed;
     };
 
+    // KTX 1.1 containers start with this identifier, followed by the KtxInfo fields and the
+    // number of array elements, faces, mip levels and bytes of key-value data.
+    constexpr uint8_t KTX_IDENTIFIER[12] = {
+            0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    constexpr size_t KTX_HEADER_SIZE =
+            sizeof(KTX_IDENTIFIER) + sizeof(image::KtxInfo) + 4 * sizeof(uint32_t);
+
     using BufferTextureCache = tsl::robin_map<const void*, std::unique_ptr<TextureCacheEntry>>;
     using UriTextureCache = tsl::robin_map<std::string, std::unique_ptr<TextureCacheEntry>>;
-    using UriDataCache = tsl::robin_map<std::string, gltfio::ResourceLoader::BufferDescriptor>;
+    using UriDataCache = tsl::robin_map<std::string, gltfio::SharedBuffer>;
+
+    // Describes the generation of the tangent frames of a single vertex buffer slot.
+    struct TangentsJob {
+        // Consumed by the job:
+        const cgltf_primitive* prim;
+        VertexBuffer* vb;
+        uint8_t slot;
+        int morphTargetIndex;
+        // Produced by the job:
+        cgltf_size vertexCount;
+        short4* results;
+    };
+
+    constexpr int kMorphTargetUnused = -1;
+
+    // A primitive whose geometry is loaded asynchronously. It is decoded by a job, then uploaded
+    // from the main thread, after which the renderables that use it can become ready.
+    struct PendingPrimitive {
+        const cgltf_primitive* prim;
+        VertexBuffer* vertices;
+        IndexBuffer* indices;
+        std::vector<gltfio::BufferSlot> slots;
+        std::vector<TangentsJob> tangents;
+        std::atomic<bool> decoded;
+        bool uploaded;
+    };
 }
 
 namespace gltfio {
@@ -80,15 +134,24 @@ struct ResourceLoader::Impl {
         mEngine = config.engine;
         mNormalizeSkinningWeights = config.normalizeSkinningWeights;
         mRecomputeBoundingBoxes = config.recomputeBoundingBoxes;
+        mMapBuffers = config.mapBuffers;
+        mMaxTextureSize = config.maxTextureSize;
     }
 
     Engine* mEngine;
     bool mNormalizeSkinningWeights;
     bool mRecomputeBoundingBoxes;
+    bool mMapBuffers;
+    uint32_t mMaxTextureSize;
     std::string mGltfPath;
 
+    // Decoders added with addTextureDecoder() are tried first, stb is the fallback.
+    std::vector<const TextureDecoder*> mTextureDecoders;
+    std::unique_ptr<TextureDecoder> mStbDecoder{ TextureDecoder::createStbDecoder() };
+
     // User-provided resource data with URI string keys, populated with addResourceData().
     // This is used on platforms without traditional file systems, such as Android and WebGL.
+    // The data is shared with the assets that use it in place (see mMapBuffers).
     UriDataCache mUriDataCache;
 
     // The two texture caches are populated while textures are being decoded, and they are no longer
@@ -97,15 +160,39 @@ struct ResourceLoader::Impl {
     // two caches: one for URI-based textures and one for buffer-based textures.
     BufferTextureCache mBufferTextureCache;
     UriTextureCache mUriTextureCache;
-    int mNumDecoderTasks;
-    int mNumDecoderTasksFinished;
+    int mNumDecoderTasks = 0;
+    int mNumDecoderTasksFinished = 0;
     JobSystem::Job* mDecoderRootJob = nullptr;
     FFilamentAsset* mCurrentAsset = nullptr;
 
+    // With asyncBeginLoad(), Draco decompression and tangent generation are done by jobs, one
+    // primitive at a time. Each primitive is uploaded by asyncUpdateLoad() as soon as its job has
+    // finished, so renderables don't have to wait for the geometry of the whole asset.
+    // The source data is retained until all of them have been uploaded.
+    std::vector<std::unique_ptr<PendingPrimitive>> mPendingPrimitives;
+    FFilamentAsset::SourceHandle mGeometrySource;
+    int mNumGeometryTasks = 0;
+    int mNumGeometryTasksFinished = 0;
+    JobSystem::Job* mGeometryRootJob = nullptr;
+
+    void uploadBuffer(const FFilamentAsset::SourceHandle& source, const BufferSlot& slot);
+    void uploadTangents(const TangentsJob& job);
+    void collectTangentsJobs(FFilamentAsset* asset, std::vector<TangentsJob>& jobs);
     void computeTangents(FFilamentAsset* asset);
+    void createGeometryJobs(FFilamentAsset* asset);
+    void decodeSinglePrimitive();
+    void uploadPendingPrimitives();
+    void finishGeometryLoading();
+    void cancelGeometryLoading();
+    bool decodeTextures(FFilamentAsset* asset, bool async);
     bool createTextures(bool async);
     void cancelTextureDecoding();
     void addTextureCacheEntry(const TextureSlot& tb);
+    bool readTextureInfo(TextureCacheEntry* entry, const uint8_t* data, size_t size,
+            const char* name);
+    bool readKtxHeader(TextureCacheEntry* entry, const uint8_t* header, const char* name);
+    bool readImageInfo(TextureCacheEntry* entry, const uint8_t* data, size_t size,
+            const char* name);
     void bindTextureToMaterial(const TextureSlot& tb);
     void decodeSingleTexture();
     void uploadPendingTextures();
@@ -114,7 +201,8 @@ struct ResourceLoader::Impl {
 };
 
 uint32_t computeBindingSize(const cgltf_accessor* accessor);
-uint32_t computeBindingOffset(const cgltf_accessor* accessor);
+uint32_t computeElementSize(const cgltf_accessor* accessor);
+const uint8_t* computeBindingData(const cgltf_accessor* accessor);
 
 // This little struct holds a shared_ptr that wraps cgltf_data (and, potentially, glb data) while
 // uploading vertex buffer data to the GPU.
@@ -122,8 +210,8 @@ struct UploadEvent {
     FFilamentAsset::SourceHandle handle;
 };
 
-UploadEvent* uploadUserdata(FFilamentAsset* asset) {
-    return new UploadEvent({ asset->mSourceAsset });
+UploadEvent* uploadUserdata(const FFilamentAsset::SourceHandle& source) {
+    return new UploadEvent({ source });
 }
 
 static void uploadCallback(void* buffer, size_t size, void* user) {
@@ -168,12 +256,11 @@ void importSkins(const cgltf_data* gltf, const NodeMap& nodeMap, SkinVector& dst
         dstSkin.inverseBindMatrices.resize(srcSkin.joints_count);
         if (srcMatrices) {
             auto dstMatrices = (uint8_t*) dstSkin.inverseBindMatrices.data();
-            uint8_t* bytes = (uint8_t*) srcMatrices->buffer_view->buffer->data;
-            if (!bytes) {
+            const uint8_t* srcBuffer = computeBindingData(srcMatrices);
+            if (!srcBuffer) {
                 slog.w << "Empty animation buffer, have resources been loaded yet?" << io::endl;
                 continue;
             }
-            auto srcBuffer = (void*) (bytes + srcMatrices->offset + srcMatrices->buffer_view->offset);
             memcpy(dstMatrices, srcBuffer, srcSkin.joints_count * sizeof(mat4f));
         }
     }
@@ -185,8 +272,12 @@ static void convertBytesToShorts(uint16_t* dst, const uint8_t* src, size_t count
     }
 }
 
-static void decodeDracoMeshes(FFilamentAsset* asset) {
-    DracoCache* dracoCache = &asset->mSourceAsset->dracoCache;
+// Decompresses the Draco mesh of the given primitive, if it has one. This can be called from
+// several jobs at once, with different primitives.
+static void decodeDracoMesh(FFilamentAsset::SourceAsset* source, const cgltf_primitive* prim) {
+    if (!prim->has_draco_mesh_compression) {
+        return;
+    }
 
     // For a given primitive and attribute, find the corresponding accessor.
     auto findAccessor = [](const cgltf_primitive* prim, cgltf_attribute_type type, cgltf_int idx) {
@@ -199,49 +290,242 @@ static void decodeDracoMeshes(FFilamentAsset* asset) {
         return (cgltf_accessor*) nullptr;
     };
 
-    // Go through every primitive and check if it has a Draco mesh.
-    for (auto pair : asset->mPrimitives) {
-        const cgltf_primitive* prim = pair.first;
-        VertexBuffer* vb = pair.second;
-        if (!prim->has_draco_mesh_compression) {
-            continue;
-        }
+    const cgltf_draco_mesh_compression& draco = prim->draco_mesh_compression;
+
+    // Check if we have already decoded this mesh.
+    DracoMesh* mesh = source->dracoCache.findOrCreateMesh(draco.buffer_view);
+    if (!mesh) {
+        slog.w << "Cannot decompress mesh, Draco decoding error." << io::endl;
+        return;
+    }
+
+    // Copy over the decompressed data, converting the data type if necessary.
+    if (prim->indices) {
+        mesh->getFaceIndices(prim->indices);
+    }
 
-        const cgltf_draco_mesh_compression& draco = prim->draco_mesh_compression;
+    // Go through each attribute in the decompressed mesh.
+    for (cgltf_size i = 0; i < draco.attributes_count; i++) {
 
-        // Check if we have already decoded this mesh.
-        DracoMesh* mesh = dracoCache->findOrCreateMesh(draco.buffer_view);
-        if (!mesh) {
-            slog.w << "Cannot decompress mesh, Draco decoding error." << io::endl;
+        // In cgltf, each Draco attribute's data pointer is an attribute id, not an accessor.
+        const uint32_t id = draco.attributes[i].data - source->hierarchy->accessors;
+
+        // Find the destination accessor; this contains the desired component type, etc.
+        const cgltf_attribute_type type = draco.attributes[i].type;
+        const cgltf_int index = draco.attributes[i].index;
+        cgltf_accessor* accessor = findAccessor(prim, type, index);
+        if (!accessor) {
+            slog.w << "Cannot find matching accessor for Draco id " << id << io::endl;
             continue;
         }
 
         // Copy over the decompressed data, converting the data type if necessary.
-        if (prim->indices) {
-            mesh->getFaceIndices(prim->indices);
+        mesh->getVertexAttributes(id, accessor);
+    }
+}
+
+// Decompresses the Draco meshes of all primitives, each distinct mesh is decoded by its own job.
+// Decompresses the buffer views that use EXT_meshopt_compression, one job per view. The rest of
+// the loader then reads them like uncompressed views.
+static bool decodeMeshoptBuffers(FFilamentAsset* asset, JobSystem& js) {
+    SYSTRACE_CALL();
+
+    cgltf_data* gltf = (cgltf_data*) asset->mSourceAsset->hierarchy;
+    std::atomic<bool> success = { true };
+    JobSystem::Job* parent = nullptr;
+    for (cgltf_size i = 0, n = gltf->buffer_views_count; i < n; ++i) {
+        cgltf_buffer_view* view = &gltf->buffer_views[i];
+
+        // Views that have already been decoded by a previous load are left alone.
+        if (!view->has_meshopt_compression || view->data) {
+            continue;
         }
+        if (!parent) {
+            parent = js.createJob();
+        }
+        std::atomic<bool>* result = &success;
+        js.run(jobs::createJob(js, parent, [view, result] {
+            if (!decodeMeshoptCompression(view)) {
+                result->store(false, std::memory_order_relaxed);
+            }
+        }));
+    }
+    if (parent) {
+        js.runAndWait(parent);
+    }
+    return success.load(std::memory_order_relaxed);
+}
+
+static void decodeDracoMeshes(FFilamentAsset* asset, JobSystem& js) {
+    SYSTRACE_CALL();
 
-        // Go through each attribute in the decompressed mesh.
-        for (cgltf_size i = 0; i < draco.attributes_count; i++) {
+    // Group the primitives by compressed mesh, so that primitives which share a mesh don't
+    // decode it concurrently.
+    using PrimitiveList = std::vector<const cgltf_primitive*>;
+    tsl::robin_map<const cgltf_buffer_view*, PrimitiveList> meshes;
+    for (auto pair : asset->mPrimitives) {
+        const cgltf_primitive* prim = pair.first;
+        if (prim->has_draco_mesh_compression) {
+            meshes[prim->draco_mesh_compression.buffer_view].push_back(prim);
+        }
+    }
+    if (meshes.empty()) {
+        return;
+    }
 
-            // In cgltf, each Draco attribute's data pointer is an attribute id, not an accessor.
-            const uint32_t id = draco.attributes[i].data - asset->mSourceAsset->hierarchy->accessors;
+    FFilamentAsset::SourceAsset* source = asset->mSourceAsset.get();
+    JobSystem::Job* parent = js.createJob();
+    for (const auto& pair : meshes) {
+        const PrimitiveList* prims = &pair.second;
+        js.run(jobs::createJob(js, parent, [source, prims] {
+            for (const cgltf_primitive* prim : *prims) {
+                decodeDracoMesh(source, prim);
+            }
+        }));
+    }
+    js.runAndWait(parent);
+}
 
-            // Find the destination accessor; this contains the desired component type, etc.
-            const cgltf_attribute_type type = draco.attributes[i].type;
-            const cgltf_int index = draco.attributes[i].index;
-            cgltf_accessor* accessor = findAccessor(prim, type, index);
-            if (!accessor) {
-                slog.w << "Cannot find matching accessor for Draco id " << id << io::endl;
-                continue;
+// Computes the tangent frames of a vertex buffer slot into a new buffer, this is run in a job.
+static void computeTangentFrames(TangentsJob* params) {
+    const cgltf_primitive& prim = *params->prim;
+    const uint8_t slot = params->slot;
+    const int morphTargetIndex = params->morphTargetIndex;
+
+    // Declare vectors of normals and tangents, which we'll extract & convert from the source.
+    std::vector<float3> fp32Normals;
+    std::vector<float4> fp32Tangents;
+    std::vector<float3> fp32Positions;
+    std::vector<float2> fp32TexCoords;
+    std::vector<uint3> ui32Triangles;
+
+    cgltf_size vertexCount = 0;
+
+    // Build a mapping from cgltf_attribute_type to cgltf_accessor*.
+    const int NUM_ATTRIBUTES = 8;
+    const cgltf_accessor* accessors[NUM_ATTRIBUTES] = {};
+
+    // Collect accessors for normals, tangents, etc.
+    if (morphTargetIndex == kMorphTargetUnused) {
+        for (cgltf_size aindex = 0; aindex < prim.attributes_count; aindex++) {
+            const cgltf_attribute& attr = prim.attributes[aindex];
+            if (attr.index == 0) {
+                accessors[attr.type] = attr.data;
+                vertexCount = attr.data->count;
             }
+        }
+    } else {
+        const cgltf_morph_target& morphTarget = prim.targets[morphTargetIndex];
+        for (cgltf_size aindex = 0; aindex < morphTarget.attributes_count; aindex++) {
+            const cgltf_attribute& attr = morphTarget.attributes[aindex];
+            if (attr.index == 0) {
+                accessors[attr.type] = attr.data;
+                vertexCount = attr.data->count;
+            }
+        }
+    }
+    params->vertexCount = vertexCount;
+
+    // At a minimum we need normals to generate tangents.
+    auto normalsInfo = accessors[cgltf_attribute_type_normal];
+    if (vertexCount == 0) {
+        return;
+    }
+
+    geometry::SurfaceOrientation::Builder sob;
+    sob.vertexCount(vertexCount);
+
+    // Convert normals into packed floats.
+    if (normalsInfo) {
+        assert(normalsInfo->count == vertexCount);
+        assert(normalsInfo->type == cgltf_type_vec3);
+        fp32Normals.resize(vertexCount);
+        cgltf_accessor_unpack_floats(normalsInfo, &fp32Normals[0].x, vertexCount * 3);
+        sob.normals(fp32Normals.data());
+    }
 
-            // Copy over the decompressed data, converting the data type if necessary.
-            mesh->getVertexAttributes(id, accessor);
+    // Convert tangents into packed floats.
+    auto tangentsInfo = accessors[cgltf_attribute_type_tangent];
+    if (tangentsInfo) {
+        if (tangentsInfo->count != vertexCount || tangentsInfo->type != cgltf_type_vec4) {
+            slog.e << "Bad tangent count or type." << io::endl;
+            return;
+        }
+        fp32Tangents.resize(vertexCount);
+        cgltf_accessor_unpack_floats(tangentsInfo, &fp32Tangents[0].x, vertexCount * 4);
+        sob.tangents(fp32Tangents.data());
+    }
+
+    auto positionsInfo = accessors[cgltf_attribute_type_position];
+    if (positionsInfo) {
+        if (positionsInfo->count != vertexCount || positionsInfo->type != cgltf_type_vec3) {
+            slog.e << "Bad position count or type." << io::endl;
+            return;
+        }
+        fp32Positions.resize(vertexCount);
+        cgltf_accessor_unpack_floats(positionsInfo, &fp32Positions[0].x, vertexCount * 3);
+        sob.positions(fp32Positions.data());
+    }
+
+    if (prim.indices) {
+        size_t triangleCount = prim.indices->count / 3;
+        ui32Triangles.resize(triangleCount);
+        cgltf_size j = 0;
+        for (auto& triangle : ui32Triangles) {
+            triangle.x = cgltf_accessor_read_index(prim.indices, j++);
+            triangle.y = cgltf_accessor_read_index(prim.indices, j++);
+            triangle.z = cgltf_accessor_read_index(prim.indices, j++);
+        }
+    } else {
+        size_t triangleCount = vertexCount / 3;
+        ui32Triangles.resize(triangleCount);
+        cgltf_size j = 0;
+        for (auto& triangle : ui32Triangles) {
+            triangle.x = j++;
+            triangle.y = j++;
+            triangle.z = j++;
+        }
+    }
+
+    sob.triangleCount(ui32Triangles.size());
+    sob.triangles(ui32Triangles.data());
+
+    auto texcoordsInfo = accessors[cgltf_attribute_type_texcoord];
+    if (texcoordsInfo) {
+        if (texcoordsInfo->count != vertexCount || texcoordsInfo->type != cgltf_type_vec2) {
+            slog.e << "Bad texture coordinate count or type." << io::endl;
+            return;
         }
+        fp32TexCoords.resize(vertexCount);
+        cgltf_accessor_unpack_floats(texcoordsInfo, &fp32TexCoords[0].x, vertexCount * 2);
+        sob.uvs(fp32TexCoords.data());
     }
+
+    // Compute surface orientation quaternions.
+    params->results = (short4*) malloc(sizeof(short4) * vertexCount);
+    geometry::SurfaceOrientation* helper = sob.build();
+    helper->getQuats(params->results, vertexCount);
+    delete helper;
 }
 
+#if USE_FILESYSTEM
+static cgltf_result mapBufferFile(const cgltf_memory_options*, const cgltf_file_options* options,
+        const char* path, cgltf_size* size, void** data) {
+    SharedBuffer file = mapFile(path);
+    if (!file) {
+        return cgltf_result_file_not_found;
+    }
+    if (*size > file->size) {
+        return cgltf_result_data_too_short;
+    }
+    *size = file->size;
+    *data = file->buffer;
+    auto source = (FFilamentAsset::SourceAsset*) options->user_data;
+    source->externalBuffers.push_back(std::move(file));
+    return cgltf_result_success;
+}
+#endif
+
 ResourceLoader::ResourceLoader(const ResourceConfiguration& config) : pImpl(new Impl(config)) { }
 
 ResourceLoader::~ResourceLoader() {
@@ -256,13 +540,17 @@ void ResourceLoader::addResourceData(const char* uri, BufferDescriptor&& buffer)
         SYSTRACE_CONTEXT();
         SYSTRACE_ASYNC_BEGIN("addResourceData", 1);
     }
-    pImpl->mUriDataCache.emplace(uri, std::move(buffer));
+    pImpl->mUriDataCache.emplace(uri, std::make_shared<BufferDescriptor>(std::move(buffer)));
 }
 
 bool ResourceLoader::hasResourceData(const char* uri) const {
     return pImpl->mUriDataCache.find(uri) != pImpl->mUriDataCache.end();
 }
 
+void ResourceLoader::addTextureDecoder(const TextureDecoder* decoder) {
+    pImpl->mTextureDecoders.push_back(decoder);
+}
+
 bool ResourceLoader::loadResources(FilamentAsset* asset) {
     FFilamentAsset* fasset = upcast(asset);
     return loadResources(fasset, false);
@@ -275,6 +563,10 @@ bool ResourceLoader::loadResources(FFilamentAsset* asset, bool async) {
     if (asset->mResourcesLoaded) {
         return false;
     }
+
+    // If the geometry of a previous asynchronous load is still pending, finish it first.
+    pImpl->finishGeometryLoading();
+
     const cgltf_data* gltf = asset->mSourceAsset->hierarchy;
     cgltf_options options {};
 
@@ -320,12 +612,20 @@ bool ResourceLoader::loadResources(FFilamentAsset* asset, bool async) {
             if (iter == pImpl->mUriDataCache.end()) {
                 slog.e << "Unable to load external resource: " << uri << io::endl;
                 missingResources = true;
+                continue;
+            }
+            SharedBuffer const& buffer = iter->second;
+            if (pImpl->mMapBuffers) {
+                // Use the data in place, the asset shares it with the cache.
+                gltf->buffers[i].data = buffer->buffer;
+                asset->mSourceAsset->externalBuffers.push_back(buffer);
+                continue;
             }
             // Make a copy to allow cgltf_free() to work as expected and prevent a double-free.
             // TODO: Future versions of CGLTF will make this easier, see the following ticket.
             // https://github.com/jkuhlmann/cgltf/issues/94
-            gltf->buffers[i].data = malloc(iter->second.size);
-            memcpy(gltf->buffers[i].data, iter->second.buffer, iter->second.size);
+            gltf->buffers[i].data = malloc(buffer->size);
+            memcpy(gltf->buffers[i].data, buffer->buffer, buffer->size);
         } else {
             slog.e << "Unable to load " << uri << io::endl;
             return false;
@@ -339,7 +639,12 @@ bool ResourceLoader::loadResources(FFilamentAsset* asset, bool async) {
 
     #else
 
-    // Read data from the file system and base64 URIs.
+    // Read data from the file system and base64 URIs. Files are memory-mapped rather than read
+    // when buffers aren't copied, the mappings are kept alive by the source asset.
+    if (pImpl->mMapBuffers) {
+        options.file.read = mapBufferFile;
+        options.file.user_data = asset->mSourceAsset.get();
+    }
     cgltf_result result = cgltf_load_buffers(&options, (cgltf_data*) gltf, pImpl->mGltfPath.c_str());
     if (result != cgltf_result_success) {
         slog.e << "Unable to load resources." << io::endl;
@@ -356,9 +661,26 @@ bool ResourceLoader::loadResources(FFilamentAsset* asset, bool async) {
     }
     #endif
 
+    // Vertex and index data compressed with meshopt decode at several GB/s, this is done
+    // before anything reads the buffers.
+    if (!decodeMeshoptBuffers(asset, pImpl->mEngine->getJobSystem())) {
+        return false;
+    }
+
+    // Start decoding textures right away, so that it overlaps with the processing of the
+    // geometry. The textures are created and bound once the dependency graph is finalized.
+    if (!pImpl->decodeTextures(asset, async)) {
+        return false;
+    }
+
     // Decompress Draco meshes early on, which allows us to exploit subsequent processing such as
-    // tangent generation.
-    decodeDracoMeshes(asset);
+    // tangent generation. Asynchronous loads decompress them in jobs instead, unless the bounding
+    // boxes or the skinning weights need the decompressed data right away.
+    const bool needsDecodedMeshes = pImpl->mRecomputeBoundingBoxes ||
+            (gltf->skins_count > 0 && pImpl->mNormalizeSkinningWeights);
+    if (!async || needsDecodedMeshes) {
+        decodeDracoMeshes(asset, pImpl->mEngine->getJobSystem());
+    }
 
     // Normalize skinning weights, then "import" each skin into the asset by building a mapping of
     // skins to their affected entities.
@@ -381,41 +703,22 @@ bool ResourceLoader::loadResources(FFilamentAsset* asset, bool async) {
         updateBoundingBoxes(asset);
     }
 
-    Engine& engine = *pImpl->mEngine;
-
-    // Upload VertexBuffer and IndexBuffer data to the GPU.
-    for (auto slot : asset->mBufferSlots) {
-        const cgltf_accessor* accessor = slot.accessor;
-        if (!accessor->buffer_view) {
-            continue;
-        }
-        auto bufferData = (const uint8_t*) accessor->buffer_view->buffer->data;
-        const uint8_t* data = computeBindingOffset(accessor) + bufferData;
-        const uint32_t size = computeBindingSize(accessor);
-        if (slot.vertexBuffer) {
-            VertexBuffer::BufferDescriptor bd(data, size, uploadCallback, uploadUserdata(asset));
-            slot.vertexBuffer->setBufferAt(engine, slot.bufferIndex, std::move(bd));
-            continue;
-        }
-        assert(slot.indexBuffer);
-        if (accessor->component_type == cgltf_component_type_r_8u) {
-            const size_t size16 = size * 2;
-            uint16_t* data16 = (uint16_t*) malloc(size16);
-            convertBytesToShorts(data16, data, size);
-            IndexBuffer::BufferDescriptor bd(data16, size16, FREE_CALLBACK);
-            slot.indexBuffer->setBuffer(engine, std::move(bd));
-            continue;
+    if (async) {
+        // Decompress, generate and upload the geometry in the background, one primitive at a
+        // time. Renderables become ready as soon as their primitives have been uploaded.
+        pImpl->createGeometryJobs(asset);
+    } else {
+        // Upload VertexBuffer and IndexBuffer data to the GPU, and apply sparse data
+        // modifications to base arrays.
+        for (const BufferSlot& slot : asset->mBufferSlots) {
+            pImpl->uploadBuffer(asset->mSourceAsset, slot);
         }
-        IndexBuffer::BufferDescriptor bd(data, size, uploadCallback, uploadUserdata(asset));
-        slot.indexBuffer->setBuffer(engine, std::move(bd));
-    }
 
-    // Apply sparse data modifications to base arrays, then upload the result.
-    applySparseData(asset);
-
-    // Compute surface orientation quaternions if necessary. This is similar to sparse data in that
-    // we need to generate the contents of a GPU buffer by processing one or more CPU buffer(s).
-    pImpl->computeTangents(asset);
+        // Compute surface orientation quaternions if necessary. This is similar to sparse data in
+        // that we need to generate the contents of a GPU buffer by processing one or more CPU
+        // buffer(s).
+        pImpl->computeTangents(asset);
+    }
 
     // Non-textured renderables are now considered ready, so notify the dependency graph.
     asset->mDependencyGraph.finalize();
@@ -431,35 +734,101 @@ bool ResourceLoader::asyncBeginLoad(FilamentAsset* asset) {
 }
 
 void ResourceLoader::asyncCancelLoad() {
+    pImpl->cancelGeometryLoading();
     pImpl->cancelTextureDecoding();
     pImpl->mEngine->flushAndWait();
 }
 
 float ResourceLoader::asyncGetLoadProgress() const {
-    const float finished = pImpl->mNumDecoderTasksFinished;
-    const float total = pImpl->mNumDecoderTasks;
+    const float finished = pImpl->mNumDecoderTasksFinished + pImpl->mNumGeometryTasksFinished;
+    const float total = pImpl->mNumDecoderTasks + pImpl->mNumGeometryTasks;
     return total == 0 ? 0 : finished / total;
 }
 
 void ResourceLoader::asyncUpdateLoad() {
-    if (!UTILS_HAS_THREADING) {
+    if (!UTILS_HAS_JOB_THREADS) {
+        pImpl->decodeSinglePrimitive();
         pImpl->decodeSingleTexture();
     }
+    pImpl->uploadPendingPrimitives();
     pImpl->uploadPendingTextures();
 }
 
+static bool isKtx(const uint8_t* data, size_t size) {
+    return size >= KTX_HEADER_SIZE && !memcmp(data, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+}
+
+static bool isDecoded(const TextureCacheEntry* entry) {
+    return entry->pixels || entry->ktx;
+}
+
+// Decodes, or for KTX containers parses, an image held in memory. This is run in a job.
+static void decodeTexture(TextureCacheEntry* entry, const uint8_t* data, size_t size) {
+    if (entry->isKtx) {
+        entry->ktx = new image::KtxBundle(data, uint32_t(size));
+        return;
+    }
+    auto pixels = std::make_unique<Texture::PixelBufferDescriptor>();
+    if (entry->decoder->decode(data, size, entry->channels, entry->lod, pixels.get())) {
+        entry->pixels = pixels.release();
+    }
+}
+
+#if USE_FILESYSTEM
+static void decodeTextureFile(TextureCacheEntry* entry, const Path& path) {
+    if (SharedBuffer file = mapFile(path.c_str())) {
+        decodeTexture(entry, (const uint8_t*) file->buffer, file->size);
+    }
+}
+#endif
+
+// Uploads the mip chain of a KTX container, which is freed once all of its levels have been
+// consumed. The remaining levels, if any, are generated.
+static void uploadKtx(Engine& engine, Texture* texture, image::KtxBundle* ktx) {
+    struct Userdata {
+        image::KtxBundle* ktx;
+        uint32_t remainingLevels;
+    };
+    const image::KtxInfo& info = ktx->getInfo();
+    const uint32_t levels = std::min(ktx->getNumMipLevels(), uint32_t(texture->getLevels()));
+    Userdata* userdata = new Userdata({ ktx, levels });
+    auto release = [](void*, size_t, void* user) {
+        Userdata* userdata = (Userdata*) user;
+        if (--userdata->remainingLevels == 0) {
+            delete userdata->ktx;
+            delete userdata;
+        }
+    };
+    for (uint32_t level = 0; level < levels; level++) {
+        uint8_t* data;
+        uint32_t size;
+        ktx->getBlob({ level, 0, 0 }, &data, &size);
+        if (image::ktx::isCompressed(info)) {
+            Texture::PixelBufferDescriptor pbd(data, size,
+                    image::ktx::toCompressedPixelDataType(info), size, release, userdata);
+            texture->setImage(engine, level, std::move(pbd));
+        } else {
+            Texture::PixelBufferDescriptor pbd(data, size, image::ktx::toPixelDataFormat(info),
+                    image::ktx::toPixelDataType(info), release, userdata);
+            texture->setImage(engine, level, std::move(pbd));
+        }
+    }
+    if (levels < texture->getLevels()) {
+        texture->generateMipmaps(engine);
+    }
+}
+
 void ResourceLoader::Impl::decodeSingleTexture() {
-    assert(!UTILS_HAS_THREADING);
-    int w, h, c;
+    assert(!UTILS_HAS_JOB_THREADS);
 
     // Check if any buffer-based textures haven't been decoded yet.
     for (auto& pair : mBufferTextureCache) {
         const uint8_t* sourceData = (const uint8_t*) pair.first;
         TextureCacheEntry* entry = pair.second.get();
-        if (entry->texels) {
+        if (isDecoded(entry)) {
             continue;
         }
-        entry->texels = stbi_load_from_memory(sourceData, entry->bufferSize, &w, &h, &c, 4);
+        decodeTexture(entry, sourceData, entry->bufferSize);
         return;
     }
 
@@ -467,15 +836,15 @@ void ResourceLoader::Impl::decodeSingleTexture() {
     for (auto& pair : mUriTextureCache) {
         auto uri = pair.first;
         TextureCacheEntry* entry = pair.second.get();
-        if (entry->texels) {
+        if (isDecoded(entry)) {
             continue;
         }
 
         // First, check the user-supplied resource cache for this URI.
         auto iter = mUriDataCache.find(uri);
         if (iter != mUriDataCache.end()) {
-            const uint8_t* sourceData = (const uint8_t*) iter->second.buffer;
-            entry->texels = stbi_load_from_memory(sourceData, iter->second.size, &w, &h, &c, 4);
+            const uint8_t* sourceData = (const uint8_t*) iter->second->buffer;
+            decodeTexture(entry, sourceData, iter->second->size);
             return;
         }
 
@@ -487,7 +856,7 @@ void ResourceLoader::Impl::decodeSingleTexture() {
             return;
         #else
             Path fullpath = Path(mGltfPath).getParent() + uri;
-            entry->texels = stbi_load(fullpath.c_str(), &w, &h, &c, 4);
+            decodeTextureFile(entry, fullpath);
             return;
         #endif
     }
@@ -496,13 +865,16 @@ void ResourceLoader::Impl::decodeSingleTexture() {
 void ResourceLoader::Impl::uploadPendingTextures() {
     auto upload = [this](TextureCacheEntry* entry, Engine& engine) {
         Texture* texture = entry->texture;
-        uint8_t* texels = entry->texels;
-        if (texture && texels && !entry->completed) {
-            Texture::PixelBufferDescriptor pbd(texels,
-                    texture->getWidth() * texture->getHeight() * 4,
-                    Texture::Format::RGBA, Texture::Type::UBYTE, FREE_CALLBACK);
-            texture->setImage(engine, 0, std::move(pbd));
-            texture->generateMipmaps(engine);
+        Texture::PixelBufferDescriptor* pixels = entry->pixels;
+        image::KtxBundle* ktx = entry->ktx;
+        if (texture && (pixels || ktx) && !entry->completed) {
+            if (pixels) {
+                texture->setImage(engine, 0, std::move(*pixels));
+                texture->generateMipmaps(engine);
+                delete pixels;
+            } else {
+                uploadKtx(engine, texture, ktx);
+            }
             entry->completed = true;
             mNumDecoderTasksFinished++;
             mCurrentAsset->mDependencyGraph.markAsReady(texture);
@@ -515,11 +887,13 @@ void ResourceLoader::Impl::uploadPendingTextures() {
 void ResourceLoader::Impl::releasePendingTextures() {
     auto release = [this](TextureCacheEntry* entry, Engine& engine) {
         Texture* texture = entry->texture;
-        uint8_t* texels = entry->texels;
-        if (texture && texels && !entry->completed) {
-            // Normally the ownership of these texels is transferred to PixelBufferDescriptor, but
-            // if uploads have been cancelled then we need to free them explicitly.
-            free(texels);
+        Texture::PixelBufferDescriptor* pixels = entry->pixels;
+        image::KtxBundle* ktx = entry->ktx;
+        if (texture && !entry->completed) {
+            // Normally the texels are handed over to the texture, but if uploads have been
+            // cancelled then the descriptor releases them with its callback.
+            delete pixels;
+            delete ktx;
         }
     };
     for (auto& pair : mBufferTextureCache) release(pair.second.get(), *mEngine);
@@ -545,9 +919,7 @@ void ResourceLoader::Impl::addTextureCacheEntry(const TextureSlot& tb) {
         }
         entry = (mBufferTextureCache[sourceData] = std::make_unique<TextureCacheEntry>()).get();
         entry->srgb = tb.srgb;
-        if (!stbi_info_from_memory(sourceData, totalSize, &entry->width, &entry->height,
-                &entry->numComponents)) {
-            slog.e << "Unable to decode BufferView texture: " << stbi_failure_reason() << io::endl;
+        if (!readTextureInfo(entry, sourceData, totalSize, "BufferView texture")) {
             mBufferTextureCache.erase(sourceData);
             return;
         }
@@ -567,10 +939,8 @@ void ResourceLoader::Impl::addTextureCacheEntry(const TextureSlot& tb) {
     // Check the user-supplied resource cache for this URI, otherwise peek at the file.
     auto iter = mUriDataCache.find(uri);
     if (iter != mUriDataCache.end()) {
-        const uint8_t* sourceData = (const uint8_t*) iter->second.buffer;
-        if (!stbi_info_from_memory(sourceData, iter->second.size, &entry->width,
-                &entry->height, &entry->numComponents)) {
-            slog.e << "Unable to decode " << uri << " : " << stbi_failure_reason() << io::endl;
+        const uint8_t* sourceData = (const uint8_t*) iter->second->buffer;
+        if (!readTextureInfo(entry, sourceData, iter->second->size, uri)) {
             mUriTextureCache.erase(uri);
         }
         return;
@@ -578,15 +948,115 @@ void ResourceLoader::Impl::addTextureCacheEntry(const TextureSlot& tb) {
     #if !USE_FILESYSTEM
         slog.e << "Unable to load texture: " << uri << io::endl;
     #else
+        // The file is mapped, so only the pages of its header are read here.
         Path fullpath = Path(mGltfPath).getParent() + uri;
-        if (!stbi_info(fullpath.c_str(), &entry->width, &entry->height, &entry->numComponents)) {
-            slog.e << "Unable to decode " << fullpath.c_str() << " : " << stbi_failure_reason()
-                    << io::endl;
+        SharedBuffer file = mapFile(fullpath.c_str());
+        if (!file || !readTextureInfo(entry, (const uint8_t*) file->buffer, file->size,
+                fullpath.c_str())) {
             mUriTextureCache.erase(uri);
         }
     #endif
 }
 
+bool ResourceLoader::Impl::readTextureInfo(TextureCacheEntry* entry, const uint8_t* data,
+        size_t size, const char* name) {
+    if (isKtx(data, size)) {
+        return readKtxHeader(entry, data, name);
+    }
+    return readImageInfo(entry, data, size, name);
+}
+
+// Picks the decoder of an image, the resolution at which it's decoded and the format of its
+// texture. Images without alpha are kept in three channels when the device can sample and
+// mipmap them, otherwise they are expanded to RGBA.
+bool ResourceLoader::Impl::readImageInfo(TextureCacheEntry* entry, const uint8_t* data,
+        size_t size, const char* name) {
+    TextureDecoder::Info info{};
+    const TextureDecoder* decoder = nullptr;
+    for (const TextureDecoder* candidate : mTextureDecoders) {
+        if (candidate->getInfo(data, size, &info)) {
+            decoder = candidate;
+            break;
+        }
+    }
+    if (!decoder && mStbDecoder->getInfo(data, size, &info)) {
+        decoder = mStbDecoder.get();
+    }
+    if (!decoder || !info.width || !info.height) {
+        slog.e << "Unable to decode " << name << io::endl;
+        return false;
+    }
+
+    uint8_t lod = 0;
+    while (mMaxTextureSize && std::max(info.width, info.height) >> lod > mMaxTextureSize) {
+        lod++;
+    }
+
+    const Texture::InternalFormat rgb = entry->srgb ?
+            Texture::InternalFormat::SRGB8 : Texture::InternalFormat::RGB8;
+    const bool opaque = info.channels == 1 || info.channels == 3;
+    if (opaque && Texture::isTextureFormatSupported(*mEngine, rgb) &&
+            Texture::isTextureFormatMipmappable(*mEngine, rgb)) {
+        entry->format = rgb;
+        entry->channels = 3;
+    } else {
+        entry->format = entry->srgb ?
+                Texture::InternalFormat::SRGB8_A8 : Texture::InternalFormat::RGBA8;
+        entry->channels = 4;
+    }
+    entry->decoder = decoder;
+    entry->lod = lod;
+    entry->levels = 0xff;
+    entry->width = int(std::max(info.width >> lod, 1u));
+    entry->height = int(std::max(info.height >> lod, 1u));
+    return true;
+}
+
+// The texture is created before the container is parsed, so its description comes from the
+// header. Containers with a format that the device can't sample from are rejected.
+bool ResourceLoader::Impl::readKtxHeader(TextureCacheEntry* entry, const uint8_t* header,
+        const char* name) {
+    image::KtxInfo info;
+    memcpy(&info, header + sizeof(KTX_IDENTIFIER), sizeof(info));
+
+    // numberOfArrayElements, numberOfFaces, numberOfMipmapLevels, bytesOfKeyValueData
+    uint32_t counts[4];
+    memcpy(counts, header + sizeof(KTX_IDENTIFIER) + sizeof(info), sizeof(counts));
+    if (counts[0] > 1 || counts[1] > 1 || info.pixelDepth > 1) {
+        slog.e << "KTX texture is not a 2D texture: " << name << io::endl;
+        return false;
+    }
+
+    const bool compressed = image::ktx::isCompressed(info);
+    Texture::InternalFormat format = image::ktx::toTextureFormat(info);
+    if (format == Texture::InternalFormat(0xffff) || (!compressed &&
+            (image::ktx::toPixelDataFormat(info) == Texture::Format(0xff) ||
+            image::ktx::toPixelDataType(info) == Texture::Type(0xff)))) {
+        slog.e << "Unknown KTX texture format: " << name << io::endl;
+        return false;
+    }
+    if (entry->srgb && format == Texture::InternalFormat::RGB8) {
+        format = Texture::InternalFormat::SRGB8;
+    }
+    if (entry->srgb && format == Texture::InternalFormat::RGBA8) {
+        format = Texture::InternalFormat::SRGB8_A8;
+    }
+    if (!Texture::isTextureFormatSupported(*mEngine, format)) {
+        slog.e << "KTX texture format is not supported by this device: " << name << io::endl;
+        return false;
+    }
+
+    // Uncompressed containers without a mip chain get their mipmaps generated, like the images
+    // decoded images.
+    const uint32_t levels = std::max(counts[2], 1u);
+    entry->isKtx = true;
+    entry->format = format;
+    entry->levels = uint8_t(levels == 1 && !compressed ? 0xff : std::min(levels, 0xffu));
+    entry->width = int(info.pixelWidth);
+    entry->height = int(info.pixelHeight);
+    return true;
+}
+
 void ResourceLoader::Impl::bindTextureToMaterial(const TextureSlot& tb) {
     FFilamentAsset* asset = mCurrentAsset;
 
@@ -631,7 +1101,9 @@ void ResourceLoader::Impl::cancelTextureDecoding() {
     mNumDecoderTasks = 0;
 }
 
-bool ResourceLoader::Impl::createTextures(bool async) {
+bool ResourceLoader::Impl::decodeTextures(FFilamentAsset* asset, bool async) {
+    SYSTRACE_CALL();
+
     // If any decoding jobs are still underway, wait for them to finish.
     JobSystem* js = &mEngine->getJobSystem();
     if (mDecoderRootJob) {
@@ -643,7 +1115,6 @@ bool ResourceLoader::Impl::createTextures(bool async) {
     mUriTextureCache.clear();
 
     // First, determine texture dimensions and create texture cache entries.
-    FFilamentAsset* asset = mCurrentAsset;
     for (auto slot : asset->mTextureSlots) {
         addTextureCacheEntry(slot);
     }
@@ -659,34 +1130,19 @@ bool ResourceLoader::Impl::createTextures(bool async) {
         mNumDecoderTasksFinished = 0;
     }
 
-    // Next create blank Filament textures.
-    auto createTexture = [=](TextureCacheEntry* entry) {
-        entry->texture = Texture::Builder()
-            .width(entry->width)
-            .height(entry->height)
-            .levels(0xff)
-            .format(entry->srgb ? Texture::InternalFormat::SRGB8_A8 : Texture::InternalFormat::RGBA8)
-            .build(*mEngine);
-        asset->takeOwnership(entry->texture);
-    };
-    for (auto& pair : mBufferTextureCache) createTexture(pair.second.get());
-    for (auto& pair : mUriTextureCache) createTexture(pair.second.get());
-
-    // Bind the textures to material instances.
-    for (auto slot : asset->mTextureSlots) {
-        bindTextureToMaterial(slot);
-    }
-
     // Before creating jobs for PNG / JPEG decoding, we might need to return early. On single
     // threaded systems, it is usually fine to create jobs because the job system will simply
     // execute serially. However if the client requests async behavior, then we need to wait
     // until subsequent calls to asyncUpdateLoad().
-    if (!UTILS_HAS_THREADING && async) {
+    if (!UTILS_HAS_JOB_THREADS && async) {
         return true;
     }
 
     JobSystem::Job* parent = js->createJob();
 
+    // Decoding in the background shouldn't compete with the rendering of frames.
+    const uint32_t runFlags = async ? JobSystem::LOW_PRIORITY : 0;
+
     // Create a copy of the shared_ptr to the source data to prevent it from being freed during
     // the texture decoding process.
     FFilamentAsset::SourceHandle retainSourceAsset = asset->mSourceAsset;
@@ -696,14 +1152,13 @@ bool ResourceLoader::Impl::createTextures(bool async) {
         const uint8_t* sourceData = (const uint8_t*) pair.first;
         TextureCacheEntry* entry = pair.second.get();
         JobSystem::Job* decode = jobs::createJob(*js, parent, [retainSourceAsset, entry, sourceData] {
-            int width, height, comp;
-            entry->texels = stbi_load_from_memory(sourceData, entry->bufferSize,
-                    &width, &height, &comp, 4);
+            decodeTexture(entry, sourceData, entry->bufferSize);
         });
-        js->run(decode);
+        js->run(decode, runFlags);
     }
 
     // Kick off jobs that decode texels from URI strings.
+    bool success = true;
     for (auto& pair : mUriTextureCache) {
         auto uri = pair.first;
         TextureCacheEntry* entry = pair.second.get();
@@ -711,185 +1166,76 @@ bool ResourceLoader::Impl::createTextures(bool async) {
         // First, check the user-supplied resource cache for this URI.
         auto iter = mUriDataCache.find(uri);
         if (iter != mUriDataCache.end()) {
-            const uint8_t* sourceData = (const uint8_t*) iter->second.buffer;
+            const uint8_t* sourceData = (const uint8_t*) iter->second->buffer;
             JobSystem::Job* decode = jobs::createJob(*js, parent, [retainSourceAsset, entry, sourceData, iter] {
-                int width, height, comp;
-                entry->texels = stbi_load_from_memory(sourceData, iter->second.size, &width,
-                        &height, &comp, 4);
+                decodeTexture(entry, sourceData, iter->second->size);
             });
-            js->run(decode);
+            js->run(decode, runFlags);
             continue;
         }
 
         // Otherwise load it from the file system if this platform supports it.
         #if !USE_FILESYSTEM
             slog.e << "Unable to load texture: " << uri << io::endl;
-            return false;
+            success = false;
         #else
             Path fullpath = Path(mGltfPath).getParent() + uri;
             JobSystem::Job* decode = jobs::createJob(*js, parent, [retainSourceAsset, entry, fullpath] {
-                int width, height, comp;
-                entry->texels = stbi_load(fullpath.c_str(), &width, &height, &comp, 4);
+                decodeTextureFile(entry, fullpath);
             });
-            js->run(decode);
+            js->run(decode, runFlags);
         #endif
     }
 
+    // Decoding proceeds while the geometry is being processed, createTextures() waits for it
+    // when the load is synchronous.
+    mDecoderRootJob = js->runAndRetain(parent, runFlags);
+    return success;
+}
+
+bool ResourceLoader::Impl::createTextures(bool async) {
+    FFilamentAsset* asset = mCurrentAsset;
+
+    // Create blank Filament textures.
+    auto createTexture = [=](TextureCacheEntry* entry) {
+        entry->texture = Texture::Builder()
+            .width(entry->width)
+            .height(entry->height)
+            .levels(entry->levels)
+            .format(entry->format)
+            .build(*mEngine);
+        asset->takeOwnership(entry->texture);
+    };
+    for (auto& pair : mBufferTextureCache) createTexture(pair.second.get());
+    for (auto& pair : mUriTextureCache) createTexture(pair.second.get());
+
+    // Bind the textures to material instances.
+    for (auto slot : asset->mTextureSlots) {
+        bindTextureToMaterial(slot);
+    }
+
+    // Asynchronous loads upload the textures from asyncUpdateLoad().
     if (async) {
-        mDecoderRootJob = js->runAndRetain(parent);
         return true;
     }
 
     // Wait for decoding to finish.
-    js->runAndWait(parent);
+    if (mDecoderRootJob) {
+        mEngine->getJobSystem().waitAndRelease(mDecoderRootJob);
+        mDecoderRootJob = nullptr;
+    }
 
     // Finally, upload texels to the GPU and generate mipmaps.
-    mCurrentAsset = asset;
     uploadPendingTextures();
 
     return true;
 }
 
-void ResourceLoader::Impl::computeTangents(FFilamentAsset* asset) {
-    SYSTRACE_CALL();
-
+void ResourceLoader::Impl::collectTangentsJobs(FFilamentAsset* asset,
+        std::vector<TangentsJob>& jobs) {
     const cgltf_accessor* kGenerateTangents = &asset->mGenerateTangents;
     const cgltf_accessor* kGenerateNormals = &asset->mGenerateNormals;
 
-    struct JobParams {
-        // Consumed by the job:
-        const cgltf_primitive* prim;
-        VertexBuffer* const vb;
-        const uint8_t slot;
-        const int morphTargetIndex;
-        // Produced by the job:
-        cgltf_size vertexCount;
-        short4* results;
-    };
-
-    constexpr int kMorphTargetUnused = -1;
-
-    auto computeQuats = [&](JobParams* params) {
-        const cgltf_primitive& prim = *params->prim;
-        const uint8_t slot = params->slot;
-        const int morphTargetIndex = params->morphTargetIndex;
-
-        // Declare vectors of normals and tangents, which we'll extract & convert from the source.
-        std::vector<float3> fp32Normals;
-        std::vector<float4> fp32Tangents;
-        std::vector<float3> fp32Positions;
-        std::vector<float2> fp32TexCoords;
-        std::vector<uint3> ui32Triangles;
-
-        cgltf_size vertexCount = 0;
-
-        // Build a mapping from cgltf_attribute_type to cgltf_accessor*.
-        const int NUM_ATTRIBUTES = 8;
-        const cgltf_accessor* accessors[NUM_ATTRIBUTES] = {};
-
-        // Collect accessors for normals, tangents, etc.
-        if (morphTargetIndex == kMorphTargetUnused) {
-            for (cgltf_size aindex = 0; aindex < prim.attributes_count; aindex++) {
-                const cgltf_attribute& attr = prim.attributes[aindex];
-                if (attr.index == 0) {
-                    accessors[attr.type] = attr.data;
-                    vertexCount = attr.data->count;
-                }
-            }
-        } else {
-            const cgltf_morph_target& morphTarget = prim.targets[morphTargetIndex];
-            for (cgltf_size aindex = 0; aindex < morphTarget.attributes_count; aindex++) {
-                const cgltf_attribute& attr = morphTarget.attributes[aindex];
-                if (attr.index == 0) {
-                    accessors[attr.type] = attr.data;
-                    vertexCount = attr.data->count;
-                }
-            }
-        }
-        params->vertexCount = vertexCount;
-
-        // At a minimum we need normals to generate tangents.
-        auto normalsInfo = accessors[cgltf_attribute_type_normal];
-        if (vertexCount == 0) {
-            return;
-        }
-
-        geometry::SurfaceOrientation::Builder sob;
-        sob.vertexCount(vertexCount);
-
-        // Convert normals into packed floats.
-        if (normalsInfo) {
-            assert(normalsInfo->count == vertexCount);
-            assert(normalsInfo->type == cgltf_type_vec3);
-            fp32Normals.resize(vertexCount);
-            cgltf_accessor_unpack_floats(normalsInfo, &fp32Normals[0].x, vertexCount * 3);
-            sob.normals(fp32Normals.data());
-        }
-
-        // Convert tangents into packed floats.
-        auto tangentsInfo = accessors[cgltf_attribute_type_tangent];
-        if (tangentsInfo) {
-            if (tangentsInfo->count != vertexCount || tangentsInfo->type != cgltf_type_vec4) {
-                slog.e << "Bad tangent count or type." << io::endl;
-                return;
-            }
-            fp32Tangents.resize(vertexCount);
-            cgltf_accessor_unpack_floats(tangentsInfo, &fp32Tangents[0].x, vertexCount * 4);
-            sob.tangents(fp32Tangents.data());
-        }
-
-        auto positionsInfo = accessors[cgltf_attribute_type_position];
-        if (positionsInfo) {
-            if (positionsInfo->count != vertexCount || positionsInfo->type != cgltf_type_vec3) {
-                slog.e << "Bad position count or type." << io::endl;
-                return;
-            }
-            fp32Positions.resize(vertexCount);
-            cgltf_accessor_unpack_floats(positionsInfo, &fp32Positions[0].x, vertexCount * 3);
-            sob.positions(fp32Positions.data());
-        }
-
-        if (prim.indices) {
-            size_t triangleCount = prim.indices->count / 3;
-            ui32Triangles.resize(triangleCount);
-            cgltf_size j = 0;
-            for (auto& triangle : ui32Triangles) {
-                triangle.x = cgltf_accessor_read_index(prim.indices, j++);
-                triangle.y = cgltf_accessor_read_index(prim.indices, j++);
-                triangle.z = cgltf_accessor_read_index(prim.indices, j++);
-            }
-        } else {
-            size_t triangleCount = vertexCount / 3;
-            ui32Triangles.resize(triangleCount);
-            cgltf_size j = 0;
-            for (auto& triangle : ui32Triangles) {
-                triangle.x = j++;
-                triangle.y = j++;
-                triangle.z = j++;
-            }
-        }
-
-        sob.triangleCount(ui32Triangles.size());
-        sob.triangles(ui32Triangles.data());
-
-        auto texcoordsInfo = accessors[cgltf_attribute_type_texcoord];
-        if (texcoordsInfo) {
-            if (texcoordsInfo->count != vertexCount || texcoordsInfo->type != cgltf_type_vec2) {
-                slog.e << "Bad texture coordinate count or type." << io::endl;
-                return;
-            }
-            fp32TexCoords.resize(vertexCount);
-            cgltf_accessor_unpack_floats(texcoordsInfo, &fp32TexCoords[0].x, vertexCount * 2);
-            sob.uvs(fp32TexCoords.data());
-        }
-
-        // Compute surface orientation quaternions.
-        params->results = (short4*) malloc(sizeof(short4) * vertexCount);
-        geometry::SurfaceOrientation* helper = sob.build();
-        helper->getQuats(params->results, vertexCount);
-        delete helper;
-    };
-
     // Collect all TANGENT vertex attribute slots that need to be populated.
     tsl::robin_map<VertexBuffer*, uint8_t> baseTangents;
     tsl::robin_map<VertexBuffer*, uint8_t> morphTangents[4];
@@ -905,57 +1251,276 @@ void ResourceLoader::Impl::computeTangents(FFilamentAsset* asset) {
     }
 
     // Create a job description for each primitive.
-    std::vector<JobParams> jobParams;
     for (auto pair : asset->mPrimitives) {
         VertexBuffer* vb = pair.second;
         auto iter = baseTangents.find(vb);
         if (iter != baseTangents.end()) {
-            jobParams.emplace_back(JobParams { pair.first, vb, iter->second, kMorphTargetUnused });
+            jobs.push_back(TangentsJob { pair.first, vb, iter->second, kMorphTargetUnused });
         }
         for (int morphTarget = 0; morphTarget < 4; morphTarget++) {
             const auto& tangents = morphTangents[morphTarget];
             auto iter = tangents.find(vb);
             if (iter != tangents.end()) {
-                jobParams.emplace_back(JobParams { pair.first, vb, iter->second, morphTarget });
+                jobs.push_back(TangentsJob { pair.first, vb, iter->second, morphTarget });
             }
         }
     }
+}
+
+void ResourceLoader::Impl::uploadTangents(const TangentsJob& job) {
+    if (!job.results) {
+        return;
+    }
+    VertexBuffer::BufferDescriptor bd(job.results, job.vertexCount * sizeof(short4),
+            FREE_CALLBACK);
+    job.vb->setBufferAt(*mEngine, job.slot, std::move(bd));
+}
+
+void ResourceLoader::Impl::computeTangents(FFilamentAsset* asset) {
+    SYSTRACE_CALL();
+
+    std::vector<TangentsJob> jobParams;
+    collectTangentsJobs(asset, jobParams);
 
     // Kick off jobs for computing tangent frames.
     JobSystem* js = &mEngine->getJobSystem();
     JobSystem::Job* parent = js->createJob();
-    for (JobParams& params : jobParams) {
-        JobParams* pptr = &params;
-        js->run(jobs::createJob(*js, parent, [pptr, computeQuats] { computeQuats(pptr); }));
+    for (TangentsJob& params : jobParams) {
+        TangentsJob* pptr = &params;
+        js->run(jobs::createJob(*js, parent, [pptr] { computeTangentFrames(pptr); }));
     }
     js->runAndWait(parent);
 
     // Finally, upload quaternions to the GPU from the main thread.
-    for (JobParams& params : jobParams) {
-        VertexBuffer::BufferDescriptor bd(params.results, params.vertexCount * sizeof(short4),
-                FREE_CALLBACK);
-        params.vb->setBufferAt(*mEngine, params.slot, std::move(bd));
+    for (const TangentsJob& params : jobParams) {
+        uploadTangents(params);
     }
 }
 
-ResourceLoader::Impl::~Impl() {
-    if (mDecoderRootJob) {
-        mEngine->getJobSystem().waitAndRelease(mDecoderRootJob);
+// Decompresses and generates the geometry of a primitive, this is run in a job.
+static void decodePrimitive(FFilamentAsset::SourceAsset* source, PendingPrimitive* primitive) {
+    decodeDracoMesh(source, primitive->prim);
+    for (TangentsJob& job : primitive->tangents) {
+        computeTangentFrames(&job);
     }
+    primitive->decoded.store(true, std::memory_order_release);
 }
 
-void ResourceLoader::applySparseData(FFilamentAsset* asset) const {
-    for (auto slot : asset->mBufferSlots) {
-        const cgltf_accessor* accessor = slot.accessor;
-        if (!accessor->is_sparse) {
-            continue;
-        }
+void ResourceLoader::Impl::uploadBuffer(const FFilamentAsset::SourceHandle& source,
+        const BufferSlot& slot) {
+    const cgltf_accessor* accessor = slot.accessor;
+    if (!accessor->buffer_view) {
+        return;
+    }
+    Engine& engine = *mEngine;
+
+    // Sparse accessors are unpacked from their base array, then uploaded in its place.
+    if (accessor->is_sparse && slot.vertexBuffer) {
         cgltf_size numFloats = accessor->count * cgltf_num_components(accessor->type);
         cgltf_size numBytes = sizeof(float) * numFloats;
         float* generated = (float*) malloc(numBytes);
         cgltf_accessor_unpack_floats(accessor, generated, numFloats);
         VertexBuffer::BufferDescriptor bd(generated, numBytes, FREE_CALLBACK);
-        slot.vertexBuffer->setBufferAt(*pImpl->mEngine, slot.bufferIndex, std::move(bd));
+        slot.vertexBuffer->setBufferAt(engine, slot.bufferIndex, std::move(bd));
+        return;
+    }
+
+    const uint8_t* data = computeBindingData(accessor);
+    const uint32_t size = computeBindingSize(accessor);
+
+    // The depth vertices are packed tightly, whatever the layout of the buffer view.
+    const uint32_t elementSize = computeElementSize(accessor);
+    if (slot.compact && data && accessor->stride != elementSize) {
+        const size_t packedSize = elementSize * accessor->count;
+        uint8_t* packed = (uint8_t*) malloc(packedSize);
+        for (cgltf_size i = 0; i < accessor->count; ++i) {
+            memcpy(packed + i * elementSize, data + i * accessor->stride, elementSize);
+        }
+        VertexBuffer::BufferDescriptor bd(packed, packedSize, FREE_CALLBACK);
+        slot.vertexBuffer->setBufferAt(engine, slot.bufferIndex, std::move(bd));
+        return;
+    }
+
+    if (slot.vertexBuffer) {
+        VertexBuffer::BufferDescriptor bd(data, size, uploadCallback, uploadUserdata(source));
+        slot.vertexBuffer->setBufferAt(engine, slot.bufferIndex, std::move(bd));
+        return;
+    }
+    assert(slot.indexBuffer);
+    const uint32_t byteOffset = slot.indexOffset * (slot.wideIndices ? 4 : 2);
+    if (slot.wideIndices && accessor->component_type != cgltf_component_type_r_32u) {
+        const size_t size32 = accessor->count * sizeof(uint32_t);
+        uint32_t* data32 = (uint32_t*) malloc(size32);
+        for (cgltf_size i = 0; i < accessor->count; ++i) {
+            data32[i] = uint32_t(cgltf_accessor_read_index(accessor, i));
+        }
+        IndexBuffer::BufferDescriptor bd(data32, size32, FREE_CALLBACK);
+        slot.indexBuffer->setBuffer(engine, std::move(bd), byteOffset);
+        return;
+    }
+    if (accessor->component_type == cgltf_component_type_r_8u) {
+        const size_t size16 = size * 2;
+        uint16_t* data16 = (uint16_t*) malloc(size16);
+        convertBytesToShorts(data16, data, size);
+        IndexBuffer::BufferDescriptor bd(data16, size16, FREE_CALLBACK);
+        slot.indexBuffer->setBuffer(engine, std::move(bd), byteOffset);
+        return;
+    }
+    IndexBuffer::BufferDescriptor bd(data, size, uploadCallback, uploadUserdata(source));
+    slot.indexBuffer->setBuffer(engine, std::move(bd), byteOffset);
+}
+
+void ResourceLoader::Impl::createGeometryJobs(FFilamentAsset* asset) {
+    SYSTRACE_CALL();
+
+    // Gather the buffer slots and the tangent frames of each primitive.
+    // Packed index buffers are shared, their slots are told apart by their offset.
+    tsl::robin_map<VertexBuffer*, PendingPrimitive*> vertexBuffers;
+    std::map<std::pair<IndexBuffer*, uint32_t>, PendingPrimitive*> indexBuffers;
+    for (auto pair : asset->mPrimitives) {
+        mPendingPrimitives.emplace_back(new PendingPrimitive { pair.first, pair.second });
+        vertexBuffers[pair.second] = mPendingPrimitives.back().get();
+    }
+    for (const auto& pair : asset->mMeshCache) {
+        for (const Primitive& prim : pair.second) {
+            auto iter = vertexBuffers.find(prim.vertices);
+            if (prim.indices && iter != vertexBuffers.end()) {
+                iter->second->indices = prim.indices;
+                indexBuffers[{ prim.indices, prim.indexOffset }] = iter->second;
+            }
+            // the depth vertices are uploaded with the primitive's vertices
+            if (prim.depthVertices && iter != vertexBuffers.end()) {
+                PendingPrimitive* primitive = iter->second;
+                vertexBuffers[prim.depthVertices] = primitive;
+            }
+        }
+    }
+    for (const BufferSlot& slot : asset->mBufferSlots) {
+        if (slot.vertexBuffer) {
+            vertexBuffers.at(slot.vertexBuffer)->slots.push_back(slot);
+        } else if (auto iter = indexBuffers.find({ slot.indexBuffer, slot.indexOffset });
+                iter != indexBuffers.end()) {
+            iter->second->slots.push_back(slot);
+        }
+    }
+    std::vector<TangentsJob> tangents;
+    collectTangentsJobs(asset, tangents);
+    for (const TangentsJob& job : tangents) {
+        vertexBuffers.at(job.vb)->tangents.push_back(job);
+    }
+
+    // Renderables wait for their primitives in addition to their textures.
+    if (asset->isInstanced()) {
+        for (FFilamentInstance* instance : asset->mInstances) {
+            asset->addGeometryEdges(instance->nodeMap);
+        }
+    } else {
+        asset->addGeometryEdges(asset->mNodeMap);
+    }
+
+    mGeometrySource = asset->mSourceAsset;
+    mNumGeometryTasks = mPendingPrimitives.size();
+    mNumGeometryTasksFinished = 0;
+
+    // On single threaded systems, primitives are decoded one at a time by asyncUpdateLoad().
+    if (!UTILS_HAS_JOB_THREADS) {
+        return;
+    }
+
+    // Like texture decoding, this shouldn't compete with the rendering of frames.
+    JobSystem* js = &mEngine->getJobSystem();
+    JobSystem::Job* parent = js->createJob();
+    FFilamentAsset::SourceAsset* source = mGeometrySource.get();
+    for (auto& pending : mPendingPrimitives) {
+        PendingPrimitive* primitive = pending.get();
+        JobSystem::Job* decode = jobs::createJob(*js, parent, [source, primitive] {
+            decodePrimitive(source, primitive);
+        });
+        js->run(decode, JobSystem::LOW_PRIORITY);
+    }
+    mGeometryRootJob = js->runAndRetain(parent, JobSystem::LOW_PRIORITY);
+}
+
+void ResourceLoader::Impl::decodeSinglePrimitive() {
+    assert(!UTILS_HAS_JOB_THREADS);
+    for (auto& pending : mPendingPrimitives) {
+        if (!pending->decoded.load(std::memory_order_relaxed)) {
+            decodePrimitive(mGeometrySource.get(), pending.get());
+            return;
+        }
+    }
+}
+
+void ResourceLoader::Impl::uploadPendingPrimitives() {
+    if (mPendingPrimitives.empty()) {
+        return;
+    }
+    for (auto& pending : mPendingPrimitives) {
+        PendingPrimitive* primitive = pending.get();
+        if (primitive->uploaded || !primitive->decoded.load(std::memory_order_acquire)) {
+            continue;
+        }
+        for (const BufferSlot& slot : primitive->slots) {
+            uploadBuffer(mGeometrySource, slot);
+        }
+        for (const TangentsJob& job : primitive->tangents) {
+            uploadTangents(job);
+        }
+        primitive->uploaded = true;
+        mNumGeometryTasksFinished++;
+        mCurrentAsset->mDependencyGraph.markAsReady(primitive->vertices);
+    }
+
+    // Once everything has been uploaded, the source data is only retained by the buffers that
+    // are still in flight.
+    if (mNumGeometryTasksFinished == mNumGeometryTasks) {
+        if (mGeometryRootJob) {
+            mEngine->getJobSystem().waitAndRelease(mGeometryRootJob);
+            mGeometryRootJob = nullptr;
+        }
+        mPendingPrimitives.clear();
+        mGeometrySource.reset();
+    }
+}
+
+void ResourceLoader::Impl::finishGeometryLoading() {
+    if (mGeometryRootJob) {
+        mEngine->getJobSystem().waitAndRelease(mGeometryRootJob);
+        mGeometryRootJob = nullptr;
+    }
+    for (auto& pending : mPendingPrimitives) {
+        if (!pending->decoded.load(std::memory_order_relaxed)) {
+            decodePrimitive(mGeometrySource.get(), pending.get());
+        }
+    }
+    uploadPendingPrimitives();
+    mNumGeometryTasks = 0;
+    mNumGeometryTasksFinished = 0;
+}
+
+void ResourceLoader::Impl::cancelGeometryLoading() {
+    if (mGeometryRootJob) {
+        mEngine->getJobSystem().waitAndRelease(mGeometryRootJob);
+        mGeometryRootJob = nullptr;
+    }
+    for (auto& pending : mPendingPrimitives) {
+        if (!pending->uploaded) {
+            // Ownership of the tangent frames is normally transferred to the BufferDescriptor.
+            for (const TangentsJob& job : pending->tangents) {
+                free(job.results);
+            }
+        }
+    }
+    mPendingPrimitives.clear();
+    mGeometrySource.reset();
+    mNumGeometryTasks = 0;
+    mNumGeometryTasksFinished = 0;
+}
+
+ResourceLoader::Impl::~Impl() {
+    cancelGeometryLoading();
+    if (mDecoderRootJob) {
+        mEngine->getJobSystem().waitAndRelease(mDecoderRootJob);
     }
 }
 
@@ -965,8 +1530,7 @@ void ResourceLoader::normalizeSkinningWeights(FFilamentAsset* asset) const {
             slog.w << "Cannot normalize weights, unsupported attribute type." << io::endl;
             return;
         }
-        uint8_t* bytes = (uint8_t*) data->buffer_view->buffer->data;
-        float4* floats = (float4*) (bytes + data->offset + data->buffer_view->offset);
+        float4* floats = (float4*) computeBindingData(data);
         for (cgltf_size i = 0; i < data->count; ++i) {
             float4 weights = floats[i];
             float sum = weights.x + weights.y + weights.z + weights.w;
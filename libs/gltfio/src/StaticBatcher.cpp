@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gltfio/StaticBatcher.h>
+
+#include "FFilamentAsset.h"
+#include "upcast.h"
+
+#include <filament/Box.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+
+#include <geometry/SurfaceOrientation.h>
+
+#include <utils/EntityManager.h>
+#include <utils/Log.h>
+
+#include <math/mat3.h>
+#include <math/vec3.h>
+
+#include <tsl/robin_map.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include <cgltf.h>
+
+using namespace filament;
+using namespace filament::math;
+using namespace utils;
+
+static const auto FREE_CALLBACK = [](void* mem, size_t, void*) { free(mem); };
+
+namespace gltfio {
+
+namespace {
+
+// the optional attributes of a batch, the tangents are always present
+enum Attributes : uint8_t {
+    HAS_UV0     = 0x1,
+    HAS_UV1     = 0x2,
+    HAS_COLORS  = 0x4,
+};
+
+// the primitives that can be merged have the same key
+struct BatchKey {
+    MaterialInstance* materialInstance;
+    uint8_t attributes;
+    uint8_t layerMask;
+    bool castShadows;
+    bool receiveShadows;
+
+    bool operator==(BatchKey const& rhs) const noexcept {
+        return materialInstance == rhs.materialInstance && attributes == rhs.attributes &&
+                layerMask == rhs.layerMask && castShadows == rhs.castShadows &&
+                receiveShadows == rhs.receiveShadows;
+    }
+};
+
+struct BatchKeyHash {
+    size_t operator()(BatchKey const& key) const noexcept {
+        const size_t flags = key.attributes | (key.layerMask << 8u) |
+                (key.castShadows << 16u) | (key.receiveShadows << 17u);
+        return std::hash<void*>()(key.materialInstance) ^ (flags * 0x9e3779b97f4a7c15llu);
+    }
+};
+
+// the geometry of an added primitive, in world space
+struct PendingPrimitive {
+    uint32_t batchKey;
+    int3 cell;
+    std::vector<float3> positions;
+    std::vector<short4> tangents;
+    std::vector<float2> uv0;
+    std::vector<float2> uv1;
+    std::vector<float4> colors;
+    std::vector<uint32_t> indices;
+};
+
+} // anonymous namespace
+
+struct StaticBatcherImpl {
+    StaticBatcherImpl(Engine* engine, StaticBatcherConfig const& config)
+            : engine(engine), config(config) {}
+
+    ~StaticBatcherImpl() {
+        EntityManager& em = EntityManager::get();
+        for (Entity entity : entities) {
+            engine->destroy(entity);
+            em.destroy(entity);
+        }
+        for (VertexBuffer* vb : vertexBuffers) {
+            engine->destroy(vb);
+        }
+        for (IndexBuffer* ib : indexBuffers) {
+            engine->destroy(ib);
+        }
+    }
+
+    void addPrimitive(StaticBatcher::Geometry const& geometry, MaterialInstance* mi,
+            mat4f const& transform, bool castShadows, bool receiveShadows, uint8_t layerMask);
+
+    void addRenderablePrimitive(Entity entity, size_t primitiveIndex,
+            StaticBatcher::Geometry const& geometry);
+
+    size_t addAsset(FFilamentAsset const* asset);
+
+    void createBatch(PendingPrimitive const* const* first, PendingPrimitive const* const* last);
+
+    Engine* const engine;
+    const StaticBatcherConfig config;
+
+    std::vector<BatchKey> batchKeys;
+    tsl::robin_map<BatchKey, uint32_t, BatchKeyHash> batchKeyIndices;
+    std::vector<PendingPrimitive> primitives;
+
+    // number of primitives added for each renderable
+    tsl::robin_map<Entity, size_t> addedPrimitiveCounts;
+    std::vector<Entity> sourceEntities;
+
+    std::vector<Entity> entities;
+    std::vector<VertexBuffer*> vertexBuffers;
+    std::vector<IndexBuffer*> indexBuffers;
+};
+
+void StaticBatcherImpl::addPrimitive(StaticBatcher::Geometry const& geometry,
+        MaterialInstance* mi, mat4f const& transform, bool castShadows, bool receiveShadows,
+        uint8_t layerMask) {
+    const size_t vertexCount = geometry.vertexCount;
+    if (!geometry.positions || vertexCount == 0 || !mi) {
+        return;
+    }
+
+    const BatchKey key = {
+            .materialInstance = mi,
+            .attributes = uint8_t((geometry.uv0 ? HAS_UV0 : 0) | (geometry.uv1 ? HAS_UV1 : 0) |
+                    (geometry.colors ? HAS_COLORS : 0)),
+            .layerMask = layerMask,
+            .castShadows = castShadows,
+            .receiveShadows = receiveShadows
+    };
+    auto pos = batchKeyIndices.find(key);
+    if (pos == batchKeyIndices.end()) {
+        pos = batchKeyIndices.insert({ key, uint32_t(batchKeys.size()) }).first;
+        batchKeys.push_back(key);
+    }
+
+    primitives.emplace_back();
+    PendingPrimitive& primitive = primitives.back();
+    primitive.batchKey = pos->second;
+
+    // a transform that mirrors the primitive also reverses the winding of its triangles
+    const mat3f upper = transform.upperLeft();
+    const mat3f normalTransform = mat3f::getTransformForNormals(upper);
+    const bool mirrored = det(upper) < 0.0f;
+
+    Box box;
+    float3 minimum(std::numeric_limits<float>::max());
+    float3 maximum(std::numeric_limits<float>::lowest());
+    primitive.positions.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const float3 p = (transform * float4(geometry.positions[i], 1.0f)).xyz;
+        primitive.positions[i] = p;
+        minimum = min(minimum, p);
+        maximum = max(maximum, p);
+    }
+    box.set(minimum, maximum);
+    primitive.cell = int3(floor(box.center / config.chunkSize));
+
+    if (geometry.indices) {
+        primitive.indices.assign(geometry.indices, geometry.indices + geometry.indexCount);
+    } else {
+        primitive.indices.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            primitive.indices[i] = uint32_t(i);
+        }
+    }
+    primitive.indices.resize(primitive.indices.size() - primitive.indices.size() % 3);
+    if (mirrored) {
+        for (size_t i = 0; i < primitive.indices.size(); i += 3) {
+            std::swap(primitive.indices[i + 1], primitive.indices[i + 2]);
+        }
+    }
+
+    // the tangent frames are computed in world space, as the ResourceLoader does in object space
+    std::vector<float3> normals;
+    std::vector<float4> tangents;
+    geometry::SurfaceOrientation::Builder sob;
+    sob.vertexCount(vertexCount);
+    sob.positions(primitive.positions.data());
+    sob.triangleCount(primitive.indices.size() / 3);
+    sob.triangles(reinterpret_cast<uint3 const*>(primitive.indices.data()));
+    if (geometry.normals) {
+        normals.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            normals[i] = normalize(normalTransform * geometry.normals[i]);
+        }
+        sob.normals(normals.data());
+    }
+    if (geometry.normals && geometry.tangents) {
+        tangents.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float4 t = geometry.tangents[i];
+            tangents[i] = float4(normalize(upper * t.xyz), mirrored ? -t.w : t.w);
+        }
+        sob.tangents(tangents.data());
+    }
+    if (geometry.uv0) {
+        sob.uvs(geometry.uv0);
+    }
+    geometry::SurfaceOrientation* helper = sob.build();
+    primitive.tangents.resize(vertexCount);
+    helper->getQuats(primitive.tangents.data(), vertexCount);
+    delete helper;
+
+    if (geometry.uv0) {
+        primitive.uv0.assign(geometry.uv0, geometry.uv0 + vertexCount);
+    }
+    if (geometry.uv1) {
+        primitive.uv1.assign(geometry.uv1, geometry.uv1 + vertexCount);
+    }
+    if (geometry.colors) {
+        primitive.colors.assign(geometry.colors, geometry.colors + vertexCount);
+    }
+}
+
+void StaticBatcherImpl::addRenderablePrimitive(Entity entity, size_t primitiveIndex,
+        StaticBatcher::Geometry const& geometry) {
+    RenderableManager& rm = engine->getRenderableManager();
+    TransformManager& tm = engine->getTransformManager();
+    const RenderableManager::Instance ri = rm.getInstance(entity);
+    if (!ri || primitiveIndex >= rm.getPrimitiveCount(ri)) {
+        return;
+    }
+    const TransformManager::Instance ti = tm.getInstance(entity);
+    const mat4f transform = ti ? tm.getWorldTransform(ti) : mat4f();
+    addPrimitive(geometry, rm.getMaterialInstanceAt(ri, primitiveIndex), transform,
+            rm.isShadowCaster(ri), rm.isShadowReceiver(ri), rm.getLayerMask(ri));
+
+    size_t& count = addedPrimitiveCounts[entity];
+    if (++count == rm.getPrimitiveCount(ri)) {
+        sourceEntities.push_back(entity);
+    }
+}
+
+size_t StaticBatcherImpl::addAsset(FFilamentAsset const* asset) {
+    if (asset->isInstanced() || !asset->mSourceAsset) {
+        slog.e << "StaticBatcher needs the source data of a non-instanced asset." << io::endl;
+        return 0;
+    }
+
+    RenderableManager& rm = engine->getRenderableManager();
+
+    // the texture coordinates of each material, see AssetLoader::createPrimitive()
+    tsl::robin_map<MaterialInstance*, UvMap> uvmaps;
+    for (auto const& entry : asset->mMatInstanceCache) {
+        uvmaps[entry.second.instance] = entry.second.uvmap;
+    }
+
+    size_t count = 0;
+    std::vector<float3> positions;
+    std::vector<float3> normals;
+    std::vector<float4> tangents;
+    std::vector<float2> uvs[2];
+    std::vector<float4> colors;
+    std::vector<uint32_t> indices;
+    for (auto const& item : asset->mNodeMap) {
+        cgltf_node const* node = item.first;
+        const Entity entity = item.second;
+        const RenderableManager::Instance ri = rm.getInstance(entity);
+        cgltf_mesh const* mesh = node->mesh;
+        if (!ri || !mesh || node->skin || mesh->primitives_count != rm.getPrimitiveCount(ri) ||
+                rm.getInstanceCount(ri) > 1 || rm.getLevelOfDetailCount(ri) > 1) {
+            continue;
+        }
+
+        for (cgltf_size index = 0; index < mesh->primitives_count; index++) {
+            cgltf_primitive const& prim = mesh->primitives[index];
+            if (prim.type != cgltf_primitive_type_triangles || prim.targets_count > 0 ||
+                    prim.has_draco_mesh_compression) {
+                continue;
+            }
+
+            MaterialInstance* mi = rm.getMaterialInstanceAt(ri, index);
+            UvMap uvmap = {};
+            auto pos = uvmaps.find(mi);
+            if (pos != uvmaps.end()) {
+                uvmap = pos->second;
+            } else {
+                uvmap[0] = UV0;
+                uvmap[1] = UV1;
+            }
+
+            StaticBatcher::Geometry geometry;
+            bool valid = true;
+            for (cgltf_size a = 0; a < prim.attributes_count; a++) {
+                cgltf_attribute const& attribute = prim.attributes[a];
+                cgltf_accessor const* accessor = attribute.data;
+                const cgltf_size vertexCount = accessor->count;
+                if (!accessor->buffer_view && !accessor->is_sparse) {
+                    valid = false;
+                    break;
+                }
+                switch (attribute.type) {
+                    case cgltf_attribute_type_position:
+                        positions.resize(vertexCount);
+                        cgltf_accessor_unpack_floats(accessor, &positions[0].x, vertexCount * 3);
+                        geometry.positions = positions.data();
+                        geometry.vertexCount = vertexCount;
+                        break;
+                    case cgltf_attribute_type_normal:
+                        normals.resize(vertexCount);
+                        cgltf_accessor_unpack_floats(accessor, &normals[0].x, vertexCount * 3);
+                        geometry.normals = normals.data();
+                        break;
+                    case cgltf_attribute_type_tangent:
+                        tangents.resize(vertexCount);
+                        cgltf_accessor_unpack_floats(accessor, &tangents[0].x, vertexCount * 4);
+                        geometry.tangents = tangents.data();
+                        break;
+                    case cgltf_attribute_type_texcoord: {
+                        if (attribute.index < 0 || attribute.index >= UvMapSize) {
+                            break;
+                        }
+                        UvSet uvset = uvmap[attribute.index];
+                        if (uvset == UNUSED && !geometry.uv0 && getNumUvSets(uvmap) == 0) {
+                            uvset = UV0;
+                        }
+                        if (uvset == UNUSED) {
+                            break;
+                        }
+                        std::vector<float2>& uv = uvs[uvset == UV0 ? 0 : 1];
+                        uv.resize(vertexCount);
+                        cgltf_accessor_unpack_floats(accessor, &uv[0].x, vertexCount * 2);
+                        (uvset == UV0 ? geometry.uv0 : geometry.uv1) = uv.data();
+                        break;
+                    }
+                    case cgltf_attribute_type_color:
+                        if (attribute.index == 0) {
+                            colors.assign(vertexCount, float4(1.0f));
+                            const cgltf_size components = cgltf_num_components(accessor->type);
+                            for (cgltf_size i = 0; i < vertexCount; i++) {
+                                cgltf_accessor_read_float(accessor, i, &colors[i].x, components);
+                            }
+                            geometry.colors = colors.data();
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (!valid || !geometry.positions) {
+                continue;
+            }
+
+            if (prim.indices) {
+                indices.resize(prim.indices->count);
+                for (cgltf_size i = 0; i < indices.size(); i++) {
+                    indices[i] = uint32_t(cgltf_accessor_read_index(prim.indices, i));
+                }
+                geometry.indices = indices.data();
+                geometry.indexCount = indices.size();
+            }
+
+            addRenderablePrimitive(entity, index, geometry);
+            count++;
+        }
+    }
+    return count;
+}
+
+void StaticBatcherImpl::createBatch(PendingPrimitive const* const* first,
+        PendingPrimitive const* const* last) {
+    const BatchKey& key = batchKeys[(*first)->batchKey];
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (auto p = first; p != last; ++p) {
+        vertexCount += (*p)->positions.size();
+        indexCount += (*p)->indices.size();
+    }
+
+    float3* positions = (float3*) malloc(vertexCount * sizeof(float3));
+    short4* tangents = (short4*) malloc(vertexCount * sizeof(short4));
+    float2* uv0 = (key.attributes & HAS_UV0) ? (float2*) malloc(vertexCount * sizeof(float2)) : nullptr;
+    float2* uv1 = (key.attributes & HAS_UV1) ? (float2*) malloc(vertexCount * sizeof(float2)) : nullptr;
+    float4* colors = (key.attributes & HAS_COLORS) ? (float4*) malloc(vertexCount * sizeof(float4)) : nullptr;
+    uint32_t* indices = (uint32_t*) malloc(indexCount * sizeof(uint32_t));
+
+    float3 minimum(std::numeric_limits<float>::max());
+    float3 maximum(std::numeric_limits<float>::lowest());
+    size_t vertexOffset = 0;
+    size_t indexOffset = 0;
+    for (auto p = first; p != last; ++p) {
+        PendingPrimitive const& primitive = **p;
+        const size_t n = primitive.positions.size();
+        std::copy_n(primitive.positions.data(), n, positions + vertexOffset);
+        std::copy_n(primitive.tangents.data(), n, tangents + vertexOffset);
+        if (uv0) std::copy_n(primitive.uv0.data(), n, uv0 + vertexOffset);
+        if (uv1) std::copy_n(primitive.uv1.data(), n, uv1 + vertexOffset);
+        if (colors) std::copy_n(primitive.colors.data(), n, colors + vertexOffset);
+        for (size_t i = 0; i < primitive.indices.size(); i++) {
+            indices[indexOffset + i] = uint32_t(vertexOffset) + primitive.indices[i];
+        }
+        for (float3 const& position : primitive.positions) {
+            minimum = min(minimum, position);
+            maximum = max(maximum, position);
+        }
+        vertexOffset += n;
+        indexOffset += primitive.indices.size();
+    }
+
+    VertexBuffer::Builder vbb;
+    vbb.vertexCount(uint32_t(vertexCount))
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .attribute(VertexAttribute::TANGENTS, 1, VertexBuffer::AttributeType::SHORT4)
+            .normalized(VertexAttribute::TANGENTS);
+    uint8_t bufferCount = 2;
+    if (uv0) {
+        vbb.attribute(VertexAttribute::UV0, bufferCount++, VertexBuffer::AttributeType::FLOAT2);
+    }
+    if (uv1) {
+        vbb.attribute(VertexAttribute::UV1, bufferCount++, VertexBuffer::AttributeType::FLOAT2);
+    }
+    if (colors) {
+        vbb.attribute(VertexAttribute::COLOR, bufferCount++, VertexBuffer::AttributeType::FLOAT4);
+    }
+    VertexBuffer* vb = vbb.bufferCount(bufferCount).build(*engine);
+
+    uint8_t slot = 0;
+    vb->setBufferAt(*engine, slot++, VertexBuffer::BufferDescriptor(
+            positions, vertexCount * sizeof(float3), FREE_CALLBACK));
+    vb->setBufferAt(*engine, slot++, VertexBuffer::BufferDescriptor(
+            tangents, vertexCount * sizeof(short4), FREE_CALLBACK));
+    if (uv0) {
+        vb->setBufferAt(*engine, slot++, VertexBuffer::BufferDescriptor(
+                uv0, vertexCount * sizeof(float2), FREE_CALLBACK));
+    }
+    if (uv1) {
+        vb->setBufferAt(*engine, slot++, VertexBuffer::BufferDescriptor(
+                uv1, vertexCount * sizeof(float2), FREE_CALLBACK));
+    }
+    if (colors) {
+        vb->setBufferAt(*engine, slot++, VertexBuffer::BufferDescriptor(
+                colors, vertexCount * sizeof(float4), FREE_CALLBACK));
+    }
+
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(uint32_t(indexCount))
+            .bufferType(IndexBuffer::IndexType::UINT)
+            .build(*engine);
+    ib->setBuffer(*engine, IndexBuffer::BufferDescriptor(
+            indices, indexCount * sizeof(uint32_t), FREE_CALLBACK));
+
+    Box box;
+    box.set(minimum, maximum);
+
+    Entity entity = EntityManager::get().create();
+    RenderableManager::Builder(1)
+            .boundingBox(box)
+            .material(0, key.materialInstance)
+            .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+            .castShadows(key.castShadows)
+            .receiveShadows(key.receiveShadows)
+            .layerMask(0xff, key.layerMask)
+            .build(*engine, entity);
+
+    entities.push_back(entity);
+    vertexBuffers.push_back(vb);
+    indexBuffers.push_back(ib);
+}
+
+StaticBatcher::StaticBatcher(Engine* engine, const StaticBatcherConfig& config)
+        : mImpl(new StaticBatcherImpl(engine, config)) {
+}
+
+StaticBatcher::~StaticBatcher() {
+    delete mImpl;
+}
+
+void StaticBatcher::addPrimitive(const Geometry& geometry, MaterialInstance* materialInstance,
+        const mat4f& transform, bool castShadows, bool receiveShadows, uint8_t layerMask) {
+    mImpl->addPrimitive(geometry, materialInstance, transform, castShadows, receiveShadows,
+            layerMask);
+}
+
+void StaticBatcher::addRenderablePrimitive(Entity entity, size_t primitiveIndex,
+        const Geometry& geometry) {
+    mImpl->addRenderablePrimitive(entity, primitiveIndex, geometry);
+}
+
+size_t StaticBatcher::addAsset(const FilamentAsset* asset) {
+    return mImpl->addAsset(upcast(asset));
+}
+
+size_t StaticBatcher::build() {
+    auto& primitives = mImpl->primitives;
+
+    // the primitives of a batch have the same key and are in the same cell
+    std::vector<PendingPrimitive const*> sorted(primitives.size());
+    for (size_t i = 0; i < primitives.size(); i++) {
+        sorted[i] = &primitives[i];
+    }
+    auto order = [](PendingPrimitive const* p) {
+        return std::make_tuple(p->batchKey, p->cell.x, p->cell.y, p->cell.z);
+    };
+    std::sort(sorted.begin(), sorted.end(), [&order](auto const* lhs, auto const* rhs) {
+        return order(lhs) < order(rhs);
+    });
+
+    const size_t batchCount = mImpl->entities.size();
+    const uint32_t maxVertexCount = mImpl->config.maxVertexCount;
+    auto first = sorted.data();
+    auto const end = sorted.data() + sorted.size();
+    while (first != end) {
+        // the batch ends with its cell or when it has enough vertices, but always has at least
+        // one primitive
+        size_t vertexCount = (*first)->positions.size();
+        auto last = first + 1;
+        while (last != end && order(*last) == order(*first) &&
+                vertexCount + (*last)->positions.size() <= maxVertexCount) {
+            vertexCount += (*last)->positions.size();
+            ++last;
+        }
+        mImpl->createBatch(first, last);
+        first = last;
+    }
+
+    primitives = {};
+    return mImpl->entities.size() - batchCount;
+}
+
+const Entity* StaticBatcher::getEntities() const noexcept {
+    return mImpl->entities.data();
+}
+
+size_t StaticBatcher::getEntityCount() const noexcept {
+    return mImpl->entities.size();
+}
+
+const Entity* StaticBatcher::getSourceEntities() const noexcept {
+    return mImpl->sourceEntities.data();
+}
+
+size_t StaticBatcher::getSourceEntityCount() const noexcept {
+    return mImpl->sourceEntities.size();
+}
+
+} // namespace gltfio
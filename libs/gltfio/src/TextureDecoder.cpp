@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <gltfio/TextureDecoder.h>
+#include <gltfio/Image.h>
+
+#include <algorithm>
+
+using namespace filament;
+
+namespace gltfio {
+
+namespace {
+
+// Halves the resolution of 8-bit texels with a 2x2 box filter. This works in place: each texel is
+// written before the texels it's computed from, which are never read again.
+void downsample(uint8_t* texels, uint32_t& width, uint32_t& height, uint8_t channels) {
+    const uint32_t dstWidth = std::max(width >> 1u, 1u);
+    const uint32_t dstHeight = std::max(height >> 1u, 1u);
+    const size_t srcStride = size_t(width) * channels;
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        const uint8_t* row0 = texels + std::min(2 * y, height - 1) * srcStride;
+        const uint8_t* row1 = texels + std::min(2 * y + 1, height - 1) * srcStride;
+        uint8_t* dst = texels + size_t(y) * dstWidth * channels;
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            const size_t x0 = size_t(std::min(2 * x, width - 1)) * channels;
+            const size_t x1 = size_t(std::min(2 * x + 1, width - 1)) * channels;
+            for (uint8_t c = 0; c < channels; c++) {
+                const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                *dst++ = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+    width = dstWidth;
+    height = dstHeight;
+}
+
+class StbDecoder : public TextureDecoder {
+public:
+    bool getInfo(const uint8_t* data, size_t size, Info* info) const noexcept override {
+        int width, height, channels;
+        if (!stbi_info_from_memory(data, int(size), &width, &height, &channels)) {
+            return false;
+        }
+        *info = { uint32_t(width), uint32_t(height), uint8_t(channels) };
+        return true;
+    }
+
+    bool decode(const uint8_t* data, size_t size, uint8_t channels, uint8_t lod,
+            Texture::PixelBufferDescriptor* pixels) const noexcept override {
+        int w, h, comp;
+        stbi_uc* texels = stbi_load_from_memory(data, int(size), &w, &h, &comp, channels);
+        if (!texels) {
+            return false;
+        }
+
+        // stb can't decode at a reduced resolution, the smaller image replaces the decoded one.
+        uint32_t width = uint32_t(w);
+        uint32_t height = uint32_t(h);
+        for (uint8_t i = 0; i < lod && (width > 1 || height > 1); i++) {
+            downsample(texels, width, height, channels);
+        }
+
+        *pixels = Texture::PixelBufferDescriptor(texels, size_t(width) * height * channels,
+                getFormat(channels), Texture::Type::UBYTE,
+                [](void* buffer, size_t, void*) { stbi_image_free(buffer); });
+        return true;
+    }
+};
+
+} // anonymous namespace
+
+Texture::Format TextureDecoder::getFormat(uint8_t channels) noexcept {
+    switch (channels) {
+        case 1: return Texture::Format::R;
+        case 2: return Texture::Format::RG;
+        case 3: return Texture::Format::RGB;
+        default: return Texture::Format::RGBA;
+    }
+}
+
+TextureDecoder* TextureDecoder::createStbDecoder() {
+    return new StbDecoder();
+}
+
+} // namespace gltfio
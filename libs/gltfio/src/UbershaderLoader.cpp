@@ -67,17 +67,21 @@ public:
     filament::Engine* mEngine;
 };
 
+// Materials pruned from the archive (see FILAMENT_UBERSHADER_CORPUS) have an empty package, they
+// are replaced by the LIT_OPAQUE material.
+static Material* createMaterial(Engine& engine, const uint8_t* data, size_t size) {
+    return size ? Material::Builder().package(data, size).build(engine) : nullptr;
+}
+
 #if GLTFIO_LITE
 
-#define CREATE_MATERIAL(name) Material::Builder() \
-    .package(GLTFRESOURCES_LITE_ ## name ## _DATA, GLTFRESOURCES_LITE_ ## name ## _SIZE) \
-    .build(*mEngine);
+#define CREATE_MATERIAL(name) createMaterial(*mEngine, \
+    GLTFRESOURCES_LITE_ ## name ## _DATA, GLTFRESOURCES_LITE_ ## name ## _SIZE);
 
 #else
 
-#define CREATE_MATERIAL(name) Material::Builder() \
-    .package(GLTFRESOURCES_ ## name ## _DATA, GLTFRESOURCES_ ## name ## _SIZE) \
-    .build(*mEngine);
+#define CREATE_MATERIAL(name) createMaterial(*mEngine, \
+    GLTFRESOURCES_ ## name ## _DATA, GLTFRESOURCES_ ## name ## _SIZE);
 
 #endif
 
@@ -174,6 +178,9 @@ MaterialInstance* UbershaderLoader::createMaterialInstance(MaterialKey* config,
         config->hasSheen = false;
     }
 
+    // The pre-built materials don't apply the per-instance transforms.
+    config->hasInstanceTransforms = false;
+
     constrainMaterial(config, uvmap);
     auto getUvIndex = [uvmap](uint8_t srcIndex, bool hasTexture) -> int {
         return hasTexture ? int(uvmap->at(srcIndex)) - 1 : -1;
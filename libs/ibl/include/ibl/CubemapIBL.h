@@ -55,6 +55,30 @@ public:
             float linearRoughness, size_t maxNumSamples, math::float3 mirror, bool prefilter,
             Progress updater = nullptr, void* userdata = nullptr);
 
+    //! A roughness LOD computed by roughnessFilter()
+    struct RoughnessLevel {
+        Cubemap* dst;               //!< the destination cubemap
+        float linearRoughness;      //!< roughness
+        size_t maxNumSamples;       //!< number of samples for importance sampling
+    };
+
+    /**
+     * Computes several roughness LODs using prefiltered importance sampling GGX
+     *
+     * All the faces of all the LODs are split in 2D tiles of similar cost (samples x texels),
+     * which are processed by a single job graph. This balances the work much better than
+     * computing the LODs one after the other, whose smallest levels have very few texels.
+     *
+     * @param dst               the LODs to compute
+     * @param count             number of LODs in dst
+     * @param levels            a list of prefiltered lods of the source environment
+     * @param updater           a callback for the caller to track progress, of all the LODs
+     */
+    static void roughnessFilter(
+            utils::JobSystem& js, RoughnessLevel const* dst, size_t count,
+            const std::vector<Cubemap>& levels, math::float3 mirror, bool prefilter,
+            Progress updater = nullptr, void* userdata = nullptr);
+
     //! Computes the "DFG" term of the "split-sum" approximation and stores it in a 2D image
     static void DFG(utils::JobSystem& js, Image& dst, bool multiscatter, bool cloth);
 
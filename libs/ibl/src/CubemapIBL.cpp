@@ -22,12 +22,15 @@
 #include <ibl/utilities.h>
 
 #include "CubemapUtilsImpl.h"
+#include "SampleTable.h"
 
 #include <utils/JobSystem.h>
 
 #include <math/mat3.h>
 #include <math/scalar.h>
 
+#include <algorithm>
+#include <atomic>
 #include <random>
 #include <vector>
 
@@ -292,11 +295,9 @@ static float UTILS_UNUSED VisibilityAshikhmin(float NoV, float NoL, float /*a*/)
  *
  */
 
-void CubemapIBL::roughnessFilter(
-        utils::JobSystem& js, Cubemap& dst, const std::vector<Cubemap>& levels,
-        float linearRoughness, size_t maxNumSamples, math::float3 mirror, bool prefilter,
-        Progress updater, void* userdata)
-{
+// Returns the samples of the GGX filter of 'linearRoughness', see above.
+static SampleTable computeGgxSamples(const std::vector<Cubemap>& levels,
+        float linearRoughness, size_t maxNumSamples, bool prefilter) {
     const float numSamples = maxNumSamples;
     const float inumSamples = 1.0f / numSamples;
     const size_t maxLevel = levels.size()-1;
@@ -304,33 +305,6 @@ void CubemapIBL::roughnessFilter(
     const Cubemap& base(levels[0]);
     const size_t dim0 = base.getDimensions();
     const float omegaP = (4.0f * (float) F_PI) / float(6 * dim0 * dim0);
-    std::atomic_uint progress = {0};
-
-    if (linearRoughness == 0) {
-        auto scanline = [&]
-                (CubemapUtils::EmptyState&, size_t y, Cubemap::Face f, Cubemap::Texel* data, size_t dim) {
-                    if (UTILS_UNLIKELY(updater)) {
-                        size_t p = progress.fetch_add(1, std::memory_order_relaxed) + 1;
-                        updater(0, (float)p / ((float) dim * 6.0f), userdata);
-                    }
-                    const Cubemap& cm = levels[0];
-                    for (size_t x = 0; x < dim; ++x, ++data) {
-                        const float2 p(Cubemap::center(x, y));
-                        const float3 N(dst.getDirectionFor(f, p.x, p.y) * mirror);
-                        // FIXME: we should pick the proper LOD here and do trilinear filtering
-                        Cubemap::writeAt(data, cm.sampleAt(N));
-                    }
-        };
-        // at least 256 pixel cubemap before we use multithreading -- the overhead of launching
-        // jobs is too large compared to the work above.
-        if (dst.getDimensions() <= 256) {
-            CubemapUtils::processSingleThreaded<CubemapUtils::EmptyState>(
-                    dst, js, std::ref(scanline));
-        } else {
-            CubemapUtils::process<CubemapUtils::EmptyState>(dst, js, std::ref(scanline));
-        }
-        return;
-    }
 
     // be careful w/ the size of this structure, the smaller the better
     struct CacheEntry {
@@ -406,53 +380,138 @@ void CubemapIBL::roughnessFilter(
         return lhs.brdf_NoL < rhs.brdf_NoL;
     });
 
+    SampleTable samples;
+    samples.reserve(cache.size());
+    for (auto const& entry : cache) {
+        samples.add(entry.L, entry.brdf_NoL, entry.lerp, entry.l0, entry.l1);
+    }
+    return samples;
+}
 
-    struct State {
-        // maybe blue-noise instead would look even better
-        std::default_random_engine gen;
-        std::uniform_real_distribution<float> distribution{ -F_PI, F_PI };
+void CubemapIBL::roughnessFilter(
+        utils::JobSystem& js, Cubemap& dst, const std::vector<Cubemap>& levels,
+        float linearRoughness, size_t maxNumSamples, math::float3 mirror, bool prefilter,
+        Progress updater, void* userdata)
+{
+    const RoughnessLevel level{ &dst, linearRoughness, maxNumSamples };
+    roughnessFilter(js, &level, 1, levels, mirror, prefilter, updater, userdata);
+}
+
+void CubemapIBL::roughnessFilter(
+        utils::JobSystem& js, RoughnessLevel const* dst, size_t count,
+        const std::vector<Cubemap>& levels, math::float3 mirror, bool prefilter,
+        Progress updater, void* userdata)
+{
+    // Estimated cost of a tile, in samples. This is a few milliseconds of work, which is large
+    // compared to the overhead of a job but small enough to balance the work between threads.
+    constexpr size_t TILE_COST = 1u << 16u;
+
+    struct Tile {
+        uint32_t level;     // index in dst
+        Cubemap::Face face;
+        uint32_t x;
+        uint32_t y;
+        uint32_t size;
+        uint32_t seed;
+        size_t cost;
     };
 
-    auto scanline = [&](State& state, size_t y,
-            Cubemap::Face f, Cubemap::Texel* data, size_t dim) {
-        if (UTILS_UNLIKELY(updater)) {
-            size_t p = progress.fetch_add(1, std::memory_order_relaxed) + 1;
-            updater(0, (float) p / ((float) dim * 6.0f), userdata);
+    std::vector<SampleTable> samples(count);
+    std::vector<Tile> tiles;
+    size_t totalCost = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (dst[i].linearRoughness > 0) {
+            samples[i] = computeGgxSamples(levels, dst[i].linearRoughness,
+                    dst[i].maxNumSamples, prefilter);
+        }
+
+        // a copy of the base level costs about one sample per texel
+        const size_t texelCost = std::max(size_t(1), samples[i].size());
+        const size_t dim = dst[i].dst->getDimensions();
+
+        // the largest power-of-two tile whose cost doesn't exceed TILE_COST
+        size_t size = 1;
+        while (size * 2 <= dim && (size * 2) * (size * 2) * texelCost <= TILE_COST) {
+            size *= 2;
         }
+
+        for (size_t f = 0; f < 6; f++) {
+            for (size_t y = 0; y < dim; y += size) {
+                for (size_t x = 0; x < dim; x += size) {
+                    const size_t w = std::min(size, dim - x);
+                    const size_t h = std::min(size, dim - y);
+                    tiles.push_back({ uint32_t(i), Cubemap::Face(f), uint32_t(x), uint32_t(y),
+                            uint32_t(size), uint32_t(tiles.size()), w * h * texelCost });
+                }
+            }
+        }
+        totalCost += 6 * dim * dim * texelCost;
+    }
+
+    std::atomic<size_t> progress = { 0 };
+
+    auto processTile = [&](Tile const& tile) {
+        Cubemap& cm = *dst[tile.level].dst;
+        SampleTable const& table = samples[tile.level];
+        const bool copy = dst[tile.level].linearRoughness == 0;
+        const size_t dim = cm.getDimensions();
+        const size_t x1 = std::min(dim, size_t(tile.x + tile.size));
+        const size_t y1 = std::min(dim, size_t(tile.y + tile.size));
+        Image& image(cm.getImageForFace(tile.face));
+
+        // maybe blue-noise instead would look even better
+        // the random rotations only depend on the tile, not on the order tiles are processed in
+        std::default_random_engine gen(tile.seed);
+        std::uniform_real_distribution<float> distribution{ -F_PI, F_PI };
+
         mat3 R;
-        const size_t numSamples = cache.size();
-        for (size_t x = 0; x < dim; ++x, ++data) {
-            const float2 p(Cubemap::center(x, y));
-            const float3 N(dst.getDirectionFor(f, p.x, p.y) * mirror);
+        for (size_t y = tile.y; y < y1; y++) {
+            Cubemap::Texel* data = static_cast<Cubemap::Texel*>(image.getPixelRef(tile.x, y));
+            for (size_t x = tile.x; x < x1; ++x, ++data) {
+                const float2 p(Cubemap::center(x, y));
+                const float3 N(cm.getDirectionFor(tile.face, p.x, p.y) * mirror);
+
+                if (copy) {
+                    // FIXME: we should pick the proper LOD here and do trilinear filtering
+                    Cubemap::writeAt(data, levels[0].sampleAt(N));
+                    continue;
+                }
 
-            // center the cone around the normal (handle case of normal close to up)
-            const float3 up = std::abs(N.z) < 0.999 ? float3(0, 0, 1) : float3(1, 0, 0);
-            R[0] = normalize(cross(up, N));
-            R[1] = cross(N, R[0]);
-            R[2] = N;
+                // center the cone around the normal (handle case of normal close to up)
+                const float3 up = std::abs(N.z) < 0.999 ? float3(0, 0, 1) : float3(1, 0, 0);
+                R[0] = normalize(cross(up, N));
+                R[1] = cross(N, R[0]);
+                R[2] = N;
 
-            R *= mat3f::rotation(state.distribution(state.gen), float3{0,0,1});
+                R *= mat3f::rotation(distribution(gen), float3{0,0,1});
 
-            float3 Li = 0;
-            for (size_t sample = 0; sample < numSamples; sample++) {
-                const CacheEntry& e = cache[sample];
-                const float3 L(R * e.L);
-                const Cubemap& cmBase = levels[e.l0];
-                const Cubemap& next = levels[e.l1];
-                const float3 c0 = Cubemap::trilinearFilterAt(cmBase, next, e.lerp, L);
-                Li += c0 * e.brdf_NoL;
+                const float3 Li = table.integrate(levels, mat3f(R));
+                Cubemap::writeAt(data, Cubemap::Texel(Li));
             }
-            Cubemap::writeAt(data, Cubemap::Texel(Li));
+        }
+
+        if (UTILS_UNLIKELY(updater)) {
+            size_t p = progress.fetch_add(tile.cost, std::memory_order_relaxed) + tile.cost;
+            updater(0, (float) p / (float) totalCost, userdata);
         }
     };
 
-    // don't use the jobsystem unless we have enough work per scanline -- or the overhead of
-    // launching jobs will prevail.
-    if (dst.getDimensions() * maxNumSamples <= 256) {
-        CubemapUtils::processSingleThreaded<State>(dst, js, std::ref(scanline));
-    } else {
-        CubemapUtils::process<State>(dst, js, std::ref(scanline));
+    // don't use the jobsystem unless we have enough work -- or the overhead of launching
+    // jobs will prevail.
+    if (tiles.size() <= 1 || totalCost <= TILE_COST) {
+        for (Tile const& tile : tiles) {
+            processTile(tile);
+        }
+        return;
     }
+
+    auto job = jobs::parallel_for(js, nullptr, tiles.data(), uint32_t(tiles.size()),
+            [&processTile](Tile const* tiles, size_t count) {
+                for (size_t i = 0; i < count; i++) {
+                    processTile(tiles[i]);
+                }
+            }, jobs::CountSplitter<1, 10>());
+    js.runAndWait(job);
 }
 
 /*
@@ -589,6 +648,12 @@ void CubemapIBL::diffuseIrradiance(JobSystem& js, Cubemap& dst, const std::vecto
         }
     }
 
+    SampleTable samples;
+    samples.reserve(cache.size());
+    for (auto const& entry : cache) {
+        samples.add(entry.L, 1.0f, entry.lerp, entry.l0, entry.l1);
+    }
+
     CubemapUtils::process<CubemapUtils::EmptyState>(dst, js,
             [&](CubemapUtils::EmptyState&, size_t y,
                     Cubemap::Face f, Cubemap::Texel* data, size_t dim) {
@@ -599,7 +664,6 @@ void CubemapIBL::diffuseIrradiance(JobSystem& js, Cubemap& dst, const std::vecto
         }
 
         mat3 R;
-        const size_t numSamples = cache.size();
         for (size_t x = 0; x < dim; ++x, ++data) {
             const float2 p(Cubemap::center(x, y));
             const float3 N(dst.getDirectionFor(f, p.x, p.y));
@@ -610,15 +674,7 @@ void CubemapIBL::diffuseIrradiance(JobSystem& js, Cubemap& dst, const std::vecto
             R[1] = cross(N, R[0]);
             R[2] = N;
 
-            float3 Li = 0;
-            for (size_t sample = 0; sample < numSamples; sample++) {
-                const CacheEntry& e = cache[sample];
-                const float3 L(R * e.L);
-                const Cubemap& cmBase = levels[e.l0];
-                const Cubemap& next = levels[e.l1];
-                const float3 c0 = Cubemap::trilinearFilterAt(cmBase, next, e.lerp, L);
-                Li += c0;
-            }
+            const float3 Li = samples.integrate(levels, mat3f(R));
             Cubemap::writeAt(data, Cubemap::Texel(Li * inumSamples));
         }
     });
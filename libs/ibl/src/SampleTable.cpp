@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SampleTable.h"
+
+#include <utils/compiler.h>
+
+#include <algorithm>
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <immintrin.h>
+#   define IBL_HAS_SSE 1
+#endif
+
+// vdivq_f32() is only available on AArch64
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define IBL_HAS_NEON 1
+#endif
+
+#ifndef IBL_HAS_SSE
+#   define IBL_HAS_SSE 0
+#endif
+#ifndef IBL_HAS_NEON
+#   define IBL_HAS_NEON 0
+#endif
+
+using namespace filament::math;
+
+namespace filament {
+namespace ibl {
+
+// the samples are processed in groups of this size
+static constexpr size_t GROUP_SIZE = 4;
+
+// Cubemap::Address of 4 directions, as structure of arrays
+struct Addresses {
+    float s[GROUP_SIZE];
+    float t[GROUP_SIZE];
+    int32_t face[GROUP_SIZE];
+};
+
+void SampleTable::reserve(size_t count) {
+    count = (count + GROUP_SIZE - 1) & ~(GROUP_SIZE - 1);
+    mX.reserve(count);
+    mY.reserve(count);
+    mZ.reserve(count);
+    mWeight.reserve(count);
+    mLerp.reserve(count);
+    mL0.reserve(count);
+    mL1.reserve(count);
+}
+
+void SampleTable::add(float3 const& L, float weight, float lerp, uint8_t l0, uint8_t l1) {
+    if (mCount == mX.size()) {
+        // add a group of null weight samples, which are overwritten by the next ones
+        const size_t size = mCount + GROUP_SIZE;
+        mX.resize(size, 0.0f);
+        mY.resize(size, 0.0f);
+        mZ.resize(size, 1.0f);
+        mWeight.resize(size, 0.0f);
+        mLerp.resize(size, 0.0f);
+        mL0.resize(size, 0);
+        mL1.resize(size, 0);
+    }
+    mX[mCount] = L.x;
+    mY[mCount] = L.y;
+    mZ[mCount] = L.z;
+    mWeight[mCount] = weight;
+    mLerp[mCount] = lerp;
+    mL0[mCount] = l0;
+    mL1[mCount] = l1;
+    mCount++;
+}
+
+// Rotates 4 directions by R and computes their address, this is the same as
+// Cubemap::getAddressFor(R * L).
+static void address(mat3f const& R, float const* UTILS_RESTRICT x, float const* UTILS_RESTRICT y,
+        float const* UTILS_RESTRICT z, Addresses& UTILS_RESTRICT out) noexcept {
+#if IBL_HAS_SSE
+    const __m128 lx = _mm_loadu_ps(x);
+    const __m128 ly = _mm_loadu_ps(y);
+    const __m128 lz = _mm_loadu_ps(z);
+    auto row = [&](size_t i) {
+        return _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(R[0][i]), lx),
+                _mm_mul_ps(_mm_set1_ps(R[1][i]), ly)),
+                _mm_mul_ps(_mm_set1_ps(R[2][i]), lz));
+    };
+    const __m128 rx = row(0);
+    const __m128 ry = row(1);
+    const __m128 rz = row(2);
+
+    auto select = [](__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    };
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 ax = _mm_and_ps(rx, absMask);
+    const __m128 ay = _mm_and_ps(ry, absMask);
+    const __m128 az = _mm_and_ps(rz, absMask);
+    const __m128 isX = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+    const __m128 isY = _mm_andnot_ps(isX,
+            _mm_and_ps(_mm_cmpge_ps(ay, ax), _mm_cmpge_ps(ay, az)));
+    const __m128 negX = _mm_cmplt_ps(rx, zero);
+    const __m128 negY = _mm_cmplt_ps(ry, zero);
+    const __m128 negZ = _mm_cmplt_ps(rz, zero);
+    const __m128 nrx = _mm_sub_ps(zero, rx);
+    const __m128 nry = _mm_sub_ps(zero, ry);
+    const __m128 nrz = _mm_sub_ps(zero, rz);
+
+    const __m128 ma = _mm_div_ps(_mm_set1_ps(1.0f), select(isX, ax, select(isY, ay, az)));
+    // PX: (-z, -y)  NX: (z, -y)  PY: (x, z)  NY: (x, -z)  PZ: (x, -y)  NZ: (-x, -y)
+    const __m128 sc = select(isX, select(negX, rz, nrz),
+            select(isY, rx, select(negZ, nrx, rx)));
+    const __m128 tc = select(isY, select(negY, nrz, rz), nry);
+    const __m128 half = _mm_set1_ps(0.5f);
+    _mm_storeu_ps(out.s, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sc, ma), _mm_set1_ps(1.0f)), half));
+    _mm_storeu_ps(out.t, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tc, ma), _mm_set1_ps(1.0f)), half));
+
+    // the masks are -1 when set, the face is 2 * axis + negative
+    const __m128i isXi = _mm_castps_si128(isX);
+    const __m128i isYi = _mm_castps_si128(isY);
+    const __m128i neg = _mm_castps_si128(select(isX, negX, select(isY, negY, negZ)));
+    const __m128i axis = _mm_andnot_si128(isXi, _mm_add_epi32(_mm_set1_epi32(2), isYi));
+    const __m128i face = _mm_sub_epi32(_mm_add_epi32(axis, axis), neg);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out.face), face);
+#elif IBL_HAS_NEON
+    const float32x4_t lx = vld1q_f32(x);
+    const float32x4_t ly = vld1q_f32(y);
+    const float32x4_t lz = vld1q_f32(z);
+    auto row = [&](size_t i) {
+        return vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(lx, R[0][i]), ly, R[1][i]), lz, R[2][i]);
+    };
+    const float32x4_t rx = row(0);
+    const float32x4_t ry = row(1);
+    const float32x4_t rz = row(2);
+
+    const float32x4_t ax = vabsq_f32(rx);
+    const float32x4_t ay = vabsq_f32(ry);
+    const float32x4_t az = vabsq_f32(rz);
+    const uint32x4_t isX = vandq_u32(vcgeq_f32(ax, ay), vcgeq_f32(ax, az));
+    const uint32x4_t isY = vbicq_u32(vandq_u32(vcgeq_f32(ay, ax), vcgeq_f32(ay, az)), isX);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const uint32x4_t negX = vcltq_f32(rx, zero);
+    const uint32x4_t negY = vcltq_f32(ry, zero);
+    const uint32x4_t negZ = vcltq_f32(rz, zero);
+
+    const float32x4_t ma = vdivq_f32(vdupq_n_f32(1.0f),
+            vbslq_f32(isX, ax, vbslq_f32(isY, ay, az)));
+    // PX: (-z, -y)  NX: (z, -y)  PY: (x, z)  NY: (x, -z)  PZ: (x, -y)  NZ: (-x, -y)
+    const float32x4_t sc = vbslq_f32(isX, vbslq_f32(negX, rz, vnegq_f32(rz)),
+            vbslq_f32(isY, rx, vbslq_f32(negZ, vnegq_f32(rx), rx)));
+    const float32x4_t tc = vbslq_f32(isY, vbslq_f32(negY, vnegq_f32(rz), rz), vnegq_f32(ry));
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    vst1q_f32(out.s, vmulq_n_f32(vmlaq_f32(one, sc, ma), 0.5f));
+    vst1q_f32(out.t, vmulq_n_f32(vmlaq_f32(one, tc, ma), 0.5f));
+
+    // the masks are -1 when set, the face is 2 * axis + negative
+    const int32x4_t neg = vreinterpretq_s32_u32(
+            vbslq_u32(isX, negX, vbslq_u32(isY, negY, negZ)));
+    const int32x4_t axis = vreinterpretq_s32_u32(vbicq_u32(
+            vreinterpretq_u32_s32(vaddq_s32(vdupq_n_s32(2), vreinterpretq_s32_u32(isY))), isX));
+    vst1q_s32(out.face, vsubq_s32(vaddq_s32(axis, axis), neg));
+#else
+    for (size_t i = 0; i < GROUP_SIZE; i++) {
+        const Cubemap::Address addr = Cubemap::getAddressFor(R * float3{ x[i], y[i], z[i] });
+        out.s[i] = addr.s;
+        out.t[i] = addr.t;
+        out.face[i] = int32_t(addr.face);
+    }
+#endif
+}
+
+float3 SampleTable::integrate(std::vector<Cubemap> const& levels, mat3f const& R) const noexcept {
+    // same as Cubemap::mUpperBound, the largest texel coordinate of each level
+    float upperBounds[32];
+    const size_t levelCount = std::min(levels.size(), size_t(32));
+    for (size_t i = 0; i < levelCount; i++) {
+        upperBounds[i] = nextafterf(float(levels[i].getDimensions()), 0.0f);
+    }
+
+    float3 Li = 0;
+    Addresses addresses;
+    for (size_t i = 0; i < mCount; i += GROUP_SIZE) {
+        address(R, mX.data() + i, mY.data() + i, mZ.data() + i, addresses);
+
+        // this is Cubemap::trilinearFilterAt() with the addresses computed above
+        const size_t count = std::min(GROUP_SIZE, mCount - i);
+        for (size_t j = 0; j < count; j++) {
+            const size_t k = i + j;
+            const Cubemap::Face face = Cubemap::Face(addresses.face[j]);
+            const Cubemap& l0 = levels[mL0[k]];
+            const Cubemap& l1 = levels[mL1[k]];
+            const float d0 = float(l0.getDimensions());
+            const float d1 = float(l1.getDimensions());
+            const float x0 = std::min(addresses.s[j] * d0, upperBounds[mL0[k]]);
+            const float y0 = std::min(addresses.t[j] * d0, upperBounds[mL0[k]]);
+            const float x1 = std::min(addresses.s[j] * d1, upperBounds[mL1[k]]);
+            const float y1 = std::min(addresses.t[j] * d1, upperBounds[mL1[k]]);
+            float3 c0 = Cubemap::filterAt(l0.getImageForFace(face), x0, y0);
+            c0 += mLerp[k] * (Cubemap::filterAt(l1.getImageForFace(face), x1, y1) - c0);
+            Li += c0 * mWeight[k];
+        }
+    }
+    return Li;
+}
+
+} // namespace ibl
+} // namespace filament
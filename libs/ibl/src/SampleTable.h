@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IBL_SAMPLETABLE_H
+#define IBL_SAMPLETABLE_H
+
+#include <ibl/Cubemap.h>
+
+#include <math/mat3.h>
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace ibl {
+
+/*
+ * The samples of a filter kernel in tangent space (i.e. around [0 0 1]), with their weight and
+ * the levels of the cubemap they're fetched from. They only depend on the kernel, so they're
+ * computed once and shared by all the texels filtered.
+ *
+ * The samples are stored as a structure of arrays, padded with null weight samples, so that
+ * their direction and cubemap address are computed 4 at a time with SSE or NEON.
+ */
+class SampleTable {
+public:
+    void reserve(size_t count);
+
+    void add(filament::math::float3 const& L, float weight, float lerp, uint8_t l0, uint8_t l1);
+
+    size_t size() const noexcept { return mCount; }
+
+    // Returns the sum of the weighted samples rotated by R, fetched from 'levels' with
+    // trilinear filtering.
+    filament::math::float3 integrate(std::vector<Cubemap> const& levels,
+            filament::math::mat3f const& R) const noexcept;
+
+private:
+    size_t mCount = 0;
+    std::vector<float> mX;
+    std::vector<float> mY;
+    std::vector<float> mZ;
+    std::vector<float> mWeight;
+    std::vector<float> mLerp;
+    std::vector<uint8_t> mL0;
+    std::vector<uint8_t> mL1;
+};
+
+} // namespace ibl
+} // namespace filament
+
+#endif // IBL_SAMPLETABLE_H
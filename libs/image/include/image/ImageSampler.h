@@ -19,6 +19,10 @@
 
 #include <image/LinearImage.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace image {
 
 /**
@@ -100,15 +104,19 @@ struct ImageSampler {
 
 /**
  * Resizes or blurs the given linear image, producing a new linear image with the given dimensions.
+ *
+ * The image is resampled horizontally then vertically, with precomputed filter weights. If a job
+ * system is given, the rows of each pass are processed by several jobs. The calling thread must
+ * have been adopted by the job system.
  */
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        const ImageSampler& sampler);
+        const ImageSampler& sampler, utils::JobSystem* js = nullptr);
 
 /**
  * Resizes the given linear image using a simplified API that takes target dimensions and filter.
  */
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        Filter filter = Filter::DEFAULT);
+        Filter filter = Filter::DEFAULT, utils::JobSystem* js = nullptr);
 
 /**
  * Computes a single sample for the given texture coordinate and writes the resulting color
@@ -135,9 +143,10 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
  *
  * Source image need not be power-of-two. In the result vector, the half-size image is returned at
  * index 0, the quarter-size image is at index 1, etc. Please note that the original-sized image is
- * not included.
+ * not included. If a job system is given, it is used to resample the levels, see resampleImage.
  */
-void generateMipmaps(const LinearImage& source, Filter, LinearImage* result, uint32_t mipCount);
+void generateMipmaps(const LinearImage& source, Filter, LinearImage* result, uint32_t mipCount,
+        utils::JobSystem* js = nullptr);
 
 /**
  * Returns the number of miplevels it would take to downsample the given image down to 1x1. This
@@ -223,6 +223,9 @@ public:
     static constexpr uint32_t RGBA_S3TC_DXT3 = 0x83F2;
     static constexpr uint32_t RGBA_S3TC_DXT5 = 0x83F3;
 
+    static constexpr uint32_t RGB_BPTC_SIGNED_FLOAT = 0x8E8E;
+    static constexpr uint32_t RGB_BPTC_UNSIGNED_FLOAT = 0x8E8F;
+
     static constexpr uint32_t RGBA_ASTC_4x4 = 0x93B0;
     static constexpr uint32_t RGBA_ASTC_5x4 = 0x93B1;
     static constexpr uint32_t RGBA_ASTC_5x5 = 0x93B2;
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGE_KTXREADER_H
+#define IMAGE_KTXREADER_H
+
+#include <image/KtxBundle.h>
+
+#include <math/vec3.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace image {
+
+/**
+ * KtxReader gives read-only access to the miplevels of a KTX file without copying them.
+ *
+ * Unlike KtxBundle, which deserializes the whole file into its own storage, KtxReader only parses
+ * the header and the key/value metadata; the miplevels are returned as pointers into the file,
+ * which is memory-mapped (or read into memory on platforms without mmap). This is well suited
+ * for passing large cubemaps and lightmaps straight to the GPU, see ktx::createTexture().
+ *
+ * The data of a miplevel is contiguous: its faces and array elements follow each other and all
+ * have the same size.
+ */
+class KtxReader {
+public:
+
+    /**
+     * Maps the KTX file at the given path. Returns null if the file can't be opened or if it's not
+     * a valid KTX file.
+     */
+    static KtxReader* open(const char* path);
+
+    ~KtxReader();
+
+    KtxReader(KtxReader const&) = delete;
+    KtxReader& operator=(KtxReader const&) = delete;
+
+    KtxInfo const& getInfo() const { return mInfo; }
+
+    /**
+     * Gets the value of the given key/value metadata, or null if there is none. Values are binary
+     * strings that need not be null-terminated.
+     */
+    const char* getMetadata(const char* key, size_t* valueSize = nullptr) const;
+
+    /**
+     * Parses the key="sh" metadata and returns 3 bands of data, see KtxBundle.
+     */
+    bool getSphericalHarmonics(filament::math::float3* result) const;
+
+    uint32_t getNumMipLevels() const { return mNumMipLevels; }
+    uint32_t getArrayLength() const { return mArrayLength; }
+    bool isCubemap() const { return mNumCubeFaces > 1; }
+
+    /**
+     * Retrieves the data of all the faces and array elements of the given miplevel, and the size
+     * of each of them. The data is valid for the lifetime of the reader. Returns false if the
+     * level is out of bounds.
+     */
+    bool getLevel(uint32_t level, uint8_t const** data, uint32_t* faceSize) const;
+
+private:
+    using Unmapper = void(*)(void* data, size_t size);
+
+    KtxReader(uint8_t* data, size_t size, Unmapper unmapper);
+    bool parse();
+
+    static constexpr uint32_t MAX_LEVELS = 32;
+
+    uint8_t* mData;
+    size_t mSize;
+    Unmapper mUnmapper;
+
+    KtxInfo mInfo = {};
+    uint32_t mNumMipLevels = 0;
+    uint32_t mArrayLength = 0;
+    uint32_t mNumCubeFaces = 0;
+    uint8_t const* mMetadata = nullptr;
+    uint32_t mMetadataSize = 0;
+    uint32_t mLevelOffsets[MAX_LEVELS] = {};
+    uint32_t mFaceSizes[MAX_LEVELS] = {};
+};
+
+} // namespace image
+
+#endif /* IMAGE_KTXREADER_H */
@@ -21,6 +21,7 @@
 #include <filament/Texture.h>
 
 #include <image/KtxBundle.h>
+#include <image/KtxReader.h>
 
 namespace image {
 
@@ -156,6 +157,105 @@ namespace ktx {
         return createTexture(engine, *ktx, srgb, freeKtx, ktx);
     }
 
+    /**
+     * Creates a Texture object from a memory-mapped KTX file and populates all of its faces and
+     * miplevels.
+     *
+     * The miplevels are uploaded from the lowest resolution to the highest, straight from the
+     * mapping of the file: no copy of the data is made on the CPU. The reader must stay alive
+     * until the callback is called.
+     *
+     * @param engine Used to create the Filament Texture
+     * @param ktx Memory-mapped KTX file
+     * @param srgb Forces the KTX-specified format into an SRGB format if possible
+     * @param callback Gets called after all texture data has been uploaded to the GPU
+     * @param userdata Passed into the callback
+     */
+    inline Texture* createTexture(Engine* engine, const KtxReader& ktx, bool srgb,
+            Callback callback, void* userdata) {
+        using Sampler = Texture::Sampler;
+        const auto& ktxinfo = ktx.getInfo();
+        const uint32_t nmips = ktx.getNumMipLevels();
+        const uint32_t nfaces = ktx.isCubemap() ? 6 : 1;
+
+        auto texformat = toTextureFormat(ktxinfo);
+        if (srgb) {
+            if (texformat == Texture::InternalFormat::RGB8) {
+                texformat = Texture::InternalFormat::SRGB8;
+            }
+            if (texformat == Texture::InternalFormat::RGBA8) {
+                texformat = Texture::InternalFormat::SRGB8_A8;
+            }
+        }
+
+        Texture* texture = Texture::Builder()
+            .width(ktxinfo.pixelWidth)
+            .height(ktxinfo.pixelHeight)
+            .levels(static_cast<uint8_t>(nmips))
+            .sampler(ktx.isCubemap() ? Sampler::SAMPLER_CUBEMAP : Sampler::SAMPLER_2D)
+            .format(texformat)
+            .build(*engine);
+
+        struct Userdata {
+            uint32_t remainingBuffers;
+            Callback callback;
+            void* userdata;
+        };
+
+        Userdata* cbuser = new Userdata({nmips, callback, userdata});
+
+        PixelBufferDescriptor::Callback cb = [](void*, size_t, void* cbuserptr) {
+            Userdata* cbuser = (Userdata*) cbuserptr;
+            if (--cbuser->remainingBuffers == 0) {
+                if (cbuser->callback) {
+                    cbuser->callback(cbuser->userdata);
+                }
+                delete cbuser;
+            }
+        };
+
+        // the descriptors don't own the data, they point into the mapping
+        auto descriptor = [&](uint8_t const* data, uint32_t size) {
+            void* buffer = const_cast<uint8_t*>(data);
+            if (isCompressed(ktxinfo)) {
+                return PixelBufferDescriptor(buffer, size * nfaces,
+                        toCompressedPixelDataType(ktxinfo), size, cb, cbuser);
+            }
+            return PixelBufferDescriptor(buffer, size * nfaces,
+                    toPixelDataFormat(ktxinfo), toPixelDataType(ktxinfo), cb, cbuser);
+        };
+
+        for (uint32_t level = nmips; level-- > 0;) {
+            uint8_t const* data;
+            uint32_t size;
+            ktx.getLevel(level, &data, &size);
+            if (ktx.isCubemap()) {
+                texture->setImage(*engine, level, descriptor(data, size),
+                        Texture::FaceOffsets(size));
+            } else {
+                texture->setImage(*engine, level, descriptor(data, size));
+            }
+        }
+        return texture;
+    }
+
+    /**
+     * Creates a Texture object from a memory-mapped KTX file, populates all of its faces and
+     * miplevels, and automatically destroys the reader (which unmaps the file) after all the
+     * texture data has been uploaded.
+     *
+     * @param engine Used to create the Filament Texture
+     * @param ktx Memory-mapped KTX file, see KtxReader::open()
+     * @param srgb Forces the KTX-specified format into an SRGB format if possible
+     */
+    inline Texture* createTexture(Engine* engine, KtxReader* ktx, bool srgb) {
+        auto freeKtx = [] (void* userdata) {
+            KtxReader* ktx = (KtxReader*) userdata;
+            delete ktx;
+        };
+        return createTexture(engine, *ktx, srgb, freeKtx, ktx);
+    }
+
     template<typename T>
     T toCompressedFilamentEnum(uint32_t format) {
         switch (format) {
@@ -163,6 +263,8 @@ namespace ktx {
             case KtxBundle::RGBA_S3TC_DXT1: return T::DXT1_RGBA;
             case KtxBundle::RGBA_S3TC_DXT3: return T::DXT3_RGBA;
             case KtxBundle::RGBA_S3TC_DXT5: return T::DXT5_RGBA;
+            case KtxBundle::RGB_BPTC_SIGNED_FLOAT: return T::RGB_BPTC_SIGNED_FLOAT;
+            case KtxBundle::RGB_BPTC_UNSIGNED_FLOAT: return T::RGB_BPTC_UNSIGNED_FLOAT;
             case KtxBundle::RGBA_ASTC_4x4: return T::RGBA_ASTC_4x4;
             case KtxBundle::RGBA_ASTC_5x4: return T::RGBA_ASTC_5x4;
             case KtxBundle::RGBA_ASTC_5x5: return T::RGBA_ASTC_5x5;
@@ -21,13 +21,24 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
-#include <utils/Panic.h>
+#include <utils/compiler.h>
 #include <utils/CString.h>
+#include <utils/JobSystem.h>
+#include <utils/Panic.h>
 
+#include <limits>
 #include <memory>
 #include <vector>
 #include <unordered_map>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   include <immintrin.h>
+#   define IMAGE_HAS_SSE 1
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define IMAGE_HAS_NEON 1
+#endif
+
 using namespace image;
 
 namespace {
@@ -132,7 +143,7 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
     // the [0,1] domain. If this were a huge number, the filtered results would look the same, but
     // the filter would perform very poorly because it would be iterating over a lot more samples
     // than necessary.
-    const float filterBounds = domainScale * std::abs(filter.boundingRadius);
+    const float filterBounds = std::abs(filter.boundingRadius) / domainScale;
 
     // Iterate through target samples. "xtarget" points to the center of each target pixel.
     float xtarget = dtarget / 2.0f;
@@ -143,9 +154,13 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
         uint32_t count = 0;
         float sum = 0;
 
-        // Iterate through source samples that lie within the bounded region.
-        const auto isource_lower = int32_t((xtarget - filterBounds) * nsource);
-        const auto isource_upper = int32_t(std::ceil((xtarget + filterBounds) * nsource));
+        // Iterate through source samples that lie within the bounded region, with a margin of one
+        // sample on each side for the samples on the boundary.
+        const float xlower = left + (xtarget - filterBounds) * (right - left);
+        const float xupper = left + (xtarget + filterBounds) * (right - left);
+        const int32_t margin = filterBounds > 0 ? 1 : 0;
+        const auto isource_lower = int32_t(std::floor(xlower * nsource)) - margin;
+        const auto isource_upper = int32_t(std::ceil(xupper * nsource)) + margin;
         for (int32_t isource = isource_lower; isource <= isource_upper; ++isource) {
             const float xsource = (((isource + 0.5f) / nsource) - left) / (right - left);
             const bool outside_image = isource < 0 || isource >= int32_t(nsource);
@@ -172,22 +187,155 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
     }
 }
 
-// Transforms a MAD program intended for single-channel data into a program intended for
-// multi-channel data.
-void expandMadProgram(uint32_t nchannels, MadProgram* program) {
-    if (nchannels == 1) {
+// The weights of a MAD program as a table. The target sample i is the sum of the source samples
+// [spans[i].first, spans[i].first + spans[i].count) multiplied by the weights starting at
+// spans[i].offset. The source samples of a span are contiguous (the samples skipped by the MAD
+// program get a null weight), so that the resampling passes read contiguous memory.
+struct FilterSpan {
+    uint32_t first;
+    uint32_t count;
+    uint32_t offset;
+};
+
+struct FilterTable {
+    std::vector<FilterSpan> spans;
+    std::vector<float> weights;
+};
+
+// Converts a MAD program of single-channel data into a table. The MAD instructions are sorted by
+// target index, then by source index. External source samples are never generated because all
+// of our filter functions reject them.
+void compileFilterTable(const MadProgram& program, uint32_t ntarget, FilterTable* result) {
+    result->spans.assign(ntarget, FilterSpan{});
+    result->weights.clear();
+    auto mad = program.begin();
+    for (uint32_t itarget = 0; itarget < ntarget; ++itarget) {
+        FilterSpan& span = result->spans[itarget];
+        span.offset = uint32_t(result->weights.size());
+        if (mad == program.end() || mad->targetIndex != itarget) {
+            continue;
+        }
+        span.first = uint32_t(mad->sourceIndex);
+        for (; mad != program.end() && mad->targetIndex == itarget; ++mad) {
+            result->weights.resize(span.offset + mad->sourceIndex - span.first, 0.0f);
+            result->weights.push_back(mad->weight);
+            span.count = uint32_t(result->weights.size()) - span.offset;
+        }
+    }
+}
+
+void generateFilterTable(uint32_t ntarget, uint32_t nsource, float left, float right,
+        FilterFunction filter, float radiusMultiplier, FilterTable* result) {
+    MadProgram program;
+    generateMadProgram(ntarget, nsource, left, right, filter, radiusMultiplier, &program);
+    compileFilterTable(program, ntarget, result);
+}
+
+// Calls fn(begin, end) over ranges of [0, count), using the job system if there's one.
+template<typename F>
+void parallelRows(utils::JobSystem* js, uint32_t count, const F& fn) {
+    using namespace utils;
+    constexpr uint32_t ROWS_PER_JOB = 16;
+    if (!js || count < ROWS_PER_JOB * 2) {
+        fn(0, count);
         return;
     }
-    MadProgram result;
-    result.reserve(program->size() * nchannels);
-    for (auto mad : *program) {
-        mad.sourceIndex *= nchannels;
-        mad.targetIndex *= nchannels;
-        for (uint32_t j = 0; j < nchannels; ++j, ++mad.sourceIndex, ++mad.targetIndex) {
-            result.push_back(mad);
+    JobSystem::Job* job = jobs::parallel_for(*js, nullptr, 0, count,
+            [&fn](uint32_t start, uint32_t n) { fn(start, start + n); },
+            jobs::CountSplitter<ROWS_PER_JOB, 8>());
+    js->runAndWait(job);
+}
+
+// Applies the table to a row of "N" channel samples (or "nchan" channels if N is 0).
+template<uint32_t N>
+void filterRow(float const* UTILS_RESTRICT source, float* UTILS_RESTRICT target,
+        const FilterTable& table, uint32_t nchan) {
+    const uint32_t n = N ? N : nchan;
+    float const* const weights = table.weights.data();
+    for (const FilterSpan& span : table.spans) {
+        float const* src = source + span.first * n;
+        float const* w = weights + span.offset;
+        if (N == 4) {
+#if defined(IMAGE_HAS_SSE)
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t k = 0; k < span.count; ++k, src += 4) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(w[k])));
+            }
+            _mm_storeu_ps(target, sum);
+            target += 4;
+            continue;
+#elif defined(IMAGE_HAS_NEON)
+            float32x4_t sum = vdupq_n_f32(0.0f);
+            for (uint32_t k = 0; k < span.count; ++k, src += 4) {
+                sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(src), w[k]));
+            }
+            vst1q_f32(target, sum);
+            target += 4;
+            continue;
+#endif
+        }
+        for (uint32_t c = 0; c < n; ++c) {
+            float sum = 0;
+            for (uint32_t k = 0; k < span.count; ++k) {
+                sum += src[k * n + c] * w[k];
+            }
+            target[c] = sum;
+        }
+        target += n;
+    }
+}
+
+// Applies the table to the columns of a block of rows, the source rows of a target row are
+// accumulated one after the other, this vectorizes well.
+void filterColumns(const LinearImage& source, LinearImage& result, const FilterTable& table,
+        uint32_t begin, uint32_t end) {
+    const uint32_t rowSize = source.getWidth() * source.getChannels();
+    float const* const weights = table.weights.data();
+    for (uint32_t row = begin; row < end; ++row) {
+        const FilterSpan& span = table.spans[row];
+        float* UTILS_RESTRICT target = result.getPixelRef(0, row);
+        for (uint32_t k = 0; k < span.count; ++k) {
+            float const* UTILS_RESTRICT src = source.getPixelRef(0, span.first + k);
+            const float w = weights[span.offset + k];
+            for (uint32_t i = 0; i < rowSize; ++i) {
+                target[i] += src[i] * w;
+            }
+        }
+    }
+}
+
+// The MIN filter is special because it starts with non-zero values and ignores filter weights.
+void minimumRow(float const* source, float* target, const FilterTable& table, uint32_t nchan) {
+    for (const FilterSpan& span : table.spans) {
+        for (uint32_t c = 0; c < nchan; ++c) {
+            float value = std::numeric_limits<float>::max();
+            for (uint32_t k = 0; k < span.count; ++k) {
+                if (table.weights[span.offset + k] != 0) {
+                    value = std::min(source[(span.first + k) * nchan + c], value);
+                }
+            }
+            target[c] = value;
+        }
+        target += nchan;
+    }
+}
+
+void minimumColumns(const LinearImage& source, LinearImage& result, const FilterTable& table,
+        uint32_t begin, uint32_t end) {
+    const uint32_t rowSize = source.getWidth() * source.getChannels();
+    for (uint32_t row = begin; row < end; ++row) {
+        const FilterSpan& span = table.spans[row];
+        float* target = result.getPixelRef(0, row);
+        std::fill(target, target + rowSize, std::numeric_limits<float>::max());
+        for (uint32_t k = 0; k < span.count; ++k) {
+            if (table.weights[span.offset + k] != 0) {
+                float const* src = source.getPixelRef(0, span.first + k);
+                for (uint32_t i = 0; i < rowSize; ++i) {
+                    target[i] = std::min(src[i], target[i]);
+                }
+            }
         }
     }
-    program->swap(result);
 }
 
 FilterFunction createFilterFunction(Filter ftype) {
@@ -226,50 +374,71 @@ void normalize(LinearImage& image) {
     }
 }
 
-LinearImage resampleImage1D(const LinearImage& source, MadProgram* program,
-        uint32_t twidth, Filter filter, float left, float right, float filterRadiusMultiplier) {
+Filter resolveFilter(Filter filter, uint32_t ntarget, uint32_t nsource) {
+    if (filter == Filter::DEFAULT) {
+        return ntarget > nsource ? Filter::MITCHELL : Filter::LANCZOS;
+    }
+    return filter;
+}
+
+// Resizes the image horizontally.
+LinearImage resampleRows(const LinearImage& source, uint32_t twidth, Filter filter,
+        float left, float right, float filterRadiusMultiplier, utils::JobSystem* js) {
     const uint32_t swidth = source.getWidth();
     const uint32_t sheight = source.getHeight();
     const uint32_t nchan = source.getChannels();
-    const bool mag = twidth > swidth;
-    if (filter == Filter::DEFAULT) filter = mag ? Filter::MITCHELL : Filter::LANCZOS;
-    const FilterFunction hfn = createFilterFunction(filter);
+    filter = resolveFilter(filter, twidth, swidth);
 
-    // Generate a flat list of multiply-add (MAD) instructions.
-    program->clear();
-    generateMadProgram(twidth, swidth, left, right, hfn, filterRadiusMultiplier, program);
-    expandMadProgram(nchan, program);
+    FilterTable table;
+    generateFilterTable(twidth, swidth, left, right, createFilterFunction(filter),
+            filterRadiusMultiplier, &table);
 
-    // Allocate the target image.
     LinearImage result(twidth, sheight, nchan);
-    float const* sourceRow = source.getPixelRef();
-    float* targetRow = result.getPixelRef();
-
-    // The MIN filter is special because it starts with non-zero values and ignores filter weights.
-    if (filter == Filter::MINIMUM) {
-        for (uint32_t n = 0; n < twidth * sheight * nchan; ++n) {
-            targetRow[n] = std::numeric_limits<float>::max();
-        }
-        for (uint32_t row = 0; row < sheight; ++row) {
-            for (auto mad : *program) {
-                const float a = sourceRow[mad.sourceIndex];
-                const float b = targetRow[mad.targetIndex];
-                targetRow[mad.targetIndex] = std::min(a, b);
+    parallelRows(js, sheight, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; ++row) {
+            float const* src = source.getPixelRef(0, row);
+            float* dst = result.getPixelRef(0, row);
+            if (filter == Filter::MINIMUM) {
+                minimumRow(src, dst, table, nchan);
+            } else if (nchan == 4) {
+                filterRow<4>(src, dst, table, nchan);
+            } else if (nchan == 3) {
+                filterRow<3>(src, dst, table, nchan);
+            } else if (nchan == 1) {
+                filterRow<1>(src, dst, table, nchan);
+            } else {
+                filterRow<0>(src, dst, table, nchan);
             }
-            targetRow += twidth * nchan;
-            sourceRow += swidth * nchan;
         }
-        return result;
+    });
+
+    // Perform post processing for the current pass.
+    if (filter == Filter::GAUSSIAN_NORMALS) {
+        normalize(result);
     }
+    return result;
+}
 
-    // Resize the image horizontally by executing the MAD instructions over each row.
-    for (uint32_t row = 0; row < sheight; ++row) {
-        for (auto mad : *program) {
-            targetRow[mad.targetIndex] += sourceRow[mad.sourceIndex] * mad.weight;
+// Resizes the image vertically.
+LinearImage resampleColumns(const LinearImage& source, uint32_t theight, Filter filter,
+        float top, float bottom, float filterRadiusMultiplier, utils::JobSystem* js) {
+    const uint32_t swidth = source.getWidth();
+    const uint32_t sheight = source.getHeight();
+    const uint32_t nchan = source.getChannels();
+    filter = resolveFilter(filter, theight, sheight);
+
+    FilterTable table;
+    generateFilterTable(theight, sheight, top, bottom, createFilterFunction(filter),
+            filterRadiusMultiplier, &table);
+
+    LinearImage result(swidth, theight, nchan);
+    parallelRows(js, theight, [&](uint32_t begin, uint32_t end) {
+        if (filter == Filter::MINIMUM) {
+            minimumColumns(source, result, table, begin, end);
+        } else {
+            filterColumns(source, result, table, begin, end);
         }
-        targetRow += twidth * nchan;
-        sourceRow += swidth * nchan;
-    }
+    });
 
     // Perform post processing for the current pass.
     if (filter == Filter::GAUSSIAN_NORMALS) {
@@ -287,7 +456,7 @@ SingleSample::~SingleSample() {
 }
 
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        const ImageSampler& sampler) {
+        const ImageSampler& sampler, utils::JobSystem* js) {
     ASSERT_PRECONDITION(
         sampler.east.mode == Boundary::EXCLUDE &&
         sampler.north.mode == Boundary::EXCLUDE &&
@@ -300,19 +469,16 @@ LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t he
     const float top = sampler.sourceRegion.top;
     const float right = sampler.sourceRegion.right;
     const float bottom = sampler.sourceRegion.bottom;
-    MadProgram program;
-    LinearImage result;
-    result = transpose(resampleImage1D(source, &program, width, hfilter, left, right, radius));
-    result = transpose(resampleImage1D(result, &program, height, vfilter, top, bottom, radius));
-    return result;
+    LinearImage result = resampleRows(source, width, hfilter, left, right, radius, js);
+    return resampleColumns(result, height, vfilter, top, bottom, radius, js);
 }
 
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        Filter filter) {
+        Filter filter, utils::JobSystem* js) {
     return resampleImage(source, width, height, ImageSampler {
         .horizontalFilter = filter,
         .verticalFilter = filter
-    });
+    }, js);
 }
 
 void computeSingleSample(const LinearImage& source, float x, float y, SingleSample* result,
@@ -322,9 +488,8 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
     const float top = y - radius / source.getHeight();
     const float right = x + radius / source.getWidth();
     const float bottom = y + radius / source.getHeight();
-    MadProgram program;
-    LinearImage row = transpose(resampleImage1D(source, &program, 1, filter, left, right, radius));
-    row = resampleImage1D(row, &program, 1, filter, top, bottom, radius);
+    LinearImage row = resampleRows(source, 1, filter, left, right, radius, nullptr);
+    row = resampleColumns(row, 1, filter, top, bottom, radius, nullptr);
     if (!result->data) {
         result->data = new float[source.getChannels()];
     }
@@ -337,14 +502,15 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
 
 // Unlike traditional mipmap generation, our implementation generates all levels from the original
 // image, under the premise that this produces a higher quality result.
-void generateMipmaps(const LinearImage& source, Filter filter, LinearImage* result, uint32_t mips) {
+void generateMipmaps(const LinearImage& source, Filter filter, LinearImage* result, uint32_t mips,
+        utils::JobSystem* js) {
     mips = std::min(mips, getMipmapCount(source));
     uint32_t width = source.getWidth();
     uint32_t height = source.getHeight();
     for (uint32_t n = 0; n < mips; ++n) {
         width = std::max(width >> 1u, 1u);
         height = std::max(height >> 1u, 1u);
-        result[n] = resampleImage(source, width, height, filter);
+        result[n] = resampleImage(source, width, height, filter, js);
     }
 }
 
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <image/KtxReader.h>
+
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32) || defined(__EMSCRIPTEN__)
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace utils;
+
+namespace {
+
+// same as the header parsed by KtxBundle
+struct SerializationHeader {
+    uint8_t magic[12];
+    image::KtxInfo info;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+static_assert(sizeof(SerializationHeader) == 16 * 4, "Unexpected header size.");
+
+const uint8_t MAGIC[] = {0xab, 0x4b, 0x54, 0x58, 0x20, 0x31, 0x31, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a};
+
+inline uint32_t readUint32(uint8_t const* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+} // anonymous namespace
+
+namespace image {
+
+#if defined(WIN32) || defined(__EMSCRIPTEN__)
+
+KtxReader* KtxReader::open(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return nullptr;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void* data = size > 0 ? malloc(size_t(size)) : nullptr;
+    const bool ok = data && fread(data, 1, size_t(size), file) == size_t(size);
+    fclose(file);
+    if (!ok) {
+        free(data);
+        slog.e << "Unable to read " << path << io::endl;
+        return nullptr;
+    }
+    KtxReader* reader = new KtxReader((uint8_t*) data, size_t(size),
+            [](void* data, size_t) { free(data); });
+    if (!reader->parse()) {
+        slog.e << path << " is not a valid KTX file" << io::endl;
+        delete reader;
+        return nullptr;
+    }
+    return reader;
+}
+
+#else
+
+KtxReader* KtxReader::open(const char* path) {
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st = {};
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid after the file is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        slog.e << "Unable to map " << path << io::endl;
+        return nullptr;
+    }
+    KtxReader* reader = new KtxReader((uint8_t*) data, size_t(st.st_size),
+            [](void* data, size_t size) { munmap(data, size); });
+    if (!reader->parse()) {
+        slog.e << path << " is not a valid KTX file" << io::endl;
+        delete reader;
+        return nullptr;
+    }
+    return reader;
+}
+
+#endif
+
+KtxReader::KtxReader(uint8_t* data, size_t size, Unmapper unmapper)
+        : mData(data), mSize(size), mUnmapper(unmapper) {
+}
+
+KtxReader::~KtxReader() {
+    mUnmapper(mData, mSize);
+}
+
+bool KtxReader::parse() {
+    // The file comes from the outside, so unlike KtxBundle every size is checked against the
+    // size of the mapping.
+    if (mSize < sizeof(SerializationHeader)) {
+        return false;
+    }
+    SerializationHeader header;
+    memcpy(&header, mData, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    mInfo = header.info;
+
+    // 0 mipmaps or array elements are replaced with 1, as in KtxBundle
+    mNumMipLevels = header.numberOfMipmapLevels ? header.numberOfMipmapLevels : 1;
+    mArrayLength = header.numberOfArrayElements ? header.numberOfArrayElements : 1;
+    mNumCubeFaces = header.numberOfFaces ? header.numberOfFaces : 1;
+    if (mNumMipLevels > MAX_LEVELS || (mNumCubeFaces != 1 && mNumCubeFaces != 6)) {
+        return false;
+    }
+
+    size_t offset = sizeof(SerializationHeader);
+    if (header.bytesOfKeyValueData > mSize - offset) {
+        return false;
+    }
+    mMetadata = mData + offset;
+    mMetadataSize = header.bytesOfKeyValueData;
+    offset += header.bytesOfKeyValueData;
+
+    // One aspect of the KTX spec is that the semantics differ for non-array cubemaps.
+    const bool isNonArrayCube = mNumCubeFaces > 1 && mArrayLength == 1;
+    const uint64_t facesPerMip = uint64_t(mArrayLength) * mNumCubeFaces;
+
+    // The cube and mip paddings are always 0, see KtxBundle.
+    for (uint32_t level = 0; level < mNumMipLevels; ++level) {
+        if (sizeof(uint32_t) > mSize - offset) {
+            return false;
+        }
+        const uint32_t imageSize = readUint32(mData + offset);
+        offset += sizeof(uint32_t);
+        const uint64_t faceSize = isNonArrayCube ? imageSize : (imageSize / facesPerMip);
+        if (faceSize * facesPerMip > mSize - offset) {
+            return false;
+        }
+        mLevelOffsets[level] = uint32_t(offset);
+        mFaceSizes[level] = uint32_t(faceSize);
+        offset += size_t(faceSize * facesPerMip);
+    }
+    return true;
+}
+
+const char* KtxReader::getMetadata(const char* key, size_t* valueSize) const {
+    const size_t keySize = strlen(key) + 1;
+    uint32_t offset = 0;
+    while (mMetadataSize - offset >= sizeof(uint32_t)) {
+        const uint32_t keyAndValueByteSize = readUint32(mMetadata + offset);
+        offset += sizeof(uint32_t);
+        if (keyAndValueByteSize > mMetadataSize - offset) {
+            break;
+        }
+        char const* pkey = (char const*) mMetadata + offset;
+        if (keyAndValueByteSize >= keySize && memcmp(pkey, key, keySize) == 0) {
+            if (valueSize) {
+                *valueSize = keyAndValueByteSize - keySize;
+            }
+            return pkey + keySize;
+        }
+        const uint32_t paddingSize = 3 - ((keyAndValueByteSize + 3) % 4);
+        offset += std::min(keyAndValueByteSize + paddingSize, mMetadataSize - offset);
+    }
+    return nullptr;
+}
+
+bool KtxReader::getSphericalHarmonics(filament::math::float3* result) const {
+    size_t size;
+    char const* value = getMetadata("sh", &size);
+    if (!value) {
+        return false;
+    }
+    // the value isn't null-terminated in the file
+    const std::string sh(value, size);
+    char const* src = sh.c_str();
+    float* flat = &result->x;
+    // 3 bands, 9 RGB coefficients for a total of 27 floats.
+    for (int i = 0; i < 9 * 3; i++) {
+        char* next;
+        *flat++ = strtof(src, &next);
+        if (next == src) {
+            return false;
+        }
+        src = next;
+    }
+    return true;
+}
+
+bool KtxReader::getLevel(uint32_t level, uint8_t const** data, uint32_t* faceSize) const {
+    if (level >= mNumMipLevels) {
+        return false;
+    }
+    *data = mData + mLevelOffsets[level];
+    *faceSize = mFaceSizes[level];
+    return true;
+}
+
+} // namespace image
@@ -16,10 +16,12 @@
 
 #include <image/ColorTransform.h>
 #include <image/KtxBundle.h>
+#include <image/KtxReader.h>
 #include <image/ImageOps.h>
 #include <image/ImageSampler.h>
 #include <image/LinearImage.h>
 
+#include <imageio/BlockCompression.h>
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageDiffer.h>
 #include <imageio/ImageEncoder.h>
@@ -29,6 +31,7 @@
 #include <utils/Panic.h>
 #include <utils/Path.h>
 
+#include <math/half.h>
 #include <math/vec3.h>
 #include <math/vec4.h>
 
@@ -427,6 +430,217 @@ TEST_F(ImageTest, Ktx) { // NOLINT
     }
 }
 
+TEST_F(ImageTest, KtxReader) { // NOLINT
+    // a cubemap with 2 miplevels, the faces of each level have distinct contents
+    KtxBundle bundle(2, 1, true);
+    for (uint32_t level = 0; level < 2; level++) {
+        for (uint32_t face = 0; face < 6; face++) {
+            vector<uint8_t> blob((2 - level) * 8, uint8_t(level * 6 + face));
+            ASSERT_TRUE(bundle.setBlob({level, 0, face}, blob.data(), blob.size()));
+        }
+    }
+    bundle.info().pixelWidth = 4;
+    bundle.info().pixelHeight = 4;
+    bundle.setMetadata("foo", "bar");
+    bundle.setMetadata("sh", "1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25 "
+            "26 27");
+
+    vector<uint8_t> contents(bundle.getSerializedLength());
+    ASSERT_TRUE(bundle.serialize(contents.data(), contents.size()));
+    const string path = (utils::Path::getTemporaryDirectory() + "test_image_reader.ktx").getPath();
+    std::ofstream(path, std::ios::binary).write((char const*) contents.data(), contents.size());
+
+    KtxReader* reader = KtxReader::open(path.c_str());
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(reader->getNumMipLevels(), 2);
+    EXPECT_EQ(reader->getArrayLength(), 1);
+    EXPECT_TRUE(reader->isCubemap());
+    EXPECT_EQ(reader->getInfo().pixelWidth, 4);
+
+    size_t valueSize;
+    char const* value = reader->getMetadata("foo", &valueSize);
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(string(value, valueSize), "bar");
+    EXPECT_EQ(reader->getMetadata("fo"), nullptr);
+
+    float3 sh[9];
+    ASSERT_TRUE(reader->getSphericalHarmonics(sh));
+    EXPECT_FLOAT_EQ(sh[8].z, 27.0f);
+
+    // the faces of a level are contiguous
+    for (uint32_t level = 0; level < 2; level++) {
+        uint8_t const* data;
+        uint32_t faceSize;
+        ASSERT_TRUE(reader->getLevel(level, &data, &faceSize));
+        ASSERT_EQ(faceSize, (2 - level) * 8);
+        for (uint32_t face = 0; face < 6; face++) {
+            uint8_t* blob;
+            uint32_t size;
+            ASSERT_TRUE(bundle.getBlob({level, 0, face}, &blob, &size));
+            EXPECT_EQ(memcmp(data + face * faceSize, blob, size), 0);
+        }
+    }
+    EXPECT_FALSE(reader->getLevel(2, nullptr, nullptr));
+    delete reader;
+
+    // truncated files are rejected
+    std::ofstream(path, std::ios::binary).write((char const*) contents.data(),
+            contents.size() - 1);
+    EXPECT_EQ(KtxReader::open(path.c_str()), nullptr);
+    utils::Path(path).unlinkFile();
+}
+
+// Decodes a BC7 block that uses mode 6, which is the only mode produced by bc7Compress().
+static bool decodeBc7Mode6(uint8_t const* block, float4* texels) {
+    size_t bit = 0;
+    auto read = [&](size_t count) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < count; i++, bit++) {
+            value |= ((block[bit / 8] >> (bit % 8)) & 1u) << i;
+        }
+        return value;
+    };
+    if (read(7) != 0x40) {
+        return false;
+    }
+    uint32_t endpoints[2][4];
+    for (size_t c = 0; c < 4; c++) {
+        endpoints[0][c] = read(7) << 1u;
+        endpoints[1][c] = read(7) << 1u;
+    }
+    const uint32_t p0 = read(1);
+    const uint32_t p1 = read(1);
+    static constexpr uint32_t weights[16] = {
+            0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for (size_t t = 0; t < 16; t++) {
+        const uint32_t w = weights[read(t == 0 ? 3 : 4)];
+        for (size_t c = 0; c < 4; c++) {
+            const uint32_t e0 = endpoints[0][c] | p0;
+            const uint32_t e1 = endpoints[1][c] | p1;
+            texels[t][c] = float(((64 - w) * e0 + w * e1 + 32) >> 6u) / 255.0f;
+        }
+    }
+    return true;
+}
+
+TEST_F(ImageTest, Bc7Compression) { // NOLINT
+    // the colors of each block are on a line, which a single subset can represent
+    const uint32_t width = 16, height = 8;
+    LinearImage image(width, height, 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float* texel = image.getPixelRef(x, y);
+            const float s = (x % 4 + (y % 4) * 4) / 15.0f;
+            texel[0] = s;
+            texel[1] = 1.0f - s;
+            texel[2] = 0.25f + 0.5f * s;
+            texel[3] = (x / 4 + 1) / 4.0f;
+        }
+    }
+
+    Bc7Config config = bc7ParseOptionString("srgba_thorough");
+    ASSERT_TRUE(config.valid);
+    ASSERT_TRUE(config.srgb);
+    ASSERT_FALSE(bc7ParseOptionString("rgba_slow").valid);
+
+    for (Bc7Preset quality : { Bc7Preset::FAST, Bc7Preset::MEDIUM, Bc7Preset::THOROUGH }) {
+        config.quality = quality;
+        CompressedTexture tex = bc7Compress(image, config);
+        ASSERT_EQ(tex.format, CompressedFormat::SRGB_ALPHA_BPTC_UNORM);
+        ASSERT_EQ(tex.size, (width / 4) * (height / 4) * 16);
+        for (uint32_t by = 0; by < height / 4; by++) {
+            for (uint32_t bx = 0; bx < width / 4; bx++) {
+                float4 texels[16];
+                const uint8_t* block = tex.data.get() + (by * (width / 4) + bx) * 16;
+                ASSERT_TRUE(decodeBc7Mode6(block, texels));
+                for (uint32_t t = 0; t < 16; t++) {
+                    float const* expected = image.getPixelRef(bx * 4 + t % 4, by * 4 + t / 4);
+                    for (size_t c = 0; c < 4; c++) {
+                        EXPECT_NEAR(texels[t][c], expected[c], 8.0f / 255.0f);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Decodes an unsigned BC6H block that uses mode 11, which is the only mode produced by
+// bc6hCompress(). The texels are returned as the bits of half-floats.
+static bool decodeBc6hMode11(uint8_t const* block, uint32_t texels[16][3]) {
+    size_t bit = 0;
+    auto read = [&](size_t count) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < count; i++, bit++) {
+            value |= ((block[bit / 8] >> (bit % 8)) & 1u) << i;
+        }
+        return value;
+    };
+    if (read(5) != 0x03) {
+        return false;
+    }
+    uint32_t endpoints[2][3];
+    for (size_t e = 0; e < 2; e++) {
+        for (size_t c = 0; c < 3; c++) {
+            const uint32_t q = read(10);
+            endpoints[e][c] = q == 0 ? 0 : (q == 1023 ? 0xFFFF : ((q << 16u) + 0x8000u) >> 10u);
+        }
+    }
+    static constexpr uint32_t weights[16] = {
+            0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for (size_t t = 0; t < 16; t++) {
+        const uint32_t w = weights[read(t == 0 ? 3 : 4)];
+        for (size_t c = 0; c < 3; c++) {
+            const uint32_t v = ((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6u;
+            texels[t][c] = (v * 31) >> 6u;
+        }
+    }
+    return true;
+}
+
+TEST_F(ImageTest, Bc6hCompression) { // NOLINT
+    // HDR colors from 1/64 to 4096, the colors of each block are on a line in the space of the
+    // half-float bits
+    using filament::math::makeHalf;
+    const uint32_t width = 16, height = 8;
+    LinearImage image(width, height, 3);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float* texel = image.getPixelRef(x, y);
+            const float s = (x % 4 + (y % 4) * 4) / 15.0f;
+            const float bright = (x / 4 + (y / 4) * 4) / 7.0f;
+            texel[0] = makeHalf(uint16_t(0x2400 + 0x4000 * bright + 0x800 * s));
+            texel[1] = makeHalf(uint16_t(0x2400 + 0x3000 * bright + 0x1000 * (1.0f - s)));
+            texel[2] = makeHalf(uint16_t(0x2400 + 0x2000 * bright));
+        }
+    }
+
+    ASSERT_TRUE(bc6hParseOptionString("thorough").valid);
+    ASSERT_FALSE(bc6hParseOptionString("slow").valid);
+    CompressionConfig parsed;
+    ASSERT_TRUE(parseOptionString("bc6h_fast", &parsed));
+    ASSERT_EQ(parsed.type, CompressionConfig::BC6H);
+
+    for (Bc6hPreset quality : { Bc6hPreset::FAST, Bc6hPreset::MEDIUM, Bc6hPreset::THOROUGH }) {
+        CompressedTexture tex = bc6hCompress(image, { quality, true });
+        ASSERT_EQ(tex.format, CompressedFormat::RGB_BPTC_UNSIGNED_FLOAT);
+        ASSERT_EQ(tex.size, (width / 4) * (height / 4) * 16);
+        for (uint32_t by = 0; by < height / 4; by++) {
+            for (uint32_t bx = 0; bx < width / 4; bx++) {
+                uint32_t texels[16][3];
+                const uint8_t* block = tex.data.get() + (by * (width / 4) + bx) * 16;
+                ASSERT_TRUE(decodeBc6hMode11(block, texels));
+                for (uint32_t t = 0; t < 16; t++) {
+                    float const* expected = image.getPixelRef(bx * 4 + t % 4, by * 4 + t / 4);
+                    for (size_t c = 0; c < 3; c++) {
+                        const float bits = getBits(filament::math::half(expected[c]));
+                        EXPECT_NEAR(float(texels[t][c]), bits, 32.0f);
+                    }
+                }
+            }
+        }
+    }
+}
+
 TEST_F(ImageTest, getSphericalHarmonics) {
     KtxBundle ktx(2, 1, true);
 
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef IMAGE_BATCHMANIFEST_H_
+#define IMAGE_BATCHMANIFEST_H_
+
+#include <utils/Path.h>
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace image {
+
+// The list of files processed by the batch mode of the image tools (mipgen, cmgen), which
+// process many inputs in a single process rather than one per invocation.
+//
+// The manifest is a text file with one entry per line: an input file followed by its arguments
+// (e.g. an output path), separated by whitespace. Empty lines and lines starting with '#' are
+// ignored, relative paths are relative to the manifest.
+//
+// Entries whose input file content, arguments and tool settings are unchanged since they were
+// last processed are up-to-date, and can be skipped. The hashes of the processed entries are
+// saved next to the manifest, in <manifest>.stamps. Deleting this file forces a full rebuild.
+class BatchManifest {
+public:
+    struct Entry {
+        std::vector<std::string> args;  // args[0] is the input file
+        uint64_t hash = 0;              // set by isUpToDate()
+        bool processed = false;
+    };
+
+    // Reads the manifest and the stamps of its previous run. 'settings' identifies the options
+    // shared by all the entries, e.g. the command line of the tool.
+    bool load(const utils::Path& path, const std::string& settings);
+
+    std::vector<Entry>& getEntries() noexcept { return mEntries; }
+
+    // Hashes the input file and the arguments of an entry, and compares them with the last run.
+    // An up-to-date entry is marked as processed. Different entries can be checked concurrently.
+    bool isUpToDate(size_t index);
+
+    // Marks an entry as successfully processed, so that its hash is saved. Different entries can
+    // be marked concurrently.
+    void setProcessed(size_t index) noexcept { mEntries[index].processed = true; }
+
+    // Saves the hashes of the processed entries.
+    bool saveStamps() const;
+
+private:
+    utils::Path mStampsPath;
+    std::string mSettings;
+    std::vector<Entry> mEntries;
+    std::vector<uint64_t> mStamps;      // sorted
+};
+
+} // namespace image
+
+#endif // IMAGE_BATCHMANIFEST_H_
@@ -81,6 +81,11 @@ enum class CompressedFormat {
     SRGB8_ALPHA8_ASTC_10x10 = 0x93DB,
     SRGB8_ALPHA8_ASTC_12x10 = 0x93DC,
     SRGB8_ALPHA8_ASTC_12x12 = 0x93DD,
+
+    RGBA_BPTC_UNORM = 0x8E8C,
+    SRGB_ALPHA_BPTC_UNORM = 0x8E8D,
+    RGB_BPTC_SIGNED_FLOAT = 0x8E8E,
+    RGB_BPTC_UNSIGNED_FLOAT = 0x8E8F,
 };
 
 // Represents the opaque result of compression and the chosen texture format.
@@ -159,27 +164,86 @@ EtcConfig etcParseOptionString(const std::string& options);
 
 // S3TC ////////////////////////////////////////////////////////////////////////////////////////////
 
+// Controls how fast compression occurs at the cost of quality in the resulting image.
+enum class S3tcPreset {
+    FAST,
+    THOROUGH,
+};
+
 // Informs the S3TC encoder of the desired output.
 struct S3tcConfig {
     CompressedFormat format;
     bool srgb;
+    S3tcPreset quality;
 };
 
-// Uses the CPU to compress a linear image (1 to 4 channels) into an S3TC texture.
+// Uses the CPU to compress a linear image (1 to 4 channels) into an S3TC texture. The blocks are
+// compressed by all the cores.
 CompressedTexture s3tcCompress(const LinearImage& source, S3tcConfig config);
 
 // Parses an underscore-delimited string to produce an S3TC compression configuration. Currently
-// this only accepts "rgb_dxt1" and "rgba_dxt5". If the string is malformed, this returns a config
-// with an invalid format.
+// this only accepts "rgb_dxt1" and "rgba_dxt5", optionally followed by "_thorough". If the string
+// is malformed, this returns a config with an invalid format.
 S3tcConfig s3tcParseOptionString(const std::string& options);
 
+// BC7 /////////////////////////////////////////////////////////////////////////////////////////////
+
+// Controls how fast compression occurs at the cost of quality in the resulting image.
+enum class Bc7Preset {
+    FAST,
+    MEDIUM,
+    THOROUGH,
+};
+
+// Informs the BC7 encoder of the desired output.
+struct Bc7Config {
+    Bc7Preset quality;
+    bool srgb;
+    bool valid;
+};
+
+// Uses the CPU to compress a linear image (1 to 4 channels) into a BC7 (BPTC) texture. The blocks
+// are compressed by all the cores.
+CompressedTexture bc7Compress(const LinearImage& source, Bc7Config config);
+
+// Parses an underscore-delimited string of the form FORMAT_QUALITY to produce a BC7 compression
+// configuration, where FORMAT is rgba or srgba and QUALITY is fast, medium or thorough. If the
+// string is malformed, this returns an invalid config.
+Bc7Config bc7ParseOptionString(const std::string& options);
+
+// BC6H ////////////////////////////////////////////////////////////////////////////////////////////
+
+// Controls how fast compression occurs at the cost of quality in the resulting image.
+enum class Bc6hPreset {
+    FAST,
+    MEDIUM,
+    THOROUGH,
+};
+
+// Informs the BC6H encoder of the desired output.
+struct Bc6hConfig {
+    Bc6hPreset quality;
+    bool valid;
+};
+
+// Uses the CPU to compress a linear HDR image (1 to 4 channels) into an unsigned BC6H (BPTC float)
+// texture. Negative values are clamped to zero and the alpha channel is dropped. The blocks are
+// compressed by all the cores.
+CompressedTexture bc6hCompress(const LinearImage& source, Bc6hConfig config);
+
+// Parses a quality string (fast, medium or thorough) to produce a BC6H compression configuration.
+// If the string is malformed, this returns an invalid config.
+Bc6hConfig bc6hParseOptionString(const std::string& options);
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct CompressionConfig {
-    enum { INVALID, ASTC, S3TC, ETC } type;
+    enum { INVALID, ASTC, S3TC, ETC, BC7, BC6H } type;
     AstcConfig astc;
     S3tcConfig s3tc;
     EtcConfig etc;
+    Bc7Config bc7;
+    Bc6hConfig bc6h;
 };
 
 bool parseOptionString(const std::string& options, CompressionConfig* config);
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageio/BatchManifest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace image {
+
+namespace {
+
+// 64-bit FNV-1a, good enough to detect changes in the inputs.
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) noexcept {
+    const uint8_t* bytes = (const uint8_t*) data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+} // anonymous namespace
+
+bool BatchManifest::load(const utils::Path& path, const std::string& settings) {
+    std::ifstream in(path.getPath());
+    if (!in) {
+        return false;
+    }
+
+    const utils::Path root = path.getParent();
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        Entry entry;
+        for (std::string word; words >> word;) {
+            if (entry.args.empty() && word[0] == '#') {
+                break;
+            }
+            utils::Path arg(word);
+            entry.args.push_back(arg.isAbsolute() ? word : (root + arg).getPath());
+        }
+        if (!entry.args.empty()) {
+            mEntries.push_back(std::move(entry));
+        }
+    }
+
+    mSettings = settings;
+    mStampsPath = path.getPath() + ".stamps";
+    std::ifstream stamps(mStampsPath.getPath());
+    for (std::string word; stamps >> word;) {
+        mStamps.push_back(std::stoull(word, nullptr, 16));
+    }
+    std::sort(mStamps.begin(), mStamps.end());
+    return true;
+}
+
+bool BatchManifest::isUpToDate(size_t index) {
+    Entry& entry = mEntries[index];
+    uint64_t hash = fnv1a(FNV_OFFSET_BASIS, mSettings.data(), mSettings.size());
+    for (const std::string& arg : entry.args) {
+        hash = fnv1a(hash, arg.c_str(), arg.size() + 1);
+    }
+
+    std::ifstream in(entry.args[0], std::ios::binary);
+    if (!in) {
+        entry.hash = 0;
+        return false;
+    }
+    char buffer[65536];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        hash = fnv1a(hash, buffer, size_t(in.gcount()));
+    }
+
+    entry.hash = hash;
+    entry.processed = std::binary_search(mStamps.begin(), mStamps.end(), hash);
+    return entry.processed;
+}
+
+bool BatchManifest::saveStamps() const {
+    std::ofstream out(mStampsPath.getPath(), std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    out << std::hex;
+    for (const Entry& entry : mEntries) {
+        if (entry.processed && entry.hash) {
+            out << entry.hash << '\n';
+        }
+    }
+    return bool(out);
+}
+
+} // namespace image
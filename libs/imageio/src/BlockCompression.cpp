@@ -18,9 +18,16 @@
 
 #include <image/ImageOps.h>
 
+#include <math/half.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
 #include <thread>
+#include <vector>
 
 #include <astcenc.h>
 #include <Etc.h>
@@ -32,6 +39,26 @@ namespace image {
 
 static LinearImage extendToFourChannels(LinearImage source);
 
+// Calls encodeRow(y) for each of the 'rows' rows of blocks, using all the cores.
+template<typename F>
+static void encodeBlockRows(uint32_t rows, F encodeRow) {
+    const uint32_t threadCount = std::min(rows, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<uint32_t> next = { 0 };
+    auto worker = [&]() {
+        for (uint32_t y = next++; y < rows; y = next++) {
+            encodeRow(y);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
 CompressedTexture astcCompress(const LinearImage& original, AstcConfig config) {
 
     // If this is the first time, initialize the ARM encoder tables.
@@ -385,19 +412,20 @@ static void extract4x4RGBA(uint8_t* dst, const LinearImage& source, uint32_t x0,
 CompressedTexture s3tcCompress(const LinearImage& original, S3tcConfig config) {
     const bool dxt5 = config.format == CompressedFormat::RGBA_S3TC_DXT5;
     LinearImage source = extendToFourChannels(original);
-    uint8_t block[64];
-    uint32_t xblocks = (source.getWidth() + 3) / 4;
-    uint32_t yblocks = (source.getHeight() + 3) / 4;
-    uint32_t size = xblocks * yblocks * (dxt5 ? 16 : 8);
+    const uint32_t blockSize = dxt5 ? 16 : 8;
+    const uint32_t xblocks = (source.getWidth() + 3) / 4;
+    const uint32_t yblocks = (source.getHeight() + 3) / 4;
+    const uint32_t size = xblocks * yblocks * blockSize;
     uint8_t* buffer = new uint8_t[size];
-    uint8_t* dst = buffer;
-    for (int y = 0, h = source.getHeight(); y < h; y += 4) {
-        for (int x = 0, w = source.getWidth(); x < w; x += 4) {
-            extract4x4RGBA(block, source, x, y);
-            stb_compress_dxt_block(dst, block, dxt5, 8);
-            dst += dxt5 ? 16 : 8;
+    const int mode = config.quality == S3tcPreset::THOROUGH ? STB_DXT_HIGHQUAL : STB_DXT_NORMAL;
+    encodeBlockRows(yblocks, [&](uint32_t by) {
+        uint8_t block[64];
+        uint8_t* dst = buffer + by * xblocks * blockSize;
+        for (uint32_t bx = 0; bx < xblocks; bx++, dst += blockSize) {
+            extract4x4RGBA(block, source, bx * 4, by * 4);
+            stb_compress_dxt_block(dst, block, dxt5, mode);
         }
-    }
+    });
     return {
         .format = config.format,
         .size = size,
@@ -405,16 +433,501 @@ CompressedTexture s3tcCompress(const LinearImage& original, S3tcConfig config) {
     };
 }
 
-S3tcConfig s3tcParseOptionString(const std::string& options) {
+S3tcConfig s3tcParseOptionString(const std::string& configString) {
+    std::string options = configString;
+    S3tcPreset quality = S3tcPreset::FAST;
+    if (options.size() > 9 && options.substr(options.size() - 9) == "_thorough") {
+        quality = S3tcPreset::THOROUGH;
+        options = options.substr(0, options.size() - 9);
+    }
     if (options == "rgb_dxt1") {
-        return {CompressedFormat::RGB_S3TC_DXT1, false};
+        return {CompressedFormat::RGB_S3TC_DXT1, false, quality};
     }
     if (options == "rgba_dxt5") {
-        return {CompressedFormat::RGBA_S3TC_DXT5, false};
+        return {CompressedFormat::RGBA_S3TC_DXT5, false, quality};
     }
     return {};
 }
 
+// Our BC7 encoder only uses mode 6: a single pair of RGBA endpoints with 7 bits per component plus
+// one p-bit (shared LSB) per endpoint, and 4-bit indices. It has the best quality of the single
+// subset modes and covers images with and without alpha, but can't represent blocks with several
+// distinct colors as well as the partitioned modes.
+
+static constexpr uint8_t BC7_WEIGHTS[16] = {
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+using filament::math::float4;
+
+struct Bc7Endpoints {
+    uint8_t c[2][4];    // 7-bit components
+    uint8_t p[2];       // p-bits
+};
+
+static float4 bc7Decode(Bc7Endpoints const& e, size_t i) {
+    return float4{
+            float((e.c[i][0] << 1u) | e.p[i]), float((e.c[i][1] << 1u) | e.p[i]),
+            float((e.c[i][2] << 1u) | e.p[i]), float((e.c[i][3] << 1u) | e.p[i]) };
+}
+
+// Quantizes the endpoints e0/e1 (0 to 255) for all the p-bit combinations, and picks the indices
+// of each texel. Returns the error of the best combination.
+static float bc7Quantize(float4 const* texels, float4 e0, float4 e1,
+        Bc7Endpoints* outEndpoints, uint8_t* outIndices) {
+    float best = std::numeric_limits<float>::max();
+    for (uint8_t p = 0; p < 4; p++) {
+        Bc7Endpoints e;
+        e.p[0] = p & 1u;
+        e.p[1] = p >> 1u;
+        for (size_t c = 0; c < 4; c++) {
+            e.c[0][c] = (uint8_t) std::min(127.0f, std::max(0.0f,
+                    std::round((e0[c] - e.p[0]) * 0.5f)));
+            e.c[1][c] = (uint8_t) std::min(127.0f, std::max(0.0f,
+                    std::round((e1[c] - e.p[1]) * 0.5f)));
+        }
+        const float4 d0 = bc7Decode(e, 0);
+        const float4 d1 = bc7Decode(e, 1);
+        float4 palette[16];
+        for (size_t i = 0; i < 16; i++) {
+            const uint32_t w = BC7_WEIGHTS[i];
+            palette[i] = floor(((64 - w) * d0 + w * d1 + 32.0f) / 64.0f);
+        }
+        float error = 0;
+        uint8_t indices[16];
+        for (size_t t = 0; t < 16; t++) {
+            float texelError = std::numeric_limits<float>::max();
+            for (uint8_t i = 0; i < 16; i++) {
+                const float4 d = palette[i] - texels[t];
+                const float err = dot(d, d);
+                if (err < texelError) {
+                    texelError = err;
+                    indices[t] = i;
+                }
+            }
+            error += texelError;
+        }
+        if (error < best) {
+            best = error;
+            *outEndpoints = e;
+            std::copy(indices, indices + 16, outIndices);
+        }
+    }
+    return best;
+}
+
+static void bc7CompressBlock(uint8_t* dst, uint8_t const* block, Bc7Preset quality) {
+    float4 texels[16];
+    float4 mean = 0;
+    float4 lo = std::numeric_limits<float>::max();
+    float4 hi = 0;
+    for (size_t t = 0; t < 16; t++) {
+        texels[t] = float4{ block[t * 4], block[t * 4 + 1], block[t * 4 + 2], block[t * 4 + 3] };
+        mean += texels[t];
+        lo = min(lo, texels[t]);
+        hi = max(hi, texels[t]);
+    }
+    mean /= 16.0f;
+
+    // the principal axis of the texels, found with power iterations from the diagonal of their
+    // bounding box (a single iteration is enough to get the direction of the correlations right)
+    float covariance[4][4] = {};
+    for (size_t t = 0; t < 16; t++) {
+        const float4 d = texels[t] - mean;
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 4; j++) {
+                covariance[i][j] += d[i] * d[j];
+            }
+        }
+    }
+    float4 axis = hi - lo;
+    const size_t powerIterations = quality == Bc7Preset::FAST ? 1 : 8;
+    for (size_t iteration = 0; iteration < powerIterations; iteration++) {
+        float4 v = 0;
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 4; j++) {
+                v[i] += covariance[i][j] * axis[j];
+            }
+        }
+        const float l = std::max(std::abs(v.x), std::max(std::abs(v.y),
+                std::max(std::abs(v.z), std::abs(v.w))));
+        if (l == 0) {
+            break;
+        }
+        axis = v / l;
+    }
+
+    // the endpoints are the extents of the texels along the axis
+    float4 e0 = mean;
+    float4 e1 = mean;
+    const float axisLength2 = dot(axis, axis);
+    if (axisLength2 > 0) {
+        float tmin = std::numeric_limits<float>::max();
+        float tmax = -std::numeric_limits<float>::max();
+        for (size_t t = 0; t < 16; t++) {
+            const float proj = dot(texels[t] - mean, axis);
+            tmin = std::min(tmin, proj);
+            tmax = std::max(tmax, proj);
+        }
+        e0 = mean + axis * (tmin / axisLength2);
+        e1 = mean + axis * (tmax / axisLength2);
+    }
+
+    Bc7Endpoints endpoints;
+    uint8_t indices[16];
+    float error = bc7Quantize(texels, e0, e1, &endpoints, indices);
+
+    // refine the endpoints with a least squares fit to the chosen indices
+    const size_t iterations = quality == Bc7Preset::THOROUGH ? 4 :
+            (quality == Bc7Preset::MEDIUM ? 1 : 0);
+    for (size_t iteration = 0; iteration < iterations && error > 0; iteration++) {
+        float aa = 0, ab = 0, bb = 0;
+        float4 ax = 0, bx = 0;
+        for (size_t t = 0; t < 16; t++) {
+            const float b = BC7_WEIGHTS[indices[t]] / 64.0f;
+            const float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * texels[t];
+            bx += b * texels[t];
+        }
+        const float det = aa * bb - ab * ab;
+        if (det == 0) {
+            break;
+        }
+        const float4 f0 = (ax * bb - bx * ab) / det;
+        const float4 f1 = (bx * aa - ax * ab) / det;
+        Bc7Endpoints refinedEndpoints;
+        uint8_t refinedIndices[16];
+        const float refinedError = bc7Quantize(texels, f0, f1, &refinedEndpoints, refinedIndices);
+        if (refinedError >= error) {
+            break;
+        }
+        error = refinedError;
+        endpoints = refinedEndpoints;
+        std::copy(refinedIndices, refinedIndices + 16, indices);
+    }
+
+    // the MSB of the first index is implied to be 0, swap the endpoints if needed
+    if (indices[0] & 8u) {
+        std::swap(endpoints.c[0], endpoints.c[1]);
+        std::swap(endpoints.p[0], endpoints.p[1]);
+        for (uint8_t& index : indices) {
+            index = 15u - index;
+        }
+    }
+
+    uint64_t lo64 = 1u << 6u; // mode 6
+    uint64_t hi64 = 0;
+    size_t bit = 7;
+    auto write = [&](uint64_t value, size_t count) {
+        for (size_t i = 0; i < count; i++, bit++) {
+            const uint64_t b = (value >> i) & 1u;
+            if (bit < 64) {
+                lo64 |= b << bit;
+            } else {
+                hi64 |= b << (bit - 64);
+            }
+        }
+    };
+    for (size_t c = 0; c < 4; c++) {
+        write(endpoints.c[0][c], 7);
+        write(endpoints.c[1][c], 7);
+    }
+    write(endpoints.p[0], 1);
+    write(endpoints.p[1], 1);
+    write(indices[0], 3);
+    for (size_t t = 1; t < 16; t++) {
+        write(indices[t], 4);
+    }
+    for (size_t i = 0; i < 8; i++) {
+        dst[i] = uint8_t(lo64 >> (i * 8));
+        dst[i + 8] = uint8_t(hi64 >> (i * 8));
+    }
+}
+
+CompressedTexture bc7Compress(const LinearImage& original, Bc7Config config) {
+    LinearImage source = extendToFourChannels(original);
+    const uint32_t xblocks = (source.getWidth() + 3) / 4;
+    const uint32_t yblocks = (source.getHeight() + 3) / 4;
+    const uint32_t size = xblocks * yblocks * 16;
+    uint8_t* buffer = new uint8_t[size];
+    encodeBlockRows(yblocks, [&](uint32_t by) {
+        uint8_t block[64];
+        uint8_t* dst = buffer + by * xblocks * 16;
+        for (uint32_t bx = 0; bx < xblocks; bx++, dst += 16) {
+            extract4x4RGBA(block, source, bx * 4, by * 4);
+            bc7CompressBlock(dst, block, config.quality);
+        }
+    });
+    return {
+        .format = config.srgb ? CompressedFormat::SRGB_ALPHA_BPTC_UNORM :
+                CompressedFormat::RGBA_BPTC_UNORM,
+        .size = size,
+        .data = decltype(CompressedTexture::data)(buffer)
+    };
+}
+
+Bc7Config bc7ParseOptionString(const std::string& options) {
+    const size_t _1 = options.find('_');
+    if (_1 == std::string::npos) {
+        return {};
+    }
+    const std::string format = options.substr(0, _1);
+    const std::string quality = options.substr(_1 + 1);
+    Bc7Config config;
+    if (format == "rgba") {
+        config.srgb = false;
+    } else if (format == "srgba") {
+        config.srgb = true;
+    } else {
+        return {};
+    }
+    if (quality == "fast") {
+        config.quality = Bc7Preset::FAST;
+    } else if (quality == "medium") {
+        config.quality = Bc7Preset::MEDIUM;
+    } else if (quality == "thorough") {
+        config.quality = Bc7Preset::THOROUGH;
+    } else {
+        return {};
+    }
+    config.valid = true;
+    return config;
+}
+
+// Our BC6H encoder only produces unsigned blocks in mode 11: a single pair of RGB endpoints with 10
+// bits per component and 4-bit indices, without the delta-encoded endpoints of the other modes.
+// The hardware interpolates the bit patterns of half-floats, which are roughly logarithmic, so the
+// endpoints are fit and the error is measured in that space rather than on linear values.
+
+using filament::math::float3;
+
+struct Bc6hEndpoints {
+    uint32_t c[2][3];   // 10-bit components
+};
+
+// Returns the bits of the half-float nearest to each component, clamped to the finite positive
+// range that unsigned BC6H can represent.
+static float3 bc6hToHalfBits(float const* rgb, uint32_t channels) {
+    float3 bits;
+    for (size_t c = 0; c < 3; c++) {
+        const float v = std::min(65504.0f, std::max(0.0f, rgb[channels >= 3 ? c : 0]));
+        bits[c] = getBits(filament::math::half(v));
+    }
+    return bits;
+}
+
+// The decoder unquantizes the endpoints to 16 bits, interpolates them and scales the result by
+// 31/64 to get the half-float bits.
+static uint32_t bc6hUnquantize(uint32_t q) {
+    return q == 0 ? 0 : (q == 1023 ? 0xFFFF : ((q << 16u) + 0x8000u) >> 10u);
+}
+
+static uint32_t bc6hQuantize(float halfBits) {
+    const float unquantized = halfBits * (64.0f / 31.0f);
+    return (uint32_t) std::min(1023.0f, std::max(0.0f, std::round((unquantized - 32.0f) / 64.0f)));
+}
+
+// Quantizes the endpoints e0/e1 (in half-float bits) and picks the indices of each texel. Returns
+// the error of the block.
+static float bc6hQuantizeEndpoints(float3 const* texels, float3 e0, float3 e1,
+        Bc6hEndpoints* outEndpoints, uint8_t* outIndices) {
+    for (size_t c = 0; c < 3; c++) {
+        outEndpoints->c[0][c] = bc6hQuantize(e0[c]);
+        outEndpoints->c[1][c] = bc6hQuantize(e1[c]);
+    }
+    float3 palette[16];
+    for (size_t i = 0; i < 16; i++) {
+        const uint32_t w = BC7_WEIGHTS[i];
+        for (size_t c = 0; c < 3; c++) {
+            const uint32_t a = bc6hUnquantize(outEndpoints->c[0][c]);
+            const uint32_t b = bc6hUnquantize(outEndpoints->c[1][c]);
+            palette[i][c] = float(((((64 - w) * a + w * b + 32) >> 6u) * 31) >> 6u);
+        }
+    }
+    float error = 0;
+    for (size_t t = 0; t < 16; t++) {
+        float texelError = std::numeric_limits<float>::max();
+        for (uint8_t i = 0; i < 16; i++) {
+            const float3 d = palette[i] - texels[t];
+            const float err = dot(d, d);
+            if (err < texelError) {
+                texelError = err;
+                outIndices[t] = i;
+            }
+        }
+        error += texelError;
+    }
+    return error;
+}
+
+static void bc6hCompressBlock(uint8_t* dst, float3 const* texels, Bc6hPreset quality) {
+    float3 mean = 0;
+    float3 lo = std::numeric_limits<float>::max();
+    float3 hi = 0;
+    for (size_t t = 0; t < 16; t++) {
+        mean += texels[t];
+        lo = min(lo, texels[t]);
+        hi = max(hi, texels[t]);
+    }
+    mean /= 16.0f;
+
+    // the principal axis of the texels, see bc7CompressBlock()
+    float covariance[3][3] = {};
+    for (size_t t = 0; t < 16; t++) {
+        const float3 d = texels[t] - mean;
+        for (size_t i = 0; i < 3; i++) {
+            for (size_t j = 0; j < 3; j++) {
+                covariance[i][j] += d[i] * d[j];
+            }
+        }
+    }
+    float3 axis = hi - lo;
+    const size_t powerIterations = quality == Bc6hPreset::FAST ? 1 : 8;
+    for (size_t iteration = 0; iteration < powerIterations; iteration++) {
+        float3 v = 0;
+        for (size_t i = 0; i < 3; i++) {
+            for (size_t j = 0; j < 3; j++) {
+                v[i] += covariance[i][j] * axis[j];
+            }
+        }
+        const float l = std::max(std::abs(v.x), std::max(std::abs(v.y), std::abs(v.z)));
+        if (l == 0) {
+            break;
+        }
+        axis = v / l;
+    }
+
+    float3 e0 = mean;
+    float3 e1 = mean;
+    const float axisLength2 = dot(axis, axis);
+    if (axisLength2 > 0) {
+        float tmin = std::numeric_limits<float>::max();
+        float tmax = -std::numeric_limits<float>::max();
+        for (size_t t = 0; t < 16; t++) {
+            const float proj = dot(texels[t] - mean, axis);
+            tmin = std::min(tmin, proj);
+            tmax = std::max(tmax, proj);
+        }
+        e0 = mean + axis * (tmin / axisLength2);
+        e1 = mean + axis * (tmax / axisLength2);
+    }
+
+    Bc6hEndpoints endpoints;
+    uint8_t indices[16];
+    float error = bc6hQuantizeEndpoints(texels, e0, e1, &endpoints, indices);
+
+    // refine the endpoints with a least squares fit to the chosen indices
+    const size_t iterations = quality == Bc6hPreset::THOROUGH ? 4 :
+            (quality == Bc6hPreset::MEDIUM ? 1 : 0);
+    for (size_t iteration = 0; iteration < iterations && error > 0; iteration++) {
+        float aa = 0, ab = 0, bb = 0;
+        float3 ax = 0, bx = 0;
+        for (size_t t = 0; t < 16; t++) {
+            const float b = BC7_WEIGHTS[indices[t]] / 64.0f;
+            const float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * texels[t];
+            bx += b * texels[t];
+        }
+        const float det = aa * bb - ab * ab;
+        if (det == 0) {
+            break;
+        }
+        Bc6hEndpoints refinedEndpoints;
+        uint8_t refinedIndices[16];
+        const float refinedError = bc6hQuantizeEndpoints(texels,
+                (ax * bb - bx * ab) / det, (bx * aa - ax * ab) / det,
+                &refinedEndpoints, refinedIndices);
+        if (refinedError >= error) {
+            break;
+        }
+        error = refinedError;
+        endpoints = refinedEndpoints;
+        std::copy(refinedIndices, refinedIndices + 16, indices);
+    }
+
+    // the MSB of the first index is implied to be 0, swap the endpoints if needed
+    if (indices[0] & 8u) {
+        std::swap(endpoints.c[0], endpoints.c[1]);
+        for (uint8_t& index : indices) {
+            index = 15u - index;
+        }
+    }
+
+    uint64_t lo64 = 0x03; // mode 11
+    uint64_t hi64 = 0;
+    size_t bit = 5;
+    auto write = [&](uint64_t value, size_t count) {
+        for (size_t i = 0; i < count; i++, bit++) {
+            const uint64_t b = (value >> i) & 1u;
+            if (bit < 64) {
+                lo64 |= b << bit;
+            } else {
+                hi64 |= b << (bit - 64);
+            }
+        }
+    };
+    for (size_t e = 0; e < 2; e++) {
+        for (size_t c = 0; c < 3; c++) {
+            write(endpoints.c[e][c], 10);
+        }
+    }
+    write(indices[0], 3);
+    for (size_t t = 1; t < 16; t++) {
+        write(indices[t], 4);
+    }
+    for (size_t i = 0; i < 8; i++) {
+        dst[i] = uint8_t(lo64 >> (i * 8));
+        dst[i + 8] = uint8_t(hi64 >> (i * 8));
+    }
+}
+
+CompressedTexture bc6hCompress(const LinearImage& source, Bc6hConfig config) {
+    const uint32_t channels = source.getChannels();
+    const uint32_t maxx = source.getWidth() - 1;
+    const uint32_t maxy = source.getHeight() - 1;
+    const uint32_t xblocks = (source.getWidth() + 3) / 4;
+    const uint32_t yblocks = (source.getHeight() + 3) / 4;
+    const uint32_t size = xblocks * yblocks * 16;
+    uint8_t* buffer = new uint8_t[size];
+    encodeBlockRows(yblocks, [&](uint32_t by) {
+        float3 block[16];
+        uint8_t* dst = buffer + by * xblocks * 16;
+        for (uint32_t bx = 0; bx < xblocks; bx++, dst += 16) {
+            for (uint32_t t = 0; t < 16; t++) {
+                const uint32_t x = imin(maxx, bx * 4 + t % 4);
+                const uint32_t y = imin(maxy, by * 4 + t / 4);
+                block[t] = bc6hToHalfBits(source.getPixelRef(x, y), channels);
+            }
+            bc6hCompressBlock(dst, block, config.quality);
+        }
+    });
+    return {
+        .format = CompressedFormat::RGB_BPTC_UNSIGNED_FLOAT,
+        .size = size,
+        .data = decltype(CompressedTexture::data)(buffer)
+    };
+}
+
+Bc6hConfig bc6hParseOptionString(const std::string& options) {
+    Bc6hConfig config;
+    if (options == "fast") {
+        config.quality = Bc6hPreset::FAST;
+    } else if (options == "medium") {
+        config.quality = Bc6hPreset::MEDIUM;
+    } else if (options == "thorough") {
+        config.quality = Bc6hPreset::THOROUGH;
+    } else {
+        return {};
+    }
+    config.valid = true;
+    return config;
+}
+
 CompressedTexture etcCompress(const LinearImage& original, EtcConfig config) {
     LinearImage source = extendToFourChannels(original);
     const int threadcount = std::thread::hardware_concurrency();
@@ -524,6 +1037,16 @@ bool parseOptionString(const std::string& options, CompressionConfig* config) {
         if (config->s3tc.format != CompressedFormat::INVALID) {
             config->type = CompressionConfig::S3TC;
         }
+    } else if (options.substr(0, 4) == "bc7_") {
+        config->bc7 = bc7ParseOptionString(options.substr(4));
+        if (config->bc7.valid) {
+            config->type = CompressionConfig::BC7;
+        }
+    } else if (options.substr(0, 5) == "bc6h_") {
+        config->bc6h = bc6hParseOptionString(options.substr(5));
+        if (config->bc6h.valid) {
+            config->type = CompressionConfig::BC6H;
+        }
     } else if (options.substr(0, 4) == "etc_") {
         config->etc = etcParseOptionString(options.substr(4));
         if (config->etc.format != CompressedFormat::INVALID) {
@@ -543,6 +1066,12 @@ CompressedTexture compressTexture(const CompressionConfig& config, const LinearI
     if (config.type == CompressionConfig::ETC) {
         return etcCompress(image, config.etc);
     }
+    if (config.type == CompressionConfig::BC7) {
+        return bc7Compress(image, config.bc7);
+    }
+    if (config.type == CompressionConfig::BC6H) {
+        return bc6hCompress(image, config.bc6h);
+    }
     return {};
 }
 
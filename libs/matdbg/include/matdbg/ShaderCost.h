@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MATDBG_SHADERCOST_H
+#define MATDBG_SHADERCOST_H
+
+#include <filaflat/ChunkContainer.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace matdbg {
+
+// Static estimate of the cost of a shader, computed from its SPIR-V. The counts are the
+// instructions of the code, not of an execution: loops aren't unrolled and both sides of the
+// branches are counted.
+struct ShaderCost {
+    uint32_t instructionCount = 0;  // all the instructions of the functions
+    uint32_t arithmeticCount = 0;   // arithmetic, logic, conversions, derivatives and built-ins
+    uint32_t textureCount = 0;      // texture samples, fetches, gathers and image reads
+    uint32_t memoryCount = 0;       // loads and stores
+    uint32_t branchCount = 0;       // conditional branches, switches and discards
+    // The largest number of scalar values live at once, e.g. a live vec4 counts as 4. This
+    // estimates the register pressure of the shader before the driver's compiler optimizes it.
+    uint32_t maxLiveScalars = 0;
+};
+
+// Returns false if the SPIR-V can't be parsed.
+bool getShaderCost(const uint32_t* words, size_t wordCount, ShaderCost* cost);
+
+// Computes the costs of the Vulkan shaders of a material package, in the order of
+// getVkShaderInfo(). The container must be the whole package, costs must have
+// getShaderCount(container, MaterialSpirv) entries.
+bool getVkShaderCosts(filaflat::ChunkContainer const& container, ShaderCost* costs);
+
+} // namespace matdbg
+} // namespace filament
+
+#endif  // MATDBG_SHADERCOST_H
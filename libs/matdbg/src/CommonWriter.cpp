@@ -41,7 +41,10 @@ std::string formatVariantString(uint8_t variant, MaterialDomain domain) noexcept
         if (variant & Variant::SHADOW_RECEIVER)       variantString += "SRE|";
         if (variant & Variant::SKINNING_OR_MORPHING)  variantString += "SKN|";
         if (variant & Variant::DEPTH)                 variantString += "DEP|";
-        if (variant & Variant::FOG)                   variantString += "FOG|";
+        if (variant & Variant::FOG) {
+            // the depth variants reuse the fog bit for picking
+            variantString += (variant & Variant::DEPTH) ? "PCK|" : "FOG|";
+        }
         if (variant & Variant::VSM)                   variantString += "VSM|";
         variantString = variantString.substr(0, variantString.length() - 1);
     }
@@ -21,6 +21,7 @@
 #include <backend/DriverEnums.h>
 
 #include <matdbg/JsonWriter.h>
+#include <matdbg/ShaderCost.h>
 #include <matdbg/ShaderInfo.h>
 
 #include "CommonWriter.h"
@@ -96,6 +97,7 @@ static bool printMaterial(ostream& json, const ChunkContainer& container) {
     printFloatChunk(json, container, MaterialSpecularAntiAliasingVariance, "variance");
     printFloatChunk(json, container, MaterialSpecularAntiAliasingThreshold, "threshold");
     printChunk<bool, bool>(json, container, MaterialClearCoatIorChange, "clear_coat_IOR_change");
+    printChunk<bool, bool>(json, container, MaterialFoveation, "foveation");
     json << "\"_\": 0 },\n";
     json << "\"raster\": {\n";
     printChunk<BlendingMode, uint8_t>(json, container, MaterialBlendingMode, "blending");
@@ -115,7 +117,8 @@ static bool printParametersInfo(ostream& json, const ChunkContainer& container)
     return true;
 }
 
-static void printShaderInfo(ostream& json, const vector<ShaderInfo>& info, const ChunkContainer& container) {
+static void printShaderInfo(ostream& json, const vector<ShaderInfo>& info, const ChunkContainer& container,
+        const vector<ShaderCost>* costs = nullptr) {
     MaterialDomain domain = MaterialDomain::SURFACE;
     read(container, ChunkType::MaterialDomain, reinterpret_cast<uint8_t*>(&domain));
     for (uint64_t i = 0; i < info.size(); ++i) {
@@ -128,8 +131,19 @@ static void printShaderInfo(ostream& json, const vector<ShaderInfo>& info, const
             << "\"shaderModel\": \"" << toString(item.shaderModel) << "\", "
             << "\"pipelineStage\": \"" << ps << "\", "
             << "\"variantString\": \"" << variantString << "\", "
-            << "\"variant\": \"" << std::hex << int(item.variant) << std::dec << "\" }"
-            << ((i == info.size() - 1) ? "\n" : ",\n");
+            << "\"variant\": \"" << std::hex << int(item.variant) << std::dec << "\"";
+        if (costs) {
+            const auto& cost = (*costs)[i];
+            json
+                << ", \"cost\": {"
+                << "\"instructions\": " << cost.instructionCount << ", "
+                << "\"arithmetic\": " << cost.arithmeticCount << ", "
+                << "\"texture\": " << cost.textureCount << ", "
+                << "\"memory\": " << cost.memoryCount << ", "
+                << "\"branches\": " << cost.branchCount << ", "
+                << "\"liveScalars\": " << cost.maxLiveScalars << " }";
+        }
+        json << " }" << ((i == info.size() - 1) ? "\n" : ",\n");
     }
 }
 
@@ -151,8 +165,11 @@ static bool printVkInfo(ostream& json, const ChunkContainer& container) {
     if (!getVkShaderInfo(container, info.data())) {
         return false;
     }
+    // the costs are only an addition, the shaders are listed even if they can't be analyzed
+    std::vector<ShaderCost> costs(info.size());
+    const bool hasCosts = getVkShaderCosts(container, costs.data());
     json << "\"vulkan\": [\n";
-    printShaderInfo(json, info, container);
+    printShaderInfo(json, info, container, hasCosts ? &costs : nullptr);
     json << "],\n";
     return true;
 }
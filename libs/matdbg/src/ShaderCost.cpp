@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <matdbg/ShaderCost.h>
+
+#include <matdbg/ShaderExtractor.h>
+#include <matdbg/ShaderInfo.h>
+
+#include <filaflat/ShaderBuilder.h>
+
+#include <spirv.hpp>
+#include <spirv-tools/libspirv.h>
+
+#include <tsl/robin_map.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace filament {
+namespace matdbg {
+
+using namespace spv;
+
+namespace {
+
+class CostAnalyzer {
+public:
+    explicit CostAnalyzer(ShaderCost* cost) : mCost(*cost) { }
+
+    static spv_result_t parseInstruction(void* user, const spv_parsed_instruction_t* instruction) {
+        static_cast<CostAnalyzer*>(user)->addInstruction(*instruction);
+        return SPV_SUCCESS;
+    }
+
+private:
+    // where a value of the function being parsed is defined and last used
+    struct LiveRange {
+        uint32_t first = UINT32_MAX;
+        uint32_t last = 0;
+        uint32_t size = 0;      // in scalars, 0 if it's not a value that needs a register
+    };
+
+    void addInstruction(spv_parsed_instruction_t const& instruction) {
+        const Op op = Op(instruction.opcode);
+        const uint32_t* const words = instruction.words;
+
+        switch (op) {
+            case OpTypeVector:
+                mTypeSizes[instruction.result_id] = getTypeSize(words[2]) * words[3];
+                return;
+            case OpTypeMatrix:
+                mTypeSizes[instruction.result_id] = getTypeSize(words[2]) * words[3];
+                return;
+            case OpTypePointer:
+                mTypeSizes[instruction.result_id] = 0;
+                return;
+            case OpFunction:
+                mInFunction = true;
+                mPosition = 0;
+                mLiveRanges.clear();
+                return;
+            case OpFunctionEnd:
+                mInFunction = false;
+                mCost.maxLiveScalars = std::max(mCost.maxLiveScalars, getMaxLiveScalars());
+                return;
+            default:
+                break;
+        }
+
+        if (!mInFunction) {
+            return;
+        }
+
+        switch (op) {
+            case OpLabel:
+            case OpLine:
+            case OpNoLine:
+            case OpNop:
+            case OpFunctionParameter:
+            case OpVariable:
+            case OpSelectionMerge:
+            case OpLoopMerge:
+                break;
+            default:
+                mCost.instructionCount++;
+                break;
+        }
+
+        if (op >= OpImageSampleImplicitLod && op <= OpImageRead) {
+            mCost.textureCount++;
+        } else if (op == OpExtInst ||
+                (op >= OpConvertFToU && op <= OpBitcast) ||
+                (op >= OpSNegate && op <= OpSMulExtended) ||
+                (op >= OpAny && op <= OpFUnordGreaterThanEqual) ||
+                (op >= OpShiftRightLogical && op <= OpBitCount) ||
+                (op >= OpDPdx && op <= OpFwidthCoarse)) {
+            mCost.arithmeticCount++;
+        } else if (op == OpLoad || op == OpStore || op == OpCopyMemory) {
+            mCost.memoryCount++;
+        } else if (op == OpBranchConditional || op == OpSwitch || op == OpKill) {
+            mCost.branchCount++;
+        }
+
+        // the values used by this instruction are live until here, the values used before they're
+        // defined are loop-carried values of OpPhi
+        for (uint16_t i = 0; i < instruction.num_operands; i++) {
+            spv_parsed_operand_t const& operand = instruction.operands[i];
+            if (operand.type == SPV_OPERAND_TYPE_ID) {
+                LiveRange& range = mLiveRanges[words[operand.offset]];
+                range.first = std::min(range.first, mPosition);
+                range.last = std::max(range.last, mPosition);
+            }
+        }
+        if (instruction.result_id && instruction.type_id && op != OpVariable) {
+            LiveRange& range = mLiveRanges[instruction.result_id];
+            range.first = std::min(range.first, mPosition);
+            range.last = std::max(range.last, mPosition);
+            range.size = getTypeSize(instruction.type_id);
+        }
+        mPosition++;
+    }
+
+    uint32_t getTypeSize(uint32_t typeId) const {
+        auto pos = mTypeSizes.find(typeId);
+        return pos != mTypeSizes.end() ? pos->second : 1;
+    }
+
+    // the largest sum of the sizes of the values live at the same position, the values defined
+    // outside of the function (e.g. the constants) aren't counted
+    uint32_t getMaxLiveScalars() const {
+        std::vector<int64_t> deltas(mPosition + 1);
+        for (auto const& item : mLiveRanges) {
+            LiveRange const& range = item.second;
+            if (range.size) {
+                deltas[range.first] += range.size;
+                deltas[range.last + 1] -= range.size;
+            }
+        }
+        int64_t live = 0;
+        int64_t maxLive = 0;
+        for (int64_t delta : deltas) {
+            live += delta;
+            maxLive = std::max(maxLive, live);
+        }
+        return uint32_t(maxLive);
+    }
+
+    ShaderCost& mCost;
+    tsl::robin_map<uint32_t, uint32_t> mTypeSizes;
+    tsl::robin_map<uint32_t, LiveRange> mLiveRanges;
+    uint32_t mPosition = 0;
+    bool mInFunction = false;
+};
+
+} // anonymous namespace
+
+bool getShaderCost(const uint32_t* words, size_t wordCount, ShaderCost* cost) {
+    *cost = {};
+    CostAnalyzer analyzer(cost);
+    spv_context context = spvContextCreate(SPV_ENV_UNIVERSAL_1_0);
+    const spv_result_t result = spvBinaryParse(context, &analyzer, words, wordCount,
+            nullptr, &CostAnalyzer::parseInstruction, nullptr);
+    spvContextDestroy(context);
+    return result == SPV_SUCCESS;
+}
+
+bool getVkShaderCosts(filaflat::ChunkContainer const& container, ShaderCost* costs) {
+    ShaderExtractor parser(backend::Backend::VULKAN, container.getData(), container.getSize());
+    if (!parser.parse()) {
+        return false;
+    }
+
+    std::vector<ShaderInfo> info(getShaderCount(container, filamat::ChunkType::MaterialSpirv));
+    if (!getVkShaderInfo(container, info.data())) {
+        return false;
+    }
+
+    filaflat::ShaderBuilder builder;
+    for (size_t i = 0; i < info.size(); i++) {
+        ShaderInfo const& item = info[i];
+        if (!parser.getShader(item.shaderModel, item.variant, item.pipelineStage, builder)) {
+            return false;
+        }
+        uint32_t const* words = reinterpret_cast<uint32_t const*>(builder.data());
+        if (!getShaderCost(words, builder.size() / 4, &costs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace matdbg
+} // namespace filament
@@ -80,6 +80,11 @@ bool ShaderExtractor::getShader(ShaderModel shaderModel,
         return false;
     }
 
+    // the lines of the shared dictionary are not in the package
+    if (mDictionaryTag == ChunkType::DictionaryText && cc.hasChunk(ChunkType::DictionaryShared)) {
+        return false;
+    }
+
     BlobDictionary blobDictionary;
     if (!DictionaryReader::unflatten(cc, mDictionaryTag, blobDictionary)) {
         return false;
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/simd.h>
+
+#include <vector>
+
+using namespace filament::math;
+
+struct Generic{};
+struct Simd{};
+
+static constexpr size_t COUNT = 1024;
+
+UTILS_NOINLINE
+static void init(std::vector<mat4f>& v) noexcept {
+    for (size_t i = 0; i < v.size(); i++) {
+        const float a = float(i + 1) / float(v.size() + 1);
+        v[i] = mat4f::rotation(a * 6.0f, float3{ a, 1.0f, 1.0f - a }) *
+               mat4f::scaling(float3{ 1.0f + a, 1.0f, 2.0f - a });
+        v[i][3] = { a, 2.0f * a, -a, 1.0f };
+    }
+}
+
+template <typename A>
+static void BM_mat4_multiply(benchmark::State& state) noexcept {
+    std::vector<mat4f> a(COUNT), b(COUNT), res(COUNT);
+    init(a);
+    init(b);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            for (size_t i = 0; i < COUNT; i++) {
+                if (std::is_same<A, Simd>::value) {
+                    simd::multiply(res[i], a[i], b[COUNT - 1 - i]);
+                } else {
+                    res[i] = a[i] * b[COUNT - 1 - i];
+                }
+            }
+            benchmark::ClobberMemory();
+            benchmark::DoNotOptimize(res);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * COUNT);
+    }
+}
+
+template <typename A>
+static void BM_mat4_multiply_vector(benchmark::State& state) noexcept {
+    std::vector<mat4f> m(COUNT);
+    std::vector<float4> res(COUNT);
+    init(m);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            for (size_t i = 0; i < COUNT; i++) {
+                const float4 v = { float(i), 1.0f, 2.0f, 1.0f };
+                if (std::is_same<A, Simd>::value) {
+                    res[i] = simd::multiply(m[i], v);
+                } else {
+                    res[i] = m[i] * v;
+                }
+            }
+            benchmark::ClobberMemory();
+            benchmark::DoNotOptimize(res);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * COUNT);
+    }
+}
+
+template <typename A>
+static void BM_mat4_affine_inverse(benchmark::State& state) noexcept {
+    std::vector<mat4f> m(COUNT), res(COUNT);
+    init(m);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            for (size_t i = 0; i < COUNT; i++) {
+                if (std::is_same<A, Simd>::value) {
+                    res[i] = simd::affineInverse(m[i]);
+                } else {
+                    res[i] = inverse(m[i]);
+                }
+            }
+            benchmark::ClobberMemory();
+            benchmark::DoNotOptimize(res);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * COUNT);
+    }
+}
+
+template <typename A>
+static void BM_box_rigid_transform(benchmark::State& state) noexcept {
+    std::vector<mat4f> m(COUNT);
+    std::vector<float3> centers(COUNT), halfExtents(COUNT);
+    std::vector<float3> outCenters(COUNT), outHalfExtents(COUNT);
+    init(m);
+    for (size_t i = 0; i < COUNT; i++) {
+        centers[i] = { float(i), 1.0f, -1.0f };
+        halfExtents[i] = { 1.0f, 2.0f, float(i) };
+    }
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            if (std::is_same<A, Simd>::value) {
+                simd::rigidTransform(outCenters.data(), outHalfExtents.data(),
+                        m.data(), centers.data(), halfExtents.data(), COUNT);
+            } else {
+                for (size_t i = 0; i < COUNT; i++) {
+                    const mat3f u(m[i].upperLeft());
+                    outCenters[i] = u * centers[i] + m[i][3].xyz;
+                    outHalfExtents[i] = abs(u) * halfExtents[i];
+                }
+            }
+            benchmark::ClobberMemory();
+            benchmark::DoNotOptimize(outCenters);
+            benchmark::DoNotOptimize(outHalfExtents);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * COUNT);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_mat4_multiply, Generic);
+BENCHMARK_TEMPLATE(BM_mat4_multiply, Simd);
+
+BENCHMARK_TEMPLATE(BM_mat4_multiply_vector, Generic);
+BENCHMARK_TEMPLATE(BM_mat4_multiply_vector, Simd);
+
+BENCHMARK_TEMPLATE(BM_mat4_affine_inverse, Generic);
+BENCHMARK_TEMPLATE(BM_mat4_affine_inverse, Simd);
+
+BENCHMARK_TEMPLATE(BM_box_rigid_transform, Generic);
+BENCHMARK_TEMPLATE(BM_box_rigid_transform, Simd);
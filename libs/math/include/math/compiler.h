@@ -71,6 +71,14 @@
 #   define MATH_PURE
 #endif
 
+#if defined(_MSC_VER) && _MSC_VER >= 1900
+#   define MATH_RESTRICT __restrict
+#elif (defined(__clang__) || defined(__GNUC__))
+#   define MATH_RESTRICT __restrict__
+#else
+#   define MATH_RESTRICT
+#endif
+
 #ifdef _MSC_VER
 #   define MATH_EMPTY_BASES __declspec(empty_bases)
 
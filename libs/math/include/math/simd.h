@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_MATH_SIMD_H
+#define TNT_MATH_SIMD_H
+
+#include <math/compiler.h>
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <stddef.h>
+
+#if defined(__wasm_simd128__)
+    // Emscripten can also emulate SSE, but the native instructions are a better match
+#   include <wasm_simd128.h>
+#   define MATH_SIMD_WASM 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <immintrin.h>
+#   define MATH_SIMD_SSE 1
+#   if defined(__AVX__)
+#       define MATH_SIMD_AVX 1
+#   endif
+#elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define MATH_SIMD_NEON 1
+#endif
+
+/*
+ * mat4f operations written with SSE, AVX, NEON or WebAssembly SIMD intrinsics, for the hot paths that the
+ * compilers only partially vectorize. The operators of mat4f stay constexpr and generic, these
+ * are never constexpr.
+ *
+ * The results match the generic operators: no fused multiply-add is used, and the products are
+ * summed in the same order.
+ */
+
+namespace filament {
+namespace math {
+namespace simd {
+
+namespace details {
+
+#if defined(MATH_SIMD_SSE)
+
+inline __m128 MATH_PURE load(float4 const& v) noexcept {
+    return _mm_loadu_ps(&v[0]);
+}
+
+// the w component is 0
+inline __m128 MATH_PURE load(float3 const& v) noexcept {
+    return _mm_set_ps(0.0f, v.z, v.y, v.x);
+}
+
+inline void store(float4& out, __m128 v) noexcept {
+    _mm_storeu_ps(&out[0], v);
+}
+
+inline void store(float3& out, __m128 v) noexcept {
+    float4 t;
+    _mm_storeu_ps(&t[0], v);
+    out = t.xyz;
+}
+
+inline __m128 MATH_PURE add(__m128 a, __m128 b) noexcept {
+    return _mm_add_ps(a, b);
+}
+
+inline __m128 MATH_PURE abs(__m128 v) noexcept {
+    return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+// a.x * c0 + a.y * c1 + a.z * c2 (+ a.w * c3)
+inline __m128 MATH_PURE combine(__m128 c0, __m128 c1, __m128 c2, __m128 a) noexcept {
+    __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1))));
+    return _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+inline __m128 MATH_PURE combine(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 a) noexcept {
+    return _mm_add_ps(combine(c0, c1, c2, a),
+            _mm_mul_ps(c3, _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+// (y, z, x, w)
+inline __m128 MATH_PURE yzx(__m128 v) noexcept {
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// with a.w == b.w == 0, the w component is 0
+inline __m128 MATH_PURE cross(__m128 a, __m128 b) noexcept {
+    return yzx(_mm_sub_ps(_mm_mul_ps(a, yzx(b)), _mm_mul_ps(yzx(a), b)));
+}
+
+#elif defined(MATH_SIMD_NEON)
+
+inline float32x4_t MATH_PURE load(float4 const& v) noexcept {
+    return vld1q_f32(&v[0]);
+}
+
+// the w component is 0
+inline float32x4_t MATH_PURE load(float3 const& v) noexcept {
+    return vcombine_f32(vld1_f32(&v[0]), vset_lane_f32(v.z, vdup_n_f32(0.0f), 0));
+}
+
+inline void store(float4& out, float32x4_t v) noexcept {
+    vst1q_f32(&out[0], v);
+}
+
+inline void store(float3& out, float32x4_t v) noexcept {
+    vst1_f32(&out[0], vget_low_f32(v));
+    out.z = vgetq_lane_f32(v, 2);
+}
+
+inline float32x4_t MATH_PURE add(float32x4_t a, float32x4_t b) noexcept {
+    return vaddq_f32(a, b);
+}
+
+inline float32x4_t MATH_PURE abs(float32x4_t v) noexcept {
+    return vabsq_f32(v);
+}
+
+// a.x * c0 + a.y * c1 + a.z * c2 (+ a.w * c3)
+inline float32x4_t MATH_PURE combine(float32x4_t c0, float32x4_t c1, float32x4_t c2,
+        float32x4_t a) noexcept {
+    float32x4_t r = vmulq_lane_f32(c0, vget_low_f32(a), 0);
+    r = vaddq_f32(r, vmulq_lane_f32(c1, vget_low_f32(a), 1));
+    return vaddq_f32(r, vmulq_lane_f32(c2, vget_high_f32(a), 0));
+}
+
+inline float32x4_t MATH_PURE combine(float32x4_t c0, float32x4_t c1, float32x4_t c2,
+        float32x4_t c3, float32x4_t a) noexcept {
+    return vaddq_f32(combine(c0, c1, c2, a), vmulq_lane_f32(c3, vget_high_f32(a), 1));
+}
+
+// (y, z, x, w)
+inline float32x4_t MATH_PURE yzx(float32x4_t v) noexcept {
+    // (y, z, w, x) then (y, z, x, w)
+    const float32x4_t t = vextq_f32(v, v, 1);
+    return vsetq_lane_f32(vgetq_lane_f32(v, 3),
+            vsetq_lane_f32(vgetq_lane_f32(v, 0), t, 2), 3);
+}
+
+// with a.w == b.w == 0, the w component is 0
+inline float32x4_t MATH_PURE cross(float32x4_t a, float32x4_t b) noexcept {
+    return yzx(vsubq_f32(vmulq_f32(a, yzx(b)), vmulq_f32(yzx(a), b)));
+}
+
+#elif defined(MATH_SIMD_WASM)
+
+inline v128_t MATH_PURE load(float4 const& v) noexcept {
+    return wasm_v128_load(&v[0]);
+}
+
+// the w component is 0
+inline v128_t MATH_PURE load(float3 const& v) noexcept {
+    return wasm_f32x4_make(v.x, v.y, v.z, 0.0f);
+}
+
+inline void store(float4& out, v128_t v) noexcept {
+    wasm_v128_store(&out[0], v);
+}
+
+inline void store(float3& out, v128_t v) noexcept {
+    out.x = wasm_f32x4_extract_lane(v, 0);
+    out.y = wasm_f32x4_extract_lane(v, 1);
+    out.z = wasm_f32x4_extract_lane(v, 2);
+}
+
+inline v128_t MATH_PURE add(v128_t a, v128_t b) noexcept {
+    return wasm_f32x4_add(a, b);
+}
+
+inline v128_t MATH_PURE abs(v128_t v) noexcept {
+    return wasm_f32x4_abs(v);
+}
+
+// a.x * c0 + a.y * c1 + a.z * c2 (+ a.w * c3)
+inline v128_t MATH_PURE combine(v128_t c0, v128_t c1, v128_t c2, v128_t a) noexcept {
+    v128_t r = wasm_f32x4_mul(c0, wasm_i32x4_shuffle(a, a, 0, 0, 0, 0));
+    r = wasm_f32x4_add(r, wasm_f32x4_mul(c1, wasm_i32x4_shuffle(a, a, 1, 1, 1, 1)));
+    return wasm_f32x4_add(r, wasm_f32x4_mul(c2, wasm_i32x4_shuffle(a, a, 2, 2, 2, 2)));
+}
+
+inline v128_t MATH_PURE combine(v128_t c0, v128_t c1, v128_t c2, v128_t c3, v128_t a) noexcept {
+    return wasm_f32x4_add(combine(c0, c1, c2, a),
+            wasm_f32x4_mul(c3, wasm_i32x4_shuffle(a, a, 3, 3, 3, 3)));
+}
+
+// (y, z, x, w)
+inline v128_t MATH_PURE yzx(v128_t v) noexcept {
+    return wasm_i32x4_shuffle(v, v, 1, 2, 0, 3);
+}
+
+// with a.w == b.w == 0, the w component is 0
+inline v128_t MATH_PURE cross(v128_t a, v128_t b) noexcept {
+    return yzx(wasm_f32x4_sub(wasm_f32x4_mul(a, yzx(b)), wasm_f32x4_mul(yzx(a), b)));
+}
+
+#endif
+
+} // namespace details
+
+/*
+ * out = a * b
+ * out can't alias a or b.
+ */
+inline void multiply(mat4f& MATH_RESTRICT out,
+        mat4f const& MATH_RESTRICT a, mat4f const& MATH_RESTRICT b) noexcept {
+#if defined(MATH_SIMD_AVX)
+    // two columns of the result at a time
+    const __m256 a0 = _mm256_broadcast_ps((__m128 const*)&a[0][0]);
+    const __m256 a1 = _mm256_broadcast_ps((__m128 const*)&a[1][0]);
+    const __m256 a2 = _mm256_broadcast_ps((__m128 const*)&a[2][0]);
+    const __m256 a3 = _mm256_broadcast_ps((__m128 const*)&a[3][0]);
+    for (size_t j = 0; j < 4; j += 2) {
+        const __m256 bj = _mm256_loadu_ps(&b[j][0]);
+        __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(bj, 0x00));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(bj, 0x55)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(bj, 0xAA)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(bj, 0xFF)));
+        _mm256_storeu_ps(&out[j][0], r);
+    }
+#elif defined(MATH_SIMD_SSE) || defined(MATH_SIMD_NEON) || defined(MATH_SIMD_WASM)
+    using namespace details;
+    const auto a0 = load(a[0]);
+    const auto a1 = load(a[1]);
+    const auto a2 = load(a[2]);
+    const auto a3 = load(a[3]);
+    for (size_t j = 0; j < 4; j++) {
+        store(out[j], combine(a0, a1, a2, a3, load(b[j])));
+    }
+#else
+    out = a * b;
+#endif
+}
+
+inline mat4f MATH_PURE multiply(mat4f const& a, mat4f const& b) noexcept {
+    mat4f out;
+    multiply(out, a, b);
+    return out;
+}
+
+// m * v
+inline float4 MATH_PURE multiply(mat4f const& m, float4 const& v) noexcept {
+#if defined(MATH_SIMD_SSE) || defined(MATH_SIMD_NEON) || defined(MATH_SIMD_WASM)
+    using namespace details;
+    float4 out;
+    store(out, combine(load(m[0]), load(m[1]), load(m[2]), load(m[3]), load(v)));
+    return out;
+#else
+    return m * v;
+#endif
+}
+
+/*
+ * Inverse of an affine transform, i.e. whose last row is (0, 0, 0, 1). Unlike the inverse of a
+ * rigid transform, the upper-left 3x3 matrix can have scales and shears. The result is undefined
+ * if the matrix isn't affine or invertible.
+ */
+inline mat4f MATH_PURE affineInverse(mat4f const& m) noexcept {
+#if defined(MATH_SIMD_SSE) || defined(MATH_SIMD_NEON) || defined(MATH_SIMD_WASM)
+    using namespace details;
+    const auto c0 = load(m[0].xyz);
+    const auto c1 = load(m[1].xyz);
+    const auto c2 = load(m[2].xyz);
+
+    // the rows of the inverse are the cross products of the columns, divided by the determinant
+    const auto r0 = cross(c1, c2);
+    const auto r1 = cross(c2, c0);
+    const auto r2 = cross(c0, c1);
+    float3 d;
+    store(d, r0);
+    const float invDet = 1.0f / dot(m[0].xyz, d);
+
+    float3 rows[3];
+    store(rows[0], r0);
+    store(rows[1], r1);
+    store(rows[2], r2);
+    const mat3f inv = transpose(mat3f{ rows[0], rows[1], rows[2] }) * invDet;
+
+    float3 t;
+    store(t, combine(load(inv[0]), load(inv[1]), load(inv[2]), load(m[3].xyz)));
+    return mat4f{ inv, -t };
+#else
+    const mat3f inv = inverse(m.upperLeft());
+    return mat4f{ inv, -(inv * m[3].xyz) };
+#endif
+}
+
+/*
+ * Computes the bounding box, as a center and a half extent, of a box transformed by a rigid
+ * transform. This is the same as filament::rigidTransform(Box const&, mat4f const&).
+ */
+inline void rigidTransform(float3& MATH_RESTRICT outCenter, float3& MATH_RESTRICT outHalfExtent,
+        mat4f const& m, float3 const& center, float3 const& halfExtent) noexcept {
+#if defined(MATH_SIMD_SSE) || defined(MATH_SIMD_NEON) || defined(MATH_SIMD_WASM)
+    using namespace details;
+    const auto c0 = load(m[0].xyz);
+    const auto c1 = load(m[1].xyz);
+    const auto c2 = load(m[2].xyz);
+    store(outCenter, add(combine(c0, c1, c2, load(center)), load(m[3].xyz)));
+    store(outHalfExtent, combine(abs(c0), abs(c1), abs(c2), load(halfExtent)));
+#else
+    const mat3f u(m.upperLeft());
+    outCenter = u * center + m[3].xyz;
+    outHalfExtent = abs(u) * halfExtent;
+#endif
+}
+
+/*
+ * Transforms 'count' boxes, box i by transforms[i]. The outputs can't alias the inputs.
+ */
+inline void rigidTransform(float3* MATH_RESTRICT outCenters, float3* MATH_RESTRICT outHalfExtents,
+        mat4f const* transforms, float3 const* centers, float3 const* halfExtents,
+        size_t count) noexcept {
+    for (size_t i = 0; i < count; i++) {
+        rigidTransform(outCenters[i], outHalfExtents[i], transforms[i], centers[i], halfExtents[i]);
+    }
+}
+
+/*
+ * Transforms 'count' boxes in place, box i by transforms[i].
+ */
+inline void rigidTransform(float3* centers, float3* halfExtents,
+        mat4f const* transforms, size_t count) noexcept {
+    for (size_t i = 0; i < count; i++) {
+        const float3 center = centers[i];
+        const float3 halfExtent = halfExtents[i];
+        rigidTransform(centers[i], halfExtents[i], transforms[i], center, halfExtent);
+    }
+}
+
+} // namespace simd
+} // namespace math
+} // namespace filament
+
+#endif // TNT_MATH_SIMD_H
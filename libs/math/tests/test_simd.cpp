@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/simd.h>
+
+#include <functional>
+#include <random>
+
+using namespace filament::math;
+
+class SimdTest : public testing::Test {
+protected:
+    std::default_random_engine generator{ 82828 }; // NOLINT
+    std::uniform_real_distribution<float> distribution{ -10.0f, 10.0f };
+
+    float rand() { return distribution(generator); }
+
+    // a random affine transform with scales and shears
+    mat4f affine() {
+        mat4f m = mat4f::rotation(rand(), float3{ rand(), rand(), rand() });
+        m[0] *= 1.0f + std::abs(rand());
+        m[1] += m[0] * 0.1f * rand();
+        m[2] *= 0.1f + std::abs(rand());
+        m[3] = { rand(), rand(), rand(), 1.0f };
+        return m;
+    }
+
+    mat4f rigid() {
+        mat4f m = mat4f::rotation(rand(), float3{ rand(), rand(), rand() });
+        m[3] = { rand(), rand(), rand(), 1.0f };
+        return m;
+    }
+};
+
+#define EXPECT_MAT4_NEAR(M1, M2, EPS)                           \
+    for (size_t c = 0; c < 4; c++) {                            \
+        for (size_t r = 0; r < 4; r++) {                        \
+            EXPECT_NEAR((M1)[c][r], (M2)[c][r], EPS);           \
+        }                                                       \
+    }
+
+TEST_F(SimdTest, Multiply) {
+    for (size_t i = 0; i < 100; i++) {
+        const mat4f a = affine();
+        const mat4f b = affine();
+        const mat4f expected = a * b;
+        EXPECT_MAT4_NEAR(simd::multiply(a, b), expected, 1e-4f);
+
+        mat4f out;
+        simd::multiply(out, a, b);
+        EXPECT_MAT4_NEAR(out, expected, 1e-4f);
+    }
+}
+
+TEST_F(SimdTest, MultiplyVector) {
+    for (size_t i = 0; i < 100; i++) {
+        const mat4f m = affine();
+        const float4 v = { rand(), rand(), rand(), rand() };
+        const float4 expected = m * v;
+        const float4 actual = simd::multiply(m, v);
+        EXPECT_FLOAT_EQ(actual.x, expected.x);
+        EXPECT_FLOAT_EQ(actual.y, expected.y);
+        EXPECT_FLOAT_EQ(actual.z, expected.z);
+        EXPECT_FLOAT_EQ(actual.w, expected.w);
+    }
+}
+
+TEST_F(SimdTest, AffineInverse) {
+    for (size_t i = 0; i < 100; i++) {
+        const mat4f m = affine();
+        EXPECT_MAT4_NEAR(simd::affineInverse(m), inverse(m), 1e-3f);
+        EXPECT_MAT4_NEAR(simd::multiply(m, simd::affineInverse(m)), mat4f{}, 1e-4f);
+    }
+}
+
+TEST_F(SimdTest, RigidTransform) {
+    mat4f transforms[16];
+    float3 centers[16];
+    float3 halfExtents[16];
+    for (size_t i = 0; i < 16; i++) {
+        transforms[i] = rigid();
+        centers[i] = { rand(), rand(), rand() };
+        halfExtents[i] = abs(float3{ rand(), rand(), rand() });
+    }
+
+    float3 outCenters[16];
+    float3 outHalfExtents[16];
+    simd::rigidTransform(outCenters, outHalfExtents, transforms, centers, halfExtents, 16);
+
+    for (size_t i = 0; i < 16; i++) {
+        const mat3f u = transforms[i].upperLeft();
+        const float3 center = u * centers[i] + transforms[i][3].xyz;
+        const float3 halfExtent = abs(u) * halfExtents[i];
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_FLOAT_EQ(outCenters[i][j], center[j]);
+            EXPECT_FLOAT_EQ(outHalfExtents[i][j], halfExtent[j]);
+        }
+    }
+}
+
+TEST_F(SimdTest, RigidTransformInPlace) {
+    mat4f transforms[16];
+    float3 centers[16];
+    float3 halfExtents[16];
+    for (size_t i = 0; i < 16; i++) {
+        transforms[i] = rigid();
+        centers[i] = { rand(), rand(), rand() };
+        halfExtents[i] = abs(float3{ rand(), rand(), rand() });
+    }
+
+    float3 outCenters[16];
+    float3 outHalfExtents[16];
+    simd::rigidTransform(outCenters, outHalfExtents, transforms, centers, halfExtents, 16);
+    simd::rigidTransform(centers, halfExtents, transforms, 16);
+
+    for (size_t i = 0; i < 16; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            EXPECT_EQ(centers[i][j], outCenters[i][j]);
+            EXPECT_EQ(halfExtents[i][j], outHalfExtents[i][j]);
+        }
+    }
+}
@@ -391,15 +391,18 @@ using ThreadSafeObjectPoolAllocator = PoolAllocator<sizeof(T),
 
 class HeapArea {
 public:
+    struct Options {
+        // back the area with transparent huge pages where supported, to reduce TLB misses
+        bool hugePages = false;
+        // touch every page of the area upfront, so that its first use doesn't page fault
+        bool prefault = false;
+    };
+
     HeapArea() noexcept = default;
 
-    explicit HeapArea(size_t size) {
-        if (size) {
-            // TODO: policy committing memory
-            mBegin = malloc(size);
-            mEnd = pointermath::add(mBegin, size);
-        }
-    }
+    explicit HeapArea(size_t size) : HeapArea(size, Options{}) { }
+
+    HeapArea(size_t size, Options options);
 
     ~HeapArea() noexcept {
         // TODO: policy for returning memory to system
@@ -476,6 +479,8 @@ struct HighWatermark {
     void onFree(void* p, size_t size) noexcept;
     void onReset() noexcept;
     void onRewind(void const* addr) noexcept;
+    // largest amount of memory allocated at once so far, in bytes
+    size_t getHighWatermark() const noexcept { return mHighWaterMark; }
 protected:
     const char* mName = nullptr;
     void* mBase = nullptr;
@@ -503,6 +508,7 @@ struct DebugAndHighWatermark : protected HighWatermark, protected Debug {
     DebugAndHighWatermark() noexcept = default;
     DebugAndHighWatermark(const char* name, void* base, size_t size) noexcept
             : HighWatermark(name, base, size), Debug(name, base, size) { }
+    using HighWatermark::getHighWatermark;
     void onAlloc(void* p, size_t size, size_t alignment, size_t extra) noexcept {
         HighWatermark::onAlloc(p, size, alignment, extra);
         Debug::onAlloc(p, size, alignment, extra);
@@ -543,6 +549,15 @@ public:
               mArenaName(name) {
     }
 
+    // same as above, with options for the memory backing the arena
+    template<typename ... ARGS>
+    Arena(const char* name, size_t size, HeapArea::Options options, ARGS&& ... args)
+            : mArea(size, options),
+              mAllocator(mArea, std::forward<ARGS>(args) ... ),
+              mListener(name, mArea.data(), size),
+              mArenaName(name) {
+    }
+
     // allocate memory from arena with given size and alignment
     // (acceptable size/alignment may depend on the allocator provided)
     void* alloc(size_t size, size_t alignment = alignof(std::max_align_t), size_t extra = 0) noexcept {
@@ -23,10 +23,18 @@
 #include <utils/Entity.h>
 #include <utils/compiler.h>
 
+#include <atomic>
+
 #ifndef FILAMENT_UTILS_TRACK_ENTITIES
 #define FILAMENT_UTILS_TRACK_ENTITIES false
 #endif
 
+// Number of bits of an Entity used for its index, which sets the maximum number of entities that
+// can exist at the same time. This must be the same for utils and all the code using it.
+#ifndef FILAMENT_UTILS_ENTITY_INDEX_BITS
+#define FILAMENT_UTILS_ENTITY_INDEX_BITS 17
+#endif
+
 #if FILAMENT_UTILS_TRACK_ENTITIES
 #include <utils/ostream.h>
 #include <vector>
@@ -77,7 +85,8 @@ public:
     // Thread safe.
     bool isAlive(Entity e) const noexcept {
         assert(getIndex(e) < RAW_INDEX_COUNT);
-        return (!e.isNull()) && (getGeneration(e) == mGens[getIndex(e)]);
+        return (!e.isNull()) &&
+                (getGeneration(e) == mGens[getIndex(e)].load(std::memory_order_relaxed));
     }
 
     // registers a listener to be called when an entity is destroyed. thread safe.
@@ -90,9 +99,14 @@ public:
 
     /* no user serviceable parts below */
 
+    // index of an Entity, at most getMaxEntityCount(). Use for lookup tables.
+    static size_t getEntityIndex(Entity e) noexcept {
+        return getIndex(e);
+    }
+
     // current generation of the given index. Use for debugging and testing.
     uint8_t getGenerationForIndex(size_t index) const noexcept {
-        return mGens[index];
+        return mGens[index].load(std::memory_order_relaxed);
     }
     // singleton, can't be copied
     EntityManager(const EntityManager& rhs) = delete;
@@ -110,7 +124,10 @@ private:
 
     // GENERATION_SHIFT determines how many simultaneous Entities are available, the
     // minimum memory requirement is 2^GENERATION_SHIFT bytes.
-    static constexpr const int GENERATION_SHIFT = 17;
+    // Generations are 8 bits, they must fit above the index.
+    static constexpr const int GENERATION_SHIFT = FILAMENT_UTILS_ENTITY_INDEX_BITS;
+    static_assert(GENERATION_SHIFT >= 10 && GENERATION_SHIFT <= 24,
+            "FILAMENT_UTILS_ENTITY_INDEX_BITS must be between 10 and 24");
     static constexpr const size_t RAW_INDEX_COUNT = (1 << GENERATION_SHIFT);
     static constexpr const Entity::Type INDEX_MASK = (1 << GENERATION_SHIFT) - 1u;
 
@@ -125,7 +142,7 @@ private:
     }
 
     // stores the generation of each index.
-    uint8_t * const mGens;
+    std::atomic<uint8_t>* const mGens;
 };
 
 } // namespace utils
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_JOBEXECUTOR_H
+#define TNT_UTILS_JOBEXECUTOR_H
+
+#include <stddef.h>
+
+namespace utils {
+
+/*
+ * Interface to an external task scheduler, which lends its threads to a JobSystem instead of
+ * the JobSystem starting threads of its own (see JobSystem::Config::executor). This avoids
+ * oversubscribing the CPUs when the application already runs a thread pool.
+ *
+ * The JobSystem keeps its own work queues, jobs are still created, run and waited on with the
+ * JobSystem API (and jobs::parallel_for). When jobs are queued, it dispatches "helper" tasks to
+ * the executor, each of them runs jobs until there are none left and then returns the thread.
+ *
+ * The executor must outlive the JobSystem and run every task it is given, the JobSystem
+ * destructor waits for them to return.
+ */
+class JobExecutor {
+public:
+    using Task = void(*)(void* user);
+
+    virtual ~JobExecutor() noexcept;
+
+    // Number of tasks the executor can run concurrently on behalf of the JobSystem, this is the
+    // number of helper tasks in flight at most. It's queried once, when the JobSystem is created.
+    virtual size_t getConcurrency() const noexcept = 0;
+
+    // Runs task(user) asynchronously on one of the executor's threads. This must not wait for
+    // the task to complete. Tasks may block for a short while when the jobs they run wait on
+    // other jobs.
+    virtual void dispatch(Task task, void* user) noexcept = 0;
+};
+
+} // namespace utils
+
+#endif // TNT_UTILS_JOBEXECUTOR_H
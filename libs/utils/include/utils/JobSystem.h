@@ -30,6 +30,7 @@
 #include <utils/architecture.h>
 #include <utils/compiler.h>
 #include <utils/Condition.h>
+#include <utils/JobExecutor.h>
 #include <utils/Log.h>
 #include <utils/memalign.h>
 #include <utils/Mutex.h>
@@ -39,11 +40,37 @@
 namespace utils {
 
 class JobSystem {
-    static constexpr size_t MAX_JOB_COUNT = 4096;
-    static_assert(MAX_JOB_COUNT <= 0x7FFE, "MAX_JOB_COUNT must be <= 0x7FFE");
-    using WorkQueue = WorkStealingDequeue<uint16_t, MAX_JOB_COUNT>;
+    using WorkQueue = WorkStealingDequeue<uint16_t, 0>;
 
 public:
+    // jobs are referenced by 15-bits indices, this is the upper bound of maxJobCount
+    static constexpr size_t MAX_JOB_COUNT = 0x7FFE;
+    static constexpr size_t DEFAULT_MAX_JOB_COUNT = 4096;
+
+    enum class Priority {
+        NORMAL,
+        DISPLAY,
+        URGENT_DISPLAY
+    };
+
+    struct Config {
+        // # of threads in the pool, 0 picks a value based on the number of CPUs
+        size_t threadCount = 0;
+        // # of threads that can be adopted
+        size_t adoptableThreadsCount = 1;
+        // # of jobs that can exist at the same time, clamped to MAX_JOB_COUNT
+        size_t maxJobCount = DEFAULT_MAX_JOB_COUNT;
+        // CPUs the pool threads run on (bit N is CPU N), each thread is pinned to one of them in
+        // turn. 0 pins thread N to CPU N. See getBigCoresMask().
+        uint64_t affinityMask = 0;
+        // priority of the pool threads, low priority jobs always run at Priority::NORMAL
+        Priority priority = Priority::DISPLAY;
+        // when set, the pool doesn't start threads, it borrows up to
+        // executor->getConcurrency() threads of the executor instead (threadCount, affinityMask
+        // and priority are ignored). The executor must outlive the JobSystem.
+        JobExecutor* executor = nullptr;
+    };
+
     class Job;
 
     using JobFunc = void(*)(void*, JobSystem&, Job*);
@@ -72,11 +99,17 @@ public:
         uint16_t parent;                                        //  2 |  2
         std::atomic<uint16_t> runningJobCount = { 1 };          //  2 |  2
         mutable std::atomic<uint16_t> refCount = { 1 };         //  2 |  2
-                                                                //  6 |  2 (padding)
+        bool lowPriority = false;                               //  1 |  1
+                                                                //  5 |  1 (padding)
                                                                 // 64 | 64
     };
 
-    explicit JobSystem(size_t threadCount = 0, size_t adoptableThreadsCount = 1) noexcept;
+    // maxJobCount is the number of jobs that can exist at the same time, clamped to
+    // MAX_JOB_COUNT. When this is reached, creating a job fails (returns nullptr).
+    explicit JobSystem(size_t threadCount = 0, size_t adoptableThreadsCount = 1,
+            size_t maxJobCount = DEFAULT_MAX_JOB_COUNT) noexcept;
+
+    explicit JobSystem(Config const& config) noexcept;
 
     ~JobSystem();
 
@@ -250,13 +283,18 @@ public:
      * Add job to this thread's execution queue. It's reference will drop automatically.
      * Current thread must be owned by JobSystem's thread pool. See adopt().
      *
+     * LOW_PRIORITY jobs are meant for background work (e.g. asset decoding). They are only
+     * picked by idle threads of the pool, or by threads waiting on a LOW_PRIORITY job, and run
+     * at a lower OS thread priority. When the pool has no threads of its own, they're regular
+     * jobs.
+     *
      * The job can't be used after this call.
      */
-    enum runFlags { DONT_SIGNAL = 0x1 };
+    enum runFlags { DONT_SIGNAL = 0x1, LOW_PRIORITY = 0x2 };
     void run(Job*& job, uint32_t flags = 0) noexcept;
     void run(Job*&& job, uint32_t flags = 0) noexcept { // allows run(createJob(...));
         Job* p = job;
-        run(p);
+        run(p, flags);
     }
 
     void signal() noexcept;
@@ -300,19 +338,52 @@ public:
     // set the name of the current thread (on OSes that support it)
     static void setThreadName(const char* threadName) noexcept;
 
-    enum class Priority {
-        NORMAL,
-        DISPLAY,
-        URGENT_DISPLAY
-    };
-
     static void setThreadPriority(Priority priority) noexcept;
     static void setThreadAffinityById(size_t id) noexcept;
 
+    // Returns the CPUs with the highest maximum frequency, i.e. the "big" cores of a big.LITTLE
+    // SoC, or 0 if that's unknown. All CPUs are returned when they're all the same.
+    static uint64_t getBigCoresMask() noexcept;
+
     size_t getParallelSplitCount() const noexcept {
         return mParallelSplitCount;
     }
 
+    size_t getThreadCount() const noexcept {
+        return mThreadCount;
+    }
+
+    size_t getMaxJobCount() const noexcept {
+        return mMaxJobCount;
+    }
+
+    // largest number of jobs that existed at the same time so far, this can be used to tune
+    // maxJobCount.
+    size_t getPeakJobCount() const noexcept {
+        return mPeakJobCount.load(std::memory_order_relaxed);
+    }
+
+    // Time in microseconds an idle thread keeps looking for new jobs before parking. Spinning
+    // cuts the latency of short dependent jobs at the cost of power. Defaults to 0, idle
+    // threads park immediately.
+    void setIdleSpinTime(uint32_t microseconds) noexcept {
+        mIdleSpinTime.store(microseconds, std::memory_order_relaxed);
+    }
+
+    uint32_t getIdleSpinTime() const noexcept {
+        return mIdleSpinTime.load(std::memory_order_relaxed);
+    }
+
+    struct IdleStats {
+        uint64_t spins = 0;             // # of times a spinning thread found work
+        uint64_t parks = 0;             // # of times a thread parked
+        uint64_t wakes = 0;             // # of times a parked thread resumed after a signal
+        uint64_t wakeLatencyNs = 0;     // total time between signals and threads resuming
+    };
+
+    // statistics about idle threads since this JobSystem was created
+    IdleStats getIdleStats() const noexcept;
+
 private:
     // this is just to avoid using std::default_random_engine, since we're in a public header.
     class default_random_engine {
@@ -330,6 +401,7 @@ private:
     struct alignas(CACHELINE_SIZE) ThreadState {    // this causes 40-bytes padding
         // make sure storage is cache-line aligned
         WorkQueue workQueue;
+        WorkQueue lowPriorityWorkQueue;
 
         // these are not accessed by the worker threads
         alignas(CACHELINE_SIZE)     // this causes 56-bytes padding
@@ -337,6 +409,7 @@ private:
         std::thread thread;
         default_random_engine rndGen;
         uint32_t id;
+        uint32_t cpu;           // CPU this thread is pinned to
     };
 
     static_assert(sizeof(ThreadState) % CACHELINE_SIZE == 0,
@@ -353,28 +426,31 @@ private:
 
     void requestExit() noexcept;
     bool exitRequested() const noexcept;
-    bool hasActiveJobs() const noexcept;
+    bool hasActiveJobs(bool lowPriority) const noexcept;
 
     void loop(ThreadState* state) noexcept;
-    bool execute(JobSystem::ThreadState& state) noexcept;
-    Job* steal(JobSystem::ThreadState& state) noexcept;
+    static void help(void* user) noexcept;
+    void help(ThreadState& state) noexcept;
+    void dispatchHelpers() noexcept;
+    bool execute(JobSystem::ThreadState& state, bool lowPriority) noexcept;
+    Job* steal(JobSystem::ThreadState& state, bool lowPriority) noexcept;
     void finish(Job* job) noexcept;
 
     void put(WorkQueue& workQueue, Job* job) noexcept {
         size_t index = job - mJobStorageBase;
-        assert(index >= 0 && index < MAX_JOB_COUNT);
+        assert(index >= 0 && index < mMaxJobCount);
         workQueue.push(uint16_t(index + 1));
     }
 
     Job* pop(WorkQueue& workQueue) noexcept {
         size_t index = workQueue.pop();
-        assert(index <= MAX_JOB_COUNT);
+        assert(index <= mMaxJobCount);
         return !index ? nullptr : &mJobStorageBase[index - 1];
     }
 
     Job* steal(WorkQueue& workQueue) noexcept {
         size_t index = workQueue.steal();
-        assert(index <= MAX_JOB_COUNT);
+        assert(index <= mMaxJobCount);
         return !index ? nullptr : &mJobStorageBase[index - 1];
     }
 
@@ -382,11 +458,20 @@ private:
     void wake() noexcept;
 
     // these have thread contention, keep them together
-    utils::Mutex mWaiterLock;
+    mutable utils::Mutex mWaiterLock;
     utils::Condition mWaiterCondition;
     uint32_t mWaiterCount = 0;
+    int64_t mWakeTime = 0;              // time of the last wake() with waiters, in ns
+    IdleStats mIdleStats;               // protected by mWaiterLock, except for spins
 
     std::atomic<uint32_t> mActiveJobs = { 0 };
+    std::atomic<uint32_t> mActiveLowPriorityJobs = { 0 };   // included in mActiveJobs
+    std::atomic<uint32_t> mJobCount = { 0 };                // allocated jobs
+    std::atomic<uint32_t> mPeakJobCount = { 0 };
+    std::atomic<uint32_t> mIdleSpinTime = { 0 };            // in microseconds
+    std::atomic<uint64_t> mIdleSpins = { 0 };
+    std::atomic<uint32_t> mIdleHelpers = { 0 };     // bit N: pool state N can be lent
+    std::atomic<uint32_t> mActiveHelpers = { 0 };   // helpers dispatched to the executor
     utils::Arena<utils::ThreadSafeObjectPoolAllocator<Job>, LockingPolicy::NoLock> mJobPool;
 
     template <typename T>
@@ -404,6 +489,9 @@ private:
     std::atomic<uint16_t> mAdoptedThreads = { 0 };      // this one is almost never written
     Job* const mJobStorageBase;                         // Base for conversion to indices
     uint16_t mThreadCount = 0;                          // total # of threads in the pool
+    uint16_t mMaxJobCount = 0;                          // # of jobs mJobPool can hold
+    Priority mPriority = Priority::DISPLAY;             // priority of the pool threads
+    JobExecutor* const mExecutor;                       // lends the pool threads, if any
     uint8_t mParallelSplitCount = 0;                    // # of split allowable in parallel_for
     Job* mRootJob = nullptr;
 
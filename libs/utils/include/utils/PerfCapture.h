@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_PERFCAPTURE_H
+#define TNT_UTILS_PERFCAPTURE_H
+
+#include <utils/compiler.h>
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+
+namespace io {
+class ostream;
+} // namespace io
+
+/*
+ * PerfCapture records the elapsed time and the hardware counters (instructions, cache misses
+ * and branch misses, see Profiler) of the thread running each SYSTRACE_NAME / SYSTRACE_CALL
+ * scope, and aggregates them into a report for each frame.
+ *
+ * The scopes are instrumented only when UTILS_PERF_CAPTURE is defined, which is done by the
+ * FILAMENT_ENABLE_PERF_CAPTURE CMake option. They record something only between start() and
+ * stop(), otherwise their cost is a single relaxed load.
+ *
+ * The counters of a scope include the ones of the scopes nested in it. Scopes that span frames
+ * are accounted for in the frame they end in. Hardware counters read 0 when perf events are
+ * not available (e.g. because of /proc/sys/kernel/perf_event_paranoid).
+ *
+ * e.g.:
+ *      PerfCapture::start("/data/local/tmp/perf.csv");
+ *      // render some frames
+ *      PerfCapture::stop();
+ */
+class UTILS_PUBLIC PerfCapture {
+    struct ThreadData;
+    struct Registry;
+
+public:
+    struct ScopeStats {
+        const char* name;
+        uint32_t calls;
+        uint64_t timeNs;
+        uint64_t instructions;
+        uint64_t cacheMisses;
+        uint64_t branchMisses;
+    };
+
+    // Called at the end of each frame with its report, sorted by decreasing time. 'stats' is
+    // only valid during the call.
+    using FrameCallback = void(*)(uint32_t frame,
+            ScopeStats const* stats, size_t count, void* user);
+
+    // Starts a capture. If 'path' isn't null, each frame's report is appended to this file
+    // as CSV. Returns false if the file couldn't be opened.
+    static bool start(const char* path = nullptr) noexcept;
+
+    // Ends the capture and closes the file.
+    static void stop() noexcept;
+
+    static bool isCapturing() noexcept {
+        return sCapturing.load(std::memory_order_relaxed);
+    }
+
+    // Sets the callback receiving each frame's report. Must not be called during a capture.
+    static void setFrameCallback(FrameCallback callback, void* user = nullptr) noexcept;
+
+    // Ends the current frame, this aggregates the scopes recorded by all threads since the
+    // previous call. Called by the engine once per frame.
+    static void endFrame() noexcept;
+
+    // Prints the report of the last ended frame.
+    static void dump(io::ostream& out) noexcept;
+
+    class Scope {
+    public:
+        Scope(uint32_t tag, const char* name) noexcept {
+            if (tag && UTILS_UNLIKELY(isCapturing())) {
+                begin(name);
+            }
+        }
+
+        ~Scope() noexcept {
+            if (UTILS_UNLIKELY(mThread)) {
+                end();
+            }
+        }
+
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+
+    private:
+        void begin(const char* name) noexcept;
+        void end() noexcept;
+
+        ThreadData* mThread = nullptr;
+        const char* mName = nullptr;
+        uint64_t mTime = 0;
+        uint64_t mInstructions = 0;
+        uint64_t mCacheMisses = 0;
+        uint64_t mBranchMisses = 0;
+    };
+
+private:
+    static ThreadData& getThreadData() noexcept;
+    static Registry& getRegistry() noexcept;
+
+    static std::atomic<bool> sCapturing;
+};
+
+} // namespace utils
+
+#endif // TNT_UTILS_PERFCAPTURE_H
@@ -24,6 +24,10 @@
 
 #include <tsl/robin_map.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -32,6 +36,94 @@ namespace utils {
 
 class EntityManager;
 
+namespace details {
+
+// Maps entities to instances with a hash map
+class HashedInstanceMap {
+public:
+    using Instance = EntityInstanceBase::Type;
+
+    UTILS_NOINLINE
+    Instance find(Entity e) const noexcept {
+        // find() generates quite a bit of code
+        auto pos = mMap.find(e);
+        return pos != mMap.end() ? pos->second : 0;
+    }
+
+    void set(Entity e, Instance i) {
+        mMap[e] = i;
+    }
+
+    void erase(Entity e) noexcept {
+        mMap.erase(e);
+    }
+
+private:
+    tsl::robin_map<Entity, Instance> mMap;
+};
+
+// Maps entities to instances with a table indexed by the entities' index, lookups don't need
+// hashing. An index can be used by a destroyed entity that still has a component and by a new
+// one until the garbage collection runs, the latter is then kept in a (rarely used) hash map.
+class SparseInstanceMap {
+public:
+    using Instance = EntityInstanceBase::Type;
+
+    Instance find(Entity e) const noexcept {
+        const size_t index = EntityManager::getEntityIndex(e);
+        if (UTILS_LIKELY(index < mSlots.size() && mSlots[index].entity == e)) {
+            return mSlots[index].instance;
+        }
+        return UTILS_UNLIKELY(!mOverflow.empty()) ? findOverflow(e) : 0;
+    }
+
+    void set(Entity e, Instance i) {
+        if (UTILS_UNLIKELY(!mOverflow.empty())) {
+            auto pos = mOverflow.find(e);
+            if (pos != mOverflow.end()) {
+                pos.value() = i;
+                return;
+            }
+        }
+        const size_t index = EntityManager::getEntityIndex(e);
+        if (UTILS_UNLIKELY(index >= mSlots.size())) {
+            mSlots.resize(std::max(index + 1, mSlots.size() * 2));
+        }
+        Slot& slot = mSlots[index];
+        if (UTILS_LIKELY(slot.entity.isNull() || slot.entity == e)) {
+            slot = { e, i };
+        } else {
+            mOverflow[e] = i;
+        }
+    }
+
+    void erase(Entity e) noexcept {
+        const size_t index = EntityManager::getEntityIndex(e);
+        if (index < mSlots.size() && mSlots[index].entity == e) {
+            mSlots[index] = {};
+        } else {
+            mOverflow.erase(e);
+        }
+    }
+
+private:
+    struct Slot {
+        Entity entity;
+        Instance instance = 0;
+    };
+
+    UTILS_NOINLINE
+    Instance findOverflow(Entity e) const noexcept {
+        auto pos = mOverflow.find(e);
+        return pos != mOverflow.end() ? pos->second : 0;
+    }
+
+    std::vector<Slot> mSlots;
+    tsl::robin_map<Entity, Instance> mOverflow;
+};
+
+} // namespace details
+
 /*
  * Helper class to create single instance component managers.
  *
@@ -42,9 +134,11 @@ class EntityManager;
  * and the real component manager is a public API, make sure to forward the public methods
  * to the implementation.
  *
+ * InstanceMap finds the instance of an entity, see SingleInstanceComponentManager and
+ * SparseSingleInstanceComponentManager below.
  */
-template <typename ... Elements>
-class UTILS_PUBLIC SingleInstanceComponentManager {
+template <typename InstanceMap, typename ... Elements>
+class UTILS_PUBLIC SingleInstanceComponentManagerBase {
 private:
 
     // this is just to avoid using std::default_random_engine, since we're in a public header.
@@ -64,20 +158,23 @@ public:
 
     using Instance = EntityInstanceBase::Type;
 
-    SingleInstanceComponentManager() noexcept {
+    SingleInstanceComponentManagerBase() noexcept {
         // We always start with a dummy entry because index=0 is reserved. The component
         // at index = 0, is guaranteed to be default-initialized.
         // Sub-classes can use this to their advantage.
         mData.push_back();
     }
 
-    SingleInstanceComponentManager(SingleInstanceComponentManager&& rhs) noexcept {/* = default */}
-    SingleInstanceComponentManager& operator=(SingleInstanceComponentManager&& rhs) noexcept {/* = default */}
-    ~SingleInstanceComponentManager() noexcept = default;
+    SingleInstanceComponentManagerBase(
+            SingleInstanceComponentManagerBase&& rhs) noexcept {/* = default */}
+    SingleInstanceComponentManagerBase& operator=(
+            SingleInstanceComponentManagerBase&& rhs) noexcept {/* = default */}
+    ~SingleInstanceComponentManagerBase() noexcept = default;
 
     // not copyable
-    SingleInstanceComponentManager(SingleInstanceComponentManager const& rhs) = delete;
-    SingleInstanceComponentManager& operator=(SingleInstanceComponentManager const& rhs) = delete;
+    SingleInstanceComponentManagerBase(SingleInstanceComponentManagerBase const& rhs) = delete;
+    SingleInstanceComponentManagerBase& operator=(
+            SingleInstanceComponentManagerBase const& rhs) = delete;
 
 
     // returns true if the given Entity has a component of this Manager
@@ -86,12 +183,16 @@ public:
     }
 
     // Get instance of this Entity to be used to retrieve components
-    UTILS_NOINLINE
     Instance getInstance(Entity e) const noexcept {
-        auto const& map = mInstanceMap;
-        // find() generates quite a bit of code
-        auto pos = map.find(e);
-        return pos != map.end() ? pos->second : 0;
+        return mInstanceMap.find(e);
+    }
+
+    // Get the instances of 'count' entities, 0 for those without a component
+    void getInstances(Entity const* entities, size_t count, Instance* instances) const noexcept {
+        InstanceMap const& map = mInstanceMap;
+        for (size_t i = 0; i < count; i++) {
+            instances[i] = map.find(entities[i]);
+        }
     }
 
     // returns the number of components (i.e. size of each arrays)
@@ -194,7 +295,7 @@ public:
     // We need our own version of Field because mData is private
     template<size_t E>
     struct Field : public SoA::template Field<E> {
-        Field(SingleInstanceComponentManager& soa, EntityInstanceBase::Type i) noexcept
+        Field(SingleInstanceComponentManagerBase& soa, EntityInstanceBase::Type i) noexcept
                 : SoA::template Field<E>{ soa.mData, i } {
         }
         using SoA::template Field<E>::operator =;
@@ -222,23 +323,25 @@ protected:
             Entity& ej = elementAt<ENTITY_INDEX>(j);
             std::swap(ei, ej);
             if (ei) {
-                map[ei] = i;
+                map.set(ei, i);
             }
             if (ej) {
-                map[ej] = j;
+                map.set(ej, j);
             }
         }
     }
 
+    // At most 'maxCount' components are removed, the others are left for the next rounds.
     template<typename REMOVE>
     void gc(const EntityManager& em, size_t ratio,
-            REMOVE removeComponent) noexcept {
+            REMOVE removeComponent,
+            size_t maxCount = std::numeric_limits<size_t>::max()) noexcept {
         Entity const* entities = getEntities();
         size_t count = getComponentCount();
         size_t aliveInARow = 0;
         default_random_engine& rng = mRng;
         #pragma nounroll
-        while (count && aliveInARow < ratio) {
+        while (count && aliveInARow < ratio && maxCount) {
             // note: using the modulo favorizes lower number
             size_t i = rng() % count;
             if (UTILS_LIKELY(em.isAlive(entities[i]))) {
@@ -247,6 +350,7 @@ protected:
             }
             aliveInARow = 0;
             count--;
+            maxCount--;
             removeComponent(entities[i]);
         }
     }
@@ -256,40 +360,51 @@ protected:
 
 private:
     // maps an entity to an instance index
-    tsl::robin_map<Entity, Instance> mInstanceMap;
+    InstanceMap mInstanceMap;
     default_random_engine mRng;
 };
 
+// Components are found with a hash map of the entities.
+template <typename ... Elements>
+class UTILS_PUBLIC SingleInstanceComponentManager :
+        public SingleInstanceComponentManagerBase<details::HashedInstanceMap, Elements ...> {
+};
+
+// Components are found with a table indexed by the entities' index, which is faster than
+// hashing but uses memory proportionally to the largest index of entities with a component
+// (8 bytes each).
+template <typename ... Elements>
+class UTILS_PUBLIC SparseSingleInstanceComponentManager :
+        public SingleInstanceComponentManagerBase<details::SparseInstanceMap, Elements ...> {
+};
+
 // Keep these outside of the class because CLion has trouble parsing them
-template<typename ... Elements>
-typename SingleInstanceComponentManager<Elements ...>::Instance
-SingleInstanceComponentManager<Elements ...>::addComponent(Entity e) {
+template<typename InstanceMap, typename ... Elements>
+typename SingleInstanceComponentManagerBase<InstanceMap, Elements ...>::Instance
+SingleInstanceComponentManagerBase<InstanceMap, Elements ...>::addComponent(Entity e) {
     Instance ci = 0;
     if (!e.isNull()) {
-        if (!hasComponent(e)) {
+        ci = getInstance(e);
+        if (!ci) {
             // this is like a push_back(e);
             mData.push_back().template back<ENTITY_INDEX>() = e;
             // index 0 is used when the component doesn't exist
             ci = Instance(mData.size() - 1);
-            mInstanceMap[e] = ci;
-        } else {
-            // if the entity already has this component, just return its instance
-            ci = mInstanceMap[e];
+            mInstanceMap.set(e, ci);
         }
+        // if the entity already has this component, just return its instance
     }
     assert(ci != 0);
     return ci;
 }
 
 // Keep these outside of the class because CLion has trouble parsing them
-template <typename ... Elements>
-typename SingleInstanceComponentManager<Elements ...>::Instance
-SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
+template <typename InstanceMap, typename ... Elements>
+typename SingleInstanceComponentManagerBase<InstanceMap, Elements ...>::Instance
+SingleInstanceComponentManagerBase<InstanceMap, Elements ... >::removeComponent(Entity e) {
     auto& map = mInstanceMap;
-    auto pos = map.find(e);
-    if (UTILS_LIKELY(pos != map.end())) {
-        size_t index = pos->second;
-        assert(index != 0);
+    const size_t index = map.find(e);
+    if (UTILS_LIKELY(index)) {
         size_t last = mData.size() - 1;
         if (last != index) {
             // move the last item to where we removed this component, as to keep
@@ -299,10 +414,10 @@ SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
             });
 
             Entity lastEntity = mData.template elementAt<ENTITY_INDEX>(index);
-            map[lastEntity] = index;
+            map.set(lastEntity, Instance(index));
         }
         mData.pop_back();
-        map.erase(pos);
+        map.erase(e);
         return last;
     }
     return 0;
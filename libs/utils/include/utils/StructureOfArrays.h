@@ -39,6 +39,17 @@ class StructureOfArraysBase {
     static constexpr const size_t kArrayCount = sizeof...(Elements);
 
 public:
+    // Every array starts on a cache line, which also satisfies the alignment of SIMD types.
+    static constexpr size_t ARRAY_ALIGNMENT = 64;
+
+    // Every array has room for a multiple of this many elements, so that SIMD loops can process
+    // the elements past size() up to the next multiple without going out of bounds. Elements past
+    // size() are not constructed.
+    static constexpr size_t ARRAY_PADDING = 16;
+
+    static_assert(((alignof(Elements) <= ARRAY_ALIGNMENT) && ...),
+            "StructureOfArrays elements can't be aligned to more than a cache line");
+
     using SoA = StructureOfArraysBase<Allocator, Elements ...>;
 
     // Type of the Nth array
@@ -50,7 +61,13 @@ public:
 
     // Size needed to store "size" array elements
     static size_t getNeededSize(size_t size) noexcept {
-        return getOffset(kArrayCount - 1, size) + sizeof(TypeAt<kArrayCount - 1>) * size;
+        return getOffset(kArrayCount - 1, size) +
+                sizeof(TypeAt<kArrayCount - 1>) * getPaddedCount(size);
+    }
+
+    // Number of elements that can be accessed in each array of an SoA of the given capacity
+    static constexpr size_t getPaddedCount(size_t count) noexcept {
+        return (count + ARRAY_PADDING - 1) & ~(ARRAY_PADDING - 1);
     }
 
     // --------------------------------------------------------------------------------------------
@@ -269,7 +286,7 @@ public:
         // capacity cannot change when optional storage is specified
         if (capacity >= mSize) {
             const size_t sizeNeeded = getNeededSize(capacity);
-            void* buffer = mAllocator.alloc(sizeNeeded);
+            void* buffer = mAllocator.alloc(sizeNeeded, ARRAY_ALIGNMENT);
 
             // move all the items (one array at a time) from the old allocation to the new
             // this also update the array pointers
@@ -284,6 +301,8 @@ public:
         }
     }
 
+    // increases the capacity geometrically if needed, so that a growing array isn't reallocated
+    // every time
     void ensureCapacity(size_t needed) {
         if (UTILS_UNLIKELY(needed > mCapacity)) {
             // not enough space, increase the capacity
@@ -515,11 +534,12 @@ private:
     }
 
     static inline std::array<size_t, kArrayCount> getOffsets(size_t capacity) noexcept {
-        // compute the required size of each array
-        const size_t sizes[] = { (sizeof(Elements) * capacity)... };
+        // compute the required size of each array, including the padding
+        const size_t paddedCapacity = getPaddedCount(capacity);
+        const size_t sizes[] = { (sizeof(Elements) * paddedCapacity)... };
 
-        // we align each array to the same alignment guaranteed by malloc
-        const size_t align = alignof(std::max_align_t);
+        // we align each array to a cache line
+        const size_t align = ARRAY_ALIGNMENT;
 
         // hopefully most of this gets unrolled and inlined
         std::array<size_t, kArrayCount> offsets;
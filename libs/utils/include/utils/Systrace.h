@@ -23,14 +23,41 @@
 #define SYSTRACE_TAG_FILAMENT       (1<<1)  // don't change, used in makefiles
 #define SYSTRACE_TAG_JOBSYSTEM      (1<<2)
 
+/*
+ * When UTILS_PERF_CAPTURE is defined, SYSTRACE_NAME and SYSTRACE_CALL scopes also record their
+ * time and hardware counters with utils::PerfCapture, on all platforms.
+ */
+#if defined(UTILS_PERF_CAPTURE)
+
+#include <utils/PerfCapture.h>
+
+#ifndef SYSTRACE_TAG
+#define SYSTRACE_TAG (SYSTRACE_TAG_ALWAYS)
+#endif
+
+#define SYSTRACE_PERF_SCOPE(name) ::utils::PerfCapture::Scope ___perfScope(SYSTRACE_TAG, name)
+
+#else
 
-#if defined(ANDROID)
+#define SYSTRACE_PERF_SCOPE(name)
+
+#endif // UTILS_PERF_CAPTURE
+
+/*
+ * When UTILS_PERFETTO is defined, through the FILAMENT_PERFETTO_SDK CMake option, the SYSTRACE_
+ * macros emit Perfetto track events on all platforms instead of writing ATrace markers. The
+ * events go to the Perfetto tracing service (traced on Android, tracebox elsewhere), so they
+ * show up in the same trace as the rest of the system.
+ */
+#if defined(ANDROID) || defined(UTILS_PERFETTO)
 
 #include <atomic>
 
 #include <stdint.h>
 #include <stdio.h>
+#if !defined(UTILS_PERFETTO)
 #include <unistd.h>
+#endif
 
 #include <utils/compiler.h>
 
@@ -61,7 +88,8 @@
 // the correct start and end times this macro should be declared first in the
 // scope body.
 // It also automatically creates a Systrace context
-#define SYSTRACE_NAME(name) ::utils::details::ScopedTrace ___tracer(SYSTRACE_TAG, name)
+#define SYSTRACE_NAME(name) ::utils::details::ScopedTrace ___tracer(SYSTRACE_TAG, name); \
+        SYSTRACE_PERF_SCOPE(name)
 
 // SYSTRACE_CALL is an SYSTRACE_NAME that uses the current function name.
 #define SYSTRACE_CALL() SYSTRACE_NAME(__FUNCTION__)
@@ -100,6 +128,31 @@
 #define SYSTRACE_VALUE64(name, val) \
         ___tracer.value(SYSTRACE_TAG, name, int64_t(val))
 
+#if defined(UTILS_PERFETTO)
+
+/**
+ * Emits an instant event that starts a flow, identified by id. The flow ends at the scope
+ * created by SYSTRACE_NAME_FLOW_END with the same id, e.g. where a job scheduled here runs.
+ */
+#define SYSTRACE_FLOW(name, id) \
+        ::utils::details::Systrace::flow(SYSTRACE_TAG, name, uint64_t(id))
+
+// Same as SYSTRACE_NAME, this scope also ends the flow identified by id.
+#define SYSTRACE_NAME_FLOW_END(name, id) \
+        ::utils::details::ScopedTrace ___tracer(SYSTRACE_TAG, name, uint64_t(id)); \
+        SYSTRACE_PERF_SCOPE(name)
+
+// Names the track of the current thread, the OS thread name isn't available on all platforms.
+#define SYSTRACE_THREAD_NAME(name) ::utils::details::Systrace::setThreadName(name)
+
+#else
+
+#define SYSTRACE_FLOW(name, id)
+#define SYSTRACE_NAME_FLOW_END(name, id) SYSTRACE_NAME(name)
+#define SYSTRACE_THREAD_NAME(name)
+
+#endif // UTILS_PERFETTO
+
 // ------------------------------------------------------------------------------------------------
 // No user serviceable code below...
 // ------------------------------------------------------------------------------------------------
@@ -107,6 +160,102 @@
 namespace utils {
 namespace details {
 
+#if defined(UTILS_PERFETTO)
+
+// Perfetto's headers are large, so the events are emitted out of line, in Systrace.cpp
+class Systrace {
+public:
+
+    enum tags {
+        NEVER       = SYSTRACE_TAG_NEVER,
+        ALWAYS      = SYSTRACE_TAG_ALWAYS,
+        FILAMENT    = SYSTRACE_TAG_FILAMENT,
+        JOBSYSTEM   = SYSTRACE_TAG_JOBSYSTEM
+    };
+
+    // tags are mapped to Perfetto categories, which are enabled by the trace config
+    Systrace(uint32_t) noexcept { }
+
+    // initializes Perfetto and connects to the tracing service, there is nothing to disable
+    static void enable(uint32_t tags) noexcept;
+    static void disable(uint32_t) noexcept { }
+
+    inline void asyncBegin(uint32_t tag, const char* name, int32_t cookie) noexcept {
+        if (tag) async_begin_body(tag, name, cookie);
+    }
+
+    inline void asyncEnd(uint32_t tag, const char*, int32_t cookie) noexcept {
+        if (tag) async_end_body(tag, cookie);
+    }
+
+    inline void value(uint32_t tag, const char* name, int32_t value) noexcept {
+        if (tag) int64_body(tag, name, value);
+    }
+
+    inline void value(uint32_t tag, const char* name, int64_t value) noexcept {
+        if (tag) int64_body(tag, name, value);
+    }
+
+    // the name isn't necessarily a literal here, so it's copied
+    inline void traceBegin(uint32_t tag, const char* name) noexcept {
+        if (tag) begin_body(tag, name, true);
+    }
+
+    inline void traceEnd(uint32_t tag) noexcept {
+        if (tag) end_body(tag);
+    }
+
+    static inline void flow(uint32_t tag, const char* name, uint64_t id) noexcept {
+        if (tag) flow_body(tag, name, id);
+    }
+
+    static void setThreadName(const char* name) noexcept;
+
+private:
+    friend class ScopedTrace;
+
+    static void begin_body(uint32_t tag, const char* name, bool copy) noexcept;
+    static void begin_flow_end_body(uint32_t tag, const char* name, uint64_t id) noexcept;
+    static void end_body(uint32_t tag) noexcept;
+    static void async_begin_body(uint32_t tag, const char* name, int32_t cookie) noexcept;
+    static void async_end_body(uint32_t tag, int32_t cookie) noexcept;
+    static void int64_body(uint32_t tag, const char* name, int64_t value) noexcept;
+    static void flow_body(uint32_t tag, const char* name, uint64_t id) noexcept;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+class ScopedTrace {
+public:
+    // the name of a scope is a literal or __FUNCTION__, it's never copied
+    ScopedTrace(uint32_t tag, const char* name) noexcept : mTrace(tag), mTag(tag) {
+        if (tag) Systrace::begin_body(tag, name, false);
+    }
+
+    ScopedTrace(uint32_t tag, const char* name, uint64_t flow) noexcept
+            : mTrace(tag), mTag(tag) {
+        if (tag) Systrace::begin_flow_end_body(tag, name, flow);
+    }
+
+    inline ~ScopedTrace() noexcept {
+        mTrace.traceEnd(mTag);
+    }
+
+    inline void value(uint32_t tag, const char* name, int32_t v) noexcept {
+        mTrace.value(tag, name, v);
+    }
+
+    inline void value(uint32_t tag, const char* name, int64_t v) noexcept {
+        mTrace.value(tag, name, v);
+    }
+
+private:
+    Systrace mTrace;
+    const uint32_t mTag;
+};
+
+#else // !UTILS_PERFETTO
+
 class Systrace {
 public:
 
@@ -221,25 +370,30 @@ private:
     const uint32_t mTag;
 };
 
+#endif // UTILS_PERFETTO
+
 } // namespace details
 } // namespace utils
 
 // ------------------------------------------------------------------------------------------------
-#else // !ANDROID
+#else // !ANDROID && !UTILS_PERFETTO
 // ------------------------------------------------------------------------------------------------
 
 #define SYSTRACE_ENABLE()
 #define SYSTRACE_DISABLE()
 #define SYSTRACE_CONTEXT()
-#define SYSTRACE_NAME(name)
+#define SYSTRACE_NAME(name) SYSTRACE_PERF_SCOPE(name)
 #define SYSTRACE_NAME_BEGIN(name)
 #define SYSTRACE_NAME_END()
-#define SYSTRACE_CALL()
+#define SYSTRACE_CALL() SYSTRACE_NAME(__FUNCTION__)
 #define SYSTRACE_ASYNC_BEGIN(name, cookie)
 #define SYSTRACE_ASYNC_END(name, cookie)
 #define SYSTRACE_VALUE32(name, val)
 #define SYSTRACE_VALUE64(name, val)
+#define SYSTRACE_FLOW(name, id)
+#define SYSTRACE_NAME_FLOW_END(name, id) SYSTRACE_NAME(name)
+#define SYSTRACE_THREAD_NAME(name)
 
-#endif // ANDROID
+#endif // ANDROID || UTILS_PERFETTO
 
 #endif // TNT_UTILS_SYSTRACE_H
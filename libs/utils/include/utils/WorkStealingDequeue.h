@@ -24,6 +24,41 @@
 
 namespace utils {
 
+namespace details {
+
+// items of a WorkStealingDequeue, either inline or in the heap when the size is only known
+// at runtime
+template <typename TYPE, size_t COUNT>
+struct WorkStealingDequeueStorage {
+    static_assert(!(COUNT & (COUNT - 1)), "COUNT must be a power of two");
+    TYPE items[COUNT];
+    TYPE* data() noexcept { return items; }
+    static constexpr size_t mask() noexcept { return COUNT - 1; }
+};
+
+template <typename TYPE>
+struct WorkStealingDequeueStorage<TYPE, 0> {
+    TYPE* items = nullptr;
+    size_t itemsMask = 0;
+    WorkStealingDequeueStorage() noexcept = default;
+    ~WorkStealingDequeueStorage() noexcept { delete [] items; }
+    WorkStealingDequeueStorage(WorkStealingDequeueStorage const&) = delete;
+    WorkStealingDequeueStorage& operator=(WorkStealingDequeueStorage const&) = delete;
+    TYPE* data() noexcept { return items; }
+    size_t mask() const noexcept { return itemsMask; }
+    void resize(size_t count) noexcept {
+        size_t size = 1;
+        while (size < count) {
+            size *= 2;
+        }
+        delete [] items;
+        items = new TYPE[size];
+        itemsMask = size - 1;
+    }
+};
+
+} // namespace details
+
 /*
  * A templated, lockless, fixed-size work-stealing dequeue
  *
@@ -35,11 +70,10 @@ namespace utils {
  *  any thread                     main thread
  *
  *
+ * When COUNT is 0, the size is chosen at runtime with setSize().
  */
 template <typename TYPE, size_t COUNT>
 class WorkStealingDequeue {
-    static_assert(!(COUNT & (COUNT - 1)), "COUNT must be a power of two");
-    static constexpr size_t MASK = COUNT - 1;
 
     // mTop and mBottom must be signed integers. We use 64-bits atomics so we don't have
     // to worry about wrapping around.
@@ -48,13 +82,15 @@ class WorkStealingDequeue {
     std::atomic<index_t> mTop    = { 0 };   // written/read in pop()/steal()
     std::atomic<index_t> mBottom = { 0 };   // written only in pop(), read in push(), steal()
 
-    TYPE mItems[COUNT];
+    details::WorkStealingDequeueStorage<TYPE, COUNT> mItems;
 
     // NOTE: it's not safe to return a reference because getItemAt() can be called
     // concurrently and the caller could std::move() the item unsafely.
-    TYPE getItemAt(index_t index) noexcept { return mItems[index & MASK]; }
+    TYPE getItemAt(index_t index) noexcept { return mItems.data()[index & mItems.mask()]; }
 
-    void setItemAt(index_t index, TYPE item) noexcept { mItems[index & MASK] = item; }
+    void setItemAt(index_t index, TYPE item) noexcept {
+        mItems.data()[index & mItems.mask()] = item;
+    }
 
 public:
     using value_type = TYPE;
@@ -63,7 +99,15 @@ public:
     inline TYPE pop() noexcept;
     inline TYPE steal() noexcept;
 
-    size_t getSize() const noexcept { return COUNT; }
+    size_t getSize() const noexcept { return mItems.mask() + 1; }
+
+    // Sets the number of items the queue can hold, rounded up to a power of two. Only for
+    // queues sized at runtime, which must be empty and not used concurrently.
+    void setSize(size_t count) noexcept {
+        static_assert(COUNT == 0, "the size of this queue is fixed");
+        assert(getCount() == 0);
+        mItems.resize(count);
+    }
 
     // for debugging only...
     size_t getCount() const noexcept {
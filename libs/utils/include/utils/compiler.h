@@ -112,6 +112,17 @@
 #   define UTILS_HAS_THREADING 1
 #endif
 
+// Whether jobs can run on threads other than the caller's. Emscripten builds compiled with wasm
+// threads (-pthread) run the JobSystem on web workers, but the driver stays on the main thread,
+// which owns the WebGL context, so UTILS_HAS_THREADING is still 0 there.
+#if defined(FILAMENT_SINGLE_THREADED)
+#   define UTILS_HAS_JOB_THREADS 0
+#elif defined(__EMSCRIPTEN__) && defined(__EMSCRIPTEN_PTHREADS__)
+#   define UTILS_HAS_JOB_THREADS 1
+#else
+#   define UTILS_HAS_JOB_THREADS UTILS_HAS_THREADING
+#endif
+
 #if __has_attribute(noinline)
 #define UTILS_NOINLINE __attribute__((noinline))
 #else
@@ -19,12 +19,50 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#if !defined(WIN32)
+#include <sys/mman.h>
+#endif
+
 #include <algorithm>
 
 #include <utils/Log.h>
 
 namespace utils {
 
+// ------------------------------------------------------------------------------------------------
+// HeapArea
+// ------------------------------------------------------------------------------------------------
+
+HeapArea::HeapArea(size_t size, Options options) {
+    if (size) {
+#if defined(MADV_HUGEPAGE)
+        if (options.hugePages) {
+            // transparent huge pages only back whole aligned huge pages, so we align and round up
+            // the allocation. aligned_alloc() uses free() here, like malloc().
+            constexpr size_t HUGE_PAGE_SIZE = 2u * 1024u * 1024u;
+            const size_t hugeSize = (size + HUGE_PAGE_SIZE - 1u) & ~(HUGE_PAGE_SIZE - 1u);
+            mBegin = aligned_alloc(hugeSize, HUGE_PAGE_SIZE);
+            if (mBegin) {
+                madvise(mBegin, hugeSize, MADV_HUGEPAGE);
+            }
+        }
+#endif
+        if (!mBegin) {
+            mBegin = malloc(size);
+        }
+        mEnd = pointermath::add(mBegin, size);
+
+        if (options.prefault && mBegin) {
+            // writing one byte per page is enough to commit the whole area
+            constexpr size_t PAGE_STRIDE = 4096u;
+            char volatile* const p = static_cast<char volatile*>(mBegin);
+            for (size_t i = 0; i < size; i += PAGE_STRIDE) {
+                p[i] = 0;
+            }
+        }
+    }
+}
+
 // ------------------------------------------------------------------------------------------------
 // LinearAllocator
 // ------------------------------------------------------------------------------------------------
@@ -129,6 +167,10 @@ AtomicFreeList::AtomicFreeList(void* begin, void* end,
 
 void TrackingPolicy::HighWatermark::onAlloc(
         void* p, size_t size, size_t alignment, size_t extra) noexcept {
+    if (UTILS_UNLIKELY(!p)) {
+        // the allocation failed
+        return;
+    }
     mCurrent += uint32_t(size);
     mHighWaterMark = mCurrent > mHighWaterMark ? mCurrent : mHighWaterMark;
 }
@@ -21,9 +21,11 @@
 namespace utils {
 
 EntityManager::EntityManager()
-        : mGens(new uint8_t[RAW_INDEX_COUNT]) {
+        : mGens(new std::atomic<uint8_t>[RAW_INDEX_COUNT]) {
     // initialize all the generations to 0
-    std::fill_n(mGens, RAW_INDEX_COUNT, 0);
+    for (size_t i = 0; i < RAW_INDEX_COUNT; i++) {
+        mGens[i].store(0, std::memory_order_relaxed);
+    }
 }
 
 EntityManager::~EntityManager() {
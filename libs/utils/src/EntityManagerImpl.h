@@ -19,6 +19,7 @@
 
 #include <utils/EntityManager.h>
 
+#include <utils/architecture.h>
 #include <utils/compiler.h>
 #include <utils/Entity.h>
 #include <utils/Mutex.h>
@@ -30,7 +31,7 @@
 #include <tsl/robin_map.h>
 #endif
 
-#include <deque>
+#include <atomic>
 #include <mutex> // for std::lock_guard
 #include <vector>
 
@@ -39,6 +40,97 @@ namespace utils {
 
 static constexpr const size_t MIN_FREE_INDICES = 1024;
 
+/*
+ * A lock-free, bounded, multi-producer multi-consumer FIFO of entity indices (this is Dmitry
+ * Vyukov's queue). An index can only be in the free list once, so it never overflows when it
+ * can hold all indices.
+ */
+class UTILS_PRIVATE EntityFreeList {
+public:
+    explicit EntityFreeList(size_t capacity) noexcept
+            : mCells(new Cell[capacity]), mMask(uint32_t(capacity - 1)) {
+        assert(!(capacity & (capacity - 1)));
+        for (size_t i = 0; i < capacity; i++) {
+            mCells[i].sequence.store(uint32_t(i), std::memory_order_relaxed);
+        }
+    }
+
+    ~EntityFreeList() noexcept {
+        delete [] mCells;
+    }
+
+    EntityFreeList(EntityFreeList const&) = delete;
+    EntityFreeList& operator=(EntityFreeList const&) = delete;
+
+    void push(uint32_t index) noexcept {
+        uint32_t pos = mTail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &mCells[pos & mMask];
+            const uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const int32_t diff = int32_t(sequence - pos);
+            // the list can't be full
+            assert(diff >= 0);
+            if (diff == 0) {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else {
+                // another thread got this cell first
+                pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->index = index;
+        // publish the index, and everything written before push()
+        cell->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    bool pop(uint32_t* index) noexcept {
+        uint32_t pos = mHead.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &mCells[pos & mMask];
+            const uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const int32_t diff = int32_t(sequence - (pos + 1));
+            if (diff == 0) {
+                if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // empty (or the next index is being pushed)
+                return false;
+            } else {
+                // another thread got this cell first
+                pos = mHead.load(std::memory_order_relaxed);
+            }
+        }
+        *index = cell->index;
+        // the cell can be reused by push() once the queue wrapped around
+        cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate number of indices in the list
+    size_t size() const noexcept {
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        const uint32_t head = mHead.load(std::memory_order_relaxed);
+        return int32_t(tail - head) > 0 ? tail - head : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        uint32_t index;
+    };
+
+    Cell* const mCells;
+    const uint32_t mMask;
+
+    // push() and pop() are often called from different threads
+    alignas(CACHELINE_SIZE) std::atomic<uint32_t> mTail = { 0 };
+    alignas(CACHELINE_SIZE) std::atomic<uint32_t> mHead = { 0 };
+};
+
 class UTILS_PRIVATE EntityManagerImpl : public EntityManager {
 public:
     using EntityManager::getGeneration;
@@ -47,49 +139,36 @@ public:
     using EntityManager::create;
     using EntityManager::destroy;
 
+    EntityManagerImpl() noexcept : mFreeList(RAW_INDEX_COUNT) {
+    }
+
+    // this is lock-free
     void create(size_t n, Entity* entities) {
-        Entity::Type index{};
-        auto& freeList = mFreeList;
-        uint8_t* const gens = mGens;
+        std::atomic<uint8_t>* const gens = mGens;
 
-        // this must be thread-safe, acquire the free-list mutex
-        std::lock_guard<Mutex> lock(mFreeListLock);
-        Entity::Type currentIndex = mCurrentIndex;
         for (size_t i = 0; i < n; i++) {
-            // If we have more than a certain number of freed indices, get one from the list.
-            // this is a trade-off between how often we recycle indices and how large the free list
-            // can grow.
-            if (UTILS_UNLIKELY(currentIndex >= RAW_INDEX_COUNT || freeList.size() >= MIN_FREE_INDICES)) {
-
-                // this could only happen if we had gone through all the indices at least once
-                if (UTILS_UNLIKELY(freeList.empty())) {
-                    // return the null entity
-                    entities[i] = {};
-                    continue;
-                }
-
-                index = freeList.front();
-                freeList.pop_front();
-            } else {
-                // In the common case, we just grab the next index.
-                // This works only until all indices have been used once, at which point
-                // we're always in the slower case above. The idea is that we have enough indices
-                // that it doesn't happen in practice.
-                index = currentIndex++;
+            Entity::Type index;
+            if (UTILS_UNLIKELY(!allocateIndex(&index))) {
+                // return the null entity
+                entities[i] = {};
+                continue;
             }
-            entities[i] = Entity{ makeIdentity(gens[index], index) };
+
+            // pop() acquired the generation written by destroy()
+            entities[i] = Entity{
+                    makeIdentity(gens[index].load(std::memory_order_relaxed), index) };
 #if FILAMENT_UTILS_TRACK_ENTITIES
+            std::lock_guard<Mutex> lock(mDebugLock);
             mDebugActiveEntities.emplace(entities[i], CallStack::unwind(5));
 #endif
         }
-        mCurrentIndex = currentIndex;
     }
 
+    // this is lock-free, unless there are listeners
     void destroy(size_t n, Entity* entities) noexcept {
         auto& freeList = mFreeList;
-        uint8_t* const gens = mGens;
+        std::atomic<uint8_t>* const gens = mGens;
 
-        std::unique_lock<Mutex> lock(mFreeListLock);
         for (size_t i = 0; i < n; i++) {
             if (!entities[i]) {
                 // behave like free(), ok to free null Entity.
@@ -100,40 +179,44 @@ public:
             assert(isAlive(entities[i]));
 
             // ... deleting a dead Entity will corrupt the internal state, so we protect ourselves
-            // against it. We don't guarantee anything about external state -- e.g. the listeners
-            // will be called.
-            if (isAlive(entities[i])) {
-                Entity::Type index = getIndex(entities[i]);
-                freeList.push_back(index);
-
-                // The generation update doesn't require the lock because it's only used for isAlive()
-                // and entities work as weak references -- it just means that isAlive() could return
-                // true a little longer than expected in some other threads.
-                // We do need a memory fence though, it is provided by the mFreeListLock.unlock() below.
-                gens[index]++;
-
+            // against it, even when it's destroyed by several threads at once: only the thread
+            // that bumps the generation frees the index. We don't guarantee anything about
+            // external state -- e.g. the listeners will be called.
+            // The generation is only used for isAlive() and entities work as weak references --
+            // it just means that isAlive() could return true a little longer than expected in
+            // some other threads.
+            Entity::Type index = getIndex(entities[i]);
+            uint8_t generation = uint8_t(getGeneration(entities[i]));
+            if (gens[index].compare_exchange_strong(generation, uint8_t(generation + 1),
+                    std::memory_order_relaxed)) {
+                // push() publishes the new generation to create()
+                freeList.push(index);
 #if FILAMENT_UTILS_TRACK_ENTITIES
+                std::lock_guard<Mutex> lock(mDebugLock);
                 mDebugActiveEntities.erase(entities[i]);
 #endif
             }
         }
-        lock.unlock();
 
         // notify our listeners that some entities are being destroyed
-        auto listeners = getListeners();
-        for (auto const& l : listeners) {
-            l->onEntitiesDestroyed(n, entities);
+        if (mListenerCount.load(std::memory_order_relaxed)) {
+            auto listeners = getListeners();
+            for (auto const& l : listeners) {
+                l->onEntitiesDestroyed(n, entities);
+            }
         }
     }
 
     void registerListener(EntityManager::Listener* l) noexcept {
         std::lock_guard<Mutex> lock(mListenerLock);
         mListeners.insert(l);
+        mListenerCount.store(uint32_t(mListeners.size()), std::memory_order_relaxed);
     }
 
     void unregisterListener(EntityManager::Listener* l) noexcept {
         std::lock_guard<Mutex> lock(mListenerLock);
         mListeners.erase(l);
+        mListenerCount.store(uint32_t(mListeners.size()), std::memory_order_relaxed);
     }
 
     std::vector<EntityManager::Listener*> getListeners() const noexcept {
@@ -167,16 +250,42 @@ public:
 #endif
 
 private:
-    uint32_t mCurrentIndex = 1;
+    bool allocateIndex(Entity::Type* index) noexcept {
+        // If we have more than a certain number of freed indices, get one from the list.
+        // this is a trade-off between how often we recycle indices and how large the free list
+        // can grow.
+        if (UTILS_UNLIKELY(mFreeList.size() >= MIN_FREE_INDICES) && mFreeList.pop(index)) {
+            return true;
+        }
+
+        // In the common case, we just grab the next index.
+        // This works only until all indices have been used once, at which point
+        // we're always in the slower case above. The idea is that we have enough indices
+        // that it doesn't happen in practice.
+        Entity::Type current = mCurrentIndex.load(std::memory_order_relaxed);
+        while (current < RAW_INDEX_COUNT && !mCurrentIndex.compare_exchange_weak(
+                current, current + 1, std::memory_order_relaxed)) {
+        }
+        if (UTILS_LIKELY(current < RAW_INDEX_COUNT)) {
+            *index = current;
+            return true;
+        }
+
+        // this could only fail if we had gone through all the indices at least once
+        return mFreeList.pop(index);
+    }
+
+    std::atomic<Entity::Type> mCurrentIndex = { 1 };
 
     // stores indices that got freed
-    mutable Mutex mFreeListLock;
-    std::deque<Entity::Type> mFreeList;
+    EntityFreeList mFreeList;
 
     mutable Mutex mListenerLock;
     tsl::robin_set<Listener*> mListeners;
+    std::atomic<uint32_t> mListenerCount = { 0 };   // lets destroy() skip mListenerLock
 
 #if FILAMENT_UTILS_TRACK_ENTITIES
+    mutable Mutex mDebugLock;
     tsl::robin_map<Entity, CallStack> mDebugActiveEntities;
 #endif
 };
@@ -15,17 +15,26 @@
  */
 
 // Note: The overhead of SYSTRACE_TAG_JOBSYSTEM is not negligible especially with parallel_for().
+// With Perfetto, it's only paid when the "jobsystem" category is enabled by the trace config.
+#if defined(UTILS_PERFETTO)
+#define SYSTRACE_TAG SYSTRACE_TAG_JOBSYSTEM
+#else
 //#define SYSTRACE_TAG SYSTRACE_TAG_JOBSYSTEM
 #define SYSTRACE_TAG SYSTRACE_TAG_NEVER
+#endif
 
 // when SYSTRACE_TAG_JOBSYSTEM is used, enables even heavier systraces
 #define HEAVY_SYSTRACE  0
 
 #include <utils/JobSystem.h>
 
+#include <chrono>
 #include <cmath>
 #include <random>
 
+#include <stdio.h>
+
+#include <utils/algorithm.h>
 #include <utils/compiler.h>
 #include <utils/memalign.h>
 #include <utils/Panic.h>
@@ -74,6 +83,7 @@ void JobSystem::setThreadName(const char* name) noexcept {
 #else
 // TODO: implement setting thread name on WIN32
 #endif
+    SYSTRACE_THREAD_NAME(name);
 }
 
 void JobSystem::setThreadPriority(Priority priority) noexcept {
@@ -103,14 +113,70 @@ void JobSystem::setThreadAffinityById(size_t id) noexcept {
 #endif
 }
 
-JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreadsCount) noexcept
-    : mJobPool("JobSystem Job pool", MAX_JOB_COUNT * sizeof(Job)),
-      mJobStorageBase(static_cast<Job *>(mJobPool.getAllocator().getCurrent()))
+uint64_t JobSystem::getBigCoresMask() noexcept {
+    uint64_t mask = 0;
+#if defined(__linux__)
+    // big cores are the ones that can run at the highest frequency
+    uint32_t maxFrequency = 0;
+    const size_t cpuCount = std::min(64u, std::thread::hardware_concurrency());
+    for (size_t cpu = 0; cpu < cpuCount; cpu++) {
+        char path[96];
+        snprintf(path, sizeof(path),
+                "/sys/devices/system/cpu/cpu%zu/cpufreq/cpuinfo_max_freq", cpu);
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            continue;
+        }
+        uint32_t frequency = 0;
+        if (fscanf(file, "%u", &frequency) == 1 && frequency >= maxFrequency) {
+            mask = (frequency > maxFrequency ? 0 : mask) | (uint64_t(1) << cpu);
+            maxFrequency = frequency;
+        }
+        fclose(file);
+    }
+#endif
+    return mask;
+}
+
+static size_t clampJobCount(size_t count) noexcept {
+    return std::min(std::max(count, size_t(1)), size_t(JobSystem::MAX_JOB_COUNT));
+}
+
+// returns the index of the n-th bit set in mask, which must not be 0
+static uint32_t nthBitSet(uint64_t mask, size_t n) noexcept {
+    assert(mask);
+    n %= popcount(mask);
+    while (n--) {
+        mask &= mask - 1;
+    }
+    return uint32_t(ctz(mask));
+}
+
+JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreadsCount,
+        const size_t maxJobCount) noexcept
+    : JobSystem(Config{ userThreadCount, adoptableThreadsCount, maxJobCount }) {
+}
+
+JobSystem::JobSystem(Config const& config) noexcept
+    : mJobPool("JobSystem Job pool", clampJobCount(config.maxJobCount) * sizeof(Job)),
+      mJobStorageBase(static_cast<Job *>(mJobPool.getAllocator().getCurrent())),
+      mMaxJobCount(uint16_t(clampJobCount(config.maxJobCount))),
+      mPriority(config.priority),
+      mExecutor(config.executor)
 {
     SYSTRACE_ENABLE();
 
-    int threadPoolCount = userThreadCount;
-    if (threadPoolCount == 0) {
+    const size_t adoptableThreadsCount = config.adoptableThreadsCount;
+    const uint64_t affinityMask = config.affinityMask;
+
+    int threadPoolCount = int(config.threadCount);
+    if (mExecutor) {
+        // the pool is made of the executor's threads
+        threadPoolCount = int(mExecutor->getConcurrency());
+    } else if (threadPoolCount == 0 && affinityMask) {
+        // one thread per CPU we're allowed to use, one of them will be the user thread
+        threadPoolCount = std::max(2, int(popcount(affinityMask))) - 1;
+    } else if (threadPoolCount == 0) {
         // default value, system dependant
         int hwThreads = std::thread::hardware_concurrency();
         if (UTILS_HAS_HYPER_THREADING) {
@@ -124,7 +190,7 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
         // one of the thread will be the user thread
         threadPoolCount = hwThreads - 1;
     }
-    threadPoolCount = std::min(UTILS_HAS_THREADING ? 32 : 0, threadPoolCount);
+    threadPoolCount = std::min(UTILS_HAS_JOB_THREADS ? 32 : 0, threadPoolCount);
 
     mThreadStates = aligned_vector<ThreadState>(threadPoolCount + adoptableThreadsCount);
     mThreadCount = uint16_t(threadPoolCount);
@@ -141,19 +207,34 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
     #pragma nounroll
     for (size_t i = 0, n = states.size(); i < n; i++) {
         auto& state = states[i];
+        // a queue never holds more items than there are jobs
+        state.workQueue.setSize(mMaxJobCount);
+        state.lowPriorityWorkQueue.setSize(mMaxJobCount);
         state.rndGen = default_random_engine(rd());
         state.id = (uint32_t)i;
+        state.cpu = affinityMask ? nthBitSet(affinityMask, i) : (uint32_t)i;
         state.js = this;
-        if (i < hardwareThreadCount) {
+        if (i < hardwareThreadCount && !mExecutor) {
             // don't start a thread of adoptable thread slots
             state.thread = std::thread(&JobSystem::loop, this, &state);
         }
     }
+
+    if (mExecutor) {
+        // all the pool states can be lent to the executor's threads
+        mIdleHelpers.store(uint32_t((uint64_t(1) << mThreadCount) - 1u));
+    }
 }
 
 JobSystem::~JobSystem() {
     requestExit();
 
+    // the helpers still running reference this JobSystem, they return soon since exit was
+    // requested
+    while (mActiveHelpers.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
     #pragma nounroll
     for (auto &state : mThreadStates) {
         // adopted threads are not joinable
@@ -185,6 +266,7 @@ void JobSystem::decRef(Job const* job) noexcept {
     if (c == 1) {
         // This was the last reference, it's safe to destroy the job.
         mJobPool.destroy(job);
+        mJobCount.fetch_sub(1, std::memory_order_relaxed);
     }
 }
 
@@ -200,28 +282,76 @@ inline bool JobSystem::exitRequested() const noexcept {
     return mExitRequested.load(std::memory_order_relaxed);
 }
 
-inline bool JobSystem::hasActiveJobs() const noexcept {
-    return mActiveJobs.load(std::memory_order_relaxed) > 0;
+inline bool JobSystem::hasActiveJobs(bool lowPriority) const noexcept {
+    // a thread that won't take low priority jobs doesn't care about them
+    const uint32_t activeJobs = mActiveJobs.load(std::memory_order_relaxed);
+    return lowPriority ? activeJobs > 0 :
+            activeJobs > mActiveLowPriorityJobs.load(std::memory_order_relaxed);
 }
 
 inline bool JobSystem::hasJobCompleted(JobSystem::Job const* job) noexcept {
     return job->runningJobCount.load(std::memory_order_relaxed) <= 0;
 }
 
+static int64_t now() noexcept {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Spins until ready() returns true or 'microseconds' elapsed, returns the last value of ready().
+template<typename PREDICATE>
+static bool spinUntil(uint32_t microseconds, PREDICATE ready) noexcept {
+    if (!microseconds) {
+        return false;
+    }
+    const int64_t deadline = now() + int64_t(microseconds) * 1000;
+    do {
+        // reading the clock is much more expensive than checking ready()
+        for (size_t i = 0; i < 64; i++) {
+            if (ready()) {
+                return true;
+            }
+            UTILS_PAUSE();
+        }
+    } while (now() < deadline);
+    return ready();
+}
+
 void JobSystem::wait(std::unique_lock<Mutex>& lock) noexcept {
     ++mWaiterCount;
+    mIdleStats.parks++;
+    const int64_t wakeTime = mWakeTime;
     mWaiterCondition.wait(lock);
+    if (mWakeTime != wakeTime) {
+        // we were (most likely) woken up by wake()
+        mIdleStats.wakes++;
+        mIdleStats.wakeLatencyNs += uint64_t(std::max(int64_t(0), now() - mWakeTime));
+    }
     --mWaiterCount;
 }
 
 void JobSystem::wake() noexcept {
+    if (mExecutor) {
+        dispatchHelpers();
+    }
+
     Mutex& lock = mWaiterLock;
     lock.lock();
     const uint32_t waiterCount = mWaiterCount;
+    if (waiterCount) {
+        mWakeTime = now();
+    }
     lock.unlock();
     mWaiterCondition.notify_n(waiterCount);
 }
 
+JobSystem::IdleStats JobSystem::getIdleStats() const noexcept {
+    std::lock_guard<Mutex> lock(mWaiterLock);
+    IdleStats stats = mIdleStats;
+    stats.spins = mIdleSpins.load(std::memory_order_relaxed);
+    return stats;
+}
+
 inline JobSystem::ThreadState& JobSystem::getState() noexcept {
     std::lock_guard<utils::SpinLock> lock(mThreadMapLock);
     auto iter = mThreadMap.find(std::this_thread::get_id());
@@ -230,7 +360,16 @@ inline JobSystem::ThreadState& JobSystem::getState() noexcept {
 }
 
 JobSystem::Job* JobSystem::allocateJob() noexcept {
-    return mJobPool.make<Job>();
+    Job* const job = mJobPool.make<Job>();
+    if (UTILS_LIKELY(job)) {
+        // these are only statistics, memory_order_relaxed is enough
+        const uint32_t count = mJobCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint32_t peak = mPeakJobCount.load(std::memory_order_relaxed);
+        while (UTILS_UNLIKELY(count > peak) && !mPeakJobCount.compare_exchange_weak(peak, count,
+                std::memory_order_relaxed, std::memory_order_relaxed)) {
+        }
+    }
+    return job;
 }
 
 inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadState& state) noexcept {
@@ -255,27 +394,36 @@ inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadS
     return stateToStealFrom;
 }
 
-JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state) noexcept {
+JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state, bool lowPriority) noexcept {
     HEAVY_SYSTRACE_CALL();
     Job* job = nullptr;
     do {
         ThreadState* const stateToStealFrom = getStateToStealFrom(state);
         if (UTILS_LIKELY(stateToStealFrom)) {
             job = steal(stateToStealFrom->workQueue);
+            if (!job && lowPriority) {
+                job = steal(stateToStealFrom->lowPriorityWorkQueue);
+            }
         }
         // nullptr -> nothing to steal in that queue either, if there are active jobs,
         // continue to try stealing one.
-    } while (!job && hasActiveJobs());
+    } while (!job && hasActiveJobs(lowPriority));
     return job;
 }
 
-bool JobSystem::execute(JobSystem::ThreadState& state) noexcept {
+bool JobSystem::execute(JobSystem::ThreadState& state, bool lowPriority) noexcept {
     HEAVY_SYSTRACE_CALL();
 
+    // low priority jobs are only considered when there is nothing else to do around
     Job* job = pop(state.workQueue);
     if (UTILS_UNLIKELY(job == nullptr)) {
-        // our queue is empty, try to steal a job
-        job = steal(state);
+        job = steal(state, false);
+    }
+    if (UTILS_UNLIKELY(job == nullptr && lowPriority)) {
+        job = pop(state.lowPriorityWorkQueue);
+        if (job == nullptr) {
+            job = steal(state, true);
+        }
     }
 
     if (job) {
@@ -284,10 +432,23 @@ bool JobSystem::execute(JobSystem::ThreadState& state) noexcept {
         assert(activeJobs); // whoops, we were already at 0
         HEAVY_SYSTRACE_VALUE32("JobSystem::activeJobs", activeJobs - 1);
 
+        const bool isLowPriority = job->lowPriority;
+        if (UTILS_UNLIKELY(isLowPriority)) {
+            mActiveLowPriorityJobs.fetch_sub(1, std::memory_order_relaxed);
+            if (!mExecutor) {
+                setThreadPriority(Priority::NORMAL);
+            }
+        }
+
         if (UTILS_LIKELY(job->function)) {
-            HEAVY_SYSTRACE_NAME("job->function");
+            // ends the flow started when the job was run, i.e. from its parent
+            SYSTRACE_NAME_FLOW_END("job", uintptr_t(job));
             job->function(job->storage, *this, job);
         }
+
+        if (UTILS_UNLIKELY(isLowPriority && !mExecutor)) {
+            setThreadPriority(mPriority);
+        }
         finish(job);
     }
     return job != nullptr;
@@ -295,11 +456,11 @@ bool JobSystem::execute(JobSystem::ThreadState& state) noexcept {
 
 void JobSystem::loop(ThreadState* state) noexcept {
     setThreadName("JobSystem::loop");
-    setThreadPriority(Priority::DISPLAY);
+    setThreadPriority(mPriority);
 
     // set a CPU affinity on each of our JobSystem thread to prevent them from jumping from core
     // to core. On Android, it looks like the affinity needs to be reset from time to time.
-    setThreadAffinityById(state->id);
+    setThreadAffinityById(state->cpu);
 
     // record our work queue
     mThreadMapLock.lock();
@@ -309,16 +470,77 @@ void JobSystem::loop(ThreadState* state) noexcept {
 
     // run our main loop...
     do {
-        if (!execute(*state)) {
+        if (!execute(*state, true)) {
+            // spinning a bit can save a park/unpark round-trip between dependent jobs
+            if (spinUntil(getIdleSpinTime(),
+                    [this]() { return exitRequested() || hasActiveJobs(true); })) {
+                mIdleSpins.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
             std::unique_lock<Mutex> lock(mWaiterLock);
-            while (!exitRequested() && !hasActiveJobs()) {
+            while (!exitRequested() && !hasActiveJobs(true)) {
                 wait(lock);
-                setThreadAffinityById(state->id);
+                setThreadAffinityById(state->cpu);
             }
         }
     } while (!exitRequested());
 }
 
+void JobSystem::dispatchHelpers() noexcept {
+    // one helper per queued job at most, the helpers already running pick them up as well
+    uint32_t activeJobs = mActiveJobs.load(std::memory_order_relaxed);
+    while (activeJobs && !exitRequested()) {
+        const uint32_t idle = mIdleHelpers.load(std::memory_order_relaxed);
+        if (!idle) {
+            break;
+        }
+        const uint32_t bit = idle & (~idle + 1u);
+        if (!(mIdleHelpers.fetch_and(~bit, std::memory_order_acquire) & bit)) {
+            // another thread took this state first
+            continue;
+        }
+        mActiveHelpers.fetch_add(1, std::memory_order_relaxed);
+        mExecutor->dispatch(&JobSystem::help, &mThreadStates[ctz(bit)]);
+        activeJobs--;
+    }
+}
+
+void JobSystem::help(void* user) noexcept {
+    ThreadState* const state = static_cast<ThreadState*>(user);
+    state->js->help(*state);
+}
+
+void JobSystem::help(ThreadState& state) noexcept {
+    const auto tid = std::this_thread::get_id();
+    const uint32_t bit = 1u << state.id;
+    do {
+        mThreadMapLock.lock();
+        const bool inserted = mThreadMap.emplace(tid, &state).second;
+        mThreadMapLock.unlock();
+        if (UTILS_UNLIKELY(!inserted)) {
+            // the executor ran this helper on a thread that already runs our jobs, e.g. inline
+            // from dispatch(), that thread gets to the queued jobs on its own.
+            mIdleHelpers.fetch_or(bit, std::memory_order_release);
+            break;
+        }
+
+        while (!exitRequested() && execute(state, true)) {
+        }
+
+        mThreadMapLock.lock();
+        mThreadMap.erase(tid);
+        mThreadMapLock.unlock();
+        mIdleHelpers.fetch_or(bit, std::memory_order_release);
+
+        // jobs queued before the state was given back couldn't dispatch a helper, take the
+        // state back for them, unless another helper got it already.
+    } while (!exitRequested() && hasActiveJobs(true) &&
+            (mIdleHelpers.fetch_and(~bit, std::memory_order_acquire) & bit));
+
+    // this JobSystem can't be used after this, see ~JobSystem()
+    mActiveHelpers.fetch_sub(1, std::memory_order_release);
+}
+
 UTILS_NOINLINE
 void JobSystem::finish(Job* job) noexcept {
     HEAVY_SYSTRACE_CALL();
@@ -369,7 +591,7 @@ JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept
             assert(parentJobCount > 0);
 
             index = parent - mJobStorageBase;
-            assert(index < MAX_JOB_COUNT);
+            assert(index < mMaxJobCount);
         }
         job->function = func;
         job->parent = uint16_t(index);
@@ -407,7 +629,17 @@ void JobSystem::run(JobSystem::Job*& job, uint32_t flags) noexcept {
     // an assert() in execute(). Either way, it's not "wrong", but the assert() is useful.
     uint32_t activeJobs = mActiveJobs.fetch_add(1, std::memory_order_relaxed);
 
-    put(state.workQueue, job);
+    // the flow must start before another thread can pick the job
+    SYSTRACE_FLOW("JobSystem::run", uintptr_t(job));
+
+    // without threads of our own, nobody would pick low priority jobs
+    job->lowPriority = (flags & LOW_PRIORITY) && mThreadCount > 0;
+    if (UTILS_UNLIKELY(job->lowPriority)) {
+        mActiveLowPriorityJobs.fetch_add(1, std::memory_order_relaxed);
+        put(state.lowPriorityWorkQueue, job);
+    } else {
+        put(state.workQueue, job);
+    }
 
     HEAVY_SYSTRACE_VALUE32("JobSystem::activeJobs", activeJobs + 1);
 
@@ -434,9 +666,12 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
     assert(job);
     assert(job->refCount.load(std::memory_order_relaxed) >= 1);
 
+    // Low priority jobs can take a long time, we only help with them if that's what we're
+    // waiting on.
     ThreadState& state(getState());
+    const bool lowPriority = job->lowPriority;
     do {
-        if (!execute(state)) {
+        if (!execute(state, lowPriority)) {
             // test if job has completed first, to possibly avoid taking the lock
             if (hasJobCompleted(job)) {
                 break;
@@ -451,8 +686,15 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
             // this could take time however, so we will wait with a condition, and
             // continue to handle more jobs, as they get added.
 
+            if (spinUntil(getIdleSpinTime(), [this, job, lowPriority]() {
+                return hasJobCompleted(job) || hasActiveJobs(lowPriority) || exitRequested();
+            })) {
+                mIdleSpins.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
             std::unique_lock<Mutex> lock(mWaiterLock);
-            if (!hasJobCompleted(job) && !hasActiveJobs() && !exitRequested()) {
+            if (!hasJobCompleted(job) && !hasActiveJobs(lowPriority) && !exitRequested()) {
                 wait(lock);
             }
         }
@@ -494,7 +736,7 @@ void JobSystem::adopt() {
             "Too many calls to adopt(). No more adoptable threads!");
 
     // all threads adopted by the JobSystem need to run at the same priority
-    JobSystem::setThreadPriority(JobSystem::Priority::DISPLAY);
+    JobSystem::setThreadPriority(mPriority);
 
     // This thread's queue will be selectable immediately (i.e.: before we set its TLS)
     // however, it's not a problem since mThreadState is pre-initialized and valid
@@ -514,6 +756,8 @@ void JobSystem::emancipate() {
     mThreadMap.erase(iter);
 }
 
+JobExecutor::~JobExecutor() noexcept = default;
+
 io::ostream& operator<<(io::ostream& out, JobSystem const& js) {
     for (auto const& item : js.mThreadStates) {
         out << size_t(item.id) << ": " << item.workQueue.getCount() << io::endl;
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/PerfCapture.h>
+
+#include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/Profiler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <mutex>
+#include <vector>
+
+#include <stdio.h>
+
+namespace utils {
+
+std::atomic<bool> PerfCapture::sCapturing = { false };
+
+struct PerfCapture::ThreadData {
+    ThreadData() noexcept;
+    ~ThreadData() noexcept;
+
+    Profiler profiler;
+    // protects 'scopes', which endFrame() collects from another thread
+    Mutex lock;
+    std::vector<ScopeStats> scopes;
+};
+
+struct PerfCapture::Registry {
+    Mutex lock;
+    std::vector<ThreadData*> threads;
+    // scopes of the threads that exited during the frame
+    std::vector<ScopeStats> orphans;
+    // report of the last ended frame
+    std::vector<ScopeStats> frame;
+    uint32_t frameIndex = 0;
+    FILE* file = nullptr;
+    FrameCallback callback = nullptr;
+    void* user = nullptr;
+};
+
+namespace {
+
+struct Counters {
+    uint64_t instructions;
+    uint64_t cacheMisses;
+    uint64_t branchMisses;
+};
+
+Counters readCounters(Profiler& profiler) noexcept {
+    // counters that couldn't be enabled read 0
+    const Profiler::Counters counters = profiler.readCounters();
+    const uint32_t events = profiler.getEnabledEvents();
+    return {
+            counters.getInstructions(),
+            (events & Profiler::EV_L1D_MISSES) ? counters.getL1DMisses() : 0,
+            (events & Profiler::EV_BPU_MISSES) ? counters.getBranchMisses() : 0 };
+}
+
+uint64_t now() noexcept {
+    using namespace std::chrono;
+    return uint64_t(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Adds 'stats' to the entry of the same scope in 'list'. Scopes are identified by the address
+// of their name, which is a string literal, so that e.g. two functions both called "prepare"
+// (SYSTRACE_CALL uses __FUNCTION__) are reported separately.
+void accumulate(std::vector<PerfCapture::ScopeStats>& list,
+        PerfCapture::ScopeStats const& stats) noexcept {
+    auto pos = std::find_if(list.begin(), list.end(), [&stats](auto const& entry) {
+        return entry.name == stats.name;
+    });
+    if (pos == list.end()) {
+        list.push_back(stats);
+        return;
+    }
+    pos->calls += stats.calls;
+    pos->timeNs += stats.timeNs;
+    pos->instructions += stats.instructions;
+    pos->cacheMisses += stats.cacheMisses;
+    pos->branchMisses += stats.branchMisses;
+}
+
+} // anonymous namespace
+
+// ------------------------------------------------------------------------------------------------
+
+PerfCapture::ThreadData::ThreadData() noexcept
+        : profiler(Profiler::EV_L1D_MISSES | Profiler::EV_BPU_MISSES) {
+    // the counters run for the whole life of the thread, scopes read them at both ends
+    profiler.reset();
+    profiler.start();
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+    r.threads.push_back(this);
+}
+
+PerfCapture::ThreadData::~ThreadData() noexcept {
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+    for (ScopeStats const& stats : scopes) {
+        accumulate(r.orphans, stats);
+    }
+}
+
+PerfCapture::Registry& PerfCapture::getRegistry() noexcept {
+    // constructed on first use, so it outlives the threads' data
+    static Registry sRegistry;
+    return sRegistry;
+}
+
+PerfCapture::ThreadData& PerfCapture::getThreadData() noexcept {
+    static thread_local ThreadData tThreadData;
+    return tThreadData;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+bool PerfCapture::start(const char* path) noexcept {
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+    if (r.file) {
+        fclose(r.file);
+        r.file = nullptr;
+    }
+    if (path) {
+        r.file = fopen(path, "w");
+        if (!r.file) {
+            slog.e << "PerfCapture: couldn't open " << path << io::endl;
+            return false;
+        }
+        fputs("frame,scope,calls,time_ns,instructions,cache_misses,branch_misses\n", r.file);
+    }
+
+    // forget what was recorded before this capture
+    for (ThreadData* thread : r.threads) {
+        std::lock_guard<Mutex> threadGuard(thread->lock);
+        thread->scopes.clear();
+    }
+    r.orphans.clear();
+    r.frame.clear();
+    r.frameIndex = 0;
+
+    sCapturing.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void PerfCapture::stop() noexcept {
+    sCapturing.store(false, std::memory_order_relaxed);
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+    if (r.file) {
+        fclose(r.file);
+        r.file = nullptr;
+    }
+}
+
+void PerfCapture::setFrameCallback(FrameCallback callback, void* user) noexcept {
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+    r.callback = callback;
+    r.user = user;
+}
+
+void PerfCapture::endFrame() noexcept {
+    if (!isCapturing()) {
+        return;
+    }
+
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+
+    std::vector<ScopeStats>& frame = r.frame;
+    frame.clear();
+    frame.swap(r.orphans);
+    for (ThreadData* thread : r.threads) {
+        std::lock_guard<Mutex> threadGuard(thread->lock);
+        for (ScopeStats const& stats : thread->scopes) {
+            accumulate(frame, stats);
+        }
+        thread->scopes.clear();
+    }
+    std::sort(frame.begin(), frame.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.timeNs > rhs.timeNs;
+    });
+
+    if (r.file) {
+        for (ScopeStats const& s : frame) {
+            fprintf(r.file, "%" PRIu32 ",%s,%" PRIu32 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                    ",%" PRIu64 "\n", r.frameIndex, s.name, s.calls, s.timeNs,
+                    s.instructions, s.cacheMisses, s.branchMisses);
+        }
+    }
+    if (r.callback) {
+        r.callback(r.frameIndex, frame.data(), frame.size(), r.user);
+    }
+    r.frameIndex++;
+}
+
+void PerfCapture::dump(io::ostream& out) noexcept {
+    Registry& r = getRegistry();
+    std::lock_guard<Mutex> guard(r.lock);
+    out << "frame " << (r.frameIndex ? r.frameIndex - 1 : 0)
+        << ": scope, calls, time (us), instructions, cache misses, branch misses" << io::endl;
+    for (ScopeStats const& s : r.frame) {
+        out << "  " << s.name << ", " << s.calls << ", " << double(s.timeNs) * 1e-3 << ", "
+            << s.instructions << ", " << s.cacheMisses << ", " << s.branchMisses << io::endl;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void PerfCapture::Scope::begin(const char* name) noexcept {
+    ThreadData& thread = getThreadData();
+    const Counters counters = readCounters(thread.profiler);
+    mThread = &thread;
+    mName = name;
+    mInstructions = counters.instructions;
+    mCacheMisses = counters.cacheMisses;
+    mBranchMisses = counters.branchMisses;
+    // read last, so the time doesn't include reading the counters
+    mTime = now();
+}
+
+void PerfCapture::Scope::end() noexcept {
+    const uint64_t time = now();
+    const Counters counters = readCounters(mThread->profiler);
+    const ScopeStats stats = {
+            mName, 1, time - mTime,
+            counters.instructions - mInstructions,
+            counters.cacheMisses - mCacheMisses,
+            counters.branchMisses - mBranchMisses };
+    std::lock_guard<Mutex> guard(mThread->lock);
+    accumulate(mThread->scopes, stats);
+}
+
+} // namespace utils
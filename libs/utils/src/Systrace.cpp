@@ -17,7 +17,110 @@
 #include <utils/Systrace.h>
 #include <utils/Log.h>
 
-#if defined(ANDROID)
+#if defined(UTILS_PERFETTO)
+
+#include <perfetto.h>
+
+#include <mutex>
+
+// Filament's categories are kept in their own namespace, so that they don't clash with the ones
+// of an application that uses the Perfetto SDK too
+PERFETTO_DEFINE_CATEGORIES_IN_NAMESPACE(utils::tracing,
+        perfetto::Category("filament")
+                .SetDescription("Filament's engine and backend scopes, and its counters"),
+        perfetto::Category("jobsystem")
+                .SetDescription("Filament's JobSystem jobs, with flows from where they're run"));
+
+PERFETTO_USE_CATEGORIES_FROM_NAMESPACE(utils::tracing);
+
+PERFETTO_TRACK_EVENT_STATIC_STORAGE_IN_NAMESPACE(utils::tracing);
+
+// the categories of the TRACE_ macros must be literals
+#define WITH_CATEGORY(tag, MACRO)                   \
+    if ((tag) & SYSTRACE_TAG_JOBSYSTEM) {           \
+        MACRO("jobsystem");                         \
+    } else {                                        \
+        MACRO("filament");                          \
+    }
+
+namespace utils {
+namespace details {
+
+void Systrace::enable(uint32_t) noexcept {
+    static std::once_flag sInitialized;
+    std::call_once(sInitialized, []() {
+        perfetto::TracingInitArgs args;
+        // the system backend is what merges our events with the rest of the system's, the
+        // in-process backend lets an application record a trace of its own
+        args.backends = perfetto::kSystemBackend | perfetto::kInProcessBackend;
+        perfetto::Tracing::Initialize(args);
+        tracing::TrackEvent::Register();
+    });
+}
+
+void Systrace::setThreadName(const char* name) noexcept {
+    enable(SYSTRACE_TAG_ALWAYS);
+    perfetto::ThreadTrack const track = perfetto::ThreadTrack::Current();
+    perfetto::protos::gen::TrackDescriptor descriptor = track.Serialize();
+    descriptor.mutable_thread()->set_thread_name(name);
+    tracing::TrackEvent::SetTrackDescriptor(track, descriptor);
+}
+
+void Systrace::begin_body(uint32_t tag, const char* name, bool copy) noexcept {
+    if (copy) {
+#define BEGIN(category) TRACE_EVENT_BEGIN(category, perfetto::DynamicString{ name })
+        WITH_CATEGORY(tag, BEGIN)
+#undef BEGIN
+    } else {
+#define BEGIN(category) TRACE_EVENT_BEGIN(category, perfetto::StaticString{ name })
+        WITH_CATEGORY(tag, BEGIN)
+#undef BEGIN
+    }
+}
+
+void Systrace::begin_flow_end_body(uint32_t tag, const char* name, uint64_t id) noexcept {
+#define BEGIN(category) TRACE_EVENT_BEGIN(category, perfetto::StaticString{ name }, \
+        perfetto::TerminatingFlow::ProcessScoped(id))
+    WITH_CATEGORY(tag, BEGIN)
+#undef BEGIN
+}
+
+void Systrace::end_body(uint32_t tag) noexcept {
+#define END(category) TRACE_EVENT_END(category)
+    WITH_CATEGORY(tag, END)
+#undef END
+}
+
+void Systrace::async_begin_body(uint32_t tag, const char* name, int32_t cookie) noexcept {
+#define BEGIN(category) TRACE_EVENT_BEGIN(category, perfetto::StaticString{ name }, \
+        perfetto::Track(uint64_t(uint32_t(cookie))))
+    WITH_CATEGORY(tag, BEGIN)
+#undef BEGIN
+}
+
+void Systrace::async_end_body(uint32_t tag, int32_t cookie) noexcept {
+#define END(category) TRACE_EVENT_END(category, perfetto::Track(uint64_t(uint32_t(cookie))))
+    WITH_CATEGORY(tag, END)
+#undef END
+}
+
+void Systrace::int64_body(uint32_t tag, const char* name, int64_t value) noexcept {
+#define COUNTER(category) TRACE_COUNTER(category, perfetto::CounterTrack(name), value)
+    WITH_CATEGORY(tag, COUNTER)
+#undef COUNTER
+}
+
+void Systrace::flow_body(uint32_t tag, const char* name, uint64_t id) noexcept {
+#define INSTANT(category) TRACE_EVENT_INSTANT(category, perfetto::StaticString{ name }, \
+        perfetto::Flow::ProcessScoped(id))
+    WITH_CATEGORY(tag, INSTANT)
+#undef INSTANT
+}
+
+} // namespace details
+} // namespace utils
+
+#elif defined(ANDROID)
 
 #include <cinttypes>
 
@@ -138,4 +241,4 @@ void Systrace::init(uint32_t tag) noexcept {
 } // namespace details
 } // namespace utils
 
-#endif // ANDROID
+#endif // UTILS_PERFETTO
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <bitset>
 #include <functional>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -154,6 +155,54 @@ TEST(AllocatorTest, PoolAllocator) {
 }
 
 
+TEST(AllocatorTest, AtomicPoolAllocator) {
+    constexpr size_t COUNT = 256;
+    constexpr size_t THREAD_COUNT = 4;
+    std::vector<char> scratch(COUNT * 64 + 31);
+
+    // pool of 64-bytes objects aligned on 32 bytes, shared by all threads
+    PoolAllocator<64, 32, 0, AtomicFreeList> pa(scratch.data(), scratch.data() + scratch.size());
+
+    // each thread repeatedly allocates and frees its share of the pool, writing its own pattern
+    std::vector<std::thread> threads;
+    std::vector<int> success(THREAD_COUNT, true);
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back([&pa, &success, t]() {
+            void* blocks[COUNT / THREAD_COUNT];
+            for (size_t k = 0; k < 1000; k++) {
+                for (void*& p : blocks) {
+                    p = pa.alloc();
+                    if (!p) {
+                        success[t] = false;
+                        return;
+                    }
+                    memset(p, int(t + 1), 64);
+                }
+                for (void* p : blocks) {
+                    // no other thread got the same block
+                    if (std::any_of((char const*)p, (char const*)p + 64,
+                            [t](char c) { return c != char(t + 1); })) {
+                        success[t] = false;
+                    }
+                    pa.free(p);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        EXPECT_TRUE(success[t]);
+    }
+
+    // all the blocks are back in the pool
+    for (size_t i = 0; i < COUNT; i++) {
+        EXPECT_NE(nullptr, pa.alloc());
+    }
+    EXPECT_EQ(nullptr, pa.alloc());
+}
+
 TEST(AllocatorTest, CppAllocator) {
     struct Tracking {
         Tracking() noexcept { }
@@ -330,3 +379,19 @@ TEST(AllocatorTest, STLAllocator) {
 
     EXPECT_EQ(0, arena.getListener().allocations.size());
 }
+
+TEST(AllocatorTest, HeapAreaOptions) {
+    HeapArea::Options options;
+    options.hugePages = true;
+    options.prefault = true;
+
+    // the area is usable whether or not huge pages are supported
+    using Allocator = Arena<LinearAllocator, LockingPolicy::NoLock>;
+    Allocator allocator("HeapAreaOptions", 3 * 1024 * 1024 + 1, options);
+    EXPECT_EQ(3 * 1024 * 1024 + 1, allocator.getArea().getSize());
+
+    void* p = allocator.alloc(3 * 1024 * 1024, 1);
+    EXPECT_NE(nullptr, p);
+    memset(p, 0xFF, 3 * 1024 * 1024);
+    EXPECT_EQ(nullptr, allocator.alloc(2, 1));
+}
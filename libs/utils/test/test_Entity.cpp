@@ -17,9 +17,12 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "../src/EntityManagerImpl.h"
 #include <utils/NameComponentManager.h>
+#include <utils/SingleInstanceComponentManager.h>
 
 using namespace utils;
 
@@ -128,6 +131,38 @@ TEST(EntityTest, Lots) {
     // at this point, we should be getting indices from the free-list exclusively
 }
 
+TEST(EntityTest, Threads) {
+    EntityManagerImpl em;
+
+    // several threads creating and destroying entities at the same time
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&em]() {
+            Entity entities[64];
+            for (size_t i = 0; i < 1000; i++) {
+                em.create(64, entities);
+                for (auto const& e : entities) {
+                    EXPECT_TRUE(em.isAlive(e));
+                }
+                em.destroy(64, entities);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // all indices were given back, we can still create the maximum number of entities
+    std::unique_ptr<Entity[]> entities(new Entity[EntityManager::getMaxEntityCount()]);
+    size_t n = EntityManager::getMaxEntityCount();
+    em.create(n, entities.get());
+    for (size_t i = 0; i < n; i++) {
+        EXPECT_TRUE(em.isAlive(entities[i]));
+    }
+    EXPECT_TRUE(em.create().isNull());
+    em.destroy(n, entities.get());
+}
+
 
 TEST(EntityTest, NameComponent) {
 
@@ -176,3 +211,71 @@ TEST(EntityTest, NameComponent) {
 
     cm.gc(em);
 }
+
+TEST(EntityTest, ComponentManagerGcBudget) {
+    struct Manager : public SingleInstanceComponentManager<int> {
+        using SingleInstanceComponentManager<int>::gc;
+    };
+    EntityManagerImpl em;
+    Manager cm;
+
+    Entity entities[64];
+    em.create(64, entities);
+    for (size_t i = 0; i < 64; i++) {
+        cm.addComponent(entities[i]);
+    }
+    em.destroy(64, entities);
+
+    // all the components are dead, each round removes exactly 'maxCount' of them
+    auto remove = [&cm](Entity e) { cm.removeComponent(e); };
+    cm.gc(em, 4, remove, 10);
+    EXPECT_EQ(54, cm.getComponentCount());
+    cm.gc(em, 4, remove, 50);
+    EXPECT_EQ(4, cm.getComponentCount());
+    cm.gc(em, 4, remove, 10);
+    EXPECT_EQ(0, cm.getComponentCount());
+}
+
+TEST(EntityTest, SparseComponentManager) {
+    EntityManagerImpl em;
+    SparseSingleInstanceComponentManager<int> cm;
+
+    Entity entities[1024];
+    em.create(1024, entities);
+    for (size_t i = 0; i < 1024; i++) {
+        cm.elementAt<0>(cm.addComponent(entities[i])) = int(i);
+    }
+    EXPECT_EQ(1024, cm.getComponentCount());
+
+    SparseSingleInstanceComponentManager<int>::Instance instances[1024];
+    cm.getInstances(entities, 1024, instances);
+    for (size_t i = 0; i < 1024; i++) {
+        EXPECT_EQ(cm.getInstance(entities[i]), instances[i]);
+        EXPECT_EQ(int(i), cm.elementAt<0>(instances[i]));
+    }
+
+    // destroy the entities without removing their components, their indices get reused
+    em.destroy(1024, entities);
+    Entity recycled = em.create();
+    EXPECT_EQ(EntityManagerImpl::getEntityIndex(entities[0]),
+            EntityManagerImpl::getEntityIndex(recycled));
+    EXPECT_EQ(0, cm.getInstance(recycled));
+
+    // both the dead and the new entity have a component with the same index
+    cm.elementAt<0>(cm.addComponent(recycled)) = -1;
+    EXPECT_NE(cm.getInstance(recycled), cm.getInstance(entities[0]));
+    EXPECT_EQ(-1, cm.elementAt<0>(cm.getInstance(recycled)));
+    EXPECT_EQ(0, cm.elementAt<0>(cm.getInstance(entities[0])));
+
+    // removing components moves the others around
+    for (size_t i = 0; i < 1024; i++) {
+        cm.removeComponent(entities[i]);
+        EXPECT_EQ(0, cm.getInstance(entities[i]));
+    }
+    EXPECT_EQ(1, cm.getComponentCount());
+    EXPECT_EQ(-1, cm.elementAt<0>(cm.getInstance(recycled)));
+
+    cm.removeComponent(recycled);
+    EXPECT_TRUE(cm.empty());
+    em.destroy(recycled);
+}
@@ -23,7 +23,9 @@
 #include <math/mat3.h>
 
 #include <array>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <utils/Allocator.h>
 
 using namespace utils;
@@ -284,6 +286,149 @@ TEST(JobSystem, JobSystemParallelFor) {
     js.emancipate();
 }
 
+TEST(JobSystem, JobSystemLowPriority) {
+    JobSystem js;
+    js.adopt();
+
+    std::atomic_int calls = { 0 };
+    auto work = [&calls]() { calls++; };
+
+    // waiting on a regular job doesn't need anybody to pick up low priority work
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 64; i++) {
+        js.run(jobs::createJob(js, root, work), JobSystem::LOW_PRIORITY | JobSystem::DONT_SIGNAL);
+        js.run(jobs::createJob(js, root, work), JobSystem::DONT_SIGNAL);
+    }
+    js.runAndWait(root);
+    EXPECT_EQ(128, calls.load());
+
+    // and the waiting thread helps when waiting on a low priority job
+    root = js.createJob();
+    for (int i = 0; i < 64; i++) {
+        js.run(jobs::createJob(js, root, work), JobSystem::LOW_PRIORITY | JobSystem::DONT_SIGNAL);
+    }
+    root = js.runAndRetain(root, JobSystem::LOW_PRIORITY);
+    js.waitAndRelease(root);
+    EXPECT_EQ(192, calls.load());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemMaxJobCount) {
+    JobSystem js(0, 1, 16384);
+    js.adopt();
+
+    EXPECT_EQ(16384, js.getMaxJobCount());
+
+    // all these jobs exist at the same time, more than the default allows
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 8192; i++) {
+        JobSystem::Job* job = jobs::createJob(js, root, [&calls]() { calls++; });
+        ASSERT_NE(nullptr, job);
+        js.run(job, JobSystem::DONT_SIGNAL);
+    }
+    js.runAndWait(root);
+    EXPECT_EQ(8192, calls.load());
+    EXPECT_GT(js.getPeakJobCount(), JobSystem::DEFAULT_MAX_JOB_COUNT);
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemIdleSpin) {
+    JobSystem js;
+    js.adopt();
+
+    js.setIdleSpinTime(200);
+    EXPECT_EQ(200, js.getIdleSpinTime());
+
+    // short dependent waves of jobs, idle threads spin between them
+    std::atomic_int calls = { 0 };
+    for (int wave = 0; wave < 64; wave++) {
+        JobSystem::Job* root = js.createJob();
+        for (int i = 0; i < 16; i++) {
+            js.run(jobs::createJob(js, root, [&calls]() { calls++; }));
+        }
+        js.runAndWait(root);
+    }
+    EXPECT_EQ(64 * 16, calls.load());
+
+    JobSystem::IdleStats stats = js.getIdleStats();
+    EXPECT_GE(stats.parks, stats.wakes);
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemConfig) {
+    JobSystem::Config config;
+    config.affinityMask = 0b101;
+    config.priority = JobSystem::Priority::NORMAL;
+    JobSystem js(config);
+    js.adopt();
+
+    // one thread per CPU in the mask, minus the user thread
+    EXPECT_EQ(1, js.getThreadCount());
+
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 256; i++) {
+        js.run(jobs::createJob(js, root, [&calls]() { calls++; }));
+    }
+    js.runAndWait(root);
+    EXPECT_EQ(256, calls.load());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemExecutor) {
+    // runs each task on a new thread, which a real scheduler would take from its pool
+    class ThreadExecutor : public JobExecutor {
+    public:
+        ~ThreadExecutor() noexcept override {
+            for (std::thread& thread : mThreads) {
+                thread.join();
+            }
+        }
+        size_t getConcurrency() const noexcept override { return 3; }
+        void dispatch(Task task, void* user) noexcept override {
+            std::lock_guard<std::mutex> guard(mLock);
+            mThreads.emplace_back(task, user);
+        }
+        size_t getDispatchCount() {
+            std::lock_guard<std::mutex> guard(mLock);
+            return mThreads.size();
+        }
+    private:
+        std::mutex mLock;
+        std::vector<std::thread> mThreads;
+    } executor;
+
+    {
+        JobSystem::Config config;
+        config.executor = &executor;
+        JobSystem js(config);
+        js.adopt();
+
+        EXPECT_EQ(3, js.getThreadCount());
+
+        std::vector<uint32_t> values(4096, 1);
+        JobSystem::Job* job = parallel_for(js, nullptr, values.data(), values.size(),
+                [](uint32_t* v, size_t c) {
+                    for (size_t i = 0; i < c; ++i) {
+                        v[i] *= 2;
+                    }
+                }, CountSplitter<16>());
+        js.runAndWait(job);
+
+        for (uint32_t value : values) {
+            EXPECT_EQ(2, value);
+        }
+        EXPECT_GT(executor.getDispatchCount(), 0);
+
+        js.emancipate();
+    }
+}
+
 TEST(JobSystem, JobSystemDelegates) {
     JobSystem js;
     js.adopt();
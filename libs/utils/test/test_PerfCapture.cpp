@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/PerfCapture.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace {
+
+struct Report {
+    uint32_t frames = 0;
+    std::vector<PerfCapture::ScopeStats> stats;
+};
+
+void onFrame(uint32_t, PerfCapture::ScopeStats const* stats, size_t count, void* user) {
+    Report* report = static_cast<Report*>(user);
+    report->frames++;
+    report->stats.assign(stats, stats + count);
+}
+
+PerfCapture::ScopeStats const* find(Report const& report, const char* name) {
+    for (auto const& stats : report.stats) {
+        if (stats.name == name) {
+            return &stats;
+        }
+    }
+    return nullptr;
+}
+
+} // anonymous namespace
+
+TEST(PerfCapture, Scopes) {
+    static const char* const OUTER = "outer";
+    static const char* const INNER = "inner";
+    static const char* const WORKER = "worker";
+
+    Report report;
+    PerfCapture::setFrameCallback(&onFrame, &report);
+
+    // nothing is recorded outside of a capture
+    {
+        PerfCapture::Scope scope(1, OUTER);
+    }
+    EXPECT_FALSE(PerfCapture::isCapturing());
+
+    ASSERT_TRUE(PerfCapture::start());
+    {
+        PerfCapture::Scope outer(1, OUTER);
+        for (size_t i = 0; i < 3; i++) {
+            PerfCapture::Scope inner(1, INNER);
+        }
+        std::thread([]() {
+            PerfCapture::Scope worker(1, WORKER);
+        }).join();
+        // scopes with a null tag are compiled out
+        PerfCapture::Scope never(0, WORKER);
+    }
+    PerfCapture::endFrame();
+
+    EXPECT_EQ(1u, report.frames);
+    ASSERT_EQ(3u, report.stats.size());
+    ASSERT_NE(nullptr, find(report, OUTER));
+    ASSERT_NE(nullptr, find(report, INNER));
+    ASSERT_NE(nullptr, find(report, WORKER));
+    EXPECT_EQ(1u, find(report, OUTER)->calls);
+    EXPECT_EQ(3u, find(report, INNER)->calls);
+    EXPECT_EQ(1u, find(report, WORKER)->calls);
+    // outer includes inner
+    EXPECT_GE(find(report, OUTER)->timeNs, find(report, INNER)->timeNs);
+    EXPECT_GE(find(report, OUTER)->instructions, find(report, INNER)->instructions);
+
+    // each frame only reports its own scopes
+    PerfCapture::endFrame();
+    EXPECT_EQ(2u, report.frames);
+    EXPECT_TRUE(report.stats.empty());
+
+    PerfCapture::stop();
+    PerfCapture::endFrame();
+    EXPECT_EQ(2u, report.frames);
+
+    PerfCapture::setFrameCallback(nullptr);
+}
+
+TEST(PerfCapture, File) {
+    std::string path = testing::TempDir() + "perf_capture.csv";
+    ASSERT_TRUE(PerfCapture::start(path.c_str()));
+    {
+        PerfCapture::Scope scope(1, "scope");
+    }
+    PerfCapture::endFrame();
+    PerfCapture::stop();
+
+    FILE* file = fopen(path.c_str(), "r");
+    ASSERT_NE(nullptr, file);
+    char line[256];
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), file));
+    EXPECT_STREQ("frame,scope,calls,time_ns,instructions,cache_misses,branch_misses\n", line);
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), file));
+    EXPECT_EQ(0, strncmp(line, "0,scope,1,", 10));
+    fclose(file);
+    remove(path.c_str());
+}
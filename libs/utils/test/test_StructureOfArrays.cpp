@@ -173,3 +173,26 @@ TEST(StructureOfArraysTest, Simple) {
     soa.push_back(0.0f, 1.0, std::move(destroyedFloat4));
 }
 
+
+TEST(StructureOfArraysTest, AlignmentAndPadding) {
+    StructureOfArrays<uint8_t, float, double, TestFloat4> soa;
+
+    for (size_t capacity : { 1, 7, 16, 17, 33 }) {
+        soa.setCapacity(capacity);
+        EXPECT_EQ(capacity, soa.capacity());
+
+        // each array starts on a cache line
+        EXPECT_EQ(0, uintptr_t(soa.data<0>()) % soa.ARRAY_ALIGNMENT);
+        EXPECT_EQ(0, uintptr_t(soa.data<1>()) % soa.ARRAY_ALIGNMENT);
+        EXPECT_EQ(0, uintptr_t(soa.data<2>()) % soa.ARRAY_ALIGNMENT);
+        EXPECT_EQ(0, uintptr_t(soa.data<3>()) % soa.ARRAY_ALIGNMENT);
+
+        // each array has room for the padded count of elements
+        const size_t padded = soa.getPaddedCount(capacity);
+        EXPECT_EQ(0, padded % soa.ARRAY_PADDING);
+        EXPECT_GE(padded, capacity);
+        EXPECT_TRUE((void*)soa.data<1>() >= (void*)(soa.data<0>() + padded));
+        EXPECT_TRUE((void*)soa.data<2>() >= (void*)(soa.data<1>() + padded));
+        EXPECT_TRUE((void*)soa.data<3>() >= (void*)(soa.data<2>() + padded));
+    }
+}
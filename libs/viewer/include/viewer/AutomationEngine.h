@@ -44,12 +44,21 @@ namespace viewer {
  * the first test case until the client unblocks it via signalBatchMode(). This is useful when
  * waiting for a large model file to become fully loaded. Batch mode also offers a query
  * (shouldClose) that is triggered after the last screenshot has been written to disk.
+ *
+ * The engine can also measure each test: after a number of warm-up frames, it collects the CPU,
+ * GPU and per-pass timings of a number of frames from the Renderer, and writes a summary of every
+ * test to "timings.json" after the last one.
  */
 class AutomationEngine {
 public:
     AutomationEngine(const AutomationSpec* spec, Settings* settings) :
             mSpec(spec), mSettings(settings) {}
 
+    ~AutomationEngine();
+
+    AutomationEngine(AutomationEngine const&) = delete;
+    AutomationEngine& operator=(AutomationEngine const&) = delete;
+
     // Enters the running state.
     void startRunning();
 
@@ -65,7 +74,7 @@ public:
     void signalBatchMode() { mBatchModeAllowed = true; }
 
     // Cancels an in-progress automation session.
-    void stopRunning() { mIsRunning = false; }
+    void stopRunning();
 
     // Signals that the application is closing, so all pending screenshots should be cancelled.
     void terminate();
@@ -91,6 +100,16 @@ public:
 
         // If true, test progress is dumped to the utils Log (info priority).
         bool verbose = true;
+
+        // If true, the timings of the frames of each test are measured and written out to
+        // "timings.json" after the last test. The GPU times require timer queries.
+        bool exportTimings = false;
+
+        // Number of frames rendered before measuring a test, and number of frames measured, used
+        // when the AutomationSpec doesn't specify them. The timings are received a few frames
+        // after the frames are rendered, so the warm-up must be longer than this latency.
+        int warmupFrameCount = 10;
+        int measuredFrameCount = 60;
     };
 
     Options getOptions() const { return mOptions; }
@@ -104,9 +123,14 @@ public:
     const char* getStatusMessage() const;
 
 private:
+    struct Timings;
+
+    void stopTimings();
+
     AutomationSpec const * const mSpec;
     Settings * const mSettings;
     Options mOptions;
+    Timings* mTimings = nullptr;
     size_t mCurrentTest;
     float mElapsedTime;
     int mElapsedFrames;
@@ -47,6 +47,25 @@ namespace viewer {
  *     "view.postProcessingEnabled": false
  *   }
  * }]
+ *
+ * When the AutomationEngine exports timings, a group can also specify the number of frames
+ * rendered before measuring each of its test cases, and the number of frames measured, with
+ * "warmupFrames" and "measuredFrames". For instance, this measures SSAO and TAA at two
+ * resolutions (with a fixed dynamic resolution scale):
+ * [{
+ *   "name": "perf",
+ *   "warmupFrames": 10,
+ *   "measuredFrames": 100,
+ *   "base": {
+ *     "view.dsr.minScale": [0.5, 0.5],
+ *     "view.dsr.maxScale": [0.5, 0.5]
+ *   },
+ *   "permute": {
+ *     "view.ssao.enabled": [false, true],
+ *     "view.taa.enabled": [false, true],
+ *     "view.dsr.enabled": [false, true]
+ *   }
+ * }]
  */
 class AutomationSpec {
 public:
@@ -69,6 +88,16 @@ public:
     // Returns the name of the JSON group for a given Settings object.
     char const* getName(size_t index) const;
 
+    // Number of frames to render before measuring a test case, and number of frames measured.
+    // A count of 0 means that the group didn't specify it.
+    struct FrameCounts {
+        int warmup = 0;
+        int measured = 0;
+    };
+
+    // Returns the frame counts of the JSON group for a given Settings object.
+    FrameCounts getFrameCounts(size_t index) const;
+
     // Frees all Settings objects and name strings.
     ~AutomationSpec();
 
@@ -43,6 +43,7 @@ using AntiAliasing = filament::View::AntiAliasing;
 using BloomOptions = filament::View::BloomOptions;
 using DepthOfFieldOptions = filament::View::DepthOfFieldOptions;
 using Dithering = filament::View::Dithering;
+using DynamicResolutionOptions = filament::View::DynamicResolutionOptions;
 using FogOptions = filament::View::FogOptions;
 using RenderQuality = filament::View::RenderQuality;
 using ShadowType = filament::View::ShadowType;
@@ -70,6 +71,7 @@ std::string writeJson(const BloomOptions& in);
 std::string writeJson(const ColorGradingSettings& in);
 std::string writeJson(const DepthOfFieldOptions& in);
 std::string writeJson(const DynamicLightingSettings& in);
+std::string writeJson(const DynamicResolutionOptions& in);
 std::string writeJson(const FogOptions& in);
 std::string writeJson(const MaterialSettings& in);
 std::string writeJson(const RenderQuality& in);
@@ -124,6 +126,7 @@ struct ViewSettings {
     DynamicLightingSettings dynamicLighting;
     ShadowType shadowType = ShadowType::PCF;
     VsmShadowOptions vsmShadowOptions;
+    DynamicResolutionOptions dsr;
     bool postProcessingEnabled = true;
 };
 
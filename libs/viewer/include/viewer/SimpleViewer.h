@@ -208,6 +208,7 @@ private:
     int mShadowCascades = 1;
     bool mEnableContactShadows = false;
     int mVsmMsaaSamplesLog2 = 1;
+    float mVsmBlurWidth = 0.0f;
     std::array<float, 3> mSplitPositions = {0.25f, 0.50f, 0.75f};
     Settings mSettings;
     int mSidebarWidth;
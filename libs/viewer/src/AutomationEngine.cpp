@@ -28,9 +28,12 @@
 #include <utils/Log.h>
 #include <utils/Path.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 using namespace image;
 using namespace utils;
@@ -85,6 +88,103 @@ void exportScreenshot(View* view, Renderer* renderer, std::string filename,
             std::move(buffer));
 }
 
+static std::string writeJson(std::vector<float> timesMs) {
+    if (timesMs.empty()) {
+        return "{}";
+    }
+    std::sort(timesMs.begin(), timesMs.end());
+    float sum = 0;
+    for (float t : timesMs) {
+        sum += t;
+    }
+    std::ostringstream oss;
+    oss << "{ "
+        << "\"min\": " << timesMs.front() << ", "
+        << "\"median\": " << timesMs[timesMs.size() / 2] << ", "
+        << "\"mean\": " << sum / float(timesMs.size()) << ", "
+        << "\"max\": " << timesMs.back()
+        << " }";
+    return oss.str();
+}
+
+struct AutomationEngine::Timings {
+    struct Pass {
+        std::string name;
+        double totalTimeMs;
+    };
+
+    struct Test {
+        std::string name;
+        std::string settings;
+        std::vector<float> mainThreadTimeMs;
+        std::vector<float> driverThreadTimeMs;
+        std::vector<float> gpuTimeMs;
+        std::vector<Pass> passes;
+    };
+
+    static void onFrameTimings(Renderer::FrameTimings const& timings, void* user) {
+        Timings* const self = static_cast<Timings*>(user);
+        if (!self->collecting || self->tests.empty()) {
+            return;
+        }
+        Test& test = self->tests.back();
+        if (test.mainThreadTimeMs.size() >= self->measuredFrameCount) {
+            return;
+        }
+        test.mainThreadTimeMs.push_back(float(timings.mainThreadTimeNs) * 1e-6f);
+        test.driverThreadTimeMs.push_back(float(timings.driverThreadTimeNs) * 1e-6f);
+        test.gpuTimeMs.push_back(float(timings.gpuTimeNs) * 1e-6f);
+        for (size_t i = 0; i < timings.passCount; i++) {
+            Renderer::FrameTimings::Pass const& pass = timings.passes[i];
+            auto pos = std::find_if(test.passes.begin(), test.passes.end(),
+                    [&pass](Pass const& p) { return p.name == pass.name; });
+            if (pos == test.passes.end()) {
+                pos = test.passes.insert(pos, { pass.name, 0.0 });
+            }
+            pos->totalTimeMs += double(pass.gpuTimeNs) * 1e-6;
+        }
+    }
+
+    void exportJson(const char* filename) const {
+        std::ofstream out(filename);
+        if (!out) {
+            gStatus = "Failed to export timings file.";
+            return;
+        }
+        out << "{\n\"tests\": [\n";
+        for (size_t i = 0; i < tests.size(); i++) {
+            auto const& test = tests[i];
+            const size_t frameCount = test.mainThreadTimeMs.size();
+            out << "{\n"
+                << "\"name\": \"" << test.name << "\",\n"
+                << "\"frames\": " << frameCount << ",\n"
+                << "\"mainThreadMs\": " << writeJson(test.mainThreadTimeMs) << ",\n"
+                << "\"driverThreadMs\": " << writeJson(test.driverThreadTimeMs) << ",\n"
+                << "\"gpuMs\": " << writeJson(test.gpuTimeMs) << ",\n"
+                << "\"passesMs\": {";
+            for (size_t j = 0; j < test.passes.size(); j++) {
+                out << (j ? ", " : " ") << "\"" << test.passes[j].name << "\": "
+                    << test.passes[j].totalTimeMs / double(std::max(frameCount, size_t(1)));
+            }
+            out << " },\n"
+                << "\"settings\": " << test.settings << "\n"
+                << "}" << (i < tests.size() - 1 ? "," : "") << "\n";
+        }
+        out << "]\n}" << std::endl;
+        gStatus = "Exported timings to '" + std::string(filename) + "' in the current folder.";
+    }
+
+    Renderer* renderer = nullptr;
+    std::vector<Test> tests;
+    size_t warmupFrameCount = 0;
+    size_t measuredFrameCount = 0;
+    bool collecting = false;
+};
+
+AutomationEngine::~AutomationEngine() {
+    delete mTimings;
+}
+
 void AutomationEngine::startRunning() {
     mRequestStart = true;
 }
@@ -94,11 +194,24 @@ void AutomationEngine::startBatchMode() {
     mBatchModeEnabled = true;
 }
 
+void AutomationEngine::stopRunning() {
+    mIsRunning = false;
+    stopTimings();
+}
+
 void AutomationEngine::terminate() {
     stopRunning();
     mTerminated = true;
 }
 
+void AutomationEngine::stopTimings() {
+    if (mTimings && mTimings->renderer) {
+        mTimings->renderer->setFrameTimingsCallback(nullptr);
+        mTimings->renderer = nullptr;
+        mTimings->collecting = false;
+    }
+}
+
 void AutomationEngine::exportSettings(const Settings& settings, const char* filename) {
     std::string contents = writeJson(settings);
     std::ofstream out(filename);
@@ -119,6 +232,15 @@ void AutomationEngine::tick(View* view, MaterialInstance* const* materials, size
         for (size_t i = 0; i < materialCount; i++) {
             applySettings(mSettings->material, materials[i]);
         }
+        if (mTimings && mTimings->renderer) {
+            const AutomationSpec::FrameCounts counts = mSpec->getFrameCounts(mCurrentTest);
+            mTimings->warmupFrameCount = size_t(std::max(1,
+                    counts.warmup ? counts.warmup : mOptions.warmupFrameCount));
+            mTimings->measuredFrameCount = size_t(std::max(1,
+                    counts.measured ? counts.measured : mOptions.measuredFrameCount));
+            mTimings->collecting = false;
+            mTimings->tests.emplace_back();
+        }
         if (mOptions.verbose) {
             utils::slog.i << "Running test " << mCurrentTest << utils::io::endl;
         }
@@ -130,6 +252,14 @@ void AutomationEngine::tick(View* view, MaterialInstance* const* materials, size
                 mIsRunning = true;
                 mRequestStart = false;
                 mCurrentTest = 0;
+                if (mOptions.exportTimings) {
+                    if (!mTimings) {
+                        mTimings = new Timings();
+                    }
+                    mTimings->tests.clear();
+                    mTimings->renderer = renderer;
+                    renderer->setFrameTimingsCallback(&Timings::onFrameTimings, mTimings);
+                }
                 activateTest();
             }
         }
@@ -143,6 +273,18 @@ void AutomationEngine::tick(View* view, MaterialInstance* const* materials, size
         return;
     }
 
+    // Start measuring after the warm-up, then wait for the timings of all the measured frames.
+    if (mTimings && mTimings->renderer) {
+        if (size_t(mElapsedFrames) >= mTimings->warmupFrameCount) {
+            mTimings->collecting = true;
+        }
+        if (!mTimings->collecting ||
+                mTimings->tests.back().mainThreadTimeMs.size() < mTimings->measuredFrameCount) {
+            return;
+        }
+        mTimings->collecting = false;
+    }
+
     const bool isLastTest = mCurrentTest == mSpec->size() - 1;
 
     const int digits = (int) log10 ((double) mSpec->size()) + 1;
@@ -160,6 +302,20 @@ void AutomationEngine::tick(View* view, MaterialInstance* const* materials, size
         exportScreenshot(view, renderer, prefix + ".png", isLastTest, this);
     }
 
+    if (mTimings && mTimings->renderer) {
+        Timings::Test& test = mTimings->tests.back();
+        test.name = prefix;
+        test.settings = writeJson(*mSettings);
+        if (mOptions.verbose) {
+            utils::slog.i << "Measured " << test.mainThreadTimeMs.size() << " frames of test "
+                    << mCurrentTest << utils::io::endl;
+        }
+        if (isLastTest) {
+            mTimings->exportJson("timings.json");
+            stopTimings();
+        }
+    }
+
     if (isLastTest) {
         mIsRunning = false;
         if (mBatchModeEnabled && !mOptions.exportScreenshots) {
@@ -61,14 +61,18 @@ static const char* DEFAULT_AUTOMATION = R"TXT([
 ]
 )TXT";
 
+using FrameCounts = AutomationSpec::FrameCounts;
+
 struct Case {
     Settings settings;
     char const* name;
+    FrameCounts frameCounts;
 };
 
 struct CaseGroup {
     std::string name;
     std::vector<Settings> cases;
+    FrameCounts frameCounts;
 };
 
 struct AutomationSpec::Impl {
@@ -82,10 +86,16 @@ static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, std::str
     return i + 1;
 }
 
+static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, int* val) {
+    CHECK_TOKTYPE(tokens[i], JSMN_PRIMITIVE);
+    *val = strtol(jsonChunk + tokens[i].start, nullptr, 10);
+    return i + 1;
+}
+
 static int parseBaseSettings(jsmntok_t const* tokens, int i, const char* jsonChunk, Settings* out) {
     CHECK_TOKTYPE(tokens[i], JSMN_OBJECT);
     int size = tokens[i++].size;
-    for (int j = 0; j < size; ++j, i += 2) {
+    for (int j = 0; j < size; ++j) {
         std::stringstream dk(STR(tokens[i], jsonChunk));
         std::string token;
         std::string prefix;
@@ -104,6 +114,12 @@ static int parseBaseSettings(jsmntok_t const* tokens, int i, const char* jsonChu
 
         // Now that we have a complete JSON string, apply this property change.
         readJson(json.c_str(), json.size(), out);
+
+        // Skip the value, which can be an array or an object.
+        i = parse(tokens, i + 1);
+        if (i < 0) {
+            return i;
+        }
     }
     return i;
 }
@@ -131,10 +147,14 @@ static int parsePermutationsSpec(jsmntok_t const* tokens, int i, const char* jso
         CHECK_TOKTYPE(valueArray, JSMN_ARRAY);
         vector<std::string>& spec = (*out)[j];
         spec.resize(valueArray.size);
-        for (int k = 0; k < valueArray.size; k++, i++) {
+        for (int k = 0; k < valueArray.size; k++) {
             std::string json = prefix + STR(tokens[i], jsonChunk);
             for (int d = 0; d < depth; d++) {  json += " } "; }
             spec[k] = json;
+            i = parse(tokens, i);
+            if (i < 0) {
+                return i;
+            }
         }
     }
     return i;
@@ -158,6 +178,10 @@ static int parseAutomationSpec(jsmntok_t const* tokens, int i, const char* jsonC
             i = parseBaseSettings(tokens, i + 1, jsonChunk, &base);
         } else if (0 == compare(tok, jsonChunk, "permute")) {
             i = parsePermutationsSpec(tokens, i + 1, jsonChunk, &permute);
+        } else if (0 == compare(tok, jsonChunk, "warmupFrames")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->frameCounts.warmup);
+        } else if (0 == compare(tok, jsonChunk, "measuredFrames")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->frameCounts.measured);
         } else {
             slog.w << "Invalid automation key: '" << STR(tok, jsonChunk) << "'" << io::endl;
             i = parse(tokens, i + 1);
@@ -291,6 +315,7 @@ AutomationSpec* AutomationSpec::generate(const char* jsonChunk, size_t size) {
         for (const auto& settings : group.cases) {
             impl->cases[caseIndex].name = impl->names[groupIndex].c_str();
             impl->cases[caseIndex].settings = settings;
+            impl->cases[caseIndex].frameCounts = group.frameCounts;
             ++caseIndex;
         }
         ++groupIndex;
@@ -321,6 +346,13 @@ char const* AutomationSpec::getName(size_t index) const {
     return mImpl->cases.at(index).name;
 }
 
+AutomationSpec::FrameCounts AutomationSpec::getFrameCounts(size_t index) const {
+    if (index >= mImpl->cases.size()) {
+        return {};
+    }
+    return mImpl->cases.at(index).frameCounts;
+}
+
 size_t AutomationSpec::size() const { return mImpl->cases.size(); }
 AutomationSpec::AutomationSpec(Impl* impl) : mImpl(impl) {}
 AutomationSpec::~AutomationSpec() { delete mImpl; }
@@ -99,6 +99,13 @@ static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, bool* va
     return i + 1;
 }
 
+static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, math::float2* val) {
+    float values[2];
+    i = parse(tokens, i, jsonChunk, values, 2);
+    *val = {values[0], values[1]};
+    return i;
+}
+
 static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, math::float3* val) {
     float values[3];
     i = parse(tokens, i, jsonChunk, values, 3);
@@ -200,6 +207,8 @@ static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk,
         CHECK_KEY(tok);
         if (0 == compare(tok, jsonChunk, "anisotropy")) {
             i = parse(tokens, i + 1, jsonChunk, &out->anisotropy);
+        } else if (0 == compare(tok, jsonChunk, "highPrecision")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->highPrecision);
         } else {
             slog.w << "Invalid shadow options key: '" << STR(tok, jsonChunk) << "'" << io::endl;
             i = parse(tokens, i + 1);
@@ -225,6 +234,8 @@ static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk,
             i = parse(tokens, i + 1, jsonChunk, &out->feedback);
         } else if (compare(tok, jsonChunk, "enabled") == 0) {
             i = parse(tokens, i + 1, jsonChunk, &out->enabled);
+        } else if (compare(tok, jsonChunk, "upscaling") == 0) {
+            i = parse(tokens, i + 1, jsonChunk, &out->upscaling);
         } else {
             slog.w << "Invalid taa key: '" << STR(tok, jsonChunk) << "'" << io::endl;
             i = parse(tokens, i + 1);
@@ -544,6 +555,37 @@ static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk,
     return i;
 }
 
+static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk,
+        DynamicResolutionOptions* out) {
+    CHECK_TOKTYPE(tokens[i], JSMN_OBJECT);
+    int size = tokens[i++].size;
+    for (int j = 0; j < size; ++j) {
+        const jsmntok_t tok = tokens[i];
+        CHECK_KEY(tok);
+        if (0 == compare(tok, jsonChunk, "minScale")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->minScale);
+        } else if (0 == compare(tok, jsonChunk, "maxScale")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->maxScale);
+        } else if (0 == compare(tok, jsonChunk, "enabled")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->enabled);
+        } else if (0 == compare(tok, jsonChunk, "homogeneousScaling")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->homogeneousScaling);
+        } else if (0 == compare(tok, jsonChunk, "quality")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->quality);
+        } else if (0 == compare(tok, jsonChunk, "scaleStep")) {
+            i = parse(tokens, i + 1, jsonChunk, &out->scaleStep);
+        } else {
+            slog.w << "Invalid dsr key: '" << STR(tok, jsonChunk) << "'" << io::endl;
+            i = parse(tokens, i + 1);
+        }
+        if (i < 0) {
+            slog.e << "Invalid dsr value: '" << STR(tok, jsonChunk) << "'" << io::endl;
+            return i;
+        }
+    }
+    return i;
+}
+
 static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, ViewSettings* out) {
     CHECK_TOKTYPE(tokens[i], JSMN_OBJECT);
     int size = tokens[i++].size;
@@ -578,6 +620,8 @@ static int parse(jsmntok_t const* tokens, int i, const char* jsonChunk, ViewSett
             i = parse(tokens, i + 1, jsonChunk, &out->shadowType);
         } else if (compare(tok, jsonChunk, "vsmShadowOptions") == 0) {
             i = parse(tokens, i + 1, jsonChunk, &out->vsmShadowOptions);
+        } else if (compare(tok, jsonChunk, "dsr") == 0) {
+            i = parse(tokens, i + 1, jsonChunk, &out->dsr);
         } else if (compare(tok, jsonChunk, "postProcessingEnabled") == 0) {
             i = parse(tokens, i + 1, jsonChunk, &out->postProcessingEnabled);
         } else {
@@ -710,6 +754,7 @@ void applySettings(const ViewSettings& settings, View* dest) {
             settings.dynamicLighting.zLightFar);
     dest->setShadowType(settings.shadowType);
     dest->setVsmShadowOptions(settings.vsmShadowOptions);
+    dest->setDynamicResolutionOptions(settings.dsr);
     dest->setPostProcessingEnabled(settings.postProcessingEnabled);
 }
 
@@ -830,6 +875,10 @@ static std::string writeJson(const float* v, int count) {
     return oss.str();
 }
 
+static std::string writeJson(math::float2 v) {
+    return writeJson(&v.x, 2);
+}
+
 static std::string writeJson(math::float3 v) {
     return writeJson(&v.x, 3);
 }
@@ -852,7 +901,8 @@ std::string writeJson(const TemporalAntiAliasingOptions& in) {
     oss << "{\n"
         << "\"filterWidth\": " << writeJson(in.filterWidth) << ",\n"
         << "\"feedback\": " << writeJson(in.feedback) << ",\n"
-        << "\"enabled\": " << writeJson(in.enabled) << "\n"
+        << "\"enabled\": " << writeJson(in.enabled) << ",\n"
+        << "\"upscaling\": " << writeJson(in.upscaling) << "\n"
         << "}";
     return oss.str();
 }
@@ -1034,7 +1084,21 @@ std::string writeJson(const DynamicLightingSettings& in) {
 std::string writeJson(const VsmShadowOptions& in) {
     std::ostringstream oss;
     oss << "{\n"
-        << "\"anisotropy\": " << writeJson(in.anisotropy) << "\n"
+        << "\"anisotropy\": " << writeJson(in.anisotropy) << ",\n"
+        << "\"highPrecision\": " << writeJson(in.highPrecision) << "\n"
+        << "}";
+    return oss.str();
+}
+
+std::string writeJson(const DynamicResolutionOptions& in) {
+    std::ostringstream oss;
+    oss << "{\n"
+        << "\"minScale\": " << writeJson(in.minScale) << ",\n"
+        << "\"maxScale\": " << writeJson(in.maxScale) << ",\n"
+        << "\"enabled\": " << writeJson(in.enabled) << ",\n"
+        << "\"homogeneousScaling\": " << writeJson(in.homogeneousScaling) << ",\n"
+        << "\"quality\": " << writeJson(in.quality) << ",\n"
+        << "\"scaleStep\": " << writeJson(in.scaleStep) << "\n"
         << "}";
     return oss.str();
 }
@@ -1056,6 +1120,7 @@ std::string writeJson(const ViewSettings& in) {
         << "\"dynamicLighting\": " << writeJson(in.dynamicLighting) << ",\n"
         << "\"shadowType\": " << writeJson(in.shadowType) << ",\n"
         << "\"vsmShadowOptions\": " << writeJson(in.vsmShadowOptions) << ",\n"
+        << "\"dsr\": " << writeJson(in.dsr) << ",\n"
         << "\"postProcessingEnabled\": " << writeJson(in.postProcessingEnabled) << "\n"
         << "}";
     return oss.str();
@@ -301,15 +301,18 @@ void SimpleViewer::updateUserInterface() {
             int quality = (int) ssao.quality;
             int lowpass = (int) ssao.lowPassFilter;
             bool upsampling = ssao.upsampling != View::QualityLevel::LOW;
+            int downsampling = ssao.resolution < 0.375f ? 2 : (ssao.resolution < 0.75f ? 1 : 0);
 
             ImGui::SliderInt("Quality", &quality, 0, 3);
             ImGui::SliderInt("Low Pass", &lowpass, 0, 2);
+            ImGui::SliderInt("Downsampling", &downsampling, 0, 2);
             ImGui::Checkbox("High quality upsampling", &upsampling);
             ImGui::SliderFloat("Min Horizon angle", &ssao.minHorizonAngleRad, 0.0f, (float)M_PI_4);
 
             ssao.upsampling = upsampling ? View::QualityLevel::HIGH : View::QualityLevel::LOW;
             ssao.lowPassFilter = (View::QualityLevel) lowpass;
             ssao.quality = (View::QualityLevel) quality;
+            ssao.resolution = 1.0f / float(1 << downsampling);
 
             if (ImGui::CollapsingHeader("Dominant Light Shadows (experimental)")) {
                 int sampleCount = ssao.ssct.sampleCount;
@@ -349,6 +352,8 @@ void SimpleViewer::updateUserInterface() {
         snprintf(label, 32, "%d", 1 << vsmAnisotropy);
         ImGui::SliderInt("VSM anisotropy", &vsmAnisotropy, 0, 3, label);
         mSettings.view.vsmShadowOptions.anisotropy = vsmAnisotropy;
+        ImGui::Checkbox("VSM high precision", &mSettings.view.vsmShadowOptions.highPrecision);
+        ImGui::SliderFloat("VSM blur", &mVsmBlurWidth, 0.0f, 125.0f);
 
         ImGui::SliderInt("Cascades", &mShadowCascades, 1, 4);
         ImGui::Checkbox("Debug cascades",
@@ -387,6 +392,7 @@ void SimpleViewer::updateUserInterface() {
         lm.setShadowCaster(sun, mEnableShadows);
         auto options = lm.getShadowOptions(sun);
         options.vsm.msaaSamples = static_cast<uint8_t>(1u << mVsmMsaaSamplesLog2);
+        options.vsm.blurWidth = mVsmBlurWidth;
         lm.setShadowOptions(sun, options);
     } else {
         mScene->remove(mSunlight);
@@ -397,6 +403,7 @@ void SimpleViewer::updateUserInterface() {
         options.screenSpaceContactShadows = mEnableContactShadows;
         options.shadowCascades = mShadowCascades;
         options.vsm.msaaSamples = static_cast<uint8_t>(1u << mVsmMsaaSamplesLog2);
+        options.vsm.blurWidth = mVsmBlurWidth;
         std::copy_n(mSplitPositions.begin(), 3, options.cascadeSplitPositions);
         lm.setShadowOptions(ci, options);
         lm.setShadowCaster(ci, mEnableShadows);
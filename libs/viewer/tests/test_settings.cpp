@@ -124,7 +124,8 @@ static const char* JSON_TEST_DEFAULTS = R"TXT(
         },
         "shadowType": "PCF",
         "vsmShadowOptions": {
-            "anisotropy": 1
+            "anisotropy": 1,
+            "highPrecision": true
         },
         "postProcessingEnabled": true
     }
@@ -147,6 +148,24 @@ static const char* JSON_TEST_AUTOMATION = R"TXT([{
     }
 }])TXT";
 
+static const char* JSON_TEST_TIMINGS = R"TXT([{
+    "name": "test_timings",
+    "warmupFrames": 5,
+    "measuredFrames": 30,
+    "base": {
+        "view.dsr.minScale": [0.5, 0.5],
+        "view.dsr.maxScale": [0.5, 0.5]
+    },
+    "permute": {
+        "view.dsr.enabled": [false, true],
+        "view.ssao.enabled": [false, true]
+    }
+},
+{
+    "name": "test_no_timings",
+    "base": { "view.taa.enabled": true }
+}])TXT";
+
 TEST_F(ViewSettingsTest, JsonTestDefaults) {
     Settings settings1 = {0};
     ASSERT_TRUE(readJson(JSON_TEST_DEFAULTS, strlen(JSON_TEST_DEFAULTS), &settings1));
@@ -197,6 +216,30 @@ TEST_F(ViewSettingsTest, CustomAutomationSpec) {
     delete spec;
 }
 
+TEST_F(ViewSettingsTest, TimingsAutomationSpec) {
+    AutomationSpec* spec = AutomationSpec::generate(JSON_TEST_TIMINGS,
+            strlen(JSON_TEST_TIMINGS));
+    ASSERT_TRUE(spec);
+    ASSERT_EQ(spec->size(), 5);
+
+    Settings settings;
+    ASSERT_TRUE(spec->get(1, &settings));
+    ASSERT_TRUE(settings.view.dsr.enabled);
+    ASSERT_FALSE(settings.view.ssao.enabled);
+    ASSERT_EQ(settings.view.dsr.minScale.x, 0.5f);
+    ASSERT_EQ(settings.view.dsr.maxScale.y, 0.5f);
+
+    ASSERT_EQ(spec->getFrameCounts(3).warmup, 5);
+    ASSERT_EQ(spec->getFrameCounts(3).measured, 30);
+
+    ASSERT_TRUE(spec->get(4, &settings));
+    ASSERT_TRUE(settings.view.taa.enabled);
+    ASSERT_EQ(spec->getFrameCounts(4).warmup, 0);
+    ASSERT_EQ(spec->getFrameCounts(4).measured, 0);
+
+    delete spec;
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -114,6 +114,7 @@ struct App {
     std::string messageBoxText;
     std::string settingsFile;
     std::string batchFile;
+    bool batchTimings = false;
 
     AutomationSpec* automationSpec = nullptr;
     AutomationEngine* automationEngine = nullptr;
@@ -136,6 +137,9 @@ static void printUsage(char* name) {
         "       Start automation using the given JSON spec, then quit the app\n\n"
         "   --headless, -e\n"
         "       Use a headless swapchain; ignored if --batch is not present\n\n"
+        "   --perf, -p\n"
+        "       Measure the frame times of each test and write them to timings.json;\n"
+        "       ignored if --batch is not present\n\n"
         "   --ibl=<path to cmgen IBL>, -i <path>\n"
         "       Override the built-in IBL\n\n"
         "   --actual-size, -s\n"
@@ -168,12 +172,13 @@ static std::ifstream::pos_type getFileSize(const char* filename) {
 }
 
 static int handleCommandLineArguments(int argc, char* argv[], App* app) {
-    static constexpr const char* OPTSTR = "ha:i:usc:rt:b:e";
+    static constexpr const char* OPTSTR = "ha:i:usc:rt:b:ep";
     static const struct option OPTIONS[] = {
         { "help",         no_argument,       nullptr, 'h' },
         { "api",          required_argument, nullptr, 'a' },
         { "batch",        required_argument, nullptr, 'b' },
         { "headless",     no_argument,       nullptr, 'e' },
+        { "perf",         no_argument,       nullptr, 'p' },
         { "ibl",          required_argument, nullptr, 'i' },
         { "ubershader",   no_argument,       nullptr, 'u' },
         { "actual-size",  no_argument,       nullptr, 's' },
@@ -214,6 +219,9 @@ static int handleCommandLineArguments(int argc, char* argv[], App* app) {
             case 'e':
                 app->config.headless = true;
                 break;
+            case 'p':
+                app->batchTimings = true;
+                break;
             case 'i':
                 app->config.iblDirectory = arg;
                 break;
@@ -716,6 +724,7 @@ int main(int argc, char** argv) {
             options.sleepDuration = 0.0;
             options.exportScreenshots = true;
             options.exportSettings = true;
+            options.exportTimings = app.batchTimings;
             app.automationEngine->setOptions(options);
             app.viewer->stopAnimation();
         }
@@ -784,6 +793,7 @@ int main(int argc, char** argv) {
 
                 ImGui::Checkbox("Export screenshot for each test", &options.exportScreenshots);
                 ImGui::Checkbox("Export settings JSON for each test", &options.exportSettings);
+                ImGui::Checkbox("Export timings JSON for all tests", &options.exportTimings);
 
                 automation.setOptions(options);
 
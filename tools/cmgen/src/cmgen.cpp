@@ -27,6 +27,7 @@
 #include <imageio/BlockCompression.h>
 #endif
 
+#include <imageio/BatchManifest.h>
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageEncoder.h>
 
@@ -70,6 +71,7 @@ enum class OutputType {
 static image::ImageEncoder::Format g_format = image::ImageEncoder::Format::PNG;
 static OutputType g_type = OutputType::FACES;
 static std::string g_compression;
+static std::vector<std::string> g_ibl_compression;
 static bool g_extract_faces = false;
 static float g_extract_blur = 0.0;
 static utils::Path g_extract_dir;
@@ -110,6 +112,9 @@ static size_t g_num_samples = 1024;
 
 static bool g_mirror = false;
 
+static bool g_batch = false;
+static utils::Path g_batch_manifest;
+
 // -----------------------------------------------------------------------------------------------
 
 static void generateMipmaps(utils::JobSystem& js, std::vector<Cubemap>& levels,
@@ -135,7 +140,8 @@ static void UTILS_UNUSED outputSpectrum(std::ostream& out,
 static void saveImage(const std::string& path, ImageEncoder::Format format, const Image& image,
         const std::string& compression);
 static LinearImage toLinearImage(const Image& image);
-static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubemap& cm);
+static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubemap& cm,
+        const std::string& compression);
 
 // -----------------------------------------------------------------------------------------------
 
@@ -149,6 +155,7 @@ static void printUsage(char* name) {
             "Usages:\n"
             "    CMGEN [options] <input-file>\n"
             "    CMGEN [options] <uv[N]>\n"
+            "    CMGEN [options] --batch=<manifest>\n"
             "\n"
             "Supported input formats:\n"
             "    PNG, 8 and 16 bits\n"
@@ -173,7 +180,9 @@ static void printUsage(char* name) {
 #ifdef IMAGEIO_SUPPORTS_BLOCK_COMPRESSION
             "           KTX:\n"
             "             astc_[fast|thorough]_[ldr|hdr]_WxH, where WxH is a valid block size\n"
-            "             s3tc_rgba_dxt5\n"
+            "             s3tc_rgba_dxt5[_thorough]\n"
+            "             bc7_[rgba|srgba]_[fast|medium|thorough]\n"
+            "             bc6h_[fast|medium|thorough]\n"
             "             etc_FORMAT_METRIC_EFFORT\n"
             "               FORMAT is rgb8_alpha, srgb8_alpha, rgba8, or srgb8_alpha8\n"
             "               METRIC is rgba, rgbx, rec709, numeric, or normalxyz\n"
@@ -185,6 +194,15 @@ static void printUsage(char* name) {
             "           Photoshop: 16 (default), 32\n"
             "           OpenEXR: RAW, RLE, ZIPS, ZIP, PIZ (default)\n"
             "           DDS: 8, 16 (default), 32\n\n"
+#ifdef IMAGEIO_SUPPORTS_BLOCK_COMPRESSION
+            "   --ibl-compression=COMPRESSION\n"
+            "       With KTX output, also writes the pre-filtered reflections compressed with\n"
+            "       one of the KTX compressions above into <name>_ibl_<type>.ktx, <type> being\n"
+            "       the part of COMPRESSION before the first '_'. Can be repeated.\n"
+            "       HDR compressions are:\n"
+            "             bc6h_[fast|medium|thorough]\n"
+            "             astc_[fast|thorough]_hdr_WxH\n\n"
+#endif
             "   --size=power-of-two, -s power-of-two\n"
             "       Size of the output cubemaps (base level), 256 by default\n"
             "       Also applies to DFG LUT\n\n"
@@ -204,6 +222,11 @@ static void printUsage(char* name) {
             "       Roughness pre-filter into <dir>\n\n"
             "   --sh-shader\n"
             "       Generate irradiance SH for shader code\n\n"
+            "   --batch=manifest\n"
+            "       Process all the inputs listed in <manifest>, one per line, in a single run\n"
+            "       Relative paths are relative to the manifest, '#' starts a comment line\n"
+            "       Inputs and options unchanged since the previous run are skipped,\n"
+            "       delete <manifest>.stamps to process all of them again\n\n"
             "\n"
             "Private use only:\n"
             "   --ibl-dfg=filename.[exr|hdr|psd|png|rgbm|rgb32f|dds|h|hpp|c|cpp|inc|txt]\n"
@@ -258,6 +281,7 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
             { "type",                 required_argument, nullptr, 't' },
             { "format",               required_argument, nullptr, 'f' },
             { "compression",          required_argument, nullptr, 'c' },
+            { "ibl-compression",      required_argument, nullptr, 'B' },
             { "size",                 required_argument, nullptr, 's' },
             { "extract",              required_argument, nullptr, 'e' },
             { "extract-blur",         required_argument, nullptr, 'r' },
@@ -279,6 +303,7 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
             { "deploy",               required_argument, nullptr, 'x' },
             { "no-mirror",                  no_argument, nullptr, 'm' },
             { "debug",                      no_argument, nullptr, 'd' },
+            { "batch",                required_argument, nullptr, 'M' },
             { nullptr, 0, nullptr, 0 }  // termination of the option list
     };
     int opt;
@@ -357,6 +382,9 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
             case 'c':
                 g_compression = arg;
                 break;
+            case 'B':
+                g_ibl_compression.push_back(arg);
+                break;
             case 's':
                 g_output_size = std::stoul(arg);
                 if (!isPOT(g_output_size)) {
@@ -456,6 +484,10 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
             case 'm':
                 g_mirror = true;
                 break;
+            case 'M':
+                g_batch = true;
+                g_batch_manifest = arg;
+                break;
         }
     }
 
@@ -478,29 +510,13 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
     return optind;
 }
 
-int main(int argc, char* argv[]) {
-    utils::JobSystem js;
-    js.adopt();
-
-    int option_index = handleCommandLineArgments(argc, argv);
-    int num_args = argc - option_index;
-    if (!g_dfg && num_args < 1) {
-        printUsage(argv[0]);
-        return 1;
-    }
-
-    if (g_dfg) {
-        if (!g_quiet) {
-            std::cout << "Generating IBL DFG LUT..." << std::endl;
-        }
-        size_t size = g_output_size ? g_output_size : DFG_LUT_DEFAULT_SIZE;
-        iblLutDfg(js, g_dfg_filename, size, g_dfg_multiscatter, g_dfg_cloth);
-        if (num_args < 1) return 0;
-    }
-
-    std::string command(argv[option_index]);
-    utils::Path iname(command);
+static LinearImage decodeInput(const utils::Path& iname) {
+    std::ifstream input_stream(iname.getPath(), std::ios::binary);
+    return ImageDecoder::decode(input_stream, iname.getPath());
+}
 
+// Generates the outputs for one input, 'linputImage' is the decoded input file if it exists.
+static int processInput(utils::JobSystem& js, const utils::Path& iname, LinearImage linputImage) {
     if (g_deploy) {
         utils::Path sh_dir = g_deploy_dir;
 
@@ -533,19 +549,14 @@ int main(int argc, char* argv[]) {
     std::vector<Cubemap> levels;
 
     if (iname.exists()) {
-        if (!g_quiet) {
-            std::cout << "Decoding image..." << std::endl;
-        }
-        std::ifstream input_stream(iname.getPath(), std::ios::binary);
-        LinearImage linputImage = ImageDecoder::decode(input_stream, iname.getPath());
         if (!linputImage.isValid()) {
             std::cerr << "Unable to open image: " << iname.getPath() << std::endl;
-            exit(1);
+            return 1;
         }
         if (linputImage.getChannels() != 3) {
             std::cerr << "Input image must be RGB (3 channels)! This image has "
                       << linputImage.getChannels() << " channels." << std::endl;
-            exit(1);
+            return 1;
         }
 
         // Convert from LinearImage to the deprecated Image object which is used throughout cmgen.
@@ -587,7 +598,7 @@ int main(int argc, char* argv[]) {
             std::cerr << "  2:1, lat/long or equirectangular" << std::endl;
             std::cerr << "  3:4, vertical cross (height must be power of two)" << std::endl;
             std::cerr << "  4:3, horizontal cross (width must be power of two)" << std::endl;
-            exit(0);
+            return 1;
         }
     } else {
         if (!g_quiet) {
@@ -617,8 +628,6 @@ int main(int argc, char* argv[]) {
         levels.push_back(std::move(cml));
     }
 
-    // we mirror by default -- the mirror option in fact un-mirrors.
-    g_mirror = !g_mirror;
     if (g_mirror) {
         if (!g_quiet) {
             std::cout << "Mirroring..." << std::endl;
@@ -704,6 +713,125 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
+// Processes the inputs of a manifest one after the other, since each of them already uses all the
+// threads of the job system. The next input is decoded in a job while the current one is filtered.
+static int processBatch(utils::JobSystem& js, int argc, char* argv[], int option_index) {
+    // the options apply to every input, an input is reprocessed when they change
+    std::string settings;
+    for (int i = 1; i < option_index; i++) {
+        settings.append(argv[i]).append(" ");
+    }
+
+    BatchManifest manifest;
+    if (!manifest.load(g_batch_manifest, settings)) {
+        std::cerr << "Unable to open manifest: " << g_batch_manifest << std::endl;
+        return 1;
+    }
+
+    auto& entries = manifest.getEntries();
+    std::vector<size_t> pending;
+    size_t failed = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].args.size() != 1) {
+            std::cerr << "Expected a single input per line in manifest: "
+                    << entries[i].args[0] << std::endl;
+            failed++;
+            continue;
+        }
+        if (!manifest.isUpToDate(i)) {
+            pending.push_back(i);
+        }
+    }
+
+    struct Prefetch {
+        utils::Path iname;
+        LinearImage image;
+    };
+    auto prefetch = [&js](Prefetch* next) {
+        utils::JobSystem::Job* job = utils::jobs::createJob(js, nullptr, [next]() {
+            if (next->iname.exists()) {
+                next->image = decodeInput(next->iname);
+            }
+        });
+        js.run(job);
+        return job;
+    };
+
+    Prefetch current, next;
+    utils::JobSystem::Job* job = nullptr;
+    if (!pending.empty()) {
+        next.iname = entries[pending[0]].args[0];
+        job = prefetch(&next);
+    }
+
+    for (size_t p = 0; p < pending.size(); p++) {
+        js.waitAndRelease(job);
+        job = nullptr;
+        std::swap(current, next);
+        next.image.reset();
+        if (p + 1 < pending.size()) {
+            next.iname = entries[pending[p + 1]].args[0];
+            job = prefetch(&next);
+        }
+
+        if (!g_quiet) {
+            std::cout << "Processing " << current.iname << "..." << std::endl;
+        }
+        if (processInput(js, current.iname, std::move(current.image)) == 0) {
+            manifest.setProcessed(pending[p]);
+        } else {
+            failed++;
+        }
+    }
+
+    manifest.saveStamps();
+    if (!g_quiet) {
+        std::cout << "Done, " << pending.size() << " of " << entries.size()
+                << " inputs out of date, " << failed << " failed." << std::endl;
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    utils::JobSystem js;
+    js.adopt();
+
+    int option_index = handleCommandLineArgments(argc, argv);
+    int num_args = argc - option_index;
+    if (!g_dfg && !g_batch && num_args < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // we mirror by default -- the mirror option in fact un-mirrors.
+    g_mirror = !g_mirror;
+
+    if (g_dfg) {
+        if (!g_quiet) {
+            std::cout << "Generating IBL DFG LUT..." << std::endl;
+        }
+        size_t size = g_output_size ? g_output_size : DFG_LUT_DEFAULT_SIZE;
+        iblLutDfg(js, g_dfg_filename, size, g_dfg_multiscatter, g_dfg_cloth);
+        if (!g_batch && num_args < 1) return 0;
+    }
+
+    if (g_batch) {
+        return processBatch(js, argc, argv, option_index);
+    }
+
+    std::string command(argv[option_index]);
+    utils::Path iname(command);
+
+    LinearImage linputImage;
+    if (iname.exists()) {
+        if (!g_quiet) {
+            std::cout << "Decoding image..." << std::endl;
+        }
+        linputImage = decodeInput(iname);
+    }
+    return processInput(js, iname, std::move(linputImage));
+}
+
 void generateMipmaps(utils::JobSystem& js, std::vector<Cubemap>& levels,
         std::vector<Image>& images) {
     Image temp;
@@ -947,6 +1075,18 @@ void iblRoughnessPrefilter(
         .pixelDepth = 0,
     };
 
+    // and one more for each of the --ibl-compression options
+    std::vector<std::unique_ptr<KtxBundle>> compressedContainers;
+    for (size_t i = 0; i < g_ibl_compression.size(); i++) {
+        compressedContainers.emplace_back(new KtxBundle((uint32_t) numLevels, 1, true));
+        compressedContainers.back()->info() = container.info();
+    }
+
+    // all the levels are filtered together, so that their work is balanced between the threads
+    std::vector<Image> images(numLevels);
+    std::vector<Cubemap> cubemaps;
+    std::vector<CubemapIBL::RoughnessLevel> roughnessLevels(numLevels);
+    cubemaps.reserve(numLevels);
     for (ssize_t i = baseExp; i >= ssize_t((baseExp + 1) - numLevels) ; --i) {
         const size_t dim = 1U << (DEBUG_FULL_RESOLUTION ? baseExp : i); // NOLINT
         const size_t level = baseExp - i;
@@ -969,23 +1109,29 @@ void iblRoughnessPrefilter(
                       << ", roughness (perceptual) = " << perceptualRoughness
                     << std::endl;
         }
-        Image image;
-        Cubemap dst = CubemapUtils::create(image, dim);
+        cubemaps.push_back(CubemapUtils::create(images[level], dim));
+        roughnessLevels[level] = { &cubemaps.back(), roughness, numSamples };
+    }
 
-        ProgressUpdater updater(1);
-        if (!g_quiet) {
-            updater.start();
-        }
-        CubemapIBL::roughnessFilter(js, dst, levels, roughness, numSamples,
-                float3{ 1, 1, 1 }, prefilter,
-                [](size_t index, float v, void* userdata) {
-                    if (!g_quiet) {
-                        ((ProgressUpdater*) userdata)->update(index, v);
-                    }
-                }, &updater);
-        if (!g_quiet) {
-            updater.stop();
-        }
+    ProgressUpdater updater(1);
+    if (!g_quiet) {
+        updater.start();
+    }
+    CubemapIBL::roughnessFilter(js, roughnessLevels.data(), roughnessLevels.size(), levels,
+            float3{ 1, 1, 1 }, prefilter,
+            [](size_t index, float v, void* userdata) {
+                if (!g_quiet) {
+                    ((ProgressUpdater*) userdata)->update(index, v);
+                }
+            }, &updater);
+    if (!g_quiet) {
+        updater.stop();
+    }
+
+    for (size_t level = 0; level < numLevels; level++) {
+        Cubemap& dst = cubemaps[level];
+        const Image& image = images[level];
+        const size_t dim = dst.getDimensions();
 
         dst.makeSeamless();
 
@@ -1000,7 +1146,11 @@ void iblRoughnessPrefilter(
         std::string ext = ImageEncoder::chooseExtension(g_format);
 
         if (g_type == OutputType::KTX) {
-            exportKtxFaces(container, (uint32_t) level, dst);
+            exportKtxFaces(container, (uint32_t) level, dst, g_compression);
+            for (size_t i = 0; i < g_ibl_compression.size(); i++) {
+                exportKtxFaces(*compressedContainers[i], (uint32_t) level, dst,
+                        g_ibl_compression[i]);
+            }
             continue;
         }
 
@@ -1029,23 +1179,33 @@ void iblRoughnessPrefilter(
     }
 
     if (g_type == OutputType::KTX) {
+        std::ostringstream sstr;
         if (g_sh_coefficients) {
-            std::ostringstream sstr;
             for (ssize_t l = 0; l < g_sh_compute; l++) {
                 for (ssize_t m = -l; m <= l; m++) {
                     auto v = g_sh_coefficients[CubemapSH::getShIndex(m, (size_t) l)];
                     sstr << v.r << " " << v.g << " " << v.b << "\n";
                 }
             }
-            container.setMetadata("sh", sstr.str().c_str());
         }
-        std::vector<uint8_t> fileContents(container.getSerializedLength());
-        container.serialize(fileContents.data(), (uint32_t) fileContents.size());
-        std::string filename = dir.getNameWithoutExtension() + "_ibl.ktx";
-        auto fullpath = outputDir + filename;
-        std::ofstream outputStream(fullpath.c_str(), std::ios::out | std::ios::binary);
-        outputStream.write((const char*) fileContents.data(), fileContents.size());
-        outputStream.close();
+        auto writeKtx = [&](KtxBundle& bundle, std::string const& suffix) {
+            if (g_sh_coefficients) {
+                bundle.setMetadata("sh", sstr.str().c_str());
+            }
+            std::vector<uint8_t> fileContents(bundle.getSerializedLength());
+            bundle.serialize(fileContents.data(), (uint32_t) fileContents.size());
+            std::string filename = dir.getNameWithoutExtension() + suffix;
+            auto fullpath = outputDir + filename;
+            std::ofstream outputStream(fullpath.c_str(), std::ios::out | std::ios::binary);
+            outputStream.write((const char*) fileContents.data(), fileContents.size());
+            outputStream.close();
+        };
+        writeKtx(container, "_ibl.ktx");
+        for (size_t i = 0; i < g_ibl_compression.size(); i++) {
+            const std::string& compression = g_ibl_compression[i];
+            writeKtx(*compressedContainers[i],
+                    "_ibl_" + compression.substr(0, compression.find('_')) + ".ktx");
+        }
     }
 }
 
@@ -1205,7 +1365,7 @@ void extractCubemapFaces(utils::JobSystem& js, const utils::Path& iname, const C
             .pixelHeight = dim,
             .pixelDepth = 0,
         };
-        exportKtxFaces(container, 0, cm);
+        exportKtxFaces(container, 0, cm, g_compression);
         std::string filename = dir.getNameWithoutExtension() + "_skybox.ktx";
         auto fullpath = outputDir + filename;
         std::vector<uint8_t> fileContents(container.getSerializedLength());
@@ -1266,15 +1426,16 @@ static void saveImage(const std::string& path, ImageEncoder::Format format, cons
     }
 }
 
-static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubemap& cm) {
+static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubemap& cm,
+        const std::string& compressionString) {
     auto& info = container.info();
 
 #ifdef IMAGEIO_SUPPORTS_BLOCK_COMPRESSION
     CompressionConfig compression {};
-    if (!g_compression.empty()) {
-        bool valid = parseOptionString(g_compression, &compression);
+    if (!compressionString.empty()) {
+        bool valid = parseOptionString(compressionString, &compression);
         if (!valid) {
-            std::cerr << "Unrecognized compression: " << g_compression << std::endl;
+            std::cerr << "Unrecognized compression: " << compressionString << std::endl;
             exit(1);
         }
         // The KTX spec says the following for compressed textures: glTypeSize should 1,
@@ -1287,7 +1448,7 @@ static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubema
         info.glInternalFormat = KtxBundle::RGB;
     }
 #else
-    if (!g_compression.empty()) {
+    if (!compressionString.empty()) {
         std::cerr << "Block compression is not supported in this build." << std::endl;
         exit(1);
     }
@@ -1306,10 +1467,11 @@ static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubema
             case 5: face = Cubemap::Face::NZ; break;
             default: face = Cubemap::Face::PX; break; // make linters happy
         }
-        LinearImage image = toLinearImage(cm.getImageForFace(face));
+        const Image& faceImage = cm.getImageForFace(face);
 
 #ifdef IMAGEIO_SUPPORTS_BLOCK_COMPRESSION
         if (compression.type != CompressionConfig::INVALID) {
+            LinearImage image = toLinearImage(faceImage);
             CompressedTexture tex = compressTexture(compression, image);
             container.setBlob(blobIndex, tex.data.get(), tex.size);
             info.glInternalFormat = (uint32_t) tex.format;
@@ -1317,7 +1479,17 @@ static void exportKtxFaces(KtxBundle& container, uint32_t miplevel, const Cubema
         }
 #endif
 
-        auto uintData = fromLinearToRGB_10_11_11_REV(image);
-        container.setBlob(blobIndex, uintData.get(), dim * dim * 4);
+        // convert the face directly into the container's blob
+        uint8_t* data;
+        uint32_t size;
+        container.allocateBlob(blobIndex, dim * dim * 4);
+        container.getBlob(blobIndex, &data, &size);
+        uint32_t* texels = reinterpret_cast<uint32_t*>(data);
+        for (size_t y = 0; y < dim; y++) {
+            float3 const* src = static_cast<float3 const*>(faceImage.getPixelRef(0, y));
+            for (size_t x = 0; x < dim; x++) {
+                *texels++ = linearToRGB_10_11_11_REV(src[x]);
+            }
+        }
     }
 }
@@ -40,12 +40,69 @@ size_t write(unsigned char* out, const vector<T>& data) {
     return data.size() * sizeof(T);
 }
 
-void MeshWriter::optimize(Mesh& mesh) {
+vector<float3> MeshWriter::getPositions(Mesh const& mesh, bool interleaved) {
+    vector<float3> positions(mesh.vertexCount);
+    for (size_t i = 0; i < mesh.vertexCount; i++) {
+        const half4 p = interleaved ? mesh.vertices[i].position : mesh.positions[i];
+        positions[i] = float3(p.xyz);
+    }
+    return positions;
+}
+
+void MeshWriter::generateLevelsOfDetail(Mesh& mesh, vector<float3> const& positions) {
+    // Each level simplifies all the parts of the original mesh to half the triangles of the
+    // previous level, its parts are appended to the index buffer. The vertices are shared.
+    const size_t partCount = mesh.parts.size();
+    mesh.levels.push_back({ uint32_t(partCount), 0.5f });
+    vector<uint32_t> simplified;
+    for (uint32_t level = 1; level < mLevelCount; level++) {
+        const size_t previous = (level - 1) * partCount;
+        size_t previousIndexCount = 0;
+        size_t indexCount = 0;
+        for (size_t i = 0; i < partCount; i++) {
+            Part part = mesh.parts[previous + i];
+            previousIndexCount += part.indexCount;
+            const size_t target = (part.indexCount / 6) * 3;
+            simplified.resize(part.indexCount);
+            part.indexCount = uint32_t(meshopt_simplify(simplified.data(),
+                    mesh.indices.data() + part.offset, part.indexCount,
+                    &positions.data()->x, mesh.vertexCount, sizeof(float3), target,
+                    0.02f * float(level)));
+            part.offset = uint32_t(mesh.indices.size());
+            mesh.indices.insert(mesh.indices.end(),
+                    simplified.begin(), simplified.begin() + part.indexCount);
+            mesh.parts.push_back(part);
+            indexCount += part.indexCount;
+        }
+
+        // stop once the error threshold prevents the simplification
+        if (indexCount * 10 > previousIndexCount * 9) {
+            mesh.indices.resize(mesh.parts[mesh.parts.size() - partCount].offset);
+            mesh.parts.resize(mesh.parts.size() - partCount);
+            break;
+        }
+
+        // each level is used down to half the size on screen of the previous one
+        mesh.levels.push_back({ uint32_t(partCount), mesh.levels.back().screenSize * 0.5f });
+    }
+    if (mesh.levels.size() == 1) {
+        cerr << "The mesh can't be simplified, no levels of detail were added." << endl;
+        mesh.levels.clear();
+    }
+}
+
+void MeshWriter::optimize(Mesh& mesh, vector<float3> const& positions) {
     // First, re-order triangles to improve cache locality and reduce the number of VS invocations.
     // Note that assimp already has aiProcess_ImproveCacheLocality, but MeshWriter doesn't know
     // about assimp, and it doesn't hurt to do it again here since this generally runs offline.
-    meshopt_optimizeVertexCache(mesh.indices.data(), mesh.indices.data(), mesh.indices.size(),
-                mesh.vertexCount);
+    // Then re-order them again to reduce overdraw, while keeping most of the cache efficiency.
+    // Triangles are only re-ordered within their part, since parts are ranges of the index buffer.
+    for (Part const& part : mesh.parts) {
+        uint32_t* indices = mesh.indices.data() + part.offset;
+        meshopt_optimizeVertexCache(indices, indices, part.indexCount, mesh.vertexCount);
+        meshopt_optimizeOverdraw(indices, indices, part.indexCount, &positions.data()->x,
+                mesh.vertexCount, sizeof(float3), 1.05f);
+    }
 
     // At this point, triangle order has been established but we still need to shuffle vertices to
     // optimize the fetch. This makes it so that lower-numbered indices generally come before
@@ -85,17 +142,25 @@ void MeshWriter::optimize(Mesh& mesh) {
 
     // As a last step, the meshoptimizer README recommends applying individual meshopt_quantize*
     // functions as needed, but we actually already quantized the data according to our constraints
-    // e.g. we already (potentially) use snorm16 for uvs, half-floats for tangents, etc.
+    // e.g. we already (potentially) use snorm16 for uvs, half-floats for positions, etc. Tangent
+    // frames are quantized further by serialize() when TANGENTS_SNORM8 is set.
 }
 
 bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
     const bool hasIndex16 = mesh.vertexCount <= numeric_limits<uint16_t>::max();
     const bool hasUV1 = !mesh.uv1.empty();
-    const size_t vertexSize = sizeof(Vertex) + (hasUV1 ? sizeof(ushort2) : 0);
+    const bool hasTangents8 = mFlags & TANGENTS_SNORM8;
+    const size_t tangentSize = hasTangents8 ? sizeof(byte4) : sizeof(Vertex::tangents);
+    const size_t vertexSize = sizeof(Vertex) - sizeof(Vertex::tangents) + tangentSize +
+            (hasUV1 ? sizeof(ushort2) : 0);
     if ((mFlags & INTERLEAVED) && hasUV1) {
         cerr << "Interleaved vertices can only have 1 UV set." << endl;
         return false;
     }
+    if ((mFlags & INTERLEAVED) && hasTangents8) {
+        cerr << "Interleaved vertices cannot have 8 bits tangents." << endl;
+        return false;
+    }
 
     // Compute the overall bounding box.
     Box aabb = mesh.parts.at(0).aabb;
@@ -103,8 +168,23 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
         aabb.unionSelf(mesh.parts.at(i).aabb);
     }
 
+    // Levels of detail are generated first so that they're optimized too.
+    const vector<float3> positions = getPositions(mesh, mFlags & INTERLEAVED);
+    if (mLevelCount > 1) {
+        generateLevelsOfDetail(mesh, positions);
+    }
+
     // It's safe to optimize the mesh regardless of the compression setting.
-    optimize(mesh);
+    optimize(mesh, positions);
+
+    // The tangent frames were packed for 8 bits storage, so w is never 0 after quantization.
+    vector<byte4> tangents8;
+    if (hasTangents8) {
+        tangents8.resize(mesh.vertexCount);
+        for (size_t i = 0; i < mesh.vertexCount; i++) {
+            tangents8[i] = packSnorm8(unpackSnorm16(mesh.tangents[i]));
+        }
+    }
 
     // Perform compression of vertex data if it has been requested.
     CompressionHeader cheader {};
@@ -123,8 +203,9 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
                     mesh.vertexCount, sizeof(decltype(Vertex::position)));
             cptr += cheader.positions;
 
-            cheader.tangents = meshopt_encodeVertexBuffer(cptr, cend - cptr, mesh.tangents.data(),
-                    mesh.vertexCount, sizeof(decltype(Vertex::tangents)));
+            cheader.tangents = meshopt_encodeVertexBuffer(cptr, cend - cptr,
+                    hasTangents8 ? (void const*) tangents8.data() : mesh.tangents.data(),
+                    mesh.vertexCount, tangentSize);
             cptr += cheader.tangents;
 
             cheader.colors = meshopt_encodeVertexBuffer(cptr, cend - cptr, mesh.colors.data(),
@@ -171,7 +252,7 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
     header.version = VERSION;
     header.parts = uint32_t(mesh.parts.size());
     header.aabb = aabb;
-    header.flags = mFlags;
+    header.flags = mFlags | (mesh.levels.empty() ? 0 : LEVELS_OF_DETAIL);
     if (mFlags & INTERLEAVED) {
         header.offsetPosition = offsetof(Vertex, position);
         header.offsetTangents = offsetof(Vertex, tangents);
@@ -186,7 +267,7 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
     } else {
         header.offsetPosition = 0;
         header.offsetTangents = mesh.vertexCount * sizeof(Vertex::position);
-        header.offsetColor    = header.offsetTangents + mesh.vertexCount * sizeof(Vertex::tangents);
+        header.offsetColor    = header.offsetTangents + mesh.vertexCount * tangentSize;
         header.offsetUV0      = header.offsetColor + mesh.vertexCount * sizeof(Vertex::color);
         header.offsetUV1      = numeric_limits<uint32_t>::max();;
         header.stridePosition = 0;
@@ -220,7 +301,11 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
         write(out, mesh.vertices.data(), uint32_t(mesh.vertices.size()));
     } else {
         write(out, mesh.positions.data(), uint32_t(mesh.positions.size()));
-        write(out, mesh.tangents.data(),  uint32_t(mesh.tangents.size()));
+        if (hasTangents8) {
+            write(out, tangents8.data(), uint32_t(tangents8.size()));
+        } else {
+            write(out, mesh.tangents.data(), uint32_t(mesh.tangents.size()));
+        }
         write(out, mesh.colors.data(), uint32_t(mesh.colors.size()));
         write(out, mesh.uv0.data(), uint32_t(mesh.uv0.size()));
         if (hasUV1) {
@@ -250,5 +335,10 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
         write(out, char(0));
     }
 
+    if (!mesh.levels.empty()) {
+        write(out, uint32_t(mesh.levels.size()));
+        write(out, mesh.levels.data(), uint32_t(mesh.levels.size()));
+    }
+
     return true;
 }
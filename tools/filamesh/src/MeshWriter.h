@@ -28,6 +28,8 @@
 
 namespace filamesh {
 
+using byte4 = filament::math::byte4;
+using float3 = filament::math::float3;
 using half4 = filament::math::half4;
 using short4 = filament::math::short4;
 using ubyte4 = filament::math::ubyte4;
@@ -53,13 +55,19 @@ struct Mesh {
     std::vector<decltype(Vertex::color)>     colors;
     std::vector<decltype(Vertex::uv0)>       uv0;
     std::vector<decltype(Vertex::uv0)>       uv1;
+    // filled by MeshWriter when it generates levels of detail
+    std::vector<LevelOfDetail> levels;
 };
 
 class MeshWriter {
     uint32_t mFlags;
-    void optimize(Mesh& mesh);
+    uint32_t mLevelCount;
+    static std::vector<float3> getPositions(Mesh const& mesh, bool interleaved);
+    void generateLevelsOfDetail(Mesh& mesh, std::vector<float3> const& positions);
+    void optimize(Mesh& mesh, std::vector<float3> const& positions);
 public:
-    MeshWriter(uint32_t flags) : mFlags(flags) {}
+    // levelCount includes the original mesh, more levels are made by simplifying it
+    MeshWriter(uint32_t flags, uint32_t levelCount = 1) : mFlags(flags), mLevelCount(levelCount) {}
     bool serialize(std::ostream&, Mesh& mesh);
 };
 
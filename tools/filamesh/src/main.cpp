@@ -16,6 +16,7 @@
 
 #include "MeshWriter.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -47,6 +48,8 @@ using Assimp::Importer;
 bool g_interleaved = false;
 bool g_snormUVs = false;
 bool g_compression = false;
+bool g_quantizeTangents = false;
+uint32_t g_levelCount = 1;
 
 Mesh g_mesh;
 float2 g_minUV = float2(std::numeric_limits<float>::max());
@@ -161,7 +164,8 @@ void processNode(const aiScene* scene, const aiNode* node, std::vector<Part>& me
                 for (size_t j = 0; j < numVertices; j++) {
                     quatf q;
                     if (uv0) {
-                        q = mat3f::packTangentFrame({tangents[j], bitangents[j], normals[j]});
+                        q = mat3f::packTangentFrame({tangents[j], bitangents[j], normals[j]},
+                                g_quantizeTangents ? sizeof(int8_t) : sizeof(int16_t));
                     } else {
                         q = quatf(0, 0, 0, 1);
                     }
@@ -241,6 +245,12 @@ static void printUsage(const char* name) {
                     "       interleaves mesh attributes\n\n"
                     "   --compress, -c\n"
                     "       enable compression\n\n"
+                    "   --quantize, -q\n"
+                    "       quantize tangent frames to 8 bits per component,\n"
+                    "       cannot be used with --interleaved\n\n"
+                    "   --lods=<count>, -L <count>\n"
+                    "       number of levels of detail, including the original mesh, up to 8.\n"
+                    "       The others are made by simplifying the previous level by half\n\n"
     );
 
     const std::string from("FILAMESH");
@@ -262,12 +272,14 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[]) {
-    static constexpr const char* OPTSTR = "hilc";
+    static constexpr const char* OPTSTR = "hilcqL:";
     static const struct option OPTIONS[] = {
             { "help",        no_argument, 0, 'h' },
             { "license",     no_argument, 0, 'l' },
             { "interleaved", no_argument, 0, 'i' },
             { "compress",    no_argument, 0, 'c' },
+            { "quantize",    no_argument, 0, 'q' },
+            { "lods",  required_argument, 0, 'L' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -292,6 +304,12 @@ static int handleArguments(int argc, char* argv[]) {
             case 'c':
                 g_compression = true;
                 break;
+            case 'q':
+                g_quantizeTangents = true;
+                break;
+            case 'L':
+                g_levelCount = uint32_t(std::min(std::max(atoi(optarg), 1), 8));
+                break;
         }
     }
 
@@ -399,7 +417,13 @@ int main(int argc, char* argv[]) {
     if (g_compression) {
         flags |= filamesh::COMPRESSION;
     }
-    MeshWriter(flags).serialize(out, g_mesh);
+    if (g_quantizeTangents) {
+        flags |= filamesh::TANGENTS_SNORM8;
+    }
+    if (!MeshWriter(flags, g_levelCount).serialize(out, g_mesh)) {
+        out.close();
+        return 1;
+    }
 
     out.flush();
     out.close();
@@ -0,0 +1,639 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <backend/Platform.h>
+
+#include "private/backend/CommandBufferQueue.h"
+#include "private/backend/CommandCapture.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/UniformBufferUpdate.h"
+
+#include <utils/CString.h>
+#include <utils/Path.h>
+
+#include <getopt/getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filament::backend;
+using namespace utils;
+
+static constexpr size_t COMMAND_BUFFER_MIN_SIZE = 4 * 1024 * 1024;
+static constexpr size_t COMMAND_BUFFER_SIZE = 3 * COMMAND_BUFFER_MIN_SIZE;
+
+static Backend g_backend = Backend::DEFAULT;
+static uint32_t g_width = 1920;
+static uint32_t g_height = 1080;
+static bool g_printFrames = false;
+
+static const char* USAGE = R"TXT(
+FRAMEREPLAY replays the driver commands captured by a Filament application, and reports how long
+each frame takes to execute.
+
+To capture the commands, set the FILAMENT_COMMAND_CAPTURE environment variable (or the
+filament.capture system property on Android) to the path of the capture before starting the
+application. All the commands executed from the creation of the engine are recorded, along with
+the contents of the buffers and the images they upload.
+
+The capture must be replayed by a FRAMEREPLAY built from the same version of Filament, on a
+platform with the same pointer size. The swap chains are replaced by headless swap chains, and
+the external images and streams are replaced by blank textures.
+
+Usage:
+    FRAMEREPLAY [options] <capture>
+
+Options:
+   --help, -h
+       Print this message
+   --license, -L
+       Print copyright and license information
+   --api, -a
+       Specify the backend API: opengl (default), vulkan, metal or noop
+   --size=WIDTHxHEIGHT, -s WIDTHxHEIGHT
+       Size of the swap chains, 1920x1080 by default
+   --frames, -f
+       Print the time of each frame, not only their statistics
+
+Example:
+    FRAMEREPLAY -a vulkan capture.bin
+)TXT";
+
+static void printUsage(const char* name) {
+    std::string execName(Path(name).getName());
+    const std::string from("FRAMEREPLAY");
+    std::string usage(USAGE);
+    for (size_t pos = usage.find(from); pos != std::string::npos; pos = usage.find(from, pos)) {
+        usage.replace(pos, from.length(), execName);
+    }
+    puts(usage.c_str());
+}
+
+static void license() {
+    static const char *license[] = {
+        #include "licenses/licenses.inc"
+        nullptr
+    };
+
+    const char **p = &license[0];
+    while (*p)
+        std::cout << *p++ << std::endl;
+}
+
+static int handleArguments(int argc, char* argv[]) {
+    static constexpr const char* OPTSTR = "hLa:s:f";
+    static const struct option OPTIONS[] = {
+            { "help",         no_argument, nullptr, 'h' },
+            { "license",      no_argument, nullptr, 'L' },
+            { "api",    required_argument, nullptr, 'a' },
+            { "size",   required_argument, nullptr, 's' },
+            { "frames",       no_argument, nullptr, 'f' },
+            { nullptr, 0, nullptr, 0 }  // termination of the option list
+    };
+
+    int opt;
+    int optionIndex = 0;
+
+    while ((opt = getopt_long(argc, argv, OPTSTR, OPTIONS, &optionIndex)) >= 0) {
+        std::string arg(optarg ? optarg : "");
+        switch (opt) {
+            default:
+            case 'h':
+                printUsage(argv[0]);
+                exit(0);
+            case 'L':
+                license();
+                exit(0);
+            case 'a':
+                if (arg == "opengl") {
+                    g_backend = Backend::OPENGL;
+                } else if (arg == "vulkan") {
+                    g_backend = Backend::VULKAN;
+                } else if (arg == "metal") {
+                    g_backend = Backend::METAL;
+                } else if (arg == "noop") {
+                    g_backend = Backend::NOOP;
+                } else {
+                    std::cerr << "Unrecognized backend. Must be 'opengl'|'vulkan'|'metal'|'noop'."
+                              << std::endl;
+                    exit(1);
+                }
+                break;
+            case 's':
+                if (sscanf(arg.c_str(), "%ux%u", &g_width, &g_height) != 2 ||
+                        !g_width || !g_height) {
+                    std::cerr << "The size must be given as WIDTHxHEIGHT." << std::endl;
+                    exit(1);
+                }
+                break;
+            case 'f':
+                g_printFrames = true;
+                break;
+        }
+    }
+
+    return optind;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+/*
+ * Replayer reads the commands of a capture (see CommandCapture.h) and issues them to a
+ * CommandStream, whose commands are executed when the buffer fills up and at the end of each
+ * frame. The handles of the capture are mapped to the handles created by the replay.
+ */
+class Replayer {
+public:
+    Replayer(Driver& driver, FILE* file)
+            : mDriver(driver), mFile(file),
+              mQueue(COMMAND_BUFFER_MIN_SIZE, COMMAND_BUFFER_SIZE),
+              mStream(driver, mQueue.getCircularBuffer()) {
+    }
+
+    bool readHeader() noexcept {
+        CommandCapture::Header header{};
+        read(&header, sizeof(header));
+        if (mError || memcmp(header.magic, CommandCapture::MAGIC, sizeof(header.magic)) != 0) {
+            std::cerr << "This file isn't a Filament capture." << std::endl;
+            return false;
+        }
+        if (header.version != CommandCapture::VERSION || header.sizeOfSizeT != sizeof(size_t)) {
+            std::cerr << "This capture was recorded by another version of Filament, "
+                         "or on another platform." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Returns false at the end of the capture, or if it's corrupted.
+    bool replayCommand() {
+        CapturedCommand command;
+        read(&command, sizeof(command));
+        if (mError) {
+            return false;
+        }
+        if (!replaySpecialCommand(command) && !replayGenericCommand(command)) {
+            std::cerr << "Unknown command " << uint32_t(command) << ", stopping." << std::endl;
+            return false;
+        }
+        const size_t used = size_t((char*)mQueue.getCircularBuffer().getHead() -
+                                   (char*)mQueue.getCircularBuffer().getTail());
+        if (used >= COMMAND_BUFFER_MIN_SIZE / 2) {
+            execute();
+        }
+        return !mError;
+    }
+
+    // executes the commands of an incomplete frame, and terminates the driver
+    void terminate() {
+        mStream.finish();
+        execute();
+        mDriver.purge();
+        mDriver.terminate();
+    }
+
+    std::vector<double> const& getFrameTimes() const noexcept { return mFrameTimes; }
+
+    bool hasError() const noexcept { return mError; }
+
+private:
+    template<typename T>
+    struct Type {};
+
+    // ---------------------------------------------------------------------------------------------
+    // Reading the arguments
+
+    void read(void* data, size_t size) noexcept {
+        if (size && fread(data, size, 1, mFile) != 1) {
+            mError = true;
+        }
+    }
+
+    template<typename T>
+    T get(Type<T>) noexcept {
+        static_assert(std::is_trivially_copyable<T>::value, "this type needs its own get()");
+        T value{};
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    Handle<T> get(Type<Handle<T>>) noexcept {
+        return toHandle<T>(get(Type<HandleBase::HandleId>{}));
+    }
+
+    // callbacks and native objects aren't captured
+    template<typename T>
+    T* get(Type<T*>) noexcept {
+        return nullptr;
+    }
+
+    const char* get(Type<const char*>) {
+        const uint32_t length = get(Type<uint32_t>{});
+        std::string& string = mStrings.emplace_back(length, '\0');
+        read(string.data(), length);
+        return string.c_str();
+    }
+
+    CString get(Type<CString>) {
+        const uint32_t length = get(Type<uint32_t>{});
+        std::string string(length, '\0');
+        read(string.data(), length);
+        return CString(string.c_str(), length);
+    }
+
+    BufferDescriptor get(Type<BufferDescriptor>) {
+        const uint64_t size = get(Type<uint64_t>{});
+        void* const data = malloc(size);
+        read(data, size);
+        return BufferDescriptor(data, size, [](void* buffer, size_t, void*) { free(buffer); });
+    }
+
+    PixelBufferDescriptor get(Type<PixelBufferDescriptor>) {
+        BufferDescriptor data = get(Type<BufferDescriptor>{});
+        const uint32_t left = get(Type<uint32_t>{});
+        const uint32_t top = get(Type<uint32_t>{});
+        const PixelDataType type = get(Type<PixelDataType>{});
+        const uint8_t alignment = get(Type<uint8_t>{});
+        void* const buffer = data.buffer;
+        const size_t size = data.size;
+        data.buffer = nullptr;  // the PixelBufferDescriptor takes it over
+        if (type == PixelDataType::COMPRESSED) {
+            const uint32_t imageSize = get(Type<uint32_t>{});
+            const auto format = get(Type<CompressedPixelDataType>{});
+            return PixelBufferDescriptor(buffer, size, format, imageSize,
+                    [](void* buffer, size_t, void*) { free(buffer); });
+        }
+        const uint32_t stride = get(Type<uint32_t>{});
+        const PixelDataFormat format = get(Type<PixelDataFormat>{});
+        return PixelBufferDescriptor(buffer, size, format, type, alignment, left, top, stride,
+                [](void* buffer, size_t, void*) { free(buffer); });
+    }
+
+    FaceOffsets get(Type<FaceOffsets>) noexcept {
+        FaceOffsets offsets;
+        read(offsets.offsets, sizeof(offsets.offsets));
+        return offsets;
+    }
+
+    Program get(Type<Program>) {
+        Program program;
+        CString name = get(Type<CString>{});
+        const uint8_t variant = get(Type<uint8_t>{});
+        program.diagnostics(std::move(name), variant);
+        for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+            std::vector<uint8_t> source(get(Type<uint64_t>{}));
+            read(source.data(), source.size());
+            if (!source.empty()) {
+                program.shader(Program::Shader(i), source.data(), source.size());
+            }
+        }
+        for (size_t i = 0; i < Program::UNIFORM_BINDING_COUNT; i++) {
+            CString blockName = get(Type<CString>{});
+            if (!blockName.empty()) {
+                program.setUniformBlock(i, std::move(blockName));
+            }
+        }
+        for (size_t i = 0; i < Program::SAMPLER_BINDING_COUNT; i++) {
+            std::vector<Program::Sampler> samplers(get(Type<uint32_t>{}));
+            for (auto& sampler : samplers) {
+                sampler.name = get(Type<CString>{});
+                sampler.binding = get(Type<uint16_t>{});
+                sampler.strict = get(Type<bool>{});
+            }
+            if (!samplers.empty()) {
+                program.setSamplerGroup(i, samplers.data(), samplers.size());
+            }
+        }
+        Program::SpecializationConstantsInfo constants(get(Type<uint32_t>{}));
+        for (auto& constant : constants) {
+            constant.id = get(Type<uint32_t>{});
+            switch (get(Type<uint8_t>{})) {
+                case 0: constant.value = get(Type<int32_t>{}); break;
+                case 1: constant.value = get(Type<float>{});   break;
+                default: constant.value = get(Type<bool>{});   break;
+            }
+        }
+        if (!constants.empty()) {
+            program.specializationConstants(std::move(constants));
+        }
+        program.nonBlocking(get(Type<bool>{}));
+        return program;
+    }
+
+    SamplerGroup get(Type<SamplerGroup>) noexcept {
+        const uint32_t size = get(Type<uint32_t>{});
+        SamplerGroup samplerGroup(size);
+        for (uint32_t i = 0; i < size; i++) {
+            TextureHandle t = get(Type<TextureHandle>{});
+            SamplerParams s = get(Type<SamplerParams>{});
+            samplerGroup.setSampler(i, t, s);
+        }
+        return samplerGroup;
+    }
+
+    PipelineState get(Type<PipelineState>) noexcept {
+        PipelineState state;
+        state.program = get(Type<ProgramHandle>{});
+        state.rasterState = get(Type<RasterState>{});
+        state.polygonOffset = get(Type<PolygonOffset>{});
+        state.scissor = get(Type<Viewport>{});
+        return state;
+    }
+
+    TargetBufferInfo get(Type<TargetBufferInfo>) noexcept {
+        TextureHandle handle = get(Type<TextureHandle>{});
+        const uint8_t level = get(Type<uint8_t>{});
+        const uint16_t layer = get(Type<uint16_t>{});
+        return { handle, level, layer };
+    }
+
+    MRT get(Type<MRT>) noexcept {
+        TargetBufferInfo c0 = get(Type<TargetBufferInfo>{});
+        TargetBufferInfo c1 = get(Type<TargetBufferInfo>{});
+        TargetBufferInfo c2 = get(Type<TargetBufferInfo>{});
+        TargetBufferInfo c3 = get(Type<TargetBufferInfo>{});
+        return { c0, c1, c2, c3 };
+    }
+
+    template<typename T>
+    Handle<T> toHandle(HandleBase::HandleId id) const noexcept {
+        auto pos = mHandles.find(id);
+        return pos != mHandles.end() ? Handle<T>(pos->second) : Handle<T>{};
+    }
+
+    template<typename T>
+    std::vector<Handle<T>>& getHandles() {
+        const uint32_t count = get(Type<uint32_t>{});
+        std::vector<Handle<T>> handles;
+        handles.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            handles.push_back(get(Type<Handle<T>>{}));
+        }
+        auto& arrays = std::get<std::deque<std::vector<Handle<T>>>>(mHandleArrays);
+        return arrays.emplace_back(std::move(handles));
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Replaying the commands
+
+    // reads the arguments of 'method' and calls 'f' with them
+    template<typename... ARGS, typename F>
+    void replay(void (Driver::*)(ARGS...), F&& f) {
+        // the arguments are read in order, because they're list-initialized
+        std::tuple<std::decay_t<ARGS>...> args{ get(Type<std::decay_t<ARGS>>{})... };
+        std::apply(std::forward<F>(f), std::move(args));
+    }
+
+    // reads the handle created by a createXXX() command and its arguments, and maps the handle
+    // to the one returned by 'f'
+    template<typename R, typename... ARGS, typename F>
+    void replayCreate(void (Driver::*)(R, ARGS...), F&& f) {
+        const HandleBase::HandleId id = get(Type<HandleBase::HandleId>{});
+        std::tuple<std::decay_t<ARGS>...> args{ get(Type<std::decay_t<ARGS>>{})... };
+        R handle = std::apply(std::forward<F>(f), std::move(args));
+        if (handle) {
+            mHandles[id] = handle.getId();
+        } else {
+            mHandles.erase(id);
+        }
+    }
+
+    // the commands which can't be replayed as they were captured
+    bool replaySpecialCommand(CapturedCommand command) {
+        switch (command) {
+            case CapturedCommand::endFrame:
+                replay(&Driver::endFrame, [this](uint32_t frameId) {
+                    mStream.endFrame(frameId);
+                    mStream.finish();
+                });
+                execute();
+                mDriver.purge();
+                mFrameTimes.push_back(mFrameTime);
+                mFrameTime = 0;
+                return true;
+
+            case CapturedCommand::createSwapChain:
+                replayCreate(&Driver::createSwapChainR, [this](void*, uint64_t flags) {
+                    return mStream.createSwapChainHeadless(g_width, g_height, flags);
+                });
+                return true;
+
+            case CapturedCommand::importTexture:
+                replayCreate(&Driver::importTextureR, [this](intptr_t, SamplerType target,
+                        uint8_t levels, TextureFormat format, uint8_t samples, uint32_t width,
+                        uint32_t height, uint32_t depth, TextureUsage usage) {
+                    return mStream.createTexture(target, levels, format, samples,
+                            width, height, depth, usage);
+                });
+                return true;
+
+            case CapturedCommand::createStreamFromTextureId:
+                replayCreate(&Driver::createStreamFromTextureIdR, [](auto&& ...) {
+                    return StreamHandle{};
+                });
+                return true;
+
+            case CapturedCommand::setFrameScheduledCallback:
+                replay(&Driver::setFrameScheduledCallback, [](auto&& ...) {});
+                return true;
+            case CapturedCommand::setFrameCompletedCallback:
+                replay(&Driver::setFrameCompletedCallback, [](auto&& ...) {});
+                return true;
+            case CapturedCommand::setExternalImage:
+                replay(&Driver::setExternalImage, [](auto&& ...) {});
+                return true;
+            case CapturedCommand::setExternalImagePlane:
+                replay(&Driver::setExternalImagePlane, [](auto&& ...) {});
+                return true;
+            case CapturedCommand::setExternalStream:
+                replay(&Driver::setExternalStream, [](auto&& ...) {});
+                return true;
+            case CapturedCommand::readStreamPixels:
+                replay(&Driver::readStreamPixels, [](auto&& ...) {});
+                return true;
+
+            case CapturedCommand::updateUniformBuffers:
+                // the updates start with the handle of the buffer they update
+                replay(&Driver::updateUniformBuffers, [this](BufferDescriptor&& updates) {
+                    char* p = static_cast<char*>(updates.buffer);
+                    char* const end = p + updates.size;
+                    while (p < end) {
+                        auto* update = reinterpret_cast<UniformBufferUpdate*>(p);
+                        update->ubh = toHandle<HwUniformBuffer>(update->ubh.getId());
+                        p += UniformBufferUpdate::getStorageSize(update->byteSize);
+                    }
+                    mStream.updateUniformBuffers(std::move(updates));
+                });
+                return true;
+
+            case CapturedCommand::createRenderPrimitives: {
+                const uint32_t count = get(Type<uint32_t>{});
+                std::vector<HandleBase::HandleId> ids(count);
+                read(ids.data(), count * sizeof(HandleBase::HandleId));
+                auto& arrays = std::get<std::deque<std::vector<RenderPrimitiveHandle>>>(
+                        mHandleArrays);
+                auto& rphs = arrays.emplace_back(count);
+                mStream.allocateRenderPrimitives(rphs.data(), count);
+                for (uint32_t i = 0; i < count; i++) {
+                    mHandles[ids[i]] = rphs[i].getId();
+                }
+                mStream.createRenderPrimitives(rphs.data(), count);
+                return true;
+            }
+            case CapturedCommand::destroyRenderPrimitives: {
+                auto& rphs = getHandles<HwRenderPrimitive>();
+                mStream.destroyRenderPrimitives(rphs.data(), rphs.size());
+                return true;
+            }
+            case CapturedCommand::destroyTextures: {
+                auto& ths = getHandles<HwTexture>();
+                mStream.destroyTextures(ths.data(), ths.size());
+                return true;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    bool replayGenericCommand(CapturedCommand command) {
+        switch (command) {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+            case CapturedCommand::methodName:                                                   \
+                replay(&Driver::methodName, [this](auto&& ... args) {                           \
+                    mStream.methodName(std::forward<decltype(args)>(args)...);                  \
+                });                                                                             \
+                return true;
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+            case CapturedCommand::methodName:                                                   \
+                replayCreate(&Driver::methodName##R, [this](auto&& ... args) {                  \
+                    return mStream.methodName(std::forward<decltype(args)>(args)...);           \
+                });                                                                             \
+                return true;
+#include "private/backend/DriverAPI.inc"
+            default:
+                return false;
+        }
+    }
+
+    // executes the commands issued so far, and adds the time they take to the current frame
+    void execute() {
+        mQueue.flush();
+        auto buffers = mQueue.waitForCommands();
+        const auto start = std::chrono::steady_clock::now();
+        for (auto& item : buffers) {
+            if (item.begin) {
+                mStream.execute(item.begin);
+                mQueue.releaseBuffer(item);
+            }
+        }
+        const std::chrono::duration<double, std::milli> duration =
+                std::chrono::steady_clock::now() - start;
+        mFrameTime += duration.count();
+        mStrings.clear();
+        std::apply([](auto& ... arrays) { (arrays.clear(), ...); }, mHandleArrays);
+    }
+
+    Driver& mDriver;
+    FILE* mFile;
+    CommandBufferQueue mQueue;
+    CommandStream mStream;
+    bool mError = false;
+
+    // the handles of the capture, mapped to the handles of the replay
+    std::unordered_map<HandleBase::HandleId, HandleBase::HandleId> mHandles;
+
+    // the arguments given by address, which must live until their command is executed
+    std::deque<std::string> mStrings;
+    std::tuple<std::deque<std::vector<RenderPrimitiveHandle>>,
+            std::deque<std::vector<TextureHandle>>> mHandleArrays;
+
+    double mFrameTime = 0;
+    std::vector<double> mFrameTimes;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+    const int optionIndex = handleArguments(argc, argv);
+    if (argc - optionIndex != 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char* const path = argv[optionIndex];
+    FILE* const file = fopen(path, "rb");
+    if (!file) {
+        std::cerr << "Unable to read " << path << std::endl;
+        return 1;
+    }
+
+    DefaultPlatform* platform = DefaultPlatform::create(&g_backend);
+    Driver* driver = platform ? platform->createDriver(nullptr) : nullptr;
+    if (!driver) {
+        std::cerr << "Unable to create the driver." << std::endl;
+        fclose(file);
+        return 1;
+    }
+
+    Replayer* replayer = new Replayer(*driver, file);
+    if (replayer->readHeader()) {
+        while (replayer->replayCommand()) {
+        }
+        replayer->terminate();
+    }
+
+    std::vector<double> frameTimes = replayer->getFrameTimes();
+    delete replayer;
+    delete driver;
+    DefaultPlatform::destroy(&platform);
+    fclose(file);
+
+    if (frameTimes.empty()) {
+        std::cerr << "The capture doesn't contain any complete frame." << std::endl;
+        return 1;
+    }
+
+    if (g_printFrames) {
+        for (size_t i = 0; i < frameTimes.size(); i++) {
+            printf("frame %zu: %.3f ms\n", i, frameTimes[i]);
+        }
+    }
+
+    // the first frames also create and upload the resources, the median isn't affected by them
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double time : sorted) {
+        total += time;
+    }
+    printf("%zu frames: min %.3f ms, median %.3f ms, mean %.3f ms, max %.3f ms\n",
+            sorted.size(), sorted.front(), sorted[sorted.size() / 2], total / sorted.size(),
+            sorted.back());
+    return 0;
+}
@@ -65,6 +65,33 @@ static void usage(char* name) {
             "       Filter out specified comma-separated variants:\n"
             "           directionalLighting, dynamicLighting, shadowReceiver, skinning, vsm, fog\n"
             "       This variant filter is merged with the filter from the material, if any\n\n"
+            "   --batch=<manifest>, -b <manifest>\n"
+            "       Compile all the materials listed in this file, in parallel, with the same\n"
+            "       options. Each line holds an input file and, optionally, its output file. By\n"
+            "       default the output is the input with a .filamat extension (.inc for headers).\n"
+            "       Empty lines and lines starting with # are ignored\n\n"
+            "   --shared-dictionary=<path>, -k <path>\n"
+            "       Store the lines of the text shaders that materials have in common only once,\n"
+            "       in this shared dictionary. It must be loaded with\n"
+            "       Engine::loadShaderDictionary() before the materials are created. In batch\n"
+            "       mode the dictionary is built from the materials of the batch, otherwise it\n"
+            "       must exist\n\n"
+            "   --compress, -z\n"
+            "       Compress each GLSL and MSL shader on its own. The engine must be built with\n"
+            "       FILAMENT_SUPPORTS_COMPRESSED_MATERIALS to load these materials, it only\n"
+            "       decompresses the shaders of the variants it uses. Cannot be combined with\n"
+            "       --shared-dictionary\n\n"
+            "   --metallib, -L\n"
+            "       Also precompile the Metal shaders into Metal libraries with the Metal\n"
+            "       toolchain, which must be installed (macOS only). The Metal backend loads them\n"
+            "       instead of compiling the MSL at runtime\n\n"
+            "   --infer-precision, -P\n"
+            "       Compute in mediump the values of the optimized mobile fragment shaders that\n"
+            "       only depend on mediump values, e.g. colors and lighting. Materials can opt\n"
+            "       out with relaxPrecision : false\n\n"
+            "   --cache-dir=<path>, -c <path>\n"
+            "       Cache the optimized shaders in this directory, across builds. It is created\n"
+            "       if needed and can be shared by concurrent invocations of MATC\n\n"
             "   --version, -v\n"
             "       Print the material version number\n\n"
             "Internal use and debugging only:\n"
@@ -153,7 +180,7 @@ static void parseDefine(std::string defineString,
 }
 
 bool CommandlineConfig::parse() {
-    static constexpr const char* OPTSTR = "hlxo:f:dm:a:p:D:OSEr:vV:gtw";
+    static constexpr const char* OPTSTR = "hlxo:f:dm:a:p:D:OSEr:vV:gtwc:b:k:zLP";
     static const struct option OPTIONS[] = {
             { "help",                    no_argument, nullptr, 'h' },
             { "license",                 no_argument, nullptr, 'l' },
@@ -173,6 +200,12 @@ bool CommandlineConfig::parse() {
             { "print",                   no_argument, nullptr, 't' },
             { "version",                 no_argument, nullptr, 'v' },
             { "raw",                     no_argument, nullptr, 'w' },
+            { "cache-dir",         required_argument, nullptr, 'c' },
+            { "batch",             required_argument, nullptr, 'b' },
+            { "shared-dictionary", required_argument, nullptr, 'k' },
+            { "compress",                no_argument, nullptr, 'z' },
+            { "metallib",                no_argument, nullptr, 'L' },
+            { "infer-precision",         no_argument, nullptr, 'P' },
             { nullptr, 0, nullptr, 0 }  // termination of the option list
     };
 
@@ -271,6 +304,24 @@ bool CommandlineConfig::parse() {
             case 'w':
                 mRawShaderMode = true;
                 break;
+            case 'c':
+                mShaderCacheDirectory = arg;
+                break;
+            case 'b':
+                mBatchManifest = arg;
+                break;
+            case 'k':
+                mSharedDictionary = arg;
+                break;
+            case 'z':
+                mCompressShaders = true;
+                break;
+            case 'L':
+                mMetalLibraries = true;
+                break;
+            case 'P':
+                mInferPrecision = true;
+                break;
         }
     }
 
@@ -25,6 +25,7 @@
 #include <memory>
 #include <unordered_map>
 #include <ostream>
+#include <string>
 
 #include <utils/compiler.h>
 
@@ -114,6 +115,33 @@ public:
         return mVariantFilter;
     }
 
+    const std::string& getShaderCacheDirectory() const noexcept {
+        return mShaderCacheDirectory;
+    }
+
+    // List of the materials to compile in batch mode, empty otherwise.
+    const std::string& getBatchManifest() const noexcept {
+        return mBatchManifest;
+    }
+
+    // Path of the shared dictionary, empty if none.
+    const std::string& getSharedDictionary() const noexcept {
+        return mSharedDictionary;
+    }
+
+    bool compressShaders() const noexcept {
+        return mCompressShaders;
+    }
+
+    // Whether the Metal shaders are also precompiled into Metal libraries.
+    bool metalLibraries() const noexcept {
+        return mMetalLibraries;
+    }
+
+    bool inferPrecision() const noexcept {
+        return mInferPrecision;
+    }
+
     const std::unordered_map<std::string, std::string>& getDefines() const noexcept {
         return mDefines;
     }
@@ -123,6 +151,9 @@ protected:
     bool mIsValid = true;
     bool mPrintShaders = false;
     bool mRawShaderMode = false;
+    bool mCompressShaders = false;
+    bool mMetalLibraries = false;
+    bool mInferPrecision = false;
     Optimization mOptimizationLevel = Optimization::PERFORMANCE;
     Metadata mReflectionTarget = Metadata::NONE;
     Platform mPlatform = Platform::ALL;
@@ -130,6 +161,9 @@ protected:
     TargetApi mTargetApi = (TargetApi) 0;
     std::unordered_map<std::string, std::string> mDefines;
     uint8_t mVariantFilter = 0;
+    std::string mShaderCacheDirectory;
+    std::string mBatchManifest;
+    std::string mSharedDictionary;
 };
 
 }
@@ -16,8 +16,14 @@
 
 #include "MaterialCompiler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
 #include <memory>
 #include <iostream>
+#include <sstream>
+#include <vector>
 
 #include <filamat/MaterialBuilder.h>
 
@@ -28,6 +34,7 @@
 #include "DirIncluder.h"
 #include "MaterialLexeme.h"
 #include "MaterialLexer.h"
+#include "MetalLibraryCompiler.h"
 #include "JsonishLexer.h"
 #include "JsonishParser.h"
 #include "ParametersProcessor.h"
@@ -255,26 +262,254 @@ bool MaterialCompiler::isValidJsonStart(const char* buffer, size_t size) const n
     return c == 'n' && (end - buffer) > 3 && strncmp(buffer, "null", 5) != 0;
 }
 
-bool MaterialCompiler::run(const Config& config) {
-    Config::Input* input = config.getInput();
-    ssize_t size = input->open();
-    if (size <= 0) {
+static bool readFile(const std::string& path, std::vector<uint8_t>* data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
         return false;
     }
-    auto buffer = input->read();
+    data->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !data->empty();
+}
 
-    utils::Path materialFilePath = utils::Path(input->getName()).getAbsolutePath();
-    assert(materialFilePath.isFile());
+bool MaterialCompiler::run(const Config& config) {
+    if (!config.getBatchManifest().empty()) {
+        return runBatch(config);
+    }
 
     if (config.rawShaderMode()) {
-        const std::string extension = materialFilePath.getExtension();
+        Config::Input* input = config.getInput();
+        ssize_t size = input->open();
+        if (size <= 0) {
+            return false;
+        }
+        auto buffer = input->read();
+        const std::string extension = utils::Path(input->getName()).getExtension();
         glslang::InitializeProcess();
         bool success = compileRawShader(buffer.get(), size, config.getOutput(), extension.c_str());
         glslang::FinalizeProcess();
         return success;
     }
 
+    if (!config.getSharedDictionary().empty() &&
+            !readFile(config.getSharedDictionary(), &mSharedDictionary)) {
+        std::cerr << "Unable to read shared dictionary '" << config.getSharedDictionary() << "'"
+                << std::endl;
+        return false;
+    }
+
     MaterialBuilder::init();
+
+    JobSystem js;
+    js.adopt();
+
+    bool success = compileMaterial(config, js);
+
+    js.emancipate();
+    MaterialBuilder::shutdown();
+
+    return success;
+}
+
+// The options of the command line, with the input and the output of one material of a batch.
+class BatchConfig final : public Config {
+public:
+    BatchConfig(const Config& config, const std::string& input, Output* output,
+            OutputFormat format) : Config(config), mCommandline(config),
+            mInput(input.c_str()), mOutput(output) {
+        mOutputFormat = format;
+    }
+
+    Output* getOutput() const noexcept override {
+        return mOutput;
+    }
+
+    Input* getInput() const noexcept override {
+        return &mInput;
+    }
+
+    std::string toString() const noexcept override {
+        return mCommandline.toString();
+    }
+
+private:
+    const Config& mCommandline;
+    mutable FilesystemInput mInput;
+    Output* const mOutput;
+};
+
+// Keeps a binary package in memory.
+class MemoryOutput final : public Config::Output {
+public:
+    bool open() noexcept override {
+        mStream.str("");
+        return true;
+    }
+
+    bool write(const uint8_t* data, size_t size) noexcept override {
+        mStream.write((const char*) data, size);
+        return mStream.fail();
+    }
+
+    std::ostream& getOutputStream() noexcept override {
+        return mStream;
+    }
+
+    bool close() noexcept override {
+        return mStream.fail();
+    }
+
+    Package getPackage() const {
+        const std::string data = mStream.str();
+        return Package(data.data(), data.size());
+    }
+
+private:
+    std::ostringstream mStream;
+};
+
+bool MaterialCompiler::runBatch(const Config& config) {
+    std::ifstream manifest(config.getBatchManifest());
+    if (!manifest) {
+        std::cerr << "Unable to open batch manifest '" << config.getBatchManifest() << "'"
+                << std::endl;
+        return false;
+    }
+
+    // Each line is "<input> [<output>]", paths are relative to the working directory.
+    std::vector<std::pair<std::string, std::string>> materials;
+    std::string line;
+    while (std::getline(manifest, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string input, output;
+        if (!(fields >> input)) {
+            continue;
+        }
+        if (!(fields >> output)) {
+            const bool header = config.getOutputFormat() == Config::OutputFormat::C_HEADER;
+            utils::Path path(input);
+            output = path.getParent().concat(path.getNameWithoutExtension()).getPath() +
+                    (header ? ".inc" : ".filamat");
+        }
+        materials.emplace_back(std::move(input), std::move(output));
+    }
+
+    if (materials.empty()) {
+        std::cerr << "No material in batch manifest '" << config.getBatchManifest() << "'"
+                << std::endl;
+        return false;
+    }
+
+    MaterialBuilder::init();
+
+    // Every material compiles its variants with jobs of its own, the number of materials
+    // compiled at the same time is bounded so that they never run out of jobs.
+    JobSystem::Config jsConfig;
+    jsConfig.maxJobCount = JobSystem::MAX_JOB_COUNT;
+    JobSystem js(jsConfig);
+    js.adopt();
+
+    const size_t materialsInFlight = std::max(size_t(1), std::min(size_t(js.getThreadCount()),
+            (JobSystem::MAX_JOB_COUNT - js.getThreadCount()) / JobSystem::DEFAULT_MAX_JOB_COUNT));
+
+    // Compiles all the materials, returns the number of failures.
+    auto compileAll = [&](std::vector<std::unique_ptr<Config::Output>> const& outputs,
+            Config::OutputFormat format) {
+        std::atomic<size_t> failures = { 0 };
+        auto compile = [&](size_t index) {
+            BatchConfig materialConfig(config, materials[index].first, outputs[index].get(),
+                    format);
+            if (!compileMaterial(materialConfig, js)) {
+                failures++;
+            }
+        };
+
+        // The first material is compiled on its own, to work around the lack of thread safety
+        // of glslang on first use. The shaders the materials have in common are only compiled
+        // once, the MaterialBuilders share their cache until MaterialBuilder::shutdown().
+        compile(0);
+
+        std::atomic<size_t> next = { 1 };
+        JobSystem::Job* parent = js.createJob();
+        for (size_t i = 0; i < materialsInFlight; i++) {
+            js.run(jobs::createJob(js, parent, [&]() {
+                for (size_t index = next++; index < materials.size(); index = next++) {
+                    compile(index);
+                }
+            }));
+        }
+        js.runAndWait(parent);
+        return failures.load();
+    };
+
+    size_t failures = 0;
+    std::vector<std::unique_ptr<Config::Output>> outputs(materials.size());
+
+    // The shared dictionary is built from the materials compiled without it, in memory.
+    const std::string& dictionaryPath = config.getSharedDictionary();
+    if (!dictionaryPath.empty()) {
+        for (auto& output : outputs) {
+            output.reset(new MemoryOutput());
+        }
+        mSharedDictionary.clear();
+        failures = compileAll(outputs, Config::OutputFormat::BLOB);
+
+        std::vector<Package> packages;
+        for (auto& output : outputs) {
+            packages.push_back(static_cast<MemoryOutput*>(output.get())->getPackage());
+        }
+        Package dictionary = failures ? Package::invalidPackage() :
+                MaterialBuilder::buildSharedDictionary(packages.data(), packages.size());
+        if (dictionary.isValid()) {
+            mSharedDictionary.assign(dictionary.getData(), dictionary.getEnd());
+            FilesystemOutput output(dictionaryPath.c_str());
+            if (!output.open()) {
+                std::cerr << "Unable to create shared dictionary '" << dictionaryPath << "'"
+                        << std::endl;
+                failures++;
+            } else {
+                output.write(dictionary.getData(), dictionary.getSize());
+                output.close();
+            }
+        } else if (!failures) {
+            std::cerr << "Could not build shared dictionary '" << dictionaryPath << "'"
+                    << std::endl;
+            failures++;
+        }
+    }
+
+    if (!failures) {
+        for (size_t i = 0; i < materials.size(); i++) {
+            outputs[i].reset(new FilesystemOutput(materials[i].second.c_str()));
+        }
+        failures = compileAll(outputs, config.getOutputFormat());
+    }
+
+    js.emancipate();
+    MaterialBuilder::shutdown();
+
+    if (failures) {
+        std::cerr << failures << " of " << materials.size() << " materials failed to compile"
+                << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MaterialCompiler::compileMaterial(const Config& config, JobSystem& js) {
+    Config::Input* input = config.getInput();
+    ssize_t size = input->open();
+    if (size <= 0) {
+        return false;
+    }
+    auto buffer = input->read();
+    if (!buffer) {
+        return false;
+    }
+
+    utils::Path materialFilePath = utils::Path(input->getName()).getAbsolutePath();
+    assert(materialFilePath.isFile());
+
     MaterialBuilder builder;
     // Before attempting an expensive lex, let's find out if we were sent pure JSON.
     bool parsed;
@@ -307,21 +542,26 @@ bool MaterialCompiler::run(const Config& config) {
         .optimization(config.getOptimizationLevel())
         .printShaders(config.printShaders())
         .generateDebugInfo(config.isDebug())
-        .variantFilter(config.getVariantFilter() | builder.getVariantFilter());
+        .inferPrecision(config.inferPrecision())
+        .variantFilter(config.getVariantFilter() | builder.getVariantFilter())
+        .shaderCacheDirectory(config.getShaderCacheDirectory().c_str())
+        .compressShaders(config.compressShaders());
 
     for (const auto& define : config.getDefines()) {
         builder.shaderDefine(define.first.c_str(), define.second.c_str());
     }
 
-    JobSystem js;
-    js.adopt();
+    if (!mSharedDictionary.empty()) {
+        builder.sharedDictionary(mSharedDictionary.data(), mSharedDictionary.size());
+    }
+
+    if (config.metalLibraries()) {
+        builder.metalLibraryCompiler(MetalLibraryCompiler());
+    }
 
     // Write builder.build() to output.
     Package package = builder.build(js);
 
-    js.emancipate();
-    MaterialBuilder::shutdown();
-
     if (!package.isValid()) {
         std::cerr << "Could not compile material " << input->getName() << std::endl;
         return false;
@@ -330,6 +570,34 @@ bool MaterialCompiler::run(const Config& config) {
 }
 
 bool MaterialCompiler::checkParameters(const Config& config) {
+    // Compressed shaders don't use the text dictionary.
+    if (config.compressShaders() && !config.getSharedDictionary().empty()) {
+        std::cerr << "Compressed shaders cannot use a shared dictionary." << std::endl;
+        return false;
+    }
+
+#if !defined(__APPLE__)
+    if (config.metalLibraries()) {
+        std::cerr << "Metal libraries can only be compiled on macOS." << std::endl;
+        return false;
+    }
+#endif
+
+    // In batch mode, the inputs and outputs are listed in the manifest.
+    if (!config.getBatchManifest().empty()) {
+        if (config.getInput() != nullptr || config.getOutput() != nullptr) {
+            std::cerr << "Input and output files must be listed in the batch manifest."
+                    << std::endl;
+            return false;
+        }
+        if (config.getReflectionTarget() != Config::Metadata::NONE || config.rawShaderMode()) {
+            std::cerr << "Reflection and raw shader mode are not supported in batch mode."
+                    << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     // Check for input file.
     if (config.getInput() == nullptr) {
         std::cerr << "Missing input filename." << std::endl;
@@ -19,6 +19,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Compiler.h"
 #include "MaterialLexeme.h"
@@ -26,6 +27,9 @@
 namespace filamat {
 class MaterialBuilder;
 }
+namespace utils {
+class JobSystem;
+}
 class TestMaterialCompiler;
 
 namespace matc {
@@ -42,6 +46,10 @@ public:
 private:
     friend class ::TestMaterialCompiler;
 
+    // Compiles the materials listed in the batch manifest, concurrently.
+    bool runBatch(const Config& config);
+    bool compileMaterial(const Config& config, utils::JobSystem& js);
+
     bool parseMaterial(const char* buffer, size_t size,
             filamat::MaterialBuilder& builder) const noexcept;
     bool processMaterial(const MaterialLexeme&,
@@ -77,6 +85,9 @@ private:
     using MaterialConfigProcessorJSON = bool (MaterialCompiler::*)
             (const JsonishValue*, filamat::MaterialBuilder& builder) const;
     std::unordered_map<std::string, MaterialConfigProcessorJSON> mConfigProcessorJSON;
+
+    // The shared dictionary the materials are compiled with, empty if none.
+    std::vector<uint8_t> mSharedDictionary;
 };
 
 } // namespace matc
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "MetalLibraryCompiler.h"
+
+#include <utils/Path.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace utils;
+
+namespace matc {
+
+bool MetalLibraryCompiler::operator()(const std::string& msl,
+        filament::backend::ShaderModel shaderModel, std::vector<uint8_t>& library) {
+    using ShaderModel = filament::backend::ShaderModel;
+
+    // each shader is compiled in its own directory, since the jobs run in parallel
+    std::string directory = Path::concat(Path::getTemporaryDirectory(), "matc-XXXXXX");
+    if (!mkdtemp(&directory[0])) {
+        std::cerr << "Could not create a temporary directory for the Metal toolchain."
+                << std::endl;
+        return false;
+    }
+    Path source = Path::concat(directory, "shader.metal");
+    Path air = Path::concat(directory, "shader.air");
+    Path metallib = Path::concat(directory, "shader.metallib");
+
+    std::ofstream(source.getPath(), std::ios::binary) << msl;
+
+    // the mobile shader model targets iOS, the desktop one macOS
+    const char* sdk = shaderModel == ShaderModel::GL_ES_30 ? "iphoneos" : "macosx";
+    const std::string command =
+            std::string("xcrun -sdk ") + sdk + " metal -c '" + source.getPath() +
+            "' -o '" + air.getPath() + "' && " +
+            "xcrun -sdk " + sdk + " metallib '" + air.getPath() +
+            "' -o '" + metallib.getPath() + "'";
+    bool success = system(command.c_str()) == 0;
+
+    if (success) {
+        std::ifstream in(metallib.getPath(), std::ios::binary);
+        library.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        success = !library.empty();
+    }
+    if (!success) {
+        std::cerr << "The Metal toolchain could not compile a shader." << std::endl;
+    }
+
+    source.unlinkFile();
+    air.unlinkFile();
+    metallib.unlinkFile();
+    rmdir(directory.c_str());
+    return success;
+}
+
+} // namespace matc
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TNT_METALLIBRARYCOMPILER_H_
+#define TNT_METALLIBRARYCOMPILER_H_
+
+#include <backend/DriverEnums.h>
+
+#include <string>
+#include <vector>
+
+namespace matc {
+
+// Functor callback handler used to precompile MSL into Metal libraries with the Metal toolchain,
+// which is only available on macOS.
+class MetalLibraryCompiler {
+public:
+    bool operator()(const std::string& msl, filament::backend::ShaderModel shaderModel,
+            std::vector<uint8_t>& library);
+};
+
+} // namespace matc
+
+#endif
@@ -547,11 +547,21 @@ static bool processClearCoatIorChange(MaterialBuilder& builder, const JsonishVal
     return true;
 }
 
+static bool processFoveation(MaterialBuilder& builder, const JsonishValue& value) {
+    builder.foveation(value.toJsonBool()->getBool());
+    return true;
+}
+
 static bool processFlipUV(MaterialBuilder& builder, const JsonishValue& value) {
     builder.flipUV(value.toJsonBool()->getBool());
     return true;
 }
 
+static bool processRelaxPrecision(MaterialBuilder& builder, const JsonishValue& value) {
+    builder.relaxPrecision(value.toJsonBool()->getBool());
+    return true;
+}
+
 static bool processMultiBounceAO(MaterialBuilder& builder, const JsonishValue& value) {
     builder.multiBounceAmbientOcclusion(value.toJsonBool()->getBool());
     return true;
@@ -705,7 +715,9 @@ ParametersProcessor::ParametersProcessor() {
     mParameters["specularAntiAliasingVariance"]  = { &processSpecularAntiAliasingVariance, Type::NUMBER };
     mParameters["specularAntiAliasingThreshold"] = { &processSpecularAntiAliasingThreshold, Type::NUMBER };
     mParameters["clearCoatIorChange"]            = { &processClearCoatIorChange, Type::BOOL };
+    mParameters["foveation"]                     = { &processFoveation, Type::BOOL };
     mParameters["flipUV"]                        = { &processFlipUV, Type::BOOL };
+    mParameters["relaxPrecision"]                = { &processRelaxPrecision, Type::BOOL };
     mParameters["multiBounceAmbientOcclusion"]   = { &processMultiBounceAO, Type::BOOL };
     mParameters["specularAmbientOcclusion"]      = { &processSpecularAmbientOcclusion, Type::STRING };
     mParameters["domain"]                        = { &processDomain, Type::STRING };
@@ -22,6 +22,7 @@
 #include <filaflat/ChunkContainer.h>
 
 #include <matdbg/DebugServer.h>
+#include <matdbg/ShaderCost.h>
 #include <matdbg/ShaderExtractor.h>
 #include <matdbg/ShaderInfo.h>
 #include <matdbg/TextWriter.h>
@@ -44,6 +45,8 @@ using namespace filament::matdbg;
 using filaflat::BlobDictionary;
 using filaflat::ChunkContainer;
 using filament::backend::Backend;
+using filament::backend::ShaderModel;
+using filament::backend::ShaderType;
 using utils::Path;
 
 struct Config {
@@ -56,6 +59,7 @@ struct Config {
     bool transpile = false;
     bool binary = false;
     bool analyze = false;
+    bool printCost = false;
     uint64_t shaderIndex;
     int serverPort = 0;
 };
@@ -78,6 +82,9 @@ static void printUsage(const char* name) {
             "       Print Metal Shading Language for the nth shader (0 is the first Metal shader)\n\n"
             "   --print-vkglsl=[index], -v\n"
             "       Print the nth Vulkan shader transpiled into GLSL\n\n"
+            "   --print-cost, -c\n"
+            "       Print the estimated cost of every Vulkan shader: its instructions, arithmetic,\n"
+            "       texture, memory and branch instructions, and its peak number of live scalars\n\n"
             "   --print-dic-glsl\n"
             "       Print the GLSL dictionary\n\n"
             "   --print-dic-metal\n"
@@ -113,7 +120,7 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[], Config* config) {
-    static constexpr const char* OPTSTR = "hla:g:s:v:b:m:b:w:xyz";
+    static constexpr const char* OPTSTR = "hla:cg:s:v:b:m:b:w:xyz";
     static const struct option OPTIONS[] = {
             { "help",            no_argument,       0, 'h' },
             { "license",         no_argument,       0, 'l' },
@@ -122,6 +129,7 @@ static int handleArguments(int argc, char* argv[], Config* config) {
             { "print-spirv",     required_argument, 0, 's' },
             { "print-vkglsl",    required_argument, 0, 'v' },
             { "print-metal",     required_argument, 0, 'm' },
+            { "print-cost",      no_argument,       0, 'c' },
             { "print-dic-glsl",  no_argument,       0, 'x' },
             { "print-dic-metal", no_argument,       0, 'y' },
             { "print-dic-vk",    no_argument,       0, 'z' },
@@ -170,6 +178,9 @@ static int handleArguments(int argc, char* argv[], Config* config) {
                 config->printMetal = true;
                 config->shaderIndex = static_cast<uint64_t>(std::stoi(arg));
                 break;
+            case 'c':
+                config->printCost = true;
+                break;
             case 'w':
                 config->serverPort = std::stoi(arg);
                 break;
@@ -494,6 +505,33 @@ static bool parseChunks(Config config, void* data, size_t size) {
         }
     }
 
+    if (config.printCost) {
+        std::vector<ShaderInfo> info(getShaderCount(container, filamat::ChunkType::MaterialSpirv));
+        if (!getVkShaderInfo(container, info.data())) {
+            std::cerr << "Failed to parse SPIRV chunk." << std::endl;
+            return false;
+        }
+
+        std::vector<ShaderCost> costs(info.size());
+        if (!getVkShaderCosts(container, costs.data())) {
+            std::cerr << "Failed to analyze the SPIRV shaders." << std::endl;
+            return false;
+        }
+
+        printf(" index  model    variant  stage     instrs     ALU  texture  memory  branch  live\n");
+        for (size_t i = 0; i < info.size(); i++) {
+            ShaderInfo const& item = info[i];
+            ShaderCost const& cost = costs[i];
+            printf("  %4zu  %-7s  0x%02x     %-8s  %6u  %6u  %7u  %6u  %6u  %4u\n", i,
+                    item.shaderModel == ShaderModel::GL_ES_30 ? "mobile" : "desktop",
+                    item.variant,
+                    item.pipelineStage == ShaderType::VERTEX ? "vertex" : "fragment",
+                    cost.instructionCount, cost.arithmeticCount, cost.textureCount,
+                    cost.memoryCount, cost.branchCount, cost.maxLiveScalars);
+        }
+        return true;
+    }
+
     TextWriter writer;
 
     if (config.printDictionaryGLSL || config.printDictionarySPIRV || config.printDictionaryMetal) {
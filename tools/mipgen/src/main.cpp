@@ -24,13 +24,16 @@
 #include <imageio/BlockCompression.h>
 #endif
 
+#include <imageio/BatchManifest.h>
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageEncoder.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Path.h>
 
 #include <getopt/getopt.h>
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -51,6 +54,7 @@ static bool g_ktxContainer = false;
 static bool g_linearized = false;
 static bool g_quietMode = false;
 static uint32_t g_mipLevelCount = 0;
+static std::string g_batchManifest = "";
 
 static const char* USAGE = R"TXT(
 MIPGEN generates mipmaps for an image down to the 1x1 level.
@@ -64,6 +68,7 @@ If the output format is a container format like KTX, then
 
 Usage:
     MIPGEN [options] <input_file> <output_pattern>
+    MIPGEN [options] --batch=<manifest>
 
 Options:
    --help, -h
@@ -90,14 +95,23 @@ Options:
    --mip-levels=N, -m N
        specifies the number of mip levels to generate
        if 0 (default), all levels are generated
+   --batch=<manifest>, -b <manifest>
+       process all the images listed in a manifest file in a single run, the
+       manifest has one "<input_file> <output_pattern>" pair per line, relative
+       to the manifest, lines starting with '#' are ignored
+       images whose input, output and options are unchanged since the previous
+       run are skipped, delete <manifest>.stamps to process all of them again
    --compression=COMPRESSION, -c COMPRESSION
        format specific compression:
 )TXT"
 #ifdef IMAGEIO_SUPPORTS_BLOCK_COMPRESSION
 R"TXT(
            KTX:
-             astc_[fast|thorough]_[ldr|hdr]_WxH, where WxH is a valid block size
-             s3tc_rgb_dxt1, s3tc_rgba_dxt5
+             astc_PRESET_[ldr|hdr|normals]_WxH, where WxH is a valid block size
+               PRESET is veryfast, fast, medium, thorough, or exhaustive
+             s3tc_rgb_dxt1[_thorough], s3tc_rgba_dxt5[_thorough]
+             bc7_[rgba|srgba]_[fast|medium|thorough]
+             bc6h_[fast|medium|thorough], for HDR images
              etc_FORMAT_METRIC_EFFORT
                FORMAT is r11, signed_r11, rg11, signed_rg11, rgb8, srgb8, rgb8_alpha
                          srgb8_alpha, rgba8, or srgb8_alpha8
@@ -116,6 +130,8 @@ Examples:
     MIPGEN -g --kernel=hermite grassland.png mip_%03d.png
     MIPGEN -f ktx --compression=astc_fast_ldr_4x4 grassland.png mips.ktx
     MIPGEN -f ktx --compression=etc_rgb_rgba_40 grassland.png mips.ktx
+    MIPGEN -f ktx --compression=bc7_srgba_fast grassland.png mips.ktx
+    MIPGEN -f ktx --compression=bc7_srgba_fast --batch=textures.txt
 )TXT";
 
 static const char* HTML_PREFIX = R"HTML(<!DOCTYPE html>
@@ -159,7 +175,7 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[]) {
-    static constexpr const char* OPTSTR = "hLlgpf:c:k:saqm:";
+    static constexpr const char* OPTSTR = "hLlgpf:c:k:saqm:b:";
     static const struct option OPTIONS[] = {
             { "help",                 no_argument, 0, 'h' },
             { "license",              no_argument, 0, 'L' },
@@ -173,6 +189,7 @@ static int handleArguments(int argc, char* argv[]) {
             { "add-alpha",            no_argument, 0, 'a' },
             { "quiet",                no_argument, 0, 'q' },
             { "mip-levels",     required_argument, 0, 'm' },
+            { "batch",          required_argument, 0, 'b' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -254,26 +271,25 @@ static int handleArguments(int argc, char* argv[]) {
                     // keep default value
                 }
                 break;
+            case 'b':
+                g_batchManifest = arg;
+                break;
         }
     }
 
     return optind;
 }
 
-int main(int argc, char* argv[]) {
-    int optionIndex = handleArguments(argc, argv);
-    int numArgs = argc - optionIndex;
-    if (numArgs < 2) {
-        printUsage(argv[0]);
-        return 1;
-    }
-    Path inputPath(argv[optionIndex++]);
-    std::string outputPattern(argv[optionIndex]);
+static int processImage(const Path& inputPath, const std::string& outputPattern,
+        JobSystem& js) {
+    // the output format can depend on the output pattern, don't change the global settings which
+    // are shared by all the images of a batch
+    ImageEncoder::Format format = g_format;
+    bool ktxContainer = g_ktxContainer;
     if (Path(outputPattern).getExtension() == "ktx") {
-        g_ktxContainer = true;
-        g_formatSpecified = true;
+        ktxContainer = true;
     } else if (!g_formatSpecified) {
-        g_format = ImageEncoder::chooseFormat(outputPattern, g_linearized);
+        format = ImageEncoder::chooseFormat(outputPattern, g_linearized);
     }
 
     if (!g_quietMode) {
@@ -316,9 +332,9 @@ int main(int argc, char* argv[]) {
     uint32_t count = getMipmapCount(sourceImage);
     count = g_mipLevelCount == 0 ? count : min(g_mipLevelCount - 1, count);
     vector<LinearImage> miplevels(count);
-    generateMipmaps(sourceImage, g_filter, miplevels.data(), count);
+    generateMipmaps(sourceImage, g_filter, miplevels.data(), count, &js);
 
-    if (g_ktxContainer) {
+    if (ktxContainer) {
         if (!g_quietMode) {
             puts("Writing KTX file to disk...");
         }
@@ -440,7 +456,7 @@ int main(int argc, char* argv[]) {
         if (!outputStream) {
             cerr << "The output file cannot be opened: " << path << endl;
         } else {
-            if (!ImageEncoder::encode(outputStream, g_format, image, g_compression, path)) {
+            if (!ImageEncoder::encode(outputStream, format, image, g_compression, path)) {
                 cerr << "An error occurred while encoding the image." << endl;
                 return 1;
             }
@@ -485,4 +501,98 @@ int main(int argc, char* argv[]) {
     if (!g_quietMode) {
         puts("Done.");
     }
+    return 0;
+}
+
+// Processes the images of a manifest concurrently, one job per image. The jobs share the job
+// system with the filters and the encoders, so that the decoding and the writing of an image
+// overlap with the processing of the others.
+static int processBatch(int argc, char* argv[], int optionIndex) {
+    // the options apply to every image, an image is reprocessed when they change
+    std::string settings;
+    for (int i = 1; i < optionIndex; i++) {
+        settings.append(argv[i]).append(" ");
+    }
+
+    BatchManifest manifest;
+    if (!manifest.load(Path(g_batchManifest), settings)) {
+        cerr << "Unable to open manifest: " << g_batchManifest << endl;
+        return 1;
+    }
+
+    // the per-stage messages of the images would be interleaved, and they would all write the
+    // same gallery
+    const bool quiet = g_quietMode;
+    g_quietMode = true;
+    g_createGallery = false;
+
+    struct Context {
+        BatchManifest* manifest;
+        JobSystem* js;
+        std::atomic<uint32_t> processed;
+        std::atomic<uint32_t> failed;
+        bool quiet;
+    } context{ &manifest, nullptr, { 0 }, { 0 }, quiet };
+
+    JobSystem js;
+    js.adopt();
+    context.js = &js;
+
+    JobSystem::Job* parent = js.createJob();
+    for (size_t i = 0, c = manifest.getEntries().size(); i < c; i++) {
+        Context* ctx = &context;
+        JobSystem::Job* job = jobs::createJob(js, parent, [ctx, i]() {
+            const BatchManifest::Entry& entry = ctx->manifest->getEntries()[i];
+            if (entry.args.size() != 2) {
+                cerr << "Expected <input_file> <output_pattern> in manifest: "
+                        << entry.args[0] << endl;
+                ctx->failed++;
+                return;
+            }
+            if (ctx->manifest->isUpToDate(i)) {
+                return;
+            }
+            if (!ctx->quiet) {
+                printf("Processing %s...\n", entry.args[0].c_str());
+            }
+            if (processImage(Path(entry.args[0]), entry.args[1], *ctx->js) != 0) {
+                ctx->failed++;
+                return;
+            }
+            ctx->manifest->setProcessed(i);
+            ctx->processed++;
+        });
+        js.run(job);
+    }
+    js.runAndWait(parent);
+
+    manifest.saveStamps();
+    js.emancipate();
+
+    if (!quiet) {
+        printf("Done, %u of %zu images processed, %u failed.\n",
+                context.processed.load(), manifest.getEntries().size(), context.failed.load());
+    }
+    return context.failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    int optionIndex = handleArguments(argc, argv);
+    if (!g_batchManifest.empty()) {
+        return processBatch(argc, argv, optionIndex);
+    }
+
+    int numArgs = argc - optionIndex;
+    if (numArgs < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    Path inputPath(argv[optionIndex++]);
+    std::string outputPattern(argv[optionIndex]);
+
+    JobSystem js;
+    js.adopt();
+    int result = processImage(inputPath, outputPattern, js);
+    js.emancipate();
+    return result;
 }
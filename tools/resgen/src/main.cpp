@@ -19,6 +19,7 @@
 #include <getopt/getopt.h>
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -37,6 +38,7 @@ static bool g_appendNull = false;
 static bool g_generateC = false;
 static bool g_quietMode = false;
 static bool g_embedJson = false;
+static bool g_compress = false;
 
 static const char* USAGE = R"TXT(
 RESGEN aggregates a sequence of binary blobs, each of which becomes a "resource" whose id
@@ -69,6 +71,9 @@ Options:
    --json, -j
        Embed a JSON string in the output that provides a summary
        of all resource sizes and names. Useful for size analysis.
+   --compress, -z
+       Compress each resource (LZ4 block format). The sizes are those of the compressed data,
+       resources are decompressed with resgen::decompress(), declared in the generated header.
     --quiet, -q
         Suppress console output
 
@@ -93,6 +98,134 @@ static const char* ASM_TEMPLATE = R"ASM(
     .incbin "{resources}.bin"
 )ASM";
 
+// Declared in the header of compressed packages. The resources are LZ4 blocks prefixed with their
+// uncompressed size.
+static const char* DECOMPRESS_TEMPLATE = R"CPP(
+#ifndef RESGEN_DECOMPRESS_H_
+#define RESGEN_DECOMPRESS_H_
+
+#include <stddef.h>
+
+namespace resgen {
+
+// Returns the size of a compressed resource once decompressed.
+inline size_t getUncompressedSize(uint8_t const* data) noexcept {
+    return data[0] | (data[1] << 8u) | (data[2] << 16u) | (size_t(data[3]) << 24u);
+}
+
+// Decompresses a resource into 'out', which must hold getUncompressedSize() bytes. Returns false
+// if the data is corrupt.
+inline bool decompress(uint8_t const* data, size_t size, uint8_t* out) noexcept {
+    uint8_t const* src = data + 4;
+    uint8_t const* const srcEnd = data + size;
+    uint8_t* dst = out;
+    uint8_t* const dstEnd = out + getUncompressedSize(data);
+    auto readLength = [&src, srcEnd](size_t length) -> size_t {
+        for (uint8_t b = 255; length >= 15 && b == 255 && src < srcEnd; length += b) {
+            b = *src++;
+        }
+        return length;
+    };
+    while (src < srcEnd) {
+        const uint8_t token = *src++;
+        size_t length = readLength(token >> 4u);
+        if (length > size_t(srcEnd - src) || length > size_t(dstEnd - dst)) {
+            return false;
+        }
+        for (; length; length--) {
+            *dst++ = *src++;
+        }
+        if (src == srcEnd) {
+            break; // the last sequence only has literals
+        }
+        if (srcEnd - src < 2) {
+            return false;
+        }
+        const size_t offset = src[0] | (src[1] << 8u);
+        src += 2;
+        length = readLength(token & 0xfu) + 4;
+        if (offset == 0 || offset > size_t(dst - out) || length > size_t(dstEnd - dst)) {
+            return false;
+        }
+        // the match can overlap the output, copy one byte at a time
+        for (uint8_t const* match = dst - offset; length; length--) {
+            *dst++ = *match++;
+        }
+    }
+    return dst == dstEnd;
+}
+
+} // namespace resgen
+
+#endif
+)CPP";
+
+// Compresses a resource into an LZ4 block, prefixed with its uncompressed size (little endian).
+// This is a simple greedy compressor, the decompression speed is what matters.
+static vector<uint8_t> compress(const vector<uint8_t>& src) {
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr uint32_t HASH_BITS = 16;
+    // LZ4 requires the last 5 bytes to be literals and the last match to start 12 bytes before
+    // the end
+    constexpr size_t LAST_LITERALS = 5;
+    constexpr size_t MATCH_LIMIT = 12;
+
+    const size_t size = src.size();
+    vector<uint8_t> dst = {
+            uint8_t(size), uint8_t(size >> 8u), uint8_t(size >> 16u), uint8_t(size >> 24u) };
+
+    auto read32 = [&src](size_t i) {
+        uint32_t v;
+        memcpy(&v, src.data() + i, sizeof(v));
+        return v;
+    };
+    auto writeLength = [&dst](size_t length) {
+        for (; length >= 255; length -= 255) {
+            dst.push_back(255);
+        }
+        dst.push_back(uint8_t(length));
+    };
+    auto writeLiterals = [&](size_t begin, size_t end, uint8_t matchToken) {
+        const size_t count = end - begin;
+        dst.push_back(uint8_t((std::min(count, size_t(15)) << 4u) | matchToken));
+        if (count >= 15) {
+            writeLength(count - 15);
+        }
+        dst.insert(dst.end(), src.begin() + begin, src.begin() + end);
+    };
+
+    // last position of each hashed 4-byte sequence, plus one
+    vector<size_t> table(1u << HASH_BITS, 0);
+    size_t anchor = 0;
+    for (size_t i = 0; i + MATCH_LIMIT < size;) {
+        const uint32_t sequence = read32(i);
+        const uint32_t h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const size_t candidate = table[h];
+        table[h] = i + 1;
+        if (!candidate || i + 1 - candidate > MAX_OFFSET || read32(candidate - 1) != sequence) {
+            i++;
+            continue;
+        }
+        const size_t match = candidate - 1;
+        size_t length = MIN_MATCH;
+        while (i + length < size - LAST_LITERALS && src[match + length] == src[i + length]) {
+            length++;
+        }
+        const size_t extra = length - MIN_MATCH;
+        writeLiterals(anchor, i, uint8_t(std::min(extra, size_t(15))));
+        dst.push_back(uint8_t(i - match));
+        dst.push_back(uint8_t((i - match) >> 8u));
+        if (extra >= 15) {
+            writeLength(extra - 15);
+        }
+        i += length;
+        anchor = i;
+    }
+    writeLiterals(anchor, size, 0);
+    return dst;
+}
+
 static void printUsage(const char* name) {
     std::string execName(Path(name).getName());
     const std::string from("RESGEN");
@@ -115,7 +248,7 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[]) {
-    static constexpr const char* OPTSTR = "hLp:x:ktcqj";
+    static constexpr const char* OPTSTR = "hLp:x:ktcqjz";
     static const struct option OPTIONS[] = {
             { "help",                 no_argument, 0, 'h' },
             { "license",              no_argument, 0, 'L' },
@@ -126,6 +259,7 @@ static int handleArguments(int argc, char* argv[]) {
             { "cfile",                no_argument, 0, 'c' },
             { "quiet",                no_argument, 0, 'q' },
             { "json",                 no_argument, 0, 'j' },
+            { "compress",             no_argument, 0, 'z' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -163,6 +297,9 @@ static int handleArguments(int argc, char* argv[]) {
             case 'j':
                 g_embedJson = true;
                 break;
+            case 'z':
+                g_compress = true;
+                break;
         }
     }
 
@@ -291,6 +428,9 @@ int main(int argc, char* argv[]) {
         if (g_appendNull) {
             content.push_back(0);
         }
+        if (g_compress && inPath != g_jsonMagicString) {
+            content = compress(content);
+        }
 
         // Formulate the resource name and the prefixed resource name.
         std::string rname = g_keepExtension ? inPath.getName() : inPath.getNameWithoutExtension();
@@ -353,6 +493,9 @@ int main(int argc, char* argv[]) {
     }
 
     headerStream << "}\n" << headerMacros.str();
+    if (g_compress) {
+        headerStream << DECOMPRESS_TEMPLATE;
+    }
     headerStream << "\n#endif\n";
 
     // To optimize builds, avoid overwriting the header file if nothing has changed.
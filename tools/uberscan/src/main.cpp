@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/Path.h>
+
+#include <getopt/getopt.h>
+
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+
+using namespace utils;
+
+static const char* g_outputPath = nullptr;
+
+static const char* USAGE = R"TXT(
+UBERSCAN finds which of the gltfio ubershader materials are needed by a corpus of glTF files, so
+that the others can be left out of the ubershader archive. It prints one line for each material
+needed, in the form "material <name>", and a "skinning" line if any of the files has skins or
+morph targets.
+
+Usage:
+    UBERSCAN [options] <gltf_file_0> <gltf_file_1> ...
+
+Options:
+   --help, -h
+       Print this message
+   --license, -L
+       Print copyright and license information
+   --output=path, -o path
+       Write the list to this file rather than to the standard output
+
+Examples:
+    UBERSCAN -o usage.txt helmet.glb city/*.gltf
+    > material lit_opaque
+      material unlit_fade
+)TXT";
+
+static void printUsage(const char* name) {
+    std::string execName(Path(name).getName());
+    const std::string from("UBERSCAN");
+    std::string usage(USAGE);
+    for (size_t pos = usage.find(from); pos != std::string::npos; pos = usage.find(from, pos)) {
+        usage.replace(pos, from.length(), execName);
+    }
+    puts(usage.c_str());
+}
+
+static void license() {
+    static const char *license[] = {
+        #include "licenses/licenses.inc"
+        nullptr
+    };
+
+    const char **p = &license[0];
+    while (*p)
+        std::cout << *p++ << std::endl;
+}
+
+static int handleArguments(int argc, char* argv[]) {
+    static constexpr const char* OPTSTR = "hLo:";
+    static const struct option OPTIONS[] = {
+            { "help",                 no_argument, 0, 'h' },
+            { "license",              no_argument, 0, 'L' },
+            { "output",         required_argument, 0, 'o' },
+            { 0, 0, 0, 0 }  // termination of the option list
+    };
+
+    int opt;
+    int optionIndex = 0;
+
+    while ((opt = getopt_long(argc, argv, OPTSTR, OPTIONS, &optionIndex)) >= 0) {
+        switch (opt) {
+            default:
+            case 'h':
+                printUsage(argv[0]);
+                exit(0);
+            case 'L':
+                license();
+                exit(0);
+            case 'o':
+                g_outputPath = optarg;
+                break;
+        }
+    }
+
+    return optind;
+}
+
+// Returns the name of the ubershader material that UbershaderLoader picks for a glTF material,
+// which is also the basename of its source in libs/gltfio/materials.
+static std::string getMaterialName(const cgltf_material* material) {
+    if (!material) {
+        return "lit_opaque";
+    }
+
+    // The ubershaders don't support these extensions together, UbershaderLoader drops them.
+    bool sheen = material->has_sheen;
+    bool transmission = material->has_transmission;
+    if (transmission && sheen) {
+        sheen = false;
+    }
+    if (material->has_clearcoat && (transmission || sheen)) {
+        transmission = false;
+        sheen = false;
+    }
+    if (transmission) {
+        return "lit_transmission";
+    }
+    if (sheen) {
+        return "lit_sheen";
+    }
+
+    const char* shading = material->unlit ? "unlit" :
+            (material->has_pbr_specular_glossiness ? "specularGlossiness" : "lit");
+    const char* blending = "opaque";
+    switch (material->alpha_mode) {
+        case cgltf_alpha_mode_opaque:
+            blending = "opaque";
+            break;
+        case cgltf_alpha_mode_mask:
+            blending = "masked";
+            break;
+        case cgltf_alpha_mode_blend:
+            blending = "fade";
+            break;
+    }
+    return std::string(shading) + "_" + blending;
+}
+
+int main(int argc, char* argv[]) {
+    int optionIndex = handleArguments(argc, argv);
+    int numArgs = argc - optionIndex;
+    if (numArgs < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::set<std::string> materials;
+    bool skinning = false;
+
+    for (int argIndex = optionIndex; argIndex < argc; ++argIndex) {
+        const char* path = argv[argIndex];
+
+        // Only the JSON is needed, buffers and images are not loaded.
+        cgltf_options options {};
+        cgltf_data* data = nullptr;
+        if (cgltf_parse_file(&options, path, &data) != cgltf_result_success) {
+            std::cerr << "Unable to parse " << path << std::endl;
+            return 1;
+        }
+
+        skinning = skinning || data->skins_count > 0;
+        for (cgltf_size i = 0; i < data->meshes_count; ++i) {
+            const cgltf_mesh& mesh = data->meshes[i];
+            for (cgltf_size j = 0; j < mesh.primitives_count; ++j) {
+                const cgltf_primitive& prim = mesh.primitives[j];
+                materials.insert(getMaterialName(prim.material));
+                skinning = skinning || prim.targets_count > 0;
+            }
+        }
+        cgltf_free(data);
+    }
+
+    std::ofstream file;
+    if (g_outputPath) {
+        file.open(g_outputPath);
+        if (!file) {
+            std::cerr << "Unable to open " << g_outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = g_outputPath ? file : std::cout;
+    for (const std::string& material : materials) {
+        out << "material " << material << std::endl;
+    }
+    if (skinning) {
+        out << "skinning" << std::endl;
+    }
+    return 0;
+}
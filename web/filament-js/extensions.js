@@ -48,7 +48,8 @@ Filament.shadowOptions = function(overrides) {
         polygonOffsetSlope: 2.0,
         screenSpaceContactShadows: false,
         stepCount: 8,
-        maxShadowDistance: 0.3
+        maxShadowDistance: 0.3,
+        isStatic: false
     };
     return Object.assign(options, overrides);
 };
@@ -201,7 +202,7 @@ Filament.loadClassExtensions = function() {
     /// overrides ::argument:: Dictionary with one or more of the following properties: \
     /// mapSize, shadowCascades, constantBias, normalBias, shadowFar, shadowNearHint, \
     /// shadowFarHint, stable, polygonOffsetConstant, polygonOffsetSlope, \
-    // screenSpaceContactShadows, stepCount, maxShadowDistance.
+    // screenSpaceContactShadows, stepCount, maxShadowDistance, isStatic.
     Filament.LightManager.prototype.setShadowOptions = function(instance, overrides) {
         this._setShadowOptions(instance, Filament.shadowOptions(overrides));
     };
@@ -319,6 +320,20 @@ Filament.loadClassExtensions = function() {
         buffer.delete();
     };
 
+    /// mapBufferAt ::method:: Updates part of a buffer with data written directly to the \
+    /// returned view of the WASM heap, which avoids the allocation and the copy of setBufferAt. \
+    /// The view must be filled before the next call to render, endFrame or flush, and must not \
+    /// be kept: it is invalidated when the heap grows.
+    /// engine ::argument:: [Engine]
+    /// bufferIndex ::argument:: non-negative integer
+    /// byteCount ::argument:: non-negative integer
+    /// byteOffset ::argument:: non-negative integer
+    /// ::retval:: Uint8Array, or null if bufferIndex is out of range or byteCount is 0
+    Filament.VertexBuffer.prototype.mapBufferAt = function(engine, bufferIndex, byteCount,
+            byteOffset = 0) {
+        return this._mapBufferAt(engine, bufferIndex, byteCount, byteOffset);
+    };
+
     /// IndexBuffer ::core class::
 
     /// setBuffer ::method::
@@ -331,6 +346,16 @@ Filament.loadClassExtensions = function() {
         buffer.delete();
     };
 
+    /// mapBuffer ::method:: Updates part of the indices with data written directly to the \
+    /// returned view of the WASM heap, see VertexBuffer.mapBufferAt.
+    /// engine ::argument:: [Engine]
+    /// byteCount ::argument:: non-negative integer
+    /// byteOffset ::argument:: non-negative integer
+    /// ::retval:: Uint8Array, or null if byteCount is 0
+    Filament.IndexBuffer.prototype.mapBuffer = function(engine, byteCount, byteOffset = 0) {
+        return this._mapBuffer(engine, byteCount, byteOffset);
+    };
+
     Filament.LightManager$Builder.prototype.shadowOptions = function(overrides) {
         return this._shadowOptions(Filament.shadowOptions(overrides));
     };
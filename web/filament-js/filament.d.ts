@@ -29,6 +29,7 @@ export function getSupportedFormatSuffix(desired: string): void;
 export function init(assets: string[], onready?: (() => void) | null): void;
 export function fetch(assets: string[], onDone?: (() => void) | null, onFetched?: ((name: string) => void) | null): void;
 export function clearAssetCache(): void;
+export function isSimdSupported(): boolean;
 
 export const assets: {[url: string]: Uint8Array};
 
@@ -88,6 +89,7 @@ export interface LightManager$ShadowOptions {
     screenSpaceContactShadows?: boolean;
     stepCount?: number;
     maxShadowDistance?: number;
+    isStatic?: boolean;
 }
 
 export interface View$AmbientOcclusionOptions {
@@ -224,12 +226,14 @@ export class VertexBuffer$Builder {
             offset: number, stride: number): VertexBuffer$Builder;
     public normalized(attrib: VertexAttribute): VertexBuffer$Builder;
     public normalizedIf(attrib: VertexAttribute, normalized: boolean): VertexBuffer$Builder;
+    public streaming(enabled: boolean): VertexBuffer$Builder;
     public build(engine: Engine): VertexBuffer;
 }
 
 export class IndexBuffer$Builder {
     public indexCount(count: number): IndexBuffer$Builder;
     public bufferType(type: IndexBuffer$IndexType): IndexBuffer$Builder;
+    public streaming(enabled: boolean): IndexBuffer$Builder;
     public build(engine: Engine): IndexBuffer;
 }
 
@@ -361,11 +365,14 @@ export class VertexBuffer {
     public static Builder(): VertexBuffer$Builder;
     public setBufferAt(engine: Engine, bufindex: number, f32array: BufferReference,
             byteOffset?: number): void;
+    public mapBufferAt(engine: Engine, bufindex: number, byteCount: number,
+            byteOffset?: number): Uint8Array|null;
 }
 
 export class IndexBuffer {
     public static Builder(): IndexBuffer$Builder;
     public setBuffer(engine: Engine, u16array: BufferReference, byteOffset?: number): void;
+    public mapBuffer(engine: Engine, byteCount: number, byteOffset?: number): Uint8Array|null;
 }
 
 export class Renderer {
@@ -584,6 +591,7 @@ export class gltfio$FilamentAsset {
     public getCameraEntities(): Entity[];
     public getRoot(): Entity;
     public popRenderable(): Entity;
+    public isRenderableReady(entity: Entity): boolean;
     public getMaterialInstances(): Vector<MaterialInstance>;
     public getResourceUris(): Vector<string>;
     public getBoundingBox(): Aabb;
@@ -704,6 +712,8 @@ export enum CompressedPixelDataType {
     SRGB8_ALPHA8_ASTC_10x10,
     SRGB8_ALPHA8_ASTC_12x10,
     SRGB8_ALPHA8_ASTC_12x12,
+    RGB_BPTC_SIGNED_FLOAT,
+    RGB_BPTC_UNSIGNED_FLOAT,
 }
 
 export enum IndexBuffer$IndexType {
@@ -885,6 +895,8 @@ export enum Texture$InternalFormat {
     SRGB8_ALPHA8_ASTC_10x10,
     SRGB8_ALPHA8_ASTC_12x10,
     SRGB8_ALPHA8_ASTC_12x12,
+    RGB_BPTC_SIGNED_FLOAT,
+    RGB_BPTC_UNSIGNED_FLOAT,
 }
 
 export enum Texture$Sampler {
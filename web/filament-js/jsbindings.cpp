@@ -402,7 +402,8 @@ value_object<LightManager::ShadowOptions>("LightManager$ShadowOptions")
     .field("polygonOffsetSlope", &LightManager::ShadowOptions::polygonOffsetSlope)
     .field("screenSpaceContactShadows", &LightManager::ShadowOptions::screenSpaceContactShadows)
     .field("stepCount", &LightManager::ShadowOptions::stepCount)
-    .field("maxShadowDistance", &LightManager::ShadowOptions::maxShadowDistance);
+    .field("maxShadowDistance", &LightManager::ShadowOptions::maxShadowDistance)
+    .field("isStatic", &LightManager::ShadowOptions::isStatic);
 
 // In JavaScript, a flat contiguous representation is best for matrices (see gl-matrix) so we
 // need to define a small wrapper here.
@@ -1154,7 +1155,9 @@ class_<VertexBuilder>("VertexBuffer$Builder")
             VertexAttribute attrib, bool normalized), {
         return &builder->normalized(attrib, normalized); })
     .BUILDER_FUNCTION("bufferCount", VertexBuilder, (VertexBuilder* builder, int count), {
-        return &builder->bufferCount(count); });
+        return &builder->bufferCount(count); })
+    .BUILDER_FUNCTION("streaming", VertexBuilder, (VertexBuilder* builder, bool enabled), {
+        return &builder->streaming(enabled); });
 
 /// VertexBuffer ::core class:: Bundle of buffers and associated vertex attributes.
 class_<VertexBuffer>("VertexBuffer")
@@ -1162,6 +1165,13 @@ class_<VertexBuffer>("VertexBuffer")
     .function("_setBufferAt", EMBIND_LAMBDA(void, (VertexBuffer* self,
             Engine* engine, uint8_t bufferIndex, BufferDescriptor vbd, uint32_t byteOffset), {
         self->setBufferAt(*engine, bufferIndex, std::move(*vbd.bd), byteOffset);
+    }), allow_raw_pointers())
+    // The update is written by JavaScript straight into memory owned by the engine, in the WASM
+    // heap, so there is neither an allocation nor a copy to the heap.
+    .function("_mapBufferAt", EMBIND_LAMBDA(val, (VertexBuffer* self,
+            Engine* engine, uint8_t bufferIndex, uint32_t byteCount, uint32_t byteOffset), {
+        uint8_t* data = (uint8_t*) self->mapBufferAt(*engine, bufferIndex, byteCount, byteOffset);
+        return data ? val(typed_memory_view(byteCount, data)) : val::null();
     }), allow_raw_pointers());
 
 class_<IndexBuilder>("IndexBuffer$Builder")
@@ -1172,7 +1182,9 @@ class_<IndexBuilder>("IndexBuffer$Builder")
         return &builder->indexCount(count); })
     .BUILDER_FUNCTION("bufferType", IndexBuilder, (IndexBuilder* builder,
             IndexBuffer::IndexType indexType), {
-        return &builder->bufferType(indexType); });
+        return &builder->bufferType(indexType); })
+    .BUILDER_FUNCTION("streaming", IndexBuilder, (IndexBuilder* builder, bool enabled), {
+        return &builder->streaming(enabled); });
 
 /// IndexBuffer ::core class:: Array of 16-bit or 32-bit unsigned integers consumed by the GPU.
 class_<IndexBuffer>("IndexBuffer")
@@ -1180,6 +1192,11 @@ class_<IndexBuffer>("IndexBuffer")
     .function("_setBuffer", EMBIND_LAMBDA(void, (IndexBuffer* self,
             Engine* engine, BufferDescriptor ibd, uint32_t byteOffset), {
         self->setBuffer(*engine, std::move(*ibd.bd), byteOffset);
+    }), allow_raw_pointers())
+    .function("_mapBuffer", EMBIND_LAMBDA(val, (IndexBuffer* self,
+            Engine* engine, uint32_t byteCount, uint32_t byteOffset), {
+        uint8_t* data = (uint8_t*) self->mapBuffer(*engine, byteCount, byteOffset);
+        return data ? val(typed_memory_view(byteCount, data)) : val::null();
     }), allow_raw_pointers());
 
 class_<Material>("Material")
@@ -1698,6 +1715,8 @@ class_<FilamentAsset>("gltfio$FilamentAsset")
 
     .function("popRenderable", &FilamentAsset::popRenderable)
 
+    .function("isRenderableReady", &FilamentAsset::isRenderableReady)
+
     .function("getMaterialInstances", EMBIND_LAMBDA(std::vector<const MaterialInstance*>,
             (FilamentAsset* self), {
         const filament::MaterialInstance* const* ptr = self->getMaterialInstances();
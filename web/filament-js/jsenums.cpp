@@ -269,7 +269,9 @@ enum_<Texture::InternalFormat>("Texture$InternalFormat") // aka backend::Texture
     .value("SRGB8_ALPHA8_ASTC_10x8", Texture::InternalFormat::SRGB8_ALPHA8_ASTC_10x8)
     .value("SRGB8_ALPHA8_ASTC_10x10", Texture::InternalFormat::SRGB8_ALPHA8_ASTC_10x10)
     .value("SRGB8_ALPHA8_ASTC_12x10", Texture::InternalFormat::SRGB8_ALPHA8_ASTC_12x10)
-    .value("SRGB8_ALPHA8_ASTC_12x12", Texture::InternalFormat::SRGB8_ALPHA8_ASTC_12x12);
+    .value("SRGB8_ALPHA8_ASTC_12x12", Texture::InternalFormat::SRGB8_ALPHA8_ASTC_12x12)
+    .value("RGB_BPTC_SIGNED_FLOAT", Texture::InternalFormat::RGB_BPTC_SIGNED_FLOAT)
+    .value("RGB_BPTC_UNSIGNED_FLOAT", Texture::InternalFormat::RGB_BPTC_UNSIGNED_FLOAT);
 
 enum_<Texture::Usage>("Texture$Usage") // aka backend::TextureUsage
     .value("DEFAULT", Texture::Usage::DEFAULT)
@@ -359,7 +361,9 @@ enum_<backend::CompressedPixelDataType>("CompressedPixelDataType")
     .value("SRGB8_ALPHA8_ASTC_10x8", backend::CompressedPixelDataType::SRGB8_ALPHA8_ASTC_10x8)
     .value("SRGB8_ALPHA8_ASTC_10x10", backend::CompressedPixelDataType::SRGB8_ALPHA8_ASTC_10x10)
     .value("SRGB8_ALPHA8_ASTC_12x10", backend::CompressedPixelDataType::SRGB8_ALPHA8_ASTC_12x10)
-    .value("SRGB8_ALPHA8_ASTC_12x12", backend::CompressedPixelDataType::SRGB8_ALPHA8_ASTC_12x12);
+    .value("SRGB8_ALPHA8_ASTC_12x12", backend::CompressedPixelDataType::SRGB8_ALPHA8_ASTC_12x12)
+    .value("RGB_BPTC_SIGNED_FLOAT", backend::CompressedPixelDataType::RGB_BPTC_SIGNED_FLOAT)
+    .value("RGB_BPTC_UNSIGNED_FLOAT", backend::CompressedPixelDataType::RGB_BPTC_UNSIGNED_FLOAT);
 
 enum_<backend::SamplerWrapMode>("WrapMode")
     .value("CLAMP_TO_EDGE", backend::SamplerWrapMode::CLAMP_TO_EDGE)
@@ -48,10 +48,16 @@ Filament.init = (assets, onready) => {
     // Issue a fetch for each asset.
     Filament.fetch(assets, null, taskFinished);
 
+    // Browsers that support WebAssembly SIMD load the module built with it, if it was packaged.
+    const moduleArgs = {};
+    if (Filament.hasSimdWasm && Filament.isSimdSupported()) {
+        moduleArgs.locateFile = (path, prefix) => prefix + path.replace(/\.wasm$/, '-simd.wasm');
+    }
+
     // Emscripten creates a global function called "Filament" that returns a promise that
     // resolves to a module. Here we replace the function with the module. Note that our
     // TypeScript bindings assume that Filament is a namespace, not a function.
-    Filament().then(module => {
+    Filament(moduleArgs).then(module => {
         Filament = Object.assign(module, Filament);
 
         // At this point, emscripten has finished compiling and instancing the WebAssembly module.
@@ -63,6 +69,14 @@ Filament.init = (assets, onready) => {
     });
 };
 
+/// isSimdSupported ::function:: Returns whether the browser supports WebAssembly SIMD.
+Filament.isSimdSupported = () => {
+    // a function that returns i8x16.popcnt(i8x16.splat(0)), which only validates with SIMD
+    const module = new Uint8Array([0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0,
+            10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11]);
+    return typeof WebAssembly === 'object' && WebAssembly.validate(module);
+};
+
 Filament.clearAssetCache = () => {
     for (const key in Filament.assets) delete Filament.assets[key];
 };